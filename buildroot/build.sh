@@ -25,7 +25,8 @@ cmake \
     -DBUILD_SHARED_LIBS=ON \
     -DBUILD_SHARED_LIB=ON \
     -DLV_CONF_BUILD_DISABLE_EXAMPLES=ON \
-    -DLV_CONF_BUILD_DISABLE_DEMOS=ON
+    -DLV_CONF_BUILD_DISABLE_DEMOS=ON \
+    "$@"
 
 make -j$((`nproc`))
 
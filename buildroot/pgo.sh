@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Profile guided release build
+#
+#   ./pgo.sh generate   - instrumented build, install it on the device
+#   ./pgo.sh use        - final -O3 LTO build with the profiles in ../pgo
+#
+# Workload on the device, between the two steps:
+#
+#   1. Put an IQ recording to /mnt/iq_replay.x6iq, it is replayed on boot instead of
+#      the live flow (see iq_capture.h). A busy FT8 band segment covers the most code
+#   2. Start the app, open FT8 and let it decode for a few periods, switch through
+#      the modes and zoom levels of the waterfall
+#   3. killall -TERM x6100_gui, the profiles are written to /mnt/pgo
+#   4. Copy /mnt/pgo/* to ../pgo on the host
+#
+# Both builds use the same build directory, profile names depend on object paths.
+#
+# CPU per subsystem: run both builds with X6100_PERF_STATS=1 on the same replay and
+# compare per-thread load in /tmp/perf_stats.txt (waterfall, audio_capture, ft8, ui...)
+
+set -e
+
+case "$1" in
+    generate)
+        ./build.sh -DRELEASE_PGO=GENERATE
+        ;;
+    use)
+        if [ -z "$(ls -A ../pgo 2>/dev/null)" ]; then
+            echo "No profiles in ../pgo"
+            exit 1
+        fi
+        ./build.sh -DRELEASE_PGO=USE -DPGO_PROFILE_DIR=$(realpath ../pgo)
+        ;;
+    *)
+        echo "Usage: $0 generate|use"
+        exit 1
+        ;;
+esac
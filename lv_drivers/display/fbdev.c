@@ -16,6 +16,7 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <pthread.h>
 
 #if USE_BSD_FBDEV
 #include <sys/fcntl.h>
@@ -37,6 +38,15 @@
 #define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
 #endif
 
+#ifndef FBDEV_PAGE_FLIP
+#define FBDEV_PAGE_FLIP 0
+#endif
+
+#define FLIP_AREAS_MAX  16
+
+/* Square of pixels rotated at once, source and destination lines stay in cache */
+#define ROT_TILE        16
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -61,6 +71,13 @@ struct bsd_fb_fix_info{
 /**********************
  *  STATIC PROTOTYPES
  **********************/
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+static void flip_init(void);
+static void flip_add_area(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+static void flip_pages(void);
+#endif
+static uint32_t page_offset(void);
+static void * flush_worker(void * arg);
 
 /**********************
  *  STATIC VARIABLES
@@ -76,6 +93,24 @@ static char *fbp = 0;
 static long int screensize = 0;
 static int fbfd = 0;
 
+/* Asynchronous flush: one area in flight, copied by the flush thread */
+static fbdev_flush_cb_t flush_target = NULL;
+static pthread_t        flush_thread;
+static pthread_mutex_t  flush_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   flush_cond = PTHREAD_COND_INITIALIZER;
+static bool             flush_pending = false;
+static lv_disp_drv_t    *flush_drv;
+static lv_area_t        flush_area;
+static lv_color_t       *flush_color_p;
+
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+/* Two pages in the virtual framebuffer: flush draws to the back one, the last flush pans to it */
+static bool      flip = false;
+static uint32_t  back_page = 1;
+static lv_area_t flip_areas[FLIP_AREAS_MAX];
+static uint32_t  flip_areas_cnt = 0;
+#endif
+
 /**********************
  *      MACROS
  **********************/
@@ -159,6 +194,10 @@ void fbdev_init(void)
 
     LV_LOG_INFO("The framebuffer device was mapped to memory successfully");
 
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+    flip_init();
+#endif
+
 }
 
 void fbdev_exit(void)
@@ -192,6 +231,7 @@ void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color
 
 
     lv_coord_t w = (act_x2 - act_x1 + 1);
+    uint32_t page_y = page_offset();
     long int location = 0;
     long int byte_location = 0;
     unsigned char bit_location = 0;
@@ -201,7 +241,7 @@ void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color
         uint32_t * fbp32 = (uint32_t *)fbp;
         int32_t y;
         for(y = act_y1; y <= act_y2; y++) {
-            location = (act_x1 + vinfo.xoffset) + (y + vinfo.yoffset) * finfo.line_length / 4;
+            location = (act_x1 + vinfo.xoffset) + (y + page_y) * finfo.line_length / 4;
             memcpy(&fbp32[location], (uint32_t *)color_p, (act_x2 - act_x1 + 1) * 4);
             color_p += w;
         }
@@ -211,7 +251,7 @@ void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color
         uint16_t * fbp16 = (uint16_t *)fbp;
         int32_t y;
         for(y = act_y1; y <= act_y2; y++) {
-            location = (act_x1 + vinfo.xoffset) + (y + vinfo.yoffset) * finfo.line_length / 2;
+            location = (act_x1 + vinfo.xoffset) + (y + page_y) * finfo.line_length / 2;
             memcpy(&fbp16[location], (uint32_t *)color_p, (act_x2 - act_x1 + 1) * 2);
             color_p += w;
         }
@@ -221,7 +261,7 @@ void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color
         uint8_t * fbp8 = (uint8_t *)fbp;
         int32_t y;
         for(y = act_y1; y <= act_y2; y++) {
-            location = (act_x1 + vinfo.xoffset) + (y + vinfo.yoffset) * finfo.line_length;
+            location = (act_x1 + vinfo.xoffset) + (y + page_y) * finfo.line_length;
             memcpy(&fbp8[location], (uint32_t *)color_p, (act_x2 - act_x1 + 1));
             color_p += w;
         }
@@ -233,7 +273,7 @@ void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color
         int32_t y;
         for(y = act_y1; y <= act_y2; y++) {
             for(x = act_x1; x <= act_x2; x++) {
-                location = (x + vinfo.xoffset) + (y + vinfo.yoffset) * vinfo.xres;
+                location = (x + vinfo.xoffset) + (y + page_y) * vinfo.xres;
                 byte_location = location / 8; /* find the byte we need to change */
                 bit_location = location % 8; /* inside the byte found, find the bit we need to change */
                 fbp8[byte_location] &= ~(((uint8_t)(1)) << bit_location);
@@ -250,9 +290,137 @@ void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color
     //May be some direct update command is required
     //ret = ioctl(state->fd, FBIO_UPDATE, (unsigned long)((uintptr_t)rect));
 
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+    if(flip) {
+        flip_add_area(act_x1, act_y1, act_x2, act_y2);
+
+        if(lv_disp_flush_is_last(drv)) {
+            flip_pages();
+        }
+    }
+#endif
+
+    lv_disp_flush_ready(drv);
+}
+
+/**
+ * Flush a buffer rendered in landscape orientation to the portrait panel,
+ * rotating it by 90 degrees while copying. Same mapping as LV_DISP_ROT_90:
+ * panel x = y, panel y = panel height - 1 - x. Only 32 bit per pixel.
+ * @param drv pointer to driver where this function belongs
+ * @param area an area where to copy `color_p`, in landscape coordinates
+ * @param color_p an array of pixels to copy to the `area` part of the screen
+ */
+void fbdev_flush_rot90(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    int32_t w = (int32_t)vinfo.yres;
+    int32_t h = (int32_t)vinfo.xres;
+
+    if(fbp == NULL || vinfo.bits_per_pixel != 32 ||
+            area->x2 < 0 ||
+            area->y2 < 0 ||
+            area->x1 > w - 1 ||
+            area->y1 > h - 1) {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+    int32_t act_x1 = area->x1 < 0 ? 0 : area->x1;
+    int32_t act_y1 = area->y1 < 0 ? 0 : area->y1;
+    int32_t act_x2 = area->x2 > w - 1 ? w - 1 : area->x2;
+    int32_t act_y2 = area->y2 > h - 1 ? h - 1 : area->y2;
+
+    lv_coord_t  src_w = lv_area_get_width(area);
+    uint32_t    *src = (uint32_t *)color_p;
+    uint32_t    *fbp32 = (uint32_t *)fbp;
+    uint32_t    stride = finfo.line_length / 4;
+    uint32_t    page_y = page_offset();
+
+    for(int32_t ty = act_y1; ty <= act_y2; ty += ROT_TILE) {
+        int32_t ty2 = LV_MIN(ty + ROT_TILE - 1, act_y2);
+
+        for(int32_t tx = act_x1; tx <= act_x2; tx += ROT_TILE) {
+            int32_t tx2 = LV_MIN(tx + ROT_TILE - 1, act_x2);
+
+            /* Each source column becomes a panel row */
+            for(int32_t x = tx; x <= tx2; x++) {
+                uint32_t *dst = &fbp32[(w - 1 - x + page_y) * stride + ty + vinfo.xoffset];
+                uint32_t *from = &src[(ty - area->y1) * src_w + (x - area->x1)];
+
+                for(int32_t y = ty; y <= ty2; y++) {
+                    *dst++ = *from;
+                    from += src_w;
+                }
+            }
+        }
+    }
+
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+    if(flip) {
+        flip_add_area(act_y1, w - 1 - act_x2, act_y2, w - 1 - act_x1);
+
+        if(lv_disp_flush_is_last(drv)) {
+            flip_pages();
+        }
+    }
+#endif
+
     lv_disp_flush_ready(drv);
 }
 
+/**
+ * Start the flush thread, which calls `flush` for areas passed to fbdev_flush_async()
+ * @param flush fbdev_flush or fbdev_flush_rot90
+ */
+void fbdev_async_init(fbdev_flush_cb_t flush)
+{
+    flush_target = flush;
+
+    if(pthread_create(&flush_thread, NULL, flush_worker, NULL) != 0) {
+        perror("Error: cannot create flush thread");
+        flush_target = NULL;
+        return;
+    }
+    pthread_detach(flush_thread);
+}
+
+/**
+ * Hand the area to the flush thread and return, so LVGL can render the next
+ * area into its other draw buffer meanwhile
+ */
+void fbdev_flush_async(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    if(flush_target == NULL) {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+    pthread_mutex_lock(&flush_mux);
+    while(flush_pending) {
+        pthread_cond_wait(&flush_cond, &flush_mux);
+    }
+    flush_drv = drv;
+    flush_area = *area;
+    flush_color_p = color_p;
+    flush_pending = true;
+    pthread_cond_broadcast(&flush_cond);
+    pthread_mutex_unlock(&flush_mux);
+}
+
+/**
+ * Wait callback for LVGL: sleep until the area in flight is flushed instead of spinning
+ */
+void fbdev_flush_wait(lv_disp_drv_t * drv)
+{
+    LV_UNUSED(drv);
+
+    pthread_mutex_lock(&flush_mux);
+    while(flush_pending) {
+        pthread_cond_wait(&flush_cond, &flush_mux);
+    }
+    pthread_mutex_unlock(&flush_mux);
+}
+
 void fbdev_get_sizes(uint32_t *width, uint32_t *height, uint32_t *dpi) {
     if (width)
         *width = vinfo.xres;
@@ -273,4 +441,142 @@ void fbdev_set_offset(uint32_t xoffset, uint32_t yoffset) {
  *   STATIC FUNCTIONS
  **********************/
 
+static void * flush_worker(void * arg)
+{
+    LV_UNUSED(arg);
+
+    pthread_mutex_lock(&flush_mux);
+    while(1) {
+        while(!flush_pending) {
+            pthread_cond_wait(&flush_cond, &flush_mux);
+        }
+        pthread_mutex_unlock(&flush_mux);
+
+        /* Calls lv_disp_flush_ready() when done */
+        flush_target(flush_drv, &flush_area, flush_color_p);
+
+        pthread_mutex_lock(&flush_mux);
+        flush_pending = false;
+        pthread_cond_broadcast(&flush_cond);
+    }
+    return NULL;
+}
+
+/**
+ * Row of the page, which flush draws to
+ */
+static uint32_t page_offset(void)
+{
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+    if(flip) {
+        return back_page * vinfo.yres;
+    }
+#endif
+    return vinfo.yoffset;
+}
+
+#if FBDEV_PAGE_FLIP && !USE_BSD_FBDEV
+/**
+ * Double the virtual height and check that the driver can pan over it
+ */
+static void flip_init(void)
+{
+    struct fb_var_screeninfo var = vinfo;
+    size_t page_size = finfo.line_length * vinfo.yres;
+
+    if(finfo.smem_len < page_size * 2) {
+        LV_LOG_WARN("Framebuffer is too small for page flip");
+        return;
+    }
+
+    var.yres_virtual = vinfo.yres * 2;
+    var.yoffset = 0;
+
+    if(ioctl(fbfd, FBIOPUT_VSCREENINFO, &var) == -1 || ioctl(fbfd, FBIOGET_VSCREENINFO, &var) == -1 ||
+            var.yres_virtual < vinfo.yres * 2) {
+        LV_LOG_WARN("Virtual framebuffer can't hold two pages");
+        return;
+    }
+    if(ioctl(fbfd, FBIOPAN_DISPLAY, &var) == -1) {
+        LV_LOG_WARN("Framebuffer can't pan");
+        return;
+    }
+    vinfo = var;
+
+    /* Both pages start with what is shown now */
+    memcpy(fbp + page_size, fbp, page_size);
+
+    back_page = 1;
+    flip = true;
+    LV_LOG_INFO("Page flip enabled");
+}
+
+/**
+ * Remember an area drawn to the back page, merge all of them when the list is full
+ */
+static void flip_add_area(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    lv_area_t area = { x1, y1, x2, y2 };
+
+    if(flip_areas_cnt < FLIP_AREAS_MAX) {
+        flip_areas[flip_areas_cnt++] = area;
+        return;
+    }
+    for(uint32_t i = 1; i < flip_areas_cnt; i++) {
+        _lv_area_join(&flip_areas[0], &flip_areas[0], &flip_areas[i]);
+    }
+    _lv_area_join(&flip_areas[0], &flip_areas[0], &area);
+    flip_areas_cnt = 1;
+}
+
+/**
+ * Show the back page on vsync, then bring the new back page up to date with
+ * the areas drawn in this frame
+ */
+static void flip_pages(void)
+{
+    uint32_t front_page = back_page;
+    uint32_t vsync = 0;
+
+    vinfo.yoffset = front_page * vinfo.yres;
+    ioctl(fbfd, FBIO_WAITFORVSYNC, &vsync);
+
+    size_t page_size = finfo.line_length * vinfo.yres;
+
+    if(ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo) == -1) {
+        perror("ioctl(FBIOPAN_DISPLAY)");
+
+        /* Fall back to drawing into the shown page */
+        vinfo.yoffset = (front_page ^ 1) * vinfo.yres;
+        memcpy(fbp + vinfo.yoffset * finfo.line_length, fbp + front_page * page_size, page_size);
+        flip = false;
+        return;
+    }
+
+    back_page = front_page ^ 1;
+
+    uint32_t bpp = vinfo.bits_per_pixel == 24 ? 4 : vinfo.bits_per_pixel / 8;
+
+    if(bpp == 0) {
+        /* 1 bit per pixel, packed rows: copy the whole page */
+        memcpy(fbp + back_page * page_size, fbp + front_page * page_size, page_size);
+        flip_areas_cnt = 0;
+        return;
+    }
+
+    for(uint32_t i = 0; i < flip_areas_cnt; i++) {
+        lv_area_t *a = &flip_areas[i];
+        size_t    len = (a->x2 - a->x1 + 1) * bpp;
+
+        for(int32_t y = a->y1; y <= a->y2; y++) {
+            size_t from = (y + front_page * vinfo.yres) * finfo.line_length + (a->x1 + vinfo.xoffset) * bpp;
+            size_t to = (y + back_page * vinfo.yres) * finfo.line_length + (a->x1 + vinfo.xoffset) * bpp;
+
+            memcpy(fbp + to, fbp + from, len);
+        }
+    }
+    flip_areas_cnt = 0;
+}
+#endif
+
 #endif
@@ -36,6 +36,7 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+typedef void (*fbdev_flush_cb_t)(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -43,6 +44,18 @@ extern "C" {
 void fbdev_init(void);
 void fbdev_exit(void);
 void fbdev_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
+/**
+ * Flush a landscape buffer to a portrait framebuffer, rotating by 90 degrees while copying.
+ * Used instead of LVGL software rotation.
+ */
+void fbdev_flush_rot90(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
+/**
+ * Flush areas from a separate thread with `flush`, use with two draw buffers:
+ * flush_cb = fbdev_flush_async, wait_cb = fbdev_flush_wait
+ */
+void fbdev_async_init(fbdev_flush_cb_t flush);
+void fbdev_flush_async(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
+void fbdev_flush_wait(lv_disp_drv_t * drv);
 void fbdev_get_sizes(uint32_t *width, uint32_t *height, uint32_t *dpi);
 /**
  * Set the X and Y offset in the variable framebuffer info.
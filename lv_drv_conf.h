@@ -321,6 +321,7 @@
 #if USE_FBDEV
 #  define FBDEV_PATH              "/dev/fb0"
 #  define FBDEV_DISPLAY_POWER_ON  1 /* 1 to force display power during initialization */
+#  define FBDEV_PAGE_FLIP         1 /* 1 to draw into a second page and pan to it on vsync */
 #endif
 
 /*-----------------------------------------
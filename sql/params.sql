@@ -64,8 +64,24 @@ CREATE TABLE transverter(
     UNIQUE      (id, name) ON CONFLICT REPLACE
 );
 
+CREATE TABLE swrscan(
+    ant         INTEGER NOT NULL,
+    band        INTEGER NOT NULL,
+    points      BLOB,
+    PRIMARY KEY(ant, band)
+);
+
+CREATE TABLE profiles(
+    name        TEXT NOT NULL,
+    item        TEXT NOT NULL,
+    val,
+    PRIMARY KEY(name, item)
+);
+
+-- Schema of the last migration in src/params/migrations.c, none run on first boot
 CREATE TABLE version(id INT NOT NULL DEFAULT 0);
-INSERT INTO version(id) values (1);
+INSERT INTO version(id) values (4);
+PRAGMA user_version = 4;
 
 CREATE TABLE digital_modes(
     id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -81,3 +97,4 @@ CREATE INDEX digital_modes_freq_idx ON digital_modes (freq);
 .separator ","
 .import digital_modes.csv digital_modes
 
+VACUUM;
@@ -17,9 +17,13 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
 #include <unistd.h>
-#include <regex.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MHZ 1000000
 #define KHZ 1000
@@ -27,24 +31,72 @@
 #define ARRAY_SIZE(arr) (sizeof((arr)) / sizeof((arr)[0]))
 #define COPY_STR(dst, src, len) (copy_str(dst, src, len, sizeof(dst)))
 
+#define FIELD_HASH_SIZE 32
+
 struct adif_log_s {
     FILE *fd;
 };
 
-static void write_header(FILE *fd);
+typedef enum {
+    FIELD_UNKNOWN = 0,
+    FIELD_OPERATOR,
+    FIELD_STATION_CALLSIGN,
+    FIELD_CALL,
+    FIELD_QSO_DATE,
+    FIELD_TIME_ON,
+    FIELD_MODE,
+    FIELD_SUBMODE,
+    FIELD_NAME,
+    FIELD_QTH,
+    FIELD_RST_SENT,
+    FIELD_RST_RCVD,
+    FIELD_BAND,
+    FIELD_FREQ,
+    FIELD_MY_GRIDSQUARE,
+    FIELD_GRIDSQUARE,
+} adif_field_t;
+
+typedef struct {
+    const char      *name;
+    adif_field_t    field;
+} adif_field_def_t;
+
+/* Record being parsed */
+typedef struct {
+    qso_log_record_t    record;
+    struct tm           ts;
+    char                mode[16];
+    char                submode[16];
+} adif_parse_t;
 
-static void write_str(FILE *fd, const char * key, const char * val);
-static void write_int(FILE *fd, const char * key, int val);
+/*
+ * Perfect hash of the known field names, see field_hash(). Slots are checked with
+ * a full compare, other fields are skipped
+ */
+static const adif_field_def_t fields[FIELD_HASH_SIZE] = {
+    [1]  = { "QSO_DATE",         FIELD_QSO_DATE },
+    [4]  = { "SUBMODE",          FIELD_SUBMODE },
+    [8]  = { "RST_SENT",         FIELD_RST_SENT },
+    [9]  = { "TIME_ON",          FIELD_TIME_ON },
+    [11] = { "FREQ",             FIELD_FREQ },
+    [12] = { "OPERATOR",         FIELD_OPERATOR },
+    [14] = { "CALL",             FIELD_CALL },
+    [15] = { "GRIDSQUARE",       FIELD_GRIDSQUARE },
+    [16] = { "STATION_CALLSIGN", FIELD_STATION_CALLSIGN },
+    [20] = { "BAND",             FIELD_BAND },
+    [21] = { "MODE",             FIELD_MODE },
+    [23] = { "NAME",             FIELD_NAME },
+    [24] = { "RST_RCVD",         FIELD_RST_RCVD },
+    [29] = { "QTH",              FIELD_QTH },
+    [30] = { "MY_GRIDSQUARE",    FIELD_MY_GRIDSQUARE },
+};
 
-static void write_date_time(FILE *fd, time_t time);
-static void write_freq(FILE *fd, float freq_mhz);
-static void write_band(FILE *fd, qso_log_band_t band);
-static void write_mode(FILE *fd, qso_log_mode_t mode);
+static void write_header(FILE *fd);
 
-static void copy_str(char * dst, char * src, size_t val_len, size_t dst_len);
-static char * extract_str(const char * src, size_t src_len);
+static void copy_str(char * dst, const char * src, size_t val_len, size_t dst_len);
 
 static qso_log_band_t str_to_band(const char * s);
+static int parse_digits(const char * s, size_t len);
 static qso_log_mode_t create_mode(const char * mode, const char * submode);
 
 
@@ -74,115 +126,285 @@ void adif_log_close(adif_log l) {
 
 void adif_add_qso(adif_log l, qso_log_record_t qso)
 {
-    write_str(l->fd, "STATION_CALLSIGN", qso.local_call);
-    write_str(l->fd, "OPERATOR", qso.local_call);
-    write_str(l->fd, "CALL", qso.remote_call);
-    write_date_time(l->fd, qso.time);
-    write_mode(l->fd, qso.mode);
-    write_str(l->fd, "NAME", NULL);
-    write_str(l->fd, "QTH", NULL);
-    write_int(l->fd, "RST_SENT", qso.rsts);
-    write_str(l->fd, "STX", NULL);
-    write_int(l->fd, "RST_RCVD", qso.rstr);
-    write_band(l->fd, qso.band);
-    write_freq(l->fd, qso.freq_mhz);
-    write_str(l->fd, "GRIDSQUARE", qso.remote_grid);
-    write_str(l->fd, "MY_GRIDSQUARE", qso.local_grid);
-    fprintf(l->fd, "<EOR>\r\n");
+    char buf[ADIF_QSO_MAX];
+
+    fwrite(buf, 1, adif_format_qso(buf, sizeof(buf), &qso), l->fd);
     fflush(l->fd);
 }
 
-int adif_read(const char * path, qso_log_record_t ** records) {
-    char * line = NULL;
-    size_t len = 0;
-    ssize_t read;
+void adif_write_header(FILE *fd) {
+    write_header(fd);
+}
+
+static inline uint8_t field_hash(const char *name, size_t len) {
+    return (toupper((unsigned char) name[0]) * 2 + toupper((unsigned char) name[len - 1]) * 11 + len) % FIELD_HASH_SIZE;
+}
+
+static adif_field_t field_find(const char *name, size_t len) {
+    const adif_field_def_t *def = &fields[field_hash(name, len)];
+
+    if (def->name && strlen(def->name) == len && strncasecmp(def->name, name, len) == 0) {
+        return def->field;
+    }
+    return FIELD_UNKNOWN;
+}
+
+/**
+ * Value of the ADIF field, len bytes from val, not null terminated
+ */
+static void set_field(adif_parse_t *ctx, adif_field_t field, const char *val, size_t len) {
+    qso_log_record_t    *r = &ctx->record;
+    char                num[16];
+
+    switch (field) {
+        case FIELD_OPERATOR:
+        case FIELD_STATION_CALLSIGN:
+            COPY_STR(r->local_call, val, len);
+            break;
 
-    FILE *fp = fopen(path, "r");
+        case FIELD_CALL:
+            COPY_STR(r->remote_call, val, len);
+            break;
+
+        case FIELD_QSO_DATE:
+            if (len >= 8) {
+                ctx->ts.tm_year = parse_digits(val, 4) - 1900;
+                ctx->ts.tm_mon = parse_digits(val + 4, 2) - 1;
+                ctx->ts.tm_mday = parse_digits(val + 6, 2);
+            }
+            break;
+
+        case FIELD_TIME_ON:
+            if (len >= 4) {
+                ctx->ts.tm_hour = parse_digits(val, 2);
+                ctx->ts.tm_min = parse_digits(val + 2, 2);
+                ctx->ts.tm_sec = len >= 6 ? parse_digits(val + 4, 2) : 0;
+            }
+            break;
+
+        case FIELD_MODE:
+            COPY_STR(ctx->mode, val, len);
+            break;
 
-    if (fp == NULL) {
+        case FIELD_SUBMODE:
+            COPY_STR(ctx->submode, val, len);
+            break;
+
+        case FIELD_NAME:
+            COPY_STR(r->name, val, len);
+            break;
+
+        case FIELD_QTH:
+            COPY_STR(r->qth, val, len);
+            break;
+
+        case FIELD_RST_SENT:
+            COPY_STR(num, val, len);
+            r->rsts = atoi(num);
+            break;
+
+        case FIELD_RST_RCVD:
+            COPY_STR(num, val, len);
+            r->rstr = atoi(num);
+            break;
+
+        case FIELD_BAND:
+            COPY_STR(num, val, len);
+            r->band = str_to_band(num);
+            break;
+
+        case FIELD_FREQ:
+            COPY_STR(num, val, len);
+            r->freq_mhz = strtof(num, NULL);
+            break;
+
+        case FIELD_MY_GRIDSQUARE:
+            COPY_STR(r->local_grid, val, len);
+            break;
+
+        case FIELD_GRIDSQUARE:
+            COPY_STR(r->remote_grid, val, len);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void record_reset(adif_parse_t *ctx) {
+    memset(ctx, 0, sizeof(adif_parse_t));
+}
+
+static void record_finish(adif_parse_t *ctx) {
+    qso_log_record_t *r = &ctx->record;
+
+    // Written in UTC by adif_add_qso()
+    r->time = timegm(&ctx->ts);
+    r->mode = create_mode(ctx->mode[0] ? ctx->mode : NULL, ctx->submode[0] ? ctx->submode : NULL);
+
+    if ((qso_log_freq_to_band(r->freq_mhz * MHZ) != r->band) &&
+        (qso_log_freq_to_band(r->freq_mhz * KHZ) == r->band)) {
+            r->freq_mhz /= 1000;
+    }
+}
+
+static inline bool is_name_char(char c) {
+    return isalnum((unsigned char) c) || c == '_';
+}
+
+int adif_parse(const char * path, adif_record_cb_t cb, void *user) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
         perror("Unable to open log file:");
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
         return 0;
     }
 
-    static regex_t  regex;
-    static const    char re[] = "<([A-Za-z_]+):([0-9]+)>";
-    regmatch_t      pmatch[3];
-    regoff_t        off, r_len;
-    char            *s;
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
 
-    if (regcomp(&regex, re, REG_NEWLINE | REG_EXTENDED)) {
-        printf("Can't compile regexp");
-        return -2;
+    if (data == MAP_FAILED) {
+        perror("Unable to map log file:");
+        return -1;
     }
 
-    size_t arr_size = 128;
-    *records = malloc(arr_size * sizeof(qso_log_record_t));
-
-    qso_log_record_t *cur_record;
-    ssize_t cur_record_id = 0;
-    struct tm qso_ts;
-    size_t val_len;
-
-    while ((read = getline(&line, &len, fp)) != -1) {
-        if (strcmp(line + read - 7, "<EOR>\r\n") != 0) continue;
-        s = line;
-        cur_record = &(*records)[cur_record_id];
-        char * mode = NULL;
-        char * submode = NULL;
-        for (unsigned int i = 0; ; i++) {
-            if (regexec(&regex, s, ARRAY_SIZE(pmatch), pmatch, 0))
-                break;
-            val_len = atoi(s + pmatch[2].rm_so);
-            if (val_len > 0) {
-                if (strncmp(s + pmatch[1].rm_so, "OPERATOR", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    COPY_STR(cur_record->local_call, s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "CALL", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    COPY_STR(cur_record->remote_call, s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "QSO_DATE", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    strptime(s + pmatch[0].rm_eo, "%Y%m%d", &qso_ts);
-                } else if (strncmp(s + pmatch[1].rm_so, "TIME_ON", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    strptime(s + pmatch[0].rm_eo, "%H%M", &qso_ts);
-                } else if (strncmp(s + pmatch[1].rm_so, "MODE", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    mode = extract_str(s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "SUBMODE", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    submode = extract_str(s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "NAME", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    COPY_STR(cur_record->name, s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "QTH", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    COPY_STR(cur_record->qth, s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "RST_SENT", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    cur_record->rsts = atoi(s + pmatch[0].rm_eo);
-                } else if (strncmp(s + pmatch[1].rm_so, "RST_RCVD", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    cur_record->rstr = atoi(s + pmatch[0].rm_eo);
-                } else if (strncmp(s + pmatch[1].rm_so, "BAND", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    cur_record->band = str_to_band(s + pmatch[0].rm_eo);
-                } else if (strncmp(s + pmatch[1].rm_so, "FREQ", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    cur_record->freq_mhz = strtof(s + pmatch[0].rm_eo, NULL);
-                } else if (strncmp(s + pmatch[1].rm_so, "MY_GRIDSQUARE", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    COPY_STR(cur_record->local_grid, s + pmatch[0].rm_eo, val_len);
-                } else if (strncmp(s + pmatch[1].rm_so, "GRIDSQUARE", pmatch[1].rm_eo - pmatch[1].rm_so) == 0) {
-                    COPY_STR(cur_record->remote_grid, s + pmatch[0].rm_eo, val_len);
+    madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+
+    const char      *p = data;
+    const char      *end = data + st.st_size;
+    int             count = 0;
+    adif_parse_t    ctx;
+
+    record_reset(&ctx);
+
+    /*
+     * Tokens are <NAME:LEN[:TYPE]>VALUE, <EOR> and <EOH>. Line breaks and any other text
+     * between them are ignored, so records may span lines
+     */
+    while (p < end) {
+        const char *tag = memchr(p, '<', end - p);
+
+        if (!tag) {
+            break;
+        }
+
+        const char *name = tag + 1;
+        const char *q = name;
+
+        while (q < end && is_name_char(*q)) {
+            q++;
+        }
+
+        if (q >= end) {
+            break;
+        }
+
+        size_t name_len = q - name;
+
+        if (*q == '>') {
+            p = q + 1;
+
+            if (name_len == 3 && strncasecmp(name, "EOR", 3) == 0) {
+                record_finish(&ctx);
+                count++;
+
+                if (!cb(&ctx.record, user)) {
+                    break;
                 }
+                record_reset(&ctx);
+            } else if (name_len == 3 && strncasecmp(name, "EOH", 3) == 0) {
+                record_reset(&ctx);
             }
+            continue;
+        }
 
-            s += pmatch[0].rm_eo;
+        if (*q != ':' || name_len == 0) {
+            p = name;
+            continue;
         }
 
-        cur_record->time = mktime(&qso_ts);
-        cur_record->mode = create_mode(mode, submode);
-        if (mode) free(mode);
-        if (submode) free(submode);
-        if ((qso_log_freq_to_band(cur_record->freq_mhz * MHZ) != cur_record->band) &&
-            (qso_log_freq_to_band(cur_record->freq_mhz * KHZ) == cur_record->band)) {
-                cur_record->freq_mhz /= 1000;
+        size_t len = 0;
+
+        for (q++; q < end && isdigit((unsigned char) *q); q++) {
+            len = len * 10 + (*q - '0');
         }
-        cur_record_id++;
-        if (cur_record_id >= arr_size) {
-            arr_size *= 2;
-            (*records) = realloc((*records), arr_size * sizeof(qso_log_record_t));
+
+        // Optional data type indicator
+        if (q < end && *q == ':') {
+            for (q++; q < end && isalpha((unsigned char) *q); q++) {
+            }
         }
+
+        if (q >= end || *q != '>') {
+            p = name;
+            continue;
+        }
+
+        const char *val = q + 1;
+
+        if (len > end - val) {
+            len = end - val;
+        }
+
+        if (len > 0) {
+            set_field(&ctx, field_find(name, name_len), val, len);
+        }
+
+        p = val + len;
+    }
+
+    munmap((void *) data, st.st_size);
+
+    return count;
+}
+
+typedef struct {
+    qso_log_record_t    *records;
+    size_t              size;
+    size_t              count;
+} adif_array_t;
+
+static bool append_record(const qso_log_record_t *record, void *user) {
+    adif_array_t *arr = (adif_array_t *) user;
+
+    if (arr->count >= arr->size) {
+        size_t              size = arr->size ? arr->size * 2 : 128;
+        qso_log_record_t    *records = realloc(arr->records, size * sizeof(qso_log_record_t));
+
+        if (!records) {
+            return false;
+        }
+        arr->records = records;
+        arr->size = size;
+    }
+
+    arr->records[arr->count++] = *record;
+    return true;
+}
+
+int adif_read(const char * path, qso_log_record_t ** records) {
+    adif_array_t arr = { 0 };
+
+    if (adif_parse(path, append_record, &arr) < 0) {
+        *records = NULL;
+        return 0;
     }
-    return cur_record_id--;
+
+    *records = arr.records;
+    return arr.count;
 }
 
 static void write_header(FILE *fd) {
@@ -192,52 +414,104 @@ static void write_header(FILE *fd) {
     fprintf(fd, "<EOH>\r\n");
 }
 
-static void write_str(FILE *fd, const char * key, const char * val) {
-    if (val == NULL) {
-        fprintf(fd, "<%s:0>", key);
-    } else {
-        size_t l = strlen(val);
-        fprintf(fd, "<%s:%i>%s", key, l, val);
+static char * put_str(char *p, const char *val, size_t len) {
+    memcpy(p, val, len);
+    return p + len;
+}
+
+/**
+ * Decimal digits, zero padded to width
+ */
+static char * put_uint(char *p, uint32_t val, int width) {
+    char    tmp[10];
+    int     n = 0;
+
+    do {
+        tmp[n++] = '0' + val % 10;
+        val /= 10;
+    } while (val && n < sizeof(tmp));
+
+    while (width-- > n) {
+        *p++ = '0';
+    }
+    while (n) {
+        *p++ = tmp[--n];
     }
+    return p;
 }
 
-static void write_int(FILE *fd, const char * key, int val) {
-    char str_val[8];
-    sprintf(str_val, "%i", val);
-    write_str(fd, key, str_val);
+static char * put_field(char *p, const char *key, const char *val, size_t len) {
+    *p++ = '<';
+    p = put_str(p, key, strlen(key));
+    *p++ = ':';
+    p = put_uint(p, len, 0);
+    *p++ = '>';
+    return put_str(p, val, len);
 }
 
-static void write_date_time(FILE *fd, time_t time) {
-    struct tm *ts = gmtime(&time);
-    fprintf(fd, "<QSO_DATE:8>%04i%02i%02i", ts->tm_year + 1900, ts->tm_mon + 1, ts->tm_mday);
-    fprintf(fd, "<QSO_DATE_OFF:8>%04i%02i%02i", ts->tm_year + 1900, ts->tm_mon + 1, ts->tm_mday);
-    fprintf(fd, "<TIME_ON:4>%02i%02i", ts->tm_hour, ts->tm_min);
-    fprintf(fd, "<TIME_OFF:4>%02i%02i", ts->tm_hour, ts->tm_min);
+static char * put_text(char *p, const char *key, const char *val) {
+    return put_field(p, key, val, val ? strlen(val) : 0);
 }
 
-static void write_freq(FILE *fd, float freq_mhz) {
-    char str_freq[8];
-    sprintf(str_freq, "%0.4f", freq_mhz);
-    write_str(fd, "FREQ", str_freq);
+static char * put_int(char *p, const char *key, int val) {
+    char    str[12];
+    char    *end = str;
+
+    if (val < 0) {
+        *end++ = '-';
+        val = -val;
+    }
+    end = put_uint(end, val, 0);
+
+    return put_field(p, key, str, end - str);
 }
 
-static void write_band(FILE *fd, qso_log_band_t band) {
-    if (band == BAND_OTHER) {
-        write_str(fd, "BAND", "");
-    } else {
-        char str_band[8];
-        sprintf(str_band, "%dM", band);
-        write_str(fd, "BAND", str_band);
+static char * put_date_time(char *p, time_t time) {
+    struct tm   ts;
+    char        date[8];
+    char        hm[4];
+
+    gmtime_r(&time, &ts);
+
+    put_uint(put_uint(put_uint(date, ts.tm_year + 1900, 4), ts.tm_mon + 1, 2), ts.tm_mday, 2);
+    put_uint(put_uint(hm, ts.tm_hour, 2), ts.tm_min, 2);
+
+    p = put_field(p, "QSO_DATE", date, sizeof(date));
+    p = put_field(p, "QSO_DATE_OFF", date, sizeof(date));
+    p = put_field(p, "TIME_ON", hm, sizeof(hm));
+    return put_field(p, "TIME_OFF", hm, sizeof(hm));
+}
+
+static char * put_freq(char *p, float freq_mhz) {
+    char        str[16];
+    uint32_t    x = freq_mhz > 0 ? (uint32_t) (freq_mhz * 10000.0f + 0.5f) : 0;
+    char        *end = put_uint(str, x / 10000, 0);
+
+    *end++ = '.';
+    end = put_uint(end, x % 10000, 4);
+
+    return put_field(p, "FREQ", str, end - str);
+}
+
+static char * put_band(char *p, qso_log_band_t band) {
+    char    str[8];
+    char    *end = str;
+
+    if (band != BAND_OTHER) {
+        end = put_uint(end, band, 0);
+        *end++ = 'M';
     }
+    return put_field(p, "BAND", str, end - str);
 }
 
-static void write_mode(FILE *fd, qso_log_mode_t mode) {
-    char * mode_str;
-    char * submode_str = NULL;
+static char * put_mode(char *p, qso_log_mode_t mode) {
+    const char *mode_str = "";
+    const char *submode_str = NULL;
+
     switch (mode) {
         case MODE_SSB:
             mode_str = "SSB";
-            // submode_str = "USB";
+            break;
         case MODE_AM:
             mode_str = "AM";
             break;
@@ -246,7 +520,6 @@ static void write_mode(FILE *fd, qso_log_mode_t mode) {
             break;
         case MODE_CW:
             mode_str = "CW";
-            // submode_str = "PCW";
             break;
         case MODE_FT8:
             mode_str = "FT8";
@@ -258,13 +531,41 @@ static void write_mode(FILE *fd, qso_log_mode_t mode) {
         case MODE_RTTY:
             mode_str = "RTTY";
             break;
+        default:
+            break;
+    }
+    p = put_text(p, "MODE", mode_str);
+    return put_text(p, "SUBMODE", submode_str);
+}
+
+size_t adif_format_qso(char *buf, size_t size, const qso_log_record_t *qso) {
+    if (size < ADIF_QSO_MAX) {
+        return 0;
     }
-    write_str(fd, "MODE", mode_str);
-    write_str(fd, "SUBMODE", submode_str);
+
+    char *p = buf;
+
+    p = put_text(p, "STATION_CALLSIGN", qso->local_call);
+    p = put_text(p, "OPERATOR", qso->local_call);
+    p = put_text(p, "CALL", qso->remote_call);
+    p = put_date_time(p, qso->time);
+    p = put_mode(p, qso->mode);
+    p = put_text(p, "NAME", qso->name);
+    p = put_text(p, "QTH", qso->qth);
+    p = put_int(p, "RST_SENT", qso->rsts);
+    p = put_text(p, "STX", NULL);
+    p = put_int(p, "RST_RCVD", qso->rstr);
+    p = put_band(p, qso->band);
+    p = put_freq(p, qso->freq_mhz);
+    p = put_text(p, "GRIDSQUARE", qso->remote_grid);
+    p = put_text(p, "MY_GRIDSQUARE", qso->local_grid);
+    p = put_str(p, "<EOR>\r\n", 7);
+
+    return p - buf;
 }
 
 
-static void copy_str(char * dst, char * src, size_t val_len, size_t dst_len) {
+static void copy_str(char * dst, const char * src, size_t val_len, size_t dst_len) {
     if (val_len > (dst_len - 1)) {
         val_len = dst_len - 1;
     }
@@ -272,12 +573,13 @@ static void copy_str(char * dst, char * src, size_t val_len, size_t dst_len) {
     dst[val_len] = 0;
 }
 
-static char * extract_str(const char * src, size_t src_len) {
-    char * dst;
-    dst = malloc(src_len + 1);
-    memcpy(dst, src, src_len);
-    dst[src_len] = 0;
-    return dst;
+static int parse_digits(const char * s, size_t len) {
+    int res = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        res = res * 10 + (s[i] - '0');
+    }
+    return res;
 }
 
 static qso_log_band_t str_to_band(const char * s) {
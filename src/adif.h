@@ -10,6 +10,11 @@
 #include "qso_log.h"
 
 #include <time.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Buffer size, enough for any record */
+#define ADIF_QSO_MAX 512
 
 typedef struct adif_log_s *adif_log;
 
@@ -19,4 +24,21 @@ void adif_log_close(adif_log l);
 
 void adif_add_qso(adif_log l, qso_log_record_t qso);
 
+void adif_write_header(FILE *fd);
+
+/**
+ * Format QSO as an ADIF record into buf of at least ADIF_QSO_MAX bytes. Returns the length
+ */
+size_t adif_format_qso(char *buf, size_t size, const qso_log_record_t *qso);
+
+/**
+ * Called for each parsed record, return false to stop
+ */
+typedef bool (*adif_record_cb_t)(const qso_log_record_t *record, void *user);
+
+/**
+ * Stream records of the ADIF file to the callback. Returns number of records or -1
+ */
+int adif_parse(const char * path, adif_record_cb_t cb, void *user);
+
 int adif_read(const char * path, qso_log_record_t ** records);
@@ -14,170 +14,146 @@
 #include <string.h>
 #include <math.h>
 
-#include <pulse/pulseaudio.h>
 #include <alsa/asoundlib.h>
 #include <alsa/mixer.h>
 
 #include "lvgl/lvgl.h"
-#include "audio.h"
-#include "meter.h"
-#include "dsp.h"
+#include "audio.private.h"
 #include "params/params.h"
 
-#define AUDIO_RATE_MS   100
+/* Opened once, volume setters write the cached elements. Setters are called from several threads */
 
-static pa_threaded_mainloop *mloop;
-static pa_mainloop_api      *mlapi;
-static pa_context           *ctx;
+static snd_mixer_t          *mixer = NULL;
+static snd_mixer_elem_t     *play_vol_elem = NULL;
+static snd_mixer_elem_t     *rec_vol_elem = NULL;
+static pthread_mutex_t      mixer_mux = PTHREAD_MUTEX_INITIALIZER;
 
-static pa_stream            *play_stm;
-static char                 *play_device = "alsa_output.platform-sound.stereo-fallback";
+/* Play path is on for prompts and voice messages (play_en) or for the sub receiver */
 
-static pa_stream            *capture_stm;
-static char                 *capture_device = "alsa_input.platform-sound.stereo-fallback";
+static pthread_mutex_t      play_en_mux = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool        play_en = false;
+static volatile bool        play_monitor = false;
 
-static pa_stream            *monitor_stm = NULL;
+size_t audio_ring_put(audio_ring_t *ring, const int16_t *samples, size_t n) {
+    size_t room = AUDIO_PLAY_RING - ring->count;
 
-static float                peak_db = -60.0f;
-
-static void record_monitor_setup();
+    if (n > room) {
+        n = room;
+    }
 
-static void on_state_change(pa_context *c, void *userdata) {
-    pa_threaded_mainloop_signal(mloop, 0);
-}
+    size_t tail = (ring->head + ring->count) % AUDIO_PLAY_RING;
+    size_t part = LV_MIN(n, AUDIO_PLAY_RING - tail);
 
-static void read_callback(pa_stream *s, size_t nbytes, void *udata) {
-    int16_t *buf = NULL;
+    memcpy(&ring->buf[tail], samples, part * sizeof(int16_t));
+    memcpy(ring->buf, samples + part, (n - part) * sizeof(int16_t));
+    ring->count += n;
 
-    pa_stream_peek(s, (const void**) &buf, &nbytes);
-    dsp_put_audio_samples(nbytes / 2, buf);
-    pa_stream_drop(s);
+    return n;
 }
 
-static void mixer_setup() {
-    int res;
-    // overall level
-    res = system("amixer sset 'Headphone',0 58,58");
-    // Play level from app to radio (for FT8)
-    res = system("amixer sset 'AIF1 DA0',0 160,160");
-
-    // capture audio from radio
-    res = system("amixer sset 'Mic1',0 0,0 cap");
-    // mic boost
-    res = system("amixer sset 'Mic1 Boost',0 1");
-    // disable capturing from mixer
-    res = system("amixer sset 'Mixer',0 nocap");
-    res = system("amixer sset 'ADC Gain',0 3");
-    res = system("amixer sset 'AIF1 AD0',0 160,160");
-    res = system("amixer sset 'AIF1 AD0 Stereo',0 'Mix Mono'");
-    res = system("amixer sset 'AIF1 Data Digital ADC',0 cap");
-
-    audio_set_rec_vol(0.0f);
-    audio_set_play_vol(0.0f);
-}
-
-void audio_init() {
-    mixer_setup();
-    mloop = pa_threaded_mainloop_new();
-    pa_threaded_mainloop_start(mloop);
+static snd_mixer_elem_t * mixer_elem(const char *name) {
+    snd_mixer_selem_id_t *sid;
 
-    mlapi = pa_threaded_mainloop_get_api(mloop);
-    ctx = pa_context_new(mlapi, "X6100 GUI");
+    snd_mixer_selem_id_alloca(&sid);
+    snd_mixer_selem_id_set_index(sid, 0);
+    snd_mixer_selem_id_set_name(sid, name);
 
-    pa_threaded_mainloop_lock(mloop);
-    pa_context_set_state_callback(ctx, on_state_change, NULL);
-    pa_context_connect(ctx, NULL, 0, NULL);
-    pa_threaded_mainloop_unlock(mloop);
+    snd_mixer_elem_t *elem = snd_mixer_find_selem(mixer, sid);
 
-    while (PA_CONTEXT_READY != pa_context_get_state(ctx))  {
-        pa_threaded_mainloop_wait(mloop);
+    if (!elem) {
+        LV_LOG_ERROR("Mixer element %s not found", name);
     }
 
-    LV_LOG_USER("Conected");
-
-    pa_buffer_attr  attr;
-
-    pa_sample_spec  spec = {
-        .format = PA_SAMPLE_S16NE,
-        .channels = 1
-    };
-
-    memset(&attr, 0xff, sizeof(attr));
-
-    /* Play */
-
-    spec.rate = AUDIO_PLAY_RATE,
-    attr.fragsize = pa_usec_to_bytes(AUDIO_RATE_MS * PA_USEC_PER_MSEC, &spec);
-    attr.tlength = attr.fragsize * 8;
-
-    play_stm = pa_stream_new(ctx, "X6100 GUI Play", &spec, NULL);
-
-    pa_threaded_mainloop_lock(mloop);
-    pa_stream_connect_playback(play_stm, play_device, &attr, PA_STREAM_ADJUST_LATENCY, NULL, NULL);
-    pa_threaded_mainloop_unlock(mloop);
-
-    /* Capture */
-
-    spec.rate = AUDIO_CAPTURE_RATE,
-    attr.fragsize = attr.tlength = pa_usec_to_bytes(AUDIO_RATE_MS * PA_USEC_PER_MSEC, &spec);
+    return elem;
+}
 
-    capture_stm = pa_stream_new(ctx, "X6100 GUI Capture", &spec, NULL);
+/**
+ * Raw volume of all channels, playback and capture ones (as amixer sset does)
+ */
+static void mixer_volume(const char *name, long val) {
+    snd_mixer_elem_t *elem = mixer_elem(name);
 
-    pa_threaded_mainloop_lock(mloop);
-    pa_stream_set_read_callback(capture_stm, read_callback, NULL);
-    pa_stream_connect_record(capture_stm, capture_device, &attr, PA_STREAM_ADJUST_LATENCY);
-    pa_threaded_mainloop_unlock(mloop);
+    if (!elem) {
+        return;
+    }
 
-    record_monitor_setup();
+    if (snd_mixer_selem_has_playback_volume(elem)) {
+        snd_mixer_selem_set_playback_volume_all(elem, val);
+    }
+    if (snd_mixer_selem_has_capture_volume(elem)) {
+        snd_mixer_selem_set_capture_volume_all(elem, val);
+    }
 }
 
-int audio_play(int16_t *samples_buf, size_t samples) {
-    while (true) {
-        size_t size;
+static void mixer_capture(const char *name, bool on) {
+    snd_mixer_elem_t *elem = mixer_elem(name);
 
-        pa_threaded_mainloop_lock(mloop);
-        size = pa_stream_writable_size(play_stm);
-        pa_threaded_mainloop_unlock(mloop);
+    if (elem) {
+        snd_mixer_selem_set_capture_switch_all(elem, on);
+    }
+}
 
-        if (size >= (samples * 2)) {
-            break;
-        }
+static void mixer_enum(const char *name, const char *item) {
+    snd_mixer_elem_t    *elem = mixer_elem(name);
+    char                str[64];
 
-        usleep(1000);
+    if (!elem) {
+        return;
     }
 
-    pa_threaded_mainloop_lock(mloop);
-    int res = pa_stream_write(play_stm, samples_buf, samples * 2, NULL, 0, PA_SEEK_RELATIVE);
-    pa_threaded_mainloop_unlock(mloop);
+    int items = snd_mixer_selem_get_enum_items(elem);
 
-    if (res < 0) {
-        LV_LOG_ERROR("pa_stream_write() failed: %s", pa_strerror(pa_context_errno(ctx)));
+    for (int i = 0; i < items; i++) {
+        if (snd_mixer_selem_get_enum_item_name(elem, i, sizeof(str), str) == 0 && strcmp(str, item) == 0) {
+            for (int chn = 0; chn <= SND_MIXER_SCHN_LAST; chn++) {
+                if (snd_mixer_selem_set_enum_item(elem, chn, i) < 0) {
+                    break;
+                }
+            }
+            return;
+        }
     }
 
-    return res;
+    LV_LOG_ERROR("Mixer element %s has no item %s", name, item);
 }
 
-void audio_play_wait() {
-    pa_operation *op;
-    int r;
+static void mixer_setup() {
+    if (snd_mixer_open(&mixer, 0) < 0 ||
+        snd_mixer_attach(mixer, "default") < 0 ||
+        snd_mixer_selem_register(mixer, NULL, NULL) < 0 ||
+        snd_mixer_load(mixer) < 0)
+    {
+        LV_LOG_ERROR("Can't open mixer");
+        return;
+    }
 
-    pa_threaded_mainloop_lock(mloop);
-    op = pa_stream_drain(play_stm, NULL, NULL);
-    pa_threaded_mainloop_unlock(mloop);
+    // overall level
+    mixer_volume("Headphone", 58);
+    // Play level from app to radio (for FT8)
+    mixer_volume("AIF1 DA0", 160);
 
-    while (true) {
-        pa_threaded_mainloop_lock(mloop);
-        r = pa_operation_get_state(op);
-        pa_threaded_mainloop_unlock(mloop);
+    // capture audio from radio
+    mixer_volume("Mic1", 0);
+    mixer_capture("Mic1", true);
+    // mic boost
+    mixer_volume("Mic1 Boost", 1);
+    // disable capturing from mixer
+    mixer_capture("Mixer", false);
+    mixer_volume("ADC Gain", 3);
+    mixer_volume("AIF1 AD0", 160);
+    mixer_enum("AIF1 AD0 Stereo", "Mix Mono");
+    mixer_capture("AIF1 Data Digital ADC", true);
 
-        if (r == PA_OPERATION_DONE || r == PA_OPERATION_CANCELLED) {
-            break;
-        }
+    play_vol_elem = mixer_elem("AIF1 DA0");
+    rec_vol_elem = mixer_elem("ADC");
 
-        usleep(1000);
-    }
+    audio_set_rec_vol(0.0f);
+    audio_set_play_vol(0.0f);
+}
 
-    pa_operation_unref(op);
+void audio_init() {
+    mixer_setup();
+    audio_backend_init();
 }
 
 void audio_gain_db(int16_t *buf, size_t samples, float gain, int16_t *out) {
@@ -218,7 +194,7 @@ void audio_gain_db_transition(int16_t *buf, size_t samples, float gain1, float g
     }
 }
 
-void audio_play_en(bool on) {
+static void play_path_set(bool on) {
     if (on) {
         x6100_control_hmic_set(0);
         x6100_control_imic_set(0);
@@ -230,86 +206,59 @@ void audio_play_en(bool on) {
     }
 }
 
-float audio_set_play_vol(float db) {
-    snd_mixer_t *handle;
-    snd_mixer_selem_id_t *sid;
-    const char *card = "default";
-    const char *selem_name = "AIF1 DA0";
-
-    snd_mixer_open(&handle, 0);
-    snd_mixer_attach(handle, card);
-    snd_mixer_selem_register(handle, NULL, NULL);
-    snd_mixer_load(handle);
+void audio_play_en(bool on) {
+    pthread_mutex_lock(&play_en_mux);
+    play_en = on;
 
-    snd_mixer_selem_id_alloca(&sid);
-    snd_mixer_selem_id_set_index(sid, 0);
-    snd_mixer_selem_id_set_name(sid, selem_name);
-    snd_mixer_elem_t* elem = snd_mixer_find_selem(handle, sid);
-
-    snd_mixer_selem_set_playback_dB_all(elem, (long)(db * 100.0f), 0);
-    long db_long;
-    snd_mixer_selem_get_playback_dB(elem, SND_MIXER_SCHN_MONO, &db_long);
-    snd_mixer_close(handle);
-    return (float)db_long / 100.0f;
+    if (!play_monitor) {
+        play_path_set(on);
+    }
+    pthread_mutex_unlock(&play_en_mux);
 }
 
-float audio_set_rec_vol(float db) {
-    snd_mixer_t *handle;
-    snd_mixer_selem_id_t *sid;
-    const char *card = "default";
-    const char *selem_name = "ADC";
-
-    snd_mixer_open(&handle, 0);
-    snd_mixer_attach(handle, card);
-    snd_mixer_selem_register(handle, NULL, NULL);
-    snd_mixer_load(handle);
+void audio_play_monitor(bool on) {
+    pthread_mutex_lock(&play_en_mux);
 
-    snd_mixer_selem_id_alloca(&sid);
-    snd_mixer_selem_id_set_index(sid, 0);
-    snd_mixer_selem_id_set_name(sid, selem_name);
-    snd_mixer_elem_t* elem = snd_mixer_find_selem(handle, sid);
+    if (on != play_monitor) {
+        play_monitor = on;
 
-    snd_mixer_selem_set_capture_dB_all(elem, (long)(db * 100.0f), 0);
-    long db_long;
-    snd_mixer_selem_get_capture_dB(elem, SND_MIXER_SCHN_MONO, &db_long);
-    snd_mixer_close(handle);
-    return (float) db_long / 100.0f;
+        if (!play_en) {
+            play_path_set(on);
+        }
+    }
+    pthread_mutex_unlock(&play_en_mux);
 }
 
-float audio_get_peak_db() {
-    return peak_db;
+bool audio_play_monitor_ready() {
+    return play_monitor && !play_en;
 }
 
-static void monitor_cb(pa_stream *stream, size_t length, void *udata) {
-    int16_t *buf = NULL;
+float audio_set_play_vol(float db) {
+    long db_long = 0;
 
-    pa_stream_peek(stream, (const void**) &buf, &length);
-    int16_t max_val = 1;
-    int16_t cur_val;
-    for (size_t i=0; i < length / 2; i++) {
-        cur_val = buf[i];
-        if (cur_val > max_val) {
-            max_val = cur_val;
-        }
+    if (!play_vol_elem) {
+        return 0.0f;
     }
-    peak_db = 20.0f * log10f((float) max_val / ((1UL << 15) - 1));
-    pa_stream_drop(stream);
-}
 
+    pthread_mutex_lock(&mixer_mux);
+    snd_mixer_selem_set_playback_dB_all(play_vol_elem, (long)(db * 100.0f), 0);
+    snd_mixer_selem_get_playback_dB(play_vol_elem, SND_MIXER_SCHN_MONO, &db_long);
+    pthread_mutex_unlock(&mixer_mux);
 
-static void record_monitor_setup() {
+    return (float) db_long / 100.0f;
+}
 
-    pa_sample_spec  spec = {
-        .format = PA_SAMPLE_S16NE,
-        .channels = 1
-    };
+float audio_set_rec_vol(float db) {
+    long db_long = 0;
 
-    spec.rate = 30;
+    if (!rec_vol_elem) {
+        return 0.0f;
+    }
 
-    monitor_stm = pa_stream_new(ctx, "X6100 GUI Monitor", &spec, NULL);
+    pthread_mutex_lock(&mixer_mux);
+    snd_mixer_selem_set_capture_dB_all(rec_vol_elem, (long)(db * 100.0f), 0);
+    snd_mixer_selem_get_capture_dB(rec_vol_elem, SND_MIXER_SCHN_MONO, &db_long);
+    pthread_mutex_unlock(&mixer_mux);
 
-    pa_threaded_mainloop_lock(mloop);
-    pa_stream_set_read_callback(monitor_stm, monitor_cb, NULL);
-    pa_stream_connect_record(monitor_stm, capture_device, NULL, PA_STREAM_PEAK_DETECT);
-    pa_threaded_mainloop_unlock(mloop);
+    return (float) db_long / 100.0f;
 }
@@ -10,15 +10,50 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define AUDIO_PLAY_RATE     (44100)
 #define AUDIO_CAPTURE_RATE  (44100)
+#define AUDIO_RATE_MS       (100)
+#define AUDIO_LOW_LATENCY_MS (10)
+
+/* Max samples in capture fragment */
+#define AUDIO_CAPTURE_FRAGMENT  (AUDIO_CAPTURE_RATE * AUDIO_RATE_MS / 1000)
+
+/* Play ring capacity per priority, samples */
+#define AUDIO_PLAY_RING     (AUDIO_PLAY_RATE / 2)
+
+/* Play priorities, the highest first. A lower priority holds while a higher one plays */
+typedef enum {
+    AUDIO_PLAY_TX = 0,
+    AUDIO_PLAY_PROMPT,
+    AUDIO_PLAY_MONITOR,     /* Sub receiver, see audio_play_monitor() */
+
+    AUDIO_PLAY_PRIOS
+} audio_play_prio_t;
 
 void audio_init();
+void audio_profile_init();
+
+/* Put samples to the play ring without blocking. Returns the number of samples taken */
+size_t audio_play_write(audio_play_prio_t prio, const int16_t *buf, size_t samples);
+
+/* Drop samples of the play ring, which are not passed to the stream yet */
+void audio_play_drop(audio_play_prio_t prio);
+
+/* Put all samples to the play ring, waiting for room if it is full */
+int audio_play_prio(audio_play_prio_t prio, const int16_t *buf, size_t samples);
 int audio_play(int16_t *buf, size_t samples);
 void audio_play_wait();
 void audio_play_en(bool on);
 
+/*
+ * Keep the play path on for the sub receiver, between prompts and voice messages too.
+ * Monitor samples are welcome only while audio_play_monitor_ready()
+ */
+void audio_play_monitor(bool on);
+bool audio_play_monitor_ready();
+
 void audio_gain_db(int16_t *buf, size_t samples, float gain, int16_t *out);
 void audio_gain_db_transition(int16_t *buf, size_t samples, float gain1, float gain2, int16_t *out);
 
@@ -26,3 +61,8 @@ float audio_set_play_vol(float db);
 float audio_set_rec_vol(float db);
 
 float audio_get_peak_db();
+
+/* Measured latency of the streams, us, 0 - unknown */
+
+uint32_t audio_get_play_latency();
+uint32_t audio_get_capture_latency();
@@ -0,0 +1,32 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#pragma once
+
+/*
+ * Shared by the audio backends: PulseAudio (audio_pulse.c) or direct ALSA (audio_alsa.c),
+ * selected with the AUDIO_BACKEND cmake option
+ */
+
+#include "audio.h"
+
+typedef struct {
+    int16_t     buf[AUDIO_PLAY_RING];
+    size_t      head;
+    size_t      count;
+} audio_ring_t;
+
+/**
+ * Put samples to the ring, as much as fits. Returns the number of samples taken
+ */
+size_t audio_ring_put(audio_ring_t *ring, const int16_t *samples, size_t n);
+
+/**
+ * Open the streams of the backend, the mixer is already set up
+ */
+void audio_backend_init();
@@ -0,0 +1,408 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+/*
+ * Direct ALSA backend: play and capture PCMs of the codec in mmap mode, served by
+ * one real-time I/O thread. No resampling or mixing by a sound server
+ */
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <math.h>
+#include <poll.h>
+
+#include <alsa/asoundlib.h>
+
+#include "lvgl/lvgl.h"
+#include "audio.private.h"
+#include "dsp.h"
+#include "util.h"
+#include "cfg/cfg.h"
+
+#define ALSA_DEVICE     "hw:0,0"
+#define ALSA_CHANNELS   2
+#define ALSA_MAX_FDS    8
+
+static snd_pcm_t            *play_pcm = NULL;
+static snd_pcm_t            *capture_pcm = NULL;
+
+static pthread_t            io_thread;
+static volatile bool        io_run = false;
+
+static float                peak_db = -60.0f;
+
+static bool                 low_latency = false;
+static volatile uint32_t    play_latency = 0;
+static volatile uint32_t    capture_latency = 0;
+
+static int16_t              capture_buf[AUDIO_CAPTURE_FRAGMENT];
+
+/* Play rings, one per priority */
+
+static audio_ring_t         play_ring[AUDIO_PLAY_PRIOS];
+static pthread_mutex_t      play_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       play_cond = PTHREAD_COND_INITIALIZER;
+
+static int pcm_setup(snd_pcm_t *pcm, unsigned int rate, snd_pcm_uframes_t period, unsigned int periods) {
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_sw_params_t *sw;
+    int                 err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_hw_params_any(pcm, hw);
+
+    if ((err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, hw, ALSA_CHANNELS)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_periods_near(pcm, hw, &periods, NULL)) < 0 ||
+        (err = snd_pcm_hw_params(pcm, hw)) < 0)
+    {
+        return err;
+    }
+
+    snd_pcm_sw_params_alloca(&sw);
+    snd_pcm_sw_params_current(pcm, sw);
+    snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+    snd_pcm_sw_params_set_start_threshold(pcm, sw, period);
+
+    return snd_pcm_sw_params(pcm, sw);
+}
+
+static snd_pcm_t * pcm_open(snd_pcm_stream_t stream, unsigned int rate, uint32_t fragment_ms) {
+    snd_pcm_t   *pcm;
+    int         err;
+
+    err = snd_pcm_open(&pcm, ALSA_DEVICE, stream, SND_PCM_NONBLOCK);
+
+    if (err < 0) {
+        LV_LOG_ERROR("Can't open %s: %s", ALSA_DEVICE, snd_strerror(err));
+        return NULL;
+    }
+
+    err = pcm_setup(pcm, rate, rate * fragment_ms / 1000, low_latency ? 4 : 8);
+
+    if (err < 0) {
+        LV_LOG_ERROR("Can't setup %s: %s", ALSA_DEVICE, snd_strerror(err));
+        snd_pcm_close(pcm);
+        return NULL;
+    }
+
+    return pcm;
+}
+
+static inline int16_t * mmap_ptr(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset) {
+    return (int16_t *) ((uint8_t *) areas[0].addr + areas[0].first / 8) + offset * ALSA_CHANNELS;
+}
+
+/**
+ * Take samples of the highest priority ring with data, the rest of frames is silence
+ */
+static void play_ring_get(int16_t *out, snd_pcm_uframes_t frames) {
+    pthread_mutex_lock(&play_mux);
+
+    for (int i = 0; i < AUDIO_PLAY_PRIOS && frames > 0; i++) {
+        audio_ring_t *ring = &play_ring[i];
+
+        while (ring->count > 0 && frames > 0) {
+            int16_t x = ring->buf[ring->head];
+
+            *out++ = x;
+            *out++ = x;
+            ring->head = (ring->head + 1) % AUDIO_PLAY_RING;
+            ring->count--;
+            frames--;
+        }
+
+        if (ring->count > 0) {
+            break;
+        }
+    }
+
+    pthread_cond_broadcast(&play_cond);
+    pthread_mutex_unlock(&play_mux);
+
+    memset(out, 0, frames * ALSA_CHANNELS * sizeof(int16_t));
+}
+
+static int play_write() {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(play_pcm);
+    snd_pcm_sframes_t delay;
+
+    if (avail < 0) {
+        return avail;
+    }
+
+    while (avail > 0) {
+        const snd_pcm_channel_area_t    *areas;
+        snd_pcm_uframes_t               offset;
+        snd_pcm_uframes_t               frames = avail;
+        snd_pcm_sframes_t               res;
+
+        res = snd_pcm_mmap_begin(play_pcm, &areas, &offset, &frames);
+
+        if (res < 0) {
+            return res;
+        }
+
+        play_ring_get(mmap_ptr(areas, offset), frames);
+        res = snd_pcm_mmap_commit(play_pcm, offset, frames);
+
+        if (res < 0) {
+            return res;
+        }
+        if (res != frames) {
+            return -EPIPE;
+        }
+
+        avail -= frames;
+    }
+
+    if (snd_pcm_delay(play_pcm, &delay) == 0 && delay > 0) {
+        play_latency = (uint64_t) delay * 1000000 / AUDIO_PLAY_RATE;
+    }
+
+    return 0;
+}
+
+static int capture_read() {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(capture_pcm);
+
+    if (avail < 0) {
+        return avail;
+    }
+
+    // Age of the oldest unread sample
+    capture_latency = (uint64_t) avail * 1000000 / AUDIO_CAPTURE_RATE;
+
+    while (avail > 0) {
+        const snd_pcm_channel_area_t    *areas;
+        snd_pcm_uframes_t               offset;
+        snd_pcm_uframes_t               frames = LV_MIN(avail, AUDIO_CAPTURE_FRAGMENT);
+        snd_pcm_sframes_t               res;
+        int16_t                         max_val = 1;
+
+        res = snd_pcm_mmap_begin(capture_pcm, &areas, &offset, &frames);
+
+        if (res < 0) {
+            return res;
+        }
+
+        // Channels are the same mono mix, take the left one
+        int16_t *in = mmap_ptr(areas, offset);
+
+        for (snd_pcm_uframes_t i = 0; i < frames; i++) {
+            int16_t x = in[i * ALSA_CHANNELS];
+
+            capture_buf[i] = x;
+
+            if (x > max_val) {
+                max_val = x;
+            }
+        }
+
+        res = snd_pcm_mmap_commit(capture_pcm, offset, frames);
+
+        if (res < 0) {
+            return res;
+        }
+
+        peak_db = 20.0f * log10f((float) max_val / ((1UL << 15) - 1));
+        dsp_put_audio_samples(frames, capture_buf);
+        avail -= frames;
+    }
+
+    return 0;
+}
+
+static void * io_thread_fn(void *arg) {
+    struct pollfd   fds[ALSA_MAX_FDS];
+    int             play_n = snd_pcm_poll_descriptors(play_pcm, fds, ALSA_MAX_FDS);
+    int             capture_n = snd_pcm_poll_descriptors(capture_pcm, fds + play_n, ALSA_MAX_FDS - play_n);
+    unsigned short  revents;
+    int             err;
+
+    // Same name as the PulseAudio capture callback thread, the DSP feed has the same priority
+    set_thread_name("audio_capture");
+
+    play_write();
+    snd_pcm_start(capture_pcm);
+
+    while (io_run) {
+        if (poll(fds, play_n + capture_n, 100) <= 0) {
+            continue;
+        }
+
+        snd_pcm_poll_descriptors_revents(play_pcm, fds, play_n, &revents);
+
+        if (revents & (POLLOUT | POLLERR)) {
+            err = play_write();
+
+            if (err < 0) {
+                LV_LOG_WARN("Play xrun: %s", snd_strerror(err));
+                snd_pcm_recover(play_pcm, err, 1);
+                play_write();
+            }
+        }
+
+        snd_pcm_poll_descriptors_revents(capture_pcm, fds + play_n, capture_n, &revents);
+
+        if (revents & (POLLIN | POLLERR)) {
+            err = capture_read();
+
+            if (err < 0) {
+                LV_LOG_WARN("Capture xrun: %s", snd_strerror(err));
+                snd_pcm_recover(capture_pcm, err, 1);
+                snd_pcm_start(capture_pcm);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void streams_connect() {
+    uint32_t fragment_ms = low_latency ? AUDIO_LOW_LATENCY_MS : AUDIO_RATE_MS;
+
+    play_pcm = pcm_open(SND_PCM_STREAM_PLAYBACK, AUDIO_PLAY_RATE, fragment_ms);
+    capture_pcm = pcm_open(SND_PCM_STREAM_CAPTURE, AUDIO_CAPTURE_RATE, fragment_ms);
+
+    if (!play_pcm || !capture_pcm) {
+        return;
+    }
+
+    play_latency = 0;
+    capture_latency = 0;
+    io_run = true;
+    pthread_create(&io_thread, NULL, io_thread_fn, NULL);
+}
+
+static void streams_disconnect() {
+    if (io_run) {
+        io_run = false;
+        pthread_join(io_thread, NULL);
+    }
+
+    if (play_pcm) {
+        snd_pcm_close(play_pcm);
+        play_pcm = NULL;
+    }
+
+    if (capture_pcm) {
+        snd_pcm_close(capture_pcm);
+        capture_pcm = NULL;
+    }
+}
+
+static void on_low_latency_change(Subject *subj, void *user_data) {
+    bool x = subject_get_int(subj);
+
+    if (x == low_latency) {
+        return;
+    }
+
+    streams_disconnect();
+    low_latency = x;
+    streams_connect();
+
+    LV_LOG_USER("Audio %s latency profile", x ? "low" : "normal");
+}
+
+void audio_backend_init() {
+    streams_connect();
+
+    if (io_run) {
+        LV_LOG_USER("ALSA %s opened", ALSA_DEVICE);
+    }
+}
+
+void audio_profile_init() {
+    subject_add_observer_and_call(cfg.audio_low_latency.val, on_low_latency_change, NULL);
+}
+
+size_t audio_play_write(audio_play_prio_t prio, const int16_t *samples_buf, size_t samples) {
+    pthread_mutex_lock(&play_mux);
+    size_t res = audio_ring_put(&play_ring[prio], samples_buf, samples);
+    pthread_mutex_unlock(&play_mux);
+
+    return res;
+}
+
+void audio_play_drop(audio_play_prio_t prio) {
+    pthread_mutex_lock(&play_mux);
+    play_ring[prio].head = 0;
+    play_ring[prio].count = 0;
+    pthread_mutex_unlock(&play_mux);
+}
+
+int audio_play_prio(audio_play_prio_t prio, const int16_t *samples_buf, size_t samples) {
+    if (!io_run) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&play_mux);
+
+    while (true) {
+        size_t n = audio_ring_put(&play_ring[prio], samples_buf, samples);
+
+        samples_buf += n;
+        samples -= n;
+
+        if (samples == 0) {
+            break;
+        }
+
+        /* Woken up by the I/O thread, when it took ring samples */
+        pthread_cond_wait(&play_cond, &play_mux);
+    }
+
+    pthread_mutex_unlock(&play_mux);
+
+    return 0;
+}
+
+int audio_play(int16_t *samples_buf, size_t samples) {
+    return audio_play_prio(AUDIO_PLAY_TX, samples_buf, samples);
+}
+
+void audio_play_wait() {
+    if (!io_run) {
+        return;
+    }
+
+    pthread_mutex_lock(&play_mux);
+
+    for (int i = 0; i < AUDIO_PLAY_PRIOS; i++) {
+        while (play_ring[i].count > 0) {
+            pthread_cond_wait(&play_cond, &play_mux);
+        }
+    }
+
+    pthread_mutex_unlock(&play_mux);
+
+    /* The last samples are in the hardware buffer */
+    usleep(play_latency);
+}
+
+float audio_get_peak_db() {
+    return peak_db;
+}
+
+uint32_t audio_get_play_latency() {
+    return play_latency;
+}
+
+uint32_t audio_get_capture_latency() {
+    return capture_latency;
+}
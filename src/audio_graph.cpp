@@ -0,0 +1,231 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "audio_graph.h"
+
+#include "dsp/decim.h"
+#include "dsp/hilbert.h"
+#include "dsp/poly_resamp.h"
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+    #include "audio.h"
+    #include "lvgl/lvgl.h"
+
+    #include <pthread.h>
+}
+
+struct audio_sink_t {
+    uint32_t                rate;
+    audio_format_t          format;
+    audio_sink_cb_t         cb;
+    audio_sink_active_cb_t  active;
+    void                    *user;
+    bool                    run;        // Of the current fragment
+};
+
+/*
+ * Analytic signal to a lower rate. Integer factors go through DecimChain, others
+ * through PolyResampler. Input, which doesn't make a whole output, waits for the
+ * next fragment
+ */
+class RateStage {
+    DecimChain          *decim = NULL;
+    PolyResampler       *poly = NULL;
+    std::vector<cfloat> pending;
+
+  public:
+    uint32_t            rate;
+    size_t              sinks = 0;
+    bool                run = false;
+    bool                was_run = false;
+    std::vector<cfloat> out;
+    size_t              out_size = 0;   // Of the current fragment
+
+    RateStage(uint32_t rate) : rate(rate) {
+        if (AUDIO_CAPTURE_RATE % rate == 0) {
+            decim = new DecimChain(AUDIO_CAPTURE_RATE / rate);
+        } else {
+            poly = new PolyResampler(AUDIO_CAPTURE_RATE, rate);
+        }
+        pending.reserve(AUDIO_CAPTURE_FRAGMENT * 2);
+        out.resize((size_t)AUDIO_CAPTURE_FRAGMENT * rate / AUDIO_CAPTURE_RATE + 1);
+    }
+
+    ~RateStage() {
+        delete decim;
+        delete poly;
+    }
+
+    void reset() {
+        if (decim) {
+            decim->reset();
+        } else {
+            poly->reset();
+        }
+        pending.clear();
+    }
+
+    void execute(const cfloat *in, size_t n) {
+        size_t used;
+
+        pending.insert(pending.end(), in, in + n);
+
+        if (decim) {
+            out_size = pending.size() / decim->get_factor();
+            used = out_size * decim->get_factor();
+        } else {
+            out_size = pending.size() * rate / AUDIO_CAPTURE_RATE;
+
+            while (out_size && poly->input_size(out_size) > pending.size()) {
+                out_size--;
+            }
+            used = poly->input_size(out_size);
+        }
+
+        if (out_size > out.size()) {
+            out.resize(out_size);
+        }
+        if (out_size) {
+            if (decim) {
+                decim->execute(pending.data(), out_size, out.data());
+            } else {
+                poly->execute(pending.data(), out_size, out.data());
+            }
+        }
+        pending.erase(pending.begin(), pending.begin() + used);
+    }
+};
+
+static pthread_mutex_t              graph_mux = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<audio_sink_t *>  sinks;
+static std::vector<RateStage *>     stages;
+
+static BlockHilbert                 hilb(7, 60.0f, AUDIO_CAPTURE_FRAGMENT);
+static bool                         hilb_was_run = false;
+static cfloat                       analytic[AUDIO_CAPTURE_FRAGMENT];
+
+static RateStage *find_stage(uint32_t rate) {
+    for (RateStage *stage : stages) {
+        if (stage->rate == rate) {
+            return stage;
+        }
+    }
+    return NULL;
+}
+
+audio_sink_t *audio_graph_add(uint32_t rate, audio_format_t format, audio_sink_cb_t cb, audio_sink_active_cb_t active,
+                              void *user) {
+    if (rate == 0 || rate > AUDIO_CAPTURE_RATE || (format == AUDIO_FORMAT_S16 && rate != AUDIO_CAPTURE_RATE)) {
+        LV_LOG_ERROR("Unsupported audio sink, rate %u, format %i", rate, format);
+        return NULL;
+    }
+
+    audio_sink_t *sink = new audio_sink_t{rate, format, cb, active, user, false};
+
+    pthread_mutex_lock(&graph_mux);
+
+    if (rate != AUDIO_CAPTURE_RATE) {
+        RateStage *stage = find_stage(rate);
+
+        if (!stage) {
+            stage = new RateStage(rate);
+            stages.push_back(stage);
+        }
+        stage->sinks++;
+    }
+    sinks.push_back(sink);
+
+    pthread_mutex_unlock(&graph_mux);
+    return sink;
+}
+
+void audio_graph_remove(audio_sink_t *sink) {
+    if (!sink) {
+        return;
+    }
+    pthread_mutex_lock(&graph_mux);
+
+    sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+
+    if (sink->rate != AUDIO_CAPTURE_RATE) {
+        RateStage *stage = find_stage(sink->rate);
+
+        if (--stage->sinks == 0) {
+            stages.erase(std::remove(stages.begin(), stages.end(), stage), stages.end());
+            delete stage;
+        }
+    }
+
+    pthread_mutex_unlock(&graph_mux);
+    delete sink;
+}
+
+void audio_graph_put(const int16_t *samples, size_t n) {
+    bool hilb_run = false;
+
+    pthread_mutex_lock(&graph_mux);
+
+    /* Stages of the active sinks only */
+
+    for (RateStage *stage : stages) {
+        stage->run = false;
+    }
+    for (audio_sink_t *sink : sinks) {
+        sink->run = !sink->active || sink->active(sink->user);
+
+        if (sink->run && sink->format == AUDIO_FORMAT_CFLOAT) {
+            hilb_run = true;
+
+            if (sink->rate != AUDIO_CAPTURE_RATE) {
+                find_stage(sink->rate)->run = true;
+            }
+        }
+    }
+
+    /* Idle stages keep no history of old audio */
+
+    if (hilb_run) {
+        if (!hilb_was_run) {
+            hilb.reset();
+        }
+        hilb.execute(samples, n, analytic);
+    }
+    hilb_was_run = hilb_run;
+
+    for (RateStage *stage : stages) {
+        if (stage->run) {
+            if (!stage->was_run) {
+                stage->reset();
+            }
+            stage->execute(analytic, n);
+        }
+        stage->was_run = stage->run;
+    }
+
+    for (audio_sink_t *sink : sinks) {
+        if (!sink->run) {
+            continue;
+        }
+        if (sink->format == AUDIO_FORMAT_S16) {
+            sink->cb(samples, n, sink->user);
+        } else if (sink->rate == AUDIO_CAPTURE_RATE) {
+            sink->cb(analytic, n, sink->user);
+        } else {
+            RateStage *stage = find_stage(sink->rate);
+
+            if (stage->out_size) {
+                sink->cb(stage->out.data(), stage->out_size, sink->user);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&graph_mux);
+}
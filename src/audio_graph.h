@@ -0,0 +1,54 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "helpers.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Routing of the captured audio. Consumers subscribe with the rate and format
+ * they need, any number of them at once. The Hilbert transform and a resampler
+ * per rate are shared stages, computed once per fragment and only while one of
+ * their sinks is active. A sink gets a view into the stage buffer, valid for
+ * the call only.
+ *
+ * Sinks are called on the audio thread in the order of subscription
+ */
+
+typedef enum {
+    AUDIO_FORMAT_S16 = 0,       // Real samples of the codec, capture rate only
+    AUDIO_FORMAT_CFLOAT,        // Analytic signal
+} audio_format_t;
+
+typedef struct audio_sink_t audio_sink_t;
+
+typedef void (*audio_sink_cb_t)(const void *samples, size_t n, void *user);
+typedef bool (*audio_sink_active_cb_t)(void *user);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Subscribe a consumer
+/// @param[in] rate sample rate, not above AUDIO_CAPTURE_RATE
+/// @param[in] active tells if the consumer wants the current fragment, NULL - always
+/// @return sink, NULL on unsupported rate or format
+audio_sink_t *audio_graph_add(uint32_t rate, audio_format_t format, audio_sink_cb_t cb, audio_sink_active_cb_t active,
+                              void *user);
+void          audio_graph_remove(audio_sink_t *sink);
+
+/// @brief Run the graph on a captured fragment, from the audio thread
+void          audio_graph_put(const int16_t *samples, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
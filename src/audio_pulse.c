@@ -0,0 +1,352 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/pulseaudio.h>
+
+#include "lvgl/lvgl.h"
+#include "audio.private.h"
+#include "meter.h"
+#include "dsp.h"
+#include "params/params.h"
+#include "cfg/cfg.h"
+
+static pa_threaded_mainloop *mloop;
+static pa_mainloop_api      *mlapi;
+static pa_context           *ctx;
+
+static pa_stream            *play_stm;
+static char                 *play_device = "alsa_output.platform-sound.stereo-fallback";
+
+static pa_stream            *capture_stm;
+static char                 *capture_device = "alsa_input.platform-sound.stereo-fallback";
+
+static pa_stream            *monitor_stm = NULL;
+
+static float                peak_db = -60.0f;
+
+static bool                 low_latency = false;
+static volatile uint32_t    capture_latency = 0;
+
+/* Play rings, one per priority. Guarded by the mainloop lock */
+
+static audio_ring_t         play_ring[AUDIO_PLAY_PRIOS];
+static bool                 play_drained = false;
+
+static const pa_stream_flags_t stream_flags =
+    PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+
+static void record_monitor_setup();
+
+static void on_state_change(pa_context *c, void *userdata) {
+    pa_threaded_mainloop_signal(mloop, 0);
+}
+
+static void read_callback(pa_stream *s, size_t nbytes, void *udata) {
+    int16_t *buf = NULL;
+
+    pa_usec_t usec;
+    int       neg;
+
+    // Age of the oldest unread sample, the data to read is counted in
+    if (pa_stream_get_latency(s, &usec, &neg) == 0) {
+        capture_latency = neg ? 0 : usec;
+    }
+
+    pa_stream_peek(s, (const void**) &buf, &nbytes);
+    dsp_put_audio_samples(nbytes / 2, buf);
+    pa_stream_drop(s);
+}
+
+/**
+ * Move ring samples to the play stream, as much as it can take. The highest priority
+ * ring with data plays, the lower ones hold until it is empty. Called with mainloop locked
+ */
+static void play_ring_flush() {
+    size_t writable = pa_stream_writable_size(play_stm);
+
+    if (writable == (size_t) -1) {
+        return;
+    }
+
+    writable /= sizeof(int16_t);
+
+    for (int i = 0; i < AUDIO_PLAY_PRIOS && writable > 0; i++) {
+        audio_ring_t *ring = &play_ring[i];
+
+        while (ring->count > 0 && writable > 0) {
+            size_t n = LV_MIN(LV_MIN(ring->count, writable), AUDIO_PLAY_RING - ring->head);
+
+            if (pa_stream_write(play_stm, &ring->buf[ring->head], n * sizeof(int16_t), NULL, 0, PA_SEEK_RELATIVE) < 0) {
+                LV_LOG_ERROR("pa_stream_write() failed: %s", pa_strerror(pa_context_errno(ctx)));
+                return;
+            }
+
+            ring->head = (ring->head + n) % AUDIO_PLAY_RING;
+            ring->count -= n;
+            writable -= n;
+        }
+
+        if (ring->count > 0) {
+            break;
+        }
+    }
+
+    pa_threaded_mainloop_signal(mloop, 0);
+}
+
+static void write_callback(pa_stream *s, size_t nbytes, void *udata) {
+    play_ring_flush();
+}
+
+static void drain_callback(pa_stream *s, int success, void *udata) {
+    play_drained = true;
+    pa_threaded_mainloop_signal(mloop, 0);
+}
+
+static bool play_ring_empty() {
+    for (int i = 0; i < AUDIO_PLAY_PRIOS; i++) {
+        if (play_ring[i].count > 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Connect play and capture streams with the fragments of the profile. Called with
+ * mainloop locked
+ */
+static void streams_connect() {
+    uint32_t        fragment_ms = low_latency ? AUDIO_LOW_LATENCY_MS : AUDIO_RATE_MS;
+    pa_buffer_attr  attr;
+
+    pa_sample_spec  spec = {
+        .format = PA_SAMPLE_S16NE,
+        .channels = 1
+    };
+
+    memset(&attr, 0xff, sizeof(attr));
+
+    /* Play */
+
+    spec.rate = AUDIO_PLAY_RATE,
+    attr.fragsize = pa_usec_to_bytes(fragment_ms * PA_USEC_PER_MSEC, &spec);
+
+    if (low_latency) {
+        attr.minreq = attr.fragsize;
+        attr.tlength = attr.fragsize * 4;
+    } else {
+        attr.tlength = attr.fragsize * 8;
+    }
+
+    play_stm = pa_stream_new(ctx, "X6100 GUI Play", &spec, NULL);
+    pa_stream_set_write_callback(play_stm, write_callback, NULL);
+    pa_stream_connect_playback(play_stm, play_device, &attr, stream_flags, NULL, NULL);
+
+    /* Capture */
+
+    memset(&attr, 0xff, sizeof(attr));
+
+    spec.rate = AUDIO_CAPTURE_RATE,
+    attr.fragsize = attr.tlength = pa_usec_to_bytes(fragment_ms * PA_USEC_PER_MSEC, &spec);
+
+    capture_stm = pa_stream_new(ctx, "X6100 GUI Capture", &spec, NULL);
+    pa_stream_set_read_callback(capture_stm, read_callback, NULL);
+    pa_stream_connect_record(capture_stm, capture_device, &attr, stream_flags);
+
+    capture_latency = 0;
+}
+
+static void streams_disconnect() {
+    pa_stream_set_write_callback(play_stm, NULL, NULL);
+    pa_stream_disconnect(play_stm);
+    pa_stream_unref(play_stm);
+
+    pa_stream_set_read_callback(capture_stm, NULL, NULL);
+    pa_stream_disconnect(capture_stm);
+    pa_stream_unref(capture_stm);
+}
+
+static void on_low_latency_change(Subject *subj, void *user_data) {
+    bool x = subject_get_int(subj);
+
+    if (x == low_latency) {
+        return;
+    }
+
+    pa_threaded_mainloop_lock(mloop);
+    streams_disconnect();
+    low_latency = x;
+    streams_connect();
+    pa_threaded_mainloop_unlock(mloop);
+
+    LV_LOG_USER("Audio %s latency profile", x ? "low" : "normal");
+}
+
+void audio_backend_init() {
+    mloop = pa_threaded_mainloop_new();
+    pa_threaded_mainloop_start(mloop);
+
+    mlapi = pa_threaded_mainloop_get_api(mloop);
+    ctx = pa_context_new(mlapi, "X6100 GUI");
+
+    pa_threaded_mainloop_lock(mloop);
+    pa_context_set_state_callback(ctx, on_state_change, NULL);
+    pa_context_connect(ctx, NULL, 0, NULL);
+    pa_threaded_mainloop_unlock(mloop);
+
+    while (PA_CONTEXT_READY != pa_context_get_state(ctx))  {
+        pa_threaded_mainloop_wait(mloop);
+    }
+
+    LV_LOG_USER("Conected");
+
+    pa_threaded_mainloop_lock(mloop);
+    streams_connect();
+    pa_threaded_mainloop_unlock(mloop);
+
+    record_monitor_setup();
+}
+
+void audio_profile_init() {
+    subject_add_observer_and_call(cfg.audio_low_latency.val, on_low_latency_change, NULL);
+}
+
+size_t audio_play_write(audio_play_prio_t prio, const int16_t *samples_buf, size_t samples) {
+    pa_threaded_mainloop_lock(mloop);
+    size_t res = audio_ring_put(&play_ring[prio], samples_buf, samples);
+
+    if (pa_stream_get_state(play_stm) == PA_STREAM_READY) {
+        play_ring_flush();
+    }
+    pa_threaded_mainloop_unlock(mloop);
+
+    return res;
+}
+
+void audio_play_drop(audio_play_prio_t prio) {
+    pa_threaded_mainloop_lock(mloop);
+    play_ring[prio].head = 0;
+    play_ring[prio].count = 0;
+    pa_threaded_mainloop_unlock(mloop);
+}
+
+int audio_play_prio(audio_play_prio_t prio, const int16_t *samples_buf, size_t samples) {
+    pa_threaded_mainloop_lock(mloop);
+
+    while (true) {
+        size_t n = audio_ring_put(&play_ring[prio], samples_buf, samples);
+
+        samples_buf += n;
+        samples -= n;
+
+        if (pa_stream_get_state(play_stm) == PA_STREAM_READY) {
+            play_ring_flush();
+        }
+
+        if (samples == 0) {
+            break;
+        }
+
+        /* Woken up by the write callback, when the stream took ring samples */
+        pa_threaded_mainloop_wait(mloop);
+    }
+
+    pa_threaded_mainloop_unlock(mloop);
+
+    return 0;
+}
+
+int audio_play(int16_t *samples_buf, size_t samples) {
+    return audio_play_prio(AUDIO_PLAY_TX, samples_buf, samples);
+}
+
+void audio_play_wait() {
+    pa_operation *op;
+
+    pa_threaded_mainloop_lock(mloop);
+
+    while (!play_ring_empty()) {
+        pa_threaded_mainloop_wait(mloop);
+    }
+
+    play_drained = false;
+    op = pa_stream_drain(play_stm, drain_callback, NULL);
+
+    if (op) {
+        while (!play_drained && pa_operation_get_state(op) == PA_OPERATION_RUNNING) {
+            pa_threaded_mainloop_wait(mloop);
+        }
+        pa_operation_unref(op);
+    }
+
+    pa_threaded_mainloop_unlock(mloop);
+}
+
+float audio_get_peak_db() {
+    return peak_db;
+}
+
+uint32_t audio_get_play_latency() {
+    pa_usec_t usec;
+    int       neg;
+    int       res;
+
+    pa_threaded_mainloop_lock(mloop);
+    res = pa_stream_get_latency(play_stm, &usec, &neg);
+    pa_threaded_mainloop_unlock(mloop);
+
+    return (res == 0 && !neg) ? usec : 0;
+}
+
+uint32_t audio_get_capture_latency() {
+    return capture_latency;
+}
+
+static void monitor_cb(pa_stream *stream, size_t length, void *udata) {
+    int16_t *buf = NULL;
+
+    pa_stream_peek(stream, (const void**) &buf, &length);
+    int16_t max_val = 1;
+    int16_t cur_val;
+    for (size_t i=0; i < length / 2; i++) {
+        cur_val = buf[i];
+        if (cur_val > max_val) {
+            max_val = cur_val;
+        }
+    }
+    peak_db = 20.0f * log10f((float) max_val / ((1UL << 15) - 1));
+    pa_stream_drop(stream);
+}
+
+
+static void record_monitor_setup() {
+
+    pa_sample_spec  spec = {
+        .format = PA_SAMPLE_S16NE,
+        .channels = 1
+    };
+
+    spec.rate = 30;
+
+    monitor_stm = pa_stream_new(ctx, "X6100 GUI Monitor", &spec, NULL);
+
+    pa_threaded_mainloop_lock(mloop);
+    pa_stream_set_read_callback(monitor_stm, monitor_cb, NULL);
+    pa_stream_connect_record(monitor_stm, capture_device, NULL, PA_STREAM_PEAK_DETECT);
+    pa_threaded_mainloop_unlock(mloop);
+}
@@ -0,0 +1,611 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "audio_stream.h"
+
+#include "audio.h"
+#include "audio_graph.h"
+#include "cfg/cfg.h"
+#include "dsp/adpcm.h"
+#include "dsp/poly_resamp.h"
+#include "governor.h"
+#include "jitter_buffer.h"
+#include "radio.h"
+#include "ring.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <arpa/inet.h>
+#include <complex.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define BLOCK_SAMPLES   (AUDIO_CAPTURE_FRAGMENT * AUDIO_STREAM_RATE / AUDIO_CAPTURE_RATE + 1)
+#define RING_BLOCKS     8
+#define MAX_FRAME       JITTER_BUFFER_MAX_FRAME
+#define PLAY_FACTOR     (AUDIO_PLAY_RATE / AUDIO_STREAM_RATE)
+#define TX_IDLE_MS      300
+#define STATUS_MS       1000
+#define STREAM_IFACE    "wlan0"
+
+const uint8_t audio_stream_frames[AUDIO_STREAM_FRAMES] = { 10, 20, 40 };
+
+typedef struct __attribute__((packed)) {
+    char        magic[4];
+    uint8_t     version;
+    uint8_t     flags;
+} subscribe_t;
+
+typedef struct __attribute__((packed)) {
+    char        magic[4];
+    uint8_t     version;
+    uint8_t     flags;
+    uint16_t    seq;
+    uint16_t    samples;
+    int16_t     predictor;
+    uint8_t     index;
+    uint8_t     reserved;
+    uint16_t    latency_ms;
+} frame_header_t;
+
+typedef struct __attribute__((packed)) {
+    char        magic[4];
+    uint8_t     version;
+    uint8_t     frame_ms;
+    uint16_t    rate;
+    uint16_t    rx_latency_ms;
+    uint16_t    tx_latency_ms;
+    uint8_t     jitter_depth;
+    uint8_t     jitter_target;
+    uint32_t    rx_dropped;
+    uint32_t    tx_lost;
+    uint32_t    tx_late;
+    uint32_t    tx_underruns;
+} status_t;
+
+/* Fragment of RX audio, from the audio thread */
+typedef struct {
+    uint64_t    time_us;        /* Of the last sample */
+    uint16_t    n;
+    int16_t     samples[BLOCK_SAMPLES];
+} block_t;
+
+typedef struct {
+    struct sockaddr_in  addr;
+    bool                used;
+    bool                rx;
+    uint64_t            expire_ms;
+} client_t;
+
+static ring_t           rx_ring;
+static int              sock = -1;
+static int              wake_event = -1;
+static client_t         client;
+
+static atomic_uint      cfg_frame_ms = 0;
+static atomic_bool      rx_wanted = false;
+
+/* Stream thread */
+
+static uint8_t          frame_ms = 0;
+static uint16_t         frame = 0;              /* Samples */
+static uint32_t         frame_us = 0;
+
+static int16_t          acc[MAX_FRAME];
+static uint16_t         acc_len = 0;
+static uint64_t         acc_time_us = 0;        /* Of acc[0] */
+static adpcm_state_t    enc_state;
+static uint16_t         rx_seq = 0;
+
+static uint64_t         budget_start_us = 0;
+static uint64_t         budget_start_cpu_us = 0;
+
+static jitter_buffer_t  jb;
+static PolyResampler    *upsampler = NULL;
+static bool             tx_active = false;
+static uint64_t         tx_next_us = 0;
+static uint64_t         tx_played_us = 0;
+static uint64_t         status_ms = 0;
+
+static atomic_bool      stat_client = false;
+static atomic_uint      stat_rx_frames = 0;
+static atomic_uint      stat_rx_dropped = 0;
+static atomic_uint      stat_tx_frames = 0;
+static atomic_uint      stat_tx_lost = 0;
+static atomic_uint      stat_tx_late = 0;
+static atomic_uint      stat_tx_underruns = 0;
+static atomic_uint      stat_rx_latency_ms = 0;
+static atomic_uint      stat_tx_latency_ms = 0;
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static uint64_t thread_cpu_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void wake() {
+    uint64_t val = 1;
+
+    if (wake_event >= 0 && write(wake_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("Audio stream wake event");
+    }
+}
+
+/* Audio thread */
+
+static bool audio_active(void *user) {
+    return atomic_load_explicit(&rx_wanted, memory_order_relaxed);
+}
+
+static void audio_cb(const void *samples, size_t n, void *user) {
+    const cfloat    *in = (const cfloat *) samples;
+    uint64_t        now = now_us();
+
+    while (n) {
+        block_t *block = ring_reserve(rx_ring);
+
+        if (!block) {
+            atomic_fetch_add_explicit(&stat_rx_dropped, 1, memory_order_relaxed);
+            break;
+        }
+
+        size_t part = LV_MIN(n, BLOCK_SAMPLES);
+
+        for (size_t i = 0; i < part; i++) {
+            float x = crealf(in[i]) * 32768.0f;
+
+            block->samples[i] = x > 32767.0f ? 32767 : x < -32767.0f ? -32767 : (int16_t) x;
+        }
+        block->n = part;
+        block->time_us = now - (uint64_t) (n - part) * 1000000 / AUDIO_STREAM_RATE;
+
+        ring_commit(rx_ring);
+        in += part;
+        n -= part;
+    }
+    wake();
+}
+
+/* RX */
+
+/**
+ * CPU time of the thread in the current second is over the budget
+ */
+static bool over_budget(uint64_t now) {
+    uint64_t cpu = thread_cpu_us();
+
+    if (now - budget_start_us >= 1000000) {
+        budget_start_us = now;
+        budget_start_cpu_us = cpu;
+    }
+    return cpu - budget_start_cpu_us > AUDIO_STREAM_CPU_BUDGET * 10000;
+}
+
+static void send_rx_frame() {
+    static uint8_t  buf[sizeof(frame_header_t) + MAX_FRAME / 2 + 1];
+    frame_header_t  *header = (frame_header_t *) buf;
+    uint64_t        now = now_us();
+
+    if (over_budget(now)) {
+        atomic_fetch_add_explicit(&stat_rx_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    uint32_t latency_ms = (now - acc_time_us + audio_get_capture_latency()) / 1000;
+
+    memcpy(header->magic, "X6AF", 4);
+    header->version = AUDIO_STREAM_VERSION;
+    header->flags = radio_get_state() == RADIO_RX ? 0 : 1;
+    header->seq = htons(rx_seq++);
+    header->samples = htons(frame);
+    header->predictor = htons(enc_state.predictor);
+    header->index = enc_state.index;
+    header->reserved = 0;
+    header->latency_ms = htons(LV_MIN(latency_ms, 0xFFFF));
+
+    adpcm_encode(&enc_state, acc, frame, buf + sizeof(frame_header_t));
+
+    ssize_t res = sendto(sock, buf, sizeof(frame_header_t) + (frame + 1) / 2, MSG_DONTWAIT,
+                         (struct sockaddr *) &client.addr, sizeof(client.addr));
+
+    if (res < 0) {
+        atomic_fetch_add_explicit(&stat_rx_dropped, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&stat_rx_frames, 1, memory_order_relaxed);
+        atomic_store_explicit(&stat_rx_latency_ms, latency_ms, memory_order_relaxed);
+    }
+}
+
+/**
+ * Cut the captured blocks to frames
+ */
+static void process_rx() {
+    block_t *block;
+
+    while ((block = ring_peek(rx_ring))) {
+        uint64_t    first_us = block->time_us - (uint64_t) block->n * 1000000 / AUDIO_STREAM_RATE;
+        uint16_t    i = 0;
+
+        while (i < block->n) {
+            if (acc_len == 0) {
+                acc_time_us = first_us + (uint64_t) i * 1000000 / AUDIO_STREAM_RATE;
+            }
+
+            uint16_t part = LV_MIN(frame - acc_len, block->n - i);
+
+            memcpy(acc + acc_len, block->samples + i, part * sizeof(int16_t));
+            acc_len += part;
+            i += part;
+
+            if (acc_len == frame) {
+                if (client.used && client.rx) {
+                    send_rx_frame();
+                }
+                acc_len = 0;
+            }
+        }
+        ring_release(rx_ring);
+    }
+}
+
+/* TX */
+
+static void tx_start(uint64_t now) {
+    tx_active = true;
+    tx_next_us = now;
+    tx_played_us = now;
+    poly_resamp_reset(upsampler);
+    audio_play_en(true);
+}
+
+static void tx_stop() {
+    if (tx_active) {
+        tx_active = false;
+        audio_play_en(false);
+        jitter_buffer_reset(&jb, frame, jb.target);
+    }
+}
+
+static void play_frame() {
+    static int16_t  pcm[MAX_FRAME];
+    static cfloat   in[MAX_FRAME];
+    static cfloat   out[MAX_FRAME * PLAY_FACTOR];
+    static int16_t  play[MAX_FRAME * PLAY_FACTOR];
+    size_t          out_size = frame * PLAY_FACTOR;
+
+    if (!jitter_buffer_get(&jb, pcm)) {
+        return;
+    }
+    for (uint16_t i = 0; i < frame; i++) {
+        in[i] = pcm[i] / 32768.0f;
+    }
+    poly_resamp_execute(upsampler, in, out_size, out);
+
+    for (size_t i = 0; i < out_size; i++) {
+        float x = crealf(out[i]) * 32768.0f;
+
+        play[i] = x > 32767.0f ? 32767 : x < -32767.0f ? -32767 : (int16_t) x;
+    }
+    audio_play_write(AUDIO_PLAY_TX, play, out_size);
+    atomic_fetch_add_explicit(&stat_tx_frames, 1, memory_order_relaxed);
+    tx_played_us = now_us();
+}
+
+/**
+ * One frame per frame time, as our clock goes
+ */
+static void playout(uint64_t now) {
+    if (!tx_active) {
+        return;
+    }
+    /* Thread was stalled, don't burst the missed ticks */
+    if (now > tx_next_us + 10 * frame_us) {
+        tx_next_us = now;
+    }
+    while (now >= tx_next_us) {
+        play_frame();
+        tx_next_us += frame_us;
+    }
+    if (now - tx_played_us > TX_IDLE_MS * 1000) {
+        tx_stop();
+    }
+}
+
+static void receive_tx(const uint8_t *buf, size_t size, uint64_t now) {
+    static int16_t          pcm[MAX_FRAME];
+    const frame_header_t    *header = (const frame_header_t *) buf;
+    uint16_t                samples = ntohs(header->samples);
+
+    if (samples != frame || size < sizeof(frame_header_t) + (samples + 1) / 2) {
+        return;
+    }
+
+    adpcm_state_t state = { .predictor = ntohs(header->predictor), .index = LV_MIN(header->index, 88) };
+
+    adpcm_decode(&state, buf + sizeof(frame_header_t), samples, pcm);
+    jitter_buffer_put(&jb, ntohs(header->seq), pcm);
+
+    if (!tx_active) {
+        tx_start(now);
+    }
+}
+
+/* Clients */
+
+static bool same_addr(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static void client_leave() {
+    tx_stop();
+    client.used = false;
+    atomic_store(&rx_wanted, false);
+    atomic_store(&stat_client, false);
+}
+
+static void subscribe(const subscribe_t *req, const struct sockaddr_in *addr, uint64_t now) {
+    if (req->flags == 0) {
+        if (client.used) {
+            client_leave();
+        }
+        return;
+    }
+    if (!client.used) {
+        client.addr = *addr;
+        client.used = true;
+        jitter_buffer_reset(&jb, frame, jb.target);
+        LV_LOG_USER("Audio stream client %s", inet_ntoa(addr->sin_addr));
+    }
+    client.rx = req->flags & 1;
+    client.expire_ms = now / 1000 + AUDIO_STREAM_TIMEOUT_S * 1000;
+
+    atomic_store(&rx_wanted, client.rx);
+    atomic_store(&stat_client, true);
+}
+
+static void receive(uint64_t now) {
+    static uint8_t      buf[sizeof(frame_header_t) + MAX_FRAME / 2 + 1];
+    struct sockaddr_in  addr;
+    socklen_t           addr_len = sizeof(addr);
+    ssize_t             res;
+
+    while ((res = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *) &addr, &addr_len)) >= 0) {
+        bool subscribe_req = res == sizeof(subscribe_t) && memcmp(buf, "X6AS", 4) == 0 && buf[4] == AUDIO_STREAM_VERSION;
+
+        addr_len = sizeof(addr);
+
+        /* Only the subscribed peer is heard */
+        if (client.used && !same_addr(&client.addr, &addr)) {
+            if (subscribe_req) {
+                LV_LOG_WARN("Audio stream: busy with another client");
+            }
+            continue;
+        }
+        if (subscribe_req) {
+            subscribe((const subscribe_t *) buf, &addr, now);
+        } else if (client.used && (size_t) res >= sizeof(frame_header_t) && memcmp(buf, "X6AF", 4) == 0 &&
+                   buf[4] == AUDIO_STREAM_VERSION)
+        {
+            client.expire_ms = now / 1000 + AUDIO_STREAM_TIMEOUT_S * 1000;
+            receive_tx(buf, res, now);
+        }
+    }
+}
+
+static void send_status() {
+    status_t    status;
+    uint32_t    tx_latency_ms = jitter_buffer_depth(&jb) * frame_ms + audio_get_play_latency() / 1000;
+
+    atomic_store(&stat_tx_lost, jb.stats.lost);
+    atomic_store(&stat_tx_late, jb.stats.late);
+    atomic_store(&stat_tx_underruns, jb.stats.underruns);
+    atomic_store(&stat_tx_latency_ms, tx_latency_ms);
+
+    if (!client.used) {
+        return;
+    }
+
+    memcpy(status.magic, "X6AI", 4);
+    status.version = AUDIO_STREAM_VERSION;
+    status.frame_ms = frame_ms;
+    status.rate = htons(AUDIO_STREAM_RATE);
+    status.rx_latency_ms = htons(LV_MIN(atomic_load(&stat_rx_latency_ms), 0xFFFF));
+    status.tx_latency_ms = htons(LV_MIN(tx_latency_ms, 0xFFFF));
+    status.jitter_depth = jitter_buffer_depth(&jb);
+    status.jitter_target = jb.target;
+    status.rx_dropped = htonl(atomic_load(&stat_rx_dropped));
+    status.tx_lost = htonl(jb.stats.lost);
+    status.tx_late = htonl(jb.stats.late);
+    status.tx_underruns = htonl(jb.stats.underruns);
+
+    sendto(sock, &status, sizeof(status), MSG_DONTWAIT, (struct sockaddr *) &client.addr, sizeof(client.addr));
+}
+
+/* Stream thread */
+
+static void configure(uint8_t ms) {
+    frame_ms = ms;
+    frame = LV_MIN((uint32_t) AUDIO_STREAM_RATE * ms / 1000, MAX_FRAME);
+    frame_us = (uint64_t) frame * 1000000 / AUDIO_STREAM_RATE;
+    acc_len = 0;
+    memset(&enc_state, 0, sizeof(enc_state));
+
+    tx_stop();
+    jitter_buffer_reset(&jb, frame, ms ? (AUDIO_STREAM_JITTER_MS + ms - 1) / ms : 1);
+}
+
+static void socket_open() {
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (sock < 0) {
+        LV_LOG_ERROR("Audio stream socket: %s", strerror(errno));
+        return;
+    }
+    if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, STREAM_IFACE, sizeof(STREAM_IFACE)) < 0) {
+        LV_LOG_WARN("Audio stream on all interfaces, %s: %s", STREAM_IFACE, strerror(errno));
+    }
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(AUDIO_STREAM_PORT);
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        LV_LOG_ERROR("Audio stream port %u: %s", AUDIO_STREAM_PORT, strerror(errno));
+        close(sock);
+        sock = -1;
+    }
+}
+
+static void socket_close() {
+    if (client.used) {
+        client_leave();
+    }
+    close(sock);
+    sock = -1;
+}
+
+static int poll_timeout() {
+    if (sock < 0) {
+        return -1;
+    }
+    if (tx_active) {
+        uint64_t now = now_us();
+
+        return tx_next_us > now ? (tx_next_us - now + 999) / 1000 : 0;
+    }
+    return STATUS_MS;
+}
+
+static void * audio_stream_thread(void *arg) {
+    set_thread_name("audio_stream");
+
+    struct pollfd   fds[2];
+
+    while (true) {
+        uint8_t ms = atomic_load(&cfg_frame_ms);
+
+        if (ms != frame_ms) {
+            if (sock >= 0) {
+                socket_close();
+            }
+            configure(ms);
+        }
+        if (ms && sock < 0) {
+            socket_open();
+        }
+
+        fds[0].fd = wake_event;
+        fds[0].events = POLLIN;
+        fds[1].fd = sock;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, poll_timeout()) < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("Audio stream poll: %s", strerror(errno));
+                sleep_usec(100000);
+            }
+            continue;
+        }
+
+        uint64_t now = now_us();
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t val;
+
+            if (read(wake_event, &val, sizeof(val)) < 0) {
+                LV_LOG_WARN("Audio stream wake event");
+            }
+        }
+        if (sock < 0) {
+            ring_flush(rx_ring);
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            receive(now);
+        }
+
+        process_rx();
+        playout(now);
+
+        if (client.used && now / 1000 > client.expire_ms) {
+            LV_LOG_USER("Audio stream client is gone");
+            client_leave();
+        }
+        if (now / 1000 - status_ms >= STATUS_MS) {
+            status_ms = now / 1000;
+            send_status();
+        }
+    }
+    return NULL;
+}
+
+static void on_audio_stream_change(Subject *subj, void *user_data) {
+    int32_t ms = subject_get_int(subj);
+
+    for (uint8_t i = 0; i < AUDIO_STREAM_FRAMES; i++) {
+        if (audio_stream_frames[i] == ms) {
+            atomic_store(&cfg_frame_ms, ms);
+            wake();
+            return;
+        }
+    }
+    atomic_store(&cfg_frame_ms, 0);
+    wake();
+}
+
+void audio_stream_init() {
+    wake_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_event < 0) {
+        LV_LOG_ERROR("Audio stream wake event");
+        return;
+    }
+
+    rx_ring = ring_create(sizeof(block_t), RING_BLOCKS);
+    upsampler = poly_resamp_create(AUDIO_STREAM_RATE, AUDIO_PLAY_RATE);
+
+    subject_add_observer_and_call(cfg.audio_stream.val, on_audio_stream_change, NULL);
+    audio_graph_add(AUDIO_STREAM_RATE, AUDIO_FORMAT_CFLOAT, audio_cb, audio_active, NULL);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, audio_stream_thread, NULL);
+    pthread_detach(thread);
+    governor_watch_thread("audio_stream", thread);
+}
+
+void audio_stream_stats(audio_stream_stats_t *stats) {
+    stats->client = atomic_load(&stat_client);
+    stats->rx_frames = atomic_load(&stat_rx_frames);
+    stats->rx_dropped = atomic_load(&stat_rx_dropped);
+    stats->tx_frames = atomic_load(&stat_tx_frames);
+    stats->tx_lost = atomic_load(&stat_tx_lost);
+    stats->tx_late = atomic_load(&stat_tx_late);
+    stats->tx_underruns = atomic_load(&stat_tx_underruns);
+    stats->rx_latency_ms = atomic_load(&stat_rx_latency_ms);
+    stats->tx_latency_ms = atomic_load(&stat_tx_latency_ms);
+}
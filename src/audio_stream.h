@@ -0,0 +1,81 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Remote audio over UDP, RX audio to a client and TX audio from it, IMA ADPCM
+ * at AUDIO_STREAM_RATE (44 kbit/s). RX audio is a sink of the audio graph: the
+ * audio thread only copies fragments to a ring, the "audio_stream" thread cuts
+ * them to frames, encodes and sends them within AUDIO_STREAM_CPU_BUDGET, frames
+ * over the budget are dropped. TX frames go through a jitter buffer to the
+ * AUDIO_PLAY_TX play ring, the play path is on while they come. Keying is left
+ * to CAT (rigctl "T 1" over the network CAT).
+ *
+ * Enabled by cfg.audio_stream, frame length in ms, one of audio_stream_frames.
+ * One client at a time.
+ *
+ * Subscribe, sent by the client to AUDIO_STREAM_PORT and repeated within
+ * AUDIO_STREAM_TIMEOUT_S (TX frames count as well):
+ *
+ *   "X6AS", u8 version, u8 flags (bit 0 RX audio, 0 to leave)
+ *
+ * Frame, both ways, one datagram per frame, multibyte fields big endian:
+ *
+ *   "X6AF", u8 version, u8 flags (bit 0 TX, from the radio), u16 seq, u16 samples,
+ *   i16 ADPCM predictor, u8 ADPCM step index, u8 0, u16 latency ms (from the radio,
+ *   age of the first sample), then (samples + 1) / 2 bytes
+ *
+ * TX frames must have the samples of the configured frame length.
+ *
+ * Status, from the radio once a second:
+ *
+ *   "X6AI", u8 version, u8 frame ms, u16 rate, u16 RX latency ms, u16 TX latency ms,
+ *   u8 jitter buffer frames, u8 jitter buffer target, u32 RX dropped, u32 TX lost,
+ *   u32 TX late, u32 TX underruns
+ */
+
+#define AUDIO_STREAM_PORT       4535
+#define AUDIO_STREAM_RATE       11025
+#define AUDIO_STREAM_TIMEOUT_S  10
+#define AUDIO_STREAM_VERSION    1
+#define AUDIO_STREAM_JITTER_MS  60
+#define AUDIO_STREAM_CPU_BUDGET 5       /* % of a core */
+#define AUDIO_STREAM_FRAMES     3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const uint8_t audio_stream_frames[AUDIO_STREAM_FRAMES];
+
+typedef struct {
+    bool        client;
+    uint32_t    rx_frames;
+    uint32_t    rx_dropped;     /* Over the CPU budget, the ring or the socket was full */
+    uint32_t    tx_frames;      /* Played */
+    uint32_t    tx_lost;
+    uint32_t    tx_late;
+    uint32_t    tx_underruns;
+    uint32_t    rx_latency_ms;  /* Of the last sent frame */
+    uint32_t    tx_latency_ms;  /* Jitter buffer and play stream */
+} audio_stream_stats_t;
+
+void audio_stream_init();
+
+/**
+ * Counters since start
+ */
+void audio_stream_stats(audio_stream_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
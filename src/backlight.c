@@ -17,6 +17,7 @@
 #include "backlight.h"
 #include "util.h"
 #include "voice.h"
+#include "dsp.h"
 
 static int          power;
 static int          brightness;
@@ -100,7 +101,9 @@ void backlight_switch() {
         on = false;
         voice_say_text_fmt("Display off");
         lv_disp_enable_invalidation(lv_disp_get_default(), false);
+        dsp_set_display_on(false);
     } else {
+        dsp_set_display_on(true);
         lv_disp_enable_invalidation(lv_disp_get_default(), true);
         set_power(true);
         set_brightness(params.brightness_normal);
@@ -0,0 +1,269 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "band_activity.h"
+
+#include "cfg/cfg.h"
+#include "qso_log.h"
+#include "ring.h"
+#include "signals.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define RING_SIZE       16
+#define PENDING         4
+#define HOUR_S          3600
+#define HOUR_BANDS      4
+
+typedef struct {
+    uint32_t    start;
+    uint16_t    snr[BAND_ACTIVITY_SNR_BINS];
+} slot_event_t;
+
+/* Record of a slot, while open */
+typedef struct {
+    bool                    used;
+    band_activity_record_t  rec;
+    float                   floor_sum;
+    float                   occupied_sum;
+} accum_t;
+
+static ring_t                   ring = NULL;
+static band_activity_store_t    slots_store;
+static band_activity_store_t    hours_store;
+
+/* Aggregator thread */
+static accum_t                  pending[PENDING];
+static band_activity_record_t   hours[HOUR_BANDS];      /* Band 0 is free */
+static uint32_t                 hour_start = 0;
+static signals_t                signals;
+
+/* Decode thread */
+
+void band_activity_slot(uint32_t start, const uint16_t *snr) {
+    if (!ring) {
+        return;
+    }
+
+    slot_event_t *event = ring_reserve(ring);
+
+    if (event) {
+        event->start = start;
+        memcpy(event->snr, snr, sizeof(event->snr));
+        ring_commit(ring);
+    }
+}
+
+/* Aggregator thread */
+
+static void hours_close() {
+    for (uint8_t i = 0; i < HOUR_BANDS; i++) {
+        if (hours[i].band && !band_activity_store_append(&hours_store, &hours[i])) {
+            LV_LOG_WARN("Band activity: can't write %s", hours_store.path);
+        }
+        hours[i].band = 0;
+    }
+    if (!band_activity_store_flush(&slots_store) || !band_activity_store_flush(&hours_store)) {
+        LV_LOG_WARN("Band activity: can't write the blocks");
+    }
+    hour_start = 0;
+}
+
+static void hour_add(const band_activity_record_t *rec) {
+    uint32_t                hour = rec->time / HOUR_S * HOUR_S;
+    band_activity_record_t  *total = NULL;
+
+    if (hour_start && hour != hour_start) {
+        hours_close();
+    }
+    hour_start = hour;
+
+    for (uint8_t i = 0; i < HOUR_BANDS && !total; i++) {
+        if (hours[i].band == rec->band) {
+            total = &hours[i];
+        }
+    }
+    for (uint8_t i = 0; i < HOUR_BANDS && !total; i++) {
+        if (hours[i].band == 0) {
+            total = &hours[i];
+            memset(total, 0, sizeof(*total));
+            total->time = hour;
+            total->span = HOUR_S;
+            total->band = rec->band;
+        }
+    }
+    if (total) {
+        band_activity_rollup(total, rec);
+    }
+}
+
+static void accum_close(accum_t *accum) {
+    band_activity_record_t *rec = &accum->rec;
+
+    accum->used = false;
+
+    if (rec->rows) {
+        rec->floor = accum->floor_sum * 10.0f / rec->rows;
+        rec->occupied = accum->occupied_sum * 1000.0f / rec->rows;
+    } else if (!rec->decodes) {
+        return;
+    }
+    if (!band_activity_store_append(&slots_store, rec)) {
+        LV_LOG_WARN("Band activity: can't write %s", slots_store.path);
+    }
+    hour_add(rec);
+}
+
+/**
+ * Open record of the slot and band. The oldest one is closed, when all are in use
+ */
+static accum_t * accum_get(uint32_t start, uint8_t band) {
+    accum_t *free_accum = NULL;
+    accum_t *oldest = NULL;
+
+    for (uint8_t i = 0; i < PENDING; i++) {
+        accum_t *accum = &pending[i];
+
+        if (!accum->used) {
+            if (!free_accum) {
+                free_accum = accum;
+            }
+        } else if (accum->rec.time == start && accum->rec.band == band) {
+            return accum;
+        } else if (!oldest || accum->rec.time < oldest->rec.time) {
+            oldest = accum;
+        }
+    }
+    if (!free_accum) {
+        accum_close(oldest);
+        free_accum = oldest;
+    }
+
+    memset(free_accum, 0, sizeof(*free_accum));
+    free_accum->used = true;
+    free_accum->rec.time = start;
+    free_accum->rec.span = BAND_ACTIVITY_SLOT_S;
+    free_accum->rec.band = band;
+
+    return free_accum;
+}
+
+/**
+ * Close the records ended before the grace time, in time order
+ */
+static void accums_close(uint32_t now) {
+    while (true) {
+        accum_t *oldest = NULL;
+
+        for (uint8_t i = 0; i < PENDING; i++) {
+            accum_t *accum = &pending[i];
+
+            if (accum->used && (!oldest || accum->rec.time < oldest->rec.time)) {
+                oldest = accum;
+            }
+        }
+        if (!oldest || oldest->rec.time + BAND_ACTIVITY_SLOT_S + BAND_ACTIVITY_GRACE_S > now) {
+            break;
+        }
+        accum_close(oldest);
+    }
+}
+
+static void * band_activity_thread(void *arg) {
+    set_thread_name("band_activity");
+
+    uint32_t version = 0;
+
+    while (true) {
+        sleep_usec(1000000);
+
+        uint32_t    now = time(NULL);
+        uint32_t    slot = now / BAND_ACTIVITY_SLOT_S * BAND_ACTIVITY_SLOT_S;
+        uint64_t    freq = subject_get_int(cfg_cur.fg_freq) + subject_get_int(cfg_cur.lo_offset);
+        uint8_t     band = qso_log_freq_to_band(freq);
+
+        /* Not updated on TX */
+        uint32_t v = signals_read(&signals);
+
+        if (v != version) {
+            version = v;
+
+            if (band != BAND_OTHER) {
+                accum_t *accum = accum_get(slot, band);
+
+                accum->floor_sum += signals.floor;
+                accum->occupied_sum += signals.occupied;
+                accum->rec.rows++;
+            }
+        }
+
+        slot_event_t *event;
+
+        while ((event = ring_peek(ring))) {
+            uint32_t start = event->start / BAND_ACTIVITY_SLOT_S * BAND_ACTIVITY_SLOT_S;
+
+            if (band != BAND_OTHER && start + BAND_ACTIVITY_SLOT_S + BAND_ACTIVITY_GRACE_S > now) {
+                accum_t *accum = accum_get(start, band);
+
+                for (uint8_t i = 0; i < BAND_ACTIVITY_SNR_BINS; i++) {
+                    accum->rec.snr[i] += event->snr[i];
+                    accum->rec.decodes += event->snr[i];
+                }
+            }
+            ring_release(ring);
+        }
+
+        accums_close(now);
+
+        if (hour_start && now >= hour_start + HOUR_S + BAND_ACTIVITY_SLOT_S + BAND_ACTIVITY_GRACE_S) {
+            hours_close();
+        }
+    }
+    return NULL;
+}
+
+void band_activity_init() {
+    if (!band_activity_store_open(&slots_store, BAND_ACTIVITY_SLOTS_PATH, BAND_ACTIVITY_SLOTS_MAX)) {
+        LV_LOG_WARN("Band activity: can't open %s", BAND_ACTIVITY_SLOTS_PATH);
+    }
+    if (!band_activity_store_open(&hours_store, BAND_ACTIVITY_HOURS_PATH, BAND_ACTIVITY_HOURS_MAX)) {
+        LV_LOG_WARN("Band activity: can't open %s", BAND_ACTIVITY_HOURS_PATH);
+    }
+
+    ring = ring_create(sizeof(slot_event_t), RING_SIZE);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, band_activity_thread, NULL);
+    pthread_detach(thread);
+}
+
+void band_activity_flush() {
+    if (!ring) {
+        return;
+    }
+    band_activity_store_flush(&slots_store);
+    band_activity_store_flush(&hours_store);
+}
+
+size_t band_activity_query(band_activity_kind_t kind, uint32_t from, uint32_t to, uint8_t band,
+                           band_activity_record_t *out, size_t max)
+{
+    if (!ring) {
+        return 0;
+    }
+
+    band_activity_store_t *store = kind == BAND_ACTIVITY_HOURS ? &hours_store : &slots_store;
+
+    return band_activity_store_query(store, from, to, band, out, max);
+}
@@ -0,0 +1,61 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "band_activity_store.h"
+
+#include <stdint.h>
+
+/*
+ * Band activity over time, for a propagation view. The "band_activity"
+ * thread samples the noise floor and the occupied bins of the waterfall rows
+ * (signals.h) once a second and takes the FT8/FT4 slots of the decode thread
+ * from a ring. Samples of a band are summed to a record of BAND_ACTIVITY_SLOT_S,
+ * closed BAND_ACTIVITY_GRACE_S after its end for the late decodes, and to an
+ * hourly rollup. Records of known bands with any data go to the stores
+ * (band_activity_store.h), the blocks are flushed every hour.
+ */
+
+#define BAND_ACTIVITY_SLOT_S        15
+#define BAND_ACTIVITY_GRACE_S       10
+#define BAND_ACTIVITY_SLOTS_PATH    "/mnt/band_activity.x6ba"
+#define BAND_ACTIVITY_HOURS_PATH    "/mnt/band_activity_hours.x6ba"
+#define BAND_ACTIVITY_SLOTS_MAX     (16 * 1024 * 1024)
+#define BAND_ACTIVITY_HOURS_MAX     (1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BAND_ACTIVITY_SLOTS = 0,
+    BAND_ACTIVITY_HOURS,
+} band_activity_kind_t;
+
+void band_activity_init();
+
+/**
+ * Decodes of an FT8/FT4 slot by SNR bin, from the decode thread, lock-free
+ */
+void band_activity_slot(uint32_t start, const uint16_t *snr);
+
+/**
+ * Write the blocks, before power off
+ */
+void band_activity_flush();
+
+/**
+ * Closed records of from <= time < to, see band_activity_store_query(). Any thread
+ */
+size_t band_activity_query(band_activity_kind_t kind, uint32_t from, uint32_t to, uint8_t band,
+                           band_activity_record_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
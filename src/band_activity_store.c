@@ -0,0 +1,244 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "band_activity_store.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define HEADER_SIZE     16
+#define RECORD_SIZE     sizeof(band_activity_record_t)
+#define QUERY_CHUNK     32
+
+_Static_assert(sizeof(band_activity_record_t) == 32, "Band activity record size");
+
+uint8_t band_activity_snr_bin(int snr) {
+    if (snr < -20) {
+        return 0;
+    }
+
+    int bin = (snr + 25) / 5;
+
+    return bin >= BAND_ACTIVITY_SNR_BINS ? BAND_ACTIVITY_SNR_BINS - 1 : bin;
+}
+
+static uint16_t add_sat(uint16_t a, uint16_t b) {
+    uint32_t x = (uint32_t) a + b;
+
+    return x > UINT16_MAX ? UINT16_MAX : x;
+}
+
+void band_activity_rollup(band_activity_record_t *total, const band_activity_record_t *rec) {
+    uint32_t rows = (uint32_t) total->rows + rec->rows;
+
+    if (rows) {
+        total->floor = ((int32_t) total->floor * total->rows + (int32_t) rec->floor * rec->rows) / (int32_t) rows;
+        total->occupied = ((uint32_t) total->occupied * total->rows + (uint32_t) rec->occupied * rec->rows) / rows;
+    }
+    total->rows = add_sat(total->rows, rec->rows);
+    total->decodes = add_sat(total->decodes, rec->decodes);
+
+    for (uint8_t i = 0; i < BAND_ACTIVITY_SNR_BINS; i++) {
+        total->snr[i] = add_sat(total->snr[i], rec->snr[i]);
+    }
+}
+
+static void make_header(uint8_t *header) {
+    memset(header, 0, HEADER_SIZE);
+    memcpy(header, "X6BA", 4);
+    header[4] = BAND_ACTIVITY_VERSION;
+    header[5] = RECORD_SIZE;
+}
+
+/**
+ * Open the file of the path, start it over if it isn't ours
+ */
+static int file_open(const char *path, size_t *size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    uint8_t     header[HEADER_SIZE];
+    uint8_t     expected[HEADER_SIZE];
+    struct stat st;
+
+    make_header(expected);
+
+    if (fstat(fd, &st) == 0 && st.st_size >= HEADER_SIZE &&
+        pread(fd, header, HEADER_SIZE, 0) == HEADER_SIZE && memcmp(header, expected, HEADER_SIZE) == 0)
+    {
+        /* Drop the tail of a torn write */
+        *size = st.st_size - (st.st_size - HEADER_SIZE) % RECORD_SIZE;
+
+        if (*size != (size_t) st.st_size && ftruncate(fd, *size) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    if (ftruncate(fd, 0) < 0 || write(fd, expected, HEADER_SIZE) != HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+    *size = HEADER_SIZE;
+    return fd;
+}
+
+bool band_activity_store_open(band_activity_store_t *store, const char *path, size_t max_bytes) {
+    memset(store, 0, sizeof(*store));
+    pthread_mutex_init(&store->lock, NULL);
+    snprintf(store->path, sizeof(store->path), "%s", path);
+    snprintf(store->old_path, sizeof(store->old_path), "%s.1", path);
+    store->max_bytes = max_bytes;
+    store->fd = file_open(path, &store->size);
+
+    return store->fd >= 0;
+}
+
+void band_activity_store_close(band_activity_store_t *store) {
+    band_activity_store_flush(store);
+
+    pthread_mutex_lock(&store->lock);
+    if (store->fd >= 0) {
+        close(store->fd);
+        store->fd = -1;
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+static bool flush_locked(band_activity_store_t *store) {
+    size_t  bytes = store->block_used * RECORD_SIZE;
+    bool    res = true;
+
+    if (bytes == 0) {
+        return true;
+    }
+    if (store->fd >= 0 && store->size + bytes > store->max_bytes / 2) {
+        close(store->fd);
+        rename(store->path, store->old_path);
+        store->fd = file_open(store->path, &store->size);
+    }
+    if (store->fd < 0 || write(store->fd, store->block, bytes) != (ssize_t) bytes) {
+        res = false;
+    } else {
+        store->size += bytes;
+    }
+    store->block_used = 0;
+
+    return res;
+}
+
+bool band_activity_store_append(band_activity_store_t *store, const band_activity_record_t *rec) {
+    bool res = true;
+
+    pthread_mutex_lock(&store->lock);
+    store->block[store->block_used++] = *rec;
+
+    if (store->block_used == BAND_ACTIVITY_BLOCK) {
+        res = flush_locked(store);
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return res;
+}
+
+bool band_activity_store_flush(band_activity_store_t *store) {
+    pthread_mutex_lock(&store->lock);
+    bool res = flush_locked(store);
+    pthread_mutex_unlock(&store->lock);
+
+    return res;
+}
+
+static bool record_match(const band_activity_record_t *rec, uint32_t from, uint32_t to, uint8_t band) {
+    return rec->time >= from && rec->time < to && (band == 0 || rec->band == band);
+}
+
+/**
+ * Records of a file, the first one at or after from is found by bisection
+ */
+static size_t query_file(int fd, size_t size, uint32_t from, uint32_t to, uint8_t band,
+                         band_activity_record_t *out, size_t max)
+{
+    size_t                  lo = 0;
+    size_t                  hi = (size - HEADER_SIZE) / RECORD_SIZE;
+    size_t                  total = hi;
+    band_activity_record_t  rec;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (pread(fd, &rec, RECORD_SIZE, HEADER_SIZE + mid * RECORD_SIZE) != RECORD_SIZE) {
+            return 0;
+        }
+        if (rec.time < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    band_activity_record_t  chunk[QUERY_CHUNK];
+    size_t                  n = 0;
+
+    while (lo < total && n < max) {
+        size_t  count = total - lo < QUERY_CHUNK ? total - lo : QUERY_CHUNK;
+        ssize_t res = pread(fd, chunk, count * RECORD_SIZE, HEADER_SIZE + lo * RECORD_SIZE);
+
+        if (res != (ssize_t) (count * RECORD_SIZE)) {
+            break;
+        }
+        for (size_t i = 0; i < count && n < max; i++) {
+            if (chunk[i].time >= to) {
+                return n;
+            }
+            if (record_match(&chunk[i], from, to, band)) {
+                out[n++] = chunk[i];
+            }
+        }
+        lo += count;
+    }
+    return n;
+}
+
+size_t band_activity_store_query(band_activity_store_t *store, uint32_t from, uint32_t to, uint8_t band,
+                                 band_activity_record_t *out, size_t max)
+{
+    size_t n = 0;
+
+    pthread_mutex_lock(&store->lock);
+
+    int old_fd = open(store->old_path, O_RDONLY | O_CLOEXEC);
+
+    if (old_fd >= 0) {
+        struct stat st;
+
+        if (fstat(old_fd, &st) == 0 && st.st_size > HEADER_SIZE) {
+            n += query_file(old_fd, st.st_size, from, to, band, out, max);
+        }
+        close(old_fd);
+    }
+    if (store->fd >= 0) {
+        n += query_file(store->fd, store->size, from, to, band, out + n, max - n);
+    }
+    for (uint16_t i = 0; i < store->block_used && n < max; i++) {
+        if (record_match(&store->block[i], from, to, band)) {
+            out[n++] = store->block[i];
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    return n;
+}
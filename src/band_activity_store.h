@@ -0,0 +1,89 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only file of fixed size band activity records, in time order. New
+ * records are kept in a block of BAND_ACTIVITY_BLOCK and written with one
+ * write() when it's full or flushed. The file starts with a 16 bytes header
+ * ("X6BA", u8 version, u8 record size, zeros). At the half of max_bytes it's
+ * renamed to "<path>.1" (replacing the previous one) and a new one is started,
+ * queries read both. Any thread, the lock is held for the append and the query.
+ */
+
+#define BAND_ACTIVITY_VERSION   1
+#define BAND_ACTIVITY_BLOCK     128         /* Records, 4 KB */
+#define BAND_ACTIVITY_SNR_BINS  8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct __attribute__((packed)) {
+    uint32_t    time;           /* Unix time of the interval start */
+    uint16_t    span;           /* s, length of the interval */
+    uint8_t     band;           /* m, qso_log_band_t */
+    uint8_t     reserved;
+    uint16_t    decodes;        /* FT8/FT4 */
+    uint16_t    snr[BAND_ACTIVITY_SNR_BINS];    /* Decodes by SNR, see band_activity_snr_bin() */
+    int16_t     floor;          /* 0.1 dB, average noise floor of the waterfall rows */
+    uint16_t    occupied;       /* 1/1000 of the bins, average of the rows */
+    uint16_t    rows;           /* Waterfall rows sampled */
+} band_activity_record_t;
+
+typedef struct {
+    pthread_mutex_t         lock;
+    char                    path[64];
+    char                    old_path[68];
+    size_t                  max_bytes;
+    int                     fd;
+    size_t                  size;           /* Of the file */
+    band_activity_record_t  block[BAND_ACTIVITY_BLOCK];
+    uint16_t                block_used;
+} band_activity_store_t;
+
+/**
+ * Bin of the SNR: below -20 dB, 5 dB bins from -20 dB, 10 dB and over
+ */
+uint8_t band_activity_snr_bin(int snr);
+
+/**
+ * Add the record of an interval to the record of a longer one, the time,
+ * span and band of it are left to the caller
+ */
+void band_activity_rollup(band_activity_record_t *total, const band_activity_record_t *rec);
+
+/**
+ * Open or create the file, a file of another format is started over
+ */
+bool band_activity_store_open(band_activity_store_t *store, const char *path, size_t max_bytes);
+void band_activity_store_close(band_activity_store_t *store);
+
+/**
+ * Add to the block, it's written when full. False if the write failed, the
+ * block is dropped then
+ */
+bool band_activity_store_append(band_activity_store_t *store, const band_activity_record_t *rec);
+bool band_activity_store_flush(band_activity_store_t *store);
+
+/**
+ * Records of from <= time < to, of the band or all of them with band 0, up to
+ * max. Returns their number
+ */
+size_t band_activity_store_query(band_activity_store_t *store, uint32_t from, uint32_t to, uint8_t band,
+                                 band_activity_record_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,301 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "band_sweep.h"
+
+#include "cfg/cfg.h"
+#include "memory_scan.h"
+#include "radio.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define IQ_SPAN_HZ      100000
+#define TIMER_MS        50
+#define DWELL_MS        2000        /* Normal RX between hops */
+#define SETTLE_ROWS     4           /* Rows skipped after a retune */
+#define AVG_ROWS        4
+#define HOP_TIMEOUT_MS  3000
+
+typedef enum {
+    HOP_IDLE = 0,
+    HOP_SETTLE,
+    HOP_CAPTURE,
+    HOP_DONE,
+    HOP_RETURN,
+} hop_state_t;
+
+typedef struct {
+    uint64_t    time;               /* 0 if not captured */
+    float       db[BAND_SWEEP_TILE_BINS];
+} tile_t;
+
+/* UI thread */
+static tile_t               tiles[BAND_SWEEP_MAX_TILES];
+static uint16_t             tiles_count = 0;
+static uint32_t             range_from = 0;
+static uint32_t             range_to = 0;
+static lv_timer_t           *timer = NULL;
+static band_sweep_update_t  update_cb = NULL;
+static uint64_t             hop_time = 0;       /* Last change of the hop state */
+static int16_t              hop_tile = -1;
+static int32_t              hop_fg_freq;
+
+/* Set by the UI thread, moved along by the DSP */
+static atomic_int           hop_state = HOP_IDLE;
+
+/* DSP thread */
+static hop_state_t          seen_state = HOP_IDLE;
+static uint8_t              rows;
+static float                acc[BAND_SWEEP_TILE_BINS];
+
+static uint32_t tile_center(uint16_t i) {
+    return range_from + i * BAND_SWEEP_TILE_HZ + BAND_SWEEP_TILE_HZ / 2;
+}
+
+static void hop_return() {
+    radio_set_freq(subject_get_int(cfg_cur.fg_freq));
+    atomic_store(&hop_state, HOP_RETURN);
+    hop_time = get_time();
+    hop_tile = -1;
+}
+
+/**
+ * Stalest tile out of the TTL, -1 if all are fresh
+ */
+static int16_t stale_tile(uint64_t now) {
+    int16_t res = -1;
+
+    for (uint16_t i = 0; i < tiles_count; i++) {
+        if (tiles[i].time && now - tiles[i].time < BAND_SWEEP_TTL_MS) {
+            continue;
+        }
+        if (res < 0 || tiles[i].time < tiles[res].time) {
+            res = i;
+        }
+    }
+    return res;
+}
+
+static void hop_done() {
+    /* The VFO was tuned during the hop, the rows may be of any freq */
+    if (subject_get_int(cfg_cur.fg_freq) == hop_fg_freq) {
+        tile_t *tile = &tiles[hop_tile];
+
+        for (uint16_t i = 0; i < BAND_SWEEP_TILE_BINS; i++) {
+            tile->db[i] = acc[i] / AVG_ROWS;
+        }
+        tile->time = get_time();
+    }
+    hop_return();
+
+    if (update_cb) {
+        update_cb();
+    }
+}
+
+static void timer_cb(lv_timer_t *t) {
+    uint64_t    now = get_time();
+    int         state = atomic_load_explicit(&hop_state, memory_order_acquire);
+
+    switch (state) {
+        case HOP_IDLE:
+            if (now - hop_time < DWELL_MS || radio_get_state() != RADIO_RX || memory_scan_running()) {
+                break;
+            }
+
+            int16_t tile = stale_tile(now);
+
+            if (tile < 0) {
+                break;
+            }
+            hop_tile = tile;
+            hop_fg_freq = subject_get_int(cfg_cur.fg_freq);
+            hop_time = now;
+            radio_set_freq(tile_center(tile));
+            atomic_store_explicit(&hop_state, HOP_SETTLE, memory_order_release);
+            break;
+
+        case HOP_SETTLE:
+        case HOP_CAPTURE:
+            if (radio_get_state() != RADIO_RX || now - hop_time > HOP_TIMEOUT_MS) {
+                hop_return();
+            }
+            break;
+
+        case HOP_DONE:
+            hop_done();
+            break;
+
+        case HOP_RETURN:
+            /* The DSP is stopped or the display is off, rows are rare */
+            if (now - hop_time > HOP_TIMEOUT_MS) {
+                atomic_store(&hop_state, HOP_IDLE);
+                hop_time = now;
+            }
+            break;
+    }
+}
+
+void band_sweep_start(uint32_t from, uint32_t to, band_sweep_update_t cb) {
+    uint32_t max = from + BAND_SWEEP_MAX_TILES * BAND_SWEEP_TILE_HZ;
+
+    if (to > max) {
+        to = max;
+    }
+    if (from != range_from || to != range_to) {
+        range_from = from;
+        range_to = to;
+        tiles_count = (to - from + BAND_SWEEP_TILE_HZ - 1) / BAND_SWEEP_TILE_HZ;
+        memset(tiles, 0, sizeof(tiles));
+    }
+
+    update_cb = cb;
+    hop_time = get_time();
+
+    if (!timer) {
+        timer = lv_timer_create(timer_cb, TIMER_MS, NULL);
+    }
+}
+
+void band_sweep_stop() {
+    if (!timer) {
+        return;
+    }
+    lv_timer_del(timer);
+    timer = NULL;
+    update_cb = NULL;
+
+    int state = atomic_load(&hop_state);
+
+    if (state != HOP_IDLE && state != HOP_RETURN) {
+        hop_return();
+    }
+}
+
+void band_sweep_refresh() {
+    for (uint16_t i = 0; i < tiles_count; i++) {
+        tiles[i].time = 0;
+    }
+}
+
+void band_sweep_get(float *db, uint16_t size, band_sweep_info_t *info) {
+    uint64_t now = get_time();
+    uint32_t bins = tiles_count * BAND_SWEEP_TILE_BINS;
+
+    for (uint16_t x = 0; x < size; x++) {
+        uint32_t    from = (uint64_t) bins * x / size;
+        uint32_t    to = (uint64_t) bins * (x + 1) / size;
+        float       peak = NAN;
+
+        if (to <= from) {
+            to = from + 1;
+        }
+
+        for (uint32_t n = from; n < to && n < bins; n++) {
+            tile_t *tile = &tiles[n / BAND_SWEEP_TILE_BINS];
+
+            if (!tile->time) {
+                continue;
+            }
+
+            float v = tile->db[n % BAND_SWEEP_TILE_BINS];
+
+            if (isnan(peak) || v > peak) {
+                peak = v;
+            }
+        }
+        db[x] = peak;
+    }
+
+    if (info) {
+        info->from = range_from;
+        info->to = range_from + tiles_count * BAND_SWEEP_TILE_HZ;
+        info->tiles = tiles_count;
+        info->fresh = 0;
+
+        for (uint16_t i = 0; i < tiles_count; i++) {
+            if (tiles[i].time && now - tiles[i].time < BAND_SWEEP_TTL_MS) {
+                info->fresh++;
+            }
+        }
+    }
+}
+
+/* DSP thread */
+
+bool band_sweep_hopping() {
+    return atomic_load_explicit(&hop_state, memory_order_relaxed) != HOP_IDLE;
+}
+
+static void accumulate(const float *psd, uint16_t size) {
+    uint32_t first = (uint32_t) size * (IQ_SPAN_HZ - BAND_SWEEP_TILE_HZ) / 2 / IQ_SPAN_HZ;
+    uint32_t len = (uint32_t) size * BAND_SWEEP_TILE_HZ / IQ_SPAN_HZ;
+
+    for (uint16_t i = 0; i < BAND_SWEEP_TILE_BINS; i++) {
+        uint32_t    from = first + len * i / BAND_SWEEP_TILE_BINS;
+        uint32_t    to = first + len * (i + 1) / BAND_SWEEP_TILE_BINS;
+        float       peak = psd[from];
+
+        for (uint32_t n = from + 1; n < to; n++) {
+            if (psd[n] > peak) {
+                peak = psd[n];
+            }
+        }
+        acc[i] += peak;
+    }
+}
+
+static void advance(hop_state_t from, hop_state_t to) {
+    int expected = from;
+
+    /* The UI thread may have cut the hop short meanwhile */
+    if (atomic_compare_exchange_strong_explicit(&hop_state, &expected, to, memory_order_release, memory_order_relaxed)) {
+        seen_state = to;
+        rows = 0;
+    }
+}
+
+void band_sweep_put_psd(const float *psd, uint16_t size) {
+    hop_state_t state = atomic_load_explicit(&hop_state, memory_order_acquire);
+
+    if (state != seen_state) {
+        seen_state = state;
+        rows = 0;
+    }
+
+    switch (state) {
+        case HOP_SETTLE:
+            if (++rows >= SETTLE_ROWS) {
+                memset(acc, 0, sizeof(acc));
+                advance(HOP_SETTLE, HOP_CAPTURE);
+            }
+            break;
+
+        case HOP_CAPTURE:
+            accumulate(psd, size);
+
+            if (++rows >= AVG_ROWS) {
+                advance(HOP_CAPTURE, HOP_DONE);
+            }
+            break;
+
+        case HOP_RETURN:
+            if (++rows >= SETTLE_ROWS) {
+                advance(HOP_RETURN, HOP_IDLE);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Band-wide occupancy from the 100 kHz IQ span. The range is split into tiles,
+ * every few seconds of normal RX the radio hops to the stalest tile, the DSP
+ * averages a few waterfall PSDs of it and the radio returns to the VFO freq.
+ * Tiles are kept with their time, only the ones older than BAND_SWEEP_TTL_MS
+ * are captured again. Rows of a hop don't reach the displays, the audio of a
+ * hop is heard. No hops on TX, a hop is cut short when TX starts.
+ */
+
+#define BAND_SWEEP_TILE_HZ      80000       /* Middle of the span, the edges are filtered */
+#define BAND_SWEEP_TILE_BINS    64          /* Peak of the PSD bins in each */
+#define BAND_SWEEP_MAX_TILES    64
+#define BAND_SWEEP_TTL_MS       (60 * 1000)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t    from;
+    uint32_t    to;
+    uint16_t    tiles;
+    uint16_t    fresh;          /* Captured within the TTL */
+} band_sweep_info_t;
+
+typedef void (*band_sweep_update_t)();
+
+/**
+ * Sweep from..to (clamped to BAND_SWEEP_MAX_TILES), called on the UI thread.
+ * Tiles of the same range are kept from the last run. The callback is called
+ * on the UI thread after each captured tile
+ */
+void band_sweep_start(uint32_t from, uint32_t to, band_sweep_update_t update_cb);
+void band_sweep_stop();
+
+/**
+ * Make all tiles stale
+ */
+void band_sweep_refresh();
+
+/**
+ * Stitched dB values of the range, NAN where no tile was captured yet
+ */
+void band_sweep_get(float *db, uint16_t size, band_sweep_info_t *info);
+
+/**
+ * The radio is away from the VFO freq, called by the DSP
+ */
+bool band_sweep_hopping();
+
+/**
+ * Waterfall PSD of RX while hopping, called by the DSP
+ */
+void band_sweep_put_psd(const float *psd, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
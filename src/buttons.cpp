@@ -21,6 +21,7 @@ extern "C" {
     #include "msg.h"
     #include "pannel.h"
     #include "params/params.h"
+    #include "cfg/profile.h"
     #include "voice.h"
     #include "pubsub_ids.h"
 }
@@ -41,6 +42,7 @@ static void button_app_page_cb(button_item_t *item);
 static void button_vol_update_cb(button_item_t *item);
 static void button_mfk_update_cb(button_item_t *item);
 static void button_mem_load_cb(button_item_t *item);
+static void button_profile_apply_cb(button_item_t *item);
 
 static void param_changed_cb(void * s, lv_msg_t * m);
 static void label_update_cb(Subject *subj, void *user_data);
@@ -48,6 +50,7 @@ static void label_update_cb(Subject *subj, void *user_data);
 static void button_vol_hold_cb(button_item_t *item);
 static void button_mfk_hold_cb(button_item_t *item);
 static void button_mem_save_cb(button_item_t *item);
+static void button_profile_save_cb(button_item_t *item);
 
 // Label getters
 
@@ -134,6 +137,11 @@ static button_item_t make_mem_btn(const char *name, int32_t data) {
         .type = BTN_TEXT, .label = name, .press = button_mem_load_cb, .hold = button_mem_save_cb, .data = data};
 }
 
+static button_item_t make_profile_btn(const char *name) {
+    return button_item_t{
+        .type = BTN_TEXT, .label = name, .press = button_profile_apply_cb, .hold = button_profile_save_cb};
+}
+
 static button_item_t make_app_btn(const char *name, press_action_t data) {
     return button_item_t{.type = BTN_TEXT, .label = name, .press = button_app_page_cb, .hold = nullptr, .data = data};
 }
@@ -223,6 +231,13 @@ static button_item_t btn_mem_6 = make_mem_btn("Set 6", 6);
 static button_item_t btn_mem_7 = make_mem_btn("Set 7", 7);
 static button_item_t btn_mem_8 = make_mem_btn("Set 8", 8);
 
+/* MEM page 3 */
+
+static button_item_t btn_mem_scan = make_action_btn("Scan", ACTION_MEM_SCAN);
+static button_item_t btn_profile_1 = make_profile_btn("Contest");
+static button_item_t btn_profile_2 = make_profile_btn("Digital");
+static button_item_t btn_profile_3 = make_profile_btn("Ragchew");
+
 /* CW */
 
 static button_item_t btn_key_speed  = make_btn(key_speed_label_getter, MFK_KEY_SPEED);
@@ -302,13 +317,11 @@ static button_item_t btn_callsign = make_action_btn("Callsign", ACTION_APP_CALLS
 static button_item_t btn_settings = make_app_btn("Settings", ACTION_APP_SETTINGS);
 
 static button_item_t  btn_wifi   = make_app_btn("WiFi", ACTION_APP_WIFI);
+static button_item_t  btn_sweep  = make_app_btn("Band\nSweep", ACTION_APP_BAND_SWEEP);
 
 /* RTTY */
-static button_item_t btn_rtty_p1 = {
-    .type  = BTN_TEXT,
-    .label = "(RTTY 1:1)",
-    .press = NULL,
-};
+static button_item_t btn_rtty_p1 = make_page_btn("(RTTY 1:2)", "Teletype|page 1");
+static button_item_t btn_rtty_p2 = make_page_btn("(RTTY 2:2)", "Teletype|page 2");
 static button_item_t btn_rtty_rate = {
     .type  = BTN_TEXT,
     .label = "Rate",
@@ -333,6 +346,18 @@ static button_item_t btn_rtty_reverse = {
     .press = button_mfk_update_cb,
     .data  = MFK_RTTY_REVERSE,
 };
+static button_item_t btn_rtty_multi = {
+    .type  = BTN_TEXT,
+    .label = "Multi",
+    .press = button_mfk_update_cb,
+    .data  = MFK_RTTY_MULTI,
+};
+static button_item_t btn_rtty_channel = {
+    .type  = BTN_TEXT,
+    .label = "Channel",
+    .press = button_mfk_update_cb,
+    .data  = MFK_RTTY_CHANNEL,
+};
 
 
 /* VOL pages */
@@ -371,8 +396,9 @@ static buttons_page_t page_mfk_4 = {
 
 /* MEM pages */
 
-static button_item_t btn_mem_p1 = make_page_btn("(MEM 1:2)", "Memory|page 1");
-static button_item_t btn_mem_p2 = make_page_btn("(MEM 2:2)", "Memory|page 2");
+static button_item_t btn_mem_p1 = make_page_btn("(MEM 1:3)", "Memory|page 1");
+static button_item_t btn_mem_p2 = make_page_btn("(MEM 2:3)", "Memory|page 2");
+static button_item_t btn_mem_p3 = make_page_btn("(MEM 3:3)", "Memory|page 3");
 
 static buttons_page_t page_mem_1 = {
     {&btn_mem_p1, &btn_mem_1, &btn_mem_2, &btn_mem_3, &btn_mem_4}
@@ -380,6 +406,9 @@ static buttons_page_t page_mem_1 = {
 static buttons_page_t page_mem_2 = {
     {&btn_mem_p2, &btn_mem_5, &btn_mem_6, &btn_mem_7, &btn_mem_8}
 };
+static buttons_page_t page_mem_3 = {
+    {&btn_mem_p3, &btn_mem_scan, &btn_profile_1, &btn_profile_2, &btn_profile_3}
+};
 
 /* KEY pages */
 static button_item_t btn_key_p1 = make_page_btn("(KEY 1:2)", "Key|page 1");
@@ -432,7 +461,7 @@ static buttons_page_t page_app_2 = {
     {&btn_app_p2, &btn_rec, &btn_qth, &btn_callsign, &btn_settings}
 };
 static buttons_page_t page_app_3 = {
-    {&btn_app_p3, &btn_wifi}
+    {&btn_app_p3, &btn_wifi, &btn_sweep}
 };
 
 /* RTTY */
@@ -440,6 +469,9 @@ static buttons_page_t page_app_3 = {
 buttons_page_t buttons_page_rtty = {
     {&btn_rtty_p1, &btn_rtty_rate, &btn_rtty_shift, &btn_rtty_center, &btn_rtty_reverse}
 };
+static buttons_page_t page_rtty_2 = {
+    {&btn_rtty_p2, &btn_rtty_multi, &btn_rtty_channel}
+};
 
 buttons_group_t buttons_group_gen = {
     &buttons_page_vol_1,
@@ -477,6 +509,12 @@ buttons_group_t buttons_group_dfl = {
 buttons_group_t buttons_group_vm = {
     &page_mem_1,
     &page_mem_2,
+    &page_mem_3,
+};
+
+static buttons_group_t group_rtty = {
+    &buttons_page_rtty,
+    &page_rtty_2,
 };
 
 static struct {
@@ -489,6 +527,7 @@ static struct {
     {buttons_group_dfn, ARRAY_SIZE(buttons_group_dfn)},
     {buttons_group_dfl, ARRAY_SIZE(buttons_group_dfl)},
     {buttons_group_vm,  ARRAY_SIZE(buttons_group_vm) },
+    {group_rtty,        ARRAY_SIZE(group_rtty)       },
 };
 
 void buttons_init(lv_obj_t *parent) {
@@ -715,6 +754,24 @@ static void button_mem_save_cb(button_item_t *item) {
     voice_say_text_fmt("Memory %i stored", item->data);
 }
 
+static void button_profile_apply_cb(button_item_t *item) {
+    int changed = cfg_profile_apply(item->label);
+
+    if (changed < 0) {
+        msg_update_text_fmt("Profile %s is not stored", item->label);
+    } else {
+        msg_update_text_fmt("Profile %s: %i changes", item->label, changed);
+        voice_say_text_fmt("Profile %s", item->label);
+    }
+}
+
+static void button_profile_save_cb(button_item_t *item) {
+    if (cfg_profile_save(item->label) == 0) {
+        msg_update_text_fmt("Profile %s stored", item->label);
+        voice_say_text_fmt("Profile %s stored", item->label);
+    }
+}
+
 void buttons_press(uint8_t n, bool hold) {
     button_item_t *item = btn[n].item;
     if (item == NULL) {
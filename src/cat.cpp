@@ -12,13 +12,17 @@
 
 #include "cat.h"
 
+#include "cat.private.hpp"
+#include "cat_frame.hpp"
+#include "cat_record.hpp"
+#include "cat_state.h"
 #include "cfg/subjects.h"
 #include "util.hpp"
 #include "util.h"
 
+#include <atomic>
 #include <mutex>
 #include <thread>
-#include <vector>
 
 extern "C" {
     // #include "cfg/cfg.h"
@@ -34,252 +38,191 @@ extern "C" {
 
     #include "lvgl/lvgl.h"
     #include <aether_radio/x6100_control/low/gpio.h>
+    #include <errno.h>
     #include <fcntl.h>
     #include <stdio.h>
     #include <stdlib.h>
     #include <string.h>
+    #include <sys/eventfd.h>
+    #include <sys/ioctl.h>
     #include <sys/poll.h>
     #include <termios.h>
+    #include <time.h>
     #include <unistd.h>
 }
 
 
-#define FRAME_PRE 0xFE
-#define FRAME_END 0xFD
-
-#define CODE_OK 0xFB
-#define CODE_NG 0xFA
-
-#define LOCAL_ADDRESS 0xA4
-
-#define C_SND_FREQ 0x00      /* Send frequency data  transceive mode does not ack*/
-#define C_SND_MODE 0x01      /* Send mode data, Sc  for transceive mode does not ack */
-#define C_RD_BAND 0x02       /* Read band edge frequencies */
-#define C_RD_FREQ 0x03       /* Read display frequency */
-#define C_RD_MODE 0x04       /* Read display mode */
-#define C_SET_FREQ 0x05      /* Set frequency data(1) */
-#define C_SET_MODE 0x06      /* Set mode data, Sc */
-#define C_SET_VFO 0x07       /* Set VFO */
-#define C_SET_MEM 0x08       /* Set channel, Sc(2) */
-#define C_WR_MEM 0x09        /* Write memory */
-#define C_MEM2VFO 0x0a       /* Memory to VFO */
-#define C_CLR_MEM 0x0b       /* Memory clear */
-#define C_RD_OFFS 0x0c       /* Read duplex offset frequency; default changes with HF/6M/2M */
-#define C_SET_OFFS 0x0d      /* Set duplex offset frequency */
-#define C_CTL_SCAN 0x0e      /* Control scan, Sc */
-#define C_CTL_SPLT 0x0f      /* Control split, and duplex mode Sc */
-#define C_SET_TS 0x10        /* Set tuning step, Sc */
-#define C_CTL_ATT 0x11       /* Set/get attenuator, Sc */
-#define C_CTL_ANT 0x12       /* Set/get antenna, Sc */
-#define C_CTL_ANN 0x13       /* Control announce (speech synth.), Sc */
-#define C_CTL_LVL 0x14       /* Set AF/RF/squelch, Sc */
-#define C_RD_SQSM 0x15       /* Read squelch condition/S-meter level, Sc */
-#define C_CTL_FUNC 0x16      /* Function settings (AGC,NB,etc.), Sc */
-#define C_SND_CW 0x17        /* Send CW message */
-#define C_SET_PWR 0x18       /* Set Power ON/OFF, Sc */
-#define C_RD_TRXID 0x19      /* Read transceiver ID code */
-#define C_CTL_MEM 0x1a       /* Misc memory/bank/rig control functions, Sc */
-#define C_SET_TONE 0x1b      /* Set tone frequency */
-#define C_CTL_PTT 0x1c       /* Control Transmit On/Off, Sc */
-#define C_CTL_EDGE 0x1e      /* Band edges */
-#define C_CTL_DVT 0x1f       /* Digital modes calsigns & messages */
-#define C_CTL_DIG 0x20       /* Digital modes settings & status */
-#define C_CTL_RIT 0x21       /* RIT/XIT control */
-#define C_CTL_DSD 0x22       /* D-STAR Data */
-#define C_SEND_SEL_FREQ 0x25 /* Send/Recv sel/unsel VFO frequency */
-#define C_SEND_SEL_MODE 0x26
-#define C_CTL_SCP 0x27   /* Scope control & data */
-#define C_SND_VOICE 0x28 /* Transmit Voice Memory Contents */
-#define C_CTL_MTEXT 0x70 /* Microtelecom Extension */
-#define C_CTL_MISC 0x7f  /* Miscellaneous control, Sc */
-
-#define S_VFOA 0x00      /* Set to VFO A */
-#define S_VFOB 0x01      /* Set to VFO B */
-#define S_BTOA 0xa0      /* VFO A=B */
-#define S_XCHNG 0xb0     /* Switch VFO A and B */
-#define S_SUBTOMAIN 0xb1 /* MAIN = SUB */
-#define S_DUAL_OFF 0xc0  /* Dual watch off */
-#define S_DUAL_ON 0xc1   /* Dual watch on */
-#define S_DUAL 0xc2      /* Dual watch (0 = off, 1 = on) */
-#define S_MAIN 0xd0      /* Select MAIN band */
-#define S_SUB 0xd1       /* Select SUB band */
-#define S_SUB_SEL 0xd2   /* Read/Set Main/Sub selection */
-#define S_FRONTWIN 0xe0  /* Select front window */
-
-// modes
-#define M_LSB 0x00
-#define M_USB 0x01
-#define M_AM 0x02
-#define M_CW 0x03
-#define M_NFM 0x05
-#define M_CWR 0x07
-
-// memory/bank/rig control
-#define MEM_BS_REG 0x01 /* Get band stacking register */
-#define MEM_IF_FW 0x03  /* Get IF filter width */
-#define MEM_LOCK 0x05   /* LOCK status */
-#define MEM_DM_FG 0x06  /* Get data mode switch and filter group */
-
-#define FRAME_ADD_LEN 5 /* Header and end len */
-
-static TSQueue<std::vector<char>> send_queue;
-
-static void send_waterfall_data();
-
-static void on_fg_freq_change(Subject *s, void *user_data);
-
-struct Frame {
-    uint8_t dst_addr;
-    uint8_t src_addr;
-    uint8_t command;
-    std::vector<uint8_t> data;
-
-    Frame(uint8_t dst, uint8_t src, uint8_t command): dst_addr(dst), src_addr(src), command(command) {};
-
-    Frame(const char * data, const uint16_t len): data(len - FRAME_ADD_LEN - 1) {
-        dst_addr = data[2];
-        src_addr = data[3];
-        command = data[4];
-        std::copy(&data[5], &data[len - 1], this->data.begin());
-    };
-
-    Frame(const Frame *req) {
-        // Swap address
-        dst_addr = req->src_addr;
-        src_addr = LOCAL_ADDRESS;
-        command  = req->command;
-        data = req->data;
-    }
+const int32_t cat_baud_rates[CAT_BAUD_RATES] = {
+    4800, 9600, 19200, 38400, 57600, 115200, 230400
+};
 
-    void log(const char *prefix=nullptr) const {
-        char buf[512];
-        char *buf_ptr = buf;
-        buf_ptr += sprintf(buf_ptr, "[%02X:%02X:", FRAME_PRE, FRAME_PRE);
-        buf_ptr += sprintf(buf_ptr, "%02X:", dst_addr);
-        buf_ptr += sprintf(buf_ptr, "%02X]-", src_addr);
-        buf_ptr += sprintf(buf_ptr, "[%02X:", command);
-        uint16_t remain_len = data.size();
-        size_t i = 0;
-        while (remain_len) {
-            buf_ptr += sprintf(buf_ptr, "%02X:", data[i++]);
-            remain_len--;
-        }
-        buf_ptr += sprintf(buf_ptr - 1, "]-[%02X]", FRAME_END);
-        *(buf_ptr - 1) = '\0';
-        if (prefix) {
-            LV_LOG_USER("%s\t: %s\t(Len %i)", prefix, buf, data.size() + FRAME_ADD_LEN + 1);
-        } else {
-            LV_LOG_USER("%s\t(Len %i)", buf, data.size() + FRAME_ADD_LEN + 1);
-        }
-    }
+static const speed_t baud_speeds[CAT_BAUD_RATES] = {
+    B4800, B9600, B19200, B38400, B57600, B115200, B230400
+};
 
-    void set_code(uint8_t code) {
-        set_payload_len(1);
-        command = code;
-    }
+const uint16_t cat_transceive_periods[CAT_TRANSCEIVE_PERIODS] = {
+    10, 50, 100, 200
+};
 
-    void set_payload_len(size_t len) {
-        data.resize(len - 1);
-    }
+static std::atomic<bool>          echo{true};          /* Repeat requests, as a CI-V bus does */
 
-    size_t get_len() const {
-        return data.size() + 1 + FRAME_ADD_LEN;
-    }
+static CatTxRing                  tx_ring;
+static CatRecorder                recorder;
+static bool                       flushed = true;      /* UART took all data of tx_ring */
+static int                        send_event = -1;     /* Signalled on tx_ring push by other threads */
 
-    std::vector<char> dump() const {
-        std::vector<char> buf(data.size() + 1 + FRAME_ADD_LEN);
-        buf[0] = FRAME_PRE;
-        buf[1] = FRAME_PRE;
-        buf[2] = dst_addr;
-        buf[3] = src_addr;
-        buf[4] = command;
-        std::copy(data.begin(), data.end(), buf.begin() + 5);
-        *--buf.end() = FRAME_END;
-        return buf;
-    }
+static std::mutex                 latency_mux;
+static cat_latency_stats_t        latency;
+
+static const uint32_t latency_bounds[CAT_LATENCY_BUCKETS - 1] = {
+    100, 250, 500, 1000, 2000, 5000, 10000, 20000
 };
 
+/*
+ * Scope wave data, as IC-7300 sends it over USB: 475 points of 0..160 in 11
+ * frames (header and 10 divisions). DSP thread quantizes the waterfall PSD at
+ * the client selected speed, the CAT thread sends one frame at a time when
+ * the UART output is almost drained. A sweep, which is not started by the
+ * time the next one is ready, is skipped.
+ */
+#define SCOPE_POINTS        475
+#define SCOPE_DIVISION      50
+#define SCOPE_FRAMES        11
+#define SCOPE_AMP           160
+#define SCOPE_BACKLOG       64      /* Bytes in UART output to send next frame, ~33 ms at 19200 */
+#define SCOPE_POLL_MS       10
+
+static const uint16_t       scope_periods[3] = {400, 1000, 2000};  /* Fast, mid, slow */
+
+static std::atomic<bool>    scope_on{false};
+static std::atomic<bool>    scope_wave{false};
+static std::atomic<uint8_t> scope_speed{1};
+
+static std::mutex           scope_mux;
+static uint8_t              scope_ready[SCOPE_POINTS];
+static int32_t              scope_ready_center;
+static bool                 scope_ready_new = false;
+
+/* CAT thread only */
+static uint8_t              scope_points[SCOPE_POINTS];
+static int32_t              scope_center;
+static uint8_t              scope_seq = 0;                          /* Next frame, 0 if idle */
+
+/*
+ * Transceive notifications of the freq and mode. A change only marks them, the
+ * CAT thread puts the latest values, when the UART output is almost drained and
+ * cfg.cat_transceive ms passed since the previous ones. Spinning the VFO doesn't
+ * queue stale frames ahead of the answers to requests.
+ */
+#define TRANSCEIVE_FREQ     (1 << 0)
+#define TRANSCEIVE_MODE     (1 << 1)
+#define TRANSCEIVE_BACKLOG  64      /* Bytes in UART output to send the notifications */
+
+static std::atomic<uint8_t>  transceive_req{0};
+static std::atomic<uint16_t> transceive_ms{50};
+static uint64_t              transceive_time = 0;  /* CAT thread only */
+
+static void on_state_change(const cat_state_t *prev, const cat_state_t *cur);
+static void on_cat_baud_change(Subject *subj, void *user_data);
+static void on_cat_echo_change(Subject *subj, void *user_data);
+static void on_cat_transceive_change(Subject *subj, void *user_data);
+
+static void frame_log(const CatFrame &frame, const char *prefix=nullptr) {
+    char buf[512];
+    char *buf_ptr = buf;
+    buf_ptr += sprintf(buf_ptr, "[%02X:%02X:", FRAME_PRE, FRAME_PRE);
+    buf_ptr += sprintf(buf_ptr, "%02X:", frame.dst_addr);
+    buf_ptr += sprintf(buf_ptr, "%02X]-", frame.src_addr);
+    buf_ptr += sprintf(buf_ptr, "[%02X:", frame.command);
+    size_t remain_len = LV_MIN(frame.len, 100);
+    size_t i = 0;
+    while (remain_len) {
+        buf_ptr += sprintf(buf_ptr, "%02X:", frame.data[i++]);
+        remain_len--;
+    }
+    buf_ptr += sprintf(buf_ptr - 1, "]-[%02X]", FRAME_END);
+    *(buf_ptr - 1) = '\0';
+    if (prefix) {
+        LV_LOG_USER("%s\t: %s\t(Len %i)", prefix, buf, frame.raw_len);
+    } else {
+        LV_LOG_USER("%s\t(Len %i)", buf, frame.raw_len);
+    }
+}
 
 class Connection {
     int        fd;
-    char       buf[1024];
-    const char header[2] = {FRAME_PRE, FRAME_PRE};
-    size_t     start=0;
-    size_t     end=0;
-
-  protected:
-    void write_buf(const char *buf, size_t len) {
-        ssize_t l;
-        while (len) {
-            l = write(fd, buf, len);
-            if (l < 0) {
-                perror("Error during writing message");
-                return;
-            }
-            len -= l;
-        }
-    }
+    CatParser  parser;
 
   public:
     Connection(int fd) : fd(fd) {}
-    Frame *feed() {
-        if (start) {
-            end -= start;
-            memmove(buf, buf + start, end);
-            start = 0;
+    int get_fd() const {
+        return fd;
+    }
+
+    /**
+     * Read available data. Returns false if there is nothing to read
+     */
+    bool read_data() {
+        size_t  len;
+        uint8_t *buf = parser.space(&len);
+
+        if (len == 0) {
+            return false;
         }
-        while (1) {
-            int res = read(fd, buf + end, sizeof(buf) - end);
-            if (res < 0) {
-                return nullptr;
-            }
-            if (res > 0) {
-                end += res;
-            }
-            char *frame_start = (char *)memmem(buf, end, header, sizeof(header));
-            if (frame_start == NULL) {
-                // Move last byte to begin
-                buf[0] = buf[end - 1];
-                end    = 1;
-                return nullptr;
-            }
-            if (frame_start != buf) {
-                end = end + buf - frame_start;
-                memmove(buf, frame_start, end);
-                start = 0;
-            }
-            if (end >= FRAME_ADD_LEN) {
-                char *end_pos = (char *)memchr(buf + FRAME_ADD_LEN, FRAME_END, end - FRAME_ADD_LEN);
-                if (end_pos) {
-                    size_t frame_len = end_pos - buf + 1;
-                    start            = frame_len;
-                    end              = start;
-                    return new Frame(buf, frame_len);
-                }
-            }
+
+        int res = read(fd, buf, len);
+
+        if (res <= 0) {
+            return false;
         }
+        parser.commit(res);
+        recorder.put(CAT_RECORD_RX, buf, res);
+        return true;
     }
 
-    void send(const char * data, size_t len) {
-        write_buf(data, len);
+    bool next(CatFrame *frame) {
+        return parser.next(frame);
     }
-    void send(const Frame * frame) {
-        auto data = frame->dump();
-        write_buf(data.data(), frame->get_len());
+
+    /**
+     * Bytes not sent yet by the UART driver
+     */
+    size_t out_queue() const {
+        int n = 0;
+
+        if (ioctl(fd, TIOCOUTQ, &n) < 0) {
+            return 0;
+        }
+        return n;
+    }
+
+    /**
+     * Write pending data of the ring. Returns false if the UART can't take all of it now
+     */
+    bool flush(CatTxRing &ring) {
+        const uint8_t *data;
+        size_t        len;
+
+        while ((len = ring.peek(&data))) {
+            ssize_t l = write(fd, data, len);
+
+            if (l < 0) {
+                if (errno == EAGAIN) {
+                    return false;
+                }
+                perror("Error during writing message");
+                ring.clear();
+                return true;
+            }
+            recorder.put(CAT_RECORD_TX, data, l);
+            ring.consume(l);
+        }
+        return true;
     }
 };
 
 static Connection *conn;
 
-typedef struct {
-    uint8_t start[2];
-    uint8_t dst_addr;
-    uint8_t src_addr;
-    uint8_t command;
-    uint8_t subcommand;
-    uint8_t args[1500];
-} frame_t;
-
 static void set_vfo(void *arg) {
     if (!arg) {
         LV_LOG_ERROR("arg is NULL");
@@ -346,9 +289,9 @@ static uint8_t x_mode_2_ci_mode(x6100_mode_t mode, bool *data_mode=nullptr) {
     }
 }
 
-static uint8_t get_if_bandwidth() {
-    uint32_t bw = subject_get_int(cfg_cur.filter.bw);
-    switch (subject_get_int(cfg_cur.mode)) {
+static uint8_t get_if_bandwidth(const cat_state_t &st) {
+    uint32_t bw = st.filter_bw;
+    switch (st.mode) {
         case x6100_mode_cw:
         case x6100_mode_cwr:
         case x6100_mode_lsb:
@@ -403,65 +346,72 @@ static uint8_t freq_step_to_ci(int32_t val) {
     return 0x02;
 }
 
-static void set_unsupported(const Frame *req, Frame *resp) {
-    req->log("unsupported");
-    resp->set_code(CODE_NG);
+static void set_unsupported(const CatFrame &req, CatResponse &resp) {
+    frame_log(req, "unsupported");
+    resp.set_code(CODE_NG);
 }
 
-static Frame *process_req(const Frame *req) {
-    auto resp = new Frame(req);
+static void process_req(const CatFrame &req, CatResponse &resp) {
+    cat_state_t    st;
+
+    cat_state_read(&st);
 
     int32_t        new_freq;
-    x6100_vfo_t    cur_vfo    = (x6100_vfo_t)subject_get_int(cfg_cur.band->vfo.val);
-    int32_t        cur_freq   = subject_get_int(cfg_cur.fg_freq);
-    x6100_mode_t   cur_mode   = (x6100_mode_t)subject_get_int(cfg_cur.mode);
+    x6100_vfo_t    cur_vfo    = (x6100_vfo_t)st.vfo;
+    int32_t        cur_freq   = st.fg_freq;
+    x6100_mode_t   cur_mode   = (x6100_mode_t)st.mode;
     x6100_vfo_t    target_vfo = cur_vfo;
     uint8_t        vfo_id;
 
-    size_t data_size = req->data.size();
+    size_t data_size = req.len;
 
     struct vfo_params *vfo_params[2];
+    uint8_t           vfo_idx[2];   /* Index in the state */
     if (cur_vfo == X6100_VFO_A) {
         vfo_params[0] = &cfg_cur.band->vfo_a;
         vfo_params[1] = &cfg_cur.band->vfo_b;
+        vfo_idx[0] = 0;
+        vfo_idx[1] = 1;
     } else {
         vfo_params[0] = &cfg_cur.band->vfo_b;
         vfo_params[1] = &cfg_cur.band->vfo_a;
+        vfo_idx[0] = 1;
+        vfo_idx[1] = 0;
     }
 
 #if 0
-    req->log("req");
+    frame_log(req, "req");
 #endif
 
-    switch (req->command) {
+    switch (req.command) {
         case C_SND_FREQ:
             if (data_size == 5) {
-                subject_set_int(cfg_cur.fg_freq, from_bcd(req->data.data(), 10));
-                resp->set_code(CODE_OK);
+                subject_set_int(cfg_cur.fg_freq, from_bcd(req.data, 10));
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
             break;
 
         case C_RD_FREQ:
-            resp->set_payload_len(6);
+            resp.set_payload_len(6);
             // bcd len - 5 bytes
-            to_bcd(resp->data.data(), cur_freq, 10);
+            to_bcd(resp.data, cur_freq, 10);
             break;
 
         case C_RD_MODE:
             {
                 uint8_t v = x_mode_2_ci_mode(cur_mode);
-                resp->set_payload_len(3);
-                resp->data[0] = v;
-                resp->data[1] = v;
+                resp.set_payload_len(3);
+                resp.data[0] = v;
+                resp.data[1] = v;
             }
             break;
 
         case C_SET_FREQ:
             if (data_size == 5) {
-                subject_set_int(cfg_cur.fg_freq, from_bcd(req->data.data(), 10));
-                resp->set_code(CODE_OK);
+                subject_set_int(cfg_cur.fg_freq, from_bcd(req.data, 10));
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
@@ -469,9 +419,9 @@ static Frame *process_req(const Frame *req) {
 
         case C_SET_MODE:
             if (data_size == 2) {
-                subject_set_int(cfg_cur.mode, ci_mode_2_x_mode(req->data[0]));
-                // filter selector -> req->data[1]
-                resp->set_code(CODE_OK);
+                subject_set_int(cfg_cur.mode, ci_mode_2_x_mode(req.data[0]));
+                // filter selector -> req.data[1]
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
@@ -480,14 +430,14 @@ static Frame *process_req(const Frame *req) {
         case C_SET_VFO:
             if (data_size == 1) {
                 x6100_vfo_t new_vfo;
-                switch (req->data[0]) {
+                switch (req.data[0]) {
                     case S_VFOA:
                         if (cur_vfo != X6100_VFO_A) {
                             new_vfo = X6100_VFO_A;
                             subject_set_int(cfg_cur.band->vfo.val, new_vfo);
                         }
 
-                        resp->set_code(CODE_OK);
+                        resp.set_code(CODE_OK);
                         break;
 
                     case S_VFOB:
@@ -495,7 +445,7 @@ static Frame *process_req(const Frame *req) {
                             new_vfo = X6100_VFO_B;
                             subject_set_int(cfg_cur.band->vfo.val, new_vfo);
                         }
-                        resp->set_code(CODE_OK);
+                        resp.set_code(CODE_OK);
                         break;
 
                     case S_XCHNG:
@@ -505,12 +455,12 @@ static Frame *process_req(const Frame *req) {
                             new_vfo = X6100_VFO_A;
                         }
                         subject_set_int(cfg_cur.band->vfo.val, new_vfo);
-                        resp->set_code(CODE_OK);
+                        resp.set_code(CODE_OK);
                         break;
 
                     case S_BTOA:
                         cfg_band_vfo_copy();
-                        resp->set_code(CODE_OK);
+                        resp.set_code(CODE_OK);
                         break;
 
                     default:
@@ -518,8 +468,8 @@ static Frame *process_req(const Frame *req) {
                         break;
                 }
             } else if (data_size == 0) {
-                resp->set_payload_len(2);
-                resp->data[0] = cur_vfo == X6100_VFO_A ? S_VFOA : S_VFOB;
+                resp.set_payload_len(2);
+                resp.data[0] = cur_vfo == X6100_VFO_A ? S_VFOA : S_VFOB;
             } else {
                 set_unsupported(req, resp);
             }
@@ -527,11 +477,11 @@ static Frame *process_req(const Frame *req) {
 
         case C_CTL_SPLT:
             if (data_size == 0) {
-                resp->set_payload_len(2);
-                resp->data[0] = subject_get_int(cfg_cur.band->split.val);
+                resp.set_payload_len(2);
+                resp.data[0] = st.split;
             } else if (data_size == 1) {
-                subject_set_int(cfg_cur.band->split.val, req->data[0]);
-                resp->set_code(CODE_OK);
+                subject_set_int(cfg_cur.band->split.val, req.data[0]);
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
@@ -539,11 +489,11 @@ static Frame *process_req(const Frame *req) {
 
         case C_SET_TS:
             if (data_size == 0) {
-                resp->set_payload_len(2);
-                resp->data[0] = freq_step_to_ci(subject_get_int(cfg_cur.freq_step));
+                resp.set_payload_len(2);
+                resp.data[0] = freq_step_to_ci(st.freq_step);
             } else if (data_size == 1) {
-                subject_set_int(cfg_cur.freq_step, freq_step_from_ci(resp->data[0]));
-                resp->set_code(CODE_OK);
+                subject_set_int(cfg_cur.freq_step, freq_step_from_ci(resp.data[0]));
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
@@ -551,11 +501,11 @@ static Frame *process_req(const Frame *req) {
 
         case C_CTL_ATT:
             if (data_size == 0) {
-                resp->set_payload_len(2);
-                resp->data[0] = subject_get_int(cfg_cur.att) * 0x20;
+                resp.set_payload_len(2);
+                resp.data[0] = st.att * 0x20;
             } else if (data_size == 1) {
-                subject_set_int(cfg_cur.att, req->data[0]);
-                resp->set_code(CODE_OK);
+                subject_set_int(cfg_cur.att, req.data[0]);
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
@@ -563,47 +513,47 @@ static Frame *process_req(const Frame *req) {
 
         case C_CTL_LVL:
             if (data_size >= 1) {
-                switch(req->data[0]) {
+                switch(req.data[0]) {
                     case 0x01:
                         // VOL
                         if (data_size == 1) {
-                            resp->set_payload_len(4);
-                            to_bcd_be(&resp->data[1], subject_get_int(cfg.vol.val) * 255 / 55, 3);
+                            resp.set_payload_len(4);
+                            to_bcd_be(&resp.data[1], st.vol * 255 / 55, 3);
                         } else if (data_size == 3) {
-                            subject_set_int(cfg.vol.val, from_bcd_be(&req->data[1], 3) * 55 / 255);
+                            subject_set_int(cfg.vol.val, from_bcd_be(&req.data[1], 3) * 55 / 255);
                         }
                         break;
                     case 0x02:
                         // RFG
                         if (data_size == 1) {
-                            resp->set_payload_len(4);
-                            to_bcd_be(&resp->data[1], subject_get_int(cfg_cur.band->rfg.val) * 255 / 100, 3);
+                            resp.set_payload_len(4);
+                            to_bcd_be(&resp.data[1], st.rfg * 255 / 100, 3);
                         } else if (data_size == 3) {
-                            subject_set_int(cfg_cur.band->rfg.val, from_bcd_be(&req->data[1], 3) * 100 / 255);
+                            subject_set_int(cfg_cur.band->rfg.val, from_bcd_be(&req.data[1], 3) * 100 / 255);
                         }
                         break;
                     case 0x03:
                         // Squelch
                         if (data_size == 1) {
-                            resp->set_payload_len(4);
-                            to_bcd_be(&resp->data[1], subject_get_int(cfg.sql.val) * 255 / 100, 3);
+                            resp.set_payload_len(4);
+                            to_bcd_be(&resp.data[1], st.sql * 255 / 100, 3);
                         } else if (data_size == 3) {
-                            subject_set_int(cfg.sql.val, from_bcd_be(&req->data[1], 3) * 100 / 255);
+                            subject_set_int(cfg.sql.val, from_bcd_be(&req.data[1], 3) * 100 / 255);
                         }
                         break;
                     case 0x0a:
                         // PWR
                         if (data_size == 1) {
-                            resp->set_payload_len(4);
-                            to_bcd_be(&resp->data[1], subject_get_float(cfg.pwr.val) * 255 / 10, 3);
+                            resp.set_payload_len(4);
+                            to_bcd_be(&resp.data[1], st.pwr * 255 / 10, 3);
                         } else if (data_size == 3) {
-                            subject_set_float(cfg.pwr.val, (from_bcd_be(&req->data[1], 3) * 100 / 255) / 10.0f);
+                            subject_set_float(cfg.pwr.val, (from_bcd_be(&req.data[1], 3) * 100 / 255) / 10.0f);
                         }
                         break;
                     case 0x15:
                         // Monitor level
-                        resp->set_payload_len(4);
-                        to_bcd_be(&resp->data[1], params.moni * 255 / 100, 3);
+                        resp.set_payload_len(4);
+                        to_bcd_be(&resp.data[1], params.moni * 255 / 100, 3);
                         break;
                     default:
                         set_unsupported(req, resp);
@@ -620,7 +570,7 @@ static Frame *process_req(const Frame *req) {
                 static uint8_t msg_id;
                 tx_info_refresh(&msg_id, &alc, &pwr, &swr);
                 uint8_t val;
-                switch (req->data[0]) {
+                switch (req.data[0]) {
                     case 0x02: // S-meter
                         {
                             int16_t db = meter_get_raw_db();
@@ -629,94 +579,94 @@ static Frame *process_req(const Frame *req) {
                             } else {
                                 val = (db - S9) * 2 + 120;
                             }
-                            resp->set_payload_len(4);
-                            to_bcd_be(&resp->data[1], val, 3);
+                            resp.set_payload_len(4);
+                            to_bcd_be(&resp.data[1], val, 3);
                         }
                         break;
                     case 0x11:  // Power
                         val = -pwr * pwr + 35 * pwr;
-                        resp->set_payload_len(4);
-                        to_bcd_be(&resp->data[1], val, 3);
+                        resp.set_payload_len(4);
+                        to_bcd_be(&resp.data[1], val, 3);
                         break;
                     case 0x12:  // SWR
                         val = -21 * swr * swr + 134 * swr - 122;
-                        resp->set_payload_len(4);
-                        to_bcd_be(&resp->data[1], val, 3);
+                        resp.set_payload_len(4);
+                        to_bcd_be(&resp.data[1], val, 3);
                         break;
                     case 0x13:  // ALC
                         val = alc * 120 / 10;
-                        resp->set_payload_len(4);
-                        to_bcd_be(&resp->data[1], val, 3);
+                        resp.set_payload_len(4);
+                        to_bcd_be(&resp.data[1], val, 3);
                         break;
                     default:
-                        resp->set_code(CODE_NG);
+                        resp.set_code(CODE_NG);
                         break;
                 }
             } else {
-                resp->set_code(CODE_NG);
+                resp.set_code(CODE_NG);
             }
             break;
 
         case C_CTL_FUNC:
             if ((data_size == 1) || (data_size == 2)) {
-                switch (req->data[0]) {
+                switch (req.data[0]) {
                     case 0x02:
                         // PRE
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = subject_get_int(cfg_cur.pre);
+                            resp.set_payload_len(3);
+                            resp.data[1] = st.pre;
                         } else {
-                            subject_set_int(cfg_cur.pre, req->data[1] > 0);
-                            resp->set_code(CODE_OK);
+                            subject_set_int(cfg_cur.pre, req.data[1] > 0);
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x22:
                         // NB
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = subject_get_int(cfg.nb.val);
+                            resp.set_payload_len(3);
+                            resp.data[1] = st.nb;
                         } else {
-                            subject_set_int(cfg.nb.val, req->data[1]);
-                            resp->set_code(CODE_OK);
+                            subject_set_int(cfg.nb.val, req.data[1]);
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x40:
                         // NR
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = subject_get_int(cfg.nr.val);
+                            resp.set_payload_len(3);
+                            resp.data[1] = st.nr;
                         } else {
-                            subject_set_int(cfg.nr.val, req->data[1]);
-                            resp->set_code(CODE_OK);
+                            subject_set_int(cfg.nr.val, req.data[1]);
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x44:
                         // COMP
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = 0x00;
+                            resp.set_payload_len(3);
+                            resp.data[1] = 0x00;
                         } else {
                             // COMP set is not suported yet
-                            resp->set_code(CODE_OK);
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x45:
                         // Monitor [MONI] On/off
-                        resp->set_code(CODE_NG);
+                        resp.set_code(CODE_NG);
                         break;
                     case 0x46:
                         // VOX
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = 0x00;
+                            resp.set_payload_len(3);
+                            resp.data[1] = 0x00;
                         } else {
                             // VOX set is not suported yet
-                            resp->set_code(CODE_OK);
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x5D:
                         // Tone squelch function
-                        resp->set_code(CODE_NG);
+                        resp.set_code(CODE_NG);
                         break;
                     default:
                         set_unsupported(req, resp);
@@ -727,28 +677,28 @@ static Frame *process_req(const Frame *req) {
             break;
 
         case C_RD_TRXID:
-            if ((data_size == 1) && (req->data[0] == 0)) {
-                resp->set_payload_len(3);
-                resp->data[1] = 0xA4;
+            if ((data_size == 1) && (req.data[0] == 0)) {
+                resp.set_payload_len(3);
+                resp.data[1] = 0xA4;
             }
             break;
 
         case C_CTL_MEM:
             // TODO: Implement another options
             if (data_size == 1) {
-                switch (req->data[0]) {
+                switch (req.data[0]) {
                     case MEM_IF_FW:
-                        resp->set_payload_len(3);
-                        resp->data[1] = get_if_bandwidth();
+                        resp.set_payload_len(3);
+                        resp.data[1] = get_if_bandwidth(st);
                         break;
 
                     case MEM_DM_FG:
-                        resp->set_payload_len(5);
-                        resp->data[1] = x_mode_2_ci_mode(cur_mode);
+                        resp.set_payload_len(5);
+                        resp.data[1] = x_mode_2_ci_mode(cur_mode);
                         // data mode
-                        resp->data[2] = (cur_mode == x6100_mode_lsb_dig) || (cur_mode == x6100_mode_usb_dig);
+                        resp.data[2] = (cur_mode == x6100_mode_lsb_dig) || (cur_mode == x6100_mode_usb_dig);
                         // filter group
-                        resp->data[3] = 0;
+                        resp.data[3] = 0;
                         break;
 
                     default:
@@ -756,15 +706,15 @@ static Frame *process_req(const Frame *req) {
                         break;
                 }
             } else {
-                switch (req->data[0]) {
+                switch (req.data[0]) {
                     case MEM_LOCK:  // Various controls for icom, unsupported
-                        resp->set_code(CODE_NG);
+                        resp.set_code(CODE_NG);
                         break;
                     case MEM_DM_FG:
                         {
-                            x6100_mode_t new_mode  = ci_mode_2_x_mode(req->data[1], req->data[2]);
+                            x6100_mode_t new_mode  = ci_mode_2_x_mode(req.data[1], req.data[2]);
                             subject_set_int(cfg_cur.mode, new_mode);
-                            resp->set_code(CODE_OK);
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     default:
@@ -775,12 +725,12 @@ static Frame *process_req(const Frame *req) {
             break;
 
         case C_CTL_PTT:
-            if ((data_size >= 1) && (req->data[0] == 0x00)) {
+            if ((data_size >= 1) && (req.data[0] == 0x00)) {
                 if (data_size == 1) {
-                    resp->set_payload_len(3);
-                    resp->data[1] = (radio_get_state() == RADIO_RX) ? 0 : 1;
+                    resp.set_payload_len(3);
+                    resp.data[1] = (radio_get_state() == RADIO_RX) ? 0 : 1;
                 } else {
-                    switch (req->data[1]) {
+                    switch (req.data[1]) {
                         case 0:
                             radio_set_ptt(false);
                             break;
@@ -789,23 +739,23 @@ static Frame *process_req(const Frame *req) {
                             radio_set_ptt(true);
                             break;
                     }
-                    resp->set_payload_len(3);
-                    resp->data[1] = CODE_OK;
+                    resp.set_payload_len(3);
+                    resp.data[1] = CODE_OK;
                 }
             }
             break;
 
         case C_SEND_SEL_FREQ:
             if (data_size == 1) {
-                vfo_id       = req->data[0] > 0;
-                int32_t freq = subject_get_int(vfo_params[vfo_id]->freq.val);
-                resp->set_payload_len(7);
-                to_bcd(&resp->data[1], freq, 10);
+                vfo_id       = req.data[0] > 0;
+                int32_t freq = st.vfo_freq[vfo_idx[vfo_id]];
+                resp.set_payload_len(7);
+                to_bcd(&resp.data[1], freq, 10);
             } else if (data_size == 6) {
-                vfo_id       = req->data[0] > 0;
-                int32_t freq = from_bcd(&req->data[1], 10);
+                vfo_id       = req.data[0] > 0;
+                int32_t freq = from_bcd(&req.data[1], 10);
                 subject_set_int(vfo_params[vfo_id]->freq.val, freq);
-                resp->set_code(CODE_OK);
+                resp.set_code(CODE_OK);
             } else {
                 set_unsupported(req, resp);
             }
@@ -818,26 +768,26 @@ static Frame *process_req(const Frame *req) {
                 bool data_mode = false;
                 switch (data_size) {
                     case 1:
-                        vfo_id    = req->data[0] > 0;
-                        v = x_mode_2_ci_mode((x6100_mode_t)subject_get_int(vfo_params[vfo_id]->mode.val), &data_mode);
-                        resp->set_payload_len(5);
-                        resp->data[1] = v;
-                        resp->data[2] = data_mode;
+                        vfo_id    = req.data[0] > 0;
+                        v = x_mode_2_ci_mode((x6100_mode_t)st.vfo_mode[vfo_idx[vfo_id]], &data_mode);
+                        resp.set_payload_len(5);
+                        resp.data[1] = v;
+                        resp.data[2] = data_mode;
                         // filter
-                        resp->data[3] = 1;
+                        resp.data[3] = 1;
                         break;
 
                     case 4:
                         // get filter
                     case 3:
                         // get data
-                        data_mode = req->data[2];
+                        data_mode = req.data[2];
                     case 2:
                         // get mode
-                        vfo_id                = req->data[0] > 0;
-                        new_mode = ci_mode_2_x_mode(req->data[1], data_mode);
+                        vfo_id                = req.data[0] > 0;
+                        new_mode = ci_mode_2_x_mode(req.data[1], data_mode);
                         subject_set_int(vfo_params[vfo_id]->mode.val, new_mode);
-                        resp->set_code(CODE_OK);
+                        resp.set_code(CODE_OK);
                         break;
                     default:
                         set_unsupported(req, resp);
@@ -849,58 +799,68 @@ static Frame *process_req(const Frame *req) {
 
         case C_CTL_SCP:
             if (data_size >= 1) {
-                switch (req->data[0]) {
+                switch (req.data[0]) {
                     case 0x10:  // Send/read the Scope ON/OFF status
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = 1;
+                            resp.set_payload_len(3);
+                            resp.data[1] = scope_on;
                         } else {
-                            resp->set_payload_len(2);
+                            scope_on = req.data[1];
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x11:  // Send/read the Scope wave data output*4
                         if (data_size == 1) {
-                            resp->set_payload_len(3);
-                            resp->data[1] = 1;
+                            resp.set_payload_len(3);
+                            resp.data[1] = scope_wave;
                         } else {
-                            resp->set_payload_len(2);
+                            scope_wave = req.data[1];
+                            resp.set_code(CODE_OK);
                         }
                         break;
                     case 0x13:  // Single/Dual scope setting
-                        resp->set_code(CODE_NG);
+                        resp.set_code(CODE_NG);
                         break;
                     case 0x14:  // Send/read the Scope Center mode or Fixed mode setting
                         if (data_size == 1) {
                             // Report center mode
-                            resp->set_payload_len(4);
-                            resp->data[1] = 0;
-                            resp->data[2] = 0;
+                            resp.set_payload_len(4);
+                            resp.data[1] = 0;
+                            resp.data[2] = 0;
                         } else {
-                            resp->set_payload_len(2);
+                            resp.set_payload_len(2);
                         }
                         break;
                     case 0x15:  // Scope span settings
-                        if (req->data[2] == FRAME_END) {
+                        if (req.data[2] == FRAME_END) {
                             // Span +- 50kHz
-                            resp->set_payload_len(8);
-                            to_bcd(&resp->data[1] + 1, 50000, 10);
+                            resp.set_payload_len(8);
+                            to_bcd(&resp.data[1] + 1, 50000, 10);
                         } else {
-                            resp->set_payload_len(2);
+                            resp.set_payload_len(2);
                         }
                         break;
                     case 0x17:  // Scope hold function
-                        resp->set_code(CODE_NG);
+                        resp.set_code(CODE_NG);
                         break;
                     case 0x19:
-                        resp->set_payload_len(6);
-                        resp->data[1] = 0;
-                        resp->data[2] = 0;
-                        resp->data[3] = 0;
-                        resp->data[4] = 0;
+                        resp.set_payload_len(6);
+                        resp.data[1] = 0;
+                        resp.data[2] = 0;
+                        resp.data[3] = 0;
+                        resp.data[4] = 0;
                         break;
                     case 0x1A:
-                        // Sweep speed setting
-                        resp->set_code(CODE_NG);
+                        // Sweep speed setting: main/sub, fast/mid/slow
+                        if (data_size == 2) {
+                            resp.set_payload_len(4);
+                            resp.data[2] = scope_speed;
+                        } else if (data_size == 3 && req.data[2] <= 2) {
+                            scope_speed = req.data[2];
+                            resp.set_code(CODE_OK);
+                        } else {
+                            set_unsupported(req, resp);
+                        }
                         break;
                     default:
                         set_unsupported(req, resp);
@@ -915,77 +875,293 @@ static Frame *process_req(const Frame *req) {
             set_unsupported(req, resp);
             break;
     }
-    // send_waterfall_data();
-    return resp;
 }
 
-static uint8_t counter = 0;
-
-// static void send_waterfall_data() {
-//     frame_t frame;
-//     counter++;
-//     if (counter < 10) {
-//         return;
-//     }
-//     counter          = 0;
-//     uint8_t *data    = (uint8_t *)malloc(1024);
-//     frame.dst_addr   = 0x00;
-//     frame.src_addr   = LOCAL_ADDRESS;
-//     frame.command    = C_CTL_SCP;
-//     frame.subcommand = 0;
-//     uint8_t i        = 0;
-//     // main
-//     frame.args[i++] = 0;
-//     // SequenceNumber[01-11]
-//     frame.args[i++] = 1;
-//     // TotalSeqneuceSize[01=LAN, 11=USB]
-//     frame.args[i++] = 1;
-//     // Center/Fixed (for lan radio)  [00=cent, 01=fixed]
-//     frame.args[i++] = 0;
-//     // Center freq
-//     to_bcd(frame.args + i, subject_get_int(cfg_cur.fg_freq), 10);
-//     i += 5;
-//     // Span
-//     to_bcd(frame.args + i, 50000, 10);
-//     i += 5;
-//     // Range information 00 = In range, 01 = Out of range
-//     frame.args[i++] = 0;
-//     // FFT data
-//     // printf("%u\n", i);
-//     size_t c;
-//     for (c = 0; c < 300; c++) {
-//         frame.args[i + c] = c % 160;
-//     }
-//     // printf("%u, %u\n", i, c);
-//     send_frame(&frame, i + c + 3);
-//     // printf("len: %u\n", i+c);
-//     free(data);
-// }
+void cat_process(const CatFrame &req, CatResponse &resp) {
+    static std::mutex process_mux;
+
+    std::lock_guard<std::mutex> lock(process_mux);
+
+    resp.reply_to(req, LOCAL_ADDRESS);
+    process_req(req, resp);
+}
+
+bool cat_command(uint8_t command, const uint8_t *data, size_t len, CatResponse *resp) {
+    CatFrame    req = {LOCAL_ADDRESS, 0xE0, command, data, len, nullptr, len + 1 + FRAME_ADD_LEN};
+    CatResponse tmp;
+
+    if (!resp) {
+        resp = &tmp;
+    }
+    cat_process(req, *resp);
+
+    return resp->command != CODE_NG;
+}
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void latency_put(uint32_t us) {
+    uint8_t bucket = 0;
+
+    while (bucket < CAT_LATENCY_BUCKETS - 1 && us >= latency_bounds[bucket]) {
+        bucket++;
+    }
+
+    std::lock_guard<std::mutex> lock(latency_mux);
+
+    latency.requests++;
+    latency.buckets[bucket]++;
+    latency.sum_us += us;
+    latency.max_us = LV_MAX(latency.max_us, us);
+}
+
+static void wake_cat_thread() {
+    uint64_t val = 1;
+
+    if (send_event >= 0 && write(send_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("CAT send event");
+    }
+}
+
+/**
+ * Put the pending transceive notifications, when it's time for them. Returns poll timeout
+ */
+static int transceive_send() {
+    uint16_t period = transceive_ms;
+
+    if (!transceive_req || !period) {
+        return -1;
+    }
+
+    uint64_t now = get_time();
+
+    if (now - transceive_time < period) {
+        return period - (now - transceive_time);
+    }
+    if (tx_ring.pending() + conn->out_queue() > TRANSCEIVE_BACKLOG) {
+        return SCOPE_POLL_MS;
+    }
+
+    uint8_t     req = transceive_req.exchange(0);
+    uint8_t     dropped = 0;
+    cat_state_t st;
+
+    cat_state_read(&st);
+
+    if (req & TRANSCEIVE_FREQ) {
+        CatResponse frame{0, LOCAL_ADDRESS, C_SND_FREQ};
+
+        // bcd len - 5 bytes
+        frame.set_payload_len(6);
+        to_bcd(frame.data, st.fg_freq, 10);
+
+        if (!tx_ring.put(frame)) {
+            dropped |= TRANSCEIVE_FREQ;
+        }
+    }
+    if (req & TRANSCEIVE_MODE) {
+        CatResponse frame{0, LOCAL_ADDRESS, C_SND_MODE};
+        uint8_t     v = x_mode_2_ci_mode((x6100_mode_t) st.mode);
+
+        // As the answer to C_RD_MODE
+        frame.set_payload_len(3);
+        frame.data[0] = v;
+        frame.data[1] = v;
+
+        if (!tx_ring.put(frame)) {
+            dropped |= TRANSCEIVE_MODE;
+        }
+    }
+    flushed = conn->flush(tx_ring);
+    transceive_time = now;
+
+    if (dropped) {
+        /* Kept pending, the next try sends the latest values */
+        LV_LOG_WARN("CAT TX ring is full, transceive notification postponed");
+        transceive_req |= dropped;
+        return SCOPE_POLL_MS;
+    }
+    return -1;
+}
+
+void cat_scope_data(const float *psd, uint16_t size) {
+    static uint64_t prev_time = 0;
+
+    if (!scope_on || !scope_wave) {
+        return;
+    }
+
+    uint64_t now = get_time();
+
+    if (now - prev_time < scope_periods[scope_speed]) {
+        return;
+    }
+    prev_time = now;
+
+    cat_state_t st;
+    cat_state_read(&st);
+
+    std::lock_guard<std::mutex> lock(scope_mux);
+
+    for (uint16_t i = 0; i < SCOPE_POINTS; i++) {
+        uint16_t from = i * size / SCOPE_POINTS;
+        uint16_t to = (i + 1) * size / SCOPE_POINTS;
+        float    peak = psd[from];
+
+        for (uint16_t n = from + 1; n < to; n++) {
+            peak = LV_MAX(peak, psd[n]);
+        }
+
+        float v = (peak - S_MIN) * SCOPE_AMP / (S9_40 - S_MIN);
+
+        scope_ready[i] = clip(v, 0.0f, (float) SCOPE_AMP);
+    }
+
+    scope_ready_center = st.fg_freq + subject_get_int(cfg_cur.lo_offset);
+    scope_ready_new = true;
+
+    wake_cat_thread();
+}
+
+/**
+ * Put the next scope frame, when the UART has time for it. Returns poll timeout
+ */
+static int scope_send() {
+    if (scope_seq == 0) {
+        std::lock_guard<std::mutex> lock(scope_mux);
+
+        if (!scope_ready_new) {
+            return -1;
+        }
+        memcpy(scope_points, scope_ready, sizeof(scope_points));
+        scope_center = scope_ready_center;
+        scope_ready_new = false;
+        scope_seq = 1;
+    }
+
+    if (!scope_on || !scope_wave) {
+        scope_seq = 0;
+        return -1;
+    }
+
+    while (scope_seq <= SCOPE_FRAMES) {
+        if (tx_ring.pending() + conn->out_queue() > SCOPE_BACKLOG) {
+            return SCOPE_POLL_MS;
+        }
+
+        CatResponse frame{0, LOCAL_ADDRESS, C_CTL_SCP};
+        size_t      n = 0;
+
+        frame.data[n++] = 0x00;                 /* Wave data */
+        frame.data[n++] = 0x00;                 /* Main scope */
+        to_bcd(&frame.data[n++], scope_seq, 2);
+        to_bcd(&frame.data[n++], SCOPE_FRAMES, 2);
+
+        if (scope_seq == 1) {
+            frame.data[n++] = 0x00;             /* Center mode */
+            to_bcd(&frame.data[n], scope_center, 10);
+            n += 5;
+            to_bcd(&frame.data[n], 50000, 10);  /* Span +- 50kHz */
+            n += 5;
+            frame.data[n++] = 0x00;             /* In range */
+        } else {
+            uint16_t from = (scope_seq - 2) * SCOPE_DIVISION;
+            uint16_t count = LV_MIN(SCOPE_DIVISION, SCOPE_POINTS - from);
+
+            memcpy(&frame.data[n], &scope_points[from], count);
+            n += count;
+        }
+        frame.len = n;
+
+        if (!tx_ring.put(frame)) {
+            return SCOPE_POLL_MS;
+        }
+        flushed = conn->flush(tx_ring);
+        scope_seq++;
+    }
+
+    scope_seq = 0;
+    return -1;
+}
 
 static void cat_thread() {
+    set_thread_name("cat");
+
+    struct pollfd fds[2];
+    CatFrame      req;
+    CatResponse   resp;
+    int           timeout = -1;
+
+    fds[0].fd = conn->get_fd();
+    fds[1].fd = send_event;
+    fds[1].events = POLLIN;
+
     while (true) {
-        bool sleep = true;
-
-        const Frame *req = conn->feed();
-        if (req) {
-            sleep = false;
-            conn->send(req);
-            auto resp = process_req(req);
-            // resp->log("resp");
-            conn->send(resp);
+        fds[0].events = flushed ? POLLIN : POLLIN | POLLOUT;
+
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("CAT poll: %s", strerror(errno));
+                sleep_usec(10000);
+            }
+            continue;
+        }
+
+        /* Frames are answered from the moment the data came */
+        uint64_t woke = now_us();
+
+        if (fds[0].revents & POLLIN) {
+            while (conn->read_data()) {
+                while (conn->next(&req)) {
+                    /* Echo and answer go out with one write */
+                    if (echo) {
+                        tx_ring.put(req.raw, req.raw_len);
+                    }
+                    cat_process(req, resp);
+                    tx_ring.put(resp);
+                    flushed = conn->flush(tx_ring);
+                    latency_put(now_us() - woke);
+                }
+            }
         }
 
-        while (!send_queue.empty()) {
-            sleep = false;
-            auto data = send_queue.pop();
-            conn->send(data.data(), data.size());
+        if (fds[1].revents & POLLIN) {
+            uint64_t val;
+
+            if (read(send_event, &val, sizeof(val)) < 0) {
+                LV_LOG_WARN("CAT send event");
+            }
         }
-        if (sleep) {
-            sleep_usec(10000);
+
+        flushed = conn->flush(tx_ring);
+
+        /* Notifications go ahead of the scope frames */
+        int transceive_timeout = transceive_send();
+        int scope_timeout = scope_send();
+
+        if (transceive_timeout < 0 || scope_timeout < 0) {
+            timeout = LV_MAX(transceive_timeout, scope_timeout);
+        } else {
+            timeout = LV_MIN(transceive_timeout, scope_timeout);
         }
     }
 }
 
+void cat_latency_stats(cat_latency_stats_t *stats, bool reset) {
+    std::lock_guard<std::mutex> lock(latency_mux);
+
+    *stats = latency;
+
+    if (reset) {
+        memset(&latency, 0, sizeof(latency));
+    }
+}
+
 void cat_init() {
     /* UART */
     x6100_gpio_set(x6100_pin_usb, 1); /* USB -> CAT */
@@ -996,11 +1172,6 @@ void cat_init() {
         struct termios attr;
 
         tcgetattr(fd, &attr);
-
-        cfsetispeed(&attr, B19200);
-        cfsetospeed(&attr, B19200);
-        // cfsetispeed(&attr, B115200);
-        // cfsetospeed(&attr, B115200);
         cfmakeraw(&attr);
 
         if (tcsetattr(fd, 0, &attr) < 0) {
@@ -1013,18 +1184,83 @@ void cat_init() {
 
     conn = new Connection(fd);
 
-    subject_add_observer(cfg_cur.fg_freq, on_fg_freq_change, NULL);
+    subject_add_observer_and_call(cfg.cat_baud.val, on_cat_baud_change, NULL);
+    subject_add_observer_and_call(cfg.cat_echo.val, on_cat_echo_change, NULL);
+    subject_add_observer_and_call(cfg.cat_transceive.val, on_cat_transceive_change, NULL);
+
+    send_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (send_event < 0) {
+        LV_LOG_ERROR("CAT send event");
+    }
+
+    cat_state_init();
+    cat_state_add_listener(on_state_change);
+
+    if (access(CAT_RECORD_MARKER, F_OK) == 0) {
+        cat_state_t st;
+
+        cat_state_read(&st);
+
+        if (recorder.open(CAT_RECORD_PATH, st)) {
+            LV_LOG_USER("CAT session recording to %s", CAT_RECORD_PATH);
+        } else {
+            LV_LOG_ERROR("Can't create CAT record %s", CAT_RECORD_PATH);
+        }
+    }
 
     /* * */
     std::thread thread(cat_thread);
     thread.detach();
 }
 
-static void on_fg_freq_change(Subject *s, void *user_data) {
-    int32_t new_freq = subject_get_int(s);
-    Frame frame{0, LOCAL_ADDRESS, C_SND_FREQ};
-    // bcd len - 5 bytes
-    frame.set_payload_len(6);
-    to_bcd(frame.data.data(), new_freq, 10);
-    send_queue.push(frame.dump());
+static void on_cat_baud_change(Subject *subj, void *user_data) {
+    int32_t baud = subject_get_int(subj);
+    speed_t speed = B19200;
+
+    for (uint8_t i = 0; i < CAT_BAUD_RATES; i++) {
+        if (cat_baud_rates[i] == baud) {
+            speed = baud_speeds[i];
+            break;
+        }
+    }
+
+    struct termios attr;
+    int            fd = conn->get_fd();
+
+    if (tcgetattr(fd, &attr) < 0) {
+        return;
+    }
+    cfsetispeed(&attr, speed);
+    cfsetospeed(&attr, speed);
+
+    if (tcsetattr(fd, TCSADRAIN, &attr) < 0) {
+        LV_LOG_ERROR("UART set speed");
+    }
+}
+
+static void on_cat_echo_change(Subject *subj, void *user_data) {
+    echo = subject_get_int(subj);
+}
+
+static void on_cat_transceive_change(Subject *subj, void *user_data) {
+    transceive_ms = LV_CLAMP(0, subject_get_int(subj), UINT16_MAX);
+}
+
+static void on_state_change(const cat_state_t *prev, const cat_state_t *cur) {
+    uint8_t req = 0;
+
+    if (!transceive_ms) {
+        return;
+    }
+    if (cur->fg_freq != prev->fg_freq) {
+        req |= TRANSCEIVE_FREQ;
+    }
+    if (cur->mode != prev->mode) {
+        req |= TRANSCEIVE_MODE;
+    }
+    if (req) {
+        transceive_req |= req;
+        wake_cat_thread();
+    }
 }
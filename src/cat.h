@@ -8,12 +8,43 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define CAT_LATENCY_BUCKETS 9
+#define CAT_BAUD_RATES      7
+#define CAT_TRANSCEIVE_PERIODS  4
+
+/* UART speeds for cfg.cat_baud */
+extern const int32_t cat_baud_rates[CAT_BAUD_RATES];
+
+/* Min ms between transceive notifications for cfg.cat_transceive, 0 is off */
+extern const uint16_t cat_transceive_periods[CAT_TRANSCEIVE_PERIODS];
+
+/*
+ * Request to response time, counted from the wake up on incoming data.
+ * Buckets are < 100, 250, 500 us, 1, 2, 5, 10, 20 ms and the rest
+ */
+typedef struct {
+    uint32_t    requests;
+    uint32_t    buckets[CAT_LATENCY_BUCKETS];
+    uint64_t    sum_us;
+    uint32_t    max_us;
+} cat_latency_stats_t;
+
 void cat_init();
 
+void cat_latency_stats(cat_latency_stats_t *stats, bool reset);
+
+/**
+ * Waterfall PSD (dB) for the scope output, called by DSP thread for each one
+ */
+void cat_scope_data(const float *psd, uint16_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,98 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#pragma once
+
+/*
+ * CI-V commands, shared by the CAT frontends (UART, network)
+ */
+
+#include "cat_frame.hpp"
+
+#define CODE_OK 0xFB
+#define CODE_NG 0xFA
+
+#define LOCAL_ADDRESS 0xA4
+
+#define C_SND_FREQ 0x00      /* Send frequency data  transceive mode does not ack*/
+#define C_SND_MODE 0x01      /* Send mode data, Sc  for transceive mode does not ack */
+#define C_RD_BAND 0x02       /* Read band edge frequencies */
+#define C_RD_FREQ 0x03       /* Read display frequency */
+#define C_RD_MODE 0x04       /* Read display mode */
+#define C_SET_FREQ 0x05      /* Set frequency data(1) */
+#define C_SET_MODE 0x06      /* Set mode data, Sc */
+#define C_SET_VFO 0x07       /* Set VFO */
+#define C_SET_MEM 0x08       /* Set channel, Sc(2) */
+#define C_WR_MEM 0x09        /* Write memory */
+#define C_MEM2VFO 0x0a       /* Memory to VFO */
+#define C_CLR_MEM 0x0b       /* Memory clear */
+#define C_RD_OFFS 0x0c       /* Read duplex offset frequency; default changes with HF/6M/2M */
+#define C_SET_OFFS 0x0d      /* Set duplex offset frequency */
+#define C_CTL_SCAN 0x0e      /* Control scan, Sc */
+#define C_CTL_SPLT 0x0f      /* Control split, and duplex mode Sc */
+#define C_SET_TS 0x10        /* Set tuning step, Sc */
+#define C_CTL_ATT 0x11       /* Set/get attenuator, Sc */
+#define C_CTL_ANT 0x12       /* Set/get antenna, Sc */
+#define C_CTL_ANN 0x13       /* Control announce (speech synth.), Sc */
+#define C_CTL_LVL 0x14       /* Set AF/RF/squelch, Sc */
+#define C_RD_SQSM 0x15       /* Read squelch condition/S-meter level, Sc */
+#define C_CTL_FUNC 0x16      /* Function settings (AGC,NB,etc.), Sc */
+#define C_SND_CW 0x17        /* Send CW message */
+#define C_SET_PWR 0x18       /* Set Power ON/OFF, Sc */
+#define C_RD_TRXID 0x19      /* Read transceiver ID code */
+#define C_CTL_MEM 0x1a       /* Misc memory/bank/rig control functions, Sc */
+#define C_SET_TONE 0x1b      /* Set tone frequency */
+#define C_CTL_PTT 0x1c       /* Control Transmit On/Off, Sc */
+#define C_CTL_EDGE 0x1e      /* Band edges */
+#define C_CTL_DVT 0x1f       /* Digital modes calsigns & messages */
+#define C_CTL_DIG 0x20       /* Digital modes settings & status */
+#define C_CTL_RIT 0x21       /* RIT/XIT control */
+#define C_CTL_DSD 0x22       /* D-STAR Data */
+#define C_SEND_SEL_FREQ 0x25 /* Send/Recv sel/unsel VFO frequency */
+#define C_SEND_SEL_MODE 0x26
+#define C_CTL_SCP 0x27   /* Scope control & data */
+#define C_SND_VOICE 0x28 /* Transmit Voice Memory Contents */
+#define C_CTL_MTEXT 0x70 /* Microtelecom Extension */
+#define C_CTL_MISC 0x7f  /* Miscellaneous control, Sc */
+
+#define S_VFOA 0x00      /* Set to VFO A */
+#define S_VFOB 0x01      /* Set to VFO B */
+#define S_BTOA 0xa0      /* VFO A=B */
+#define S_XCHNG 0xb0     /* Switch VFO A and B */
+#define S_SUBTOMAIN 0xb1 /* MAIN = SUB */
+#define S_DUAL_OFF 0xc0  /* Dual watch off */
+#define S_DUAL_ON 0xc1   /* Dual watch on */
+#define S_DUAL 0xc2      /* Dual watch (0 = off, 1 = on) */
+#define S_MAIN 0xd0      /* Select MAIN band */
+#define S_SUB 0xd1       /* Select SUB band */
+#define S_SUB_SEL 0xd2   /* Read/Set Main/Sub selection */
+#define S_FRONTWIN 0xe0  /* Select front window */
+
+// modes
+#define M_LSB 0x00
+#define M_USB 0x01
+#define M_AM 0x02
+#define M_CW 0x03
+#define M_NFM 0x05
+#define M_CWR 0x07
+
+// memory/bank/rig control
+#define MEM_BS_REG 0x01 /* Get band stacking register */
+#define MEM_IF_FW 0x03  /* Get IF filter width */
+#define MEM_LOCK 0x05   /* LOCK status */
+#define MEM_DM_FG 0x06  /* Get data mode switch and filter group */
+
+/**
+ * Handle a CI-V request, resp is the answer to send. Thread safe
+ */
+void cat_process(const CatFrame &req, CatResponse &resp);
+
+/**
+ * Handle a request built from command and data. Returns false if the radio answered NG
+ */
+bool cat_command(uint8_t command, const uint8_t *data, size_t len, CatResponse *resp=nullptr);
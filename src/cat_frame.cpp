@@ -0,0 +1,149 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "cat_frame.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+void CatResponse::reply_to(const CatFrame &req, uint8_t local_addr) {
+    dst_addr = req.src_addr;
+    src_addr = local_addr;
+    command = req.command;
+    len = std::min(req.len, (size_t) CAT_MAX_PAYLOAD);
+    memcpy(data, req.data, len);
+}
+
+size_t CatResponse::encode(uint8_t *buf) const {
+    buf[0] = FRAME_PRE;
+    buf[1] = FRAME_PRE;
+    buf[2] = dst_addr;
+    buf[3] = src_addr;
+    buf[4] = command;
+    memcpy(buf + 5, data, len);
+    buf[5 + len] = FRAME_END;
+
+    return get_len();
+}
+
+uint8_t * CatParser::space(size_t *len) {
+    if (start) {
+        end -= start;
+        memmove(buf, buf + start, end);
+        start = 0;
+    }
+    *len = sizeof(buf) - end;
+
+    return buf + end;
+}
+
+bool CatParser::next(CatFrame *frame) {
+    static const uint8_t header[2] = {FRAME_PRE, FRAME_PRE};
+
+    uint8_t *frame_start = (uint8_t *) memmem(buf + start, end - start, header, sizeof(header));
+
+    if (!frame_start) {
+        /* Keep the last byte, it can be the first one of the header */
+        if (end - start > 1) {
+            start = end - 1;
+        }
+        return false;
+    }
+
+    /* Extra preamble bytes are allowed */
+    while (frame_start + 2 < buf + end && frame_start[2] == FRAME_PRE) {
+        frame_start++;
+    }
+
+    start = frame_start - buf;
+
+    if (end - start < FRAME_ADD_LEN + 1) {
+        return false;
+    }
+
+    uint8_t *end_pos = (uint8_t *) memchr(frame_start + FRAME_ADD_LEN, FRAME_END, end - start - FRAME_ADD_LEN);
+
+    if (!end_pos) {
+        /* Garbage without end, which fills the whole buffer */
+        if (start == 0 && end == sizeof(buf)) {
+            start = end;
+        }
+        return false;
+    }
+
+    size_t frame_len = end_pos - frame_start + 1;
+
+    frame->dst_addr = frame_start[2];
+    frame->src_addr = frame_start[3];
+    frame->command = frame_start[4];
+    frame->data = frame_start + 5;
+    frame->len = frame_len - FRAME_ADD_LEN - 1;
+    frame->raw = frame_start;
+    frame->raw_len = frame_len;
+
+    start += frame_len;
+
+    return true;
+}
+
+bool CatTxRing::put(const uint8_t *data, size_t len) {
+    std::lock_guard<std::mutex> lock(mux);
+
+    if (sizeof(buf) - (head - tail) < len) {
+        return false;
+    }
+
+    size_t pos = head % sizeof(buf);
+    size_t part = std::min(len, sizeof(buf) - pos);
+
+    memcpy(buf + pos, data, part);
+    memcpy(buf, data + part, len - part);
+    head += len;
+
+    return true;
+}
+
+bool CatTxRing::put(const CatResponse &frame) {
+    uint8_t data[CAT_MAX_PAYLOAD + 1 + FRAME_ADD_LEN];
+
+    return put(data, frame.encode(data));
+}
+
+size_t CatTxRing::peek(const uint8_t **data) {
+    std::lock_guard<std::mutex> lock(mux);
+
+    size_t pos = tail % sizeof(buf);
+
+    *data = buf + pos;
+
+    return std::min(head - tail, sizeof(buf) - pos);
+}
+
+void CatTxRing::consume(size_t len) {
+    std::lock_guard<std::mutex> lock(mux);
+
+    tail += std::min(len, head - tail);
+}
+
+void CatTxRing::clear() {
+    std::lock_guard<std::mutex> lock(mux);
+
+    tail = head;
+}
+
+bool CatTxRing::empty() {
+    std::lock_guard<std::mutex> lock(mux);
+
+    return head == tail;
+}
+
+size_t CatTxRing::pending() {
+    std::lock_guard<std::mutex> lock(mux);
+
+    return head - tail;
+}
@@ -0,0 +1,123 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+/*
+ * CI-V framing without allocations. Requests are parsed in place from a fixed
+ * receive buffer, responses are built in fixed storage and encoded into a
+ * preallocated transmit ring shared by the CAT thread and frame producers.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#define FRAME_PRE 0xFE
+#define FRAME_END 0xFD
+
+#define FRAME_ADD_LEN 5             /* Header and end len */
+
+#define CAT_RX_BUF_SIZE     1024
+#define CAT_TX_RING_SIZE    4096
+#define CAT_MAX_PAYLOAD     256     /* Longest answer has 7 bytes, requests are clipped */
+
+/**
+ * Parsed request, points into the receive buffer until the next parse
+ */
+struct CatFrame {
+    uint8_t         dst_addr;
+    uint8_t         src_addr;
+    uint8_t         command;
+    const uint8_t   *data;
+    size_t          len;
+
+    const uint8_t   *raw;       /* Whole frame, for the echo */
+    size_t          raw_len;
+};
+
+struct CatResponse {
+    uint8_t dst_addr;
+    uint8_t src_addr;
+    uint8_t command;
+    uint8_t data[CAT_MAX_PAYLOAD];
+    size_t  len = 0;
+
+    CatResponse() = default;
+    CatResponse(uint8_t dst, uint8_t src, uint8_t command): dst_addr(dst), src_addr(src), command(command) {};
+
+    /**
+     * Start the answer to req: swap address and copy command with data
+     */
+    void reply_to(const CatFrame &req, uint8_t local_addr);
+
+    void set_code(uint8_t code) {
+        set_payload_len(1);
+        command = code;
+    }
+
+    /**
+     * Payload is the command and len - 1 data bytes
+     */
+    void set_payload_len(size_t len) {
+        this->len = len - 1;
+    }
+
+    size_t get_len() const {
+        return len + 1 + FRAME_ADD_LEN;
+    }
+
+    /**
+     * Write the frame to buf of at least get_len() bytes
+     */
+    size_t encode(uint8_t *buf) const;
+};
+
+class CatParser {
+    uint8_t buf[CAT_RX_BUF_SIZE];
+    size_t  start = 0;
+    size_t  end = 0;
+
+  public:
+    /**
+     * Free space to read into, data is compacted to the buffer begin first
+     */
+    uint8_t *space(size_t *len);
+
+    void commit(size_t len) {
+        end += len;
+    }
+
+    /**
+     * Next complete frame of the received data. Returns false if there is none yet
+     */
+    bool next(CatFrame *frame);
+};
+
+class CatTxRing {
+    uint8_t     buf[CAT_TX_RING_SIZE];
+    size_t      head = 0;
+    size_t      tail = 0;
+    std::mutex  mux;
+
+  public:
+    /**
+     * Append whole data, or nothing if there is no room for it
+     */
+    bool put(const uint8_t *data, size_t len);
+    bool put(const CatResponse &frame);
+
+    /**
+     * Oldest contiguous chunk of the pending data. Returns its len
+     */
+    size_t peek(const uint8_t **data);
+    void consume(size_t len);
+    void clear();
+    bool empty();
+    size_t pending();
+};
@@ -0,0 +1,805 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "cat_net.h"
+
+#include "cat.private.hpp"
+#include "cat_frame.hpp"
+#include "cat_state.h"
+#include "cfg/subjects.h"
+#include "util.hpp"
+#include "util.h"
+
+#include <atomic>
+#include <thread>
+
+extern "C" {
+    #include "cfg/cfg.h"
+    #include "meter.h"
+    #include "radio.h"
+
+    #include "lvgl/lvgl.h"
+    #include <errno.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <stdarg.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <sys/eventfd.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+}
+
+#define RATE            50      /* Requests per second of a client */
+#define RATE_BURST      25
+#define RATE_POLL_MS    20
+#define LINE_LEN        256
+#define OUT_SIZE        4096
+#define MAX_ARGS        8
+
+/* Hamlib error codes */
+#define RPRT_OK         0
+#define RPRT_EINVAL     -1
+#define RPRT_ERJCTED    -9
+#define RPRT_ENAVAIL    -11
+
+typedef enum {
+    CLIENT_RIGCTL = 0,
+    CLIENT_CIV,
+} client_kind_t;
+
+struct Client {
+    int             fd = -1;
+    client_kind_t   kind;
+
+    char            line[LINE_LEN];     /* rigctl */
+    size_t          line_len;
+    bool            discard;            /* Drop bytes up to the next '\n' */
+    CatParser       parser;             /* CI-V */
+
+    uint8_t         out[OUT_SIZE];
+    size_t          out_len;
+
+    float           tokens;
+    uint64_t        tokens_time;
+    bool            limited;            /* Requests are waiting for tokens */
+};
+
+typedef struct {
+    char        short_cmd;
+    const char  *long_cmd;
+    void        (*fn)(Client *client, char *argv[], int argc);
+} rigctl_cmd_t;
+
+static Client               clients[CAT_NET_CLIENTS];
+static int                  listen_fd[2] = {-1, -1};
+static const uint16_t       listen_port[2] = {CAT_NET_RIGCTL_PORT, CAT_NET_CIV_PORT};
+static int                  wake_event = -1;
+
+static std::atomic<bool>    enabled{false};
+static std::atomic<bool>    freq_changed{false};
+
+static const char *dump_state =
+    "0\n"                                                               /* Protocol version */
+    "2\n"                                                               /* Rig model */
+    "2\n"                                                               /* ITU region */
+    "500000.000000 55000000.000000 0xcaf -1 -1 0x10000003 0x3\n"        /* RX range */
+    "0 0 0 0 0 0 0\n"
+    "1800000.000000 54000000.000000 0xcaf 1000 10000 0x10000003 0x3\n"  /* TX range */
+    "0 0 0 0 0 0 0\n"
+    "0xcaf 10\n"                                                        /* Tuning steps */
+    "0xcaf 100\n"
+    "0 0\n"
+    "0xc0c 2400\n"                                                      /* Filters */
+    "0x82 500\n"
+    "0x1 6000\n"
+    "0x20 12000\n"
+    "0 0\n"
+    "0\n"                                                               /* Max RIT */
+    "0\n"                                                               /* Max XIT */
+    "0\n"                                                               /* Max IF shift */
+    "0\n"                                                               /* Announces */
+    "10\n"                                                              /* Preamp */
+    "10\n"                                                              /* Attenuator */
+    "0x0\n"                                                             /* Get func */
+    "0x0\n"                                                             /* Set func */
+    "0x40001008\n"                                                      /* Get level: STRENGTH, RFPOWER, AF */
+    "0x1008\n"                                                          /* Set level: RFPOWER, AF */
+    "0x0\n"                                                             /* Get parm */
+    "0x0\n";                                                            /* Set parm */
+
+static void on_cat_net_change(Subject *subj, void *user_data);
+static void on_state_change(const cat_state_t *prev, const cat_state_t *cur);
+static void net_thread();
+
+/* Output */
+
+static bool client_write(Client *client, const void *data, size_t len) {
+    if (OUT_SIZE - client->out_len < len) {
+        return false;
+    }
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+
+    return true;
+}
+
+static void client_printf(Client *client, const char *fmt, ...) {
+    va_list args;
+    size_t  space = OUT_SIZE - client->out_len;
+
+    va_start(args, fmt);
+    int len = vsnprintf((char *) client->out + client->out_len, space, fmt, args);
+    va_end(args);
+
+    if (len > 0 && (size_t) len < space) {
+        client->out_len += len;
+    }
+}
+
+static void client_report(Client *client, int code) {
+    client_printf(client, "RPRT %i\n", code);
+}
+
+static void client_close(Client *client) {
+    close(client->fd);
+    client->fd = -1;
+}
+
+/**
+ * Returns false if the client is gone
+ */
+static bool client_flush(Client *client) {
+    while (client->out_len) {
+        ssize_t l = send(client->fd, client->out, client->out_len, MSG_NOSIGNAL);
+
+        if (l < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            client_close(client);
+            return false;
+        }
+
+        client->out_len -= l;
+        memmove(client->out, client->out + l, client->out_len);
+    }
+    return true;
+}
+
+/* rigctl */
+
+static const char * mode_name(int32_t mode) {
+    switch (mode) {
+        case x6100_mode_lsb:        return "LSB";
+        case x6100_mode_lsb_dig:    return "PKTLSB";
+        case x6100_mode_usb:        return "USB";
+        case x6100_mode_usb_dig:    return "PKTUSB";
+        case x6100_mode_cw:         return "CW";
+        case x6100_mode_cwr:        return "CWR";
+        case x6100_mode_am:         return "AM";
+        case x6100_mode_nfm:        return "FM";
+        default:                    return "USB";
+    }
+}
+
+static int32_t other_vfo_freq(const cat_state_t *st) {
+    return st->vfo_freq[st->vfo == X6100_VFO_A ? 1 : 0];
+}
+
+/**
+ * Parse a frequency in Hz, an optional ".0" fraction is allowed
+ */
+static bool parse_freq(const char *str, int32_t *freq) {
+    char        *end;
+    long long   val;
+
+    errno = 0;
+    val = strtoll(str, &end, 10);
+
+    if (end == str || errno == ERANGE || val < 0) {
+        return false;
+    }
+    if (*end == '.') {
+        end++;
+        while (*end == '0') {
+            end++;
+        }
+    }
+    if (*end != '\0' || val > INT32_MAX || !radio_check_freq((int32_t) val)) {
+        return false;
+    }
+    *freq = (int32_t) val;
+
+    return true;
+}
+
+static void cmd_get_freq(Client *client, char *argv[], int argc) {
+    cat_state_t st;
+
+    cat_state_read(&st);
+    client_printf(client, "%i\n", st.fg_freq);
+}
+
+static void cmd_set_freq(Client *client, char *argv[], int argc) {
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+
+    int32_t freq;
+    uint8_t data[5];
+
+    if (!parse_freq(argv[1], &freq)) {
+        return client_report(client, RPRT_EINVAL);
+    }
+    to_bcd(data, freq, 10);
+    client_report(client, cat_command(C_SET_FREQ, data, sizeof(data)) ? RPRT_OK : RPRT_ERJCTED);
+}
+
+static void cmd_get_mode(Client *client, char *argv[], int argc) {
+    cat_state_t st;
+
+    cat_state_read(&st);
+    client_printf(client, "%s\n%i\n", mode_name(st.mode), st.filter_bw);
+}
+
+static void cmd_set_mode(Client *client, char *argv[], int argc) {
+    static const struct {
+        const char  *name;
+        uint8_t     mode;
+        uint8_t     data_mode;
+    } modes[] = {
+        { "LSB",    M_LSB,  0 },
+        { "USB",    M_USB,  0 },
+        { "PKTLSB", M_LSB,  1 },
+        { "PKTUSB", M_USB,  1 },
+        { "CW",     M_CW,   0 },
+        { "CWR",    M_CWR,  0 },
+        { "AM",     M_AM,   0 },
+        { "FM",     M_NFM,  0 },
+    };
+
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (strcmp(argv[1], modes[i].name) == 0) {
+            uint8_t data[4] = { MEM_DM_FG, modes[i].mode, modes[i].data_mode, 1 };
+
+            return client_report(client, cat_command(C_CTL_MEM, data, sizeof(data)) ? RPRT_OK : RPRT_ERJCTED);
+        }
+    }
+    client_report(client, RPRT_EINVAL);
+}
+
+static void cmd_get_vfo(Client *client, char *argv[], int argc) {
+    cat_state_t st;
+
+    cat_state_read(&st);
+    client_printf(client, "%s\n", st.vfo == X6100_VFO_A ? "VFOA" : "VFOB");
+}
+
+static void cmd_set_vfo(Client *client, char *argv[], int argc) {
+    uint8_t vfo;
+
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+    if (strcmp(argv[1], "VFOA") == 0 || strcmp(argv[1], "Main") == 0) {
+        vfo = S_VFOA;
+    } else if (strcmp(argv[1], "VFOB") == 0 || strcmp(argv[1], "Sub") == 0) {
+        vfo = S_VFOB;
+    } else if (strcmp(argv[1], "currVFO") == 0) {
+        return client_report(client, RPRT_OK);
+    } else {
+        return client_report(client, RPRT_EINVAL);
+    }
+    client_report(client, cat_command(C_SET_VFO, &vfo, 1) ? RPRT_OK : RPRT_ERJCTED);
+}
+
+static void cmd_get_ptt(Client *client, char *argv[], int argc) {
+    client_printf(client, "%i\n", radio_get_state() == RADIO_RX ? 0 : 1);
+}
+
+static void cmd_set_ptt(Client *client, char *argv[], int argc) {
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+
+    uint8_t data[2] = { 0x00, (uint8_t) (atoi(argv[1]) ? 1 : 0) };
+
+    client_report(client, cat_command(C_CTL_PTT, data, sizeof(data)) ? RPRT_OK : RPRT_ERJCTED);
+}
+
+static void cmd_get_split_vfo(Client *client, char *argv[], int argc) {
+    cat_state_t st;
+
+    cat_state_read(&st);
+    client_printf(client, "%i\n%s\n", st.split ? 1 : 0, st.vfo == X6100_VFO_A ? "VFOB" : "VFOA");
+}
+
+static void cmd_set_split_vfo(Client *client, char *argv[], int argc) {
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+
+    uint8_t split = atoi(argv[1]) ? 1 : 0;
+
+    client_report(client, cat_command(C_CTL_SPLT, &split, 1) ? RPRT_OK : RPRT_ERJCTED);
+}
+
+static void cmd_get_split_freq(Client *client, char *argv[], int argc) {
+    cat_state_t st;
+
+    cat_state_read(&st);
+    client_printf(client, "%i\n", other_vfo_freq(&st));
+}
+
+static void cmd_set_split_freq(Client *client, char *argv[], int argc) {
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+
+    int32_t freq;
+    uint8_t data[6] = { 1 };
+
+    if (!parse_freq(argv[1], &freq)) {
+        return client_report(client, RPRT_EINVAL);
+    }
+    to_bcd(&data[1], freq, 10);
+    client_report(client, cat_command(C_SEND_SEL_FREQ, data, sizeof(data)) ? RPRT_OK : RPRT_ERJCTED);
+}
+
+static void cmd_get_level(Client *client, char *argv[], int argc) {
+    cat_state_t st;
+
+    if (argc < 2) {
+        return client_report(client, RPRT_EINVAL);
+    }
+    cat_state_read(&st);
+
+    if (strcmp(argv[1], "STRENGTH") == 0) {
+        client_printf(client, "%i\n", meter_get_raw_db() - S9);
+    } else if (strcmp(argv[1], "RFPOWER") == 0) {
+        client_printf(client, "%f\n", st.pwr / 10.0f);
+    } else if (strcmp(argv[1], "AF") == 0) {
+        client_printf(client, "%f\n", st.vol / 55.0f);
+    } else {
+        client_report(client, RPRT_ENAVAIL);
+    }
+}
+
+static void cmd_set_level(Client *client, char *argv[], int argc) {
+    uint8_t data[3];
+
+    if (argc < 3) {
+        return client_report(client, RPRT_EINVAL);
+    }
+
+    if (strcmp(argv[1], "RFPOWER") == 0) {
+        data[0] = 0x0a;
+    } else if (strcmp(argv[1], "AF") == 0) {
+        data[0] = 0x01;
+    } else {
+        return client_report(client, RPRT_ENAVAIL);
+    }
+
+    float val = clip((float) strtod(argv[2], NULL), 0.0f, 1.0f);
+
+    to_bcd_be(&data[1], val * 255, 3);
+    client_report(client, cat_command(C_CTL_LVL, data, sizeof(data)) ? RPRT_OK : RPRT_ERJCTED);
+}
+
+static void cmd_dump_state(Client *client, char *argv[], int argc) {
+    client_write(client, dump_state, strlen(dump_state));
+}
+
+static void cmd_chk_vfo(Client *client, char *argv[], int argc) {
+    client_printf(client, "0\n");
+}
+
+static void cmd_get_powerstat(Client *client, char *argv[], int argc) {
+    client_printf(client, "1\n");
+}
+
+static void cmd_get_info(Client *client, char *argv[], int argc) {
+    client_printf(client, "Xiegu X6100\n");
+}
+
+static void cmd_quit(Client *client, char *argv[], int argc) {
+    client_flush(client);
+
+    if (client->fd >= 0) {
+        client_close(client);
+    }
+}
+
+static const rigctl_cmd_t rigctl_cmds[] = {
+    { 'f',  "get_freq",         cmd_get_freq },
+    { 'F',  "set_freq",         cmd_set_freq },
+    { 'm',  "get_mode",         cmd_get_mode },
+    { 'M',  "set_mode",         cmd_set_mode },
+    { 'v',  "get_vfo",          cmd_get_vfo },
+    { 'V',  "set_vfo",          cmd_set_vfo },
+    { 't',  "get_ptt",          cmd_get_ptt },
+    { 'T',  "set_ptt",          cmd_set_ptt },
+    { 's',  "get_split_vfo",    cmd_get_split_vfo },
+    { 'S',  "set_split_vfo",    cmd_set_split_vfo },
+    { 'i',  "get_split_freq",   cmd_get_split_freq },
+    { 'I',  "set_split_freq",   cmd_set_split_freq },
+    { 'l',  "get_level",        cmd_get_level },
+    { 'L',  "set_level",        cmd_set_level },
+    { '_',  "get_info",         cmd_get_info },
+    { 'q',  "quit",             cmd_quit },
+    { 'Q',  "quit",             cmd_quit },
+    { 0,    "dump_state",       cmd_dump_state },
+    { 0,    "chk_vfo",          cmd_chk_vfo },
+    { 0,    "get_powerstat",    cmd_get_powerstat },
+};
+
+static void rigctl_line(Client *client, char *line) {
+    char    *argv[MAX_ARGS];
+    int     argc = 0;
+    char    *save;
+
+    for (char *tok = strtok_r(line, " \t\r", &save); tok && argc < MAX_ARGS; tok = strtok_r(NULL, " \t\r", &save)) {
+        argv[argc++] = tok;
+    }
+
+    if (argc == 0) {
+        return;
+    }
+
+    const char *cmd = argv[0];
+
+    for (size_t i = 0; i < sizeof(rigctl_cmds) / sizeof(rigctl_cmds[0]); i++) {
+        const rigctl_cmd_t *item = &rigctl_cmds[i];
+
+        if (cmd[0] == '\\' ? strcmp(cmd + 1, item->long_cmd) == 0 : (cmd[1] == 0 && cmd[0] == item->short_cmd)) {
+            item->fn(client, argv, argc);
+            return;
+        }
+    }
+    client_report(client, RPRT_ENAVAIL);
+}
+
+/* Clients */
+
+static bool has_token(Client *client) {
+    uint64_t now = get_time();
+
+    client->tokens = LV_MIN(RATE_BURST, client->tokens + (now - client->tokens_time) * RATE / 1000.0f);
+    client->tokens_time = now;
+
+    if (client->tokens < 1.0f) {
+        client->limited = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Answer buffered requests, while the client has tokens and room for answers
+ */
+static void client_process(Client *client) {
+    client->limited = false;
+
+    if (client->kind == CLIENT_CIV) {
+        CatFrame    req;
+        CatResponse resp;
+
+        while (client->fd >= 0 && client->out_len < OUT_SIZE / 2 && has_token(client)) {
+            if (!client->parser.next(&req)) {
+                break;
+            }
+            client->tokens -= 1.0f;
+            cat_process(req, resp);
+
+            uint8_t buf[CAT_MAX_PAYLOAD + 1 + FRAME_ADD_LEN];
+
+            client_write(client, buf, resp.encode(buf));
+        }
+    } else {
+        while (client->fd >= 0 && client->out_len < OUT_SIZE / 2) {
+            char *end = (char *) memchr(client->line, '\n', client->line_len);
+
+            if (client->discard) {
+                /* Rest of a too long line */
+                if (!end) {
+                    client->line_len = 0;
+                    break;
+                }
+                client->discard = false;
+                client->line_len -= end - client->line + 1;
+                memmove(client->line, end + 1, client->line_len);
+                continue;
+            }
+            if (!end) {
+                /* Too long line without end */
+                if (client->line_len == LINE_LEN) {
+                    client->line_len = 0;
+                    client->discard = true;
+                    client_report(client, RPRT_EINVAL);
+                }
+                break;
+            }
+            if (!has_token(client)) {
+                break;
+            }
+            client->tokens -= 1.0f;
+
+            *end = '\0';
+            size_t len = end - client->line + 1;
+
+            rigctl_line(client, client->line);
+
+            if (client->fd >= 0) {
+                client->line_len -= len;
+                memmove(client->line, client->line + len, client->line_len);
+            }
+        }
+    }
+}
+
+static void client_read(Client *client) {
+    uint8_t *buf;
+    size_t  space;
+
+    if (client->kind == CLIENT_CIV) {
+        buf = client->parser.space(&space);
+    } else {
+        buf = (uint8_t *) client->line + client->line_len;
+        space = LINE_LEN - client->line_len;
+    }
+
+    if (space == 0) {
+        return;
+    }
+
+    ssize_t res = recv(client->fd, buf, space, 0);
+
+    if (res == 0 || (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        client_close(client);
+        return;
+    }
+    if (res > 0) {
+        if (client->kind == CLIENT_CIV) {
+            client->parser.commit(res);
+        } else {
+            client->line_len += res;
+        }
+    }
+}
+
+static void client_accept(int fd, client_kind_t kind) {
+    int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (client_fd < 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < CAT_NET_CLIENTS; i++) {
+        Client *client = &clients[i];
+
+        if (client->fd < 0) {
+            int one = 1;
+
+            setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            client->fd = client_fd;
+            client->kind = kind;
+            client->line_len = 0;
+            client->discard = false;
+            client->parser = CatParser();
+            client->out_len = 0;
+            client->tokens = RATE_BURST;
+            client->tokens_time = get_time();
+            client->limited = false;
+
+            LV_LOG_USER("CAT net client %i connected (%s)", i, kind == CLIENT_CIV ? "CI-V" : "rigctl");
+            return;
+        }
+    }
+
+    LV_LOG_WARN("CAT net: too many clients");
+    close(client_fd);
+}
+
+/* Server */
+
+static void servers_open() {
+    for (uint8_t i = 0; i < 2; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+
+        if (fd < 0) {
+            LV_LOG_ERROR("CAT net socket: %s", strerror(errno));
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in addr;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(listen_port[i]);
+
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+            LV_LOG_ERROR("CAT net port %u: %s", listen_port[i], strerror(errno));
+            close(fd);
+            continue;
+        }
+        listen_fd[i] = fd;
+    }
+}
+
+static void servers_close() {
+    for (uint8_t i = 0; i < 2; i++) {
+        if (listen_fd[i] >= 0) {
+            close(listen_fd[i]);
+            listen_fd[i] = -1;
+        }
+    }
+    for (uint8_t i = 0; i < CAT_NET_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            client_close(&clients[i]);
+        }
+    }
+}
+
+static void send_transceive() {
+    cat_state_t st;
+    CatResponse frame{0, LOCAL_ADDRESS, C_SND_FREQ};
+    uint8_t     buf[CAT_MAX_PAYLOAD + 1 + FRAME_ADD_LEN];
+
+    cat_state_read(&st);
+    frame.set_payload_len(6);
+    to_bcd(frame.data, st.fg_freq, 10);
+
+    size_t len = frame.encode(buf);
+
+    /* Skipped for a client without room, the next change will update it */
+    for (uint8_t i = 0; i < CAT_NET_CLIENTS; i++) {
+        if (clients[i].fd >= 0 && clients[i].kind == CLIENT_CIV) {
+            client_write(&clients[i], buf, len);
+        }
+    }
+}
+
+static void net_thread() {
+    set_thread_name("cat_net");
+
+    struct pollfd   fds[3 + CAT_NET_CLIENTS];
+    int             timeout = -1;
+
+    while (true) {
+        bool on = enabled;
+
+        if (on && listen_fd[0] < 0 && listen_fd[1] < 0) {
+            servers_open();
+        } else if (!on && (listen_fd[0] >= 0 || listen_fd[1] >= 0)) {
+            servers_close();
+        }
+
+        fds[0].fd = wake_event;
+        fds[0].events = POLLIN;
+        fds[1].fd = listen_fd[0];
+        fds[1].events = POLLIN;
+        fds[2].fd = listen_fd[1];
+        fds[2].events = POLLIN;
+
+        for (uint8_t i = 0; i < CAT_NET_CLIENTS; i++) {
+            Client *client = &clients[i];
+
+            fds[3 + i].fd = client->fd;
+            fds[3 + i].events = 0;
+
+            if (client->fd >= 0) {
+                if (!client->limited && client->out_len < OUT_SIZE / 2) {
+                    fds[3 + i].events |= POLLIN;
+                }
+                if (client->out_len) {
+                    fds[3 + i].events |= POLLOUT;
+                }
+            }
+        }
+
+        if (poll(fds, 3 + CAT_NET_CLIENTS, timeout) < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("CAT net poll: %s", strerror(errno));
+                sleep_usec(100000);
+            }
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t val;
+
+            if (read(wake_event, &val, sizeof(val)) < 0) {
+                LV_LOG_WARN("CAT net wake event");
+            }
+        }
+
+        for (uint8_t i = 0; i < 2; i++) {
+            if (listen_fd[i] >= 0 && (fds[1 + i].revents & POLLIN)) {
+                client_accept(listen_fd[i], (client_kind_t) i);
+            }
+        }
+
+        if (freq_changed.exchange(false)) {
+            send_transceive();
+        }
+
+        timeout = -1;
+
+        for (uint8_t i = 0; i < CAT_NET_CLIENTS; i++) {
+            Client  *client = &clients[i];
+            short   revents = fds[3 + i].fd == client->fd ? fds[3 + i].revents : 0;
+
+            if (client->fd < 0) {
+                continue;
+            }
+            if (revents & (POLLERR | POLLHUP)) {
+                client_close(client);
+                continue;
+            }
+            if (revents & POLLIN) {
+                client_read(client);
+            }
+            if (client->fd >= 0) {
+                client_process(client);
+            }
+            if (client->fd >= 0 && !client_flush(client)) {
+                continue;
+            }
+            if (client->fd >= 0 && client->limited) {
+                timeout = RATE_POLL_MS;
+            }
+        }
+    }
+}
+
+static void wake() {
+    uint64_t val = 1;
+
+    if (wake_event >= 0 && write(wake_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("CAT net wake event");
+    }
+}
+
+static void on_cat_net_change(Subject *subj, void *user_data) {
+    enabled = subject_get_int(subj);
+    wake();
+}
+
+static void on_state_change(const cat_state_t *prev, const cat_state_t *cur) {
+    if (cur->fg_freq != prev->fg_freq) {
+        freq_changed = true;
+        wake();
+    }
+}
+
+void cat_net_init() {
+    wake_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_event < 0) {
+        LV_LOG_ERROR("CAT net wake event");
+        return;
+    }
+
+    cat_state_init();
+    cat_state_add_listener(on_state_change);
+    subject_add_observer_and_call(cfg.cat_net.val, on_cat_net_change, NULL);
+
+    std::thread thread(net_thread);
+    thread.detach();
+}
@@ -0,0 +1,29 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+/*
+ * Network CAT: Hamlib rigctld protocol and raw CI-V over TCP. One event loop
+ * serves all clients, reads come from the CAT state snapshot, changes go
+ * through the same CI-V handlers as the UART CAT. Enabled by cfg.cat_net.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAT_NET_RIGCTL_PORT 4532
+#define CAT_NET_CIV_PORT    4533
+#define CAT_NET_CLIENTS     8
+
+void cat_net_init();
+
+#ifdef __cplusplus
+}
+#endif
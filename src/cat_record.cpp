@@ -0,0 +1,177 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "cat_record.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#define STATE_PREFIX "# state"
+
+static const struct {
+    const char  *name;
+    size_t      offset;
+} state_fields[] = {
+    {"fg_freq",     offsetof(cat_state_t, fg_freq)},
+    {"mode",        offsetof(cat_state_t, mode)},
+    {"vfo",         offsetof(cat_state_t, vfo)},
+    {"vfo_a_freq",  offsetof(cat_state_t, vfo_freq)},
+    {"vfo_b_freq",  offsetof(cat_state_t, vfo_freq) + sizeof(int32_t)},
+    {"vfo_a_mode",  offsetof(cat_state_t, vfo_mode)},
+    {"vfo_b_mode",  offsetof(cat_state_t, vfo_mode) + sizeof(int32_t)},
+    {"split",       offsetof(cat_state_t, split)},
+    {"filter_bw",   offsetof(cat_state_t, filter_bw)},
+    {"freq_step",   offsetof(cat_state_t, freq_step)},
+    {"att",         offsetof(cat_state_t, att)},
+    {"pre",         offsetof(cat_state_t, pre)},
+    {"vol",         offsetof(cat_state_t, vol)},
+    {"rfg",         offsetof(cat_state_t, rfg)},
+    {"sql",         offsetof(cat_state_t, sql)},
+    {"nb",          offsetof(cat_state_t, nb)},
+    {"nr",          offsetof(cat_state_t, nr)},
+};
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static int32_t *state_field(cat_state_t *state, size_t i) {
+    return (int32_t *) ((uint8_t *) state + state_fields[i].offset);
+}
+
+bool CatRecorder::open(const char *path, const cat_state_t &state) {
+    file = fopen(path, "w");
+
+    if (!file) {
+        return false;
+    }
+    setvbuf(file, NULL, _IOLBF, 0);
+
+    cat_state_t st = state;
+
+    fprintf(file, STATE_PREFIX);
+
+    for (size_t i = 0; i < sizeof(state_fields) / sizeof(state_fields[0]); i++) {
+        fprintf(file, " %s=%i", state_fields[i].name, *state_field(&st, i));
+    }
+    fprintf(file, " pwr=%.1f\n", st.pwr);
+
+    start = now_us();
+    return true;
+}
+
+void CatRecorder::close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void CatRecorder::put(CatRecordDir dir, const uint8_t *data, size_t len) {
+    if (!file || len == 0) {
+        return;
+    }
+    fprintf(file, "%llu %c", (unsigned long long) (now_us() - start), dir);
+
+    for (size_t i = 0; i < len; i++) {
+        fprintf(file, " %02X", data[i]);
+    }
+    fputc('\n', file);
+}
+
+bool cat_record_parse_state(const char *line, cat_state_t *state) {
+    size_t prefix_len = strlen(STATE_PREFIX);
+
+    if (strncmp(line, STATE_PREFIX, prefix_len) != 0) {
+        return false;
+    }
+    memset(state, 0, sizeof(*state));
+
+    const char *p = line + prefix_len;
+
+    while (*p) {
+        while (*p == ' ') {
+            p++;
+        }
+
+        const char *eq = strchr(p, '=');
+
+        if (!eq) {
+            break;
+        }
+
+        size_t name_len = eq - p;
+
+        if (name_len == 3 && strncmp(p, "pwr", 3) == 0) {
+            state->pwr = strtof(eq + 1, NULL);
+        } else {
+            for (size_t i = 0; i < sizeof(state_fields) / sizeof(state_fields[0]); i++) {
+                if (strlen(state_fields[i].name) == name_len && strncmp(p, state_fields[i].name, name_len) == 0) {
+                    *state_field(state, i) = strtol(eq + 1, NULL, 10);
+                    break;
+                }
+            }
+        }
+
+        p = strchr(eq, ' ');
+
+        if (!p) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool cat_record_parse(const char *line, CatRecordEntry *entry) {
+    char *end;
+
+    if (*line == '#' || *line == '\0' || *line == '\n') {
+        return false;
+    }
+    entry->time = strtoull(line, &end, 10);
+
+    if (end == line || *end != ' ') {
+        return false;
+    }
+
+    switch (end[1]) {
+        case CAT_RECORD_RX:
+            entry->dir = CAT_RECORD_RX;
+            break;
+
+        case CAT_RECORD_TX:
+            entry->dir = CAT_RECORD_TX;
+            break;
+
+        default:
+            return false;
+    }
+
+    const char *p = end + 2;
+
+    entry->len = 0;
+
+    while (entry->len < sizeof(entry->data)) {
+        unsigned long val = strtoul(p, &end, 16);
+
+        if (end == p) {
+            break;
+        }
+        if (val > 0xFF) {
+            return false;
+        }
+        entry->data[entry->len++] = val;
+        p = end;
+    }
+    return entry->len > 0;
+}
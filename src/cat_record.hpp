@@ -0,0 +1,69 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+/*
+ * CAT session recording, for replay by tests/test_cat_replay.cpp.
+ *
+ * Text file, one line per UART read or write:
+ *
+ *   <usec from start> <direction> <hex bytes>
+ *
+ * Direction "<" is data from the client, ">" is data from the radio. The
+ * "# state" line at the beginning holds the CAT state at start, a replay
+ * begins from it.
+ */
+
+#include "cat_frame.hpp"
+#include "cat_state.h"
+
+#include <cstdio>
+
+#define CAT_RECORD_MARKER   "/mnt/cat_record.on"    // Record UART CAT on boot, if exists
+#define CAT_RECORD_PATH     "/mnt/cat_record.txt"
+
+enum CatRecordDir {
+    CAT_RECORD_RX = '<',
+    CAT_RECORD_TX = '>',
+};
+
+struct CatRecordEntry {
+    uint64_t        time;                   /* usec from start */
+    CatRecordDir    dir;
+    uint8_t         data[CAT_RX_BUF_SIZE];
+    size_t          len;
+};
+
+/**
+ * Writer, used by the CAT thread only
+ */
+class CatRecorder {
+    FILE        *file = nullptr;
+    uint64_t    start;
+
+  public:
+    bool open(const char *path, const cat_state_t &state);
+    void close();
+
+    bool is_on() const {
+        return file != nullptr;
+    }
+
+    void put(CatRecordDir dir, const uint8_t *data, size_t len);
+};
+
+/**
+ * Parse the "# state" line. Returns false for other lines
+ */
+bool cat_record_parse_state(const char *line, cat_state_t *state);
+
+/**
+ * Parse a data line. Returns false for comments, empty and malformed lines
+ */
+bool cat_record_parse(const char *line, CatRecordEntry *entry);
@@ -0,0 +1,130 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "cat_state.h"
+
+#include "cfg/cfg.h"
+
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+static cat_state_t          state;
+static atomic_uint          seq = 0;        /* Odd while state is written */
+
+static pthread_mutex_t      write_mux = PTHREAD_MUTEX_INITIALIZER;
+static cat_state_listener_t listeners[CAT_STATE_LISTENERS];
+static uint8_t              listeners_count = 0;
+static bool                 ready = false;
+
+static void collect(cat_state_t *s) {
+    s->fg_freq = subject_get_int(cfg_cur.fg_freq);
+    s->mode = subject_get_int(cfg_cur.mode);
+    s->vfo = subject_get_int(cfg_cur.band->vfo.val);
+    s->vfo_freq[0] = subject_get_int(cfg_cur.band->vfo_a.freq.val);
+    s->vfo_freq[1] = subject_get_int(cfg_cur.band->vfo_b.freq.val);
+    s->vfo_mode[0] = subject_get_int(cfg_cur.band->vfo_a.mode.val);
+    s->vfo_mode[1] = subject_get_int(cfg_cur.band->vfo_b.mode.val);
+    s->split = subject_get_int(cfg_cur.band->split.val);
+    s->filter_bw = subject_get_int(cfg_cur.filter.bw);
+    s->freq_step = subject_get_int(cfg_cur.freq_step);
+    s->att = subject_get_int(cfg_cur.att);
+    s->pre = subject_get_int(cfg_cur.pre);
+    s->vol = subject_get_int(cfg.vol.val);
+    s->rfg = subject_get_int(cfg_cur.band->rfg.val);
+    s->sql = subject_get_int(cfg.sql.val);
+    s->pwr = subject_get_float(cfg.pwr.val);
+    s->nb = subject_get_int(cfg.nb.val);
+    s->nr = subject_get_int(cfg.nr.val);
+}
+
+static void update(Subject *subj, void *user_data) {
+    cat_state_t prev, cur;
+
+    pthread_mutex_lock(&write_mux);
+
+    prev = state;
+    cur = state;
+    collect(&cur);
+
+    if (memcmp(&prev, &cur, sizeof(cur)) == 0) {
+        pthread_mutex_unlock(&write_mux);
+        return;
+    }
+    cur.version++;
+
+    unsigned s = atomic_load_explicit(&seq, memory_order_relaxed);
+
+    atomic_store_explicit(&seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    state = cur;
+
+    atomic_store_explicit(&seq, s + 2, memory_order_release);
+
+    for (uint8_t i = 0; i < listeners_count; i++) {
+        listeners[i](&prev, &cur);
+    }
+
+    pthread_mutex_unlock(&write_mux);
+}
+
+void cat_state_init() {
+    if (ready) {
+        return;
+    }
+
+    Subject *subjects[] = {
+        cfg_cur.fg_freq, cfg_cur.mode, cfg_cur.band->vfo.val,
+        cfg_cur.band->vfo_a.freq.val, cfg_cur.band->vfo_b.freq.val,
+        cfg_cur.band->vfo_a.mode.val, cfg_cur.band->vfo_b.mode.val,
+        cfg_cur.band->split.val, cfg_cur.filter.bw, cfg_cur.freq_step,
+        cfg_cur.att, cfg_cur.pre, cfg.vol.val, cfg_cur.band->rfg.val,
+        cfg.sql.val, cfg.pwr.val, cfg.nb.val, cfg.nr.val,
+    };
+
+    for (uint8_t i = 0; i < sizeof(subjects) / sizeof(subjects[0]); i++) {
+        subject_add_observer(subjects[i], update, NULL);
+    }
+
+    update(NULL, NULL);
+    ready = true;
+}
+
+uint32_t cat_state_read(cat_state_t *dst) {
+    unsigned s;
+
+    do {
+        s = atomic_load_explicit(&seq, memory_order_acquire);
+
+        if (s & 1) {
+            continue;
+        }
+
+        *dst = state;
+
+        atomic_thread_fence(memory_order_acquire);
+    } while ((s & 1) || atomic_load_explicit(&seq, memory_order_relaxed) != s);
+
+    return dst->version;
+}
+
+void cat_state_add_listener(cat_state_listener_t fn) {
+    pthread_mutex_lock(&write_mux);
+
+    if (listeners_count < CAT_STATE_LISTENERS) {
+        listeners[listeners_count++] = fn;
+    } else {
+        LV_LOG_ERROR("Too many CAT state listeners");
+    }
+
+    pthread_mutex_unlock(&write_mux);
+}
@@ -0,0 +1,62 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Snapshot of the radio state for CAT. Observers of the subjects update it on
+ * change, CAT readers copy it without locks (seqlock) and never touch the
+ * subjects, params or the radio for read commands.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAT_STATE_LISTENERS 4
+
+typedef struct {
+    uint32_t    version;        /* Incremented with every update */
+
+    int32_t     fg_freq;
+    int32_t     mode;
+    int32_t     vfo;
+    int32_t     vfo_freq[2];    /* VFO A, B */
+    int32_t     vfo_mode[2];
+    int32_t     split;
+    int32_t     filter_bw;
+    int32_t     freq_step;
+    int32_t     att;
+    int32_t     pre;
+    int32_t     vol;
+    int32_t     rfg;
+    int32_t     sql;
+    float       pwr;
+    int32_t     nb;
+    int32_t     nr;
+} cat_state_t;
+
+/**
+ * Called after each update by the thread, which changed the state
+ */
+typedef void (*cat_state_listener_t)(const cat_state_t *prev, const cat_state_t *cur);
+
+void cat_state_init();
+
+/**
+ * Copy the latest state. Returns its version
+ */
+uint32_t cat_state_read(cat_state_t *state);
+
+void cat_state_add_listener(cat_state_listener_t fn);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,49 +1,50 @@
 #include "atu.private.h"
 
-#include "cfg.h"
+#include "cfg.private.h"
 
 #include "../lvgl/lvgl.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define STR_INDIR(x) #x
-#define STR(x) STR_INDIR(x)
+/*
+ * Networks of all antennas are kept in memory, sorted by freq. Lookups never
+ * touch the database, new and updated networks are written by the cfg_save
+ * thread with the other changed items.
+ */
 
-#define ATU_SAVE_STEP 25000
+typedef struct {
+    int32_t  freq;
+    uint32_t network;
+    int32_t  db_freq;   /* Freq of the stored row, -1 if not stored yet */
+    bool     dirty;
+} atu_entry_t;
+
+typedef struct {
+    int32_t     ant;
+    atu_entry_t *items;
+    uint32_t    count;
+    uint32_t    allocated;
+} atu_ant_t;
 
 static sqlite3        *db;
 static sqlite3_stmt   *insert_stmt;
 static sqlite3_stmt   *update_stmt;
-static sqlite3_stmt   *read_stmt;
-static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t read_mutex  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t atu_mux = PTHREAD_MUTEX_INITIALIZER;
 
-static void    update_atu_network(Subject *subj, void *user_data);
-static void    add_atu_net_to_cache(int32_t freq, uint32_t network);
-static void    load_all_atu_for_ant(int32_t ant_id);
-static int32_t find_atu_for_freq(int32_t freq);
+static atu_ant_t      *ants = NULL;
+static uint32_t       ants_count = 0;
+static bool           dirty = false;
 
-atu_network_t atu_network;
-
-static struct atu_network_data_st {
-    int32_t  freq;
-    uint32_t network;
-} *atu_network_cache = NULL;
+static void update_atu_network(Subject *subj, void *user_data);
+static void load_all();
 
-static uint32_t atu_network_cache_size      = 0;
-static uint32_t atu_network_cache_allocated = 0;
-static uint32_t ant_id                      = -1;
+atu_network_t atu_network;
 
 void cfg_atu_init(sqlite3 *database) {
     db = database;
     int rc;
 
-    rc = sqlite3_prepare_v2(db, "SELECT freq, val FROM atu WHERE ant = :ant", -1, &read_stmt, 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
-        exit(1);
-    }
     rc = sqlite3_prepare_v2(db, "UPDATE atu SET freq = :freq, val = :val WHERE ant = :ant AND freq = :prev_freq", -1,
                             &update_stmt, 0);
     if (rc != SQLITE_OK) {
@@ -57,96 +58,228 @@ void cfg_atu_init(sqlite3 *database) {
         exit(1);
     }
 
-    atu_network_cache_allocated = 10;
-    atu_network_cache           = malloc(sizeof(*atu_network_cache) * atu_network_cache_allocated);
+    load_all();
 
     atu_network.loaded        = subject_create_int(false);
     atu_network.network        = subject_create_int(0);
 
-    subject_add_observer(cfg_cur.fg_freq, update_atu_network, NULL);
-    subject_add_observer(cfg.atu_enabled.val, update_atu_network, NULL);
-    subject_add_observer_and_call(cfg.ant_id.val, update_atu_network, NULL);
+    subject_add_coalesced_observer(cfg_cur.fg_freq, update_atu_network, NULL);
+    subject_add_coalesced_observer(cfg.atu_enabled.val, update_atu_network, NULL);
+    subject_add_coalesced_observer(cfg.ant_id.val, update_atu_network, NULL);
+    subject_add_coalesced_observer(cfg.atu_tolerance.val, update_atu_network, NULL);
+    update_atu_network(cfg.ant_id.val, NULL);
+}
+
+static atu_ant_t * get_ant(int32_t ant, bool create) {
+    for (uint32_t i = 0; i < ants_count; i++) {
+        if (ants[i].ant == ant) {
+            return &ants[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    ants = realloc(ants, sizeof(*ants) * (ants_count + 1));
+
+    atu_ant_t *item = &ants[ants_count++];
+
+    item->ant = ant;
+    item->items = NULL;
+    item->count = 0;
+    item->allocated = 0;
+
+    return item;
+}
+
+/**
+ * Position of the first entry with freq not less than given
+ */
+static uint32_t lower_bound(const atu_ant_t *ant, int32_t freq) {
+    uint32_t lo = 0;
+    uint32_t hi = ant->count;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (ant->items[mid].freq < freq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Nearest entry within tolerance, -1 if there is none
+ */
+static int32_t find_nearest(const atu_ant_t *ant, int32_t freq, int32_t tolerance) {
+    if (!ant || ant->count == 0) {
+        return -1;
+    }
+
+    uint32_t pos = lower_bound(ant, freq);
+    int32_t  best = -1;
+    int32_t  best_diff = tolerance + 1;
+
+    if (pos < ant->count) {
+        best_diff = abs(ant->items[pos].freq - freq);
+        best = pos;
+    }
+    if (pos > 0 && abs(ant->items[pos - 1].freq - freq) < best_diff) {
+        best_diff = abs(ant->items[pos - 1].freq - freq);
+        best = pos - 1;
+    }
+
+    return best_diff <= tolerance ? best : -1;
+}
+
+static atu_entry_t * insert_entry(atu_ant_t *ant, int32_t freq) {
+    if (ant->count >= ant->allocated) {
+        ant->allocated += 16;
+        ant->items = realloc(ant->items, sizeof(*ant->items) * ant->allocated);
+    }
+
+    uint32_t pos = lower_bound(ant, freq);
+
+    memmove(&ant->items[pos + 1], &ant->items[pos], (ant->count - pos) * sizeof(*ant->items));
+    ant->count++;
+
+    atu_entry_t *entry = &ant->items[pos];
+
+    entry->freq = freq;
+    entry->network = 0;
+    entry->db_freq = -1;
+    entry->dirty = false;
+
+    return entry;
+}
+
+/**
+ * Keep entries sorted after freq of one of them is changed
+ */
+static void resort_entry(atu_ant_t *ant, uint32_t pos) {
+    atu_entry_t entry = ant->items[pos];
+
+    while (pos > 0 && ant->items[pos - 1].freq > entry.freq) {
+        ant->items[pos] = ant->items[pos - 1];
+        pos--;
+    }
+    while (pos + 1 < ant->count && ant->items[pos + 1].freq < entry.freq) {
+        ant->items[pos] = ant->items[pos + 1];
+        pos++;
+    }
+    ant->items[pos] = entry;
 }
 
 int cfg_atu_save_network(uint32_t network) {
-    int     rc;
     int32_t ant_id = subject_get_int(cfg.ant_id.val);
     int32_t freq   = subject_get_int(cfg_cur.fg_freq);
 
     LV_LOG_INFO("Saving ATU network %u for freq: %i and ant: %i\n", network, freq, ant_id);
 
-    sqlite3_stmt *stmt;
-    int32_t       atu_pos = find_atu_for_freq(freq);
-    pthread_mutex_lock(&write_mutex);
-    if (atu_pos >= 0) {
-        stmt = update_stmt;
-        rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":prev_freq"), atu_network_cache[atu_pos].freq);
-        if (rc != SQLITE_OK) {
-            LV_LOG_ERROR("Failed to bind prev_freq %i: %s", atu_network_cache[atu_pos].freq, sqlite3_errmsg(db));
-            sqlite3_reset(stmt);
-            sqlite3_clear_bindings(stmt);
-            pthread_mutex_unlock(&write_mutex);
-            return rc;
-        }
+    pthread_mutex_lock(&atu_mux);
+
+    atu_ant_t   *ant = get_ant(ant_id, true);
+    int32_t     pos = find_nearest(ant, freq, subject_get_int(cfg.atu_tolerance.val));
+    atu_entry_t *entry;
+
+    if (pos >= 0) {
+        entry = &ant->items[pos];
+        entry->freq = freq;
+        entry->network = network;
+        entry->dirty = true;
+        resort_entry(ant, pos);
     } else {
-        stmt = insert_stmt;
+        entry = insert_entry(ant, freq);
+        entry->network = network;
+        entry->dirty = true;
     }
+    dirty = true;
 
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":ant"), ant_id);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind ant_id %i: %s", ant_id, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&write_mutex);
-        return rc;
-    }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":freq"), freq);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind freq %i: %s", freq, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&write_mutex);
-        return rc;
-    }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":val"), network);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind network %i: %s", network, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&write_mutex);
-        return rc;
+    pthread_mutex_unlock(&atu_mux);
+
+    cfg_save_request();
+
+    subject_set_int(atu_network.loaded, true);
+    subject_set_int(atu_network.network, network);
+
+    return 0;
+}
+
+static int store_entry(int32_t ant, atu_entry_t *entry) {
+    sqlite3_stmt *stmt = entry->db_freq >= 0 ? update_stmt : insert_stmt;
+    int          rc;
+
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":ant"), ant);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":freq"), entry->freq);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":val"), entry->network);
+
+    if (entry->db_freq >= 0) {
+        sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":prev_freq"), entry->db_freq);
     }
 
     rc = sqlite3_step(stmt);
+
     if (rc != SQLITE_DONE) {
         LV_LOG_ERROR("Failed save atu_params: %s", sqlite3_errmsg(db));
     } else {
         rc = 0;
-        add_atu_net_to_cache(freq, network);
-        subject_set_int(atu_network.loaded, true);
-        subject_set_int(atu_network.network, network);
+        entry->db_freq = entry->freq;
+        entry->dirty = false;
+        cfg_save_account(1, 3 * sizeof(int32_t));
     }
     sqlite3_reset(stmt);
     sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&write_mutex);
+
     return rc;
 }
 
+void cfg_atu_save_changed() {
+    cfg_save_begin();
+    pthread_mutex_lock(&atu_mux);
+
+    if (dirty) {
+        dirty = false;
+
+        for (uint32_t i = 0; i < ants_count; i++) {
+            for (uint32_t n = 0; n < ants[i].count; n++) {
+                if (ants[i].items[n].dirty && store_entry(ants[i].ant, &ants[i].items[n]) != 0) {
+                    dirty = true;
+                }
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&atu_mux);
+    cfg_save_end();
+}
+
 static void update_atu_network(Subject *subj, void *user_data) {
     if (!subject_get_int(cfg.atu_enabled.val)) {
         return;
     }
-    int32_t new_ant_id = subject_get_int(cfg.ant_id.val);
-    if (ant_id != new_ant_id) {
-        ant_id = new_ant_id;
-        load_all_atu_for_ant(ant_id);
-    }
+    int32_t ant_id  = subject_get_int(cfg.ant_id.val);
     int32_t freq    = subject_get_int(cfg_cur.fg_freq);
-    int32_t min_pos = find_atu_for_freq(freq);
-    if (min_pos >= 0) {
+    bool    found   = false;
+    uint32_t network = 0;
+
+    pthread_mutex_lock(&atu_mux);
+
+    atu_ant_t *ant = get_ant(ant_id, false);
+    int32_t   pos = find_nearest(ant, freq, subject_get_int(cfg.atu_tolerance.val));
+
+    if (pos >= 0) {
+        found = true;
+        network = ant->items[pos].network;
+    }
+    pthread_mutex_unlock(&atu_mux);
+
+    if (found) {
         subject_set_int(atu_network.loaded, true);
-        subject_set_int(atu_network.network, atu_network_cache[min_pos].network);
-        LV_LOG_INFO("Loaded ATU network for freq: %i, ant: %i -  %u", freq, ant_id, atu_network_cache[min_pos].network);
+        subject_set_int(atu_network.network, network);
+        LV_LOG_INFO("Loaded ATU network for freq: %i, ant: %i -  %u", freq, ant_id, network);
     } else {
         subject_set_int(atu_network.loaded, false);
         subject_set_int(atu_network.network, 0);
@@ -154,53 +287,33 @@ static void update_atu_network(Subject *subj, void *user_data) {
     }
 }
 
-static void add_atu_net_to_cache(int32_t freq, uint32_t network) {
-    if (atu_network_cache_size >= atu_network_cache_allocated) {
-        atu_network_cache_allocated += 10;
-        atu_network_cache = realloc(atu_network_cache, sizeof(*atu_network_cache) * atu_network_cache_allocated);
-    }
-    atu_network_cache[atu_network_cache_size].freq    = freq;
-    atu_network_cache[atu_network_cache_size].network = network;
-    atu_network_cache_size++;
-}
-
-static int32_t find_atu_for_freq(int32_t freq) {
-    int32_t min_diff = ATU_SAVE_STEP + 1;
-    int32_t diff, min_pos;
-    // search closest atu network
-    for (size_t i = 0; i < atu_network_cache_size; i++) {
-        diff = abs(atu_network_cache[i].freq - freq);
-        if (diff < min_diff) {
-            min_diff = diff;
-            min_pos  = i;
-        }
-    }
-    if (min_diff <= ATU_SAVE_STEP) {
-        return min_pos;
-    } else {
-        return -1;
-    }
-}
+static void load_all() {
+    sqlite3_stmt *stmt;
+    int          rc;
 
-static void load_all_atu_for_ant(int32_t ant_id) {
-    int           rc;
-    sqlite3_stmt *stmt = read_stmt;
-    pthread_mutex_lock(&read_mutex);
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":ant"), ant_id);
+    rc = sqlite3_prepare_v2(db, "SELECT ant, freq, val FROM atu ORDER BY ant, freq", -1, &stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind ant_id %i: %s", ant_id, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&read_mutex);
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
         return;
     }
 
-    atu_network_cache_size = 0;
+    atu_ant_t *ant = NULL;
+
     while (1) {
         rc = sqlite3_step(stmt);
 
         if (rc == SQLITE_ROW) {
-            add_atu_net_to_cache(sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1));
+            int32_t ant_id = sqlite3_column_int(stmt, 0);
+
+            if (!ant || ant->ant != ant_id) {
+                ant = get_ant(ant_id, true);
+            }
+
+            int32_t     freq = sqlite3_column_int(stmt, 1);
+            atu_entry_t *entry = insert_entry(ant, freq);
+
+            entry->network = sqlite3_column_int(stmt, 2);
+            entry->db_freq = freq;
         } else if (rc == SQLITE_DONE) {
             break;
         } else {
@@ -208,7 +321,5 @@ static void load_all_atu_for_ant(int32_t ant_id) {
             break;
         }
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&read_mutex);
+    sqlite3_finalize(stmt);
 }
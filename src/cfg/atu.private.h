@@ -8,3 +8,8 @@
 extern atu_network_t atu_network;
 
 void cfg_atu_init(sqlite3 *database);
+
+/**
+ * Write new and updated networks, called by the cfg_save thread
+ */
+void cfg_atu_save_changed();
@@ -8,6 +8,7 @@
 #include "transverter.h"
 
 #include "../lvgl/lvgl.h"
+#include "../util.h"
 #include "band.h"
 #include <aether_radio/x6100_control/control.h>
 #include <stdio.h>
@@ -17,24 +18,62 @@
 static sqlite3      *db;
 static sqlite3_stmt *insert_stmt;
 static sqlite3_stmt *read_stmt;
-static sqlite3_stmt *read_band_by_pk_stmt;
-static sqlite3_stmt *read_band_by_freq_stmt;
-static sqlite3_stmt *find_up_band_stmt;
-static sqlite3_stmt *find_down_band_stmt;
-static sqlite3_stmt *read_all_bands_stmt;
+static sqlite3_stmt *read_band_stmt;
 
 static pthread_mutex_t write_mutex             = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t read_mutex              = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t read_band_by_pk_mutex   = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t read_band_by_freq_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t find_up_down_band_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t read_all_bands_mutex    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t band_info_cache_mutex   = PTHREAD_MUTEX_INITIALIZER;
 
 static band_info_t _band_info_cache = {.id = BAND_UNDEFINED, .start_freq = 0, .stop_freq = 0};
 
+/*
+ * Copy of the bands table, loaded once and rebuilt on edit. Lookups are binary
+ * searches over it, so tuning doesn't query SQLite
+ */
+typedef struct {
+    band_info_t *all;       /* Sorted by id */
+    size_t       all_count;
+    band_info_t *active;    /* Active (type = 1) bands, sorted by start_freq */
+    uint32_t    *max_stop;  /* Max stop_freq of active[0..i] */
+    size_t       active_count;
+} band_index_t;
+
+static band_index_t     band_index;
+static pthread_rwlock_t band_index_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 cfg_band_t cfg_band;
 
+#define BAND_ITEMS          (sizeof(cfg_band_t) / sizeof(cfg_item_t))
+#define BAND_CACHE_SIZE     8
+
+/*
+ * Params of recently used and neighbor bands. A band switch stashes the items
+ * here and hydrates them from the entry of the new band, changed values are
+ * written later by the cfg_save thread. Neighbors of the current band are read
+ * ahead by the prefetch thread, with one query per band
+ */
+typedef struct {
+    bool        used;
+    int32_t     pk;
+    uint32_t    last_use;
+    int32_t     val[BAND_ITEMS];
+    bool        present[BAND_ITEMS];    /* Stored in DB or stashed */
+    bool        dirty[BAND_ITEMS];      /* Not written yet */
+} band_cache_t;
+
+static band_cache_t     band_cache[BAND_CACHE_SIZE];
+static uint32_t         band_cache_uses = 0;
+static bool             band_cache_dirty = false;
+static pthread_mutex_t  band_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t  prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   prefetch_cond = PTHREAD_COND_INITIALIZER;
+static int32_t          prefetch_pks[2];
+static uint8_t          prefetch_count = 0;
+
 static void init_db(sqlite3 *database);
+static void *prefetch_thread(void *arg);
+static void prefetch_neighbors();
 
 static void on_fg_freq_change(Subject *subj, void *user_data);
 static void on_bg_freq_change(Subject *subj, void *user_data);
@@ -99,6 +138,8 @@ void cfg_band_params_init(sqlite3 *database) {
 
     cfg_band.grid.min = (cfg_item_t){.val = subject_create_int(-121), .db_name = "grid_min", .pk = band_id};
     cfg_band.grid.max = (cfg_item_t){.val = subject_create_int(-73), .db_name = "grid_max", .pk = band_id};
+    cfg_band.grid.floor_pct = (cfg_item_t){.val = subject_create_int(15), .db_name = "grid_floor_pct", .pk = band_id};
+    cfg_band.grid.range     = (cfg_item_t){.val = subject_create_int(48), .db_name = "grid_range", .pk = band_id};
 
     cfg_band.vfo   = (cfg_item_t){.val = subject_create_int(X6100_VFO_A), .db_name = "vfo", .pk = band_id};
     cfg_band.split = (cfg_item_t){.val = subject_create_int(false), .db_name = "split", .pk = band_id};
@@ -127,6 +168,12 @@ void cfg_band_params_init(sqlite3 *database) {
     uint32_t    cfg_size = sizeof(cfg_band) / sizeof(*cfg_arr);
     init_items(cfg_arr, cfg_size, cfg_band_params_load_item, cfg_band_params_save_item);
     load_items_from_db(cfg_arr, cfg_size);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, prefetch_thread, NULL);
+    pthread_detach(thread);
+
+    prefetch_neighbors();
 }
 
 
@@ -143,18 +190,22 @@ void cfg_band_set_freq_for_vfo(x6100_vfo_t vfo, int32_t freq) {
     } else {
         target = &cfg_band.vfo_b;
     }
+    subject_batch_begin();
     if (new_band_id != target->freq.pk) {
-        cfg_band.vfo.pk = new_band_id;
-        save_item_to_db(&cfg_band.vfo, true);
+        int32_t cur_vfo = subject_get_int(cfg_band.vfo.val);
+
         // save old freq and update band_id
         cfg_band_params_save_all();
         cfg_band_params_change_pk(new_band_id);
         if (new_band_id != BAND_UNDEFINED) {
             cfg_band_params_load_all();
+            // The VFO is kept, it gets saved for the new band
+            subject_set_int(cfg_band.vfo.val, cur_vfo);
         }
         subject_set_int(cfg.band_id.val, new_band_id);
     }
     subject_set_int(target->freq.val, freq);
+    subject_batch_commit();
 }
 
 void cfg_band_vfo_copy() {
@@ -166,11 +217,13 @@ void cfg_band_vfo_copy() {
         src = &cfg_band.vfo_b;
         dst = &cfg_band.vfo_a;
     }
+    subject_batch_begin();
     subject_set_int(dst->freq.val, subject_get_int(src->freq.val));
     subject_set_int(dst->mode.val, subject_get_int(src->mode.val));
     subject_set_int(dst->agc.val, subject_get_int(src->agc.val));
     subject_set_int(dst->att.val, subject_get_int(src->att.val));
     subject_set_int(dst->pre.val, subject_get_int(src->pre.val));
+    subject_batch_commit();
 }
 
 void cfg_band_load_next(bool up) {
@@ -178,7 +231,9 @@ void cfg_band_load_next(bool up) {
     int32_t      cur_id    = cfg_band.vfo.pk;
     band_info_t *band_info = get_band_info_next(cur_freq, up, cur_id);
     if (band_info != NULL) {
+        subject_batch_begin();
         subject_set_int(cfg.band_id.val, band_info->id);
+        subject_batch_commit();
     }
 }
 
@@ -190,176 +245,398 @@ const char *cfg_band_label_get() {
     }
 }
 
+static int compare_band_id(const void *a, const void *b) {
+    const band_info_t *x = a;
+    const band_info_t *y = b;
+
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+static int compare_band_start(const void *a, const void *b) {
+    const band_info_t *x = a;
+    const band_info_t *y = b;
+
+    if (x->start_freq != y->start_freq) {
+        return (x->start_freq > y->start_freq) - (x->start_freq < y->start_freq);
+    }
+    return compare_band_id(a, b);
+}
+
+static void band_index_free(band_index_t *index) {
+    for (size_t i = 0; i < index->all_count; i++) {
+        free(index->all[i].name);
+    }
+    free(index->all);
+    free(index->active);
+    free(index->max_stop);
+    memset(index, 0, sizeof(*index));
+}
+
+void cfg_band_index_rebuild() {
+    sqlite3_stmt *stmt;
+    band_index_t  index = {0};
+    size_t        cap   = 32;
+    int           rc;
+
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT id, name, start_freq, stop_freq, type FROM bands", -1, &stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare read all bands statement: %s", sqlite3_errmsg(cfg_read_db()));
+        return;
+    }
+    index.all = malloc(sizeof(*index.all) * cap);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (index.all_count == cap) {
+            cap *= 2;
+            index.all = realloc(index.all, sizeof(*index.all) * cap);
+        }
+
+        band_info_t *band = &index.all[index.all_count++];
+        const char  *name = (const char *)sqlite3_column_text(stmt, 1);
+
+        band->id         = sqlite3_column_int(stmt, 0);
+        band->name       = strdup(name ? name : "");
+        band->start_freq = sqlite3_column_int(stmt, 2);
+        band->stop_freq  = sqlite3_column_int(stmt, 3);
+        band->active     = sqlite3_column_int(stmt, 4);
+    }
+    if (rc != SQLITE_DONE) {
+        LV_LOG_ERROR("Error while reading bands rows: %s", sqlite3_errmsg(cfg_read_db()));
+    }
+    sqlite3_finalize(stmt);
+
+    qsort(index.all, index.all_count, sizeof(*index.all), compare_band_id);
+
+    /* Active bands share names with the all array */
+    index.active   = malloc(sizeof(*index.active) * (index.all_count ? index.all_count : 1));
+    index.max_stop = malloc(sizeof(*index.max_stop) * (index.all_count ? index.all_count : 1));
+
+    for (size_t i = 0; i < index.all_count; i++) {
+        if (index.all[i].active == 1) {
+            index.active[index.active_count++] = index.all[i];
+        }
+    }
+    qsort(index.active, index.active_count, sizeof(*index.active), compare_band_start);
+
+    for (size_t i = 0; i < index.active_count; i++) {
+        uint32_t prev = i ? index.max_stop[i - 1] : 0;
+
+        index.max_stop[i] = LV_MAX(prev, index.active[i].stop_freq);
+    }
+
+    pthread_rwlock_wrlock(&band_index_lock);
+    band_index_free(&band_index);
+    band_index = index;
+    pthread_rwlock_unlock(&band_index_lock);
+
+    /* Cached band could be changed or removed */
+    pthread_mutex_lock(&band_info_cache_mutex);
+    _band_info_cache.id         = BAND_UNDEFINED;
+    _band_info_cache.start_freq = 0;
+    _band_info_cache.stop_freq  = 0;
+    pthread_mutex_unlock(&band_info_cache_mutex);
+
+    LV_LOG_USER("Loaded %zu bands (%zu active)", index.all_count, index.active_count);
+}
+
+/**
+ * Count of active bands with start_freq <= freq, call with band_index_lock held
+ */
+static size_t active_upper_bound(uint32_t freq) {
+    size_t lo = 0;
+    size_t hi = band_index.active_count;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+
+        if (band_index.active[mid].start_freq <= freq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static band_info_t *set_band_info_cache(const band_info_t *band) {
+    if (_band_info_cache.name) {
+        free(_band_info_cache.name);
+        _band_info_cache.name = NULL;
+    }
+    _band_info_cache            = *band;
+    _band_info_cache.name       = band->name ? strdup(band->name) : NULL;
+    return &_band_info_cache;
+}
+
 band_info_t *get_band_info_by_pk(int32_t band_id) {
-    int rc;
+    band_info_t *result = NULL;
+
+    pthread_mutex_lock(&band_info_cache_mutex);
     if (_band_info_cache.id == band_id) {
+        pthread_mutex_unlock(&band_info_cache_mutex);
         return &_band_info_cache;
     }
     LV_LOG_USER("Loading band info for id: %i", band_id);
-    sqlite3_stmt *stmt = read_band_by_pk_stmt;
-    pthread_mutex_lock(&read_band_by_pk_mutex);
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), band_id);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind bands_id %i: %s", band_id, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&read_band_by_pk_mutex);
-        return NULL;
-    }
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW) {
-        if (_band_info_cache.name) {
-            free(_band_info_cache.name);
-            _band_info_cache.name = NULL;
-        }
-        _band_info_cache.id         = band_id;
-        _band_info_cache.name       = strdup(sqlite3_column_text(stmt, 0));
-        _band_info_cache.start_freq = sqlite3_column_int(stmt, 1);
-        _band_info_cache.stop_freq  = sqlite3_column_int(stmt, 2);
-        _band_info_cache.active     = sqlite3_column_int(stmt, 3);
-        rc                          = 0;
+
+    pthread_rwlock_rdlock(&band_index_lock);
+    band_info_t  key  = {.id = band_id};
+    band_info_t *band = bsearch(&key, band_index.all, band_index.all_count, sizeof(key), compare_band_id);
+
+    if (band) {
+        result = set_band_info_cache(band);
     } else {
         LV_LOG_USER("No info for band with id: %i", band_id);
-        rc = -1;
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&read_band_by_pk_mutex);
-    if (rc == 0)
-        return &_band_info_cache;
-    else
-        return NULL;
+    pthread_rwlock_unlock(&band_index_lock);
+    pthread_mutex_unlock(&band_info_cache_mutex);
+
+    return result;
 }
 
 band_info_t *get_band_info_by_freq(uint32_t freq) {
-    if ((freq > _band_info_cache.start_freq) && (freq <= _band_info_cache.stop_freq))
+    band_info_t *result = NULL;
+
+    pthread_mutex_lock(&band_info_cache_mutex);
+    if ((freq > _band_info_cache.start_freq) && (freq <= _band_info_cache.stop_freq)) {
+        pthread_mutex_unlock(&band_info_cache_mutex);
         return &_band_info_cache;
-    LV_LOG_USER("Loading band info for freq: %u", freq);
-    int           rc;
-    sqlite3_stmt *stmt = read_band_by_freq_stmt;
-    pthread_mutex_lock(&read_band_by_freq_mutex);
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":freq"), freq);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind freq %lu to read_band_by_freq_stmt: %s", freq, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&read_band_by_freq_mutex);
-        return NULL;
     }
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW) {
-        if (_band_info_cache.name) {
-            free(_band_info_cache.name);
-            _band_info_cache.name = NULL;
-        }
-        if (sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
-            _band_info_cache.id     = sqlite3_column_int(stmt, 0);
-            _band_info_cache.name   = strdup(sqlite3_column_text(stmt, 1));
-            _band_info_cache.active = true;
-        } else {
-            _band_info_cache.id     = BAND_UNDEFINED;
-            _band_info_cache.active = false;
-        }
-        _band_info_cache.start_freq = sqlite3_column_int(stmt, 2);
-        if (sqlite3_column_type(stmt, 3) == SQLITE_NULL) {
-            _band_info_cache.stop_freq = 0LU - 1;
-        } else {
-            _band_info_cache.stop_freq = sqlite3_column_int(stmt, 3);
+    LV_LOG_USER("Loading band info for freq: %u", freq);
+
+    pthread_rwlock_rdlock(&band_index_lock);
+    size_t       pos   = active_upper_bound(freq);
+    band_info_t *found = NULL;
+
+    /* Bands could overlap, the one with the biggest id wins */
+    for (size_t i = pos; i > 0 && band_index.max_stop[i - 1] >= freq; i--) {
+        band_info_t *band = &band_index.active[i - 1];
+
+        if (band->stop_freq >= freq && (!found || band->id > found->id)) {
+            found = band;
         }
-        rc = 0;
+    }
+
+    if (found) {
+        result = set_band_info_cache(found);
+        _band_info_cache.active = true;
+    } else if (band_index.active_count > 0) {
+        /* Gap between bands */
+        band_info_t gap = {
+            .id         = BAND_UNDEFINED,
+            .name       = NULL,
+            .start_freq = pos > 0 ? band_index.max_stop[pos - 1] : 0,
+            .stop_freq  = pos < band_index.active_count ? band_index.active[pos].start_freq : 0LU - 1,
+            .active     = false,
+        };
+
+        result = set_band_info_cache(&gap);
     } else {
         LV_LOG_WARN("No band info for freq: %lu", freq);
-        rc = -1;
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&read_band_by_freq_mutex);
-    if (rc == 0) {
-        return &_band_info_cache;
+    pthread_rwlock_unlock(&band_index_lock);
+    pthread_mutex_unlock(&band_info_cache_mutex);
+
+    return result;
+}
+
+/**
+ * Next active band up or down from freq, call with band_index_lock held
+ */
+static band_info_t *find_next(uint32_t freq, bool up, int32_t cur_id) {
+    if (up) {
+        /* Lowest start_freq >= freq */
+        size_t lo = 0;
+        size_t hi = band_index.active_count;
+
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+
+            if (band_index.active[mid].start_freq < freq) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (size_t i = lo; i < band_index.active_count; i++) {
+            if (band_index.active[i].id != cur_id) {
+                return &band_index.active[i];
+            }
+        }
     } else {
-        return NULL;
+        /* Highest start_freq with stop_freq <= freq */
+        for (size_t i = active_upper_bound(freq); i > 0; i--) {
+            band_info_t *band = &band_index.active[i - 1];
+
+            if (band->stop_freq <= freq && band->id != cur_id) {
+                return band;
+            }
+        }
     }
+    return NULL;
 }
 
 band_info_t *get_band_info_next(uint32_t freq, bool up, int32_t cur_id) {
-    int           rc;
-    sqlite3_stmt *stmt;
-    pthread_mutex_lock(&find_up_down_band_mutex);
-    if (up) {
-        stmt = find_up_band_stmt;
+    band_info_t *result = NULL;
+    band_info_t *found;
+
+    pthread_mutex_lock(&band_info_cache_mutex);
+    pthread_rwlock_rdlock(&band_index_lock);
+
+    found = find_next(freq, up, cur_id);
+
+    if (found) {
+        result = set_band_info_cache(found);
+        _band_info_cache.active = true;
     } else {
-        stmt = find_down_band_stmt;
+        LV_LOG_INFO("No next band info for freq: %lu, cur_id: %i and direction: %u", freq, cur_id, up);
     }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":freq"), freq);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind freq %lu to find up/down stmt: %s", freq, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&find_up_down_band_mutex);
-        return NULL;
+    pthread_rwlock_unlock(&band_index_lock);
+    pthread_mutex_unlock(&band_info_cache_mutex);
+
+    return result;
+}
+
+uint32_t cfg_band_read_all_bands(band_info_t **results, int32_t *cap) {
+    uint32_t i = 0;
+
+    pthread_rwlock_rdlock(&band_index_lock);
+    for (; i < band_index.all_count; i++) {
+        if (i >= *cap) {
+            *cap *= 2;
+            *results = realloc(*results, sizeof(**results) * *cap);
+        }
+        (*results)[i]      = band_index.all[i];
+        (*results)[i].name = strdup(band_index.all[i].name);
     }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), cur_id);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to current band id %i to find up/down stmt: %s", cur_id, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&find_up_down_band_mutex);
-        return NULL;
+    pthread_rwlock_unlock(&band_index_lock);
+
+    return i;
+}
+
+/**
+ * Entry of the band, call with band_cache_mutex held
+ */
+static band_cache_t *cache_find(int32_t pk) {
+    for (size_t i = 0; i < BAND_CACHE_SIZE; i++) {
+        if (band_cache[i].used && band_cache[i].pk == pk) {
+            band_cache[i].last_use = ++band_cache_uses;
+            return &band_cache[i];
+        }
     }
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW) {
-        if (_band_info_cache.name) {
-            free(_band_info_cache.name);
-            _band_info_cache.name = NULL;
+    return NULL;
+}
+
+/**
+ * Free or least recently used entry without unwritten values, NULL if all of
+ * them wait for the cfg_save thread. Call with band_cache_mutex held
+ */
+static band_cache_t *cache_claim(int32_t pk) {
+    band_cache_t *res = NULL;
+
+    for (size_t i = 0; i < BAND_CACHE_SIZE; i++) {
+        band_cache_t *entry = &band_cache[i];
+        bool         dirty = false;
+
+        for (size_t n = 0; n < BAND_ITEMS && entry->used; n++) {
+            dirty |= entry->dirty[n];
+        }
+        if (dirty) {
+            continue;
+        }
+        if (!entry->used) {
+            res = entry;
+            break;
+        }
+        if (!res || entry->last_use < res->last_use) {
+            res = entry;
         }
-        _band_info_cache.id         = sqlite3_column_int(stmt, 0);
-        _band_info_cache.name       = strdup(sqlite3_column_text(stmt, 1));
-        _band_info_cache.active     = true;
-        _band_info_cache.start_freq = sqlite3_column_int(stmt, 2);
-        _band_info_cache.stop_freq  = sqlite3_column_int(stmt, 3);
-        rc                          = 0;
-    } else {
-        LV_LOG_INFO("No next band info for freq: %lu, cur_id: %i and direction: %u", freq, cur_id, up);
-        rc = -1;
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&find_up_down_band_mutex);
-    if (rc == 0) {
-        return &_band_info_cache;
-    } else {
-        return NULL;
+
+    if (res) {
+        memset(res, 0, sizeof(*res));
+        res->used = true;
+        res->pk = pk;
+        res->last_use = ++band_cache_uses;
     }
+    return res;
 }
 
-uint32_t cfg_band_read_all_bands(band_info_t **results, int32_t *cap) {
+/**
+ * All params of the band by one query
+ */
+static bool read_band(int32_t pk, int32_t *val, bool *present) {
+    cfg_item_t   *cfg_arr = (cfg_item_t *)&cfg_band;
+    sqlite3_stmt *stmt = read_band_stmt;
     int           rc;
-    sqlite3_stmt *stmt = read_all_bands_stmt;
-    uint32_t      i    = 0;
-    while (1) {
-        rc = sqlite3_step(stmt);
-
-        if (rc == SQLITE_ROW) {
-            if (i >= *cap) {
-                *cap *= 2;
-                *results = realloc(*results, sizeof(**results) * *cap);
+
+    memset(present, 0, sizeof(bool) * BAND_ITEMS);
+
+    pthread_mutex_lock(&read_mutex);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), pk);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 0);
+
+        for (size_t i = 0; name && i < BAND_ITEMS; i++) {
+            if (strcmp(name, cfg_arr[i].db_name) == 0) {
+                val[i] = sqlite3_column_int(stmt, 1);
+                present[i] = true;
+                break;
             }
-            (*results)[i].id         = sqlite3_column_int(stmt, 0);
-            (*results)[i].name       = strdup(sqlite3_column_text(stmt, 1));
-            (*results)[i].start_freq = sqlite3_column_int(stmt, 2);
-            (*results)[i].stop_freq  = sqlite3_column_int(stmt, 3);
-            (*results)[i].active     = sqlite3_column_int(stmt, 4);
-            i++;
-        } else if (rc == SQLITE_DONE) {
-            break;
-        } else {
-            LV_LOG_ERROR("Error while reading bands rows: %s", sqlite3_errmsg(db));
-            break;
         }
     }
+    if (rc != SQLITE_DONE) {
+        LV_LOG_ERROR("Failed to read band_params of bands_id %i: %s", pk, sqlite3_errmsg(cfg_read_db()));
+    }
     sqlite3_reset(stmt);
-    return i;
+    sqlite3_clear_bindings(stmt);
+    pthread_mutex_unlock(&read_mutex);
+
+    return rc == SQLITE_DONE;
 }
 
+/**
+ * Stash the items in the cache, changed ones are written by the cfg_save thread
+ */
 void cfg_band_params_save_all() {
-    cfg_item_t *cfg_arr      = (cfg_item_t *)&cfg_band;
-    int32_t     cfg_arr_size = sizeof(cfg_band) / sizeof(*cfg_arr);
+    cfg_item_t   *cfg_arr = (cfg_item_t *)&cfg_band;
+    bool         changed = false;
 
     LV_LOG_USER("Save band params for pk=%i", cfg_arr[0].pk);
-    for (size_t i = 0; i < cfg_arr_size; i++) {
-        save_item_to_db(&cfg_arr[i], false);
+
+    pthread_mutex_lock(&band_cache_mutex);
+    band_cache_t *entry = cache_find(cfg_arr[0].pk);
+
+    if (!entry) {
+        entry = cache_claim(cfg_arr[0].pk);
+    }
+    if (!entry) {
+        pthread_mutex_unlock(&band_cache_mutex);
+
+        /* Cache is full of unwritten bands */
+        save_items_to_db(cfg_arr, BAND_ITEMS);
+        return;
+    }
+
+    for (size_t i = 0; i < BAND_ITEMS; i++) {
+        pthread_mutex_lock(&cfg_arr[i].dirty->mux);
+        if (cfg_arr[i].dirty->val == ITEM_STATE_CHANGED) {
+            cfg_arr[i].dirty->val = ITEM_STATE_CLEAN;
+            entry->dirty[i] = true;
+            changed = true;
+        }
+        pthread_mutex_unlock(&cfg_arr[i].dirty->mux);
+
+        entry->val[i] = subject_get_int(cfg_arr[i].val);
+        entry->present[i] = true;
+    }
+    if (changed) {
+        band_cache_dirty = true;
+    }
+    pthread_mutex_unlock(&band_cache_mutex);
+
+    if (changed) {
+        cfg_save_request();
     }
 }
 
@@ -373,11 +650,90 @@ void cfg_band_params_change_pk(int32_t pk) {
     }
 }
 
+/**
+ * Set item of the new band, as cfg_band_params_load_item() does
+ */
+static void hydrate_item(cfg_item_t *item, int32_t val, const band_info_t *band_info) {
+    bool is_freq = (strcmp(item->db_name, "vfoa_freq") == 0) || (strcmp(item->db_name, "vfob_freq") == 0);
+
+    if (is_freq && band_info->id != BAND_UNDEFINED &&
+        (val < band_info->start_freq || val > band_info->stop_freq)) {
+        LV_LOG_USER("Freq %i for %s (band_id: %i) outside boundaries, cached value ignored", val, item->db_name,
+                    item->pk);
+        val = band_info->start_freq;
+    }
+    subject_set_int(item->val, val);
+}
+
+/**
+ * Hydrate the items from the cache, the DB is read on a miss. Unwritten values
+ * of the entry are handed over to the items
+ */
 void cfg_band_params_load_all() {
-    cfg_item_t *cfg_arr      = (cfg_item_t *)&cfg_band;
-    int32_t     cfg_arr_size = sizeof(cfg_band) / sizeof(*cfg_arr);
-    LV_LOG_USER("Load band params for pk=%i", cfg_arr[0].pk);
-    load_items_from_db(cfg_arr, cfg_arr_size);
+    cfg_item_t   *cfg_arr = (cfg_item_t *)&cfg_band;
+    int32_t      pk = cfg_arr[0].pk;
+    band_info_t  *band_info = get_band_info_by_pk(pk);
+    band_info_t  band;
+    int32_t      val[BAND_ITEMS];
+    bool         present[BAND_ITEMS];
+    bool         dirty[BAND_ITEMS] = { false };
+
+    if (!band_info) {
+        LV_LOG_ERROR("Can't load band info for pk: %i", pk);
+        return;
+    }
+    /* Observers of the items may look up other bands */
+    band = *band_info;
+
+    pthread_mutex_lock(&band_cache_mutex);
+    band_cache_t *entry = cache_find(pk);
+
+    if (entry) {
+        memcpy(val, entry->val, sizeof(val));
+        memcpy(present, entry->present, sizeof(present));
+        memcpy(dirty, entry->dirty, sizeof(dirty));
+        memset(entry->dirty, 0, sizeof(entry->dirty));
+    }
+    pthread_mutex_unlock(&band_cache_mutex);
+
+    if (entry) {
+        LV_LOG_USER("Load band params for pk=%i from cache", pk);
+    } else {
+        LV_LOG_USER("Load band params for pk=%i", pk);
+
+        if (!read_band(pk, val, present)) {
+            /* Items will be read one by one */
+            load_items_from_db(cfg_arr, BAND_ITEMS);
+            prefetch_neighbors();
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < BAND_ITEMS; i++) {
+        cfg_item_t *item = &cfg_arr[i];
+
+        item->dirty->val = ITEM_STATE_LOADING;
+
+        if (present[i]) {
+            hydrate_item(item, val[i], &band);
+        } else if (strcmp(item->db_name, "vfob_freq") == 0) {
+            LV_LOG_USER("Copy vfoa freq to vfob");
+            hydrate_item(item, subject_get_int(cfg_band.vfo_a.freq.val), &band);
+        } else {
+            LV_LOG_WARN("No results for load from band_params with name: %s and bands_id: %i", item->db_name, pk);
+            // Save with default value
+            dirty[i] = true;
+        }
+        item->dirty->val = dirty[i] ? ITEM_STATE_CHANGED : ITEM_STATE_CLEAN;
+    }
+
+    for (size_t i = 0; i < BAND_ITEMS; i++) {
+        if (dirty[i]) {
+            cfg_save_request();
+            break;
+        }
+    }
+    prefetch_neighbors();
 }
 
 int cfg_band_params_load_item(cfg_item_t *item) {
@@ -392,26 +748,14 @@ int cfg_band_params_load_item(cfg_item_t *item) {
         LV_LOG_ERROR("Can't load band info for pk: %i", item->pk);
         return -1;
     }
-    sqlite3_stmt *stmt = read_stmt;
-    pthread_mutex_lock(&read_mutex);
     int     rc;
     int32_t int_val;
-    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":name"), item->db_name, strlen(item->db_name), 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind name %s: %s", item->db_name, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), item->pk);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind bands_id %i: %s", item->pk, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
+    int64_t val;
+    double  float_val;
 
-    rc = sqlite3_step(stmt);
+    rc = cfg_item_read(CFG_TABLE_BAND_PARAMS, read_stmt, &read_mutex, item, &val, &float_val);
     if (rc == SQLITE_ROW) {
-        int_val = sqlite3_column_int(stmt, 0);
+        int_val = (int32_t)val;
         rc = 0;
     } else {
         if (strcmp(item->db_name, "vfob_freq") == 0) {
@@ -425,9 +769,6 @@ int cfg_band_params_load_item(cfg_item_t *item) {
             rc = -1;
         }
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&read_mutex);
 
     if (rc == 0) {
         LV_LOG_USER("Loaded %s=%i (pk=%i)", item->db_name, int_val, item->pk);
@@ -447,9 +788,12 @@ int cfg_band_params_load_item(cfg_item_t *item) {
     return rc;
 }
 
-int cfg_band_params_save_item(cfg_item_t *item) {
+/**
+ * Write a value of the band, freqs outside of the band are not saved
+ */
+static int store_value(int32_t pk, const char *name, int32_t int_val) {
     int32_t      start_freq, stop_freq, band_id;
-    band_info_t *band_info = get_band_info_by_pk(item->pk);
+    band_info_t *band_info = get_band_info_by_pk(pk);
     if (!band_info) {
         band_id = BAND_UNDEFINED;
     } else {
@@ -460,56 +804,44 @@ int cfg_band_params_save_item(cfg_item_t *item) {
     sqlite3_stmt *stmt = insert_stmt;
     pthread_mutex_lock(&write_mutex);
     int     rc;
-    int32_t int_val;
 
-    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":name"), item->db_name, strlen(item->db_name), 0);
+    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":name"), name, strlen(name), 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind name %s: %s", item->db_name, sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed to bind name %s: %s", name, sqlite3_errmsg(db));
         pthread_mutex_unlock(&write_mutex);
         return rc;
     }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), item->pk);
+    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), pk);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind bands_id %i: %s", item->pk, sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed to bind bands_id %i: %s", pk, sqlite3_errmsg(db));
         pthread_mutex_unlock(&write_mutex);
         return rc;
     }
     int val_index = sqlite3_bind_parameter_index(stmt, ":val");
-    enum data_type dtype = subject_get_dtype(item->val);
-    switch (dtype) {
-        case DTYPE_INT:
-            int_val = subject_get_int(item->val);
-            // Check that freq match band
-            if ((strcmp(item->db_name, "vfoa_freq") == 0) || (strcmp(item->db_name, "vfob_freq") == 0)) {
-                if ((band_id == BAND_UNDEFINED) || ((int_val >= start_freq) && (int_val <= stop_freq))) {
-                    rc = sqlite3_bind_int(stmt, val_index, int_val);
-                } else {
-                    LV_LOG_USER("Freq %lu for %s (band_id: %u) outside boundaries, will not save", int_val,
-                                item->db_name, item->pk);
-                    rc = -1;
-                }
-            } else {
-                rc = sqlite3_bind_int(stmt, val_index, int_val);
-            }
-            break;
-        default:
-            LV_LOG_WARN("Unknown item %s dtype: %u, will not save", item->db_name, dtype);
-            sqlite3_reset(stmt);
-            sqlite3_clear_bindings(stmt);
-            pthread_mutex_unlock(&write_mutex);
-            return -1;
-            break;
+    // Check that freq match band
+    if ((strcmp(name, "vfoa_freq") == 0) || (strcmp(name, "vfob_freq") == 0)) {
+        if ((band_id == BAND_UNDEFINED) || ((int_val >= start_freq) && (int_val <= stop_freq))) {
+            rc = sqlite3_bind_int(stmt, val_index, int_val);
+        } else {
+            LV_LOG_USER("Freq %lu for %s (band_id: %u) outside boundaries, will not save", int_val,
+                        name, pk);
+            rc = -1;
+        }
+    } else {
+        rc = sqlite3_bind_int(stmt, val_index, int_val);
     }
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind val for name %s: %s", item->db_name, sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed to bind val for name %s: %s", name, sqlite3_errmsg(db));
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
         pthread_mutex_unlock(&write_mutex);
         return rc;
     }
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_DONE) {
-        LV_LOG_ERROR("Failed save item %s: %s", item->db_name, sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed save item %s: %s", name, sqlite3_errmsg(db));
     } else {
-        LV_LOG_USER("Saved %s=%i (pk=%i)", item->db_name, int_val, item->pk);
+        LV_LOG_USER("Saved %s=%i (pk=%i)", name, int_val, pk);
         rc = 0;
     }
     sqlite3_reset(stmt);
@@ -518,63 +850,140 @@ int cfg_band_params_save_item(cfg_item_t *item) {
     return rc;
 }
 
-static void init_db(sqlite3 *database) {
-    db = database;
-    int rc;
-    rc = sqlite3_prepare_v2(db, "SELECT val FROM band_params WHERE bands_id = :id AND name = :name", -1, &read_stmt, 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
-        exit(1);
+int cfg_band_params_save_item(cfg_item_t *item) {
+    enum data_type dtype = subject_get_dtype(item->val);
+
+    if (dtype != DTYPE_INT) {
+        LV_LOG_WARN("Unknown item %s dtype: %u, will not save", item->db_name, dtype);
+        return -1;
     }
-    rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO band_params(bands_id, name, val) VALUES(:id, :name, :val)", -1,
-                            &insert_stmt, 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare write statement: %s", sqlite3_errmsg(db));
-        exit(1);
+    return store_value(item->pk, item->db_name, subject_get_int(item->val));
+}
+
+void cfg_band_params_save_changed() {
+    cfg_item_t *cfg_arr = (cfg_item_t *)&cfg_band;
+
+    cfg_save_begin();
+    pthread_mutex_lock(&band_cache_mutex);
+
+    if (band_cache_dirty) {
+        band_cache_dirty = false;
+
+        for (size_t i = 0; i < BAND_CACHE_SIZE; i++) {
+            band_cache_t *entry = &band_cache[i];
+
+            for (size_t n = 0; n < BAND_ITEMS && entry->used; n++) {
+                if (!entry->dirty[n]) {
+                    continue;
+                }
+                /* Values outside of the band are dropped, as by the items */
+                if (store_value(entry->pk, cfg_arr[n].db_name, entry->val[n]) == 0) {
+                    cfg_save_account(1, strlen(cfg_arr[n].db_name) + 2 * sizeof(int32_t));
+                }
+                entry->dirty[n] = false;
+            }
+        }
     }
-    rc = sqlite3_prepare_v2(db, "SELECT name, start_freq, stop_freq, type FROM bands WHERE id = :id", -1,
-                            &read_band_by_pk_stmt, 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read_band_by_pk_stmt statement: %s", sqlite3_errmsg(db));
-        exit(1);
+
+    pthread_mutex_unlock(&band_cache_mutex);
+    cfg_save_end();
+}
+
+/**
+ * Read the neighbors of the current band in the band list ahead
+ */
+static void prefetch_neighbors() {
+    int32_t     pk = cfg_band.vfo.pk;
+    bool        vfo_a = subject_get_int(cfg_band.vfo.val) == X6100_VFO_A;
+    uint32_t    freq = subject_get_int(vfo_a ? cfg_band.vfo_a.freq.val : cfg_band.vfo_b.freq.val);
+
+    pthread_mutex_lock(&prefetch_mutex);
+    pthread_rwlock_rdlock(&band_index_lock);
+
+    prefetch_count = 0;
+
+    for (int up = 0; up < 2; up++) {
+        band_info_t *band = find_next(freq, up, pk);
+
+        if (band) {
+            prefetch_pks[prefetch_count++] = band->id;
+        }
     }
-    rc = sqlite3_prepare_v2(
-        db,
-        "SELECT id, name, start_freq, stop_freq FROM bands WHERE "
-        "   (:freq >= start_freq) AND (:freq <= stop_freq) AND (type = 1) "
-        "UNION SELECT * FROM ("
-        "   SELECT NULL, NULL, a.stop_freq, b.start_freq FROM ("
-        "       SELECT stop_freq FROM bands WHERE :freq > stop_freq AND type = 1 ORDER BY stop_freq DESC LIMIT 1"
-        "   ) AS a FULL OUTER JOIN ("
-        "       SELECT start_freq FROM bands WHERE :freq < start_freq AND type = 1 ORDER BY start_freq LIMIT 1"
-        "   ) AS b"
-        ") ORDER BY id DESC NULLS LAST LIMIT 1",
-        -1, &read_band_by_freq_stmt, 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read_band_by_freq_stmt statement: %s", sqlite3_errmsg(db));
-        exit(1);
+    pthread_rwlock_unlock(&band_index_lock);
+
+    if (prefetch_count) {
+        pthread_cond_signal(&prefetch_cond);
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+static void *prefetch_thread(void *arg) {
+    set_thread_name("cfg_prefetch");
+
+    while (true) {
+        int32_t pks[2];
+        uint8_t count;
+
+        pthread_mutex_lock(&prefetch_mutex);
+        while (!prefetch_count) {
+            pthread_cond_wait(&prefetch_cond, &prefetch_mutex);
+        }
+        count = prefetch_count;
+        memcpy(pks, prefetch_pks, sizeof(pks));
+        prefetch_count = 0;
+        pthread_mutex_unlock(&prefetch_mutex);
+
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t val[BAND_ITEMS];
+            bool    present[BAND_ITEMS];
+            bool    cached;
+
+            pthread_mutex_lock(&band_cache_mutex);
+            cached = cache_find(pks[i]) != NULL;
+            pthread_mutex_unlock(&band_cache_mutex);
+
+            if (cached || !read_band(pks[i], val, present)) {
+                continue;
+            }
+
+            pthread_mutex_lock(&band_cache_mutex);
+
+            /* The band could be stashed meanwhile, its values are newer */
+            if (!cache_find(pks[i])) {
+                band_cache_t *entry = cache_claim(pks[i]);
+
+                if (entry) {
+                    memcpy(entry->val, val, sizeof(val));
+                    memcpy(entry->present, present, sizeof(present));
+                    LV_LOG_INFO("Prefetched band params for pk=%i", pks[i]);
+                }
+            }
+            pthread_mutex_unlock(&band_cache_mutex);
+        }
     }
-    rc = sqlite3_prepare_v2(db,
-                            "SELECT id, name, start_freq, stop_freq, type FROM bands "
-                            "WHERE :freq <= start_freq AND id != :id AND type = 1 ORDER BY start_freq LIMIT 1",
-                            -1, &find_up_band_stmt, 0);
+    return NULL;
+}
+
+static void init_db(sqlite3 *database) {
+    db = database;
+    int rc;
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT val FROM band_params WHERE bands_id = :id AND name = :name", -1, &read_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare find_up_band_stmt statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
-    rc = sqlite3_prepare_v2(db,
-                            "SELECT id, name, start_freq, stop_freq, type FROM bands "
-                            "WHERE :freq >= stop_freq AND id != :id AND type = 1 ORDER BY start_freq DESC LIMIT 1",
-                            -1, &find_down_band_stmt, 0);
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT name, val FROM band_params WHERE bands_id = :id", -1, &read_band_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare find_down_band_stmt statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare read band statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
-    rc = sqlite3_prepare_v2(db, "SELECT id, name, start_freq, stop_freq, type FROM bands", -1, &read_all_bands_stmt, 0);
+    rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO band_params(bands_id, name, val) VALUES(:id, :name, :val)", -1,
+                            &insert_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read_all_bands statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare write statement: %s", sqlite3_errmsg(db));
         exit(1);
     }
+    cfg_band_index_rebuild();
 }
 
 static void on_fg_freq_change(Subject *subj, void *user_data) {
@@ -680,9 +1089,11 @@ static void on_ab_pre_change(Subject *subj, void *user_data) {
 static void on_band_id_change(Subject *subj, void *user_data) {
     int32_t new_band_id = subject_get_int(subj);
     if (new_band_id != cfg_band.vfo.pk) {
+        subject_batch_begin();
         cfg_band_params_save_all();
         cfg_band_params_change_pk(new_band_id);
         cfg_band_params_load_all();
+        subject_batch_commit();
     }
 }
 
@@ -703,12 +1114,14 @@ static void on_vfo_change(Subject *subj, void *user_data) {
         pre_src    = cfg_band.vfo_b.pre.val;
         att_src    = cfg_band.vfo_b.att.val;
     }
+    subject_batch_begin();
     subject_set_int(cfg_cur.fg_freq, subject_get_int(fg_freq_src));
     subject_set_int(cfg_cur.bg_freq, subject_get_int(bg_freq_src));
     subject_set_int(cfg_cur.mode, subject_get_int(mode_src));
     subject_set_int(cfg_cur.agc, subject_get_int(agc_src));
     subject_set_int(cfg_cur.pre, subject_get_int(pre_src));
     subject_set_int(cfg_cur.att, subject_get_int(att_src));
+    subject_batch_commit();
 }
 
 static void on_cur_mode_change(Subject *subj, void *user_data) {
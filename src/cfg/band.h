@@ -29,6 +29,8 @@ typedef struct {
     struct {
         cfg_item_t min;
         cfg_item_t max;
+        cfg_item_t floor_pct; // Auto min/max: noise floor percentile
+        cfg_item_t range;     // Auto min/max: dB from noise floor to max
     } grid;
 } cfg_band_t;
 
@@ -38,3 +40,8 @@ void        cfg_band_vfo_copy();
 void        cfg_band_load_next(bool up);
 const char *cfg_band_label_get();
 uint32_t    cfg_band_read_all_bands(band_info_t **results, int32_t *cap);
+
+/**
+ * Reload the in-memory copy of the bands table, call after editing it
+ */
+void        cfg_band_index_rebuild();
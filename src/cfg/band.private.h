@@ -19,3 +19,8 @@ void cfg_band_params_change_pk(int32_t pk);
 void cfg_band_params_load_all();
 int cfg_band_params_load_item(cfg_item_t *item);
 int cfg_band_params_save_item(cfg_item_t *item);
+
+/**
+ * Write stashed params of other bands, called by the cfg_save thread
+ */
+void cfg_band_params_save_changed();
@@ -7,13 +7,21 @@
 #include "transverter.private.h"
 #include "memory.private.h"
 #include "digital_modes.private.h"
+#include "swrscan.private.h"
+#include "profile.private.h"
 
 #include "../lvgl/lvgl.h"
 #include "../util.h"
 #include <aether_radio/x6100_control/control.h>
 
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAVE_INTERVAL_MS    5000
 
 cfg_t cfg;
 
@@ -21,6 +29,36 @@ cfg_cur_t cfg_cur;
 
 static band_info_t cur_band_info;
 
+/* Persistence: one transaction at a time for all tables */
+static sqlite3          *save_db = NULL;
+static sqlite3          *reader_db = NULL;
+static pthread_mutex_t  save_mux;
+static uint32_t         save_depth = 0;
+
+static pthread_mutex_t  pending_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   pending_cond = PTHREAD_COND_INITIALIZER;
+static bool             pending = false;
+static bool             flush_req = false;
+static uint32_t         flush_seq = 0;
+
+/* Startup bulk load */
+static struct {
+    cfg_preload_row_t   *rows;
+    size_t              count;
+    bool                active;
+} preload[CFG_TABLE_LAST];
+
+static const char *preload_sql[CFG_TABLE_LAST] = {
+    [CFG_TABLE_PARAMS]      = "SELECT 0, name, val FROM params",
+    [CFG_TABLE_BAND_PARAMS] = "SELECT bands_id, name, val FROM band_params",
+    [CFG_TABLE_MODE_PARAMS] = "SELECT mode, name, val FROM mode_params",
+    [CFG_TABLE_TRANSVERTER] = "SELECT id, name, val FROM transverter",
+};
+
+static atomic_uint      stats_transactions;
+static atomic_uint      stats_writes;
+static atomic_ullong    stats_bytes;
+
 static int init_params_cfg(sqlite3 *db);
 // static int init_band_cfg(sqlite3 *db);
 // static int init_mode_cfg(sqlite3 *db);
@@ -28,6 +66,9 @@ static int init_params_cfg(sqlite3 *db);
 
 static void *params_save_thread(void *arg);
 
+static void preload_tables(sqlite3 *db);
+static void preload_free();
+
 static void on_key_tone_change(Subject *subj, void *user_data);
 static void on_item_change(Subject *subj, void *user_data);
 static void on_vfo_change(Subject *subj, void *user_data);
@@ -53,8 +94,29 @@ static void on_cur_zoom_change(Subject *subj, void *user_data);
 #include "test_cfg.c"
 #endif
 
-int cfg_init(sqlite3 *db) {
+sqlite3 * cfg_read_db() {
+    return reader_db;
+}
+
+int cfg_init(sqlite3 *db, sqlite3 *read_db) {
     int rc;
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&save_mux, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    save_db = db;
+    reader_db = read_db;
+
+    preload_tables(db);
+
+    const char *stats = getenv("X6100_SUBJECT_STATS");
+
+    if (stats && stats[0] == '1') {
+        subject_stats_enable(true);
+    }
 
     rc = init_params_cfg(db);
     if (rc != 0) {
@@ -82,6 +144,9 @@ int cfg_init(sqlite3 *db) {
     cfg_transverter_init(db);
     cfg_memory_init(db);
     cfg_digital_modes_init(db);
+    cfg_swrscan_init(db);
+    cfg_profile_init(db);
+    preload_free();
 
     pthread_t thread;
     pthread_create(&thread, NULL, params_save_thread, NULL);
@@ -104,6 +169,144 @@ static void on_item_change(Subject *subj, void *user_data) {
         LV_LOG_INFO("Set dirty %s (pk=%i)", item->db_name, item->pk);
     }
     pthread_mutex_unlock(&item->dirty->mux);
+
+    cfg_save_request();
+}
+
+void cfg_save_request() {
+    pthread_mutex_lock(&pending_mux);
+    if (!pending) {
+        pending = true;
+        pthread_cond_signal(&pending_cond);
+    }
+    pthread_mutex_unlock(&pending_mux);
+}
+
+/**
+ * Bulk load
+ */
+static int compare_preload_row(const void *a, const void *b) {
+    const cfg_preload_row_t *x = a;
+    const cfg_preload_row_t *y = b;
+
+    if (x->pk != y->pk) {
+        return (x->pk > y->pk) - (x->pk < y->pk);
+    }
+    return strcmp(x->name, y->name);
+}
+
+static void preload_tables(sqlite3 *db) {
+    uint64_t start = get_time();
+
+    for (size_t t = 0; t < CFG_TABLE_LAST; t++) {
+        sqlite3_stmt *stmt;
+        size_t        cap = 64;
+        int           rc;
+
+        rc = sqlite3_prepare_v2(db, preload_sql[t], -1, &stmt, 0);
+        if (rc != SQLITE_OK) {
+            LV_LOG_ERROR("Failed prepare bulk load statement: %s", sqlite3_errmsg(db));
+            continue;
+        }
+        preload[t].rows  = malloc(sizeof(*preload[t].rows) * cap);
+        preload[t].count = 0;
+
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const char *name = (const char *)sqlite3_column_text(stmt, 1);
+
+            if (!name) {
+                continue;
+            }
+            if (preload[t].count == cap) {
+                cap *= 2;
+                preload[t].rows = realloc(preload[t].rows, sizeof(*preload[t].rows) * cap);
+            }
+
+            cfg_preload_row_t *row = &preload[t].rows[preload[t].count++];
+
+            row->pk        = sqlite3_column_int(stmt, 0);
+            row->name      = strdup(name);
+            row->int_val   = sqlite3_column_int64(stmt, 2);
+            row->float_val = sqlite3_column_double(stmt, 2);
+        }
+        sqlite3_finalize(stmt);
+
+        if (rc != SQLITE_DONE) {
+            /* Items will be read one by one */
+            LV_LOG_ERROR("Error during bulk load: %s", sqlite3_errmsg(db));
+            preload[t].active = false;
+            continue;
+        }
+        qsort(preload[t].rows, preload[t].count, sizeof(*preload[t].rows), compare_preload_row);
+        preload[t].active = true;
+    }
+    LV_LOG_USER("Bulk load of cfg tables: %llu ms", get_time() - start);
+}
+
+static void preload_free() {
+    for (size_t t = 0; t < CFG_TABLE_LAST; t++) {
+        for (size_t i = 0; i < preload[t].count; i++) {
+            free(preload[t].rows[i].name);
+        }
+        free(preload[t].rows);
+        preload[t].rows   = NULL;
+        preload[t].count  = 0;
+        preload[t].active = false;
+    }
+}
+
+bool cfg_preload_active(cfg_table_t table) {
+    return preload[table].active;
+}
+
+const cfg_preload_row_t *cfg_preload_find(cfg_table_t table, int32_t pk, const char *name) {
+    cfg_preload_row_t key = {.pk = pk, .name = (char *)name};
+
+    return bsearch(&key, preload[table].rows, preload[table].count, sizeof(key), compare_preload_row);
+}
+
+int cfg_item_read(cfg_table_t table, sqlite3_stmt *stmt, pthread_mutex_t *mux, cfg_item_t *item,
+                  int64_t *int_val, double *float_val) {
+    int rc;
+
+    if (preload[table].active) {
+        const cfg_preload_row_t *row = cfg_preload_find(table, item->pk, item->db_name);
+
+        if (!row) {
+            return SQLITE_DONE;
+        }
+        *int_val   = row->int_val;
+        *float_val = row->float_val;
+        return SQLITE_ROW;
+    }
+
+    pthread_mutex_lock(mux);
+    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":name"), item->db_name, strlen(item->db_name), 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed to bind name %s: %s", item->db_name, sqlite3_errmsg(sqlite3_db_handle(stmt)));
+        goto out;
+    }
+
+    int id_index = sqlite3_bind_parameter_index(stmt, ":id");
+
+    if (id_index) {
+        rc = sqlite3_bind_int(stmt, id_index, item->pk);
+        if (rc != SQLITE_OK) {
+            LV_LOG_ERROR("Failed to bind id %i: %s", item->pk, sqlite3_errmsg(sqlite3_db_handle(stmt)));
+            goto out;
+        }
+    }
+
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *int_val   = sqlite3_column_int64(stmt, 0);
+        *float_val = sqlite3_column_double(stmt, 0);
+    }
+out:
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    pthread_mutex_unlock(mux);
+    return rc;
 }
 
 /**
@@ -137,7 +340,8 @@ void init_items(cfg_item_t *cfg_arr, uint32_t count, int (*load)(struct cfg_item
         cfg_arr[i].dirty      = malloc(sizeof(*cfg_arr[i].dirty));
         cfg_arr[i].dirty->val = ITEM_STATE_CLEAN;
         pthread_mutex_init(&cfg_arr[i].dirty->mux, NULL);
-        Observer *o = subject_add_observer(cfg_arr[i].val, on_item_change, &cfg_arr[i]);
+        subject_set_name(cfg_arr[i].val, cfg_arr[i].db_name);
+        Observer *o = subject_add_immediate_observer(cfg_arr[i].val, on_item_change, &cfg_arr[i]);
     }
 }
 /**
@@ -164,28 +368,123 @@ int load_items_from_db(cfg_item_t *cfg_arr, uint32_t count) {
 
 void save_item_to_db(cfg_item_t *item, bool force) {
     int rc;
+    /* Transaction first, save_mux is always taken before item's mux */
+    cfg_save_begin();
     pthread_mutex_lock(&item->dirty->mux);
     if ((item->dirty->val == ITEM_STATE_CHANGED) || force) {
         rc = item->save(item);
         if (rc != 0) {
             LV_LOG_USER("Can't save %s (pk=%i)", item->db_name, item->pk);
+        } else {
+            /* name, pk and value */
+            cfg_save_account(1, strlen(item->db_name) + 2 * sizeof(int32_t));
         }
         item->dirty->val = ITEM_STATE_CLEAN;
     }
     pthread_mutex_unlock(&item->dirty->mux);
+    cfg_save_end();
 }
 
 void save_items_to_db(cfg_item_t *cfg_arr, uint32_t cfg_size) {
-    int rc;
+    cfg_save_begin();
     for (size_t i = 0; i < cfg_size; i++) {
         save_item_to_db(&cfg_arr[i], false);
     }
+    cfg_save_end();
+}
+
+void cfg_save_begin() {
+    pthread_mutex_lock(&save_mux);
+
+    if (save_depth++ == 0 && save_db) {
+        if (sqlite3_exec(save_db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+            LV_LOG_ERROR("Can't begin transaction: %s", sqlite3_errmsg(save_db));
+        }
+    }
+}
+
+void cfg_save_end() {
+    if (--save_depth == 0 && save_db && !sqlite3_get_autocommit(save_db)) {
+        if (sqlite3_exec(save_db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+            LV_LOG_ERROR("Can't commit transaction: %s", sqlite3_errmsg(save_db));
+        } else {
+            atomic_fetch_add(&stats_transactions, 1);
+        }
+    }
+    pthread_mutex_unlock(&save_mux);
+}
+
+void cfg_save_account(uint32_t writes, uint32_t bytes) {
+    atomic_fetch_add(&stats_writes, writes);
+    atomic_fetch_add(&stats_bytes, bytes);
+}
+
+void cfg_save_stats(cfg_save_stats_t *stats) {
+    stats->transactions = atomic_load(&stats_transactions);
+    stats->writes = atomic_load(&stats_writes);
+    stats->bytes = atomic_load(&stats_bytes);
+}
+
+void cfg_save_flush() {
+    pthread_mutex_lock(&pending_mux);
+
+    uint32_t seq = flush_seq;
+
+    flush_req = true;
+    pthread_cond_signal(&pending_cond);
+
+    while (flush_seq == seq) {
+        pthread_cond_wait(&pending_cond, &pending_mux);
+    }
+    pthread_mutex_unlock(&pending_mux);
+}
+
+/**
+ * Wait for changes, but commit not more often than SAVE_INTERVAL_MS. Returns true for a flush
+ */
+static bool wait_changes(uint64_t last_save) {
+    bool flush;
+
+    pthread_mutex_lock(&pending_mux);
+
+    while (!pending && !flush_req) {
+        pthread_cond_wait(&pending_cond, &pending_mux);
+    }
+
+    while (!flush_req) {
+        int64_t left = (int64_t) (last_save + SAVE_INTERVAL_MS) - (int64_t) get_time();
+
+        if (left <= 0) {
+            break;
+        }
+
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += left / 1000;
+        ts.tv_nsec += (left % 1000) * 1000000L;
+
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pending_cond, &pending_mux, &ts);
+    }
+
+    flush = flush_req;
+    flush_req = false;
+    pending = false;
+    pthread_mutex_unlock(&pending_mux);
+
+    return flush;
 }
 
 /**
  * Save thread
  */
 static void *params_save_thread(void *arg) {
+    set_thread_name("cfg_save");
+
     cfg_item_t *cfg_arr;
     cfg_arr           = (cfg_item_t *)&cfg;
     uint32_t cfg_size = sizeof(cfg) / sizeof(cfg_item_t);
@@ -202,12 +501,28 @@ static void *params_save_thread(void *arg) {
     cfg_transverter_arr           = (cfg_item_t *)&cfg_transverters;
     uint32_t cfg_transverter_size = sizeof(cfg_transverters) / sizeof(cfg_item_t);
 
+    uint64_t last_save = 0;
+
     while (true) {
+        bool flush = wait_changes(last_save);
+
+        cfg_save_begin();
         save_items_to_db(cfg_arr, cfg_size);
         save_items_to_db(cfg_band_arr, cfg_band_size);
+        cfg_band_params_save_changed();
         save_items_to_db(cfg_mode_arr, cfg_mode_size);
         save_items_to_db(cfg_transverter_arr, cfg_transverter_size);
-        sleep_usec(10000000);
+        cfg_atu_save_changed();
+        cfg_save_end();
+
+        last_save = get_time();
+
+        if (flush) {
+            pthread_mutex_lock(&pending_mux);
+            flush_seq++;
+            pthread_cond_broadcast(&pending_cond);
+            pthread_mutex_unlock(&pending_mux);
+        }
     }
 }
 
@@ -227,6 +542,7 @@ static int init_params_cfg(sqlite3 *db) {
     cfg.band_id     = (cfg_item_t){.val = subject_create_int(5), .db_name = "band"};
     cfg.ant_id      = (cfg_item_t){.val = subject_create_int(1), .db_name = "ant"};
     cfg.atu_enabled = (cfg_item_t){.val = subject_create_int(false), .db_name = "atu"};
+    cfg.atu_tolerance = (cfg_item_t){.val = subject_create_int(25000), .db_name = "atu_tolerance"};
 
     cfg.key_speed = (cfg_item_t){.val = subject_create_int(15), .db_name="key_speed"};
     cfg.key_mode = (cfg_item_t){.val = subject_create_int(x6100_key_manual), .db_name="key_mode"};
@@ -243,6 +559,7 @@ static int init_params_cfg(sqlite3 *db) {
     cfg.cw_decoder_snr_gist = (cfg_item_t){.val = subject_create_float(1.0f), .db_scale=0.1f, .db_name="cw_decoder_snr_gist"};
     cfg.cw_decoder_peak_beta = (cfg_item_t){.val = subject_create_float(0.10f), .db_scale=0.01f, .db_name="cw_decoder_peak_beta"};
     cfg.cw_decoder_noise_beta = (cfg_item_t){.val = subject_create_float(0.80f), .db_scale=0.01f, .db_name="cw_decoder_noise_beta"};
+    cfg.cw_skimmer = (cfg_item_t){.val = subject_create_int(false), .db_name="cw_skimmer"};
 
     cfg.agc_hang = (cfg_item_t){.val=subject_create_int(false), .db_name="agc_hang"};
     cfg.agc_knee = (cfg_item_t){.val=subject_create_int(-60), .db_name="agc_knee"};
@@ -253,6 +570,10 @@ static int init_params_cfg(sqlite3 *db) {
     cfg.dnf_center = (cfg_item_t){.val = subject_create_int(1000), .db_name = "dnf_center"};
     cfg.dnf_width = (cfg_item_t){.val = subject_create_int(50), .db_name = "dnf_width"};
     cfg.dnf_auto = (cfg_item_t){.val = subject_create_int(false), .db_name = "dnf_auto"};
+    cfg.s_meter_ms = (cfg_item_t){.val = subject_create_int(150), .db_name = "s_meter_ms"};
+    cfg.spectrum_hires = (cfg_item_t){.val = subject_create_int(0), .db_name = "spectrum_hires"};
+    cfg.sub_rx = (cfg_item_t){.val = subject_create_int(false), .db_name = "sub_rx"};
+    cfg.mem_scan_sql = (cfg_item_t){.val = subject_create_int(-97), .db_name = "mem_scan_sql"};
 
     cfg.nb = (cfg_item_t){.val = subject_create_int(false), .db_name = "nb"};
     cfg.nb_level = (cfg_item_t){.val = subject_create_int(10), .db_name = "nb_level"};
@@ -264,9 +585,33 @@ static int init_params_cfg(sqlite3 *db) {
     // SWR scan
     cfg.swrscan_linear = (cfg_item_t){.val=subject_create_int(true), .db_name="swrscan_linear"};
     cfg.swrscan_span = (cfg_item_t){.val=subject_create_int(200000), .db_name="swrscan_span"};
+    cfg.swrscan_adaptive = (cfg_item_t){.val=subject_create_int(false), .db_name="swrscan_adaptive"};
 
     // FT8
     cfg.ft8_hold_freq = (cfg_item_t){.val=subject_create_int(true), .db_name="ft8_hold_freq"};
+    cfg.ft8_dual_decode = (cfg_item_t){.val=subject_create_int(false), .db_name="ft8_dual_decode"};
+    cfg.ft8_monitor = (cfg_item_t){.val=subject_create_int(false), .db_name="ft8_monitor"};
+    cfg.contest = (cfg_item_t){.val=subject_create_int(false), .db_name="contest"};
+    cfg.contest_start = (cfg_item_t){.val=subject_create_int(0), .db_name="contest_start"};
+
+    // Audio
+    cfg.audio_low_latency = (cfg_item_t){.val=subject_create_int(false), .db_name="audio_low_latency"};
+    cfg.rec_pre_trigger = (cfg_item_t){.val=subject_create_int(0), .db_name="rec_pre_trigger"};
+    cfg.rec_format = (cfg_item_t){.val=subject_create_int(0), .db_name="rec_format"};
+
+    // CAT
+    cfg.cat_baud = (cfg_item_t){.val=subject_create_int(19200), .db_name="cat_baud"};
+    cfg.cat_echo = (cfg_item_t){.val=subject_create_int(true), .db_name="cat_echo"};
+    cfg.cat_transceive = (cfg_item_t){.val=subject_create_int(50), .db_name="cat_transceive"};
+    cfg.cat_net = (cfg_item_t){.val=subject_create_int(false), .db_name="cat_net"};
+    cfg.pan_stream = (cfg_item_t){.val=subject_create_int(false), .db_name="pan_stream"};
+    cfg.audio_stream = (cfg_item_t){.val=subject_create_int(0), .db_name="audio_stream"};
+    cfg.iq_server = (cfg_item_t){.val=subject_create_int(false), .db_name="iq_server"};
+    cfg.dx_cluster = (cfg_item_t){.val=subject_create_int(false), .db_name="dx_cluster"};
+    cfg.psk_reporter = (cfg_item_t){.val=subject_create_int(false), .db_name="psk_reporter"};
+
+    // Debug
+    cfg.profiler = (cfg_item_t){.val=subject_create_int(false), .db_name="profiler"};
 
     /* Bind callbacks */
     // subject_add_observer(cfg.band_id.val, on_band_id_change, NULL);
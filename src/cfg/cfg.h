@@ -6,6 +6,7 @@
 
 #include <pthread.h>
 #include <sqlite3.h>
+#include <stdint.h>
 
 
 /* configuration structs. Should contain same types (for correct initialization) */
@@ -18,6 +19,7 @@ typedef struct {
     cfg_item_t band_id;
     cfg_item_t ant_id;
     cfg_item_t atu_enabled;
+    cfg_item_t atu_tolerance;   /* Hz, max distance to a stored ATU network */
 
     /* key */
     cfg_item_t key_speed;
@@ -35,6 +37,7 @@ typedef struct {
     cfg_item_t cw_decoder_snr_gist;
     cfg_item_t cw_decoder_peak_beta;
     cfg_item_t cw_decoder_noise_beta;
+    cfg_item_t cw_skimmer;
 
     cfg_item_t agc_hang;
     cfg_item_t agc_knee;
@@ -45,6 +48,10 @@ typedef struct {
     cfg_item_t dnf_center;
     cfg_item_t dnf_width;
     cfg_item_t dnf_auto;
+    cfg_item_t s_meter_ms;      /* S-meter time constant, one of s_meter_speeds */
+    cfg_item_t spectrum_hires;  /* FFT size of the high resolution PSD, 0 is off */
+    cfg_item_t sub_rx;          /* Dual watch: the other VFO by the sub receiver */
+    cfg_item_t mem_scan_sql;    /* Memory scan stops above it, dB of the S-meter */
 
     cfg_item_t nb;
     cfg_item_t nb_level;
@@ -56,9 +63,33 @@ typedef struct {
     // SWR scan
     cfg_item_t swrscan_linear;
     cfg_item_t swrscan_span;
+    cfg_item_t swrscan_adaptive;
 
     // FT8
     cfg_item_t ft8_hold_freq;
+    cfg_item_t ft8_dual_decode;   /* FT4 with FT8 or FT8 with FT4 on the same audio */
+    cfg_item_t ft8_monitor;       /* Keep decoding in the background, when the dialog is closed */
+    cfg_item_t contest;           /* Contest session, see contest.h */
+    cfg_item_t contest_start;     /* Unix time of the session start, 0 without it */
+
+    // Audio
+    cfg_item_t audio_low_latency;   /* AUDIO_LOW_LATENCY_MS fragments instead of AUDIO_RATE_MS */
+    cfg_item_t rec_pre_trigger;     /* Seconds of audio kept before the recording start */
+    cfg_item_t rec_format;          /* recorder_format_t */
+
+    // CAT
+    cfg_item_t cat_baud;
+    cfg_item_t cat_echo;        /* Repeat requests on UART */
+    cfg_item_t cat_transceive;  /* Min ms between freq/mode notifications on UART, 0 is off */
+    cfg_item_t cat_net;         /* rigctld and CI-V TCP servers */
+    cfg_item_t pan_stream;      /* Panadapter over UDP, see pan_stream.h */
+    cfg_item_t audio_stream;    /* Remote audio frame ms, 0 is off, see audio_stream.h */
+    cfg_item_t iq_server;       /* Flow IQ over rtl_tcp, see iq_server.h */
+    cfg_item_t dx_cluster;      /* DX cluster client, see dx_cluster.h */
+    cfg_item_t psk_reporter;    /* FT8/FT4 decodes to PSK Reporter, see psk_reporter.h */
+
+    // Debug
+    cfg_item_t profiler;        /* Sampling profiler, see profiler.h */
 } cfg_t;
 extern cfg_t cfg;
 
@@ -90,4 +121,40 @@ typedef struct {
 
 extern cfg_cur_t cfg_cur;
 
-int cfg_init(sqlite3 *db);
+typedef struct {
+    uint32_t    transactions;
+    uint32_t    writes;
+    uint64_t    bytes;
+} cfg_save_stats_t;
+
+/**
+ * Writes go to db, reads after the startup to the read-only connection read_db
+ * (may be db). With WAL readers see the last commit and don't wait for the writer
+ */
+int cfg_init(sqlite3 *db, sqlite3 *read_db);
+
+/*
+ * Persistence. Changed items of all tables (params, band_params, mode_params,
+ * transverters) and ATU networks are written by one thread in a single
+ * transaction, at most once per 5 s. Other writers to params.db wrap their statements in
+ * cfg_save_begin()/cfg_save_end(), calls may be nested.
+ */
+void cfg_save_begin();
+void cfg_save_end();
+
+/**
+ * Count written rows and their approximate payload size
+ */
+void cfg_save_account(uint32_t writes, uint32_t bytes);
+
+void cfg_save_stats(cfg_save_stats_t *stats);
+
+/**
+ * Write all changed items now and wait for it
+ */
+void cfg_save_flush();
+
+/**
+ * Write subject/observer stats to file, enabled with X6100_SUBJECT_STATS=1
+ */
+void cfg_debug_dump_subjects(const char *path);
@@ -4,6 +4,7 @@
 
 #include <pthread.h>
 #include <sqlite3.h>
+#include <stdbool.h>
 
 enum item_state_t {
     ITEM_STATE_CLEAN,
@@ -21,3 +22,48 @@ void init_items(cfg_item_t *cfg_arr, uint32_t count, int (*load)(struct cfg_item
 int  load_items_from_db(cfg_item_t *cfg_arr, uint32_t count);
 void save_item_to_db(cfg_item_t *item, bool force);
 void save_items_to_db(cfg_item_t *cfg_arr, uint32_t cfg_size);
+
+/**
+ * Wake up the cfg_save thread for changes kept outside of cfg items
+ */
+void cfg_save_request();
+
+/*
+ * Bulk load for startup: each table is read with one query into a sorted
+ * in-memory copy, load functions look items up there instead of running a
+ * SELECT per item. The copies are dropped at the end of cfg_init()
+ */
+typedef enum {
+    CFG_TABLE_PARAMS = 0,
+    CFG_TABLE_BAND_PARAMS,
+    CFG_TABLE_MODE_PARAMS,
+    CFG_TABLE_TRANSVERTER,
+
+    CFG_TABLE_LAST
+} cfg_table_t;
+
+typedef struct {
+    int32_t     pk;
+    char        *name;
+    int64_t     int_val;
+    double      float_val;
+} cfg_preload_row_t;
+
+bool cfg_preload_active(cfg_table_t table);
+
+/**
+ * Row of the preloaded table, NULL if there is no such item in DB
+ */
+const cfg_preload_row_t *cfg_preload_find(cfg_table_t table, int32_t pk, const char *name);
+
+/**
+ * Read-only connection to params.db for the read statements, see cfg_init()
+ */
+sqlite3 * cfg_read_db();
+
+/**
+ * Read value of item from the bulk load or, after startup, with stmt (which
+ * has :name and optionally :id = item->pk params). Returns SQLITE_ROW if found
+ */
+int cfg_item_read(cfg_table_t table, sqlite3_stmt *stmt, pthread_mutex_t *mux, cfg_item_t *item,
+                  int64_t *int_val, double *float_val);
@@ -1,3 +1,7 @@
+#include "cfg.h"
+
+#include "../lvgl/lvgl.h"
+
 #include <execinfo.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,3 +25,15 @@ print_trace (void)
 
   free (strings);
 }
+
+void cfg_debug_dump_subjects(const char *path) {
+    FILE *f = fopen(path, "w");
+
+    if (!f) {
+        LV_LOG_ERROR("Can't open %s", path);
+        return;
+    }
+    subject_stats_dump(f);
+    fclose(f);
+    LV_LOG_USER("Subject stats written to %s", path);
+}
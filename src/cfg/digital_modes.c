@@ -1,5 +1,6 @@
 #include "digital_modes.private.h"
 #include "cfg.h"
+#include "cfg.private.h"
 
 #include "../lvgl/lvgl.h"
 #include <pthread.h>
@@ -19,24 +20,24 @@ void cfg_digital_modes_init(sqlite3 *database) {
     db = database;
     int rc;
     rc = sqlite3_prepare_v2(
-        db, "SELECT label, freq, mode FROM digital_modes WHERE type = :type AND freq > :freq ORDER BY freq ASC LIMIT 1", -1,
+        cfg_read_db(), "SELECT label, freq, mode FROM digital_modes WHERE type = :type AND freq > :freq ORDER BY freq ASC LIMIT 1", -1,
         &get_next_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare get next statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare get next statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
     rc = sqlite3_prepare_v2(
-        db, "SELECT label, freq, mode FROM digital_modes WHERE type = :type ORDER BY ABS(freq - :freq) ASC LIMIT 1", -1,
+        cfg_read_db(), "SELECT label, freq, mode FROM digital_modes WHERE type = :type ORDER BY ABS(freq - :freq) ASC LIMIT 1", -1,
         &get_closest_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare get closest statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare get closest statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
     rc = sqlite3_prepare_v2(
-        db, "SELECT label, freq, mode FROM digital_modes WHERE type = :type AND freq < :freq ORDER BY freq DESC LIMIT 1",
+        cfg_read_db(), "SELECT label, freq, mode FROM digital_modes WHERE type = :type AND freq < :freq ORDER BY freq DESC LIMIT 1",
         -1, &get_prev_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare get prev statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare get prev statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
 }
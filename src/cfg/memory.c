@@ -9,34 +9,27 @@
 
 #define STR_EQUAL(a, b) (strcmp(a, b) == 0)
 
-struct memory_item {
-    int32_t val;
-    bool loaded;
-};
-
-typedef struct {
-    struct memory_item freq;
-    struct memory_item mode;
-    struct memory_item agc;
-    struct memory_item pre;
-    struct memory_item att;
-    struct memory_item rfg;
-} memory_data_t;
-
 static sqlite3        *db;
 static sqlite3_stmt   *write_stmt;
 static sqlite3_stmt   *read_stmt;
+static sqlite3_stmt   *preload_stmt;
 static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t read_mutex  = PTHREAD_MUTEX_INITIALIZER;
 
-inline static void fill_data(const char *name, int32_t val, memory_data_t *mem_data);
+inline static void fill_data(const char *name, int32_t val, cfg_memory_channel_t *channel);
 
 void cfg_memory_init(sqlite3 *database) {
     db = database;
     int rc;
-    rc = sqlite3_prepare_v2(db, "SELECT name, val FROM memory WHERE id=:id", -1, &read_stmt, 0);
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT name, val FROM memory WHERE id=:id", -1, &read_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
+        exit(1);
+    }
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT id, name, val FROM memory WHERE id BETWEEN :from AND :to ORDER BY id", -1,
+                            &preload_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare preload statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
     rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO memory(id, name, val) VALUES(:id, :name, :val)", -1,
@@ -48,19 +41,13 @@ void cfg_memory_init(sqlite3 *database) {
 }
 
 bool cfg_memory_load(int32_t id) {
-    int           rc;
-    memory_data_t mem_data = {
-        .freq={.loaded=false},
-        .mode={.loaded=false},
-        .agc={.loaded=false},
-        .att={.loaded=false},
-        .pre={.loaded=false},
-    };
+    int                     rc;
+    cfg_memory_channel_t    channel = { .id = id, .freq = -1, .mode = -1, .agc = -1, .pre = -1, .att = -1 };
     sqlite3_stmt *stmt = read_stmt;
     pthread_mutex_lock(&read_mutex);
     rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), id);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind mem id %i: %s", id, sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed to bind mem id %i: %s", id, sqlite3_errmsg(cfg_read_db()));
         sqlite3_reset(stmt);
         sqlite3_clear_bindings(stmt);
         pthread_mutex_unlock(&read_mutex);
@@ -74,12 +61,12 @@ bool cfg_memory_load(int32_t id) {
         if (rc == SQLITE_ROW) {
             name = sqlite3_column_text(stmt, 0);
             val = sqlite3_column_int(stmt, 1);
-            fill_data(name, val, &mem_data);
+            fill_data(name, val, &channel);
         } else if (rc == SQLITE_DONE) {
             rc = 0;
             break;
         } else {
-            LV_LOG_ERROR("Error while reading rows: %s", sqlite3_errmsg(db));
+            LV_LOG_ERROR("Error while reading rows: %s", sqlite3_errmsg(cfg_read_db()));
             break;
         }
     }
@@ -87,11 +74,56 @@ bool cfg_memory_load(int32_t id) {
     sqlite3_clear_bindings(stmt);
     pthread_mutex_unlock(&read_mutex);
 
-    /* Setup values */
-    if (!mem_data.freq.loaded) {
+    if (channel.freq < 0) {
         return false;
     }
-    band_info_t *band_info = get_band_info_by_freq(mem_data.freq.val);
+    cfg_memory_apply(&channel);
+    return true;
+}
+
+size_t cfg_memory_preload(int32_t from_id, int32_t to_id, cfg_memory_channel_t *channels, size_t max) {
+    sqlite3_stmt            *stmt = preload_stmt;
+    cfg_memory_channel_t    channel = { .id = -1 };
+    size_t                  count = 0;
+    int                     rc;
+
+    pthread_mutex_lock(&read_mutex);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":from"), from_id);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":to"), to_id);
+
+    while (1) {
+        rc = sqlite3_step(stmt);
+
+        if (rc != SQLITE_ROW) {
+            if (rc != SQLITE_DONE) {
+                LV_LOG_ERROR("Error while reading rows: %s", sqlite3_errmsg(cfg_read_db()));
+            }
+            break;
+        }
+
+        int32_t id = sqlite3_column_int(stmt, 0);
+
+        /* Rows are ordered by id, a new id closes the last channel */
+        if (id != channel.id) {
+            if (channel.freq >= 0 && count < max) {
+                channels[count++] = channel;
+            }
+            channel = (cfg_memory_channel_t) { .id = id, .freq = -1, .mode = -1, .agc = -1, .pre = -1, .att = -1 };
+        }
+        fill_data((const char *) sqlite3_column_text(stmt, 1), sqlite3_column_int(stmt, 2), &channel);
+    }
+    if (channel.freq >= 0 && count < max) {
+        channels[count++] = channel;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    pthread_mutex_unlock(&read_mutex);
+
+    return count;
+}
+
+void cfg_memory_apply(const cfg_memory_channel_t *channel) {
+    band_info_t *band_info = get_band_info_by_freq(channel->freq);
     int32_t band_id;
     if (!band_info) {
         band_id = BAND_UNDEFINED;
@@ -99,12 +131,11 @@ bool cfg_memory_load(int32_t id) {
         band_id = band_info->id;
     }
     subject_set_int(cfg.band_id.val, band_id);
-    subject_set_int(cfg_cur.fg_freq, mem_data.freq.val);
-    if (mem_data.mode.loaded) subject_set_int(cfg_cur.mode, mem_data.mode.val);
-    if (mem_data.agc.loaded) subject_set_int(cfg_cur.agc, mem_data.agc.val);
-    if (mem_data.att.loaded) subject_set_int(cfg_cur.att, mem_data.att.val);
-    if (mem_data.pre.loaded) subject_set_int(cfg_cur.pre, mem_data.pre.val);
-    return true;
+    subject_set_int(cfg_cur.fg_freq, channel->freq);
+    if (channel->mode >= 0) subject_set_int(cfg_cur.mode, channel->mode);
+    if (channel->agc >= 0) subject_set_int(cfg_cur.agc, channel->agc);
+    if (channel->att >= 0) subject_set_int(cfg_cur.att, channel->att);
+    if (channel->pre >= 0) subject_set_int(cfg_cur.pre, channel->pre);
 }
 
 void cfg_memory_save(int32_t id) {
@@ -172,24 +203,16 @@ void cfg_memory_save(int32_t id) {
 }
 
 
-inline static void fill_data(const char *name, int32_t val, memory_data_t *mem_data) {
-    if (STR_EQUAL(name, "rfg")) {
-        mem_data->rfg.val = val;
-        mem_data->rfg.loaded = true;
-    } else if (STR_EQUAL(name, "vfoa_freq")) {
-        mem_data->freq.val = val;
-        mem_data->freq.loaded = true;
+inline static void fill_data(const char *name, int32_t val, cfg_memory_channel_t *channel) {
+    if (STR_EQUAL(name, "vfoa_freq")) {
+        channel->freq = val;
     } else if (STR_EQUAL(name, "vfoa_mode")) {
-        mem_data->mode.val = val;
-        mem_data->mode.loaded = true;
+        channel->mode = val;
     } else if (STR_EQUAL(name, "vfoa_agc")) {
-        mem_data->agc.val = val;
-        mem_data->agc.loaded = true;
+        channel->agc = val;
     } else if (STR_EQUAL(name, "vfoa_pre")) {
-        mem_data->pre.val = val;
-        mem_data->pre.loaded = true;
+        channel->pre = val;
     } else if (STR_EQUAL(name, "vfoa_att")) {
-        mem_data->att.val = val;
-        mem_data->att.loaded = true;
+        channel->att = val;
     }
 }
@@ -1,7 +1,28 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+/* Memory channel in RAM, the fields which were not stored are -1 */
+typedef struct {
+    int32_t id;
+    int32_t freq;
+    int16_t mode;
+    int16_t agc;
+    int16_t pre;
+    int16_t att;
+} cfg_memory_channel_t;
+
 bool cfg_memory_load(int32_t id);
 void cfg_memory_save(int32_t id);
+
+/**
+ * Channels from_id..to_id with a stored freq by a single query, ordered by id
+ */
+size_t cfg_memory_preload(int32_t from_id, int32_t to_id, cfg_memory_channel_t *channels, size_t max);
+
+/**
+ * Set the current band and VFO params to the channel, as cfg_memory_load() does
+ */
+void cfg_memory_apply(const cfg_memory_channel_t *channel);
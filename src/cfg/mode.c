@@ -109,32 +109,16 @@ int cfg_mode_params_load_item(cfg_item_t *item) {
         LV_LOG_USER("Can't load %s for undefined mode", item->db_name);
         return 0;
     }
-    int           rc;
-    int32_t       val;
-    sqlite3_stmt *stmt = read_stmt;
-    pthread_mutex_lock(&read_mutex);
-    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":name"), item->db_name, strlen(item->db_name), 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind name %s: %s", item->db_name, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), item->pk);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind mode %i: %s", item->pk, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
+    int     rc;
+    int32_t val;
+    int64_t int_val;
+    double  float_val;
 
-    rc = sqlite3_step(stmt);
+    rc = cfg_item_read(CFG_TABLE_MODE_PARAMS, read_stmt, &read_mutex, item, &int_val, &float_val);
     if (rc == SQLITE_ROW) {
         switch (subject_get_dtype(item->val)) {
             case DTYPE_INT:
-                val = sqlite3_column_int(stmt, 0);
+                val = (int32_t)int_val;
                 if (val < 0) {
                     LV_LOG_WARN("%s can't be negative (%i), ignore DB value", item->db_name, val);
                 } else {
@@ -144,9 +128,6 @@ int cfg_mode_params_load_item(cfg_item_t *item) {
                 break;
             default:
                 LV_LOG_WARN("Unknown item %s dtype: %u, can't load", item->db_name, subject_get_dtype(item->val));
-                sqlite3_reset(stmt);
-                sqlite3_clear_bindings(stmt);
-                pthread_mutex_unlock(&read_mutex);
                 return -1;
         }
         rc = 0;
@@ -156,9 +137,6 @@ int cfg_mode_params_load_item(cfg_item_t *item) {
         cfg_mode_params_save_item(item);
         rc = -1;
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&read_mutex);
     return rc;
 }
 
@@ -330,9 +308,9 @@ int32_t cfg_mode_set_high_filter(int32_t val) {
 static void init_db(sqlite3 *database) {
     db = database;
     int rc;
-    rc = sqlite3_prepare_v2(db, "SELECT val FROM mode_params WHERE mode = :id AND name = :name", -1, &read_stmt, 0);
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT val FROM mode_params WHERE mode = :id AND name = :name", -1, &read_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
     rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO mode_params(mode, name, val) VALUES(:id, :name, :val)", -1,
@@ -357,12 +335,15 @@ static void on_cur_mode_change(Subject *subj, void *user_data) {
     cfg_mode_arr           = (cfg_item_t *)&cfg_mode;
     uint32_t cfg_mode_size = sizeof(cfg_mode) / sizeof(cfg_item_t);
     // Save
+    cfg_save_begin();
     for (size_t i = 0; i < cfg_mode_size; i++) {
         if (cfg_mode_arr[i].pk != db_mode) {
             save_item_to_db(&cfg_mode_arr[i], false);
         }
     }
+    cfg_save_end();
     // Load
+    subject_batch_begin();
     for (size_t i = 0; i < cfg_mode_size; i++) {
         if (cfg_mode_arr[i].pk != db_mode) {
             cfg_mode_arr[i].dirty->val = ITEM_STATE_LOADING;
@@ -371,6 +352,7 @@ static void on_cur_mode_change(Subject *subj, void *user_data) {
             cfg_mode_arr[i].dirty->val = ITEM_STATE_CLEAN;
         }
     }
+    subject_batch_commit();
 }
 
 static void on_cur_filter_low_change(Subject *subj, void *user_data) {
@@ -3,6 +3,8 @@
  */
 #include "params.private.h"
 
+#include "cfg.private.h"
+
 #include "../lvgl/lvgl.h"
 
 #include <stdio.h>
@@ -19,9 +21,9 @@ static pthread_mutex_t read_mutex = PTHREAD_MUTEX_INITIALIZER;
 void cfg_params_init(sqlite3 *database) {
     db = database;
     int rc;
-    rc = sqlite3_prepare_v2(db, "SELECT val FROM params WHERE name = :name", -1, &read_stmt, 0);
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT val FROM params WHERE name = :name", -1, &read_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
     rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO params(name, val) VALUES(:name, :val)", -1, &insert_stmt, 0);
@@ -33,42 +35,33 @@ void cfg_params_init(sqlite3 *database) {
 
 
 int cfg_params_load_item(cfg_item_t *item) {
-    int rc;
-    pthread_mutex_lock(&read_mutex);
-    rc = sqlite3_bind_text(read_stmt, sqlite3_bind_parameter_index(read_stmt, ":name"), item->db_name, strlen(item->db_name), 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind name %s: %s", item->db_name, sqlite3_errmsg(db));
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
-    int32_t int_val;
-    uint64_t uint64_val;
-    rc = sqlite3_step(read_stmt);
+    int     rc;
+    int64_t int_val;
+    double  float_val;
+
+    rc = cfg_item_read(CFG_TABLE_PARAMS, read_stmt, &read_mutex, item, &int_val, &float_val);
     if (rc == SQLITE_ROW) {
         switch (subject_get_dtype(item->val)) {
             case DTYPE_INT:
-                int_val = sqlite3_column_int(read_stmt, 0);
-                LV_LOG_USER("Loaded %s=%i (pk=%i)", item->db_name, int_val, item->pk);
-                subject_set_int(item->val, int_val);
+                LV_LOG_USER("Loaded %s=%i (pk=%i)", item->db_name, (int32_t)int_val, item->pk);
+                subject_set_int(item->val, (int32_t)int_val);
                 break;
             case DTYPE_UINT64:
-                uint64_val = sqlite3_column_int64(read_stmt, 0);
-                LV_LOG_USER("Loaded %s=%llu (pk=%i)", item->db_name, uint64_val, item->pk);
-                subject_set_uint64(item->val, uint64_val);
+                LV_LOG_USER("Loaded %s=%llu (pk=%i)", item->db_name, (uint64_t)int_val, item->pk);
+                subject_set_uint64(item->val, (uint64_t)int_val);
                 break;
             case DTYPE_FLOAT: ;
                 float val;
                 if (item->db_scale != 0) {
-                    val = sqlite3_column_int(read_stmt, 0) * item->db_scale;
+                    val = (int32_t)int_val * item->db_scale;
                 } else {
-                    val = sqlite3_column_double(read_stmt, 0);
+                    val = float_val;
                 }
                 LV_LOG_USER("Loaded %s=%f (pk=%i)", item->db_name, val, item->pk);
                 subject_set_float(item->val, val);
                 break;
             default:
                 LV_LOG_WARN("Unknown item %s dtype: %u, can't load", item->db_name, subject_get_dtype(item->val));
-                pthread_mutex_unlock(&read_mutex);
                 return -1;
         }
         rc = 0;
@@ -76,9 +69,6 @@ int cfg_params_load_item(cfg_item_t *item) {
         LV_LOG_WARN("No results for load %s", item->db_name);
         rc = -1;
     }
-    sqlite3_reset(read_stmt);
-    sqlite3_clear_bindings(read_stmt);
-    pthread_mutex_unlock(&read_mutex);
     return rc;
 }
 
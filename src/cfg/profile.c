@@ -0,0 +1,264 @@
+#include "profile.private.h"
+
+#include "cfg.private.h"
+
+#include "../lvgl/lvgl.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZEOF_ARRAY(arr) (sizeof(arr) / sizeof(arr[0]))
+
+/* Items of a profile. Band, antenna, CAT and system settings are not switched */
+static cfg_item_t *const items[] = {
+    &cfg.vol, &cfg.sql, &cfg.pwr, &cfg.key_tone,
+
+    &cfg.key_speed, &cfg.key_mode, &cfg.iambic_mode, &cfg.key_vol, &cfg.key_train, &cfg.qsk_time,
+    &cfg.key_ratio,
+
+    &cfg.cw_decoder, &cfg.cw_tune, &cfg.cw_decoder_snr, &cfg.cw_decoder_snr_gist, &cfg.cw_decoder_peak_beta,
+    &cfg.cw_decoder_noise_beta, &cfg.cw_skimmer,
+
+    &cfg.agc_hang, &cfg.agc_knee, &cfg.agc_slope,
+
+    &cfg.dnf, &cfg.dnf_center, &cfg.dnf_width, &cfg.dnf_auto, &cfg.sub_rx, &cfg.mem_scan_sql,
+    &cfg.nb, &cfg.nb_level, &cfg.nb_width, &cfg.nr, &cfg.nr_level,
+
+    &cfg.ft8_hold_freq, &cfg.ft8_dual_decode, &cfg.ft8_monitor,
+};
+
+#define ITEMS_COUNT SIZEOF_ARRAY(items)
+
+static sqlite3          *db;
+static sqlite3_stmt     *read_stmt;
+static sqlite3_stmt     *write_stmt;
+static sqlite3_stmt     *delete_stmt;
+static sqlite3_stmt     *list_stmt;
+static pthread_mutex_t  mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void cfg_profile_init(sqlite3 *database) {
+    db = database;
+    int rc;
+
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT item, val FROM profiles WHERE name = :name", -1, &read_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
+        exit(1);
+    }
+    rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO profiles(name, item, val) VALUES(:name, :item, :val)", -1,
+                            &write_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare write statement: %s", sqlite3_errmsg(db));
+        exit(1);
+    }
+    rc = sqlite3_prepare_v2(db, "DELETE FROM profiles WHERE name = :name", -1, &delete_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare delete statement: %s", sqlite3_errmsg(db));
+        exit(1);
+    }
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT DISTINCT name FROM profiles ORDER BY name", -1, &list_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare list statement: %s", sqlite3_errmsg(cfg_read_db()));
+        exit(1);
+    }
+}
+
+static cfg_item_t *find_item(const char *db_name) {
+    for (size_t i = 0; i < ITEMS_COUNT; i++) {
+        if (strcmp(items[i]->db_name, db_name) == 0) {
+            return items[i];
+        }
+    }
+    return NULL;
+}
+
+static int bind_value(sqlite3_stmt *stmt, int index, cfg_item_t *item) {
+    switch (subject_get_dtype(item->val)) {
+        case DTYPE_INT:
+            return sqlite3_bind_int(stmt, index, subject_get_int(item->val));
+
+        case DTYPE_UINT64:
+            return sqlite3_bind_int64(stmt, index, subject_get_uint64(item->val));
+
+        case DTYPE_FLOAT:
+            if (item->db_scale != 0) {
+                return sqlite3_bind_int(stmt, index, subject_get_float(item->val) / item->db_scale);
+            }
+            return sqlite3_bind_double(stmt, index, subject_get_float(item->val));
+
+        default:
+            LV_LOG_WARN("Unknown item %s dtype, will not save", item->db_name);
+            return SQLITE_MISMATCH;
+    }
+}
+
+/**
+ * Set item to the stored value, if it differs. Returns true if it was changed
+ */
+static bool apply_value(cfg_item_t *item, sqlite3_stmt *stmt, int col) {
+    switch (subject_get_dtype(item->val)) {
+        case DTYPE_INT: {
+            int32_t val = sqlite3_column_int(stmt, col);
+
+            if (subject_get_int(item->val) == val) {
+                return false;
+            }
+            subject_set_int(item->val, val);
+            return true;
+        }
+
+        case DTYPE_UINT64: {
+            uint64_t val = sqlite3_column_int64(stmt, col);
+
+            if (subject_get_uint64(item->val) == val) {
+                return false;
+            }
+            subject_set_uint64(item->val, val);
+            return true;
+        }
+
+        case DTYPE_FLOAT: {
+            float val;
+
+            if (item->db_scale != 0) {
+                /* Compared as stored, float rounding doesn't make a change */
+                int32_t stored = sqlite3_column_int(stmt, col);
+
+                if ((int32_t)(subject_get_float(item->val) / item->db_scale) == stored) {
+                    return false;
+                }
+                val = stored * item->db_scale;
+            } else {
+                val = sqlite3_column_double(stmt, col);
+
+                if (subject_get_float(item->val) == val) {
+                    return false;
+                }
+            }
+            subject_set_float(item->val, val);
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+int cfg_profile_save(const char *name) {
+    int rc = 0;
+
+    cfg_save_begin();
+    pthread_mutex_lock(&mutex);
+
+    sqlite3_bind_text(delete_stmt, sqlite3_bind_parameter_index(delete_stmt, ":name"), name, -1, SQLITE_STATIC);
+
+    if (sqlite3_step(delete_stmt) != SQLITE_DONE) {
+        LV_LOG_ERROR("Failed clear profile %s: %s", name, sqlite3_errmsg(db));
+        rc = -1;
+    }
+    sqlite3_reset(delete_stmt);
+    sqlite3_clear_bindings(delete_stmt);
+
+    for (size_t i = 0; i < ITEMS_COUNT && rc == 0; i++) {
+        cfg_item_t *item = items[i];
+
+        sqlite3_bind_text(write_stmt, sqlite3_bind_parameter_index(write_stmt, ":name"), name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(write_stmt, sqlite3_bind_parameter_index(write_stmt, ":item"), item->db_name, -1,
+                          SQLITE_STATIC);
+
+        if (bind_value(write_stmt, sqlite3_bind_parameter_index(write_stmt, ":val"), item) == SQLITE_OK) {
+            if (sqlite3_step(write_stmt) != SQLITE_DONE) {
+                LV_LOG_ERROR("Failed save profile %s: %s", name, sqlite3_errmsg(db));
+                rc = -1;
+            } else {
+                cfg_save_account(1, strlen(name) + strlen(item->db_name) + sizeof(int32_t));
+            }
+        }
+        sqlite3_reset(write_stmt);
+        sqlite3_clear_bindings(write_stmt);
+    }
+
+    pthread_mutex_unlock(&mutex);
+    cfg_save_end();
+
+    return rc;
+}
+
+int cfg_profile_apply(const char *name) {
+    cfg_item_t  *changed[ITEMS_COUNT];
+    size_t      count = 0;
+    bool        found = false;
+
+    pthread_mutex_lock(&mutex);
+    sqlite3_bind_text(read_stmt, sqlite3_bind_parameter_index(read_stmt, ":name"), name, -1, SQLITE_STATIC);
+
+    /* Observers see the new values together, after the commit */
+    subject_batch_begin();
+
+    while (sqlite3_step(read_stmt) == SQLITE_ROW) {
+        cfg_item_t *item = find_item((const char *)sqlite3_column_text(read_stmt, 0));
+
+        found = true;
+
+        if (item && apply_value(item, read_stmt, 1)) {
+            changed[count++] = item;
+        }
+    }
+
+    sqlite3_reset(read_stmt);
+    sqlite3_clear_bindings(read_stmt);
+    pthread_mutex_unlock(&mutex);
+
+    subject_batch_commit();
+
+    if (!found) {
+        return -1;
+    }
+
+    cfg_save_begin();
+    for (size_t i = 0; i < count; i++) {
+        save_item_to_db(changed[i], false);
+    }
+    cfg_save_end();
+
+    LV_LOG_USER("Profile %s applied, %zu items changed", name, count);
+    return count;
+}
+
+int cfg_profile_delete(const char *name) {
+    int rc = 0;
+
+    cfg_save_begin();
+    pthread_mutex_lock(&mutex);
+
+    sqlite3_bind_text(delete_stmt, sqlite3_bind_parameter_index(delete_stmt, ":name"), name, -1, SQLITE_STATIC);
+
+    if (sqlite3_step(delete_stmt) != SQLITE_DONE) {
+        LV_LOG_ERROR("Failed delete profile %s: %s", name, sqlite3_errmsg(db));
+        rc = -1;
+    }
+    sqlite3_reset(delete_stmt);
+    sqlite3_clear_bindings(delete_stmt);
+
+    pthread_mutex_unlock(&mutex);
+    cfg_save_end();
+
+    return rc;
+}
+
+size_t cfg_profile_list(char names[][CFG_PROFILE_NAME_MAX], size_t max) {
+    size_t count = 0;
+
+    pthread_mutex_lock(&mutex);
+
+    while (count < max && sqlite3_step(list_stmt) == SQLITE_ROW) {
+        strncpy(names[count], (const char *)sqlite3_column_text(list_stmt, 0), CFG_PROFILE_NAME_MAX - 1);
+        names[count][CFG_PROFILE_NAME_MAX - 1] = '\0';
+        count++;
+    }
+    sqlite3_reset(list_stmt);
+
+    pthread_mutex_unlock(&mutex);
+    return count;
+}
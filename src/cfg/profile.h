@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CFG_PROFILE_NAME_MAX    32
+
+/*
+ * Operating profiles: named snapshots of the operating items of cfg (levels,
+ * keyer, CW decoder, AGC, DNF/NB/NR, FT8). Applying a profile sets only the
+ * items which differ from the snapshot, in one subject batch: observers, the
+ * radio commands and the redraw run once. The changed items are written in a
+ * single transaction.
+ */
+
+/**
+ * Store the current values as profile name, replacing the previous snapshot
+ */
+int cfg_profile_save(const char *name);
+
+/**
+ * Apply profile name, called on the UI thread. Returns count of changed items,
+ * -1 if there is no such profile
+ */
+int cfg_profile_apply(const char *name);
+
+int cfg_profile_delete(const char *name);
+
+/**
+ * Names of stored profiles, ordered by name
+ */
+size_t cfg_profile_list(char names[][CFG_PROFILE_NAME_MAX], size_t max);
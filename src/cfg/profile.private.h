@@ -0,0 +1,7 @@
+#pragma once
+
+#include "profile.h"
+
+#include <sqlite3.h>
+
+void cfg_profile_init(sqlite3 *database);
@@ -2,62 +2,428 @@
 
 extern "C" {
     #include "../lvgl/lvgl.h"
+    #include "../trace.h"
+    #include <execinfo.h>
     #include <stdint.h>
     #include <stdio.h>
     #include <stdlib.h>
+    #include <string.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+}
+
+std::atomic<bool> Subject::stats_enabled = false;
+
+static std::vector<Subject*>    all_subjects;
+static StatMutex                all_subjects_mux("subjects");
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
 }
 
 Observer::~Observer() {
-    subj->unsubscribe(this);
 }
 
 void Observer::notify() {
+    if (!active.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (!Subject::stats_enabled.load(std::memory_order_relaxed)) {
+        this->fn(subj, user_data);
+        return;
+    }
+
+    uint64_t start = now_us();
+
     this->fn(subj, user_data);
+
+    uint32_t dur = now_us() - start;
+    uint32_t cur = max_us.load(std::memory_order_relaxed);
+
+    calls.fetch_add(1, std::memory_order_relaxed);
+    total_us.fetch_add(dur, std::memory_order_relaxed);
+    last_tid.store(syscall(SYS_gettid), std::memory_order_relaxed);
+    while (dur > cur && !max_us.compare_exchange_weak(cur, dur, std::memory_order_relaxed)) {
+    }
 };
 
-std::list<ObserverDelayed*> ObserverDelayed::instances;
+void Observer::unsubscribe() {
+    subj->unsubscribe(this);
+}
+
+std::atomic<ObserverDelayed*> ObserverDelayed::dirty[SUBJECT_CTX_LAST] = {};
+ObserverDelayed *ObserverDelayed::draining[SUBJECT_CTX_LAST] = {};
+std::atomic<std::thread::id> ObserverDelayed::owner[SUBJECT_CTX_LAST] = {};
 
 ObserverDelayed::~ObserverDelayed() {
-    auto item = std::find(instances.begin(), instances.end(), this);
-    instances.erase(item);
+    if (!queued) {
+        return;
+    }
+    /* Deleted by a callback of notify_delayed() */
+    for (ObserverDelayed **p = &draining[ctx]; *p; p = &(*p)->dirty_next) {
+        if (*p == this) {
+            *p = dirty_next;
+            return;
+        }
+    }
+
+    /* Take the dirty list, drop this observer and put the rest back in order */
+    ObserverDelayed *list = dirty[ctx].exchange(nullptr, std::memory_order_acquire);
+    ObserverDelayed *rest = nullptr;
+
+    while (list) {
+        ObserverDelayed *next = list->dirty_next;
+
+        if (list != this) {
+            list->dirty_next = rest;
+            rest = list;
+        }
+        list = next;
+    }
+    while (rest) {
+        ObserverDelayed *next = rest->dirty_next;
+
+        rest->push_dirty();
+        rest = next;
+    }
+}
+
+void ObserverDelayed::push_dirty() {
+    dirty_next = dirty[ctx].load(std::memory_order_relaxed);
+    while (!dirty[ctx].compare_exchange_weak(dirty_next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
 }
 
 void ObserverDelayed::notify() {
     auto call_tid = std::this_thread::get_id();
-    if (call_tid != tid) {
-        changed = true;
+    auto owner_tid = ctx == SUBJECT_CTX_UI ? tid : owner[ctx].load(std::memory_order_acquire);
+
+    if (call_tid != owner_tid) {
+        /* Unsubscribed, don't put it into a mailbox, where reclaim() can't see it */
+        if (!active.load(std::memory_order_acquire)) {
+            return;
+        }
+        if (!queued.exchange(true, std::memory_order_acq_rel)) {
+            push_dirty();
+        }
     } else {
         this->Observer::notify();
-        changed = false;
     }
 }
 
-void ObserverDelayed::notify_delayed() {
-    for (auto item: ObserverDelayed::instances) {
-        if (item->changed) {
-            item->Observer::notify();
+void ObserverDelayed::bind(subject_ctx_t ctx) {
+    owner[ctx].store(std::this_thread::get_id(), std::memory_order_release);
+}
+
+void ObserverDelayed::notify_delayed(subject_ctx_t ctx) {
+    ObserverDelayed *list = dirty[ctx].exchange(nullptr, std::memory_order_acquire);
+
+    /* The list is LIFO, reverse it to keep the order of changes */
+    while (list) {
+        ObserverDelayed *next = list->dirty_next;
+
+        list->dirty_next = draining[ctx];
+        draining[ctx] = list;
+        list = next;
+    }
+    while (draining[ctx]) {
+        ObserverDelayed *item = draining[ctx];
+        Subject         *subj = item->subj;
+
+        draining[ctx] = item->dirty_next;
+
+        /*
+         * Clear before the call, so a change during the callback queues it again.
+         * Reclaim keeps a queued observer, readers keeps it from there until the call ends
+         */
+        subj->readers.fetch_add(1);
+        item->queued.store(false);
+        item->Observer::notify();
+        subj->readers.fetch_sub(1);
+    }
+}
+
+std::atomic<ObserverList*> Subject::retired = nullptr;
+
+static void retire(std::atomic<ObserverList*> &head, ObserverList *list) {
+    list->retired_next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(list->retired_next, list)) {
+    }
+}
+
+void Subject::replace(Observer *add, Observer *remove) {
+    const std::lock_guard<StatMutex> lock(mutex_subscribe);
+
+    ObserverList    *old = observers.load();
+    uint32_t        old_count = old ? old->count : 0;
+    ObserverList    *list = (ObserverList *) malloc(sizeof(ObserverList) + (old_count + 1) * sizeof(Observer *));
+    uint32_t        n = 0;
+
+    for (uint32_t i = 0; i < old_count; i++) {
+        if (old->items[i] != remove) {
+            list->items[n++] = old->items[i];
         }
     }
+    if (add) {
+        list->items[n++] = add;
+    }
+    list->count = n;
+    list->subj = this;
+    list->victim = nullptr;
+
+    observers.store(list);
+
+    if (old) {
+        old->victim = remove;
+        retire(retired, old);
+    } else if (remove) {
+        delete remove;
+    }
 }
 
-Observer* Subject::subscribe(void (*fn)(Subject *, void *), void *user_data) {
-    const std::lock_guard<std::mutex> lock(mutex_subscribe);
+struct batch_t {
+    uint32_t                depth = 0;
+    std::vector<Subject*>   pending;
+    size_t                  delivered = 0;
+};
+
+static thread_local batch_t batch;
+
+Subject::Subject() {
+    const std::lock_guard<StatMutex> lock(all_subjects_mux);
+
+    all_subjects.push_back(this);
+}
+
+static void thread_name(int32_t tid, char *name, size_t size) {
+    char path[64];
 
+    snprintf(path, sizeof(path), "/proc/self/task/%i/comm", tid);
+
+    FILE *f = fopen(path, "r");
+
+    if (f && fgets(name, size, f)) {
+        name[strcspn(name, "\n")] = 0;
+    } else {
+        snprintf(name, size, "%i", tid);
+    }
+    if (f) {
+        fclose(f);
+    }
+}
+
+void Subject::dump_stats(FILE *f) {
+    const std::lock_guard<StatMutex> lock(all_subjects_mux);
+
+    fprintf(f, "%-28s %8s %8s\n", "subject", "sets", "changes");
+    fprintf(f, "    %-48s %-9s %8s %8s %8s %s\n", "observer", "kind", "calls", "avg_us", "max_us", "thread");
+
+    for (auto subj : all_subjects) {
+        if (subj->name) {
+            fprintf(f, "%-28s", subj->name);
+        } else {
+            fprintf(f, "%-28p", (void *) subj);
+        }
+        fprintf(f, " %8u %8u\n", subj->sets.load(), subj->changes.load());
+
+        subj->readers.fetch_add(1);
+
+        ObserverList *list = subj->observers.load();
+
+        for (uint32_t i = 0; list && i < list->count; i++) {
+            Observer    *o = list->items[i];
+            void        *fn = (void *) o->fn;
+            char        **sym = backtrace_symbols(&fn, 1);
+            uint32_t    calls = o->calls.load();
+            const char  *kind = "plain";
+            char        thread[32] = "-";
+
+            if (dynamic_cast<ObserverDelayed *>(o)) {
+                kind = "delayed";
+            } else if (o->coalesce) {
+                kind = "coalesced";
+            } else if (o->immediate) {
+                kind = "immediate";
+            }
+            if (o->last_tid) {
+                thread_name(o->last_tid, thread, sizeof(thread));
+            }
+
+            fprintf(f, "    %-48s %-9s %8u %8llu %8u %s\n",
+                    sym ? sym[0] : "?", kind, calls,
+                    calls ? (unsigned long long) o->total_us.load() / calls : 0ULL,
+                    o->max_us.load(), thread);
+            free(sym);
+        }
+        subj->readers.fetch_sub(1);
+    }
+}
+
+void Subject::notify_observers() {
+    bool deferred = batch.depth != 0;
+
+    if (stats_enabled.load(std::memory_order_relaxed)) {
+        changes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (deferred) {
+        auto from = batch.pending.begin() + batch.delivered;
+
+        if (std::find(from, batch.pending.end(), this) == batch.pending.end()) {
+            batch.pending.push_back(this);
+        }
+    }
+
+    readers.fetch_add(1);
+
+    ObserverList *list = observers.load();
+
+    if (list) {
+        for (uint32_t i = 0; i < list->count; i++) {
+            if (!deferred || list->items[i]->immediate) {
+                list->items[i]->notify();
+            }
+        }
+    }
+    readers.fetch_sub(1);
+}
+
+void Subject::deliver(std::vector<Observer*> &coalesced) {
+    readers.fetch_add(1);
+
+    ObserverList *list = observers.load();
+
+    if (list) {
+        for (uint32_t i = 0; i < list->count; i++) {
+            Observer *o = list->items[i];
+
+            if (o->immediate) {
+                continue;
+            }
+            if (!o->coalesce) {
+                o->notify();
+                continue;
+            }
+
+            auto same = [o](Observer *x) { return x->fn == o->fn && x->user_data == o->user_data; };
+
+            if (std::find_if(coalesced.begin(), coalesced.end(), same) == coalesced.end()) {
+                coalesced.push_back(o);
+            }
+        }
+    }
+    readers.fetch_sub(1);
+}
+
+void Subject::batch_begin() {
+    batch.depth++;
+}
+
+void Subject::batch_commit() {
+    if (batch.depth == 0) {
+        LV_LOG_ERROR("Batch commit without begin");
+        return;
+    }
+    if (batch.depth > 1) {
+        batch.depth--;
+        return;
+    }
+
+    /* Keep depth while delivering, so changes made by observers join this batch */
+    std::vector<Observer*> coalesced;
+
+    while (batch.delivered < batch.pending.size() || !coalesced.empty()) {
+        while (batch.delivered < batch.pending.size()) {
+            Subject *subj = batch.pending[batch.delivered++];
+
+            subj->deliver(coalesced);
+        }
+
+        /* Observers are deleted only by reclaim() from the main loop, so the pointers stay valid */
+        std::vector<Observer*> calls;
+
+        calls.swap(coalesced);
+        for (auto o : calls) {
+            o->notify();
+        }
+    }
+    batch.pending.clear();
+    batch.delivered = 0;
+    batch.depth = 0;
+}
+
+void Subject::reclaim() {
+    ObserverList *list = retired.exchange(nullptr);
+
+    /* Snapshots in the list are unpublished, so a reader which started after this point can't see them */
+    while (list) {
+        ObserverList *next = list->retired_next;
+
+        auto    delayed = dynamic_cast<ObserverDelayed *>(list->victim);
+        Subject *subj = list->subj;
+
+        /*
+         * A notification still running with the snapshot may queue the victim, so readers go
+         * first. A drain counts a reader before it clears queued, so readers are checked again
+         */
+        bool idle = subj->readers.load() == 0 &&
+                    !(delayed && delayed->queued.load()) &&
+                    subj->readers.load() == 0;
+
+        if (idle) {
+            delete list->victim;
+            free(list);
+        } else {
+            retire(retired, list);
+        }
+        list = next;
+    }
+}
+
+Observer* Subject::subscribe(void (*fn)(Subject *, void *), void *user_data) {
     auto observer = new Observer(this, fn, user_data);
-    observers.push_back(observer);
+
+    replace(observer, nullptr);
     return observer;
 }
 
 ObserverDelayed *Subject::subscribe_delayed(void (*fn)(Subject *, void *), void *user_data) {
-    const std::lock_guard<std::mutex> lock(mutex_subscribe);
-
     auto observer = new ObserverDelayed(this, fn, user_data);
-    observers.push_back(observer);
+
+    replace(observer, nullptr);
+    return observer;
+}
+
+ObserverDelayed *Subject::subscribe_ctx(subject_ctx_t ctx, void (*fn)(Subject *, void *), void *user_data) {
+    auto observer = new ObserverDelayed(this, fn, user_data, ctx);
+
+    replace(observer, nullptr);
+    return observer;
+}
+
+Observer* Subject::subscribe_coalesced(void (*fn)(Subject *, void *), void *user_data) {
+    auto observer = new Observer(this, fn, user_data);
+
+    observer->coalesce = true;
+    replace(observer, nullptr);
+    return observer;
+}
+
+Observer* Subject::subscribe_immediate(void (*fn)(Subject *, void *), void *user_data) {
+    auto observer = new Observer(this, fn, user_data);
+
+    observer->immediate = true;
+    replace(observer, nullptr);
     return observer;
 }
 
 void Subject::unsubscribe(Observer *observer) {
-    observers.erase(std::find(observers.begin(), observers.end(), observer));
+    observer->active.store(false, std::memory_order_release);
+    replace(nullptr, observer);
 }
 
 data_type Subject::dtype() {
@@ -94,14 +460,18 @@ float subject_get_float(Subject *subj) {
 
 void subject_set_int(Subject *subj, int32_t val) {
     if (subj->dtype() == DTYPE_INT) {
+        trace_begin(TRACE_SUBJECT_SET, (uint32_t) val);
         static_cast<SubjectT<int32_t>*>(subj)->set(val);
+        trace_end(TRACE_SUBJECT_SET);
     } else {
         LV_LOG_ERROR("Expected dtype int, got %u\n", subj->dtype());
     }
 }
 void subject_set_uint64(Subject *subj, uint64_t val) {
     if (subj->dtype() == DTYPE_UINT64) {
+        trace_begin(TRACE_SUBJECT_SET, (uint32_t) val);
         static_cast<SubjectT<uint64_t>*>(subj)->set(val);
+        trace_end(TRACE_SUBJECT_SET);
     } else {
         LV_LOG_ERROR("Expected dtype uint64, got %u\n", subj->dtype());
     }
@@ -109,7 +479,9 @@ void subject_set_uint64(Subject *subj, uint64_t val) {
 
 void subject_set_float(Subject *subj, float val) {
     if (subj->dtype() == DTYPE_FLOAT) {
+        trace_begin(TRACE_SUBJECT_SET, (uint32_t) val);
         static_cast<SubjectT<float>*>(subj)->set(val);
+        trace_end(TRACE_SUBJECT_SET);
     } else {
         LV_LOG_ERROR("Expected dtype float, got %u\n", subj->dtype());
     }
@@ -124,6 +496,14 @@ Observer *subject_add_observer_and_call(Subject *subj, void (*fn)(Subject *, voi
     return observer;
 }
 
+Observer *subject_add_coalesced_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data) {
+    return subj->subscribe_coalesced(fn, user_data);
+}
+
+Observer *subject_add_immediate_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data) {
+    return subj->subscribe_immediate(fn, user_data);
+}
+
 ObserverDelayed *subject_add_delayed_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data) {
     return subj->subscribe_delayed(fn, user_data);
 }
@@ -134,20 +514,57 @@ ObserverDelayed *subject_add_delayed_observer_and_call(Subject *subj, void (*fn)
     return observer;
 }
 
+ObserverDelayed *subject_add_ctx_observer(Subject *subj, subject_ctx_t ctx, void (*fn)(Subject *, void *), void *user_data) {
+    return subj->subscribe_ctx(ctx, fn, user_data);
+}
+
+void subject_ctx_bind(subject_ctx_t ctx) {
+    ObserverDelayed::bind(ctx);
+}
+
+void subject_ctx_run(subject_ctx_t ctx) {
+    ObserverDelayed::notify_delayed(ctx);
+}
+
 data_type subject_get_dtype(Subject *subj) {
     return subj->dtype();
 }
 
 void observer_del(Observer *observer) {
-    delete observer;
+    observer->unsubscribe();
 }
 void observer_delayed_del(ObserverDelayed *observer) {
-    delete observer;
+    observer->unsubscribe();
 }
 void observer_delayed_notify_all(void) {
     ObserverDelayed::notify_delayed();
+    Subject::reclaim();
 };
 
+void subject_set_name(Subject *subj, const char *name) {
+    subj->set_name(name);
+}
+
+void subject_stats_enable(bool on) {
+    Subject::stats_enabled = on;
+}
+
+bool subject_stats_enabled(void) {
+    return Subject::stats_enabled;
+}
+
+void subject_stats_dump(FILE *f) {
+    Subject::dump_stats(f);
+}
+
+void subject_batch_begin(void) {
+    Subject::batch_begin();
+}
+
+void subject_batch_commit(void) {
+    Subject::batch_commit();
+}
+
 // subject_t subject_init_int(int32_t val) {
 //     subject_t subj = (subject_t)malloc(sizeof(__subject));
 //     pthread_mutex_init(&subj->mutex_set, NULL);
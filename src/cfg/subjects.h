@@ -8,55 +8,138 @@ enum data_type {
     DTYPE_GROUP,
 };
 
+/* Thread contexts, which run observers subscribed to them */
+typedef enum {
+    SUBJECT_CTX_UI = 0,         /* Main loop, owner is the subscribing thread */
+    SUBJECT_CTX_DSP,            /* DSP worker */
+    SUBJECT_CTX_AUDIO,          /* Audio worker */
+    SUBJECT_CTX_RADIO,          /* Radio control thread */
+
+    SUBJECT_CTX_LAST
+} subject_ctx_t;
+
 #ifdef __cplusplus
 
+#include "../lock_stats.h"
+
 #include <mutex>
+#include <stdio.h>
 #include <algorithm>
-#include <list>
 #include <type_traits>
+#include <vector>
 #include <thread>
 #include <atomic>
 
 class Subject;
 
 class Observer {
+    friend class Subject;
     protected:
     Subject *subj;
     void (*fn)(Subject *, void *);
     void *user_data;
+    std::atomic<bool> active = true;
+    bool coalesce = false;      /* Once per batch commit */
+    bool immediate = false;     /* Not deferred by batches */
+
+    /* Instrumentation, updated while subject stats are enabled */
+    std::atomic<uint32_t> calls = 0;
+    std::atomic<uint64_t> total_us = 0;
+    std::atomic<uint32_t> max_us = 0;
+    std::atomic<int32_t>  last_tid = 0;
 
     public:
     Observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data): subj(subj), fn(fn), user_data(user_data) {
     };
     virtual ~Observer();
     virtual void notify();
+    void unsubscribe();
+};
+
+/**
+ * Immutable snapshot of subject observers. Replaced on subscribe/unsubscribe,
+ * old snapshots are freed once no notification of the subject is running.
+ */
+struct ObserverList {
+    ObserverList    *retired_next;
+    Subject         *subj;
+    Observer        *victim;        /* Unsubscribed observer, deleted with the snapshot */
+    uint32_t        count;
+    Observer        *items[];
 };
 
+/**
+ * Observer called in the thread of its context. Notifications from other threads
+ * put the observer once into a lock-free dirty list of the context (mailbox),
+ * which notify_delayed() drains in the owner thread.
+ */
 class ObserverDelayed: public Observer {
-    static std::list<ObserverDelayed*> instances;
+    friend class Subject;
+    static std::atomic<ObserverDelayed*> dirty[SUBJECT_CTX_LAST];
+    static ObserverDelayed *draining[SUBJECT_CTX_LAST];
+    static std::atomic<std::thread::id> owner[SUBJECT_CTX_LAST];
+    subject_ctx_t ctx;
     std::thread::id tid;
-    std::atomic<bool> changed = false;
+    std::atomic<bool> queued = false;
+    ObserverDelayed *dirty_next = nullptr;
+
+    void push_dirty();
     public:
-    ObserverDelayed(Subject *subj, void (*fn)(Subject *, void *), void *user_data): Observer(subj, fn, user_data) {
+    ObserverDelayed(Subject *subj, void (*fn)(Subject *, void *), void *user_data,
+                    subject_ctx_t ctx=SUBJECT_CTX_UI): Observer(subj, fn, user_data), ctx(ctx) {
         tid = std::this_thread::get_id();
-        instances.push_back(this);
     };
     ~ObserverDelayed();
     void notify();
-    static void notify_delayed();
-
+    /* Make the calling thread the owner of ctx */
+    static void bind(subject_ctx_t ctx);
+    static void notify_delayed(subject_ctx_t ctx=SUBJECT_CTX_UI);
 };
 
 class Subject {
-    std::mutex mutex_subscribe;
+    friend class ObserverDelayed;
+    static std::atomic<ObserverList*> retired;
+    StatMutex mutex_subscribe{"subject"};
+    std::atomic<ObserverList*> observers = nullptr;
+    std::atomic<uint32_t> readers = 0;
+    const char *name = nullptr;
+    std::atomic<uint32_t> sets = 0;
+    std::atomic<uint32_t> changes = 0;
+
+    void replace(Observer *add, Observer *remove);
+    void deliver(std::vector<Observer*> &coalesced);
     protected:
-    std::list<Observer*> observers;
     data_type type;
+    void notify_observers();
+    void count_set() {
+        if (stats_enabled.load(std::memory_order_relaxed)) {
+            sets.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
     public:
+    static std::atomic<bool> stats_enabled;
+
+    Subject();
     virtual data_type dtype();
+    void set_name(const char *name) {
+        this->name = name;
+    };
+    static void dump_stats(FILE *f);
     Observer* subscribe(void (*fn)(Subject *, void *), void *user_data=nullptr);
     ObserverDelayed* subscribe_delayed(void (*fn)(Subject *, void *), void *user_data=nullptr);
+    /* Called in the thread bound to ctx */
+    ObserverDelayed* subscribe_ctx(subject_ctx_t ctx, void (*fn)(Subject *, void *), void *user_data=nullptr);
+    /* Called once per batch commit, even if several of its subjects changed */
+    Observer* subscribe_coalesced(void (*fn)(Subject *, void *), void *user_data=nullptr);
+    /* Called on set() even inside a batch, for bookkeeping like dirty flags */
+    Observer* subscribe_immediate(void (*fn)(Subject *, void *), void *user_data=nullptr);
+    /* Observer is deleted later, when no notification can see it */
     void unsubscribe(Observer *o);
+    /* Free retired snapshots, called from the main loop */
+    static void reclaim();
+
+    static void batch_begin();
+    static void batch_commit();
 };
 
 template <typename T> class SubjectT : public Subject {
@@ -72,11 +155,10 @@ template <typename T> class SubjectT : public Subject {
         return val;
     };
     void set(T val) {
+        count_set();
         if (this->val != val) {
             this->val = val;
-            for (auto observer : observers) {
-                observer->notify();
-            }
+            notify_observers();
         }
     };
     data_type dtype() {
@@ -105,6 +187,7 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 
 Subject *subject_create_int(int32_t val);
@@ -124,11 +207,35 @@ float    subject_get_float(Subject *subj);
 Observer *subject_add_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data);
 Observer *subject_add_observer_and_call(Subject *subj, void (*fn)(Subject *, void *), void *user_data);
 
+/// @brief Add observer, which is called once per batch even if it watches several changed subjects
+Observer *subject_add_coalesced_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data);
+
+/// @brief Add observer, which is called on change even inside a batch
+Observer *subject_add_immediate_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data);
+
 ObserverDelayed *subject_add_delayed_observer(Subject *subj, void (*fn)(Subject *, void *), void *user_data);
 ObserverDelayed *subject_add_delayed_observer_and_call(Subject *subj, void (*fn)(Subject *, void *), void *user_data);
 
+/// @brief Add observer, which is called in the thread bound to ctx.
+/// Changes made by other threads are queued and delivered by subject_ctx_run()
+ObserverDelayed *subject_add_ctx_observer(Subject *subj, subject_ctx_t ctx, void (*fn)(Subject *, void *), void *user_data);
+
+/// @brief Make the calling thread the owner of ctx
+void subject_ctx_bind(subject_ctx_t ctx);
+
+/// @brief Call queued observers of ctx, from its owner thread
+void subject_ctx_run(subject_ctx_t ctx);
+
 enum data_type subject_get_dtype(Subject *subj);
 
+/// @brief Name shown in stats dumps
+void subject_set_name(Subject *subj, const char *name);
+
+/// @brief Count sets/changes per subject and calls/durations/thread per observer
+void subject_stats_enable(bool on);
+bool subject_stats_enabled(void);
+void subject_stats_dump(FILE *f);
+
 void subject_set_int(Subject *subj, int32_t val);
 void subject_set_uint64(Subject *subj, uint64_t val);
 void subject_set_float(Subject *subj, float val);
@@ -138,6 +245,12 @@ void observer_delayed_del(ObserverDelayed *observer);
 
 void observer_delayed_notify_all(void);
 
+/// @brief Defer notifications of subjects set by this thread until the outermost commit.
+/// Each changed subject is delivered once, changes made by observers during the
+/// commit are delivered in the same commit
+void subject_batch_begin(void);
+void subject_batch_commit(void);
+
 #ifdef __cplusplus
 }
 #endif
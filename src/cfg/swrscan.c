@@ -0,0 +1,91 @@
+#include "swrscan.private.h"
+
+#include "cfg.h"
+#include "cfg.private.h"
+
+#include "../lvgl/lvgl.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static sqlite3        *db;
+static sqlite3_stmt   *write_stmt;
+static sqlite3_stmt   *read_stmt;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void cfg_swrscan_init(sqlite3 *database) {
+    db = database;
+    int rc;
+
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT points FROM swrscan WHERE ant = :ant AND band = :band", -1, &read_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
+        exit(1);
+    }
+    rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO swrscan(ant, band, points) VALUES(:ant, :band, :points)", -1,
+                            &write_stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare write statement: %s", sqlite3_errmsg(db));
+        exit(1);
+    }
+}
+
+int cfg_swrscan_save(int32_t ant, int32_t band, const cfg_swrscan_point_t *points, uint16_t count) {
+    sqlite3_stmt *stmt = write_stmt;
+    size_t       size = count * sizeof(cfg_swrscan_point_t);
+    int          rc;
+
+    cfg_save_begin();
+    pthread_mutex_lock(&mutex);
+
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":ant"), ant);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":band"), band);
+    rc = sqlite3_bind_blob(stmt, sqlite3_bind_parameter_index(stmt, ":points"), points, size, SQLITE_STATIC);
+
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed to bind swrscan points: %s", sqlite3_errmsg(db));
+    } else {
+        rc = sqlite3_step(stmt);
+
+        if (rc != SQLITE_DONE) {
+            LV_LOG_ERROR("Failed save swrscan: %s", sqlite3_errmsg(db));
+        } else {
+            rc = 0;
+            cfg_save_account(1, size + 2 * sizeof(int32_t));
+        }
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    pthread_mutex_unlock(&mutex);
+    cfg_save_end();
+
+    return rc;
+}
+
+uint16_t cfg_swrscan_load(int32_t ant, int32_t band, cfg_swrscan_point_t *points, uint16_t max) {
+    sqlite3_stmt *stmt = read_stmt;
+    uint16_t     count = 0;
+
+    pthread_mutex_lock(&mutex);
+
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":ant"), ant);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":band"), band);
+
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void *data = sqlite3_column_blob(stmt, 0);
+        int        size = sqlite3_column_bytes(stmt, 0);
+
+        count = LV_MIN(size / sizeof(cfg_swrscan_point_t), max);
+
+        if (data && count) {
+            memcpy(points, data, count * sizeof(cfg_swrscan_point_t));
+        }
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    pthread_mutex_unlock(&mutex);
+
+    return count;
+}
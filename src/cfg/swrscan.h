@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#define CFG_SWRSCAN_MAX_POINTS 64
+
+typedef struct {
+    int32_t freq;
+    float   vswr;
+} cfg_swrscan_point_t;
+
+/**
+ * Store the last sweep of antenna and band, points are ordered by freq
+ */
+int cfg_swrscan_save(int32_t ant, int32_t band, const cfg_swrscan_point_t *points, uint16_t count);
+
+/**
+ * Load the last sweep of antenna and band. Returns count of points, 0 if there is none
+ */
+uint16_t cfg_swrscan_load(int32_t ant, int32_t band, cfg_swrscan_point_t *points, uint16_t max);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "swrscan.h"
+
+#include <sqlite3.h>
+
+void cfg_swrscan_init(sqlite3 *database);
@@ -21,9 +21,9 @@ cfg_transverter_t cfg_transverters[TRANSVERTER_NUM];
 void cfg_transverter_init(sqlite3 *database) {
     db = database;
     int rc;
-    rc = sqlite3_prepare_v2(db, "SELECT val FROM transverter WHERE name = :name AND id = :id", -1, &read_stmt, 0);
+    rc = sqlite3_prepare_v2(cfg_read_db(), "SELECT val FROM transverter WHERE name = :name AND id = :id", -1, &read_stmt, 0);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare read statement: %s", sqlite3_errmsg(cfg_read_db()));
         exit(1);
     }
     rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO transverter(id, name, val) VALUES(:id, :name, :val)", -1,
@@ -65,30 +65,13 @@ int32_t cfg_transverter_get_shift(int32_t freq) {
 }
 
 static int cfg_transverter_load_item(cfg_item_t *item) {
-    int           rc;
-    int32_t       val;
-    sqlite3_stmt *stmt = read_stmt;
-    pthread_mutex_lock(&read_mutex);
-    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":name"), item->db_name, strlen(item->db_name), 0);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind name %s: %s", item->db_name, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":id"), item->pk);
-    if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Failed to bind mode %i: %s", item->pk, sqlite3_errmsg(db));
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
-        pthread_mutex_unlock(&read_mutex);
-        return rc;
-    }
+    int     rc;
+    int64_t int_val;
+    double  float_val;
 
-    rc = sqlite3_step(stmt);
+    rc = cfg_item_read(CFG_TABLE_TRANSVERTER, read_stmt, &read_mutex, item, &int_val, &float_val);
     if (rc == SQLITE_ROW) {
-        subject_set_int(item->val, sqlite3_column_int(stmt, 0));
+        subject_set_int(item->val, (int32_t)int_val);
         rc = 0;
     } else {
         LV_LOG_WARN("No results for load from transverter with name: %s and id: %i", item->db_name, item->pk);
@@ -96,9 +79,6 @@ static int cfg_transverter_load_item(cfg_item_t *item) {
         cfg_transverter_save_item(item);
         rc = -1;
     }
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    pthread_mutex_unlock(&read_mutex);
     return rc;
 }
 
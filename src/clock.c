@@ -14,6 +14,7 @@
 #include "backlight.h"
 #include "voice.h"
 #include "msg.h"
+#include "label_text.h"
 
 #include <time.h>
 #include <sys/time.h>
@@ -137,7 +138,7 @@ static void show_time() {
             break;
     }
 
-    lv_label_set_text(obj, str);
+    label_text_set(obj, str);
 }
 
 lv_obj_t * clock_init(lv_obj_t * parent) {
@@ -0,0 +1,125 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "contest.h"
+
+#include "cfg/cfg.h"
+
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+static const contest_rules_t rules = {
+    .dupe_per_mode = true,
+    .mults_per_band = true,
+    .mults = CONTEST_MULT_GRID | CONTEST_MULT_PREFIX,
+    .points = 1,
+};
+
+static contest_engine_t engine;
+static bool             engine_ready = false;
+static atomic_bool      active = false;
+static pthread_mutex_t  engine_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Called from the FT8 decode thread, which is cancelled asynchronously, so the
+ * cancellation is off while the lock is held
+ */
+static void lock(int *cancel_state) {
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, cancel_state);
+    pthread_mutex_lock(&engine_mutex);
+}
+
+static void unlock(int cancel_state) {
+    pthread_mutex_unlock(&engine_mutex);
+    pthread_setcancelstate(cancel_state, NULL);
+}
+
+static void load_record(const qso_log_record_t *qso, void *user) {
+    contest_engine_add(&engine, qso->remote_call, qso->remote_grid, qso->band, qso->mode);
+}
+
+static void on_contest_change(Subject *subj, void *user_data) {
+    bool    on = subject_get_int(subj);
+    int32_t start = subject_get_int(cfg.contest_start.val);
+    int     cancel_state;
+
+    if (on && !start) {
+        start = time(NULL);
+        subject_set_int(cfg.contest_start.val, start);
+    } else if (!on && start) {
+        subject_set_int(cfg.contest_start.val, 0);
+    }
+
+    lock(&cancel_state);
+    contest_engine_clear(&engine);
+
+    if (on) {
+        size_t count = qso_log_records_since(start, load_record, NULL);
+
+        LV_LOG_USER("Contest: %zu QSOs since %i, score %u", count, start, engine.score.score);
+    }
+    atomic_store(&active, on);
+    unlock(cancel_state);
+}
+
+void contest_init() {
+    if (!contest_engine_init(&engine, &rules)) {
+        LV_LOG_ERROR("Can't allocate contest tables");
+        return;
+    }
+    engine_ready = true;
+    subject_add_observer_and_call(cfg.contest.val, on_contest_change, NULL);
+}
+
+bool contest_active() {
+    return atomic_load(&active);
+}
+
+uint8_t contest_check(const char *callsign, const char *grid, qso_log_band_t band, qso_log_mode_t mode) {
+    uint8_t res = 0;
+    int     cancel_state;
+
+    if (!atomic_load(&active)) {
+        return 0;
+    }
+    lock(&cancel_state);
+    res = contest_engine_check(&engine, callsign, grid, band, mode);
+    unlock(cancel_state);
+
+    return res;
+}
+
+uint8_t contest_log_qso(const qso_log_record_t *qso) {
+    uint8_t res = 0;
+    int     cancel_state;
+
+    if (atomic_load(&active)) {
+        lock(&cancel_state);
+        res = contest_engine_add(&engine, qso->remote_call, qso->remote_grid, qso->band, qso->mode);
+        unlock(cancel_state);
+    }
+    qso_log_record_queue(qso);
+
+    return res;
+}
+
+void contest_score(contest_score_t *score) {
+    int cancel_state;
+
+    lock(&cancel_state);
+    if (engine_ready) {
+        *score = engine.score;
+    } else {
+        memset(score, 0, sizeof(*score));
+    }
+    unlock(cancel_state);
+}
@@ -0,0 +1,53 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "contest_engine.h"
+#include "qso_log.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Contest session over contest_engine.h: QSOs since the start are dupe and
+ * multiplier checked in O(1) and scored. The session runs while cfg contest is
+ * on, its start time is kept in cfg contest_start and the QSOs since it are
+ * loaded from the log on boot. New QSOs are added in memory at once and
+ * written to the log in batches, see qso_log_record_queue().
+ *
+ * Rules: a callsign once per band and mode, 1 point per QSO, grids and WPX
+ * prefixes are multipliers on each band. Any thread
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * After qso_log_init()
+ */
+void contest_init();
+
+bool contest_active();
+
+/**
+ * contest_check_t of a QSO, 0 if there is no session. The grid may be NULL
+ */
+uint8_t contest_check(const char *callsign, const char *grid, qso_log_band_t band, qso_log_mode_t mode);
+
+/**
+ * Add the QSO to the session and queue it to the log. Returns contest_check_t of it
+ */
+uint8_t contest_log_qso(const qso_log_record_t *qso);
+
+void contest_score(contest_score_t *score);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,296 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "contest_engine.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define INIT_SIZE       256         /* Power of 2 */
+
+/* Multiplier key: kind, band index and value (grid index or prefix ID) */
+#define MULT_KEY(kind, band, value)     ((uint32_t) (kind) << 28 | (uint32_t) (band) << 24 | (value))
+#define MULT_VALUE_MAX                  (1 << 24)
+#define MULT_UNKNOWN                    UINT32_MAX      /* Prefix which was never seen */
+
+static uint32_t hash(uint32_t key) {
+    return key * 2654435761u;
+}
+
+/**
+ * Slot of the callsign or a free slot for it
+ */
+static contest_call_t * call_find(const contest_engine_t *engine, call_id_t call) {
+    size_t i = hash(call) & (engine->calls_size - 1);
+
+    while (engine->calls[i].call && engine->calls[i].call != call) {
+        i = (i + 1) & (engine->calls_size - 1);
+    }
+    return &engine->calls[i];
+}
+
+static uint32_t * mult_find(const contest_engine_t *engine, uint32_t key) {
+    size_t i = hash(key) & (engine->mults_size - 1);
+
+    while (engine->mults[i] && engine->mults[i] != key) {
+        i = (i + 1) & (engine->mults_size - 1);
+    }
+    return &engine->mults[i];
+}
+
+static bool calls_grow(contest_engine_t *engine) {
+    contest_engine_t    old = *engine;
+    size_t              size = old.calls_size * 2;
+
+    engine->calls = calloc(size, sizeof(contest_call_t));
+
+    if (!engine->calls) {
+        engine->calls = old.calls;
+        return false;
+    }
+    engine->calls_size = size;
+
+    for (size_t i = 0; i < old.calls_size; i++) {
+        if (old.calls[i].call) {
+            *call_find(engine, old.calls[i].call) = old.calls[i];
+        }
+    }
+    free(old.calls);
+    return true;
+}
+
+static bool mults_grow(contest_engine_t *engine) {
+    contest_engine_t    old = *engine;
+    size_t              size = old.mults_size * 2;
+
+    engine->mults = calloc(size, sizeof(uint32_t));
+
+    if (!engine->mults) {
+        engine->mults = old.mults;
+        return false;
+    }
+    engine->mults_size = size;
+
+    for (size_t i = 0; i < old.mults_size; i++) {
+        if (old.mults[i]) {
+            *mult_find(engine, old.mults[i]) = old.mults[i];
+        }
+    }
+    free(old.mults);
+    return true;
+}
+
+bool contest_engine_init(contest_engine_t *engine, const contest_rules_t *rules) {
+    memset(engine, 0, sizeof(*engine));
+    engine->rules = *rules;
+    engine->calls = calloc(INIT_SIZE, sizeof(contest_call_t));
+    engine->mults = calloc(INIT_SIZE, sizeof(uint32_t));
+
+    if (!engine->calls || !engine->mults) {
+        contest_engine_free(engine);
+        return false;
+    }
+    engine->calls_size = INIT_SIZE;
+    engine->mults_size = INIT_SIZE;
+    return true;
+}
+
+void contest_engine_free(contest_engine_t *engine) {
+    free(engine->calls);
+    free(engine->mults);
+    memset(engine, 0, sizeof(*engine));
+}
+
+void contest_engine_clear(contest_engine_t *engine) {
+    memset(engine->calls, 0, engine->calls_size * sizeof(contest_call_t));
+    memset(engine->mults, 0, engine->mults_size * sizeof(uint32_t));
+    engine->calls_count = 0;
+    engine->mults_count = 0;
+    memset(&engine->score, 0, sizeof(engine->score));
+}
+
+bool contest_prefix(const char *callsign, char *out) {
+    char    call[CALL_INTERN_LEN];
+    size_t  len = 0;
+
+    if (!call_canonize(callsign, call)) {
+        return false;
+    }
+    for (size_t i = 0; call[i]; i++) {
+        if (isdigit((unsigned char) call[i])) {
+            len = i + 1;
+        }
+    }
+    if (len) {
+        memcpy(out, call, len);
+        out[len] = '\0';
+    } else if (strlen(call) >= 2) {
+        out[0] = call[0];
+        out[1] = call[1];
+        out[2] = '0';
+        out[3] = '\0';
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Index of a 4 chars locator + 1, 0 if it isn't one
+ */
+static uint32_t grid_value(const char *grid) {
+    if (!grid || strlen(grid) < CONTEST_GRID_LEN) {
+        return 0;
+    }
+
+    char a = toupper((unsigned char) grid[0]);
+    char b = toupper((unsigned char) grid[1]);
+
+    if (a < 'A' || a > 'R' || b < 'A' || b > 'R' || !isdigit((unsigned char) grid[2]) ||
+        !isdigit((unsigned char) grid[3]))
+    {
+        return 0;
+    }
+    /* FT8 sign-off, not a locator */
+    if (strncasecmp(grid, "RR73", 4) == 0) {
+        return 0;
+    }
+    return (((a - 'A') * 18 + (b - 'A')) * 10 + (grid[2] - '0')) * 10 + (grid[3] - '0') + 1;
+}
+
+/**
+ * Keys of the multipliers of the QSO, 0 for the kinds not in the rules or not
+ * parsed. Prefixes are interned on the add only, MULT_UNKNOWN otherwise
+ */
+static void mult_keys(const contest_engine_t *engine, const char *callsign, const char *grid, qso_log_band_t band,
+                      bool add, uint32_t *grid_key, uint32_t *prefix_key)
+{
+    uint8_t band_index = engine->rules.mults_per_band ? qso_log_band_index(band) : 0;
+
+    *grid_key = 0;
+    *prefix_key = 0;
+
+    if (engine->rules.mults & CONTEST_MULT_GRID) {
+        uint32_t value = grid_value(grid);
+
+        if (value) {
+            *grid_key = MULT_KEY(CONTEST_MULT_GRID, band_index, value);
+        }
+    }
+    if (engine->rules.mults & CONTEST_MULT_PREFIX) {
+        char        prefix[CALL_INTERN_LEN] = "";
+        call_id_t   id = CALL_ID_NONE;
+
+        if (contest_prefix(callsign, prefix)) {
+            id = add ? call_intern_canon(prefix) : call_intern_find_canon(prefix);
+        }
+        if (id != CALL_ID_NONE && id < MULT_VALUE_MAX) {
+            *prefix_key = MULT_KEY(CONTEST_MULT_PREFIX, band_index, id);
+        } else if (id == CALL_ID_NONE && !add && prefix[0]) {
+            *prefix_key = MULT_UNKNOWN;
+        }
+    }
+}
+
+static bool is_dupe(const contest_engine_t *engine, const contest_call_t *entry, qso_log_band_t band,
+                    qso_log_mode_t mode)
+{
+    uint8_t modes = entry->band_modes[qso_log_band_index(band)];
+
+    return engine->rules.dupe_per_mode ? modes & (1 << mode) : modes != 0;
+}
+
+uint8_t contest_engine_check(const contest_engine_t *engine, const char *callsign, const char *grid,
+                             qso_log_band_t band, qso_log_mode_t mode)
+{
+    uint8_t     res = 0;
+    call_id_t   call = call_intern_find_canon(callsign);
+
+    if (call != CALL_ID_NONE) {
+        contest_call_t *entry = call_find(engine, call);
+
+        if (entry->call && is_dupe(engine, entry, band, mode)) {
+            res |= CONTEST_DUPE;
+        }
+    }
+
+    uint32_t grid_key, prefix_key;
+
+    mult_keys(engine, callsign, grid, band, false, &grid_key, &prefix_key);
+
+    if (grid_key && !*mult_find(engine, grid_key)) {
+        res |= CONTEST_NEW_GRID;
+    }
+    if (prefix_key == MULT_UNKNOWN || (prefix_key && !*mult_find(engine, prefix_key))) {
+        res |= CONTEST_NEW_PREFIX;
+    }
+    return res;
+}
+
+static bool mult_add(contest_engine_t *engine, uint32_t key) {
+    if ((engine->mults_count + 1) * 4 > engine->mults_size * 3 && !mults_grow(engine)) {
+        return false;
+    }
+
+    uint32_t *slot = mult_find(engine, key);
+
+    if (*slot) {
+        return false;
+    }
+    *slot = key;
+    engine->mults_count++;
+    return true;
+}
+
+uint8_t contest_engine_add(contest_engine_t *engine, const char *callsign, const char *grid,
+                           qso_log_band_t band, qso_log_mode_t mode)
+{
+    call_id_t   call = call_intern_canon(callsign);
+    uint8_t     res = 0;
+
+    if (call == CALL_ID_NONE) {
+        return 0;
+    }
+    if ((engine->calls_count + 1) * 4 > engine->calls_size * 3 && !calls_grow(engine)) {
+        return 0;
+    }
+
+    contest_call_t  *entry = call_find(engine, call);
+    contest_score_t *score = &engine->score;
+
+    if (!entry->call) {
+        entry->call = call;
+        engine->calls_count++;
+    }
+    score->qsos++;
+
+    if (is_dupe(engine, entry, band, mode)) {
+        score->dupes++;
+        return CONTEST_DUPE;
+    }
+    entry->band_modes[qso_log_band_index(band)] |= 1 << mode;
+    score->points += engine->rules.points;
+
+    uint32_t grid_key, prefix_key;
+
+    mult_keys(engine, callsign, grid, band, true, &grid_key, &prefix_key);
+
+    if (grid_key && mult_add(engine, grid_key)) {
+        score->grids++;
+        res |= CONTEST_NEW_GRID;
+    }
+    if (prefix_key && mult_add(engine, prefix_key)) {
+        score->prefixes++;
+        res |= CONTEST_NEW_PREFIX;
+    }
+    score->score = engine->rules.mults ? score->points * (score->grids + score->prefixes) : score->points;
+
+    return res;
+}
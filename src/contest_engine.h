@@ -0,0 +1,104 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "qso_log.h"
+#include "ft8/call_intern.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Dupes, multipliers and score of a contest, in memory. Worked callsigns are
+ * interned (ft8/call_intern.h) and their IDs are keys of an open addressing
+ * table of mode bitsets per band. Multipliers of all kinds and bands are keys
+ * of one open addressing set. Checks are O(1) and never touch SQLite, nothing
+ * is allocated but on the growth of the tables. Not thread safe, see contest.h
+ */
+
+#define CONTEST_GRID_LEN    4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CONTEST_MULT_GRID   = 1 << 0,   /* 4 chars locators */
+    CONTEST_MULT_PREFIX = 1 << 1,   /* WPX style prefixes, see contest_prefix() */
+} contest_mult_t;
+
+typedef struct {
+    bool        dupe_per_mode;      /* A callsign counts once per band and mode, else once per band */
+    bool        mults_per_band;     /* Multipliers count on each band, else once */
+    uint8_t     mults;              /* contest_mult_t */
+    uint8_t     points;             /* Of a QSO */
+} contest_rules_t;
+
+/* Result of a check */
+typedef enum {
+    CONTEST_DUPE        = 1 << 0,
+    CONTEST_NEW_GRID    = 1 << 1,
+    CONTEST_NEW_PREFIX  = 1 << 2,
+} contest_check_t;
+
+typedef struct {
+    uint32_t    qsos;               /* With the dupes */
+    uint32_t    dupes;
+    uint32_t    points;
+    uint32_t    grids;
+    uint32_t    prefixes;
+    uint32_t    score;              /* Points by multipliers, points without multipliers in the rules */
+} contest_score_t;
+
+typedef struct {
+    uint32_t    call;               /* call_id_t, CALL_ID_NONE - free slot */
+    uint8_t     band_modes[QSO_LOG_BANDS];
+} contest_call_t;
+
+typedef struct {
+    contest_rules_t rules;
+    contest_call_t  *calls;
+    size_t          calls_size;     /* Power of 2 */
+    size_t          calls_count;
+    uint32_t        *mults;         /* 0 - free slot */
+    size_t          mults_size;     /* Power of 2 */
+    size_t          mults_count;
+    contest_score_t score;
+} contest_engine_t;
+
+bool contest_engine_init(contest_engine_t *engine, const contest_rules_t *rules);
+void contest_engine_free(contest_engine_t *engine);
+
+/**
+ * Forget the QSOs, the rules and the tables are kept
+ */
+void contest_engine_clear(contest_engine_t *engine);
+
+/**
+ * contest_check_t of a QSO, without adding it. The grid may be NULL or empty
+ */
+uint8_t contest_engine_check(const contest_engine_t *engine, const char *callsign, const char *grid,
+                             qso_log_band_t band, qso_log_mode_t mode);
+
+/**
+ * Add a QSO, returns contest_check_t of it before the adding
+ */
+uint8_t contest_engine_add(contest_engine_t *engine, const char *callsign, const char *grid,
+                           qso_log_band_t band, qso_log_mode_t mode);
+
+/**
+ * WPX prefix of the canonical callsign into `out` of CALL_INTERN_LEN: up to the
+ * last digit, the first 2 letters and "0" if there is no digit
+ */
+bool contest_prefix(const char *callsign, char *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,12 +11,14 @@
 #include <math.h>
 
 #include "util.h"
+#include "dsp/moving_power.h"
+#include "dsp/tone_band.h"
+#include "dsp/fft.h"
 #include "cfg/cfg.h"
 #include "cfg/subjects.h"
 
 extern "C" {
     #include "lvgl/lvgl.h"
-    #include <pthread.h>
     #include "audio.h"
     #include "params/params.h"
     #include "cw_decoder.h"
@@ -24,34 +26,39 @@ extern "C" {
     #include "meter.h"
     #include "cw_tune_ui.h"
     #include "pubsub_ids.h"
+    #include "goertzel.h"
 }
 
-typedef struct {
-    uint16_t    n;
-    float       val;
-} fft_item_t;
-
 #define NUM_STAGES 6
 #define DECIM_FACTOR (1LL << NUM_STAGES)
 #define FFT 128
 #define MAX_CW_BW 500
 
-static bool ready = false;
+#define TRACK_BINS          3   // Goertzel bins around the locked peak
+#define REACQUIRE_FRAMES    8   // Full FFT after so many tracked frames
 
-static fft_item_t fft_items[FFT];
+static bool ready = false;
 
 static dds_cccf  ds_dec;
-static wrms_t    wrms;
+static MovingPower *rms;
 static cbuffercf input_cbuf;
-static cbuffercf rms_cbuf;
 static wdelayf   rms_delay;
 
-static cbuffercf fft_cbuf;
-static fftplan   fft_plan;
+static fft_plan_t *fft_plan;
 static float     window[FFT];
 static cfloat    fft_time[FFT];
 static cfloat    fft_freq[FFT];
 static float     audio_psd_squared[FFT];
+static size_t    frame_pos = 0;
+
+/*
+ * While the peak is locked, frames are processed by a bank of Goertzel bins
+ * around it, instead of the full FFT. Zero track_frames - next frame is FFT
+ */
+static goertzelcf_t track_bank[TRACK_BINS];
+static uint16_t     track_bin;
+static uint16_t     track_frames = 0;
+static float        track_energy;
 
 static float peak_filtered;
 static float noise_filtered;
@@ -69,8 +76,6 @@ static float   cw_decoder_snr_gist;
 static bool    cw_decoder;
 static bool    cw_tune;
 
-static pthread_mutex_t  cw_mutex = PTHREAD_MUTEX_INITIALIZER;
-
 static void dds_dec_init();
 
 static void on_key_tone_change(Subject *subj, void *user_data);
@@ -78,7 +83,11 @@ static void on_val_float_change(Subject *subj, void *user_data);
 static void on_val_bool_change(Subject *subj, void *user_data);
 
 void cw_init() {
-    cfg.key_tone.val->subscribe(on_key_tone_change)->notify();
+    /* Decimator is used by the audio thread only, key tone changes are applied there */
+    key_tone = subject_get_int(cfg.key_tone.val);
+    dds_dec_init();
+    cw_decoder_init();
+    cfg.key_tone.val->subscribe_ctx(SUBJECT_CTX_AUDIO, on_key_tone_change);
     cfg.cw_decoder_peak_beta.val->subscribe(on_val_float_change, (void*)&cw_decoder_peak_beta)->notify();
     cfg.cw_decoder_noise_beta.val->subscribe(on_val_float_change, (void*)&cw_decoder_noise_beta)->notify();
     cfg.cw_decoder_snr.val->subscribe(on_val_float_change, (void*)&cw_decoder_snr)->notify();
@@ -87,9 +96,7 @@ void cw_init() {
     cfg.cw_tune.val->subscribe(on_val_bool_change, (void*)&cw_tune)->notify();
 
     input_cbuf = cbuffercf_create(10000);
-    wrms = wrms_create(16, 4);
-    rms_cbuf = cbuffercf_create(4000 / 8 * 2);
-    fft_cbuf = cbuffercf_create(4000 / 8 * 2);
+    rms = new MovingPower(16, 4);
 
     // Window for FFT
     float scale = 0.0f;
@@ -102,9 +109,9 @@ void cw_init() {
     for (size_t i=0; i<FFT; i++)
         window[i] *= scale;
 
-    fft_plan = fft_create_plan(FFT, fft_time, fft_freq, LIQUID_FFT_FORWARD, 0);
+    fft_plan = fft_plan_get(FFT, FFT_DIR_FORWARD);
 
-    rms_delay = wdelayf_create(FFT / wrms_delay(wrms));
+    rms_delay = wdelayf_create(FFT / rms->get_step());
 
     peak_filtered = -10.0f;
     noise_filtered = -20.0f;
@@ -113,58 +120,16 @@ void cw_init() {
 }
 
 static void dds_dec_init() {
-    pthread_mutex_lock(&cw_mutex);
     if (ds_dec != NULL) {
         dds_cccf_destroy(ds_dec);
     }
     float rel_freq = (float) key_tone / AUDIO_CAPTURE_RATE;
     float bw = (float) MAX_CW_BW / AUDIO_CAPTURE_RATE;
     ds_dec = dds_cccf_create(NUM_STAGES, rel_freq, bw, 60.0f);
-    pthread_mutex_unlock(&cw_mutex);
 }
 
-static int compare_fft_items(const void *p1, const void *p2) {
-    fft_item_t *i1 = (fft_item_t *) p1;
-    fft_item_t *i2 = (fft_item_t *) p2;
-
-    return (i1->val > i2->val) ? -1 : 1;
-}
-
-static void update_thresholds() {
-    float noise;
-    float sum_all = 0.0f;
-    float sum_signal = 0.0f;
-    float peak_val = -1.0f;
-    int16_t peak_pos, peak_start, peak_end;
-
-    // Find top positions
-    for (int16_t n = 0; n < FFT; n++) {
-        if (audio_psd_squared[n] > peak_val) {
-            peak_val = audio_psd_squared[n];
-            peak_pos = n;
-        }
-        sum_all += audio_psd_squared[n];
-    }
-
-    // BW for 30 WPM
-    uint16_t peak_width = 30 * 4 * FFT * DECIM_FACTOR / AUDIO_CAPTURE_RATE;
-
-    peak_start = peak_pos - peak_width / 2;
-    peak_end = peak_start + peak_width;
-    if (peak_start < 0) {
-        peak_start = 0;
-        peak_end = peak_width;
-    } else if (peak_end >= FFT) {
-        peak_end = FFT;
-        peak_start = peak_end - peak_width;
-    }
-
-    for (uint16_t i = peak_start; i < peak_end; i++) {
-        sum_signal += audio_psd_squared[i];
-    }
-    noise = sum_all - sum_signal;
-
-    if (sum_signal/noise > 1) {
+static void update_thresholds(bool signal) {
+    if (signal) {
         lpf(&peak_filtered, LV_MAX(noise_filtered + cw_decoder_snr, rms_db_max), cw_decoder_peak_beta, S_MIN);
         threshold_pulse = 0;
     } else {
@@ -204,6 +169,97 @@ static bool decode(float rms_db) {
 }
 
 
+static float bin_freq(uint16_t bin) {
+    // Fix fft order
+    return (((float) (FFT - (bin + FFT / 2) % FFT) / FFT) - 0.5f) * ((float) AUDIO_CAPTURE_RATE / DECIM_FACTOR);
+}
+
+static void track_start(uint16_t bin) {
+    track_bin = bin;
+    track_energy = 0.0f;
+
+    for (int i = 0; i < TRACK_BINS; i++) {
+        goertzelcf_bin_init(&track_bank[i], (bin + FFT + i - TRACK_BINS / 2) % FFT, FFT);
+    }
+}
+
+static void process_fft() {
+    fft_plan_execute(fft_plan, fft_time, fft_freq);
+
+    for (size_t i = 0; i < FFT; i++) {
+        audio_psd_squared[i] = std::real(fft_freq[i] * std::conj(fft_freq[i]));
+    }
+
+    // BW for 30 WPM
+    tone_band_t band = tone_band(audio_psd_squared, FFT, 30 * 4 * FFT * DECIM_FACTOR / AUDIO_CAPTURE_RATE);
+    bool        signal = band.ratio > 1;
+
+    update_thresholds(signal);
+    update_peak_freq(bin_freq(band.peak_pos));
+
+    if (signal) {
+        track_frames = 1;
+        track_start(band.peak_pos);
+    } else {
+        track_frames = 0;
+    }
+}
+
+/* Signal in the bank, against the rest of the frame energy */
+static void process_track() {
+    float    sum_signal = 0.0f;
+    float    peak_val = -1.0f;
+    uint16_t peak_bin = track_bin;
+
+    for (int i = 0; i < TRACK_BINS; i++) {
+        float val = goertzelcf_power(&track_bank[i]);
+
+        if (val > peak_val) {
+            peak_val = val;
+            peak_bin = (track_bin + FFT + i - TRACK_BINS / 2) % FFT;
+        }
+        sum_signal += val;
+    }
+
+    // Parseval, energy of all bins
+    float noise = track_energy * FFT - sum_signal;
+    bool  signal = sum_signal / noise > 1;
+
+    update_thresholds(signal);
+
+    if (signal) {
+        update_peak_freq(bin_freq(peak_bin));
+        track_frames = (track_frames + 1) % REACQUIRE_FRAMES;
+        track_start(peak_bin);
+    } else {
+        track_frames = 0;
+    }
+}
+
+static void put_frame_sample(cfloat sample) {
+    sample *= window[frame_pos];
+
+    if (track_frames) {
+        for (int i = 0; i < TRACK_BINS; i++) {
+            goertzelcf_input(&track_bank[i], sample);
+        }
+        track_energy += std::real(sample * std::conj(sample));
+    } else {
+        fft_time[frame_pos] = sample;
+    }
+
+    if (++frame_pos < FFT) {
+        return;
+    }
+    frame_pos = 0;
+
+    if (track_frames) {
+        process_track();
+    } else {
+        process_fft();
+    }
+}
+
 void cw_put_audio_samples(unsigned int n, cfloat *samples) {
     if (!ready) {
         return;
@@ -212,8 +268,7 @@ void cw_put_audio_samples(unsigned int n, cfloat *samples) {
         return;
     }
     cfloat sample;
-    float rms_db, peak_freq;
-    size_t max_pos;
+    float rms_db;
 
     // fill input buffer
     cbuffercf_write(input_cbuf, samples, n);
@@ -224,44 +279,19 @@ void cw_put_audio_samples(unsigned int n, cfloat *samples) {
         unsigned int n;
         cfloat *buf;
         cbuffercf_read(input_cbuf, desired_num, &buf, &n);
-        pthread_mutex_lock(&cw_mutex);
         dds_cccf_decim_execute(ds_dec, buf, &sample);
-        pthread_mutex_unlock(&cw_mutex);
         cbuffercf_release(input_cbuf, desired_num);
-        cbuffercf_push(rms_cbuf, sample);
-        cbuffercf_push(fft_cbuf, sample);
-
-        // Process FFT
-        while (cbuffercf_size(fft_cbuf) >= FFT) {
-            for (size_t i = 0; i < FFT; i++) {
-                cbuffercf_pop(fft_cbuf, &fft_time[i]);
-                fft_time[i] *= window[i];
-            }
-            fft_execute(fft_plan);
-
-            for (size_t i = 0; i < FFT; i++) {
-                audio_psd_squared[i] = std::real(fft_freq[i] * std::conj(fft_freq[i]));
-            }
-            update_thresholds();
-
-            max_pos = argmax(audio_psd_squared, FFT);
-            // Fix fft order
-            peak_freq = (((float) (FFT - (max_pos + FFT / 2) % FFT) / FFT) - 0.5f) * ((float) AUDIO_CAPTURE_RATE / DECIM_FACTOR);
-            update_peak_freq(peak_freq);
-        }
+        put_frame_sample(sample);
 
         // Process RMS
-        while (cbuffercf_size(rms_cbuf)) {
-            cbuffercf_pop(rms_cbuf, &sample);
-            wrms_pushcf(wrms, sample);
-            if (wrms_ready(wrms)) {
-                rms_db = wrms_get_val(wrms);
-                rms_db_min = LV_MIN(rms_db_min, rms_db);
-                rms_db_max = LV_MAX(rms_db_max, rms_db);
-                wdelayf_push(rms_delay, rms_db);
-                wdelayf_read(rms_delay, &rms_db);
-                cw_decoder_signal(decode(rms_db), 1000.0f / AUDIO_CAPTURE_RATE * DECIM_FACTOR * wrms_delay(wrms));
-            }
+        if (rms->push(sample)) {
+            // Thresholds are of the amplitude, 10 * log10(|x|)
+            rms_db = rms->get_db(-242.0f) * 0.5f;
+            rms_db_min = LV_MIN(rms_db_min, rms_db);
+            rms_db_max = LV_MAX(rms_db_max, rms_db);
+            wdelayf_push(rms_delay, rms_db);
+            wdelayf_read(rms_delay, &rms_db);
+            cw_decoder_signal(decode(rms_db), 1000.0f / AUDIO_CAPTURE_RATE * DECIM_FACTOR * rms->get_step());
         }
     }
 }
@@ -326,6 +356,8 @@ void cw_put_audio_samples(unsigned int n, cfloat *samples) {
 static void on_key_tone_change(Subject *subj, void *user_data) {
     key_tone = static_cast<SubjectT<int32_t>*>(subj)->get();
     dds_dec_init();
+    frame_pos = 0;
+    track_frames = 0;
 }
 
 static void on_val_float_change(Subject *subj, void *user_data) {
@@ -8,49 +8,25 @@
 
 /* Based on idea Michael A. Maynard, a.k.a. "K4ICY" */
 
+#include <ctype.h>
 #include <math.h>
+#include <pthread.h>
+#include <string.h>
 #include "lvgl/lvgl.h"
 #include "cw_decoder.h"
 #include "pannel.h"
 
-#define HIST_SIZE       10
+static cw_decoder_t     decoder;
 
-static uint32_t debounce_factor = 15;
-static uint32_t thr_mean = 139;
-
-static uint32_t time_track = 0;
-
-static int32_t  key_line_event_prev = 0;
-static int32_t  key_line_event_new = 0;
-static uint32_t key_line_ref = 0;
-
-static uint32_t event_hist_index = 0;
-static uint32_t short_event_hist[HIST_SIZE];
-static uint32_t long_event_hist[HIST_SIZE];
-static uint32_t space_event_hist[HIST_SIZE];
-
-static uint64_t long_event_avr = 0;
-static uint64_t short_event_avr = 0;
-static uint64_t space_event_avr = 0;
-
-static uint16_t wpm_old;
-static uint32_t wpm;
-
-static uint32_t space_duration = 0;
-static uint32_t space_duration_prev = 0;
-static uint32_t space_duration_ref;
-
-static uint32_t word_space_duration = 0;
-static uint32_t word_space_duration_ref = 0;
-static float    word_space_timing = 3.0f;
-
-static bool     key_line = false;
-
-static float    compare_factor = 2.0;
-
-static bool     character_step = false;
-static bool     word_step = false;
-static char     elements[128];
+/*
+ * Indexes of cw_characters, built once. Codes are (1 << len) | bits, with the first
+ * element in the high bit, so every length has its own range. Prosigns are keyed by
+ * their first two letters. The first entry of a duplicated character wins
+ */
+static cw_characters_t  *by_code[2 << CW_MORSE_MAX_LEN];
+static cw_characters_t  *by_char[128];
+static cw_characters_t  *by_prosign[26][26];
+static pthread_once_t   index_once = PTHREAD_ONCE_INIT;
 
 cw_characters_t cw_characters[] = {
     { .morse = ".-",        .character = "A" },
@@ -124,181 +100,250 @@ cw_characters_t cw_characters[] = {
     { .morse = NULL }
 };
 
-void cw_decoder_init() {
-}
+static void index_build() {
+    for (cw_characters_t *character = &cw_characters[0]; character->morse; character++) {
+        uint16_t    code = 1;
+        const char  *text = character->character;
+
+        for (const char *m = character->morse; *m; m++) {
+            code = (code << 1) | (*m == '-');
+        }
+        if (!by_code[code]) {
+            by_code[code] = character;
+        }
 
-static void cw_decoder_ans(const char *ans) {
-    pannel_add_text(ans);
+        if (text[1] == '\0') {
+            if (!by_char[(uint8_t)text[0] & 0x7F]) {
+                by_char[(uint8_t)text[0] & 0x7F] = character;
+            }
+        } else if (text[0] == '<' && isupper(text[1]) && isupper(text[2])) {
+            if (!by_prosign[text[1] - 'A'][text[2] - 'A']) {
+                by_prosign[text[1] - 'A'][text[2] - 'A'] = character;
+            }
+        }
+    }
 }
 
-static void cw_decoder_wpm(uint16_t wpm) {
+const char * cw_morse_decode(uint16_t bits, uint8_t len) {
+    pthread_once(&index_once, index_build);
+
+    if (len == 0 || len > CW_MORSE_MAX_LEN) {
+        return NULL;
+    }
+
+    cw_characters_t *character = by_code[(1 << len) | bits];
+
+    return character ? character->character : NULL;
 }
 
-static void cw_decoder_dict() {
-    cw_characters_t *character = &cw_characters[0];
+uint8_t cw_morse_encode(const char *text, const char **morse) {
+    cw_characters_t *character = NULL;
+    uint8_t         c = toupper((uint8_t)text[0]);
 
-    while (character->morse) {
-        if (strcmp(elements, character->morse) == 0) {
-            cw_decoder_ans(character->character);
-            return;
-        }
+    pthread_once(&index_once, index_build);
 
-        character++;
+    if (c == '<' && isalpha((uint8_t)text[1]) && isalpha((uint8_t)text[2])) {
+        character = by_prosign[toupper((uint8_t)text[1]) - 'A'][toupper((uint8_t)text[2]) - 'A'];
+
+        if (character && strncasecmp(character->character, text, strlen(character->character)) != 0) {
+            character = NULL;
+        }
+    }
+    if (!character && c < 128) {
+        character = by_char[c];
     }
+    if (!character) {
+        return 0;
+    }
+    *morse = character->morse;
+    return strlen(character->character);
+}
+
+static void pannel_text(void *user, const char *text) {
+    pannel_add_text(text);
+}
+
+void cw_decoder_init() {
+    cw_decoder_reset(&decoder, pannel_text, NULL);
+}
+
+void cw_decoder_reset(cw_decoder_t *d, cw_decoder_text_cb_t text_cb, void *user) {
+    memset(d, 0, sizeof(*d));
+
+    d->debounce_factor = 15;
+    d->thr_mean = 139;
+    d->word_space_timing = 3.0f;
+    d->compare_factor = 2.0f;
+    d->text_cb = text_cb;
+    d->user = user;
 
-    cw_decoder_ans("<?>");
+    pthread_once(&index_once, index_build);
 }
 
-static void cw_decoder_calc_wpm() {
-    wpm_old = wpm;
-    wpm = (6000 * 1.06) / (long_event_avr + short_event_avr + space_event_avr);
+uint32_t cw_decoder_get_wpm(const cw_decoder_t *d) {
+    return d->wpm;
+}
 
-    if (wpm != wpm_old) {
-        cw_decoder_wpm(wpm);
+static void cw_decoder_ans(cw_decoder_t *d, const char *ans) {
+    if (d->text_cb) {
+        d->text_cb(d->user, ans);
     }
 }
 
-static void cw_decoder_dot_dash(uint16_t short_event, uint16_t long_event) {
+static void cw_decoder_dict(cw_decoder_t *d) {
+    const char *character = cw_morse_decode(d->code, d->code_len);
+
+    cw_decoder_ans(d, character ? character : "<?>");
+}
+
+static void cw_decoder_calc_wpm(cw_decoder_t *d) {
+    d->wpm = (6000 * 1.06) / (d->long_event_avr + d->short_event_avr + d->space_event_avr);
+}
+
+static void cw_decoder_dot_dash(cw_decoder_t *d, uint16_t short_event, uint16_t long_event) {
     /* Find out which one is the Dot and which is the Dash and roll them into a moving average of each */
 
-    long_event_hist[event_hist_index] = long_event;
-    short_event_hist[event_hist_index] = short_event;
+    d->long_event_hist[d->event_hist_index] = long_event;
+    d->short_event_hist[d->event_hist_index] = short_event;
 
     /* Keep a moving average of the intra-element space duration */
 
-    space_event_hist[event_hist_index] = space_duration_prev;
+    d->space_event_hist[d->event_hist_index] = d->space_duration_prev;
 
     /* Keep a moving averages */
 
-    long_event_avr = 0;
-    short_event_avr = 0;
-    space_event_avr = 0;
+    d->long_event_avr = 0;
+    d->short_event_avr = 0;
+    d->space_event_avr = 0;
 
-    for (uint8_t i = 0; i < HIST_SIZE; i++) {
-        long_event_avr += long_event_hist[i];
-        short_event_avr += short_event_hist[i];
-        space_event_avr += space_event_hist[i];
+    for (uint8_t i = 0; i < CW_DECODER_HIST_SIZE; i++) {
+        d->long_event_avr += d->long_event_hist[i];
+        d->short_event_avr += d->short_event_hist[i];
+        d->space_event_avr += d->space_event_hist[i];
     }
 
-    long_event_avr /= HIST_SIZE;
-    short_event_avr /= HIST_SIZE;
-    space_event_avr /= HIST_SIZE;
+    d->long_event_avr /= CW_DECODER_HIST_SIZE;
+    d->short_event_avr /= CW_DECODER_HIST_SIZE;
+    d->space_event_avr /= CW_DECODER_HIST_SIZE;
 
     /* Find threshold mean */
 
-    thr_mean = sqrt(short_event_avr * long_event_avr);
+    d->thr_mean = sqrt(d->short_event_avr * d->long_event_avr);
 
     /* Bootstrap threshold values - - - If any are below or above known Dot/Dash pair ranges then move them instantly */
 
-    if (thr_mean < short_event_hist[event_hist_index] || thr_mean > long_event_hist[event_hist_index]) {
-        thr_mean = sqrt(short_event_hist[event_hist_index] * long_event_hist[event_hist_index]);
+    if (d->thr_mean < d->short_event_hist[d->event_hist_index] || d->thr_mean > d->long_event_hist[d->event_hist_index]) {
+        d->thr_mean = sqrt(d->short_event_hist[d->event_hist_index] * d->long_event_hist[d->event_hist_index]);
 
-        long_event_avr = long_event_hist[event_hist_index];
-        short_event_avr = short_event_hist[event_hist_index];
+        d->long_event_avr = d->long_event_hist[d->event_hist_index];
+        d->short_event_avr = d->short_event_hist[d->event_hist_index];
 
-        for (uint8_t i = 0; i < HIST_SIZE; i++) {
-            long_event_hist[i] = long_event_avr;
-            short_event_hist[i] = short_event_avr;
+        for (uint8_t i = 0; i < CW_DECODER_HIST_SIZE; i++) {
+            d->long_event_hist[i] = d->long_event_avr;
+            d->short_event_hist[i] = d->short_event_avr;
         }
     }
 
-    event_hist_index++;
+    d->event_hist_index++;
 
-    if (event_hist_index > HIST_SIZE - 1)
-        event_hist_index = 0;
+    if (d->event_hist_index > CW_DECODER_HIST_SIZE - 1)
+        d->event_hist_index = 0;
 
-    cw_decoder_calc_wpm();
+    cw_decoder_calc_wpm(d);
 }
 
 
-static void cw_decoder_inner_space() {
-    space_duration_prev = space_duration;
-    space_duration = time_track - space_duration_ref;
+static void cw_decoder_inner_space(cw_decoder_t *d) {
+    d->space_duration_prev = d->space_duration;
+    d->space_duration = d->time_track - d->space_duration_ref;
 
     /* DECODE collected string of elements */
 
     /* check to see if inter-element space duration threshold has been exceeded - then decode   */
     /* it is assumed that the intra-space is longer than a Dot but shorter than a Dash          */
 
-    if (space_duration >= thr_mean) {
-        space_duration_ref = time_track;
+    if (d->space_duration >= d->thr_mean) {
+        d->space_duration_ref = d->time_track;
 
-        if (character_step) {
-            cw_decoder_dict();
-            strcpy(elements, "");
+        if (d->character_step) {
+            cw_decoder_dict(d);
+            d->code = 0;
+            d->code_len = 0;
 
-            character_step = false;
+            d->character_step = false;
         }
     }
 }
 
-static void cw_decoder_word_space() {
-    word_space_duration = time_track - word_space_duration_ref;
+static void cw_decoder_word_space(cw_decoder_t *d) {
+    d->word_space_duration = d->time_track - d->word_space_duration_ref;
 
-    if (word_space_duration >= thr_mean * word_space_timing) {
-        word_space_duration_ref = time_track;
+    if (d->word_space_duration >= d->thr_mean * d->word_space_timing) {
+        d->word_space_duration_ref = d->time_track;
 
-        if (word_step) {
-            cw_decoder_ans(" ");
-            word_step = false;
+        if (d->word_step) {
+            cw_decoder_ans(d, " ");
+            d->word_step = false;
         }
     }
 }
 
 void cw_decoder_signal(bool on, float ms) {
-    time_track += (ms + 0.5f);
+    cw_decoder_put(&decoder, on, ms);
+}
+
+void cw_decoder_put(cw_decoder_t *d, bool on, float ms) {
+    d->time_track += (ms + 0.5f);
 
     /* Key down */
 
     if (on) {
-        if (!key_line) {
-            key_line_ref = time_track;
-            word_space_duration_ref = time_track;
+        if (!d->key_line) {
+            d->key_line_ref = d->time_track;
+            d->word_space_duration_ref = d->time_track;
 
-            key_line = true;
+            d->key_line = true;
         }
     }
 
     /* Key up */
 
     if (!on) {
-        if (time_track - key_line_ref < debounce_factor) {
-            key_line = false;
+        if (d->time_track - d->key_line_ref < d->debounce_factor) {
+            d->key_line = false;
             return;
         }
 
-        if (key_line) {
-            key_line = false;
-            key_line_event_prev = key_line_event_new;
-            key_line_event_new = time_track - key_line_ref;
+        if (d->key_line) {
+            d->key_line = false;
+            d->key_line_event_prev = d->key_line_event_new;
+            d->key_line_event_new = d->time_track - d->key_line_ref;
 
             /* If the Current Duration Event Compared to the Previous Event appears to be a Dot / Dash pair [ roughly (>2):1 ] */
 
-            if (key_line_event_new >= key_line_event_prev * compare_factor && space_duration_prev <= key_line_event_prev * compare_factor) {
-                cw_decoder_dot_dash(key_line_event_new, key_line_event_prev);
-            } else if (key_line_event_prev >= key_line_event_new * compare_factor && space_duration_prev <= key_line_event_new * compare_factor) {
-                cw_decoder_dot_dash(key_line_event_prev, key_line_event_new);
+            if (d->key_line_event_new >= d->key_line_event_prev * d->compare_factor && d->space_duration_prev <= d->key_line_event_prev * d->compare_factor) {
+                cw_decoder_dot_dash(d, d->key_line_event_new, d->key_line_event_prev);
+            } else if (d->key_line_event_prev >= d->key_line_event_new * d->compare_factor && d->space_duration_prev <= d->key_line_event_new * d->compare_factor) {
+                cw_decoder_dot_dash(d, d->key_line_event_prev, d->key_line_event_new);
             }
 
             /* Reset space durations */
 
-            space_duration_ref = time_track;
-            word_space_duration_ref = time_track;
+            d->space_duration_ref = d->time_track;
+            d->word_space_duration_ref = d->time_track;
 
             /* Classify and add most likely Dots or Dashes to a string for eventual character decoding */
 
-            if (key_line_event_new <= thr_mean) {
-                strcat(elements, ".");
-            } else {
-                strcat(elements, "-");
+            if (d->code_len <= CW_MORSE_MAX_LEN) {
+                d->code = (d->code << 1) | (d->key_line_event_new > d->thr_mean);
+                d->code_len++;
             }
 
-            character_step = true;
-            word_step = true;
+            d->character_step = true;
+            d->word_step = true;
         }
 
-        cw_decoder_inner_space();
-        cw_decoder_word_space();
+        cw_decoder_inner_space(d);
+        cw_decoder_word_space(d);
     }
 }
-
@@ -9,13 +9,78 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#define CW_DECODER_HIST_SIZE    10
+#define CW_MORSE_MAX_LEN        9       // Elements of the longest code
 
 typedef struct {
     char    *morse;
     char    *character;
 } cw_characters_t;
 
+typedef void (*cw_decoder_text_cb_t)(void *user, const char *text);
+
+/* Key timing state machine, one per decoded signal */
+typedef struct {
+    uint32_t    debounce_factor;
+    uint32_t    thr_mean;
+    uint32_t    time_track;
+
+    int32_t     key_line_event_prev;
+    int32_t     key_line_event_new;
+    uint32_t    key_line_ref;
+
+    uint32_t    event_hist_index;
+    uint32_t    short_event_hist[CW_DECODER_HIST_SIZE];
+    uint32_t    long_event_hist[CW_DECODER_HIST_SIZE];
+    uint32_t    space_event_hist[CW_DECODER_HIST_SIZE];
+
+    uint64_t    long_event_avr;
+    uint64_t    short_event_avr;
+    uint64_t    space_event_avr;
+
+    uint32_t    wpm;
+
+    uint32_t    space_duration;
+    uint32_t    space_duration_prev;
+    uint32_t    space_duration_ref;
+
+    uint32_t    word_space_duration;
+    uint32_t    word_space_duration_ref;
+    float       word_space_timing;
+
+    bool        key_line;
+    float       compare_factor;
+    bool        character_step;
+    bool        word_step;
+    uint16_t    code;                   // Elements of the character, 1 - dash
+    uint8_t     code_len;               // Above CW_MORSE_MAX_LEN - unknown code
+
+    cw_decoder_text_cb_t    text_cb;
+    void                    *user;
+} cw_decoder_t;
+
 extern cw_characters_t cw_characters[];
 
+/* Decoder of the audio CW, text goes to the pannel */
 void cw_decoder_init();
 void cw_decoder_signal(bool on, float ms);
+
+/**
+ * Reset decoder state, decoded characters and word spaces go to text_cb
+ */
+void cw_decoder_reset(cw_decoder_t *d, cw_decoder_text_cb_t text_cb, void *user);
+void cw_decoder_put(cw_decoder_t *d, bool on, float ms);
+uint32_t cw_decoder_get_wpm(const cw_decoder_t *d);
+
+/**
+ * Character of len elements, first one in the high bit of bits (1 - dash). NULL for unknown code
+ */
+const char * cw_morse_decode(uint16_t bits, uint8_t len);
+
+/**
+ * Morse of the character or the prosign (like "<AR>") at the start of text, case insensitive.
+ * Returns length of the matched text, 0 if it is unknown
+ */
+uint8_t cw_morse_encode(const char *text, const char **morse);
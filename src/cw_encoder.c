@@ -13,6 +13,7 @@
 #include "radio.h"
 #include "msg.h"
 #include "buttons.h"
+#include "util.h"
 
 #include "lvgl/lvgl.h"
 #include <unistd.h>
@@ -20,48 +21,78 @@
 #include <string.h>
 #include <pthread.h>
 #include <sched.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
 
 
+#define NSEC_PER_SEC    1000000000LL
+
 static cw_encoder_state_t   state = CW_ENCODER_IDLE;
 static pthread_t            thread;
 
 static char                 *current_msg = NULL;
 static char                 *current_char = NULL;
 
-static uint8_t get_morse(char *str, char **morse) {
-    cw_characters_t *character = &cw_characters[0];
+/* Key edges are at absolute deadlines, so late wakeups don't add up */
+static struct timespec      deadline;
+static int64_t              dit_nsec;
 
-    while (character->morse) {
-        uint8_t char_len = strlen(character->character);
+/* Lateness of the edges to their deadlines, of the current message */
+static atomic_uint          jitter_edges;
+static atomic_uint          jitter_sum_us;
+static atomic_uint          jitter_max_us;
 
-        if (strncasecmp(character->character, str, char_len) == 0) {
-            *morse = character->morse;
+static int64_t ts_diff_nsec(const struct timespec *a, const struct timespec *b) {
+    return (int64_t)(a->tv_sec - b->tv_sec) * NSEC_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
 
-            return char_len;
-        }
+static void deadline_reset() {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+}
+
+/**
+ * Wait for the next edge `nsec` after the previous one
+ */
+static void wait_edge(int64_t nsec) {
+    struct timespec now;
+
+    deadline.tv_nsec += nsec;
+    while (deadline.tv_nsec >= NSEC_PER_SEC) {
+        deadline.tv_nsec -= NSEC_PER_SEC;
+        deadline.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t     late = ts_diff_nsec(&now, &deadline);
+    uint32_t    late_us = late > 0 ? late / 1000 : 0;
 
-        character++;
+    atomic_fetch_add(&jitter_edges, 1);
+    atomic_fetch_add(&jitter_sum_us, late_us);
+    if (late_us > atomic_load(&jitter_max_us)) {
+        atomic_store(&jitter_max_us, late_us);
     }
 
-    return 0;
+    /* Stalled for longer than an element, the rest is not squeezed to catch up */
+    if (late > dit_nsec) {
+        deadline = now;
+    }
 }
 
-static void send_morse(char *str, time_t dit_nsec, time_t dah_nsec) {
-    struct timespec t;
-    t.tv_sec = 0;
+static void send_morse(const char *str, int64_t dah_nsec) {
     while (*str) {
         switch (*str) {
             case '.':
-                t.tv_nsec = dit_nsec;
                 radio_set_morse_key(true);
-                nanosleep(&t, NULL);
+                wait_edge(dit_nsec);
                 radio_set_morse_key(false);
                 break;
 
             case '-':
-                t.tv_nsec = dah_nsec;
                 radio_set_morse_key(true);
-                nanosleep(&t, NULL);
+                wait_edge(dah_nsec);
                 radio_set_morse_key(false);
                 break;
 
@@ -69,62 +100,62 @@ static void send_morse(char *str, time_t dit_nsec, time_t dah_nsec) {
                 break;
         }
         str++;
-        t.tv_nsec = dit_nsec;
-        nanosleep(&t, NULL);
+        wait_edge(dit_nsec);
     }
-    t.tv_nsec = dah_nsec - dit_nsec;
-    nanosleep(&t, NULL);
+    wait_edge(dah_nsec - dit_nsec);
 }
 
 static void * endecode_thread(void *arg) {
+    set_thread_name("cw_encoder");
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
+    dit_nsec = 20000000LL / (subject_get_int(cfg.key_speed.val)) * 60;
 
-    time_t dit_nsec = 20000000L / (subject_get_int(cfg.key_speed.val)) * 60;
-    time_t dah_nsec = dit_nsec * subject_get_float(cfg.key_ratio.val);
-    time_t world_space_nsec = dit_nsec * 7;
-
-    struct timespec t;
+    int64_t dah_nsec = dit_nsec * subject_get_float(cfg.key_ratio.val);
+    int64_t world_space_nsec = dit_nsec * 7;
 
-    t.tv_sec = 0;
+    deadline_reset();
 
     while (true) {
-        char    *morse;
+        const char *morse;
         uint8_t len;
 
         if (*current_char == ' ') {
             current_char++;
-            t.tv_nsec = world_space_nsec - dah_nsec;
-            nanosleep(&t, NULL);
+            wait_edge(world_space_nsec - dah_nsec);
         } else {
-            len = get_morse(current_char, &morse);
+            len = cw_morse_encode(current_char, &morse);
             if (len) {
-                send_morse(morse, dit_nsec, dah_nsec);
+                send_morse(morse, dah_nsec);
                 current_char += len;
             } else {
                 current_char++;
-                t.tv_nsec = world_space_nsec - dah_nsec;
-                nanosleep(&t, NULL);
+                wait_edge(world_space_nsec - dah_nsec);
             }
         }
         if (*current_char == 0) {
+            cw_encoder_jitter_t jitter = cw_encoder_get_jitter();
+
             if (state == CW_ENCODER_SEND) {
                 state = CW_ENCODER_IDLE;
 
+                msg_update_text_fmt("Keying jitter: avg %u us, max %u us", jitter.avg_us, jitter.max_us);
                 buttons_unload_page();
                 buttons_load_page(&buttons_page_msg_cw_1);
                 break;
             } else {
                 state = CW_ENCODER_BEACON_IDLE;
-                msg_update_text_fmt("Beacon pause: %i s", params.cw_encoder_period);
+                msg_update_text_fmt("Beacon pause: %i s, jitter max %u us", params.cw_encoder_period, jitter.max_us);
                 sleep(params.cw_encoder_period);
 
                 state = CW_ENCODER_BEACON;
                 current_char = current_msg;
+                deadline_reset();
             }
         }
     }
+    return NULL;
 }
 
 void cw_encoder_stop() {
@@ -146,19 +177,26 @@ void cw_encoder_send(const char *text, bool beacon) {
 
     current_msg = strdup(text);
     current_char = current_msg;
-    state = beacon ? CW_ENCODER_BEACON : CW_ENCODER_SEND;
 
-    int rc;
-    pthread_attr_t attr;
-    struct sched_param param;
-    rc = pthread_attr_init (&attr);
-    rc = pthread_attr_getschedparam (&attr, &param);
-    param.sched_priority += 5;
-    rc = pthread_attr_setschedparam (&attr, &param);
+    atomic_store(&jitter_edges, 0);
+    atomic_store(&jitter_sum_us, 0);
+    atomic_store(&jitter_max_us, 0);
+    state = beacon ? CW_ENCODER_BEACON : CW_ENCODER_SEND;
 
-    pthread_create(&thread, &attr, endecode_thread, NULL);
+    pthread_create(&thread, NULL, endecode_thread, NULL);
 }
 
 cw_encoder_state_t cw_encoder_state() {
     return state;
 }
+
+cw_encoder_jitter_t cw_encoder_get_jitter() {
+    cw_encoder_jitter_t jitter;
+    uint32_t            edges = atomic_load(&jitter_edges);
+
+    jitter.edges = edges;
+    jitter.avg_us = edges ? atomic_load(&jitter_sum_us) / edges : 0;
+    jitter.max_us = atomic_load(&jitter_max_us);
+
+    return jitter;
+}
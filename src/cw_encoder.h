@@ -18,7 +18,15 @@ typedef enum {
     CW_ENCODER_BEACON_IDLE
 } cw_encoder_state_t;
 
+/* Lateness of the key edges to their deadlines, of the last message */
+typedef struct {
+    uint32_t    edges;
+    uint32_t    avg_us;
+    uint32_t    max_us;
+} cw_encoder_jitter_t;
+
 void cw_encoder_send(const char *text, bool beacon);
 void cw_encoder_stop();
 
 cw_encoder_state_t cw_encoder_state();
+cw_encoder_jitter_t cw_encoder_get_jitter();
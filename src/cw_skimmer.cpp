@@ -0,0 +1,447 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "cw_skimmer.h"
+
+#include "dsp.h"
+#include "util.h"
+#include "cfg/subjects.h"
+#include "dsp/cw_channel.h"
+
+#include <atomic>
+#include <cmath>
+
+extern "C" {
+    #include "lvgl/lvgl.h"
+    #include "cfg/cfg.h"
+    #include "cw_decoder.h"
+    #include "radio.h"
+    #include "ring.h"
+    #include "scheduler.h"
+    #include "signals.h"
+
+    #include <ctype.h>
+    #include <pthread.h>
+    #include <semaphore.h>
+    #include <string.h>
+}
+
+#define FLOW_RATE           100000
+#define SKIMMER_THREADS     2
+#define RING_BLOCKS         32
+#define BATCH_BLOCKS        8                   // ~40 ms, channels are run per batch
+#define BATCH_SIZE          (BATCH_BLOCKS * RADIO_SAMPLES)
+#define MAX_KEYS            (BATCH_SIZE / (CW_CHANNEL_BOX * CW_CHANNEL_DECIM) + 1)
+
+#define DETECT_HITS         3                   // Rows with the signal, before a channel is started
+#define SAME_HZ             (1.5f * FLOW_RATE / WATERFALL_NFFT)
+#define EDGE_HZ             2000
+#define CHANNEL_IDLE_MS     10000               // Without the peak in the PSD
+#define SPOT_REPEAT_MS      (10 * 60 * 1000)
+#define WORD_SIZE           16
+
+typedef struct {
+    int32_t     retune;     // Applied before the samples
+    uint16_t    size;
+    cfloat      samples[RADIO_SAMPLES];
+} skimmer_block_t;
+
+typedef struct {
+    CwChannel       *dsp;
+    cw_decoder_t    decoder;
+    bool            active;
+    uint64_t        seen;       // Last row with the signal
+    uint16_t        signal;     // ID in the signals list
+
+    char            word[WORD_SIZE];
+    uint8_t         word_len;
+    bool            word_bad;
+    char            prev_word[WORD_SIZE];
+    char            last_call[WORD_SIZE];
+    char            spotted[WORD_SIZE];
+    uint64_t        spotted_time;
+} channel_t;
+
+static std::atomic<bool>    enabled{false};
+static bool                 ready = false;
+
+static ring_t               block_ring;
+static sem_t                data_sem;
+static pthread_t            thread;
+static int32_t              pending_retune = 0;     // DSP thread
+
+static cw_skimmer_spot_cb_t spot_cb = NULL;         // Main thread
+
+/* Skimmer thread */
+static channel_t            channels[CW_SKIMMER_CHANNELS];
+static signals_t            signals;
+static uint32_t             signals_version = 0;
+static cfloat               batch[BATCH_SIZE];
+static size_t               batch_size = 0;
+
+/*
+ * Channels of a batch are taken by the skimmer thread and the helpers from a
+ * shared atomic index, a channel and its decoder are used by one thread at a time
+ */
+static pthread_t            helpers[SKIMMER_THREADS - 1];
+static sem_t                job_sem;
+static sem_t                done_sem;
+static channel_t            *job_channels[CW_SKIMMER_CHANNELS];
+static int                  job_size;
+static std::atomic<int>     job_next;
+
+static void *skimmer_thread(void *arg);
+static void *helper_thread(void *arg);
+static void on_enabled_change(Subject *subj, void *user_data);
+
+void cw_skimmer_init() {
+    for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+        channels[i].dsp = new CwChannel(FLOW_RATE);
+    }
+
+    block_ring = ring_create(sizeof(skimmer_block_t), RING_BLOCKS);
+    sem_init(&data_sem, 0, 0);
+    sem_init(&job_sem, 0, 0);
+    sem_init(&done_sem, 0, 0);
+
+    pthread_create(&thread, NULL, skimmer_thread, NULL);
+    pthread_detach(thread);
+
+    for (int i = 0; i < SKIMMER_THREADS - 1; i++) {
+        pthread_create(&helpers[i], NULL, helper_thread, NULL);
+        pthread_detach(helpers[i]);
+    }
+    cfg.cw_skimmer.val->subscribe(on_enabled_change)->notify();
+    ready = true;
+}
+
+void cw_skimmer_set_spot_cb(cw_skimmer_spot_cb_t cb) {
+    spot_cb = cb;
+}
+
+void cw_skimmer_put_samples(const cfloat *samples, uint16_t size) {
+    if (!ready || !enabled) {
+        return;
+    }
+
+    skimmer_block_t *block = (skimmer_block_t *)ring_reserve(block_ring);
+
+    if (!block) {
+        return;
+    }
+    if (size > RADIO_SAMPLES) {
+        size = RADIO_SAMPLES;
+    }
+    block->retune = pending_retune;
+    block->size = size;
+    memcpy(block->samples, samples, size * sizeof(cfloat));
+    ring_commit(block_ring);
+    pending_retune = 0;
+    sem_post(&data_sem);
+}
+
+void cw_skimmer_retune(int32_t diff) {
+    if (enabled) {
+        pending_retune += diff;
+    }
+}
+
+/* Spots */
+
+static void spot_run(void *arg) {
+    cw_spot_t spot = *(cw_spot_t *)arg;
+
+    spot.freq += subject_get_int(cfg_cur.fg_freq);
+    LV_LOG_USER("CW spot %s %d Hz %u WPM %d dB", spot.callsign, spot.freq, spot.wpm, spot.snr);
+
+    if (spot_cb) {
+        spot_cb(&spot);
+    }
+}
+
+/**
+ * Prefix of two letters, a letter and a digit or a digit and a letter, or of one letter,
+ * then a digit and 1-4 letters. Portable parts are skipped, the longest part is checked
+ */
+static bool is_callsign(const char *word) {
+    char        base[WORD_SIZE] = "";
+    const char  *part = word;
+
+    while (*part) {
+        size_t len = strcspn(part, "/");
+
+        if (len > strlen(base) && len < sizeof(base)) {
+            strncpy(base, part, len);
+            base[len] = '\0';
+        }
+        part += len;
+        if (*part == '/') {
+            part++;
+        }
+    }
+
+    size_t len = strlen(base);
+    size_t s = len;
+
+    if (len < 3) {
+        return false;
+    }
+    while (s > 0 && isalpha(base[s - 1])) {
+        s--;
+    }
+
+    size_t suffix = len - s;
+
+    if (suffix < 1 || suffix > 4 || s == 0 || !isdigit(base[s - 1])) {
+        return false;
+    }
+    switch (s - 1) {
+        case 1:
+            return isalpha(base[0]);
+        case 2:
+            return isalpha(base[0]) || isalpha(base[1]);
+        default:
+            return false;
+    }
+}
+
+static void spot(channel_t *ch, const char *callsign) {
+    uint64_t now = get_time();
+
+    if (strcmp(ch->spotted, callsign) == 0 && now - ch->spotted_time < SPOT_REPEAT_MS) {
+        return;
+    }
+    strcpy(ch->spotted, callsign);
+    ch->spotted_time = now;
+
+    cw_spot_t spot;
+
+    spot.freq = lroundf(ch->dsp->get_freq());
+    strcpy(spot.callsign, callsign);
+    spot.wpm = cw_decoder_get_wpm(&ch->decoder);
+    spot.snr = lroundf(ch->dsp->get_snr());
+    scheduler_put_prio(SCHEDULER_PRIO_BULK, spot_run, &spot, sizeof(spot));
+}
+
+static void word_end(channel_t *ch) {
+    ch->word[ch->word_len] = '\0';
+
+    if (ch->word_len && !ch->word_bad) {
+        if (is_callsign(ch->word)) {
+            bool announced = strcmp(ch->prev_word, "DE") == 0 || strcmp(ch->prev_word, "CQ") == 0;
+
+            if (announced || strcmp(ch->word, ch->last_call) == 0) {
+                spot(ch, ch->word);
+            }
+            strcpy(ch->last_call, ch->word);
+        }
+        strcpy(ch->prev_word, ch->word);
+    } else {
+        ch->prev_word[0] = '\0';
+    }
+    ch->word_len = 0;
+    ch->word_bad = false;
+}
+
+static void channel_text(void *user, const char *text) {
+    channel_t *ch = (channel_t *)user;
+
+    if (strcmp(text, " ") == 0) {
+        word_end(ch);
+    } else if (strcmp(text, "<CQ>") == 0) {
+        word_end(ch);
+        strcpy(ch->prev_word, "CQ");
+    } else if (text[0] == '<' || text[1] != '\0' || ch->word_len >= WORD_SIZE - 1) {
+        ch->word_bad = true;
+    } else {
+        ch->word[ch->word_len++] = text[0];
+    }
+}
+
+/* Channels */
+
+static void channel_start(float freq, uint16_t signal, uint64_t now) {
+    for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+        channel_t *ch = &channels[i];
+
+        if (!ch->active) {
+            ch->dsp->reset(freq);
+            cw_decoder_reset(&ch->decoder, channel_text, ch);
+            ch->word_len = 0;
+            ch->word_bad = false;
+            ch->prev_word[0] = '\0';
+            ch->last_call[0] = '\0';
+            ch->spotted[0] = '\0';
+            ch->seen = now;
+            ch->signal = signal;
+            ch->active = true;
+            LV_LOG_INFO("CW skimmer channel %d on %.0f Hz", i, freq);
+            return;
+        }
+    }
+}
+
+static void channels_clear() {
+    for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+        channels[i].active = false;
+    }
+    batch_size = 0;
+}
+
+static void channels_retune(int32_t diff) {
+    const float max_freq = FLOW_RATE / 2 - EDGE_HZ;
+
+    for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+        channel_t *ch = &channels[i];
+
+        if (ch->active) {
+            ch->dsp->shift(-diff);
+            if (fabsf(ch->dsp->get_freq()) > max_freq) {
+                ch->active = false;
+            }
+        }
+    }
+}
+
+/**
+ * Narrow signals of the shared list get a channel, when seen for a few rows
+ */
+static void detect(const signals_t *list) {
+    uint64_t    now = get_time();
+    const float max_freq = FLOW_RATE / 2 - EDGE_HZ;
+
+    for (uint16_t n = 0; n < list->count; n++) {
+        const signal_peak_t *p = &list->peaks[n];
+        bool                known = false;
+
+        if (!p->narrow || fabsf(p->freq) > max_freq) {
+            continue;
+        }
+        for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+            channel_t *ch = &channels[i];
+
+            if (ch->active && (ch->signal == p->id || fabsf(ch->dsp->get_freq() - p->freq) < SAME_HZ)) {
+                ch->signal = p->id;
+                ch->seen = now;
+                known = true;
+                break;
+            }
+        }
+        if (!known && p->hits >= DETECT_HITS) {
+            channel_start(p->freq, p->id, now);
+        }
+    }
+    for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+        channel_t *ch = &channels[i];
+
+        if (ch->active && now - ch->seen > CHANNEL_IDLE_MS) {
+            ch->active = false;
+            LV_LOG_INFO("CW skimmer channel %d is idle", i);
+        }
+    }
+}
+
+/* Batch processing */
+
+static void run_job() {
+    bool keys[MAX_KEYS];
+    int  i;
+
+    while ((i = job_next.fetch_add(1)) < job_size) {
+        channel_t *ch = job_channels[i];
+        size_t    n = ch->dsp->execute(batch, batch_size, keys);
+        float     ms = ch->dsp->get_key_ms();
+
+        for (size_t k = 0; k < n; k++) {
+            cw_decoder_put(&ch->decoder, keys[k], ms);
+        }
+    }
+}
+
+static void process_batch() {
+    if (!batch_size) {
+        return;
+    }
+    job_size = 0;
+
+    for (int i = 0; i < CW_SKIMMER_CHANNELS; i++) {
+        if (channels[i].active) {
+            job_channels[job_size++] = &channels[i];
+        }
+    }
+    job_next = 0;
+
+    int n_helpers = LV_MIN(SKIMMER_THREADS - 1, job_size - 1);
+
+    for (int i = 0; i < n_helpers; i++) {
+        sem_post(&job_sem);
+    }
+    run_job();
+
+    for (int i = 0; i < n_helpers; i++) {
+        sem_wait(&done_sem);
+    }
+    batch_size = 0;
+}
+
+static void *helper_thread(void *arg) {
+    set_thread_name("cw_skimmer");
+
+    while (true) {
+        sem_wait(&job_sem);
+        run_job();
+        sem_post(&done_sem);
+    }
+    return NULL;
+}
+
+static void *skimmer_thread(void *arg) {
+    skimmer_block_t *block;
+    bool            was_enabled = false;
+
+    set_thread_name("cw_skimmer");
+
+    while (true) {
+        sem_wait(&data_sem);
+
+        if (!enabled) {
+            ring_flush(block_ring);
+            if (was_enabled) {
+                channels_clear();
+                was_enabled = false;
+            }
+            continue;
+        }
+        was_enabled = true;
+
+        if (signals_read(&signals) != signals_version) {
+            signals_version = signals.version;
+            detect(&signals);
+        }
+
+        while ((block = (skimmer_block_t *)ring_peek(block_ring))) {
+            if (block->retune) {
+                process_batch();
+                channels_retune(block->retune);
+            }
+            memcpy(batch + batch_size, block->samples, block->size * sizeof(cfloat));
+            batch_size += block->size;
+            ring_release(block_ring);
+
+            if (batch_size + RADIO_SAMPLES > BATCH_SIZE) {
+                process_batch();
+            }
+        }
+    }
+    return NULL;
+}
+
+static void on_enabled_change(Subject *subj, void *user_data) {
+    enabled = subject_get_int(subj);
+    sem_post(&data_sem);
+}
@@ -0,0 +1,59 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "helpers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CW_SKIMMER_CHANNELS 16
+
+/*
+ * CW skimmer of the IQ flow. Narrow signals of the shared list (signals.h) get
+ * a channel each (NCO, decimation, envelope keying and a cw_decoder_t), channels are
+ * processed by a pool of threads. A decoded callsign becomes a spot, when it
+ * follows CQ or DE, or is decoded twice in a row on the channel.
+ *
+ * Enabled by cfg.cw_skimmer
+ */
+
+typedef struct {
+    int32_t     freq;           // Hz
+    char        callsign[16];
+    uint16_t    wpm;
+    int16_t     snr;            // dB
+} cw_spot_t;
+
+typedef void (*cw_skimmer_spot_cb_t)(const cw_spot_t *spot);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void cw_skimmer_init();
+
+/**
+ * Set receiver of spots, it is called on the main thread
+ */
+void cw_skimmer_set_spot_cb(cw_skimmer_spot_cb_t cb);
+
+/**
+ * RX IQ block (DC blocked), called by DSP thread
+ */
+void cw_skimmer_put_samples(const cfloat *samples, uint16_t size);
+
+/**
+ * Flow center moved by diff Hz, called by DSP thread
+ */
+void cw_skimmer_retune(int32_t diff);
+
+#ifdef __cplusplus
+}
+#endif
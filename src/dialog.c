@@ -13,9 +13,103 @@
 #include "keyboard.h"
 #include "events.h"
 #include "waterfall.h"
+#include "spectrum.h"
+#include "util.h"
+
+#include <string.h>
+
+#define CACHE_SIZE      4
+#define CACHE_BUDGET    (1024 * 1024)           /* Heap bytes of hidden dialogs */
+#define FLAG_ITEM       LV_OBJ_FLAG_USER_1      /* Keyboard group item of a hidden dialog */
+
+typedef struct {
+    dialog_t    *dialog;
+    size_t      size;
+} cached_t;
 
 static lv_obj_t     *obj;
 static dialog_t     *current_dialog = NULL;
+static size_t       current_size = 0;
+
+static cached_t     cache[CACHE_SIZE];          /* Recently closed first */
+static uint8_t      cache_count = 0;
+static size_t       cache_total = 0;
+
+static void items_hide(lv_obj_t *parent) {
+    uint32_t n = lv_obj_get_child_cnt(parent);
+
+    for (uint32_t i = 0; i < n; i++) {
+        lv_obj_t *child = lv_obj_get_child(parent, i);
+
+        if (lv_obj_get_group(child) == keyboard_group) {
+            lv_group_remove_obj(child);
+            lv_obj_add_flag(child, FLAG_ITEM);
+        }
+        items_hide(child);
+    }
+}
+
+static void items_show(lv_obj_t *parent) {
+    uint32_t n = lv_obj_get_child_cnt(parent);
+
+    for (uint32_t i = 0; i < n; i++) {
+        lv_obj_t *child = lv_obj_get_child(parent, i);
+
+        if (lv_obj_has_flag(child, FLAG_ITEM)) {
+            lv_obj_clear_flag(child, FLAG_ITEM);
+            lv_group_add_obj(keyboard_group, child);
+        }
+        lv_event_send(child, LV_EVENT_REFRESH, NULL);
+        items_show(child);
+    }
+}
+
+static void cache_drop(uint8_t n) {
+    dialog_t *dialog = cache[n].dialog;
+
+    cache_total -= cache[n].size;
+    cache_count--;
+    memmove(&cache[n], &cache[n + 1], (cache_count - n) * sizeof(cached_t));
+
+    if (dialog->destruct_cb) {
+        dialog->destruct_cb();
+    }
+
+    lv_obj_del(dialog->obj);
+    dialog->obj = NULL;
+}
+
+static bool cache_take(dialog_t *dialog) {
+    for (uint8_t i = 0; i < cache_count; i++) {
+        if (cache[i].dialog == dialog) {
+            current_size = cache[i].size;
+            cache_total -= cache[i].size;
+            cache_count--;
+            memmove(&cache[i], &cache[i + 1], (cache_count - i) * sizeof(cached_t));
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void cache_put(dialog_t *dialog, size_t size) {
+    if (cache_count == CACHE_SIZE) {
+        cache_drop(cache_count - 1);
+    }
+
+    memmove(&cache[1], &cache[0], cache_count * sizeof(cached_t));
+    cache[0].dialog = dialog;
+    cache[0].size = size;
+    cache_count++;
+    cache_total += size;
+
+    /* Least recently used are deleted first, the just closed one too if it alone is over budget */
+    while (cache_count > 0 && cache_total > CACHE_BUDGET) {
+        cache_drop(cache_count - 1);
+    }
+}
 
 void dialog_construct(dialog_t *dialog, lv_obj_t *parent) {
     if (dialog && !dialog->run) {
@@ -26,7 +120,27 @@ void dialog_construct(dialog_t *dialog, lv_obj_t *parent) {
         if (dialog->btn_page) {
             buttons_load_page(dialog->btn_page);
         }
-        dialog->construct_cb(parent);
+
+        if (dialog->cache && cache_take(dialog)) {
+            lv_obj_clear_flag(dialog->obj, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_move_foreground(dialog->obj);
+            lv_event_send(dialog->obj, LV_EVENT_REFRESH, NULL);
+            items_show(dialog->obj);
+        } else {
+            size_t heap = get_heap_used();
+
+            dialog->construct_cb(parent);
+
+            size_t used = get_heap_used();
+
+            current_size = used > heap ? used - heap : 0;
+        }
+
+        if (dialog->obj) {
+            lv_obj_update_layout(dialog->obj);
+            spectrum_set_occluder(&dialog->obj->coords);
+            waterfall_set_occluder(&dialog->obj->coords);
+        }
 
         dialog->run = true;
     }
@@ -37,14 +151,22 @@ void dialog_construct(dialog_t *dialog, lv_obj_t *parent) {
 void dialog_destruct() {
     if (current_dialog && current_dialog->run) {
         waterfall_refresh_reset();
+        spectrum_set_occluder(NULL);
+        waterfall_set_occluder(NULL);
         current_dialog->run = false;
 
-        if (current_dialog->destruct_cb) {
-            current_dialog->destruct_cb();
-        }
-
-        if (current_dialog->obj) {
-            lv_obj_del(current_dialog->obj);
+        if (current_dialog->cache && current_dialog->obj) {
+            items_hide(current_dialog->obj);
+            lv_obj_add_flag(current_dialog->obj, LV_OBJ_FLAG_HIDDEN);
+            cache_put(current_dialog, current_size);
+        } else {
+            if (current_dialog->destruct_cb) {
+                current_dialog->destruct_cb();
+            }
+
+            if (current_dialog->obj) {
+                lv_obj_del(current_dialog->obj);
+            }
         }
         buttons_unload_page();
         if (current_dialog->prev_page) {
@@ -31,8 +31,14 @@ typedef struct {
     buttons_page_t          *prev_page;
     lv_event_cb_t           key_cb;
     bool                    run;
+    bool                    cache;      /* Hide instead of delete on close, see dialog_construct */
 } dialog_t;
 
+/**
+ * Open the dialog. A cached dialog, closed recently, is shown again without construct_cb,
+ * its objects get LV_EVENT_REFRESH to reload values from params and subjects.
+ * destruct_cb of a cached dialog is called, when its objects are deleted
+ */
 void dialog_construct(dialog_t *dialog, lv_obj_t *parent);
 void dialog_destruct();
 
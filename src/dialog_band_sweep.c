@@ -0,0 +1,250 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "dialog_band_sweep.h"
+
+#include "band_sweep.h"
+#include "buttons.h"
+#include "cfg/cfg.h"
+#include "dialog.h"
+#include "keyboard.h"
+#include "radio.h"
+#include "styles.h"
+#include "util.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WIDTH           780
+#define HEIGHT          330
+#define NO_BAND_SPAN    2000000     /* Around the VFO freq outside of the bands */
+
+static lv_obj_t     *chart;
+static float        data[WIDTH];
+
+static void construct_cb(lv_obj_t *parent);
+static void destruct_cb();
+static void key_cb(lv_event_t * e);
+
+static void refresh_cb(button_item_t *item);
+
+static button_item_t btn_refresh = {
+    .type  = BTN_TEXT,
+    .label = "Refresh",
+    .press = refresh_cb,
+};
+
+static buttons_page_t btn_page = {
+    {
+     &btn_refresh,
+     }
+};
+
+static dialog_t             dialog = {
+    .run = false,
+    .construct_cb = construct_cb,
+    .destruct_cb = destruct_cb,
+    .audio_cb = NULL,
+    .btn_page = &btn_page,
+    .key_cb = key_cb
+};
+
+dialog_t                    *dialog_band_sweep = &dialog;
+
+/**
+ * Band of the VFO freq, the narrowest if they overlap
+ */
+static void find_range(uint32_t *from, uint32_t *to) {
+    uint32_t    freq = subject_get_int(cfg_cur.fg_freq);
+    int32_t     cap = 32;
+    band_info_t *bands = malloc(sizeof(band_info_t) * cap);
+    uint32_t    count = cfg_band_read_all_bands(&bands, &cap);
+
+    *from = 0;
+    *to = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        band_info_t *band = &bands[i];
+
+        if (freq >= band->start_freq && freq <= band->stop_freq &&
+            (*to == 0 || band->stop_freq - band->start_freq < *to - *from))
+        {
+            *from = band->start_freq;
+            *to = band->stop_freq;
+        }
+        free(band->name);
+    }
+    free(bands);
+
+    if (*to == 0) {
+        *from = freq > NO_BAND_SPAN / 2 ? freq - NO_BAND_SPAN / 2 : 0;
+        *to = freq + NO_BAND_SPAN / 2;
+    }
+}
+
+static void update_cb() {
+    lv_obj_invalidate(chart);
+}
+
+static lv_coord_t calc_y(float db, float min, float max) {
+    float x = (db - min) / (max - min);
+
+    return (1.0f - LV_CLAMP(0.0f, x, 1.0f)) * (HEIGHT - 1);
+}
+
+static void draw_cb(lv_event_t * e) {
+    lv_obj_t            *obj = lv_event_get_target(e);
+    lv_draw_ctx_t       *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_line_dsc_t  line_dsc;
+    lv_draw_label_dsc_t label_dsc;
+    band_sweep_info_t   info;
+    char                str[32];
+    lv_point_t          a, b;
+    lv_area_t           area;
+    lv_point_t          label_size;
+
+    band_sweep_get(data, WIDTH, &info);
+
+    if (info.tiles == 0) {
+        return;
+    }
+
+    lv_coord_t  x1 = obj->coords.x1;
+    lv_coord_t  y1 = obj->coords.y1;
+    float       min = subject_get_int(cfg_cur.band->grid.min.val);
+    float       max = subject_get_int(cfg_cur.band->grid.max.val);
+
+    lv_draw_line_dsc_init(&line_dsc);
+    lv_draw_label_dsc_init(&label_dsc);
+
+    label_dsc.color = lv_color_white();
+    label_dsc.font = &sony_28;
+
+    /* Freq grid, edges and middle */
+
+    line_dsc.color = lv_color_hex(0xAAAAAA);
+    line_dsc.width = 2;
+
+    a.y = y1;
+    b.y = y1 + HEIGHT;
+
+    for (int16_t i = 0; i <= 2; i++) {
+        uint32_t    freq = info.from + (uint64_t) (info.to - info.from) * i / 2;
+        uint16_t    mhz, khz, hz;
+
+        a.x = x1 + (WIDTH - 1) * i / 2;
+        b.x = a.x;
+        lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+
+        split_freq(freq, &mhz, &khz, &hz);
+        snprintf(str, sizeof(str), "%i.%03i", mhz, khz);
+        lv_txt_get_size(&label_size, str, label_dsc.font, 0, 0, LV_COORD_MAX, 0);
+
+        area.x1 = LV_CLAMP(x1, a.x - label_size.x / 2, x1 + WIDTH - label_size.x);
+        area.y1 = y1 + 4;
+        area.x2 = area.x1 + label_size.x;
+        area.y2 = area.y1 + label_size.y;
+
+        lv_draw_label(draw_ctx, &label_dsc, &area, str, NULL);
+    }
+
+    /* Stitched spectrum, gaps where no tile is captured yet */
+
+    line_dsc.color = lv_color_white();
+    line_dsc.width = 2;
+
+    for (uint16_t x = 1; x < WIDTH; x++) {
+        if (isnan(data[x - 1]) || isnan(data[x])) {
+            continue;
+        }
+        a.x = x1 + x - 1;
+        a.y = y1 + calc_y(data[x - 1], min, max);
+        b.x = x1 + x;
+        b.y = y1 + calc_y(data[x], min, max);
+
+        lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+    }
+
+    /* VFO */
+
+    uint32_t freq = subject_get_int(cfg_cur.fg_freq);
+
+    if (freq >= info.from && freq <= info.to) {
+        line_dsc.color = lv_color_hex(0xFF4040);
+        a.x = x1 + (int64_t) (freq - info.from) * (WIDTH - 1) / (info.to - info.from);
+        b.x = a.x;
+        a.y = y1;
+        b.y = y1 + HEIGHT;
+
+        lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+    }
+
+    snprintf(str, sizeof(str), "%u / %u", info.fresh, info.tiles);
+    lv_txt_get_size(&label_size, str, label_dsc.font, 0, 0, LV_COORD_MAX, 0);
+
+    area.x1 = x1 + WIDTH - label_size.x;
+    area.y1 = y1 + HEIGHT - label_size.y;
+    area.x2 = area.x1 + label_size.x;
+    area.y2 = area.y1 + label_size.y;
+
+    lv_draw_label(draw_ctx, &label_dsc, &area, str, NULL);
+}
+
+static void construct_cb(lv_obj_t *parent) {
+    uint32_t from, to;
+
+    dialog.obj = dialog_init(parent);
+
+    buttons_unload_page();
+    buttons_load_page(&btn_page);
+
+    chart = lv_obj_create(dialog.obj);
+
+    lv_obj_add_event_cb(chart, draw_cb, LV_EVENT_DRAW_MAIN_END, NULL);
+    lv_obj_set_size(chart, WIDTH, HEIGHT);
+    lv_obj_center(chart);
+
+    lv_obj_set_style_bg_opa(chart, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_set_style_border_width(chart, 0, LV_PART_MAIN);
+
+    lv_group_add_obj(keyboard_group, chart);
+    lv_obj_add_event_cb(chart, key_cb, LV_EVENT_KEY, NULL);
+
+    find_range(&from, &to);
+    band_sweep_start(from, to, update_cb);
+}
+
+static void destruct_cb() {
+    band_sweep_stop();
+}
+
+static void key_cb(lv_event_t * e) {
+    uint32_t key = *((uint32_t *)lv_event_get_param(e));
+
+    switch (key) {
+        case LV_KEY_ESC:
+            dialog_destruct(&dialog);
+            break;
+
+        case KEY_VOL_LEFT_EDIT:
+        case KEY_VOL_LEFT_SELECT:
+            radio_change_vol(-1);
+            break;
+
+        case KEY_VOL_RIGHT_EDIT:
+        case KEY_VOL_RIGHT_SELECT:
+            radio_change_vol(1);
+            break;
+    }
+}
+
+static void refresh_cb(button_item_t *item) {
+    band_sweep_refresh();
+    lv_obj_invalidate(chart);
+}
@@ -0,0 +1,14 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+#include "dialog.h"
+
+extern dialog_t *dialog_band_sweep;
@@ -18,6 +18,7 @@
 #include "cfg/digital_modes.h"
 #include "radio.h"
 #include "audio.h"
+#include "audio_graph.h"
 #include "keyboard.h"
 #include "events.h"
 #include "buttons.h"
@@ -31,12 +32,21 @@
 
 #include "widgets/lv_waterfall.h"
 #include "widgets/lv_finder.h"
+#include "widgets/lv_msg_list.h"
 
 #include <ft8lib/message.h>
 #include "ft8/worker.h"
 #include "adif.h"
 #include "qso_log.h"
+#include "contest.h"
 #include "scheduler.h"
+#include "governor.h"
+#include "metrics.h"
+#include "psk_reporter.h"
+#include "band_activity.h"
+#include "ring.h"
+#include "threads.h"
+#include "soak.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -46,13 +56,18 @@
 #include <time.h>
 #include <sys/time.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <errno.h>
 #include <ctype.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
-#define DECIM           6
-#define SAMPLE_RATE     (AUDIO_CAPTURE_RATE / DECIM)
+#define SAMPLE_RATE     12000
 
 #define WIDTH           771
+#define WF_DB_OFFSET    (-17.0f)    // Decoder spectrogram dB, noise and tones, to the -60..0 range
 
 #define UNKNOWN_SNR     99
 
@@ -62,9 +77,21 @@
 #define FT4_WIDTH_HZ    83
 
 #define MAX_TABLE_MSG   512
-#define CLEAN_N_ROWS    64
 
 #define MAX_TX_START_DELAY 1.5f
+#define TX_SIGNAL_FREQ     1325    // Hz, TX audio tone, radio is shifted to params.ft8_tx_freq
+#define TX_PART            (1024 * 2)
+#define DECODE_BUDGET      1.0f    // s, for the last decoding of slot. The rest of MAX_TX_START_DELAY is for the answer
+#define DUAL_DECODE_BUDGET 0.3f    // s, for the last decoding of the other protocol, after the main one
+#define DECODE_PASSES      3       // Of the last decoding, as many as fit the budget
+#define TICK_MS            100     // Audio processing period of decode_thread
+#define AUDIO_RING_BLOCKS  32      // Capture fragments between audio_cb and decode_thread, 3.2 s
+#define AUDIO_FRAGMENT_MAX (AUDIO_CAPTURE_FRAGMENT * SAMPLE_RATE / AUDIO_CAPTURE_RATE + 1)
+#define AUDIO_STALL_MS     (AUDIO_RATE_MS * 3)     // Gap between fragments, counted as underrun
+#define MONITOR_HISTORY    128     // Cells kept by the background monitor for the reopen
+#define MONITOR_CANDIDATES 50      // Decoding effort of the background monitor, single pass
+#define MONITOR_LDPC_ITERATIONS 10
+#define MONITOR_NICE       19
 
 #define WAIT_SYNC_TEXT "Wait sync"
 
@@ -75,6 +102,12 @@ typedef enum {
     TX_PROCESS,
 } ft8_state_t;
 
+typedef struct {
+    uint64_t        time;           // ms, of the capture
+    uint16_t        n;
+    float complex   samples[AUDIO_FRAGMENT_MAX];
+} audio_block_t;
+
 typedef enum {
     CELL_RX_INFO = 0,
     CELL_RX_MSG,
@@ -93,8 +126,10 @@ typedef struct {
     bool            odd;
     ftx_msg_meta_t  meta;
     char            text[64];
+    bool            dual;           // Of the other protocol, no TX
 
     qso_log_search_worked_t       worked_type;
+    bool                          new_mult;     // New contest multiplier
 } cell_data_t;
 
 
@@ -110,6 +145,11 @@ static bool                 tx_time_slot;
 
 static ftx_tx_msg_t         tx_msg;
 
+static int16_t              *tx_wave;                       // Rendered tx_wave_msg, ahead of the slot
+static uint32_t             tx_wave_max;
+static uint32_t             tx_wave_size;                   // 0 - not rendered
+static char                 tx_wave_msg[sizeof(tx_msg.msg)];
+
 static lv_obj_t             *table;
 
 static lv_timer_t           *timer = NULL;
@@ -119,23 +159,49 @@ static bool                 disable_buttons = false;
 
 static lv_obj_t             *finder;
 static lv_obj_t             *waterfall;
-static uint16_t             waterfall_nfft;
-static spgramcf             waterfall_sg;
-static float                *waterfall_psd;
+static float                waterfall_row[WIDTH];
 static uint8_t              waterfall_fps_ms = (1000 / 5);
 static uint64_t             waterfall_time;
 
-static pthread_mutex_t      audio_mutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Capture never waits for decoding: fragments go through a lock-free ring, decode_thread
+ * copies them out to audio_buf, which only it uses, and processes them without a lock
+ */
+static ring_t               audio_ring;
 static cbuffercf            audio_buf;
+static uint64_t             audio_last_time;                // Of the last fragment, 0 - after a pause of RX
+static uint32_t             audio_underruns;                // Capture stalls, of decode_thread
+static uint32_t             audio_drops;                    // Fragments without room in audio_buf
 static pthread_t            thread;
 
-static firdecim_crcf        decim;
-static float complex        *decim_buf;
+static audio_sink_t         *audio_sink;
 
 static adif_log             ft8_log;
 static FTxQsoProcessor         *qso_processor;
 
-static double               cur_lat, cur_lon;
+static ftx_decoder_t        *dual_decoder;                  // Of the other protocol on the same audio, NULL - off
+static FTxQsoProcessor      *dual_processor;                // Only for meta of dual_decoder messages
+static cbuffercf            dual_buf;                       // Decimated audio for dual_decoder blocks
+
+static qth_pos_t            cur_pos;
+
+static int                  edge_fd = -1;                   // Slot edge timer of decode_thread
+
+/*
+ * Background monitor. With cfg ft8_monitor the dialog is closed without stopping
+ * decode_thread: it goes on at a low priority and reduced effort, without TX,
+ * and the cells go to the history instead of the table. The radio is left on
+ * the FT8 frequency. On the reopen the history is put to the table and the full
+ * effort is back. The dialog objects are used by decode_thread under
+ * dialog_mutex, while not in the background
+ */
+static bool                 monitor_running = false;        // The dialog is closed, decode_thread runs
+static atomic_bool          background = false;
+static bool                 low_effort = false;             // Of decode_thread
+static pthread_mutex_t      dialog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cell_data_t          history[MONITOR_HISTORY];
+static uint16_t             history_head;
+static uint16_t             history_count;
 
 static int32_t  filter_low, filter_high;
 
@@ -146,7 +212,8 @@ static float base_gain_offset;
 static void construct_cb(lv_obj_t *parent);
 static void key_cb(lv_event_t * e);
 static void destruct_cb();
-static void audio_cb(unsigned int n, float complex *samples);
+static void audio_cb(const void *samples, size_t n, void *user);
+static bool audio_active(void *user);
 static void rotary_cb(int32_t diff);
 static void * decode_thread(void *arg);
 
@@ -158,6 +225,8 @@ static void tx_call_en_dis_cb(struct button_item_t *btn);
 static void hold_tx_freq_cb(struct button_item_t *btn);
 static void mode_auto_cb(struct button_item_t *btn);
 static void cq_modifier_cb(struct button_item_t *btn);
+static void dual_decode_cb(struct button_item_t *btn);
+static void monitor_cb(struct button_item_t *btn);
 static void load_page(struct button_item_t *btn);
 static void time_sync(struct button_item_t *btn);
 
@@ -172,176 +241,235 @@ static void keyboard_close();
 
 static void add_info(const char * fmt, ...);
 static void add_tx_text(const char * text);
+static void add_rx_cell(const char *text, const ftx_msg_meta_t *meta, bool odd, bool dual);
 static void make_cq_msg(const char *callsign, const char *qth, const char *cq_mod, char *text);
-static bool get_time_slot(struct timespec now, float *time_since_start);
+static bool get_time_slot(ftx_protocol_t protocol, struct timespec now, float *time_since_start);
+static bool tx_wave_prepare();
 
 // button label is current state, press action and name - next state
 
-static button_item_t button_page_1 = { .type=BTN_TEXT, .label = "(Page: 1:2)", .press = load_page};
+static button_item_t button_page_1 = { .type=BTN_TEXT, .label = "(Page: 1:3)", .press = load_page};
 static button_item_t button_show_cq_all = { .type=BTN_TEXT, .label = "Show:\nAll", .press = show_cq_all_cb };
 static button_item_t button_mode_ft4_ft8 = { .type=BTN_TEXT, .label = "Mode:\nFT8", .press = mode_ft4_ft8_cb };
 static button_item_t button_tx_cq_en_dis = { .type=BTN_TEXT, .label = "TX CQ:\nDisabled", .press = tx_cq_en_dis_cb };
 static button_item_t button_tx_call_en_dis = { .type=BTN_TEXT, .label = "TX Call:\nDisabled", .press = tx_call_en_dis_cb};
 
-static button_item_t button_page_2 = { .type=BTN_TEXT, .label = "(Page: 2:2)", .press = load_page};
+static button_item_t button_page_2 = { .type=BTN_TEXT, .label = "(Page: 2:3)", .press = load_page};
 static button_item_t button_hold_freq = { .type=BTN_TEXT, .label = "Hold Freq:\nEnabled", .press = hold_tx_freq_cb };
 static button_item_t button_auto_en_dis = { .type=BTN_TEXT, .label = "Auto:\nDisabled", .press = mode_auto_cb };
 static button_item_t button_cq_mod = { .type=BTN_TEXT, .label = "CQ\nModifier", .press = cq_modifier_cb };
 static button_item_t button_time_sync = { .type=BTN_TEXT, .label = "Time\nSync", .press = time_sync };
 
+static button_item_t button_page_3 = { .type=BTN_TEXT, .label = "(Page: 3:3)", .press = load_page};
+static button_item_t button_dual_decode = { .type=BTN_TEXT, .label = "Dual:\nDisabled", .press = dual_decode_cb };
+static button_item_t button_monitor = { .type=BTN_TEXT, .label = "Monitor:\nDisabled", .press = monitor_cb };
+
 static dialog_t dialog = {
     .run = false,
     .construct_cb = construct_cb,
     .destruct_cb = destruct_cb,
-    .audio_cb = audio_cb,
+    .audio_cb = NULL,
     .rotary_cb = rotary_cb,
     .key_cb = key_cb,
 };
 
 dialog_t *dialog_ft8 = &dialog;
 
+static ftx_protocol_t dual_protocol() {
+    return params.ft8_protocol == FTX_PROTOCOL_FT8 ? FTX_PROTOCOL_FT4 : FTX_PROTOCOL_FT8;
+}
+
+static qso_log_mode_t protocol_mode(ftx_protocol_t protocol) {
+    return protocol == FTX_PROTOCOL_FT8 ? MODE_FT8 : MODE_FT4;
+}
+
+static float slot_seconds(ftx_protocol_t protocol) {
+    return protocol == FTX_PROTOCOL_FT8 ? FT8_SLOT_TIME : FT4_SLOT_TIME;
+}
+
+static void skip_qso(const char *remote_callsign, const char *remote_grid, const int r_snr, const int s_snr) {
+}
+
 static void save_qso(const char *remote_callsign, const char *remote_grid, const int r_snr, const int s_snr) {
     time_t now = time(NULL);
 
-    char * canonized_call = util_canonize_callsign(remote_callsign, false);
+    char call[16];
+
+    util_strip_callsign_brackets(remote_callsign, call, sizeof(call));
     qso_log_record_t qso = qso_log_record_create(
         params.callsign.x,
-        canonized_call,
+        call,
         now, params.ft8_protocol == FTX_PROTOCOL_FT8 ? MODE_FT8 : MODE_FT4,
         s_snr, r_snr, subject_get_int(cfg_cur.fg_freq), NULL, NULL,
         params.qth.x, remote_grid
     );
-    free(canonized_call);
 
     adif_add_qso(ft8_log, qso);
 
-    // Save QSO to sqlite log
-    qso_log_record_save(qso);
+    if (contest_active()) {
+        uint8_t         res = contest_log_qso(&qso);
+        contest_score_t score;
+
+        contest_score(&score);
 
-    msg_schedule_text_fmt("QSO saved");
+        if (res & CONTEST_DUPE) {
+            msg_schedule_text_fmt("QSO saved (dupe): score %u", score.score);
+        } else {
+            msg_schedule_text_fmt("QSO saved: %u QSOs, %u mults, score %u",
+                                  score.qsos, score.grids + score.prefixes, score.score);
+        }
+    } else {
+        // Save QSO to sqlite log
+        qso_log_record_save(qso);
+
+        msg_schedule_text_fmt("QSO saved");
+    }
     lv_finder_clear_cursor(finder);
 }
 
+static bool is_dupe(const char *remote_callsign) {
+    uint64_t    freq = subject_get_int(cfg_cur.fg_freq);
+    uint8_t     res = contest_check(remote_callsign, NULL, qso_log_freq_to_band(freq), protocol_mode(params.ft8_protocol));
+
+    return res & CONTEST_DUPE;
+}
+
 static void worker_init() {
 
     /* ftx worker */
     qso_processor = ftx_qso_processor_init(params.callsign.x, params.qth.x, save_qso);
+    ftx_qso_processor_set_dupe_cb(qso_processor, is_dupe);
 
-    ftx_worker_init(SAMPLE_RATE, params.ft8_protocol);
-    int block_size = ftx_worker_get_block_size();
+    ftx_worker_init(SAMPLE_RATE, params.ft8_protocol, filter_low, filter_high);
+    ftx_worker_set_decode_budget(DECODE_BUDGET * 1000.0f);
+    ftx_worker_set_decode_passes(DECODE_PASSES);
 
-    decim_buf = (float complex *) malloc(block_size * sizeof(float complex));
+    tx_wave_max = ftx_worker_get_tx_size(AUDIO_PLAY_RATE);
+    tx_wave = (int16_t *) malloc(tx_wave_max * sizeof(int16_t));
+    tx_wave_size = 0;
 
-    /* Waterfall */
-    waterfall_nfft = (uint16_t)(WIDTH * SAMPLE_RATE / (filter_high - filter_low));
+    /* Other protocol decoder on the same audio */
+    if (subject_get_int(cfg.ft8_dual_decode.val)) {
+        dual_decoder = ftx_decoder_create(dual_protocol(), filter_low, filter_high);
+    }
+    if (dual_decoder) {
+        ftx_decoder_set_decode_budget(dual_decoder, DUAL_DECODE_BUDGET * 1000.0f);
+        ftx_decoder_set_decode_passes(dual_decoder, DECODE_PASSES);
+        dual_processor = ftx_qso_processor_init(params.callsign.x, params.qth.x, skip_qso);
+        ftx_qso_processor_set_auto(dual_processor, false);
+        dual_buf = cbuffercf_create(block_size + ftx_decoder_get_block_size(dual_decoder));
+    }
 
-    waterfall_sg = spgramcf_create(waterfall_nfft, LIQUID_WINDOW_HANN, waterfall_nfft, waterfall_nfft / 2);
-    waterfall_psd = (float *) malloc(waterfall_nfft * sizeof(float));
+    /* Waterfall */
     waterfall_time = get_time();
 
     /* Worker */
+    audio_last_time = 0;
+    edge_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+
+    if (edge_fd < 0) {
+        LV_LOG_ERROR("Slot timer: %s", strerror(errno));
+    }
+
     pthread_create(&thread, NULL, decode_thread, NULL);
+    governor_watch_thread("ft8", thread);
 }
 
 static void worker_done() {
     state = RX_PROCESS;
 
+    governor_unwatch_thread(thread);
     pthread_cancel(thread);
     pthread_join(thread, NULL);
     radio_set_modem(false);
-    pthread_mutex_unlock(&audio_mutex);
-    ftx_worker_free();
-    free(decim_buf);
 
-    spgramcf_destroy(waterfall_sg);
-    free(waterfall_psd);
+    if (edge_fd >= 0) {
+        close(edge_fd);
+        edge_fd = -1;
+    }
+    LV_LOG_USER("FT8 audio: %u overruns, %u underruns, %u drops",
+                ring_get_overruns(audio_ring), audio_underruns, audio_drops);
+
+    if (dual_decoder) {
+        ftx_decoder_free(dual_decoder);
+        dual_decoder = NULL;
+        ftx_qso_processor_delete(dual_processor);
+        cbuffercf_destroy(dual_buf);
+    }
+    ftx_worker_free();
+    free(tx_wave);
 
     ftx_qso_processor_delete(qso_processor);
     lv_finder_clear_cursor(finder);
     tx_msg.msg[0] = '\0';
 }
 
-void static waterfall_process(float complex *frame, const size_t size) {
-    uint64_t now = get_time();
-
-    spgramcf_write(waterfall_sg, frame, size);
-
-    if (now - waterfall_time > waterfall_fps_ms) {
-        uint32_t low_bin = waterfall_nfft / 2 + waterfall_nfft * filter_low / SAMPLE_RATE;
-        uint32_t high_bin = waterfall_nfft / 2 + waterfall_nfft * filter_high / SAMPLE_RATE;
-
-        spgramcf_get_psd(waterfall_sg, waterfall_psd);
-        // Normalize FFT
-        liquid_vectorf_addscalar(
-            &waterfall_psd[low_bin],
-            high_bin - low_bin,
-            -10.f * log10f(sqrtf(waterfall_nfft)),
-            &waterfall_psd[low_bin]);
-
-        lv_waterfall_add_data(waterfall, &waterfall_psd[low_bin], high_bin - low_bin);
+/**
+ * Decode thread, true if the dialog objects may be used till dialog_unlock()
+ */
+static bool dialog_lock(int *cancel_state) {
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, cancel_state);
+    pthread_mutex_lock(&dialog_mutex);
 
-        waterfall_time = now;
-        spgramcf_reset(waterfall_sg);
-    }
+    return !atomic_load(&background);
 }
 
-static void truncate_table() {
-    lv_coord_t     removed_rows_height = 0;
-    uint16_t       table_rows = lv_table_get_row_cnt(table);
-    if (table_rows > MAX_TABLE_MSG) {
-        LV_LOG_USER("Start");
+static void dialog_unlock(int cancel_state) {
+    pthread_mutex_unlock(&dialog_mutex);
+    pthread_setcancelstate(cancel_state, NULL);
+}
 
-        lv_table_t *table_obj = (lv_table_t*) table;
+/**
+ * Row of the decoder spectrogram, called after the block is put and before the decoder reset
+ */
+void static waterfall_process() {
+    uint64_t now = get_time();
 
-        for (size_t i = 0; i < CLEAN_N_ROWS; i++) {
-            removed_rows_height += table_obj->row_h[i];
-        }
+    if (now - waterfall_time > waterfall_fps_ms && ftx_worker_get_wf_row(waterfall_row, WIDTH)) {
+        int cancel_state;
 
-        if (table_obj->row_act > CLEAN_N_ROWS) {
-            table_obj->row_act -= CLEAN_N_ROWS;
-        } else {
-            table_obj->row_act = 0;
-        }
+        // Levels of the decoder spectrogram to the waterfall range
+        liquid_vectorf_addscalar(waterfall_row, WIDTH, WF_DB_OFFSET, waterfall_row);
 
-        for (uint16_t i = CLEAN_N_ROWS; i < table_rows; i++) {
-            cell_data_t *cell_data_copy = malloc(sizeof(cell_data_t));
-            lv_table_set_cell_value(table, i-CLEAN_N_ROWS, 0, lv_table_get_cell_value(table, i, 0));
-            *cell_data_copy = *(cell_data_t *) lv_table_get_cell_user_data(table, i, 0);
-            lv_table_set_cell_user_data(table, i-CLEAN_N_ROWS, 0, cell_data_copy);
+        if (dialog_lock(&cancel_state)) {
+            lv_waterfall_add_data(waterfall, waterfall_row, WIDTH);
         }
-        table_rows -= CLEAN_N_ROWS;
+        dialog_unlock(cancel_state);
 
-        lv_table_set_row_cnt(table, table_rows);
-        lv_obj_scroll_by_bounded(table, 0, removed_rows_height, LV_ANIM_OFF);
+        waterfall_time = now;
     }
 }
 
+static const char * cell_text_cb(const void *item) {
+    return ((const cell_data_t *) item)->text;
+}
+
 static void add_msg_cb(void *data) {
-    truncate_table();
-    uint16_t    row = 0;
-    uint16_t    col = 0;
-    bool        scroll;
-
-    lv_table_get_selected_cell(table, &row, &col);
-    uint16_t table_rows = lv_table_get_row_cnt(table);
-    if ((table_rows == 1) && strcmp(lv_table_get_cell_value(table, 0, 0), WAIT_SYNC_TEXT) == 0) {
-        table_rows--;
+    // Copied to the ring, original event data will be deleted
+    if (table) {
+        lv_msg_list_append(table, data);
     }
-    scroll = table_rows == (row + 1);
-
-    // Copy data, because original event data will be deleted
-    cell_data_t *cell_data = (cell_data_t*)data;
-    cell_data_t *cell_data_copy = malloc(sizeof(cell_data_t));
-    *cell_data_copy = *cell_data;
+}
 
-    lv_table_set_cell_value(table, table_rows, 0, cell_data_copy->text);
-    lv_table_set_cell_user_data(table, table_rows, 0, cell_data_copy);
+/**
+ * Add the cell to the table or to the history in the background.
+ * The oldest cells of the history are dropped
+ */
+static void put_cell(const cell_data_t *cell_data) {
+    int cancel_state;
 
-    if (scroll) {
-        static int32_t c = LV_KEY_DOWN;
+    if (dialog_lock(&cancel_state)) {
+        scheduler_put_prio(SCHEDULER_PRIO_BULK, add_msg_cb, (void *)cell_data, sizeof(cell_data_t));
+    } else {
+        history[(history_head + history_count) % MONITOR_HISTORY] = *cell_data;
 
-        lv_event_send(table, LV_EVENT_KEY, &c);
+        if (history_count < MONITOR_HISTORY) {
+            history_count++;
+        } else {
+            history_head = (history_head + 1) % MONITOR_HISTORY;
+        }
     }
+    dialog_unlock(cancel_state);
 }
 
 static void table_draw_part_begin_cb(lv_event_t * e) {
@@ -349,9 +477,7 @@ static void table_draw_part_begin_cb(lv_event_t * e) {
     lv_obj_draw_part_dsc_t  *dsc = lv_event_get_draw_part_dsc(e);
 
     if (dsc->part == LV_PART_ITEMS) {
-        uint32_t    row = dsc->id / lv_table_get_col_cnt(obj);
-        uint32_t    col = dsc->id - row * lv_table_get_col_cnt(obj);
-        cell_data_t *cell_data = lv_table_get_cell_user_data(obj, row, col);
+        cell_data_t *cell_data = lv_msg_list_get_item(obj, dsc->id);
 
         dsc->rect_dsc->bg_opa = LV_OPA_50;
 
@@ -368,8 +494,13 @@ static void table_draw_part_begin_cb(lv_event_t * e) {
                 case CELL_RX_CQ:
                     switch (cell_data->worked_type) {
                         case SEARCH_WORKED_NO:
-                            // green
-                            dsc->rect_dsc->bg_color = lv_color_hex(0x00DD00);
+                            if (cell_data->new_mult) {
+                                // cyan
+                                dsc->rect_dsc->bg_color = lv_color_hex(0x00DDDD);
+                            } else {
+                                // green
+                                dsc->rect_dsc->bg_color = lv_color_hex(0x00DD00);
+                            }
                             break;
                         case SEARCH_WORKED_YES:
                             // dark green
@@ -398,10 +529,7 @@ static void table_draw_part_begin_cb(lv_event_t * e) {
             }
         }
 
-        uint16_t    selected_row, selected_col;
-        lv_table_get_selected_cell(obj, &selected_row, &selected_col);
-
-        if (selected_row == row) {
+        if (cell_data != NULL && lv_msg_list_get_selected(obj) == dsc->id) {
             dsc->rect_dsc->bg_color = lv_color_lighten(dsc->rect_dsc->bg_color, 20);
         }
     }
@@ -412,9 +540,7 @@ static void table_draw_part_end_cb(lv_event_t * e) {
     lv_obj_draw_part_dsc_t  *dsc = lv_event_get_draw_part_dsc(e);
 
     if (dsc->part == LV_PART_ITEMS) {
-        uint32_t    row = dsc->id / lv_table_get_col_cnt(obj);
-        uint32_t    col = dsc->id - row * lv_table_get_col_cnt(obj);
-        cell_data_t *cell_data = lv_table_get_cell_user_data(obj, row, col);
+        cell_data_t *cell_data = lv_msg_list_get_item(obj, dsc->id);
 
         if (cell_data == NULL) {
             return;
@@ -471,15 +597,56 @@ static void key_cb(lv_event_t * e) {
     }
 }
 
+/**
+ * Leave decode_thread running in the background, the dialog objects are to be deleted
+ */
+static void monitor_start() {
+    state = RX_PROCESS;
+    ftx_qso_processor_set_auto(qso_processor, false);
+    ftx_qso_processor_reset(qso_processor);
+    tx_msg.msg[0] = '\0';
+
+    pthread_mutex_lock(&dialog_mutex);
+    history_head = 0;
+    history_count = 0;
+    atomic_store(&background, true);
+    pthread_mutex_unlock(&dialog_mutex);
+
+    monitor_running = true;
+}
+
+/**
+ * Take decode_thread back to the new dialog objects, with the history in the table
+ */
+static void monitor_resume() {
+    pthread_mutex_lock(&dialog_mutex);
+    for (uint16_t i = 0; i < history_count; i++) {
+        lv_msg_list_append(table, &history[(history_head + i) % MONITOR_HISTORY]);
+    }
+    history_count = 0;
+    atomic_store(&background, false);
+    pthread_mutex_unlock(&dialog_mutex);
+
+    ftx_qso_processor_set_auto(qso_processor, params.ft8_auto.x);
+    monitor_running = false;
+}
+
 static void destruct_cb() {
     // TODO: check free mem
     keyboard_close();
-    worker_done();
 
-    firdecim_crcf_destroy(decim);
-    free(audio_buf);
+    if (subject_get_int(cfg.ft8_monitor.val)) {
+        monitor_start();
+    } else {
+        audio_graph_remove(audio_sink);
+        worker_done();
+
+        cbuffercf_destroy(audio_buf);
+        ring_destroy(audio_ring);
 
-    mem_load(MEM_BACKUP_ID);
+        mem_load(MEM_BACKUP_ID);
+    }
+    table = NULL;
 
     main_screen_lock_mode(false);
     main_screen_lock_ab(false);
@@ -511,16 +678,8 @@ static void load_band(int8_t dir) {
 
 /// @brief Clean waterfall and table
 static void clean_screen() {
-    lv_table_set_row_cnt(table, 0);
-    lv_table_set_row_cnt(table, 1);
-    lv_table_set_cell_value(table, 0, 0, WAIT_SYNC_TEXT);
-
+    lv_msg_list_clear(table);
     lv_waterfall_clear_data(waterfall);
-
-    int32_t *c = malloc(sizeof(int32_t));
-    *c = LV_KEY_UP;
-
-    lv_event_send(table, LV_EVENT_KEY, c);
 }
 
 static void band_cb(lv_event_t * e) {
@@ -599,9 +758,13 @@ static void construct_cb(lv_obj_t *parent) {
     lv_obj_add_event_cb(dialog.obj, band_cb, EVENT_BAND_UP, NULL);
     lv_obj_add_event_cb(dialog.obj, band_cb, EVENT_BAND_DOWN, NULL);
 
-    decim = firdecim_crcf_create_kaiser(DECIM, 8, 40.0f);
-    firdecim_crcf_set_scale(decim, 1.0f / DECIM);
-    audio_buf = cbuffercf_create(AUDIO_CAPTURE_RATE * 3);
+    if (!monitor_running) {
+        audio_buf = cbuffercf_create(SAMPLE_RATE * 3);
+        audio_ring = ring_create(sizeof(audio_block_t), AUDIO_RING_BLOCKS);
+        audio_underruns = 0;
+        audio_drops = 0;
+        audio_sink = audio_graph_add(SAMPLE_RATE, AUDIO_FORMAT_CFLOAT, audio_cb, audio_active, NULL);
+    }
 
     /* Waterfall */
 
@@ -639,7 +802,7 @@ static void construct_cb(lv_obj_t *parent) {
 
     /* Table */
 
-    table = lv_table_create(dialog.obj);
+    table = lv_msg_list_create(dialog.obj);
 
     lv_obj_remove_style(table, NULL, LV_STATE_ANY | LV_PART_MAIN);
     lv_obj_add_event_cb(table, cell_press_cb, LV_EVENT_PRESSED, NULL);
@@ -650,8 +813,8 @@ static void construct_cb(lv_obj_t *parent) {
     lv_obj_set_size(table, WIDTH, 325 - 55);
     lv_obj_set_pos(table, 13, 13 + 55);
 
-    lv_table_set_col_cnt(table, 1);
-    lv_table_set_col_width(table, 0, WIDTH - 2);
+    lv_msg_list_set_items(table, sizeof(cell_data_t), MAX_TABLE_MSG, cell_text_cb);
+    lv_msg_list_set_placeholder(table, WAIT_SYNC_TEXT);
 
     lv_obj_set_style_border_width(table, 0, LV_PART_ITEMS);
 
@@ -667,8 +830,6 @@ static void construct_cb(lv_obj_t *parent) {
     lv_obj_set_style_pad_left(table, 5, LV_PART_ITEMS);
     lv_obj_set_style_pad_right(table, 0, LV_PART_ITEMS);
 
-    lv_table_set_cell_value(table, 0, 0, "Wait sync");
-
     /* Fade */
 
     lv_anim_init(&fade);
@@ -684,7 +845,10 @@ static void construct_cb(lv_obj_t *parent) {
 
     reload_buttons();
 
-    mem_save(MEM_BACKUP_ID);
+    // The radio is left as is by the background monitor, the backup is of the first open
+    if (!monitor_running) {
+        mem_save(MEM_BACKUP_ID);
+    }
     load_band(0);
 
     filter_low = subject_get_int(cfg_cur.filter.low);
@@ -692,14 +856,18 @@ static void construct_cb(lv_obj_t *parent) {
 
     lv_finder_set_range(finder, filter_low, filter_high);
 
-    qth_str_to_pos(params.qth.x, &cur_lat, &cur_lon);
+    qth_grid_pos(params.qth.x, &cur_pos);
 
     main_screen_lock_ab(true);
     main_screen_lock_mode(true);
     main_screen_lock_freq(true);
     main_screen_lock_band(true);
 
-    worker_init();
+    if (monitor_running) {
+        monitor_resume();
+    } else {
+        worker_init();
+    }
 
     /* Logger */
     ft8_log = adif_log_init("/mnt/ft_log.adi");
@@ -747,6 +915,18 @@ static void reload_buttons() {
 
         buttons_load(3, &button_cq_mod);
         buttons_load(4, &button_time_sync);
+        break;
+
+    case 2:
+        buttons_load(0, &button_page_3);
+
+        button_dual_decode.label = subject_get_int(cfg.ft8_dual_decode.val) ?
+            (params.ft8_protocol == FTX_PROTOCOL_FT8 ? "Dual FT4:\nEnabled" : "Dual FT8:\nEnabled") :
+            "Dual:\nDisabled";
+        buttons_load(1, &button_dual_decode);
+
+        button_monitor.label = subject_get_int(cfg.ft8_monitor.val) ? "Monitor:\nEnabled" : "Monitor:\nDisabled";
+        buttons_load(2, &button_monitor);
     default:
         break;
     }
@@ -786,6 +966,23 @@ static void mode_auto_cb(struct button_item_t *btn) {
     reload_buttons();
 }
 
+static void dual_decode_cb(struct button_item_t *btn) {
+    if (disable_buttons) return;
+    bool val = subject_get_int(cfg.ft8_dual_decode.val);
+    subject_set_int(cfg.ft8_dual_decode.val, !val);
+    reload_buttons();
+
+    worker_done();
+    worker_init();
+}
+
+static void monitor_cb(struct button_item_t *btn) {
+    if (disable_buttons) return;
+    bool val = subject_get_int(cfg.ft8_monitor.val);
+    subject_set_int(cfg.ft8_monitor.val, !val);
+    reload_buttons();
+}
+
 static void hold_tx_freq_cb(struct button_item_t *btn) {
     if (disable_buttons) return;
     bool val = subject_get_int(cfg.ft8_hold_freq.val);
@@ -811,7 +1008,7 @@ static void tx_cq_en_dis_cb(struct button_item_t *btn) {
         struct timespec now;
         clock_gettime(CLOCK_REALTIME, &now);
         float time_since_slot_start;
-        tx_time_slot = !get_time_slot(now, &time_since_slot_start);
+        tx_time_slot = !get_time_slot(params.ft8_protocol, now, &time_since_slot_start);
         if (time_since_slot_start < MAX_TX_START_DELAY) {
             tx_time_slot = !tx_time_slot;
         }
@@ -892,7 +1089,7 @@ static void time_sync(struct button_item_t *btn) {
 }
 
 static void load_page(struct button_item_t *btn) {
-    button_page = (button_page + 1) % 2;
+    button_page = (button_page + 1) % 3;
     reload_buttons();
 }
 
@@ -900,18 +1097,15 @@ static void cell_press_cb(lv_event_t * e) {
     if (state == TX_PROCESS) {
         tx_call_off();
     } else {
-        uint16_t     row;
-        uint16_t     col;
-
-        lv_table_get_selected_cell(table, &row, &col);
-
-        cell_data_t  *cell_data = lv_table_get_cell_user_data(table, row, col);
+        cell_data_t  *cell_data = lv_msg_list_get_item(table, lv_msg_list_get_selected(table));
 
         if ((cell_data == NULL) ||
             (cell_data->cell_type == CELL_TX_MSG) ||
             (cell_data->cell_type == CELL_RX_INFO)
         ) {
             msg_schedule_text_fmt("What should I do about it?");
+        } else if (cell_data->dual) {
+            msg_schedule_text_fmt("Switch mode to answer it");
         } else {
             ftx_qso_processor_start_qso(qso_processor, &cell_data->meta, &tx_msg);
             if (strlen(tx_msg.msg) > 0) {
@@ -974,19 +1168,55 @@ static bool keyboard_ok_cb() {
     return true;
 }
 
-static void audio_cb(unsigned int n, float complex *samples) {
-    if (state == RX_PROCESS) {
-        pthread_mutex_lock(&audio_mutex);
-        cbuffercf_write(audio_buf, samples, n);
-        pthread_mutex_unlock(&audio_mutex);
+static bool audio_active(void *user) {
+    return state == RX_PROCESS;
+}
+
+/**
+ * Audio thread. A fragment on the full ring is dropped and counted by the ring as overrun
+ */
+static void audio_cb(const void *samples, size_t n, void *user) {
+    audio_block_t *block = ring_reserve(audio_ring);
+
+    if (!block) {
+        return;
+    }
+    if (n > AUDIO_FRAGMENT_MAX) {
+        n = AUDIO_FRAGMENT_MAX;
+    }
+    block->time = get_time();
+    block->n = n;
+    memcpy(block->samples, samples, n * sizeof(float complex));
+    ring_commit(audio_ring);
+}
+
+/**
+ * Copy captured fragments out of the ring into audio_buf
+ */
+static void audio_drain() {
+    audio_block_t *block;
+
+    while ((block = ring_peek(audio_ring))) {
+        if (audio_last_time && block->time - audio_last_time > AUDIO_STALL_MS) {
+            LV_LOG_WARN("FT8 audio gap %llu ms", block->time - audio_last_time);
+            audio_underruns++;
+        }
+        audio_last_time = block->time;
+
+        if (cbuffercf_space_available(audio_buf) >= block->n) {
+            cbuffercf_write(audio_buf, block->samples, block->n);
+        } else {
+            audio_drops++;
+        }
+        ring_release(audio_ring);
     }
 }
 
-static bool get_time_slot(struct timespec now, float *sec_since_start) {
+static bool get_time_slot(ftx_protocol_t protocol, struct timespec now, float *sec_since_start) {
     bool cur_odd;
     float sec = (now.tv_sec % 60) + now.tv_nsec / 1.0e9f;
 
-    switch (params.ft8_protocol) {
+    switch (protocol) {
     case FTX_PROTOCOL_FT4:
         cur_odd = (int)(sec / FT4_SLOT_TIME) % 2;
         *sec_since_start = fmodf(sec, FT4_SLOT_TIME);
@@ -1032,12 +1262,70 @@ static float get_correction() {
     return correction;
 }
 
-static void tx_worker() {
-    const uint16_t signal_freq = 1325;
-    int16_t       *samples;
-    uint32_t       n_samples;
+/**
+ * Render tx_msg, if it is not rendered yet. Called from the decode thread on each
+ * loop, so at the slot edge TX only needs to start playback
+ */
+static bool tx_wave_prepare() {
+    char msg[sizeof(tx_msg.msg)];
+
+    // tx_msg is changed from the UI
+    strncpy(msg, tx_msg.msg, sizeof(msg) - 1);
+    msg[sizeof(msg) - 1] = '\0';
+
+    if (msg[0] == '\0') {
+        return false;
+    }
+    if (tx_wave_size > 0 && strcmp(msg, tx_wave_msg) == 0) {
+        return true;
+    }
+
+    uint64_t start = get_time();
+
+    tx_wave_size = ftx_worker_render_tx_samples(msg, TX_SIGNAL_FREQ, AUDIO_PLAY_RATE, tx_wave, tx_wave_max);
+    strcpy(tx_wave_msg, msg);
+    LV_LOG_INFO("TX rendered in %llu ms: %s", get_time() - start, msg);
 
-    if (!ftx_worker_generate_tx_samples(tx_msg.msg, signal_freq, AUDIO_PLAY_RATE, &samples, &n_samples)) {
+    return tx_wave_size > 0;
+}
+
+static struct timespec shift_time(struct timespec ts, int64_t usec) {
+    int64_t nsec = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec + usec * 1000LL;
+
+    ts.tv_sec = nsec / 1000000000LL;
+    ts.tv_nsec = nsec % 1000000000LL;
+
+    return ts;
+}
+
+/**
+ * Wait for the next tick, or up to the slot edge, if it is closer. The edge is an absolute
+ * deadline of edge_fd on the realtime clock, so it is hit without polling. A clock step
+ * (time sync, GPS or PPS discipline) cancels the deadline and wakes up the wait
+ */
+static void wait_tick(struct timespec now, float sec_since_slot_start) {
+    float slot_time = (params.ft8_protocol == FTX_PROTOCOL_FT4) ? FT4_SLOT_TIME : FT8_SLOT_TIME;
+    float left = slot_time - sec_since_slot_start;
+
+    if (edge_fd < 0) {
+        usleep(TICK_MS * 1000);
+        return;
+    }
+
+    struct itimerspec   its = { .it_value = shift_time(now, (int64_t)(left * 1.0e6f)) };
+    struct pollfd       pfd = { .fd = edge_fd, .events = POLLIN };
+    uint64_t            expirations;
+
+    timerfd_settime(edge_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL);
+
+    if (poll(&pfd, 1, TICK_MS) > 0) {
+        // Fails with ECANCELED after a clock step, slots are recalculated on the next loop
+        read(edge_fd, &expirations, sizeof(expirations));
+    }
+}
+
+static void tx_worker() {
+    if (!tx_wave_prepare()) {
         state = RX_PROCESS;
         return;
     }
@@ -1047,13 +1335,15 @@ static void tx_worker() {
 
     // Change freq before tx
     uint64_t radio_freq = subject_get_int(cfg_cur.fg_freq);
-    radio_set_freq(radio_freq + params.ft8_tx_freq.x - signal_freq);
+    radio_set_freq(radio_freq + params.ft8_tx_freq.x - TX_SIGNAL_FREQ);
     radio_set_modem(true);
 
     float    prev_gain_offset = gain_offset;
     size_t   counter = 0;
-    int16_t *ptr = samples;
+    int16_t *ptr = tx_wave;
+    size_t   n_samples = tx_wave_size;
     size_t   part;
+    int16_t  buf[TX_PART];
 
     while (true) {
         if (counter > 30) {
@@ -1068,17 +1358,21 @@ static void tx_worker() {
             state = RX_PROCESS;
             break;
         }
-        part = LV_MIN(1024 * 2, n_samples);
+        part = LV_MIN(TX_PART, n_samples);
+
+        // tx_wave is kept for repeats
         if (gain_offset == prev_gain_offset) {
             if (gain_offset != 0.0f) {
-                audio_gain_db(ptr, part, gain_offset, ptr);
+                audio_gain_db(ptr, part, gain_offset, buf);
+            } else {
+                memcpy(buf, ptr, part * sizeof(int16_t));
             }
         } else {
             // Smooth change gain
-            audio_gain_db_transition(ptr, part, prev_gain_offset, gain_offset, ptr);
+            audio_gain_db_transition(ptr, part, prev_gain_offset, gain_offset, buf);
             prev_gain_offset = gain_offset;
         }
-        audio_play(ptr, part);
+        audio_play(buf, part);
 
         n_samples -= part;
         ptr += part;
@@ -1089,7 +1383,6 @@ static void tx_worker() {
     radio_set_modem(false);
     // Restore freq
     radio_set_freq(radio_freq);
-    free(samples);
     audio_set_play_vol(params.play_gain_db_f.x);
 }
 
@@ -1105,7 +1398,7 @@ static void add_info(const char * fmt, ...) {
     vsnprintf(cell_data.text, sizeof(cell_data.text), fmt, args);
     va_end(args);
 
-    scheduler_put(add_msg_cb, &cell_data, sizeof(cell_data_t));
+    put_cell(&cell_data);
 }
 
 /**
@@ -1119,7 +1412,7 @@ static void add_tx_text(const char * text) {
     if (strncmp(cell_data.text, "CQ_", 3) == 0) {
         cell_data.text[2] = ' ';
     }
-    scheduler_put(add_msg_cb, &cell_data, sizeof(cell_data_t));
+    put_cell(&cell_data);
 }
 
 /**
@@ -1134,23 +1427,43 @@ static void add_rx_text(int16_t snr, const char * text, slot_info_t *s_info, flo
     ftx_qso_processor_add_rx_text(qso_processor, text, snr, &meta, &tx_msg);
 
     if ((strlen(tx_msg.msg) > 0) && (strcmp(old_msg, tx_msg.msg) != 0)) {
-        lv_finder_set_cursor(finder, meta.freq_hz);
-        if (!subject_get_int(cfg.ft8_hold_freq.val)) {
-            set_freq(freq_hz);
+        int cancel_state;
+
+        if (dialog_lock(&cancel_state)) {
+            lv_finder_set_cursor(finder, meta.freq_hz);
+            if (!subject_get_int(cfg.ft8_hold_freq.val)) {
+                set_freq(freq_hz);
+            }
         }
+        dialog_unlock(cancel_state);
         tx_time_slot = !s_info->odd;
         msg_schedule_text_fmt("Next TX: %s", tx_msg.msg);
         if (cq_enabled) {
             cq_enabled = false;
-            scheduler_put_noargs(reload_buttons);
+            scheduler_put_prio(SCHEDULER_PRIO_DISPLAY, reload_buttons, NULL, 0);
         }
     }
     free(old_msg);
 
+    add_rx_cell(text, &meta, s_info->odd, false);
+}
+
+/**
+ * Add RX message of the main or the dual decoder to the table
+ */
+static void add_rx_cell(const char *text, const ftx_msg_meta_t *meta, bool odd, bool dual) {
+    ftx_protocol_t  protocol = dual ? dual_protocol() : params.ft8_protocol;
     ft8_cell_type_t cell_type;
-    if (meta.to_me) {
+
+    if (meta->type != FXT_MSG_TYPE_OTHER) {
+        uint64_t freq = subject_get_int(cfg_cur.fg_freq) + subject_get_int(cfg_cur.lo_offset) + (int) meta->freq_hz;
+
+        psk_reporter_spot(meta->call_de, meta->grid, meta->local_snr, freq, protocol == FTX_PROTOCOL_FT8 ? "FT8" : "FT4");
+    }
+
+    if (meta->to_me) {
         cell_type = CELL_RX_TO_ME;
-    } else if (meta.type == FTX_MSG_TYPE_CQ) {
+    } else if (meta->type == FTX_MSG_TYPE_CQ) {
         cell_type = CELL_RX_CQ;
     } else if (!params.ft8_show_all) {
         return;
@@ -1158,73 +1471,176 @@ static void add_rx_text(int16_t snr, const char * text, slot_info_t *s_info, flo
         cell_type = CELL_RX_MSG;
     }
 
-    cell_data_t  cell_data;
-    if (meta.type == FTX_MSG_TYPE_CQ) {
-        cell_data.worked_type = qso_log_search_worked(
-            meta.call_de,
-            params.ft8_protocol == FTX_PROTOCOL_FT8 ? MODE_FT8 : MODE_FT4,
-            qso_log_freq_to_band(subject_get_int(cfg_cur.fg_freq))
-        );
+    cell_data_t cell_data;
+
+    cell_data.new_mult = false;
+
+    if (meta->type == FTX_MSG_TYPE_CQ) {
+        qso_log_band_t band = qso_log_freq_to_band(subject_get_int(cfg_cur.fg_freq));
+
+        if (contest_active()) {
+            uint8_t res = contest_check(meta->call_de, meta->grid, band, protocol_mode(protocol));
+
+            cell_data.worked_type = (res & CONTEST_DUPE) ? SEARCH_WORKED_SAME_MODE : SEARCH_WORKED_NO;
+            cell_data.new_mult = res & (CONTEST_NEW_GRID | CONTEST_NEW_PREFIX);
+        } else {
+            cell_data.worked_type = qso_log_search_worked(meta->call_de, protocol_mode(protocol), band);
+        }
     }
 
     cell_data.cell_type = cell_type;
-    strncpy(cell_data.text, text, sizeof(cell_data.text) - 1);
-    cell_data.meta = meta;
-    cell_data.odd = s_info->odd;
+    if (dual) {
+        snprintf(cell_data.text, sizeof(cell_data.text), "%s: %s", protocol == FTX_PROTOCOL_FT8 ? "FT8" : "FT4", text);
+    } else {
+        strncpy(cell_data.text, text, sizeof(cell_data.text) - 1);
+    }
+    cell_data.meta = *meta;
+    cell_data.odd = odd;
+    cell_data.dual = dual;
     if (params.qth.x[0] != 0) {
-        if (strlen(meta.grid) > 0) {
-            double lat, lon;
-            qth_str_to_pos(meta.grid, &lat, &lon);
-            cell_data.dist = qth_pos_dist(lat, lon, cur_lat, cur_lon);
+        qth_pos_t   pos;
+        double      dist;
+
+        if (strlen(meta->grid) > 0 && qth_grid_pos(meta->grid, &pos)) {
+            qth_pos_dist_batch(&cur_pos, &pos, 1, &dist, NULL);
+            cell_data.dist = dist;
         } else {
             cell_data.dist = 0;
         }
     } else {
         cell_data.dist = 0;
     }
-    scheduler_put(add_msg_cb, (void*)&cell_data, sizeof(cell_data_t));
+    put_cell(&cell_data);
 }
 
+/* Messages of the current slot, decode thread */
+static uint16_t slot_decodes = 0;
+static uint16_t dual_slot_decodes = 0;
+static uint16_t slot_snr[BAND_ACTIVITY_SNR_BINS];
+static uint16_t dual_slot_snr[BAND_ACTIVITY_SNR_BINS];
+
 static void received_message_cb(const char *text, int snr, float freq_hz, float time_sec, void *user_data) {
     slot_info_t *s_info = (slot_info_t *)user_data;
+    slot_decodes++;
+    slot_snr[band_activity_snr_bin(snr)]++;
     add_rx_text(snr, text, s_info, freq_hz, time_sec);
 }
 
-static void rx_worker(bool new_slot, slot_info_t *s_info) {
+static void dual_message_cb(const char *text, int snr, float freq_hz, float time_sec, void *user_data) {
+    slot_info_t     *d_info = (slot_info_t *)user_data;
+    ftx_tx_msg_t    skip_tx_msg = { .msg = "" };
+    ftx_msg_meta_t  meta;
+
+    dual_slot_decodes++;
+    dual_slot_snr[band_activity_snr_bin(snr)]++;
+    meta.freq_hz = freq_hz;
+    meta.time_sec = time_sec;
+    ftx_qso_processor_add_rx_text(dual_processor, text, snr, &meta, &skip_tx_msg);
+    add_rx_cell(text, &meta, d_info->odd, true);
+}
+
+/**
+ * Feed the dual decoder with the decimated block of the main one
+ */
+static void dual_rx(float complex *samples, size_t n, bool idle, slot_info_t *d_info) {
+    unsigned int   read_n;
+    float complex *buf;
+    const int      block_size = ftx_decoder_get_block_size(dual_decoder);
+
+    cbuffercf_write(dual_buf, samples, n);
+
+    while (cbuffercf_size(dual_buf) >= block_size) {
+        cbuffercf_read(dual_buf, block_size, &buf, &read_n);
+        ftx_decoder_put_rx_samples(dual_decoder, buf, block_size);
+        cbuffercf_release(dual_buf, block_size);
+
+        if (ftx_decoder_is_full(dual_decoder)) {
+            ftx_decoder_decode(dual_decoder, dual_message_cb, true, (void *)d_info);
+            ftx_decoder_reset(dual_decoder);
+        }
+    }
+    if (idle && !low_effort) {
+        ftx_decoder_decode(dual_decoder, dual_message_cb, false, (void *)d_info);
+    }
+}
+
+static void rx_worker(bool new_slot, slot_info_t *s_info, bool dual_new_slot, slot_info_t *d_info) {
     unsigned int   n;
     float complex *buf;
     const int block_size = ftx_worker_get_block_size();
-    const size_t   size = block_size * DECIM;
-
-    pthread_mutex_lock(&audio_mutex);
 
-    while (cbuffercf_size(audio_buf) > size) {
-        cbuffercf_read(audio_buf, size, &buf, &n);
+    audio_drain();
 
-        firdecim_crcf_execute_block(decim, buf, block_size, decim_buf);
-        cbuffercf_release(audio_buf, size);
+    while (cbuffercf_size(audio_buf) > block_size) {
+        cbuffercf_read(audio_buf, block_size, &buf, &n);
 
-        waterfall_process(decim_buf, block_size);
+        ftx_worker_put_rx_samples(buf, block_size);
+        waterfall_process();
 
-        ftx_worker_put_rx_samples(decim_buf, block_size);
+        // Early decoding only on idle, when the audio is caught up
+        bool idle = cbuffercf_size(audio_buf) <= 2 * block_size;
 
         if (ftx_worker_is_full()) {
             ftx_worker_decode(received_message_cb, true, (void *)s_info);
             ftx_worker_reset();
-        } else {
+        } else if (idle && !low_effort) {
             ftx_worker_decode(received_message_cb, false, (void *)s_info);
         }
+
+        if (dual_decoder) {
+            dual_rx(buf, block_size, idle, d_info);
+        }
+        cbuffercf_release(audio_buf, block_size);
     }
-    pthread_mutex_unlock(&audio_mutex);
 
     if (new_slot) {
+        uint64_t decode_start = get_time();
+
         ftx_worker_decode(received_message_cb, true, (void *)s_info);
+        soak_ft8_decode(get_time() - decode_start);
         ftx_worker_reset();
         ftx_qso_processor_start_new_slot(qso_processor);
+        metrics_ft8_slot(false, slot_decodes);
+        band_activity_slot(time(NULL) - slot_seconds(params.ft8_protocol), slot_snr);
+        slot_decodes = 0;
+        memset(slot_snr, 0, sizeof(slot_snr));
+    }
+    if (dual_decoder && dual_new_slot) {
+        ftx_decoder_decode(dual_decoder, dual_message_cb, true, (void *)d_info);
+        ftx_decoder_reset(dual_decoder);
+        ftx_qso_processor_start_new_slot(dual_processor);
+        metrics_ft8_slot(true, dual_slot_decodes);
+        band_activity_slot(time(NULL) - slot_seconds(dual_protocol()), dual_slot_snr);
+        dual_slot_decodes = 0;
+        memset(dual_slot_snr, 0, sizeof(dual_slot_snr));
     }
 }
 
+/**
+ * Reduced effort and priority of the background monitor, or the full ones
+ */
+static void set_effort(bool low) {
+    if (low) {
+        ftx_worker_set_effort(MONITOR_CANDIDATES, MONITOR_LDPC_ITERATIONS);
+        ftx_worker_set_decode_passes(1);
+    } else {
+        ftx_worker_set_effort(0, 0);
+        ftx_worker_set_decode_passes(DECODE_PASSES);
+    }
+    if (dual_decoder) {
+        ftx_decoder_set_effort(dual_decoder, low ? MONITOR_CANDIDATES : 0, low ? MONITOR_LDPC_ITERATIONS : 0);
+        ftx_decoder_set_decode_passes(dual_decoder, low ? 1 : DECODE_PASSES);
+    }
+    if (low) {
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), MONITOR_NICE);
+    } else {
+        threads_apply("ft8");
+    }
+    LV_LOG_USER("FT8 %s effort", low ? "background" : "full");
+}
+
 static void * decode_thread(void *arg) {
+    set_thread_name("ft8");
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
@@ -1237,22 +1653,48 @@ static void * decode_thread(void *arg) {
     bool            have_tx_msg = false;
 
     slot_info_t s_info = {.odd=false, .answer_generated=false};
+    slot_info_t d_info = {.odd=false, .answer_generated=false};
+
+    low_effort = false;
 
     while (true) {
+        if (atomic_load(&background) != low_effort) {
+            low_effort = !low_effort;
+            set_effort(low_effort);
+        }
         clock_gettime(CLOCK_REALTIME, &now);
-        new_odd = get_time_slot(now, &sec_since_slot_start);
+
+        // Captured audio is late and played one is early by the stream latency
+        struct timespec rx_now = shift_time(now, -(int64_t)audio_get_capture_latency());
+        struct timespec tx_now = shift_time(now, audio_get_play_latency());
+
+        new_odd = get_time_slot(params.ft8_protocol, rx_now, &sec_since_slot_start);
         new_slot = new_odd != s_info.odd;
-        rx_worker(new_slot, &s_info);
+
+        float dual_sec;
+        bool  dual_odd = get_time_slot(dual_protocol(), rx_now, &dual_sec);
+
+        float tx_sec;
+        bool  tx_odd = get_time_slot(params.ft8_protocol, tx_now, &tx_sec);
+
+        rx_worker(new_slot, &s_info, dual_odd != d_info.odd, &d_info);
         s_info.odd = new_odd;
+        d_info.odd = dual_odd;
+
+        have_tx_msg = tx_msg.msg[0] != '\0' && !low_effort;
 
-        have_tx_msg = tx_msg.msg[0] != '\0';
+        if (have_tx_msg) {
+            tx_wave_prepare();
+        }
 
-        if ((sec_since_slot_start < MAX_TX_START_DELAY) && have_tx_msg) {
+        if ((tx_sec < MAX_TX_START_DELAY) && have_tx_msg) {
             // Start TX and continue after done
-            if ((tx_time_slot == new_odd) && tx_enabled) {
+            if ((tx_time_slot == tx_odd) && tx_enabled) {
                 state = TX_PROCESS;
                 add_tx_text(tx_msg.msg);
                 tx_worker();
+                // No capture on TX, the gap is not a stall
+                audio_last_time = 0;
                 if (tx_msg.repeats > 0) {
                     tx_msg.repeats--;
                 }
@@ -1266,13 +1708,14 @@ static void * decode_thread(void *arg) {
         if (new_slot) {
             // Add message about new slot;
             state = RX_PROCESS;
-            if ((!have_tx_msg || !tx_enabled)) {
+            if ((!have_tx_msg || !tx_enabled) && !low_effort) {
                 ts = localtime(&now.tv_sec);
                 add_info("RX %s %02i:%02i:%02i", cfg_digital_label_get(),
                     ts->tm_hour, ts->tm_min, ts->tm_sec);
             }
         } else {
-            usleep(100000);
+            // Up to the closest of RX and TX slot edges
+            wait_tick(now, fmaxf(sec_since_slot_start, tx_sec));
         }
     }
 
@@ -147,14 +147,14 @@ char *deg_to_str2(deg_str_type type, double f, char *buf, unsigned int buf_size,
 }
 
 static void gps_cb(lv_event_t * e) {
-    struct gps_data_t   *msg = lv_event_get_param(e);
-    char                str[64];
+    gps_fix_t   x;
+    char        str[64];
 
-    if (msg->set & SATELLITE_SET) {
-        lv_label_set_text_fmt(satellites_cnt, "%i/%i", msg->satellites_visible, msg->satellites_used);
-    }
+    gps_get_fix(&x);
+
+    lv_label_set_text_fmt(satellites_cnt, "%i/%i", x.sats_visible, x.sats_used);
 
-    switch (msg->fix.mode) {
+    switch (x.mode) {
         case MODE_3D:
             lv_label_set_text(fix, "3D");
             break;
@@ -171,22 +171,22 @@ static void gps_cb(lv_event_t * e) {
             break;
     }
 
-    if (msg->set & TIME_SET) {
-        timespec_to_iso8601(msg->fix.time, str, sizeof(str));
+    if (x.time_valid) {
+        timespec_to_iso8601(x.time, str, sizeof(str));
         lv_label_set_text(date, str);
     } else {
         lv_label_set_text(date, "N/A");
     }
 
-    if (msg->fix.mode >= MODE_2D) {
-        deg_to_str2(deg_type, msg->fix.latitude, str, sizeof(str), "N", "S");
+    if (x.mode >= MODE_2D) {
+        deg_to_str2(deg_type, x.latitude, str, sizeof(str), "N", "S");
         lv_label_set_text(lat, str);
 
-        deg_to_str2(deg_type, msg->fix.longitude, str, sizeof(str), "E", "W");
+        deg_to_str2(deg_type, x.longitude, str, sizeof(str), "E", "W");
         lv_label_set_text(lon, str);
 
         char qth_val[9];
-        qth_pos_to_str(msg->fix.latitude, msg->fix.longitude, qth_val);
+        qth_pos_to_str(x.latitude, x.longitude, qth_val);
         lv_label_set_text(qth, qth_val);
 
         int saved_qth_len = strlen(params.qth.x);
@@ -334,6 +334,11 @@ static void construct_cb(lv_obj_t *parent) {
 
     status_update_timer = lv_timer_create(gps_status_update_timer, 500,  NULL);
     lv_timer_ready(status_update_timer);
+
+    /* Updates are sent on changes only, show the latest fix now */
+    if (gps_status() == GPS_STATUS_WORKING) {
+        gps_cb(NULL);
+    }
 }
 
 static void destruct_cb() {
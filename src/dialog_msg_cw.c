@@ -285,6 +285,12 @@ void dialog_msg_cw_send_cb(button_item_t *item) {
 
 static void send_stop_cb(button_item_t *item) {
     cw_encoder_stop();
+
+    cw_encoder_jitter_t jitter = cw_encoder_get_jitter();
+
+    if (jitter.edges) {
+        msg_update_text_fmt("Keying jitter: avg %u us, max %u us", jitter.avg_us, jitter.max_us);
+    }
     buttons_unload_page();
     buttons_load_page(&buttons_page_msg_cw_1);
 }
@@ -10,6 +10,7 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <math.h>
@@ -34,6 +35,19 @@
 
 #define BUF_SIZE 1024
 
+/* Decoded messages, beacon repeats play from memory */
+#define CACHE_ITEMS     4
+#define CACHE_MAX       (16 * 1024 * 1024)
+
+typedef struct {
+    char        name[64];
+    time_t      mtime;
+    off_t       size;
+    int16_t     *samples;
+    size_t      count;
+    uint64_t    used;
+} cache_item_t;
+
 typedef enum {
     VOICE_BEACON_OFF = 0,
     VOICE_BEACON_PLAY,
@@ -50,7 +64,9 @@ static SNDFILE              *file = NULL;
 
 static char                 *prev_filename;
 static pthread_t            thread;
-static int16_t              samples_buf[BUF_SIZE];
+
+static cache_item_t         cache[CACHE_ITEMS];
+static uint64_t             cache_tick = 0;
 
 static void construct_cb(lv_obj_t *parent);
 static void destruct_cb();
@@ -250,6 +266,108 @@ static const char* get_item() {
     return lv_table_get_cell_value(table, row, col);
 }
 
+static void cache_drop(const char *filename) {
+    for (int i = 0; i < CACHE_ITEMS; i++) {
+        if (cache[i].samples && strcmp(cache[i].name, filename) == 0) {
+            free(cache[i].samples);
+            memset(&cache[i], 0, sizeof(cache_item_t));
+        }
+    }
+}
+
+/**
+ * Decode the whole file, NULL if it can't be read or doesn't fit the cache
+ */
+static int16_t * decode_file(const char *filename, size_t *count) {
+    SF_INFO sfinfo;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+
+    SNDFILE *file = sf_open(filename, SFM_READ, &sfinfo);
+
+    if (!file) {
+        return NULL;
+    }
+
+    int16_t *samples = NULL;
+    size_t  frames = sfinfo.frames;
+
+    if (sfinfo.channels == 1 && frames > 0 && frames * sizeof(int16_t) <= CACHE_MAX) {
+        samples = malloc(frames * sizeof(int16_t));
+    }
+
+    if (samples) {
+        *count = sf_read_short(file, samples, frames);
+    }
+
+    sf_close(file);
+
+    return samples;
+}
+
+/**
+ * Decoded samples of the file. Least recently used items are evicted to keep the total
+ * size and count bounded
+ */
+static cache_item_t * cache_get(const char *filename) {
+    struct stat st;
+
+    if (stat(filename, &st) != 0) {
+        return NULL;
+    }
+
+    for (int i = 0; i < CACHE_ITEMS; i++) {
+        cache_item_t *item = &cache[i];
+
+        if (item->samples && strcmp(item->name, filename) == 0) {
+            if (item->mtime == st.st_mtime && item->size == st.st_size) {
+                item->used = ++cache_tick;
+                return item;
+            }
+            cache_drop(filename);
+            break;
+        }
+    }
+
+    size_t  count = 0;
+    int16_t *samples = decode_file(filename, &count);
+
+    if (!samples) {
+        return NULL;
+    }
+
+    while (true) {
+        cache_item_t    *lru = NULL;
+        cache_item_t    *free_item = NULL;
+        size_t          total = count * sizeof(int16_t);
+
+        for (int i = 0; i < CACHE_ITEMS; i++) {
+            if (!cache[i].samples) {
+                free_item = &cache[i];
+            } else {
+                total += cache[i].count * sizeof(int16_t);
+
+                if (!lru || cache[i].used < lru->used) {
+                    lru = &cache[i];
+                }
+            }
+        }
+
+        if (free_item && total <= CACHE_MAX) {
+            strncpy(free_item->name, filename, sizeof(free_item->name) - 1);
+            free_item->mtime = st.st_mtime;
+            free_item->size = st.st_size;
+            free_item->samples = samples;
+            free_item->count = count;
+            free_item->used = ++cache_tick;
+
+            return free_item;
+        }
+
+        cache_drop(lru->name);
+    }
+}
+
 static void play_item() {
     const char *item = get_item();
 
@@ -263,32 +381,39 @@ static void play_item() {
     strcat(filename, "/");
     strcat(filename, item);
 
-    SF_INFO sfinfo;
-
-    memset(&sfinfo, 0, sizeof(sfinfo));
+    // Cache is left consistent, if the thread is cancelled
+    int             cancel_state;
+    cache_item_t    *cached;
 
-    SNDFILE *file = sf_open(filename, SFM_READ, &sfinfo);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    cached = cache_get(filename);
+    pthread_setcancelstate(cancel_state, NULL);
 
-    if (!file) {
+    if (!cached) {
         return;
     }
 
+    const int16_t   *samples = cached->samples;
+    size_t          count = cached->count;
+
     state = MSG_VOICE_PLAY;
     while (state == MSG_VOICE_PLAY) {
-        int res = sf_read_short(file, samples_buf, BUF_SIZE);
+        if (count > 0) {
+            size_t n = LV_MIN(count, BUF_SIZE);
 
-        if (res > 0) {
-            audio_play(samples_buf, res);
+            audio_play((int16_t *) samples, n);
+            samples += n;
+            count -= n;
         } else {
             state = MSG_VOICE_OFF;
         }
     }
 
-    sf_close(file);
     audio_play_wait();
 }
 
 static void * play_thread(void *arg) {
+    set_thread_name("msg_voice");
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
@@ -303,6 +428,7 @@ static void * play_thread(void *arg) {
 }
 
 static void * send_thread(void *arg) {
+    set_thread_name("msg_voice");
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
@@ -319,6 +445,7 @@ static void * send_thread(void *arg) {
 }
 
 static void * beacon_thread(void *arg) {
+    set_thread_name("msg_voice");
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
@@ -375,6 +502,7 @@ static bool textarea_window_edit_ok_cb() {
         snprintf(new, sizeof(new), "%s/%s", path, new_filename);
 
         if (rename(prev, new) == 0) {
+            cache_drop(prev);
             load_table();
             textarea_window_close_cb();
         }
@@ -598,6 +726,7 @@ void dialog_msg_voice_delete_cb(button_item_t *item) {
         strcat(filename, name);
 
         unlink(filename);
+        cache_drop(filename);
         load_table();
     }
 }
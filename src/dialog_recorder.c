@@ -9,6 +9,7 @@
 
 #include "audio.h"
 #include "recorder.h"
+#include "rec_index.h"
 #include "dialog.h"
 #include "styles.h"
 #include "params/params.h"
@@ -20,6 +21,7 @@
 #include "msg.h"
 #include "buttons.h"
 #include "scheduler.h"
+#include "cfg/cfg.h"
 
 #include <aether_radio/x6100_control/control.h>
 
@@ -31,14 +33,21 @@
 #include <sndfile.h>
 #include <dirent.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #define BUF_SIZE 1024
 #define LEVEL_HEIGHT 25
+#define OVERVIEW_HEIGHT 30
+#define OVERVIEW_WIDTH 775
 
 #define LEVEL_UPDATE_MS 100
 
 static lv_obj_t             *table;
 static lv_obj_t             *level;
+static lv_obj_t             *overruns_label;
+static uint32_t             overruns_shown;
+static lv_obj_t             *cost_label;
+static lv_timer_t           *cost_timer;
 static int16_t              table_rows = 0;
 static SNDFILE              *file = NULL;
 static bool                 play_state = false;
@@ -46,16 +55,28 @@ static bool                 play_state = false;
 static char                 *prev_filename;
 static pthread_t            thread;
 static int16_t              samples_buf[BUF_SIZE];
+static int16_t              resamp_buf[BUF_SIZE * 4];
+static float                resamp_phase;
+static int16_t              resamp_prev;
 
 static int32_t              level_db;
 static lv_timer_t           *level_timer;
 
+/* Index of the played file, filled by the play thread before index_ready */
+static lv_obj_t             *overview;
+static rec_index_t          play_index;
+static atomic_bool          index_ready = false;
+static atomic_uint_fast64_t play_pos = 0;          /* Frames */
+static atomic_int_fast64_t  seek_req = -1;         /* Frames, -1 - none */
+static lv_coord_t           cursor_shown = -1;
+
 static void construct_cb(lv_obj_t *parent);
 static void destruct_cb();
 static void key_cb(lv_event_t * e);
 static void load_btn_page();
 
 static void update_level_cb(lv_timer_t * timer);
+static void update_cost_cb(lv_timer_t * timer);
 
 static void rec_stop_cb(button_item_t *item);
 static void play_stop_cb(button_item_t *item);
@@ -63,6 +84,8 @@ static void dialog_recorder_rec_cb(button_item_t *item);
 static void dialog_recorder_play_cb(button_item_t *item);
 static void dialog_recorder_rename_cb(button_item_t *item);
 static void dialog_recorder_delete_cb(button_item_t *item);
+static void format_cb(button_item_t *item);
+static char * format_label_fn();
 
 static button_item_t btn_rec = {
     .type  = BTN_TEXT,
@@ -95,12 +118,19 @@ static button_item_t btn_play_stop = {
     .press = play_stop_cb,
 };
 
+static button_item_t btn_format = {
+    .type  = BTN_TEXT_FN,
+    .label_fn = format_label_fn,
+    .press = format_cb,
+};
+
 static buttons_page_t btn_page = {
     {
      &btn_rec,
      &btn_rename,
      &btn_delete,
      &btn_play,
+     &btn_format,
      }
 };
 
@@ -125,7 +155,8 @@ static void load_table() {
 
     if (dp != NULL) {
         while ((ep = readdir(dp)) != NULL) {
-            if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) {
+            // Also the index directory
+            if (ep->d_name[0] == '.') {
                 continue;
             }
 
@@ -163,6 +194,39 @@ static const char* get_item() {
     return lv_table_get_cell_value(table, row, col);
 }
 
+/**
+ * Linear interpolation to the play rate, for files of other rates (Opus). Phase and
+ * the last sample are kept between the calls
+ */
+static size_t play_resample(const int16_t *in, size_t n, uint32_t rate, int16_t *out, size_t out_max) {
+    float   step = (float) rate / AUDIO_PLAY_RATE;
+    size_t  idx = 0;
+    size_t  res = 0;
+
+    while (res < out_max) {
+        while (resamp_phase >= 1.0f) {
+            resamp_phase -= 1.0f;
+            idx++;
+        }
+
+        if (idx >= n) {
+            break;
+        }
+
+        int16_t a = idx ? in[idx - 1] : resamp_prev;
+        int16_t b = in[idx];
+
+        out[res++] = a + (b - a) * resamp_phase;
+        resamp_phase += step;
+    }
+
+    if (n) {
+        resamp_prev = in[n - 1];
+    }
+
+    return res;
+}
+
 static void play_item() {
     const char *item = get_item();
 
@@ -191,12 +255,36 @@ static void play_item() {
     }
 
     play_state = true;
+    resamp_phase = 0.0f;
+    resamp_prev = 0;
+    atomic_store(&play_pos, 0);
+    atomic_store(&seek_req, -1);
+
+    // Decodes the file once, if it has no index yet
+    if (rec_index_open(&play_index, filename)) {
+        atomic_store(&index_ready, true);
+    }
 
     while (play_state) {
+        int64_t seek = atomic_exchange(&seek_req, -1);
+
+        if (seek >= 0 && sf_seek(file, seek, SEEK_SET) >= 0) {
+            atomic_store(&play_pos, seek);
+            resamp_phase = 0.0f;
+            resamp_prev = 0;
+        }
+
         int res = sf_read_short(file, samples_buf, BUF_SIZE);
 
         if (res > 0) {
-            audio_play(samples_buf, res);
+            atomic_fetch_add(&play_pos, res);
+        }
+
+        if (res > 0 && sfinfo.samplerate != AUDIO_PLAY_RATE) {
+            res = play_resample(samples_buf, res, sfinfo.samplerate, resamp_buf, BUF_SIZE * 4);
+            audio_play_prio(AUDIO_PLAY_PROMPT, resamp_buf, res);
+        } else if (res > 0) {
+            audio_play_prio(AUDIO_PLAY_PROMPT, samples_buf, res);
         } else {
             play_state = false;
         }
@@ -207,6 +295,7 @@ static void play_item() {
 }
 
 static void * play_thread(void *arg) {
+    set_thread_name("rec_play");
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
@@ -215,7 +304,7 @@ static void * play_thread(void *arg) {
     audio_play_en(false);
 
     if (dialog.run) {
-        scheduler_put_noargs(load_btn_page);
+        scheduler_put_prio(SCHEDULER_PRIO_DISPLAY, load_btn_page, NULL, 0);
 
     }
 }
@@ -240,6 +329,7 @@ static bool textarea_window_edit_ok_cb() {
         snprintf(new, sizeof(new), "%s/%s", recorder_path, new_filename);
 
         if (rename(prev, new) == 0) {
+            rec_index_rename(prev, new);
             load_table();
             textarea_window_close_cb();
         }
@@ -250,6 +340,84 @@ static bool textarea_window_edit_ok_cb() {
     return true;
 }
 
+/**
+ * Seek the playback from the current position
+ */
+static void seek_by(int32_t sec) {
+    if (!play_state || !atomic_load(&index_ready)) {
+        return;
+    }
+
+    int64_t pos = (int64_t) atomic_load(&play_pos) + (int64_t) sec * play_index.rate;
+
+    atomic_store(&seek_req, LV_CLAMP(0, pos, (int64_t) play_index.frames));
+}
+
+static void overview_draw_cb(lv_event_t * e) {
+    lv_obj_t            *obj = lv_event_get_target(e);
+    lv_draw_ctx_t       *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_area_t           coords;
+    lv_draw_line_dsc_t  line_dsc;
+
+    if (!atomic_load(&index_ready) || play_index.points == 0) {
+        return;
+    }
+
+    lv_obj_get_coords(obj, &coords);
+    lv_draw_line_dsc_init(&line_dsc);
+    line_dsc.color = lv_palette_main(LV_PALETTE_BLUE);
+    line_dsc.width = 1;
+
+    lv_coord_t  w = lv_area_get_width(&coords);
+    lv_coord_t  h = lv_area_get_height(&coords);
+    lv_coord_t  mid = coords.y1 + h / 2;
+
+    for (lv_coord_t x = 0; x < w; x++) {
+        uint32_t    from = (uint64_t) x * play_index.points / w;
+        uint32_t    to = LV_MAX((uint64_t) (x + 1) * play_index.points / w, from + 1);
+        int16_t     min = INT16_MAX;
+        int16_t     max = INT16_MIN;
+
+        for (uint32_t i = from; i < to && i < play_index.points; i++) {
+            min = LV_MIN(min, play_index.min[i]);
+            max = LV_MAX(max, play_index.max[i]);
+        }
+
+        lv_point_t  p1 = { coords.x1 + x, mid - max * (h / 2) / 32768 };
+        lv_point_t  p2 = { coords.x1 + x, mid - min * (h / 2) / 32768 + 1 };
+
+        lv_draw_line(draw_ctx, &line_dsc, &p1, &p2);
+    }
+
+    /* Playback position */
+    if (play_index.frames) {
+        lv_coord_t  x = coords.x1 + atomic_load(&play_pos) * (w - 1) / play_index.frames;
+        lv_point_t  p1 = { x, coords.y1 };
+        lv_point_t  p2 = { x, coords.y2 };
+
+        line_dsc.color = lv_color_white();
+        line_dsc.width = 2;
+        lv_draw_line(draw_ctx, &line_dsc, &p1, &p2);
+    }
+}
+
+static void overview_press_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+    lv_point_t  point;
+    lv_area_t   coords;
+
+    if (!play_state || !atomic_load(&index_ready)) {
+        return;
+    }
+
+    lv_indev_get_point(lv_indev_get_act(), &point);
+    lv_obj_get_coords(obj, &coords);
+
+    int64_t x = LV_CLAMP(0, point.x - coords.x1, lv_area_get_width(&coords) - 1);
+
+    atomic_store(&seek_req, x * play_index.frames / lv_area_get_width(&coords));
+}
+
 static void tx_cb(lv_event_t * e) {
     if (play_state) {
         play_state = false;
@@ -261,6 +429,7 @@ static void tx_cb(lv_event_t * e) {
 
 static void construct_cb(lv_obj_t *parent) {
     dialog.obj = dialog_init(parent);
+    btn_format.subj = cfg.rec_format.val;
 
     buttons_unload_page();
     buttons_load_page(&btn_page);
@@ -271,7 +440,7 @@ static void construct_cb(lv_obj_t *parent) {
 
     lv_obj_remove_style(table, NULL, LV_STATE_ANY | LV_PART_MAIN);
 
-    lv_obj_set_size(table, 775, 320 - LEVEL_HEIGHT);
+    lv_obj_set_size(table, 775, 320 - LEVEL_HEIGHT - OVERVIEW_HEIGHT - 7);
 
     lv_table_set_col_cnt(table, 1);
     lv_table_set_col_width(table, 0, 770);
@@ -328,13 +497,35 @@ static void construct_cb(lv_obj_t *parent) {
     lv_obj_add_style(level, &style_level_indic, LV_PART_INDICATOR);
 
     lv_obj_set_size(level, 775, LEVEL_HEIGHT);
+    // Waveform of the played file
+    overview = lv_obj_create(dialog.obj);
+    lv_obj_remove_style_all(overview);
+    lv_obj_set_size(overview, OVERVIEW_WIDTH, OVERVIEW_HEIGHT);
+    lv_obj_align_to(overview, table, LV_ALIGN_OUT_BOTTOM_MID, 0, 7);
+    lv_obj_add_flag(overview, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(overview, overview_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(overview, overview_press_cb, LV_EVENT_PRESSED, NULL);
+    cursor_shown = -1;
+
     // lv_obj_set_align(level, LV_ALIGN_BOTTOM_MID);
-    lv_obj_align_to(level, table, LV_ALIGN_OUT_BOTTOM_MID, 0, 7);
+    lv_obj_align_to(level, overview, LV_ALIGN_OUT_BOTTOM_MID, 0, 7);
 
     lv_bar_set_range(level, -60, 0);
     lv_bar_set_value(level, -6, LV_ANIM_OFF);
 
+    overruns_label = lv_label_create(level);
+    lv_obj_set_style_text_color(overruns_label, lv_color_white(), 0);
+    lv_obj_align(overruns_label, LV_ALIGN_RIGHT_MID, -4, 0);
+    lv_label_set_text(overruns_label, "");
+    overruns_shown = 0;
+
+    cost_label = lv_label_create(level);
+    lv_obj_set_style_text_color(cost_label, lv_color_white(), 0);
+    lv_obj_align(cost_label, LV_ALIGN_LEFT_MID, 4, 0);
+
     level_timer = lv_timer_create(update_level_cb, 30, NULL);
+    cost_timer = lv_timer_create(update_cost_cb, 1000, NULL);
+    update_cost_cb(cost_timer);
 
     mkdir(recorder_path, 0755);
     load_table();
@@ -350,6 +541,7 @@ static void destruct_cb() {
     play_state = false;
     textarea_window_close();
     lv_timer_del(level_timer);
+    lv_timer_del(cost_timer);
 }
 
 static void key_cb(lv_event_t * e) {
@@ -360,6 +552,14 @@ static void key_cb(lv_event_t * e) {
             dialog_destruct(&dialog);
             break;
 
+        case LV_KEY_LEFT:
+            seek_by(-REC_INDEX_SEEK_S);
+            break;
+
+        case LV_KEY_RIGHT:
+            seek_by(REC_INDEX_SEEK_S);
+            break;
+
         case KEY_VOL_LEFT_EDIT:
         case KEY_VOL_LEFT_SELECT:
             radio_change_vol(-1);
@@ -382,6 +582,11 @@ static void rec_stop_cb(button_item_t *item) {
 }
 
 static void dialog_recorder_play_cb(button_item_t *item) {
+    // Not drawn meanwhile, the play thread loads the index of the new file
+    atomic_store(&index_ready, false);
+    rec_index_free(&play_index);
+    lv_obj_invalidate(overview);
+
     pthread_create(&thread, NULL, play_thread, NULL);
 
     buttons_unload_page();
@@ -413,6 +618,7 @@ static void dialog_recorder_delete_cb(button_item_t *item) {
         strcat(filename, name);
 
         unlink(filename);
+        rec_index_rename(filename, NULL);
         load_table();
     }
 }
@@ -434,8 +640,60 @@ void dialog_recorder_set_on(bool on) {
 
 static void update_level_cb(lv_timer_t * timer) {
     lv_bar_set_value(level, audio_get_peak_db(), LV_ANIM_OFF);
+
+    // Redraw on the move of the position by a pixel
+    lv_coord_t cursor = -1;
+
+    if (atomic_load(&index_ready) && play_index.frames) {
+        cursor = atomic_load(&play_pos) * (OVERVIEW_WIDTH - 1) / play_index.frames;
+    }
+    if (cursor != cursor_shown) {
+        cursor_shown = cursor;
+        lv_obj_invalidate(overview);
+    }
+
+    uint32_t overruns = recorder_is_on() ? recorder_get_overruns() : 0;
+
+    if (overruns != overruns_shown) {
+        overruns_shown = overruns;
+
+        if (overruns) {
+            lv_label_set_text_fmt(overruns_label, "Dropped: %u", overruns);
+        } else {
+            lv_label_set_text(overruns_label, "");
+        }
+    }
+}
+
+
+/**
+ * Measured cost of the selected format, while recording it is updated live
+ */
+static void update_cost_cb(lv_timer_t * timer) {
+    recorder_format_t   format = subject_get_int(cfg.rec_format.val);
+    float               cpu;
+    uint32_t            bytes;
+
+    if (recorder_get_cost(format, &cpu, &bytes)) {
+        lv_label_set_text_fmt(cost_label, "%s: CPU %.1f%%, %u kB/s", recorder_format_name(format), cpu, bytes / 1000);
+    } else {
+        lv_label_set_text_fmt(cost_label, "%s: not measured yet", recorder_format_name(format));
+    }
 }
 
+static char * format_label_fn() {
+    static char buf[20];
+
+    snprintf(buf, sizeof(buf), "Format:\n%s", recorder_format_name(subject_get_int(cfg.rec_format.val)));
+    return buf;
+}
+
+static void format_cb(button_item_t *item) {
+    int32_t x = subject_get_int(cfg.rec_format.val);
+
+    subject_set_int(cfg.rec_format.val, (x + 1) % RECORDER_FORMATS);
+    update_cost_cb(cost_timer);
+}
 
 static void load_btn_page() {
     buttons_load_page(&btn_page);
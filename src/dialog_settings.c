@@ -8,6 +8,7 @@
 
 #include "dialog_settings.h"
 
+#include "cfg/cfg.h"
 #include "cfg/transverter.h"
 #include "lvgl/lvgl.h"
 #include "dialog.h"
@@ -20,10 +21,17 @@
 #include "clock.h"
 #include "voice.h"
 #include "audio.h"
+#include "audio_stream.h"
+#include "cat.h"
+#include "recorder.h"
+#include "dsp.h"
+#include "spectrum_hires.h"
+#include "memory_scan.h"
 
 #include <sys/time.h>
 #include <time.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -64,7 +72,8 @@ static dialog_t     dialog = {
     .construct_cb = construct_cb,
     .destruct_cb = NULL,
     .audio_cb = NULL,
-    .key_cb = key_cb
+    .key_cb = key_cb,
+    .cache = true
 };
 
 dialog_t            *dialog_settings = &dialog;
@@ -78,6 +87,13 @@ static void bool_update_cb(lv_event_t * e) {
     params_bool_set(var, lv_obj_has_state(obj, LV_STATE_CHECKED));
 }
 
+static void subject_bool_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+    Subject     *subj = lv_event_get_user_data(e);
+
+    subject_set_int(subj, lv_obj_has_state(obj, LV_STATE_CHECKED));
+}
+
 static void uint8_spinbox_update_cb(lv_event_t * e) {
     lv_obj_t        *obj = lv_event_get_target(e);
     params_uint8_t  *var = lv_event_get_user_data(e);
@@ -100,6 +116,40 @@ static void theme_update_cb(lv_event_t * e) {
     styles_set_theme(var->x);
 }
 
+/* Shared refresh, a cached dialog is shown again */
+
+static void set_checked(lv_obj_t *obj, bool x) {
+    if (x) {
+        lv_obj_add_state(obj, LV_STATE_CHECKED);
+    } else {
+        lv_obj_clear_state(obj, LV_STATE_CHECKED);
+    }
+}
+
+static void bool_refresh_cb(lv_event_t * e) {
+    params_bool_t   *var = lv_event_get_user_data(e);
+
+    set_checked(lv_event_get_target(e), var->x);
+}
+
+static void subject_bool_refresh_cb(lv_event_t * e) {
+    Subject     *subj = lv_event_get_user_data(e);
+
+    set_checked(lv_event_get_target(e), subject_get_int(subj));
+}
+
+static void uint8_spinbox_refresh_cb(lv_event_t * e) {
+    params_uint8_t  *var = lv_event_get_user_data(e);
+
+    lv_spinbox_set_value(lv_event_get_target(e), var->x);
+}
+
+static void uint8_dropdown_refresh_cb(lv_event_t * e) {
+    params_uint8_t  *var = lv_event_get_user_data(e);
+
+    lv_dropdown_set_selected(lv_event_get_target(e), var->x);
+}
+
 /* Shared create */
 
 static lv_obj_t * switch_bool(lv_obj_t *parent, params_bool_t *var) {
@@ -109,6 +159,7 @@ static lv_obj_t * switch_bool(lv_obj_t *parent, params_bool_t *var) {
 
     lv_obj_center(obj);
     lv_obj_add_event_cb(obj, bool_update_cb, LV_EVENT_VALUE_CHANGED, var);
+    lv_obj_add_event_cb(obj, bool_refresh_cb, LV_EVENT_REFRESH, var);
 
     if (var->x) {
         lv_obj_add_state(obj, LV_STATE_CHECKED);
@@ -117,6 +168,22 @@ static lv_obj_t * switch_bool(lv_obj_t *parent, params_bool_t *var) {
     return obj;
 }
 
+static lv_obj_t * switch_subject(lv_obj_t *parent, Subject *subj) {
+    lv_obj_t *obj = lv_switch_create(parent);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_center(obj);
+    lv_obj_add_event_cb(obj, subject_bool_update_cb, LV_EVENT_VALUE_CHANGED, subj);
+    lv_obj_add_event_cb(obj, subject_bool_refresh_cb, LV_EVENT_REFRESH, subj);
+
+    if (subject_get_int(subj)) {
+        lv_obj_add_state(obj, LV_STATE_CHECKED);
+    }
+
+    return obj;
+}
+
 static lv_obj_t * spinbox_uint8(lv_obj_t *parent, params_uint8_t *var) {
     lv_obj_t *obj = lv_spinbox_create(parent);
 
@@ -125,6 +192,7 @@ static lv_obj_t * spinbox_uint8(lv_obj_t *parent, params_uint8_t *var) {
     lv_spinbox_set_value(obj, var->x);
     lv_spinbox_set_range(obj, var->min, var->max);
     lv_obj_add_event_cb(obj, uint8_spinbox_update_cb, LV_EVENT_VALUE_CHANGED, var);
+    lv_obj_add_event_cb(obj, uint8_spinbox_refresh_cb, LV_EVENT_REFRESH, var);
 
     return obj;
 }
@@ -135,6 +203,7 @@ static lv_obj_t * dropdown_uint8_custom_cb(lv_obj_t *parent, params_uint8_t *var
     dialog_item(&dialog, obj);
 
     lv_obj_add_event_cb(obj, cb, LV_EVENT_VALUE_CHANGED, var);
+    lv_obj_add_event_cb(obj, uint8_dropdown_refresh_cb, LV_EVENT_REFRESH, var);
 
     lv_obj_t *list = lv_dropdown_get_list(obj);
     lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
@@ -221,6 +290,24 @@ static void datetime_set_rtc_cb(lv_event_t * e) {
 
 }
 
+static void datetime_load() {
+    now = time(NULL);
+    struct tm *t = localtime(&now);
+
+    memcpy(&ts, t, sizeof(ts));
+}
+
+static void datetime_refresh_cb(lv_event_t * e) {
+    datetime_load();
+
+    lv_spinbox_set_value(day, ts.tm_mday);
+    lv_spinbox_set_value(month, ts.tm_mon + 1);
+    lv_spinbox_set_value(year, ts.tm_year + 1900);
+    lv_spinbox_set_value(hour, ts.tm_hour);
+    lv_spinbox_set_value(min, ts.tm_min);
+    lv_spinbox_set_value(sec, ts.tm_sec);
+}
+
 static uint8_t make_date(uint8_t row) {
     lv_obj_t    *obj;
     uint8_t     col = 0;
@@ -696,9 +783,12 @@ static action_items_t long_action_items[] = {
     { .label = " Mute ", .action = ACTION_MUTE },
     { .label = " Voice mode ", .action = ACTION_VOICE_MODE },
     { .label = " Battery info ", .action = ACTION_BAT_INFO },
+    { .label = " Export log ", .action = ACTION_LOG_EXPORT },
+    { .label = " Memory scan ", .action = ACTION_MEM_SCAN },
     { .label = " APP RTTY ", .action = ACTION_APP_RTTY },
     { .label = " APP FT8 ", .action = ACTION_APP_FT8 },
     { .label = " APP SWR Scan ", .action = ACTION_APP_SWRSCAN },
+    { .label = " APP Band sweep ", .action = ACTION_APP_BAND_SWEEP },
     { .label = " APP GPS ", .action = ACTION_APP_GPS },
     { .label = " APP Settings", .action = ACTION_APP_SETTINGS },
     { .label = " APP Recorder", .action = ACTION_APP_RECORDER },
@@ -823,6 +913,7 @@ static action_items_t hmic_action_items[] = {
     { .label = " Battery info ", .action = ACTION_BAT_INFO },
     { .label = " NR toggle ", .action = ACTION_NR_TOGGLE },
     { .label = " NB toggle ", .action = ACTION_NB_TOGGLE },
+    { .label = " Memory scan ", .action = ACTION_MEM_SCAN },
     { .label = NULL, .action = ACTION_NONE }
 };
 
@@ -1246,17 +1337,55 @@ static uint8_t make_waterfall_smooth_scroll(uint8_t row) {
     return row + 1;
 }
 
-static void sp_mode_update_cb(lv_event_t * e) {
-    lv_obj_t *obj = lv_event_get_target(e);
+static void cat_baud_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
 
-    if (lv_obj_has_state(obj, LV_STATE_CHECKED)) {
-        radio_change_spmode(-1);
-    } else {
-        radio_change_spmode(1);
+    subject_set_int(cfg.cat_baud.val, cat_baud_rates[lv_dropdown_get_selected(obj)]);
+}
+
+static uint8_t make_cat_baud(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+    int32_t     baud = subject_get_int(cfg.cat_baud.val);
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "CAT baud rate");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_dropdown_create(grid);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
+
+    lv_dropdown_clear_options(obj);
+    lv_dropdown_set_symbol(obj, NULL);
+
+    for (uint8_t i = 0; i < CAT_BAUD_RATES; i++) {
+        char str[16];
+
+        snprintf(str, sizeof(str), " %i ", cat_baud_rates[i]);
+        lv_dropdown_add_option(obj, str, LV_DROPDOWN_POS_LAST);
+
+        if (cat_baud_rates[i] == baud) {
+            lv_dropdown_set_selected(obj, i);
+        }
     }
+
+    lv_obj_add_event_cb(obj, cat_baud_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    return row + 1;
 }
 
-static uint8_t make_sp_mode(uint8_t row) {
+static uint8_t make_cat_echo(uint8_t row) {
     lv_obj_t    *obj;
     uint8_t     col = 0;
 
@@ -1264,7 +1393,7 @@ static uint8_t make_sp_mode(uint8_t row) {
 
     obj = lv_label_create(grid);
 
-    lv_label_set_text(obj, "Speaker mode");
+    lv_label_set_text(obj, "CAT echo");
     lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
 
     obj = lv_obj_create(grid);
@@ -1275,23 +1404,101 @@ static uint8_t make_sp_mode(uint8_t row) {
     lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
     lv_obj_center(obj);
 
-    obj = lv_switch_create(obj);
+    obj = switch_subject(obj, cfg.cat_echo.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static void cat_transceive_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+    uint16_t    i = lv_dropdown_get_selected(obj);
+
+    subject_set_int(cfg.cat_transceive.val, i == 0 ? 0 : cat_transceive_periods[i - 1]);
+}
+
+static uint8_t make_cat_transceive(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+    int32_t     ms = subject_get_int(cfg.cat_transceive.val);
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "CAT transceive");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_dropdown_create(grid);
 
     dialog_item(&dialog, obj);
 
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
     lv_obj_center(obj);
-    lv_obj_add_event_cb(obj, sp_mode_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
-    if (!params.spmode.x) {
-        lv_obj_add_state(obj, LV_STATE_CHECKED);
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
+
+    lv_dropdown_set_options(obj, " Off ");
+    lv_dropdown_set_symbol(obj, NULL);
+
+    /* A stored value out of the list is snapped to the nearest period */
+    uint8_t nearest = 0;
+
+    for (uint8_t i = 0; i < CAT_TRANSCEIVE_PERIODS; i++) {
+        char str[24];
+
+        snprintf(str, sizeof(str), " Every %i ms ", cat_transceive_periods[i]);
+        lv_dropdown_add_option(obj, str, LV_DROPDOWN_POS_LAST);
+
+        if (abs(cat_transceive_periods[i] - ms) < abs(cat_transceive_periods[nearest] - ms)) {
+            nearest = i;
+        }
     }
+    if (ms > 0) {
+        lv_dropdown_set_selected(obj, nearest + 1);
+
+        if (cat_transceive_periods[nearest] != ms) {
+            subject_set_int(cfg.cat_transceive.val, cat_transceive_periods[nearest]);
+        }
+    } else if (ms < 0) {
+        subject_set_int(cfg.cat_transceive.val, 0);
+    }
+
+    lv_obj_add_event_cb(obj, cat_transceive_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    return row + 1;
+}
+
+static uint8_t make_cat_net(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Network CAT");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = switch_subject(obj, cfg.cat_net.val);
 
     lv_obj_set_width(obj, SMALL_3 - 30);
 
     return row + 1;
 }
 
-static uint8_t make_freq_accel(uint8_t row) {
+static uint8_t make_pan_stream(uint8_t row) {
     lv_obj_t    *obj;
     uint8_t     col = 0;
 
@@ -1299,109 +1506,634 @@ static uint8_t make_freq_accel(uint8_t row) {
 
     obj = lv_label_create(grid);
 
-    lv_label_set_text(obj, "Freq acceleration");
+    lv_label_set_text(obj, "Panadapter stream");
     lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
 
-    obj = dropdown_uint8(grid, &params.freq_accel, " None \n Lite \n Strong");
+    obj = lv_obj_create(grid);
 
-    lv_obj_set_size(obj, SMALL_6, 56);
-    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
     lv_obj_center(obj);
 
+    obj = switch_subject(obj, cfg.pan_stream.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
     return row + 1;
 }
 
-static uint8_t make_theme(uint8_t row) {
+static void audio_stream_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+    uint16_t    i = lv_dropdown_get_selected(obj);
+
+    subject_set_int(cfg.audio_stream.val, i == 0 ? 0 : audio_stream_frames[i - 1]);
+}
+
+static uint8_t make_audio_stream(uint8_t row) {
     lv_obj_t    *obj;
     uint8_t     col = 0;
+    int32_t     ms = subject_get_int(cfg.audio_stream.val);
 
     row_dsc[row] = 54;
 
     obj = lv_label_create(grid);
 
-    lv_label_set_text(obj, "Theme");
+    lv_label_set_text(obj, "Remote audio");
     lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
 
-    obj = dropdown_uint8_custom_cb(grid, &params.theme, " Simple \n Legacy", theme_update_cb);
+    obj = lv_dropdown_create(grid);
+
+    dialog_item(&dialog, obj);
 
     lv_obj_set_size(obj, SMALL_6, 56);
     lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
     lv_obj_center(obj);
 
-    return row + 1;
-}
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
 
-static uint8_t make_delimiter(uint8_t row) {
-    row_dsc[row] = 10;
+    lv_dropdown_set_options(obj, " Off ");
+    lv_dropdown_set_symbol(obj, NULL);
+
+    for (uint8_t i = 0; i < AUDIO_STREAM_FRAMES; i++) {
+        char str[16];
+
+        snprintf(str, sizeof(str), " %i ms frames ", audio_stream_frames[i]);
+        lv_dropdown_add_option(obj, str, LV_DROPDOWN_POS_LAST);
+
+        if (audio_stream_frames[i] == ms) {
+            lv_dropdown_set_selected(obj, i + 1);
+        }
+    }
+
+    lv_obj_add_event_cb(obj, audio_stream_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
     return row + 1;
 }
 
-static void construct_cb(lv_obj_t *parent) {
-    dialog.obj = dialog_init(parent);
+static uint8_t make_iq_server(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
 
-    grid = lv_obj_create(dialog.obj);
+    row_dsc[row] = 54;
 
-    lv_obj_set_layout(grid, LV_LAYOUT_GRID);
+    obj = lv_label_create(grid);
 
-    lv_obj_set_size(grid, 780, 330);
-    lv_obj_set_style_text_color(grid, lv_color_white(), 0);
-    lv_obj_set_style_bg_opa(grid, LV_OPA_TRANSP, LV_PART_MAIN);
-    lv_obj_set_style_border_width(grid, 0, LV_PART_MAIN);
-    lv_obj_set_style_pad_column(grid, SMALL_PAD, 0);
-    lv_obj_set_style_pad_row(grid, 5, 0);
+    lv_label_set_text(obj, "IQ server");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
 
-    lv_obj_center(grid);
+    obj = lv_obj_create(grid);
 
-    uint8_t row = 1;
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
 
-    now = time(NULL);
-    struct tm *t = localtime(&now);
+    obj = switch_subject(obj, cfg.iq_server.val);
 
-    memcpy(&ts, t, sizeof(ts));
+    lv_obj_set_width(obj, SMALL_3 - 30);
 
-    row = make_date(row);
-    row = make_time(row);
+    return row + 1;
+}
 
-    row = make_delimiter(row);
-    row = make_backlight(row);
+static uint8_t make_dx_cluster(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
 
-    row = make_delimiter(row);
-    row = make_line_gain(row);
+    row_dsc[row] = 54;
 
-    row = make_delimiter(row);
-    row = make_mag(row);
+    obj = lv_label_create(grid);
 
-    row = make_delimiter(row);
-    row = make_clock(row);
+    lv_label_set_text(obj, "DX cluster");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
 
-    row = make_delimiter(row);
-    row = make_long_action(row);
+    obj = lv_obj_create(grid);
 
-    row = make_delimiter(row);
-    row = make_hmic_action(row);
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
 
-    row = make_delimiter(row);
-    row = make_audio_gain(row);
+    obj = switch_subject(obj, cfg.dx_cluster.val);
 
-    row = make_delimiter(row);
-    row = make_voice(row);
+    lv_obj_set_width(obj, SMALL_3 - 30);
 
-    row = make_delimiter(row);
-    row = make_auto(row);
+    return row + 1;
+}
 
-    row = make_delimiter(row);
-    row = make_waterfall_line_zoom(row);
-    row = make_waterfall_smooth_scroll(row);
+static uint8_t make_psk_reporter(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
 
-    row = make_delimiter(row);
-    row = make_sp_mode(row);
+    row_dsc[row] = 54;
 
-    row = make_delimiter(row);
-    row = make_freq_accel(row);
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "PSK Reporter");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = switch_subject(obj, cfg.psk_reporter.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static uint8_t make_contest(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Contest");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = switch_subject(obj, cfg.contest.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static uint8_t make_audio_latency(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Low latency audio");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = switch_subject(obj, cfg.audio_low_latency.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static void rec_pre_trigger_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+
+    subject_set_int(cfg.rec_pre_trigger.val, recorder_pre_triggers[lv_dropdown_get_selected(obj)]);
+}
+
+static uint8_t make_rec_pre_trigger(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+    int32_t     pre = subject_get_int(cfg.rec_pre_trigger.val);
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Recorder pre-trigger");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_dropdown_create(grid);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
+
+    lv_dropdown_clear_options(obj);
+    lv_dropdown_set_symbol(obj, NULL);
+
+    for (uint8_t i = 0; i < RECORDER_PRE_TRIGGERS; i++) {
+        char str[16];
+
+        if (recorder_pre_triggers[i]) {
+            snprintf(str, sizeof(str), " %i s ", recorder_pre_triggers[i]);
+        } else {
+            strcpy(str, " Off ");
+        }
+        lv_dropdown_add_option(obj, str, LV_DROPDOWN_POS_LAST);
+
+        if (recorder_pre_triggers[i] == pre) {
+            lv_dropdown_set_selected(obj, i);
+        }
+    }
+
+    lv_obj_add_event_cb(obj, rec_pre_trigger_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    return row + 1;
+}
+
+static void s_meter_speed_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+
+    subject_set_int(cfg.s_meter_ms.val, s_meter_speeds[lv_dropdown_get_selected(obj)]);
+}
+
+static uint8_t make_s_meter_speed(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+    int32_t     ms = subject_get_int(cfg.s_meter_ms.val);
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "S-meter speed");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_dropdown_create(grid);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
+
+    lv_dropdown_clear_options(obj);
+    lv_dropdown_set_symbol(obj, NULL);
+
+    for (uint8_t i = 0; i < S_METER_SPEEDS; i++) {
+        char str[16];
+
+        snprintf(str, sizeof(str), " %i ms ", s_meter_speeds[i]);
+        lv_dropdown_add_option(obj, str, LV_DROPDOWN_POS_LAST);
+
+        if (s_meter_speeds[i] == ms) {
+            lv_dropdown_set_selected(obj, i);
+        }
+    }
+
+    lv_obj_add_event_cb(obj, s_meter_speed_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    return row + 1;
+}
+
+static uint8_t make_sub_rx(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Dual watch");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = switch_subject(obj, cfg.sub_rx.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static void spectrum_hires_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+
+    subject_set_int(cfg.spectrum_hires.val, spectrum_hires_sizes[lv_dropdown_get_selected(obj)]);
+}
+
+static uint8_t make_spectrum_hires(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+    int32_t     size = subject_get_int(cfg.spectrum_hires.val);
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Hi-res spectrum");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_dropdown_create(grid);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
+
+    lv_dropdown_clear_options(obj);
+    lv_dropdown_set_symbol(obj, NULL);
+
+    for (uint8_t i = 0; i < SPECTRUM_HIRES_SIZES; i++) {
+        char str[16];
+
+        if (spectrum_hires_sizes[i]) {
+            snprintf(str, sizeof(str), " %i ", spectrum_hires_sizes[i]);
+        } else {
+            strcpy(str, " Off ");
+        }
+        lv_dropdown_add_option(obj, str, LV_DROPDOWN_POS_LAST);
+
+        if (spectrum_hires_sizes[i] == size) {
+            lv_dropdown_set_selected(obj, i);
+        }
+    }
+
+    lv_obj_add_event_cb(obj, spectrum_hires_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    return row + 1;
+}
+
+static const char *mem_scan_sql_labels[MEMORY_SCAN_SQL_LEVELS] = { " S3 ", " S5 ", " S7 ", " S9 ", " S9+20 " };
+
+static void mem_scan_sql_update_cb(lv_event_t * e) {
+    lv_obj_t    *obj = lv_event_get_target(e);
+
+    subject_set_int(cfg.mem_scan_sql.val, memory_scan_sql_levels[lv_dropdown_get_selected(obj)]);
+}
+
+static uint8_t make_mem_scan_sql(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+    int32_t     db = subject_get_int(cfg.mem_scan_sql.val);
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Scan squelch");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_dropdown_create(grid);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    lv_obj_t *list = lv_dropdown_get_list(obj);
+    lv_obj_add_style(list, &dialog_dropdown_list_style, 0);
+
+    lv_dropdown_clear_options(obj);
+    lv_dropdown_set_symbol(obj, NULL);
+
+    for (uint8_t i = 0; i < MEMORY_SCAN_SQL_LEVELS; i++) {
+        lv_dropdown_add_option(obj, mem_scan_sql_labels[i], LV_DROPDOWN_POS_LAST);
+
+        if (memory_scan_sql_levels[i] == db) {
+            lv_dropdown_set_selected(obj, i);
+        }
+    }
+
+    lv_obj_add_event_cb(obj, mem_scan_sql_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    return row + 1;
+}
+
+static void sp_mode_update_cb(lv_event_t * e) {
+    lv_obj_t *obj = lv_event_get_target(e);
+
+    if (lv_obj_has_state(obj, LV_STATE_CHECKED)) {
+        radio_change_spmode(-1);
+    } else {
+        radio_change_spmode(1);
+    }
+}
+
+static void sp_mode_refresh_cb(lv_event_t * e) {
+    set_checked(lv_event_get_target(e), !params.spmode.x);
+}
+
+static uint8_t make_sp_mode(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Speaker mode");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = lv_switch_create(obj);
+
+    dialog_item(&dialog, obj);
+
+    lv_obj_center(obj);
+    lv_obj_add_event_cb(obj, sp_mode_update_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_obj_add_event_cb(obj, sp_mode_refresh_cb, LV_EVENT_REFRESH, NULL);
+
+    if (!params.spmode.x) {
+        lv_obj_add_state(obj, LV_STATE_CHECKED);
+    }
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static uint8_t make_freq_accel(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Freq acceleration");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = dropdown_uint8(grid, &params.freq_accel, " None \n Lite \n Strong");
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    return row + 1;
+}
+
+static uint8_t make_profiler(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Profiler");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = lv_obj_create(grid);
+
+    lv_obj_set_size(obj, SMALL_3, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 4, 3, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_center(obj);
+
+    obj = switch_subject(obj, cfg.profiler.val);
+
+    lv_obj_set_width(obj, SMALL_3 - 30);
+
+    return row + 1;
+}
+
+static uint8_t make_theme(uint8_t row) {
+    lv_obj_t    *obj;
+    uint8_t     col = 0;
+
+    row_dsc[row] = 54;
+
+    obj = lv_label_create(grid);
+
+    lv_label_set_text(obj, "Theme");
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, col++, 1, LV_GRID_ALIGN_CENTER, row, 1);
+
+    obj = dropdown_uint8_custom_cb(grid, &params.theme, " Simple \n Legacy", theme_update_cb);
+
+    lv_obj_set_size(obj, SMALL_6, 56);
+    lv_obj_set_grid_cell(obj, LV_GRID_ALIGN_START, 1, 6, LV_GRID_ALIGN_CENTER, row, 1);
+    lv_obj_center(obj);
+
+    return row + 1;
+}
+
+static uint8_t make_delimiter(uint8_t row) {
+    row_dsc[row] = 10;
+
+    return row + 1;
+}
+
+static void construct_cb(lv_obj_t *parent) {
+    dialog.obj = dialog_init(parent);
+
+    grid = lv_obj_create(dialog.obj);
+
+    lv_obj_set_layout(grid, LV_LAYOUT_GRID);
+
+    lv_obj_set_size(grid, 780, 330);
+    lv_obj_set_style_text_color(grid, lv_color_white(), 0);
+    lv_obj_set_style_bg_opa(grid, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_set_style_border_width(grid, 0, LV_PART_MAIN);
+    lv_obj_set_style_pad_column(grid, SMALL_PAD, 0);
+    lv_obj_set_style_pad_row(grid, 5, 0);
+
+    lv_obj_center(grid);
+
+    uint8_t row = 1;
+
+    datetime_load();
+    lv_obj_add_event_cb(dialog.obj, datetime_refresh_cb, LV_EVENT_REFRESH, NULL);
+
+    row = make_date(row);
+    row = make_time(row);
+
+    row = make_delimiter(row);
+    row = make_backlight(row);
+
+    row = make_delimiter(row);
+    row = make_line_gain(row);
+
+    row = make_delimiter(row);
+    row = make_mag(row);
+
+    row = make_delimiter(row);
+    row = make_clock(row);
+
+    row = make_delimiter(row);
+    row = make_long_action(row);
+
+    row = make_delimiter(row);
+    row = make_hmic_action(row);
+
+    row = make_delimiter(row);
+    row = make_audio_gain(row);
+    row = make_audio_latency(row);
+    row = make_rec_pre_trigger(row);
+
+    row = make_delimiter(row);
+    row = make_voice(row);
+
+    row = make_delimiter(row);
+    row = make_auto(row);
+
+    row = make_delimiter(row);
+    row = make_waterfall_line_zoom(row);
+    row = make_waterfall_smooth_scroll(row);
+    row = make_s_meter_speed(row);
+    row = make_spectrum_hires(row);
+    row = make_sub_rx(row);
+    row = make_mem_scan_sql(row);
+
+    row = make_delimiter(row);
+    row = make_sp_mode(row);
+
+    row = make_delimiter(row);
+    row = make_freq_accel(row);
+
+    row = make_delimiter(row);
+    row = make_cat_baud(row);
+    row = make_cat_echo(row);
+    row = make_cat_transceive(row);
+    row = make_cat_net(row);
+    row = make_pan_stream(row);
+    row = make_audio_stream(row);
+    row = make_iq_server(row);
+    row = make_dx_cluster(row);
+    row = make_psk_reporter(row);
+
+    row = make_delimiter(row);
+    row = make_contest(row);
 
     row = make_delimiter(row);
     row = make_theme(row);
+    row = make_profiler(row);
 
     row = make_delimiter(row);
 
@@ -17,6 +17,8 @@
 #include "keyboard.h"
 #include "main_screen.h"
 #include "buttons.h"
+#include "scheduler.h"
+#include "cfg/swrscan.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -25,9 +27,26 @@
 
 #define STEPS   50
 
+/* Adaptive sweep: a coarse pass, then bisection where SWR changes or has its minimum */
+#define GRID            256         /* Resolution, span / GRID */
+#define COARSE_STEP     16
+#define MAX_POINTS      CFG_SWRSCAN_MAX_POINTS
+#define SETTLE_PACKETS  3           /* Readings skipped after a retune */
+
 static lv_obj_t             *chart;
 static float                data[STEPS];
 static float                data_filtered[STEPS];
+static bool                 data_full;              /* Linear sweep passed the whole span */
+
+static float                grid[GRID + 1];         /* NAN if not measured */
+static uint16_t             grid_points;
+static int16_t              grid_pos;
+static uint8_t              settle;
+
+/* Last sweep of the antenna and band, shown until a new one is started */
+static cfg_swrscan_point_t  cache[MAX_POINTS];
+static uint16_t             cache_count;
+static bool                 live = false;
 
 static lv_coord_t           w;
 static lv_coord_t           h;
@@ -40,11 +59,13 @@ static uint32_t             freq_center;
 static uint32_t             freq_stop;
 
 static bool    linear;
+static bool    adaptive;
 static int32_t span;
 
 static ObserverDelayed *freq_obs;
 static ObserverDelayed *linear_obs;
 static ObserverDelayed *span_obs;
+static ObserverDelayed *adaptive_obs;
 
 static void construct_cb(lv_obj_t *parent);
 static void destruct_cb();
@@ -53,12 +74,15 @@ static void key_cb(lv_event_t * e);
 static void dialog_swrscan_run_cb(button_item_t *item);
 static void dialog_swrscan_scale_cb(button_item_t *item);
 static void dialog_swrscan_span_cb(button_item_t *item);
+static void dialog_swrscan_sweep_cb(button_item_t *item);
 
 static void set_span(Subject *subj, void *user_data);
 static void set_linear(Subject *subj, void *user_data);
+static void set_adaptive(Subject *subj, void *user_data);
 
 static char *scale_label_fn();
 static char *span_label_fn();
+static char *sweep_label_fn();
 
 static button_item_t btn_run = {
     .type  = BTN_TEXT,
@@ -76,11 +100,18 @@ static button_item_t btn_span = {
     .press = dialog_swrscan_span_cb,
 };
 
+static button_item_t btn_sweep = {
+    .type  = BTN_TEXT_FN,
+    .label_fn = sweep_label_fn,
+    .press = dialog_swrscan_sweep_cb,
+};
+
 static buttons_page_t btn_page = {
     {
      &btn_run,
      &btn_scale,
      &btn_span,
+     &btn_sweep,
      }
 };
 
@@ -100,6 +131,14 @@ static void do_init() {
         data[i] = 1.0f;
         data_filtered[i] = 1.0f;
     }
+    data_full = false;
+
+    for (uint16_t i = 0; i <= GRID; i++) {
+        grid[i] = NAN;
+    }
+    grid_points = 0;
+    grid_pos = 0;
+    settle = SETTLE_PACKETS;
 
     freq_index = 0;
     freq_center = subject_get_int(cfg_cur.fg_freq);
@@ -108,6 +147,130 @@ static void do_init() {
     freq_stop = freq_center + span / 2;
 }
 
+static uint32_t grid_freq(int16_t pos) {
+    return freq_start + (uint64_t) (freq_stop - freq_start) * pos / GRID;
+}
+
+static void cache_load() {
+    cache_count = cfg_swrscan_load(subject_get_int(cfg.ant_id.val), subject_get_int(cfg.band_id.val),
+                                   cache, MAX_POINTS);
+}
+
+/**
+ * Keep the result of the sweep, called when it is stopped or done
+ */
+static void cache_save() {
+    cache_count = 0;
+
+    if (adaptive) {
+        for (uint16_t i = 0; i <= GRID; i++) {
+            if (!isnan(grid[i])) {
+                cache[cache_count++] = (cfg_swrscan_point_t) { .freq = grid_freq(i), .vswr = grid[i] };
+            }
+        }
+    } else if (data_full) {
+        for (uint16_t i = 0; i < STEPS; i++) {
+            cache[cache_count++] = (cfg_swrscan_point_t) {
+                .freq = freq_start + (freq_stop - freq_start) * i / STEPS,
+                .vswr = data_filtered[i]
+            };
+        }
+    }
+
+    if (cache_count > 1) {
+        cfg_swrscan_save(subject_get_int(cfg.ant_id.val), subject_get_int(cfg.band_id.val), cache, cache_count);
+    } else {
+        cache_load();
+    }
+}
+
+/**
+ * Next grid position to measure, -1 when the sweep is done
+ */
+static int16_t adaptive_next() {
+    if (grid_points >= MAX_POINTS) {
+        return -1;
+    }
+
+    for (int16_t i = 0; i <= GRID; i += COARSE_STEP) {
+        if (isnan(grid[i])) {
+            return i;
+        }
+    }
+
+    int16_t min = 0;
+
+    for (int16_t i = 0; i <= GRID; i++) {
+        if (!isnan(grid[i]) && grid[i] < grid[min]) {
+            min = i;
+        }
+    }
+
+    /* Widest interval weighted by its SWR change, the ones around the minimum first */
+    int16_t best = -1;
+    float   best_score = 0.0f;
+    int16_t prev = 0;
+
+    for (int16_t i = 1; i <= GRID; i++) {
+        if (isnan(grid[i])) {
+            continue;
+        }
+
+        int16_t gap = i - prev;
+
+        if (gap > 1) {
+            float score = fabsf(grid[i] - grid[prev]);
+
+            if (prev == min || i == min) {
+                score += 1.0f;
+            }
+            score *= gap;
+
+            if (score > best_score) {
+                best_score = score;
+                best = prev + gap / 2;
+            }
+        }
+        prev = i;
+    }
+
+    return best;
+}
+
+static void sweep_done_cb(void *arg) {
+    if (run) {
+        dialog_swrscan_run_cb(NULL);
+    }
+}
+
+static void adaptive_step(float vswr) {
+    if (settle) {
+        settle--;
+        return;
+    }
+
+    if (grid_pos < 0) {
+        return;
+    }
+
+    if (isnan(grid[grid_pos])) {
+        grid_points++;
+    }
+    grid[grid_pos] = vswr;
+
+    event_send(chart, LV_EVENT_REFRESH, NULL);
+
+    grid_pos = adaptive_next();
+
+    if (grid_pos < 0) {
+        scheduler_put_noargs(sweep_done_cb);
+        return;
+    }
+
+    settle = SETTLE_PACKETS;
+    radio_set_freq(grid_freq(grid_pos));
+}
+
 static void do_step(float vswr) {
     data[freq_index] = vswr;
     int16_t filtered_index = (STEPS + freq_index - 2) % STEPS;
@@ -130,6 +293,7 @@ static void do_step(float vswr) {
 
     if (freq_index == STEPS) {
         freq_index = 0;
+        data_full = true;
     }
 
     uint32_t freq = freq_start + (freq_stop - freq_start) * freq_index / STEPS;
@@ -230,19 +394,54 @@ static void draw_cb(lv_event_t * e) {
     line_dsc.color = lv_color_white();
     line_dsc.width = 4;
 
-    for (uint16_t i = 1; i < STEPS; i++) {
-        a.x = x1 + (i - 1) * w / STEPS;
-        a.y = y1 + calc_y(data_filtered[i-1]);
+    if (!live) {
+        /* Last sweep, placed by freq on the current span */
+        for (uint16_t i = 1; i < cache_count; i++) {
+            a.x = x1 + ((int64_t) cache[i - 1].freq - (int64_t) freq_start) * w / span;
+            a.y = y1 + calc_y(cache[i - 1].vswr);
 
-        b.x = x1 + (i) * w / STEPS;
-        b.y = y1 + calc_y(data_filtered[i]);
+            b.x = x1 + ((int64_t) cache[i].freq - (int64_t) freq_start) * w / span;
+            b.y = y1 + calc_y(cache[i].vswr);
 
-        lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+            if (b.x < x1 || a.x > x1 + w) {
+                continue;
+            }
+            lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+        }
+    } else if (adaptive) {
+        int16_t prev = -1;
+
+        for (int16_t i = 0; i <= GRID; i++) {
+            if (isnan(grid[i])) {
+                continue;
+            }
+            if (prev >= 0) {
+                a.x = x1 + prev * w / GRID;
+                a.y = y1 + calc_y(grid[prev]);
+
+                b.x = x1 + i * w / GRID;
+                b.y = y1 + calc_y(grid[i]);
+
+                lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+            }
+            prev = i;
+        }
+    } else {
+        for (uint16_t i = 1; i < STEPS; i++) {
+            a.x = x1 + (i - 1) * w / STEPS;
+            a.y = y1 + calc_y(data_filtered[i-1]);
+
+            b.x = x1 + (i) * w / STEPS;
+            b.y = y1 + calc_y(data_filtered[i]);
+
+            lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+        }
     }
 }
 
 static void freq_update_cb(Subject *subj, void *user_data) {
     do_init();
+    live = false;
     lv_obj_invalidate(chart);
 }
 
@@ -250,8 +449,10 @@ static void construct_cb(lv_obj_t *parent) {
     dialog.obj = dialog_init(parent);
     btn_scale.subj = cfg.swrscan_linear.val;
     btn_span.subj = cfg.swrscan_span.val;
+    btn_sweep.subj = cfg.swrscan_adaptive.val;
     linear_obs = subject_add_delayed_observer_and_call(cfg.swrscan_linear.val, set_linear, NULL);
     span_obs = subject_add_delayed_observer_and_call(cfg.swrscan_span.val, set_span, NULL);
+    adaptive_obs = subject_add_delayed_observer_and_call(cfg.swrscan_adaptive.val, set_adaptive, NULL);
 
     buttons_unload_page();
     buttons_load_page(&btn_page);
@@ -274,6 +475,8 @@ static void construct_cb(lv_obj_t *parent) {
     lv_obj_add_event_cb(chart, key_cb, LV_EVENT_KEY, NULL);
 
     do_init();
+    live = false;
+    cache_load();
 }
 
 static void destruct_cb() {
@@ -293,6 +496,10 @@ static void destruct_cb() {
         observer_delayed_del(span_obs);
         span_obs = NULL;
     }
+    if (adaptive_obs) {
+        observer_delayed_del(adaptive_obs);
+        adaptive_obs = NULL;
+    }
     radio_set_freq(subject_get_int(cfg_cur.fg_freq));
 }
 
@@ -322,12 +529,15 @@ void dialog_swrscan_run_cb(button_item_t *item) {
         radio_stop_swrscan();
         radio_set_freq(freq_center);
         mem_load(MEM_BACKUP_ID);
+        cache_save();
     } else {
         mem_save(MEM_BACKUP_ID);
         do_init();
+        live = true;
         radio_set_freq(freq_start);
         run = radio_start_swrscan();
     }
+    lv_obj_invalidate(chart);
 }
 
 void dialog_swrscan_scale_cb(button_item_t *item) {
@@ -362,9 +572,19 @@ void dialog_swrscan_span_cb(button_item_t *item) {
     subject_set_int(cfg.swrscan_span.val, span);
 
     do_init();
+    live = false;
     event_send(chart, LV_EVENT_REFRESH, NULL);
 }
 
+void dialog_swrscan_sweep_cb(button_item_t *item) {
+    if (run) {
+        return;
+    }
+
+    bool new_val = !subject_get_int(cfg.swrscan_adaptive.val);
+    subject_set_int(cfg.swrscan_adaptive.val, new_val);
+}
+
 void set_span(Subject *subj, void *user_data) {
     span = subject_get_int(subj);
 }
@@ -373,6 +593,10 @@ void set_linear(Subject *subj, void *user_data) {
     linear = subject_get_int(subj);
 }
 
+void set_adaptive(Subject *subj, void *user_data) {
+    adaptive = subject_get_int(subj);
+}
+
 char *scale_label_fn() {
     if (subject_get_int(cfg.swrscan_linear.val)) {
         return "Scale:\nLinear";
@@ -381,6 +605,14 @@ char *scale_label_fn() {
     }
 }
 
+char *sweep_label_fn() {
+    if (subject_get_int(cfg.swrscan_adaptive.val)) {
+        return "Sweep:\nAdaptive";
+    } else {
+        return "Sweep:\nLinear";
+    }
+}
+
 char *span_label_fn() {
     static char buf[20];
     const char * fmt = "Span:\n%u kHz";
@@ -390,7 +622,12 @@ char *span_label_fn() {
 }
 
 void dialog_swrscan_update(float vswr) {
-    if (run) {
+    if (!run) {
+        return;
+    }
+    if (adaptive) {
+        adaptive_step(vswr);
+    } else {
         do_step(vswr);
     }
 }
@@ -21,6 +21,7 @@
 #include "lvgl/lvgl.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DIALOG_WIDTH 775
 #define DIALOG_HEIGHT 320
@@ -54,18 +55,15 @@ static char *wifi_connected_label_getter();
 static char *wifi_con_change_passwd_label_getter();
 static char *wifi_con_delete_label_getter();
 
-static void start_refresh_ap_list();
-static void stop_refresh_ap_list();
-static void update_aps_table_cb(lv_timer_t *);
-
-static int compare_aps(const void *a, const void *b);
+static void update_aps_table();
+static void clear_aps_table();
 
 static void keyboard_open();
 static bool keyboard_cancel_cb();
 static bool keyboard_ok_cb();
 static void keyboard_close();
 
-static void update_status_cb(lv_timer_t *);
+static void update_ip_labels();
 static void wifi_state_changed_cb(void *s, lv_msg_t *m);
 
 static button_item_t btn_on_off = {
@@ -103,8 +101,6 @@ static buttons_page_t btn_page = {
      }
 };
 
-static lv_timer_t *timer_refresh_ap = NULL;
-static lv_timer_t *timer_status = NULL;
 static void       *subscription = NULL;
 
 static lv_obj_t *ap_table;
@@ -133,10 +129,6 @@ dialog_t *dialog_wifi = &dialog;
 static void construct_cb(lv_obj_t *parent) {
     dialog.obj = dialog_init(parent);
 
-    if (params.wifi_enabled.x) {
-        start_refresh_ap_list();
-    }
-
     // Container
     lv_obj_t *cont = lv_obj_create(dialog.obj);
     lv_obj_remove_style(cont, NULL, LV_STATE_ANY | LV_PART_MAIN);
@@ -215,12 +207,7 @@ static void destruct_cb() {
         lv_msg_unsubscribe(subscription);
         subscription = NULL;
     }
-    if (timer_status) {
-        lv_timer_del(timer_status);
-        timer_status = NULL;
-    }
     keyboard_close();
-    stop_refresh_ap_list();
 }
 
 static void key_cb(lv_event_t *e) {
@@ -275,16 +262,10 @@ static void wifi_bt_toggle_cb(button_item_t *item) {
     if (disable_buttons)
         return;
     if (params.wifi_enabled.x) {
-        stop_refresh_ap_list();
         wifi_power_off();
-        // clear table
-        lv_table_set_cell_value(ap_table, 0, 0, "");
-        lv_table_set_cell_user_data(ap_table, 0, 0, NULL);
-        lv_table_set_row_cnt(ap_table, 1);
-        lv_event_send(ap_table, LV_EVENT_VALUE_CHANGED, NULL);
+        clear_aps_table();
     } else {
         wifi_power_on();
-        start_refresh_ap_list();
         msg_update_text_fmt("Turning on");
     }
 }
@@ -440,62 +421,141 @@ static char *wifi_con_delete_label_getter() {
     }
 }
 
-static void start_refresh_ap_list() {
-    timer_refresh_ap = lv_timer_create(update_aps_table_cb, 1000, NULL);
+/* AP table, a row per BSSID. Cells keep their own copy of the AP info */
+
+typedef struct {
+    wifi_ap_info_t  *info;
+    int             score;
+    uint16_t        row;        /* Current row of the BSSID, UINT16_MAX for a new one */
+} ap_item_t;
+
+static int ap_score(const wifi_ap_info_t *ap) {
+    return ap->is_connected * 2 + ap->known;
 }
 
-static void stop_refresh_ap_list() {
-    if (timer_refresh_ap) {
-        lv_timer_del(timer_refresh_ap);
-        timer_refresh_ap = NULL;
+/**
+ * Connected and known first. APs of the same rank keep their rows, so a rescan
+ * doesn't shuffle the table
+ */
+static int compare_aps(const void *a, const void *b) {
+    const ap_item_t *item_a = (const ap_item_t *)a;
+    const ap_item_t *item_b = (const ap_item_t *)b;
+
+    if (item_a->score != item_b->score) {
+        return item_b->score - item_a->score;
+    }
+    if (item_a->row != item_b->row) {
+        return item_a->row < item_b->row ? -1 : 1;
     }
+    return strcmp(item_a->info->bssid, item_b->info->bssid);
 }
 
-static void update_aps_table_cb(lv_timer_t *t) {
-    wifi_ap_arr_t aps_info;
-    uint16_t      row;
-    bool          first_known = true;
+static wifi_ap_info_t *row_ap(uint16_t row) {
+    return (wifi_ap_info_t *)lv_table_get_cell_user_data(ap_table, row, 0);
+}
+
+static uint16_t find_row(const char *bssid, uint16_t rows) {
+    for (uint16_t row = 0; row < rows; row++) {
+        wifi_ap_info_t *ap = row_ap(row);
+
+        if (ap && strcmp(ap->bssid, bssid) == 0) {
+            return row;
+        }
+    }
+    return UINT16_MAX;
+}
+
+static void set_row_text(uint16_t row, const wifi_ap_info_t *ap) {
+    lv_table_set_cell_value_fmt(ap_table, row, 0, "%s %s", ap->ssid, ap->is_connected ? " (*)" : "");
+}
+
+static void clear_aps_table() {
+    lv_table_set_cell_value(ap_table, 0, 0, "");
+    lv_table_set_cell_user_data(ap_table, 0, 0, NULL);
+    lv_table_set_row_cnt(ap_table, 1);
+    lv_event_send(ap_table, LV_EVENT_VALUE_CHANGED, NULL);
+}
+
+/**
+ * Apply the AP snapshot to the table row by row. Unchanged rows are left
+ * alone, a new signal level only updates the cell info and redraws the bars
+ */
+static void update_aps_table() {
+    wifi_ap_arr_t   aps_info;
+    ap_item_t       *items = NULL;
+    uint16_t        rows = lv_table_get_row_cnt(ap_table);
+    uint16_t        sel_row, sel_col;
+    bool            sel_changed = false;
+    bool            redraw = false;
 
     if (!params.wifi_enabled.x) {
-        stop_refresh_ap_list();
+        if (rows > 1 || row_ap(0)) {
+            clear_aps_table();
+        }
+        return;
     }
 
     aps_info = wifi_get_available_access_points();
+
     if (aps_info.count) {
-        qsort(aps_info.ap_arr, aps_info.count, sizeof(wifi_ap_info_t), compare_aps);
+        items = (ap_item_t *)malloc(sizeof(ap_item_t) * aps_info.count);
+
+        for (uint16_t i = 0; i < aps_info.count; i++) {
+            items[i].info = &aps_info.ap_arr[i];
+            items[i].score = ap_score(items[i].info);
+            items[i].row = find_row(items[i].info->bssid, rows);
+        }
+        qsort(items, aps_info.count, sizeof(ap_item_t), compare_aps);
+    }
+
+    lv_table_get_selected_cell(ap_table, &sel_row, &sel_col);
+
+    for (uint16_t row = 0; row < aps_info.count; row++) {
+        const wifi_ap_info_t    *ap = items[row].info;
+        wifi_ap_info_t          *cur = row < rows ? row_ap(row) : NULL;
+
+        if (cur && strcmp(cur->bssid, ap->bssid) == 0) {
+            if (strcmp(cur->ssid, ap->ssid) != 0 || cur->is_connected != ap->is_connected) {
+                set_row_text(row, ap);
+            }
+            if (cur->known != ap->known || cur->password_validator != ap->password_validator) {
+                sel_changed |= row == sel_row;
+            }
+            redraw |= cur->strength != ap->strength;
+            *cur = *ap;
+        } else {
+            wifi_ap_info_t *copy = (wifi_ap_info_t *)lv_mem_alloc(sizeof(wifi_ap_info_t));
+
+            *copy = *ap;
+            set_row_text(row, ap);
+            lv_table_set_cell_user_data(ap_table, row, 0, copy);
+            sel_changed |= row == sel_row;
+        }
     }
-    row = 0;
-
-    for (uint16_t i = 0; i < aps_info.count; i++) {
-        lv_table_set_cell_value_fmt(ap_table, row++, 0, "%s %s", aps_info.ap_arr[i].ssid,
-                                    aps_info.ap_arr[i].is_connected ? " (*)" : "");
-        wifi_ap_info_t *copy = (wifi_ap_info_t *)malloc(sizeof(wifi_ap_info_t));
-        *copy = aps_info.ap_arr[i];
-        lv_table_set_cell_user_data(ap_table, row - 1, 0, (void *)copy);
+
+    if (items) {
+        free(items);
     }
 
-    if (row > 0) {
-        lv_table_set_row_cnt(ap_table, row);
+    if (aps_info.count == 0) {
+        if (rows > 1 || row_ap(0)) {
+            clear_aps_table();
+        }
     } else {
-        lv_table_set_cell_value(ap_table, 0, 0, "");
-        lv_table_set_cell_user_data(ap_table, 0, 0, NULL);
-        lv_table_set_row_cnt(ap_table, 1);
+        if (aps_info.count != rows) {
+            sel_changed |= sel_row != LV_TABLE_CELL_NONE && sel_row >= aps_info.count;
+            lv_table_set_row_cnt(ap_table, aps_info.count);
+        }
+        if (redraw) {
+            lv_obj_invalidate(ap_table);
+        }
+        if (sel_changed) {
+            lv_event_send(ap_table, LV_EVENT_VALUE_CHANGED, NULL);
+        }
     }
-    lv_event_send(ap_table, LV_EVENT_VALUE_CHANGED, NULL);
     wifi_aps_info_delete(aps_info);
 }
 
-static int compare_aps(const void *a, const void *b) {
-    int score_a = ((wifi_ap_info_t *)a)->is_connected * 2 + ((wifi_ap_info_t *)a)->known;
-    int score_b = ((wifi_ap_info_t *)b)->is_connected * 2 + ((wifi_ap_info_t *)b)->known;
-    if (score_a == score_b)
-        return 0;
-    else if (score_a < score_b)
-        return 1;
-    else
-        return -1;
-}
-
 static void keyboard_open() {
     lv_group_remove_obj(ap_table);
     textarea_window_open(keyboard_ok_cb, keyboard_cancel_cb);
@@ -541,28 +601,25 @@ static bool keyboard_ok_cb() {
     return true;
 }
 
-static void update_status_cb(lv_timer_t *t) {
+static void update_ip_labels() {
     char  ip_address[16];
     char  gateway[16];
     char *ip_addr_p = ip_address;
     char *gateway_p = gateway;
-    bool  res;
-    res = wifi_get_ipaddr(&ip_addr_p, &gateway_p);
-    if (res == (wifi_get_status() == WIFI_CONNECTED)) {
-        if (res) {
-            lv_label_set_text(label_ip_addr, ip_address);
-            lv_label_set_text(label_gateway, gateway);
-        } else {
-            lv_label_set_text(label_ip_addr, "N/A");
-            lv_label_set_text(label_gateway, "N/A");
-        }
-        if (timer_status) {
-            lv_timer_del(timer_status);
-            timer_status = NULL;
-        }
+
+    if (wifi_get_ipaddr(&ip_addr_p, &gateway_p)) {
+        lv_label_set_text(label_ip_addr, ip_address);
+        lv_label_set_text(label_gateway, gateway);
+    } else {
+        lv_label_set_text(label_ip_addr, "N/A");
+        lv_label_set_text(label_gateway, "N/A");
     }
 }
 
+/**
+ * Sent by the wifi thread on libnm signals (APs, signal level, device and
+ * IP config changes) and by the dialog itself on a new selection
+ */
 static void wifi_state_changed_cb(void *s, lv_msg_t *m) {
     const char *status_text;
     for (size_t i = 0; i < SIZE_OF_ARRAY(btn_page.items); i++) {
@@ -588,9 +645,8 @@ static void wifi_state_changed_cb(void *s, lv_msg_t *m) {
         status_text = "Disconnected";
     }
     lv_label_set_text(label_status, status_text);
-    if (!timer_status) {
-        timer_status = lv_timer_create(update_status_cb, 100, NULL);
-    }
+    update_ip_labels();
+    update_aps_table();
 }
 
 static void ap_table_draw_event_cb(lv_event_t *e) {
@@ -0,0 +1,108 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "display_snapshot.h"
+
+#include "display_snapshot_store.h"
+#include "cfg/cfg.h"
+#include "radio.h"
+#include "dsp.h"
+#include "meter.h"
+#include "spectrum.h"
+#include "waterfall.h"
+#include "waterfall_history.h"
+
+#include "lvgl/lvgl.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+_Static_assert(WATERFALL_NFFT <= DISPLAY_SNAPSHOT_WIDTH, "Waterfall row is wider than the snapshot");
+
+/* ~200 KiB, kept off the stack */
+static display_snapshot_t   snap;
+
+void display_snapshot_save() {
+    float   spectrum[DISPLAY_SNAPSHOT_BINS];
+    uint8_t row[WATERFALL_NFFT];
+
+    snap.time = time(NULL);
+    snap.band_id = subject_get_int(cfg.band_id.val);
+    spectrum_get_range(&snap.spectrum_min, &snap.spectrum_max);
+    waterfall_get_range(&snap.waterfall_min, &snap.waterfall_max);
+
+    if (spectrum_last(spectrum, DISPLAY_SNAPSHOT_BINS)) {
+        for (uint16_t i = 0; i < DISPLAY_SNAPSHOT_BINS; i++) {
+            float db = roundf(spectrum[i]);
+
+            snap.spectrum[i] = (db < S_MIN) ? S_MIN : (db > INT8_MAX) ? INT8_MAX : db;
+        }
+    } else {
+        memset(snap.spectrum, S_MIN, sizeof(snap.spectrum));
+    }
+
+    uint32_t last = wf_history_last();
+    uint32_t first = wf_history_first();
+
+    if (last && last - first + 1 > DISPLAY_SNAPSHOT_ROWS) {
+        first = last - DISPLAY_SNAPSHOT_ROWS + 1;
+    }
+
+    snap.width = WATERFALL_NFFT;
+    snap.rows = 0;
+
+    for (uint32_t seq = first; last && seq <= last; seq++) {
+        if (wf_history_get(seq, row, &snap.freqs[snap.rows])) {
+            display_snapshot_pack(row, WATERFALL_NFFT, snap.packed[snap.rows]);
+            snap.rows++;
+        }
+    }
+
+    if (!display_snapshot_write(DISPLAY_SNAPSHOT_PATH, &snap)) {
+        LV_LOG_WARN("Display snapshot: can't write %s", DISPLAY_SNAPSHOT_PATH);
+    }
+}
+
+void display_snapshot_restore() {
+    if (!display_snapshot_read(DISPLAY_SNAPSHOT_PATH, &snap)) {
+        return;
+    }
+    if (snap.band_id != subject_get_int(cfg.band_id.val)) {
+        LV_LOG_INFO("Display snapshot: of another band");
+        return;
+    }
+
+    spectrum_set_auto_range(snap.spectrum_min, snap.spectrum_max);
+    waterfall_set_auto_range(snap.waterfall_min, snap.waterfall_max);
+
+    int64_t age = (int64_t) time(NULL) - snap.time;
+
+    if (age < 0 || age > DISPLAY_SNAPSHOT_MAX_AGE_S) {
+        LV_LOG_INFO("Display snapshot: range only, %lld s old", (long long) age);
+        return;
+    }
+
+    float spectrum[DISPLAY_SNAPSHOT_BINS];
+
+    for (uint16_t i = 0; i < DISPLAY_SNAPSHOT_BINS; i++) {
+        spectrum[i] = snap.spectrum[i];
+    }
+    spectrum_data(spectrum, NULL, DISPLAY_SNAPSHOT_BINS, false);
+
+    if (snap.width == WATERFALL_NFFT) {
+        uint8_t row[WATERFALL_NFFT];
+
+        for (uint16_t i = 0; i < snap.rows; i++) {
+            display_snapshot_unpack(snap.packed[i], snap.width, row);
+            wf_history_put(row, snap.freqs[i]);
+        }
+        waterfall_redraw();
+    }
+    LV_LOG_USER("Display snapshot: restored, %u rows, %lld s old", snap.rows, (long long) age);
+}
@@ -0,0 +1,26 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+/*
+ * Last spectrum, waterfall rows and auto min/max, saved at power off and
+ * shown at boot until the first data of DSP (display_snapshot_store.h). Only
+ * the state of the same band is restored, and the picture only if it's
+ * younger than DISPLAY_SNAPSHOT_MAX_AGE_S. UI thread.
+ */
+
+#define DISPLAY_SNAPSHOT_PATH       "/mnt/display.x6ds"
+#define DISPLAY_SNAPSHOT_MAX_AGE_S  3600
+
+void display_snapshot_save();
+
+/**
+ * Call after main_screen() and before radio_init()
+ */
+void display_snapshot_restore();
@@ -0,0 +1,126 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "display_snapshot_store.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct __attribute__((packed)) {
+    char        magic[4];
+    uint8_t     version;
+    uint8_t     reserved;
+    uint16_t    bins;
+    uint16_t    width;
+    uint16_t    rows;
+    uint32_t    time;
+    int32_t     band_id;
+    float       spectrum_min;
+    float       spectrum_max;
+    float       waterfall_min;
+    float       waterfall_max;
+} header_t;
+
+_Static_assert(sizeof(header_t) == 36, "Display snapshot header size");
+
+void display_snapshot_pack(const uint8_t *row, uint16_t width, uint8_t *packed) {
+    for (uint16_t x = 0; x < width; x += 2) {
+        *packed++ = (row[x] >> 4) | (row[x + 1] & 0xF0);
+    }
+}
+
+void display_snapshot_unpack(const uint8_t *packed, uint16_t width, uint8_t *row) {
+    /* 4 bits -> 8 bits with full range: v * 17 */
+    for (uint16_t x = 0; x < width; x += 2) {
+        uint8_t v = *packed++;
+
+        row[x] = (v & 0x0F) * 17;
+        row[x + 1] = (v >> 4) * 17;
+    }
+}
+
+bool display_snapshot_write(const char *path, const display_snapshot_t *snap) {
+    char    tmp[128];
+    FILE    *f;
+    bool    res = true;
+
+    if (snap->width > DISPLAY_SNAPSHOT_WIDTH || snap->width % 2 || snap->rows > DISPLAY_SNAPSHOT_ROWS) {
+        return false;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    f = fopen(tmp, "wb");
+
+    if (!f) {
+        return false;
+    }
+
+    header_t header = {
+        .magic = { 'X', '6', 'D', 'S' },
+        .version = DISPLAY_SNAPSHOT_VERSION,
+        .bins = DISPLAY_SNAPSHOT_BINS,
+        .width = snap->width,
+        .rows = snap->rows,
+        .time = snap->time,
+        .band_id = snap->band_id,
+        .spectrum_min = snap->spectrum_min,
+        .spectrum_max = snap->spectrum_max,
+        .waterfall_min = snap->waterfall_min,
+        .waterfall_max = snap->waterfall_max,
+    };
+
+    res = fwrite(&header, sizeof(header), 1, f) == 1 &&
+          fwrite(snap->spectrum, sizeof(snap->spectrum), 1, f) == 1;
+
+    for (uint16_t i = 0; i < snap->rows && res; i++) {
+        res = fwrite(&snap->freqs[i], sizeof(snap->freqs[i]), 1, f) == 1 &&
+              fwrite(snap->packed[i], snap->width / 2, 1, f) == 1;
+    }
+    if (fclose(f) != 0) {
+        res = false;
+    }
+    if (!res || rename(tmp, path) != 0) {
+        remove(tmp);
+        return false;
+    }
+    return true;
+}
+
+bool display_snapshot_read(const char *path, display_snapshot_t *snap) {
+    FILE        *f = fopen(path, "rb");
+    header_t    header;
+    bool        res;
+
+    if (!f) {
+        return false;
+    }
+    res = fread(&header, sizeof(header), 1, f) == 1 &&
+          memcmp(header.magic, "X6DS", 4) == 0 &&
+          header.version == DISPLAY_SNAPSHOT_VERSION &&
+          header.bins == DISPLAY_SNAPSHOT_BINS &&
+          header.width <= DISPLAY_SNAPSHOT_WIDTH && header.width % 2 == 0 &&
+          header.rows <= DISPLAY_SNAPSHOT_ROWS &&
+          fread(snap->spectrum, sizeof(snap->spectrum), 1, f) == 1;
+
+    if (res) {
+        snap->time = header.time;
+        snap->band_id = header.band_id;
+        snap->spectrum_min = header.spectrum_min;
+        snap->spectrum_max = header.spectrum_max;
+        snap->waterfall_min = header.waterfall_min;
+        snap->waterfall_max = header.waterfall_max;
+        snap->width = header.width;
+        snap->rows = header.rows;
+    }
+    for (uint16_t i = 0; res && i < header.rows; i++) {
+        res = fread(&snap->freqs[i], sizeof(snap->freqs[i]), 1, f) == 1 &&
+              fread(snap->packed[i], header.width / 2, 1, f) == 1;
+    }
+    fclose(f);
+
+    return res;
+}
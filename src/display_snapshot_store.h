@@ -0,0 +1,63 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * File of the last spectrum, waterfall rows and auto min/max, host byte
+ * order. A 36 bytes header ("X6DS", u8 version, u8 reserved, u16 bins,
+ * u16 width, u16 rows, u32 time, i32 band id, f32 spectrum min/max and
+ * waterfall min/max), the spectrum as i8 dB, then the rows oldest first as
+ * i32 freq and width / 2 bytes of 4 bits per column, like waterfall_history.h.
+ */
+
+#define DISPLAY_SNAPSHOT_VERSION    1
+#define DISPLAY_SNAPSHOT_BINS       800
+#define DISPLAY_SNAPSHOT_WIDTH      1024
+#define DISPLAY_SNAPSHOT_ROWS       256
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t    time;               /* Unix time of the save */
+    int32_t     band_id;
+    float       spectrum_min;
+    float       spectrum_max;
+    float       waterfall_min;
+    float       waterfall_max;
+    int8_t      spectrum[DISPLAY_SNAPSHOT_BINS];    /* dB */
+    uint16_t    width;              /* Waterfall columns, even, up to DISPLAY_SNAPSHOT_WIDTH */
+    uint16_t    rows;
+    int32_t     freqs[DISPLAY_SNAPSHOT_ROWS];
+    uint8_t     packed[DISPLAY_SNAPSHOT_ROWS][DISPLAY_SNAPSHOT_WIDTH / 2];
+} display_snapshot_t;
+
+/**
+ * Write to path.tmp and rename it over the path
+ */
+bool display_snapshot_write(const char *path, const display_snapshot_t *snap);
+
+/**
+ * False if there is no file, or it's of another version or cut short
+ */
+bool display_snapshot_read(const char *path, display_snapshot_t *snap);
+
+/**
+ * Row of palette ids (0..255) to 4 bits per column and back
+ */
+void display_snapshot_pack(const uint8_t *row, uint16_t width, uint8_t *packed);
+void display_snapshot_unpack(const uint8_t *packed, uint16_t width, uint8_t *row);
+
+#ifdef __cplusplus
+}
+#endif
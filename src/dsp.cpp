@@ -8,71 +8,183 @@
 
 #include "dsp.h"
 
+#include "audio_graph.h"
 #include "cw.h"
+#include "cw_skimmer.h"
 #include "util.h"
 #include "buttons.h"
 #include "cfg/subjects.h"
+#include "dsp/channel_power.h"
+#include "dsp/decim.h"
+#include "dsp/peak_hold.h"
+#include "dsp/preproc.h"
+#include "dsp/sub_rx.h"
 
 #include <algorithm>
+#include <atomic>
 #include <numeric>
 
 extern "C" {
     #include "audio.h"
+    #include "band_sweep.h"
+    #include "memory_scan.h"
+    #include "cat.h"
     #include "cfg/cfg.h"
     #include "dialog_msg_voice.h"
+    #include "governor.h"
     #include "meter.h"
+    #include "pan_stream.h"
+    #include "params/params.h"
     #include "radio.h"
     #include "recorder.h"
+    #include "signals.h"
+    #include "ring.h"
     #include "rtty.h"
+    #include "scheduler.h"
     #include "spectrum.h"
+    #include "spectrum_hires.h"
     #include "waterfall.h"
 
     #include <math.h>
     #include <pthread.h>
+    #include <semaphore.h>
     #include <stdlib.h>
+    #include <string.h>
 }
 
 
 #define ANF_DECIM_FACTOR 8 // 100000 -> 12500
-#define ANF_STEP 25 // Hz
-#define ANF_NFFT 100000 / ANF_DECIM_FACTOR / ANF_STEP
+#define ANF_ZOOM 4 // 12500 -> 3125 around the passband
+#define ANF_NFFT 128
+#define ANF_STEP (100000.0f / ANF_DECIM_FACTOR / ANF_ZOOM / ANF_NFFT) // ~24.4 Hz
 #define ANF_INTERVAL_MS 500
-#define ANF_HIST_LEN 3
 
-static iirfilt_cccf dc_block;
+#define DSP_RING_BLOCKS 16 // ~80 ms of flow
+#define AUDIO_RING_BLOCKS 32 // Fragments, ~320 ms of low latency audio
 
-static pthread_mutex_t spectrum_mux = PTHREAD_MUTEX_INITIALIZER;
+typedef struct {
+    bool     tx;
+    uint16_t size;
+    cfloat   samples[RADIO_SAMPLES];
+} dsp_block_t;
 
-static uint8_t       spectrum_factor = 1;
-static firdecim_crcf spectrum_decim_rx;
-static firdecim_crcf spectrum_decim_tx;
+static ring_t            dsp_ring;
+static sem_t             dsp_sem;
+static pthread_t         dsp_thread;
+static std::atomic<bool> dsp_reset_req{false};
+static std::atomic<bool> dsp_warm_reset_req{false};
+
+/* Captured audio, decoded by the audio worker off the capture callback */
+typedef struct {
+    uint16_t size;
+    int16_t  samples[AUDIO_CAPTURE_FRAGMENT];
+} audio_block_t;
+
+static ring_t    audio_ring;
+static sem_t     audio_sem;
+static pthread_t audio_thread;
+
+#define FLOW_RATE 100000
+
+/* Retune accumulated by UI thread, followed by DSP worker */
+static std::atomic<int32_t> retune_req{0};
+static float                spectrum_shift_residual = 0.0f;
+
+static DcBlockSwap *dc_block;
+
+#define SPECTRUM_ZOOM_MAX 8
+
+/* Prebuilt spectrum spgrams and decimators for each zoom factor */
+typedef struct {
+    ChunkedSpgram *sg_rx;
+    ChunkedSpgram *sg_tx;
+    DecimChain    *decim_rx;
+    DecimChain    *decim_tx;
+} zoom_slot_t;
+
+static zoom_slot_t          zoom_pool[SPECTRUM_ZOOM_MAX + 1];
+static std::atomic<uint8_t> spectrum_factor_req{1};
+static bool                 spectrum_warmup = false;
+
+static uint8_t     spectrum_factor = 1;
+static DecimChain *spectrum_decim_rx;
+static DecimChain *spectrum_decim_tx;
 
 static ChunkedSpgram *spectrum_sg_rx;
 static ChunkedSpgram *spectrum_sg_tx;
 static float          spectrum_psd[SPECTRUM_NFFT];
+static float          spectrum_shared_psd[WATERFALL_NFFT];
 static float          spectrum_psd_filtered[SPECTRUM_NFFT];
+static PeakHold      *spectrum_peak_hold;
+static uint64_t       spectrum_peak_time;
+
+/* Requests from UI thread, applied before the next spectrum update */
+static std::atomic<bool>    peak_reset_req{false};
+static std::atomic<int32_t> peak_shift_req{0};
 static float          spectrum_beta   = 0.7f;
-static uint8_t        spectrum_fps_ms = (1000 / 15);
+static std::atomic<uint16_t> spectrum_fps_ms{1000 / 15};
 static uint64_t       spectrum_time;
 static cfloat         spectrum_dec_buf[SPECTRUM_NFFT / 2];
 
+/* Last high resolution frame, of the spectrum without zoom and the signal detector */
+static float          hires_psd[SPECTRUM_HIRES_MAX];
+static uint16_t       hires_size = 0;
+static uint32_t       hires_seq = 0;
+static uint32_t       hires_signals_seq = 0;
+
 static ChunkedSpgram *waterfall_sg_rx;
 static ChunkedSpgram *waterfall_sg_tx;
 static float          waterfall_psd[WATERFALL_NFFT];
-static uint8_t        waterfall_fps_ms = (1000 / 25);
+static std::atomic<uint16_t> waterfall_fps_ms{1000 / 25};
+
+// Low power mode while the display is off
+#define LOW_POWER_FFT_DECIM     4       /* Waterfall FFT of every Nth block */
+#define LOW_POWER_PERIOD_MS     200     /* Waterfall rows for CAT and the streams */
+
+/*
+ * Spgram hops from the frame periods: a frame gets at least FRAME_TRANSFORMS of them,
+ * with the spectrum alpha of 0.4 the older ones weigh below 13% together. The waterfall
+ * hop is up to its window of two packets, so every sample is still in a row. The zoomed
+ * spectrum window is of hop chunks, the skipped blocks go into a longer transform
+ */
+#define FRAME_TRANSFORMS        4
+#define WATERFALL_HOP_MAX       (WATERFALL_NFFT / RADIO_SAMPLES)
+
+static std::atomic<bool>    display_on_req{true};
+static bool                 display_on = true;
+static uint16_t             hops_spectrum_ms = 0;
+static uint16_t             hops_waterfall_ms = 0;
+static bool                 hops_display_on = true;
 static uint64_t       waterfall_time;
 
-static Anf *anf;
-static bool anf_enabled = true;
+#define S_METER_PERIOD_MS   50
+#define S_METER_OFFSET_DB   (-1.2f)     /* A carrier reads as the peak of the waterfall PSD */
+
+const int32_t               s_meter_speeds[S_METER_SPEEDS] = { 50, 150, 400, 1000 };
+
+static ChannelPower         *channel_power;
+static ChannelPower         *scan_power;        /* Shorter periods for the memory scan hops */
+static float                s_meter_beta;
+
+#define SUB_RX_SPAN_HZ      45000       /* Farthest passband edge of the sub receiver from the flow center */
 
-static cfloat buf_filtered[RADIO_SAMPLES];
+static SubRx                *sub_rx;
+static int16_t              *sub_rx_audio;
+static bool                 sub_rx_enabled = false;
+static bool                 sub_rx_mode_ok = false;
+static bool                 sub_rx_tunable = false;     /* Mode and freq */
+static bool                 sub_rx_on = false;          /* Play path is requested */
+
+static Anf        *anf;
+static bool anf_enabled = true;
 
 static uint32_t cur_freq;
 static uint8_t  psd_delay;
 static uint8_t  min_max_delay;
 
-static firhilbf audio_hilb;
-static cfloat  *audio;
+/* Auto min/max of the band grid, mirrored for the DSP worker */
+static std::atomic<int32_t> grid_floor_pct{15};
+static std::atomic<int32_t> grid_range{48};
 
 static bool ready = false;
 
@@ -80,387 +192,399 @@ static int32_t filter_from = 0;
 static int32_t filter_to   = 3000;
 static x6100_mode_t cur_mode;
 
-static void dsp_update_min_max(float *data_buf, uint16_t size);
-static void setup_spectrum_spgram();
+static void dsp_update_min_max();
+static void setup_zoom_pool();
+static void switch_zoom(uint8_t factor);
 static void on_zoom_change(Subject *subj, void *user_data);
+static void on_grid_floor_pct_change(Subject *subj, void *user_data);
+static void on_grid_range_change(Subject *subj, void *user_data);
 static void on_real_filter_from_change(Subject *subj, void *user_data);
 static void on_real_filter_to_change(Subject *subj, void *user_data);
 static void update_dnf_enabled(Subject *subj, void *user_data);
+static void on_s_meter_ms_change(Subject *subj, void *user_data);
+static void on_sub_rx_band_change(Subject *subj, void *user_data);
+static void on_sub_rx_freq_change(Subject *subj, void *user_data);
 static void on_cur_freq_change(Subject *subj, void *user_data);
+static void *dsp_worker(void *arg);
+static void *audio_worker(void *arg);
+static void setup_audio_sinks();
 
 
-/* Chunked spectrum periodogram class */
+/* * */
 
-ChunkedSpgram::ChunkedSpgram(size_t chunk_size, size_t nfft, size_t buffer_size) {
-    this->chunk_size = chunk_size;
-    this->nfft = nfft;
-    if (buffer_size > 0) {
-        this->buffer_size = buffer_size;
-    } else {
-        this->buffer_size = nfft - nfft % chunk_size;
+static void on_anf_update(Subject *subj, void *user_data) {
+    if (!anf_enabled) {
+        return;
     }
-    this->buffer = windowcf_create(this->buffer_size);
-    this->buf_time = (cfloat *) calloc(sizeof(cfloat), nfft);
-    this->buf_freq = (cfloat *) calloc(sizeof(cfloat), nfft);
-    this->psd = (float *) calloc(sizeof(float), nfft);
-    this->fft = fft_create_plan(nfft, buf_time, buf_freq, LIQUID_FFT_FORWARD, 0);
-    this->w = (cfloat *) calloc(sizeof(cfloat), chunk_size);
-
-    size_t i;
-    for (i = 0; i < chunk_size; i++) {
-        this->w[i] = liquid_kaiser(i, chunk_size, 5.0f);
-        // this->w[i] = liquid_hann(i, chunk_size);
+    int32_t new_val = subject_get_int(subj);
+    if ((new_val <= 0) || (new_val > 3000)) {
+        new_val = 3000;
     }
-    // scale by window magnitude
-    float g = 0.0f;
-    for (i=0; i<chunk_size; i++)
-        g += std::norm(this->w[i]);
-    g = 1.0f / sqrtf(g * nfft / chunk_size);
-
-    // scale window and copy
-    for (i=0; i<chunk_size; i++)
-        this->w[i] *= g;
-
+    subject_set_int(cfg.dnf_center.val, new_val);
 }
 
-ChunkedSpgram::~ChunkedSpgram() {
-    free(this->buf_time);
-    free(this->buf_freq);
-    free(this->psd);
-    free(this->w);
+void dsp_init() {
+    dc_block = new DcBlockSwap(0.005f);
 
-    windowcf_destroy(buffer);
-    fft_destroy_plan(fft);
-}
+    setup_zoom_pool();
+    switch_zoom(1);
 
-void ChunkedSpgram::set_alpha(float val) {
-    // validate input
-    if (val != -1 && (val < 0.0f || val > 1.0f)) {
-        printf("set_alpha(), alpha must be in {-1,[0,1]}");
-        return;
-    }
+    waterfall_sg_rx = spgram_create(RADIO_SAMPLES, WATERFALL_NFFT);
+    waterfall_sg_rx->set_alpha(0.8f);
+    waterfall_sg_tx = spgram_create(RADIO_SAMPLES, WATERFALL_NFFT);
+    waterfall_sg_tx->set_alpha(0.8f);
 
-    // set accumulation flag appropriately
-    accumulate = (val == -1.0f) ? true : false;
+    spectrum_time  = get_time();
+    spectrum_peak_hold = new PeakHold(SPECTRUM_NFFT);
+    spectrum_peak_hold->reset(S_MIN);
+    spectrum_peak_time = spectrum_time;
+    waterfall_time = get_time();
 
-    if (accumulate) {
-        this->alpha = 1.0f;
-        this->gamma = 1.0f;
-    } else {
-        this->alpha = val;
-        this->gamma = 1.0f - val;
-    }
-}
+    anf = new Anf(ANF_DECIM_FACTOR, ANF_ZOOM, RADIO_SAMPLES, ANF_NFFT, ANF_INTERVAL_MS, ANF_STEP);
+    anf->notch_freq_subj->subscribe_delayed(on_anf_update);
 
-void ChunkedSpgram::clear() {
-    num_transforms = 0;
-    num_samples = 0;
-    for (size_t i = 0; i < nfft; i++) {
-        psd[i] = 0.0f;
-        buf_time[i] = 0.0f;
-    }
-}
+    channel_power = new ChannelPower(FLOW_RATE, S_METER_PERIOD_MS);
+    scan_power = new ChannelPower(FLOW_RATE, MEMORY_SCAN_PERIOD_MS);
 
-void ChunkedSpgram::reset() {
-    clear();
-    windowcf_reset(buffer);
-}
+    sub_rx = new SubRx(FLOW_RATE, AUDIO_PLAY_RATE);
+    sub_rx_audio = new int16_t[sub_rx->max_output(RADIO_SAMPLES)];
 
-void ChunkedSpgram::execute_block(cfloat *chunk) {
-    cfloat val;
-    for (size_t i=0; i<chunk_size; i++) {
-        val = chunk[i] * w[i];
-        windowcf_push(buffer, val);
-    }
-    num_samples += chunk_size;
-    if (num_samples >= buffer_size){}
-    cfloat *rc;
-    windowcf_read(buffer, &rc);
-    memcpy(buf_time, rc, sizeof(cfloat) * buffer_size);
-    fft_execute(fft);
+    psd_delay = 4;
 
-    // accumulate output
-    // TODO: vectorize this operation
-    for (size_t i=0; i<nfft; i++) {
-        float v = std::norm(buf_freq[i]);
-        if (num_transforms == 0)
-            psd[i] = v;
-        else
-            psd[i] = gamma*psd[i] + alpha*v;
-    }
-    num_transforms++;
-}
+    setup_audio_sinks();
 
-void ChunkedSpgram::get_psd_mag(float *psd) {
-    // compute magnitude (linear) and run FFT shift
-    unsigned int i;
-    unsigned int nfft_2 = nfft / 2;
-    float scale = accumulate ? 1.0f / std::max((size_t)1, num_transforms) : 1.0f;
-    for (i=0; i<nfft; i++) {
-        unsigned int k = (i + nfft_2) % nfft;
-        psd[i] = std::max((float)LIQUID_SPGRAM_PSD_MIN, this->psd[k]) * scale;
-    }
-    if (accumulate) {
-        clear();
-    }
-}
+    subject_add_observer_and_call(cfg_cur.zoom, on_zoom_change, NULL);
+    subject_add_observer_and_call(cfg_cur.band->grid.floor_pct.val, on_grid_floor_pct_change, NULL);
+    subject_add_observer_and_call(cfg_cur.band->grid.range.val, on_grid_range_change, NULL);
+    /* ANF state belongs to the DSP worker, these are queued until it runs them */
+    cfg_cur.filter.real.from->subscribe_ctx(SUBJECT_CTX_DSP, on_real_filter_from_change)->notify();
+    cfg_cur.filter.real.to->subscribe_ctx(SUBJECT_CTX_DSP, on_real_filter_to_change)->notify();
+    cfg.dnf_auto.val->subscribe_ctx(SUBJECT_CTX_DSP, update_dnf_enabled);
+    cfg_cur.mode->subscribe_ctx(SUBJECT_CTX_DSP, update_dnf_enabled)->notify();
+    cfg.s_meter_ms.val->subscribe_ctx(SUBJECT_CTX_DSP, on_s_meter_ms_change)->notify();
+    cfg.sub_rx.val->subscribe_ctx(SUBJECT_CTX_DSP, on_sub_rx_band_change);
+    cfg_cur.mode->subscribe_ctx(SUBJECT_CTX_DSP, on_sub_rx_band_change);
+    cfg_cur.filter.real.from->subscribe_ctx(SUBJECT_CTX_DSP, on_sub_rx_band_change);
+    cfg_cur.filter.real.to->subscribe_ctx(SUBJECT_CTX_DSP, on_sub_rx_band_change)->notify();
+    cfg_cur.fg_freq->subscribe_ctx(SUBJECT_CTX_DSP, on_sub_rx_freq_change);
+    cfg_cur.bg_freq->subscribe_ctx(SUBJECT_CTX_DSP, on_sub_rx_freq_change)->notify();
 
-void ChunkedSpgram::get_psd(float *psd) {
-    // compute magnitude, linear
-    get_psd_mag(psd);
-    // convert to dB
-    unsigned int i;
-    for (i=0; i<nfft; i++)
-        psd[i] = 10*log10f(psd[i]);
-}
+    cfg_cur.fg_freq->subscribe(on_cur_freq_change);
 
-/* Anf class */
+    cw_skimmer_init();
 
-Anf::Anf(size_t decim_factor, size_t chunk_size, size_t nfft, size_t interval_ms, size_t freq_bin) {
-    this->decim_factor = decim_factor;
-    this->interval_ms = interval_ms;
-    this->freq_bin = freq_bin;
-    this->nfft = nfft;
+    dsp_ring = ring_create(sizeof(dsp_block_t), DSP_RING_BLOCKS);
+    sem_init(&dsp_sem, 0, 0);
+    pthread_create(&dsp_thread, NULL, dsp_worker, NULL);
+    pthread_detach(dsp_thread);
+    governor_watch_thread("dsp", dsp_thread);
 
-    decim_buf = (cfloat *)calloc(chunk_size / decim_factor, sizeof(cfloat));
-    psd = (float *)calloc(nfft, sizeof(float));
+    audio_ring = ring_create(sizeof(audio_block_t), AUDIO_RING_BLOCKS);
+    sem_init(&audio_sem, 0, 0);
+    pthread_create(&audio_thread, NULL, audio_worker, NULL);
+    pthread_detach(audio_thread);
+    governor_watch_thread("audio", audio_thread);
 
-    decim = firdecim_crcf_create_kaiser(this->decim_factor, 8, 60.0f);
-    firdecim_crcf_set_scale(decim, 1.0f/(float)this->decim_factor);
-    sg = spgramcf_create(nfft, LIQUID_WINDOW_HANN, chunk_size / this->decim_factor, chunk_size / this->decim_factor);
-    last_ts = get_time();
-    notch_freq_subj = new SubjectT(0);
+    ready = true;
 }
 
-void Anf::set_freq_from(int32_t freq) {
-    freq_from = freq;
+void dsp_reset() {
+    // Applied by DSP worker before next block
+    dsp_reset_req = true;
+    sem_post(&dsp_sem);
 }
 
-void Anf::set_freq_to(int32_t freq) {
-    freq_to = freq;
+void dsp_warm_reset() {
+    dsp_warm_reset_req = true;
+    sem_post(&dsp_sem);
 }
 
-void Anf::shift(int32_t freq_diff, bool lower_band) {
-    if (lower_band)
-        freq_diff = -freq_diff;
+static void process_reset() {
+    psd_delay = 4;
+    signals_reset();
+    spectrum_hires_retune();
 
-    // Shift history
-    for (size_t i = 0; i < hist_size; i++){
-        freq_hist[i] -= freq_diff;
-    }
-    // Shift detected val
-    int32_t notch_freq = notch_freq_subj->get();
-    if (notch_freq > 0) {
-        notch_freq -= freq_diff;
-        notch_freq_subj->set(notch_freq);
-    }
-    firdecim_crcf_reset(decim);
-    spgramcf_reset(sg);
+    dc_block->reset();
+    channel_power->reset();
+    scan_power->reset();
+    spectrum_sg_rx->reset();
+    spectrum_sg_tx->reset();
+    waterfall_sg_rx->reset();
+    waterfall_sg_tx->reset();
 }
 
-void Anf::reset() {
-    for (size_t i = 0; i < hist_size; i++){
-        freq_hist[i] = 0;
-    }
-    notch_freq_subj->set(0);
-    firdecim_crcf_reset(decim);
-    spgramcf_reset(sg);
-}
+/*
+ * Displays go on from the last good frames: the PSD averages, the noise floor, the DC
+ * estimate and the channel power are of the same frequency. The sample history before
+ * the gap would join the new samples with a step, so it's dropped
+ */
+static void process_warm_reset() {
+    psd_delay = 1;
+    spectrum_hires_retune();
 
-void Anf::execute_block(cfloat *block, size_t size) {
-    size_t decim_size = size / decim_factor;
-    firdecim_crcf_execute_block(decim, block, decim_size, decim_buf);
-    spgramcf_write(sg, decim_buf, decim_size);
+    spectrum_sg_rx->drop_history();
+    spectrum_sg_tx->drop_history();
+    waterfall_sg_rx->drop_history();
+    waterfall_sg_tx->drop_history();
 }
 
-void Anf::update(uint64_t now, bool lower_band) {
-    if ((now - last_ts > interval_ms) && (spgramcf_get_num_transforms(sg) > 5)) {
-        spgramcf_get_psd(sg, psd);
-        float max = -INFINITY;
-        float min = INFINITY;
-        float mean = 0;
-        int32_t max_pos = 0;
-
-        // Search for peak
-        size_t center = nfft / 2;
-        size_t start = center + freq_from / (int32_t)freq_bin;
-        size_t stop = center + freq_to / (int32_t)freq_bin;
-        for (size_t i = start; i < stop; i++){
-            if (max < psd[i]) {
-                max = psd[i];
-                max_pos = i;
-            }
-            if (min > psd[i]) {
-                min = psd[i];
-            }
-            mean += psd[i];
-        }
-        size_t peak_width = 150 / freq_bin;
-        if (stop - start < peak_width) {
-            peak_width = (stop - start) / 2;
-        }
-        mean -= peak_width * max;
-        mean /= (stop - start - peak_width);
-        // Adjust pos for USB
-        if (!lower_band) {
-            max_pos--;
-        }
-        int16_t peak_freq = (max_pos - center) * freq_bin;
-
-        // Set threshold based on freq (6 db for 3000 Hz, ~12 db on 600 Hz)
-        float threshold = 5000.0f / (peak_freq + 2000.0f) * 6.0f;
-        if (max - mean > threshold){
-            freq_hist[hist_pos] = peak_freq;
-        } else {
-            freq_hist[hist_pos] = 0;
-        }
-        hist_pos = (hist_pos + 1) % hist_size;
+static void process_samples(cfloat *buf_samples, uint16_t size, DecimChain *sp_decim, ChunkedSpgram *sp_sg,
+                            ChunkedSpgram *wf_sg, bool tx) {
+    // DC block and I/Q swap in place, consumers below read the same block
+    dc_block->execute(buf_samples, size);
 
-        // Inspect history
-        int16_t mean_freq = 0;
-        for (size_t i = 0; i < hist_size; i++) {
-            mean_freq += freq_hist[i];
-        }
-        mean_freq /= (int16_t)hist_size;
+    if (!display_on) {
+        // Only CAT and the streams read the waterfall PSD, with the hop of LOW_POWER_FFT_DECIM
+        wf_sg->execute_block(buf_samples);
 
-        int16_t deviations = 0;
-        for (size_t i = 0; i < hist_size; i++) {
-            deviations += abs(mean_freq - freq_hist[i]);
-        }
-        deviations /= (int16_t)hist_size - 1;
-        if (deviations < freq_bin) {
-            int16_t new_freq = roundf((float)mean_freq / 50) * 50;
-            if (lower_band) {
-                new_freq = - new_freq;
-            }
-            notch_freq_subj->set(new_freq);
+        if (!tx && anf_enabled) {
+            anf->execute_block(buf_samples, size);
         }
-        last_ts = now;
-        spgramcf_reset(sg);
+        return;
     }
-}
 
-/* * */
+    wf_sg->execute_block(buf_samples);
 
-static void on_anf_update(Subject *subj, void *user_data) {
-    if (!anf_enabled) {
-        return;
+    if (spectrum_factor > 1) {
+        sp_decim->execute(buf_samples, size / spectrum_factor, spectrum_dec_buf);
+        sp_sg->execute_block(spectrum_dec_buf);
+    } else {
+        // Without zoom spectrum reuses waterfall FFT
+        sp_sg->accumulate_from(wf_sg);
     }
-    int32_t new_val = subject_get_int(subj);
-    if ((new_val <= 0) || (new_val > 3000)) {
-        new_val = 3000;
+
+    if (!tx && anf_enabled) {
+        anf->execute_block(buf_samples, size);
     }
-    subject_set_int(cfg.dnf_center.val, new_val);
 }
 
-void dsp_init() {
-    dc_block = iirfilt_cccf_create_dc_blocker(0.005f);
-
-    setup_spectrum_spgram();
-
-    waterfall_sg_rx = new ChunkedSpgram(RADIO_SAMPLES, WATERFALL_NFFT);
-    waterfall_sg_rx->set_alpha(0.8f);
-    waterfall_sg_tx = new ChunkedSpgram(RADIO_SAMPLES, WATERFALL_NFFT);
-    waterfall_sg_tx->set_alpha(0.8f);
-
-    spectrum_time  = get_time();
-    waterfall_time = get_time();
-
-    anf = new Anf(ANF_DECIM_FACTOR, RADIO_SAMPLES, ANF_NFFT, ANF_INTERVAL_MS, ANF_STEP);
-    anf->notch_freq_subj->subscribe(on_anf_update);
-
-    psd_delay = 4;
-
-    audio      = (cfloat *)malloc(AUDIO_CAPTURE_RATE * sizeof(cfloat));
-    audio_hilb = firhilbf_create(7, 60.0f);
-
-    subject_add_observer_and_call(cfg_cur.zoom, on_zoom_change, NULL);
-    subject_add_observer_and_call(cfg_cur.filter.real.from, on_real_filter_from_change, NULL);
-    subject_add_observer_and_call(cfg_cur.filter.real.to, on_real_filter_to_change, NULL);
-    cfg.dnf_auto.val->subscribe(update_dnf_enabled);
-    cfg_cur.mode->subscribe(update_dnf_enabled)->notify();
+/**
+ * Fetch the high resolution frame of the current freq, false if there is none
+ */
+static bool read_hires() {
+    uint32_t seq = spectrum_hires_read(hires_seq, hires_psd, &hires_size);
 
-    cfg_cur.fg_freq->subscribe(on_cur_freq_change);
-    ready = true;
+    if (!seq) {
+        return false;
+    }
+    hires_seq = seq;
+    return true;
 }
 
-void dsp_reset() {
-    psd_delay = 4;
+static size_t frame_hop(uint16_t period_ms) {
+    size_t blocks = (size_t)period_ms * FLOW_RATE / (1000 * RADIO_SAMPLES);
 
-    iirfilt_cccf_reset(dc_block);
-    spectrum_sg_rx->reset();
-    spectrum_sg_tx->reset();
-    waterfall_sg_rx->reset();
-    waterfall_sg_tx->reset();
+    return std::max((size_t)1, blocks / FRAME_TRANSFORMS);
 }
 
-static void process_samples(cfloat *buf_samples, uint16_t size, firdecim_crcf sp_decim, ChunkedSpgram *sp_sg,
-                            ChunkedSpgram *wf_sg, bool tx) {
-    iirfilt_cccf_execute_block(dc_block, buf_samples, size, buf_filtered);
-    // Swap I and Q
-    for (size_t i = 0; i < size; i++) {
-        buf_filtered[i] = {buf_filtered[i].imag(), buf_filtered[i].real()};
-    }
+/**
+ * Transforms only as many blocks as the frame rates of the displays need
+ */
+static void update_hops() {
+    uint16_t spectrum_ms = spectrum_fps_ms;
+    uint16_t waterfall_ms = waterfall_fps_ms;
 
-    if (spectrum_factor > 1) {
-        firdecim_crcf_execute_block(sp_decim, buf_filtered, size / spectrum_factor, spectrum_dec_buf);
-        sp_sg->execute_block(spectrum_dec_buf);
-    } else {
-        sp_sg->execute_block(buf_filtered);
+    if (spectrum_ms == hops_spectrum_ms && waterfall_ms == hops_waterfall_ms && display_on == hops_display_on) {
+        return;
     }
+    hops_spectrum_ms = spectrum_ms;
+    hops_waterfall_ms = waterfall_ms;
+    hops_display_on = display_on;
 
-    wf_sg->execute_block(buf_filtered);
+    size_t wf_hop = display_on ? std::min((size_t)WATERFALL_HOP_MAX, frame_hop(waterfall_ms)) : LOW_POWER_FFT_DECIM;
+    size_t sp_hop = frame_hop(spectrum_ms);
 
-    if (!tx && anf_enabled) {
-        anf->execute_block(buf_filtered, size);
+    waterfall_sg_rx->set_hop(wf_hop);
+    waterfall_sg_tx->set_hop(wf_hop);
+
+    // Zoom x1 accumulates the waterfall transforms
+    for (uint8_t factor = 2; factor <= SPECTRUM_ZOOM_MAX; factor++) {
+        zoom_slot_t *slot = &zoom_pool[factor];
+        size_t      hop = std::min(sp_hop, slot->sg_rx->get_window_max());
+
+        slot->sg_rx->set_window(hop);
+        slot->sg_tx->set_window(hop);
+        slot->sg_rx->set_hop(hop);
+        slot->sg_tx->set_hop(hop);
     }
 }
 
 static bool update_spectrum(ChunkedSpgram *sp_sg, uint64_t now, bool tx) {
     if ((now - spectrum_time > spectrum_fps_ms)) {
-        sp_sg->get_psd(spectrum_psd);
-        liquid_vectorf_addscalar(spectrum_psd, SPECTRUM_NFFT, -30.0f, spectrum_psd);
+        float offset = -30.0f;
+
+        if (spectrum_factor > 1) {
+            sp_sg->get_psd(spectrum_psd);
+            // Noise floor as of a single chunk window, weak carriers rise with the window
+            offset -= 10.0f * log10f(sp_sg->get_window());
+        } else if (!tx && read_hires()) {
+            // Narrow carriers keep their level, the frame is of the waterfall scale already
+            const float scale = (float)RADIO_SAMPLES / SPECTRUM_NFFT;
+
+            psd_decimate_peak(hires_psd, hires_size, spectrum_psd, SPECTRUM_NFFT);
+            offset = 10.0f * log10f(scale);
+            sp_sg->clear();
+        } else {
+            /*
+             * Keep noise floor equal to separate 800-point transform of single chunk:
+             * PSD of white noise is proportional to buffer_size / nfft, waterfall buffer fills whole nfft
+             */
+            const float scale = (float)RADIO_SAMPLES / SPECTRUM_NFFT;
+
+            sp_sg->get_psd_mag(spectrum_shared_psd);
+            psd_resample(spectrum_shared_psd, WATERFALL_NFFT, spectrum_psd, SPECTRUM_NFFT, scale);
+            psd_to_db(spectrum_psd, SPECTRUM_NFFT);
+        }
+        liquid_vectorf_addscalar(spectrum_psd, SPECTRUM_NFFT, offset, spectrum_psd);
         // Decrease beta for high zoom
         float new_beta = powf(spectrum_beta, ((float)spectrum_factor - 1.0f) / 2.0f + 1.0f);
-        lpf_block(spectrum_psd_filtered, spectrum_psd, new_beta, SPECTRUM_NFFT);
-        spectrum_data(spectrum_psd_filtered, SPECTRUM_NFFT, tx);
+        params_view_t pv;
+
+        params_view_get(&pv);
+
+        bool  peaks = pv.spectrum_peak && !tx;
+        float dt_ms = now - spectrum_peak_time;
+
+        if (peak_reset_req.exchange(false)) {
+            spectrum_peak_hold->reset(S_MIN);
+            peak_shift_req = 0;
+        }
+        int32_t shift = peak_shift_req.exchange(0);
+        if (shift) {
+            spectrum_peak_hold->shift(shift, S_MIN);
+        }
+        spectrum_peak_hold->set_profile({(float)pv.spectrum_peak_hold, pv.spectrum_peak_speed});
+        spectrum_peak_time = now;
+
+        if (spectrum_warmup) {
+            // First frame after zoom change, start filter from it instead of S_MIN
+            memcpy(spectrum_psd_filtered, spectrum_psd, sizeof(spectrum_psd));
+            spectrum_warmup = false;
+            if (peaks) {
+                spectrum_peak_hold->update(spectrum_psd_filtered, dt_ms);
+            }
+        } else {
+            // Smoothing and peak hold in one pass
+            spectrum_peak_hold->smooth_update(spectrum_psd_filtered, spectrum_psd, new_beta, dt_ms, peaks);
+        }
+        spectrum_data(spectrum_psd_filtered, peaks ? spectrum_peak_hold->values() : NULL, SPECTRUM_NFFT, tx);
+        pan_stream_put(PAN_STREAM_SPECTRUM, spectrum_psd_filtered, SPECTRUM_NFFT, FLOW_RATE / spectrum_factor, tx);
         spectrum_time = now;
         return true;
     }
     return false;
 }
 
-static bool update_waterfall(ChunkedSpgram *wf_sg, uint64_t now, bool tx) {
-    if ((now - waterfall_time > waterfall_fps_ms) && (!psd_delay)) {
-        wf_sg->get_psd(waterfall_psd);
-        liquid_vectorf_addscalar(waterfall_psd, WATERFALL_NFFT, -30.0f, waterfall_psd);
-        waterfall_data(waterfall_psd, WATERFALL_NFFT, tx);
+static bool update_waterfall(ChunkedSpgram *wf_sg, uint64_t now, bool tx, bool hop) {
+    uint16_t period = display_on ? waterfall_fps_ms.load() : LOW_POWER_PERIOD_MS;
+
+    if ((now - waterfall_time > period) && (!psd_delay)) {
+        wf_sg->get_psd_mag(waterfall_psd);
         waterfall_time = now;
+
+        if (display_on && !hop) {
+            // Palette indexes straight from the linear PSD
+            waterfall_data(waterfall_psd, WATERFALL_NFFT, tx);
+        }
+        psd_to_db(waterfall_psd, WATERFALL_NFFT);
+        liquid_vectorf_addscalar(waterfall_psd, WATERFALL_NFFT, WATERFALL_DB_OFFSET, waterfall_psd);
+
+        if (hop) {
+            // Away from the VFO freq, the row is for the band sweep only
+            band_sweep_put_psd(waterfall_psd, WATERFALL_NFFT);
+            return false;
+        }
+        pan_stream_put(PAN_STREAM_WATERFALL, waterfall_psd, WATERFALL_NFFT, FLOW_RATE, tx);
+        cat_scope_data(waterfall_psd, WATERFALL_NFFT);
+        if (tx) {
+            return true;
+        }
+        if (display_on && spectrum_hires_enabled()) {
+            // Finer bins, at the rate of the frames
+            if (read_hires() && hires_seq != hires_signals_seq) {
+                hires_signals_seq = hires_seq;
+                signals_put_psd(hires_psd, hires_size, now);
+            }
+        } else {
+            signals_put_psd(waterfall_psd, WATERFALL_NFFT, now);
+        }
         return true;
     }
     return false;
 }
 
-static void update_s_meter() {
+static void update_s_meter(cfloat *buf_samples, uint16_t size) {
+    if (!channel_power->execute(buf_samples, size)) {
+        return;
+    }
+    // The meter shows the mic level meanwhile
     if (dialog_msg_voice_get_state() != MSG_VOICE_RECORD) {
-        int32_t from, to, center;
+        meter_update(lroundf(channel_power->get_db() + S_METER_OFFSET_DB), s_meter_beta);
+    }
+}
 
-        center = WATERFALL_NFFT / 2;
-        from = center + filter_from * WATERFALL_NFFT / 100000;
-        to = center + filter_to * WATERFALL_NFFT / 100000;
+static void update_memory_scan(cfloat *buf_samples, uint16_t size) {
+    if (scan_power->execute(buf_samples, size)) {
+        memory_scan_put_db(scan_power->get_db() + S_METER_OFFSET_DB);
+    }
+}
 
-        int16_t peak_db = -121;
+static void sub_rx_monitor_cb(void *arg) {
+    audio_play_monitor(*(bool *)arg);
+}
+
+static void update_sub_rx(cfloat *buf_samples, uint16_t size, bool tx, bool hop) {
+    bool on = sub_rx_enabled && sub_rx_tunable && !tx;
 
-        for (int32_t i = from; i <= to; i++)
-            if (waterfall_psd[i] > peak_db)
-                peak_db = waterfall_psd[i];
+    if (on != sub_rx_on) {
+        sub_rx_on = on;
 
-        meter_update(peak_db, 0.8f);
+        if (on) {
+            sub_rx->reset();
+        } else {
+            // Nothing of it goes on air
+            audio_play_drop(AUDIO_PLAY_MONITOR);
+        }
+        scheduler_put_prio(SCHEDULER_PRIO_RADIO, sub_rx_monitor_cb, &on, sizeof(on));
+    }
+    // Prompts and voice messages have the play path meanwhile
+    if (on && !hop && audio_play_monitor_ready()) {
+        size_t n = sub_rx->execute(buf_samples, size, sub_rx_audio);
+
+        audio_play_write(AUDIO_PLAY_MONITOR, sub_rx_audio, n);
     }
 }
 
-void dsp_samples(cfloat *buf_samples, uint16_t size, bool tx) {
-    firdecim_crcf sp_decim;
+/*
+ * Continuous tuning: accumulated PSDs follow the retune, so displays and ANF keep running.
+ * Jumps wider than half of the span restart accumulation as before.
+ */
+static void follow_retune(int32_t diff) {
+    anf->shift(diff, cur_mode == x6100_mode_lsb);
+    cw_skimmer_retune(diff);
+    signals_retune(diff);
+    spectrum_hires_retune();
+
+    if (abs(diff) >= FLOW_RATE / 2) {
+        waterfall_sg_rx->reset();
+        psd_delay = 1;
+        return;
+    }
+
+    float freq_norm = (float)diff / FLOW_RATE;
+
+    waterfall_sg_rx->shift(freq_norm);
+    spectrum_sg_rx->shift(freq_norm * spectrum_factor);
+
+    float   total = freq_norm * spectrum_factor * SPECTRUM_NFFT + spectrum_shift_residual;
+    int32_t bins  = lroundf(total);
+
+    spectrum_shift_residual = total - bins;
+    psd_shift(spectrum_psd_filtered, SPECTRUM_NFFT, bins);
+}
+
+static void process_block(cfloat *buf_samples, uint16_t size, bool tx) {
+    DecimChain    *sp_decim;
     ChunkedSpgram *sp_sg, *wf_sg;
     uint64_t      now = get_time();
 
@@ -468,7 +592,30 @@ void dsp_samples(cfloat *buf_samples, uint16_t size, bool tx) {
         psd_delay--;
     }
 
-    pthread_mutex_lock(&spectrum_mux);
+    uint8_t factor = spectrum_factor_req;
+    if (factor != spectrum_factor) {
+        switch_zoom(factor);
+    }
+
+    int32_t retune = retune_req.exchange(0);
+    if (retune) {
+        follow_retune(retune);
+    }
+
+    bool on = display_on_req;
+    if (on != display_on) {
+        display_on = on;
+        if (on) {
+            // Spectrum wasn't accumulated, start smoothing from the first frame
+            spectrum_sg_rx->reset();
+            spectrum_sg_tx->reset();
+            spectrum_warmup = true;
+            spectrum_time = 0;
+            waterfall_time = 0;
+        }
+    }
+    update_hops();
+
     if (tx) {
         sp_decim = spectrum_decim_tx;
         sp_sg    = spectrum_sg_tx;
@@ -478,14 +625,34 @@ void dsp_samples(cfloat *buf_samples, uint16_t size, bool tx) {
         sp_sg    = spectrum_sg_rx;
         wf_sg    = waterfall_sg_rx;
     }
+    bool scan = !tx && memory_scan_hopping();
+    bool hop = !tx && (band_sweep_hopping() || scan);
+
     process_samples(buf_samples, size, sp_decim, sp_sg, wf_sg, tx);
-    update_spectrum(sp_sg, now, tx);
-    pthread_mutex_unlock(&spectrum_mux);
-    if (update_waterfall(wf_sg, now, tx)) {
-        update_s_meter();
+    if (!tx && !hop && display_on && spectrum_hires_enabled()) {
+        spectrum_hires_put(buf_samples, size);
+    }
+    if (!hop) {
+        update_s_meter(buf_samples, size);
+    } else if (scan) {
+        update_memory_scan(buf_samples, size);
+    }
+    if (!tx && !hop) {
+        cw_skimmer_put_samples(buf_samples, size);
+    }
+    update_sub_rx(buf_samples, size, tx, hop);
+    if (hop) {
+        // Don't show the accumulated samples of the hop after return
+        sp_sg->reset();
+    } else if (display_on) {
+        update_spectrum(sp_sg, now, tx);
+    }
+    if (update_waterfall(wf_sg, now, tx, hop)) {
         // TODO: skip on disabled auto min/max
-        if (!tx) {
-            dsp_update_min_max(waterfall_psd, WATERFALL_NFFT);
+        if (!display_on) {
+            min_max_delay = 2;
+        } else if (!tx) {
+            dsp_update_min_max();
         } else {
             min_max_delay = 2;
         }
@@ -495,48 +662,142 @@ void dsp_samples(cfloat *buf_samples, uint16_t size, bool tx) {
     }
 }
 
-static void on_zoom_change(Subject *subj, void *user_data) {
-    int32_t x = subject_get_int(subj);
-    if (x == spectrum_factor)
+void dsp_samples(cfloat *buf_samples, uint16_t size, bool tx) {
+    if (!ready) {
         return;
+    }
 
-    pthread_mutex_lock(&spectrum_mux);
+    dsp_block_t *block = (dsp_block_t *)ring_reserve(dsp_ring);
 
-    spectrum_factor = x;
+    if (!block) {
+        // DSP is behind, block is counted as overrun
+        return;
+    }
+    if (size > RADIO_SAMPLES) {
+        size = RADIO_SAMPLES;
+    }
+    block->tx   = tx;
+    block->size = size;
+    memcpy(block->samples, buf_samples, size * sizeof(cfloat));
+    ring_commit(dsp_ring);
+    sem_post(&dsp_sem);
+}
 
-    setup_spectrum_spgram();
+uint32_t dsp_get_overruns() {
+    return dsp_ring ? ring_get_overruns(dsp_ring) : 0;
+}
 
-    if (spectrum_decim_rx) {
-        firdecim_crcf_destroy(spectrum_decim_rx);
-        spectrum_decim_rx = NULL;
-    }
+uint32_t dsp_get_queued() {
+    return dsp_ring ? ring_used(dsp_ring) : 0;
+}
 
-    if (spectrum_decim_tx) {
-        firdecim_crcf_destroy(spectrum_decim_tx);
-        spectrum_decim_tx = NULL;
-    }
+static void *dsp_worker(void *arg) {
+    uint32_t     reported_overruns = 0;
+    dsp_block_t *block;
 
-    if (spectrum_factor > 1) {
-        spectrum_decim_rx = firdecim_crcf_create_kaiser(spectrum_factor, 8, 60.0f);
-        firdecim_crcf_set_scale(spectrum_decim_rx, sqrt(1.0f / (float)spectrum_factor));
-        spectrum_decim_tx = firdecim_crcf_create_kaiser(spectrum_factor, 8, 60.0f);
-        firdecim_crcf_set_scale(spectrum_decim_tx, sqrt(1.0f / (float)spectrum_factor));
+    set_thread_name("dsp");
+    subject_ctx_bind(SUBJECT_CTX_DSP);
+
+    while (true) {
+        sem_wait(&dsp_sem);
+        subject_ctx_run(SUBJECT_CTX_DSP);
+
+        bool warm = dsp_warm_reset_req.exchange(false);
+
+        if (dsp_reset_req.exchange(false)) {
+            ring_flush(dsp_ring);
+            process_reset();
+        } else if (warm) {
+            ring_flush(dsp_ring);
+            process_warm_reset();
+        }
+
+        while ((block = (dsp_block_t *)ring_peek(dsp_ring))) {
+            process_block(block->samples, block->size, block->tx);
+            ring_release(dsp_ring);
+        }
+
+        uint32_t overruns = ring_get_overruns(dsp_ring);
+
+        if (overruns != reported_overruns) {
+            LV_LOG_WARN("DSP overrun, %u blocks dropped", overruns - reported_overruns);
+            reported_overruns = overruns;
+        }
     }
+    return NULL;
+}
 
-    for (uint16_t i = 0; i < SPECTRUM_NFFT; i++)
-        spectrum_psd_filtered[i] = S_MIN;
+static void on_zoom_change(Subject *subj, void *user_data) {
+    int32_t x = limit(subject_get_int(subj), 1, SPECTRUM_ZOOM_MAX);
+
+    // Applied by DSP worker before next block
+    spectrum_factor_req = x;
+}
+
+static void on_grid_floor_pct_change(Subject *subj, void *user_data) {
+    grid_floor_pct = limit(subject_get_int(subj), 1, 90);
+}
 
-    pthread_mutex_unlock(&spectrum_mux);
+static void on_grid_range_change(Subject *subj, void *user_data) {
+    grid_range = limit(subject_get_int(subj), 10, 100);
 }
 
 static void on_real_filter_from_change(Subject *subj, void *user_data) {
     filter_from = subject_get_int(subj);
     anf->set_freq_from(filter_from);
+    channel_power->set_band(filter_from, filter_to);
+    scan_power->set_band(filter_from, filter_to);
 }
 
 static void on_real_filter_to_change(Subject *subj, void *user_data) {
     filter_to = subject_get_int(subj);
     anf->set_freq_to(filter_to);
+    channel_power->set_band(filter_from, filter_to);
+    scan_power->set_band(filter_from, filter_to);
+}
+
+static void on_s_meter_ms_change(Subject *subj, void *user_data) {
+    int32_t tau = std::max<int32_t>(subject_get_int(subj), 1);
+
+    s_meter_beta = expf(-(float)S_METER_PERIOD_MS / tau);
+}
+
+static void on_sub_rx_band_change(Subject *subj, void *user_data) {
+    bool lsb = false;
+
+    sub_rx_enabled = subject_get_int(cfg.sub_rx.val);
+
+    switch (subject_get_int(cfg_cur.mode)) {
+        case x6100_mode_lsb:
+        case x6100_mode_lsb_dig:
+        case x6100_mode_cwr:
+            lsb = true;
+            sub_rx_mode_ok = true;
+            break;
+
+        case x6100_mode_usb:
+        case x6100_mode_usb_dig:
+        case x6100_mode_cw:
+            sub_rx_mode_ok = true;
+            break;
+
+        default:
+            // AM and FM are not demodulated
+            sub_rx_mode_ok = false;
+            break;
+    }
+    sub_rx->set_band(filter_from, filter_to, lsb);
+    on_sub_rx_freq_change(NULL, NULL);
+}
+
+/**
+ * Dial of the other VFO, the flow is centered at the dial of this one
+ */
+static void on_sub_rx_freq_change(Subject *subj, void *user_data) {
+    int32_t offset = subject_get_int(cfg_cur.bg_freq) - subject_get_int(cfg_cur.fg_freq);
+
+    sub_rx_tunable = sub_rx_mode_ok && abs(offset) + filter_to < SUB_RX_SPAN_HZ;
+    sub_rx->set_offset(offset);
 }
 
 static void update_dnf_enabled(Subject *subj, void *user_data) {
@@ -558,71 +819,164 @@ static void on_cur_freq_change(Subject *subj, void *user_data) {
     int32_t new_freq = static_cast<SubjectT<int32_t> *>(subj)->get();
     int32_t diff = new_freq - cur_freq;
     cur_freq = new_freq;
-    anf->shift(diff, cur_mode == x6100_mode_lsb);
-    waterfall_sg_rx->reset();
-    psd_delay = 1;
+    retune_req += diff;
 }
 
 float dsp_get_spectrum_beta() {
     return spectrum_beta;
 }
 
+void dsp_set_display_period(uint16_t spectrum_ms, uint16_t waterfall_ms) {
+    spectrum_fps_ms = spectrum_ms;
+    waterfall_fps_ms = waterfall_ms;
+}
+
+void dsp_spectrum_peak_reset() {
+    peak_reset_req = true;
+}
+
+void dsp_spectrum_peak_shift(int32_t bins) {
+    peak_shift_req += bins;
+}
+
+void dsp_set_display_on(bool on) {
+    display_on_req = on;
+}
+
 void dsp_set_spectrum_beta(float x) {
     spectrum_beta = x;
 }
 
 void dsp_put_audio_samples(size_t nsamples, int16_t *samples) {
+    static thread_local bool named = false;
+
     if (!ready) {
         return;
     }
-
-    if (dialog_msg_voice_get_state() == MSG_VOICE_RECORD) {
-        dialog_msg_voice_put_audio_samples(nsamples, samples);
-        return;
+    if (!named) {
+        set_thread_name("audio_capture");
+        named = true;
     }
 
-    if (recorder_is_on()) {
-        recorder_put_audio_samples(nsamples, samples);
+    // Callback may return more than one fragment
+    while (nsamples > 0) {
+        size_t        n = std::min(nsamples, (size_t)AUDIO_CAPTURE_FRAGMENT);
+        audio_block_t *block = (audio_block_t *)ring_reserve(audio_ring);
+
+        if (!block) {
+            // Audio worker is behind, fragment is counted as overrun
+            return;
+        }
+        block->size = n;
+        memcpy(block->samples, samples, n * sizeof(int16_t));
+        ring_commit(audio_ring);
+        sem_post(&audio_sem);
+
+        samples  += n;
+        nsamples -= n;
     }
+}
+
+uint32_t dsp_get_audio_overruns() {
+    return audio_ring ? ring_get_overruns(audio_ring) : 0;
+}
 
-    for (uint16_t i = 0; i < nsamples; i++)
-        firhilbf_r2c_execute(audio_hilb, samples[i] / 32768.0f, &audio[i]);
+/* Consumers of the capture rate, RTTY and FT8 subscribe at their own rates */
 
-    if (rtty_get_state() == RTTY_RX) {
-        rtty_put_audio_samples(nsamples, audio);
-    } else if (cur_mode == x6100_mode_cw || cur_mode == x6100_mode_cwr) {
-        cw_put_audio_samples(nsamples, audio);
-    } else {
-        dialog_audio_samples(nsamples, audio);
+static bool msg_voice_active(void *user) {
+    return dialog_msg_voice_get_state() == MSG_VOICE_RECORD;
+}
+
+static void msg_voice_cb(const void *samples, size_t n, void *user) {
+    dialog_msg_voice_put_audio_samples(n, (int16_t *)samples);
+}
+
+static bool recorder_active(void *user) {
+    return recorder_is_capturing() && recorder_get_rate() == (uintptr_t)user;
+}
+
+static void recorder_cb(const void *samples, size_t n, void *user) {
+    recorder_put_audio_samples(n, (int16_t *)samples);
+}
+
+static void recorder_opus_cb(const void *samples, size_t n, void *user) {
+    static int16_t  buf[AUDIO_CAPTURE_FRAGMENT];
+    const cfloat    *in = (const cfloat *)samples;
+
+    n = std::min(n, (size_t)AUDIO_CAPTURE_FRAGMENT);
+
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = std::clamp(in[i].real() * 32768.0f, -32767.0f, 32767.0f);
     }
+    recorder_put_audio_samples(n, buf);
 }
 
-static int compare_fft(const void *p1, const void *p2) {
-    float *i1 = (float *)p1;
-    float *i2 = (float *)p2;
+static bool cw_active(void *user) {
+    return cur_mode == x6100_mode_cw || cur_mode == x6100_mode_cwr;
+}
+
+static void cw_cb(const void *samples, size_t n, void *user) {
+    cw_put_audio_samples(n, (cfloat *)samples);
+}
+
+static bool dialog_active(void *user) {
+    return dialog_is_run();
+}
 
-    return (*i1 < *i2) ? -1 : 1;
+static void dialog_cb(const void *samples, size_t n, void *user) {
+    dialog_audio_samples(n, (cfloat *)samples);
 }
 
-static void dsp_update_min_max(float *data_buf, uint16_t size) {
+static void setup_audio_sinks() {
+    audio_graph_add(AUDIO_CAPTURE_RATE, AUDIO_FORMAT_S16, msg_voice_cb, msg_voice_active, NULL);
+    audio_graph_add(AUDIO_CAPTURE_RATE, AUDIO_FORMAT_S16, recorder_cb, recorder_active, (void *)AUDIO_CAPTURE_RATE);
+    audio_graph_add(RECORDER_OPUS_RATE, AUDIO_FORMAT_CFLOAT, recorder_opus_cb, recorder_active, (void *)RECORDER_OPUS_RATE);
+    audio_graph_add(AUDIO_CAPTURE_RATE, AUDIO_FORMAT_CFLOAT, cw_cb, cw_active, NULL);
+    audio_graph_add(AUDIO_CAPTURE_RATE, AUDIO_FORMAT_CFLOAT, dialog_cb, dialog_active, NULL);
+}
+
+static void *audio_worker(void *arg) {
+    uint32_t       reported_overruns = 0;
+    audio_block_t *block;
+
+    set_thread_name("audio");
+    subject_ctx_bind(SUBJECT_CTX_AUDIO);
+
+    while (true) {
+        sem_wait(&audio_sem);
+        subject_ctx_run(SUBJECT_CTX_AUDIO);
+
+        while ((block = (audio_block_t *)ring_peek(audio_ring))) {
+            audio_graph_put(block->samples, block->size);
+            ring_release(audio_ring);
+        }
+
+        uint32_t overruns = ring_get_overruns(audio_ring);
+
+        if (overruns != reported_overruns) {
+            LV_LOG_WARN("Audio overrun, %u fragments dropped", overruns - reported_overruns);
+            reported_overruns = overruns;
+        }
+    }
+    return NULL;
+}
+
+static void dsp_update_min_max() {
     if (min_max_delay) {
         min_max_delay--;
         return;
     }
-    qsort(data_buf, size, sizeof(float), compare_fft);
-    uint16_t min_nth = size * 15 / 100;
-    uint16_t max_nth = size * 10 / 100;
-
-    float min = data_buf[min_nth];
-    // float max = data_buf[size - max_nth - 1];
+    int32_t floor_pct = grid_floor_pct;
+    int32_t range     = grid_range;
 
+    float min = signals_floor_quantile(floor_pct / 100.0f);
 
     if (min < S_MIN) {
         min = S_MIN;
     } else if (min > S8) {
         min = S8;
     }
-    float max = min + 48;
+    float max = min + range;
 
     spectrum_update_min(min);
     waterfall_update_min(min);
@@ -631,16 +985,47 @@ static void dsp_update_min_max(float *data_buf, uint16_t size) {
     waterfall_update_max(max);
 }
 
-static void setup_spectrum_spgram() {
-    if (spectrum_sg_rx) {
-        delete spectrum_sg_rx;
+static void setup_zoom_pool() {
+    for (uint8_t factor = 1; factor <= SPECTRUM_ZOOM_MAX; factor++) {
+        zoom_slot_t *slot = &zoom_pool[factor];
+
+        if (factor > 1) {
+            size_t chunk_size = RADIO_SAMPLES / factor;
+            slot->sg_rx = spgram_create(chunk_size, SPECTRUM_NFFT, chunk_size);
+            slot->sg_tx = spgram_create(chunk_size, SPECTRUM_NFFT, chunk_size);
+
+            slot->decim_rx = new DecimChain(factor);
+            slot->decim_tx = new DecimChain(factor);
+        } else {
+            // PSD accumulator over waterfall transforms
+            slot->sg_rx = spgram_create(RADIO_SAMPLES, WATERFALL_NFFT);
+            slot->sg_tx = spgram_create(RADIO_SAMPLES, WATERFALL_NFFT);
+
+            slot->decim_rx = NULL;
+            slot->decim_tx = NULL;
+        }
+        slot->sg_rx->set_alpha(0.4f);
+        slot->sg_tx->set_alpha(0.4f);
     }
-    if (spectrum_sg_tx) {
-        delete spectrum_sg_tx;
+}
+
+/**
+ * Swap to prebuilt zoom slot. Called from DSP worker only
+ */
+static void switch_zoom(uint8_t factor) {
+    zoom_slot_t *slot = &zoom_pool[factor];
+
+    slot->sg_rx->reset();
+    slot->sg_tx->reset();
+    if (slot->decim_rx) {
+        slot->decim_rx->reset();
+        slot->decim_tx->reset();
     }
-    size_t chunk_size = RADIO_SAMPLES / spectrum_factor;
-    spectrum_sg_rx = new ChunkedSpgram(chunk_size, SPECTRUM_NFFT, chunk_size);
-    spectrum_sg_rx->set_alpha(0.4f);
-    spectrum_sg_tx = new ChunkedSpgram(chunk_size, SPECTRUM_NFFT, chunk_size);
-    spectrum_sg_tx->set_alpha(0.4f);
+
+    spectrum_sg_rx    = slot->sg_rx;
+    spectrum_sg_tx    = slot->sg_tx;
+    spectrum_decim_rx = slot->decim_rx;
+    spectrum_decim_tx = slot->decim_tx;
+    spectrum_factor   = factor;
+    spectrum_warmup   = true;
 }
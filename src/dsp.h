@@ -29,74 +29,73 @@ extern "C" {
 #define WATERFALL_NFFT  (RADIO_SAMPLES * 2)
 #define SPECTRUM_NFFT   800
 
+#define S_METER_SPEEDS  4
+
 #ifdef __cplusplus
 
-class ChunkedSpgram {
-    size_t   nfft;
-    size_t   chunk_size;
-    size_t   buffer_size;
-    windowcf buffer;
-    fftplan  fft;
-    cfloat  *buf_time;
-    cfloat  *buf_freq;
-    cfloat  *w;
-    float   *psd;
-    bool     accumulate     = true;
-    float    alpha          = 1.0f;
-    float    gamma          = 1.0f;
-    size_t   num_transforms = 0;
-    size_t   num_samples    = 0;
-
-  public:
-    ChunkedSpgram(size_t chunk_size, size_t nfft, size_t buffer_size=0);
-    ~ChunkedSpgram();
-    void set_alpha(float val);
-    void clear();
-    void reset();
-    void execute_block(cfloat *block);
-    void get_psd_mag(float *psd);
-    void get_psd(float *psd);
-};
-
-class Anf {
-    size_t              decim_factor;
-    size_t              freq_bin;
-    size_t              nfft;
-    cfloat             *decim_buf;
-    firdecim_crcf       decim;
-    spgramcf            sg;
-    float              *psd;
-    uint64_t            last_ts;
-    size_t              interval_ms;
-    int32_t             freq_from = -3000;
-    int32_t             freq_to   = 3000;
-    static const size_t hist_size = 3;
-    int16_t             freq_hist[hist_size];
-    size_t              hist_pos = 0;
-
-  public:
-    Anf(size_t decim_factor, size_t chunk_size, size_t nfft, size_t interval_ms, size_t freq_bin);
-    void set_freq_from(int32_t freq);
-    void set_freq_to(int32_t freq);
-    void shift(int32_t freq_diff, bool lower_band);
-    void reset();
-    void execute_block(cfloat *block, size_t size);
-    void update(uint64_t now, bool lower_band);
-
-    SubjectT<int32_t> *notch_freq_subj;
-};
+#include "dsp/anf.h"
+#include "dsp/spgram.h"
 
 extern "C" {
 #endif
 
+/* S-meter time constants, ms */
+extern const int32_t s_meter_speeds[S_METER_SPEEDS];
+
 void dsp_init();
+
+/**
+ * Queue flow samples for DSP worker thread. Never blocks, drops block if DSP is behind
+ */
 void dsp_samples(cfloat *buf_samples, uint16_t size, bool tx);
 void dsp_reset();
 
+/**
+ * Restart after a short gap of the flow: averaged PSDs, noise floor and S-meter are kept,
+ * only the sample history is dropped
+ */
+void dsp_warm_reset();
+
+/**
+ * Number of flow blocks dropped because DSP worker was behind
+ */
+uint32_t dsp_get_overruns();
+
+/**
+ * Number of flow blocks waiting for DSP worker
+ */
+uint32_t dsp_get_queued();
+
 float dsp_get_spectrum_beta();
 void dsp_set_spectrum_beta(float x);
 
+/**
+ * Minimal period between spectrum and waterfall updates (frame rate governor)
+ */
+void dsp_set_display_period(uint16_t spectrum_ms, uint16_t waterfall_ms);
+
+/**
+ * Display off: skip spectrum, decimate waterfall FFT to what the streams need.
+ * ANF and audio paths are not affected. Applied by DSP worker
+ */
+void dsp_set_display_on(bool on);
+
+/**
+ * Reset spectrum peaks / move them by `bins` (on retune). Applied by DSP worker
+ */
+void dsp_spectrum_peak_reset();
+void dsp_spectrum_peak_shift(int32_t bins);
+
+/**
+ * Queue captured audio for the audio worker (RTTY, CW and FT8 decoding, recorders).
+ * Never blocks, drops fragments if the worker is behind
+ */
 void dsp_put_audio_samples(size_t nsamples, int16_t *samples);
+
+/**
+ * Number of audio fragments dropped because the audio worker was behind
+ */
+uint32_t dsp_get_audio_overruns();
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,100 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "adpcm.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871,
+    5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+    27086, 29794, 32767
+};
+
+static const int8_t index_table[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+/**
+ * Apply a code to the state, as the decoder does
+ */
+static inline int16_t step_state(adpcm_state_t *state, uint8_t code) {
+    int32_t step = step_table[state->index];
+    int32_t diff = step >> 3;
+    int32_t pred = state->predictor;
+    int32_t index = state->index + index_table[code & 7];
+
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+
+    pred += (code & 8) ? -diff : diff;
+
+    if (pred > 32767) {
+        pred = 32767;
+    } else if (pred < -32768) {
+        pred = -32768;
+    }
+
+    state->predictor = pred;
+    state->index = index < 0 ? 0 : index > 88 ? 88 : index;
+
+    return pred;
+}
+
+static inline uint8_t encode_sample(adpcm_state_t *state, int16_t x) {
+    int32_t step = step_table[state->index];
+    int32_t diff = x - state->predictor;
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+
+    if (diff >= step) {
+        code |= 1;
+    }
+
+    step_state(state, code);
+
+    return code;
+}
+
+void adpcm_encode(adpcm_state_t *state, const int16_t *in, size_t n, uint8_t *out) {
+    for (size_t i = 0; i + 1 < n; i += 2) {
+        uint8_t lo = encode_sample(state, in[i]);
+        uint8_t hi = encode_sample(state, in[i + 1]);
+
+        *out++ = lo | (hi << 4);
+    }
+    if (n & 1) {
+        *out = encode_sample(state, in[n - 1]);
+    }
+}
+
+void adpcm_decode(adpcm_state_t *state, const uint8_t *in, size_t n, int16_t *out) {
+    for (size_t i = 0; i + 1 < n; i += 2) {
+        uint8_t byte = *in++;
+
+        *out++ = step_state(state, byte & 0x0F);
+        *out++ = step_state(state, byte >> 4);
+    }
+    if (n & 1) {
+        *out = step_state(state, *in & 0x0F);
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IMA ADPCM, 4 bits per sample, two samples per byte, the first one in the low
+ * nibble. A few adds and shifts per sample, so the encoder costs nothing next
+ * to the DSP. The state at the start of a block goes along with the block, a
+ * lost block doesn't break the following ones.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int16_t     predictor;
+    uint8_t     index;          /* Of the step table, 0 .. 88 */
+} adpcm_state_t;
+
+/**
+ * Encode n samples to (n + 1) / 2 bytes, the state goes on to the next block
+ */
+void adpcm_encode(adpcm_state_t *state, const int16_t *in, size_t n, uint8_t *out);
+
+/**
+ * Decode n samples of (n + 1) / 2 bytes
+ */
+void adpcm_decode(adpcm_state_t *state, const uint8_t *in, size_t n, int16_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,265 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#include "anf.h"
+
+#include "../util.h"
+
+extern "C" {
+    #include <math.h>
+    #include <stdlib.h>
+}
+
+#define ON_DB           10.0f
+#define OFF_DB          6.0f
+#define CONFIRM_HITS    3       // Updates with the peak before it is notched
+#define SWAP_DB         6.0f    // Advantage to take the radio notch or a full set place
+#define SIDELOBE_HZ     1000    // Window sidelobes of a strong carrier are not notched
+#define SIDELOBE_DB     20.0f
+#define FREQ_ROUND      50
+
+/* Anf class */
+
+Anf::Anf(size_t decim_factor, size_t zoom, size_t chunk_size, size_t nfft, size_t interval_ms, float freq_bin)
+    : detector(ON_DB, OFF_DB, 0)
+{
+    this->decim_factor = decim_factor;
+    this->zoom = zoom;
+    this->interval_ms = interval_ms;
+    this->freq_bin = freq_bin;
+    this->nfft = nfft;
+
+    decim_chunk = chunk_size / decim_factor;
+    decim_buf = (cfloat *)calloc(decim_chunk, sizeof(cfloat));
+    zoom_buf = (cfloat *)calloc(nfft, sizeof(cfloat));
+    psd = (float *)calloc(nfft, sizeof(float));
+
+    decim = firdecim_crcf_create_kaiser(this->decim_factor, 8, 60.0f);
+    firdecim_crcf_set_scale(decim, 1.0f/(float)this->decim_factor);
+    zoom_decim = firdecim_crcf_create_kaiser(this->zoom, 4, 60.0f);
+    firdecim_crcf_set_scale(zoom_decim, 1.0f/(float)this->zoom);
+    // Whole window per transform, without overlap
+    sg = new ChunkedSpgram(nfft, nfft, nfft);
+    last_ts = get_time();
+    notch_freq_subj = new SubjectT(0);
+    update_center();
+}
+
+void Anf::set_freq_from(int32_t freq) {
+    freq_from = freq;
+    update_center();
+}
+
+void Anf::set_freq_to(int32_t freq) {
+    freq_to = freq;
+    update_center();
+}
+
+void Anf::update_center() {
+    float new_center = (freq_from + freq_to) / 2.0f;
+    float rate = freq_bin * nfft * zoom;
+
+    // Moving the mixer moves the spectrum like retune
+    shift_bins((new_center - center) / freq_bin);
+    center = new_center;
+    mix_step = std::polar(1.0f, (float)(-2.0 * M_PI * center / rate));
+}
+
+void Anf::shift_bins(float bins) {
+    sg->shift(bins / nfft);
+    detector.shift(bins, nfft);
+
+    for (size_t i = 0; i < notch_count; i++) {
+        notches[i].bin -= bins;
+    }
+}
+
+void Anf::shift(int32_t freq_diff, bool lower_band) {
+    // PSD is of I/Q, independent of sideband
+    shift_bins((float)freq_diff / freq_bin);
+
+    if (lower_band)
+        freq_diff = -freq_diff;
+
+    // Shift detected val
+    int32_t notch_freq = notch_freq_subj->get();
+    if (notch_freq > 0) {
+        notch_freq -= freq_diff;
+        notch_freq_subj->set(notch_freq);
+    }
+}
+
+void Anf::reset() {
+    detector.reset();
+    notch_count = 0;
+    notch_freq_subj->set(0);
+    firdecim_crcf_reset(decim);
+    firdecim_crcf_reset(zoom_decim);
+    zoom_len = 0;
+    sg->reset();
+}
+
+void Anf::execute_block(cfloat *block, size_t size) {
+    size_t decim_size = size / decim_factor;
+    firdecim_crcf_execute_block(decim, block, decim_size, decim_buf);
+
+    // Passband center to DC
+    for (size_t i = 0; i < decim_size; i++) {
+        decim_buf[i] *= mix_phase;
+        mix_phase *= mix_step;
+    }
+    mix_phase /= std::abs(mix_phase);
+
+    // Transform once the window is filled
+    cfloat *in = decim_buf;
+    size_t left = decim_size / zoom;
+
+    while (left) {
+        size_t n = nfft - zoom_len;
+
+        if (n > left) {
+            n = left;
+        }
+        firdecim_crcf_execute_block(zoom_decim, in, n, zoom_buf + zoom_len);
+        in += n * zoom;
+        left -= n;
+        zoom_len += n;
+
+        if (zoom_len == nfft) {
+            sg->execute_block(zoom_buf);
+            zoom_len = 0;
+        }
+    }
+}
+
+int32_t Anf::bin_to_freq(float bin) {
+    // Adjust pos for USB
+    if (!lower_band) {
+        bin -= 1.0f;
+    }
+    int32_t freq = roundf((center + (bin - nfft / 2) * freq_bin) / FREQ_ROUND) * FREQ_ROUND;
+
+    return lower_band ? -freq : freq;
+}
+
+void Anf::update_notches() {
+    const detected_peak_t   *peaks = detector.values();
+    size_t                  count = detector.size();
+    float                   start = nfft / 2 + (freq_from - center) / freq_bin;
+    float                   stop = nfft / 2 + (freq_to - center) / freq_bin;
+    bool                    used[PeakDetector::max_peaks] = {false};
+    notch_t                 next[max_notches];
+    size_t                  n = 0;
+
+    // Confirmed carriers in the passband
+    for (size_t i = 0; i < count; i++) {
+        const detected_peak_t *p = &peaks[i];
+
+        if (p->bin < start || p->bin >= stop || p->hits < CONFIRM_HITS) {
+            used[i] = true;
+            continue;
+        }
+        for (size_t k = 0; k < count; k++) {
+            if (fabsf(peaks[k].bin - p->bin) * freq_bin < SIDELOBE_HZ && peaks[k].snr > p->snr + SIDELOBE_DB) {
+                used[i] = true;
+                break;
+            }
+        }
+    }
+
+    // Notches keep their place while the peak is tracked
+    for (size_t k = 0; k < notch_count; k++) {
+        for (size_t i = 0; i < count; i++) {
+            if (!used[i] && peaks[i].id == notches[k].id) {
+                next[n++] = notch_t{peaks[i].id, peaks[i].bin, peaks[i].snr};
+                used[i] = true;
+                break;
+            }
+        }
+    }
+
+    // Then the strongest of the rest, the weakest notch gives its place to a clearly stronger one
+    while (true) {
+        int32_t best = -1;
+
+        for (size_t i = 0; i < count; i++) {
+            if (!used[i] && (best < 0 || peaks[i].snr > peaks[best].snr)) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        used[best] = true;
+
+        notch_t notch = {peaks[best].id, peaks[best].bin, peaks[best].snr};
+
+        if (n < max_notches) {
+            next[n++] = notch;
+            continue;
+        }
+
+        size_t weakest = 0;
+
+        for (size_t k = 1; k < n; k++) {
+            if (next[k].snr < next[weakest].snr) {
+                weakest = k;
+            }
+        }
+        if (notch.snr > next[weakest].snr + SWAP_DB) {
+            next[weakest] = notch;
+        } else {
+            break;
+        }
+    }
+
+    // The radio notch moves only to a clearly stronger carrier
+    for (size_t k = 1; k < n; k++) {
+        if (next[k].snr > next[0].snr + SWAP_DB) {
+            notch_t tmp = next[0];
+
+            next[0] = next[k];
+            next[k] = tmp;
+        }
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        notches[k] = next[k];
+    }
+    notch_count = n;
+
+    // Rounding of a carrier between two steps should not move the notch back and forth
+    int32_t freq = n ? bin_to_freq(notches[0].bin) : 0;
+    int32_t cur = notch_freq_subj->get();
+
+    if (freq == 0 || cur == 0 || abs(freq - cur) > FREQ_ROUND) {
+        notch_freq_subj->set(freq);
+    }
+}
+
+void Anf::update(uint64_t now, bool lower_band) {
+    if ((now - last_ts > interval_ms) && (sg->get_num_transforms() > 5)) {
+        this->lower_band = lower_band;
+
+        sg->get_psd(psd);
+        detector.update(psd, nfft);
+        update_notches();
+
+        last_ts = now;
+        sg->reset();
+    }
+}
+
+size_t Anf::get_notches(int32_t *freqs, size_t max) {
+    size_t n = notch_count < max ? notch_count : max;
+
+    for (size_t i = 0; i < n; i++) {
+        freqs[i] = bin_to_freq(notches[i].bin);
+    }
+    return n;
+}
@@ -0,0 +1,91 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include "../cfg/subjects.h"
+#include "peak_detect.h"
+#include "spgram.h"
+
+#include <liquid/liquid.h>
+
+#include <stdint.h>
+
+/*
+ * Automatic notch of carriers in the passband. The decimated flow is mixed
+ * down by the passband center and decimated again by zoom, so the FFT covers
+ * only the passband (zoom FFT). Peaks of its PSD are tracked with hysteresis,
+ * confirmed ones join a set of up to max_notches. A notch stays in the set
+ * while its peak is tracked, and the radio notch moves to another one only if
+ * it is clearly stronger.
+ */
+class Anf {
+  public:
+    static const size_t max_notches = 4;
+
+  private:
+    size_t              decim_factor;
+    size_t              zoom;
+    float               freq_bin;
+    size_t              nfft;
+    size_t              decim_chunk;
+    cfloat             *decim_buf;
+    firdecim_crcf       decim;
+    firdecim_crcf       zoom_decim;
+    cfloat              mix_phase = 1.0f;
+    cfloat              mix_step = 1.0f;
+    float               center = 0.0f;     // Hz of the PSD center
+    cfloat             *zoom_buf;
+    size_t              zoom_len = 0;
+    ChunkedSpgram      *sg;
+    float              *psd;
+    uint64_t            last_ts;
+    size_t              interval_ms;
+    int32_t             freq_from = -3000;
+    int32_t             freq_to   = 3000;
+    PeakDetector        detector;
+
+    /* Notch set, tracked by peak id. The first one is on the radio */
+    struct notch_t {
+        uint16_t        id;
+        float           bin;
+        float           snr;
+    };
+    notch_t             notches[max_notches];
+    size_t              notch_count = 0;
+    bool                lower_band = false;
+
+    int32_t bin_to_freq(float bin);
+    void update_center();
+    void shift_bins(float bins);
+    void update_notches();
+
+  public:
+    /**
+     * Bins of freq_bin Hz, the zoom FFT span is nfft * freq_bin = input rate / decim_factor / zoom
+     */
+    Anf(size_t decim_factor, size_t zoom, size_t chunk_size, size_t nfft, size_t interval_ms, float freq_bin);
+    void set_freq_from(int32_t freq);
+    void set_freq_to(int32_t freq);
+    /**
+     * Follow retune: notches are moved, accumulated PSD is shifted instead of reset
+     */
+    void shift(int32_t freq_diff, bool lower_band);
+    void reset();
+    void execute_block(cfloat *block, size_t size);
+    void update(uint64_t now, bool lower_band);
+
+    /**
+     * Audio freqs of the notch set, the radio one first. DSP thread only
+     */
+    size_t get_notches(int32_t *freqs, size_t max);
+
+    SubjectT<int32_t> *notch_freq_subj;
+};
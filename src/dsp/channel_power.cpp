@@ -0,0 +1,76 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "channel_power.h"
+
+#include <math.h>
+
+ChannelPower::ChannelPower(float rate, float period_ms) {
+    this->rate = rate;
+    period = rate * period_ms / 1000.0f;
+}
+
+void ChannelPower::set_band(float from, float to) {
+    float width = fabsf(to - from);
+
+    // Nulls at +-2 width from the center, -1.7 dB at the passband edges, -7 dB at +-width
+    decim = width > 0.0f ? rate / (2.0f * width) : 1;
+
+    if (decim < 1) {
+        decim = 1;
+    }
+    norm = 1.0f / ((float)decim * decim);
+    step = std::polar(1.0f, (float)(-2.0 * M_PI * (from + to) / 2.0f / rate));
+    reset();
+}
+
+void ChannelPower::reset() {
+    cur = 0.0f;
+    next = 0.0f;
+    pos = 0;
+    samples = 0;
+    power = 0.0f;
+    outputs = 0;
+}
+
+bool ChannelPower::execute(const cfloat *x, size_t n) {
+    bool ready = false;
+
+    for (size_t i = 0; i < n; i++) {
+        cfloat s = x[i] * phase;
+
+        phase *= step;
+
+        // Falling half of the triangle for this output, rising half for the next one
+        cur += s * (float)(decim - 1 - pos);
+        next += s * (float)(pos + 1);
+
+        if (++pos == decim) {
+            power += std::norm(cur * norm);
+            outputs++;
+            cur = next;
+            next = 0.0f;
+            pos = 0;
+        }
+
+        if (++samples >= period && outputs) {
+            result = power / outputs;
+            power = 0.0f;
+            outputs = 0;
+            samples = 0;
+            ready = true;
+        }
+    }
+    phase /= std::abs(phase);
+
+    return ready;
+}
+
+float ChannelPower::get_db() const {
+    return 10.0f * log10f(result > 1e-20f ? result : 1e-20f);
+}
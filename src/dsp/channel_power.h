@@ -0,0 +1,54 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stddef.h>
+
+/*
+ * Power of the passband from I/Q. The passband center is mixed to DC and
+ * filtered by a second order CIC (triangle of 2 * decim - 1 taps) decimating
+ * by decim, with nulls at twice the passband width. Power of its output is
+ * integrated and dumped every period. A few flops per sample, no FFT.
+ */
+class ChannelPower {
+    float   rate;
+    size_t  period;             // Samples per dump
+    size_t  decim = 1;
+    float   norm = 1.0f;        // 1 / decim^2, DC gain of 1
+    cfloat  phase = 1.0f;
+    cfloat  step = 1.0f;
+    cfloat  cur = 0.0f;         // Output of this decim block
+    cfloat  next = 0.0f;        // Output of the next one, falling half of the triangle
+    size_t  pos = 0;
+    size_t  samples = 0;
+    float   power = 0.0f;
+    size_t  outputs = 0;
+    float   result = 0.0f;
+
+  public:
+    ChannelPower(float rate, float period_ms);
+
+    /**
+     * Passband in Hz of I/Q, from < to
+     */
+    void set_band(float from, float to);
+    void reset();
+
+    /**
+     * Returns true when a period is dumped
+     */
+    bool execute(const cfloat *x, size_t n);
+
+    /**
+     * Mean power of the last period, dB
+     */
+    float get_db() const;
+};
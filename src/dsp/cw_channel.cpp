@@ -0,0 +1,127 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "cw_channel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define CUTOFF_HZ       100.0f
+#define ENV_BETA        0.5f
+#define FAST            0.1f
+#define SIG_DECAY       0.001f
+#define NOISE_ATTACK    0.0005f
+#define MIN_SNR_DB      8.0f
+#define HYST_DB         1.0f
+
+CwChannel::CwChannel(float rate) : rate(rate) {
+    float fir_rate = rate / CW_CHANNEL_BOX;
+    float fc = CUTOFF_HZ / fir_rate;
+    float sum = 0.0f;
+
+    // Blackman windowed sinc
+    for (size_t i = 0; i < CW_CHANNEL_TAPS; i++) {
+        float n = (float)i - (CW_CHANNEL_TAPS - 1) / 2.0f;
+        float w = 0.42f - 0.5f * cosf(2.0f * M_PI * i / (CW_CHANNEL_TAPS - 1))
+                  + 0.08f * cosf(4.0f * M_PI * i / (CW_CHANNEL_TAPS - 1));
+        float x = 2.0f * M_PI * fc * n;
+
+        taps[i] = w * ((n == 0.0f) ? 1.0f : sinf(x) / x);
+        sum += taps[i];
+    }
+    // Unity gain of the whole chain for a tone in the band
+    for (size_t i = 0; i < CW_CHANNEL_TAPS; i++) {
+        taps[i] /= sum * CW_CHANNEL_BOX;
+    }
+    reset(0.0f);
+}
+
+void CwChannel::reset(float freq) {
+    this->freq = freq;
+    step = std::polar(1.0f, -2.0f * (float)M_PI * freq / rate);
+    phase = 1.0f;
+    box_acc = 0.0f;
+    box_n = 0;
+    hist_pos = 0;
+    fir_n = 0;
+    for (auto &x : hist) {
+        x = 0.0f;
+    }
+    env = 0.0f;
+    sig_db = -200.0f;
+    noise_db = -200.0f;
+    key = false;
+}
+
+void CwChannel::shift(float diff) {
+    freq += diff;
+    step = std::polar(1.0f, -2.0f * (float)M_PI * freq / rate);
+}
+
+bool CwChannel::keying(cfloat x) {
+    env += (std::norm(x) - env) * (1.0f - ENV_BETA);
+
+    float db = 10.0f * log10f(env + 1e-30f);
+
+    if (sig_db < -150.0f) {
+        // First samples
+        sig_db = db;
+        noise_db = db;
+    }
+    sig_db += (db - sig_db) * (db > sig_db ? FAST : SIG_DECAY);
+    noise_db += (db - noise_db) * (db < noise_db ? FAST : NOISE_ATTACK);
+
+    if (sig_db - noise_db < MIN_SNR_DB) {
+        key = false;
+        return key;
+    }
+
+    // Half of the amplitude, the filter tails don't lengthen the elements
+    float thr = std::max(sig_db - 6.0f, noise_db + MIN_SNR_DB * 0.5f);
+
+    key = key ? (db > thr - HYST_DB) : (db > thr + HYST_DB);
+    return key;
+}
+
+size_t CwChannel::execute(const cfloat *in, size_t size, bool *keys) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        box_acc += in[i] * phase;
+        phase *= step;
+
+        if (++box_n < CW_CHANNEL_BOX) {
+            continue;
+        }
+        box_n = 0;
+
+        hist[hist_pos] = box_acc;
+        hist[hist_pos + CW_CHANNEL_TAPS] = box_acc;
+        hist_pos = (hist_pos + 1) % CW_CHANNEL_TAPS;
+        box_acc = 0.0f;
+
+        if (++fir_n < CW_CHANNEL_DECIM) {
+            continue;
+        }
+        fir_n = 0;
+
+        // Oldest sample is at hist_pos
+        const cfloat *h = &hist[hist_pos];
+        float         re = 0.0f, im = 0.0f;
+
+        for (size_t k = 0; k < CW_CHANNEL_TAPS; k++) {
+            re += h[k].real() * taps[k];
+            im += h[k].imag() * taps[k];
+        }
+        keys[count++] = keying(cfloat(re, im));
+    }
+
+    // Keep the phasor on the unit circle
+    phase /= std::abs(phase);
+    return count;
+}
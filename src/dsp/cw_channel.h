@@ -0,0 +1,69 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CW_CHANNEL_BOX      20  // Integrate and dump, 100 kHz -> 5 kHz
+#define CW_CHANNEL_DECIM    5   // FIR, 5 kHz -> 1 kHz
+#define CW_CHANNEL_TAPS     64
+
+/*
+ * Narrow CW receiver of a part of the IQ flow. NCO is a rotating phasor, so a
+ * sample costs a complex multiply and an add, FIR runs at the output rate only.
+ * Keying is the envelope in dB against levels of the signal (fast attack, slow
+ * decay) and of the noise (fast decay, slow attack)
+ */
+class CwChannel {
+    float   rate;
+    float   freq = 0.0f;
+    cfloat  phase = 1.0f;
+    cfloat  step = 1.0f;
+
+    cfloat  box_acc = 0.0f;
+    size_t  box_n = 0;
+
+    float   taps[CW_CHANNEL_TAPS];
+    cfloat  hist[CW_CHANNEL_TAPS * 2];  // Written twice, for a linear view of the last taps
+    size_t  hist_pos = 0;
+    size_t  fir_n = 0;
+
+    float   env = 0.0f;
+    float   sig_db;
+    float   noise_db;
+    bool    key = false;
+
+    bool keying(cfloat x);
+
+  public:
+    CwChannel(float rate);
+
+    /**
+     * Start on the freq (Hz from the flow center), levels are reset
+     */
+    void reset(float freq);
+
+    /**
+     * Move NCO by diff Hz, keep levels
+     */
+    void shift(float diff);
+
+    /**
+     * Process block, key states of the output samples go to keys (size / CW_CHANNEL_BOX /
+     * CW_CHANNEL_DECIM + 1 items at most). Returns count of them
+     */
+    size_t execute(const cfloat *in, size_t size, bool *keys);
+
+    float get_freq() const { return freq; }
+    float get_snr() const { return sig_db - noise_db; }
+    float get_key_ms() const { return 1000.0f * CW_CHANNEL_BOX * CW_CHANNEL_DECIM / rate; }
+};
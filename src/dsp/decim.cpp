@@ -0,0 +1,96 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "decim.h"
+
+#include <string.h>
+
+#define HALFBAND_AS        60.0f
+#define HALFBAND_M_FIRST   4   // Early stages: wide transition band
+#define HALFBAND_M_LAST    7   // Last stage: defines final passband edge
+#define ODD_M              8
+#define CALIBRATE_OUT_SIZE 64
+
+DecimChain::DecimChain(size_t factor) {
+    this->factor = factor;
+    odd_factor   = factor;
+
+    size_t stages = 0;
+    while (odd_factor > 1 && odd_factor % 2 == 0) {
+        odd_factor /= 2;
+        stages++;
+    }
+    for (size_t i = 0; i < stages; i++) {
+        bool     last = (i == stages - 1) && (odd_factor == 1);
+        unsigned m    = last ? HALFBAND_M_LAST : HALFBAND_M_FIRST;
+        halfbands.push_back(resamp2_crcf_create(m, 0.0f, HALFBAND_AS));
+    }
+    if (odd_factor > 1) {
+        odd = firdecim_crcf_create_kaiser(odd_factor, ODD_M, HALFBAND_AS);
+    }
+
+    // Match DC gain of single stage decimator
+    std::vector<cfloat> in(CALIBRATE_OUT_SIZE * factor, 1.0f);
+    std::vector<cfloat> out(CALIBRATE_OUT_SIZE);
+
+    firdecim_crcf ref = firdecim_crcf_create_kaiser(factor, ODD_M, HALFBAND_AS);
+    firdecim_crcf_set_scale(ref, sqrtf(1.0f / (float)factor));
+    firdecim_crcf_execute_block(ref, in.data(), CALIBRATE_OUT_SIZE, out.data());
+    firdecim_crcf_destroy(ref);
+    float ref_gain = std::abs(out.back());
+
+    execute(in.data(), CALIBRATE_OUT_SIZE, out.data());
+    float chain_gain = std::abs(out.back());
+    if (chain_gain > 0.0f) {
+        gain = ref_gain / chain_gain;
+    }
+    reset();
+}
+
+DecimChain::~DecimChain() {
+    for (auto hb : halfbands) {
+        resamp2_crcf_destroy(hb);
+    }
+    if (odd) {
+        firdecim_crcf_destroy(odd);
+    }
+}
+
+void DecimChain::reset() {
+    for (auto hb : halfbands) {
+        resamp2_crcf_reset(hb);
+    }
+    if (odd) {
+        firdecim_crcf_reset(odd);
+    }
+}
+
+void DecimChain::execute(const cfloat *in, size_t out_size, cfloat *out) {
+    const cfloat *src = in;
+    size_t        n   = out_size * factor;
+
+    if (work.size() < n / 2) {
+        work.resize(n / 2);
+    }
+    for (size_t s = 0; s < halfbands.size(); s++) {
+        // Last stage without odd remainder writes directly to output, others - in place to work buffer
+        cfloat *dst = (!odd && s == halfbands.size() - 1) ? out : work.data();
+
+        n /= 2;
+        for (size_t i = 0; i < n; i++) {
+            resamp2_crcf_decim_execute(halfbands[s], const_cast<cfloat *>(&src[i * 2]), &dst[i]);
+        }
+        src = dst;
+    }
+    if (odd) {
+        firdecim_crcf_execute_block(odd, const_cast<cfloat *>(src), out_size, out);
+    } else if (halfbands.empty()) {
+        memcpy(out, src, out_size * sizeof(cfloat));
+    }
+    liquid_vectorcf_mulscalar(out, out_size, gain, out);
+}
@@ -0,0 +1,43 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <liquid/liquid.h>
+
+#include <vector>
+
+/*
+ * Multistage decimator: cascade of halfband stages for power of 2 part of factor,
+ * optional Kaiser FIR for odd remainder. Output level matches single stage
+ * firdecim_crcf_create_kaiser(factor, 8, 60) with scale sqrt(1/factor)
+ */
+class DecimChain {
+    size_t                    factor;
+    size_t                    odd_factor;
+    std::vector<resamp2_crcf> halfbands;
+    firdecim_crcf             odd  = NULL;
+    float                     gain = 1.0f;
+    std::vector<cfloat>       work;
+
+  public:
+    DecimChain(size_t factor);
+    ~DecimChain();
+
+    size_t get_factor() { return factor; }
+    size_t get_num_stages() { return halfbands.size() + (odd ? 1 : 0); }
+
+    void reset();
+
+    /**
+     * Produce `out_size` samples from `out_size * factor` input samples
+     */
+    void execute(const cfloat *in, size_t out_size, cfloat *out);
+};
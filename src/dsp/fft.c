@@ -0,0 +1,515 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "fft.h"
+
+#include <liquid/liquid.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define MAX_STAGES  32
+
+typedef struct {
+    float r;
+    float i;
+} cpx_t;
+
+/*
+ * Decimation in time, as in KISS FFT: stage d splits the input by its radix p
+ * and combines p sub-transforms of m points each. Twiddles of a stage are laid
+ * out per butterfly leg, tw[(q - 1) * m + k] = w^(q * k * stride), so kernels
+ * read them sequentially
+ */
+typedef struct {
+    uint16_t    p;
+    uint16_t    m;
+    cpx_t       *tw;
+} stage_t;
+
+struct fft_plan_t {
+    size_t          n;
+    fft_dir_t       dir;
+    fft_backend_t   backend;
+    uint32_t        refs;
+    fft_plan_t      *next;
+
+    /* Native */
+    uint8_t         stages_num;
+    stage_t         stages[MAX_STAGES];
+    cpx_t           *tw;            /* w^k of the whole size, for the generic radix */
+    cpx_t           *stage_tw;
+
+    /* Liquid, the plan is bound to the buffers */
+    fftplan         liquid;
+    cfloat          *liquid_in;
+    cfloat          *liquid_out;
+    pthread_mutex_t liquid_mux;
+};
+
+static const char       *backend_names[] = { "native", "liquid" };
+
+static fft_plan_t       *cache = NULL;
+static pthread_mutex_t  cache_mux = PTHREAD_MUTEX_INITIALIZER;
+
+static cpx_t twiddle(size_t k, size_t n, fft_dir_t dir) {
+    double  phase = (dir == FFT_DIR_FORWARD ? -2.0 : 2.0) * M_PI * k / n;
+    cpx_t   w = { cos(phase), sin(phase) };
+
+    return w;
+}
+
+static inline cpx_t cmul(cpx_t a, cpx_t b) {
+    cpx_t res = { a.r * b.r - a.i * b.i, a.r * b.i + a.i * b.r };
+
+    return res;
+}
+
+/* Butterflies */
+
+#ifdef __ARM_NEON
+static inline float32x4x2_t neon_cmul(float32x4x2_t a, float32x4x2_t b) {
+    float32x4x2_t res;
+
+    res.val[0] = vmlsq_f32(vmulq_f32(a.val[0], b.val[0]), a.val[1], b.val[1]);
+    res.val[1] = vmlaq_f32(vmulq_f32(a.val[0], b.val[1]), a.val[1], b.val[0]);
+    return res;
+}
+#endif
+
+static void bfly2(cpx_t *out, const stage_t *stage) {
+    cpx_t       *out2 = out + stage->m;
+    const cpx_t *tw = stage->tw;
+    size_t      k = 0;
+
+#ifdef __ARM_NEON
+    for (; k + 4 <= stage->m; k += 4) {
+        float32x4x2_t a = vld2q_f32((float *) &out[k]);
+        float32x4x2_t t = neon_cmul(vld2q_f32((float *) &out2[k]), vld2q_f32((const float *) &tw[k]));
+        float32x4x2_t sum, diff;
+
+        sum.val[0] = vaddq_f32(a.val[0], t.val[0]);
+        sum.val[1] = vaddq_f32(a.val[1], t.val[1]);
+        diff.val[0] = vsubq_f32(a.val[0], t.val[0]);
+        diff.val[1] = vsubq_f32(a.val[1], t.val[1]);
+
+        vst2q_f32((float *) &out[k], sum);
+        vst2q_f32((float *) &out2[k], diff);
+    }
+#endif
+    for (; k < stage->m; k++) {
+        cpx_t t = cmul(out2[k], tw[k]);
+
+        out2[k].r = out[k].r - t.r;
+        out2[k].i = out[k].i - t.i;
+        out[k].r += t.r;
+        out[k].i += t.i;
+    }
+}
+
+static void bfly4(cpx_t *out, const stage_t *stage, bool backward) {
+    size_t      m = stage->m;
+    const cpx_t *tw1 = stage->tw;
+    const cpx_t *tw2 = tw1 + m;
+    const cpx_t *tw3 = tw2 + m;
+    size_t      k = 0;
+
+#ifdef __ARM_NEON
+    for (; k + 4 <= m; k += 4) {
+        float32x4x2_t f0 = vld2q_f32((float *) &out[k]);
+        float32x4x2_t s0 = neon_cmul(vld2q_f32((float *) &out[k + m]), vld2q_f32((const float *) &tw1[k]));
+        float32x4x2_t s1 = neon_cmul(vld2q_f32((float *) &out[k + 2 * m]), vld2q_f32((const float *) &tw2[k]));
+        float32x4x2_t s2 = neon_cmul(vld2q_f32((float *) &out[k + 3 * m]), vld2q_f32((const float *) &tw3[k]));
+        float32x4x2_t s3, s4, s5, o0, o1, o2, o3;
+
+        s5.val[0] = vsubq_f32(f0.val[0], s1.val[0]);
+        s5.val[1] = vsubq_f32(f0.val[1], s1.val[1]);
+        f0.val[0] = vaddq_f32(f0.val[0], s1.val[0]);
+        f0.val[1] = vaddq_f32(f0.val[1], s1.val[1]);
+        s3.val[0] = vaddq_f32(s0.val[0], s2.val[0]);
+        s3.val[1] = vaddq_f32(s0.val[1], s2.val[1]);
+        s4.val[0] = vsubq_f32(s0.val[0], s2.val[0]);
+        s4.val[1] = vsubq_f32(s0.val[1], s2.val[1]);
+
+        o0.val[0] = vaddq_f32(f0.val[0], s3.val[0]);
+        o0.val[1] = vaddq_f32(f0.val[1], s3.val[1]);
+        o2.val[0] = vsubq_f32(f0.val[0], s3.val[0]);
+        o2.val[1] = vsubq_f32(f0.val[1], s3.val[1]);
+
+        if (backward) {
+            o1.val[0] = vsubq_f32(s5.val[0], s4.val[1]);
+            o1.val[1] = vaddq_f32(s5.val[1], s4.val[0]);
+            o3.val[0] = vaddq_f32(s5.val[0], s4.val[1]);
+            o3.val[1] = vsubq_f32(s5.val[1], s4.val[0]);
+        } else {
+            o1.val[0] = vaddq_f32(s5.val[0], s4.val[1]);
+            o1.val[1] = vsubq_f32(s5.val[1], s4.val[0]);
+            o3.val[0] = vsubq_f32(s5.val[0], s4.val[1]);
+            o3.val[1] = vaddq_f32(s5.val[1], s4.val[0]);
+        }
+
+        vst2q_f32((float *) &out[k], o0);
+        vst2q_f32((float *) &out[k + m], o1);
+        vst2q_f32((float *) &out[k + 2 * m], o2);
+        vst2q_f32((float *) &out[k + 3 * m], o3);
+    }
+#endif
+    for (; k < m; k++) {
+        cpx_t s0 = cmul(out[k + m], tw1[k]);
+        cpx_t s1 = cmul(out[k + 2 * m], tw2[k]);
+        cpx_t s2 = cmul(out[k + 3 * m], tw3[k]);
+        cpx_t f0 = out[k];
+        cpx_t s3 = { s0.r + s2.r, s0.i + s2.i };
+        cpx_t s4 = { s0.r - s2.r, s0.i - s2.i };
+        cpx_t s5 = { f0.r - s1.r, f0.i - s1.i };
+
+        f0.r += s1.r;
+        f0.i += s1.i;
+
+        out[k].r = f0.r + s3.r;
+        out[k].i = f0.i + s3.i;
+        out[k + 2 * m].r = f0.r - s3.r;
+        out[k + 2 * m].i = f0.i - s3.i;
+
+        if (backward) {
+            out[k + m].r = s5.r - s4.i;
+            out[k + m].i = s5.i + s4.r;
+            out[k + 3 * m].r = s5.r + s4.i;
+            out[k + 3 * m].i = s5.i - s4.r;
+        } else {
+            out[k + m].r = s5.r + s4.i;
+            out[k + m].i = s5.i - s4.r;
+            out[k + 3 * m].r = s5.r - s4.i;
+            out[k + 3 * m].i = s5.i + s4.r;
+        }
+    }
+}
+
+static void bfly3(cpx_t *out, const stage_t *stage, cpx_t epi3) {
+    size_t      m = stage->m;
+    const cpx_t *tw1 = stage->tw;
+    const cpx_t *tw2 = tw1 + m;
+
+    for (size_t k = 0; k < m; k++) {
+        cpx_t s1 = cmul(out[k + m], tw1[k]);
+        cpx_t s2 = cmul(out[k + 2 * m], tw2[k]);
+        cpx_t s3 = { s1.r + s2.r, s1.i + s2.i };
+        cpx_t s0 = { (s1.r - s2.r) * epi3.i, (s1.i - s2.i) * epi3.i };
+        cpx_t a = { out[k].r - s3.r * 0.5f, out[k].i - s3.i * 0.5f };
+
+        out[k].r += s3.r;
+        out[k].i += s3.i;
+        out[k + m].r = a.r - s0.i;
+        out[k + m].i = a.i + s0.r;
+        out[k + 2 * m].r = a.r + s0.i;
+        out[k + 2 * m].i = a.i - s0.r;
+    }
+}
+
+static void bfly5(cpx_t *out, const stage_t *stage, cpx_t ya, cpx_t yb) {
+    size_t      m = stage->m;
+    const cpx_t *tw = stage->tw;
+
+    for (size_t k = 0; k < m; k++) {
+        cpx_t s0 = out[k];
+        cpx_t s1 = cmul(out[k + m], tw[k]);
+        cpx_t s2 = cmul(out[k + 2 * m], tw[m + k]);
+        cpx_t s3 = cmul(out[k + 3 * m], tw[2 * m + k]);
+        cpx_t s4 = cmul(out[k + 4 * m], tw[3 * m + k]);
+
+        cpx_t s7 = { s1.r + s4.r, s1.i + s4.i };
+        cpx_t s10 = { s1.r - s4.r, s1.i - s4.i };
+        cpx_t s8 = { s2.r + s3.r, s2.i + s3.i };
+        cpx_t s9 = { s2.r - s3.r, s2.i - s3.i };
+
+        cpx_t s5 = { s0.r + s7.r * ya.r + s8.r * yb.r, s0.i + s7.i * ya.r + s8.i * yb.r };
+        cpx_t s6 = { s10.i * ya.i + s9.i * yb.i, -s10.r * ya.i - s9.r * yb.i };
+        cpx_t s11 = { s0.r + s7.r * yb.r + s8.r * ya.r, s0.i + s7.i * yb.r + s8.i * ya.r };
+        cpx_t s12 = { -s10.i * yb.i + s9.i * ya.i, s10.r * yb.i - s9.r * ya.i };
+
+        out[k].r = s0.r + s7.r + s8.r;
+        out[k].i = s0.i + s7.i + s8.i;
+        out[k + m].r = s5.r - s6.r;
+        out[k + m].i = s5.i - s6.i;
+        out[k + 4 * m].r = s5.r + s6.r;
+        out[k + 4 * m].i = s5.i + s6.i;
+        out[k + 2 * m].r = s11.r + s12.r;
+        out[k + 2 * m].i = s11.i + s12.i;
+        out[k + 3 * m].r = s11.r - s12.r;
+        out[k + 3 * m].i = s11.i - s12.i;
+    }
+}
+
+static void bfly_generic(const fft_plan_t *plan, cpx_t *out, const stage_t *stage, size_t stride) {
+    size_t  m = stage->m;
+    size_t  p = stage->p;
+    cpx_t   scratch[p];
+
+    for (size_t u = 0; u < m; u++) {
+        for (size_t q = 0; q < p; q++) {
+            scratch[q] = out[u + q * m];
+        }
+        for (size_t q1 = 0; q1 < p; q1++) {
+            size_t  k = u + q1 * m;
+            size_t  tw_idx = 0;
+            cpx_t   sum = scratch[0];
+
+            for (size_t q = 1; q < p; q++) {
+                tw_idx += stride * k;
+
+                if (tw_idx >= plan->n) {
+                    tw_idx %= plan->n;
+                }
+
+                cpx_t t = cmul(scratch[q], plan->tw[tw_idx]);
+
+                sum.r += t.r;
+                sum.i += t.i;
+            }
+            out[k] = sum;
+        }
+    }
+}
+
+static void work(const fft_plan_t *plan, cpx_t *out, const cpx_t *in, size_t stride, uint8_t depth) {
+    const stage_t   *stage = &plan->stages[depth];
+    size_t          p = stage->p;
+    size_t          m = stage->m;
+    cpx_t           *end = out + p * m;
+
+    if (m == 1) {
+        for (cpx_t *o = out; o != end; o++) {
+            *o = *in;
+            in += stride;
+        }
+    } else {
+        for (cpx_t *o = out; o != end; o += m) {
+            work(plan, o, in, stride * p, depth + 1);
+            in += stride;
+        }
+    }
+
+    switch (p) {
+        case 2:
+            bfly2(out, stage);
+            break;
+
+        case 3:
+            bfly3(out, stage, plan->tw[stride * m]);
+            break;
+
+        case 4:
+            bfly4(out, stage, plan->dir == FFT_DIR_BACKWARD);
+            break;
+
+        case 5:
+            bfly5(out, stage, plan->tw[stride * m], plan->tw[2 * stride * m]);
+            break;
+
+        default:
+            bfly_generic(plan, out, stage, stride);
+            break;
+    }
+}
+
+/* Plans */
+
+static bool native_create(fft_plan_t *plan) {
+    size_t  n = plan->n;
+    size_t  p = 4;
+    size_t  rest = n;
+    size_t  stride = 1;
+    size_t  tw_total = 0;
+
+    if (n == 1) {
+        /* Single copy stage */
+        plan->stages[0].p = 1;
+        plan->stages[0].m = 1;
+        plan->stages_num = 1;
+    }
+
+    /* Radix 4 first, then 2, 3, 5 and odd numbers */
+    while (rest > 1) {
+        while (rest % p) {
+            switch (p) {
+                case 4: p = 2; break;
+                case 2: p = 3; break;
+                default: p += 2; break;
+            }
+            if (p * p > rest) {
+                p = rest;
+            }
+        }
+        if (plan->stages_num == MAX_STAGES) {
+            return false;
+        }
+        rest /= p;
+        plan->stages[plan->stages_num].p = p;
+        plan->stages[plan->stages_num].m = rest;
+        plan->stages_num++;
+        tw_total += (p - 1) * rest;
+    }
+
+    plan->tw = malloc(sizeof(cpx_t) * n);
+    plan->stage_tw = malloc(sizeof(cpx_t) * (tw_total ? tw_total : 1));
+
+    if (!plan->tw || !plan->stage_tw) {
+        return false;
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        plan->tw[k] = twiddle(k, n, plan->dir);
+    }
+
+    cpx_t *tw = plan->stage_tw;
+
+    for (uint8_t d = 0; d < plan->stages_num; d++) {
+        stage_t *stage = &plan->stages[d];
+
+        stage->tw = tw;
+
+        for (size_t q = 1; q < stage->p; q++) {
+            for (size_t k = 0; k < stage->m; k++) {
+                *tw++ = twiddle(q * k * stride % n, n, plan->dir);
+            }
+        }
+        stride *= stage->p;
+    }
+    return true;
+}
+
+static bool liquid_create(fft_plan_t *plan) {
+    plan->liquid_in = malloc(sizeof(cfloat) * plan->n);
+    plan->liquid_out = malloc(sizeof(cfloat) * plan->n);
+
+    if (!plan->liquid_in || !plan->liquid_out) {
+        return false;
+    }
+    plan->liquid = fft_create_plan(plan->n, plan->liquid_in, plan->liquid_out,
+                                   plan->dir == FFT_DIR_FORWARD ? LIQUID_FFT_FORWARD : LIQUID_FFT_BACKWARD, 0);
+    pthread_mutex_init(&plan->liquid_mux, NULL);
+    return true;
+}
+
+static void plan_destroy(fft_plan_t *plan) {
+    if (plan->liquid) {
+        fft_destroy_plan(plan->liquid);
+        pthread_mutex_destroy(&plan->liquid_mux);
+    }
+    free(plan->liquid_in);
+    free(plan->liquid_out);
+    free(plan->tw);
+    free(plan->stage_tw);
+    free(plan);
+}
+
+static fft_plan_t * plan_create(size_t n, fft_dir_t dir, fft_backend_t backend) {
+    fft_plan_t  *plan = calloc(1, sizeof(fft_plan_t));
+    bool        ok;
+
+    if (!plan) {
+        return NULL;
+    }
+    plan->n = n;
+    plan->dir = dir;
+    plan->backend = backend;
+
+    if (backend == FFT_BACKEND_LIQUID) {
+        ok = liquid_create(plan);
+    } else {
+        ok = native_create(plan);
+    }
+
+    if (!ok) {
+        plan_destroy(plan);
+        return NULL;
+    }
+    return plan;
+}
+
+fft_plan_t * fft_plan_get_backend(size_t n, fft_dir_t dir, fft_backend_t backend) {
+    fft_plan_t *plan;
+
+    if (n == 0 || backend >= FFT_BACKEND_LAST) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache_mux);
+
+    for (plan = cache; plan; plan = plan->next) {
+        if (plan->n == n && plan->dir == dir && plan->backend == backend) {
+            break;
+        }
+    }
+
+    if (!plan) {
+        plan = plan_create(n, dir, backend);
+
+        if (plan) {
+            plan->next = cache;
+            cache = plan;
+        }
+    }
+
+    if (plan) {
+        plan->refs++;
+    }
+
+    pthread_mutex_unlock(&cache_mux);
+    return plan;
+}
+
+fft_plan_t * fft_plan_get(size_t n, fft_dir_t dir) {
+    return fft_plan_get_backend(n, dir, FFT_BACKEND_NATIVE);
+}
+
+void fft_plan_put(fft_plan_t *plan) {
+    if (!plan) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache_mux);
+
+    if (--plan->refs == 0) {
+        fft_plan_t **p = &cache;
+
+        while (*p != plan) {
+            p = &(*p)->next;
+        }
+        *p = plan->next;
+        plan_destroy(plan);
+    }
+
+    pthread_mutex_unlock(&cache_mux);
+}
+
+void fft_plan_execute(const fft_plan_t *plan, const cfloat *in, cfloat *out) {
+    if (plan->backend == FFT_BACKEND_LIQUID) {
+        pthread_mutex_t *mux = (pthread_mutex_t *) &plan->liquid_mux;
+
+        pthread_mutex_lock(mux);
+        memcpy(plan->liquid_in, in, sizeof(cfloat) * plan->n);
+        fft_execute(plan->liquid);
+        memcpy(out, plan->liquid_out, sizeof(cfloat) * plan->n);
+        pthread_mutex_unlock(mux);
+    } else {
+        work(plan, (cpx_t *) out, (const cpx_t *) in, 1, 0);
+    }
+}
+
+const char * fft_backend_name(fft_backend_t backend) {
+    return backend < FFT_BACKEND_LAST ? backend_names[backend] : "";
+}
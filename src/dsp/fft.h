@@ -0,0 +1,64 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stddef.h>
+
+/*
+ * Complex FFT behind the spectral engines. Plans are shared: the cache is
+ * keyed by size, direction and backend, a plan keeps only tables, so one plan
+ * is executed by any number of threads with their own buffers.
+ *
+ * The native backend is a mixed radix 4/2/3/5 transform (every size we use:
+ * 128, 800, 1024, 1152, 3840), radix 4 and 2 butterflies are NEON kernels on
+ * ARM. Liquid is kept as the reference backend. Both are unnormalized and
+ * have the liquid sign convention, forward is exp(-j 2 pi k n / N).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    FFT_DIR_FORWARD = 0,
+    FFT_DIR_BACKWARD,
+} fft_dir_t;
+
+typedef enum {
+    FFT_BACKEND_NATIVE = 0,
+    FFT_BACKEND_LIQUID,
+
+    FFT_BACKEND_LAST
+} fft_backend_t;
+
+typedef struct fft_plan_t fft_plan_t;
+
+/**
+ * Plan of the default backend from the cache, created on the first request
+ */
+fft_plan_t * fft_plan_get(size_t n, fft_dir_t dir);
+fft_plan_t * fft_plan_get_backend(size_t n, fft_dir_t dir, fft_backend_t backend);
+
+/**
+ * Release the reference, the last one destroys the plan
+ */
+void fft_plan_put(fft_plan_t *plan);
+
+/**
+ * Out of place transform of n samples, in and out must not overlap
+ */
+void fft_plan_execute(const fft_plan_t *plan, const cfloat *in, cfloat *out);
+
+const char * fft_backend_name(fft_backend_t backend);
+
+#ifdef __cplusplus
+}
+#endif
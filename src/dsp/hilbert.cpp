@@ -0,0 +1,91 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "hilbert.h"
+
+#include <liquid/liquid.h>
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define S16_SCALE (1.0f / 32768.0f)
+
+BlockHilbert::BlockHilbert(size_t m, float as, size_t max_block) {
+    this->m         = m;
+    this->max_block = max_block;
+    hist_size       = 4 * m;
+
+    size_t h_len = 4 * m + 1;
+    float  beta  = kaiser_beta_As(as);
+
+    // Ideal Hilbert transformer 2 / (pi * t) for odd t, zero for even
+    for (int32_t t = -(int32_t)(2 * m - 1); t < (int32_t)(2 * m); t += 2) {
+        float w = liquid_kaiser(t + 2 * m, h_len, beta);
+        taps.push_back(2.0f / ((float)M_PI * t) * w);
+    }
+    buf.resize(hist_size + max_block);
+    reset();
+}
+
+void BlockHilbert::reset() {
+    std::fill(buf.begin(), buf.end(), 0.0f);
+}
+
+void BlockHilbert::execute(const int16_t *in, size_t size, cfloat *out) {
+    float  *x      = buf.data() + hist_size;
+    float  *center = x - 2 * m;     // Delayed sample, real part of output
+    size_t  i      = 0;
+    size_t  n_taps = taps.size();
+
+    size = std::min(size, max_block);
+
+#ifdef __ARM_NEON
+    for (; i + 4 <= size; i += 4) {
+        int32x4_t s = vmovl_s16(vld1_s16(in + i));
+        vst1q_f32(x + i, vmulq_n_f32(vcvtq_f32_s32(s), S16_SCALE));
+    }
+#endif
+    for (; i < size; i++) {
+        x[i] = in[i] * S16_SCALE;
+    }
+
+    // y[n] = x[n - 2m] + j * sum(h(t) * x[n - 2m - t])
+    i = 0;
+#ifdef __ARM_NEON
+    float *o = reinterpret_cast<float *>(out);
+
+    for (; i + 4 <= size; i += 4) {
+        float32x4x2_t y;
+
+        y.val[0] = vld1q_f32(center + i);
+        y.val[1] = vdupq_n_f32(0.0f);
+        for (size_t k = 0; k < n_taps; k++) {
+            int32_t t = 2 * (int32_t)k - (int32_t)(2 * m - 1);
+            y.val[1]  = vmlaq_n_f32(y.val[1], vld1q_f32(center + i - t), taps[k]);
+        }
+        vst2q_f32(o + i * 2, y);
+    }
+#endif
+    for (; i < size; i++) {
+        float q = 0.0f;
+
+        for (size_t k = 0; k < n_taps; k++) {
+            int32_t t = 2 * (int32_t)k - (int32_t)(2 * m - 1);
+            q += taps[k] * center[(int32_t)i - t];
+        }
+        out[i] = {center[i], q};
+    }
+
+    // Keep last samples as history
+    memmove(buf.data(), buf.data() + size, hist_size * sizeof(float));
+}
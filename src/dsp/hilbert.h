@@ -0,0 +1,38 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Block real-to-complex Hilbert transform of int16 audio (4m+1 taps Kaiser windowed),
+ * drop-in for per sample firhilbf_r2c_execute(firhilbf_create(m, As), x / 32768)
+ */
+class BlockHilbert {
+    size_t             m;
+    size_t             hist_size;
+    size_t             max_block;
+    std::vector<float> taps;    // Odd taps t = -(2m-1), ..., -1, 1, ..., 2m-1
+    std::vector<float> buf;     // History + current block
+
+  public:
+    BlockHilbert(size_t m, float as, size_t max_block);
+    size_t get_max_block() { return max_block; }
+    void   reset();
+
+    /**
+     * Convert `size` samples (<= max_block) to analytic signal
+     */
+    void execute(const int16_t *in, size_t size, cfloat *out);
+};
@@ -0,0 +1,62 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "moving_power.h"
+
+#include <algorithm>
+#include <math.h>
+#include <numeric>
+
+MovingPower::MovingPower(size_t n, size_t step) : buf(n > 0 ? n : 1, 0.0f) {
+    this->step = step > 0 ? step : 1;
+    remain = this->step;
+}
+
+void MovingPower::reset() {
+    std::fill(buf.begin(), buf.end(), 0.0f);
+    pos = 0;
+    filled = 0;
+    remain = step;
+    sum = 0.0f;
+}
+
+bool MovingPower::push(cfloat x) {
+    float p = std::norm(x);
+
+    sum += p - buf[pos];
+    buf[pos] = p;
+
+    if (++pos == buf.size()) {
+        pos = 0;
+        sum = std::accumulate(buf.begin(), buf.end(), 0.0f);
+    }
+    if (filled < buf.size()) {
+        filled++;
+    }
+    if (--remain == 0) {
+        remain = step;
+        return true;
+    }
+    return false;
+}
+
+float MovingPower::get_power() const {
+    if (!filled) {
+        return 0.0f;
+    }
+    return std::max(sum, 0.0f) / filled;
+}
+
+float MovingPower::get_db(float floor) const {
+    float power = get_power();
+
+    if (power <= 0.0f) {
+        return floor;
+    }
+    return std::max(10.0f * log10f(power), floor);
+}
@@ -0,0 +1,56 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Mean power over a sliding window of n samples, ready every step samples.
+ * |x|^2 is kept in a running sum with O(1) add and remove, the sum is
+ * recomputed on each wrap of the window, so float errors don't accumulate.
+ * dB are taken once per output, not per sample.
+ */
+class MovingPower {
+    std::vector<float>  buf;
+    size_t              step;
+    size_t              pos = 0;
+    size_t              filled = 0;
+    size_t              remain;
+    float               sum = 0.0f;
+
+  public:
+    MovingPower(size_t n, size_t step);
+
+    void reset();
+
+    /**
+     * Returns true, when an output is ready, every step samples
+     */
+    bool push(cfloat x);
+
+    size_t size() const {
+        return buf.size();
+    }
+    size_t get_step() const {
+        return step;
+    }
+
+    /**
+     * Mean |x|^2 of the window, filled part of it after reset
+     */
+    float get_power() const;
+
+    /**
+     * 10 * log10 of get_power(), not below floor
+     */
+    float get_db(float floor = -240.0f) const;
+};
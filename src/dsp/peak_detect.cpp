@@ -0,0 +1,157 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "peak_detect.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define EDGE_BINS   3       // Width is checked at 3 bins
+#define SAME_BINS   1.5f
+#define MAX_MISSES  2
+#define WIDTH_DB    6.0f
+
+PeakDetector::PeakDetector(float on_db, float off_db, int32_t dc_bins) : floor(0.5f) {
+    this->on_db = on_db;
+    this->off_db = off_db;
+    this->dc_bins = dc_bins;
+}
+
+void PeakDetector::reset() {
+    floor.reset();
+    count = 0;
+}
+
+static void sort_by_bin(detected_peak_t *peaks, uint8_t *misses, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        detected_peak_t p = peaks[i];
+        uint8_t         m = misses[i];
+        size_t          j = i;
+
+        for (; j > 0 && peaks[j - 1].bin > p.bin; j--) {
+            peaks[j] = peaks[j - 1];
+            misses[j] = misses[j - 1];
+        }
+        peaks[j] = p;
+        misses[j] = m;
+    }
+}
+
+void PeakDetector::update(const float *psd, size_t size) {
+    floor.update(psd, size);
+    floor_db = floor.quantile(0.5f);
+
+    detected_peak_t found[max_peaks];
+    bool            taken[max_peaks] = {false};
+    size_t          found_count = 0;
+    float           off = floor_db + off_db;
+    int32_t         center = size / 2;
+
+    for (int32_t i = EDGE_BINS; i < (int32_t)size - EDGE_BINS; i++) {
+        float v = psd[i];
+
+        if (v < off || v < psd[i - 1] || v <= psd[i + 1] || v < psd[i - 2] || v <= psd[i + 2]) {
+            continue;
+        }
+        if (abs(i - center) < dc_bins) {
+            continue;
+        }
+
+        // Parabolic interpolation of the peak
+        float           d = psd[i - 1] - 2.0f * v + psd[i + 1];
+        float           delta = (d < 0.0f) ? 0.5f * (psd[i - 1] - psd[i + 1]) / d : 0.0f;
+        bool            narrow = psd[i - 3] <= v - WIDTH_DB && psd[i + 3] <= v - WIDTH_DB;
+        detected_peak_t p = {0, i + delta, v - floor_db, 0, narrow};
+
+        if (found_count < max_peaks) {
+            found[found_count++] = p;
+        } else {
+            // Keep the strongest, order is restored by the sort below
+            size_t weakest = 0;
+
+            for (size_t k = 1; k < found_count; k++) {
+                if (found[k].snr < found[weakest].snr) {
+                    weakest = k;
+                }
+            }
+            if (found[weakest].snr < p.snr) {
+                found[weakest] = p;
+            }
+        }
+    }
+
+    detected_peak_t next[max_peaks];
+    uint8_t         next_misses[max_peaks];
+    size_t          n = 0;
+
+    // Tracked peaks take the nearest found one, kept a few frames without it
+    for (size_t t = 0; t < count; t++) {
+        detected_peak_t *p = &peaks[t];
+        int32_t         best = -1;
+        float           best_dist = SAME_BINS;
+
+        for (size_t f = 0; f < found_count; f++) {
+            float dist = fabsf(found[f].bin - p->bin);
+
+            if (!taken[f] && dist < best_dist) {
+                best = f;
+                best_dist = dist;
+            }
+        }
+
+        if (best >= 0) {
+            taken[best] = true;
+            next[n] = found[best];
+            next[n].id = p->id;
+            next[n].hits = p->hits < UINT16_MAX ? p->hits + 1 : p->hits;
+            next_misses[n++] = 0;
+        } else if (misses[t] < MAX_MISSES) {
+            next[n] = *p;
+            next_misses[n++] = misses[t] + 1;
+        }
+    }
+
+    // New ones above the upper threshold
+    for (size_t f = 0; f < found_count && n < max_peaks; f++) {
+        if (taken[f] || found[f].snr < on_db) {
+            continue;
+        }
+        next[n] = found[f];
+        next[n].id = next_id++;
+        next[n].hits = 1;
+        next_misses[n++] = 0;
+
+        if (next_id == 0) {
+            next_id = 1;
+        }
+    }
+
+    sort_by_bin(next, next_misses, n);
+
+    for (size_t i = 0; i < n; i++) {
+        peaks[i] = next[i];
+        misses[i] = next_misses[i];
+    }
+    count = n;
+}
+
+void PeakDetector::shift(float bins, size_t size) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        float bin = peaks[i].bin - bins;
+
+        if (bin < EDGE_BINS || bin >= size - EDGE_BINS) {
+            continue;
+        }
+        peaks[n] = peaks[i];
+        peaks[n].bin = bin;
+        misses[n++] = misses[i];
+    }
+    count = n;
+}
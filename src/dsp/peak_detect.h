@@ -0,0 +1,75 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "spgram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint16_t    id;         // Same while the peak is tracked, never 0
+    float       bin;        // Interpolated, from the first bin of the PSD
+    float       snr;        // dB over the noise floor
+    uint16_t    hits;       // Frames with the peak, saturated
+    bool        narrow;     // Drop of 6 dB at 3 bins, a carrier or CW
+} detected_peak_t;
+
+/*
+ * Peaks of dB PSD frames over the median noise floor. A peak is taken at
+ * on_db and kept down to off_db, it is matched to the nearest one of the last
+ * frame within 1.5 bins and dropped after a few frames without it. Peaks are
+ * sorted by bin.
+ */
+class PeakDetector {
+  public:
+    static constexpr size_t max_peaks = 64;
+
+  private:
+    NoiseFloor      floor;
+    float           on_db;
+    float           off_db;
+    int32_t         dc_bins;
+    uint16_t        next_id = 1;
+    detected_peak_t peaks[max_peaks];
+    uint8_t         misses[max_peaks];
+    size_t          count = 0;
+    float           floor_db = 0.0f;
+
+  public:
+    /**
+     * Bins around the center closer than dc_bins are skipped, 0 if the PSD is not of baseband
+     */
+    PeakDetector(float on_db = 12.0f, float off_db = 6.0f, int32_t dc_bins = 2);
+
+    void reset();
+    void update(const float *psd, size_t size);
+
+    /**
+     * Follow retune by whole and fractional bins, peaks out of the PSD are dropped
+     */
+    void shift(float bins, size_t size);
+
+    /**
+     * Quantile of the noise floor histogram, the median is the reference of SNR
+     */
+    float floor_quantile(float q) {
+        return floor.quantile(q);
+    }
+    float floor_median() const {
+        return floor_db;
+    }
+
+    const detected_peak_t *values() const {
+        return peaks;
+    }
+    size_t size() const {
+        return count;
+    }
+};
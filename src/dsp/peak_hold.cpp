@@ -0,0 +1,119 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "peak_hold.h"
+
+#include <algorithm>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+const peak_hold_profile_t peak_hold_contest = {1000.0f, 1.5f};
+const peak_hold_profile_t peak_hold_dx      = {10000.0f, 0.2f};
+
+PeakHold::PeakHold(size_t size) : val(size), age(size) {
+    reset(-200.0f);
+}
+
+void PeakHold::set_profile(const peak_hold_profile_t &p) {
+    profile = p;
+}
+
+void PeakHold::reset(float value) {
+    std::fill(val.begin(), val.end(), value);
+    std::fill(age.begin(), age.end(), 0.0f);
+}
+
+void PeakHold::shift(int32_t delta, float value) {
+    int32_t n = val.size();
+
+    if (delta >= n || delta <= -n) {
+        reset(value);
+        return;
+    }
+    if (delta > 0) {
+        std::copy(val.begin() + delta, val.end(), val.begin());
+        std::copy(age.begin() + delta, age.end(), age.begin());
+        std::fill(val.end() - delta, val.end(), value);
+        std::fill(age.end() - delta, age.end(), 0.0f);
+    } else if (delta < 0) {
+        std::copy_backward(val.begin(), val.end() + delta, val.end());
+        std::copy_backward(age.begin(), age.end() + delta, age.end());
+        std::fill(val.begin(), val.begin() - delta, value);
+        std::fill(age.begin(), age.begin() - delta, 0.0f);
+    }
+}
+
+void PeakHold::update(const float *x, float dt_ms) {
+    update_range(nullptr, x, 0.0f, false, dt_ms, true);
+}
+
+void PeakHold::smooth_update(float *smoothed, const float *x, float beta, float dt_ms, bool peaks) {
+    update_range(smoothed, x, beta, true, dt_ms, peaks);
+}
+
+void PeakHold::update_range(float *smoothed, const float *x, float beta, bool smooth, float dt_ms, bool peaks) {
+    size_t n       = val.size();
+    size_t i       = 0;
+    float  hold    = profile.hold_ms;
+    float  decay   = profile.decay_db;
+    float  age_max = hold + 1.0f;
+    float *v       = val.data();
+    float *a       = age.data();
+
+#ifdef __ARM_NEON
+    float32x4_t vbeta  = vdupq_n_f32(beta);
+    float32x4_t vgain  = vdupq_n_f32(1.0f - beta);
+    float32x4_t vdt    = vdupq_n_f32(dt_ms);
+    float32x4_t vhold  = vdupq_n_f32(hold);
+    float32x4_t vdecay = vdupq_n_f32(decay);
+    float32x4_t vmax   = vdupq_n_f32(age_max);
+    float32x4_t vzero  = vdupq_n_f32(0.0f);
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t cur = vld1q_f32(x + i);
+
+        if (smooth) {
+            cur = vmlaq_f32(vmulq_f32(cur, vgain), vld1q_f32(smoothed + i), vbeta);
+            vst1q_f32(smoothed + i, cur);
+        }
+        if (!peaks) {
+            continue;
+        }
+
+        float32x4_t pv  = vld1q_f32(v + i);
+        float32x4_t pa  = vminq_f32(vaddq_f32(vld1q_f32(a + i), vdt), vmax);
+        uint32x4_t  up  = vcgtq_f32(cur, pv);
+        uint32x4_t  old = vcgtq_f32(pa, vhold);
+
+        pv = vbslq_f32(old, vsubq_f32(pv, vdecay), pv);
+        vst1q_f32(v + i, vbslq_f32(up, cur, pv));
+        vst1q_f32(a + i, vbslq_f32(up, vzero, pa));
+    }
+#endif
+
+    for (; i < n; i++) {
+        float cur = x[i];
+
+        if (smooth) {
+            cur = smoothed[i] * beta + cur * (1.0f - beta);
+            smoothed[i] = cur;
+        }
+        if (!peaks) {
+            continue;
+        }
+
+        bool  up = cur > v[i];
+        float pa = std::min(a[i] + dt_ms, age_max);
+        float pv = (pa > hold) ? v[i] - decay : v[i];
+
+        v[i] = up ? cur : pv;
+        a[i] = up ? 0.0f : pa;
+    }
+}
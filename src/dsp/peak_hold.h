@@ -0,0 +1,61 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+typedef struct {
+    float hold_ms;  // Time to keep peak after it was reached
+    float decay_db; // Decay per update after hold time
+} peak_hold_profile_t;
+
+extern const peak_hold_profile_t peak_hold_contest;
+extern const peak_hold_profile_t peak_hold_dx;
+
+/*
+ * Peak hold with decay for a block of bins, arrays layout (value, age) and smoothing
+ * buffer are the same, so lpf and peak are updated in one pass without per-bin branches
+ */
+class PeakHold {
+    std::vector<float>  val;
+    std::vector<float>  age;    // ms since peak, saturated at hold_ms + 1
+    peak_hold_profile_t profile = {5000.0f, 0.5f};
+
+    void update_range(float *smoothed, const float *x, float beta, bool smooth, float dt_ms, bool peaks);
+
+  public:
+    PeakHold(size_t size);
+
+    void set_profile(const peak_hold_profile_t &p);
+    void reset(float value);
+
+    /**
+     * Move bins by delta: val[i] = val[i + delta], `value` for the new ones
+     */
+    void shift(int32_t delta, float value);
+
+    /**
+     * Update peaks by the block
+     */
+    void update(const float *x, float dt_ms);
+
+    /**
+     * smoothed = smoothed * beta + x * (1 - beta), then update peaks by smoothed (if `peaks`)
+     */
+    void smooth_update(float *smoothed, const float *x, float beta, float dt_ms, bool peaks);
+
+    const float *values() const {
+        return val.data();
+    }
+    size_t size() const {
+        return val.size();
+    }
+};
@@ -0,0 +1,137 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "poly_resamp.h"
+
+#include <liquid/liquid.h>
+
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+static size_t gcd(size_t a, size_t b) {
+    while (b) {
+        size_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * sum(x[k] * h[k]) of complex x and real h
+ */
+static inline cfloat dot(const cfloat *x, const float *h, size_t n) {
+    const float *xf = reinterpret_cast<const float *>(x);
+    float        re = 0.0f;
+    float        im = 0.0f;
+    size_t       k  = 0;
+
+#ifdef __ARM_NEON
+    float32x4_t acc_re = vdupq_n_f32(0.0f);
+    float32x4_t acc_im = vdupq_n_f32(0.0f);
+
+    for (; k + 4 <= n; k += 4) {
+        float32x4x2_t v = vld2q_f32(xf + k * 2);
+        float32x4_t   t = vld1q_f32(h + k);
+
+        acc_re = vmlaq_f32(acc_re, v.val[0], t);
+        acc_im = vmlaq_f32(acc_im, v.val[1], t);
+    }
+
+    float32x2_t s = vpadd_f32(vadd_f32(vget_low_f32(acc_re), vget_high_f32(acc_re)),
+                              vadd_f32(vget_low_f32(acc_im), vget_high_f32(acc_im)));
+
+    re = vget_lane_f32(s, 0);
+    im = vget_lane_f32(s, 1);
+#endif
+    for (; k < n; k++) {
+        re += xf[k * 2] * h[k];
+        im += xf[k * 2 + 1] * h[k];
+    }
+    return cfloat(re, im);
+}
+
+PolyResampler::PolyResampler(uint32_t in_rate, uint32_t out_rate, size_t taps_per_phase, float as) {
+    size_t g = gcd(in_rate, out_rate);
+
+    l = out_rate / g;
+    m = in_rate / g;
+    this->taps_per_phase = taps_per_phase;
+
+    // Prototype at in_rate * l, cut off at half of the lower rate
+    size_t             n = l * taps_per_phase;
+    std::vector<float> h(n);
+
+    liquid_firdes_kaiser(n, 0.5f / std::max(l, m), as, 0.0f, h.data());
+
+    // Unity DC gain of each phase
+    float scale = l / std::accumulate(h.begin(), h.end(), 0.0f);
+
+    taps.resize(n);
+    for (size_t p = 0; p < l; p++) {
+        for (size_t j = 0; j < taps_per_phase; j++) {
+            taps[p * taps_per_phase + j] = h[p + (taps_per_phase - 1 - j) * l] * scale;
+        }
+    }
+    reset();
+}
+
+void PolyResampler::reset() {
+    phase = 0;
+    buf.assign(taps_per_phase - 1, 0.0f);
+}
+
+size_t PolyResampler::input_size(size_t out_size) const {
+    return (phase + out_size * m) / l;
+}
+
+void PolyResampler::execute(const cfloat *in, size_t out_size, cfloat *out) {
+    size_t hist = taps_per_phase - 1;
+    size_t n_in = input_size(out_size);
+    size_t acc  = phase;
+
+    if (buf.size() < hist + n_in) {
+        buf.resize(hist + n_in);
+    }
+    memcpy(&buf[hist], in, n_in * sizeof(cfloat));
+
+    // Output j: newest input (phase + j * m) / l, polyphase branch (phase + j * m) % l
+    for (size_t j = 0; j < out_size; j++) {
+        out[j] = dot(&buf[acc / l], &taps[(acc % l) * taps_per_phase], taps_per_phase);
+        acc += m;
+    }
+    phase = acc - n_in * l;
+
+    memmove(buf.data(), &buf[n_in], hist * sizeof(cfloat));
+}
+
+PolyResampler *poly_resamp_create(uint32_t in_rate, uint32_t out_rate) {
+    return new PolyResampler(in_rate, out_rate);
+}
+
+void poly_resamp_delete(PolyResampler *p) {
+    delete p;
+}
+
+void poly_resamp_reset(PolyResampler *p) {
+    p->reset();
+}
+
+size_t poly_resamp_input_size(PolyResampler *p, size_t out_size) {
+    return p->input_size(out_size);
+}
+
+void poly_resamp_execute(PolyResampler *p, const cfloat *in, size_t out_size, cfloat *out) {
+    p->execute(in, out_size, out);
+}
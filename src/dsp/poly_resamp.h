@@ -0,0 +1,64 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Rational polyphase resampler by L / M, Kaiser windowed sinc prototype with
+ * unity DC gain, cut off at the lower of the rates. Input count per output
+ * block varies with the phase, input_size() tells how much the next block takes
+ */
+#ifdef __cplusplus
+#include <vector>
+
+class PolyResampler {
+    size_t              l;
+    size_t              m;
+    size_t              taps_per_phase;
+    size_t              phase = 0;      // Of the next output, 0..l-1
+    std::vector<float>  taps;           // Per phase, reversed: phase p at p * taps_per_phase
+    std::vector<cfloat> buf;            // History (taps_per_phase - 1) + input
+
+  public:
+    PolyResampler(uint32_t in_rate, uint32_t out_rate, size_t taps_per_phase = 32, float as = 60.0f);
+
+    void reset();
+
+    /**
+     * Input samples, which produce `out_size` output samples from the current phase
+     */
+    size_t input_size(size_t out_size) const;
+
+    /**
+     * Produce `out_size` samples, takes exactly input_size(out_size) samples of `in`
+     */
+    void execute(const cfloat *in, size_t out_size, cfloat *out);
+};
+#else
+typedef struct PolyResampler PolyResampler;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+PolyResampler *poly_resamp_create(uint32_t in_rate, uint32_t out_rate);
+void           poly_resamp_delete(PolyResampler *p);
+void           poly_resamp_reset(PolyResampler *p);
+size_t         poly_resamp_input_size(PolyResampler *p, size_t out_size);
+void           poly_resamp_execute(PolyResampler *p, const cfloat *in, size_t out_size, cfloat *out);
+
+#ifdef __cplusplus
+}
+#endif
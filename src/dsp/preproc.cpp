@@ -0,0 +1,51 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "preproc.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+DcBlockSwap::DcBlockSwap(float alpha) {
+    a = 1.0f - alpha;
+    // Unity gain at Nyquist
+    g = (2.0f - alpha) / 2.0f;
+}
+
+void DcBlockSwap::reset() {
+    x1 = 0.0f;
+    y1 = 0.0f;
+}
+
+void DcBlockSwap::execute(cfloat *buf, size_t size) {
+#ifdef __ARM_NEON
+    // Filter is recursive, so I and Q are processed as two lanes
+    float      *p  = reinterpret_cast<float *>(buf);
+    float32x2_t px = {x1.real(), x1.imag()};
+    float32x2_t py = {y1.real(), y1.imag()};
+
+    for (size_t i = 0; i < size; i++, p += 2) {
+        float32x2_t x = vrev64_f32(vld1_f32(p));
+
+        py = vmla_n_f32(vmul_n_f32(vsub_f32(x, px), g), py, a);
+        px = x;
+        vst1_f32(p, py);
+    }
+    x1 = {vget_lane_f32(px, 0), vget_lane_f32(px, 1)};
+    y1 = {vget_lane_f32(py, 0), vget_lane_f32(py, 1)};
+#else
+    for (size_t i = 0; i < size; i++) {
+        cfloat x = {buf[i].imag(), buf[i].real()};
+
+        y1     = g * (x - x1) + a * y1;
+        x1     = x;
+        buf[i] = y1;
+    }
+#endif
+}
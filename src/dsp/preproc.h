@@ -0,0 +1,29 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+
+#include <stddef.h>
+
+/*
+ * In-place flow preprocessing: I/Q swap and first order DC blocker
+ * H(z) = g * (1 - z^-1) / (1 - (1 - alpha) * z^-1) in single pass
+ */
+class DcBlockSwap {
+    float  a;
+    float  g;
+    cfloat x1 = 0.0f;
+    cfloat y1 = 0.0f;
+
+  public:
+    DcBlockSwap(float alpha);
+    void reset();
+    void execute(cfloat *buf, size_t size);
+};
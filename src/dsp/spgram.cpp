@@ -0,0 +1,521 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#include "spgram.h"
+
+#include <lvgl/src/misc/lv_log.h>
+
+#include <algorithm>
+
+extern "C" {
+    #include <math.h>
+    #include <stdio.h>
+    #include <string.h>
+}
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/* Block kernels for ChunkedSpgram */
+
+/*
+ * 10*log10(x) = 10*log10(2) * log2(x). log2 is split to exponent and mantissa,
+ * mantissa in [1, 2) is approximated with 4th order polynomial (error < 1e-3 dB).
+ */
+#define DB_PER_LOG2 3.010299957f
+
+#ifdef __ARM_NEON
+
+static inline void window_block(const cfloat *src, const float *w, cfloat *dst, size_t n) {
+    const float *s = reinterpret_cast<const float *>(src);
+    float       *d = reinterpret_cast<float *>(dst);
+    size_t       i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v  = vld2q_f32(s + i * 2);
+        float32x4_t   wv = vld1q_f32(w + i);
+
+        v.val[0] = vmulq_f32(v.val[0], wv);
+        v.val[1] = vmulq_f32(v.val[1], wv);
+        vst2q_f32(d + i * 2, v);
+    }
+    for (; i < n; i++) {
+        dst[i] = src[i] * w[i];
+    }
+}
+
+static inline void psd_accumulate(const cfloat *freq, float *psd, size_t n, bool first, float alpha, float gamma) {
+    const float *f = reinterpret_cast<const float *>(freq);
+    size_t       i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t x = vld2q_f32(f + i * 2);
+        float32x4_t   v = vmlaq_f32(vmulq_f32(x.val[0], x.val[0]), x.val[1], x.val[1]);
+
+        if (!first) {
+            v = vmlaq_n_f32(vmulq_n_f32(vld1q_f32(psd + i), gamma), v, alpha);
+        }
+        vst1q_f32(psd + i, v);
+    }
+    for (; i < n; i++) {
+        float v = std::norm(freq[i]);
+        psd[i]  = first ? v : gamma * psd[i] + alpha * v;
+    }
+}
+
+static inline void clamp_scale(const float *src, float *dst, size_t n, float scale) {
+    float32x4_t min_v = vdupq_n_f32(LIQUID_SPGRAM_PSD_MIN);
+    size_t      i     = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vmulq_n_f32(vmaxq_f32(vld1q_f32(src + i), min_v), scale));
+    }
+    for (; i < n; i++) {
+        dst[i] = std::max((float)LIQUID_SPGRAM_PSD_MIN, src[i]) * scale;
+    }
+}
+
+static inline float32x4_t db_approx(float32x4_t x) {
+    int32x4_t   xi = vreinterpretq_s32_f32(x);
+    float32x4_t e  = vcvtq_f32_s32(vsubq_s32(vshrq_n_s32(xi, 23), vdupq_n_s32(127)));
+    float32x4_t m  = vreinterpretq_f32_s32(
+        vorrq_s32(vandq_s32(xi, vdupq_n_s32(0x007FFFFF)), vdupq_n_s32(0x3F800000)));
+    float32x4_t p;
+
+    p = vmlaq_f32(vdupq_n_f32(0.62887341f), m, vdupq_n_f32(-0.079158128f));
+    p = vmlaq_f32(vdupq_n_f32(-2.0812137f), m, p);
+    p = vmlaq_f32(vdupq_n_f32(4.0285475f), m, p);
+    p = vmlaq_f32(vdupq_n_f32(-2.4968459f), m, p);
+
+    return vmulq_n_f32(vaddq_f32(p, e), DB_PER_LOG2);
+}
+
+void psd_to_db(float *psd, size_t n) {
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(psd + i, db_approx(vld1q_f32(psd + i)));
+    }
+    for (; i < n; i++) {
+        psd[i] = 10 * log10f(psd[i]);
+    }
+}
+
+#else
+
+static inline void window_block(const cfloat *src, const float *w, cfloat *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = src[i] * w[i];
+    }
+}
+
+static inline void psd_accumulate(const cfloat *freq, float *psd, size_t n, bool first, float alpha, float gamma) {
+    for (size_t i = 0; i < n; i++) {
+        float v = std::norm(freq[i]);
+        psd[i]  = first ? v : gamma * psd[i] + alpha * v;
+    }
+}
+
+static inline void clamp_scale(const float *src, float *dst, size_t n, float scale) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = std::max((float)LIQUID_SPGRAM_PSD_MIN, src[i]) * scale;
+    }
+}
+
+void psd_to_db(float *psd, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        psd[i] = 10 * log10f(psd[i]);
+    }
+}
+
+#endif
+
+/* Chunked spectrum periodogram class */
+
+ChunkedSpgram::ChunkedSpgram(size_t chunk_size, size_t nfft, size_t buffer_size) {
+    this->chunk_size = chunk_size;
+    this->nfft = nfft;
+    if (buffer_size > 0) {
+        this->buffer_size = buffer_size;
+    } else {
+        this->buffer_size = nfft - nfft % chunk_size;
+    }
+    this->buffer_max = nfft - nfft % chunk_size;
+    this->buf_time = (cfloat *) calloc(sizeof(cfloat), nfft);
+    this->buf_freq = (cfloat *) calloc(sizeof(cfloat), nfft);
+    this->psd = (float *) calloc(sizeof(float), nfft);
+    this->fft = fft_plan_get(nfft, FFT_DIR_FORWARD);
+
+    float *w = (float *) calloc(sizeof(float), chunk_size);
+
+    make_window(w, chunk_size, nfft);
+    this->w = w;
+}
+
+ChunkedSpgram::ChunkedSpgram(size_t chunk_size, size_t nfft, size_t buffer_size, size_t buffer_max,
+                             cfloat *buf_time, cfloat *buf_freq, float *psd, const float *w) {
+    this->chunk_size = chunk_size;
+    this->nfft = nfft;
+    this->buffer_size = buffer_size;
+    this->buffer_max = buffer_max;
+    this->buf_time = buf_time;
+    this->buf_freq = buf_freq;
+    this->psd = psd;
+    this->w = w;
+    this->fft = fft_plan_get(nfft, FFT_DIR_FORWARD);
+    this->owned = false;
+
+    std::fill(buf_time, buf_time + nfft, 0.0f);
+    std::fill(buf_freq, buf_freq + nfft, 0.0f);
+    std::fill(psd, psd + nfft, 0.0f);
+}
+
+void ChunkedSpgram::make_window(float *w, size_t chunk_size, size_t nfft) {
+    size_t i;
+    for (i = 0; i < chunk_size; i++) {
+        w[i] = liquid_kaiser(i, chunk_size, 5.0f);
+        // w[i] = liquid_hann(i, chunk_size);
+    }
+    // scale by window magnitude
+    float g = 0.0f;
+    for (i=0; i<chunk_size; i++)
+        g += w[i] * w[i];
+    g = 1.0f / sqrtf(g * nfft / chunk_size);
+
+    // scale window
+    for (i=0; i<chunk_size; i++)
+        w[i] *= g;
+}
+
+ChunkedSpgram::~ChunkedSpgram() {
+    if (owned) {
+        free(this->buf_time);
+        free(this->buf_freq);
+        free(this->psd);
+        free((float *) this->w);
+    }
+
+    fft_plan_put(fft);
+}
+
+void ChunkedSpgram::set_alpha(float val) {
+    // validate input
+    if (val != -1 && (val < 0.0f || val > 1.0f)) {
+        LV_LOG_WARN("alpha must be in {-1,[0,1]}");
+        return;
+    }
+
+    // set accumulation flag appropriately
+    accumulate = (val == -1.0f) ? true : false;
+
+    if (accumulate) {
+        this->alpha = 1.0f;
+        this->gamma = 1.0f;
+    } else {
+        this->alpha = val;
+        this->gamma = 1.0f - val;
+    }
+}
+
+void ChunkedSpgram::clear() {
+    num_transforms = 0;
+    num_samples = 0;
+    memset(psd, 0, sizeof(float) * nfft);
+}
+
+void ChunkedSpgram::reset() {
+    clear();
+    hop_count = 0;
+    fresh = false;
+    std::fill(buf_time, buf_time + nfft, 0.0f);
+}
+
+void ChunkedSpgram::drop_history() {
+    std::fill(buf_time, buf_time + nfft, 0.0f);
+}
+
+void ChunkedSpgram::set_hop(size_t blocks) {
+    hop = std::max((size_t)1, blocks);
+}
+
+void ChunkedSpgram::set_window(size_t blocks) {
+    size_t size = std::clamp(blocks, (size_t)1, buffer_max / chunk_size) * chunk_size;
+
+    if (size == buffer_size) {
+        return;
+    }
+    // Samples of the old window are at other positions, start over
+    buffer_size = size;
+    hop_count = 0;
+    drop_history();
+}
+
+void ChunkedSpgram::execute_block(cfloat *chunk) {
+    // buf_time holds last buffer_size windowed samples, tail up to nfft stays zero
+    size_t keep = buffer_size - chunk_size;
+    if (keep) {
+        memmove(buf_time, buf_time + chunk_size, sizeof(cfloat) * keep);
+    }
+    window_block(chunk, w, buf_time + keep, chunk_size);
+    num_samples += chunk_size;
+
+    if (!hop_due()) {
+        return;
+    }
+    fft_plan_execute(fft, buf_time, buf_freq);
+
+    psd_accumulate(buf_freq, psd, nfft, num_transforms == 0, alpha, gamma);
+    num_transforms++;
+}
+
+void ChunkedSpgram::accumulate_from(const ChunkedSpgram *src) {
+    if (src->nfft != nfft || !src->fresh) {
+        return;
+    }
+    num_samples += src->chunk_size;
+    psd_accumulate(src->buf_freq, psd, nfft, num_transforms == 0, alpha, gamma);
+    num_transforms++;
+}
+
+void ChunkedSpgram::get_psd_mag(float *psd) {
+    // compute magnitude (linear) and run FFT shift
+    size_t nfft_2 = nfft / 2;
+    float scale = accumulate ? 1.0f / std::max((size_t)1, num_transforms) : 1.0f;
+    clamp_scale(this->psd + nfft_2, psd, nfft - nfft_2, scale);
+    clamp_scale(this->psd, psd + nfft - nfft_2, nfft_2, scale);
+    if (accumulate) {
+        clear();
+    }
+}
+
+void ChunkedSpgram::shift(float freq_norm) {
+    float   total = freq_norm * nfft + shift_residual;
+    int32_t bins  = lroundf(total);
+
+    shift_residual = total - bins;
+
+    if ((size_t)abs(bins) >= nfft) {
+        reset();
+        return;
+    }
+
+    // x[n] * exp(-j*2*pi*f*n) moves spectrum of the history down by f
+    cfloat rot  = std::polar(1.0f, -2.0f * (float)M_PI * freq_norm);
+    cfloat ph   = 1.0f;
+    for (size_t i = 0; i < buffer_size; i++) {
+        buf_time[i] *= ph;
+        ph *= rot;
+    }
+
+    if (!bins || !num_transforms) {
+        return;
+    }
+
+    // Accumulated PSD is in FFT order, move it in fft-shifted order, in place
+    size_t nfft_2 = nfft / 2;
+
+    std::rotate(psd, psd + nfft_2, psd + nfft);
+    psd_shift(psd, nfft, bins);
+    std::rotate(psd, psd + nfft - nfft_2, psd + nfft);
+}
+
+void ChunkedSpgram::get_psd(float *psd) {
+    // compute magnitude, linear
+    get_psd_mag(psd);
+    // convert to dB
+    psd_to_db(psd, nfft);
+}
+
+/* Fixed size spgram */
+
+template <size_t Chunk, size_t NFFT, size_t Buffer>
+const float * FixedSpgram<Chunk, NFFT, Buffer>::window() {
+    struct table_t {
+        alignas(16) float w[Chunk];
+        table_t() {
+            make_window(w, Chunk, NFFT);
+        }
+    };
+    static const table_t table;
+
+    return table.w;
+}
+
+template <size_t Chunk, size_t NFFT, size_t Buffer>
+FixedSpgram<Chunk, NFFT, Buffer>::FixedSpgram(size_t buffer_size)
+    : ChunkedSpgram(Chunk, NFFT, buffer_size, Buffer, fixed_time, fixed_freq, fixed_psd, window()) {
+}
+
+template <size_t Chunk, size_t NFFT, size_t Buffer>
+void FixedSpgram<Chunk, NFFT, Buffer>::execute_block(cfloat *chunk) {
+    size_t keep = buffer_size - Chunk;
+
+    if (keep) {
+        memmove(fixed_time, fixed_time + Chunk, sizeof(cfloat) * keep);
+    }
+    window_block(chunk, w, fixed_time + keep, Chunk);
+    num_samples += Chunk;
+
+    if (!hop_due()) {
+        return;
+    }
+    fft_plan_execute(fft, fixed_time, fixed_freq);
+
+    psd_accumulate(fixed_freq, fixed_psd, NFFT, num_transforms == 0, alpha, gamma);
+    num_transforms++;
+}
+
+/*
+ * Waterfall and the spectrum x1 over a packet, spectrum x2..x8 over the decimated packet,
+ * with windows of up to the whole nfft
+ */
+template class FixedSpgram<512, 1024>;
+template class FixedSpgram<256, 800>;
+template class FixedSpgram<170, 800>;
+template class FixedSpgram<128, 800>;
+template class FixedSpgram<102, 800>;
+template class FixedSpgram<85, 800>;
+template class FixedSpgram<73, 800>;
+template class FixedSpgram<64, 800>;
+
+template <size_t Chunk, size_t NFFT>
+static ChunkedSpgram * create_fixed(size_t buffer_size) {
+    return new FixedSpgram<Chunk, NFFT>(buffer_size);
+}
+
+static const struct {
+    size_t          chunk_size;
+    size_t          nfft;
+    ChunkedSpgram * (*create)(size_t buffer_size);
+} fixed_sizes[] = {
+    { 512, 1024, create_fixed<512, 1024> },
+    { 256, 800, create_fixed<256, 800> },
+    { 170, 800, create_fixed<170, 800> },
+    { 128, 800, create_fixed<128, 800> },
+    { 102, 800, create_fixed<102, 800> },
+    { 85, 800, create_fixed<85, 800> },
+    { 73, 800, create_fixed<73, 800> },
+    { 64, 800, create_fixed<64, 800> },
+};
+
+ChunkedSpgram * spgram_create(size_t chunk_size, size_t nfft, size_t buffer_size) {
+    size_t buffer_max = nfft - nfft % chunk_size;
+
+    if (buffer_size == 0) {
+        buffer_size = buffer_max;
+    }
+    for (const auto &size : fixed_sizes) {
+        if (size.chunk_size == chunk_size && size.nfft == nfft && buffer_size <= buffer_max &&
+            buffer_size % chunk_size == 0) {
+            return size.create(buffer_size);
+        }
+    }
+    return new ChunkedSpgram(chunk_size, nfft, buffer_size);
+}
+
+/* Noise floor estimator */
+
+NoiseFloor::NoiseFloor(float decay) {
+    this->decay = decay;
+    reset();
+}
+
+void NoiseFloor::reset() {
+    memset(hist, 0, sizeof(hist));
+    total = 0.0f;
+}
+
+void NoiseFloor::update(const float *psd, size_t size) {
+    for (size_t i = 0; i < num_bins; i++) {
+        hist[i] *= decay;
+    }
+    for (size_t i = 0; i < size; i++) {
+        int32_t bin = (int32_t)((psd[i] - db_min) / db_step);
+
+        if (bin < 0) {
+            bin = 0;
+        } else if (bin >= (int32_t)num_bins) {
+            bin = num_bins - 1;
+        }
+        hist[bin] += 1.0f;
+    }
+    total = total * decay + size;
+}
+
+float NoiseFloor::quantile(float q) {
+    float target = total * q;
+    float acc    = 0.0f;
+
+    for (size_t i = 0; i < num_bins; i++) {
+        if (acc + hist[i] >= target) {
+            // Interpolate inside bin
+            float frac = hist[i] > 0.0f ? (target - acc) / hist[i] : 0.0f;
+            return db_min + ((float)i + frac) * db_step;
+        }
+        acc += hist[i];
+    }
+    return db_min + num_bins * db_step;
+}
+
+/*
+ * Convert shared waterfall PSD (linear, WATERFALL_NFFT bins) to spectrum bins.
+ * Both cover full flow bandwidth, each spectrum bin is interpolated between nearest waterfall bins.
+ */
+void psd_resample(const float *src, size_t src_size, float *dst, size_t dst_size, float scale) {
+    float step = (float)src_size / (float)dst_size;
+    float pos  = (float)(src_size / 2) - (float)(dst_size / 2) * step;
+
+    for (size_t i = 0; i < dst_size; i++, pos += step) {
+        int32_t j    = (int32_t)floorf(pos);
+        float   frac = pos - (float)j;
+
+        if (j < 0) {
+            j    = 0;
+            frac = 0.0f;
+        } else if (j >= (int32_t)src_size - 1) {
+            j    = src_size - 2;
+            frac = 1.0f;
+        }
+        dst[i] = (src[j] + (src[j + 1] - src[j]) * frac) * scale;
+    }
+}
+
+void psd_decimate_peak(const float *src, size_t src_size, float *dst, size_t dst_size) {
+    // Bins are centered as of psd_resample(): bin i is around src bin i * src_size / dst_size
+    auto edge = [=](size_t i) -> size_t {
+        return i ? (src_size * (2 * i - 1) + 2 * dst_size - 1) / (2 * dst_size) : 0;
+    };
+
+    for (size_t i = 0; i < dst_size; i++) {
+        size_t from = edge(i);
+        size_t to   = (i + 1 < dst_size) ? edge(i + 1) : src_size;
+        float  peak = src[from];
+
+        for (size_t j = from + 1; j < to; j++) {
+            peak = std::max(peak, src[j]);
+        }
+        dst[i] = peak;
+    }
+}
+
+void psd_shift(float *psd, size_t n, int32_t bins) {
+    if (bins >= (int32_t)n || bins <= -(int32_t)n) {
+        std::fill(psd, psd + n, bins > 0 ? psd[n - 1] : psd[0]);
+    } else if (bins > 0) {
+        float edge = psd[n - 1];
+
+        memmove(psd, psd + bins, sizeof(float) * (n - bins));
+        std::fill(psd + n - bins, psd + n, edge);
+    } else if (bins < 0) {
+        float edge = psd[0];
+
+        memmove(psd - bins, psd, sizeof(float) * (n + bins));
+        std::fill(psd, psd - bins, edge);
+    }
+}
@@ -0,0 +1,177 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#pragma once
+
+#include "../helpers.h"
+#include "fft.h"
+
+#include <liquid/liquid.h>
+
+#include <stddef.h>
+
+class ChunkedSpgram {
+  protected:
+    size_t   nfft;
+    size_t   chunk_size;
+    size_t   buffer_size;
+    size_t   buffer_max;                // Longest window of set_window()
+    fft_plan_t *fft;
+    cfloat  *buf_time;
+    cfloat  *buf_freq;
+    const float *w;
+    float   *psd;
+    bool     owned          = true;     // Buffers are allocated here, not by FixedSpgram
+    bool     accumulate     = true;
+    float    alpha          = 1.0f;
+    float    gamma          = 1.0f;
+    size_t   num_transforms = 0;
+    size_t   num_samples    = 0;
+    size_t   hop            = 1;        // Transform on every hop-th block
+    size_t   hop_count      = 0;
+    bool     fresh          = false;    // Last block was transformed
+    float    shift_residual = 0.0f;
+
+    /**
+     * Buffers of the derived class, w is the window of make_window()
+     */
+    ChunkedSpgram(size_t chunk_size, size_t nfft, size_t buffer_size, size_t buffer_max,
+                  cfloat *buf_time, cfloat *buf_freq, float *psd, const float *w);
+
+    /**
+     * Kaiser window of chunk_size, scaled by the window magnitude over nfft
+     */
+    static void make_window(float *w, size_t chunk_size, size_t nfft);
+
+    /**
+     * Count the block to the hop, true if it's the one to transform
+     */
+    bool hop_due() {
+        if (++hop_count < hop) {
+            fresh = false;
+            return false;
+        }
+        hop_count = 0;
+        fresh = true;
+        return true;
+    }
+
+  public:
+    ChunkedSpgram(size_t chunk_size, size_t nfft, size_t buffer_size=0);
+    virtual ~ChunkedSpgram();
+    void set_alpha(float val);
+    void clear();
+    void reset();
+    /**
+     * Drop the sample history and keep the accumulated PSD, e.g. after a gap of the stream
+     */
+    void drop_history();
+    /**
+     * Transform every blocks-th block instead of each one, the history still takes all the
+     * samples. The window spans buffer_size / chunk_size blocks: the waterfall one of two
+     * packets overlaps by 50% at hop 1 and doesn't at hop 2, longer hops skip samples
+     */
+    void set_hop(size_t blocks);
+    size_t get_hop() const {
+        return hop;
+    }
+    /**
+     * Transform over the last blocks chunks, up to get_window_max(). The history is dropped
+     * on a change. White noise PSD grows with the window, a tone with its square
+     */
+    void set_window(size_t blocks);
+    size_t get_window() const {
+        return buffer_size / chunk_size;
+    }
+    size_t get_window_max() const {
+        return buffer_max / chunk_size;
+    }
+    virtual void execute_block(cfloat *block);
+    /**
+     * Accumulate PSD from last transform of other spgram with same nfft, without own FFT.
+     * Nothing if the last block of other one wasn't transformed because of its hop
+     */
+    void accumulate_from(const ChunkedSpgram *src);
+    void get_psd_mag(float *psd);
+    void get_psd(float *psd);
+    /**
+     * Follow retune by freq_norm (frequency delta / sample rate): history samples are rotated,
+     * accumulated PSD is moved by whole bins, fractional part is carried to the next shift
+     */
+    void shift(float freq_norm);
+    size_t get_num_transforms() const {
+        return num_transforms;
+    }
+};
+
+/*
+ * ChunkedSpgram of the sizes known at compile time: aligned buffers inside the
+ * object, one window table per instantiation, and the block kernels of
+ * execute_block() with constant lengths, so the compiler unrolls them and
+ * drops the tails. Buffer is the longest window. Instantiated in spgram.cpp
+ * for the sizes of spgram_create()
+ */
+template <size_t Chunk, size_t NFFT, size_t Buffer = NFFT - NFFT % Chunk>
+class FixedSpgram : public ChunkedSpgram {
+    static_assert(Chunk <= Buffer && Buffer <= NFFT, "Chunk <= Buffer <= NFFT");
+
+    alignas(16) cfloat  fixed_time[NFFT];
+    alignas(16) cfloat  fixed_freq[NFFT];
+    alignas(16) float   fixed_psd[NFFT];
+
+    static const float * window();
+
+  public:
+    FixedSpgram(size_t buffer_size = Buffer);
+    void execute_block(cfloat *block) override;
+};
+
+/**
+ * FixedSpgram if the sizes are one of the instantiated (waterfall, spectrum of every zoom)
+ * and buffer_size fits its longest window, ChunkedSpgram otherwise
+ */
+ChunkedSpgram * spgram_create(size_t chunk_size, size_t nfft, size_t buffer_size=0);
+
+/*
+ * Noise floor estimator: quantile over dB histogram, decayed between frames
+ */
+class NoiseFloor {
+    static constexpr float  db_min   = -160.0f;
+    static constexpr float  db_step  = 0.5f;
+    static constexpr size_t num_bins = 320;
+
+    float hist[num_bins];
+    float total = 0.0f;
+    float decay;
+
+  public:
+    NoiseFloor(float decay);
+    void  reset();
+    void  update(const float *psd, size_t size);
+    float quantile(float q);
+};
+
+/**
+ * Convert linear PSD to dB in place
+ */
+void psd_to_db(float *psd, size_t n);
+
+/**
+ * Resample fft-shifted linear PSD to other number of bins over the same bandwidth
+ */
+void psd_resample(const float *src, size_t src_size, float *dst, size_t dst_size, float scale);
+
+/**
+ * Reduce fft-shifted dB PSD to fewer bins over the same bandwidth, each one is the max of the bins it covers
+ */
+void psd_decimate_peak(const float *src, size_t src_size, float *dst, size_t dst_size);
+
+/**
+ * Move fft-shifted PSD by whole bins: psd[i] = psd[i + bins], edge value is repeated for new bins
+ */
+void psd_shift(float *psd, size_t n, int32_t bins);
@@ -0,0 +1,215 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "sub_rx.h"
+
+#include <liquid/liquid.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define FILTER_AS           60.0f
+#define AGC_TARGET          0.3f        // Of the full scale
+#define AGC_MAX_GAIN        10000.0f    // Noise of an empty channel stays low
+#define AGC_RELEASE_S       0.5f
+
+/**
+ * out = in * phasor, the phasor is advanced by step per sample
+ */
+static void mix_block(const cfloat *in, cfloat *out, size_t n, cfloat *phase, cfloat step) {
+    cfloat p = *phase;
+    size_t i = 0;
+
+#ifdef __ARM_NEON
+    if (n >= 4) {
+        // Four phasors, a lane each, advanced by step^4
+        cfloat      lanes[4] = {p, p * step, p * step * step, p * step * step * step};
+        cfloat      step4 = step * step * step * step;
+        float32x4x2_t ph = vld2q_f32(reinterpret_cast<const float *>(lanes));
+        float32x4_t s_re = vdupq_n_f32(step4.real());
+        float32x4_t s_im = vdupq_n_f32(step4.imag());
+
+        for (; i + 4 <= n; i += 4) {
+            float32x4x2_t x = vld2q_f32(reinterpret_cast<const float *>(in + i));
+            float32x4x2_t y;
+
+            y.val[0] = vmlsq_f32(vmulq_f32(x.val[0], ph.val[0]), x.val[1], ph.val[1]);
+            y.val[1] = vmlaq_f32(vmulq_f32(x.val[0], ph.val[1]), x.val[1], ph.val[0]);
+            vst2q_f32(reinterpret_cast<float *>(out + i), y);
+
+            float32x4_t re = vmlsq_f32(vmulq_f32(ph.val[0], s_re), ph.val[1], s_im);
+
+            ph.val[1] = vmlaq_f32(vmulq_f32(ph.val[0], s_im), ph.val[1], s_re);
+            ph.val[0] = re;
+        }
+        vst2q_f32(reinterpret_cast<float *>(lanes), ph);
+        p = lanes[0];
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = in[i] * p;
+        p *= step;
+    }
+
+    // Keep the phasor on the unit circle
+    *phase = p / std::abs(p);
+}
+
+/**
+ * sum(x[k] * h[k]) of complex x and real h
+ */
+static inline cfloat dot(const cfloat *x, const float *h, size_t n) {
+    const float *xf = reinterpret_cast<const float *>(x);
+    float        re = 0.0f;
+    float        im = 0.0f;
+    size_t       k  = 0;
+
+#ifdef __ARM_NEON
+    float32x4_t acc_re = vdupq_n_f32(0.0f);
+    float32x4_t acc_im = vdupq_n_f32(0.0f);
+
+    for (; k + 4 <= n; k += 4) {
+        float32x4x2_t v = vld2q_f32(xf + k * 2);
+        float32x4_t   t = vld1q_f32(h + k);
+
+        acc_re = vmlaq_f32(acc_re, v.val[0], t);
+        acc_im = vmlaq_f32(acc_im, v.val[1], t);
+    }
+
+    float32x2_t s = vpadd_f32(vadd_f32(vget_low_f32(acc_re), vget_high_f32(acc_re)),
+                              vadd_f32(vget_low_f32(acc_im), vget_high_f32(acc_im)));
+
+    re = vget_lane_f32(s, 0);
+    im = vget_lane_f32(s, 1);
+#endif
+    for (; k < n; k++) {
+        re += xf[k * 2] * h[k];
+        im += xf[k * 2 + 1] * h[k];
+    }
+    return cfloat(re, im);
+}
+
+SubRx::SubRx(uint32_t rate, uint32_t out_rate) :
+    rate(rate),
+    channel_rate((float)rate / SUB_RX_DECIM),
+    out_rate(out_rate),
+    decim(SUB_RX_DECIM),
+    resamp(rate / SUB_RX_DECIM, out_rate)
+{
+    set_band(from, to, lsb);
+    reset();
+}
+
+void SubRx::reset() {
+    nco_phase = 1.0f;
+    bfo_phase = 1.0f;
+    decim.reset();
+    std::fill(hist, hist + SUB_RX_TAPS * 2, 0.0f);
+    hist_pos = 0;
+    resamp.reset();
+    pending.clear();
+    env = 0.0f;
+}
+
+void SubRx::setup_nco() {
+    float center = (from + to) / 2.0f;
+
+    if (lsb) {
+        center = -center;
+    }
+    nco_step = std::polar(1.0f, -2.0f * (float)M_PI * (offset + center) / rate);
+    bfo_step = std::polar(1.0f, 2.0f * (float)M_PI * center / out_rate);
+}
+
+void SubRx::set_offset(float hz) {
+    offset = hz;
+    setup_nco();
+}
+
+void SubRx::set_band(float from, float to, bool lsb) {
+    this->from = from;
+    this->to = to;
+    this->lsb = lsb;
+
+    // Complex lowpass of half the width, the sideband is around DC
+    float half = std::max(to - from, 100.0f) / 2.0f;
+    float sum = 0.0f;
+
+    liquid_firdes_kaiser(SUB_RX_TAPS, half / channel_rate, FILTER_AS, 0.0f, taps);
+
+    for (size_t i = 0; i < SUB_RX_TAPS; i++) {
+        sum += taps[i];
+    }
+    for (size_t i = 0; i < SUB_RX_TAPS; i++) {
+        taps[i] /= sum;
+    }
+    setup_nco();
+}
+
+size_t SubRx::max_output(size_t size) const {
+    // Less than an input sample is pending between the blocks
+    return (size / SUB_RX_DECIM + 1) * out_rate / (size_t)channel_rate + 1;
+}
+
+size_t SubRx::execute(const cfloat *in, size_t size, int16_t *out) {
+    size_t n = size / SUB_RX_DECIM;
+
+    mixed.resize(size + n);
+    mix_block(in, mixed.data(), size, &nco_phase, nco_step);
+
+    cfloat *dec = &mixed[size];
+
+    decim.execute(mixed.data(), n, dec);
+
+    for (size_t i = 0; i < n; i++) {
+        hist[hist_pos] = dec[i];
+        hist[hist_pos + SUB_RX_TAPS] = dec[i];
+        hist_pos = (hist_pos + 1) % SUB_RX_TAPS;
+
+        // Oldest sample is at hist_pos, taps are symmetric
+        pending.push_back(dot(&hist[hist_pos], taps, SUB_RX_TAPS));
+    }
+
+    size_t out_size = pending.size() * out_rate / (size_t)channel_rate;
+
+    while (out_size && resamp.input_size(out_size) > pending.size()) {
+        out_size--;
+    }
+    if (!out_size) {
+        return 0;
+    }
+
+    size_t used = resamp.input_size(out_size);
+
+    audio.resize(out_size);
+    resamp.execute(pending.data(), out_size, audio.data());
+    pending.erase(pending.begin(), pending.begin() + used);
+
+    float release = expf(-1.0f / (AGC_RELEASE_S * out_rate));
+
+    for (size_t i = 0; i < out_size; i++) {
+        float x = (audio[i] * bfo_phase).real();
+        float a = fabsf(x);
+
+        bfo_phase *= bfo_step;
+
+        // Instant attack, slow release
+        env = std::max(a, env * release);
+
+        float gain = std::min(AGC_TARGET / std::max(env, 1e-12f), AGC_MAX_GAIN);
+
+        out[i] = std::clamp(x * gain * 32767.0f, -32767.0f, 32767.0f);
+    }
+    bfo_phase /= std::abs(bfo_phase);
+
+    return out_size;
+}
@@ -0,0 +1,79 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "../helpers.h"
+#include "decim.h"
+#include "poly_resamp.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define SUB_RX_DECIM        8       // Halfbands, 100 kHz -> 12.5 kHz
+#define SUB_RX_TAPS         128     // Channel filter at the decimated rate
+
+/*
+ * SSB/CW receiver of a part of the IQ flow. NCO moves the middle of the
+ * passband to DC, halfbands decimate, a complex lowpass of half the passband
+ * width selects the sideband. Polyphase resampler brings it to the audio rate,
+ * where BFO moves the band back to its audio freqs and the real part is taken.
+ * NCO and FIR run on NEON
+ */
+class SubRx {
+    float               rate;
+    float               channel_rate;
+    uint32_t            out_rate;
+    float               offset = 0.0f;
+    float               from = 300.0f;
+    float               to = 2700.0f;
+    bool                lsb = false;
+
+    cfloat              nco_phase = 1.0f;
+    cfloat              nco_step = 1.0f;
+    cfloat              bfo_phase = 1.0f;
+    cfloat              bfo_step = 1.0f;
+
+    DecimChain          decim;
+    float               taps[SUB_RX_TAPS];
+    cfloat              hist[SUB_RX_TAPS * 2];  // Written twice, for a linear view of the last taps
+    size_t              hist_pos = 0;
+    PolyResampler       resamp;
+
+    std::vector<cfloat> mixed;
+    std::vector<cfloat> pending;                // Channel samples, which don't make a whole output yet
+    std::vector<cfloat> audio;
+
+    float               env = 0.0f;
+
+    void setup_nco();
+
+  public:
+    SubRx(uint32_t rate, uint32_t out_rate);
+
+    void reset();
+
+    /**
+     * Dial, Hz from the flow center. Phase is kept
+     */
+    void set_offset(float hz);
+
+    /**
+     * Audio passband, mirrored for LSB and CWR
+     */
+    void set_band(float from, float to, bool lsb);
+
+    /**
+     * Audio samples of the block, up to max_output(size)
+     */
+    size_t execute(const cfloat *in, size_t size, int16_t *out);
+
+    size_t max_output(size_t size) const;
+};
@@ -0,0 +1,42 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "tone_band.h"
+
+tone_band_t tone_band(const float *psd, size_t n, size_t width) {
+    tone_band_t res = {0, 0.0f};
+    float       sum_all = 0.0f;
+    float       sum_signal = 0.0f;
+    float       peak_val = -1.0f;
+    size_t      start;
+
+    for (size_t i = 0; i < n; i++) {
+        if (psd[i] > peak_val) {
+            peak_val = psd[i];
+            res.peak_pos = i;
+        }
+        sum_all += psd[i];
+    }
+
+    if (width > n) {
+        width = n;
+    }
+    if (res.peak_pos < width / 2) {
+        start = 0;
+    } else if (res.peak_pos - width / 2 + width > n) {
+        start = n - width;
+    } else {
+        start = res.peak_pos - width / 2;
+    }
+    for (size_t i = start; i < start + width; i++) {
+        sum_signal += psd[i];
+    }
+    res.ratio = sum_signal / (sum_all - sum_signal);
+
+    return res;
+}
@@ -0,0 +1,22 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Tone against noise in a PSD frame: power of `width` bins around the peak against
+ * power of the rest. One pass over bins and one over the band, no sorting
+ */
+typedef struct {
+    size_t  peak_pos;
+    float   ratio;      // Band power / rest power
+} tone_band_t;
+
+tone_band_t tone_band(const float *psd, size_t n, size_t width);
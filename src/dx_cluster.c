@@ -0,0 +1,276 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#define _GNU_SOURCE
+
+#include "dx_cluster.h"
+
+#include "dx_spots.h"
+#include "cfg/cfg.h"
+#include "params/params.h"
+#include "scheduler.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define CONNECT_MS      10000
+#define LINE_SIZE       256
+
+static int                  wake_event = -1;
+static atomic_bool          enabled = false;
+static dx_cluster_update_t  update_cb = NULL;       /* UI thread */
+
+static void wake() {
+    uint64_t val = 1;
+
+    if (wake_event >= 0 && write(wake_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("DX cluster wake event");
+    }
+}
+
+/**
+ * Sleep until woken by a setting change or the timeout. Returns true if woken
+ */
+static bool wait_wake(int timeout_ms) {
+    struct pollfd fds = { .fd = wake_event, .events = POLLIN };
+
+    if (poll(&fds, 1, timeout_ms) > 0) {
+        uint64_t val;
+
+        if (read(wake_event, &val, sizeof(val)) < 0) {
+            LV_LOG_WARN("DX cluster wake event");
+        }
+        return true;
+    }
+    return false;
+}
+
+static void update_ui_cb(void *arg) {
+    if (update_cb) {
+        update_cb();
+    }
+}
+
+static int connect_host() {
+    const char  *env = getenv("X6100_DX_CLUSTER");
+    char        host[128];
+    char        *port;
+
+    strncpy(host, env ? env : DX_CLUSTER_HOST, sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    port = strrchr(host, ':');
+
+    if (!port) {
+        LV_LOG_ERROR("DX cluster %s: no port", host);
+        return -1;
+    }
+    *port++ = '\0';
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int             err = getaddrinfo(host, port, &hints, &res);
+
+    if (err) {
+        LV_LOG_WARN("DX cluster %s: %s", host, gai_strerror(err));
+        return -1;
+    }
+
+    int sock = -1;
+
+    for (struct addrinfo *ai = res; ai && sock < 0; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+
+        if (sock < 0) {
+            continue;
+        }
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        if (errno == EINPROGRESS) {
+            struct pollfd   fds = { .fd = sock, .events = POLLOUT };
+            socklen_t       len = sizeof(err);
+
+            if (poll(&fds, 1, CONNECT_MS) == 1 && getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && !err) {
+                break;
+            }
+        }
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+
+    if (sock < 0) {
+        LV_LOG_WARN("DX cluster %s:%s: can't connect", host, port);
+    } else {
+        LV_LOG_USER("DX cluster %s:%s connected", host, port);
+    }
+    return sock;
+}
+
+static bool is_login_prompt(const char *text) {
+    return strcasestr(text, "login:") || strcasestr(text, "call:") || strcasestr(text, "callsign:");
+}
+
+static bool send_callsign(int sock) {
+    char    buf[32];
+    int     len = snprintf(buf, sizeof(buf), "%s\r\n", params.callsign.x);
+
+    return send(sock, buf, len, MSG_NOSIGNAL) == len;
+}
+
+/**
+ * Read lines until the server closes the connection or the client is disabled
+ */
+static void session(int sock) {
+    char        line[LINE_SIZE];
+    size_t      line_len = 0;
+    bool        logged_in = false;
+    char        buf[1024];
+
+    while (atomic_load(&enabled)) {
+        struct pollfd fds[2] = {
+            { .fd = wake_event, .events = POLLIN },
+            { .fd = sock, .events = POLLIN }
+        };
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno != EINTR) {
+                return;
+            }
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            wait_wake(0);
+            continue;
+        }
+
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+
+        if (n <= 0) {
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                continue;
+            }
+            LV_LOG_WARN("DX cluster disconnected");
+            return;
+        }
+
+        uint16_t    added = 0;
+        uint64_t    now = get_time();
+
+        for (ssize_t i = 0; i < n; i++) {
+            char c = buf[i];
+
+            if (c == '\n') {
+                dx_spot_t spot;
+
+                line[line_len] = '\0';
+
+                if (dx_spot_parse(line, &spot)) {
+                    dx_spots_add(&spot, now);
+                    added++;
+                }
+                line_len = 0;
+            } else if ((unsigned char) c >= ' ' && (unsigned char) c < 0x7F && line_len < LINE_SIZE - 1) {
+                /* Telnet negotiation and other control bytes are skipped */
+                line[line_len++] = c;
+            }
+        }
+
+        /* The prompt has no line end */
+        if (!logged_in && line_len) {
+            line[line_len] = '\0';
+
+            if (is_login_prompt(line)) {
+                if (!send_callsign(sock)) {
+                    return;
+                }
+                logged_in = true;
+                line_len = 0;
+            }
+        }
+
+        if (added) {
+            scheduler_put_coalesced(SCHEDULER_KEY_DX_SPOTS, update_ui_cb, NULL, 0);
+        }
+    }
+}
+
+static void * dx_cluster_thread(void *arg) {
+    set_thread_name("dx_cluster");
+
+    while (true) {
+        if (!atomic_load(&enabled)) {
+            wait_wake(-1);
+            continue;
+        }
+        if (params.callsign.x[0] == '\0') {
+            LV_LOG_WARN("DX cluster needs the callsign");
+            wait_wake(DX_CLUSTER_RETRY_MS);
+            continue;
+        }
+
+        int sock = connect_host();
+
+        if (sock >= 0) {
+            session(sock);
+            close(sock);
+        }
+        if (atomic_load(&enabled)) {
+            wait_wake(DX_CLUSTER_RETRY_MS);
+        }
+    }
+    return NULL;
+}
+
+static void on_dx_cluster_change(Subject *subj, void *user_data) {
+    bool on = subject_get_int(subj);
+
+    atomic_store(&enabled, on);
+
+    if (!on) {
+        dx_spots_clear();
+
+        if (update_cb) {
+            update_cb();
+        }
+    }
+    wake();
+}
+
+void dx_cluster_init() {
+    wake_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_event < 0) {
+        LV_LOG_ERROR("DX cluster wake event");
+        return;
+    }
+
+    subject_add_observer_and_call(cfg.dx_cluster.val, on_dx_cluster_change, NULL);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, dx_cluster_thread, NULL);
+    pthread_detach(thread);
+}
+
+void dx_cluster_set_update_cb(dx_cluster_update_t cb) {
+    update_cb = cb;
+}
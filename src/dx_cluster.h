@@ -0,0 +1,36 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+/*
+ * Telnet client of a DX cluster on its own thread. Logs in with the callsign
+ * of the settings, spot lines go to dx_spots.h. However many spots arrive, the
+ * UI only gets one coalesced refresh per received chunk. The server is
+ * DX_CLUSTER_HOST or "host:port" of X6100_DX_CLUSTER, enabled by cfg.dx_cluster.
+ */
+
+#define DX_CLUSTER_HOST     "dxc.ve7cc.net:23"
+#define DX_CLUSTER_RETRY_MS (30 * 1000)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*dx_cluster_update_t)();
+
+void dx_cluster_init();
+
+/**
+ * Called on the UI thread after new spots are stored
+ */
+void dx_cluster_set_update_cb(dx_cluster_update_t cb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,145 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "dx_overlay.h"
+
+#include "dx_cluster.h"
+#include "dx_spots.h"
+#include "cfg/cfg.h"
+#include "params/params.h"
+#include "styles.h"
+#include "util.h"
+
+#define LANES       3
+#define LANE_HEIGHT 20
+#define LABEL_GAP   6
+#define MAX_VISIBLE 128
+
+static lv_obj_t     *obj;
+static int32_t      width_hz = 100000;
+static int32_t      freq;
+static uint8_t      zoom = 1;
+static dx_spot_t    visible[MAX_VISIBLE];
+
+static void on_zoom_changed(Subject *subj, void *user_data);
+static void on_freq_changed(Subject *subj, void *user_data);
+
+static void draw_cb(lv_event_t *e) {
+    lv_obj_t        *obj = lv_event_get_target(e);
+    lv_draw_ctx_t   *draw_ctx = lv_event_get_draw_ctx(e);
+
+    if (!subject_get_int(cfg.dx_cluster.val)) {
+        return;
+    }
+
+    uint8_t current_zoom = 1;
+
+    if (params.waterfall_zoom.x) {
+        current_zoom = zoom;
+    }
+
+    lv_coord_t  x1 = obj->coords.x1;
+    lv_coord_t  y1 = obj->coords.y1;
+    lv_coord_t  w = lv_obj_get_width(obj);
+    int32_t     half = width_hz / 2 / current_zoom;
+    uint16_t    count = dx_spots_range(freq - half, freq + half, visible, MAX_VISIBLE, get_time());
+
+    if (count == 0) {
+        return;
+    }
+
+    lv_draw_label_dsc_t label_dsc;
+    lv_draw_line_dsc_t  line_dsc;
+    lv_coord_t          lane_end[LANES];
+
+    lv_draw_label_dsc_init(&label_dsc);
+    lv_draw_line_dsc_init(&line_dsc);
+
+    label_dsc.color = lv_color_white();
+    label_dsc.font = &sony_18;
+
+    line_dsc.color = lv_color_white();
+    line_dsc.opa = LV_OPA_70;
+    line_dsc.width = 1;
+
+    for (uint8_t i = 0; i < LANES; i++) {
+        lane_end[i] = LV_COORD_MIN;
+    }
+
+    /* Spots are sorted by freq, so the lanes are packed left to right */
+    for (uint16_t i = 0; i < count; i++) {
+        dx_spot_t   *spot = &visible[i];
+        int32_t     x = (int64_t) (spot->freq - freq) * w / width_hz * current_zoom + w / 2;
+        lv_point_t  label_size;
+        int8_t      lane = -1;
+
+        lv_txt_get_size(&label_size, spot->call, label_dsc.font, 0, 0, LV_COORD_MAX, 0);
+
+        lv_coord_t left = x - label_size.x / 2;
+
+        for (uint8_t n = 0; n < LANES; n++) {
+            if (left >= lane_end[n]) {
+                lane = n;
+                break;
+            }
+        }
+
+        /* Crowded, the tick alone still marks the spot */
+        lv_point_t a = { x1 + x, y1 + LANES * LANE_HEIGHT };
+        lv_point_t b = { x1 + x, y1 + LANES * LANE_HEIGHT + 6 };
+
+        if (lane >= 0) {
+            lv_area_t area;
+
+            area.x1 = x1 + left;
+            area.y1 = y1 + lane * LANE_HEIGHT;
+            area.x2 = area.x1 + label_size.x;
+            area.y2 = area.y1 + label_size.y;
+
+            lv_draw_label(draw_ctx, &label_dsc, &area, spot->call, NULL);
+            lane_end[lane] = left + label_size.x + LABEL_GAP;
+            a.y = area.y1 + LANE_HEIGHT;
+        }
+        lv_draw_line(draw_ctx, &line_dsc, &a, &b);
+    }
+}
+
+static void update_cb() {
+    lv_obj_invalidate(obj);
+}
+
+lv_obj_t * dx_overlay_init(lv_obj_t *parent) {
+    obj = lv_obj_create(parent);
+
+    lv_obj_set_size(obj, lv_obj_get_width(parent), LANES * LANE_HEIGHT + 6);
+    lv_obj_align(obj, LV_ALIGN_TOP_MID, 0, 32);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);
+
+    lv_obj_set_style_radius(obj, 0, 0);
+    lv_obj_set_style_border_width(obj, 0, 0);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_0, 0);
+
+    lv_obj_add_event_cb(obj, draw_cb, LV_EVENT_DRAW_MAIN_END, NULL);
+
+    subject_add_observer_and_call(cfg_cur.zoom, on_zoom_changed, NULL);
+    subject_add_delayed_observer_and_call(cfg_cur.fg_freq, on_freq_changed, NULL);
+
+    dx_cluster_set_update_cb(update_cb);
+
+    return obj;
+}
+
+static void on_zoom_changed(Subject *subj, void *user_data) {
+    zoom = subject_get_int(subj);
+    lv_obj_invalidate(obj);
+}
+
+static void on_freq_changed(Subject *subj, void *user_data) {
+    freq = subject_get_int(subj);
+    lv_obj_invalidate(obj);
+}
@@ -0,0 +1,16 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+/*
+ * Callsigns of DX cluster spots of the visible span, under the band info
+ */
+lv_obj_t * dx_overlay_init(lv_obj_t *parent);
@@ -0,0 +1,178 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "dx_spots.h"
+
+#include "ft8/call_intern.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static dx_spot_t        spots[DX_SPOTS_MAX];
+static uint16_t         count = 0;
+static pthread_mutex_t  mux = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * First spot with freq not below the given one
+ */
+static uint16_t lower_bound(int32_t freq) {
+    uint16_t lo = 0;
+    uint16_t hi = count;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+
+        if (spots[mid].freq < freq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void remove_at(uint16_t i) {
+    memmove(&spots[i], &spots[i + 1], (count - i - 1) * sizeof(dx_spot_t));
+    count--;
+}
+
+static void expire(uint64_t now) {
+    uint16_t n = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (now - spots[i].time < DX_SPOT_TTL_MS) {
+            spots[n++] = spots[i];
+        }
+    }
+    count = n;
+}
+
+bool dx_spots_add(const dx_spot_t *spot, uint64_t now) {
+    bool        dup = false;
+    call_id_t   call_id = call_intern(spot->call);
+
+    pthread_mutex_lock(&mux);
+    expire(now);
+
+    for (uint16_t i = lower_bound(spot->freq - DX_SPOT_SAME_HZ);
+         i < count && spots[i].freq <= spot->freq + DX_SPOT_SAME_HZ; i++)
+    {
+        bool same = call_id != CALL_ID_NONE ? spots[i].call_id == call_id : strcmp(spots[i].call, spot->call) == 0;
+
+        if (same) {
+            remove_at(i);
+            dup = true;
+            break;
+        }
+    }
+
+    if (count == DX_SPOTS_MAX) {
+        uint16_t oldest = 0;
+
+        for (uint16_t i = 1; i < count; i++) {
+            if (spots[i].time < spots[oldest].time) {
+                oldest = i;
+            }
+        }
+        remove_at(oldest);
+    }
+
+    uint16_t pos = lower_bound(spot->freq);
+
+    memmove(&spots[pos + 1], &spots[pos], (count - pos) * sizeof(dx_spot_t));
+    spots[pos] = *spot;
+    spots[pos].time = now;
+    spots[pos].call_id = call_id;
+    count++;
+
+    pthread_mutex_unlock(&mux);
+    return !dup;
+}
+
+uint16_t dx_spots_range(int32_t from, int32_t to, dx_spot_t *dst, uint16_t max, uint64_t now) {
+    uint16_t n = 0;
+
+    pthread_mutex_lock(&mux);
+
+    for (uint16_t i = lower_bound(from); i < count && spots[i].freq <= to && n < max; i++) {
+        if (now - spots[i].time < DX_SPOT_TTL_MS) {
+            dst[n++] = spots[i];
+        }
+    }
+
+    pthread_mutex_unlock(&mux);
+    return n;
+}
+
+uint16_t dx_spots_count() {
+    return count;
+}
+
+void dx_spots_clear() {
+    pthread_mutex_lock(&mux);
+    count = 0;
+    pthread_mutex_unlock(&mux);
+}
+
+bool dx_spot_parse(const char *line, dx_spot_t *spot) {
+    if (strncmp(line, "DX de ", 6) != 0) {
+        return false;
+    }
+
+    const char *p = line + 6;
+    const char *colon = strchr(p, ':');
+
+    if (!colon || colon == p || (size_t) (colon - p) >= sizeof(spot->spotter)) {
+        return false;
+    }
+
+    memset(spot, 0, sizeof(*spot));
+    memcpy(spot->spotter, p, colon - p);
+
+    char    *end;
+    double  khz = strtod(colon + 1, &end);
+    int     n;
+
+    if (end == colon + 1 || khz <= 0.0) {
+        return false;
+    }
+    spot->freq = lround(khz * 1000.0);
+
+    if (sscanf(end, " %15s%n", spot->call, &n) != 1) {
+        return false;
+    }
+
+    /* Comment, without the "1234Z" time at the end */
+    p = end + n;
+
+    while (isspace((unsigned char) *p)) {
+        p++;
+    }
+
+    size_t len = strlen(p);
+
+    while (len && isspace((unsigned char) p[len - 1])) {
+        len--;
+    }
+    if (len >= 5 && p[len - 1] == 'Z' && isdigit((unsigned char) p[len - 2]) && isdigit((unsigned char) p[len - 5])) {
+        len -= 5;
+    }
+    while (len && isspace((unsigned char) p[len - 1])) {
+        len--;
+    }
+    if (len >= sizeof(spot->info)) {
+        len = sizeof(spot->info) - 1;
+    }
+    memcpy(spot->info, p, len);
+
+    return true;
+}
@@ -0,0 +1,58 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * DX spots sorted by freq, for range queries of the visible span on every
+ * frame. A callsign spotted again within DX_SPOT_SAME_HZ replaces its spot,
+ * spots older than DX_SPOT_TTL_MS are dropped, the oldest one makes room when
+ * the store is full. Any thread, the lock is held only for the copy.
+ */
+
+#define DX_SPOTS_MAX        512
+#define DX_SPOT_TTL_MS      (15 * 60 * 1000)
+#define DX_SPOT_SAME_HZ     1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int32_t     freq;           /* Hz */
+    char        call[16];
+    uint32_t    call_id;        /* Interned call, set by dx_spots_add() */
+    char        spotter[16];
+    char        info[32];
+    uint64_t    time;           /* ms, of the store clock */
+} dx_spot_t;
+
+/**
+ * Returns false if the callsign was spotted near the freq, that spot is replaced
+ */
+bool dx_spots_add(const dx_spot_t *spot, uint64_t now);
+
+/**
+ * Spots of from..to by freq, up to max. Returns their number
+ */
+uint16_t dx_spots_range(int32_t from, int32_t to, dx_spot_t *spots, uint16_t max, uint64_t now);
+
+uint16_t dx_spots_count();
+void dx_spots_clear();
+
+/**
+ * Parse a "DX de SPOTTER: 14025.0 CALL comment 1234Z" line of a cluster
+ */
+bool dx_spot_parse(const char *line, dx_spot_t *spot);
+
+#ifdef __cplusplus
+}
+#endif
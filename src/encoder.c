@@ -8,46 +8,40 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <linux/input.h>
 
 #include "encoder.h"
 #include "keyboard.h"
-#include "backlight.h"
+#include "input.h"
 
-static void encoder_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
-    struct input_event  in;
-    encoder_t           *encoder = (encoder_t*) drv->user_data;
-    int32_t             diff = 0;
-    bool                send = false;
+/**
+ * Summed delta from the input thread, on the UI thread
+ */
+static void encoder_handle(const input_rec_t *in, void *arg) {
+    encoder_t *encoder = (encoder_t*) arg;
 
-    while (read(encoder->fd, &in, sizeof(struct input_event)) > 0) {
-        if (in.type == EV_REL) {
-            diff += in.value;
-            send = true;
-        }
+    if (in->type == EV_REL) {
+        encoder->diff += in->value;
     }
+}
 
-    if (send) {
-        backlight_tick();
-    }
+static void encoder_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+    encoder_t *encoder = (encoder_t*) drv->user_data;
 
-    data->enc_diff = -diff;
+    data->enc_diff = -encoder->diff;
     data->state = encoder->pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    encoder->diff = 0;
 }
 
 encoder_t * encoder_init(char *dev_name) {
-    int fd = open(dev_name, O_RDWR | O_NOCTTY | O_NDELAY);
+    int fd = input_open(dev_name);
 
     if (fd == -1) {
-        perror("unable to open encoder interface:");
-
         return NULL;
     }
 
-    fcntl(fd, F_SETFL, O_ASYNC | O_NONBLOCK);
-
     encoder_t *encoder = malloc(sizeof(encoder_t));
 
     memset(encoder, 0, sizeof(encoder_t));
@@ -62,6 +56,7 @@ encoder_t * encoder_init(char *dev_name) {
     encoder->indev = lv_indev_drv_register(&encoder->indev_drv);
 
     lv_indev_set_group(encoder->indev, keyboard_group);
+    input_add(fd, encoder->indev, encoder_handle, encoder);
 
     return encoder;
 }
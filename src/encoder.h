@@ -15,6 +15,7 @@
 typedef struct {
     int             fd;
     bool            pressed;
+    int32_t         diff;           /* Delta not yet read by the indev */
     
     lv_indev_drv_t  indev_drv;
     lv_indev_t      *indev;
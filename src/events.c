@@ -7,12 +7,11 @@
  */
 
 #include <stdlib.h>
-#include <pthread.h>
+#include <string.h>
 #include "events.h"
 #include "backlight.h"
 #include "keyboard.h"
-
-#define QUEUE_SIZE  64
+#include "scheduler.h"
 
 uint32_t        EVENT_ROTARY;
 uint32_t        EVENT_KEYPAD;
@@ -25,17 +24,15 @@ uint32_t        EVENT_GPS;
 uint32_t        EVENT_BAND_UP;
 uint32_t        EVENT_BAND_DOWN;
 
+/* Events are scheduler tasks, small payloads stay inline in the ring slot */
 typedef struct {
     lv_obj_t        *obj;
     lv_event_code_t event_code;
-    void            *param;
+    void            *param;         /* Owned param, freed after dispatch */
+    size_t          size;           /* Size of the copied payload */
+    uint8_t         data[];
 } item_t;
 
-static item_t           *queue[QUEUE_SIZE];
-static uint8_t          queue_write = 0;
-static uint8_t          queue_read = 0;
-static pthread_mutex_t  queue_mux;
-
 void event_init() {
     EVENT_ROTARY = lv_event_register_id();
     EVENT_KEYPAD = lv_event_register_id();
@@ -47,64 +44,55 @@ void event_init() {
     EVENT_GPS = lv_event_register_id();
     EVENT_BAND_UP = lv_event_register_id();
     EVENT_BAND_DOWN = lv_event_register_id();
-
-    for (uint8_t i = 0; i < QUEUE_SIZE; i++)
-        queue[i] = NULL;
-
-    pthread_mutex_init(&queue_mux, NULL);
 }
 
-void event_obj_check() {
-    while (queue_read != queue_write) {
-        pthread_mutex_lock(&queue_mux);
-        queue_read = (queue_read + 1) % QUEUE_SIZE;
+static void event_dispatch(void *arg) {
+    item_t *item = (item_t *) arg;
 
-        item_t *item = queue[queue_read];
-        queue[queue_read] = NULL;
-        pthread_mutex_unlock(&queue_mux);
-
-        if (item) {
-            if (item->event_code == LV_EVENT_REFRESH) {
-                lv_obj_invalidate(item->obj);
-            } else {
-                lv_event_send(item->obj, item->event_code, item->param);
-            }
+    if (item->event_code == LV_EVENT_REFRESH) {
+        lv_obj_invalidate(item->obj);
+    } else {
+        lv_event_send(item->obj, item->event_code, item->size ? item->data : item->param);
+    }
 
-            if (item->param != NULL) {
-                free(item->param);
-            }
+    if (item->param != NULL) {
+        free(item->param);
+    }
+}
 
-            free(item);
-        }
+static scheduler_prio_t event_prio(lv_event_code_t event_code) {
+    if (event_code == LV_EVENT_KEY || event_code == EVENT_ROTARY || event_code == EVENT_KEYPAD || event_code == EVENT_HKEY) {
+        return SCHEDULER_PRIO_INPUT;
     }
+    return SCHEDULER_PRIO_RADIO;
 }
 
 void event_send(lv_obj_t *obj, lv_event_code_t event_code, void *param) {
-    pthread_mutex_lock(&queue_mux);
-
-    uint8_t next = (queue_write + 1) % QUEUE_SIZE;
-
-    if (queue[next]) {
-        pthread_mutex_unlock(&queue_mux);
-        LV_LOG_ERROR("Overflow");
-        return;
+    item_t item = {
+        .obj = obj,
+        .event_code = event_code,
+        .param = param,
+        .size = 0
+    };
+
+    if (!scheduler_put_prio(event_prio(event_code), event_dispatch, &item, sizeof(item)) && param) {
+        free(param);
     }
+}
 
-    item_t *item = malloc(sizeof(item_t));
+void event_send_copy(lv_obj_t *obj, lv_event_code_t event_code, const void *param, size_t size) {
+    uint8_t buf[sizeof(item_t) + size] __attribute__((aligned(8)));
+    item_t  *item = (item_t *) buf;
 
     item->obj = obj;
     item->event_code = event_code;
-    item->param = param;
-
-    queue[next] = item;
-    queue_write = next;
+    item->param = NULL;
+    item->size = size;
+    memcpy(item->data, param, size);
 
-    pthread_mutex_unlock(&queue_mux);
+    scheduler_put_prio(event_prio(event_code), event_dispatch, buf, sizeof(buf));
 }
 
 void event_send_key(int32_t key) {
-    int32_t *c = malloc(sizeof(int32_t));
-    *c = key;
-
-    event_send(lv_group_get_focused(keyboard_group), LV_EVENT_KEY, c);
+    event_send_copy(lv_group_get_focused(keyboard_group), LV_EVENT_KEY, &key, sizeof(key));
 }
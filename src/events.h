@@ -58,6 +58,12 @@ typedef struct {
     keypad_state_t  state;
 } event_keypad_t;
 
+/* EVENT_ROTARY param, detents are coalesced per UI frame */
+typedef struct {
+    int32_t         diff;
+    uint32_t        speed;          /* Detents per second, from event timestamps */
+} event_rotary_t;
+
 typedef enum {
 
     HKEY_CE = LV_KEY_BACKSPACE,
@@ -133,6 +139,13 @@ extern uint32_t EVENT_BAND_DOWN;
 
 void event_init();
 
-void event_obj_check();
+/**
+ * Send event from any thread, param is malloc'ed and freed after dispatch
+ */
 void event_send(lv_obj_t *obj, lv_event_code_t event_code, void *param);
+
+/**
+ * Send event from any thread with a copy of param
+ */
+void event_send_copy(lv_obj_t *obj, lv_event_code_t event_code, const void *param, size_t size);
 void event_send_key(int32_t key);
@@ -0,0 +1,483 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "font_pack.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_SLOTS     128
+#define CACHE_HASH      256         /* Power of 2 */
+#define NONE            0xFFFF
+
+typedef struct {
+    uint8_t     font;               /* Index in font_pack_fonts */
+    uint32_t    unicode;
+    uint32_t    used;               /* LRU stamp, 0 - free slot */
+    uint16_t    next;               /* Hash chain */
+    uint8_t     *buf;
+} slot_t;
+
+LV_FONT_DECLARE(sony_8)
+LV_FONT_DECLARE(sony_10)
+LV_FONT_DECLARE(sony_12)
+LV_FONT_DECLARE(sony_14)
+LV_FONT_DECLARE(sony_16)
+LV_FONT_DECLARE(sony_18)
+LV_FONT_DECLARE(sony_20)
+LV_FONT_DECLARE(sony_22)
+LV_FONT_DECLARE(sony_24)
+LV_FONT_DECLARE(sony_26)
+LV_FONT_DECLARE(sony_28)
+LV_FONT_DECLARE(sony_30)
+LV_FONT_DECLARE(sony_32)
+LV_FONT_DECLARE(sony_34)
+LV_FONT_DECLARE(sony_36)
+LV_FONT_DECLARE(sony_38)
+LV_FONT_DECLARE(sony_40)
+LV_FONT_DECLARE(sony_42)
+LV_FONT_DECLARE(sony_44)
+LV_FONT_DECLARE(sony_60)
+
+const font_pack_entry_t font_pack_fonts[FONT_PACK_FONTS] = {
+    { &sony_8,  "sony_8" },
+    { &sony_10, "sony_10" },
+    { &sony_12, "sony_12" },
+    { &sony_14, "sony_14" },
+    { &sony_16, "sony_16" },
+    { &sony_18, "sony_18" },
+    { &sony_20, "sony_20" },
+    { &sony_22, "sony_22" },
+    { &sony_24, "sony_24" },
+    { &sony_26, "sony_26" },
+    { &sony_28, "sony_28" },
+    { &sony_30, "sony_30" },
+    { &sony_32, "sony_32" },
+    { &sony_34, "sony_34" },
+    { &sony_36, "sony_36" },
+    { &sony_38, "sony_38" },
+    { &sony_40, "sony_40" },
+    { &sony_42, "sony_42" },
+    { &sony_44, "sony_44" },
+    { &sony_60, "sony_60" },
+};
+
+static const uint8_t            *pack = NULL;
+static size_t                   pack_size = 0;
+static const font_pack_font_t   *pack_fonts[FONT_PACK_FONTS];
+static uint32_t                 max_size = 0;
+
+static slot_t                   slots[CACHE_SLOTS];
+static uint16_t                 hash[CACHE_HASH];
+static uint32_t                 stamp = 0;
+
+/*
+ * Nibble RLE, fits 4 bpp antialiased glyphs: 1..14 - pixel, 0 or 15 followed by n -
+ * run of n + 1 such pixels. Nibbles are stored high first
+ */
+
+static inline void put_nibble(uint8_t *dst, size_t n, uint8_t x) {
+    if (n & 1) {
+        dst[n / 2] |= x;
+    } else {
+        dst[n / 2] = x << 4;
+    }
+}
+
+static inline uint8_t get_nibble(const uint8_t *src, size_t n) {
+    return (n & 1) ? (src[n / 2] & 0x0F) : (src[n / 2] >> 4);
+}
+
+size_t font_pack_rle_encode(const uint8_t *src, size_t size, uint8_t *dst) {
+    size_t  count = size * 2;
+    size_t  i = 0;
+    size_t  out = 0;
+
+    while (i < count) {
+        uint8_t x = get_nibble(src, i);
+
+        if (x == 0 || x == 15) {
+            size_t run = 1;
+
+            while (i + run < count && run < 16 && get_nibble(src, i + run) == x) {
+                run++;
+            }
+            put_nibble(dst, out++, x);
+            put_nibble(dst, out++, run - 1);
+            i += run;
+        } else {
+            put_nibble(dst, out++, x);
+            i++;
+        }
+    }
+
+    return (out + 1) / 2;
+}
+
+size_t font_pack_rle_decode(const uint8_t *src, size_t size, uint8_t *dst, size_t dst_size) {
+    size_t  count = size * 2;
+    size_t  limit = dst_size * 2;
+    size_t  i = 0;
+    size_t  out = 0;
+
+    while (i < count) {
+        uint8_t x = get_nibble(src, i++);
+        size_t  run = 1;
+
+        if (x == 0 || x == 15) {
+            // Pad nibble of the odd length
+            if (i == count) {
+                break;
+            }
+            run += get_nibble(src, i++);
+        }
+
+        if (out + run > limit) {
+            return 0;
+        }
+
+        while (run--) {
+            put_nibble(dst, out++, x);
+        }
+    }
+
+    return out / 2;
+}
+
+bool font_pack_init(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        LV_LOG_ERROR("Font pack %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size < sizeof(font_pack_header_t)) {
+        LV_LOG_ERROR("Font pack %s is broken", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        LV_LOG_ERROR("Font pack mmap: %s", strerror(errno));
+        return false;
+    }
+
+    const font_pack_header_t    *header = map;
+    const font_pack_font_t      *fonts = (const font_pack_font_t *) (header + 1);
+
+    if (header->magic != FONT_PACK_MAGIC || header->version != FONT_PACK_VERSION ||
+        sizeof(*header) + header->fonts * sizeof(font_pack_font_t) > st.st_size)
+    {
+        LV_LOG_ERROR("Font pack %s has wrong format", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    memset(pack_fonts, 0, sizeof(pack_fonts));
+
+    for (uint16_t i = 0; i < header->fonts; i++) {
+        const font_pack_font_t *font = &fonts[i];
+
+        if ((uint64_t) font->glyphs_offset + font->glyphs_count * sizeof(font_pack_glyph_t) > st.st_size) {
+            continue;
+        }
+
+        for (uint8_t n = 0; n < FONT_PACK_FONTS; n++) {
+            if (strncmp(font->name, font_pack_fonts[n].name, FONT_PACK_NAME) == 0) {
+                pack_fonts[n] = font;
+                break;
+            }
+        }
+    }
+
+    /* One allocation for all slots */
+    uint8_t *bufs = malloc((size_t) CACHE_SLOTS * header->max_size);
+
+    if (!bufs) {
+        LV_LOG_ERROR("Can't allocate glyph cache");
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    for (uint16_t i = 0; i < CACHE_SLOTS; i++) {
+        slots[i].used = 0;
+        slots[i].buf = bufs + (size_t) i * header->max_size;
+    }
+    memset(hash, 0xFF, sizeof(hash));
+
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    pack = map;
+    pack_size = st.st_size;
+    max_size = header->max_size;
+
+    return true;
+}
+
+static inline uint16_t hash_key(uint8_t font, uint32_t unicode) {
+    return ((unicode * 2654435761u) ^ font) & (CACHE_HASH - 1);
+}
+
+static const font_pack_glyph_t * glyph_find(const font_pack_font_t *font, uint32_t unicode) {
+    const font_pack_glyph_t *glyphs = (const font_pack_glyph_t *) (pack + font->glyphs_offset);
+    uint32_t                lo = 0;
+    uint32_t                hi = font->glyphs_count;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (glyphs[mid].unicode < unicode) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return (lo < font->glyphs_count && glyphs[lo].unicode == unicode) ? &glyphs[lo] : NULL;
+}
+
+static void slot_unlink(uint16_t n) {
+    uint16_t *p = &hash[hash_key(slots[n].font, slots[n].unicode)];
+
+    while (*p != NONE) {
+        if (*p == n) {
+            *p = slots[n].next;
+            return;
+        }
+        p = &slots[*p].next;
+    }
+}
+
+const uint8_t * font_pack_get_bitmap(const lv_font_t *font, uint32_t unicode) {
+    uint8_t index;
+
+    if (!pack) {
+        return NULL;
+    }
+
+    for (index = 0; index < FONT_PACK_FONTS; index++) {
+        if (font_pack_fonts[index].font == font) {
+            break;
+        }
+    }
+
+    if (index == FONT_PACK_FONTS || !pack_fonts[index]) {
+        return NULL;
+    }
+
+    /* Cache */
+
+    uint16_t key = hash_key(index, unicode);
+
+    for (uint16_t n = hash[key]; n != NONE; n = slots[n].next) {
+        if (slots[n].font == index && slots[n].unicode == unicode) {
+            slots[n].used = ++stamp;
+            return slots[n].buf;
+        }
+    }
+
+    const font_pack_glyph_t *glyph = glyph_find(pack_fonts[index], unicode);
+
+    if (!glyph || glyph->size > max_size || (uint64_t) glyph->offset + glyph->packed_size > pack_size) {
+        return NULL;
+    }
+
+    /* Free or least recently used slot */
+
+    uint16_t victim = 0;
+
+    for (uint16_t n = 0; n < CACHE_SLOTS; n++) {
+        if (slots[n].used < slots[victim].used) {
+            victim = n;
+        }
+        if (slots[n].used == 0) {
+            break;
+        }
+    }
+
+    slot_t *slot = &slots[victim];
+
+    if (slot->used) {
+        slot_unlink(victim);
+    }
+
+    if (font_pack_rle_decode(pack + glyph->offset, glyph->packed_size, slot->buf, max_size) != glyph->size) {
+        LV_LOG_ERROR("Broken glyph %u of %s", unicode, font_pack_fonts[index].name);
+        slot->used = 0;
+        return NULL;
+    }
+
+    slot->font = index;
+    slot->unicode = unicode;
+    slot->used = ++stamp;
+    slot->next = hash[key];
+    hash[key] = victim;
+
+    return slot->buf;
+}
+
+#if !FONT_PACK
+
+typedef struct {
+    uint8_t             *buf;
+    size_t              size;
+    size_t              cap;
+} out_t;
+
+static bool out_put(out_t *out, const void *data, size_t size) {
+    if (out->size + size > out->cap) {
+        size_t  cap = (out->cap + size) * 2;
+        uint8_t *buf = realloc(out->buf, cap);
+
+        if (!buf) {
+            return false;
+        }
+        out->buf = buf;
+        out->cap = cap;
+    }
+    memcpy(out->buf + out->size, data, size);
+    out->size += size;
+
+    return true;
+}
+
+static int glyph_cmp(const void *a, const void *b) {
+    uint32_t x = ((const font_pack_glyph_t *) a)->unicode;
+    uint32_t y = ((const font_pack_glyph_t *) b)->unicode;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Glyph id of the n-th code point of the cmap
+ */
+static uint32_t cmap_glyph(const lv_font_fmt_txt_cmap_t *cmap, uint32_t n, uint32_t *unicode) {
+    switch (cmap->type) {
+        case LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY:
+            *unicode = cmap->range_start + n;
+            return cmap->glyph_id_start + n;
+
+        case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+            *unicode = cmap->range_start + n;
+            return cmap->glyph_id_start + ((const uint8_t *) cmap->glyph_id_ofs_list)[n];
+
+        case LV_FONT_FMT_TXT_CMAP_SPARSE_TINY:
+            *unicode = cmap->range_start + cmap->unicode_list[n];
+            return cmap->glyph_id_start + n;
+
+        case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL:
+            *unicode = cmap->range_start + cmap->unicode_list[n];
+            return cmap->glyph_id_start + ((const uint16_t *) cmap->glyph_id_ofs_list)[n];
+    }
+    return 0;
+}
+
+bool font_pack_write(const char *path) {
+    font_pack_header_t  header = { FONT_PACK_MAGIC, FONT_PACK_VERSION, FONT_PACK_FONTS, 0 };
+    font_pack_font_t    fonts[FONT_PACK_FONTS];
+    out_t               tables = { 0 };
+    out_t               data = { 0 };
+    bool                res = false;
+
+    memset(fonts, 0, sizeof(fonts));
+
+    for (uint8_t i = 0; i < FONT_PACK_FONTS; i++) {
+        const lv_font_fmt_txt_dsc_t *dsc = font_pack_fonts[i].font->dsc;
+        size_t                      first = tables.size / sizeof(font_pack_glyph_t);
+
+        strncpy(fonts[i].name, font_pack_fonts[i].name, FONT_PACK_NAME - 1);
+
+        for (uint16_t c = 0; c < dsc->cmap_num; c++) {
+            const lv_font_fmt_txt_cmap_t *cmap = &dsc->cmaps[c];
+            uint32_t count = cmap->unicode_list ? cmap->list_length : cmap->range_length;
+
+            for (uint32_t n = 0; n < count; n++) {
+                font_pack_glyph_t           glyph;
+                uint32_t                    gid = cmap_glyph(cmap, n, &glyph.unicode);
+                const lv_font_fmt_txt_glyph_dsc_t *gdsc = &dsc->glyph_dsc[gid];
+                size_t                      size = ((size_t) gdsc->box_w * gdsc->box_h * dsc->bpp + 7) / 8;
+                uint8_t                     packed[size * 2 + 1];
+
+                // Empty glyphs are not drawn
+                if (size == 0) {
+                    continue;
+                }
+
+                glyph.offset = data.size;
+                glyph.size = size;
+                glyph.packed_size = font_pack_rle_encode(&dsc->glyph_bitmap[gdsc->bitmap_index], size, packed);
+
+                if (!out_put(&data, packed, glyph.packed_size) || !out_put(&tables, &glyph, sizeof(glyph))) {
+                    goto done;
+                }
+
+                if (size > header.max_size) {
+                    header.max_size = size;
+                }
+            }
+        }
+
+        fonts[i].glyphs_offset = first;
+        fonts[i].glyphs_count = tables.size / sizeof(font_pack_glyph_t) - first;
+
+        qsort(tables.buf + first * sizeof(font_pack_glyph_t), fonts[i].glyphs_count,
+              sizeof(font_pack_glyph_t), glyph_cmp);
+    }
+
+    /* Make offsets absolute */
+
+    size_t tables_start = sizeof(header) + sizeof(fonts);
+    size_t data_start = tables_start + tables.size;
+
+    for (uint8_t i = 0; i < FONT_PACK_FONTS; i++) {
+        fonts[i].glyphs_offset = tables_start + fonts[i].glyphs_offset * sizeof(font_pack_glyph_t);
+    }
+
+    font_pack_glyph_t *glyphs = (font_pack_glyph_t *) tables.buf;
+
+    for (size_t i = 0; i < tables.size / sizeof(font_pack_glyph_t); i++) {
+        glyphs[i].offset += data_start;
+    }
+
+    FILE *f = fopen(path, "wb");
+
+    if (!f) {
+        LV_LOG_ERROR("Can't create %s: %s", path, strerror(errno));
+        goto done;
+    }
+
+    res = fwrite(&header, sizeof(header), 1, f) == 1 &&
+          fwrite(fonts, sizeof(fonts), 1, f) == 1 &&
+          (tables.size == 0 || fwrite(tables.buf, tables.size, 1, f) == 1) &&
+          (data.size == 0 || fwrite(data.buf, data.size, 1, f) == 1);
+
+    if (fclose(f) != 0) {
+        res = false;
+    }
+
+done:
+    free(tables.buf);
+    free(data.buf);
+
+    return res;
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#ifdef LV_LVGL_H_INCLUDE_SIMPLE
+#include "lvgl.h"
+#else
+#include "lvgl/lvgl.h"
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Font pack: glyph bitmaps of the built-in fonts, RLE packed in one file. With
+ * FONT_PACK the fonts keep only metrics and cmaps, bitmaps come from the mmaped
+ * pack through a bounded LRU glyph cache. The pack is written by font_pack_tool
+ * of the host build (ENABLE_TESTING), from the same font sources
+ *
+ * Layout, little endian: header, font table, sorted glyph table of each font, data
+ */
+
+#ifndef FONT_PACK
+#define FONT_PACK 0
+#endif
+
+#if FONT_PACK
+#define FONT_BITMAP(x)      NULL
+#define FONT_GET_BITMAP     font_pack_get_bitmap
+#else
+#define FONT_BITMAP(x)      x
+#define FONT_GET_BITMAP     lv_font_get_bitmap_fmt_txt
+#endif
+
+#define FONT_PACK_PATH      "/usr/share/x6100/fonts.pack"
+#define FONT_PACK_MAGIC     0x4b504658  /* "XFPK" */
+#define FONT_PACK_VERSION   1
+#define FONT_PACK_NAME      16
+
+typedef struct {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    fonts;
+    uint32_t    max_size;       /* Largest unpacked glyph */
+} font_pack_header_t;
+
+typedef struct {
+    char        name[FONT_PACK_NAME];
+    uint32_t    glyphs_offset;
+    uint32_t    glyphs_count;
+} font_pack_font_t;
+
+typedef struct {
+    uint32_t    unicode;
+    uint32_t    offset;
+    uint16_t    size;
+    uint16_t    packed_size;
+} font_pack_glyph_t;
+
+typedef struct {
+    const lv_font_t *font;
+    const char      *name;
+} font_pack_entry_t;
+
+#define FONT_PACK_FONTS     20
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const font_pack_entry_t font_pack_fonts[FONT_PACK_FONTS];
+
+/**
+ * Map pack and allocate the glyph cache
+ */
+bool font_pack_init(const char *path);
+
+/**
+ * get_glyph_bitmap of the fonts. UI thread only, the bitmap is valid until the next call
+ */
+const uint8_t * font_pack_get_bitmap(const lv_font_t *font, uint32_t unicode);
+
+/**
+ * Nibble RLE of 4 bpp bitmaps. Encoded size is at most size * 2 + 1
+ */
+size_t font_pack_rle_encode(const uint8_t *src, size_t size, uint8_t *dst);
+size_t font_pack_rle_decode(const uint8_t *src, size_t size, uint8_t *dst, size_t dst_size);
+
+#if !FONT_PACK
+/**
+ * Write bitmaps of the built-in fonts to the pack
+ */
+bool font_pack_write(const char *path);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
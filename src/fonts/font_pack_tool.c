@@ -0,0 +1,30 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+/*
+ * Host tool: font_pack_tool <fonts.pack>. Writes glyph bitmaps of the built-in
+ * fonts for a FONT_PACK build
+ */
+
+#include "font_pack.h"
+
+#include <stdio.h>
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <fonts.pack>\n", argv[0]);
+        return 1;
+    }
+
+    if (!font_pack_write(argv[1])) {
+        fprintf(stderr, "Can't write %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -10,6 +10,8 @@
 #include "lvgl/lvgl.h"
 #endif
 
+#include "font_pack.h"
+
 #ifndef SONY_18
 #define SONY_18 1
 #endif
@@ -20,6 +22,7 @@
  *    BITMAPS
  *----------------*/
 
+#if !FONT_PACK
 /*Store the image of the glyphs*/
 static LV_ATTRIBUTE_LARGE_CONST const uint8_t glyph_bitmap[] = {
     /* U+0020 " " */
@@ -664,6 +667,7 @@ static LV_ATTRIBUTE_LARGE_CONST const uint8_t glyph_bitmap[] = {
     0x59, 0xef, 0xfd, 0x40, 0x1, 0x0, 0x0, 0x1,
     0x10, 0x0
 };
+#endif
 
 
 /*---------------------
@@ -966,7 +970,7 @@ static const lv_font_fmt_txt_dsc_t font_dsc = {
 #else
 static lv_font_fmt_txt_dsc_t font_dsc = {
 #endif
-    .glyph_bitmap = glyph_bitmap,
+    .glyph_bitmap = FONT_BITMAP(glyph_bitmap),
     .glyph_dsc = glyph_dsc,
     .cmaps = cmaps,
     .kern_dsc = &kern_pairs,
@@ -992,7 +996,7 @@ const lv_font_t sony_18 = {
 lv_font_t sony_18 = {
 #endif
     .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,    /*Function pointer to get glyph's data*/
-    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,    /*Function pointer to get glyph's bitmap*/
+    .get_glyph_bitmap = FONT_GET_BITMAP,               /*Function pointer to get glyph's bitmap*/
     .line_height = 14,          /*The maximum line height required by the font*/
     .base_line = 3,             /*Baseline measured from the bottom of the line*/
 #if !(LVGL_VERSION_MAJOR == 6 && LVGL_VERSION_MINOR == 0)
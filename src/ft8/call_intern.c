@@ -0,0 +1,245 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "call_intern.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK     4096
+#define PAGE_SIZE       1024        // IDs per page of strings
+#define PAGES           (CALL_INTERN_MAX / PAGE_SIZE)
+#define SET_INIT_SIZE   1024        // Power of 2
+
+typedef struct arena_block_t {
+    struct arena_block_t    *next;
+    size_t                  used;
+    char                    data[ARENA_BLOCK];
+} arena_block_t;
+
+static arena_block_t    *arena = NULL;
+static const char       **pages[PAGES];
+static uint32_t         count = 0;
+
+/* Open addressing set of IDs, 0 - free slot */
+static call_id_t        *set = NULL;
+static uint32_t         set_size = 0;
+
+static pthread_mutex_t  mux = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t) s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static const char * id_str(call_id_t id) {
+    return pages[(id - 1) / PAGE_SIZE][(id - 1) % PAGE_SIZE];
+}
+
+/**
+ * Slot of the string or a free slot for it
+ */
+static call_id_t * set_find(const char *s, size_t len) {
+    uint32_t i = hash(s, len) & (set_size - 1);
+
+    while (set[i]) {
+        const char *str = id_str(set[i]);
+
+        if (strncmp(str, s, len) == 0 && str[len] == '\0') {
+            break;
+        }
+        i = (i + 1) & (set_size - 1);
+    }
+    return &set[i];
+}
+
+static bool set_grow() {
+    call_id_t   *old = set;
+    uint32_t    old_size = set_size;
+    uint32_t    size = old_size ? old_size * 2 : SET_INIT_SIZE;
+
+    set = calloc(size, sizeof(call_id_t));
+
+    if (!set) {
+        set = old;
+        return false;
+    }
+    set_size = size;
+
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old[i]) {
+            const char *str = id_str(old[i]);
+
+            *set_find(str, strlen(str)) = old[i];
+        }
+    }
+    free(old);
+    return true;
+}
+
+static char * arena_put(const char *s, size_t len) {
+    if (!arena || arena->used + len + 1 > ARENA_BLOCK) {
+        arena_block_t *block = malloc(sizeof(arena_block_t));
+
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena;
+        block->used = 0;
+        arena = block;
+    }
+
+    char *str = &arena->data[arena->used];
+
+    memcpy(str, s, len);
+    str[len] = '\0';
+    arena->used += len + 1;
+
+    return str;
+}
+
+/**
+ * Under mux
+ */
+static call_id_t intern(const char *s, size_t len, bool add) {
+    if (len == 0 || len >= CALL_INTERN_LEN) {
+        return CALL_ID_NONE;
+    }
+    if (!set) {
+        if (!add || !set_grow()) {
+            return CALL_ID_NONE;
+        }
+    }
+
+    call_id_t *slot = set_find(s, len);
+
+    if (*slot || !add) {
+        return *slot;
+    }
+    if (count == CALL_INTERN_MAX) {
+        return CALL_ID_NONE;
+    }
+
+    // Load factor below 0.75
+    if ((count + 1) * 4 > set_size * 3) {
+        if (!set_grow()) {
+            return CALL_ID_NONE;
+        }
+        slot = set_find(s, len);
+    }
+
+    uint32_t page = count / PAGE_SIZE;
+
+    if (!pages[page]) {
+        pages[page] = malloc(PAGE_SIZE * sizeof(char *));
+
+        if (!pages[page]) {
+            return CALL_ID_NONE;
+        }
+    }
+
+    char *str = arena_put(s, len);
+
+    if (!str) {
+        return CALL_ID_NONE;
+    }
+    pages[page][count % PAGE_SIZE] = str;
+    *slot = ++count;
+
+    return *slot;
+}
+
+static call_id_t intern_locked(const char *s, size_t len, bool add) {
+    int         cancel_state;
+    call_id_t   id;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    pthread_mutex_lock(&mux);
+    id = intern(s, len, add);
+    pthread_mutex_unlock(&mux);
+    pthread_setcancelstate(cancel_state, NULL);
+
+    return id;
+}
+
+call_id_t call_intern_n(const char *call, size_t len) {
+    return call ? intern_locked(call, len, true) : CALL_ID_NONE;
+}
+
+call_id_t call_intern(const char *call) {
+    return call ? intern_locked(call, strlen(call), true) : CALL_ID_NONE;
+}
+
+bool call_canonize(const char *callsign, char *out) {
+    const char *token = callsign;
+    const char *found = NULL;
+    size_t      len = 0;
+
+    if (!callsign) {
+        return false;
+    }
+
+    while (*token) {
+        size_t token_len = strcspn(token, "/");
+
+        if (token_len >= 4 && (isdigit(token[0]) || isdigit(token[1]) || isdigit(token[2]))) {
+            found = token;
+            len = token_len;
+            break;
+        }
+        token += token_len;
+        token += strspn(token, "/");
+    }
+    if (!found) {
+        found = callsign;
+        len = strlen(callsign);
+    }
+    if (len == 0 || len >= CALL_INTERN_LEN) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        out[i] = toupper(found[i]);
+    }
+    out[len] = '\0';
+    return true;
+}
+
+call_id_t call_intern_canon(const char *callsign) {
+    char call[CALL_INTERN_LEN];
+
+    if (!call_canonize(callsign, call)) {
+        return CALL_ID_NONE;
+    }
+    return intern_locked(call, strlen(call), true);
+}
+
+call_id_t call_intern_find_canon(const char *callsign) {
+    char call[CALL_INTERN_LEN];
+
+    if (!call_canonize(callsign, call)) {
+        return CALL_ID_NONE;
+    }
+    return intern_locked(call, strlen(call), false);
+}
+
+const char * call_intern_str(call_id_t id) {
+    if (id == CALL_ID_NONE || id > count) {
+        return NULL;
+    }
+    return id_str(id);
+}
+
+uint32_t call_intern_count() {
+    return count;
+}
@@ -0,0 +1,67 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CALL_INTERN_LEN     16          // With the terminating zero
+#define CALL_INTERN_MAX     (64 * 1024)
+
+/*
+ * Callsign interning: each string is stored once in an arena and is referenced
+ * by a 32 bits ID, so callsigns are compared as integers. Strings are never
+ * freed and don't move, a pointer of call_intern_str() is valid while the app
+ * runs. IDs start from 1, CALL_ID_NONE is returned for too long strings and on
+ * a full pool.
+ *
+ * Any thread, asynchronous cancellation is disabled while the lock is held.
+ */
+
+#define CALL_ID_NONE        0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t call_id_t;
+
+/**
+ * ID of `len` chars of `call` as they are, added if it's new
+ */
+call_id_t call_intern_n(const char *call, size_t len);
+call_id_t call_intern(const char *call);
+
+/**
+ * ID of the canonical callsign: the part with a digit in the first 3 chars of
+ * "PREFIX/CALL/SUFFIX" and upper case. Added if it's new
+ */
+call_id_t call_intern_canon(const char *callsign);
+
+/**
+ * ID of the canonical callsign without adding it, CALL_ID_NONE if it's unknown
+ */
+call_id_t call_intern_find_canon(const char *callsign);
+
+/**
+ * String of the ID, NULL for CALL_ID_NONE
+ */
+const char *call_intern_str(call_id_t id);
+
+/**
+ * Canonical callsign into `out` of CALL_INTERN_LEN, no heap is used
+ */
+bool call_canonize(const char *callsign, char *out);
+
+uint32_t call_intern_count();
+
+#ifdef __cplusplus
+}
+#endif
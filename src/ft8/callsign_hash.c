@@ -0,0 +1,235 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "callsign_hash.h"
+
+#include "lvgl/lvgl.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define CALLSIGN_LEN    12
+#define MAX_COUNT       (CALLSIGN_HASH_SIZE * 3 / 4)
+#define HASH22_MASK     0x3FFFFFu
+
+typedef struct {
+    char        callsign[CALLSIGN_LEN];    // Empty - free slot
+    uint32_t    n22;
+    int64_t     seen;                      // Unix time of the last save or lookup
+} entry_t;
+
+static entry_t  table[CALLSIGN_HASH_SIZE];
+static uint32_t count = 0;
+static bool     loaded = false;
+static bool     dirty = false;
+static char     file_path[64];
+
+static bool lookup_hash(ftx_callsign_hash_type_t hash_type, uint32_t hash, char *callsign);
+static void save_hash(const char *callsign, uint32_t n22);
+
+ftx_callback_t callsign_hash_if = {
+    .lookup_hash = lookup_hash,
+    .save_hash = save_hash
+};
+
+static uint32_t home(uint32_t n22) {
+    uint32_t hash10 = (n22 >> 12) & 0x3FFu;
+
+    return (hash10 * 2654435761u >> 20) & (CALLSIGN_HASH_SIZE - 1);
+}
+
+static uint32_t next(uint32_t i) {
+    return (i + 1) & (CALLSIGN_HASH_SIZE - 1);
+}
+
+/**
+ * Backward shift deletion, keeps probe clusters without tombstones
+ */
+static void remove_at(uint32_t i) {
+    uint32_t j = i;
+
+    while (true) {
+        table[i].callsign[0] = '\0';
+
+        while (true) {
+            j = next(j);
+
+            if (!table[j].callsign[0]) {
+                count--;
+                return;
+            }
+
+            uint32_t k = home(table[j].n22);
+
+            // Entry at j can't go to i, if its home is cyclically in (i, j]
+            if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+                continue;
+            }
+            break;
+        }
+        table[i] = table[j];
+        i = j;
+    }
+}
+
+static void evict_oldest() {
+    uint32_t oldest = 0;
+    int64_t  oldest_seen = INT64_MAX;
+
+    for (uint32_t i = 0; i < CALLSIGN_HASH_SIZE; i++) {
+        if (table[i].callsign[0] && table[i].seen < oldest_seen) {
+            oldest = i;
+            oldest_seen = table[i].seen;
+        }
+    }
+    if (oldest_seen != INT64_MAX) {
+        remove_at(oldest);
+    }
+}
+
+static void insert(const char *callsign, uint32_t n22, int64_t seen) {
+    uint32_t i = home(n22);
+
+    n22 &= HASH22_MASK;
+
+    while (table[i].callsign[0]) {
+        if (table[i].n22 == n22 && strcmp(table[i].callsign, callsign) == 0) {
+            if (seen > table[i].seen) {
+                table[i].seen = seen;
+            }
+            return;
+        }
+        i = next(i);
+    }
+    if (count >= MAX_COUNT) {
+        evict_oldest();
+        insert(callsign, n22, seen);
+        return;
+    }
+    strncpy(table[i].callsign, callsign, CALLSIGN_LEN - 1);
+    table[i].callsign[CALLSIGN_LEN - 1] = '\0';
+    table[i].n22 = n22;
+    table[i].seen = seen;
+    count++;
+}
+
+static bool lookup_hash(ftx_callsign_hash_type_t hash_type, uint32_t hash, char *callsign) {
+    uint8_t  shift;
+    int64_t  now = time(NULL);
+    int64_t  min_seen = now - CALLSIGN_HASH_SHORT_AGE;
+    entry_t  *found = NULL;
+
+    switch (hash_type) {
+        case FTX_CALLSIGN_HASH_10_BITS:
+            shift = 12;
+            break;
+        case FTX_CALLSIGN_HASH_12_BITS:
+            shift = 10;
+            break;
+        default:
+            shift = 0;
+            min_seen = INT64_MIN;
+            break;
+    }
+
+    for (uint32_t i = home(hash << shift); table[i].callsign[0]; i = next(i)) {
+        entry_t *entry = &table[i];
+
+        if ((entry->n22 >> shift) == hash && entry->seen >= min_seen && (!found || entry->seen > found->seen)) {
+            found = entry;
+
+            if (shift == 0) {
+                break;
+            }
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    strcpy(callsign, found->callsign);
+    found->seen = now;
+    dirty = true;
+    return true;
+}
+
+static void save_hash(const char *callsign, uint32_t n22) {
+    int cancel_state;
+
+    // Keep the table consistent for the file, if the decode thread is cancelled
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    insert(callsign, n22, time(NULL));
+    dirty = true;
+    pthread_setcancelstate(cancel_state, NULL);
+}
+
+void callsign_hash_load(const char *path) {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+    strncpy(file_path, path, sizeof(file_path) - 1);
+
+    FILE *fp = fopen(path, "r");
+
+    if (!fp) {
+        LV_LOG_USER("No callsign hash file");
+        return;
+    }
+
+    char        callsign[CALLSIGN_LEN];
+    uint32_t    n22;
+    long long   seen;
+    int64_t     min_seen = time(NULL) - CALLSIGN_HASH_MAX_AGE;
+
+    while (fscanf(fp, "%11s %u %lld", callsign, &n22, &seen) == 3) {
+        if (seen >= min_seen) {
+            insert(callsign, n22, seen);
+        }
+    }
+    fclose(fp);
+    LV_LOG_USER("Loaded %u hashed callsigns", count);
+}
+
+bool callsign_hash_save() {
+    if (!dirty || !file_path[0]) {
+        return true;
+    }
+
+    char tmp_path[sizeof(file_path) + 4];
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", file_path);
+
+    FILE *fp = fopen(tmp_path, "w");
+
+    if (!fp) {
+        LV_LOG_ERROR("Can't write callsign hash file");
+        return false;
+    }
+    for (uint32_t i = 0; i < CALLSIGN_HASH_SIZE; i++) {
+        if (table[i].callsign[0]) {
+            fprintf(fp, "%s %u %lld\n", table[i].callsign, table[i].n22, (long long) table[i].seen);
+        }
+    }
+    if (fclose(fp) != 0 || rename(tmp_path, file_path) != 0) {
+        LV_LOG_ERROR("Can't write callsign hash file");
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+void callsign_hash_clear() {
+    memset(table, 0, sizeof(table));
+    count = 0;
+    dirty = true;
+}
+
+uint32_t callsign_hash_count() {
+    return count;
+}
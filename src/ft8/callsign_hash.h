@@ -0,0 +1,47 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <ft8lib/message.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CALLSIGN_HASH_SIZE      4096    // Power of 2
+#define CALLSIGN_HASH_MAX_AGE   (7 * 24 * 3600) // Seconds, older entries are not loaded
+#define CALLSIGN_HASH_SHORT_AGE (30 * 60)       // Seconds, for 10 and 12 bits lookups
+
+/*
+ * Callsigns by their 22 bits hash for ft8lib. Lives while the app runs and is kept
+ * in a file between runs. Open addressing with linear probing from the 10 bits
+ * hash, so lookups of any hash size probe the same cluster. The least recently
+ * seen entry is evicted on full table.
+ *
+ * Short hashes are ambiguous, they resolve to the most recently seen callsign, and
+ * only to the seen in CALLSIGN_HASH_SHORT_AGE.
+ *
+ * Not thread safe: used from the FT8 decode thread only.
+ */
+
+/// @brief Callbacks for ftx_message_encode() and ftx_message_decode()
+extern ftx_callback_t callsign_hash_if;
+
+/// @brief Load the table from file, once per app run
+/// @param[in] path file of the table
+void callsign_hash_load(const char *path);
+
+/// @brief Write the table to the file of callsign_hash_load()
+/// @return success flag
+bool callsign_hash_save();
+
+/// @brief Remove all entries
+void callsign_hash_clear();
+
+/// @brief Return count of entries
+uint32_t callsign_hash_count();
@@ -12,9 +12,20 @@
 #include <math.h>
 #include <stdlib.h>
 
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
 #define GFSK_CONST_K 5.336446f
+#define GFSK_AMPLITUDE (32767.0f * 0.8f)
+
+#define SIN_LUT_BITS 10
+#define SIN_LUT_SIZE (1 << SIN_LUT_BITS)
+#define PHASE_ONE 4294967296.0 // Full turn of the uint32_t phase
+
+static int16_t sin_lut[SIN_LUT_SIZE + 1];
 
-static void gfsk_pulse(uint16_t n_spsym, float symbol_bt, float *pulse) {
+static void gfsk_pulse(uint32_t n_spsym, float symbol_bt, float *pulse) {
     for (uint32_t i = 0; i < 3 * n_spsym; i++) {
         float t = i / (float)n_spsym - 1.5f;
         float arg1 = GFSK_CONST_K * symbol_bt * (t + 0.5f);
@@ -24,61 +35,141 @@ static void gfsk_pulse(uint16_t n_spsym, float symbol_bt, float *pulse) {
     }
 }
 
-int16_t *gfsk_synth(const uint8_t *symbols, uint16_t n_sym, float f0, float symbol_bt, float symbol_period,
-                    uint32_t sample_rate, uint32_t *n_samples) {
-    uint32_t n_spsym = (uint32_t)(0.5f + sample_rate * symbol_period); /* Samples per symbol */
-    uint32_t n_wave = n_sym * n_spsym;                                 /* Number of output samples */
-    float    hmod = 1.0f;
-    float    dphi_peak = 2 * M_PI * hmod / n_spsym;
-    float    dphi[n_wave + 2 * n_spsym];
-    int16_t *samples = malloc(sizeof(int16_t) * n_wave);
-
-    *n_samples = n_wave;
+static void sin_lut_init() {
+    if (sin_lut[SIN_LUT_SIZE / 4] != 0) {
+        return;
+    }
+    for (uint32_t i = 0; i <= SIN_LUT_SIZE; i++) {
+        sin_lut[i] = lrintf(sinf(2 * M_PI * i / SIN_LUT_SIZE) * GFSK_AMPLITUDE);
+    }
+}
 
-    /* Shift frequency up by f0 */
+/* Sine of uint32_t phase, linear interpolation between LUT points */
+static inline int16_t sin_phase(uint32_t phase) {
+    uint32_t idx = phase >> (32 - SIN_LUT_BITS);
+    int32_t  frac = (phase >> (16 - SIN_LUT_BITS)) & 0xFFFF;
+    int32_t  a = sin_lut[idx];
+    int32_t  b = sin_lut[idx + 1];
 
-    for (uint32_t i = 0; i < n_wave + 2 * n_spsym; i++) {
-        dphi[i] = 2 * M_PI * f0 / sample_rate;
-    }
+    return a + (((b - a) * frac) >> 16);
+}
 
-    float pulse[3 * n_spsym];
+gfsk_shape_t *gfsk_shape_create(float symbol_bt, float symbol_period, float hmod, uint32_t sample_rate) {
+    gfsk_shape_t *shape = malloc(sizeof(gfsk_shape_t));
+    uint32_t      n_spsym = (uint32_t)(0.5f + sample_rate * symbol_period);
+    float        *pulse = malloc(sizeof(float) * 3 * n_spsym);
 
+    sin_lut_init();
     gfsk_pulse(n_spsym, symbol_bt, pulse);
 
-    for (uint32_t i = 0; i < n_sym; i++) {
-        int ib = i * n_spsym;
-
-        for (uint32_t j = 0; j < 3 * n_spsym; j++) {
-            dphi[j + ib] += dphi_peak * symbols[i] * pulse[j];
-        }
-    }
+    shape->n_spsym = n_spsym;
+    shape->sample_rate = sample_rate;
+    shape->symbol_bt = symbol_bt;
+    shape->symbol_period = symbol_period;
+    shape->pulse = malloc(sizeof(uint32_t) * 3 * n_spsym);
 
-    /* Add dummy symbols at beginning and end with tone values equal to 1st and last symbol, respectively */
+    /* Phase increment of tone 1, in turns */
+    double dphi_peak = hmod / n_spsym;
 
-    for (uint32_t j = 0; j < 2 * n_spsym; j++) {
-        dphi[j] += dphi_peak * pulse[j + n_spsym] * symbols[0];
-        dphi[j + n_sym * n_spsym] += dphi_peak * pulse[j] * symbols[n_sym - 1];
+    for (uint32_t i = 0; i < 3 * n_spsym; i++) {
+        shape->pulse[i] = (uint32_t)llrint(dphi_peak * pulse[i] * PHASE_ONE);
     }
+    free(pulse);
+    return shape;
+}
 
-    /* Calculate and insert the audio waveform */
+void gfsk_shape_destroy(gfsk_shape_t *shape) {
+    if (shape) {
+        free(shape->pulse);
+        free(shape);
+    }
+}
 
-    float phi = 0;
+uint32_t gfsk_shape_size(const gfsk_shape_t *shape, uint16_t n_sym) {
+    return n_sym * shape->n_spsym;
+}
 
-    for (uint32_t k = 0; k < n_wave; k++) { /* Don't include dummy symbols */
-        samples[k] = sinf(phi) * 32767.0f * 0.8f;
-        phi = fmodf(phi + dphi[k + n_spsym], 2 * M_PI);
+/*
+ * Output sample j of symbol s is shaped by the pulses of symbols s - 1, s and s + 1,
+ * first and last symbols are repeated as dummy symbols beyond the message
+ */
+void gfsk_shape_synth(const gfsk_shape_t *shape, const uint8_t *symbols, uint16_t n_sym, float f0, int16_t *samples) {
+    const uint32_t  n = shape->n_spsym;
+    const uint32_t *pulse = shape->pulse;
+    const uint32_t  f0_inc = (uint32_t)llrint((double)f0 / shape->sample_rate * PHASE_ONE);
+    uint32_t        phase = 0;
+    int16_t        *out = samples;
+
+    for (uint32_t s = 0; s < n_sym; s++) {
+        uint32_t        t_prev = symbols[s > 0 ? s - 1 : 0];
+        uint32_t        t_cur = symbols[s];
+        uint32_t        t_next = symbols[s + 1 < n_sym ? s + 1 : n_sym - 1];
+        const uint32_t *p_prev = &pulse[2 * n];
+        const uint32_t *p_cur = &pulse[n];
+        const uint32_t *p_next = &pulse[0];
+        uint32_t        j = 0;
+
+#ifdef __ARM_NEON
+        const uint32x4_t zero = vdupq_n_u32(0);
+        uint32_t         phases[4];
+
+        for (; j + 4 <= n; j += 4) {
+            uint32x4_t inc = vdupq_n_u32(f0_inc);
+
+            inc = vmlaq_n_u32(inc, vld1q_u32(p_prev + j), t_prev);
+            inc = vmlaq_n_u32(inc, vld1q_u32(p_cur + j), t_cur);
+            inc = vmlaq_n_u32(inc, vld1q_u32(p_next + j), t_next);
+
+            // Exclusive prefix sum: the phase of a sample is before its increment
+            uint32x4_t sum = vaddq_u32(inc, vextq_u32(zero, inc, 3));
+
+            sum = vaddq_u32(sum, vextq_u32(zero, sum, 2));
+            vst1q_u32(phases, vaddq_u32(vdupq_n_u32(phase), vsubq_u32(sum, inc)));
+            phase += vgetq_lane_u32(sum, 3);
+
+            *out++ = sin_phase(phases[0]);
+            *out++ = sin_phase(phases[1]);
+            *out++ = sin_phase(phases[2]);
+            *out++ = sin_phase(phases[3]);
+        }
+#endif
+        for (; j < n; j++) {
+            *out++ = sin_phase(phase);
+            phase += f0_inc + t_prev * p_prev[j] + t_cur * p_cur[j] + t_next * p_next[j];
+        }
     }
 
     /* Apply envelope shaping to the first and last symbols */
 
-    int n_ramp = n_spsym / 8;
+    uint32_t n_wave = n_sym * n;
+    uint32_t n_ramp = n / 8;
 
     for (uint32_t i = 0; i < n_ramp; i++) {
-        float env = (1 - cosf(2 * M_PI * i / (2 * n_ramp))) / 2;
+        int32_t env = (1 - cosf(2 * M_PI * i / (2 * n_ramp))) / 2 * 32768.0f;
 
-        samples[i] *= env;
-        samples[n_wave - 1 - i] *= env;
+        samples[i] = (samples[i] * env) >> 15;
+        samples[n_wave - 1 - i] = (samples[n_wave - 1 - i] * env) >> 15;
     }
+}
+
+uint32_t gfsk_synth_size(uint16_t n_sym, float symbol_period, uint32_t sample_rate) {
+    return n_sym * (uint32_t)(0.5f + sample_rate * symbol_period);
+}
+
+void gfsk_synth_to(const uint8_t *symbols, uint16_t n_sym, float f0, float symbol_bt, float symbol_period,
+                   uint32_t sample_rate, int16_t *samples) {
+    gfsk_shape_t *shape = gfsk_shape_create(symbol_bt, symbol_period, 1.0f, sample_rate);
+
+    gfsk_shape_synth(shape, symbols, n_sym, f0, samples);
+    gfsk_shape_destroy(shape);
+}
+
+int16_t *gfsk_synth(const uint8_t *symbols, uint16_t n_sym, float f0, float symbol_bt, float symbol_period,
+                    uint32_t sample_rate, uint32_t *n_samples) {
+    *n_samples = gfsk_synth_size(n_sym, symbol_period, sample_rate);
+
+    int16_t *samples = malloc(sizeof(int16_t) * *n_samples);
 
+    gfsk_synth_to(symbols, n_sym, f0, symbol_bt, symbol_period, sample_rate, samples);
     return samples;
 }
@@ -13,5 +13,35 @@
 #define FT8_SYMBOL_BT 2.0f
 #define FT4_SYMBOL_BT 1.0f
 
+/*
+ * Precomputed pulse shape of one symbol rate, BT and sample rate: phase increments
+ * of tone 1 over 3 symbols in uint32_t turns. Synthesis accumulates phase in
+ * integers and takes sine from a LUT, so int16 output needs no float per sample
+ */
+typedef struct {
+    uint32_t n_spsym;       // Samples per symbol
+    uint32_t sample_rate;
+    float    symbol_bt;
+    float    symbol_period;
+    uint32_t *pulse;        // 3 * n_spsym
+} gfsk_shape_t;
+
+/* Tone spacing is hmod / symbol_period */
+gfsk_shape_t *gfsk_shape_create(float symbol_bt, float symbol_period, float hmod, uint32_t sample_rate);
+void gfsk_shape_destroy(gfsk_shape_t *shape);
+
+/* Samples count of n_sym symbols */
+uint32_t gfsk_shape_size(const gfsk_shape_t *shape, uint16_t n_sym);
+
+/* Synthesize into samples of gfsk_shape_size(), tone 0 is at f0 */
+void gfsk_shape_synth(const gfsk_shape_t *shape, const uint8_t *symbols, uint16_t n_sym, float f0, int16_t *samples);
+
+/* Samples count of n_sym symbols */
+uint32_t gfsk_synth_size(uint16_t n_sym, float symbol_period, uint32_t sample_rate);
+
+/* Synthesize into samples of gfsk_synth_size() */
+void gfsk_synth_to(const uint8_t *symbols, uint16_t n_sym, float f0, float symbol_bt, float symbol_period,
+                   uint32_t sample_rate, int16_t *samples);
+
 int16_t *gfsk_synth(const uint8_t *symbols, uint16_t n_sym, float f0, float symbol_bt, float symbol_period,
                     uint32_t sample_rate, uint32_t *n_samples);
@@ -3,40 +3,78 @@
 
 #define DEFAULT_SNR 100
 
+#include <algorithm>
+
 extern "C" {
 #include "../qth/qth.h"
 #include "string.h"
 #include "utils.h"
 }
 
-static std::string make_answer_text(ftx_msg_type_t last_rx_type, std::string remote_callsign,
-                                    std::string local_callsign, const int local_snr, std::string grid);
+static void make_answer_text(ftx_msg_type_t last_rx_type, const char *remote_callsign, const char *local_callsign,
+                             const int local_snr, const char *grid, char *answer);
+
+/**
+ * Copy token with truncation to the `size` buffer
+ */
+static void copy_token(char *dst, size_t size, std::string_view token) {
+    size_t len = std::min(token.size(), size - 1);
+
+    memcpy(dst, token.data(), len);
+    dst[len] = '\0';
+}
+
+/**
+ * Parse "+05", "-12" report, as stoi() did
+ */
+static int parse_report(std::string_view text) {
+    int  val = 0;
+    bool neg = false;
+
+    if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+        neg = text[0] == '-';
+        text.remove_prefix(1);
+    }
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            break;
+        }
+        val = val * 10 + (c - '0');
+    }
+    return neg ? -val : val;
+}
+
+void FTxTokens::push_back(std::string_view token) {
+    if (_size < FTX_MAX_TOKENS) {
+        _tokens[_size++] = token;
+    }
+}
 
-std::vector<std::string> split_text(std::string text) {
-    std::vector<std::string> tokens;
+FTxTokens split_text(std::string_view text) {
+    FTxTokens tokens;
 
-    const char  delim = ' ';
-    size_t      initialPos = 0;
-    size_t      pos;
-    std::string token;
+    const char delim = ' ';
+    size_t     initialPos = 0;
+    size_t     pos;
     do {
         pos = text.find(delim, initialPos);
-        token = text.substr(initialPos, pos - initialPos);
+        std::string_view token = text.substr(initialPos, pos - initialPos);
         if (!token.empty())
             tokens.push_back(token);
         initialPos = pos + 1;
-    } while (pos != std::string::npos);
+    } while (pos != std::string_view::npos);
     return tokens;
 }
 
-Candidate::Candidate(std::string remote_callsign) {
-    _remote_callsign = remote_callsign;
+Candidate::Candidate(std::string_view remote_callsign, call_id_t remote_id) {
+    copy_token(_remote_callsign, sizeof(_remote_callsign), remote_callsign);
+    _remote_id = remote_id;
     _sent_snr = DEFAULT_SNR;
     _rcvd_snr = DEFAULT_SNR;
 }
 
-void Candidate::set_grid(std::string grid) {
-    _grid = grid;
+void Candidate::set_grid(std::string_view grid) {
+    copy_token(_grid, sizeof(_grid), grid);
 }
 
 void Candidate::set_report(int report) {
@@ -55,25 +93,27 @@ void Candidate::set_rcvd_snr(int snr) {
     _rcvd_snr = snr;
 }
 
-bool Candidate::match_callsign(std::string callsign) {
-    return callsign == _remote_callsign;
+bool Candidate::match_callsign(std::string_view callsign, call_id_t id) const {
+    if (id == CALL_ID_NONE || _remote_id == CALL_ID_NONE) {
+        return callsign == _remote_callsign;
+    }
+    return id == _remote_id;
 }
 
 bool Candidate::is_finished() {
     return (_last_rx_type == FTX_MSG_TYPE_73) || (_last_rx_type == FTX_MSG_TYPE_RR73);
 }
 
-std::string Candidate::get_tx_text(std::string local_callsign, std::string local_qth) {
-    std::string answer = make_answer_text(_last_rx_type, _remote_callsign, local_callsign, _local_snr, local_qth);
+void Candidate::get_tx_text(const std::string &local_callsign, const std::string &local_qth, char *text) {
+    make_answer_text(_last_rx_type, _remote_callsign, local_callsign.c_str(), _local_snr, local_qth.c_str(), text);
     if ((_last_rx_type == FTX_MSG_TYPE_GRID) || (_last_rx_type == FTX_MSG_TYPE_REPORT)) {
         _sent_snr = _local_snr;
     }
-    return answer;
 }
 
 void Candidate::save_qso(save_qso_cb_t save_qso_cb) {
-    if ((!_remote_callsign.empty()) && (_rcvd_snr != DEFAULT_SNR) && (_sent_snr != DEFAULT_SNR) && !_saved)
-        save_qso_cb(_remote_callsign.c_str(), _grid.c_str(), _rcvd_snr, _sent_snr);
+    if ((_remote_callsign[0] != '\0') && (_rcvd_snr != DEFAULT_SNR) && (_sent_snr != DEFAULT_SNR) && !_saved)
+        save_qso_cb(_remote_callsign, _grid, _rcvd_snr, _sent_snr);
         _saved = true;
 }
 
@@ -87,24 +127,21 @@ FTxQsoProcessor::FTxQsoProcessor(std::string local_callsign, std::string local_q
     _save_qso_cb = save_qso_cb;
 }
 
-FTxQsoProcessor::~FTxQsoProcessor() {
-    if (_cur_candidate != NULL)
-        delete _cur_candidate;
-    if (_next_candidate != NULL)
-        delete _next_candidate;
-}
-
-void FTxQsoProcessor::add_rx_text(std::string text, const int snr, ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg) {
+void FTxQsoProcessor::add_rx_text(std::string_view text, const int snr, ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg) {
     meta->type = FXT_MSG_TYPE_OTHER;
     meta->local_snr = snr;
     meta->to_me = false;
     meta->grid[0] = '\0';
 
-    std::vector<std::string> tokens = split_text(text);
+    FTxTokens tokens = split_text(text);
+
+    if (tokens.size() == 0) {
+        return;
+    }
 
     if ((tokens.size() >= 5) && (text.find(';') != text.npos)) {
         // "A2AA RR73; R2RFE <RP79AA> +05"
-        std::vector<std::string> new_tokens;
+        FTxTokens new_tokens;
         if (tokens[0] == _local_callsign) {
             new_tokens.push_back(tokens[0]);
             new_tokens.push_back(tokens[3]);
@@ -117,135 +154,153 @@ void FTxQsoProcessor::add_rx_text(std::string text, const int snr, ftx_msg_meta_
         tokens = new_tokens;
     }
 
-    for (auto it = tokens.begin(); it != tokens.end(); it++) {
-        if (it->at(0) == '<') {
-            *it = it->substr(1, it->length() - 2);
+    FTxTokens stripped;
+
+    for (size_t i = 0; i < tokens.size(); i++) {
+        std::string_view token = tokens[i];
+
+        if (token[0] == '<') {
+            token = token.substr(1, token.length() - 2);
         }
+        stripped.push_back(token);
     }
-
+    tokens = stripped;
 
     if (tokens[0] == "CQ") {
         process_cq(meta, tokens, snr);
-    } else if (tokens.size() >= 3) {
+    } else if ((tokens.size() >= 3) && !tokens[2].empty()) {
+        char grid[FTX_GRID_SIZE];
+
+        copy_token(grid, sizeof(grid), tokens[2]);
+
         if (tokens[2] == "73") {
             process_73(meta, tokens, snr, *tx_msg);
         } else if ((tokens[2] == "RRR") || (tokens[2] == "RR73")) {
             process_rr73(meta, tokens, snr, *tx_msg);
-        } else if ((tokens[2][0] == 'R') && ((tokens[2][1] == '+') || (tokens[2][1] == '-'))) {
+        } else if ((tokens[2].size() > 1) && (tokens[2][0] == 'R') && ((tokens[2][1] == '+') || (tokens[2][1] == '-'))) {
             process_r_report(meta, tokens, snr, *tx_msg);
         } else if ((tokens[2][0] == '+') || (tokens[2][0] == '-')) {
             process_report(meta, tokens, snr, *tx_msg);
-        } else if (qth_grid_check(tokens[2].c_str())) {
+        } else if (tokens[2].size() < sizeof(grid) && qth_grid_check(grid)) {
             process_grid(meta, tokens, snr, *tx_msg);
         }
     }
 }
 
-void FTxQsoProcessor::process_grid(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr,
+void FTxQsoProcessor::process_grid(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr,
                                    ftx_tx_msg_t &tx_msg) {
     auto call_to = tokens[0];
     auto call_de = tokens[1];
     auto grid = tokens[2];
     meta->type = FTX_MSG_TYPE_GRID;
-    strcpy(meta->grid, grid.c_str());
-    strcpy(meta->call_de, call_de.c_str());
+    copy_token(meta->grid, sizeof(meta->grid), grid);
+    copy_token(meta->call_de, sizeof(meta->call_de), call_de);
     if (call_to == _local_callsign) {
+        call_id_t de_id = call_intern_n(call_de.data(), call_de.size());
+
         meta->to_me = true;
-        auto candidate_to_update = get_candidate_to_update(call_de);
+        auto candidate_to_update = get_candidate_to_update(call_de, de_id);
         if (candidate_to_update != NULL) {
             (*candidate_to_update)->set_msg_type(meta->type);
             (*candidate_to_update)->set_local_snr(snr);
             (*candidate_to_update)->set_grid(grid);
             if ((*candidate_to_update == _cur_candidate) && _auto) {
                 tx_msg.repeats = -1;
-                strcpy(tx_msg.msg, _cur_candidate->get_tx_text(_local_callsign, _local_qth).c_str());
+                _cur_candidate->get_tx_text(_local_callsign, _local_qth, tx_msg.msg);
             }
         }
     }
 }
 
-void FTxQsoProcessor::process_report(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr,
+void FTxQsoProcessor::process_report(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr,
                                      ftx_tx_msg_t &tx_msg) {
     auto call_to = tokens[0];
     auto call_de = tokens[1];
-    auto rcvd_snr = std::stoi(tokens[2]);
+    auto rcvd_snr = parse_report(tokens[2]);
     meta->type = FTX_MSG_TYPE_REPORT;
     meta->remote_snr = rcvd_snr;
-    strcpy(meta->call_de, call_de.c_str());
+    copy_token(meta->call_de, sizeof(meta->call_de), call_de);
     if (call_to == _local_callsign) {
+        call_id_t de_id = call_intern_n(call_de.data(), call_de.size());
+
         meta->to_me = true;
-        auto candidate_to_update = get_candidate_to_update(call_de);
+        auto candidate_to_update = get_candidate_to_update(call_de, de_id);
         if (candidate_to_update != NULL) {
             (*candidate_to_update)->set_msg_type(meta->type);
             (*candidate_to_update)->set_local_snr(snr);
             (*candidate_to_update)->set_rcvd_snr(rcvd_snr);
             if ((*candidate_to_update == _cur_candidate) && _auto) {
                 tx_msg.repeats = -1;
-                strcpy(tx_msg.msg, _cur_candidate->get_tx_text(_local_callsign, _local_qth).c_str());
+                _cur_candidate->get_tx_text(_local_callsign, _local_qth, tx_msg.msg);
             }
         }
     }
 }
 
-void FTxQsoProcessor::process_r_report(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr,
+void FTxQsoProcessor::process_r_report(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr,
                                        ftx_tx_msg_t &tx_msg) {
     auto call_to = tokens[0];
     auto call_de = tokens[1];
-    auto rcvd_snr = std::stoi(tokens[2].substr(1, tokens[2].npos));
+    auto rcvd_snr = parse_report(tokens[2].substr(1));
     meta->type = FTX_MSG_TYPE_R_REPORT;
     meta->remote_snr = rcvd_snr;
-    strcpy(meta->call_de, call_de.c_str());
+    copy_token(meta->call_de, sizeof(meta->call_de), call_de);
     if (call_to == _local_callsign) {
+        call_id_t de_id = call_intern_n(call_de.data(), call_de.size());
+
         meta->to_me = true;
-        if ((_cur_candidate != NULL) && (_cur_candidate->match_callsign(call_de))) {
+        if ((_cur_candidate != NULL) && (_cur_candidate->match_callsign(call_de, de_id))) {
             _cur_candidate->set_msg_type(meta->type);
             _cur_candidate->set_local_snr(snr);
             _cur_candidate->set_rcvd_snr(rcvd_snr);
             _cur_candidate->save_qso(_save_qso_cb);
             if (_auto) {
                 tx_msg.repeats = 1;
-                strcpy(tx_msg.msg, _cur_candidate->get_tx_text(_local_callsign, _local_qth).c_str());
+                _cur_candidate->get_tx_text(_local_callsign, _local_qth, tx_msg.msg);
             }
         }
     }
 }
 
-void FTxQsoProcessor::process_rr73(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr,
+void FTxQsoProcessor::process_rr73(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr,
                                    ftx_tx_msg_t &tx_msg) {
     auto call_to = tokens[0];
     auto call_de = tokens[1];
     meta->type = FTX_MSG_TYPE_RR73;
-    strcpy(meta->call_de, call_de.c_str());
+    copy_token(meta->call_de, sizeof(meta->call_de), call_de);
     if (call_to == _local_callsign) {
+        call_id_t de_id = call_intern_n(call_de.data(), call_de.size());
+
         meta->to_me = true;
-        if ((_cur_candidate != NULL) && (_cur_candidate->match_callsign(call_de))) {
+        if ((_cur_candidate != NULL) && (_cur_candidate->match_callsign(call_de, de_id))) {
             _cur_candidate->set_msg_type(meta->type);
             _cur_candidate->set_local_snr(snr);
             _cur_candidate->save_qso(_save_qso_cb);
             if (_auto) {
                 tx_msg.repeats = 1;
-                strcpy(tx_msg.msg, _cur_candidate->get_tx_text(_local_callsign, _local_qth).c_str());
+                _cur_candidate->get_tx_text(_local_callsign, _local_qth, tx_msg.msg);
             }
         }
     }
 }
 
-void FTxQsoProcessor::process_73(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr,
+void FTxQsoProcessor::process_73(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr,
                                  ftx_tx_msg_t &tx_msg) {
     auto call_to = tokens[0];
     auto call_de = tokens[1];
     meta->type = FTX_MSG_TYPE_73;
-    strcpy(meta->call_de, call_de.c_str());
+    copy_token(meta->call_de, sizeof(meta->call_de), call_de);
     if (call_to == _local_callsign) {
+        call_id_t de_id = call_intern_n(call_de.data(), call_de.size());
+
         meta->to_me = true;
-        if ((_cur_candidate != NULL) && (_cur_candidate->match_callsign(call_de))) {
-            delete _cur_candidate;
+        if ((_cur_candidate != NULL) && (_cur_candidate->match_callsign(call_de, de_id))) {
             if (_next_candidate != NULL) {
                 _cur_candidate = _next_candidate;
                 _next_candidate = NULL;
                 if (_auto) {
                     tx_msg.repeats = 1;
-                    strcpy(tx_msg.msg, _cur_candidate->get_tx_text(_local_callsign, _local_qth).c_str());
+                    _cur_candidate->get_tx_text(_local_callsign, _local_qth, tx_msg.msg);
                 }
             } else {
                 _cur_candidate = NULL;
@@ -254,17 +309,23 @@ void FTxQsoProcessor::process_73(ftx_msg_meta_t *meta, std::vector<std::string>
     }
 }
 
-void FTxQsoProcessor::process_cq(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr) {
+void FTxQsoProcessor::process_cq(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr) {
     meta->type = FTX_MSG_TYPE_CQ;
     size_t call_de_pos;
-    if (is_cq_modifier(tokens[1].c_str()) && tokens.size() > 2) {
+    char   modifier[FTX_CALLSIGN_SIZE];
+
+    if (tokens.size() < 2) {
+        return;
+    }
+    copy_token(modifier, sizeof(modifier), tokens[1]);
+    if (is_cq_modifier(modifier) && tokens.size() > 2) {
         call_de_pos = 2;
     } else {
         call_de_pos = 1;
     }
-    strcpy(meta->call_de, tokens[call_de_pos].c_str());
+    copy_token(meta->call_de, sizeof(meta->call_de), tokens[call_de_pos]);
     if (tokens.size() > call_de_pos + 1) {
-        strcpy(meta->grid, tokens[call_de_pos + 1].c_str());
+        copy_token(meta->grid, sizeof(meta->grid), tokens[call_de_pos + 1]);
     }
 }
 
@@ -272,22 +333,17 @@ void FTxQsoProcessor::set_auto(bool val) {
     _auto = val;
 }
 
+void FTxQsoProcessor::set_dupe_cb(is_dupe_cb_t is_dupe_cb) {
+    _is_dupe_cb = is_dupe_cb;
+}
+
 void FTxQsoProcessor::start_new_slot() {
-    if (_next_candidate != NULL) {
-        delete _next_candidate;
-        _next_candidate = NULL;
-    }
+    _next_candidate = NULL;
 }
 
 void FTxQsoProcessor::reset() {
-    if (_cur_candidate != NULL) {
-        delete _cur_candidate;
-        _cur_candidate = NULL;
-    }
-    if (_next_candidate != NULL) {
-        delete _next_candidate;
-        _next_candidate = NULL;
-    }
+    _cur_candidate = NULL;
+    _next_candidate = NULL;
 }
 
 void FTxQsoProcessor::start_qso(ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg) {
@@ -319,58 +375,91 @@ void FTxQsoProcessor::start_qso(ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg) {
     default:
         break;
     }
-    strcpy(tx_msg->msg, _cur_candidate->get_tx_text(_local_callsign, _local_qth).c_str());
+    _cur_candidate->get_tx_text(_local_callsign, _local_qth, tx_msg->msg);
 }
 
-Candidate **FTxQsoProcessor::get_candidate_to_update(std::string call_de) {
+/**
+ * Candidate in a pool slot, which is not current and not next
+ */
+Candidate *FTxQsoProcessor::new_candidate(std::string_view remote_callsign, call_id_t remote_id) {
+    Candidate *candidate = &_pool[0];
+
+    while (candidate == _cur_candidate || candidate == _next_candidate) {
+        candidate++;
+    }
+    *candidate = Candidate(remote_callsign, remote_id);
+    return candidate;
+}
+
+/**
+ * New callers are not answered in the auto mode, if they are dupes
+ */
+bool FTxQsoProcessor::is_dupe(std::string_view call_de) {
+    if (!_auto || _is_dupe_cb == NULL) {
+        return false;
+    }
+
+    char call[FTX_CALLSIGN_SIZE];
+
+    copy_token(call, sizeof(call), call_de);
+    return _is_dupe_cb(call);
+}
+
+Candidate **FTxQsoProcessor::get_candidate_to_update(std::string_view call_de, call_id_t de_id) {
     if (_cur_candidate == NULL) {
+        if (is_dupe(call_de)) {
+            return NULL;
+        }
         // Start new QSO
-        _cur_candidate = new Candidate(call_de);
+        _cur_candidate = new_candidate(call_de, de_id);
     }
     Candidate **candidate_to_update = NULL;
-    if (_cur_candidate->match_callsign(call_de)) {
+    if (_cur_candidate->match_callsign(call_de, de_id)) {
         candidate_to_update = &_cur_candidate;
-    } else if (_next_candidate == NULL) {
-        _next_candidate = new Candidate(call_de);
+    } else if (_next_candidate == NULL && !is_dupe(call_de)) {
+        _next_candidate = new_candidate(call_de, de_id);
         candidate_to_update = &_next_candidate;
     }
     return candidate_to_update;
 }
 
-Candidate *FTxQsoProcessor::get_or_create_cur_candidate(std::string remote_callsign) {
+Candidate *FTxQsoProcessor::get_or_create_cur_candidate(std::string_view remote_callsign) {
+    call_id_t remote_id = call_intern_n(remote_callsign.data(), remote_callsign.size());
+
     // Try to continue current QSO
-    if ((_cur_candidate != NULL) && !_cur_candidate->match_callsign(remote_callsign)) {
-        delete _cur_candidate;
+    if ((_cur_candidate != NULL) && !_cur_candidate->match_callsign(remote_callsign, remote_id)) {
         _cur_candidate = NULL;
     }
     if (_cur_candidate == NULL) {
-        _cur_candidate = new Candidate(remote_callsign);
+        _cur_candidate = new_candidate(remote_callsign, remote_id);
     }
     return _cur_candidate;
 }
 
-static std::string make_answer_text(ftx_msg_type_t last_rx_type, std::string remote_callsign,
-                                    std::string local_callsign, const int local_snr, std::string grid) {
-    char answer[35];
-    int  len = 0;
+static void make_answer_text(ftx_msg_type_t last_rx_type, const char *remote_callsign, const char *local_callsign,
+                             const int local_snr, const char *grid, char *answer) {
+    const size_t size = sizeof(((ftx_tx_msg_t *)0)->msg);
+
+    answer[0] = '\0';
     switch (last_rx_type) {
     case FTX_MSG_TYPE_CQ:
-        len = snprintf(answer, 35, "%s %s %s", remote_callsign.c_str(), local_callsign.c_str(), grid.c_str());
+        snprintf(answer, size, "%s %s %s", remote_callsign, local_callsign, grid);
         break;
     case FTX_MSG_TYPE_GRID:
-        len = snprintf(answer, 35, "%s %s %+03d", remote_callsign.c_str(), local_callsign.c_str(), local_snr);
+        snprintf(answer, size, "%s %s %+03d", remote_callsign, local_callsign, local_snr);
         break;
     case FTX_MSG_TYPE_REPORT:
-        len = snprintf(answer, 35, "%s %s R%+03d", remote_callsign.c_str(), local_callsign.c_str(), local_snr);
+        snprintf(answer, size, "%s %s R%+03d", remote_callsign, local_callsign, local_snr);
         break;
     case FTX_MSG_TYPE_R_REPORT:
-        len = snprintf(answer, 35, "%s %s RR73", remote_callsign.c_str(), local_callsign.c_str());
+        snprintf(answer, size, "%s %s RR73", remote_callsign, local_callsign);
         break;
     case FTX_MSG_TYPE_RR73:
-        len = snprintf(answer, 35, "%s %s 73", remote_callsign.c_str(), local_callsign.c_str());
+        snprintf(answer, size, "%s %s 73", remote_callsign, local_callsign);
+        break;
+    default:
         break;
     }
-    return std::string(answer, len);
 }
 
 FTxQsoProcessor *ftx_qso_processor_init(const char *local_callsign, const char *qth, save_qso_cb_t save_qso_cb) {
@@ -385,6 +474,10 @@ void ftx_qso_processor_set_auto(FTxQsoProcessor *p, bool val) {
     p->set_auto(val);
 }
 
+void ftx_qso_processor_set_dupe_cb(FTxQsoProcessor *p, is_dupe_cb_t is_dupe_cb) {
+    p->set_dupe_cb(is_dupe_cb);
+}
+
 void ftx_qso_processor_start_new_slot(FTxQsoProcessor *p) {
     p->start_new_slot();
 }
@@ -35,54 +35,85 @@ typedef struct {
 
 typedef void (*save_qso_cb_t)(const char *remote_callsign, const char *remote_grid, const int r_snr, const int s_snr);
 
+/* Remote station was worked already, it's not answered automatically */
+typedef bool (*is_dupe_cb_t)(const char *remote_callsign);
+
 #ifdef __cplusplus
+#include "call_intern.h"
+
+#include <cstddef>
 #include <string>
-#include <vector>
+#include <string_view>
+
+#define FTX_MAX_TOKENS      8
+#define FTX_CALLSIGN_SIZE   sizeof(((ftx_msg_meta_t *)0)->call_de)
+#define FTX_GRID_SIZE       sizeof(((ftx_msg_meta_t *)0)->grid)
+
+/// @brief Words of a message, views on its text. Extra words are dropped
+class FTxTokens {
+  public:
+    size_t           size() const { return _size; }
+    std::string_view operator[](size_t i) const { return _tokens[i]; }
+    void             push_back(std::string_view token);
+
+  private:
+    std::string_view _tokens[FTX_MAX_TOKENS];
+    size_t           _size = 0;
+};
 
-std::vector<std::string> split_text(std::string text);
+FTxTokens split_text(std::string_view text);
 
 class Candidate {
   public:
-    Candidate(std::string remote_callsign);
-    void set_grid(std::string grid);
+    Candidate() = default;
+    Candidate(std::string_view remote_callsign, call_id_t remote_id);
+    void set_grid(std::string_view grid);
     void set_report(int report);
     void set_msg_type(ftx_msg_type_t msg_type);
     void set_local_snr(int snr);
     void set_rcvd_snr(int snr);
-    bool match_callsign(std::string callsign);
+    /// @brief Compares IDs, strings are compared only if they were not interned
+    bool match_callsign(std::string_view callsign, call_id_t id) const;
     bool is_finished();
     void save_qso(save_qso_cb_t save_qso_cb);
 
-    std::string get_tx_text(std::string local_callsign, std::string local_qth);
+    /// @brief Make the answer into `text` of ftx_tx_msg_t::msg size
+    void get_tx_text(const std::string &local_callsign, const std::string &local_qth, char *text);
 
   private:
-    std::string    _remote_callsign;
+    char           _remote_callsign[FTX_CALLSIGN_SIZE] = "";
+    call_id_t      _remote_id = CALL_ID_NONE;
     int            _local_snr;
     ftx_msg_type_t _last_rx_type;
-    std::string    _grid;
+    char           _grid[FTX_GRID_SIZE] = "";
     int            _rcvd_snr;
     int            _sent_snr;
     bool           _saved=false;
 };
 
+/*
+ * Messages are parsed with views on the text and candidates are kept in a small
+ * pool, so processing of a message does no heap allocation. Callsigns of
+ * messages to us are interned and matched to the candidates by ID
+ */
 class FTxQsoProcessor {
   public:
     FTxQsoProcessor(std::string local_callsign, std::string local_qth, save_qso_cb_t save_qso_cb);
-    ~FTxQsoProcessor();
 
     /// @brief Pass an RXed text, update internal state and meta
     /// @param[in] text received text
     /// @param[in] snr local snr value
     /// @param[out] meta meta information to fill
     /// @param[out] tx_msg TX message to fill
-    void add_rx_text(std::string text, const int snr, ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg);
-    void process_grid(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr, ftx_tx_msg_t &tx_msg);
-    void process_report(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr, ftx_tx_msg_t &tx_msg);
-    void process_r_report(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr, ftx_tx_msg_t &tx_msg);
-    void process_rr73(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr, ftx_tx_msg_t &tx_msg);
-    void process_73(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr, ftx_tx_msg_t &tx_msg);
-    void process_cq(ftx_msg_meta_t *meta, std::vector<std::string> &tokens, const int snr);
+    void add_rx_text(std::string_view text, const int snr, ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg);
+    void process_grid(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr, ftx_tx_msg_t &tx_msg);
+    void process_report(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr, ftx_tx_msg_t &tx_msg);
+    void process_r_report(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr, ftx_tx_msg_t &tx_msg);
+    void process_rr73(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr, ftx_tx_msg_t &tx_msg);
+    void process_73(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr, ftx_tx_msg_t &tx_msg);
+    void process_cq(ftx_msg_meta_t *meta, const FTxTokens &tokens, const int snr);
     void set_auto(bool);
+    void set_dupe_cb(is_dupe_cb_t is_dupe_cb);
     void start_new_slot();
     void reset();
     void start_qso(ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg);
@@ -93,13 +124,17 @@ class FTxQsoProcessor {
     std::string   _local_callsign;
     std::string   _local_qth;
     save_qso_cb_t _save_qso_cb;
+    is_dupe_cb_t  _is_dupe_cb = NULL;
 
     ftx_msg_type_t _last_rx_type;
+    Candidate     _pool[2];     // Storage of the current and the next ones
     Candidate     *_next_candidate = NULL;
     Candidate     *_cur_candidate = NULL;
 
-    Candidate **get_candidate_to_update(std::string call_de);
-    Candidate  *get_or_create_cur_candidate(std::string remote_callsign);
+    Candidate *new_candidate(std::string_view remote_callsign, call_id_t remote_id);
+    Candidate **get_candidate_to_update(std::string_view call_de, call_id_t de_id);
+    bool        is_dupe(std::string_view call_de);
+    Candidate  *get_or_create_cur_candidate(std::string_view remote_callsign);
 };
 #else
 typedef struct FTxQsoProcessor FTxQsoProcessor;
@@ -114,6 +149,7 @@ extern void             ftx_qso_processor_delete(FTxQsoProcessor *p);
 extern void ftx_qso_processor_add_rx_text(FTxQsoProcessor *p, const char *text, const int snr, ftx_msg_meta_t *meta,
                                           ftx_tx_msg_t *tx_msg);
 extern void ftx_qso_processor_set_auto(FTxQsoProcessor *p, bool);
+extern void ftx_qso_processor_set_dupe_cb(FTxQsoProcessor *p, is_dupe_cb_t is_dupe_cb);
 extern void ftx_qso_processor_start_new_slot(FTxQsoProcessor *p);
 extern void ftx_qso_processor_reset(FTxQsoProcessor *p);
 extern void ftx_qso_processor_start_qso(FTxQsoProcessor *p, ftx_msg_meta_t *meta, ftx_tx_msg_t *tx_msg);
@@ -10,17 +10,24 @@
 
 #include "../util.h"
 #include "gfsk.h"
+#include "callsign_hash.h"
+#include "../mem_stats.h"
+#include "../dsp/fft.h"
 
 #include "lvgl/lvgl.h"
 #include <ft8lib/constants.h>
 #include <ft8lib/decode.h>
 #include <ft8lib/encode.h>
-#include <ft8lib/hashtable.h>
 #include <ft8lib/message.h>
 #include <liquid/liquid.h>
+#include <complex.h>
 #include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #define MAX_CANDIDATES 200
 #define MAX_DECODED_MESSAGES 50
@@ -28,186 +35,519 @@
 #define TIME_OSR 4               // Time oversampling rate (symbol subdivision)
 #define FREQ_OSR 2               // Frequency oversampling rate (bin subdivision)
 #define MIN_SCORE 10             // Minimum score for candidate
-#define DECODE_BLOCK_STRIDE 2    // Try to decode each N block
-#define EARLY_LDPC_ITERATIONS 25 // LDPC iterations on early decoding
-
-static float complex *time_buf;
-static float complex *freq_buf;
-static fftplan        fft;
-static windowcf       frame_window;
-static complex float *rx_window = NULL;
-
-static float symbol_period;
-static int   block_size;
-static int   subblock_size;
-static int   nfft;
-
-static uint8_t n_tones;  // Number of tones for generate message and check minimal length for rx
-static uint8_t sync_num; // Length of sync
-
-static int             num_candidates;
-static ftx_candidate_t candidate_list[MAX_CANDIDATES];
-static ftx_message_t   decoded[MAX_DECODED_MESSAGES];
-static ftx_message_t  *decoded_hashtable[MAX_DECODED_MESSAGES];
-static ftx_waterfall_t wf;
-static int             find_candidates_at;
-
-static void decode_messages(const ftx_waterfall_t *wf, int *num_candidates, ftx_candidate_t *candidate_list,
-                            ftx_message_t *decoded, ftx_message_t **decoded_hashtable, int ldpc_iterations,
-                            decoded_msg_cb msg_cb, void *user_data);
+#define DECODE_BLOCK_STRIDE 2    // Initial early decoding stride, blocks
+#define MAX_DECODE_BLOCK_STRIDE 8 // Longest early decoding stride, blocks
+#define EARLY_LDPC_ITERATIONS 25 // Max LDPC iterations on early decoding
+#define MIN_LDPC_ITERATIONS 10   // LDPC iterations are cut to it, then candidates are dropped
+#define EARLY_LOAD 0.5f          // Part of the block period, that early decoding may take
+#define COST_EMA 0.25f           // Weight of the last decode in the cost estimation
+#define DECODE_THREADS 2         // Threads for LDPC decoding, with the caller. 1 - serial decoding
+#define PARALLEL_MIN_CANDIDATES 4 // Decode fewer candidates serially
+#define MAX_DECODE_PASSES 3      // Of the last decoding, with subtraction of the decoded signals
+#define MAX_TRIED (MAX_CANDIDATES * MAX_DECODE_PASSES)
+#define MIN_PASS_CANDIDATES 10   // Another pass needs time for the search and this many candidates
+#define CALLSIGN_HASH_FILE "/mnt/ft8_callsigns"
+
+/*
+ * Decoder of one protocol and passband. Several decoders may take the same
+ * audio, decoding threads and the callsign hash are shared
+ */
+struct ftx_decoder_t {
+    float           symbol_period;
+    int             block_size;
+    int             subblock_size;
+    int             nfft;
+    int             first_bin;          // Passband begin, wf bins are counted from it
+    uint8_t         n_tones;            // Number of tones for generate message and check minimal length for rx
+    uint8_t         sync_num;           // Length of sync
+
+    float complex   *time_buf;
+    float complex   *freq_buf;
+    fft_plan_t      *fft;
+    windowcf        frame_window;
+    float complex   *rx_window;
+
+    int             num_candidates;
+    ftx_candidate_t candidate_list[MAX_CANDIDATES];
+    ftx_message_t   decoded[MAX_DECODED_MESSAGES];
+    ftx_message_t   *decoded_hashtable[MAX_DECODED_MESSAGES];
+    ftx_waterfall_t wf;
+    int             find_candidates_at;
+
+    float           decode_budget_ms;
+    float           cand_iter_cost_us;  // 0 - not measured yet
+    float           search_cost_ms;     // Of ftx_find_candidates(), 0 - not measured yet
+    uint8_t         decode_passes;
+    int             max_candidates;     // Of a search
+    int             ldpc_iterations;    // Max of a candidate
+
+    /* Of the slot, for the passes after the first one */
+    int             num_tried;
+    ftx_candidate_t tried[MAX_TRIED];
+    int             num_found;
+    int             num_subtracted;
+    ftx_candidate_t found_cand[MAX_DECODED_MESSAGES];
+    ftx_message_t   found_msg[MAX_DECODED_MESSAGES];
+    int             early_stride;
+    int             early_block;        // Of the last early decoding
+    int             view_block;         // First block, not shown by ftx_decoder_get_wf_row()
+};
+
+static int              worker_sample_rate;
+static ftx_decoder_t    *primary;       // Of ftx_worker_*() and TX
+static gfsk_shape_t     *tx_shape;      // Of the protocol, created on TX with its sample rate
+
+/*
+ * Parallel decoding. Candidates are taken by the caller and the helpers from a
+ * shared atomic index, each result goes to the slot of its candidate. The
+ * caller merges results in candidate order, so dedup and callbacks stay the
+ * same as with serial decoding.
+ *
+ * No mutexes: the decode thread is cancelled asynchronously, helpers must not
+ * wait for a lock, which it may hold.
+ */
+typedef struct {
+    ftx_message_t       message;
+    ftx_decode_status_t status;
+    bool                ok;
+} decode_result_t;
+
+static decode_result_t          results[MAX_CANDIDATES];
+static int                      job_idx[MAX_CANDIDATES];    // Candidates to decode
+static int                      job_size;
+static int                      job_ldpc_iterations;
+static const ftx_waterfall_t    *job_wf;
+static const ftx_candidate_t    *job_candidates;
+static atomic_int               job_next;
+
+/*
+ * Decode scheduling. Cost of decoding is measured per candidate and LDPC
+ * iteration. The final decode is fitted into decode_budget_ms, early decodes
+ * into a part of the time left to the slot end, and the early decoding stride
+ * follows the cost of the last early decode, so that it takes about EARLY_LOAD
+ * of the block period. Candidates beyond the budget are dropped by the lowest
+ * score.
+ *
+ * The last decoding may take more passes within its budget: the signals decoded
+ * in the slot are subtracted from the waterfall, the residual is searched for
+ * candidates again, and the new ones are decoded. Weaker signals under the
+ * strong ones come up this way.
+ */
+
+static pthread_t                helpers[DECODE_THREADS];
+static sem_t                    job_sem;
+static sem_t                    done_sem;
+static atomic_bool              helpers_stop;
+
+static void decode_messages(ftx_decoder_t *dec, int ldpc_iterations, float budget_ms, decoded_msg_cb msg_cb,
+                            void *user_data);
 
 static int get_message_snr(const ftx_waterfall_t *wf, const ftx_candidate_t *candidate, ftx_message_t *msg);
+static void find_candidates(ftx_decoder_t *dec);
+static void decode_last(ftx_decoder_t *dec, decoded_msg_cb msg_cb, void *user_data);
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static float block_ms(const ftx_decoder_t *dec) {
+    return dec->symbol_period * 1000.0f;
+}
+
+/**
+ * Fit job_size candidates into the budget: cut LDPC iterations first, then drop the
+ * last candidates. Returns LDPC iterations
+ */
+static int fit_budget(const ftx_decoder_t *dec, float budget_ms, int ldpc_iterations) {
+    const float cand_iter_cost_us = dec->cand_iter_cost_us;
+
+    if (cand_iter_cost_us <= 0.0f || job_size == 0) {
+        return ldpc_iterations;
+    }
+
+    float iterations = budget_ms * 1000.0f / (cand_iter_cost_us * job_size);
+
+    if (iterations >= ldpc_iterations) {
+        return ldpc_iterations;
+    }
+    if (iterations >= MIN_LDPC_ITERATIONS) {
+        return (int)iterations;
+    }
+
+    int max_size = (int)(budget_ms * 1000.0f / (cand_iter_cost_us * MIN_LDPC_ITERATIONS));
+
+    if (max_size < job_size) {
+        LV_LOG_INFO("Decode budget %.0f ms: %d of %d candidates", budget_ms, max_size, job_size);
+        job_size = max_size;
+    }
+    return MIN_LDPC_ITERATIONS;
+}
+
+static void update_cost(ftx_decoder_t *dec, uint64_t elapsed_us, int ldpc_iterations) {
+    if (job_size == 0) {
+        return;
+    }
+
+    float cost = (float)elapsed_us / (job_size * ldpc_iterations);
+
+    if (dec->cand_iter_cost_us <= 0.0f) {
+        dec->cand_iter_cost_us = cost;
+    } else {
+        dec->cand_iter_cost_us += (cost - dec->cand_iter_cost_us) * COST_EMA;
+    }
+}
+
+static void decode_job() {
+    int i;
+
+    while ((i = atomic_fetch_add(&job_next, 1)) < job_size) {
+        decode_result_t *res = &results[i];
+
+        res->ok = ftx_decode_candidate(job_wf, &job_candidates[job_idx[i]], job_ldpc_iterations, &res->message,
+                                       &res->status);
+    }
+}
+
+static void * helper_thread(void *arg) {
+    set_thread_name("ft8_decode");
+
+    while (true) {
+        sem_wait(&job_sem);
+
+        if (atomic_load(&helpers_stop)) {
+            break;
+        }
+        decode_job();
+        sem_post(&done_sem);
+    }
+    return NULL;
+}
+
+static void helpers_start() {
+    sem_init(&job_sem, 0, 0);
+    sem_init(&done_sem, 0, 0);
+    atomic_store(&helpers_stop, false);
+
+    for (int i = 0; i < DECODE_THREADS - 1; i++) {
+        pthread_create(&helpers[i], NULL, helper_thread, NULL);
+    }
+}
+
+static void helpers_stop_and_join() {
+    atomic_store(&helpers_stop, true);
+
+    for (int i = 0; i < DECODE_THREADS - 1; i++) {
+        sem_post(&job_sem);
+    }
+    for (int i = 0; i < DECODE_THREADS - 1; i++) {
+        pthread_join(helpers[i], NULL);
+    }
+    sem_destroy(&job_sem);
+    sem_destroy(&done_sem);
+}
+
+/**
+ * Decode job_size candidates of job_idx into results. Thread safe ftx_decode_candidate()
+ * is required, it only reads the waterfall
+ */
+static void decode_candidates(const ftx_waterfall_t *wf, const ftx_candidate_t *candidate_list, int ldpc_iterations) {
+    job_wf = wf;
+    job_candidates = candidate_list;
+    job_ldpc_iterations = ldpc_iterations;
+    atomic_store(&job_next, 0);
+
+    int n_helpers = (job_size >= PARALLEL_MIN_CANDIDATES) ? DECODE_THREADS - 1 : 0;
+
+    for (int i = 0; i < n_helpers; i++) {
+        sem_post(&job_sem);
+    }
+    decode_job();
+
+    for (int i = 0; i < n_helpers; i++) {
+        sem_wait(&done_sem);
+    }
+}
 
 /**
  * Init worker
  */
-void ftx_worker_init(int sample_rate, ftx_protocol_t protocol) {
-    float slot_period;
+void ftx_worker_init(int sample_rate, ftx_protocol_t protocol, int freq_low, int freq_high) {
+    worker_sample_rate = sample_rate;
+    callsign_hash_load(CALLSIGN_HASH_FILE);
+    helpers_start();
+    primary = ftx_decoder_create(protocol, freq_low, freq_high);
+}
+
+/**
+ * Cleanup worker
+ */
+void ftx_worker_free() {
+    helpers_stop_and_join();
+    ftx_decoder_free(primary);
+    primary = NULL;
+    gfsk_shape_destroy(tx_shape);
+    tx_shape = NULL;
+    callsign_hash_save();
+}
+
+/**
+ * Reset worker
+ */
+void ftx_worker_reset() {
+    ftx_decoder_reset(primary);
+}
+
+ftx_decoder_t * ftx_decoder_create(ftx_protocol_t protocol, int freq_low, int freq_high) {
+    ftx_decoder_t   *dec = calloc(1, sizeof(ftx_decoder_t));
+    float           slot_period;
+
+    if (!dec) {
+        LV_LOG_ERROR("Can't allocate decoder");
+        return NULL;
+    }
 
     switch (protocol) {
     case FTX_PROTOCOL_FT8:
         slot_period = FT8_SLOT_TIME;
-        symbol_period = FT8_SYMBOL_PERIOD;
-        n_tones = FT8_NN;
-        sync_num = FT8_NUM_SYNC;
+        dec->symbol_period = FT8_SYMBOL_PERIOD;
+        dec->n_tones = FT8_NN;
+        dec->sync_num = FT8_NUM_SYNC;
         break;
     case FTX_PROTOCOL_FT4:
         slot_period = FT4_SLOT_TIME;
-        symbol_period = FT4_SYMBOL_PERIOD;
-        n_tones = FT4_NN;
-        sync_num = FT4_NUM_SYNC;
+        dec->symbol_period = FT4_SYMBOL_PERIOD;
+        dec->n_tones = FT4_NN;
+        dec->sync_num = FT4_NUM_SYNC;
         break;
     default:
         LV_LOG_ERROR("Unsupported protocol: %lu", protocol);
+        free(dec);
+        return NULL;
     }
-    int num_samples = slot_period * sample_rate;
-
-    hashtable_init(256);
 
     /* FT8 decoder */
 
-    block_size = (int)(sample_rate * symbol_period); // samples corresponding to one FSK symbol
-    subblock_size = block_size / TIME_OSR;
+    const int   sample_rate = worker_sample_rate;
+    const float symbol_period = dec->symbol_period;
+
+    dec->block_size = (int)(sample_rate * symbol_period); // samples corresponding to one FSK symbol
+    dec->subblock_size = dec->block_size / TIME_OSR;
 
     const int max_blocks = (int)(slot_period / symbol_period);
-    // TODO: skip bins outside filter
-    const int num_bins = sample_rate * symbol_period / 2;
+    const int all_bins = sample_rate * symbol_period / 2;
+    int       first_bin = limit(floorf(freq_low * symbol_period), 0, all_bins);
+    int       last_bin = limit(ceilf(freq_high * symbol_period), 0, all_bins);
+
+    // At least the tones of one signal
+    if (last_bin - first_bin < (protocol == FTX_PROTOCOL_FT4 ? 4 : 8)) {
+        LV_LOG_WARN("Passband %i-%i Hz is too narrow, using all bins", freq_low, freq_high);
+        first_bin = 0;
+        last_bin = all_bins;
+    }
+    dec->first_bin = first_bin;
+
+    const int num_bins = last_bin - first_bin;
 
     size_t mag_size = max_blocks * TIME_OSR * FREQ_OSR * num_bins * sizeof(WF_ELEM_T);
 
-    wf.max_blocks = max_blocks;
-    wf.num_bins = num_bins;
-    wf.time_osr = TIME_OSR;
-    wf.freq_osr = FREQ_OSR;
-    wf.block_stride = TIME_OSR * FREQ_OSR * num_bins;
-    wf.mag = (uint8_t *)malloc(mag_size);
-    wf.protocol = protocol;
+    dec->wf.max_blocks = max_blocks;
+    dec->wf.num_bins = num_bins;
+    dec->wf.time_osr = TIME_OSR;
+    dec->wf.freq_osr = FREQ_OSR;
+    dec->wf.block_stride = TIME_OSR * FREQ_OSR * num_bins;
+    dec->wf.mag = (uint8_t *)mem_alloc(MEM_FT8, mag_size);
+    dec->wf.protocol = protocol;
 
-    find_candidates_at = n_tones - sync_num;
+    dec->find_candidates_at = dec->n_tones - dec->sync_num;
 
     /* FT8 DSP */
-    nfft = block_size * FREQ_OSR;
-    float fft_norm = 2.0f / nfft;
-    time_buf = (float complex *)malloc(nfft * sizeof(float complex));
-    freq_buf = (float complex *)malloc(nfft * sizeof(float complex));
-    fft = fft_create_plan(nfft, time_buf, freq_buf, LIQUID_FFT_FORWARD, 0);
-    frame_window = windowcf_create(nfft);
-
-    rx_window = malloc(nfft * sizeof(complex float));
+    const int nfft = dec->block_size * FREQ_OSR;
+
+    dec->nfft = nfft;
+    dec->time_buf = (float complex *)mem_alloc(MEM_FT8, nfft * sizeof(float complex));
+    dec->freq_buf = (float complex *)mem_alloc(MEM_FT8, nfft * sizeof(float complex));
+    dec->fft = fft_plan_get(nfft, FFT_DIR_FORWARD);
+    dec->frame_window = windowcf_create(nfft);
+
+    dec->rx_window = mem_alloc(MEM_FT8, nfft * sizeof(complex float));
     float window_norm = 2.0f / nfft;
 
     for (uint16_t i = 0; i < nfft; i++) {
-        rx_window[i] = liquid_hann(i, nfft) * window_norm;
+        dec->rx_window[i] = liquid_hann(i, nfft) * window_norm;
     }
 
-    ftx_worker_reset();
+    dec->decode_budget_ms = 1000.0f;
+    dec->decode_passes = 1;
+    dec->max_candidates = MAX_CANDIDATES;
+    dec->ldpc_iterations = LDPC_ITERATIONS;
+    ftx_decoder_reset(dec);
+    return dec;
 }
 
-/**
- * Cleanup worker
- */
-void ftx_worker_free() {
-    free(wf.mag);
-    windowcf_destroy(frame_window);
+void ftx_decoder_free(ftx_decoder_t *dec) {
+    if (!dec) {
+        return;
+    }
+    mem_free(MEM_FT8, dec->wf.mag);
+    windowcf_destroy(dec->frame_window);
 
-    free(time_buf);
-    free(freq_buf);
-    fft_destroy_plan(fft);
+    mem_free(MEM_FT8, dec->time_buf);
+    mem_free(MEM_FT8, dec->freq_buf);
+    fft_plan_put(dec->fft);
 
-    free(rx_window);
-    hashtable_delete();
+    mem_free(MEM_FT8, dec->rx_window);
+    free(dec);
 }
 
-/**
- * Reset worker
- */
-void ftx_worker_reset() {
-    hashtable_cleanup(10);
-    wf.num_blocks = 0;
-    num_candidates = 0;
+void ftx_decoder_reset(ftx_decoder_t *dec) {
+    dec->wf.num_blocks = 0;
+    dec->num_candidates = 0;
+    dec->early_stride = DECODE_BLOCK_STRIDE;
+    dec->early_block = 0;
+    dec->view_block = 0;
+    dec->num_tried = 0;
+    dec->num_found = 0;
+    dec->num_subtracted = 0;
     // Initialize hash table pointers
     for (int i = 0; i < MAX_DECODED_MESSAGES; ++i) {
-        decoded_hashtable[i] = NULL;
+        dec->decoded_hashtable[i] = NULL;
     }
 }
 
-bool ftx_worker_generate_tx_samples(const char *text, const uint16_t signal_freq, const uint32_t sample_rate,
-                                    int16_t **samples, uint32_t *n_samples) {
+static bool encode_tones(const char *text, uint8_t *tones) {
     ftx_message_t    msg;
-    ftx_message_rc_t rc = ftx_message_encode(&msg, &hash_if, text);
+    ftx_message_rc_t rc = ftx_message_encode(&msg, &callsign_hash_if, text);
 
     if (rc != FTX_MESSAGE_RC_OK) {
         LV_LOG_ERROR("Cannot parse message %i", rc);
         return false;
     }
 
-    uint8_t tones[n_tones];
-    float   symbol_bt;
-
-    switch (wf.protocol) {
+    switch (primary->wf.protocol) {
     case FTX_PROTOCOL_FT8:
         ft8_encode(msg.payload, tones);
-        symbol_bt = FT8_SYMBOL_BT;
         break;
     case FTX_PROTOCOL_FT4:
         ft4_encode(msg.payload, tones);
-        symbol_bt = FT4_SYMBOL_BT;
         break;
     }
+    return true;
+}
+
+static gfsk_shape_t *get_tx_shape(uint32_t sample_rate) {
+    float symbol_bt = (primary->wf.protocol == FTX_PROTOCOL_FT4) ? FT4_SYMBOL_BT : FT8_SYMBOL_BT;
+    float symbol_period = primary->symbol_period;
 
-    *samples = gfsk_synth(tones, n_tones, signal_freq, symbol_bt, symbol_period, sample_rate, n_samples);
+    if (!tx_shape || tx_shape->sample_rate != sample_rate || tx_shape->symbol_period != symbol_period) {
+        gfsk_shape_destroy(tx_shape);
+        tx_shape = gfsk_shape_create(symbol_bt, symbol_period, 1.0f, sample_rate);
+    }
+    return tx_shape;
+}
+
+bool ftx_worker_generate_tx_samples(const char *text, const uint16_t signal_freq, const uint32_t sample_rate,
+                                    int16_t **samples, uint32_t *n_samples) {
+    uint8_t n_tones = primary->n_tones;
+    uint8_t tones[n_tones];
+
+    if (!encode_tones(text, tones)) {
+        return false;
+    }
+    gfsk_shape_t *shape = get_tx_shape(sample_rate);
+
+    *n_samples = gfsk_shape_size(shape, n_tones);
+    *samples = malloc(sizeof(int16_t) * *n_samples);
+    gfsk_shape_synth(shape, tones, n_tones, signal_freq, *samples);
     return true;
 }
 
-void ftx_worker_put_rx_samples(float complex *samples, uint32_t n_samples) {
-    if (wf.num_blocks >= wf.max_blocks) {
+uint32_t ftx_worker_get_tx_size(const uint32_t sample_rate) {
+    return gfsk_synth_size(primary->n_tones, primary->symbol_period, sample_rate);
+}
+
+uint32_t ftx_worker_render_tx_samples(const char *text, const uint16_t signal_freq, const uint32_t sample_rate,
+                                      int16_t *samples, uint32_t max_samples) {
+    uint32_t n_samples = ftx_worker_get_tx_size(sample_rate);
+    uint8_t  n_tones = primary->n_tones;
+    uint8_t  tones[n_tones];
+
+    if (n_samples > max_samples) {
+        LV_LOG_ERROR("TX buffer is too small: %u < %u", max_samples, n_samples);
+        return 0;
+    }
+    if (!encode_tones(text, tones)) {
+        return 0;
+    }
+    gfsk_shape_synth(get_tx_shape(sample_rate), tones, n_tones, signal_freq, samples);
+    return n_samples;
+}
+
+void ftx_worker_put_rx_samples(cfloat *samples, uint32_t n_samples) {
+    ftx_decoder_put_rx_samples(primary, samples, n_samples);
+}
+
+void ftx_worker_decode(decoded_msg_cb msg_cb, bool last, void *user_data) {
+    ftx_decoder_decode(primary, msg_cb, last, user_data);
+}
+
+void ftx_worker_set_decode_budget(float budget_ms) {
+    ftx_decoder_set_decode_budget(primary, budget_ms);
+}
+
+void ftx_worker_set_decode_passes(uint8_t passes) {
+    ftx_decoder_set_decode_passes(primary, passes);
+}
+
+void ftx_worker_set_effort(int max_candidates, int ldpc_iterations) {
+    ftx_decoder_set_effort(primary, max_candidates, ldpc_iterations);
+}
+
+int ftx_worker_get_block_size() {
+    return primary->block_size;
+}
+
+bool ftx_worker_is_full() {
+    return ftx_decoder_is_full(primary);
+}
+
+bool ftx_worker_get_wf_row(float *row, uint16_t width) {
+    return ftx_decoder_get_wf_row(primary, row, width);
+}
+
+void ftx_decoder_put_rx_samples(ftx_decoder_t *dec, cfloat *samples, uint32_t n_samples) {
+    ftx_waterfall_t *wf = &dec->wf;
+
+    if (wf->num_blocks >= wf->max_blocks) {
         LV_LOG_ERROR("FT8 wf is full");
         return;
     }
 
-    if (n_samples != block_size) {
-        LV_LOG_ERROR("n_samples(%llu) is not equal expected block size(%llu)", n_samples, block_size);
+    if (n_samples != dec->block_size) {
+        LV_LOG_ERROR("n_samples(%llu) is not equal expected block size(%llu)", n_samples, dec->block_size);
         return;
     }
 
     complex float *frame_ptr;
-    int            offset = wf.num_blocks * wf.block_stride;
+    int            offset = wf->num_blocks * wf->block_stride;
     int            frame_pos = 0;
 
-    for (int time_sub = 0; time_sub < wf.time_osr; time_sub++) {
-        windowcf_write(frame_window, &samples[frame_pos], subblock_size);
-        frame_pos += subblock_size;
+    for (int time_sub = 0; time_sub < wf->time_osr; time_sub++) {
+        windowcf_write(dec->frame_window, &samples[frame_pos], dec->subblock_size);
+        frame_pos += dec->subblock_size;
 
-        windowcf_read(frame_window, &frame_ptr);
+        windowcf_read(dec->frame_window, &frame_ptr);
 
-        liquid_vectorcf_mul(rx_window, frame_ptr, nfft, time_buf);
+        liquid_vectorcf_mul(dec->rx_window, frame_ptr, dec->nfft, dec->time_buf);
 
-        fft_execute(fft);
+        fft_plan_execute(dec->fft, dec->time_buf, dec->freq_buf);
 
-        for (int freq_sub = 0; freq_sub < wf.freq_osr; freq_sub++)
-            for (int bin = 0; bin < wf.num_bins; bin++) {
-                int           src_bin = (bin * wf.freq_osr) + freq_sub;
-                complex float freq = freq_buf[src_bin];
+        for (int freq_sub = 0; freq_sub < wf->freq_osr; freq_sub++)
+            for (int bin = 0; bin < wf->num_bins; bin++) {
+                int           src_bin = ((dec->first_bin + bin) * wf->freq_osr) + freq_sub;
+                complex float freq = dec->freq_buf[src_bin];
                 float         mag2 = crealf(freq * conjf(freq));
                 float         db = 10.0f * log10f(mag2);
                 int           scaled = (int16_t)(db * 2.0f + 240.0f);
@@ -218,57 +558,139 @@ void ftx_worker_put_rx_samples(float complex *samples, uint32_t n_samples) {
                     scaled = 255;
                 }
 
-                wf.mag[offset] = scaled;
+                wf->mag[offset] = scaled;
                 offset++;
             }
     }
-    wf.num_blocks++;
+    wf->num_blocks++;
 }
 
-void ftx_worker_decode(decoded_msg_cb msg_cb, bool last, void *user_data) {
-    if (wf.num_blocks >= find_candidates_at) {
-        if (num_candidates == 0) {
-            num_candidates = ftx_find_candidates(&wf, MAX_CANDIDATES, candidate_list, MIN_SCORE);
+void ftx_decoder_decode(ftx_decoder_t *dec, decoded_msg_cb msg_cb, bool last, void *user_data) {
+    ftx_waterfall_t *wf = &dec->wf;
+
+    if (wf->num_blocks >= dec->find_candidates_at) {
+        if (dec->num_candidates == 0) {
+            find_candidates(dec);
+            dec->early_block = wf->num_blocks;
         } else if (last) {
-            // Last decoding
-            decode_messages(&wf, &num_candidates, candidate_list, decoded, decoded_hashtable, LDPC_ITERATIONS, msg_cb,
-                            user_data);
-        } else if (wf.num_blocks % DECODE_BLOCK_STRIDE == 0) {
-            // incremental decoding
-            decode_messages(&wf, &num_candidates, candidate_list, decoded, decoded_hashtable, EARLY_LDPC_ITERATIONS,
-                            msg_cb, user_data);
+            decode_last(dec, msg_cb, user_data);
+        } else if (wf->num_blocks - dec->early_block >= dec->early_stride) {
+            // incremental decoding, don't delay the last one
+            float    left_ms = (wf->max_blocks - wf->num_blocks) * block_ms(dec);
+            float    budget_ms = fminf(MAX_DECODE_BLOCK_STRIDE * block_ms(dec), left_ms) * EARLY_LOAD;
+            uint64_t start = now_us();
+
+            decode_messages(dec, LV_MIN(EARLY_LDPC_ITERATIONS, dec->ldpc_iterations), budget_ms, msg_cb, user_data);
+
+            float elapsed_ms = (now_us() - start) / 1000.0f;
+
+            dec->early_stride = limit(ceilf(elapsed_ms / (block_ms(dec) * EARLY_LOAD)), 1, MAX_DECODE_BLOCK_STRIDE);
+            dec->early_block = wf->num_blocks;
         }
     }
 }
 
-int ftx_worker_get_block_size() {
-    return block_size;
+void ftx_decoder_set_decode_budget(ftx_decoder_t *dec, float budget_ms) {
+    dec->decode_budget_ms = budget_ms;
 }
 
-bool ftx_worker_is_full() {
-    return wf.max_blocks <= wf.num_blocks;
+void ftx_decoder_set_decode_passes(ftx_decoder_t *dec, uint8_t passes) {
+    dec->decode_passes = limit(passes, 1, MAX_DECODE_PASSES);
+}
+
+void ftx_decoder_set_effort(ftx_decoder_t *dec, int max_candidates, int ldpc_iterations) {
+    dec->max_candidates = max_candidates > 0 ? limit(max_candidates, 1, MAX_CANDIDATES) : MAX_CANDIDATES;
+    dec->ldpc_iterations = ldpc_iterations > 0 ?
+        limit(ldpc_iterations, MIN_LDPC_ITERATIONS, LDPC_ITERATIONS) : LDPC_ITERATIONS;
+}
+
+int ftx_decoder_get_block_size(const ftx_decoder_t *dec) {
+    return dec->block_size;
 }
 
-static void decode_messages(const ftx_waterfall_t *wf, int *num_candidates, ftx_candidate_t *candidate_list,
-                            ftx_message_t *decoded, ftx_message_t **decoded_hashtable, int ldpc_iterations,
-                            decoded_msg_cb msg_cb, void *user_data) {
+bool ftx_decoder_is_full(const ftx_decoder_t *dec) {
+    return dec->wf.max_blocks <= dec->wf.num_blocks;
+}
+
+bool ftx_decoder_get_wf_row(ftx_decoder_t *dec, float *row, uint16_t width) {
+    const ftx_waterfall_t *wf = &dec->wf;
+
+    if (dec->view_block >= wf->num_blocks || width == 0) {
+        return false;
+    }
+
+    /* Fine bins: bin * freq_osr + freq_sub, stored as freq_sub * num_bins + bin */
+    const int   num_fine = wf->num_bins * wf->freq_osr;
+    const int   time_stride = wf->freq_osr * wf->num_bins;
+
+    for (uint16_t x = 0; x < width; x++) {
+        int     from = x * num_fine / width;
+        int     to = (x + 1) * num_fine / width;
+        uint8_t max = 0;
+
+        if (to <= from) {
+            to = from + 1;
+        }
+        for (int block = dec->view_block; block < wf->num_blocks; block++) {
+            const uint8_t *mag = &wf->mag[block * wf->block_stride];
+
+            for (int time_sub = 0; time_sub < wf->time_osr; time_sub++, mag += time_stride) {
+                for (int fine = from; fine < to; fine++) {
+                    uint8_t v = mag[(fine % wf->freq_osr) * wf->num_bins + fine / wf->freq_osr];
+
+                    if (v > max) {
+                        max = v;
+                    }
+                }
+            }
+        }
+        // Inverse of the scaling in ftx_decoder_put_rx_samples()
+        row[x] = (max - 240.0f) * 0.5f;
+    }
+    dec->view_block = wf->num_blocks;
+    return true;
+}
+
+static void decode_messages(ftx_decoder_t *dec, int ldpc_iterations, float budget_ms, decoded_msg_cb msg_cb,
+                            void *user_data) {
+    const ftx_waterfall_t *wf = &dec->wf;
+    ftx_candidate_t       *candidate_list = dec->candidate_list;
+    ftx_message_t         *decoded = dec->decoded;
+    ftx_message_t         **decoded_hashtable = dec->decoded_hashtable;
+    const float           symbol_period = dec->symbol_period;
+
     // Go over candidates and attempt to decode messages
 
-    int to_delete_idx[*num_candidates];
-    int to_delete_size = 0;
+    job_size = 0;
 
-    for (int idx = 0; idx < *num_candidates; ++idx) {
+    for (int idx = 0; idx < dec->num_candidates; ++idx) {
         const ftx_candidate_t *cand = &candidate_list[idx];
 
         // Skip candidates, that are not fully received
-        if ((cand->time_offset + n_tones - sync_num) >= wf->num_blocks) {
+        if ((cand->time_offset + dec->n_tones - dec->sync_num) >= wf->num_blocks) {
             continue;
         }
-        to_delete_idx[to_delete_size++] = idx;
+        job_idx[job_size++] = idx;
+    }
+
+    ldpc_iterations = fit_budget(dec, budget_ms, ldpc_iterations);
+
+    uint64_t start = now_us();
+
+    decode_candidates(wf, candidate_list, ldpc_iterations);
+    update_cost(dec, now_us() - start, ldpc_iterations);
+
+    // Merge in candidate order
 
-        ftx_message_t       message;
-        ftx_decode_status_t status;
-        if (!ftx_decode_candidate(wf, cand, ldpc_iterations, &message, &status)) {
+    for (int i = 0; i < job_size; ++i) {
+        const ftx_candidate_t     *cand = &candidate_list[job_idx[i]];
+        ftx_message_t             message = results[i].message;
+        const ftx_decode_status_t status = results[i].status;
+
+        if (dec->num_tried < MAX_TRIED) {
+            dec->tried[dec->num_tried++] = *cand;
+        }
+        if (!results[i].ok) {
             if (status.ldpc_errors > 0) {
                 LV_LOG_INFO("LDPC decode: %d errors", status.ldpc_errors);
             } else if (status.crc_calculated != status.crc_extracted) {
@@ -277,13 +699,14 @@ static void decode_messages(const ftx_waterfall_t *wf, int *num_candidates, ftx_
             continue;
         }
 
-        float freq_hz = (cand->freq_offset + (float)cand->freq_sub / FREQ_OSR) / symbol_period;
+        float freq_hz = (dec->first_bin + cand->freq_offset + (float)cand->freq_sub / FREQ_OSR) / symbol_period;
         float time_sec = (cand->time_offset + (float)cand->time_sub / TIME_OSR) * symbol_period;
 
         LV_LOG_INFO("Checking hash table for %4.1fs / %4.1fHz [%d]...", time_sec, freq_hz, cand->score);
         int  idx_hash = message.hash % MAX_DECODED_MESSAGES;
         bool found_empty_slot = false;
         bool found_duplicate = false;
+        int  probes = 0;
         do {
             if (decoded_hashtable[idx_hash] == NULL) {
                 LV_LOG_INFO("Found an empty slot");
@@ -297,15 +720,21 @@ static void decode_messages(const ftx_waterfall_t *wf, int *num_candidates, ftx_
                 // Move on to check the next entry in hash table
                 idx_hash = (idx_hash + 1) % MAX_DECODED_MESSAGES;
             }
-        } while (!found_empty_slot && !found_duplicate);
+        } while (!found_empty_slot && !found_duplicate && ++probes < MAX_DECODED_MESSAGES);
 
         if (found_empty_slot) {
             // Fill the empty hashtable slot
             memcpy(&decoded[idx_hash], &message, sizeof(message));
             decoded_hashtable[idx_hash] = &decoded[idx_hash];
 
+            if (dec->num_found < MAX_DECODED_MESSAGES) {
+                dec->found_cand[dec->num_found] = *cand;
+                dec->found_msg[dec->num_found] = message;
+                dec->num_found++;
+            }
+
             char             text[FTX_MAX_MESSAGE_LENGTH];
-            ftx_message_rc_t unpack_status = ftx_message_decode(&message, &hash_if, text);
+            ftx_message_rc_t unpack_status = ftx_message_decode(&message, &callsign_hash_if, text);
             if (unpack_status != FTX_MESSAGE_RC_OK) {
                 LV_LOG_INFO("Error [%d] while unpacking!", (int)unpack_status);
             } else {
@@ -315,7 +744,7 @@ static void decode_messages(const ftx_waterfall_t *wf, int *num_candidates, ftx_
         }
     }
     // Remove decoded candidate;
-    ftx_delete_candidates(to_delete_idx, to_delete_size, candidate_list, num_candidates);
+    ftx_delete_candidates(job_idx, job_size, candidate_list, &dec->num_candidates);
 }
 
 static int get_message_snr(const ftx_waterfall_t *wf, const ftx_candidate_t *candidate, ftx_message_t *msg) {
@@ -329,3 +758,146 @@ static int get_message_snr(const ftx_waterfall_t *wf, const ftx_candidate_t *can
     }
     return ftx_get_snr(wf, candidate, tones, n_tones);
 }
+
+static void find_candidates(ftx_decoder_t *dec) {
+    uint64_t start = now_us();
+
+    dec->num_candidates = ftx_find_candidates(&dec->wf, dec->max_candidates, dec->candidate_list, MIN_SCORE);
+
+    float cost = (now_us() - start) / 1000.0f;
+
+    if (dec->search_cost_ms <= 0.0f) {
+        dec->search_cost_ms = cost;
+    } else {
+        dec->search_cost_ms += (cost - dec->search_cost_ms) * COST_EMA;
+    }
+}
+
+/**
+ * Clear the cells of a decoded signal down to its noise, the median of the
+ * other tones at its symbols. Tones are encoded again of the payload, the
+ * neighbour time and freq subdivisions are cleared as well, the window of the
+ * waterfall spreads a tone over them
+ */
+static void subtract_message(ftx_decoder_t *dec, const ftx_candidate_t *cand, ftx_message_t *msg) {
+    ftx_waterfall_t *wf = &dec->wf;
+    const uint8_t   n_tones = dec->n_tones;
+    const int       n_fsk = (wf->protocol == FTX_PROTOCOL_FT4) ? 4 : 8;
+    const int       row = wf->freq_osr * wf->num_bins;  // Cells of a time subdivision
+    const int       rows = wf->num_blocks * wf->time_osr;
+    const int       fine_bins = wf->num_bins * wf->freq_osr;
+    uint8_t         tones[n_tones];
+    uint16_t        hist[256] = { 0 };
+    int             count = 0;
+
+    if (wf->protocol == FTX_PROTOCOL_FT4) {
+        ft4_encode(msg->payload, tones);
+    } else {
+        ft8_encode(msg->payload, tones);
+    }
+
+    for (int k = 0; k < n_tones; k++) {
+        int j = (cand->time_offset + k) * wf->time_osr + cand->time_sub;
+
+        if (j < 0 || j >= rows) {
+            continue;
+        }
+        for (int tone = 0; tone < n_fsk; tone++) {
+            int bin = cand->freq_offset + tone;
+
+            if (tone != tones[k] && bin >= 0 && bin < wf->num_bins) {
+                hist[wf->mag[j * row + cand->freq_sub * wf->num_bins + bin]]++;
+                count++;
+            }
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+
+    uint8_t noise = 0;
+
+    for (int sum = 0; sum + hist[noise] <= count / 2; noise++) {
+        sum += hist[noise];
+    }
+
+    for (int k = 0; k < n_tones; k++) {
+        int j0 = (cand->time_offset + k) * wf->time_osr + cand->time_sub;
+        int f0 = (cand->freq_offset + tones[k]) * wf->freq_osr + cand->freq_sub;
+
+        for (int j = j0 - wf->time_osr / 2; j <= j0 + wf->time_osr / 2; j++) {
+            if (j < 0 || j >= rows) {
+                continue;
+            }
+            for (int f = f0 - 1; f <= f0 + 1; f++) {
+                if (f < 0 || f >= fine_bins) {
+                    continue;
+                }
+
+                uint8_t *cell = &wf->mag[j * row + (f % wf->freq_osr) * wf->num_bins + f / wf->freq_osr];
+
+                if (*cell > noise) {
+                    *cell = noise;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Drop candidates, which were decoded before at the same place
+ */
+static void drop_tried(ftx_decoder_t *dec) {
+    int n = 0;
+
+    for (int i = 0; i < dec->num_candidates; i++) {
+        const ftx_candidate_t *cand = &dec->candidate_list[i];
+        bool                  tried = false;
+
+        for (int t = 0; t < dec->num_tried && !tried; t++) {
+            const ftx_candidate_t *other = &dec->tried[t];
+
+            tried = cand->time_offset == other->time_offset && cand->time_sub == other->time_sub &&
+                    cand->freq_offset == other->freq_offset && cand->freq_sub == other->freq_sub;
+        }
+        if (!tried) {
+            dec->candidate_list[n++] = *cand;
+        }
+    }
+    dec->num_candidates = n;
+}
+
+/**
+ * Last decoding of the slot, more passes while the budget allows another
+ * search and MIN_PASS_CANDIDATES
+ */
+static void decode_last(ftx_decoder_t *dec, decoded_msg_cb msg_cb, void *user_data) {
+    uint64_t start = now_us();
+
+    decode_messages(dec, dec->ldpc_iterations, dec->decode_budget_ms, msg_cb, user_data);
+
+    for (uint8_t pass = 1; pass < dec->decode_passes; pass++) {
+        float left_ms = dec->decode_budget_ms - (now_us() - start) / 1000.0f;
+        float min_ms = dec->search_cost_ms + MIN_PASS_CANDIDATES * MIN_LDPC_ITERATIONS * dec->cand_iter_cost_us / 1000.0f;
+
+        if (dec->num_subtracted == dec->num_found || left_ms < min_ms) {
+            break;
+        }
+        for (; dec->num_subtracted < dec->num_found; dec->num_subtracted++) {
+            subtract_message(dec, &dec->found_cand[dec->num_subtracted], &dec->found_msg[dec->num_subtracted]);
+        }
+
+        int found = dec->num_found;
+
+        find_candidates(dec);
+        drop_tried(dec);
+
+        left_ms = dec->decode_budget_ms - (now_us() - start) / 1000.0f;
+
+        if (dec->num_candidates == 0 || left_ms <= 0.0f) {
+            break;
+        }
+        decode_messages(dec, dec->ldpc_iterations, left_ms, msg_cb, user_data);
+        LV_LOG_INFO("Decode pass %u: %d new messages", pass + 1, dec->num_found - found);
+    }
+}
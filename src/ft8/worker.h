@@ -8,21 +8,27 @@
 
 #pragma once
 
+#include "../helpers.h"
+
 #include <ft8lib/constants.h>
 
-#include <complex.h>
 #include <stdbool.h>
 #include <stdint.h>
 
 /// @brief Callback for decoded message
 typedef void (*decoded_msg_cb)(const char *text, int snr, float freq_hz, float time_sec, void *user_data);
 
-/// @brief Init worker structures
+/// @brief Decoder of one protocol and passband
+typedef struct ftx_decoder_t ftx_decoder_t;
+
+/// @brief Init worker structures and the main decoder. ftx_worker_* functions without
+/// a decoder use it, TX is of its protocol
 /// @param[in] sample_rate Input audio sample rate
 /// @param[in] protocol protocol (FT8/FT4)
-void ftx_worker_init(int sample_rate, ftx_protocol_t protocol);
+/// @param[in] freq_low, freq_high RX passband, Hz. Spectrogram and candidate search are limited to it
+void ftx_worker_init(int sample_rate, ftx_protocol_t protocol, int freq_low, int freq_high);
 
-/// @brief Free internal structures
+/// @brief Free internal structures. Decoders of ftx_decoder_create() are to be freed before
 void ftx_worker_free();
 
 /// @brief Reset state before receiving new time slot
@@ -38,20 +44,96 @@ void ftx_worker_reset();
 bool ftx_worker_generate_tx_samples(const char *text, const uint16_t signal_freq, const uint32_t sample_rate,
                                     int16_t **samples, uint32_t *n_samples);
 
+/// @brief Return count of TX audio samples for the protocol
+/// @param[in] sample_rate output sample rate
+uint32_t ftx_worker_get_tx_size(const uint32_t sample_rate);
+
+/// @brief Generate audio samples for TX into a buffer
+/// @param[in] text message to send
+/// @param[in] signal_freq base signal frequency
+/// @param[in] sample_rate output sample rate
+/// @param[out] samples buffer of `max_samples`, at least ftx_worker_get_tx_size()
+/// @param[in] max_samples size of `samples`
+/// @return count of samples, 0 on error
+uint32_t ftx_worker_render_tx_samples(const char *text, const uint16_t signal_freq, const uint32_t sample_rate,
+                                      int16_t *samples, uint32_t max_samples);
+
 /// @brief Process RX audio samples
 /// @param[in] samples audio samples
 /// @param[in] n_samples count of samples
-void ftx_worker_put_rx_samples(float complex *samples, uint32_t n_samples);
+void ftx_worker_put_rx_samples(cfloat *samples, uint32_t n_samples);
 
-/// @brief Decode messages
+/// @brief Decode messages. Candidates are decoded in parallel, messages are delivered
+/// in candidate order from the calling thread
 /// @param[in] msg_cb callback for decoded messages
 /// @param[in] last flag to perform more heavy search of messages
 /// @param[in] user_data pointer to any information to pass to `msg_cb`
 void ftx_worker_decode(decoded_msg_cb msg_cb, bool last, void *user_data);
 
+/// @brief Set time for the last decoding of a slot. Early decodes are scheduled by their
+/// cost in the rest of the slot
+/// @param[in] budget_ms time, ms. LDPC iterations and candidates are cut to fit it
+void ftx_worker_set_decode_budget(float budget_ms);
+
+/// @brief Set passes of the last decoding of a slot. Passes after the first one subtract
+/// the decoded signals from the waterfall and decode the candidates of the residual, while
+/// the decode budget allows
+/// @param[in] passes 1 - a single pass (default), up to 3
+void ftx_worker_set_decode_passes(uint8_t passes);
+
+/// @brief Limit the decoding effort, e.g. for background monitoring
+/// @param[in] max_candidates of a search, 0 - the default
+/// @param[in] ldpc_iterations max of a candidate, 0 - the default. The budget may cut it further
+void ftx_worker_set_effort(int max_candidates, int ldpc_iterations);
+
 /// @brief Return block size
 int ftx_worker_get_block_size();
 
 /// @brief Check that wf is full
 bool ftx_worker_is_full();
 
+/// @brief Display row of the spectrogram, which the decoder has built of the blocks since
+/// the last call. Time and frequency subdivisions are collapsed by max
+/// @param[out] row dB of the passband, `width` points
+/// @param[in] width count of points
+/// @return false if there are no new blocks
+bool ftx_worker_get_wf_row(float *row, uint16_t width);
+
+/// @brief Create an additional decoder on the audio of the worker, e.g. of the other protocol.
+/// Decoding threads, scheduling and the callsign hash are shared with the main decoder
+/// @param[in] protocol protocol (FT8/FT4)
+/// @param[in] freq_low, freq_high RX passband, Hz
+/// @return decoder or NULL
+ftx_decoder_t *ftx_decoder_create(ftx_protocol_t protocol, int freq_low, int freq_high);
+
+/// @brief Free the decoder
+void ftx_decoder_free(ftx_decoder_t *dec);
+
+/// @brief Reset state before receiving new time slot of the decoder protocol
+void ftx_decoder_reset(ftx_decoder_t *dec);
+
+/// @brief Process RX audio samples
+/// @param[in] samples audio samples
+/// @param[in] n_samples count of samples, ftx_decoder_get_block_size()
+void ftx_decoder_put_rx_samples(ftx_decoder_t *dec, cfloat *samples, uint32_t n_samples);
+
+/// @brief Decode messages, same as ftx_worker_decode()
+void ftx_decoder_decode(ftx_decoder_t *dec, decoded_msg_cb msg_cb, bool last, void *user_data);
+
+/// @brief Set time for the last decoding of a slot, same as ftx_worker_set_decode_budget()
+void ftx_decoder_set_decode_budget(ftx_decoder_t *dec, float budget_ms);
+
+/// @brief Set passes of the last decoding, same as ftx_worker_set_decode_passes()
+void ftx_decoder_set_decode_passes(ftx_decoder_t *dec, uint8_t passes);
+
+/// @brief Limit the decoding effort, same as ftx_worker_set_effort()
+void ftx_decoder_set_effort(ftx_decoder_t *dec, int max_candidates, int ldpc_iterations);
+
+/// @brief Return block size
+int ftx_decoder_get_block_size(const ftx_decoder_t *dec);
+
+/// @brief Check that wf is full
+bool ftx_decoder_is_full(const ftx_decoder_t *dec);
+
+/// @brief Display row of the spectrogram, same as ftx_worker_get_wf_row()
+bool ftx_decoder_get_wf_row(ftx_decoder_t *dec, float *row, uint16_t width);
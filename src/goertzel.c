@@ -7,6 +7,7 @@
  */
 
 #include <math.h>
+#include <complex.h>
 #include "goertzel.h"
 
 void goertzel_bin_init(goertzel_t *goertzel, uint16_t bin, uint16_t bins) {
@@ -39,3 +40,32 @@ void goertzel_input(goertzel_t *goertzel, float input) {
 float goertzel_output(goertzel_t *goertzel) {
     return sqrt(goertzel->s2 * goertzel->s2 + goertzel->s1 * goertzel->s1 - goertzel->coef * goertzel->s1 * goertzel->s2);
 }
+
+void goertzelcf_bin_init(goertzelcf_t *goertzel, uint16_t bin, uint16_t bins) {
+    float       w = (float) (2.0 * M_PI * bin) / (float) bins;
+
+    goertzel->coef = 2.0f * cosf(w);
+    goertzel->w = cexpf(I * w);
+
+    goertzelcf_reset(goertzel);
+}
+
+void goertzelcf_reset(goertzelcf_t *goertzel) {
+    goertzel->s1 = 0;
+    goertzel->s2 = 0;
+}
+
+void goertzelcf_input(goertzelcf_t *goertzel, cfloat input) {
+    cfloat s0 = goertzel->coef * goertzel->s1 - goertzel->s2 + input;
+
+    goertzel->s2 = goertzel->s1;
+    goertzel->s1 = s0;
+}
+
+/* Squared magnitude of the bin, as of an FFT over the same samples */
+float goertzelcf_power(goertzelcf_t *goertzel) {
+    cfloat s1 = goertzel->s1;
+    cfloat s2 = goertzel->s2;
+
+    return crealf(s1 * conjf(s1)) + crealf(s2 * conjf(s2)) - 2.0f * crealf(s1 * conjf(s2) * goertzel->w);
+}
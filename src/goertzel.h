@@ -9,6 +9,7 @@
 #pragma once
 
 #include <stdint.h>
+#include "helpers.h"
 
 typedef struct {
     float   coef;
@@ -16,9 +17,22 @@ typedef struct {
     float   s2;
 } goertzel_t;
 
+/* For complex input, bins above bins/2 are negative frequencies */
+typedef struct {
+    float   coef;
+    cfloat  w;
+    cfloat  s1;
+    cfloat  s2;
+} goertzelcf_t;
+
 void goertzel_freq_init(goertzel_t *goertzel, uint32_t freq, uint32_t rate, uint16_t bins);
 void goertzel_bin_init(goertzel_t *goertzel, uint16_t bin, uint16_t bins);
 
 void goertzel_input(goertzel_t *goertzel, float input);
 float goertzel_output(goertzel_t *goertzel);
 void goertzel_reset(goertzel_t *goertzel);
+
+void goertzelcf_bin_init(goertzelcf_t *goertzel, uint16_t bin, uint16_t bins);
+void goertzelcf_input(goertzelcf_t *goertzel, cfloat input);
+float goertzelcf_power(goertzelcf_t *goertzel);
+void goertzelcf_reset(goertzelcf_t *goertzel);
@@ -0,0 +1,197 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "governor.h"
+
+#include "dsp.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WINDOW_MS       1000
+#define RESTORE_WINDOWS 3
+
+#define UI_HIGH     0.5f
+#define UI_LOW      0.25f
+#define CPU_HIGH    0.85f
+#define CPU_LOW     0.6f
+
+typedef struct {
+    uint16_t    spectrum_ms;
+    uint16_t    waterfall_ms;
+} level_t;
+
+static const level_t levels[GOVERNOR_LEVELS] = {
+    { 1000 / 15,    1000 / 25 },
+    { 1000 / 10,    1000 / 20 },
+    { 1000 / 7,     1000 / 15 },
+    { 1000 / 5,     1000 / 10 },
+};
+
+typedef struct {
+    char        name[16];
+    pthread_t   thread;
+    clockid_t   clock;
+    uint64_t    last_ns;
+    float       load;
+    bool        used;
+} watched_t;
+
+static pthread_mutex_t  mux = PTHREAD_MUTEX_INITIALIZER;
+static watched_t        threads[GOVERNOR_MAX_THREADS];
+
+static governor_stats_t stats;
+static uint64_t         window_start;
+static uint64_t         ui_busy;
+static uint64_t         ui_start;
+static uint64_t         cpu_last_ns;
+static uint8_t          calm_windows = 0;
+static long             cores = 1;
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void set_level(uint8_t level) {
+    stats.level = level;
+    stats.spectrum_ms = levels[level].spectrum_ms;
+    stats.waterfall_ms = levels[level].waterfall_ms;
+    dsp_set_display_period(stats.spectrum_ms, stats.waterfall_ms);
+}
+
+void governor_init() {
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) {
+        cores = 1;
+    }
+    memset(&stats, 0, sizeof(stats));
+    set_level(0);
+
+    window_start = get_time();
+    cpu_last_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void governor_watch_thread(const char *name, pthread_t thread) {
+    clockid_t clock;
+
+    if (pthread_getcpuclockid(thread, &clock) != 0) {
+        LV_LOG_WARN("Can't get CPU clock of %s", name);
+        return;
+    }
+
+    pthread_mutex_lock(&mux);
+    for (uint8_t i = 0; i < GOVERNOR_MAX_THREADS; i++) {
+        watched_t *t = &threads[i];
+
+        if (!t->used) {
+            strncpy(t->name, name, sizeof(t->name) - 1);
+            t->name[sizeof(t->name) - 1] = 0;
+            t->thread = thread;
+            t->clock = clock;
+            t->last_ns = clock_ns(clock);
+            t->load = 0.0f;
+            t->used = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mux);
+}
+
+void governor_unwatch_thread(pthread_t thread) {
+    pthread_mutex_lock(&mux);
+    for (uint8_t i = 0; i < GOVERNOR_MAX_THREADS; i++) {
+        if (threads[i].used && pthread_equal(threads[i].thread, thread)) {
+            threads[i].used = false;
+        }
+    }
+    pthread_mutex_unlock(&mux);
+}
+
+void governor_ui_begin() {
+    ui_start = get_time();
+}
+
+static void evaluate(uint64_t now) {
+    float    window = now - window_start;
+    uint64_t cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    stats.ui_load = ui_busy / window;
+    stats.cpu_load = (cpu_ns - cpu_last_ns) / (window * 1e6f * cores);
+    cpu_last_ns = cpu_ns;
+
+    pthread_mutex_lock(&mux);
+    for (uint8_t i = 0; i < GOVERNOR_MAX_THREADS; i++) {
+        watched_t *t = &threads[i];
+
+        if (t->used) {
+            uint64_t ns = clock_ns(t->clock);
+
+            t->load = (ns - t->last_ns) / (window * 1e6f);
+            t->last_ns = ns;
+        }
+    }
+    pthread_mutex_unlock(&mux);
+
+    uint8_t level = stats.level;
+
+    if (stats.ui_load > UI_HIGH || stats.cpu_load > CPU_HIGH) {
+        calm_windows = 0;
+        if (level < GOVERNOR_LEVELS - 1) {
+            level++;
+        }
+    } else if (stats.ui_load < UI_LOW && stats.cpu_load < CPU_LOW) {
+        if (level > 0 && ++calm_windows >= RESTORE_WINDOWS) {
+            calm_windows = 0;
+            level--;
+        }
+    } else {
+        calm_windows = 0;
+    }
+
+    if (level != stats.level) {
+        stats.changes++;
+        set_level(level);
+
+        LV_LOG_USER("Level %u: UI %.0f%%, CPU %.0f%%, spectrum %u ms, waterfall %u ms",
+                    level, stats.ui_load * 100.0f, stats.cpu_load * 100.0f, stats.spectrum_ms, stats.waterfall_ms);
+
+        pthread_mutex_lock(&mux);
+        for (uint8_t i = 0; i < GOVERNOR_MAX_THREADS; i++) {
+            if (threads[i].used) {
+                LV_LOG_USER("Thread %s: %.0f%%", threads[i].name, threads[i].load * 100.0f);
+            }
+        }
+        pthread_mutex_unlock(&mux);
+    }
+
+    window_start = now;
+    ui_busy = 0;
+}
+
+void governor_ui_end() {
+    uint64_t now = get_time();
+
+    ui_busy += now - ui_start;
+
+    if (now - window_start >= WINDOW_MS) {
+        evaluate(now);
+    }
+}
+
+void governor_get_stats(governor_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,47 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Frame-rate governor. Measures busy time of the UI loop and CPU time of the watched
+ * threads, lowers spectrum/waterfall rates when the budget is exceeded and restores
+ * them when load drops.
+ */
+
+#define GOVERNOR_LEVELS     4
+#define GOVERNOR_MAX_THREADS 8
+
+typedef struct {
+    uint8_t     level;          /* 0 - full rate */
+    uint16_t    spectrum_ms;
+    uint16_t    waterfall_ms;
+    float       ui_load;        /* Busy part of UI loop in the last window */
+    float       cpu_load;       /* Process CPU time / (window * cores) */
+    uint32_t    changes;        /* Level changes since start */
+} governor_stats_t;
+
+void governor_init();
+
+/**
+ * Take CPU time of the thread into account (until governor_unwatch_thread)
+ */
+void governor_watch_thread(const char *name, pthread_t thread);
+void governor_unwatch_thread(pthread_t thread);
+
+/**
+ * Mark UI loop work, called from the main loop
+ */
+void governor_ui_begin();
+void governor_ui_end();
+
+void governor_get_stats(governor_stats_t *stats);
@@ -13,15 +13,25 @@
 #include "dialog_gps.h"
 #include "usb_devices.h"
 #include "pubsub_ids.h"
+#include "util.h"
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 static struct gps_data_t    gpsdata;
-static uint64_t             prev_time = 0;
 static gps_status_t         status=GPS_STATUS_WAITING;
 
+/* Latest fix under a seqlock, odd sequence - write in progress. Written by the gps thread only */
+static gps_fix_t            fix;
+static atomic_uint          fix_seq = 0;
+
+static gps_fix_t            notified;
+static uint64_t             notified_time = 0;
+
 static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
 
@@ -35,6 +45,63 @@ static bool connect() {
     return true;
 }
 
+static void fix_publish(const gps_fix_t *x) {
+    atomic_fetch_add_explicit(&fix_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    fix = *x;
+    atomic_fetch_add_explicit(&fix_seq, 1, memory_order_release);
+}
+
+void gps_get_fix(gps_fix_t *x) {
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&fix_seq, memory_order_acquire);
+        *x = fix;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&fix_seq, memory_order_relaxed));
+}
+
+static void fix_from_report(gps_fix_t *x) {
+    memset(x, 0, sizeof(*x));
+
+    x->mode = gpsdata.fix.mode;
+
+    if (gpsdata.set & TIME_SET) {
+        x->time_valid = true;
+        x->time = gpsdata.fix.time;
+    }
+    if (gpsdata.fix.mode >= MODE_2D) {
+        x->latitude = gpsdata.fix.latitude;
+        x->longitude = gpsdata.fix.longitude;
+        x->altitude = isfinite(gpsdata.fix.altMSL) ? gpsdata.fix.altMSL : 0;
+    }
+    if (gpsdata.set & SATELLITE_SET) {
+        x->sats_visible = gpsdata.satellites_visible;
+        x->sats_used = gpsdata.satellites_used;
+    } else {
+        x->sats_visible = fix.sats_visible;
+        x->sats_used = fix.sats_used;
+    }
+    x->hdop = isfinite(gpsdata.dop.hdop) ? gpsdata.dop.hdop : 0;
+    x->pdop = isfinite(gpsdata.dop.pdop) ? gpsdata.dop.pdop : 0;
+}
+
+/**
+ * Changes worth a UI update, small position and DOP jitter is ignored
+ */
+static bool fix_changed(const gps_fix_t *a, const gps_fix_t *b) {
+    return a->mode != b->mode ||
+        a->time_valid != b->time_valid ||
+        a->time.tv_sec != b->time.tv_sec ||
+        a->sats_visible != b->sats_visible ||
+        a->sats_used != b->sats_used ||
+        fabs(a->latitude - b->latitude) > GPS_POS_EPS ||
+        fabs(a->longitude - b->longitude) > GPS_POS_EPS ||
+        fabs(a->hdop - b->hdop) > GPS_DOP_EPS ||
+        fabs(a->pdop - b->pdop) > GPS_DOP_EPS;
+}
+
 static void data_receive() {
     while (gps_waiting(&gpsdata, 5000000)) {
         usleep(100000);
@@ -44,11 +111,20 @@ static void data_receive() {
                 continue;
             }
             status = GPS_STATUS_WORKING;
-            if (dialog_gps->run) {
-                struct gps_data_t *msg = malloc(sizeof(struct gps_data_t));
 
-                memcpy(msg, &gpsdata, sizeof(*msg));
-                event_send(dialog_gps->obj, EVENT_GPS, msg);
+            gps_fix_t   x;
+            uint64_t    now = get_time();
+
+            fix_from_report(&x);
+            fix_publish(&x);
+
+            if (now - notified_time >= GPS_NOTIFY_MS && fix_changed(&x, &notified)) {
+                notified = x;
+                notified_time = now;
+
+                if (dialog_gps->run) {
+                    event_send(dialog_gps->obj, EVENT_GPS, NULL);
+                }
             }
         }
     }
@@ -61,6 +137,8 @@ static void disconnect() {
 }
 
 static void * gps_thread(void *arg) {
+    set_thread_name("gps");
+
     while (true) {
         status = GPS_STATUS_WAITING;
         if (connect()) {
@@ -9,6 +9,12 @@
 #pragma once
 
 #include <gps.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define GPS_NOTIFY_MS   1000        /* Min interval of change notifications */
+#define GPS_POS_EPS     0.00001     /* Degrees, ~1 m */
+#define GPS_DOP_EPS     0.1
 
 typedef enum {
     GPS_STATUS_WAITING=0,
@@ -17,6 +23,25 @@ typedef enum {
     GPS_STATUS_EXITED,
 } gps_status_t;
 
+/* Latest fix, compact copy of the gpsd report */
+typedef struct {
+    int             mode;           /* MODE_NOT_SEEN .. MODE_3D */
+    bool            time_valid;
+    struct timespec time;
+    double          latitude;
+    double          longitude;
+    double          altitude;
+    int             sats_visible;
+    int             sats_used;
+    double          hdop;
+    double          pdop;
+} gps_fix_t;
+
 void gps_init();
 
+/**
+ * Consistent copy of the latest fix, from any thread
+ */
+void gps_get_fix(gps_fix_t *fix);
+
 gps_status_t gps_status();
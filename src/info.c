@@ -9,11 +9,14 @@
 #include "info.h"
 
 #include "cfg/transverter.h"
+#include "label_text.h"
 #include "styles.h"
 #include "params/params.h"
 #include "pubsub_ids.h"
 #include "wifi.h"
 
+#include <stdio.h>
+
 typedef enum {
     INFO_VFO = 0,
     INFO_MODE,
@@ -33,7 +36,7 @@ static void wifi_state_change_cb(void *s, lv_msg_t *m);
 static void vfo_label_update(Subject *subj, void * user_data);
 static void mode_label_update(Subject *subj, void * user_data);
 static void atu_label_update(Subject *subj, void * user_data);
-static void agc_label_update(Subject *subj, void * user_data);
+static void agc_label_format(Subject *subj, char *buf, size_t size, void *user_data);
 static void att_pre_label_update(Subject *subj, void * user_data);
 
 lv_obj_t * info_init(lv_obj_t * parent) {
@@ -80,8 +83,7 @@ lv_obj_t * info_init(lv_obj_t * parent) {
     subject_add_delayed_observer(cfg.atu_enabled.val, atu_label_update, NULL);
     atu_label_update(cfg.atu_enabled.val, NULL);
 
-    subject_add_delayed_observer(cfg_cur.agc, agc_label_update, NULL);
-    agc_label_update(cfg_cur.agc, NULL);
+    label_text_bind(items[INFO_AGC], cfg_cur.agc, agc_label_format, NULL);
 
     subject_add_delayed_observer(cfg_cur.att, att_pre_label_update, NULL);
     subject_add_delayed_observer(cfg_cur.pre, att_pre_label_update, NULL);
@@ -202,11 +204,11 @@ static void wifi_state_change_cb(void *s, lv_msg_t *m) {
 
 
 static void vfo_label_update(Subject *subj, void * user_data) {
-    lv_label_set_text(items[INFO_VFO], info_params_vfo_label_get());
+    label_text_set(items[INFO_VFO], info_params_vfo_label_get());
 }
 
 static void mode_label_update(Subject *subj, void *user_data) {
-    lv_label_set_text(items[INFO_MODE], info_params_mode_label_get());
+    label_text_set(items[INFO_MODE], info_params_mode_label_get());
     x6100_mode_t mode = subject_get_int(cfg_cur.mode);
     if ((mode == x6100_mode_lsb_dig) || (mode == x6100_mode_usb_dig)) {
         lv_obj_set_style_text_color(items[INFO_MODE], lv_color_hex(COLOR_LIGHT_RED), 0);
@@ -219,7 +221,7 @@ static void mode_label_update(Subject *subj, void *user_data) {
 
 static void atu_label_update(Subject *subj, void * user_data) {
     int32_t ant = subject_get_int(cfg.ant_id.val);
-    lv_label_set_text_fmt(items[INFO_ATU], "ATU%i", ant);
+    label_text_set_fmt(items[INFO_ATU], "ATU%i", ant);
     int32_t freq = subject_get_int(cfg_cur.fg_freq);
 
     if (!subject_get_int(cfg.atu_enabled.val)) {
@@ -238,8 +240,8 @@ static void atu_label_update(Subject *subj, void * user_data) {
     }
 }
 
-static void agc_label_update(Subject *subj, void * user_data) {
-    lv_label_set_text(items[INFO_AGC], info_params_agc());
+static void agc_label_format(Subject *subj, char *buf, size_t size, void *user_data) {
+    snprintf(buf, size, "%s", info_params_agc());
 }
 
 static void att_pre_label_update(Subject *subj, void * user_data) {
@@ -247,16 +249,16 @@ static void att_pre_label_update(Subject *subj, void * user_data) {
         lv_obj_set_style_text_color(items[INFO_PRE_ATT], lv_color_black(), 0);
         lv_obj_set_style_bg_color(items[INFO_PRE_ATT], lv_color_white(), 0);
         lv_obj_set_style_bg_opa(items[INFO_PRE_ATT], LV_OPA_50, 0);
-        lv_label_set_text(items[INFO_PRE_ATT], "ATT");
+        label_text_set(items[INFO_PRE_ATT], "ATT");
     } else if (subject_get_int(cfg_cur.pre)) {
         lv_obj_set_style_text_color(items[INFO_PRE_ATT], lv_color_black(), 0);
         lv_obj_set_style_bg_color(items[INFO_PRE_ATT], lv_color_white(), 0);
         lv_obj_set_style_bg_opa(items[INFO_PRE_ATT], LV_OPA_50, 0);
-        lv_label_set_text(items[INFO_PRE_ATT], "PRE");
+        label_text_set(items[INFO_PRE_ATT], "PRE");
     } else {
         lv_obj_set_style_text_color(items[INFO_PRE_ATT], lv_color_white(), 0);
         lv_obj_set_style_bg_color(items[INFO_PRE_ATT], lv_color_black(), 0);
         lv_obj_set_style_bg_opa(items[INFO_PRE_ATT], LV_OPA_0, 0);
-        lv_label_set_text(items[INFO_PRE_ATT], "P/A");
+        label_text_set(items[INFO_PRE_ATT], "P/A");
     }
 }
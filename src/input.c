@@ -0,0 +1,212 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "input.h"
+
+#include "backlight.h"
+#include "main_loop.h"
+#include "scheduler.h"
+#include "util.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+
+#define READ_EVENTS     16
+
+typedef struct {
+    int             fd;
+    lv_indev_t      *indev;
+    input_handler_t handler;
+    void            *arg;
+
+    /* Relative axis, summed up to the SYN_REPORT. Input thread only */
+    bool            rel_pending;
+    uint16_t        rel_code;
+    int32_t         rel_value;
+    uint64_t        rel_time;
+} device_t;
+
+typedef struct {
+    uint8_t         device;
+    input_rec_t     rec;
+} item_t;
+
+static device_t         devices[INPUT_MAX_DEVICES];
+static uint8_t          devices_count = 0;
+static int              epoll_fd = -1;
+static pthread_once_t   init_once = PTHREAD_ONCE_INIT;
+
+static void dispatch(void *arg) {
+    item_t      *item = (item_t *) arg;
+    device_t    *dev = &devices[item->device];
+
+    backlight_tick();
+    dev->handler(&item->rec, dev->arg);
+    main_loop_input_wake(dev->indev);
+}
+
+static void emit(uint8_t id, uint16_t type, uint16_t code, int32_t value, uint64_t time) {
+    item_t item = {
+        .device = id,
+        .rec = {
+            .time = time,
+            .type = type,
+            .code = code,
+            .value = value
+        }
+    };
+
+    if (!scheduler_put_prio(SCHEDULER_PRIO_INPUT, dispatch, &item, sizeof(item))) {
+        LV_LOG_WARN("Input queue is full");
+    }
+}
+
+static void device_read(uint8_t id) {
+    device_t            *dev = &devices[id];
+    struct input_event  buf[READ_EVENTS];
+    ssize_t             res;
+
+    while ((res = read(dev->fd, buf, sizeof(buf))) > 0) {
+        size_t count = res / sizeof(struct input_event);
+
+        trace_instant(TRACE_INPUT, id);
+
+        for (size_t i = 0; i < count; i++) {
+            struct input_event  *in = &buf[i];
+            uint64_t            time = (uint64_t) in->input_event_sec * 1000000L + in->input_event_usec;
+
+            switch (in->type) {
+                case EV_KEY:
+                    // Autorepeat is done by LVGL and the keypad long press
+                    if (in->value != 2) {
+                        emit(id, EV_KEY, in->code, in->value, time);
+                    }
+                    break;
+
+                case EV_REL:
+                    if (!dev->rel_pending) {
+                        dev->rel_pending = true;
+                        dev->rel_code = in->code;
+                        dev->rel_value = 0;
+                        dev->rel_time = time;
+                    }
+                    dev->rel_value += in->value;
+                    break;
+
+                case EV_SYN:
+                    if (dev->rel_pending) {
+                        dev->rel_pending = false;
+
+                        if (dev->rel_value != 0) {
+                            emit(id, EV_REL, dev->rel_code, dev->rel_value, dev->rel_time);
+                        }
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    if (res < 0 && errno != EAGAIN) {
+        LV_LOG_ERROR("Input read: %s", strerror(errno));
+    }
+}
+
+static void * input_thread(void *arg) {
+    struct epoll_event events[INPUT_MAX_DEVICES];
+
+    set_thread_name("input");
+
+    while (true) {
+        int n = epoll_wait(epoll_fd, events, INPUT_MAX_DEVICES, -1);
+
+        if (n < 0 && errno != EINTR) {
+            LV_LOG_ERROR("Input epoll: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            device_read(events[i].data.u32);
+        }
+    }
+
+    return NULL;
+}
+
+static void init() {
+    pthread_t thread;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    pthread_create(&thread, NULL, input_thread, NULL);
+    pthread_detach(thread);
+}
+
+int input_open(const char *dev_name) {
+    int fd = open(dev_name, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd < 0) {
+        LV_LOG_ERROR("Unable to open %s: %s", dev_name, strerror(errno));
+        return -1;
+    }
+
+    int clock = CLOCK_MONOTONIC;
+
+    if (ioctl(fd, EVIOCSCLOCKID, &clock) < 0) {
+        LV_LOG_WARN("Monotonic clock for %s: %s", dev_name, strerror(errno));
+    }
+
+    return fd;
+}
+
+void input_add(int fd, lv_indev_t *indev, input_handler_t handler, void *arg) {
+    pthread_once(&init_once, init);
+
+    if (devices_count == INPUT_MAX_DEVICES) {
+        LV_LOG_ERROR("Too many input devices");
+        return;
+    }
+
+    uint8_t     id = devices_count;
+    device_t    *dev = &devices[id];
+
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = fd;
+    dev->indev = indev;
+    dev->handler = handler;
+    dev->arg = arg;
+
+    main_loop_add_input(indev);
+
+    // Published before the fd is polled
+    devices_count++;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = id };
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LV_LOG_ERROR("epoll_ctl(%i): %s", fd, strerror(errno));
+    }
+}
+
+uint64_t input_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
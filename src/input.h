@@ -0,0 +1,46 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+#include <stdint.h>
+
+/*
+ * Evdev input thread. All devices are read from one epoll as events arrive,
+ * relative axes are summed up to the SYN_REPORT. Records go to the UI loop on
+ * the input lane of the scheduler, the handler runs on the UI thread and then
+ * the LVGL indev is read at once
+ */
+
+#define INPUT_MAX_DEVICES   8
+
+typedef struct {
+    uint64_t    time;       /* Event time, CLOCK_MONOTONIC us */
+    uint16_t    type;       /* EV_KEY or EV_REL */
+    uint16_t    code;
+    int32_t     value;      /* Key state or summed delta */
+} input_rec_t;
+
+typedef void (*input_handler_t)(const input_rec_t *rec, void *arg);
+
+/**
+ * Open evdev device in non-blocking mode with monotonic timestamps. Returns fd or -1
+ */
+int input_open(const char *dev_name);
+
+/**
+ * Read fd on the input thread, call handler for each record on the UI thread
+ */
+void input_add(int fd, lv_indev_t *indev, input_handler_t handler, void *arg);
+
+/**
+ * Monotonic time in us, same clock as input_rec_t.time
+ */
+uint64_t input_now();
@@ -0,0 +1,279 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "iq_capture.h"
+
+#include "dsp.h"
+#include "radio.h"
+#include "ring.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLOW_SAMPLE_RATE    100000
+#define CAPTURE_RING_BLOCKS 64      // ~330 ms write-behind
+#define CAPTURE_DEFAULT_SEC 60
+#define REPLAY_DSP_BACKLOG  4       // Fast replay: keep DSP queue short
+
+typedef struct {
+    iq_file_record_t rec;
+    cfloat           samples[RADIO_SAMPLES];
+} capture_block_t;
+
+static ring_t        capture_ring;
+static sem_t         capture_sem;
+static FILE          *capture_file;
+static atomic_bool   capture_on;
+static atomic_bool   capture_stop_req;
+static uint64_t      capture_max_blocks;
+static uint64_t      capture_blocks;
+static uint32_t      capture_overruns_start;
+
+static atomic_bool   replay_on;
+static atomic_bool   replay_stop_req;
+static FILE          *replay_file;
+static bool          replay_realtime;
+static bool          replay_loop;
+
+/* Capture */
+
+static void * capture_thread(void *arg) {
+    capture_block_t *block;
+    bool            done = false;
+
+    set_thread_name("iq_capture");
+
+    while (!done) {
+        sem_wait(&capture_sem);
+        done = atomic_load(&capture_stop_req);
+
+        while ((block = ring_peek(capture_ring))) {
+            size_t len = sizeof(block->rec) + block->rec.size * sizeof(cfloat);
+
+            if (fwrite(block, 1, len, capture_file) != len) {
+                LV_LOG_ERROR("IQ capture write failed");
+                done = true;
+            }
+            ring_release(capture_ring);
+        }
+    }
+
+    fclose(capture_file);
+    capture_file = NULL;
+
+    uint32_t overruns = ring_get_overruns(capture_ring) - capture_overruns_start;
+    LV_LOG_USER("IQ capture stopped, %llu blocks, %u dropped", capture_blocks, overruns);
+    atomic_store(&capture_on, false);
+    return NULL;
+}
+
+bool iq_capture_start(const char *filename, uint32_t max_sec) {
+    if (atomic_load(&capture_on)) {
+        return false;
+    }
+
+    capture_file = fopen(filename, "wb");
+    if (!capture_file) {
+        LV_LOG_ERROR("Can't create IQ capture file %s", filename);
+        return false;
+    }
+
+    struct timeval   tv;
+    iq_file_header_t header;
+
+    gettimeofday(&tv, NULL);
+    memcpy(header.magic, IQ_FILE_MAGIC, sizeof(header.magic));
+    header.version       = IQ_FILE_VERSION;
+    header.block_samples = RADIO_SAMPLES;
+    header.sample_rate   = FLOW_SAMPLE_RATE;
+    header.start_time    = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    fwrite(&header, sizeof(header), 1, capture_file);
+
+    // Ring is kept between captures, radio thread may still hold pointer to it
+    if (!capture_ring) {
+        capture_ring = ring_create(sizeof(capture_block_t), CAPTURE_RING_BLOCKS);
+        sem_init(&capture_sem, 0, 0);
+    }
+    ring_flush(capture_ring);
+    capture_overruns_start = ring_get_overruns(capture_ring);
+    capture_blocks         = 0;
+    capture_max_blocks     = max_sec ? (uint64_t)max_sec * FLOW_SAMPLE_RATE / RADIO_SAMPLES : 0;
+    atomic_store(&capture_stop_req, false);
+    atomic_store(&capture_on, true);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, capture_thread, NULL);
+    pthread_detach(thread);
+
+    LV_LOG_USER("IQ capture started: %s", filename);
+    return true;
+}
+
+void iq_capture_stop() {
+    if (atomic_load(&capture_on) && !atomic_exchange(&capture_stop_req, true)) {
+        sem_post(&capture_sem);
+    }
+}
+
+bool iq_capture_is_on() {
+    return atomic_load(&capture_on) && !atomic_load(&capture_stop_req);
+}
+
+void iq_capture_put(const cfloat *samples, uint16_t size, bool tx) {
+    if (!iq_capture_is_on()) {
+        return;
+    }
+
+    capture_block_t *block = ring_reserve(capture_ring);
+
+    if (!block) {
+        return;
+    }
+    if (size > RADIO_SAMPLES) {
+        size = RADIO_SAMPLES;
+    }
+    block->rec.flags = tx ? IQ_FLAG_TX : 0;
+    block->rec.size  = size;
+    memcpy(block->samples, samples, size * sizeof(cfloat));
+    ring_commit(capture_ring);
+    sem_post(&capture_sem);
+
+    if (capture_max_blocks && ++capture_blocks >= capture_max_blocks) {
+        iq_capture_stop();
+    }
+}
+
+uint32_t iq_capture_get_overruns() {
+    return capture_ring ? ring_get_overruns(capture_ring) - capture_overruns_start : 0;
+}
+
+/* Replay */
+
+static bool replay_read_header() {
+    iq_file_header_t header;
+
+    if (fread(&header, sizeof(header), 1, replay_file) != 1) {
+        return false;
+    }
+    if (memcmp(header.magic, IQ_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != IQ_FILE_VERSION) {
+        LV_LOG_ERROR("Unknown IQ file format");
+        return false;
+    }
+    if (header.sample_rate != FLOW_SAMPLE_RATE) {
+        LV_LOG_WARN("IQ file sample rate %u differs from flow rate", header.sample_rate);
+    }
+    return true;
+}
+
+static void * replay_thread(void *arg) {
+    static cfloat    samples[RADIO_SAMPLES];
+    iq_file_record_t rec;
+    struct timespec  next;
+    uint64_t         blocks = 0;
+
+    set_thread_name("iq_replay");
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!atomic_load(&replay_stop_req)) {
+        if (fread(&rec, sizeof(rec), 1, replay_file) != 1 || rec.size > RADIO_SAMPLES ||
+            fread(samples, sizeof(cfloat), rec.size, replay_file) != rec.size) {
+            if (replay_loop && blocks) {
+                fseek(replay_file, sizeof(iq_file_header_t), SEEK_SET);
+                continue;
+            }
+            break;
+        }
+
+        if (replay_realtime) {
+            uint64_t period_ns = (uint64_t)rec.size * 1000000000ULL / FLOW_SAMPLE_RATE;
+
+            next.tv_nsec += period_ns;
+            while (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        } else {
+            while (dsp_get_queued() >= REPLAY_DSP_BACKLOG && !atomic_load(&replay_stop_req)) {
+                usleep(500);
+            }
+        }
+        dsp_samples(samples, rec.size, rec.flags & IQ_FLAG_TX);
+        blocks++;
+    }
+
+    fclose(replay_file);
+    replay_file = NULL;
+    LV_LOG_USER("IQ replay finished, %llu blocks", blocks);
+    atomic_store(&replay_on, false);
+    return NULL;
+}
+
+bool iq_replay_start(const char *filename, bool realtime, bool loop) {
+    if (atomic_load(&replay_on)) {
+        return false;
+    }
+
+    replay_file = fopen(filename, "rb");
+    if (!replay_file) {
+        return false;
+    }
+    if (!replay_read_header()) {
+        fclose(replay_file);
+        replay_file = NULL;
+        return false;
+    }
+
+    replay_realtime = realtime;
+    replay_loop     = loop;
+    atomic_store(&replay_stop_req, false);
+    atomic_store(&replay_on, true);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, replay_thread, NULL);
+    pthread_detach(thread);
+
+    LV_LOG_USER("IQ replay started: %s", filename);
+    return true;
+}
+
+void iq_replay_stop() {
+    atomic_store(&replay_stop_req, true);
+}
+
+bool iq_replay_is_on() {
+    return atomic_load(&replay_on);
+}
+
+/* * */
+
+void iq_capture_boot() {
+    if (iq_replay_start(IQ_REPLAY_PATH, true, true)) {
+        return;
+    }
+    if (access(IQ_CAPTURE_MARKER, F_OK) == 0) {
+        char    filename[64];
+        time_t  now = time(NULL);
+        struct tm *t = localtime(&now);
+
+        snprintf(filename, sizeof(filename),
+            "%s/IQ_%04i%02i%02i_%02i%02i%02i.x6iq",
+            IQ_CAPTURE_PATH, t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec
+        );
+        iq_capture_start(filename, CAPTURE_DEFAULT_SEC);
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "helpers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Raw flow IQ capture to file and replay into DSP.
+ *
+ * File format: iq_file_header_t, then iq_file_record_t per flow block
+ */
+
+#define IQ_FILE_MAGIC   "X6IQ"
+#define IQ_FILE_VERSION 1
+
+#define IQ_CAPTURE_PATH     "/mnt"
+#define IQ_CAPTURE_MARKER   "/mnt/iq_capture.on"    // Start capture on boot, if exists
+#define IQ_REPLAY_PATH      "/mnt/iq_replay.x6iq"   // Replay on boot instead of live flow, if exists
+
+#define IQ_FLAG_TX (1 << 0)
+
+typedef struct __attribute__((packed)) {
+    char     magic[4];
+    uint16_t version;
+    uint16_t block_samples;
+    uint32_t sample_rate;
+    uint64_t start_time;    // UNIX time, ms
+} iq_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t flags;
+    uint16_t size;
+} iq_file_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start capture to file. `max_sec` limits duration (0 - unlimited)
+ */
+bool iq_capture_start(const char *filename, uint32_t max_sec);
+void iq_capture_stop();
+bool iq_capture_is_on();
+
+/**
+ * Queue flow block for writing. Called from radio thread, never blocks
+ */
+void iq_capture_put(const cfloat *samples, uint16_t size, bool tx);
+uint32_t iq_capture_get_overruns();
+
+/**
+ * Replay file to dsp_samples(). With `realtime` blocks are paced with flow rate,
+ * otherwise fed as fast as DSP consumes them
+ */
+bool iq_replay_start(const char *filename, bool realtime, bool loop);
+void iq_replay_stop();
+bool iq_replay_is_on();
+
+/**
+ * Start capture/replay by marker files on SD card
+ */
+void iq_capture_boot();
+
+#ifdef __cplusplus
+}
+#endif
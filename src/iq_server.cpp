@@ -0,0 +1,497 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "iq_server.h"
+
+#include "cat.private.hpp"
+#include "cfg/subjects.h"
+#include "dsp/decim.h"
+#include "util.hpp"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+extern "C" {
+    #include "cfg/cfg.h"
+    #include "radio.h"
+
+    #include "lvgl/lvgl.h"
+    #include <arpa/inet.h>
+    #include <errno.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <string.h>
+    #include <sys/eventfd.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+}
+
+#define RING_BLOCKS     64      /* 330 ms of flow */
+#define RING_MARGIN     8       /* Blocks a reader keeps away from the writer */
+#define WAKE_BLOCKS     4
+#define MAX_FACTOR      8
+#define BLOCK_BYTES     (RADIO_SAMPLES * sizeof(cfloat))
+
+#define CMD_SET_FREQ    0x01
+#define CMD_SET_RATE    0x02
+#define CMD_SET_FORMAT  0x80
+
+typedef struct {
+    bool    tx;
+    cfloat  samples[RADIO_SAMPLES];
+} block_t;
+
+struct Client {
+    int                 fd = -1;
+    uint64_t            cursor;         /* Next block of the ring */
+    iq_server_format_t  format;
+    size_t              factor;
+    DecimChain          *decim = NULL;
+
+    uint8_t             cmd[5];
+    size_t              cmd_len;
+
+    uint8_t             out[BLOCK_BYTES];
+    size_t              out_len;
+    size_t              out_pos;
+};
+
+static block_t                  ring[RING_BLOCKS];
+static std::atomic<uint64_t>    write_seq{0};
+
+static Client                   clients[IQ_SERVER_CLIENTS];
+static int                      listen_fd = -1;
+static int                      wake_event = -1;
+
+static std::atomic<bool>        enabled{false};
+static std::atomic<bool>        active{false};      /* Has clients */
+
+static std::atomic<uint32_t>    stat_clients{0};
+static std::atomic<uint32_t>    stat_blocks{0};
+static std::atomic<uint32_t>    stat_sent{0};
+static std::atomic<uint32_t>    stat_dropped{0};
+static std::atomic<uint64_t>    stat_bytes{0};
+
+static void wake() {
+    uint64_t val = 1;
+
+    if (wake_event >= 0 && write(wake_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("IQ server wake event");
+    }
+}
+
+/* Radio thread */
+
+void iq_server_put(const cfloat *samples, uint16_t size, bool tx) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    uint64_t    seq = write_seq.load(std::memory_order_relaxed);
+    block_t     *block = &ring[seq % RING_BLOCKS];
+
+    block->tx = tx;
+    memcpy(block->samples, samples, std::min<size_t>(size, RADIO_SAMPLES) * sizeof(cfloat));
+    write_seq.store(seq + 1, std::memory_order_release);
+
+    stat_blocks.fetch_add(1, std::memory_order_relaxed);
+
+    if ((seq + 1) % WAKE_BLOCKS == 0) {
+        wake();
+    }
+}
+
+/* Clients */
+
+static void clients_update() {
+    uint32_t count = 0;
+
+    for (uint8_t i = 0; i < IQ_SERVER_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            count++;
+        }
+    }
+    active = count > 0;
+    stat_clients = count;
+}
+
+static void client_close(Client *client) {
+    close(client->fd);
+    client->fd = -1;
+    delete client->decim;
+    client->decim = NULL;
+}
+
+static void set_rate(Client *client, uint32_t rate) {
+    size_t factor = 1;
+
+    while (factor < MAX_FACTOR && IQ_SERVER_RATE / factor > rate) {
+        factor *= 2;
+    }
+    if (factor != client->factor) {
+        delete client->decim;
+        client->decim = factor > 1 ? new DecimChain(factor) : NULL;
+        client->factor = factor;
+    }
+}
+
+static void set_freq(uint32_t freq) {
+    uint8_t data[5];
+
+    to_bcd(data, (int64_t) freq - subject_get_int(cfg_cur.lo_offset), 10);
+    cat_command(C_SET_FREQ, data, sizeof(data));
+}
+
+static void client_command(Client *client) {
+    uint32_t param = (client->cmd[1] << 24) | (client->cmd[2] << 16) | (client->cmd[3] << 8) | client->cmd[4];
+
+    switch (client->cmd[0]) {
+        case CMD_SET_FREQ:
+            set_freq(param);
+            break;
+
+        case CMD_SET_RATE:
+            set_rate(client, param);
+            break;
+
+        case CMD_SET_FORMAT:
+            if (param <= IQ_SERVER_F32) {
+                client->format = (iq_server_format_t) param;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void client_read(Client *client) {
+    uint8_t buf[64];
+    ssize_t res = recv(client->fd, buf, sizeof(buf), 0);
+
+    if (res == 0 || (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        client_close(client);
+        return;
+    }
+    for (ssize_t i = 0; i < res; i++) {
+        client->cmd[client->cmd_len++] = buf[i];
+
+        if (client->cmd_len == sizeof(client->cmd)) {
+            client_command(client);
+            client->cmd_len = 0;
+        }
+    }
+}
+
+/**
+ * Send the scratch block, false if the socket is full or the client is gone
+ */
+static bool client_flush(Client *client) {
+    while (client->out_pos < client->out_len) {
+        ssize_t res = send(client->fd, client->out + client->out_pos, client->out_len - client->out_pos,
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (res < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client_close(client);
+            }
+            return false;
+        }
+        client->out_pos += res;
+        stat_bytes.fetch_add(res, std::memory_order_relaxed);
+    }
+    client->out_len = 0;
+    client->out_pos = 0;
+
+    return true;
+}
+
+/**
+ * Send a ring block as is, the rest goes to the scratch block, as the slot is reused soon
+ */
+static bool client_send_block(Client *client, const block_t *block) {
+    const uint8_t   *data = reinterpret_cast<const uint8_t *>(block->samples);
+    ssize_t         res = send(client->fd, data, BLOCK_BYTES, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if (res < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            client_close(client);
+            return false;
+        }
+        res = 0;
+    }
+    stat_bytes.fetch_add(res, std::memory_order_relaxed);
+
+    if ((size_t) res < BLOCK_BYTES) {
+        memcpy(client->out, data + res, BLOCK_BYTES - res);
+        client->out_len = BLOCK_BYTES - res;
+        client->out_pos = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Block in the client format to the scratch block, returns its size
+ */
+static size_t convert(Client *client, const block_t *block) {
+    static cfloat   decimated[RADIO_SAMPLES];
+    const cfloat    *in = block->samples;
+    size_t          n = RADIO_SAMPLES;
+
+    if (client->decim) {
+        n = RADIO_SAMPLES / client->factor;
+        client->decim->execute(in, n, decimated);
+        in = decimated;
+    }
+
+    const float *x = reinterpret_cast<const float *>(in);
+
+    switch (client->format) {
+        case IQ_SERVER_U8:
+            for (size_t i = 0; i < n * 2; i++) {
+                client->out[i] = std::clamp(x[i] * 127.5f + 127.5f, 0.0f, 255.0f);
+            }
+            return n * 2;
+
+        case IQ_SERVER_S16: {
+            int16_t *out = reinterpret_cast<int16_t *>(client->out);
+
+            for (size_t i = 0; i < n * 2; i++) {
+                out[i] = std::clamp(x[i] * 32767.0f, -32767.0f, 32767.0f);
+            }
+            return n * 2 * sizeof(int16_t);
+        }
+
+        default:
+            memcpy(client->out, in, n * sizeof(cfloat));
+            return n * sizeof(cfloat);
+    }
+}
+
+/**
+ * Blocks were overwritten by the radio thread while we were reading
+ */
+static bool overwritten(uint64_t cursor) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return write_seq.load(std::memory_order_relaxed) - cursor >= RING_BLOCKS;
+}
+
+static void client_process(Client *client) {
+    if (client->out_len && !client_flush(client)) {
+        return;
+    }
+
+    uint64_t seq = write_seq.load(std::memory_order_acquire);
+
+    while (client->fd >= 0 && client->cursor < seq) {
+        /* Too far behind, skip to the newest blocks */
+        if (seq - client->cursor > RING_BLOCKS - RING_MARGIN) {
+            stat_dropped.fetch_add(seq - client->cursor - 1, std::memory_order_relaxed);
+            client->cursor = seq - 1;
+        }
+
+        uint64_t        cursor = client->cursor++;
+        const block_t   *block = &ring[cursor % RING_BLOCKS];
+        bool            sent;
+
+        if (client->format == IQ_SERVER_F32 && !client->decim) {
+            sent = client_send_block(client, block);
+        } else {
+            client->out_len = convert(client, block);
+            client->out_pos = 0;
+
+            if (overwritten(cursor)) {
+                client->out_len = 0;
+                stat_dropped.fetch_add(1, std::memory_order_relaxed);
+                seq = write_seq.load(std::memory_order_acquire);
+                continue;
+            }
+            sent = client_flush(client);
+        }
+        stat_sent.fetch_add(1, std::memory_order_relaxed);
+
+        if (!sent) {
+            break;
+        }
+        seq = write_seq.load(std::memory_order_acquire);
+    }
+}
+
+static void client_accept() {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < IQ_SERVER_CLIENTS; i++) {
+        Client *client = &clients[i];
+
+        if (client->fd < 0) {
+            uint8_t hello[12] = { 'R', 'T', 'L', '0', 0, 0, 0, 0, 0, 0, 0, 0 };
+            int     one = 1;
+
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            client->fd = fd;
+            client->cursor = write_seq.load(std::memory_order_acquire);
+            client->format = IQ_SERVER_U8;
+            client->factor = 1;
+            client->cmd_len = 0;
+            client->out_len = 0;
+            client->out_pos = 0;
+
+            memcpy(client->out, hello, sizeof(hello));
+            client->out_len = sizeof(hello);
+
+            LV_LOG_USER("IQ server client %i connected", i);
+            return;
+        }
+    }
+
+    LV_LOG_WARN("IQ server: too many clients");
+    close(fd);
+}
+
+/* Server */
+
+static void server_open() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+
+    if (fd < 0) {
+        LV_LOG_ERROR("IQ server socket: %s", strerror(errno));
+        return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(IQ_SERVER_PORT);
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 2) < 0) {
+        LV_LOG_ERROR("IQ server port %u: %s", IQ_SERVER_PORT, strerror(errno));
+        close(fd);
+        return;
+    }
+    listen_fd = fd;
+}
+
+static void server_close() {
+    close(listen_fd);
+    listen_fd = -1;
+
+    for (uint8_t i = 0; i < IQ_SERVER_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            client_close(&clients[i]);
+        }
+    }
+}
+
+static void server_thread() {
+    set_thread_name("iq_server");
+
+    struct pollfd fds[2 + IQ_SERVER_CLIENTS];
+
+    while (true) {
+        bool on = enabled;
+
+        if (on && listen_fd < 0) {
+            server_open();
+        } else if (!on && listen_fd >= 0) {
+            server_close();
+        }
+        clients_update();
+
+        fds[0].fd = wake_event;
+        fds[0].events = POLLIN;
+        fds[1].fd = listen_fd;
+        fds[1].events = POLLIN;
+
+        for (uint8_t i = 0; i < IQ_SERVER_CLIENTS; i++) {
+            Client *client = &clients[i];
+
+            fds[2 + i].fd = client->fd;
+            fds[2 + i].events = POLLIN | (client->out_len ? POLLOUT : 0);
+        }
+
+        if (poll(fds, 2 + IQ_SERVER_CLIENTS, -1) < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("IQ server poll: %s", strerror(errno));
+                sleep_usec(100000);
+            }
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t val;
+
+            if (read(wake_event, &val, sizeof(val)) < 0) {
+                LV_LOG_WARN("IQ server wake event");
+            }
+        }
+        if (listen_fd >= 0 && (fds[1].revents & POLLIN)) {
+            client_accept();
+        }
+
+        for (uint8_t i = 0; i < IQ_SERVER_CLIENTS; i++) {
+            Client  *client = &clients[i];
+            short   revents = fds[2 + i].fd == client->fd ? fds[2 + i].revents : 0;
+
+            if (client->fd < 0) {
+                continue;
+            }
+            if (revents & (POLLERR | POLLHUP)) {
+                LV_LOG_USER("IQ server client %i disconnected", i);
+                client_close(client);
+                continue;
+            }
+            if (revents & POLLIN) {
+                client_read(client);
+            }
+            if (client->fd >= 0) {
+                client_process(client);
+            }
+        }
+    }
+}
+
+static void on_iq_server_change(Subject *subj, void *user_data) {
+    enabled = subject_get_int(subj);
+    wake();
+}
+
+void iq_server_init() {
+    wake_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_event < 0) {
+        LV_LOG_ERROR("IQ server wake event");
+        return;
+    }
+
+    subject_add_observer_and_call(cfg.iq_server.val, on_iq_server_change, NULL);
+
+    std::thread thread(server_thread);
+    thread.detach();
+}
+
+void iq_server_stats(iq_server_stats_t *stats) {
+    stats->clients = stat_clients;
+    stats->blocks = stat_blocks;
+    stats->sent = stat_sent;
+    stats->dropped = stat_dropped;
+    stats->bytes = stat_bytes;
+}
@@ -0,0 +1,71 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "helpers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Flow IQ for external SDR software, rtl_tcp protocol over TCP. The radio
+ * thread copies each flow block once into a broadcast ring, the "iq_server"
+ * thread sends it to every client from its own cursor: float blocks straight
+ * from the ring, other formats and rates through a per client scratch block.
+ * A client, which doesn't keep up, skips the blocks overwritten by the radio
+ * thread, nothing ever waits for a socket. Enabled by cfg.iq_server.
+ *
+ * On connect the server sends "RTL0", u32 tuner type (0), u32 gain count (0).
+ * Commands are u8 id, u32 parameter, big endian:
+ *
+ *   0x01 center frequency, Hz, retunes the VFO
+ *   0x02 sample rate, the highest of IQ_SERVER_RATE / 1, 2, 4, 8 not above it
+ *   0x80 sample format, iq_server_format_t (extension, rtl_tcp clients leave it)
+ *
+ * Other rtl_tcp commands are accepted and ignored. Samples are interleaved I, Q,
+ * full scale is 1.0 of the flow.
+ */
+
+#define IQ_SERVER_PORT      1234
+#define IQ_SERVER_CLIENTS   4
+#define IQ_SERVER_RATE      100000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    IQ_SERVER_U8 = 0,       /* rtl_tcp, 127.5 is zero */
+    IQ_SERVER_S16,
+    IQ_SERVER_F32,
+} iq_server_format_t;
+
+typedef struct {
+    uint32_t    clients;
+    uint32_t    blocks;         /* Put by the radio thread */
+    uint32_t    sent;           /* Blocks sent to clients */
+    uint32_t    dropped;        /* Skipped by slow clients */
+    uint64_t    bytes;
+} iq_server_stats_t;
+
+void iq_server_init();
+
+/**
+ * Flow block, called by the radio thread, never blocks
+ */
+void iq_server_put(const cfloat *samples, uint16_t size, bool tx);
+
+/**
+ * Counters since start
+ */
+void iq_server_stats(iq_server_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,114 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "jitter_buffer.h"
+
+#include <string.h>
+
+void jitter_buffer_reset(jitter_buffer_t *jb, uint16_t frame, uint8_t target) {
+    memset(jb->filled, 0, sizeof(jb->filled));
+    memset(jb->last, 0, sizeof(jb->last));
+
+    jb->frame = frame > JITTER_BUFFER_MAX_FRAME ? JITTER_BUFFER_MAX_FRAME : frame;
+    jb->target = target < 1 ? 1 : target > JITTER_BUFFER_SLOTS / 2 ? JITTER_BUFFER_SLOTS / 2 : target;
+    jb->started = false;
+    jb->playing = false;
+    jb->next_seq = 0;
+}
+
+bool jitter_buffer_put(jitter_buffer_t *jb, uint16_t seq, const int16_t *samples) {
+    if (!jb->started) {
+        jb->started = true;
+        jb->next_seq = seq;
+    }
+
+    int16_t ahead = seq - jb->next_seq;
+
+    /* The sender has restarted or we were away for long */
+    if (ahead >= JITTER_BUFFER_SLOTS || ahead < -JITTER_BUFFER_SLOTS) {
+        memset(jb->filled, 0, sizeof(jb->filled));
+        jb->next_seq = seq;
+        jb->playing = false;
+    } else if (ahead < 0) {
+        jb->stats.late++;
+        return false;
+    }
+
+    uint8_t slot = seq % JITTER_BUFFER_SLOTS;
+
+    if (jb->filled[slot] && jb->seqs[slot] == seq) {
+        jb->stats.late++;
+        return false;
+    }
+
+    memcpy(jb->frames[slot], samples, jb->frame * sizeof(int16_t));
+    jb->seqs[slot] = seq;
+    jb->filled[slot] = true;
+    jb->stats.received++;
+
+    return true;
+}
+
+uint8_t jitter_buffer_depth(const jitter_buffer_t *jb) {
+    uint8_t depth = 0;
+
+    for (uint8_t i = 0; i < JITTER_BUFFER_SLOTS; i++) {
+        if (jb->filled[i]) {
+            uint16_t ahead = jb->seqs[i] - jb->next_seq;
+
+            if (ahead < JITTER_BUFFER_SLOTS && ahead + 1 > depth) {
+                depth = ahead + 1;
+            }
+        }
+    }
+    return depth;
+}
+
+bool jitter_buffer_get(jitter_buffer_t *jb, int16_t *out) {
+    uint8_t depth = jitter_buffer_depth(jb);
+
+    if (!jb->playing) {
+        if (depth < jb->target) {
+            return false;
+        }
+        jb->playing = true;
+    } else if (depth == 0) {
+        jb->playing = false;
+        jb->stats.underruns++;
+        return false;
+    }
+
+    uint8_t high = jb->target * 2 > jb->target + 2 ? jb->target * 2 : jb->target + 2;
+
+    while (depth > high) {
+        uint8_t slot = jb->next_seq % JITTER_BUFFER_SLOTS;
+
+        if (jb->filled[slot]) {
+            jb->filled[slot] = false;
+            jb->stats.skipped++;
+        }
+        jb->next_seq++;
+        depth--;
+    }
+
+    uint8_t slot = jb->next_seq % JITTER_BUFFER_SLOTS;
+
+    if (jb->filled[slot] && jb->seqs[slot] == jb->next_seq) {
+        memcpy(jb->last, jb->frames[slot], jb->frame * sizeof(int16_t));
+        jb->filled[slot] = false;
+    } else {
+        for (uint16_t i = 0; i < jb->frame; i++) {
+            jb->last[i] /= 2;
+        }
+        jb->stats.lost++;
+    }
+    memcpy(out, jb->last, jb->frame * sizeof(int16_t));
+    jb->next_seq++;
+
+    return true;
+}
@@ -0,0 +1,75 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Playout buffer of audio frames from the network. Frames are put by sequence
+ * number in any order, playout starts when target frames are buffered and then
+ * takes one frame per tick. A missing frame is concealed by the previous one,
+ * fading out. The sender clock running ahead of ours is absorbed by skipping
+ * frames over twice the target, an empty buffer stops playout until it fills
+ * up again.
+ */
+
+#define JITTER_BUFFER_SLOTS     16
+#define JITTER_BUFFER_MAX_FRAME 512
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t    received;
+    uint32_t    lost;           /* Concealed at playout */
+    uint32_t    late;           /* Came after its playout, or twice */
+    uint32_t    skipped;        /* Dropped to catch up with the sender */
+    uint32_t    underruns;
+} jitter_buffer_stats_t;
+
+typedef struct {
+    int16_t                 frames[JITTER_BUFFER_SLOTS][JITTER_BUFFER_MAX_FRAME];
+    uint16_t                seqs[JITTER_BUFFER_SLOTS];
+    bool                    filled[JITTER_BUFFER_SLOTS];
+    int16_t                 last[JITTER_BUFFER_MAX_FRAME];
+
+    uint16_t                frame;      /* Samples */
+    uint8_t                 target;     /* Frames before playout */
+    bool                    started;
+    bool                    playing;
+    uint16_t                next_seq;   /* Of the next playout */
+
+    jitter_buffer_stats_t   stats;
+} jitter_buffer_t;
+
+/**
+ * Forget all frames, frame is limited by JITTER_BUFFER_MAX_FRAME, target by the half of slots
+ */
+void jitter_buffer_reset(jitter_buffer_t *jb, uint16_t frame, uint8_t target);
+
+/**
+ * Store a frame of jb->frame samples, false if it is late or a duplicate
+ */
+bool jitter_buffer_put(jitter_buffer_t *jb, uint16_t seq, const int16_t *samples);
+
+/**
+ * Frame for playout, false while buffering
+ */
+bool jitter_buffer_get(jitter_buffer_t *jb, int16_t *out);
+
+/**
+ * Frames from the next playout to the newest one
+ */
+uint8_t jitter_buffer_depth(const jitter_buffer_t *jb);
+
+#ifdef __cplusplus
+}
+#endif
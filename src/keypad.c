@@ -8,14 +8,15 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <linux/input.h>
 
 #include "keypad.h"
 #include "main.h"
-#include "backlight.h"
 #include "keyboard.h"
+#include "input.h"
+#include "main_loop.h"
 
 #define KEYPAD_LONG_TIME 1000
 
@@ -28,181 +29,207 @@ static void keypad_timer(lv_timer_t *t) {
     timer = NULL;
 }
 
+static void queue_put(keypad_t *keypad, uint32_t key, int state) {
+    if (keypad->queue_count == KEYPAD_QUEUE) {
+        return;
+    }
+
+    keypad_indev_key_t *item = &keypad->queue[(keypad->queue_head + keypad->queue_count) % KEYPAD_QUEUE];
+
+    item->key = key;
+    item->state = state;
+    keypad->queue_count++;
+}
+
 static void keypad_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
-    struct input_event  in;
-    keypad_t            *keypad = (keypad_t*) drv->user_data;
+    keypad_t *keypad = (keypad_t*) drv->user_data;
 
-    if (read(keypad->fd, &in, sizeof(struct input_event)) > 0) {
-        if (in.type == EV_KEY) {
-            backlight_tick();
+    if (keypad->queue_count > 0) {
+        keypad_indev_key_t *item = &keypad->queue[keypad->queue_head];
 
-            switch (in.code) {
-                /* Rotary VOL */
+        keypad->evdev_key = item->key;
+        keypad->evdev_state = item->state;
+        keypad->queue_head = (keypad->queue_head + 1) % KEYPAD_QUEUE;
+        keypad->queue_count--;
 
-                case BTN_TRIGGER_HAPPY21:
-                    data->key = LV_KEY_ESC;
-                    data->state = (in.value) ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
-                    keypad->evdev_key = data->key;
-                    keypad->evdev_state = data->state;
-                    return;
+        data->continue_reading = keypad->queue_count > 0;
+    }
 
-                /* Rotary MFK */
+    data->key = keypad->evdev_key;
+    data->state = keypad->evdev_state;
+}
 
-                case BTN_TRIGGER_HAPPY27:
-                    mfk->pressed = (in.value != 0);
-                    return;
+/**
+ * Key record from the input thread, on the UI thread
+ */
+static void keypad_handle(const input_rec_t *in, void *arg) {
+    keypad_t *keypad = (keypad_t*) arg;
 
-                /* Front side */
+    if (in->type != EV_KEY) {
+        return;
+    }
 
-                case KEY_POWER:
-                    event.key = KEYPAD_POWER;
-                    break;
+    switch (in->code) {
+        /* Rotary VOL */
 
-                case BTN_TRIGGER_HAPPY1:
-                    event.key = KEYPAD_GEN;
-                    break;
+        case BTN_TRIGGER_HAPPY21:
+            queue_put(keypad, LV_KEY_ESC, in->value ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED);
+            return;
 
-                case BTN_TRIGGER_HAPPY7:
-                    event.key = KEYPAD_APP;
-                    break;
+        /* Rotary MFK */
 
-                case BTN_TRIGGER_HAPPY2:
-                    event.key = KEYPAD_KEY;
-                    break;
+        case BTN_TRIGGER_HAPPY27:
+            mfk->pressed = (in->value != 0);
+            main_loop_input_wake(mfk->indev);
+            return;
 
-                case BTN_TRIGGER_HAPPY8:
-                    event.key = KEYPAD_MSG;
-                    break;
+        /* Front side */
 
-                case BTN_TRIGGER_HAPPY3:
-                    event.key = KEYPAD_DFN;
-                    break;
-
-                case BTN_TRIGGER_HAPPY9:
-                    event.key = KEYPAD_DFL;
-                    break;
-
-                case BTN_TRIGGER_HAPPY13:
-                    event.key = KEYPAD_F1;
-                    break;
-
-                case BTN_TRIGGER_HAPPY14:
-                    event.key = KEYPAD_F2;
-                    break;
-
-                case BTN_TRIGGER_HAPPY15:
-                    event.key = KEYPAD_F3;
-                    break;
-
-                case BTN_TRIGGER_HAPPY19:
-                    event.key = KEYPAD_F4;
-                    break;
-
-                case BTN_TRIGGER_HAPPY20:
-                    event.key = KEYPAD_F5;
-                    break;
-
-                case BTN_TRIGGER_HAPPY25:
-                    event.key = KEYPAD_LOCK;
-                    break;
-
-                /* Top side */
-
-                case BTN_TRIGGER_HAPPY4:
-                    event.key = KEYPAD_PTT;
-                    break;
-
-                case BTN_TRIGGER_HAPPY5:
-                    event.key = KEYPAD_BAND_DOWN;
-                    break;
-
-                case BTN_TRIGGER_HAPPY6:
-                    event.key = KEYPAD_BAND_UP;
-                    break;
-
-                case BTN_TRIGGER_HAPPY10:
-                    event.key = KEYPAD_MODE_AM;
-                    break;
-
-                case BTN_TRIGGER_HAPPY11:
-                    event.key = KEYPAD_MODE_CW;
-                    break;
-
-                case BTN_TRIGGER_HAPPY12:
-                    event.key = KEYPAD_MODE_SSB;
-                    break;
-
-                case BTN_TRIGGER_HAPPY16:
-                    event.key = KEYPAD_AB;
-                    break;
-
-                case BTN_TRIGGER_HAPPY17:
-                    event.key = KEYPAD_PRE;
-                    break;
-
-                case BTN_TRIGGER_HAPPY18:
-                    event.key = KEYPAD_ATU;
-                    break;
-
-                case BTN_TRIGGER_HAPPY22:
-                    event.key = KEYPAD_VM;
-                    break;
-
-                case BTN_TRIGGER_HAPPY23:
-                    event.key = KEYPAD_AGC;
-                    break;
-
-                case BTN_TRIGGER_HAPPY24:
-                    event.key = KEYPAD_FST;
-                    break;
-
-                default:
-                    event.key = KEYPAD_UNKNOWN;
-                    LV_LOG_WARN("Unknown key");
-                    break;
-            }
-
-            if (timer) {
-                lv_timer_del(timer);
-                timer = NULL;
-            }
-
-            if (in.value == 1) {
-                event.state = KEYPAD_PRESS;
-                lv_event_send(lv_scr_act(), EVENT_KEYPAD, (void*) &event);
-
-                timer = lv_timer_create(keypad_timer, KEYPAD_LONG_TIME, NULL);
-                lv_timer_set_repeat_count(timer, 1);
-            } else {
-                if (event.state == KEYPAD_PRESS) {
-                    event.state = KEYPAD_RELEASE;
-                    lv_event_send(lv_scr_act(), EVENT_KEYPAD, (void*) &event);
-                } else if (event.state == KEYPAD_LONG) {
-                    event.state = KEYPAD_LONG_RELEASE;
-                    lv_event_send(lv_scr_act(), EVENT_KEYPAD, (void*) &event);
-                }
-            }
-        }
+        case KEY_POWER:
+            event.key = KEYPAD_POWER;
+            break;
+
+        case BTN_TRIGGER_HAPPY1:
+            event.key = KEYPAD_GEN;
+            break;
+
+        case BTN_TRIGGER_HAPPY7:
+            event.key = KEYPAD_APP;
+            break;
+
+        case BTN_TRIGGER_HAPPY2:
+            event.key = KEYPAD_KEY;
+            break;
+
+        case BTN_TRIGGER_HAPPY8:
+            event.key = KEYPAD_MSG;
+            break;
+
+        case BTN_TRIGGER_HAPPY3:
+            event.key = KEYPAD_DFN;
+            break;
+
+        case BTN_TRIGGER_HAPPY9:
+            event.key = KEYPAD_DFL;
+            break;
+
+        case BTN_TRIGGER_HAPPY13:
+            event.key = KEYPAD_F1;
+            break;
+
+        case BTN_TRIGGER_HAPPY14:
+            event.key = KEYPAD_F2;
+            break;
+
+        case BTN_TRIGGER_HAPPY15:
+            event.key = KEYPAD_F3;
+            break;
+
+        case BTN_TRIGGER_HAPPY19:
+            event.key = KEYPAD_F4;
+            break;
+
+        case BTN_TRIGGER_HAPPY20:
+            event.key = KEYPAD_F5;
+            break;
+
+        case BTN_TRIGGER_HAPPY25:
+            event.key = KEYPAD_LOCK;
+            break;
+
+        /* Top side */
+
+        case BTN_TRIGGER_HAPPY4:
+            event.key = KEYPAD_PTT;
+            break;
+
+        case BTN_TRIGGER_HAPPY5:
+            event.key = KEYPAD_BAND_DOWN;
+            break;
+
+        case BTN_TRIGGER_HAPPY6:
+            event.key = KEYPAD_BAND_UP;
+            break;
+
+        case BTN_TRIGGER_HAPPY10:
+            event.key = KEYPAD_MODE_AM;
+            break;
+
+        case BTN_TRIGGER_HAPPY11:
+            event.key = KEYPAD_MODE_CW;
+            break;
+
+        case BTN_TRIGGER_HAPPY12:
+            event.key = KEYPAD_MODE_SSB;
+            break;
+
+        case BTN_TRIGGER_HAPPY16:
+            event.key = KEYPAD_AB;
+            break;
+
+        case BTN_TRIGGER_HAPPY17:
+            event.key = KEYPAD_PRE;
+            break;
+
+        case BTN_TRIGGER_HAPPY18:
+            event.key = KEYPAD_ATU;
+            break;
+
+        case BTN_TRIGGER_HAPPY22:
+            event.key = KEYPAD_VM;
+            break;
+
+        case BTN_TRIGGER_HAPPY23:
+            event.key = KEYPAD_AGC;
+            break;
+
+        case BTN_TRIGGER_HAPPY24:
+            event.key = KEYPAD_FST;
+            break;
+
+        default:
+            event.key = KEYPAD_UNKNOWN;
+            LV_LOG_WARN("Unknown key");
+            break;
     }
 
-    data->key = keypad->evdev_key;
-    data->state = keypad->evdev_state;
+    if (timer) {
+        lv_timer_del(timer);
+        timer = NULL;
+    }
+
+    if (in->value == 1) {
+        event.state = KEYPAD_PRESS;
+        lv_event_send(lv_scr_act(), EVENT_KEYPAD, (void*) &event);
+
+        // Long press counts from the key event, not from the dispatch
+        uint64_t age = (input_now() - in->time) / 1000;
+
+        timer = lv_timer_create(keypad_timer, age < KEYPAD_LONG_TIME ? KEYPAD_LONG_TIME - age : 1, NULL);
+        lv_timer_set_repeat_count(timer, 1);
+    } else {
+        if (event.state == KEYPAD_PRESS) {
+            event.state = KEYPAD_RELEASE;
+            lv_event_send(lv_scr_act(), EVENT_KEYPAD, (void*) &event);
+        } else if (event.state == KEYPAD_LONG) {
+            event.state = KEYPAD_LONG_RELEASE;
+            lv_event_send(lv_scr_act(), EVENT_KEYPAD, (void*) &event);
+        }
+    }
 }
 
 keypad_t * keypad_init(char *dev_name) {
-    int fd = open(dev_name, O_RDWR | O_NOCTTY | O_NDELAY);
+    int fd = input_open(dev_name);
 
     if (fd == -1) {
-        perror("unable to open keypad interface:");
-
         return NULL;
     }
 
-    fcntl(fd, F_SETFL, O_ASYNC | O_NONBLOCK);
-
     keypad_t *keypad = malloc(sizeof(keypad_t));
 
+    memset(keypad, 0, sizeof(keypad_t));
     keypad->fd = fd;
+    keypad->evdev_state = LV_INDEV_STATE_RELEASED;
 
     lv_indev_drv_init(&keypad->indev_drv);
 
@@ -215,6 +242,7 @@ keypad_t * keypad_init(char *dev_name) {
 
 
     lv_indev_set_group(keypad->indev, keyboard_group);
+    input_add(fd, keypad->indev, keypad_handle, keypad);
 
     return keypad;
 }
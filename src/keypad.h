@@ -12,6 +12,13 @@
 #include "lvgl/lvgl.h"
 #include "events.h"
 
+#define KEYPAD_QUEUE    8
+
+typedef struct {
+    uint32_t        key;
+    int             state;
+} keypad_indev_key_t;
+
 typedef struct {
     int             fd;
     
@@ -20,6 +27,11 @@ typedef struct {
     
     int             evdev_state;
     int             evdev_key;
+
+    /* Key changes for the indev, so a short press isn't lost between reads */
+    keypad_indev_key_t  queue[KEYPAD_QUEUE];
+    uint8_t             queue_head;
+    uint8_t             queue_count;
 } keypad_t;
 
 keypad_t * keypad_init(char *dev_name);
@@ -0,0 +1,69 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "label_text.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    lv_obj_t            *label;
+    ObserverDelayed     *observer;
+    label_text_format_t format;
+    void                *user_data;
+} binding_t;
+
+bool label_text_set(lv_obj_t *label, const char *text) {
+    const char *cur = lv_label_get_text(label);
+
+    if (cur && strcmp(cur, text) == 0) {
+        return false;
+    }
+    lv_label_set_text(label, text);
+    return true;
+}
+
+bool label_text_set_fmt(lv_obj_t *label, const char *fmt, ...) {
+    char    buf[LABEL_TEXT_MAX];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    return label_text_set(label, buf);
+}
+
+static void on_subject_change(Subject *subj, void *user_data) {
+    binding_t   *binding = (binding_t *) user_data;
+    char        buf[LABEL_TEXT_MAX];
+
+    buf[0] = '\0';
+    binding->format(subj, buf, sizeof(buf), binding->user_data);
+    label_text_set(binding->label, buf);
+}
+
+static void on_label_delete(lv_event_t *e) {
+    binding_t *binding = (binding_t *) lv_event_get_user_data(e);
+
+    observer_delayed_del(binding->observer);
+    free(binding);
+}
+
+void label_text_bind(lv_obj_t *label, Subject *subj, label_text_format_t format, void *user_data) {
+    binding_t *binding = malloc(sizeof(binding_t));
+
+    binding->label = label;
+    binding->format = format;
+    binding->user_data = user_data;
+    binding->observer = subject_add_delayed_observer_and_call(subj, on_subject_change, binding);
+
+    lv_obj_add_event_cb(label, on_label_delete, LV_EVENT_DELETE, binding);
+}
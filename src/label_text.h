@@ -0,0 +1,49 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "cfg/subjects.h"
+
+#include "lvgl/lvgl.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Text of the frequently updated labels. lv_label_set_text() measures the text
+ * and invalidates the label even if it didn't change, so the new text is
+ * compared with the one the label keeps and set only on change. UI thread.
+ */
+
+#define LABEL_TEXT_MAX  128
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Format the label text from the subject to buf of LABEL_TEXT_MAX
+ */
+typedef void (*label_text_format_t)(Subject *subj, char *buf, size_t size, void *user_data);
+
+/**
+ * Set the text if it differs. Returns true if it was set
+ */
+bool label_text_set(lv_obj_t *label, const char *text);
+bool label_text_set_fmt(lv_obj_t *label, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * Keep the label text formatted from the subject, it's set now and on the
+ * changes. The observer is removed with the label
+ */
+void label_text_bind(lv_obj_t *label, Subject *subj, label_text_format_t format, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
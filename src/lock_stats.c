@@ -0,0 +1,294 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "lock_stats.h"
+
+#if LOCK_STATS
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define OWNERS      256
+#define HELD_MAX    8
+
+typedef struct {
+    _Atomic(const char *)   name;
+    atomic_uint             acquisitions;
+    atomic_uint             contended;
+    atomic_uint             wait_hist[LOCK_STATS_BUCKETS];
+    atomic_ullong           wait_sum_us;
+    atomic_uint             wait_max_us;
+    atomic_int              wait_max_owner;
+    atomic_uint             hold_max_us;
+    atomic_int              hold_max_owner;
+} entry_t;
+
+/* Current holder of a mutex, by address hash. A collision only loses the owner */
+typedef struct {
+    _Atomic(pthread_mutex_t *)  mutex;
+    atomic_int                  tid;
+} owner_t;
+
+typedef struct {
+    pthread_mutex_t *mutex;
+    uint64_t        since;
+} held_t;
+
+static entry_t          entries[LOCK_STATS_MAX];
+static owner_t          owners[OWNERS];
+
+static __thread held_t  held[HELD_MAX];
+static __thread uint8_t held_count = 0;
+static __thread int32_t self_tid = 0;
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int32_t tid() {
+    if (!self_tid) {
+        self_tid = syscall(SYS_gettid);
+    }
+    return self_tid;
+}
+
+static owner_t * owner_slot(pthread_mutex_t *mutex) {
+    uintptr_t x = (uintptr_t) mutex;
+
+    return &owners[((x >> 4) ^ (x >> 12)) % OWNERS];
+}
+
+/**
+ * Entry of the name, a free one is taken on the first use. NULL when all are taken
+ */
+static entry_t * entry_get(const char *name) {
+    for (uint8_t i = 0; i < LOCK_STATS_MAX; i++) {
+        entry_t     *e = &entries[i];
+        const char  *cur = atomic_load(&e->name);
+
+        if (!cur) {
+            const char *expected = NULL;
+
+            if (atomic_compare_exchange_strong(&e->name, &expected, name)) {
+                return e;
+            }
+            cur = expected;
+        }
+        if (cur == name || strcmp(cur, name) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void update_max(atomic_uint *max, atomic_int *owner, uint32_t v, int32_t tid) {
+    uint32_t cur = atomic_load_explicit(max, memory_order_relaxed);
+
+    while (v > cur) {
+        if (atomic_compare_exchange_weak_explicit(max, &cur, v, memory_order_relaxed, memory_order_relaxed)) {
+            atomic_store_explicit(owner, tid, memory_order_relaxed);
+            break;
+        }
+    }
+}
+
+static uint8_t bucket(uint64_t us) {
+    uint8_t b = 0;
+
+    while (us && b < LOCK_STATS_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void hold_start(pthread_mutex_t *mutex) {
+    owner_t *owner = owner_slot(mutex);
+
+    atomic_store_explicit(&owner->mutex, mutex, memory_order_relaxed);
+    atomic_store_explicit(&owner->tid, tid(), memory_order_relaxed);
+
+    if (held_count < HELD_MAX) {
+        held[held_count].mutex = mutex;
+        held[held_count].since = now_us();
+        held_count++;
+    }
+}
+
+static void hold_end(pthread_mutex_t *mutex, entry_t *e) {
+    owner_t *owner = owner_slot(mutex);
+
+    atomic_store_explicit(&owner->tid, 0, memory_order_relaxed);
+
+    for (int i = held_count - 1; i >= 0; i--) {
+        if (held[i].mutex == mutex) {
+            if (e) {
+                update_max(&e->hold_max_us, &e->hold_max_owner, now_us() - held[i].since, tid());
+            }
+            held[i] = held[--held_count];
+            break;
+        }
+    }
+}
+
+void lock_stats_lock(pthread_mutex_t *mutex, const char *name) {
+    entry_t *e = entry_get(name);
+
+    if (pthread_mutex_trylock(mutex) == 0) {
+        if (e) {
+            atomic_fetch_add_explicit(&e->acquisitions, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&e->wait_hist[0], 1, memory_order_relaxed);
+        }
+        hold_start(mutex);
+        return;
+    }
+
+    owner_t *owner = owner_slot(mutex);
+    int32_t holder = 0;
+
+    if (atomic_load_explicit(&owner->mutex, memory_order_relaxed) == mutex) {
+        holder = atomic_load_explicit(&owner->tid, memory_order_relaxed);
+    }
+
+    uint64_t start = now_us();
+
+    pthread_mutex_lock(mutex);
+
+    uint64_t wait = now_us() - start;
+
+    if (e) {
+        atomic_fetch_add_explicit(&e->acquisitions, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&e->contended, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&e->wait_hist[bucket(wait)], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&e->wait_sum_us, wait, memory_order_relaxed);
+        update_max(&e->wait_max_us, &e->wait_max_owner, wait, holder);
+    }
+    hold_start(mutex);
+}
+
+void lock_stats_unlock(pthread_mutex_t *mutex, const char *name) {
+    hold_end(mutex, entry_get(name));
+    pthread_mutex_unlock(mutex);
+}
+
+int lock_stats_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name) {
+    hold_end(mutex, entry_get(name));
+
+    int res = pthread_cond_wait(cond, mutex);
+
+    hold_start(mutex);
+    return res;
+}
+
+int lock_stats_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name,
+                              const struct timespec *abstime)
+{
+    hold_end(mutex, entry_get(name));
+
+    int res = pthread_cond_timedwait(cond, mutex, abstime);
+
+    hold_start(mutex);
+    return res;
+}
+
+size_t lock_stats_get(lock_stats_t *out, size_t max, bool reset) {
+    size_t n = 0;
+
+    for (uint8_t i = 0; i < LOCK_STATS_MAX && n < max; i++) {
+        entry_t         *e = &entries[i];
+        lock_stats_t    *s = &out[n];
+
+        s->name = atomic_load(&e->name);
+
+        if (!s->name) {
+            break;
+        }
+
+        if (reset) {
+            s->acquisitions = atomic_exchange(&e->acquisitions, 0);
+            s->contended = atomic_exchange(&e->contended, 0);
+            s->wait_sum_us = atomic_exchange(&e->wait_sum_us, 0);
+            s->wait_max_us = atomic_exchange(&e->wait_max_us, 0);
+            s->hold_max_us = atomic_exchange(&e->hold_max_us, 0);
+
+            for (uint8_t b = 0; b < LOCK_STATS_BUCKETS; b++) {
+                s->wait_hist[b] = atomic_exchange(&e->wait_hist[b], 0);
+            }
+        } else {
+            s->acquisitions = atomic_load(&e->acquisitions);
+            s->contended = atomic_load(&e->contended);
+            s->wait_sum_us = atomic_load(&e->wait_sum_us);
+            s->wait_max_us = atomic_load(&e->wait_max_us);
+            s->hold_max_us = atomic_load(&e->hold_max_us);
+
+            for (uint8_t b = 0; b < LOCK_STATS_BUCKETS; b++) {
+                s->wait_hist[b] = atomic_load(&e->wait_hist[b]);
+            }
+        }
+        s->wait_max_owner = atomic_load(&e->wait_max_owner);
+        s->hold_max_owner = atomic_load(&e->hold_max_owner);
+        n++;
+    }
+    return n;
+}
+
+static void thread_name(int32_t tid, char *name, size_t size) {
+    char path[64];
+
+    snprintf(path, sizeof(path), "/proc/self/task/%i/comm", tid);
+
+    FILE *f = tid ? fopen(path, "r") : NULL;
+
+    if (f && fgets(name, size, f)) {
+        name[strcspn(name, "\n")] = 0;
+    } else {
+        snprintf(name, size, tid ? "%i" : "?", tid);
+    }
+    if (f) {
+        fclose(f);
+    }
+}
+
+size_t lock_stats_format(char *buf, size_t size) {
+    lock_stats_t    stats[LOCK_STATS_MAX];
+    size_t          n = lock_stats_get(stats, LOCK_STATS_MAX, true);
+    size_t          len = 0;
+
+    for (size_t i = 0; i < n && len < size; i++) {
+        lock_stats_t    *s = &stats[i];
+        char            wait_owner[16];
+        char            hold_owner[16];
+        uint32_t        slow = 0;
+
+        if (!s->contended) {
+            continue;
+        }
+
+        /* From 1 ms */
+        for (uint8_t b = 11; b < LOCK_STATS_BUCKETS; b++) {
+            slow += s->wait_hist[b];
+        }
+        thread_name(s->wait_max_owner, wait_owner, sizeof(wait_owner));
+        thread_name(s->hold_max_owner, hold_owner, sizeof(hold_owner));
+
+        len += snprintf(buf + len, size - len,
+                        "lock %-9s %u acq, %u cont, wait %u/%u us (%s), >1 ms %u, hold max %u us (%s)\n",
+                        s->name, s->acquisitions, s->contended, (uint32_t) (s->wait_sum_us / s->contended),
+                        s->wait_max_us, wait_owner, slow, s->hold_max_us, hold_owner);
+    }
+    return len < size ? len : size;
+}
+
+#endif
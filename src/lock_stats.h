@@ -0,0 +1,121 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Contention of the shared locks, for profiling builds (cmake -DLOCK_STATS=ON).
+ * Locks are counted by name, the mutexes of one name (every Subject) are summed.
+ * A lock is first tried, a failed try is a contended acquisition and the wait
+ * goes to a log2 histogram of us. The hold time is measured from the
+ * acquisition to the unlock, a cond wait ends the hold. The owner is the
+ * thread that held the mutex at the longest wait, and the one with the longest
+ * hold. Without LOCK_STATS the calls are the plain pthread ones.
+ */
+
+#define LOCK_STATS_MAX      32
+#define LOCK_STATS_BUCKETS  16          /* < 1 us, < 2 us, ... >= 16 ms */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char  *name;
+    uint32_t    acquisitions;
+    uint32_t    contended;
+    uint32_t    wait_hist[LOCK_STATS_BUCKETS];
+    uint64_t    wait_sum_us;
+    uint32_t    wait_max_us;
+    int32_t     wait_max_owner;         /* Holder tid at the longest wait, 0 if unknown */
+    uint32_t    hold_max_us;
+    int32_t     hold_max_owner;
+} lock_stats_t;
+
+#if LOCK_STATS
+
+void lock_stats_lock(pthread_mutex_t *mutex, const char *name);
+void lock_stats_unlock(pthread_mutex_t *mutex, const char *name);
+int lock_stats_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name);
+int lock_stats_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name,
+                              const struct timespec *abstime);
+
+/**
+ * Copy of the named locks, up to max. Returns their number
+ */
+size_t lock_stats_get(lock_stats_t *out, size_t max, bool reset);
+
+/**
+ * Contended locks as text lines for perf_stats, the counters are reset
+ */
+size_t lock_stats_format(char *buf, size_t size);
+
+#else
+
+static inline void lock_stats_lock(pthread_mutex_t *mutex, const char *name) {
+    pthread_mutex_lock(mutex);
+}
+
+static inline void lock_stats_unlock(pthread_mutex_t *mutex, const char *name) {
+    pthread_mutex_unlock(mutex);
+}
+
+static inline int lock_stats_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name) {
+    return pthread_cond_wait(cond, mutex);
+}
+
+static inline int lock_stats_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name,
+                                            const struct timespec *abstime)
+{
+    return pthread_cond_timedwait(cond, mutex, abstime);
+}
+
+static inline size_t lock_stats_get(lock_stats_t *out, size_t max, bool reset) {
+    return 0;
+}
+
+static inline size_t lock_stats_format(char *buf, size_t size) {
+    return 0;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+
+#include <mutex>
+
+/**
+ * std::mutex counted under the name, for std::lock_guard
+ */
+class StatMutex {
+    std::mutex  mux;
+    const char  *name;
+
+public:
+    /* constexpr: static ones are ready before the dynamic initialization */
+    constexpr explicit StatMutex(const char *name) : name(name) {}
+
+    StatMutex(const StatMutex &) = delete;
+    StatMutex & operator=(const StatMutex &) = delete;
+
+#if LOCK_STATS
+    void lock() { lock_stats_lock(mux.native_handle(), name); }
+    void unlock() { lock_stats_unlock(mux.native_handle(), name); }
+#else
+    void lock() { mux.lock(); }
+    void unlock() { mux.unlock(); }
+#endif
+};
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#define _GNU_SOURCE
+
+#include "logger.h"
+
+#include "ring.h"
+#include "util.h"
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#define SLOTS           32              /* Threads with a ring at once */
+#define SLOT_RECORDS    64
+#define WRITER_PERIOD   100000          /* us */
+#define REPEAT_FLUSH_US 10000000        /* Report of folded repeats */
+
+typedef struct {
+    uint64_t    time;                   /* us, CLOCK_REALTIME */
+    uint8_t     level;
+    char        text[LOGGER_TEXT_LEN];
+} record_t;
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_USED,
+    SLOT_DEAD                           /* Thread is gone, the ring is drained by the writer */
+} slot_state_t;
+
+typedef struct {
+    atomic_int          state;
+    _Atomic(ring_t)     ring;           /* Kept for the next thread of the slot */
+    char                thread[16];
+
+    /* Writer side */
+    uint32_t            overruns;
+    char                last[LOGGER_TEXT_LEN];
+    uint8_t             last_level;
+    uint32_t            repeats;
+    uint64_t            repeat_time;
+} slot_t;
+
+static const char       *level_names[] = { "Trace", "Info", "Warn", "Error", "User" };
+
+static slot_t           slots[SLOTS];
+static __thread slot_t  *own_slot = NULL;
+static pthread_key_t    slot_key;
+static pthread_once_t   key_once = PTHREAD_ONCE_INIT;
+static atomic_uint      lost;           /* Records of threads without a slot */
+
+static pthread_mutex_t  drain_mux = PTHREAD_MUTEX_INITIALIZER;
+static char             *file_path = NULL;
+static FILE             *file = NULL;
+static long             file_size = 0;
+static uint64_t         rate_second = 0;
+static uint32_t         rate_lines = 0;
+static uint32_t         rate_dropped = 0;
+static uint32_t         lost_reported = 0;
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void slot_release(void *arg) {
+    slot_t *slot = arg;
+
+    own_slot = NULL;
+    atomic_store(&slot->state, SLOT_DEAD);
+}
+
+static void key_init() {
+    pthread_key_create(&slot_key, slot_release);
+}
+
+static slot_t * get_slot() {
+    if (own_slot) {
+        return own_slot;
+    }
+    pthread_once(&key_once, key_init);
+
+    for (int i = 0; i < SLOTS; i++) {
+        slot_t  *slot = &slots[i];
+        int     expected = SLOT_FREE;
+
+        if (!atomic_compare_exchange_strong(&slot->state, &expected, SLOT_USED)) {
+            continue;
+        }
+        if (!atomic_load(&slot->ring)) {
+            ring_t ring = ring_create(sizeof(record_t), SLOT_RECORDS);
+
+            if (!ring) {
+                atomic_store(&slot->state, SLOT_FREE);
+                return NULL;
+            }
+            atomic_store(&slot->ring, ring);
+        }
+        prctl(PR_GET_NAME, slot->thread, 0, 0, 0);
+        pthread_setspecific(slot_key, slot);
+        own_slot = slot;
+
+        return slot;
+    }
+    return NULL;
+}
+
+void logger_vwrite(logger_level_t level, const char *fmt, va_list ap) {
+    slot_t *slot = get_slot();
+
+    if (!slot) {
+        atomic_fetch_add(&lost, 1);
+        return;
+    }
+
+    ring_t      ring = atomic_load_explicit(&slot->ring, memory_order_relaxed);
+    record_t    *rec = ring_reserve(ring);
+
+    if (!rec) {
+        return;     /* Counted as overrun of the ring */
+    }
+    rec->time = now_us();
+    rec->level = level;
+    vsnprintf(rec->text, sizeof(rec->text), fmt, ap);
+    ring_commit(ring);
+}
+
+void logger_write(logger_level_t level, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    logger_vwrite(level, fmt, ap);
+    va_end(ap);
+}
+
+/**
+ * LVGL line: "[Level]\t(sec.ms, +delta)\t func: text \t(in file line #N)\n".
+ * The level goes to the record, the tick time is replaced by the record time
+ */
+static void lvgl_print_cb(const char *buf) {
+    logger_level_t  level = LOGGER_USER;
+    const char      *text = buf;
+
+    for (int i = 0; i <= LOGGER_USER; i++) {
+        size_t len = strlen(level_names[i]);
+
+        if (buf[0] == '[' && strncmp(buf + 1, level_names[i], len) == 0 && buf[len + 1] == ']') {
+            level = i;
+            break;
+        }
+    }
+
+    const char *tick = strstr(buf, ")\t ");
+
+    if (tick) {
+        text = tick + 3;
+    }
+
+    size_t len = strlen(text);
+
+    while (len && (text[len - 1] == '\n' || text[len - 1] == ' ')) {
+        len--;
+    }
+    logger_write(level, "%.*s", (int) len, text);
+}
+
+/* Writer side, under drain_mux */
+
+static void file_open() {
+    file = fopen(file_path, "a");
+
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        file_size = ftell(file);
+    }
+}
+
+static void file_rotate() {
+    char old_path[256];
+
+    fclose(file);
+    file = NULL;
+
+    snprintf(old_path, sizeof(old_path), "%s.1", file_path);
+    rename(file_path, old_path);
+    file_open();
+}
+
+static void emit(uint64_t time, uint8_t level, const char *thread, const char *text) {
+    char        line[LOGGER_TEXT_LEN + 64];
+    time_t      sec = time / 1000000;
+    struct tm   tm;
+    int         n;
+
+    localtime_r(&sec, &tm);
+    n = strftime(line, sizeof(line), "%Y-%m-%d %H:%M:%S", &tm);
+    n += snprintf(line + n, sizeof(line) - n, ".%03u [%s] %s: %s\n",
+                  (unsigned) (time / 1000 % 1000), level_names[level], thread, text);
+
+    if (n >= (int) sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+
+    fputs(line, stdout);
+
+    if (file) {
+        fputs(line, file);
+        file_size += n;
+
+        if (file_size > LOGGER_FILE_MAX) {
+            file_rotate();
+        }
+    }
+}
+
+static void flush_repeats(slot_t *slot, uint64_t time) {
+    if (slot->repeats) {
+        char text[64];
+
+        snprintf(text, sizeof(text), "Last line repeated %u times", slot->repeats);
+        emit(time, slot->last_level, slot->thread, text);
+        slot->repeats = 0;
+    }
+}
+
+static void put_record(slot_t *slot, const record_t *rec) {
+    if (strcmp(slot->last, rec->text) == 0) {
+        if (!slot->repeats) {
+            slot->repeat_time = rec->time;
+        }
+        slot->repeats++;
+        return;
+    }
+    flush_repeats(slot, rec->time);
+
+    strcpy(slot->last, rec->text);
+    slot->last_level = rec->level;
+
+    uint64_t second = rec->time / 1000000;
+
+    if (second != rate_second) {
+        if (rate_dropped) {
+            char text[64];
+
+            snprintf(text, sizeof(text), "%u lines dropped over the rate limit", rate_dropped);
+            emit(rec->time, LOGGER_WARN, "logger", text);
+        }
+        rate_second = second;
+        rate_lines = 0;
+        rate_dropped = 0;
+    }
+    if (rate_lines++ >= LOGGER_RATE_MAX) {
+        rate_dropped++;
+        return;
+    }
+    emit(rec->time, rec->level, slot->thread, rec->text);
+}
+
+static void drain() {
+    while (true) {
+        slot_t      *next = NULL;
+        record_t    *next_rec = NULL;
+
+        /* Oldest head of all rings */
+        for (int i = 0; i < SLOTS; i++) {
+            slot_t  *slot = &slots[i];
+            ring_t  ring = atomic_load(&slot->ring);
+
+            if (atomic_load(&slot->state) == SLOT_FREE || !ring) {
+                continue;
+            }
+
+            record_t *rec = ring_peek(ring);
+
+            if (rec && (!next_rec || rec->time < next_rec->time)) {
+                next = slot;
+                next_rec = rec;
+            }
+        }
+
+        if (!next) {
+            break;
+        }
+        put_record(next, next_rec);
+        ring_release(atomic_load(&next->ring));
+    }
+
+    uint64_t now = now_us();
+
+    for (int i = 0; i < SLOTS; i++) {
+        slot_t  *slot = &slots[i];
+        ring_t  ring = atomic_load(&slot->ring);
+        int     state = atomic_load(&slot->state);
+
+        if (state == SLOT_FREE || !ring) {
+            continue;
+        }
+
+        uint32_t overruns = ring_get_overruns(ring);
+
+        if (overruns != slot->overruns) {
+            char text[64];
+
+            snprintf(text, sizeof(text), "%u records dropped, ring is full", overruns - slot->overruns);
+            emit(now, LOGGER_WARN, slot->thread, text);
+            slot->overruns = overruns;
+        }
+        if (slot->repeats && (now - slot->repeat_time > REPEAT_FLUSH_US || state == SLOT_DEAD)) {
+            flush_repeats(slot, now);
+        }
+        if (state == SLOT_DEAD && ring_used(ring) == 0) {
+            slot->last[0] = '\0';
+            atomic_store(&slot->state, SLOT_FREE);
+        }
+    }
+
+    uint32_t lost_now = atomic_load(&lost);
+
+    if (lost_now != lost_reported) {
+        char text[64];
+
+        snprintf(text, sizeof(text), "%u records lost, no free ring", lost_now - lost_reported);
+        emit(now, LOGGER_WARN, "logger", text);
+        lost_reported = lost_now;
+    }
+
+    fflush(stdout);
+
+    if (file) {
+        fflush(file);
+    }
+}
+
+void logger_flush() {
+    pthread_mutex_lock(&drain_mux);
+    drain();
+    pthread_mutex_unlock(&drain_mux);
+}
+
+static void * writer_thread(void *arg) {
+    set_thread_name("logger");
+
+    while (true) {
+        usleep(WRITER_PERIOD);
+        logger_flush();
+    }
+    return NULL;
+}
+
+void logger_init(const char *path) {
+    pthread_t thread;
+
+    lv_log_register_print_cb(lvgl_print_cb);
+
+    if (path) {
+        file_path = strdup(path);
+        file_open();
+
+        if (!file) {
+            logger_write(LOGGER_WARN, "Can't open log file %s", path);
+        }
+    }
+
+    pthread_create(&thread, NULL, writer_thread, NULL);
+    pthread_detach(thread);
+    atexit(logger_flush);
+}
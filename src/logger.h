@@ -0,0 +1,59 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdarg.h>
+
+/*
+ * Asynchronous logger, the backend of LV_LOG_*. A record is formatted into
+ * the ring of the calling thread, so logging from the radio or audio thread
+ * costs a vsnprintf and never blocks. The "logger" thread writes records of
+ * all threads in time order to stdout and to the log file, which is rotated
+ * at LOGGER_FILE_MAX.
+ *
+ * Repeats of a line of a thread are folded into a count, lines over
+ * LOGGER_RATE_MAX per second are dropped. Records of a full ring are dropped
+ * too, both are reported in the log.
+ */
+
+#define LOGGER_PATH         "/mnt/x6100.log"
+#define LOGGER_FILE_MAX     (512 * 1024)    /* The previous file is kept as .1 */
+#define LOGGER_RATE_MAX     50
+#define LOGGER_TEXT_LEN     240
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Same values as LV_LOG_LEVEL_* */
+typedef enum {
+    LOGGER_TRACE = 0,
+    LOGGER_INFO,
+    LOGGER_WARN,
+    LOGGER_ERROR,
+    LOGGER_USER,
+} logger_level_t;
+
+/**
+ * Register the LVGL print callback and start the writer. Call first in main(),
+ * records before it are lost. NULL path - stdout only
+ */
+void logger_init(const char *path);
+
+void logger_write(logger_level_t level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void logger_vwrite(logger_level_t level, const char *fmt, va_list ap);
+
+/**
+ * Write out pending records now, any thread
+ */
+void logger_flush();
+
+#ifdef __cplusplus
+}
+#endif
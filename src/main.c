@@ -9,7 +9,10 @@
 #include "lvgl/lvgl.h"
 #include "lv_drivers/display/fbdev.h"
 #include <unistd.h>
+#include <signal.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <sys/time.h>
 
@@ -21,13 +24,23 @@
 #include "util.h"
 #include "keyboard.h"
 #include "spectrum.h"
+#include "spectrum_hires.h"
 #include "waterfall.h"
 #include "keypad.h"
 #include "params/params.h"
 #include "audio.h"
+#include "recorder.h"
 #include "cw.h"
 #include "pannel.h"
 #include "cat.h"
+#include "cat_net.h"
+#include "pan_stream.h"
+#include "audio_stream.h"
+#include "iq_server.h"
+#include "dx_cluster.h"
+#include "psk_reporter.h"
+#include "band_activity.h"
+#include "display_snapshot.h"
 #include "rtty.h"
 #include "backlight.h"
 #include "events.h"
@@ -35,70 +48,241 @@
 #include "mfk.h"
 #include "vol.h"
 #include "qso_log.h"
+#include "contest.h"
 #include "scheduler.h"
+#include "threads.h"
+#include "rt_mem.h"
 #include "wifi.h"
 #include "usb_devices.h"
+#include "iq_capture.h"
+#include "governor.h"
+#include "main_loop.h"
+#include "perf_stats.h"
+#include "metrics.h"
+#include "soak.h"
+#include "trace.h"
+#include "profiler.h"
+#include "logger.h"
+#include "cfg/cfg.h"
+#include "fonts/font_pack.h"
 
-#define DISP_BUF_SIZE (800 * 480 * 4)
+#if SIMULATOR
+#include "sim/sdl.h"
+#endif
+
+/* 1 - LVGL rotates rendered areas, 0 - fbdev rotates them while copying to the panel */
+#ifndef DISP_SW_ROTATE
+#define DISP_SW_ROTATE 0
+#endif
+
+/*
+ * 0 - one full screen draw buffer, flushed in the UI thread.
+ * N - two draw buffers of 1/N screen, flushed by the fbdev thread while the next area renders
+ */
+#ifndef DISP_BUF_DIV
+#define DISP_BUF_DIV 10
+#endif
+
+#if DISP_BUF_DIV
+#define DISP_BUF_SIZE (800 * 480 / DISP_BUF_DIV)
+#else
+#define DISP_BUF_SIZE (800 * 480)
+#endif
 
 rotary_t                    *vol;
 encoder_t                   *mfk;
 
 static lv_color_t           buf[DISP_BUF_SIZE];
+#if DISP_BUF_DIV
+static lv_color_t           buf2[DISP_BUF_SIZE];
+#endif
 static lv_disp_draw_buf_t   disp_buf;
 static lv_disp_drv_t        disp_drv;
 
-void * tick_thread (void *args);
+#define BOOT_TIME_PATH "/tmp/boot_time.txt"
+
+static uint64_t             boot_prev;
+static FILE                 *boot_file;
+static uint8_t              boot_tail = 2;      /* "late" and "waterfall", they come in any order */
+
+/**
+ * Startup timing. CLOCK_MONOTONIC counts from the kernel start, so the
+ * first line shows how long it took to get to main()
+ */
+void boot_phase(const char *name) {
+    uint64_t now = get_time();
+
+    if (!boot_prev) {
+        boot_file = fopen(BOOT_TIME_PATH, "w");
+        boot_prev = now;
+    }
+
+    LV_LOG_USER("Boot %s: %llu ms (at %llu ms)", name, now - boot_prev, now);
+
+    if (boot_file) {
+        fprintf(boot_file, "%-16s %6llu ms %8llu ms\n", name, now - boot_prev, now);
+        fflush(boot_file);
+
+        if (strcmp(name, "late") == 0 || strcmp(name, "waterfall") == 0) {
+            if (--boot_tail == 0) {
+                fclose(boot_file);
+                boot_file = NULL;
+            }
+        }
+    }
+    boot_prev = now;
+}
+
+#if PGO_GENERATE
+extern void __gcov_dump(void);
+
+/**
+ * The instrumented build is stopped with SIGTERM after the workload, profiles are written here
+ */
+static void on_pgo_term(int sig) {
+    __gcov_dump();
+    _exit(0);
+}
+#endif
+
+static void on_profiler_change(Subject *subj, void *user_data) {
+    profiler_enable(subject_get_int(subj));
+}
+
+/**
+ * Secondary subsystems, started after the first frame is on the panel and RX runs
+ */
+static void boot_late_cb(lv_timer_t *t) {
+#if !SIMULATOR
+    /* NetworkManager of the desktop is not ours */
+    wifi_power_setup();
+#endif
+    cat_init();
+    cat_net_init();
+    pan_stream_init();
+    audio_stream_init();
+    iq_server_init();
+    dx_cluster_init();
+    psk_reporter_init();
+    band_activity_init();
+    boot_phase("cat");
+    gps_init();
+    if (!qso_log_init()) {
+        LV_LOG_ERROR("Can't init QSO log");
+    }
+    contest_init();
+    qso_log_import_adif("/mnt/incoming_log.adi");
+    boot_phase("late");
+}
 
 int main(void) {
+    rt_mem_init();
+    logger_init(LOGGER_PATH);
+    boot_phase("main");
+    threads_apply("ui");
+    profiler_thread_start("ui");
+#if PGO_GENERATE
+    signal(SIGTERM, on_pgo_term);
+#endif
     lv_init();
     // lv_png_init();
 
+#if FONT_PACK
+    font_pack_init(FONT_PACK_PATH);
+#endif
+
+#if SIMULATOR
+    if (!sim_sdl_init()) {
+        return 1;
+    }
+#else
     fbdev_init();
+#endif
     audio_init();
     event_init();
     usb_devices_monitor_init();
+    boot_phase("lvgl, audio");
 
-    lv_disp_draw_buf_init(&disp_buf, buf, NULL, DISP_BUF_SIZE);
     lv_disp_drv_init(&disp_drv);
 
     disp_drv.draw_buf   = &disp_buf;
+#if SIMULATOR
+    disp_drv.flush_cb   = sim_sdl_flush;
+    disp_drv.hor_res    = 800;
+    disp_drv.ver_res    = 480;
+#elif DISP_SW_ROTATE
     disp_drv.flush_cb   = fbdev_flush;
     disp_drv.hor_res    = 480;
     disp_drv.ver_res    = 800;
     disp_drv.sw_rotate  = 1;
     disp_drv.rotated    = LV_DISP_ROT_90;
+#else
+    disp_drv.flush_cb   = fbdev_flush_rot90;
+    disp_drv.hor_res    = 800;
+    disp_drv.ver_res    = 480;
+#endif
 
-    lv_disp_drv_register(&disp_drv);
+#if SIMULATOR
+    lv_disp_draw_buf_init(&disp_buf, buf, NULL, DISP_BUF_SIZE);
+#elif DISP_BUF_DIV
+    lv_disp_draw_buf_init(&disp_buf, buf, buf2, DISP_BUF_SIZE);
+    fbdev_async_init(disp_drv.flush_cb);
+    disp_drv.flush_cb   = fbdev_flush_async;
+    disp_drv.wait_cb    = fbdev_flush_wait;
+#else
+    lv_disp_draw_buf_init(&disp_buf, buf, NULL, DISP_BUF_SIZE);
+#endif
+
+    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
 
     lv_disp_set_bg_color(lv_disp_get_default(), lv_color_black());
     lv_disp_set_bg_opa(lv_disp_get_default(), LV_OPA_COVER);
+    boot_phase("display");
 
     keyboard_init();
 
+    /* Devices are read by the input thread */
+#if SIMULATOR
+    keypad_init(SIM_KEYPAD);
+    rotary_init(SIM_VFO);
+
+    vol = rotary_init(SIM_VOL);
+    mfk = encoder_init(SIM_MFK);
+
+    sim_sdl_input_start();
+#else
     keypad_init("/dev/input/event0");
     keypad_init("/dev/input/event4");
-
     rotary_init("/dev/input/event1");
 
     vol = rotary_init("/dev/input/event2");
     mfk = encoder_init("/dev/input/event3");
+#endif
 
     vol->left[VOL_EDIT] = KEY_VOL_LEFT_EDIT;
     vol->right[VOL_EDIT] = KEY_VOL_RIGHT_EDIT;
 
     vol->left[VOL_SELECT] = KEY_VOL_LEFT_SELECT;
     vol->right[VOL_SELECT] = KEY_VOL_RIGHT_SELECT;
+    boot_phase("input");
 
     params_init();
+    boot_phase("params");
     audio_set_play_vol(params.play_gain_db_f.x);
     audio_set_rec_vol(params.rec_gain_db_f.x);
+    audio_profile_init();
+    recorder_init();
     mfk_change_mode(0);
     vol_change_mode(0);
     styles_init(params.theme.x);
+    boot_phase("styles");
 
+    spectrum_hires_init();
     dsp_init();
+    boot_phase("dsp");
     lv_obj_t *main_obj = main_screen();
+    display_snapshot_restore();
+    boot_phase("main screen");
 
     cw_init();
     rtty_init();
@@ -106,19 +290,17 @@ int main(void) {
         &main_screen_notify_tx,
         &main_screen_notify_rx
     );
-    wifi_power_setup();
+    boot_phase("radio");
     backlight_init();
-    cat_init();
-    // pannel_visible();
-    gps_init();
-    if (!qso_log_init()) {
-        LV_LOG_ERROR("Can't init QSO log");
-    }
-    qso_log_import_adif("/mnt/incoming_log.adi");
-
-    pthread_t thread;
-    pthread_create(&thread, NULL, tick_thread, NULL);
-    pthread_detach(thread);
+    iq_capture_boot();
+    governor_init();
+    rt_mem_watch();
+    trace_init(disp);
+    perf_stats_init(disp);
+    metrics_init();
+    soak_init();
+    subject_add_observer_and_call(cfg.profiler.val, on_profiler_change, NULL);
+    boot_phase("misc");
 
 #if 0
     lv_obj_set_style_bg_opa(lv_scr_act(), LV_OPA_0, 0);
@@ -126,26 +308,12 @@ int main(void) {
 #else
     lv_scr_load(main_obj);
 #endif
+    lv_refr_now(disp);
+    boot_phase("shown");
 
-    int64_t next_loop_time, sleep_time, loop_start_time;
-    while (1) {
-        loop_start_time = get_time();
-        observer_delayed_notify_all();
-        event_obj_check();
-        scheduler_work();
-        next_loop_time = lv_timer_handler() + loop_start_time;
-        sleep_time = next_loop_time - get_time();
-        if (sleep_time > 0) {
-            usleep(sleep_time * 1000);
-        }
-    }
-    return 0;
-}
+    lv_timer_t *late = lv_timer_create(boot_late_cb, 0, NULL);
+    lv_timer_set_repeat_count(late, 1);
 
-void * tick_thread (void *args)
-{
-      while(1) {
-        usleep(5 * 1000);    /*Sleep for 5 millisecond*/
-        lv_tick_inc(5);      /*Tell LVGL that 5 milliseconds were elapsed*/
-    }
+    main_loop_run();
+    return 0;
 }
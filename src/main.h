@@ -20,3 +20,8 @@ typedef enum {
 
 extern rotary_t     *vol;
 extern encoder_t    *mfk;
+
+/**
+ * Mark a boot phase in the startup timeline (/tmp/boot_time.txt)
+ */
+void boot_phase(const char *name);
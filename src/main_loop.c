@@ -0,0 +1,268 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "main_loop.h"
+
+#include "governor.h"
+#include "perf_stats.h"
+#include "soak.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include "scheduler.h"
+#include "cfg/cfg.h"
+#include "cfg/subjects.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_INPUTS      8
+#define MAX_FDS         4
+#define ID_SCHEDULER    0
+#define ID_TIMER        1
+#define ID_FD           2
+#define INPUT_HOLD_MS   1500    /* Keep polling after activity, covers long press and release */
+
+typedef struct {
+    lv_indev_t  *indev;
+    uint64_t    active_until;
+} input_t;
+
+typedef struct {
+    int                 fd;
+    main_loop_fd_cb_t   cb;
+    void                *arg;
+} fd_handler_t;
+
+static const char * phase_names[MAIN_LOOP_PHASE_LAST] = {
+    "observers", "scheduler", "lvgl", "sleep"
+};
+
+static int                      epoll_fd = -1;
+static int                      timer_fd = -1;
+static input_t                  inputs[MAX_INPUTS];
+static uint8_t                  inputs_count = 0;
+static fd_handler_t             fds[MAX_FDS];
+static uint8_t                  fds_count = 0;
+static uint32_t                 hist[MAIN_LOOP_PHASE_LAST][MAIN_LOOP_HIST_BUCKETS];
+static volatile sig_atomic_t    dump_req = 0;
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void hist_put(main_loop_phase_t phase, uint64_t us) {
+    uint8_t bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+    if (bucket >= MAIN_LOOP_HIST_BUCKETS) {
+        bucket = MAIN_LOOP_HIST_BUCKETS - 1;
+    }
+    hist[phase][bucket]++;
+}
+
+static void on_sigusr1(int sig) {
+    dump_req = 1;
+}
+
+static void epoll_add(int fd, uint32_t id) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = id };
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LV_LOG_ERROR("epoll_ctl(%i): %s", fd, strerror(errno));
+    }
+}
+
+static void init() {
+    if (epoll_fd >= 0) {
+        return;
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    epoll_add(scheduler_wake_fd(), ID_SCHEDULER);
+    epoll_add(timer_fd, ID_TIMER);
+
+    signal(SIGUSR1, on_sigusr1);
+}
+
+static void arm_timer(uint32_t ms) {
+    struct itimerspec spec;
+    struct timespec   now;
+
+    if (ms == LV_NO_TIMER_READY) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t ns = now.tv_nsec + (uint64_t) ms * 1000000L;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = now.tv_sec + ns / 1000000000L;
+    spec.it_value.tv_nsec = ns % 1000000000L;
+
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+static void input_wake(input_t *input, uint64_t now) {
+    lv_timer_t *timer = input->indev->driver->read_timer;
+
+    input->active_until = now + INPUT_HOLD_MS * 1000L;
+    lv_timer_resume(timer);
+    lv_timer_ready(timer);
+}
+
+static void inputs_idle(uint64_t now) {
+    for (uint8_t i = 0; i < inputs_count; i++) {
+        input_t *input = &inputs[i];
+
+        if (input->active_until && now > input->active_until) {
+            input->active_until = 0;
+            lv_timer_pause(input->indev->driver->read_timer);
+        }
+    }
+}
+
+void main_loop_add_input(lv_indev_t *indev) {
+    init();
+
+    if (inputs_count == MAX_INPUTS) {
+        LV_LOG_ERROR("Too many inputs");
+        return;
+    }
+
+    input_t *input = &inputs[inputs_count];
+
+    input->indev = indev;
+    input->active_until = 0;
+    lv_timer_pause(indev->driver->read_timer);
+
+    inputs_count++;
+}
+
+void main_loop_input_wake(lv_indev_t *indev) {
+    for (uint8_t i = 0; i < inputs_count; i++) {
+        if (inputs[i].indev == indev) {
+            input_wake(&inputs[i], now_us());
+            return;
+        }
+    }
+}
+
+void main_loop_add_fd(int fd, main_loop_fd_cb_t cb, void *arg) {
+    init();
+
+    if (fds_count == MAX_FDS) {
+        LV_LOG_ERROR("Too many fds");
+        return;
+    }
+
+    fd_handler_t *handler = &fds[fds_count];
+
+    handler->fd = fd;
+    handler->cb = cb;
+    handler->arg = arg;
+
+    epoll_add(fd, ID_FD + fds_count++);
+}
+
+void main_loop_run() {
+    struct epoll_event  events[ID_FD + MAX_FDS];
+
+    init();
+
+    while (1) {
+        uint64_t    t0 = now_us();
+
+        governor_ui_begin();
+        observer_delayed_notify_all();
+
+        uint64_t    t1 = now_us();
+
+        scheduler_work();
+
+        uint64_t    t2 = now_us();
+        uint32_t    next = lv_timer_handler();
+        uint64_t    t3 = now_us();
+
+        governor_ui_end();
+        inputs_idle(t3);
+
+        hist_put(MAIN_LOOP_PHASE_OBSERVERS, t1 - t0);
+        hist_put(MAIN_LOOP_PHASE_SCHEDULER, t2 - t1);
+        hist_put(MAIN_LOOP_PHASE_LVGL, t3 - t2);
+
+        if (perf_stats_enabled()) {
+            perf_stats_loop(t2 - t1, t3 - t2);
+        }
+
+        if (soak_enabled()) {
+            soak_loop(t3 - t2);
+        }
+
+        if (dump_req) {
+            dump_req = 0;
+            main_loop_dump_stats();
+        }
+
+        arm_timer(next);
+
+        int n = epoll_wait(epoll_fd, events, ID_FD + MAX_FDS, -1);
+        uint64_t woke = now_us();
+
+        for (int i = 0; i < n; i++) {
+            uint32_t id = events[i].data.u32;
+
+            if (id == ID_SCHEDULER) {
+                scheduler_wake_ack();
+            } else if (id >= ID_FD) {
+                fd_handler_t *handler = &fds[id - ID_FD];
+
+                handler->cb(handler->fd, handler->arg);
+            } else {
+                uint64_t expirations;
+
+                if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                    LV_LOG_WARN("timerfd read: %s", strerror(errno));
+                }
+            }
+        }
+        hist_put(MAIN_LOOP_PHASE_SLEEP, woke - t3);
+    }
+}
+
+void main_loop_get_hist(main_loop_phase_t phase, uint32_t out[MAIN_LOOP_HIST_BUCKETS]) {
+    memcpy(out, hist[phase], sizeof(hist[phase]));
+}
+
+void main_loop_dump_stats() {
+    for (uint8_t p = 0; p < MAIN_LOOP_PHASE_LAST; p++) {
+        char    str[256];
+        size_t  len = 0;
+
+        for (uint8_t b = 0; b < MAIN_LOOP_HIST_BUCKETS; b++) {
+            len += snprintf(str + len, sizeof(str) - len, " %u", hist[p][b]);
+        }
+        LV_LOG_USER("%-9s (log2 us):%s", phase_names[p], str);
+    }
+    mem_stats_log();
+
+    if (subject_stats_enabled()) {
+        cfg_debug_dump_subjects("/tmp/subjects_stats.txt");
+    }
+    if (trace_enabled()) {
+        trace_dump(TRACE_PATH);
+    }
+}
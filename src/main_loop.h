@@ -0,0 +1,55 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+/*
+ * Event driven UI loop. Sleeps in epoll on event fds (udev monitor), the
+ * scheduler wakeup and a timerfd armed to the next LVGL deadline. Input
+ * devices are read by the input thread and wake the loop through the scheduler. SIGUSR1 dumps
+ * per-phase duration histograms to the log (and subject stats, if enabled).
+ */
+
+typedef enum {
+    MAIN_LOOP_PHASE_OBSERVERS = 0,
+    MAIN_LOOP_PHASE_SCHEDULER,
+    MAIN_LOOP_PHASE_LVGL,
+    MAIN_LOOP_PHASE_SLEEP,
+
+    MAIN_LOOP_PHASE_LAST
+} main_loop_phase_t;
+
+#define MAIN_LOOP_HIST_BUCKETS  16  /* log2 of us, last one is >= 32 ms */
+
+/**
+ * Manage read timer of the indev. It is paused while the device is idle
+ */
+void main_loop_add_input(lv_indev_t *indev);
+
+/**
+ * Read indev at once and keep polling it for a while. Called on the UI thread
+ */
+void main_loop_input_wake(lv_indev_t *indev);
+
+typedef void (*main_loop_fd_cb_t)(int fd, void *arg);
+
+/**
+ * Call cb on the UI thread as soon as fd is readable. The fd should be
+ * non-blocking, cb reads all pending data
+ */
+void main_loop_add_fd(int fd, main_loop_fd_cb_t cb, void *arg);
+
+/**
+ * Run loop, never returns
+ */
+void main_loop_run();
+
+void main_loop_get_hist(main_loop_phase_t phase, uint32_t hist[MAIN_LOOP_HIST_BUCKETS]);
+void main_loop_dump_stats();
@@ -20,6 +20,7 @@
 #include "clock.h"
 #include "cw_tune_ui.h"
 #include "info.h"
+#include "label_text.h"
 #include "meter.h"
 #include "band_info.h"
 #include "tx_info.h"
@@ -36,6 +37,7 @@
 #include "dialog_msg_cw.h"
 #include "dialog_msg_voice.h"
 #include "dialog_swrscan.h"
+#include "dialog_band_sweep.h"
 #include "dialog_ft8.h"
 #include "dialog_gps.h"
 #include "dialog_qth.h"
@@ -49,6 +51,8 @@
 #include "pubsub_ids.h"
 #include "cfg/mode.h"
 #include "cfg/memory.h"
+#include "memory_scan.h"
+#include "qso_log.h"
 
 #include <unistd.h>
 #include <stdint.h>
@@ -71,7 +75,7 @@ static lv_obj_t     *msg_tiny;
 static lv_obj_t     *meter;
 static lv_obj_t     *tx_info;
 
-static void freq_shift(int16_t diff);
+static void freq_shift(int16_t diff, uint32_t speed);
 static void next_freq_step(bool up);
 static void toggle_atu_enabled();
 
@@ -98,6 +102,11 @@ void mem_save(uint16_t id) {
     }
 }
 
+static void mem_scan_hit_cb(int32_t id) {
+    msg_update_text_fmt("Signal on memory %i", id);
+    voice_say_text_fmt("Memory %i", id);
+}
+
 static void toggle_atu_enabled() {
     bool new_atu_enabled = !subject_get_int(cfg.atu_enabled.val);
     subject_set_int(cfg.atu_enabled.val, new_atu_enabled);
@@ -138,6 +147,11 @@ void main_screen_start_app(press_action_t app_action) {
             voice_say_text_fmt("SWR scan window");
             break;
 
+        case ACTION_APP_BAND_SWEEP:
+            dialog_construct(dialog_band_sweep, obj);
+            voice_say_text_fmt("Band sweep window");
+            break;
+
         case ACTION_APP_FT8:
             dialog_construct(dialog_ft8, obj);
             voice_say_text_fmt("FT8 window");
@@ -195,6 +209,23 @@ void main_screen_action(press_action_t action) {
             clock_say_bat_info();
             break;
 
+        case ACTION_LOG_EXPORT:
+            qso_log_export_adif("/mnt/qso_log.adi");
+            break;
+
+        case ACTION_MEM_SCAN:
+            if (memory_scan_running()) {
+                memory_scan_stop();
+                msg_update_text_fmt("Memory scan stopped");
+                voice_say_text_fmt("Memory scan off");
+            } else if (memory_scan_start(1, MEM_HKEY_MAX_ID, mem_scan_hit_cb)) {
+                msg_update_text_fmt("Memory scan");
+                voice_say_text_fmt("Memory scan on");
+            } else {
+                msg_update_text_fmt("Nothing to scan");
+            }
+            break;
+
         case ACTION_STEP_UP:
             next_freq_step(true);
             break;
@@ -224,6 +255,7 @@ void main_screen_action(press_action_t action) {
         case ACTION_APP_SETTINGS:
         case ACTION_APP_RECORDER:
         case ACTION_APP_WIFI:
+        case ACTION_APP_BAND_SWEEP:
             main_screen_start_app(action);
             break;
 
@@ -639,6 +671,7 @@ static void main_screen_keypad_cb(lv_event_t * e) {
                 subject_set_int(freq_lock, !subject_get_int(freq_lock));
                 voice_say_text_fmt("Frequency %s", subject_get_int(freq_lock) ? "locked" : "unlocked");
             } else if (keypad->state == KEYPAD_LONG) {
+                params_flush();
                 radio_bb_reset();
                 exit(1);
             }
@@ -734,7 +767,7 @@ static void main_screen_hkey_cb(lv_event_t * e) {
         case HKEY_UP:
             if (hkey->state == HKEY_RELEASE) {
                 if (!subject_get_int(freq_lock)) {
-                    freq_shift(+1);
+                    freq_shift(+1, 0);
                 }
             } else if (hkey->state == HKEY_LONG) {
                 if (!band_lock) {
@@ -747,7 +780,7 @@ static void main_screen_hkey_cb(lv_event_t * e) {
         case HKEY_DOWN:
             if (hkey->state == HKEY_RELEASE) {
                 if (!subject_get_int(freq_lock)) {
-                    freq_shift(-1);
+                    freq_shift(-1, 0);
                 }
             } else if (hkey->state == HKEY_LONG) {
                 if (!band_lock) {
@@ -794,8 +827,12 @@ static void main_screen_update_cb(lv_event_t * e) {
     spectrum_clear();
 }
 
-static uint16_t freq_accel(uint16_t diff) {
-    if (diff < 3) {
+/* Detents per second, 3 and 6 detents per 30 ms indev read as before */
+#define ACCEL_SPEED_MID     100
+#define ACCEL_SPEED_HIGH    200
+
+static uint16_t freq_accel(uint32_t speed) {
+    if (speed < ACCEL_SPEED_MID) {
         return 1;
     }
 
@@ -804,21 +841,24 @@ static uint16_t freq_accel(uint16_t diff) {
             return 1;
 
         case FREQ_ACCEL_LITE:
-            return (diff < 6) ? 5 : 10;
+            return (speed < ACCEL_SPEED_HIGH) ? 5 : 10;
 
         case FREQ_ACCEL_STRONG:
-            return (diff < 6) ? 10 : 30;
+            return (speed < ACCEL_SPEED_HIGH) ? 10 : 30;
     }
     return 1;
 }
 
-static void freq_shift(int16_t diff) {
+/**
+ * Shift by diff steps, called once per UI frame with the coalesced detents
+ */
+static void freq_shift(int16_t diff, uint32_t speed) {
     if (subject_get_int(freq_lock)) {
         return;
     }
 
     int32_t freq = subject_get_int(cfg_cur.fg_freq);
-    int32_t df = diff * subject_get_int(cfg_cur.freq_step) * freq_accel(abs(diff));
+    int32_t df = diff * subject_get_int(cfg_cur.freq_step) * freq_accel(speed);
     freq = align_int(freq + df, abs(df));
     subject_set_int(cfg_cur.fg_freq, freq);
 
@@ -826,11 +866,10 @@ static void freq_shift(int16_t diff) {
 }
 
 static void main_screen_rotary_cb(lv_event_t * e) {
-    int32_t *diff = (int32_t *) lv_event_get_param(e);
+    event_rotary_t *event = (event_rotary_t *) lv_event_get_param(e);
 
-    freq_shift(*diff);
-    dialog_rotary(*diff);
-    free(diff);
+    freq_shift(event->diff, event->speed);
+    dialog_rotary(event->diff);
 }
 
 static void spectrum_key_cb(lv_event_t * e) {
@@ -839,13 +878,13 @@ static void spectrum_key_cb(lv_event_t * e) {
     switch (key) {
         case '-':
             if (!subject_get_int(freq_lock)) {
-                freq_shift(-1);
+                freq_shift(-1, 0);
             }
             break;
 
         case '=':
             if (!subject_get_int(freq_lock)) {
-                freq_shift(+1);
+                freq_shift(+1, 0);
             }
             break;
 
@@ -1144,9 +1183,9 @@ static void on_fg_freq_change(Subject *subj, void *user_data) {
 
         split_freq(f2, &mhz2, &khz2, &hz2);
 
-        lv_label_set_text_fmt(freq[1], "#%03X %i.%03i.%03i / %i.%03i.%03i", color, mhz, khz, hz, mhz2, khz2, hz2);
+        label_text_set_fmt(freq[1], "#%03X %i.%03i.%03i / %i.%03i.%03i", color, mhz, khz, hz, mhz2, khz2, hz2);
     } else {
-        lv_label_set_text_fmt(freq[1], "#%03X %i.%03i.%03i", color, mhz, khz, hz);
+        label_text_set_fmt(freq[1], "#%03X %i.%03i.%03i", color, mhz, khz, hz);
     }
 }
 
@@ -1170,8 +1209,8 @@ static void update_freq_boundaries(Subject *subj, void *user_data) {
     }
 
     split_freq(f - half_width, &mhz, &khz, &hz);
-    lv_label_set_text_fmt(freq[0], "#%03X %i.%03i", color, mhz, khz);
+    label_text_set_fmt(freq[0], "#%03X %i.%03i", color, mhz, khz);
 
     split_freq(f + half_width, &mhz, &khz, &hz);
-    lv_label_set_text_fmt(freq[2], "#%03X %i.%03i", color, mhz, khz);
+    label_text_set_fmt(freq[2], "#%03X %i.%03i", color, mhz, khz);
 }
@@ -0,0 +1,201 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "mem_pool.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define PAGES       (MEM_POOL_ARENA / MEM_POOL_PAGE)
+#define NO_PAGE     UINT16_MAX
+#define CLASSES     (sizeof(class_sizes) / sizeof(class_sizes[0]))
+
+/* From the sizes of LVGL objects, styles and short label texts */
+static const uint16_t   class_sizes[] = { 16, 24, 32, 48, 64, 96, 128, 192, 256 };
+
+typedef struct {
+    void        *free;          /* Freed blocks of the page */
+    uint16_t    used;
+    uint16_t    carved;         /* Blocks handed out at least once, the rest of the page is untouched */
+    uint16_t    next;           /* Partial pages of the class or free pages */
+    uint16_t    prev;
+    uint8_t     cls;
+} page_t;
+
+static uint8_t          *arena = NULL;
+static page_t           pages[PAGES];
+static uint16_t         partial[CLASSES];   /* Pages with a free block */
+static uint16_t         free_pages = NO_PAGE;
+static uint16_t         fresh = 0;          /* Pages from here were never used */
+static uint8_t          class_of[MEM_POOL_MAX_SIZE / 8 + 1];
+
+static mem_pool_stats_t stats;
+static pthread_mutex_t  mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t   init_once = PTHREAD_ONCE_INIT;
+
+static void init() {
+    void *p = mmap(NULL, MEM_POOL_ARENA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (p == MAP_FAILED) {
+        return;
+    }
+
+    uint8_t cls = 0;
+
+    for (size_t i = 0; i < sizeof(class_of); i++) {
+        while (class_sizes[cls] < i * 8) {
+            cls++;
+        }
+        class_of[i] = cls;
+    }
+    for (size_t i = 0; i < CLASSES; i++) {
+        partial[i] = NO_PAGE;
+    }
+    arena = p;
+}
+
+static void list_push(uint16_t *head, uint16_t id) {
+    pages[id].prev = NO_PAGE;
+    pages[id].next = *head;
+
+    if (*head != NO_PAGE) {
+        pages[*head].prev = id;
+    }
+    *head = id;
+}
+
+static void list_remove(uint16_t *head, uint16_t id) {
+    page_t *page = &pages[id];
+
+    if (page->prev != NO_PAGE) {
+        pages[page->prev].next = page->next;
+    } else {
+        *head = page->next;
+    }
+    if (page->next != NO_PAGE) {
+        pages[page->next].prev = page->prev;
+    }
+}
+
+static uint16_t page_take(uint8_t cls) {
+    uint16_t id;
+
+    if (free_pages != NO_PAGE) {
+        id = free_pages;
+        free_pages = pages[id].next;
+    } else if (fresh < PAGES) {
+        id = fresh++;
+    } else {
+        return NO_PAGE;
+    }
+
+    page_t *page = &pages[id];
+
+    page->free = NULL;
+    page->used = 0;
+    page->carved = 0;
+    page->cls = cls;
+
+    if (++stats.pages > stats.pages_max) {
+        stats.pages_max = stats.pages;
+    }
+    list_push(&partial[cls], id);
+    return id;
+}
+
+void * mem_pool_alloc(size_t size) {
+    if (size == 0 || size > MEM_POOL_MAX_SIZE) {
+        return NULL;
+    }
+    pthread_once(&init_once, init);
+
+    if (!arena) {
+        return NULL;
+    }
+
+    uint8_t     cls = class_of[(size + 7) / 8];
+    uint16_t    block = class_sizes[cls];
+    void        *p;
+
+    pthread_mutex_lock(&mux);
+
+    uint16_t id = partial[cls];
+
+    if (id == NO_PAGE) {
+        id = page_take(cls);
+
+        if (id == NO_PAGE) {
+            stats.overflows++;
+            pthread_mutex_unlock(&mux);
+            return NULL;
+        }
+    }
+
+    page_t *page = &pages[id];
+
+    if (page->free) {
+        p = page->free;
+        page->free = *(void **) p;
+    } else {
+        p = arena + (size_t) id * MEM_POOL_PAGE + page->carved * block;
+        page->carved++;
+    }
+
+    if (++page->used == MEM_POOL_PAGE / block) {
+        list_remove(&partial[cls], id);
+    }
+    stats.used += block;
+    stats.blocks++;
+
+    pthread_mutex_unlock(&mux);
+    return p;
+}
+
+void mem_pool_free(void *p) {
+    uint16_t    id = ((uint8_t *) p - arena) / MEM_POOL_PAGE;
+    page_t      *page = &pages[id];
+
+    pthread_mutex_lock(&mux);
+
+    uint16_t block = class_sizes[page->cls];
+
+    if (page->used == MEM_POOL_PAGE / block) {
+        list_push(&partial[page->cls], id);
+    }
+    *(void **) p = page->free;
+    page->free = p;
+
+    stats.used -= block;
+    stats.blocks--;
+
+    if (--page->used == 0) {
+        /* Back to the arena for any class */
+        list_remove(&partial[page->cls], id);
+        pages[id].next = free_pages;
+        free_pages = id;
+        stats.pages--;
+    }
+
+    pthread_mutex_unlock(&mux);
+}
+
+bool mem_pool_owns(const void *p) {
+    return arena && (const uint8_t *) p >= arena && (const uint8_t *) p < arena + MEM_POOL_ARENA;
+}
+
+size_t mem_pool_block_size(const void *p) {
+    uint16_t id = ((const uint8_t *) p - arena) / MEM_POOL_PAGE;
+
+    return class_sizes[pages[id].cls];
+}
+
+void mem_pool_stats(mem_pool_stats_t *out) {
+    pthread_mutex_lock(&mux);
+    *out = stats;
+    pthread_mutex_unlock(&mux);
+}
@@ -0,0 +1,56 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Size class pools for the small LVGL allocations (objects, styles, labels).
+ * Blocks of one class are carved from pages of a reserved arena, a page with
+ * no used blocks goes back to the arena and can serve any class, so churn of
+ * dialogs and table cells doesn't fragment the heap. Alloc and free are O(1).
+ * Bigger requests and requests over a full arena are for malloc. Any thread.
+ */
+
+#define MEM_POOL_MAX_SIZE   256
+#define MEM_POOL_PAGE       4096
+#define MEM_POOL_ARENA      (1024 * 1024)   /* Reserved, pages are touched on use */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t      pages;          /* Given to classes */
+    size_t      pages_max;
+    size_t      used;           /* Bytes of used blocks */
+    size_t      blocks;
+    uint32_t    overflows;      /* Requests which went to malloc on a full arena */
+} mem_pool_stats_t;
+
+/**
+ * Block of at least `size`, NULL if it's too big or the arena is full
+ */
+void * mem_pool_alloc(size_t size);
+void mem_pool_free(void *p);
+
+bool mem_pool_owns(const void *p);
+
+/**
+ * Usable size of the pool block
+ */
+size_t mem_pool_block_size(const void *p);
+
+void mem_pool_stats(mem_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
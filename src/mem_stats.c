@@ -0,0 +1,206 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "mem_stats.h"
+
+#include "mem_pool.h"
+#include "rt_mem.h"
+#include "lvgl/lvgl.h"
+
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+
+typedef struct {
+    atomic_size_t   cur;
+    atomic_size_t   peak;
+} counter_t;
+
+static counter_t            counters[MEM_TAG_LAST];
+
+static const char * const   tag_names[MEM_TAG_LAST] = {
+    "lvgl",
+    "waterfall",
+    "ft8",
+    "audio",
+    "scheduler",
+};
+
+static void account(mem_tag_t tag, size_t freed, size_t allocated) {
+    counter_t   *c = &counters[tag];
+    size_t      cur;
+
+    if (allocated >= freed) {
+        cur = atomic_fetch_add_explicit(&c->cur, allocated - freed, memory_order_relaxed) + allocated - freed;
+    } else {
+        cur = atomic_fetch_sub_explicit(&c->cur, freed - allocated, memory_order_relaxed) - (freed - allocated);
+    }
+
+    size_t peak = atomic_load_explicit(&c->peak, memory_order_relaxed);
+
+    while (cur > peak && !atomic_compare_exchange_weak_explicit(&c->peak, &peak, cur, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/* Waterfall, FT8 and audio buffers are big and used by the real-time paths */
+static void prefault(mem_tag_t tag, void *p, size_t size) {
+    if (tag != MEM_LVGL && tag != MEM_SCHEDULER) {
+        rt_mem_prefault(p, size);
+    }
+}
+
+static void failed(mem_tag_t tag, size_t size) {
+    LV_LOG_ERROR("Can't allocate %zu bytes for %s", size, tag_names[tag]);
+    mem_stats_log();
+}
+
+void * mem_alloc(mem_tag_t tag, size_t size) {
+    void *p = malloc(size);
+
+    if (p) {
+        account(tag, 0, malloc_usable_size(p));
+        prefault(tag, p, size);
+    } else if (size) {
+        failed(tag, size);
+    }
+    return p;
+}
+
+void * mem_calloc(mem_tag_t tag, size_t n, size_t size) {
+    void *p = calloc(n, size);
+
+    if (p) {
+        account(tag, 0, malloc_usable_size(p));
+        prefault(tag, p, n * size);
+    } else if (n && size) {
+        failed(tag, n * size);
+    }
+    return p;
+}
+
+void * mem_realloc(mem_tag_t tag, void *p, size_t size) {
+    size_t  old = malloc_usable_size(p);
+    void    *res = realloc(p, size);
+
+    if (res) {
+        account(tag, old, malloc_usable_size(res));
+    } else if (size) {
+        failed(tag, size);
+    } else {
+        account(tag, old, 0);
+    }
+    return res;
+}
+
+void mem_free(mem_tag_t tag, void *p) {
+    if (p) {
+        account(tag, malloc_usable_size(p), 0);
+        free(p);
+    }
+}
+
+/* Small LVGL blocks come from the size class pools, the rest from malloc */
+
+void * mem_lv_alloc(size_t size) {
+    void *p = mem_pool_alloc(size);
+
+    if (p) {
+        account(MEM_LVGL, 0, mem_pool_block_size(p));
+        return p;
+    }
+    return mem_alloc(MEM_LVGL, size);
+}
+
+void * mem_lv_realloc(void *p, size_t size) {
+    if (!p) {
+        return mem_lv_alloc(size);
+    }
+    if (!mem_pool_owns(p)) {
+        return mem_realloc(MEM_LVGL, p, size);
+    }
+
+    size_t old = mem_pool_block_size(p);
+
+    if (size <= old) {
+        return p;
+    }
+
+    void *res = mem_lv_alloc(size);
+
+    if (res) {
+        memcpy(res, p, old);
+        mem_lv_free(p);
+    }
+    return res;
+}
+
+void mem_lv_free(void *p) {
+    if (p && mem_pool_owns(p)) {
+        account(MEM_LVGL, mem_pool_block_size(p), 0);
+        mem_pool_free(p);
+    } else {
+        mem_free(MEM_LVGL, p);
+    }
+}
+
+void mem_stats_get(mem_tag_t tag, mem_stats_t *stats) {
+    stats->cur = atomic_load_explicit(&counters[tag].cur, memory_order_relaxed);
+    stats->peak = atomic_load_explicit(&counters[tag].peak, memory_order_relaxed);
+}
+
+const char * mem_stats_tag_name(mem_tag_t tag) {
+    return tag < MEM_TAG_LAST ? tag_names[tag] : "";
+}
+
+size_t mem_stats_format(char *buf, size_t size) {
+    static size_t   ram = 0;
+    size_t          len = 0;
+
+    if (!ram) {
+        struct sysinfo info;
+
+        if (sysinfo(&info) == 0) {
+            ram = (size_t) info.totalram * info.mem_unit;
+        }
+    }
+
+    for (uint8_t i = 0; i < MEM_TAG_LAST && len < size; i++) {
+        mem_stats_t s;
+
+        mem_stats_get(i, &s);
+        len += snprintf(buf + len, size - len, "mem %-9s %6zu KiB, peak %6zu KiB, %4.1f%% ram\n",
+                        tag_names[i], s.cur / 1024, s.peak / 1024, ram ? s.peak * 100.0f / ram : 0.0f);
+    }
+
+    mem_pool_stats_t pool;
+
+    mem_pool_stats(&pool);
+
+    /* Fill - used share of the pages given to classes, the rest is free blocks of partial pages */
+    if (len < size) {
+        len += snprintf(buf + len, size - len, "mem pool      %6zu KiB, peak %6zu KiB, fill %3zu%%, %zu blocks, %u overflows\n",
+                        pool.pages * MEM_POOL_PAGE / 1024, pool.pages_max * MEM_POOL_PAGE / 1024,
+                        pool.pages ? pool.used * 100 / (pool.pages * MEM_POOL_PAGE) : 100, pool.blocks, pool.overflows);
+    }
+    return LV_MIN(len, size);
+}
+
+void mem_stats_log() {
+    char    text[768];
+    char    *line = text;
+
+    mem_stats_format(text, sizeof(text));
+
+    for (char *end; (end = strchr(line, '\n')); line = end + 1) {
+        *end = 0;
+        LV_LOG_USER("%s", line);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Heap usage by subsystem. Big buffers are allocated with a tag, LVGL allocates
+ * through mem_lv_* (lv_conf.h), so lv_mem_monitor() is not needed with LV_MEM_CUSTOM.
+ * Sizes are malloc_usable_size(), current and peak per tag. Included by lv_mem.c,
+ * keep it free of LVGL headers.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MEM_LVGL = 0,
+    MEM_WATERFALL,
+    MEM_FT8,
+    MEM_AUDIO,
+    MEM_SCHEDULER,
+
+    MEM_TAG_LAST
+} mem_tag_t;
+
+typedef struct {
+    size_t  cur;
+    size_t  peak;
+} mem_stats_t;
+
+void * mem_alloc(mem_tag_t tag, size_t size);
+void * mem_calloc(mem_tag_t tag, size_t n, size_t size);
+void * mem_realloc(mem_tag_t tag, void *p, size_t size);
+void mem_free(mem_tag_t tag, void *p);
+
+void * mem_lv_alloc(size_t size);
+void * mem_lv_realloc(void *p, size_t size);
+void mem_lv_free(void *p);
+
+void mem_stats_get(mem_tag_t tag, mem_stats_t *stats);
+
+const char * mem_stats_tag_name(mem_tag_t tag);
+
+/**
+ * One line per tag with current and peak KiB and the share of the device RAM
+ */
+size_t mem_stats_format(char *buf, size_t size);
+
+/**
+ * mem_stats_format() to the log
+ */
+void mem_stats_log();
+
+#ifdef __cplusplus
+}
+#endif
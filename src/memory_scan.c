@@ -0,0 +1,189 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "memory_scan.h"
+
+#include "band_sweep.h"
+#include "cfg/cfg.h"
+#include "cfg/memory.h"
+#include "cfg/transverter.h"
+#include "meter.h"
+#include "radio.h"
+
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define TIMER_MS        50
+#define SETTLE_MS       40          /* Radio retune, the periods of it are skipped */
+#define SETTLE_PERIODS  ((SETTLE_MS + MEMORY_SCAN_PERIOD_MS - 1) / MEMORY_SCAN_PERIOD_MS)
+
+typedef enum {
+    SCAN_OFF = 0,
+    SCAN_HOP,
+    SCAN_HIT,
+} scan_state_t;
+
+typedef struct {
+    int32_t     radio_freq;         /* Without transverter shift */
+    uint8_t     memory;             /* Index in memories */
+} hop_t;
+
+const int32_t memory_scan_sql_levels[MEMORY_SCAN_SQL_LEVELS] = { S3, S5, S7, S9, S9_20 };
+
+/* UI thread */
+static cfg_memory_channel_t memories[MEMORY_SCAN_MAX];
+static lv_timer_t           *timer = NULL;
+static memory_scan_hit_t    hit_cb = NULL;
+static int32_t              start_fg_freq;
+
+/* Set by the UI thread before the scan starts */
+static hop_t                hops[MEMORY_SCAN_MAX];
+static uint8_t              hops_count;
+static x6100_vfo_t          vfo;
+static float                sql_db;
+
+/* Hops of the DSP and the return of the UI don't cross */
+static pthread_mutex_t      hop_mux = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int           state = SCAN_OFF;
+static atomic_uint          scan_gen = 0;
+static atomic_int           hit = -1;
+
+/* DSP thread */
+static unsigned             seen_gen = 0;
+static uint8_t              cur;
+static uint8_t              periods;
+
+static void scan_return() {
+    if (timer) {
+        lv_timer_del(timer);
+        timer = NULL;
+    }
+
+    pthread_mutex_lock(&hop_mux);
+    atomic_store(&state, SCAN_OFF);
+    radio_set_freq(subject_get_int(cfg_cur.fg_freq));
+    pthread_mutex_unlock(&hop_mux);
+}
+
+static void timer_cb(lv_timer_t *t) {
+    if (atomic_load_explicit(&state, memory_order_acquire) == SCAN_HIT) {
+        cfg_memory_channel_t *channel = &memories[hops[atomic_load(&hit)].memory];
+
+        lv_timer_del(timer);
+        timer = NULL;
+        atomic_store(&state, SCAN_OFF);
+
+        /* Radio follows the subjects from here */
+        cfg_memory_apply(channel);
+
+        if (hit_cb) {
+            hit_cb(channel->id);
+        }
+        return;
+    }
+
+    if (radio_get_state() != RADIO_RX || subject_get_int(cfg_cur.fg_freq) != start_fg_freq) {
+        scan_return();
+    }
+}
+
+bool memory_scan_start(int32_t from_id, int32_t to_id, memory_scan_hit_t cb) {
+    if (timer || band_sweep_hopping() || radio_get_state() != RADIO_RX) {
+        return false;
+    }
+
+    size_t count = cfg_memory_preload(from_id, to_id, memories, MEMORY_SCAN_MAX);
+
+    hops_count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t freq = memories[i].freq;
+
+        if (!radio_check_freq(freq)) {
+            continue;
+        }
+        hops[hops_count].radio_freq = freq - cfg_transverter_get_shift(freq);
+        hops[hops_count].memory = i;
+        hops_count++;
+    }
+
+    if (!hops_count) {
+        return false;
+    }
+
+    vfo = subject_get_int(cfg_cur.band->vfo.val);
+    sql_db = subject_get_int(cfg.mem_scan_sql.val);
+    start_fg_freq = subject_get_int(cfg_cur.fg_freq);
+    hit_cb = cb;
+
+    pthread_mutex_lock(&hop_mux);
+    radio_set_vfo_freq(vfo, hops[0].radio_freq);
+    atomic_fetch_add(&scan_gen, 1);
+    atomic_store_explicit(&state, SCAN_HOP, memory_order_release);
+    pthread_mutex_unlock(&hop_mux);
+
+    timer = lv_timer_create(timer_cb, TIMER_MS, NULL);
+    return true;
+}
+
+void memory_scan_stop() {
+    if (timer) {
+        scan_return();
+    }
+}
+
+bool memory_scan_running() {
+    return timer != NULL;
+}
+
+/* DSP thread */
+
+bool memory_scan_hopping() {
+    return atomic_load_explicit(&state, memory_order_relaxed) != SCAN_OFF;
+}
+
+void memory_scan_put_db(float db) {
+    scan_state_t    s = atomic_load_explicit(&state, memory_order_acquire);
+    unsigned        gen = atomic_load(&scan_gen);
+
+    if (gen != seen_gen) {
+        /* The UI has queued the first hop of a new scan */
+        seen_gen = gen;
+        cur = 0;
+        periods = 0;
+    }
+
+    if (s != SCAN_HOP || ++periods <= SETTLE_PERIODS) {
+        return;
+    }
+
+    if (db >= sql_db) {
+        int expected = SCAN_HOP;
+
+        atomic_store(&hit, cur);
+        atomic_compare_exchange_strong(&state, &expected, SCAN_HIT);
+        return;
+    }
+
+    if (hops_count > 1) {
+        cur = (cur + 1) % hops_count;
+        periods = 0;
+
+        pthread_mutex_lock(&hop_mux);
+
+        /* The UI may have returned the radio meanwhile */
+        if (atomic_load(&state) == SCAN_HOP) {
+            radio_set_vfo_freq(vfo, hops[cur].radio_freq);
+        }
+        pthread_mutex_unlock(&hop_mux);
+    } else {
+        periods = SETTLE_PERIODS;
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Memory channel scan. The channels are read from the DB once at start into
+ * RAM, then the DSP drives the hops: the radio freq is queued to the control
+ * thread, a few channel power periods are skipped for the radio to settle and
+ * the next one is compared with the squelch level. The scan stops on a channel
+ * above it, which is loaded as by the memory button. Only the freq is hopped,
+ * the power is of the current passband. No hops on TX, tuning or TX stops the
+ * scan and the radio returns to the VFO freq.
+ */
+
+#define MEMORY_SCAN_MAX         32
+#define MEMORY_SCAN_PERIOD_MS   20      /* Channel power period of the DSP while hopping */
+
+#define MEMORY_SCAN_SQL_LEVELS  5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Squelch levels, dB of the S-meter */
+extern const int32_t memory_scan_sql_levels[MEMORY_SCAN_SQL_LEVELS];
+
+typedef void (*memory_scan_hit_t)(int32_t id);
+
+/**
+ * Scan memories from_id..to_id, called on the UI thread. Returns false if
+ * there are no stored channels. The callback is called on the UI thread with
+ * the memory id when the scan stops on a signal
+ */
+bool memory_scan_start(int32_t from_id, int32_t to_id, memory_scan_hit_t hit_cb);
+void memory_scan_stop();
+bool memory_scan_running();
+
+/**
+ * The radio is away from the VFO freq, called by the DSP
+ */
+bool memory_scan_hopping();
+
+/**
+ * Channel power of a period while hopping, dB of the S-meter. Called by the DSP
+ */
+void memory_scan_put_db(float db);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,23 +13,39 @@
 #include "spectrum.h"
 #include "util.h"
 
+#include <stdatomic.h>
+
 #define NUM_ITEMS   7
 #define METER_PEAK_HOLD 1500
 #define METER_PEAK_SPEED 20
+#define SLICE_DB    3
+#define REDRAW_MS   50
+
+#define FRAME_PACK(db, p, noise)    ((uint64_t) (uint16_t) (db) | (uint64_t) (uint16_t) (p) << 16 | \
+                                     (uint64_t) (uint16_t) (noise) << 32)
 
 static int16_t          min_db = S1;
 static int16_t          max_db = S9_40;
 
-static int16_t          meter_db = S1;
-static int16_t          meter_db_raw = S1;
-static float            noise_level = S_MIN;
+/* Producer state, the DSP or a dialog */
+static float            meter_lpf = S1;
+static int16_t          peak = S1;
+static int64_t          peak_time;
+
+/*
+ * Published by producers, read by the redraw timer and CAT. The bar, the peak
+ * and the noise of an update are packed to one word, so the frame is never mixed
+ */
+static atomic_ullong    shared_frame = FRAME_PACK(S1, S1, S_MIN);
+static atomic_int       shared_db_raw = S1;
 
+/* Values of the last redraw, UI thread */
+static int16_t          meter_db = S1;
 static int16_t          meter_peak = S1;
-static int64_t          meter_peak_time;
-static int64_t          now;
+static float            noise_level = S_MIN;
 
-static bool             pre=false;
-static bool             att=false;
+static atomic_bool      pre = false;
+static atomic_bool      att = false;
 
 static lv_obj_t         *obj;
 
@@ -49,7 +65,7 @@ static s_item_t s_items[NUM_ITEMS] = {
 };
 
 static void on_bool_value_change(Subject *subj, void *user_data) {
-    *(bool*)user_data = subject_get_int(subj);
+    atomic_store((atomic_bool *) user_data, subject_get_int(subj));
 }
 
 static void meter_draw_cb(lv_event_t * e) {
@@ -65,7 +81,7 @@ static void meter_draw_cb(lv_event_t * e) {
     lv_coord_t w = lv_obj_get_width(obj) - 80;
     // lv_coord_t h = lv_obj_get_height(obj) - 1;
 
-    uint8_t     slice_db = 3;
+    uint8_t     slice_db = SLICE_DB;
     uint8_t     slices_total = (max_db - min_db) / slice_db;
     uint8_t     slice_w = w / slices_total;
     uint8_t     slice_spacing = slice_w * 2 / 10;
@@ -147,6 +163,35 @@ static void rx_cb(lv_event_t * e) {
 }
 
 
+static int16_t frame_get(uint64_t frame, uint8_t index) {
+    return (int16_t) (uint16_t) (frame >> (index * 16));
+}
+
+static int16_t slice(int16_t db) {
+    return (db - min_db + SLICE_DB) / SLICE_DB;
+}
+
+/**
+ * Redraw only when the bar, the peak or the noise color moved by a slice
+ */
+static void redraw_timer(lv_timer_t *t) {
+    uint64_t    frame = atomic_load_explicit(&shared_frame, memory_order_relaxed);
+    int16_t     db = frame_get(frame, 0);
+    int16_t     p = frame_get(frame, 1);
+    int16_t     noise = frame_get(frame, 2);
+
+    bool changed = slice(db) != slice(meter_db) || slice(p) != slice(meter_peak) ||
+                   slice(noise) != slice(noise_level);
+
+    meter_db = db;
+    meter_peak = p;
+    noise_level = noise;
+
+    if (changed && !lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_invalidate(obj);
+    }
+}
+
 lv_obj_t * meter_init(lv_obj_t * parent) {
     obj = lv_obj_create(parent);
 
@@ -161,36 +206,41 @@ lv_obj_t * meter_init(lv_obj_t * parent) {
     subject_add_delayed_observer(cfg_cur.att, on_bool_value_change, &att);
     on_bool_value_change(cfg_cur.att, &att);
 
+    lv_timer_create(redraw_timer, REDRAW_MS, NULL);
+
     return obj;
 }
 
 void meter_update(int16_t db, float beta) {
-    noise_level = spectrum_get_min();
-    if (att) {
+    float   noise = spectrum_get_min();
+    int64_t now;
+
+    if (atomic_load_explicit(&att, memory_order_relaxed)) {
         db += 14;
-        noise_level+= 14.0f;
+        noise += 14.0f;
     }
-    if (pre){
+    if (atomic_load_explicit(&pre, memory_order_relaxed)) {
         db -= 14;
-        noise_level -= 14.0f;
+        noise -= 14.0f;
     }
     if (db < min_db) {
         db = min_db;
     } else if (db > max_db) {
         db = max_db;
     }
-    meter_db_raw = db;
     now = get_time();
-    if (db > meter_peak) {
-        meter_peak = db;
-        meter_peak_time = now;
-    } else if (now - meter_peak_time > METER_PEAK_HOLD) {
-        meter_peak -= (now - meter_peak_time - METER_PEAK_HOLD) * METER_PEAK_SPEED / 1000;
+    if (db > peak) {
+        peak = db;
+        peak_time = now;
+    } else if (now - peak_time > METER_PEAK_HOLD) {
+        peak -= (now - peak_time - METER_PEAK_HOLD) * METER_PEAK_SPEED / 1000;
     }
-    meter_db = meter_db * beta + db * (1.0f - beta);
-    event_send(obj, LV_EVENT_REFRESH, NULL);
+    meter_lpf = meter_lpf * beta + db * (1.0f - beta);
+
+    atomic_store_explicit(&shared_db_raw, db, memory_order_relaxed);
+    atomic_store_explicit(&shared_frame, FRAME_PACK((int16_t) meter_lpf, peak, (int16_t) noise), memory_order_relaxed);
 }
 
 int16_t meter_get_raw_db() {
-    return meter_db_raw;
+    return atomic_load_explicit(&shared_db_raw, memory_order_relaxed);
 }
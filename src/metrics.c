@@ -0,0 +1,543 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#define _GNU_SOURCE
+
+#include "metrics.h"
+
+#include "audio.h"
+#include "audio_stream.h"
+#include "cat.h"
+#include "cfg/cfg.h"
+#include "governor.h"
+#include "iq_server.h"
+#include "mem_pool.h"
+#include "mem_stats.h"
+#include "pan_stream.h"
+#include "psk_reporter.h"
+#include "radio.h"
+#include "scheduler.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define COLLECT_MS      1000
+#define TEXT_SIZE       16384
+#define REQUEST_SIZE    1024
+#define METRICS_IFACE   "wlan0"
+#define FT8_BUCKETS     7
+
+/*
+ * Total of a counter which perf_stats can reset, then it starts from zero again.
+ * Counts between the last collection and a reset are lost, that is a second at most
+ */
+typedef struct {
+    uint64_t    last;
+    uint64_t    total;
+} counter_t;
+
+static const uint16_t   ft8_bucket_le[FT8_BUCKETS] = { 0, 1, 2, 5, 10, 20, 50 };
+static const char       *ft8_decoders[2] = { "main", "dual" };
+static const char       *lane_names[SCHEDULER_PRIO_LAST] = { "input", "radio", "display", "bulk" };
+static const char       *cat_bucket_le[CAT_LATENCY_BUCKETS - 1] = {
+    "0.0001", "0.00025", "0.0005", "0.001", "0.002", "0.005", "0.01", "0.02"
+};
+
+/* Written by the decode thread */
+static atomic_uint      ft8_slots[2];
+static atomic_uint      ft8_decodes[2];
+static atomic_uint      ft8_last[2];
+static atomic_uint      ft8_buckets[2][FT8_BUCKETS];
+
+/* UI thread */
+static long             clk_tck = 100;
+static counter_t        flow_packets, flow_late;
+static counter_t        cmd_queued, cmd_coalesced, cmd_executed;
+static counter_t        pan_rows, pan_sent, pan_dropped;
+static counter_t        cat_requests, cat_sum_us, cat_buckets[CAT_LATENCY_BUCKETS];
+
+static char             texts[2][TEXT_SIZE];
+static size_t           text_len[2];
+static uint8_t          back = 0;
+static size_t           len;
+
+/* Last complete text, read by the server thread */
+static pthread_mutex_t  text_mux = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t          front = 0;
+
+static void counter_update(counter_t *c, uint64_t val) {
+    c->total += val >= c->last ? val - c->last : val;
+    c->last = val;
+}
+
+static void put(const char *fmt, ...) {
+    va_list ap;
+
+    if (len >= TEXT_SIZE) {
+        return;
+    }
+    va_start(ap, fmt);
+    len += vsnprintf(texts[back] + len, TEXT_SIZE - len, fmt, ap);
+    va_end(ap);
+}
+
+static void header(const char *name, const char *type, const char *help) {
+    put("# HELP x6100_%s %s\n# TYPE x6100_%s %s\n", name, help, name, type);
+}
+
+/* Collector, on the UI thread */
+
+static void collect_threads() {
+    DIR             *dir = opendir("/proc/self/task");
+    struct dirent   *entry;
+
+    if (!dir) {
+        return;
+    }
+    header("thread_cpu_seconds_total", "counter", "CPU time of the thread");
+
+    while ((entry = readdir(dir))) {
+        char    path[64];
+        char    buf[512];
+        pid_t   tid = atoi(entry->d_name);
+
+        if (tid <= 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/self/task/%i/stat", tid);
+
+        FILE *f = fopen(path, "r");
+
+        if (!f) {
+            continue;
+        }
+
+        size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+
+        fclose(f);
+        buf[n] = 0;
+
+        /* pid (comm) state ..., utime and stime are fields 14 and 15 */
+        char                *name = strchr(buf, '(');
+        char                *end = strrchr(buf, ')');
+        unsigned long long  utime, stime;
+
+        if (!name || !end ||
+            sscanf(end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2)
+        {
+            continue;
+        }
+        put("x6100_thread_cpu_seconds_total{thread=\"%.*s\",tid=\"%i\"} %.2f\n",
+            (int) (end - name - 1), name + 1, tid, (double) (utime + stime) / clk_tck);
+    }
+    closedir(dir);
+}
+
+static void collect_queues() {
+    scheduler_stats_t   sched;
+    radio_cmd_stats_t   cmd;
+    radio_flow_stats_t  flow;
+    pan_stream_stats_t  pan;
+
+    scheduler_get_stats(&sched);
+    radio_cmd_stats(&cmd, false);
+    radio_flow_stats(&flow, false);
+    pan_stream_stats(&pan, false);
+
+    counter_update(&cmd_queued, cmd.queued);
+    counter_update(&cmd_coalesced, cmd.coalesced);
+    counter_update(&cmd_executed, cmd.executed);
+    counter_update(&flow_packets, flow.packets);
+    counter_update(&flow_late, flow.late);
+    counter_update(&pan_rows, pan.rows);
+    counter_update(&pan_sent, pan.sent);
+    counter_update(&pan_dropped, pan.dropped);
+
+    header("scheduler_puts_total", "counter", "Tasks put to the UI scheduler");
+    put("x6100_scheduler_puts_total %u\n", sched.puts);
+    header("scheduler_drops_total", "counter", "Tasks dropped on a full scheduler queue");
+    put("x6100_scheduler_drops_total %u\n", sched.drops);
+    header("scheduler_coalesced_total", "counter", "Puts absorbed by a pending keyed task");
+    put("x6100_scheduler_coalesced_total %u\n", sched.coalesced);
+    header("scheduler_depth_max", "gauge", "Queue depth high-water mark of the lane");
+
+    for (int i = 0; i < SCHEDULER_PRIO_LAST; i++) {
+        put("x6100_scheduler_depth_max{lane=\"%s\"} %u\n", lane_names[i], sched.lanes[i].depth_max);
+    }
+    header("scheduler_wait_max_seconds", "gauge", "Longest put to execution delay of the lane");
+
+    for (int i = 0; i < SCHEDULER_PRIO_LAST; i++) {
+        put("x6100_scheduler_wait_max_seconds{lane=\"%s\"} %.6f\n", lane_names[i], sched.lanes[i].wait_max_us / 1e6);
+    }
+
+    header("radio_cmd_total", "counter", "Radio control commands");
+    put("x6100_radio_cmd_total{result=\"queued\"} %llu\n", (unsigned long long) cmd_queued.total);
+    put("x6100_radio_cmd_total{result=\"coalesced\"} %llu\n", (unsigned long long) cmd_coalesced.total);
+    put("x6100_radio_cmd_total{result=\"executed\"} %llu\n", (unsigned long long) cmd_executed.total);
+    header("radio_cmd_depth", "gauge", "Pending radio control commands");
+    put("x6100_radio_cmd_depth %u\n", cmd.depth);
+
+    header("flow_packets_total", "counter", "Flow packets from the base board");
+    put("x6100_flow_packets_total %llu\n", (unsigned long long) flow_packets.total);
+    header("flow_late_total", "counter", "Flow intervals longer than two packets");
+    put("x6100_flow_late_total %llu\n", (unsigned long long) flow_late.total);
+    header("flow_restarts_total", "counter", "Flow restarts after a timeout");
+    put("x6100_flow_restarts_total %u\n", flow.restarts);
+    header("flow_warm_restarts_total", "counter", "Flow restarts with the DSP averages kept");
+    put("x6100_flow_warm_restarts_total %u\n", flow.restarts_warm);
+    header("flow_outages_total", "counter", "Flow gaps with restarts");
+    put("x6100_flow_outages_total %u\n", flow.outages);
+    header("flow_outage_seconds_total", "counter", "Time without flow, of the gaps with restarts");
+    put("x6100_flow_outage_seconds_total %.3f\n", flow.outage_total_ms / 1000.0);
+    header("flow_outage_last_seconds", "gauge", "Length of the last flow gap");
+    put("x6100_flow_outage_last_seconds %.3f\n", flow.outage_last_ms / 1000.0);
+    header("flow_outage_max_seconds", "gauge", "Longest flow gap");
+    put("x6100_flow_outage_max_seconds %.3f\n", flow.outage_max_ms / 1000.0);
+
+    header("pan_stream_clients", "gauge", "Panadapter stream clients");
+    put("x6100_pan_stream_clients %u\n", pan.clients);
+    header("pan_stream_rows_total", "counter", "Panadapter rows");
+    put("x6100_pan_stream_rows_total{result=\"quantized\"} %llu\n", (unsigned long long) pan_rows.total);
+    put("x6100_pan_stream_rows_total{result=\"sent\"} %llu\n", (unsigned long long) pan_sent.total);
+    put("x6100_pan_stream_rows_total{result=\"dropped\"} %llu\n", (unsigned long long) pan_dropped.total);
+
+    iq_server_stats_t iq;
+
+    iq_server_stats(&iq);
+
+    header("iq_server_clients", "gauge", "IQ server clients");
+    put("x6100_iq_server_clients %u\n", iq.clients);
+    header("iq_server_blocks_total", "counter", "Flow blocks of the IQ server");
+    put("x6100_iq_server_blocks_total{result=\"put\"} %u\n", iq.blocks);
+    put("x6100_iq_server_blocks_total{result=\"sent\"} %u\n", iq.sent);
+    put("x6100_iq_server_blocks_total{result=\"dropped\"} %u\n", iq.dropped);
+    header("iq_server_sent_bytes_total", "counter", "IQ sent to clients");
+    put("x6100_iq_server_sent_bytes_total %llu\n", (unsigned long long) iq.bytes);
+
+    psk_reporter_stats_t psk;
+
+    psk_reporter_stats(&psk);
+
+    header("psk_reporter_spots_total", "counter", "FT8/FT4 decodes for PSK Reporter");
+    put("x6100_psk_reporter_spots_total{result=\"put\"} %u\n", psk.spots);
+    put("x6100_psk_reporter_spots_total{result=\"dropped\"} %u\n", psk.dropped);
+    put("x6100_psk_reporter_spots_total{result=\"rejected\"} %u\n", psk.rejected);
+    put("x6100_psk_reporter_spots_total{result=\"repeated\"} %u\n", psk.repeated);
+    put("x6100_psk_reporter_spots_total{result=\"sent\"} %u\n", psk.sent);
+    header("psk_reporter_packets_total", "counter", "PSK Reporter datagrams");
+    put("x6100_psk_reporter_packets_total %u\n", psk.packets);
+    header("psk_reporter_errors_total", "counter", "PSK Reporter failed lookups and sends");
+    put("x6100_psk_reporter_errors_total %u\n", psk.errors);
+}
+
+static void collect_cat() {
+    cat_latency_stats_t cat;
+    uint64_t            cumulative = 0;
+
+    cat_latency_stats(&cat, false);
+    counter_update(&cat_requests, cat.requests);
+    counter_update(&cat_sum_us, cat.sum_us);
+
+    for (int i = 0; i < CAT_LATENCY_BUCKETS; i++) {
+        counter_update(&cat_buckets[i], cat.buckets[i]);
+    }
+
+    header("cat_latency_seconds", "histogram", "CAT request to response time");
+
+    for (int i = 0; i < CAT_LATENCY_BUCKETS - 1; i++) {
+        cumulative += cat_buckets[i].total;
+        put("x6100_cat_latency_seconds_bucket{le=\"%s\"} %llu\n", cat_bucket_le[i], (unsigned long long) cumulative);
+    }
+    put("x6100_cat_latency_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long) cat_requests.total);
+    put("x6100_cat_latency_seconds_sum %.6f\n", cat_sum_us.total / 1e6);
+    put("x6100_cat_latency_seconds_count %llu\n", (unsigned long long) cat_requests.total);
+}
+
+static void collect_ft8() {
+    header("ft8_slots_total", "counter", "Decoded FT8/FT4 slots");
+
+    for (int d = 0; d < 2; d++) {
+        put("x6100_ft8_slots_total{decoder=\"%s\"} %u\n", ft8_decoders[d], atomic_load(&ft8_slots[d]));
+    }
+    header("ft8_last_slot_decodes", "gauge", "Messages of the last slot");
+
+    for (int d = 0; d < 2; d++) {
+        put("x6100_ft8_last_slot_decodes{decoder=\"%s\"} %u\n", ft8_decoders[d], atomic_load(&ft8_last[d]));
+    }
+    header("ft8_slot_decodes", "histogram", "Messages per slot");
+
+    for (int d = 0; d < 2; d++) {
+        uint32_t cumulative = 0;
+
+        for (int i = 0; i < FT8_BUCKETS; i++) {
+            cumulative += atomic_load(&ft8_buckets[d][i]);
+            put("x6100_ft8_slot_decodes_bucket{decoder=\"%s\",le=\"%u\"} %u\n",
+                ft8_decoders[d], ft8_bucket_le[i], cumulative);
+        }
+
+        uint32_t slots = atomic_load(&ft8_slots[d]);
+
+        put("x6100_ft8_slot_decodes_bucket{decoder=\"%s\",le=\"+Inf\"} %u\n", ft8_decoders[d], slots);
+        put("x6100_ft8_slot_decodes_sum{decoder=\"%s\"} %u\n", ft8_decoders[d], atomic_load(&ft8_decodes[d]));
+        put("x6100_ft8_slot_decodes_count{decoder=\"%s\"} %u\n", ft8_decoders[d], slots);
+    }
+}
+
+static void collect_system() {
+    cfg_save_stats_t    db;
+    governor_stats_t    gov;
+    mem_pool_stats_t    pool;
+
+    cfg_save_stats(&db);
+    governor_get_stats(&gov);
+    mem_pool_stats(&pool);
+
+    header("audio_latency_seconds", "gauge", "Measured latency of the audio stream, 0 - unknown");
+    put("x6100_audio_latency_seconds{stream=\"play\"} %.6f\n", audio_get_play_latency() / 1e6);
+    put("x6100_audio_latency_seconds{stream=\"capture\"} %.6f\n", audio_get_capture_latency() / 1e6);
+
+    audio_stream_stats_t remote;
+
+    audio_stream_stats(&remote);
+
+    header("remote_audio_clients", "gauge", "Remote audio stream clients");
+    put("x6100_remote_audio_clients %u\n", remote.client ? 1 : 0);
+    header("remote_audio_latency_seconds", "gauge", "Remote audio latency, RX capture to send, TX jitter buffer to play");
+    put("x6100_remote_audio_latency_seconds{dir=\"rx\"} %.3f\n", remote.rx_latency_ms / 1e3);
+    put("x6100_remote_audio_latency_seconds{dir=\"tx\"} %.3f\n", remote.tx_latency_ms / 1e3);
+    header("remote_audio_frames_total", "counter", "Remote audio frames");
+    put("x6100_remote_audio_frames_total{dir=\"rx\",result=\"sent\"} %u\n", remote.rx_frames);
+    put("x6100_remote_audio_frames_total{dir=\"rx\",result=\"dropped\"} %u\n", remote.rx_dropped);
+    put("x6100_remote_audio_frames_total{dir=\"tx\",result=\"played\"} %u\n", remote.tx_frames);
+    put("x6100_remote_audio_frames_total{dir=\"tx\",result=\"lost\"} %u\n", remote.tx_lost);
+    put("x6100_remote_audio_frames_total{dir=\"tx\",result=\"late\"} %u\n", remote.tx_late);
+    header("remote_audio_underruns_total", "counter", "Remote TX audio jitter buffer underruns");
+    put("x6100_remote_audio_underruns_total %u\n", remote.tx_underruns);
+
+    header("db_transactions_total", "counter", "params.db transactions");
+    put("x6100_db_transactions_total %u\n", db.transactions);
+    header("db_writes_total", "counter", "params.db written rows");
+    put("x6100_db_writes_total %u\n", db.writes);
+    header("db_written_bytes_total", "counter", "params.db approximate written payload");
+    put("x6100_db_written_bytes_total %llu\n", (unsigned long long) db.bytes);
+
+    header("memory_bytes", "gauge", "Heap of the subsystem");
+
+    for (int i = 0; i < MEM_TAG_LAST; i++) {
+        mem_stats_t s;
+
+        mem_stats_get(i, &s);
+        put("x6100_memory_bytes{tag=\"%s\"} %zu\n", mem_stats_tag_name(i), s.cur);
+    }
+    header("memory_peak_bytes", "gauge", "Heap peak of the subsystem");
+
+    for (int i = 0; i < MEM_TAG_LAST; i++) {
+        mem_stats_t s;
+
+        mem_stats_get(i, &s);
+        put("x6100_memory_peak_bytes{tag=\"%s\"} %zu\n", mem_stats_tag_name(i), s.peak);
+    }
+    header("memory_pool_bytes", "gauge", "Pages of the small allocation pool");
+    put("x6100_memory_pool_bytes %zu\n", pool.pages * MEM_POOL_PAGE);
+    header("memory_pool_overflows_total", "counter", "Small allocations which went to malloc");
+    put("x6100_memory_pool_overflows_total %u\n", pool.overflows);
+    header("heap_used_bytes", "gauge", "Used heap of the process");
+    put("x6100_heap_used_bytes %zu\n", get_heap_used());
+
+    header("governor_level", "gauge", "Load governor level, 0 - full rate");
+    put("x6100_governor_level %u\n", gov.level);
+    header("cpu_load_ratio", "gauge", "Process CPU time per window and core");
+    put("x6100_cpu_load_ratio %.3f\n", gov.cpu_load);
+}
+
+static void collect_cb(lv_timer_t *t) {
+    len = 0;
+
+    collect_threads();
+    collect_queues();
+    collect_cat();
+    collect_ft8();
+    collect_system();
+
+    text_len[back] = len < TEXT_SIZE ? len : TEXT_SIZE - 1;
+
+    pthread_mutex_lock(&text_mux);
+    front = back;
+    pthread_mutex_unlock(&text_mux);
+
+    back ^= 1;
+}
+
+/* Server */
+
+static int listen_open(uint16_t port) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (sock < 0) {
+        LV_LOG_ERROR("Metrics socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int on = 1;
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, METRICS_IFACE, sizeof(METRICS_IFACE)) < 0) {
+        LV_LOG_WARN("Metrics on all interfaces, %s: %s", METRICS_IFACE, strerror(errno));
+    }
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(sock, 4) < 0) {
+        LV_LOG_ERROR("Metrics port %u: %s", port, strerror(errno));
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void send_all(int fd, const char *buf, size_t size) {
+    while (size) {
+        ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        buf += n;
+        size -= n;
+    }
+}
+
+static void serve(int fd) {
+    static char     request[REQUEST_SIZE];
+    static char     text[TEXT_SIZE];
+    char            head[160];
+    size_t          text_size;
+    struct timeval  tv = { .tv_sec = 2 };
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+
+    if (n <= 0) {
+        return;
+    }
+    request[n] = '\0';
+
+    if (strncmp(request, "GET /metrics", 12) != 0 && strncmp(request, "GET / ", 6) != 0) {
+        static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    pthread_mutex_lock(&text_mux);
+    text_size = text_len[front];
+    memcpy(text, texts[front], text_size);
+    pthread_mutex_unlock(&text_mux);
+
+    int head_size = snprintf(head, sizeof(head),
+                             "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: %zu\r\nConnection: close\r\n\r\n", text_size);
+
+    send_all(fd, head, head_size);
+    send_all(fd, text, text_size);
+}
+
+static void * metrics_thread(void *arg) {
+    int sock = (int) (intptr_t) arg;
+
+    set_thread_name("metrics");
+
+    while (true) {
+        int fd = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("Metrics accept: %s", strerror(errno));
+                sleep_usec(1000000);
+            }
+            continue;
+        }
+        serve(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+void metrics_ft8_slot(bool dual, uint16_t decodes) {
+    int d = dual ? 1 : 0;
+    int i = 0;
+
+    while (i < FT8_BUCKETS && decodes > ft8_bucket_le[i]) {
+        i++;
+    }
+    if (i < FT8_BUCKETS) {
+        atomic_fetch_add_explicit(&ft8_buckets[d][i], 1, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ft8_last[d], decodes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ft8_decodes[d], decodes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ft8_slots[d], 1, memory_order_relaxed);
+}
+
+void metrics_init() {
+    const char  *env = getenv("X6100_METRICS");
+    long        port;
+
+    if (!env || !*env || strcmp(env, "0") == 0) {
+        return;
+    }
+    port = atol(env);
+
+    if (port <= 1 || port > 65535) {
+        port = METRICS_PORT;
+    }
+
+    clk_tck = sysconf(_SC_CLK_TCK);
+
+    if (clk_tck <= 0) {
+        clk_tck = 100;
+    }
+
+    int sock = listen_open(port);
+
+    if (sock < 0) {
+        return;
+    }
+
+    collect_cb(NULL);
+    lv_timer_create(collect_cb, COLLECT_MS, NULL);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, metrics_thread, (void *) (intptr_t) sock);
+    pthread_detach(thread);
+
+    LV_LOG_USER("Metrics on port %li", port);
+}
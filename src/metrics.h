@@ -0,0 +1,45 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Device health for Prometheus, text exposition at http://<radio>:<port>/metrics
+ * on the WiFi interface: CPU time per thread, queue depths, drop counters, FT8
+ * decodes per slot, audio latency, params.db writes and memory per tag.
+ *
+ * Values are collected once per second on the UI thread from the stats the
+ * modules already keep, and rendered to a text buffer. The "metrics" thread
+ * (nice 19) only copies the last text to the socket, so a scrape allocates
+ * nothing and never touches the radio, DSP or audio threads.
+ *
+ * Enabled by X6100_METRICS=1 (METRICS_PORT) or X6100_METRICS=<port>.
+ */
+
+#define METRICS_PORT    9100
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read X6100_METRICS and start the collector and the server, call after lv_init()
+ */
+void metrics_init();
+
+/**
+ * Decodes of a finished FT8/FT4 slot, called by the decode thread
+ */
+void metrics_ft8_slot(bool dual, uint16_t decodes);
+
+#ifdef __cplusplus
+}
+#endif
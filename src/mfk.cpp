@@ -680,6 +680,28 @@ void mfk_update(int16_t diff, bool voice) {
             }
             break;
 
+        case MFK_RTTY_MULTI:
+            b = rtty_change_multi(diff);
+            msg_update_text_fmt("#%3X RTTY multi-channel: %s", color, b ? "On" : "Off");
+
+            if (diff) {
+                voice_say_bool("Teletype multi channel", b);
+            } else if (voice) {
+                voice_say_text_fmt("Teletype multi channel switcher");
+            }
+            break;
+
+        case MFK_RTTY_CHANNEL:
+            i = rtty_change_channel(diff);
+            msg_update_text_fmt("#%3X RTTY channel: %i (%i Hz)", color, i, rtty_get_channel_center(i));
+
+            if (diff) {
+                voice_say_int("Teletype channel", i);
+            } else if (voice) {
+                voice_say_text_fmt("Teletype channel");
+            }
+            break;
+
         default:
             break;
     }
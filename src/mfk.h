@@ -68,6 +68,8 @@ typedef enum {
     MFK_RTTY_SHIFT,
     MFK_RTTY_CENTER,
     MFK_RTTY_REVERSE,
+    MFK_RTTY_MULTI,
+    MFK_RTTY_CHANNEL,
 } mfk_mode_t;
 
 typedef enum {
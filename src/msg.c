@@ -11,6 +11,7 @@
 #include "styles.h"
 #include "util.h"
 #include "events.h"
+#include "label_text.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,7 +55,7 @@ static void msg_show_timer(lv_timer_t *t) {
     if (fade_out_timer != NULL) {
         lv_timer_del(fade_out_timer);
     }
-    lv_label_set_text(obj, msg->text);
+    label_text_set(obj, msg->text);
     lv_obj_move_foreground(obj);
     lv_anim_set_values(&fade, lv_obj_get_style_opa(obj, 0), LV_OPA_COVER);
     fade_run = true;
@@ -105,23 +106,23 @@ lv_obj_t * msg_init(lv_obj_t *parent) {
 void msg_update_text_fmt(const char * fmt, ...) {
     va_list args;
 
-    delayed_message_t * msg = (delayed_message_t *) malloc(sizeof(delayed_message_t));
-    msg->type = MSG_UPDATE;
+    delayed_message_t msg;
+    msg.type = MSG_UPDATE;
     va_start(args, fmt);
-    vsnprintf(msg->text, sizeof(msg->text), fmt, args);
+    vsnprintf(msg.text, sizeof(msg.text), fmt, args);
     va_end(args);
 
-    event_send(obj, EVENT_MSG_UPDATE, (void*)msg);
+    event_send_copy(obj, EVENT_MSG_UPDATE, &msg, sizeof(msg));
 }
 
 void msg_schedule_text_fmt(const char * fmt, ...) {
     va_list args;
 
-    delayed_message_t * msg = (delayed_message_t *) malloc(sizeof(delayed_message_t));
-    msg->type = MSG_SCHEDULE;
+    delayed_message_t msg;
+    msg.type = MSG_SCHEDULE;
     va_start(args, fmt);
-    vsnprintf(msg->text, sizeof(msg->text), fmt, args);
+    vsnprintf(msg.text, sizeof(msg.text), fmt, args);
     va_end(args);
 
-    event_send(obj, EVENT_MSG_UPDATE, (void*)msg);
+    event_send_copy(obj, EVENT_MSG_UPDATE, &msg, sizeof(msg));
 }
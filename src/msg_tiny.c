@@ -11,6 +11,7 @@
 #include "styles.h"
 #include "util.h"
 #include "events.h"
+#include "label_text.h"
 
 static lv_obj_t     *obj;
 static char         buf[512];
@@ -34,7 +35,7 @@ static void fade_ready(lv_anim_t * a) {
 }
 
 static void msg_update_cb(lv_event_t * e) {
-    lv_label_set_text(obj, buf);
+    label_text_set(obj, buf);
 
     if (!fade_run) {
         fade_run = true;
@@ -0,0 +1,41 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+#include <stdbool.h>
+
+/* Uncovered columns on the sides up to this width are ignored */
+#define OCCLUSION_MARGIN    4
+
+/**
+ * Part of the area not covered by an opaque occluder, which spans the area width
+ * (dialogs do). Occluder in the middle of the area leaves it all visible.
+ * @param area object coords
+ * @param occluder covering area, NULL - none
+ * @param visible visible part of the area
+ * @return false if the area is fully covered
+ */
+static inline bool occlusion_visible_area(const lv_area_t *area, const lv_area_t *occluder, lv_area_t *visible) {
+    *visible = *area;
+
+    if (!occluder || occluder->x1 > area->x1 + OCCLUSION_MARGIN || occluder->x2 < area->x2 - OCCLUSION_MARGIN) {
+        return true;
+    }
+    if (occluder->y1 <= area->y1 && occluder->y2 >= area->y2) {
+        return false;
+    }
+    if (occluder->y1 <= area->y1 && occluder->y2 >= area->y1) {
+        visible->y1 = occluder->y2 + 1;
+    } else if (occluder->y2 >= area->y2 && occluder->y1 <= area->y2) {
+        visible->y2 = occluder->y1 - 1;
+    }
+    return true;
+}
@@ -0,0 +1,421 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "pan_stream.h"
+
+#include "cat_state.h"
+#include "cfg/cfg.h"
+#include "dsp.h"
+#include "meter.h"
+#include "radio.h"
+#include "triple_buf.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define MAX_BINS        WATERFALL_NFFT
+#define POLL_MS         1000
+
+typedef struct __attribute__((packed)) {
+    char        magic[4];
+    uint8_t     version;
+    uint8_t     kinds;
+    uint8_t     fps;
+} subscribe_t;
+
+typedef struct __attribute__((packed)) {
+    char        magic[4];
+    uint8_t     version;
+    uint8_t     kind;
+    uint8_t     flags;
+    uint8_t     reserved;
+    uint16_t    seq;
+    uint16_t    bins;
+    int32_t     center;
+    int32_t     span;
+    int16_t     db_min;
+    int16_t     db_max;
+} frame_header_t;
+
+/* Row of a kind, written by the radio thread and sent in place */
+typedef struct {
+    unsigned    seq;            /* Row number */
+    uint16_t    bins;
+    int32_t     span;
+    bool        tx;
+    uint8_t     data[MAX_BINS];
+} row_t;
+
+typedef struct {
+    struct sockaddr_in  addr;
+    bool                used;
+    uint8_t             kinds;
+    uint16_t            period_ms;
+    uint64_t            next_ms[PAN_STREAM_KINDS];
+    uint64_t            expire_ms;
+} client_t;
+
+static triple_buf_t     rows[PAN_STREAM_KINDS];
+static uint64_t         put_ms[PAN_STREAM_KINDS];       /* Radio thread */
+static unsigned         put_seq[PAN_STREAM_KINDS];      /* Radio thread */
+static unsigned         sent_seq[PAN_STREAM_KINDS];     /* Sender thread */
+
+static client_t         clients[PAN_STREAM_CLIENTS];
+static int              sock = -1;
+static int              wake_event = -1;
+
+static atomic_bool      enabled = false;
+static atomic_uint      wanted = 0;                     /* Kinds with clients */
+static atomic_uint      min_period_ms = 1000;
+
+static atomic_uint      stat_clients = 0;
+static atomic_uint      stat_rows = 0;
+static atomic_uint      stat_sent = 0;
+static atomic_uint      stat_dropped = 0;
+static atomic_ullong    stat_put_us = 0;
+static atomic_uint      stat_put_max_us = 0;
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void wake() {
+    uint64_t val = 1;
+
+    if (wake_event >= 0 && write(wake_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("Pan stream wake event");
+    }
+}
+
+/* Radio thread */
+
+void pan_stream_put(pan_stream_kind_t kind, const float *psd, uint16_t size, int32_t span, bool tx) {
+    if (!(atomic_load_explicit(&wanted, memory_order_relaxed) & (1 << kind))) {
+        return;
+    }
+
+    uint64_t start = now_us();
+
+    /* Not faster than the fastest client */
+    if (start / 1000 - put_ms[kind] < atomic_load_explicit(&min_period_ms, memory_order_relaxed)) {
+        return;
+    }
+    put_ms[kind] = start / 1000;
+
+    row_t       *row = triple_buf_back(rows[kind]);
+    const float scale = 255.0f / (S9_40 - S_MIN);
+
+    if (size > MAX_BINS) {
+        size = MAX_BINS;
+    }
+
+    for (uint16_t i = 0; i < size; i++) {
+        float v = (psd[i] - S_MIN) * scale;
+
+        row->data[i] = v <= 0.0f ? 0 : v >= 255.0f ? 255 : (uint8_t) v;
+    }
+    row->seq = ++put_seq[kind];
+    row->bins = size;
+    row->span = span;
+    row->tx = tx;
+
+    triple_buf_publish(rows[kind]);
+
+    uint32_t us = now_us() - start;
+
+    atomic_fetch_add_explicit(&stat_rows, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat_put_us, us, memory_order_relaxed);
+
+    if (us > atomic_load_explicit(&stat_put_max_us, memory_order_relaxed)) {
+        atomic_store_explicit(&stat_put_max_us, us, memory_order_relaxed);
+    }
+
+    wake();
+}
+
+/* Sender thread */
+
+static void clients_update() {
+    unsigned    kinds = 0;
+    unsigned    period = 1000;
+    unsigned    count = 0;
+
+    for (uint8_t i = 0; i < PAN_STREAM_CLIENTS; i++) {
+        if (clients[i].used) {
+            kinds |= clients[i].kinds;
+            period = LV_MIN(period, clients[i].period_ms);
+            count++;
+        }
+    }
+    atomic_store(&min_period_ms, period);
+    atomic_store(&wanted, kinds);
+    atomic_store(&stat_clients, count);
+}
+
+static void subscribe(const subscribe_t *req, const struct sockaddr_in *addr, uint64_t now) {
+    client_t *free_client = NULL;
+    client_t *client = NULL;
+
+    for (uint8_t i = 0; i < PAN_STREAM_CLIENTS; i++) {
+        client_t *c = &clients[i];
+
+        if (!c->used) {
+            if (!free_client) {
+                free_client = c;
+            }
+        } else if (c->addr.sin_addr.s_addr == addr->sin_addr.s_addr && c->addr.sin_port == addr->sin_port) {
+            client = c;
+        }
+    }
+
+    if (req->kinds == 0) {
+        if (client) {
+            client->used = false;
+        }
+        return;
+    }
+    if (!client) {
+        if (!free_client) {
+            LV_LOG_WARN("Pan stream: too many clients");
+            return;
+        }
+        client = free_client;
+        memset(client, 0, sizeof(*client));
+        client->addr = *addr;
+        client->used = true;
+    }
+
+    uint8_t fps = req->fps ? LV_MIN(req->fps, PAN_STREAM_MAX_FPS) : 1;
+
+    client->kinds = req->kinds & ((1 << PAN_STREAM_KINDS) - 1);
+    client->period_ms = 1000 / fps;
+    client->expire_ms = now + PAN_STREAM_TIMEOUT_S * 1000;
+}
+
+static void receive(uint64_t now) {
+    subscribe_t         req;
+    struct sockaddr_in  addr;
+    socklen_t           addr_len = sizeof(addr);
+    ssize_t             res;
+
+    while ((res = recvfrom(sock, &req, sizeof(req), 0, (struct sockaddr *) &addr, &addr_len)) >= 0) {
+        if (res == sizeof(req) && memcmp(req.magic, "X6PS", 4) == 0 && req.version == PAN_STREAM_VERSION) {
+            subscribe(&req, &addr, now);
+        }
+        addr_len = sizeof(addr);
+    }
+}
+
+/**
+ * Copy of the latest row, false if there is no new one or it's written right now
+ */
+/**
+ * New row of the kind, owned by the sender until the next read. NULL if there is none
+ */
+static const row_t * row_read(pan_stream_kind_t kind) {
+    bool        fresh;
+    const row_t *row = triple_buf_read(rows[kind], &fresh);
+
+    if (!fresh) {
+        return NULL;
+    }
+    if (sent_seq[kind] && row->seq - sent_seq[kind] > 1) {
+        atomic_fetch_add_explicit(&stat_dropped, row->seq - sent_seq[kind] - 1, memory_order_relaxed);
+    }
+    sent_seq[kind] = row->seq;
+
+    return row;
+}
+
+static void send_rows(uint64_t now) {
+    static uint8_t  buf[sizeof(frame_header_t) + MAX_BINS];
+    frame_header_t  *header = (frame_header_t *) buf;
+    cat_state_t     st;
+
+    cat_state_read(&st);
+
+    for (uint8_t kind = 0; kind < PAN_STREAM_KINDS; kind++) {
+        const row_t *row = row_read(kind);
+
+        if (!row) {
+            continue;
+        }
+
+        memcpy(header->magic, "X6PF", 4);
+        header->version = PAN_STREAM_VERSION;
+        header->kind = kind;
+        header->flags = row->tx ? 1 : 0;
+        header->reserved = 0;
+        header->seq = htons(row->seq);
+        header->bins = htons(row->bins);
+        header->center = htonl(st.fg_freq + subject_get_int(cfg_cur.lo_offset));
+        header->span = htonl(row->span);
+        header->db_min = htons(S_MIN);
+        header->db_max = htons(S9_40);
+        memcpy(buf + sizeof(frame_header_t), row->data, row->bins);
+
+        for (uint8_t i = 0; i < PAN_STREAM_CLIENTS; i++) {
+            client_t *c = &clients[i];
+
+            if (!c->used || !(c->kinds & (1 << kind)) || now < c->next_ms[kind]) {
+                continue;
+            }
+            c->next_ms[kind] = now + c->period_ms;
+
+            ssize_t res = sendto(sock, buf, sizeof(frame_header_t) + row->bins, MSG_DONTWAIT,
+                                 (struct sockaddr *) &c->addr, sizeof(c->addr));
+
+            if (res < 0) {
+                atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+            } else {
+                atomic_fetch_add_explicit(&stat_sent, 1, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+static void socket_open() {
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (sock < 0) {
+        LV_LOG_ERROR("Pan stream socket: %s", strerror(errno));
+        return;
+    }
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(PAN_STREAM_PORT);
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        LV_LOG_ERROR("Pan stream port %u: %s", PAN_STREAM_PORT, strerror(errno));
+        close(sock);
+        sock = -1;
+    }
+}
+
+static void socket_close() {
+    close(sock);
+    sock = -1;
+    memset(clients, 0, sizeof(clients));
+    clients_update();
+}
+
+static void * pan_stream_thread(void *arg) {
+    set_thread_name("pan_stream");
+
+    struct pollfd fds[2];
+
+    while (true) {
+        bool on = atomic_load(&enabled);
+
+        if (on && sock < 0) {
+            socket_open();
+        } else if (!on && sock >= 0) {
+            socket_close();
+        }
+
+        fds[0].fd = wake_event;
+        fds[0].events = POLLIN;
+        fds[1].fd = sock;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, sock >= 0 ? POLL_MS : -1) < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("Pan stream poll: %s", strerror(errno));
+                sleep_usec(100000);
+            }
+            continue;
+        }
+
+        uint64_t now = get_time();
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t val;
+
+            if (read(wake_event, &val, sizeof(val)) < 0) {
+                LV_LOG_WARN("Pan stream wake event");
+            }
+        }
+        if (sock < 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            receive(now);
+        }
+
+        for (uint8_t i = 0; i < PAN_STREAM_CLIENTS; i++) {
+            if (clients[i].used && now > clients[i].expire_ms) {
+                clients[i].used = false;
+            }
+        }
+        clients_update();
+        send_rows(now);
+    }
+    return NULL;
+}
+
+static void on_pan_stream_change(Subject *subj, void *user_data) {
+    atomic_store(&enabled, subject_get_int(subj));
+    wake();
+}
+
+void pan_stream_init() {
+    wake_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_event < 0) {
+        LV_LOG_ERROR("Pan stream wake event");
+        return;
+    }
+
+    for (uint8_t i = 0; i < PAN_STREAM_KINDS; i++) {
+        rows[i] = triple_buf_create(sizeof(row_t));
+    }
+
+    subject_add_observer_and_call(cfg.pan_stream.val, on_pan_stream_change, NULL);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, pan_stream_thread, NULL);
+    pthread_detach(thread);
+}
+
+void pan_stream_stats(pan_stream_stats_t *stats, bool reset) {
+    uint32_t rows = atomic_load(&stat_rows);
+
+    stats->clients = atomic_load(&stat_clients);
+    stats->rows = rows;
+    stats->sent = atomic_load(&stat_sent);
+    stats->dropped = atomic_load(&stat_dropped);
+    stats->put_avg_us = rows ? atomic_load(&stat_put_us) / rows : 0;
+    stats->put_max_us = atomic_load(&stat_put_max_us);
+
+    if (reset) {
+        atomic_store(&stat_rows, 0);
+        atomic_store(&stat_sent, 0);
+        atomic_store(&stat_dropped, 0);
+        atomic_store(&stat_put_us, 0);
+        atomic_store(&stat_put_max_us, 0);
+    }
+}
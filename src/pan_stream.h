@@ -0,0 +1,69 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Panadapter over UDP for remote displays. The DSP puts waterfall and spectrum
+ * rows, they are quantized to 8 bits into a single slot per kind (a newer row
+ * replaces an unsent one) and the "pan_stream" thread sends them to the
+ * subscribed clients at their frame rate. Nothing is done on the radio thread
+ * without clients. Enabled by cfg.pan_stream.
+ *
+ * Subscribe, sent by the client to PAN_STREAM_PORT and repeated within
+ * PAN_STREAM_TIMEOUT_S:
+ *
+ *   "X6PS", u8 version, u8 kinds (bit 0 waterfall, bit 1 spectrum, 0 to leave), u8 fps
+ *
+ * Frame, one datagram per row, multibyte fields big endian:
+ *
+ *   "X6PF", u8 version, u8 kind, u8 flags (bit 0 TX), u8 0, u16 seq, u16 bins,
+ *   i32 center Hz, i32 span Hz, i16 dB of 0, i16 dB of 255, then bins bytes
+ */
+
+#define PAN_STREAM_PORT         4534
+#define PAN_STREAM_CLIENTS      4
+#define PAN_STREAM_MAX_FPS      25
+#define PAN_STREAM_TIMEOUT_S    10
+#define PAN_STREAM_VERSION      1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PAN_STREAM_WATERFALL = 0,
+    PAN_STREAM_SPECTRUM,
+
+    PAN_STREAM_KINDS
+} pan_stream_kind_t;
+
+typedef struct {
+    uint32_t    clients;
+    uint32_t    rows;           /* Quantized on the radio thread */
+    uint32_t    sent;
+    uint32_t    dropped;        /* Replaced before sending, or the socket was full */
+    uint32_t    put_avg_us;
+    uint32_t    put_max_us;
+} pan_stream_stats_t;
+
+void pan_stream_init();
+
+/**
+ * Row of dB values, called by the DSP. Span is the width of the row in Hz
+ */
+void pan_stream_put(pan_stream_kind_t kind, const float *psd, uint16_t size, int32_t span, bool tx);
+
+void pan_stream_stats(pan_stream_stats_t *stats, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,84 +8,118 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "pannel.h"
 #include "styles.h"
 #include "util.h"
-#include "scheduler.h"
+#include "ring.h"
 #include "radio.h"
 #include "params/params.h"
 #include "rtty.h"
 
-static lv_obj_t     *obj;
-static char         buf[1024];
-static char         tmp_buf[1024];
-static char         *last_line;
+#define TEXT_RING   1024        /* Chars between the UI frames */
+#define LINES_MAX   4           /* Full lines kept above the current one */
+#define DRAIN_MS    40
+#define MARGIN      40
+
+static lv_obj_t         *obj;
+
+/* Decoder threads write the ring, the UI drains it once per frame */
+static ring_t           text_ring;
+static pthread_mutex_t  producer_mux = PTHREAD_MUTEX_INITIALIZER;
+
+/* Text of the label, UI thread */
+static char             buf[1024];
+static size_t           len = 0;
+static size_t           line_start = 0;
+static lv_coord_t       line_width = 0;
+static uint16_t         lines = 0;
 
 static void update_visibility(Subject *subj, void *user_data);
 
-static void check_lines() {
-    char        *second_line = NULL;
-    char        *ptr = (char *) &buf;
-    uint16_t    count = 0;
+static void text_clear() {
+    buf[0] = '\0';
+    len = 0;
+    line_start = 0;
+    line_width = 0;
+    lines = 0;
+}
 
-    while (*ptr) {
-        if (*ptr == '\n') {
-            count++;
+/**
+ * Drop the oldest lines, so `keep` full lines are left above the current one
+ */
+static void trim_lines(uint16_t keep) {
+    char *ptr = buf;
 
-            if (count == 1) {
-                second_line = ptr + 1;
-            }
-        }
-        ptr++;
+    while (lines > keep) {
+        ptr = strchr(ptr, '\n') + 1;
+        lines--;
     }
 
-    if (count > 4) {
-        strcpy(tmp_buf, second_line);
-        strcpy(buf, tmp_buf);
+    size_t removed = ptr - buf;
+
+    if (removed) {
+        memmove(buf, ptr, len - removed + 1);
+        len -= removed;
+        line_start -= removed;
     }
+}
 
-    ptr = (char *) &buf;
+static void new_line() {
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    line_start = len;
+    line_width = 0;
+    lines++;
+}
 
-    while (*ptr) {
-        if (*ptr == '\n') {
-            last_line = ptr + 1;
+static void append_char(char c, lv_coord_t max_width) {
+    if (c == '\n') {
+        if (len > line_start) {
+            new_line();
         }
-        ptr++;
+        return;
     }
 
-    *last_line = '\0';
-}
+    lv_coord_t w = lv_font_get_glyph_width(&sony_38, (uint8_t) c, 0);
 
-static void pannel_update_cb(const char *text) {
-    lv_point_t line_size;
-    lv_point_t text_size;
-
-    if (!last_line) {
-        return;
+    if (line_width + w > max_width && len > line_start) {
+        new_line();
     }
+    if (len + 2 >= sizeof(buf)) {
+        trim_lines(lines ? lines - 1 : 0);
 
-    if (strcmp(text, "\n") == 0) {
-        if (last_line[strlen(last_line) - 1] != '\n') {
-            strcat(last_line, text);
-            check_lines();
+        if (len + 2 >= sizeof(buf)) {
+            return;
         }
-    } else {
-        lv_txt_get_size(&line_size, last_line, &sony_38, 0, 0, LV_COORD_MAX, 0);
-        lv_txt_get_size(&text_size, text, &sony_38, 0, 0, LV_COORD_MAX, 0);
+    }
+    buf[len++] = c;
+    buf[len] = '\0';
+    line_width += w;
+}
 
-        if (line_size.x + text_size.x > (lv_obj_get_width(obj) - 40)) {
-            strcat(last_line, "\n");
-            check_lines();
-        }
+static void drain_cb(lv_timer_t *t) {
+    lv_coord_t  max_width = lv_obj_get_width(obj) - MARGIN;
+    size_t      count = 0;
+    char        *c;
 
-        strcat(last_line, text);
+    while ((c = ring_peek(text_ring)) != NULL) {
+        append_char(*c, max_width);
+        ring_release(text_ring);
+        count++;
     }
 
-    lv_label_set_text_static(obj, buf);
+    if (count) {
+        trim_lines(LINES_MAX);
+        lv_label_set_text_static(obj, buf);
+    }
 }
 
 lv_obj_t * pannel_init(lv_obj_t *parent) {
     obj = lv_label_create(parent);
+    text_ring = ring_create(1, TEXT_RING);
+    lv_timer_create(drain_cb, DRAIN_MS, NULL);
 
     lv_obj_add_style(obj, &pannel_style, 0);
     lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
@@ -96,7 +130,22 @@ lv_obj_t * pannel_init(lv_obj_t *parent) {
 }
 
 void pannel_add_text(const char * text) {
-    scheduler_put((void(*)(void*))pannel_update_cb, (void*)text, strlen(text) + 1);
+    if (!text_ring) {
+        return;
+    }
+    pthread_mutex_lock(&producer_mux);
+
+    for (; *text; text++) {
+        char *c = ring_reserve(text_ring);
+
+        if (!c) {
+            break;
+        }
+        *c = *text;
+        ring_commit(text_ring);
+    }
+
+    pthread_mutex_unlock(&producer_mux);
 }
 
 void pannel_hide() {
@@ -122,8 +171,8 @@ void pannel_visible() {
     }
 
     if (on) {
-        strcpy(buf, "");
-        last_line = (char *) &buf;
+        ring_flush(text_ring);
+        text_clear();
         lv_label_set_text_static(obj, buf);
         lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
     } else {
@@ -17,4 +17,8 @@ lv_obj_t * pannel_init(lv_obj_t *parent);
 
 void pannel_hide();
 void pannel_visible();
+/**
+ * Queue decoded text, any thread. The label is updated once per UI frame
+ * with everything queued since the previous one
+ */
 void pannel_add_text(const char * text);
@@ -9,14 +9,23 @@
 
 #include "common.h"
 #include "../util.h"
+#include "../cfg/cfg.h"
+#include "../lock_stats.h"
+
+#include <errno.h>
+#include <time.h>
 
 #define PARAMS_SAVE_TIMEOUT  (3 * 1000)
 
 pthread_mutex_t params_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t params_cond = PTHREAD_COND_INITIALIZER;
 static uint64_t params_mod_time = 0;
 
+static bool     flush_req = false;
+static uint32_t flush_seq = 0;
+
 void params_lock() {
-    pthread_mutex_lock(&params_mux);
+    lock_stats_lock(&params_mux, "params");
 }
 
 void params_unlock(bool *dirty) {
@@ -26,14 +35,66 @@ void params_unlock(bool *dirty) {
     if (!params_mod_time)
     {
         params_mod_time = get_time();
+        pthread_cond_broadcast(&params_cond);
     }
-    pthread_mutex_unlock(&params_mux);
+    params_view_publish();
+    lock_stats_unlock(&params_mux, "params");
 }
 
-bool params_ready_to_save() {
-    if ((params_mod_time) && (get_time() - params_mod_time > PARAMS_SAVE_TIMEOUT)) {
-        params_mod_time = 0;
-        return true;
+bool params_wait_save() {
+    bool flush;
+
+    while (!params_mod_time && !flush_req) {
+        lock_stats_cond_wait(&params_cond, &params_mux, "params");
     }
-    return false;
+
+    /* Changes within the window after the first one are saved together */
+    while (params_mod_time && !flush_req) {
+        int64_t left = (int64_t) (params_mod_time + PARAMS_SAVE_TIMEOUT) - (int64_t) get_time();
+
+        if (left <= 0) {
+            break;
+        }
+
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += left / 1000;
+        ts.tv_nsec += (left % 1000) * 1000000L;
+
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        lock_stats_cond_timedwait(&params_cond, &params_mux, "params", &ts);
+    }
+
+    flush = flush_req;
+    flush_req = false;
+    params_mod_time = 0;
+
+    return flush;
+}
+
+void params_saved(bool flush) {
+    if (flush) {
+        flush_seq++;
+        pthread_cond_broadcast(&params_cond);
+    }
+}
+
+void params_flush() {
+    lock_stats_lock(&params_mux, "params");
+
+    uint32_t seq = flush_seq;
+
+    flush_req = true;
+    pthread_cond_broadcast(&params_cond);
+
+    while (flush_seq == seq) {
+        lock_stats_cond_wait(&params_cond, &params_mux, "params");
+    }
+    lock_stats_unlock(&params_mux, "params");
+
+    cfg_save_flush();
 }
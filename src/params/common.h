@@ -15,4 +15,25 @@ extern pthread_mutex_t  params_mux;
 
 void params_lock();
 void params_unlock(bool *dirty);
-bool params_ready_to_save();
+
+/**
+ * Publish params_view_t of the current params, with params_mux held
+ */
+void params_view_publish();
+
+/**
+ * Wait with params_mux held until changes are ready to save (3 s after the
+ * first one) or a flush is requested. Returns true for a flush
+ */
+bool params_wait_save();
+
+/**
+ * Called by the writer with params_mux held after the journal is committed
+ */
+void params_saved(bool flush);
+
+/**
+ * Save all changes (params and cfg items) now and wait until they are
+ * written, e.g. before power off
+ */
+void params_flush();
@@ -10,12 +10,14 @@
 
 #include "migrations.h"
 #include "../util.h"
+#include "../cfg/cfg.h"
 
 #include <string.h>
 #include <lvgl/src/misc/lv_log.h>
 
 
 sqlite3                 *db = NULL;
+sqlite3                 *db_read = NULL;
 
 static sqlite3_stmt     *insert_stmt;
 
@@ -35,6 +37,11 @@ bool database_init() {
         return false;
     }
 
+    /* One fsync of the WAL per transaction instead of the rollback journal ones, readers don't wait */
+    if (sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL) != SQLITE_OK) {
+        LV_LOG_WARN("Can't switch params.db to WAL: %s", sqlite3_errmsg(db));
+    }
+
     rc = migrations_apply();
     if (rc != 0) {
         return false;
@@ -46,6 +53,13 @@ bool database_init() {
         LV_LOG_ERROR("Can't prepare insert statement for params");
         return false;
     }
+
+    /* After the migrations, they may change the schema */
+    if (sqlite3_open_v2("/mnt/params.db", &db_read, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        LV_LOG_WARN("Can't open params.db for reading, sharing the connection");
+        sqlite3_close(db_read);
+        db_read = db;
+    }
     return true;
 }
 
@@ -63,42 +77,121 @@ bool sql_query_exec(const char *sql) {
 }
 
 
-void params_write_int(const char *name, int data, bool *dirty) {
-    sqlite3_bind_text(insert_stmt, 1, name, strlen(name), 0);
-    sqlite3_bind_int(insert_stmt, 2, data);
-    sqlite3_step(insert_stmt);
-    sqlite3_reset(insert_stmt);
-    sqlite3_clear_bindings(insert_stmt);
+/* Journal */
+
+typedef enum {
+    JOURNAL_INT = 0,
+    JOURNAL_INT64,
+    JOURNAL_FLOAT,
+    JOURNAL_TEXT,
+} journal_type_t;
+
+typedef struct {
+    const char      *name;
+    journal_type_t  type;
+    union {
+        int64_t     i;
+        float       f;
+        char        t[16];
+    };
+} journal_rec_t;
+
+#define JOURNAL_SIZE    128
+
+static journal_rec_t    journal[JOURNAL_SIZE];
+static uint16_t         journal_len = 0;
+
+static journal_rec_t * journal_append(const char *name, journal_type_t type, bool *dirty) {
+    if (journal_len == JOURNAL_SIZE) {
+        LV_LOG_WARN("Params journal is full, %s is postponed", name);
+        return NULL;
+    }
+
+    journal_rec_t *rec = &journal[journal_len++];
 
+    rec->name = name;
+    rec->type = type;
     *dirty = false;
+
+    return rec;
+}
+
+void params_write_int(const char *name, int data, bool *dirty) {
+    journal_rec_t *rec = journal_append(name, JOURNAL_INT, dirty);
+
+    if (rec) {
+        rec->i = data;
+    }
 }
 
 void params_write_int64(const char *name, uint64_t data, bool *dirty) {
-    sqlite3_bind_text(insert_stmt, 1, name, strlen(name), 0);
-    sqlite3_bind_int64(insert_stmt, 2, data);
-    sqlite3_step(insert_stmt);
-    sqlite3_reset(insert_stmt);
-    sqlite3_clear_bindings(insert_stmt);
+    journal_rec_t *rec = journal_append(name, JOURNAL_INT64, dirty);
 
-    *dirty = false;
+    if (rec) {
+        rec->i = (int64_t) data;
+    }
 }
 
 void params_write_float(const char *name, float data, bool *dirty) {
-    sqlite3_bind_text(insert_stmt, 1, name, strlen(name), 0);
-    sqlite3_bind_double(insert_stmt, 2, (double) data);
-    sqlite3_step(insert_stmt);
-    sqlite3_reset(insert_stmt);
-    sqlite3_clear_bindings(insert_stmt);
+    journal_rec_t *rec = journal_append(name, JOURNAL_FLOAT, dirty);
 
-    *dirty = false;
+    if (rec) {
+        rec->f = data;
+    }
 }
 
 void params_write_text(const char *name, const char *data, bool *dirty) {
-    sqlite3_bind_text(insert_stmt, 1, name, strlen(name), 0);
-    sqlite3_bind_text(insert_stmt, 2, data, strlen(data), 0);
-    sqlite3_step(insert_stmt);
-    sqlite3_reset(insert_stmt);
-    sqlite3_clear_bindings(insert_stmt);
+    journal_rec_t *rec = journal_append(name, JOURNAL_TEXT, dirty);
 
-    *dirty = false;
+    if (rec) {
+        strncpy(rec->t, data, sizeof(rec->t) - 1);
+        rec->t[sizeof(rec->t) - 1] = 0;
+    }
+}
+
+void params_journal_commit() {
+    if (journal_len == 0) {
+        return;
+    }
+    if (!db) {
+        journal_len = 0;
+        return;
+    }
+
+    uint32_t bytes = 0;
+
+    cfg_save_begin();
+
+    for (uint16_t i = 0; i < journal_len; i++) {
+        journal_rec_t *rec = &journal[i];
+
+        sqlite3_bind_text(insert_stmt, 1, rec->name, strlen(rec->name), 0);
+
+        switch (rec->type) {
+            case JOURNAL_INT:
+                sqlite3_bind_int(insert_stmt, 2, (int) rec->i);
+                break;
+
+            case JOURNAL_INT64:
+                sqlite3_bind_int64(insert_stmt, 2, rec->i);
+                break;
+
+            case JOURNAL_FLOAT:
+                sqlite3_bind_double(insert_stmt, 2, (double) rec->f);
+                break;
+
+            case JOURNAL_TEXT:
+                sqlite3_bind_text(insert_stmt, 2, rec->t, strlen(rec->t), 0);
+                break;
+        }
+        sqlite3_step(insert_stmt);
+        sqlite3_reset(insert_stmt);
+        sqlite3_clear_bindings(insert_stmt);
+
+        bytes += strlen(rec->name) + (rec->type == JOURNAL_TEXT ? strlen(rec->t) : sizeof(rec->i));
+    }
+
+    cfg_save_end();
+    cfg_save_account(journal_len, bytes);
+    journal_len = 0;
 }
@@ -14,12 +14,21 @@
 #include <stdint.h>
 
 extern sqlite3          *db;
+extern sqlite3          *db_read;       /* Read-only, see cfg_init() */
 
 bool database_init();
 
 bool sql_query_exec(const char *sql);
 
+/*
+ * Writes go to the journal with params_mux held (cheap copies, the dirty flag
+ * is cleared), params_journal_commit() then stores them in one cfg_save
+ * transaction without holding params_mux. Only the params thread uses the journal.
+ */
+
 void params_write_int(const char *name, int data, bool *dirty);
 void params_write_int64(const char *name, uint64_t data, bool *dirty);
 void params_write_float(const char *name, float data, bool *dirty);
 void params_write_text(const char *name, const char *data, bool *dirty);
+
+void params_journal_commit();
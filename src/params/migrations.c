@@ -13,6 +13,7 @@
 #include "db.h"
 #include "../cfg/digital_modes.h"
 
+#include <lvgl/src/misc/lv_log.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +22,7 @@
 
 static sqlite3_stmt *update_ver_stmt;
 
+static int get_user_version(int * ver);
 static int get_current_version(int * ver);
 static int set_current_version(int ver);
 
@@ -29,7 +31,7 @@ static int _0_init_migrations() {
     int rc;
     rc = sqlite3_exec(db, "INSERT INTO version(id) VALUES(0)", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
-        printf("Cannot insert 0 version: %s\n", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Cannot insert 0 version: %s", sqlite3_errmsg(db));
         return 1;
     }
     return 0;
@@ -66,13 +68,13 @@ static int _1_create_ftx_table() {
         CFG_DIG_TYPE_FT8, CFG_DIG_TYPE_FT4
     );
     if (rc == -1) {
-        printf("Cannot allocate SQL query\n");
+        LV_LOG_ERROR("Cannot allocate SQL query");
         return 1;
     }
     rc = sqlite3_exec(db, query, NULL, NULL, NULL);
     free(query);
     if (rc != SQLITE_OK) {
-        printf("Cannot migrate: %s\n", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Cannot migrate: %s", sqlite3_errmsg(db));
         return 1;
     }
     return 0;
@@ -82,7 +84,39 @@ static int _2_update_atu_freq() {
     int rc;
     rc = sqlite3_exec(db, "UPDATE atu SET freq=freq * 50000 + 25000 WHERE freq < 500000", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
-        printf("Cannot update ATU frequencies: %s\n", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Cannot update ATU frequencies: %s", sqlite3_errmsg(db));
+        return 1;
+    }
+    return 0;
+}
+
+static int _3_create_swrscan_table() {
+    int rc;
+    rc = sqlite3_exec(db,
+        "CREATE TABLE IF NOT EXISTS swrscan("
+            "ant INTEGER NOT NULL, "
+            "band INTEGER NOT NULL, "
+            "points BLOB, "
+            "PRIMARY KEY(ant, band)"
+        ")", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Cannot create swrscan table: %s", sqlite3_errmsg(db));
+        return 1;
+    }
+    return 0;
+}
+
+static int _4_create_profiles_table() {
+    int rc;
+    rc = sqlite3_exec(db,
+        "CREATE TABLE IF NOT EXISTS profiles("
+            "name TEXT NOT NULL, "
+            "item TEXT NOT NULL, "
+            "val, "
+            "PRIMARY KEY(name, item)"
+        ")", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Cannot create profiles table: %s", sqlite3_errmsg(db));
         return 1;
     }
     return 0;
@@ -93,26 +127,39 @@ static int (*migrations[])() = {
     _0_init_migrations,
     _1_create_ftx_table,
     _2_update_atu_freq,
+    _3_create_swrscan_table,
+    _4_create_profiles_table,
 };
 
 int migrations_apply(void) {
     int rc = 0;
     int ver;
     if (db == NULL) {
-        printf("Database is not opened\n");
+        LV_LOG_ERROR("Database is not opened");
         return 1;
     }
 
+    /* Prebuilt and migrated databases are up to date, no other queries */
+    int latest = SIZEOF_ARRAY(migrations) - 1;
+
+    if (get_user_version(&ver) == 0 && ver >= latest) {
+        return 0;
+    }
+
     rc = get_current_version(&ver);
     if (rc != 0) {
-        printf("Cannot get current version\n");
+        LV_LOG_ERROR("Cannot get current version");
         return 1;
     }
+    if (ver >= latest) {
+        /* Migrated before user_version was kept */
+        return set_current_version(ver);
+    }
     for (size_t i = ver+1; i < SIZEOF_ARRAY(migrations); i++){
-        printf("Apply migration: %i ...\n", i);
+        LV_LOG_USER("Apply migration: %i", i);
         rc = (*migrations[i])();
         if (rc != 0) {
-            printf("Can't apply %i migration\n", i);
+            LV_LOG_ERROR("Can't apply %i migration", i);
             break;
         }
         set_current_version(i);
@@ -121,17 +168,36 @@ int migrations_apply(void) {
 }
 
 
+static int get_user_version(int * ver) {
+    int rc;
+    sqlite3_stmt *stmt;
+    rc = sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, 0);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Failed prepare statement: %s", sqlite3_errmsg(db));
+        return 1;
+    }
+    rc = sqlite3_step(stmt);
+
+    if (rc == SQLITE_ROW) {
+        *ver = sqlite3_column_int(stmt, 0);
+    } else {
+        *ver = 0;
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
 static int get_current_version(int * ver) {
     int rc;
     sqlite3_stmt *stmt;
     rc = sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS version(id INT NOT NULL DEFAULT 0)", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
-        printf("Cannot create versions table: %s\n", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Cannot create versions table: %s", sqlite3_errmsg(db));
         return 1;
     }
     rc = sqlite3_prepare_v2(db, "SELECT id from version", -1, &stmt, 0);
     if (rc != SQLITE_OK) {
-        printf("Failed prepare statement: %s\n", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare statement: %s", sqlite3_errmsg(db));
         return 1;
     }
     rc = sqlite3_step(stmt);
@@ -150,11 +216,21 @@ static int set_current_version(int ver) {
     sqlite3_stmt *stmt;
     rc = sqlite3_prepare_v2(db, "UPDATE version SET id=?", -1, &stmt, 0);
     if (rc != SQLITE_OK) {
-        printf("Failed prepare statement: %s\n", sqlite3_errmsg(db));
+        LV_LOG_ERROR("Failed prepare statement: %s", sqlite3_errmsg(db));
         return 1;
     }
     sqlite3_bind_int(stmt, 1, ver);
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+
+    /* PRAGMA can't take parameters */
+    char query[32];
+
+    snprintf(query, sizeof(query), "PRAGMA user_version = %i", ver);
+    rc = sqlite3_exec(db, query, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Cannot set user version: %s", sqlite3_errmsg(db));
+        return 1;
+    }
     return 0;
 }
@@ -16,6 +16,7 @@
 #include "../vol.h"
 #include "../dialog_msg_cw.h"
 #include "../qth/qth.h"
+#include "../lock_stats.h"
 
 #include "lvgl/lvgl.h"
 
@@ -23,6 +24,7 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <sqlite3.h>
+#include <stdatomic.h>
 #include <string.h>
 
 #define BAND_NOT_LOADED -10
@@ -48,6 +50,7 @@ params_t params = {
     .waterfall_smooth_scroll= { .x = true,  .name = "waterfall_smooth_scroll",  .voice = "Waterfall smooth scroll"},
     .waterfall_center_line  = { .x = true,  .name = "waterfall_center_line",    .voice = "Waterfall center line"},
     .waterfall_zoom         = { .x = true,  .name = "waterfall_zoom",           .voice = "Waterfall zoom"},
+    .waterfall_threaded     = { .x = false, .name = "waterfall_threaded",       .voice = "Waterfall render thread"},
     .mag_freq               = { .x = true,  .name = "mag_freq",                 .voice = "Magnification of frequency" },
     .mag_info               = { .x = true,  .name = "mag_info",                 .voice = "Magnification of info" },
     .mag_alc                = { .x = true,  .name = "mag_alc",                  .voice = "Magnification of A L C" },
@@ -82,6 +85,7 @@ params_t params = {
     .rtty_shift             = 170,
     .rtty_rate              = 4545,
     .rtty_reverse           = false,
+    .rtty_multi             = false,
     .rtty_bits              = 5,
     .rtty_snr               = 3.0f,
 
@@ -122,8 +126,9 @@ params_t params = {
 };
 
 static sqlite3_stmt     *write_mode_stmt;
-static sqlite3_stmt     *bands_find_all_stmt;
-static sqlite3_stmt     *bands_find_stmt;
+
+static params_view_t    view;
+static atomic_uint      view_seq;       /* Odd while the view is written */
 
 
 /* System params */
@@ -224,6 +229,8 @@ static bool params_load() {
             params.rtty_center = i;
         } else if (strcmp(name, "rtty_reverse") == 0) {
             params.rtty_reverse = i;
+        } else if (strcmp(name, "rtty_multi") == 0) {
+            params.rtty_multi = i;
         } else if (strcmp(name, "rit") == 0) {
             params.rit = i;
         } else if (strcmp(name, "xit") == 0) {
@@ -289,6 +296,7 @@ static bool params_load() {
         if (params_load_bool(&params.waterfall_smooth_scroll, name, i)) continue;
         if (params_load_bool(&params.waterfall_center_line, name, i)) continue;
         if (params_load_bool(&params.waterfall_zoom, name, i)) continue;
+        if (params_load_bool(&params.waterfall_threaded, name, i)) continue;
         if (params_load_bool(&params.spmode, name, i)) continue;
         if (params_load_bool(&params.ft8_auto, name, i)) continue;
         if (params_load_float(&params.ft8_output_gain_offset, name, f)) continue;
@@ -344,11 +352,10 @@ static void params_save_str(params_str_t *var) {
     }
 }
 
+/**
+ * Journal dirty params, called with params_mux held
+ */
 static void params_save() {
-    if (!sql_query_exec("BEGIN")) {
-        return;
-    }
-
     if (params.dirty.band)                  params_write_int("band", params.band_id, &params.dirty.band);
 
     if (params.dirty.spectrum_beta)         params_write_int("spectrum_beta", params.spectrum_beta, &params.dirty.spectrum_beta);
@@ -373,6 +380,7 @@ static void params_save() {
     if (params.dirty.rtty_shift)            params_write_int("rtty_shift", params.rtty_shift, &params.dirty.rtty_shift);
     if (params.dirty.rtty_center)           params_write_int("rtty_center", params.rtty_center, &params.dirty.rtty_center);
     if (params.dirty.rtty_reverse)          params_write_int("rtty_reverse", params.rtty_reverse, &params.dirty.rtty_reverse);
+    if (params.dirty.rtty_multi)            params_write_int("rtty_multi", params.rtty_multi, &params.dirty.rtty_multi);
 
     if (params.dirty.rit)                   params_write_int("rit", params.rit, &params.dirty.rit);
     if (params.dirty.xit)                   params_write_int("xit", params.xit, &params.dirty.xit);
@@ -429,6 +437,7 @@ static void params_save() {
     params_save_bool(&params.waterfall_smooth_scroll);
     params_save_bool(&params.waterfall_center_line);
     params_save_bool(&params.waterfall_zoom);
+    params_save_bool(&params.waterfall_threaded);
     params_save_bool(&params.spmode);
     params_save_bool(&params.ft8_auto);
     params_save_float(&params.ft8_output_gain_offset);
@@ -438,29 +447,66 @@ static void params_save() {
     params_save_str(&params.callsign);
     params_save_bool(&params.wifi_enabled);
     params_save_uint8(&params.theme);
+}
+
+/* View */
+
+void params_view_publish() {
+    unsigned seq = atomic_load_explicit(&view_seq, memory_order_relaxed);
 
-    sql_query_exec("COMMIT");
+    atomic_store_explicit(&view_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    view.spectrum_peak = params.spectrum_peak;
+    view.spectrum_peak_hold = params.spectrum_peak_hold;
+    view.spectrum_peak_speed = params.spectrum_peak_speed;
+    view.spectrum_auto_min = params.spectrum_auto_min.x;
+    view.spectrum_auto_max = params.spectrum_auto_max.x;
+    view.waterfall_auto_min = params.waterfall_auto_min.x;
+    view.waterfall_auto_max = params.waterfall_auto_max.x;
+
+    view.rtty_reverse = params.rtty_reverse;
+    view.rtty_multi = params.rtty_multi;
+    view.rtty_bits = params.rtty_bits;
+    view.rtty_snr = params.rtty_snr;
+
+    atomic_store_explicit(&view_seq, seq + 2, memory_order_release);
+}
+
+void params_view_get(params_view_t *out) {
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&view_seq, memory_order_acquire);
+        *out = view;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&view_seq, memory_order_relaxed));
 }
 
 /* * */
 
 static void * params_thread(void *arg) {
+    set_thread_name("params");
+
+    lock_stats_lock(&params_mux, "params");
+
     while (true) {
-        pthread_mutex_lock(&params_mux);
-        if (params_ready_to_save()){
-            params_save();
-            // params_band_save(params.band_id);
-            // params_mode_save();
-        }
-        pthread_mutex_unlock(&params_mux);
-        usleep(100000);
+        bool flush = params_wait_save();
+
+        params_save();
+        lock_stats_unlock(&params_mux, "params");
+
+        params_journal_commit();
+
+        lock_stats_lock(&params_mux, "params");
+        params_saved(flush);
     }
 }
 
 void params_init() {
     int rc;
     if (database_init()) {
-        cfg_init(db);
+        cfg_init(db, db_read);
         if (!params_load()) {
             LV_LOG_ERROR("Load params");
             sqlite3_close(db);
@@ -476,28 +522,15 @@ void params_init() {
         if (rc != SQLITE_OK) {
             LV_LOG_ERROR("Prepare mode write");
         }
-
-        rc = sqlite3_prepare_v2(db,
-            "SELECT id,name,start_freq,stop_freq,type FROM bands "
-                "WHERE (stop_freq BETWEEN ? AND ?) OR (start_freq BETWEEN ? AND ?) OR (start_freq <= ? AND stop_freq >= ?) "
-                "ORDER BY start_freq ASC",
-                -1, &bands_find_all_stmt, 0
-        );
-
-        if (rc != SQLITE_OK) {
-            LV_LOG_ERROR("Prepare bands all find");
-        }
-
-        rc = sqlite3_prepare_v2(db,  "SELECT id,name,start_freq,stop_freq,type FROM bands WHERE (? BETWEEN start_freq AND stop_freq)", -1, &bands_find_stmt, 0);
-
-        if (rc != SQLITE_OK) {
-            LV_LOG_ERROR("Prepare bands find");
-        }
-
     } else {
         LV_LOG_ERROR("Open params.db");
     }
 
+    /* Loaded or default values */
+    params_lock();
+    params_view_publish();
+    lock_stats_unlock(&params_mux, "params");
+
     pthread_t thread;
 
     pthread_create(&thread, NULL, params_thread, NULL);
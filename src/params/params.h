@@ -37,6 +37,8 @@ typedef enum {
     ACTION_BAT_INFO,
     ACTION_NR_TOGGLE,
     ACTION_NB_TOGGLE,
+    ACTION_LOG_EXPORT,
+    ACTION_MEM_SCAN,
 
     ACTION_APP_RTTY = 100,
     ACTION_APP_FT8,
@@ -47,6 +49,7 @@ typedef enum {
     ACTION_APP_QTH,
     ACTION_APP_CALLSIGN,
     ACTION_APP_WIFI,
+    ACTION_APP_BAND_SWEEP,
 } press_action_t;
 
 typedef enum {
@@ -113,6 +116,7 @@ typedef struct {
     params_bool_t       waterfall_smooth_scroll;
     params_bool_t       waterfall_center_line;
     params_bool_t       waterfall_zoom;
+    params_bool_t       waterfall_threaded;
     params_bool_t       mag_freq;
     params_bool_t       mag_info;
     params_bool_t       mag_alc;
@@ -132,6 +136,7 @@ typedef struct {
     uint16_t            rtty_shift;
     uint32_t            rtty_rate;
     bool                rtty_reverse;
+    bool                rtty_multi;
     uint8_t             rtty_bits;
     float               rtty_snr;
 
@@ -230,6 +235,7 @@ typedef struct {
         bool    rtty_shift;
         bool    rtty_rate;
         bool    rtty_reverse;
+        bool    rtty_multi;
 
         bool    ft8_show_all;
         bool    ft8_protocol;
@@ -253,8 +259,33 @@ typedef struct {
 
 extern params_t params;
 
+/*
+ * Read-only copy of the params read by the DSP and RTTY threads. It is
+ * published by params_unlock() under a sequence counter, so readers never
+ * take params_mux and see all fields of one change together
+ */
+typedef struct {
+    bool                spectrum_peak;
+    uint16_t            spectrum_peak_hold;
+    float               spectrum_peak_speed;
+    bool                spectrum_auto_min;
+    bool                spectrum_auto_max;
+    bool                waterfall_auto_min;
+    bool                waterfall_auto_max;
+
+    bool                rtty_reverse;
+    bool                rtty_multi;
+    uint8_t             rtty_bits;
+    float               rtty_snr;
+} params_view_t;
+
 void params_init();
 
+/**
+ * Consistent copy of the hot params, lock-free, any thread
+ */
+void params_view_get(params_view_t *view);
+
 void params_bool_set(params_bool_t *var, bool x);
 void params_uint8_set(params_uint8_t *var, uint8_t x);
 void params_uint16_set(params_uint16_t *var, uint16_t x);
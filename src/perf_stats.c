@@ -0,0 +1,453 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "perf_stats.h"
+
+#include "styles.h"
+#include "cfg/cfg.h"
+#include "radio.h"
+#include "cat.h"
+#include "util.h"
+#include "mem_stats.h"
+#include "lock_stats.h"
+#include "rt_mem.h"
+#include "pan_stream.h"
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLES         512
+#define MAX_THREADS     48
+#define REPORT_MS       1000
+
+typedef struct {
+    uint32_t    v[SAMPLES];
+    uint16_t    count;
+    uint16_t    pos;
+} samples_t;
+
+typedef struct {
+    pid_t       tid;
+    char        name[16];
+    uint64_t    ticks;
+    float       load;
+    uint64_t    min_flt;
+    uint64_t    maj_flt;
+    uint32_t    min_flt_window;     /* Page faults in the last window */
+    uint32_t    maj_flt_window;
+    int         nice;
+    int         cpu;            /* Last CPU the thread ran on */
+    unsigned    rt_prio;
+    unsigned    policy;
+    bool        seen;
+} thread_t;
+
+static bool                 enabled = false;
+static lv_disp_t            *disp = NULL;
+static lv_timer_t           *timer = NULL;
+static lv_obj_t             *overlay = NULL;
+
+static void (*orig_flush_cb)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+static void (*orig_monitor_cb)(lv_disp_drv_t *, uint32_t, uint32_t);
+static void (*orig_render_start_cb)(lv_disp_drv_t *);
+
+static samples_t            scheduler_samples;
+static samples_t            lvgl_samples;
+
+static uint32_t             refreshes;
+static uint64_t             refresh_ms;
+static uint64_t             flush_us;
+static uint64_t             frame_flush_us;     /* Flushes of the current refresh */
+static uint64_t             window_start;
+
+/* Rendering of each invalidated area (or its part, which fits the draw buffer) */
+static uint64_t             render_start;
+static uint32_t             areas;
+static uint64_t             areas_us;
+static uint32_t             areas_max_us;
+static uint64_t             areas_px;
+
+static thread_t             threads[MAX_THREADS];
+static uint8_t              threads_count = 0;
+static long                 clk_tck = 100;
+
+static size_t               heap_max = 0;
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void samples_put(samples_t *s, uint32_t v) {
+    s->v[s->pos] = v;
+    s->pos = (s->pos + 1) % SAMPLES;
+
+    if (s->count < SAMPLES) {
+        s->count++;
+    }
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+static void samples_pct(samples_t *s, uint32_t *p50, uint32_t *p99) {
+    static uint32_t sorted[SAMPLES];
+
+    if (s->count == 0) {
+        *p50 = *p99 = 0;
+        return;
+    }
+    memcpy(sorted, s->v, s->count * sizeof(uint32_t));
+    qsort(sorted, s->count, sizeof(uint32_t), compare_u32);
+
+    *p50 = sorted[s->count / 2];
+    *p99 = sorted[s->count * 99 / 100];
+    s->count = 0;
+    s->pos = 0;
+}
+
+static void render_start_cb(lv_disp_drv_t *drv) {
+    render_start = now_us();
+
+    if (orig_render_start_cb) {
+        orig_render_start_cb(drv);
+    }
+}
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p) {
+    uint64_t start = now_us();
+
+    if (render_start) {
+        uint32_t us = start - render_start;
+
+        areas++;
+        areas_us += us;
+        areas_px += lv_area_get_size(area);
+        if (us > areas_max_us) {
+            areas_max_us = us;
+        }
+        render_start = 0;
+    }
+
+    orig_flush_cb(drv, area, color_p);
+    frame_flush_us += now_us() - start;
+}
+
+static void monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px) {
+    refreshes++;
+    refresh_ms += time;
+    flush_us += frame_flush_us;
+    frame_flush_us = 0;
+
+    if (orig_monitor_cb) {
+        orig_monitor_cb(drv, time, px);
+    }
+}
+
+static thread_t * thread_get(pid_t tid) {
+    for (uint8_t i = 0; i < threads_count; i++) {
+        if (threads[i].tid == tid) {
+            return &threads[i];
+        }
+    }
+    if (threads_count == MAX_THREADS) {
+        return NULL;
+    }
+
+    thread_t *t = &threads[threads_count++];
+
+    memset(t, 0, sizeof(*t));
+    t->tid = tid;
+    return t;
+}
+
+/**
+ * CPU time of all threads from /proc, so pulseaudio and detached threads are counted too
+ */
+static void threads_update(float window_s) {
+    DIR             *dir = opendir("/proc/self/task");
+    struct dirent   *entry;
+
+    if (!dir) {
+        return;
+    }
+    for (uint8_t i = 0; i < threads_count; i++) {
+        threads[i].seen = false;
+    }
+    while ((entry = readdir(dir))) {
+        char    path[64];
+        char    buf[512];
+        pid_t   tid = atoi(entry->d_name);
+
+        if (tid <= 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/self/task/%i/stat", tid);
+
+        FILE *f = fopen(path, "r");
+
+        if (!f) {
+            continue;
+        }
+
+        size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+
+        fclose(f);
+        buf[len] = 0;
+
+        /*
+         * pid (comm) state ..., minflt and majflt are fields 10 and 12, utime and
+         * stime are 14 and 15, nice is 19, processor, rt_priority and policy are 39-41
+         */
+        char *name = strchr(buf, '(');
+        char *end = strrchr(buf, ')');
+        unsigned long long min_flt, maj_flt, utime, stime;
+        int      nice, cpu;
+        unsigned rt_prio, policy;
+
+        if (!name || !end ||
+            sscanf(end + 2, "%*c %*d %*d %*d %*d %*d %*u %llu %*u %llu %*u %llu %llu %*d %*d %*d %d"
+                   " %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %d %u %u",
+                   &min_flt, &maj_flt, &utime, &stime, &nice, &cpu, &rt_prio, &policy) != 8)
+        {
+            continue;
+        }
+
+        thread_t *t = thread_get(tid);
+
+        if (!t) {
+            continue;
+        }
+
+        uint64_t ticks = utime + stime;
+        size_t   name_len = LV_MIN(end - name - 1, (long) sizeof(t->name) - 1);
+
+        memcpy(t->name, name + 1, name_len);
+        t->name[name_len] = 0;
+        t->load = t->ticks ? (ticks - t->ticks) * 100.0f / (clk_tck * window_s) : 0.0f;
+        t->ticks = ticks;
+        t->min_flt_window = t->min_flt ? min_flt - t->min_flt : 0;
+        t->maj_flt_window = t->min_flt ? maj_flt - t->maj_flt : 0;
+        t->min_flt = min_flt;
+        t->maj_flt = maj_flt;
+        t->nice = nice;
+        t->cpu = cpu;
+        t->rt_prio = rt_prio;
+        t->policy = policy;
+        t->seen = true;
+    }
+    closedir(dir);
+
+    /* Forget finished threads */
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < threads_count; i++) {
+        if (threads[i].seen) {
+            threads[n++] = threads[i];
+        }
+    }
+    threads_count = n;
+}
+
+static void report(lv_timer_t *t) {
+    uint64_t    now = now_us();
+    float       window_s = (now - window_start) / 1000000.0f;
+    uint32_t    sched_p50, sched_p99, lvgl_p50, lvgl_p99;
+    size_t      heap = get_heap_used();
+    char        text[4096];
+    size_t      len = 0;
+
+    if (window_s <= 0.0f) {
+        return;
+    }
+    if (heap > heap_max) {
+        heap_max = heap;
+    }
+    samples_pct(&scheduler_samples, &sched_p50, &sched_p99);
+    samples_pct(&lvgl_samples, &lvgl_p50, &lvgl_p99);
+    threads_update(window_s);
+
+    float refresh_avg = refreshes ? (float) refresh_ms / refreshes : 0.0f;
+    float flush_avg = refreshes ? flush_us / 1000.0f / refreshes : 0.0f;
+
+    len += snprintf(text + len, sizeof(text) - len, "fps %.1f\n", refreshes / window_s);
+    len += snprintf(text + len, sizeof(text) - len, "scheduler p50 %u us, p99 %u us\n", sched_p50, sched_p99);
+    len += snprintf(text + len, sizeof(text) - len, "lvgl p50 %u us, p99 %u us\n", lvgl_p50, lvgl_p99);
+    len += snprintf(text + len, sizeof(text) - len, "render %.1f ms, flush %.1f ms\n",
+                    LV_MAX(refresh_avg - flush_avg, 0.0f), flush_avg);
+    len += snprintf(text + len, sizeof(text) - len, "areas %u, render avg %u us, max %u us, avg %u px\n",
+                    areas, areas ? (uint32_t) (areas_us / areas) : 0, areas_max_us,
+                    areas ? (uint32_t) (areas_px / areas) : 0);
+    len += snprintf(text + len, sizeof(text) - len, "heap %zu KiB, max %zu KiB\n", heap / 1024, heap_max / 1024);
+    len += mem_stats_format(text + len, sizeof(text) - len);
+    len += lock_stats_format(text + len, sizeof(text) - len);
+
+    cfg_save_stats_t db;
+
+    cfg_save_stats(&db);
+    len += snprintf(text + len, sizeof(text) - len, "db %u transactions, %u writes, %llu KiB\n",
+                    db.transactions, db.writes, (unsigned long long) (db.bytes / 1024));
+
+    radio_flow_stats_t flow;
+
+    radio_flow_stats(&flow, true);
+    len += snprintf(text + len, sizeof(text) - len, "flow %u pkts, %u/%u/%u us, late %u, restarts %u\n",
+                    flow.packets, flow.interval_min_us, flow.interval_avg_us, flow.interval_max_us,
+                    flow.late, flow.restarts);
+
+    radio_cmd_stats_t cmd;
+
+    radio_cmd_stats(&cmd, true);
+    len += snprintf(text + len, sizeof(text) - len, "cmd %u queued, %u coalesced, %u sent, depth %u/%u\n",
+                    cmd.queued, cmd.coalesced, cmd.executed, cmd.depth, cmd.depth_max);
+
+    cat_latency_stats_t cat;
+
+    cat_latency_stats(&cat, true);
+
+    if (cat.requests) {
+        uint32_t fast = cat.buckets[0] + cat.buckets[1] + cat.buckets[2] + cat.buckets[3];
+        uint32_t slow = cat.buckets[7] + cat.buckets[8];
+
+        len += snprintf(text + len, sizeof(text) - len, "cat %u req, %u/%u us, <1 ms %u, >10 ms %u\n",
+                        cat.requests, (uint32_t) (cat.sum_us / cat.requests), cat.max_us, fast, slow);
+    }
+
+    pan_stream_stats_t pan;
+
+    pan_stream_stats(&pan, true);
+
+    if (pan.clients) {
+        len += snprintf(text + len, sizeof(text) - len, "pan %u clients, %u rows, %u sent, %u dropped, put %u/%u us\n",
+                        pan.clients, pan.rows, pan.sent, pan.dropped, pan.put_avg_us, pan.put_max_us);
+    }
+
+    if (rt_mem_enabled()) {
+        size_t locked, budget;
+
+        rt_mem_locked(&locked, &budget);
+        len += snprintf(text + len, sizeof(text) - len, "mlock %zu KiB, budget %zu KiB\n",
+                        locked / 1024, budget / 1024);
+    }
+
+    /* Page faults of the window as minor/major */
+    for (uint8_t i = 0; i < threads_count && len < sizeof(text); i++) {
+        thread_t *t = &threads[i];
+
+        if (t->policy == SCHED_FIFO) {
+            len += snprintf(text + len, sizeof(text) - len, "%-15s %5.1f%% cpu%i fifo %u pf %u/%u\n",
+                            t->name, t->load, t->cpu, t->rt_prio, t->min_flt_window, t->maj_flt_window);
+        } else {
+            len += snprintf(text + len, sizeof(text) - len, "%-15s %5.1f%% cpu%i nice %i pf %u/%u\n",
+                            t->name, t->load, t->cpu, t->nice, t->min_flt_window, t->maj_flt_window);
+        }
+    }
+
+    FILE *f = fopen(PERF_STATS_PATH ".tmp", "w");
+
+    if (f) {
+        fputs(text, f);
+        fclose(f);
+        rename(PERF_STATS_PATH ".tmp", PERF_STATS_PATH);
+    }
+    if (overlay) {
+        lv_label_set_text(overlay, text);
+    }
+
+    refreshes = 0;
+    refresh_ms = 0;
+    flush_us = 0;
+    areas = 0;
+    areas_us = 0;
+    areas_max_us = 0;
+    areas_px = 0;
+    window_start = now;
+}
+
+void perf_stats_init(lv_disp_t *d) {
+    const char *env = getenv("X6100_PERF_STATS");
+
+    disp = d;
+    clk_tck = sysconf(_SC_CLK_TCK);
+
+    if (clk_tck <= 0) {
+        clk_tck = 100;
+    }
+    if (env && *env && strcmp(env, "0") != 0) {
+        perf_stats_enable(true, strcmp(env, "overlay") == 0);
+    }
+}
+
+void perf_stats_enable(bool on, bool show_overlay) {
+    lv_disp_drv_t *drv = disp->driver;
+
+    if (on && !enabled) {
+        orig_flush_cb = drv->flush_cb;
+        orig_monitor_cb = drv->monitor_cb;
+        orig_render_start_cb = drv->render_start_cb;
+        drv->flush_cb = flush_cb;
+        drv->monitor_cb = monitor_cb;
+        drv->render_start_cb = render_start_cb;
+
+        refreshes = 0;
+        refresh_ms = 0;
+        flush_us = 0;
+        frame_flush_us = 0;
+        render_start = 0;
+        areas = 0;
+        areas_us = 0;
+        areas_max_us = 0;
+        areas_px = 0;
+        threads_count = 0;
+        window_start = now_us();
+        timer = lv_timer_create(report, REPORT_MS, NULL);
+        enabled = true;
+    } else if (!on && enabled) {
+        drv->flush_cb = orig_flush_cb;
+        drv->monitor_cb = orig_monitor_cb;
+        drv->render_start_cb = orig_render_start_cb;
+        lv_timer_del(timer);
+        timer = NULL;
+        enabled = false;
+    }
+
+    if (on && show_overlay && !overlay) {
+        overlay = lv_label_create(lv_layer_top());
+
+        lv_obj_set_style_text_font(overlay, &sony_14, 0);
+        lv_obj_set_style_text_color(overlay, lv_color_white(), 0);
+        lv_obj_set_style_bg_color(overlay, lv_color_black(), 0);
+        lv_obj_set_style_bg_opa(overlay, LV_OPA_60, 0);
+        lv_obj_set_style_pad_all(overlay, 4, 0);
+        lv_obj_align(overlay, LV_ALIGN_TOP_LEFT, 0, 0);
+        lv_label_set_text(overlay, "");
+    } else if ((!on || !show_overlay) && overlay) {
+        lv_obj_del(overlay);
+        overlay = NULL;
+    }
+}
+
+bool perf_stats_enabled() {
+    return enabled;
+}
+
+void perf_stats_loop(uint32_t scheduler_us, uint32_t lvgl_us) {
+    samples_put(&scheduler_samples, scheduler_us);
+    samples_put(&lvgl_samples, lvgl_us);
+}
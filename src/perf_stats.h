@@ -0,0 +1,42 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * On-device profiling. Once per second writes UI frame rate, main loop phase
+ * percentiles, LVGL render/flush time, render time per invalidated area
+ * (to tune the draw buffer size), CPU load, CPU, priority and page faults of every thread,
+ * heap usage (also per mem_stats tag), contended locks of LOCK_STATS builds and
+ * params.db writes to /tmp/perf_stats.txt,
+ * and optionally shows them in an overlay.
+ *
+ * Enabled by X6100_PERF_STATS=1 (file) or X6100_PERF_STATS=overlay,
+ * nothing is measured otherwise.
+ */
+
+#define PERF_STATS_PATH "/tmp/perf_stats.txt"
+
+/**
+ * Read X6100_PERF_STATS and hook into the display driver, call after it is registered
+ */
+void perf_stats_init(lv_disp_t *disp);
+
+void perf_stats_enable(bool on, bool overlay);
+
+bool perf_stats_enabled();
+
+/**
+ * Durations of a main loop iteration, called only while enabled
+ */
+void perf_stats_loop(uint32_t scheduler_us, uint32_t lvgl_us);
@@ -0,0 +1,382 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#define _GNU_SOURCE
+
+#include "profiler.h"
+
+#include "util.h"
+#include "lvgl/lvgl.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define MAX_THREADS     16
+#define DEPTH           32
+#define SKIP            2               /* Signal handler and the sigreturn trampoline */
+#define RING            2048
+#define STACKS          4096            /* Power of 2 */
+#define DRAIN_MS        200
+#define WRITE_MS        10000
+
+/* Written by the signal handler, seq is pos + 1 once complete and 0 while written */
+typedef struct {
+    atomic_uint     seq;
+    uint8_t         thread;
+    uint8_t         depth;
+    void            *pc[DEPTH];
+} sample_t;
+
+typedef struct {
+    uint32_t        hash;
+    uint32_t        count;
+    uint8_t         thread;
+    uint8_t         depth;
+    void            *pc[DEPTH];
+} folded_t;
+
+typedef struct {
+    char            name[16];
+    pid_t           tid;
+    timer_t         timer;
+} thread_t;
+
+typedef struct {
+    uint32_t        count;
+    folded_t        stacks[];
+} snapshot_t;
+
+static const char * const   profiled[] = {
+    "ui", "radio", "radio_cmd", "dsp", "audio", "audio_capture", "ft8", "ft8_decode", "cat"
+};
+
+static thread_t             threads[MAX_THREADS];
+static uint8_t              threads_count = 0;
+static pthread_mutex_t      threads_mux = PTHREAD_MUTEX_INITIALIZER;
+static __thread int         thread_id = -1;
+
+static sample_t             ring[RING];
+static atomic_uint          ring_head = 0;
+static uint32_t             ring_tail = 0;
+
+/* UI thread only */
+static bool                 enabled = false;
+static folded_t             *stacks = NULL;
+static uint32_t             stacks_count = 0;
+static uint32_t             samples = 0;
+static uint32_t             dropped = 0;
+static lv_timer_t           *timer = NULL;
+static uint32_t             since_write = 0;
+static atomic_bool          writing = false;
+
+static void on_sigprof(int sig, siginfo_t *info, void *ctx) {
+    if (thread_id < 0) {
+        return;
+    }
+
+    int         saved_errno = errno;
+    uint32_t    pos = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+    sample_t    *s = &ring[pos % RING];
+
+    atomic_store_explicit(&s->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    s->thread = thread_id;
+    s->depth = backtrace(s->pc, DEPTH);
+
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    errno = saved_errno;
+}
+
+static void timer_arm(thread_t *t, bool on) {
+    long                ns = on ? 1000000000L / PROFILER_HZ : 0;
+    struct itimerspec   spec = {
+        .it_interval = { .tv_sec = 0, .tv_nsec = ns },
+        .it_value = { .tv_sec = 0, .tv_nsec = ns }
+    };
+
+    timer_settime(t->timer, 0, &spec, NULL);
+}
+
+void profiler_thread_start(const char *name) {
+    bool found = false;
+
+    for (uint8_t i = 0; i < sizeof(profiled) / sizeof(profiled[0]); i++) {
+        if (strcmp(profiled[i], name) == 0) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        return;
+    }
+
+    pthread_mutex_lock(&threads_mux);
+
+    pid_t       tid = syscall(SYS_gettid);
+    thread_t    *t = NULL;
+
+    /* Slots of finished threads are reused, FT8 threads come and go with the dialog */
+    for (uint8_t i = 0; i < threads_count; i++) {
+        if (syscall(SYS_tgkill, getpid(), threads[i].tid, 0) < 0 && errno == ESRCH) {
+            t = &threads[i];
+            timer_delete(t->timer);
+            break;
+        }
+    }
+    if (!t && threads_count < MAX_THREADS) {
+        t = &threads[threads_count++];
+    }
+
+    if (t) {
+        struct sigevent sev = {
+            .sigev_notify = SIGEV_THREAD_ID,
+            .sigev_signo = SIGPROF
+        };
+
+        sev._sigev_un._tid = tid;
+
+        if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &t->timer) == 0) {
+            strncpy(t->name, name, sizeof(t->name) - 1);
+            t->tid = tid;
+            thread_id = t - threads;
+
+            if (enabled) {
+                timer_arm(t, true);
+            }
+        } else {
+            LV_LOG_WARN("Profiler timer of %s: %s", name, strerror(errno));
+            t->tid = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&threads_mux);
+}
+
+/* Folding, UI thread */
+
+static void fold(const sample_t *s) {
+    if (s->depth <= SKIP) {
+        return;
+    }
+
+    uint32_t hash = 2166136261u ^ s->thread;
+
+    for (uint8_t i = SKIP; i < s->depth; i++) {
+        hash = (hash ^ (uint32_t) (uintptr_t) s->pc[i]) * 16777619u;
+    }
+
+    for (uint32_t i = hash & (STACKS - 1);; i = (i + 1) & (STACKS - 1)) {
+        folded_t *f = &stacks[i];
+
+        if (f->count == 0) {
+            if (stacks_count >= STACKS * 3 / 4) {
+                dropped++;
+                return;
+            }
+            f->hash = hash;
+            f->thread = s->thread;
+            f->depth = s->depth;
+            memcpy(f->pc, s->pc, s->depth * sizeof(void *));
+            f->count = 1;
+            stacks_count++;
+            return;
+        }
+        if (f->hash == hash && f->thread == s->thread && f->depth == s->depth &&
+            memcmp(f->pc, s->pc, s->depth * sizeof(void *)) == 0)
+        {
+            f->count++;
+            return;
+        }
+    }
+}
+
+static void drain() {
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+
+    if (head - ring_tail > RING) {
+        dropped += head - ring_tail - RING;
+        ring_tail = head - RING;
+    }
+
+    while (ring_tail != head) {
+        sample_t    *s = &ring[ring_tail % RING];
+        sample_t    copy;
+
+        /* Still written by a thread on the other core, retry next time */
+        if (atomic_load_explicit(&s->seq, memory_order_acquire) != ring_tail + 1) {
+            break;
+        }
+        copy.thread = s->thread;
+        copy.depth = s->depth;
+        memcpy(copy.pc, s->pc, sizeof(copy.pc));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == ring_tail + 1) {
+            fold(&copy);
+            samples++;
+        } else {
+            dropped++;
+        }
+        ring_tail++;
+    }
+}
+
+/* Output, symbols are resolved on a worker thread */
+
+static void put_frame(FILE *f, void *pc) {
+    Dl_info info;
+    bool    found = dladdr(pc, &info) != 0;
+
+    if (found && info.dli_sname) {
+        fprintf(f, ";%s", info.dli_sname);
+    } else if (found && info.dli_fname) {
+        const char *name = strrchr(info.dli_fname, '/');
+
+        fprintf(f, ";%s+0x%lx", name ? name + 1 : info.dli_fname,
+                (unsigned long) ((uintptr_t) pc - (uintptr_t) info.dli_fbase));
+    } else {
+        fprintf(f, ";0x%lx", (unsigned long) (uintptr_t) pc);
+    }
+}
+
+static void * write_thread(void *arg) {
+    snapshot_t  *snap = (snapshot_t *) arg;
+
+    set_thread_name("profiler");
+
+    FILE *f = fopen(PROFILER_PATH ".tmp", "w");
+
+    if (f) {
+        for (uint32_t i = 0; i < snap->count; i++) {
+            folded_t *s = &snap->stacks[i];
+
+            fputs(threads[s->thread].name, f);
+
+            for (int j = s->depth - 1; j >= SKIP; j--) {
+                put_frame(f, s->pc[j]);
+            }
+            fprintf(f, " %u\n", s->count);
+        }
+        fclose(f);
+        rename(PROFILER_PATH ".tmp", PROFILER_PATH);
+    } else {
+        LV_LOG_ERROR("Can't write %s", PROFILER_PATH);
+    }
+
+    free(snap);
+    atomic_store(&writing, false);
+    return NULL;
+}
+
+static void write_stacks() {
+    if (atomic_exchange(&writing, true)) {
+        return;
+    }
+
+    snapshot_t *snap = malloc(sizeof(snapshot_t) + stacks_count * sizeof(folded_t));
+
+    if (!snap) {
+        atomic_store(&writing, false);
+        return;
+    }
+    snap->count = 0;
+
+    for (uint32_t i = 0; i < STACKS; i++) {
+        if (stacks[i].count) {
+            snap->stacks[snap->count++] = stacks[i];
+        }
+    }
+
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, write_thread, snap) == 0) {
+        pthread_detach(thread);
+    } else {
+        free(snap);
+        atomic_store(&writing, false);
+    }
+}
+
+static void timer_cb(lv_timer_t *t) {
+    drain();
+    since_write += DRAIN_MS;
+
+    if (since_write >= WRITE_MS) {
+        since_write = 0;
+        write_stacks();
+    }
+}
+
+void profiler_enable(bool on) {
+    if (on == enabled) {
+        return;
+    }
+
+    if (on) {
+        if (!stacks) {
+            stacks = calloc(STACKS, sizeof(folded_t));
+
+            if (!stacks) {
+                LV_LOG_ERROR("Can't allocate profiler stacks");
+                return;
+            }
+
+            struct sigaction sa;
+
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = on_sigprof;
+            sa.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            sigaction(SIGPROF, &sa, NULL);
+
+            /* The first backtrace() loads libgcc_s, not in the signal handler */
+            void *pc;
+
+            backtrace(&pc, 1);
+        } else {
+            memset(stacks, 0, STACKS * sizeof(folded_t));
+        }
+
+        stacks_count = 0;
+        samples = 0;
+        dropped = 0;
+        since_write = 0;
+        ring_tail = atomic_load(&ring_head);
+        timer = lv_timer_create(timer_cb, DRAIN_MS, NULL);
+    }
+
+    pthread_mutex_lock(&threads_mux);
+    enabled = on;
+
+    for (uint8_t i = 0; i < threads_count; i++) {
+        if (threads[i].tid) {
+            timer_arm(&threads[i], on);
+        }
+    }
+    pthread_mutex_unlock(&threads_mux);
+
+    if (!on) {
+        lv_timer_del(timer);
+        timer = NULL;
+        drain();
+        write_stacks();
+        LV_LOG_USER("Profiler: %u samples, %u stacks, %u dropped, %s", samples, stacks_count, dropped, PROFILER_PATH);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Sampling profiler for the busy threads (radio, dsp, ui, ft8, cat, audio), for
+ * the rootfs without perf. Each of them gets a CPU time timer, SIGPROF takes a
+ * backtrace into a ring. The UI thread folds the ring into unique stacks, which
+ * are written every few seconds and when stopped as collapsed stacks
+ * ("thread;outer;...;inner count") for flamegraph.pl or speedscope.
+ *
+ * Switched by the "Profiler" setting. Function names need -rdynamic, frames
+ * of code without unwind tables end the stack.
+ */
+
+#define PROFILER_PATH   "/mnt/profile.folded"
+#define PROFILER_HZ     250             /* Samples per second of thread CPU time */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create the timer of the calling thread if it's one of the profiled, called from set_thread_name
+ */
+void profiler_thread_start(const char *name);
+
+/**
+ * Arm the timers of the registered threads, called on the UI thread
+ */
+void profiler_enable(bool on);
+
+#ifdef __cplusplus
+}
+#endif
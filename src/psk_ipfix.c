@@ -0,0 +1,198 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "psk_ipfix.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#define RECEIVER_ID     0x9992
+#define SENDER_ID       0x9993
+#define HEADER_SIZE     16
+
+/* Options template of the receiver: scope callsign, locator, software */
+static const uint8_t receiver_template[] = {
+    0x00, 0x03, 0x00, 0x24, 0x99, 0x92, 0x00, 0x03, 0x00, 0x01,
+    0x80, 0x02, 0xFF, 0xFF, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x04, 0xFF, 0xFF, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x08, 0xFF, 0xFF, 0x00, 0x00, 0x76, 0x8F,
+    0x00, 0x00
+};
+
+/* Template of a sender: callsign, freq, SNR, mode, locator, information source, flowStartSeconds */
+static const uint8_t sender_template[] = {
+    0x00, 0x02, 0x00, 0x3C, 0x99, 0x93, 0x00, 0x07,
+    0x80, 0x01, 0xFF, 0xFF, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x05, 0x00, 0x04, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x0A, 0xFF, 0xFF, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x03, 0xFF, 0xFF, 0x00, 0x00, 0x76, 0x8F,
+    0x80, 0x0B, 0x00, 0x01, 0x00, 0x00, 0x76, 0x8F,
+    0x00, 0x96, 0x00, 0x04
+};
+
+static uint8_t * put_u16(uint8_t *p, uint16_t x) {
+    *p++ = x >> 8;
+    *p++ = x;
+    return p;
+}
+
+static uint8_t * put_u32(uint8_t *p, uint32_t x) {
+    p = put_u16(p, x >> 16);
+    return put_u16(p, x);
+}
+
+static uint8_t * put_str(uint8_t *p, const char *str) {
+    size_t len = str ? strlen(str) : 0;
+
+    if (len > 254) {
+        len = 254;
+    }
+    *p++ = len;
+    memcpy(p, str, len);
+    return p + len;
+}
+
+static size_t str_size(const char *str) {
+    size_t len = str ? strlen(str) : 0;
+
+    return 1 + (len > 254 ? 254 : len);
+}
+
+static size_t pad4(size_t x) {
+    return (x + 3) & ~(size_t) 3;
+}
+
+static size_t spot_size(const psk_spot_t *spot) {
+    return str_size(spot->call) + 4 + 1 + str_size(spot->mode) + str_size(spot->grid) + 1 + 4;
+}
+
+/**
+ * Close a data set started at set, zero padding to 4 bytes
+ */
+static uint8_t * set_end(uint8_t *set, uint8_t *p) {
+    while ((p - set) & 3) {
+        *p++ = 0;
+    }
+    put_u16(set + 2, p - set);
+    return p;
+}
+
+size_t psk_ipfix_encode(uint8_t *buf, size_t size, const psk_receiver_t *rx, const psk_spot_t *spots,
+                        size_t *count, uint32_t now)
+{
+    size_t receiver_size = pad4(4 + str_size(rx->call) + str_size(rx->grid) + str_size(rx->software));
+    size_t used = HEADER_SIZE + sizeof(receiver_template) + sizeof(sender_template) + receiver_size;
+    size_t n = 0;
+
+    if (used > size) {
+        *count = 0;
+        return 0;
+    }
+
+    /* Spots, which fit with the sender set header and padding */
+    size_t senders = 4;
+
+    while (n < *count && used + pad4(senders + spot_size(&spots[n])) <= size) {
+        senders += spot_size(&spots[n]);
+        n++;
+    }
+    if (n) {
+        used += pad4(senders);
+    }
+
+    uint8_t *p = buf;
+
+    p = put_u16(p, 0x000A);
+    p = put_u16(p, used);
+    p = put_u32(p, now);
+    p = put_u32(p, rx->seq);
+    p = put_u32(p, rx->domain);
+
+    memcpy(p, receiver_template, sizeof(receiver_template));
+    p += sizeof(receiver_template);
+    memcpy(p, sender_template, sizeof(sender_template));
+    p += sizeof(sender_template);
+
+    uint8_t *set = p;
+
+    p = put_u16(p, RECEIVER_ID);
+    p = put_u16(p, 0);
+    p = put_str(p, rx->call);
+    p = put_str(p, rx->grid);
+    p = put_str(p, rx->software);
+    p = set_end(set, p);
+
+    if (n) {
+        set = p;
+        p = put_u16(p, SENDER_ID);
+        p = put_u16(p, 0);
+
+        for (size_t i = 0; i < n; i++) {
+            const psk_spot_t *spot = &spots[i];
+
+            p = put_str(p, spot->call);
+            p = put_u32(p, spot->freq);
+            *p++ = (uint8_t) spot->snr;
+            p = put_str(p, spot->mode);
+            p = put_str(p, spot->grid);
+            *p++ = 1;                       /* Automatically extracted */
+            p = put_u32(p, spot->time);
+        }
+        p = set_end(set, p);
+    }
+
+    *count = n;
+    return p - buf;
+}
+
+bool psk_call_valid(const char *call) {
+    size_t  len = strlen(call);
+    bool    digit = false;
+    bool    alpha = false;
+
+    if (len < 3 || len > 12) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = call[i];
+
+        if (isdigit((unsigned char) c)) {
+            digit = true;
+        } else if (isupper((unsigned char) c)) {
+            alpha = true;
+        } else if (c != '/') {
+            return false;
+        }
+    }
+    return digit && alpha && call[0] != '/' && call[len - 1] != '/';
+}
+
+bool psk_grid_valid(const char *grid) {
+    size_t len = strlen(grid);
+
+    if (len != 4 && len != 6) {
+        return false;
+    }
+    if (grid[0] < 'A' || grid[0] > 'R' || grid[1] < 'A' || grid[1] > 'R') {
+        return false;
+    }
+    if (!isdigit((unsigned char) grid[2]) || !isdigit((unsigned char) grid[3])) {
+        return false;
+    }
+    if (len == 6) {
+        char a = tolower((unsigned char) grid[4]);
+        char b = tolower((unsigned char) grid[5]);
+
+        if (a < 'a' || a > 'x' || b < 'a' || b > 'x') {
+            return false;
+        }
+    }
+    /* Report words, which look like a locator */
+    return strcmp(grid, "RR73") != 0;
+}
@@ -0,0 +1,64 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IPFIX datagrams of PSK Reporter (https://pskreporter.info/pskdev.html).
+ * Every datagram carries both templates, the receiver record and as many
+ * sender records as fit, so a lost one doesn't spoil the next ones.
+ */
+
+#define PSK_IPFIX_MAX       1400        /* Datagram bytes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    char        call[16];
+    char        grid[8];        /* Empty if unknown */
+    char        mode[8];
+    int8_t      snr;
+    uint32_t    freq;           /* Hz */
+    uint32_t    time;           /* Unix time of the decode */
+} psk_spot_t;
+
+typedef struct {
+    const char  *call;
+    const char  *grid;
+    const char  *software;
+    uint32_t    domain;         /* Observation domain, random per run */
+    uint32_t    seq;            /* Data records sent before */
+} psk_receiver_t;
+
+/**
+ * Encode a datagram of at most size bytes with the first spots. On return
+ * count is the number of encoded spots, the datagram has count + 1 data
+ * records. Returns the datagram size, 0 if nothing fits
+ */
+size_t psk_ipfix_encode(uint8_t *buf, size_t size, const psk_receiver_t *rx, const psk_spot_t *spots,
+                        size_t *count, uint32_t now);
+
+/**
+ * Plain callsign, hashed ("<...>") and free text ones are rejected
+ */
+bool psk_call_valid(const char *call);
+
+/**
+ * 4 or 6 chars Maidenhead locator
+ */
+bool psk_grid_valid(const char *grid);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,314 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "psk_reporter.h"
+
+#include "psk_ipfix.h"
+#include "cfg/cfg.h"
+#include "params/params.h"
+#include "main.h"
+#include "ring.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define RING_SIZE       128
+#define RECENT_MAX      512
+
+/* Reported callsign of a band and mode */
+typedef struct {
+    char        call[16];
+    char        mode[8];
+    uint16_t    mhz;
+    uint32_t    time;
+} recent_t;
+
+static ring_t           ring;
+static int              wake_event = -1;
+static atomic_bool      enabled = false;
+
+/* Reporter thread */
+static psk_spot_t       batch[PSK_REPORTER_BATCH];
+static uint16_t         batch_size = 0;
+static recent_t         recent[RECENT_MAX];
+static uint32_t         domain;
+static uint32_t         records = 0;
+
+static atomic_uint      stat_spots = 0;
+static atomic_uint      stat_rejected = 0;
+static atomic_uint      stat_repeated = 0;
+static atomic_uint      stat_sent = 0;
+static atomic_uint      stat_packets = 0;
+static atomic_uint      stat_errors = 0;
+
+static void wake() {
+    uint64_t val = 1;
+
+    if (wake_event >= 0 && write(wake_event, &val, sizeof(val)) < 0) {
+        LV_LOG_WARN("PSK Reporter wake event");
+    }
+}
+
+/* Decode thread */
+
+void psk_reporter_spot(const char *call, const char *grid, int snr, uint64_t freq_hz, const char *mode) {
+    if (!atomic_load_explicit(&enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    psk_spot_t *spot = ring_reserve(ring);
+
+    if (!spot) {
+        return;
+    }
+    strncpy(spot->call, call, sizeof(spot->call) - 1);
+    spot->call[sizeof(spot->call) - 1] = '\0';
+    strncpy(spot->grid, grid, sizeof(spot->grid) - 1);
+    spot->grid[sizeof(spot->grid) - 1] = '\0';
+    strncpy(spot->mode, mode, sizeof(spot->mode) - 1);
+    spot->mode[sizeof(spot->mode) - 1] = '\0';
+    spot->snr = snr < -128 ? -128 : snr > 127 ? 127 : snr;
+    spot->freq = freq_hz;
+    spot->time = time(NULL);
+
+    ring_commit(ring);
+    atomic_fetch_add_explicit(&stat_spots, 1, memory_order_relaxed);
+}
+
+/* Reporter thread */
+
+/**
+ * False if the callsign was reported on the band and mode lately, otherwise
+ * remember it in place of an expired or the oldest one
+ */
+static bool recent_add(const psk_spot_t *spot) {
+    uint16_t    mhz = spot->freq / 1000000;
+    recent_t    *oldest = &recent[0];
+
+    for (uint16_t i = 0; i < RECENT_MAX; i++) {
+        recent_t *r = &recent[i];
+
+        if (r->mhz == mhz && strcmp(r->call, spot->call) == 0 && strcmp(r->mode, spot->mode) == 0) {
+            if (spot->time - r->time < PSK_REPORTER_REPEAT_S) {
+                return false;
+            }
+            oldest = r;
+            break;
+        }
+        if (r->time < oldest->time) {
+            oldest = r;
+        }
+    }
+
+    strcpy(oldest->call, spot->call);
+    strcpy(oldest->mode, spot->mode);
+    oldest->mhz = mhz;
+    oldest->time = spot->time;
+
+    return true;
+}
+
+static void drain(uint64_t now, uint64_t *send_time) {
+    psk_spot_t *spot;
+
+    while (batch_size < PSK_REPORTER_BATCH && (spot = ring_peek(ring))) {
+        /* "<...>" of unknown hashes and "<CALL>" of known ones */
+        if (spot->call[0] == '<') {
+            size_t len = strlen(spot->call);
+
+            if (len > 2 && spot->call[len - 1] == '>') {
+                memmove(spot->call, spot->call + 1, len - 2);
+                spot->call[len - 2] = '\0';
+            }
+        }
+
+        if (!psk_call_valid(spot->call)) {
+            atomic_fetch_add_explicit(&stat_rejected, 1, memory_order_relaxed);
+        } else if (!recent_add(spot)) {
+            atomic_fetch_add_explicit(&stat_repeated, 1, memory_order_relaxed);
+        } else {
+            if (!psk_grid_valid(spot->grid)) {
+                spot->grid[0] = '\0';
+            }
+            if (batch_size == 0 && *send_time < now + PSK_REPORTER_PERIOD_S * 1000) {
+                *send_time = now + PSK_REPORTER_PERIOD_S * 1000;
+            }
+            batch[batch_size++] = *spot;
+        }
+        ring_release(ring);
+    }
+}
+
+static int connect_server() {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM };
+    struct addrinfo *res;
+    int             err = getaddrinfo(PSK_REPORTER_HOST, PSK_REPORTER_PORT, &hints, &res);
+
+    if (err) {
+        LV_LOG_WARN("PSK Reporter %s: %s", PSK_REPORTER_HOST, gai_strerror(err));
+        return -1;
+    }
+
+    int sock = -1;
+
+    for (struct addrinfo *ai = res; ai && sock < 0; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+
+        if (sock >= 0 && connect(sock, ai->ai_addr, ai->ai_addrlen) < 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+
+    return sock;
+}
+
+static void send_batch() {
+    char call[sizeof(params.callsign.x)];
+    char grid[sizeof(params.qth.x)];
+
+    strncpy(call, params.callsign.x, sizeof(call) - 1);
+    call[sizeof(call) - 1] = '\0';
+    strncpy(grid, params.qth.x, sizeof(grid) - 1);
+    grid[sizeof(grid) - 1] = '\0';
+
+    if (!psk_call_valid(call)) {
+        LV_LOG_WARN("PSK Reporter: no own callsign, %u spots dropped", batch_size);
+        batch_size = 0;
+        return;
+    }
+
+    int sock = connect_server();
+
+    if (sock < 0) {
+        atomic_fetch_add_explicit(&stat_errors, 1, memory_order_relaxed);
+        batch_size = 0;
+        return;
+    }
+
+    static uint8_t  buf[PSK_IPFIX_MAX];
+    psk_receiver_t  rx = {
+        .call = call,
+        .grid = psk_grid_valid(grid) ? grid : "",
+        .software = "X6100 GUI " VERSION,
+        .domain = domain,
+    };
+    size_t          done = 0;
+
+    while (done < batch_size) {
+        size_t count = batch_size - done;
+
+        rx.seq = records;
+
+        size_t size = psk_ipfix_encode(buf, sizeof(buf), &rx, &batch[done], &count, time(NULL));
+
+        if (count == 0) {
+            break;
+        }
+        if (send(sock, buf, size, 0) < 0) {
+            LV_LOG_WARN("PSK Reporter send: %s", strerror(errno));
+            atomic_fetch_add_explicit(&stat_errors, 1, memory_order_relaxed);
+            break;
+        }
+        records += count + 1;
+        done += count;
+        atomic_fetch_add_explicit(&stat_sent, count, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stat_packets, 1, memory_order_relaxed);
+    }
+    close(sock);
+
+    LV_LOG_INFO("PSK Reporter: %zu of %u spots sent", done, batch_size);
+    batch_size = 0;
+}
+
+static void * psk_reporter_thread(void *arg) {
+    set_thread_name("psk_reporter");
+
+    struct pollfd   fds = { .fd = wake_event, .events = POLLIN };
+    uint64_t        send_time = 0;
+
+    while (true) {
+        bool on = atomic_load(&enabled);
+
+        if (poll(&fds, 1, on ? PSK_REPORTER_DRAIN_MS : -1) < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("PSK Reporter poll: %s", strerror(errno));
+                sleep_usec(100000);
+            }
+            continue;
+        }
+        if (fds.revents & POLLIN) {
+            uint64_t val;
+
+            if (read(wake_event, &val, sizeof(val)) < 0) {
+                LV_LOG_WARN("PSK Reporter wake event");
+            }
+        }
+        if (!atomic_load(&enabled)) {
+            ring_flush(ring);
+            batch_size = 0;
+            continue;
+        }
+
+        uint64_t now = get_time();
+
+        drain(now, &send_time);
+
+        if (batch_size && (now >= send_time || batch_size == PSK_REPORTER_BATCH)) {
+            send_batch();
+            send_time = now + PSK_REPORTER_PERIOD_S * 1000;
+        }
+    }
+    return NULL;
+}
+
+static void on_psk_reporter_change(Subject *subj, void *user_data) {
+    atomic_store(&enabled, subject_get_int(subj));
+    wake();
+}
+
+void psk_reporter_init() {
+    wake_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_event < 0) {
+        LV_LOG_ERROR("PSK Reporter wake event");
+        return;
+    }
+
+    ring = ring_create(sizeof(psk_spot_t), RING_SIZE);
+    domain = (uint32_t) time(NULL) ^ ((uint32_t) getpid() << 16);
+
+    subject_add_observer_and_call(cfg.psk_reporter.val, on_psk_reporter_change, NULL);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, psk_reporter_thread, NULL);
+    pthread_detach(thread);
+}
+
+void psk_reporter_stats(psk_reporter_stats_t *stats) {
+    stats->spots = atomic_load(&stat_spots);
+    stats->dropped = ring ? ring_get_overruns(ring) : 0;
+    stats->rejected = atomic_load(&stat_rejected);
+    stats->repeated = atomic_load(&stat_repeated);
+    stats->sent = atomic_load(&stat_sent);
+    stats->packets = atomic_load(&stat_packets);
+    stats->errors = atomic_load(&stat_errors);
+}
@@ -0,0 +1,57 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * FT8/FT4 decodes to PSK Reporter. The decode thread only puts a spot to a
+ * ring, the "psk_reporter" thread drains it every PSK_REPORTER_DRAIN_MS,
+ * drops callsigns reported on the same band and mode within
+ * PSK_REPORTER_REPEAT_S and sends the batch as IPFIX datagrams (psk_ipfix.h)
+ * at most every PSK_REPORTER_PERIOD_S. Enabled by cfg.psk_reporter, needs
+ * the own callsign, the QTH locator is sent when set.
+ */
+
+#define PSK_REPORTER_HOST       "report.pskreporter.info"
+#define PSK_REPORTER_PORT       "4739"
+#define PSK_REPORTER_PERIOD_S   300
+#define PSK_REPORTER_REPEAT_S   (30 * 60)
+#define PSK_REPORTER_DRAIN_MS   5000
+#define PSK_REPORTER_BATCH      256
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t    spots;          /* Put by the decode thread */
+    uint32_t    dropped;        /* The ring was full */
+    uint32_t    rejected;       /* Hashed or bad callsign */
+    uint32_t    repeated;
+    uint32_t    sent;           /* Spots in the sent datagrams */
+    uint32_t    packets;
+    uint32_t    errors;         /* Failed lookups and sends */
+} psk_reporter_stats_t;
+
+void psk_reporter_init();
+
+/**
+ * Decode of the mode ("FT8", "FT4") at freq_hz (dial + audio), lock-free
+ */
+void psk_reporter_spot(const char *call, const char *grid, int snr, uint64_t freq_hz, const char *mode);
+
+/**
+ * Counters since start
+ */
+void psk_reporter_stats(psk_reporter_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
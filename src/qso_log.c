@@ -11,6 +11,7 @@
 #include "util.h"
 #include "msg.h"
 #include "adif.h"
+#include "ft8/call_intern.h"
 
 #include <lvgl/src/misc/lv_log.h>
 #include <sqlite3.h>
@@ -18,14 +19,154 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdatomic.h>
+
+#define WORKED_INIT_SIZE    1024    // Power of 2
+
+#define IMPORT_CHUNK        2000    // Records per transaction
+#define IMPORT_PROGRESS_MS  500
+
+#define EXPORT_BUF          (64 * 1024)
+
+#define QUEUE_SIZE          256
+#define QUEUE_DELAY_MS      2000    // Since the first queued record
+
+#define INSERT_SQL \
+    "INSERT INTO qso_log (" \
+        "ts, freq, band, mode, local_callsign, remote_callsign, rsts, rstr, " \
+        "local_grid, remote_grid, op_name, canonized_remote_callsign" \
+    ") VALUES (datetime(:ts, 'unixepoch'), :freq, :band, :mode, :local_callsign, :remote_callsign, " \
+        ":rsts, :rstr, :local_grid, :remote_grid, :op_name, :canonized_remote_callsign) " \
+    "ON CONFLICT(ts, remote_callsign) DO NOTHING"
+
+/*
+ * Worked before index: ID of the canonized callsign -> modes bitmask per band.
+ * Open addressing hash table, loaded from the log on init and updated on save,
+ * so the decode path does not touch SQLite and compares integers
+ */
+typedef struct {
+    call_id_t   call;               // CALL_ID_NONE - free slot
+    uint8_t     band_modes[QSO_LOG_BANDS];
+} worked_entry_t;
+
+typedef struct {
+    sqlite3_stmt    *stmt;
+    size_t          total;
+    size_t          inserted;
+    size_t          in_tx;
+    uint64_t        progress_time;
+} import_ctx_t;
 
-static sqlite3_stmt     *search_callsign_stmt=NULL;
 static sqlite3          *db = NULL;
+static sqlite3          *db_read = NULL;        /* Read-only, queries don't wait for the writers */
+static atomic_bool      export_run = false;
+
+static worked_entry_t   *worked = NULL;
+static size_t           worked_size = 0;
+static size_t           worked_count = 0;
+static pthread_mutex_t  worked_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Records for the writer thread */
+static qso_log_record_t queue[QUEUE_SIZE];
+static size_t           queue_count = 0;
+static bool             queue_flush = false;
+static pthread_mutex_t  queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   queue_done = PTHREAD_COND_INITIALIZER;
 
 
 static bool create_tables();
 static void* import_adif_thread(void* args);
+static void* export_adif_thread(void* args);
+static void* writer_thread(void* args);
+static void worked_load();
+static void worked_add(const char *callsign, qso_log_band_t band, qso_log_mode_t mode);
+
+
+static uint32_t call_hash(call_id_t call) {
+    return call * 2654435761u;
+}
+
+/**
+ * Slot of callsign or free slot for it. Under worked_mutex
+ */
+static worked_entry_t * worked_find(call_id_t call) {
+    if (!worked) {
+        return NULL;
+    }
+
+    size_t i = call_hash(call) & (worked_size - 1);
+
+    while (worked[i].call && worked[i].call != call) {
+        i = (i + 1) & (worked_size - 1);
+    }
+    return &worked[i];
+}
+
+static bool worked_grow() {
+    worked_entry_t  *old = worked;
+    size_t          old_size = worked_size;
+    size_t          size = old_size ? old_size * 2 : WORKED_INIT_SIZE;
+
+    worked = calloc(size, sizeof(worked_entry_t));
+
+    if (!worked) {
+        LV_LOG_ERROR("Can't allocate worked index");
+        worked = old;
+        return false;
+    }
+    worked_size = size;
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (old[i].call) {
+            *worked_find(old[i].call) = old[i];
+        }
+    }
+    free(old);
+    return true;
+}
+
+static void worked_add(const char *callsign, qso_log_band_t band, qso_log_mode_t mode) {
+    call_id_t call = call_intern_canon(callsign);
 
+    if (call == CALL_ID_NONE) {
+        return;
+    }
+    pthread_mutex_lock(&worked_mutex);
+
+    // Load factor below 0.75
+    if ((worked_count + 1) * 4 > worked_size * 3 && !worked_grow()) {
+        pthread_mutex_unlock(&worked_mutex);
+        return;
+    }
+
+    worked_entry_t *entry = worked_find(call);
+
+    if (!entry->call) {
+        entry->call = call;
+        worked_count++;
+    }
+    entry->band_modes[qso_log_band_index(band)] |= 1 << mode;
+
+    pthread_mutex_unlock(&worked_mutex);
+}
+
+static void worked_load() {
+    sqlite3_stmt    *stmt;
+    int             rc;
+
+    rc = sqlite3_prepare_v2(db, "SELECT DISTINCT canonized_remote_callsign, band, mode FROM qso_log", -1, &stmt, 0);
+
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR("Can't load worked index");
+        return;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        worked_add((const char *) sqlite3_column_text(stmt, 0), sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2));
+    }
+    sqlite3_finalize(stmt);
+    LV_LOG_USER("Worked index: %zu callsigns", worked_count);
+}
 
 bool qso_log_init() {
     int rc = sqlite3_open("/mnt/qso_log.db", &db);
@@ -34,14 +175,45 @@ bool qso_log_init() {
         LV_LOG_ERROR("Can't open qso_log.db");
         return false;
     }
-    return create_tables();
+    if (sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL) != SQLITE_OK) {
+        LV_LOG_WARN("Can't switch qso_log.db to WAL: %s", sqlite3_errmsg(db));
+    }
+    if (!create_tables()) {
+        return false;
+    }
+    if (sqlite3_open_v2("/mnt/qso_log.db", &db_read, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        LV_LOG_WARN("Can't open qso_log.db for reading, sharing the connection");
+        sqlite3_close(db_read);
+        db_read = db;
+    }
+    worked_load();
+
+    pthread_t thr;
+
+    if (pthread_create(&thr, NULL, writer_thread, NULL) != 0) {
+        LV_LOG_ERROR("QSO log writer thread start failed");
+    } else {
+        pthread_detach(thr);
+    }
+    return true;
 }
 
 void qso_log_destruct() {
+    if (db_read && db_read != db) {
+        sqlite3_close(db_read);
+    }
+    db_read = NULL;
+
     if (db) {
         sqlite3_close(db);
         db = NULL;
     }
+    pthread_mutex_lock(&worked_mutex);
+    free(worked);
+    worked = NULL;
+    worked_size = 0;
+    worked_count = 0;
+    pthread_mutex_unlock(&worked_mutex);
 }
 
 void qso_log_import_adif(const char * path) {
@@ -56,6 +228,20 @@ void qso_log_import_adif(const char * path) {
     }
 }
 
+void qso_log_export_adif(const char * path) {
+    pthread_t   thr;
+    bool        expected = false;
+
+    if (!atomic_compare_exchange_strong(&export_run, &expected, true)) {
+        msg_update_text_fmt("Log export is running");
+        return;
+    }
+    if (pthread_create(&thr, NULL, export_adif_thread, (void*)path) != 0) {
+        LV_LOG_ERROR("Export adif thread start failed");
+        atomic_store(&export_run, false);
+    }
+}
+
 qso_log_band_t qso_log_freq_to_band(uint64_t freq_hz)
 {
     uint32_t freq_khz = freq_hz  / 1000;
@@ -142,6 +328,17 @@ qso_log_record_t qso_log_record_create(const char * local_call, const char * rem
 }
 
 
+static inline void column_copy(sqlite3_stmt *stmt, int col, char *dst, size_t size) {
+    const char *val = (const char *) sqlite3_column_text(stmt, col);
+
+    if (val) {
+        strncpy(dst, val, size - 1);
+        dst[size - 1] = '\0';
+    } else {
+        dst[0] = '\0';
+    }
+}
+
 static inline int bind_optional_text(sqlite3_stmt * stmt, int pos, const char * val) {
     if (!val) {
         return sqlite3_bind_null(stmt, pos);
@@ -150,158 +347,480 @@ static inline int bind_optional_text(sqlite3_stmt * stmt, int pos, const char *
     }
 }
 
-int qso_log_record_save(qso_log_record_t qso) {
-    sqlite3_stmt    *stmt;
-    int             rc;
+/**
+ * Bind QSO to the INSERT_SQL statement. Returns false, if the record can't be saved
+ */
+static bool bind_record(sqlite3_stmt *stmt, const qso_log_record_t *qso) {
+    int rc;
 
-    if (strlen(qso.local_call) == 0) {
+    if (strlen(qso->local_call) == 0) {
         LV_LOG_ERROR("Local callsign is required");
-        return -1;
+        return false;
     }
-    if (strlen(qso.remote_call) == 0) {
+    if (strlen(qso->remote_call) == 0) {
         LV_LOG_ERROR("Remote callsign is required");
-        return -1;
+        return false;
     }
 
-    rc = sqlite3_prepare_v2(
-        db, "INSERT OR IGNORE INTO qso_log ("
-                "ts, freq, band, mode, local_callsign, remote_callsign, rsts, rstr, "
-                "local_grid, remote_grid, op_name, canonized_remote_callsign"
-            ") VALUES (datetime(:ts, 'unixepoch'), :freq, :band, :mode, :local_callsign, :remote_callsign, "
-                ":rsts, :rstr, :local_grid, :remote_grid, :op_name, :canonized_remote_callsign)",
-                       -1, &stmt, 0);
+    rc = sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":ts"), qso->time);
     if (rc != SQLITE_OK) {
-        LV_LOG_ERROR("Error in prepairing query");
-        return -1;
+        LV_LOG_ERROR("Can't bind ts: %i", rc);
+        return false;
+    }
+    rc = sqlite3_bind_double(stmt, sqlite3_bind_parameter_index(stmt, ":freq"), (double) qso->freq_mhz);
+    if (rc != SQLITE_OK) return false;
+    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":band"), qso->band);
+    if (rc != SQLITE_OK) return false;
+    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":mode"), qso->mode);
+    if (rc != SQLITE_OK) return false;
+    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":local_callsign"), qso->local_call, strlen(qso->local_call), 0);
+    if (rc != SQLITE_OK) return false;
+    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":remote_callsign"), qso->remote_call, strlen(qso->remote_call), 0);
+    if (rc != SQLITE_OK) return false;
+    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":rsts"), qso->rsts);
+    if (rc != SQLITE_OK) return false;
+    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":rstr"), qso->rstr);
+    if (rc != SQLITE_OK) return false;
+    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":local_grid"), qso->local_grid);
+    if (rc != SQLITE_OK) return false;
+    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":remote_grid"), qso->remote_grid);
+    if (rc != SQLITE_OK) return false;
+    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":op_name"), qso->name);
+    if (rc != SQLITE_OK) return false;
+
+    // Interned string lives while the app runs
+    const char *canonized = call_intern_str(call_intern_canon(qso->remote_call));
+
+    if (!canonized) {
+        canonized = qso->remote_call;
     }
-    rc = sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":ts"), qso.time);
+
+    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":canonized_remote_callsign"), canonized);
+    if (rc != SQLITE_OK) return false;
+
+    return true;
+}
+
+int qso_log_record_save(qso_log_record_t qso) {
+    sqlite3_stmt    *stmt;
+    int             rc;
+
+    rc = sqlite3_prepare_v2(db, INSERT_SQL, -1, &stmt, 0);
     if (rc != SQLITE_OK) {
-        printf("check point: %i\n", rc);
-        printf("column_id: %i\n", sqlite3_bind_parameter_index(stmt, ":ts"));
-        fflush(stdout);
+        LV_LOG_ERROR("Error in prepairing query");
         return -1;
     }
-    rc = sqlite3_bind_double(stmt, sqlite3_bind_parameter_index(stmt, ":freq"), (double) qso.freq_mhz);
-    if (rc != SQLITE_OK) return -1;
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":band"), qso.band);
-    if (rc != SQLITE_OK) return -1;
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":mode"), qso.mode);
-    if (rc != SQLITE_OK) return -1;
-    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":local_callsign"), qso.local_call, strlen(qso.local_call), 0);
-    if (rc != SQLITE_OK) return -1;
-    rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":remote_callsign"), qso.remote_call, strlen(qso.remote_call), 0);
-    if (rc != SQLITE_OK) return -1;
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":rsts"), qso.rsts);
-    if (rc != SQLITE_OK) return -1;
-    rc = sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":rstr"), qso.rstr);
-    if (rc != SQLITE_OK) return -1;
-    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":local_grid"), qso.local_grid);
-    if (rc != SQLITE_OK) return -1;
-    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":remote_grid"), qso.remote_grid);
-    if (rc != SQLITE_OK) return -1;
-    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":op_name"), qso.name);
-    if (rc != SQLITE_OK) return -1;
-
-    char * canonized_remote_callsign = util_canonize_callsign(qso.remote_call, true);
-
-    rc = bind_optional_text(stmt, sqlite3_bind_parameter_index(stmt, ":canonized_remote_callsign"), canonized_remote_callsign);
-    if (rc != SQLITE_OK) {
-        free(canonized_remote_callsign);
+
+    if (!bind_record(stmt, &qso)) {
+        sqlite3_finalize(stmt);
         return -1;
     }
 
     if(sqlite3_step(stmt) != SQLITE_DONE) {
-        printf("Error during execute: `%s`\n", sqlite3_expanded_sql(stmt));
-        free(canonized_remote_callsign);
+        LV_LOG_ERROR("Error during execute: `%s`", sqlite3_expanded_sql(stmt));
+        sqlite3_finalize(stmt);
         return -1;
     }
 
     int changed = sqlite3_changes(db);
     if (changed == 0) {
-        printf("Not inserted `%s`\n", sqlite3_expanded_sql(stmt));
+        LV_LOG_WARN("Not inserted `%s`", sqlite3_expanded_sql(stmt));
+    } else {
+        worked_add(qso.remote_call, qso.band, qso.mode);
     }
 
-    free(canonized_remote_callsign);
-
     sqlite3_finalize(stmt);
     return changed;
 }
 
+bool qso_log_record_queue(const qso_log_record_t *qso) {
+    bool res = false;
 
-qso_log_search_worked_t qso_log_search_worked(const char *callsign, qso_log_mode_t mode, qso_log_band_t band)
-{
-    int                         rc;
-    qso_log_search_worked_t     worked = SEARCH_WORKED_NO;
-
-    if (!search_callsign_stmt) {
-        rc = sqlite3_prepare_v3(db, "SELECT DISTINCT band, mode FROM qso_log WHERE canonized_remote_callsign LIKE ?",
-                        -1, SQLITE_PREPARE_PERSISTENT, &search_callsign_stmt, 0);
-        if (rc != SQLITE_OK) {
-            return -1;
+    pthread_mutex_lock(&queue_mutex);
+    if (queue_count < QUEUE_SIZE) {
+        queue[queue_count++] = *qso;
+        pthread_cond_signal(&queue_cond);
+        res = true;
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    if (!res) {
+        LV_LOG_ERROR("QSO log queue is full");
+    }
+    return res;
+}
+
+void qso_log_flush() {
+    pthread_mutex_lock(&queue_mutex);
+    if (queue_count && db) {
+        queue_flush = true;
+        pthread_cond_signal(&queue_cond);
+
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 5;
+
+        while (queue_flush) {
+            if (pthread_cond_timedwait(&queue_done, &queue_mutex, &deadline) != 0) {
+                LV_LOG_WARN("QSO log flush timed out");
+                break;
+            }
         }
-    } else {
-        sqlite3_reset(search_callsign_stmt);
-        sqlite3_clear_bindings(search_callsign_stmt);
     }
+    pthread_mutex_unlock(&queue_mutex);
+}
 
-    char * canonized_callsign = util_canonize_callsign(callsign, true);
-    if (!canonized_callsign) {
-        canonized_callsign = strdup(callsign);
+/**
+ * Queued records in one transaction, instead of a journal sync per QSO
+ */
+static void write_batch(sqlite3_stmt *stmt, const qso_log_record_t *records, size_t count) {
+    char    *err = NULL;
+    size_t  inserted = 0;
+
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, &err) != SQLITE_OK) {
+        LV_LOG_ERROR("QSO log begin: %s", err);
+        sqlite3_free(err);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (bind_record(stmt, &records[i])) {
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                LV_LOG_ERROR("QSO log insert: %s", sqlite3_errmsg(db));
+            } else if (sqlite3_changes(db) > 0) {
+                inserted++;
+                worked_add(records[i].remote_call, records[i].band, records[i].mode);
+            }
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+    if (sqlite3_exec(db, "COMMIT", NULL, NULL, &err) != SQLITE_OK) {
+        LV_LOG_ERROR("QSO log commit: %s", err);
+        sqlite3_free(err);
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return;
     }
-    rc = sqlite3_bind_text(search_callsign_stmt, 1, canonized_callsign, strlen(canonized_callsign), 0);
+    LV_LOG_INFO("QSO log: %zu of %zu saved", inserted, count);
+}
+
+static void * writer_thread(void* args) {
+    set_thread_name("qso_log");
+
+    static qso_log_record_t batch[QUEUE_SIZE];
+    sqlite3_stmt            *stmt;
+
+    if (sqlite3_prepare_v2(db, INSERT_SQL, -1, &stmt, 0) != SQLITE_OK) {
+        LV_LOG_ERROR("Error in prepairing query");
+        return NULL;
+    }
+
+    while (true) {
+        pthread_mutex_lock(&queue_mutex);
+
+        while (queue_count == 0) {
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+        }
+
+        /* More records of the burst go to the same transaction */
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += QUEUE_DELAY_MS / 1000;
+        deadline.tv_nsec += (QUEUE_DELAY_MS % 1000) * 1000000L;
+
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!queue_flush && queue_count < QUEUE_SIZE / 2) {
+            if (pthread_cond_timedwait(&queue_cond, &queue_mutex, &deadline) != 0) {
+                break;
+            }
+        }
+
+        size_t count = queue_count;
+
+        memcpy(batch, queue, count * sizeof(qso_log_record_t));
+        queue_count = 0;
+        pthread_mutex_unlock(&queue_mutex);
+
+        write_batch(stmt, batch, count);
+
+        pthread_mutex_lock(&queue_mutex);
+        if (queue_count == 0) {
+            queue_flush = false;
+            pthread_cond_broadcast(&queue_done);
+        }
+        pthread_mutex_unlock(&queue_mutex);
+    }
+    return NULL;
+}
+
+size_t qso_log_records_since(time_t from, qso_log_record_cb_t cb, void *user) {
+    sqlite3_stmt    *stmt;
+    size_t          count = 0;
+
+    if (!db_read) {
+        return 0;
+    }
+
+    int rc = sqlite3_prepare_v2(db_read,
+        "SELECT CAST(strftime('%s', ts) AS INTEGER), freq, band, mode, local_callsign, remote_callsign, rsts, rstr, "
+            "local_grid, remote_grid "
+        "FROM qso_log WHERE ts >= datetime(:from, 'unixepoch') ORDER BY ts", -1, &stmt, 0);
+
     if (rc != SQLITE_OK) {
-        free(canonized_callsign);
-        return -1;
+        LV_LOG_ERROR("Can't query QSOs: %s", sqlite3_errmsg(db_read));
+        return 0;
+    }
+    sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":from"), from);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        qso_log_record_t qso = {
+            .time = sqlite3_column_int64(stmt, 0),
+            .freq_mhz = sqlite3_column_double(stmt, 1),
+            .band = sqlite3_column_int(stmt, 2),
+            .mode = sqlite3_column_int(stmt, 3),
+            .rsts = sqlite3_column_int(stmt, 6),
+            .rstr = sqlite3_column_int(stmt, 7),
+        };
+
+        column_copy(stmt, 4, qso.local_call, sizeof(qso.local_call));
+        column_copy(stmt, 5, qso.remote_call, sizeof(qso.remote_call));
+        column_copy(stmt, 8, qso.local_grid, sizeof(qso.local_grid));
+        column_copy(stmt, 9, qso.remote_grid, sizeof(qso.remote_grid));
+
+        cb(&qso, user);
+        count++;
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+
+qso_log_search_worked_t qso_log_search_worked(const char *callsign, qso_log_mode_t mode, qso_log_band_t band)
+{
+    qso_log_search_worked_t worked_type = SEARCH_WORKED_NO;
+    call_id_t               call = call_intern_find_canon(callsign);
+    int                     cancel_state;
+
+    // Not interned - not logged
+    if (call == CALL_ID_NONE) {
+        return SEARCH_WORKED_NO;
     }
 
-    while (sqlite3_step(search_callsign_stmt) != SQLITE_DONE) {
-        worked = SEARCH_WORKED_YES;
-        if ((sqlite3_column_int(search_callsign_stmt, 0) == band) &&
-            (sqlite3_column_int(search_callsign_stmt, 1) == mode))
-        {
-            worked = SEARCH_WORKED_SAME_MODE;
-            break;
+    // Called from the FT8 decode thread, which is cancelled asynchronously
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    pthread_mutex_lock(&worked_mutex);
+
+    worked_entry_t *entry = worked_find(call);
+
+    if (entry && entry->call) {
+        worked_type = SEARCH_WORKED_YES;
+
+        if (entry->band_modes[qso_log_band_index(band)] & (1 << mode)) {
+            worked_type = SEARCH_WORKED_SAME_MODE;
         }
     }
 
-    free(canonized_callsign);
-    return worked;
+    pthread_mutex_unlock(&worked_mutex);
+    pthread_setcancelstate(cancel_state, NULL);
+
+    return worked_type;
+}
+
+
+static bool import_commit(import_ctx_t *ctx, bool begin) {
+    char *err = NULL;
+
+    if (sqlite3_exec(db, begin ? "COMMIT; BEGIN" : "COMMIT", NULL, NULL, &err) != SQLITE_OK) {
+        LV_LOG_ERROR("Import commit: %s", err);
+        sqlite3_free(err);
+        return false;
+    }
+    ctx->in_tx = 0;
+    return true;
 }
 
+/**
+ * Insert record of the ADIF parser, records are not kept after that
+ */
+static bool import_record(const qso_log_record_t *qso, void *user) {
+    import_ctx_t    *ctx = (import_ctx_t *) user;
+
+    ctx->total++;
+
+    if (bind_record(ctx->stmt, qso)) {
+        if (sqlite3_step(ctx->stmt) == SQLITE_DONE) {
+            if (sqlite3_changes(db) > 0) {
+                ctx->inserted++;
+                worked_add(qso->remote_call, qso->band, qso->mode);
+            }
+        } else {
+            LV_LOG_ERROR("Import insert: %s", sqlite3_errmsg(db));
+        }
+    }
+
+    sqlite3_reset(ctx->stmt);
+    sqlite3_clear_bindings(ctx->stmt);
+
+    if (++ctx->in_tx >= IMPORT_CHUNK && !import_commit(ctx, true)) {
+        return false;
+    }
+
+    uint64_t now = get_time();
+
+    if (now - ctx->progress_time >= IMPORT_PROGRESS_MS) {
+        ctx->progress_time = now;
+        msg_update_text_fmt("Importing QSO: %zu", ctx->total);
+    }
+
+    return true;
+}
 
 static void * import_adif_thread(void* args) {
+    set_thread_name("adif_import");
 
-    char *path = (char* )args;
+    char            *path = (char* )args;
+    import_ctx_t    ctx = { 0 };
+    char            *err = NULL;
 
     pthread_detach(pthread_self());
 
-    qso_log_record_t * records;
-    int cnt = adif_read(path, &records);
-    char * canonized;
-    size_t updated_rows = 0;
-    size_t c = 0;
-    for (size_t i = 0; i < cnt; i++) {
-        int changed = qso_log_record_save(records[i]);
-        c++;
-        if (changed > 0) {
-            updated_rows += changed;
-        }
-        if (c >= 10) {
-            c = 0;
-            msg_update_text_fmt("Importing QSO: %zu/%zu", i + 1, cnt);
-        }
+    if (sqlite3_prepare_v2(db, INSERT_SQL, -1, &ctx.stmt, 0) != SQLITE_OK) {
+        LV_LOG_ERROR("Error in prepairing query");
+        pthread_exit(NULL);
     }
-    free(records);
 
-    char new_path[128] = {0};
-    snprintf(new_path, sizeof(new_path), "%s.bak", path);
-    rename(path, new_path);
-    msg_update_text_fmt("Imported %u QSOs from %i", updated_rows, cnt);
+    /*
+     * Chunks of IMPORT_CHUNK records per transaction, instead of a journal sync per QSO.
+     * Records are streamed from the parser, the log is never held in memory
+     */
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, &err) != SQLITE_OK) {
+        LV_LOG_ERROR("Import begin: %s", err);
+        sqlite3_free(err);
+        sqlite3_finalize(ctx.stmt);
+        pthread_exit(NULL);
+    }
+
+    ctx.progress_time = get_time();
+
+    int cnt = adif_parse(path, import_record, &ctx);
+
+    if (!import_commit(&ctx, false)) {
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    }
+    sqlite3_finalize(ctx.stmt);
+
+    if (cnt >= 0) {
+        char new_path[128] = {0};
+        snprintf(new_path, sizeof(new_path), "%s.bak", path);
+        rename(path, new_path);
+    }
+    msg_update_text_fmt("Imported %zu QSOs from %zu", ctx.inserted, ctx.total);
     pthread_exit(NULL);
 }
 
 
 
+static int64_t log_count() {
+    sqlite3_stmt    *stmt;
+    int64_t         count = 0;
+
+    if (sqlite3_prepare_v2(db_read, "SELECT count(*) FROM qso_log", -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            count = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return count;
+}
+
+static void * export_adif_thread(void* args) {
+    set_thread_name("adif_export");
+
+    char            *path = (char* )args;
+    sqlite3_stmt    *stmt = NULL;
+    FILE            *fd = NULL;
+    char            *buf = NULL;
+    size_t          len = 0;
+    size_t          done = 0;
+    int64_t         total = log_count();
+    uint64_t        progress_time = get_time();
+
+    pthread_detach(pthread_self());
+
+    buf = malloc(EXPORT_BUF);
+    fd = fopen(path, "w");
+
+    if (!buf || !fd) {
+        LV_LOG_ERROR("Can't open %s", path);
+        msg_update_text_fmt("Log export failed");
+        goto out;
+    }
+
+    if (sqlite3_prepare_v2(db_read,
+        "SELECT CAST(strftime('%s', ts) AS INTEGER), freq, band, mode, local_callsign, remote_callsign, "
+            "rsts, rstr, local_grid, remote_grid, op_name, remote_qth "
+        "FROM qso_log ORDER BY ts", -1, &stmt, 0) != SQLITE_OK)
+    {
+        LV_LOG_ERROR("Error in prepairing query");
+        msg_update_text_fmt("Log export failed");
+        goto out;
+    }
+
+    adif_write_header(fd);
+
+    /* Records are formatted into one buffer, written out when it is nearly full */
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        qso_log_record_t qso;
+
+        qso.time = sqlite3_column_int64(stmt, 0);
+        qso.freq_mhz = sqlite3_column_double(stmt, 1);
+        qso.band = sqlite3_column_int(stmt, 2);
+        qso.mode = sqlite3_column_int(stmt, 3);
+        column_copy(stmt, 4, qso.local_call, sizeof(qso.local_call));
+        column_copy(stmt, 5, qso.remote_call, sizeof(qso.remote_call));
+        qso.rsts = sqlite3_column_int(stmt, 6);
+        qso.rstr = sqlite3_column_int(stmt, 7);
+        column_copy(stmt, 8, qso.local_grid, sizeof(qso.local_grid));
+        column_copy(stmt, 9, qso.remote_grid, sizeof(qso.remote_grid));
+        column_copy(stmt, 10, qso.name, sizeof(qso.name));
+        column_copy(stmt, 11, qso.qth, sizeof(qso.qth));
+
+        len += adif_format_qso(buf + len, EXPORT_BUF - len, &qso);
+
+        if (EXPORT_BUF - len < ADIF_QSO_MAX) {
+            fwrite(buf, 1, len, fd);
+            len = 0;
+        }
+
+        done++;
+
+        uint64_t now = get_time();
+
+        if (now - progress_time >= IMPORT_PROGRESS_MS) {
+            progress_time = now;
+            msg_update_text_fmt("Exporting QSO: %zu/%lli", done, (long long) total);
+        }
+    }
+
+    fwrite(buf, 1, len, fd);
+    msg_update_text_fmt("Exported %zu QSOs", done);
+
+out:
+    if (stmt) {
+        sqlite3_finalize(stmt);
+    }
+    if (fd) {
+        fclose(fd);
+    }
+    free(buf);
+    atomic_store(&export_run, false);
+    pthread_exit(NULL);
+}
+
 static bool create_tables() {
     char    *err = 0;
     int     rc;
@@ -330,8 +849,19 @@ static bool create_tables() {
         return false;
     }
 
+    /*
+     * Canonized callsigns are upper case, binary collation lets equality and prefix range
+     * lookups use the index. Band and mode make it covering for worked_load()
+     */
+    rc = sqlite3_exec(db,
+        "DROP INDEX IF EXISTS qso_log_idx_canonized_remote_callsign",
+        NULL, NULL, &err);
+    if (rc != SQLITE_OK) {
+        LV_LOG_ERROR(err);
+        return false;
+    }
     rc = sqlite3_exec(db,
-        "CREATE INDEX IF NOT EXISTS qso_log_idx_canonized_remote_callsign ON qso_log(canonized_remote_callsign COLLATE NOCASE)",
+        "CREATE INDEX IF NOT EXISTS qso_log_idx_call_band_mode ON qso_log(canonized_remote_callsign, band, mode)",
         NULL, NULL, &err);
     if (rc != SQLITE_OK) {
         LV_LOG_ERROR(err);
@@ -27,6 +27,8 @@ typedef enum {
     BAND_160M   = 160,
 } qso_log_band_t;
 
+#define QSO_LOG_BANDS   12      /* Indexes of qso_log_band_index() */
+
 
 typedef enum {
     MODE_OTHER,
@@ -66,8 +68,31 @@ bool qso_log_init();
 
 int qso_log_record_save(qso_log_record_t qso);
 
+/**
+ * Save the QSO on the "qso_log" thread, with the others queued meanwhile in one
+ * transaction. Any thread. False if the queue is full
+ */
+bool qso_log_record_queue(const qso_log_record_t *qso);
+
+/**
+ * Write the queued QSOs now, before power off
+ */
+void qso_log_flush();
+
+typedef void (*qso_log_record_cb_t)(const qso_log_record_t *qso, void *user);
+
+/**
+ * Pass the saved QSOs of time >= from to cb in time order. Returns their number
+ */
+size_t qso_log_records_since(time_t from, qso_log_record_cb_t cb, void *user);
+
 void qso_log_import_adif(const char *path);
 
+/**
+ * Write the whole log to the ADIF file in background
+ */
+void qso_log_export_adif(const char *path);
+
 /**
  * Create qso log recort struct.
  * Required params: `local_call`, `remote_call`, qso_time`, `mode`, `rsts`, `rstr`,  and `freq_mhz`
@@ -84,3 +109,23 @@ qso_log_search_worked_t qso_log_search_worked(const char *callsign, qso_log_mode
 
 
 qso_log_band_t qso_log_freq_to_band(uint64_t freq_hz);
+
+/**
+ * Dense index of the band, 0 for BAND_OTHER
+ */
+static inline uint8_t qso_log_band_index(qso_log_band_t band) {
+    switch (band) {
+        case BAND_6M:   return 1;
+        case BAND_10M:  return 2;
+        case BAND_12M:  return 3;
+        case BAND_15M:  return 4;
+        case BAND_17M:  return 5;
+        case BAND_20M:  return 6;
+        case BAND_30M:  return 7;
+        case BAND_40M:  return 8;
+        case BAND_60M:  return 9;
+        case BAND_80M:  return 10;
+        case BAND_160M: return 11;
+        default:        return 0;
+    }
+}
@@ -12,6 +12,17 @@
 #include <string.h>
 #include <ctype.h>
 
+#define EARTH_RADIUS    6371.0
+#define CACHE_BITS      8
+
+typedef struct {
+    uint64_t    key;        /* Packed upper case grid, 0 - free slot */
+    qth_pos_t   pos;
+} cache_entry_t;
+
+/* Direct mapped, per thread, so lookups don't need locking */
+static _Thread_local cache_entry_t cache[1 << CACHE_BITS];
+
 
 bool qth_grid_check(const char *grid) {
     uint8_t len = strlen(grid);
@@ -55,6 +66,70 @@ double qth_pos_dist(const double lat1_deg, const double lon1_deg, const double l
     return c * 6371;
 }
 
+void qth_pos_init(qth_pos_t *pos, double lat_deg, double lon_deg) {
+    double lat = lat_deg * M_PI / 180.0;
+    double lon = lon_deg * M_PI / 180.0;
+
+    pos->lat_deg = lat_deg;
+    pos->lon_deg = lon_deg;
+    pos->sin_lat = sin(lat);
+    pos->cos_lat = cos(lat);
+    pos->sin_lon = sin(lon);
+    pos->cos_lon = cos(lon);
+}
+
+bool qth_grid_pos(const char *grid, qth_pos_t *pos) {
+    if (!qth_grid_check(grid)) {
+        return false;
+    }
+
+    uint64_t key = 0;
+
+    for (const char *c = grid; *c; c++) {
+        key = (key << 8) | toupper(*c);
+    }
+
+    cache_entry_t *entry = &cache[(key * 0x9E3779B97F4A7C15ULL) >> (64 - CACHE_BITS)];
+
+    if (entry->key != key) {
+        double lat, lon;
+
+        qth_str_to_pos(grid, &lat, &lon);
+        qth_pos_init(&entry->pos, lat, lon);
+        entry->key = key;
+    }
+
+    *pos = entry->pos;
+    return true;
+}
+
+void qth_pos_dist_batch(const qth_pos_t *from, const qth_pos_t *to, size_t n, double *dist_km, double *bearing_deg) {
+    for (size_t i = 0; i < n; i++) {
+        const qth_pos_t *p = &to[i];
+
+        /* Angle differences from the sum formulas, no trigonometry per pair except acos */
+        double cos_dlon = p->cos_lon * from->cos_lon + p->sin_lon * from->sin_lon;
+        double cos_c = from->sin_lat * p->sin_lat + from->cos_lat * p->cos_lat * cos_dlon;
+
+        if (cos_c > 1.0) {
+            cos_c = 1.0;
+        } else if (cos_c < -1.0) {
+            cos_c = -1.0;
+        }
+
+        dist_km[i] = acos(cos_c) * EARTH_RADIUS;
+
+        if (bearing_deg) {
+            double sin_dlon = p->sin_lon * from->cos_lon - p->cos_lon * from->sin_lon;
+            double y = sin_dlon * p->cos_lat;
+            double x = from->cos_lat * p->sin_lat - from->sin_lat * p->cos_lat * cos_dlon;
+            double b = atan2(y, x) * 180.0 / M_PI;
+
+            bearing_deg[i] = b < 0.0 ? b + 360.0 : b;
+        }
+    }
+}
+
 void qth_pos_to_str(double lat, double lon, char* buf) {
 
     int t1;
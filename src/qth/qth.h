@@ -10,6 +10,17 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
+
+/* Position with precomputed trigonometry, for repeated distance and bearing */
+typedef struct {
+    double  lat_deg;
+    double  lon_deg;
+    double  sin_lat;
+    double  cos_lat;
+    double  sin_lon;
+    double  cos_lon;
+} qth_pos_t;
 
 void qth_str_to_pos(const char * qth, double *lat_deg, double *lon_deg);
 void qth_pos_to_str(double lat_deg, double lon_deg, char * qth);
@@ -17,3 +28,17 @@ void qth_pos_to_str(double lat_deg, double lon_deg, char * qth);
 bool qth_grid_check(const char *grid);
 double qth_pos_dist(const double lat1_deg, const double lon1_deg, const double lat2_deg, const double lon2_deg);
 
+void qth_pos_init(qth_pos_t *pos, double lat_deg, double lon_deg);
+
+/**
+ * Position of the grid center. Results are cached per thread, repeated grids cost a lookup.
+ * Returns false for an invalid grid
+ */
+bool qth_grid_pos(const char *grid, qth_pos_t *pos);
+
+/**
+ * Distance in km and initial bearing in degrees (0..360) from one position to n others.
+ * bearing_deg may be NULL
+ */
+void qth_pos_dist_batch(const qth_pos_t *from, const qth_pos_t *to, size_t n, double *dist_km, double *bearing_deg);
+
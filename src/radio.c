@@ -13,11 +13,18 @@
 #include "dsp.h"
 #include "params/params.h"
 #include "hkey.h"
-#include "tx_info.h"
+#include "telemetry.h"
 #include "info.h"
 #include "dialog_swrscan.h"
 #include "cw.h"
 #include "pubsub_ids.h"
+#include "iq_capture.h"
+#include "iq_server.h"
+#include "band_activity.h"
+#include "display_snapshot.h"
+#include "qso_log.h"
+#include "trace.h"
+#include "lock_stats.h"
 
 #include <aether_radio/x6100_control/low/flow.h>
 #include <aether_radio/x6100_control/low/gpio.h>
@@ -26,12 +33,33 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <string.h>
-
-
+#include <time.h>
+#include <sys/timerfd.h>
 
 #define FLOW_RESTART_TIMEOUT 300
+#define FLOW_WARM_RESTART_MS 2000   /* Longer gaps restart DSP from scratch */
 #define IDLE_TIMEOUT        (3 * 1000)
 
+#define FLOW_PERIOD_US      (RADIO_SAMPLES * 1000000LL / 100000)    /* 5.12 ms at 100 kHz */
+#define FLOW_MARGIN_US      500                                     /* Wake up a bit before the packet */
+#define FLOW_POLL_US        250
+#define FLOW_RETRY_US       1000
+
+#define CMD_QUEUE_SIZE      64
+
+typedef struct radio_cmd_t radio_cmd_t;
+
+typedef void (*radio_cmd_exec_t)(const radio_cmd_t *cmd);
+
+/* Pending control command, a newer one with the same exec, fn and key replaces the value */
+struct radio_cmd_t {
+    radio_cmd_exec_t    exec;
+    void                *fn;
+    int32_t             key;        /* VFO or x6100_cmd_enum_t */
+    int32_t             val;
+    float               fval;
+};
+
 static radio_state_change_t notify_tx;
 static radio_state_change_t notify_rx;
 
@@ -45,6 +73,20 @@ static uint64_t         prev_time;
 static uint64_t         idle_time;
 static bool             mute = false;
 
+static int              flow_timer = -1;
+static uint64_t         flow_last_us = 0;
+static uint64_t         flow_lost_us = 0;       /* Last packet before a restart, 0 - flow is OK */
+
+static pthread_mutex_t      flow_stats_mux = PTHREAD_MUTEX_INITIALIZER;
+static radio_flow_stats_t   flow_stats;
+static uint64_t             flow_interval_sum_us = 0;
+
+static pthread_mutex_t      cmd_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       cmd_cond = PTHREAD_COND_INITIALIZER;
+static radio_cmd_t          cmd_queue[CMD_QUEUE_SIZE];
+static uint8_t              cmd_count = 0;
+static radio_cmd_stats_t    cmd_stats;
+
 #define WITH_RADIO_LOCK(fn) radio_lock(); fn; radio_unlock();
 
 #define CHANGE_PARAM(new_val, val, dirty, radio_fn) \
@@ -52,19 +94,168 @@ static bool             mute = false;
         params_lock(); \
         val = new_val; \
         params_unlock(&dirty); \
-        radio_lock(); \
-        radio_fn(val); \
-        radio_unlock(); \
+        cmd_put(exec_uint8, radio_fn, 0, val, 0.0f, false); \
         lv_msg_send(MSG_PARAM_CHANGED, NULL); \
     }
 
+static void exec_int8(const radio_cmd_t *cmd) {
+    ((void (*)(int8_t)) cmd->fn)(cmd->val);
+}
+
+static void exec_uint8(const radio_cmd_t *cmd) {
+    ((void (*)(uint8_t)) cmd->fn)(cmd->val);
+}
+
+static void exec_uint16(const radio_cmd_t *cmd) {
+    ((void (*)(uint16_t)) cmd->fn)(cmd->val);
+}
+
+static void exec_uint32(const radio_cmd_t *cmd) {
+    ((void (*)(uint32_t)) cmd->fn)(cmd->val);
+}
+
+static void exec_int(const radio_cmd_t *cmd) {
+    ((void (*)(int32_t)) cmd->fn)(cmd->val);
+}
+
+static void exec_bool(const radio_cmd_t *cmd) {
+    ((void (*)(bool)) cmd->fn)(cmd->val);
+}
+
+static void exec_float(const radio_cmd_t *cmd) {
+    ((void (*)(float)) cmd->fn)(cmd->fval);
+}
+
+static void exec_vfo(const radio_cmd_t *cmd) {
+    ((void (*)(x6100_vfo_t, int32_t)) cmd->fn)(cmd->key, cmd->val);
+}
+
+static void exec_cmd(const radio_cmd_t *cmd) {
+    x6100_control_cmd(cmd->key, cmd->val);
+}
+
+/**
+ * Queue a control command without waiting for the radio link. A pending command
+ * for the same setting only gets the new value. Urgent ones (PTT release) go first
+ */
+static void cmd_put(radio_cmd_exec_t exec, void *fn, int32_t key, int32_t val, float fval, bool urgent) {
+    radio_cmd_t cmd = { .exec = exec, .fn = fn, .key = key, .val = val, .fval = fval };
+    int16_t     pos = -1;
+
+    pthread_mutex_lock(&cmd_mux);
+
+    for (uint8_t i = 0; i < cmd_count; i++) {
+        radio_cmd_t *item = &cmd_queue[i];
+
+        if (item->exec == exec && item->fn == fn && item->key == key) {
+            pos = i;
+            break;
+        }
+    }
+
+    if (pos >= 0) {
+        cmd_stats.coalesced++;
+
+        if (!urgent) {
+            cmd_queue[pos] = cmd;
+            pthread_mutex_unlock(&cmd_mux);
+            return;
+        }
+
+        memmove(&cmd_queue[1], &cmd_queue[0], pos * sizeof(radio_cmd_t));
+        cmd_queue[0] = cmd;
+        pthread_mutex_unlock(&cmd_mux);
+        return;
+    }
+
+    while (cmd_count == CMD_QUEUE_SIZE) {
+        pthread_cond_wait(&cmd_cond, &cmd_mux);
+    }
+
+    if (urgent) {
+        memmove(&cmd_queue[1], &cmd_queue[0], cmd_count * sizeof(radio_cmd_t));
+        cmd_queue[0] = cmd;
+    } else {
+        cmd_queue[cmd_count] = cmd;
+    }
+
+    cmd_count++;
+    cmd_stats.queued++;
+
+    if (cmd_count > cmd_stats.depth_max) {
+        cmd_stats.depth_max = cmd_count;
+    }
+
+    pthread_cond_broadcast(&cmd_cond);
+    pthread_mutex_unlock(&cmd_mux);
+}
+
+/**
+ * Send queued commands in order, called with control_mux held
+ */
+static void cmd_drain() {
+    radio_cmd_t cmd;
+
+    pthread_mutex_lock(&cmd_mux);
+
+    while (cmd_count > 0) {
+        cmd = cmd_queue[0];
+        cmd_count--;
+        memmove(&cmd_queue[0], &cmd_queue[1], cmd_count * sizeof(radio_cmd_t));
+        pthread_cond_broadcast(&cmd_cond);
+        pthread_mutex_unlock(&cmd_mux);
+
+        trace_begin(TRACE_CONTROL, cmd.val);
+        cmd.exec(&cmd);
+        trace_end(TRACE_CONTROL);
+
+        pthread_mutex_lock(&cmd_mux);
+        cmd_stats.executed++;
+    }
+
+    pthread_mutex_unlock(&cmd_mux);
+}
+
+/**
+ * Synchronous access to the control link. Queued commands are sent first,
+ * so a sequence started here sees every setting made before it
+ */
 static void radio_lock() {
-    pthread_mutex_lock(&control_mux);
+    lock_stats_lock(&control_mux, "control");
+    cmd_drain();
 }
 
 static void radio_unlock() {
     idle_time = get_time();
-    pthread_mutex_unlock(&control_mux);
+    lock_stats_unlock(&control_mux, "control");
+}
+
+static void * radio_cmd_thread(void *arg) {
+    set_thread_name("radio_cmd");
+
+    while (true) {
+        pthread_mutex_lock(&cmd_mux);
+
+        while (cmd_count == 0) {
+            pthread_cond_wait(&cmd_cond, &cmd_mux);
+        }
+
+        pthread_mutex_unlock(&cmd_mux);
+
+        radio_lock();
+        radio_unlock();
+    }
+}
+
+void radio_cmd_stats(radio_cmd_stats_t *stats, bool reset) {
+    pthread_mutex_lock(&cmd_mux);
+    *stats = cmd_stats;
+    stats->depth = cmd_count;
+
+    if (reset) {
+        memset(&cmd_stats, 0, sizeof(cmd_stats));
+    }
+    pthread_mutex_unlock(&cmd_mux);
 }
 
 /**
@@ -84,6 +275,104 @@ static void recover_processing_audio_inputs() {
     radio_unlock();
 }
 
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void flow_stats_packet() {
+    uint64_t now = now_us();
+
+    pthread_mutex_lock(&flow_stats_mux);
+    if (flow_last_us) {
+        uint32_t interval = now - flow_last_us;
+
+        flow_interval_sum_us += interval;
+        flow_stats.intervals++;
+
+        if (flow_stats.intervals == 1 || interval < flow_stats.interval_min_us) {
+            flow_stats.interval_min_us = interval;
+        }
+        if (interval > flow_stats.interval_max_us) {
+            flow_stats.interval_max_us = interval;
+        }
+        if (interval > FLOW_PERIOD_US * 2) {
+            flow_stats.late++;
+        }
+        flow_stats.interval_avg_us = flow_interval_sum_us / flow_stats.intervals;
+    }
+    if (flow_lost_us) {
+        uint32_t outage_ms = (now - flow_lost_us) / 1000;
+
+        flow_stats.outages++;
+        flow_stats.outage_last_ms = outage_ms;
+        flow_stats.outage_total_ms += outage_ms;
+
+        if (outage_ms > flow_stats.outage_max_ms) {
+            flow_stats.outage_max_ms = outage_ms;
+        }
+        LV_LOG_USER("Flow is back after %u ms", outage_ms);
+        flow_lost_us = 0;
+    }
+    flow_stats.packets++;
+    pthread_mutex_unlock(&flow_stats_mux);
+
+    flow_last_us = now;
+}
+
+void radio_flow_stats(radio_flow_stats_t *stats, bool reset) {
+    pthread_mutex_lock(&flow_stats_mux);
+    *stats = flow_stats;
+
+    if (reset) {
+        radio_flow_stats_t kept = flow_stats;
+
+        memset(&flow_stats, 0, sizeof(flow_stats));
+        flow_stats.restarts = kept.restarts;
+        flow_stats.restarts_warm = kept.restarts_warm;
+        flow_stats.outages = kept.outages;
+        flow_stats.outage_last_ms = kept.outage_last_ms;
+        flow_stats.outage_max_ms = kept.outage_max_ms;
+        flow_stats.outage_total_ms = kept.outage_total_ms;
+        flow_interval_sum_us = 0;
+    }
+    pthread_mutex_unlock(&flow_stats_mux);
+}
+
+/**
+ * Sleep until the next packet is expected, then poll it often while it is
+ * due and less often when the flow is late
+ */
+static void flow_wait() {
+    uint64_t now = now_us();
+    uint64_t wake;
+
+    if (flow_last_us && now < flow_last_us + FLOW_PERIOD_US - FLOW_MARGIN_US) {
+        wake = flow_last_us + FLOW_PERIOD_US - FLOW_MARGIN_US;
+    } else if (flow_last_us && now < flow_last_us + FLOW_PERIOD_US * 2) {
+        wake = now + FLOW_POLL_US;
+    } else {
+        wake = now + FLOW_RETRY_US;
+    }
+
+    if (flow_timer >= 0) {
+        struct itimerspec its = { 0 };
+        uint64_t          expirations;
+
+        its.it_value.tv_sec = wake / 1000000L;
+        its.it_value.tv_nsec = (wake % 1000000L) * 1000L;
+
+        if (timerfd_settime(flow_timer, TFD_TIMER_ABSTIME, &its, NULL) == 0 &&
+            read(flow_timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+        {
+            return;
+        }
+    }
+    usleep(wake - now);
+}
+
 bool radio_tick() {
     if (now_time < prev_time) {
         prev_time = now_time;
@@ -91,8 +380,12 @@ bool radio_tick() {
 
     int32_t d = now_time - prev_time;
 
+    static uint32_t seq = 0;
+
     if (x6100_flow_read(pack)) {
         prev_time = now_time;
+        trace_instant(TRACE_FLOW_READ, ++seq);
+        flow_stats_packet();
 
         static uint8_t delay = 0;
 
@@ -101,7 +394,13 @@ bool radio_tick() {
             clock_update_power(pack->vext * 0.1f, pack->vbat*0.1f, pack->batcap, pack->flag.charging);
         }
         cfloat *samples = (cfloat*)((char *)pack + offsetof(x6100_flow_t, samples));
-        dsp_samples(samples, RADIO_SAMPLES, pack->flag.tx);
+        if (!iq_replay_is_on()) {
+            trace_begin(TRACE_DSP_SAMPLES, seq);
+            dsp_samples(samples, RADIO_SAMPLES, pack->flag.tx);
+            trace_end(TRACE_DSP_SAMPLES);
+        }
+        iq_capture_put(samples, RADIO_SAMPLES, pack->flag.tx);
+        iq_server_put(samples, RADIO_SAMPLES, pack->flag.tx);
 
         switch (state) {
             case RADIO_RX:
@@ -116,7 +415,7 @@ bool radio_tick() {
                     state = RADIO_RX;
                     notify_rx();
                 } else {
-                    tx_info_update(pack->tx_power * 0.1f, pack->vswr * 0.1f, pack->alc_level * 0.1f);
+                    telemetry_put(pack->tx_power * 0.1f, pack->vswr * 0.1f, pack->alc_level * 0.1f);
                 }
                 break;
 
@@ -144,7 +443,7 @@ bool radio_tick() {
                     WITH_RADIO_LOCK(x6100_control_cmd(x6100_atu_network, pack->atu_params));
                     state = RADIO_RX;
                 } else if (pack->flag.tx) {
-                    tx_info_update(pack->tx_power * 0.1f, pack->vswr * 0.1f, pack->alc_level * 0.1f);
+                    telemetry_put(pack->tx_power * 0.1f, pack->vswr * 0.1f, pack->alc_level * 0.1f);
                 }
                 break;
 
@@ -153,7 +452,7 @@ bool radio_tick() {
                 break;
 
             case RADIO_POWEROFF:
-                x6100_control_poweroff();
+                WITH_RADIO_LOCK(x6100_control_poweroff());
                 state = RADIO_OFF;
                 break;
 
@@ -164,10 +463,35 @@ bool radio_tick() {
         hkey_put(pack->hkey);
     } else {
         if (d > FLOW_RESTART_TIMEOUT) {
-            LV_LOG_WARN("Flow reset");
+            uint64_t now = now_us();
+
             prev_time = now_time;
+
+            /* Averages of a short gap are still good, DSP goes on with them */
+            pthread_mutex_lock(&flow_stats_mux);
+            if (!flow_lost_us) {
+                flow_lost_us = flow_last_us ? flow_last_us : now - d * 1000LL;
+            }
+
+            bool warm = now - flow_lost_us < FLOW_WARM_RESTART_MS * 1000LL;
+
+            flow_stats.restarts++;
+
+            if (warm) {
+                flow_stats.restarts_warm++;
+            }
+            pthread_mutex_unlock(&flow_stats_mux);
+
+            LV_LOG_WARN("Flow reset, %s", warm ? "warm" : "cold");
+            flow_last_us = 0;
+
             x6100_flow_restart();
-            dsp_reset();
+
+            if (warm) {
+                dsp_warm_reset();
+            } else {
+                dsp_reset();
+            }
         }
         return true;
     }
@@ -175,12 +499,21 @@ bool radio_tick() {
 }
 
 static void * radio_thread(void *arg) {
+    set_thread_name("radio");
+    subject_ctx_bind(SUBJECT_CTX_RADIO);
+
+    flow_timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+    if (flow_timer < 0) {
+        LV_LOG_WARN("Can't create flow timer, polling");
+    }
+
     while (true) {
         now_time = get_time();
+        subject_ctx_run(SUBJECT_CTX_RADIO);
 
-        if (radio_tick()) {
-            usleep(15000);
-        }
+        /* Packets queued during a stall are read back to back, then wait for the next one */
+        bool got_packet = !radio_tick();
 
         int32_t idle = now_time - idle_time;
 
@@ -189,58 +522,52 @@ static void * radio_thread(void *arg) {
 
             idle_time = now_time;
         }
+
+        if (!got_packet) {
+            flow_wait();
+        }
     }
 }
 
 static void on_change_int8(Subject *subj, void *user_data) {
-    int32_t new_val = subject_get_int(subj);
-    void (*fn)(int8_t) = (void (*)(int8_t))user_data;
-    WITH_RADIO_LOCK(fn(new_val));
+    cmd_put(exec_int8, user_data, 0, subject_get_int(subj), 0.0f, false);
 }
 
 static void on_change_uint8(Subject *subj, void *user_data) {
-    int32_t new_val = subject_get_int(subj);
-    void (*fn)(uint8_t) = (void (*)(uint8_t))user_data;
-    WITH_RADIO_LOCK(fn(new_val));
+    cmd_put(exec_uint8, user_data, 0, subject_get_int(subj), 0.0f, false);
 }
 
 static void on_change_uint16(Subject *subj, void *user_data) {
-    int32_t new_val = subject_get_int(subj);
-    void (*fn)(uint16_t) = (void (*)(uint16_t))user_data;
-    WITH_RADIO_LOCK(fn(new_val));
+    cmd_put(exec_uint16, user_data, 0, subject_get_int(subj), 0.0f, false);
 }
 
 static void on_change_uint32(Subject *subj, void *user_data) {
-    int32_t new_val = subject_get_int(subj);
-    void (*fn)(uint32_t) = (void (*)(uint32_t))user_data;
-    WITH_RADIO_LOCK(fn(new_val));
+    cmd_put(exec_uint32, user_data, 0, subject_get_int(subj), 0.0f, false);
 }
 
 static void on_change_float(Subject *subj, void *user_data) {
-    float new_val = subject_get_float(subj);
-    void (*fn)(float) = (void (*)(float))user_data;
-    WITH_RADIO_LOCK(fn(new_val));
+    cmd_put(exec_float, user_data, 0, 0, subject_get_float(subj), false);
 }
 
 static void on_vfo_freq_change(Subject *subj, void *user_data) {
     x6100_vfo_t vfo = (x6100_vfo_t )user_data;
     int32_t new_val = subject_get_int(subj);
     int32_t shift = cfg_transverter_get_shift(new_val);
-    WITH_RADIO_LOCK(x6100_control_vfo_freq_set(vfo, new_val - shift));
+    cmd_put(exec_vfo, x6100_control_vfo_freq_set, vfo, new_val - shift, 0.0f, false);
     LV_LOG_USER("Radio set vfo %i freq=%i (%i)", vfo, new_val, new_val - shift);
 }
 
 static void on_vfo_mode_change(Subject *subj, void *user_data) {
     x6100_vfo_t vfo = (x6100_vfo_t )user_data;
     int32_t new_val = subject_get_int(subj);
-    WITH_RADIO_LOCK(x6100_control_vfo_mode_set(vfo, new_val));
+    cmd_put(exec_vfo, x6100_control_vfo_mode_set, vfo, new_val, 0.0f, false);
     LV_LOG_USER("Radio set vfo %i mode=%i", vfo, new_val);;
 }
 
 static void on_vfo_agc_change(Subject *subj, void *user_data) {
     x6100_vfo_t vfo = (x6100_vfo_t )user_data;
     int32_t new_val = subject_get_int(subj);
-    WITH_RADIO_LOCK(x6100_control_vfo_agc_set(vfo, new_val));
+    cmd_put(exec_vfo, x6100_control_vfo_agc_set, vfo, new_val, 0.0f, false);
     LV_LOG_USER("Radio set vfo %i agc=%i", vfo, new_val);
 }
 
@@ -283,27 +610,27 @@ static void update_agc_time(Subject *subj, void *user_data) {
             }
             break;
     }
-    WITH_RADIO_LOCK(x6100_control_agc_time_set(agc_time));
+    cmd_put(exec_uint16, x6100_control_agc_time_set, 0, agc_time, 0.0f, false);
     LV_LOG_USER("Radio set agc time=%u for agc: %i\n", agc_time, agc);
 }
 
 static void on_vfo_att_change(Subject *subj, void *user_data) {
     x6100_vfo_t vfo = (x6100_vfo_t )user_data;
     int32_t new_val = subject_get_int(subj);
-    WITH_RADIO_LOCK(x6100_control_vfo_att_set(vfo, new_val));
+    cmd_put(exec_vfo, x6100_control_vfo_att_set, vfo, new_val, 0.0f, false);
     LV_LOG_USER("Radio set vfo %i att=%i", vfo, new_val);
 }
 
 static void on_vfo_pre_change(Subject *subj, void *user_data) {
     x6100_vfo_t vfo = (x6100_vfo_t )user_data;
     int32_t new_val = subject_get_int(subj);
-    WITH_RADIO_LOCK(x6100_control_vfo_pre_set(vfo, new_val));
+    cmd_put(exec_vfo, x6100_control_vfo_pre_set, vfo, new_val, 0.0f, false);
     LV_LOG_USER("Radio set vfo %i pre=%i", vfo, new_val);
 }
 
 static void on_atu_network_change(Subject *subj, void *user_data) {
     uint32_t new_val = subject_get_int(subj);
-    WITH_RADIO_LOCK(x6100_control_cmd(x6100_atu_network, new_val));
+    cmd_put(exec_cmd, NULL, x6100_atu_network, new_val, 0.0f, false);
     LV_LOG_USER("Radio set atu network=%u", new_val);
 }
 
@@ -315,36 +642,32 @@ static void on_low_filter_change(Subject *subj, void *user_data) {
             break;
 
         default:
-            radio_lock();
             LV_LOG_USER("Radio set filter_low=%i", low);
-            x6100_control_cmd(x6100_filter1_low, low);
-            x6100_control_cmd(x6100_filter2_low, low);
-            radio_unlock();
+            cmd_put(exec_cmd, NULL, x6100_filter1_low, low, 0.0f, false);
+            cmd_put(exec_cmd, NULL, x6100_filter2_low, low, 0.0f, false);
             break;
     }
 }
 
 static void on_high_filter_change(Subject *subj, void *user_data) {
     int32_t high = subject_get_int(subj);
-    radio_lock();
     switch (subject_get_int(cfg_cur.mode)) {
         case x6100_mode_am:
         case x6100_mode_nfm:
             LV_LOG_USER("Radio set filter_low=%i", -high);
             LV_LOG_USER("Radio set filter_high=%i", high);
-            x6100_control_cmd(x6100_filter1_low, -high);
-            x6100_control_cmd(x6100_filter2_low, -high);
-            x6100_control_cmd(x6100_filter1_high, high);
-            x6100_control_cmd(x6100_filter2_high, high);
+            cmd_put(exec_cmd, NULL, x6100_filter1_low, -high, 0.0f, false);
+            cmd_put(exec_cmd, NULL, x6100_filter2_low, -high, 0.0f, false);
+            cmd_put(exec_cmd, NULL, x6100_filter1_high, high, 0.0f, false);
+            cmd_put(exec_cmd, NULL, x6100_filter2_high, high, 0.0f, false);
             break;
 
         default:
             LV_LOG_USER("Radio set filter_high=%i", high);
-            x6100_control_cmd(x6100_filter1_high, high);
-            x6100_control_cmd(x6100_filter2_high, high);
+            cmd_put(exec_cmd, NULL, x6100_filter1_high, high, 0.0f, false);
+            cmd_put(exec_cmd, NULL, x6100_filter2_high, high, 0.0f, false);
             break;
     }
-    radio_unlock();
 }
 
 void radio_bb_reset() {
@@ -371,6 +694,13 @@ void radio_init(radio_state_change_t tx_cb, radio_state_change_t rx_cb) {
 
     pack = malloc(sizeof(x6100_flow_t));
 
+    pthread_mutex_init(&control_mux, NULL);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, radio_cmd_thread, NULL);
+    pthread_detach(thread);
+
     subject_add_observer_and_call(cfg_cur.band->vfo_a.freq.val, on_vfo_freq_change, (void*)X6100_VFO_A);
     subject_add_observer_and_call(cfg_cur.band->vfo_b.freq.val, on_vfo_freq_change, (void*)X6100_VFO_B);
 
@@ -390,8 +720,9 @@ void radio_init(radio_state_change_t tx_cb, radio_state_change_t rx_cb) {
     subject_add_observer_and_call(cfg_cur.band->split.val, on_change_uint8, x6100_control_split_set);
     subject_add_observer_and_call(cfg_cur.band->rfg.val, on_change_uint8, x6100_control_rfg_set);
 
-    subject_add_observer(cfg_cur.agc, update_agc_time, NULL);
-    subject_add_observer_and_call(cfg_cur.mode, update_agc_time, NULL);
+    subject_add_coalesced_observer(cfg_cur.agc, update_agc_time, NULL);
+    subject_add_coalesced_observer(cfg_cur.mode, update_agc_time, NULL);
+    update_agc_time(cfg_cur.mode, NULL);
 
     subject_add_observer_and_call(cfg_cur.filter.low, on_low_filter_change, NULL);
     subject_add_observer_and_call(cfg_cur.filter.high, on_high_filter_change, NULL);
@@ -424,6 +755,7 @@ void radio_init(radio_state_change_t tx_cb, radio_state_change_t rx_cb) {
     subject_add_observer_and_call(cfg.nr.val, on_change_uint8, x6100_control_nr_set);
     subject_add_observer_and_call(cfg.nr_level.val, on_change_uint8, x6100_control_nr_level_set);
 
+    radio_lock();
     x6100_control_charger_set(params.charger == RADIO_CHARGER_ON);
     x6100_control_bias_drive_set(params.bias_drive);
     x6100_control_bias_final_set(params.bias_final);
@@ -443,14 +775,11 @@ void radio_init(radio_state_change_t tx_cb, radio_state_change_t rx_cb) {
     x6100_control_linein_set(params.line_in);
     x6100_control_lineout_set(params.line_out);
     x6100_control_cmd(x6100_monilevel, params.moni);
+    radio_unlock();
 
     prev_time = get_time();
     idle_time = prev_time;
 
-    pthread_mutex_init(&control_mux, NULL);
-
-    pthread_t thread;
-
     pthread_create(&thread, NULL, radio_thread, NULL);
     pthread_detach(thread);
 }
@@ -466,7 +795,11 @@ void radio_set_freq(int32_t freq) {
     }
     x6100_vfo_t vfo = subject_get_int(cfg_cur.band->vfo.val);
     int32_t shift = cfg_transverter_get_shift(freq);
-    WITH_RADIO_LOCK(x6100_control_vfo_freq_set(vfo, freq - shift));
+    radio_set_vfo_freq(vfo, freq - shift);
+}
+
+void radio_set_vfo_freq(x6100_vfo_t vfo, int32_t freq) {
+    cmd_put(exec_vfo, x6100_control_vfo_freq_set, vfo, freq, 0.0f, false);
 }
 
 bool radio_check_freq(int32_t freq) {
@@ -495,7 +828,7 @@ uint16_t radio_change_vol(int16_t df) {
 
 void radio_change_mute() {
     mute = !mute;
-    x6100_control_rxvol_set(mute ? 0 : subject_get_int(cfg.vol.val));
+    cmd_put(exec_uint8, x6100_control_rxvol_set, 0, mute ? 0 : subject_get_int(cfg.vol.val), 0.0f, false);
 }
 
 uint16_t radio_change_moni(int16_t df) {
@@ -508,7 +841,7 @@ uint16_t radio_change_moni(int16_t df) {
         params_lock();
         params.moni = new_val;
         params_unlock(&params.dirty.moni);
-        WITH_RADIO_LOCK(x6100_control_cmd(x6100_monilevel, params.moni));
+        cmd_put(exec_cmd, NULL, x6100_monilevel, params.moni, 0.0f, false);
         lv_msg_send(MSG_PARAM_CHANGED, NULL);
     }
 
@@ -523,7 +856,7 @@ bool radio_change_spmode(int16_t df) {
     params_bool_set(&params.spmode, df > 0);
     lv_msg_send(MSG_PARAM_CHANGED, NULL);
 
-    WITH_RADIO_LOCK(x6100_control_spmode_set(params.spmode.x));
+    cmd_put(exec_bool, x6100_control_spmode_set, 0, params.spmode.x, 0.0f, false);
 
     return params.spmode.x;
 }
@@ -560,7 +893,7 @@ void radio_stop_swrscan() {
 }
 
 void radio_set_pwr(float d) {
-    WITH_RADIO_LOCK(x6100_control_txpwr_set(d));
+    cmd_put(exec_float, x6100_control_txpwr_set, 0, 0, d, false);
 }
 
 x6100_mic_sel_t radio_change_mic(int16_t d) {
@@ -587,7 +920,7 @@ x6100_mic_sel_t radio_change_mic(int16_t d) {
     params_unlock(&params.dirty.mic);
     lv_msg_send(MSG_PARAM_CHANGED, NULL);
 
-    WITH_RADIO_LOCK(x6100_control_mic_set(params.mic));
+    cmd_put(exec_int, x6100_control_mic_set, 0, params.mic, 0.0f, false);
 
     return params.mic;
 }
@@ -624,6 +957,11 @@ x6100_vfo_t radio_toggle_vfo() {
 }
 
 void radio_poweroff() {
+    params_flush();
+    band_activity_flush();
+    qso_log_flush();
+    display_snapshot_save();
+
     if (params.charger == RADIO_CHARGER_SHADOW) {
         WITH_RADIO_LOCK(x6100_control_charger_set(true));
     }
@@ -655,17 +993,19 @@ radio_charger_t radio_change_charger(int16_t d) {
     params_unlock(&params.dirty.charger);
     lv_msg_send(MSG_PARAM_CHANGED, NULL);
 
-    WITH_RADIO_LOCK(x6100_control_charger_set(params.charger == RADIO_CHARGER_ON));
+    cmd_put(exec_bool, x6100_control_charger_set, 0, params.charger == RADIO_CHARGER_ON, 0.0f, false);
 
     return params.charger;
 }
 
+/* Keying on keeps its place after the settings queued before it, releasing jumps the queue */
+
 void radio_set_ptt(bool tx) {
-    WITH_RADIO_LOCK(x6100_control_ptt_set(tx));
+    cmd_put(exec_bool, x6100_control_ptt_set, 0, tx, 0.0f, !tx);
 }
 
 void radio_set_modem(bool tx) {
-    WITH_RADIO_LOCK(x6100_control_modem_set(tx));
+    cmd_put(exec_bool, x6100_control_modem_set, 0, tx, 0.0f, !tx);
 }
 
 int16_t radio_change_rit(int16_t d) {
@@ -679,7 +1019,7 @@ int16_t radio_change_rit(int16_t d) {
         params.rit = new_val;
         params_unlock(&params.dirty.rit);
         lv_msg_send(MSG_PARAM_CHANGED, NULL);
-        WITH_RADIO_LOCK(x6100_control_cmd(x6100_rit, params.rit));
+        cmd_put(exec_cmd, NULL, x6100_rit, params.rit, 0.0f, false);
     }
 
     return params.rit;
@@ -696,7 +1036,7 @@ int16_t radio_change_xit(int16_t d) {
         params.xit = new_val;
         params_unlock(&params.dirty.xit);
         lv_msg_send(MSG_PARAM_CHANGED, NULL);
-        WITH_RADIO_LOCK(x6100_control_cmd(x6100_xit, params.xit));
+        cmd_put(exec_cmd, NULL, x6100_xit, params.xit, 0.0f, false);
     }
 
     return params.xit;
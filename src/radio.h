@@ -35,16 +35,50 @@ typedef enum {
 
 typedef void (*radio_state_change_t) ();
 
+/* Flow transport health */
+typedef struct {
+    uint32_t    packets;
+    uint32_t    intervals;
+    uint32_t    interval_min_us;
+    uint32_t    interval_avg_us;
+    uint32_t    interval_max_us;
+    uint32_t    late;               /* Intervals longer than two packets */
+    uint32_t    restarts;           /* FLOW_RESTART_TIMEOUT events, never reset */
+    uint32_t    restarts_warm;      /* Of them with the DSP state kept, never reset */
+    uint32_t    outages;            /* Gaps of the flow with restarts, till the next packet. Never reset */
+    uint32_t    outage_last_ms;
+    uint32_t    outage_max_ms;
+    uint64_t    outage_total_ms;
+} radio_flow_stats_t;
+
+/* Control command queue */
+typedef struct {
+    uint32_t    queued;
+    uint32_t    coalesced;          /* Replaced the value of a pending command */
+    uint32_t    executed;
+    uint32_t    depth;
+    uint32_t    depth_max;
+} radio_cmd_stats_t;
+
 void radio_init(radio_state_change_t tx_cb, radio_state_change_t rx_cb);
 void radio_bb_reset();
 bool radio_tick();
 radio_state_t radio_get_state();
 
+void radio_flow_stats(radio_flow_stats_t *stats, bool reset);
+void radio_cmd_stats(radio_cmd_stats_t *stats, bool reset);
+
 /**
  * Set freq for radio without updating corresponding subject.
  * Useful for FT8 TX freq change and SWR scan
  */
 void radio_set_freq(int32_t freq);
+
+/**
+ * Queue the radio freq of a VFO, transverter shift is already taken off.
+ * Doesn't touch subjects, so it may be called from any thread
+ */
+void radio_set_vfo_freq(x6100_vfo_t vfo, int32_t freq);
 bool radio_check_freq(int32_t freq);
 
 x6100_vfo_t radio_toggle_vfo();
@@ -0,0 +1,257 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "rec_index.h"
+
+#include "lvgl/lvgl.h"
+
+#include <libgen.h>
+#include <limits.h>
+#include <sndfile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define INDEX_DIR       ".index"
+#define INDEX_MAGIC     "X6RI"
+#define INDEX_VERSION   1
+#define BUILD_FRAMES    4096
+
+typedef struct {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    rate;
+    uint32_t    points;
+    uint64_t    frames;
+    uint64_t    size;           /* Of the recording, for the staleness check */
+    int64_t     mtime;
+} index_header_t;
+
+/**
+ * Sidecar name of the recording: dir/.index/name.idx. Creates the directory if `create`
+ */
+static bool sidecar_path(const char *path, char *out, size_t size, bool create) {
+    char dir_buf[PATH_MAX];
+    char name_buf[PATH_MAX];
+
+    strncpy(dir_buf, path, sizeof(dir_buf) - 1);
+    dir_buf[sizeof(dir_buf) - 1] = '\0';
+    strncpy(name_buf, path, sizeof(name_buf) - 1);
+    name_buf[sizeof(name_buf) - 1] = '\0';
+
+    const char *dir = dirname(dir_buf);
+    const char *name = basename(name_buf);
+
+    if (create) {
+        char index_dir[PATH_MAX];
+
+        snprintf(index_dir, sizeof(index_dir), "%s/%s", dir, INDEX_DIR);
+        mkdir(index_dir, 0755);
+    }
+    return snprintf(out, size, "%s/%s/%s.idx", dir, INDEX_DIR, name) < (int) size;
+}
+
+static void push_point(rec_index_t *idx) {
+    if (idx->points == idx->capacity) {
+        uint32_t    capacity = idx->capacity ? idx->capacity * 2 : 1024;
+        int16_t     *min = realloc(idx->min, capacity * sizeof(int16_t));
+
+        if (!min) {
+            return;
+        }
+        idx->min = min;
+
+        int16_t     *max = realloc(idx->max, capacity * sizeof(int16_t));
+
+        if (!max) {
+            return;
+        }
+        idx->max = max;
+        idx->capacity = capacity;
+    }
+    idx->min[idx->points] = idx->cur_min;
+    idx->max[idx->points] = idx->cur_max;
+    idx->points++;
+
+    idx->point_pos = 0;
+    idx->cur_min = INT16_MAX;
+    idx->cur_max = INT16_MIN;
+}
+
+void rec_index_begin(rec_index_t *idx, uint32_t rate) {
+    rec_index_free(idx);
+
+    idx->rate = rate;
+    idx->point_frames = rate * REC_INDEX_POINT_MS / 1000;
+    idx->cur_min = INT16_MAX;
+    idx->cur_max = INT16_MIN;
+
+    if (idx->point_frames == 0) {
+        idx->point_frames = 1;
+    }
+}
+
+void rec_index_put(rec_index_t *idx, const int16_t *samples, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int16_t x = samples[i];
+
+        if (x < idx->cur_min) {
+            idx->cur_min = x;
+        }
+        if (x > idx->cur_max) {
+            idx->cur_max = x;
+        }
+        if (++idx->point_pos == idx->point_frames) {
+            push_point(idx);
+        }
+    }
+    idx->frames += n;
+}
+
+bool rec_index_save(rec_index_t *idx, const char *path) {
+    char        index_path[PATH_MAX];
+    struct stat st;
+
+    if (idx->point_pos) {
+        push_point(idx);
+    }
+    if (stat(path, &st) != 0 || !sidecar_path(path, index_path, sizeof(index_path), true)) {
+        return false;
+    }
+
+    FILE *f = fopen(index_path, "wb");
+
+    if (!f) {
+        LV_LOG_WARN("Can't write index %s", index_path);
+        return false;
+    }
+
+    index_header_t header = {
+        .magic = INDEX_MAGIC,
+        .version = INDEX_VERSION,
+        .rate = idx->rate,
+        .points = idx->points,
+        .frames = idx->frames,
+        .size = st.st_size,
+        .mtime = st.st_mtime,
+    };
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(idx->min, sizeof(int16_t), idx->points, f) == idx->points &&
+              fwrite(idx->max, sizeof(int16_t), idx->points, f) == idx->points;
+
+    if (fclose(f) != 0 || !ok) {
+        unlink(index_path);
+        return false;
+    }
+    return true;
+}
+
+bool rec_index_load(rec_index_t *idx, const char *path) {
+    char            index_path[PATH_MAX];
+    struct stat     st;
+    index_header_t  header;
+
+    if (stat(path, &st) != 0 || !sidecar_path(path, index_path, sizeof(index_path), false)) {
+        return false;
+    }
+
+    FILE *f = fopen(index_path, "rb");
+
+    if (!f) {
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, INDEX_MAGIC, 4) != 0 ||
+        header.version != INDEX_VERSION || header.size != (uint64_t) st.st_size || header.mtime != st.st_mtime)
+    {
+        fclose(f);
+        return false;
+    }
+
+    rec_index_begin(idx, header.rate);
+    idx->min = malloc(header.points * sizeof(int16_t));
+    idx->max = malloc(header.points * sizeof(int16_t));
+
+    bool ok = idx->min && idx->max &&
+              fread(idx->min, sizeof(int16_t), header.points, f) == header.points &&
+              fread(idx->max, sizeof(int16_t), header.points, f) == header.points;
+
+    fclose(f);
+
+    if (!ok) {
+        rec_index_free(idx);
+        return false;
+    }
+    idx->points = header.points;
+    idx->capacity = header.points;
+    idx->frames = header.frames;
+    return true;
+}
+
+bool rec_index_open(rec_index_t *idx, const char *path) {
+    if (rec_index_load(idx, path)) {
+        return true;
+    }
+
+    SF_INFO sfinfo;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+
+    SNDFILE *file = sf_open(path, SFM_READ, &sfinfo);
+
+    if (!file) {
+        return false;
+    }
+
+    int16_t     *buf = malloc(BUILD_FRAMES * sfinfo.channels * sizeof(int16_t));
+    sf_count_t  n;
+
+    if (!buf) {
+        sf_close(file);
+        return false;
+    }
+
+    rec_index_begin(idx, sfinfo.samplerate);
+
+    while ((n = sf_readf_short(file, buf, BUILD_FRAMES)) > 0) {
+        // The first channel of interleaved ones
+        for (sf_count_t i = 1; i < n && sfinfo.channels > 1; i++) {
+            buf[i] = buf[i * sfinfo.channels];
+        }
+        rec_index_put(idx, buf, n);
+    }
+
+    free(buf);
+    sf_close(file);
+
+    LV_LOG_USER("Index of %s: %llu frames, %u points", path, idx->frames, idx->points);
+    rec_index_save(idx, path);
+    return true;
+}
+
+void rec_index_free(rec_index_t *idx) {
+    free(idx->min);
+    free(idx->max);
+    memset(idx, 0, sizeof(*idx));
+}
+
+void rec_index_rename(const char *from, const char *to) {
+    char from_index[PATH_MAX];
+    char to_index[PATH_MAX];
+
+    if (!sidecar_path(from, from_index, sizeof(from_index), false)) {
+        return;
+    }
+    if (to && sidecar_path(to, to_index, sizeof(to_index), false)) {
+        rename(from_index, to_index);
+    } else {
+        unlink(from_index);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sidecar index of a recording: length, sample rate and min/max envelope of
+ * REC_INDEX_POINT_MS points. It is built by the recorder while writing, or by
+ * decoding the file once on the first open, and is kept in the hidden .index
+ * directory next to the recordings. The index is stale when the size or mtime
+ * of the recording differs from the stored ones.
+ */
+
+#define REC_INDEX_POINT_MS  100
+#define REC_INDEX_SEEK_S    10          /* Seek step of the playback */
+
+typedef struct {
+    uint32_t    rate;
+    uint64_t    frames;
+    uint32_t    points;
+    int16_t     *min;
+    int16_t     *max;
+
+    /* Building state */
+    uint32_t    capacity;
+    uint32_t    point_frames;
+    uint32_t    point_pos;
+    int16_t     cur_min;
+    int16_t     cur_max;
+} rec_index_t;
+
+/**
+ * Start a new envelope of the sample rate
+ */
+void rec_index_begin(rec_index_t *idx, uint32_t rate);
+void rec_index_put(rec_index_t *idx, const int16_t *samples, size_t n);
+
+/**
+ * Store the index of the recording `path`, call after the file is closed
+ */
+bool rec_index_save(rec_index_t *idx, const char *path);
+
+/**
+ * Load the index of the recording, false if there is none or it's stale
+ */
+bool rec_index_load(rec_index_t *idx, const char *path);
+
+/**
+ * Load the index, or build it by decoding the recording and store it
+ */
+bool rec_index_open(rec_index_t *idx, const char *path);
+
+void rec_index_free(rec_index_t *idx);
+
+/**
+ * Move or delete the sidecar along with the recording, `to` NULL - delete
+ */
+void rec_index_rename(const char *from, const char *to);
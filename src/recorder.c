@@ -8,53 +8,312 @@
 
 #include <time.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <stdlib.h>
 #include <sndfile.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 
 #include "audio.h"
 #include "dialog_recorder.h"
 #include "recorder.h"
+#include "rec_index.h"
+#include "util.h"
+#include "mem_stats.h"
 #include "msg.h"
 #include "params/params.h"
+#include "cfg/cfg.h"
 
-char            *recorder_path = "/mnt/rec";
+/*
+ * Capture path copies samples into a FIFO, encoder thread writes them with sf_write of
+ * up to REC_WRITE samples. While idle, the FIFO keeps the last pre-trigger seconds,
+ * a recording starts from the oldest of them
+ */
+
+#define REC_WRITE       (8192)
+#define REC_HEADROOM    (12)        /* Seconds of live audio while the encoder is behind */
+
+typedef enum {
+    REC_IDLE = 0,                   /* Pre-trigger only, oldest samples are overwritten */
+    REC_CAPTURE,
+    REC_DRAIN,                      /* Stopped, encoder writes up to stop_head */
+} rec_state_t;
+
+typedef struct {
+    const char  *name;
+    const char  *ext;
+    int         sf_format;
+    uint32_t    rate;
+} rec_format_t;
+
+typedef struct {
+    uint64_t    cpu_ns;
+    uint64_t    samples;
+    uint64_t    bytes;
+} rec_cost_t;
+
+static const rec_format_t formats[RECORDER_FORMATS] = {
+    [RECORDER_MP3]  = { "MP3",  "mp3",  SF_FORMAT_MPEG | SF_FORMAT_MPEG_LAYER_III, AUDIO_CAPTURE_RATE },
+    [RECORDER_WAV]  = { "WAV",  "wav",  SF_FORMAT_WAV | SF_FORMAT_PCM_16,          AUDIO_CAPTURE_RATE },
+    [RECORDER_FLAC] = { "FLAC", "flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16,         AUDIO_CAPTURE_RATE },
+    [RECORDER_OPUS] = { "Opus", "opus", SF_FORMAT_OGG | SF_FORMAT_OPUS,            RECORDER_OPUS_RATE },
+};
+
+const int32_t           recorder_pre_triggers[RECORDER_PRE_TRIGGERS] = { 0, 30, 60, 120 };
+
+char                    *recorder_path = "/mnt/rec";
+
+static bool             on = false;
+static atomic_int       state = REC_IDLE;
+static atomic_bool      stop_req = false;
+
+/* FIFO, positions are sample counters. Producer is the audio thread, consumer is the encoder */
+
+static int16_t          *fifo = NULL;
+static size_t           fifo_size = 0;
+static _Atomic uint64_t head = 0;
+static _Atomic uint64_t tail = 0;
+static _Atomic uint64_t stop_head = 0;
+static pthread_mutex_t  fifo_mux = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_uint      overruns = 0;
+static uint32_t         overruns_base = 0;
+
+static atomic_uint      pre_trigger = 0;    /* Seconds */
+static atomic_uint      format_req = RECORDER_MP3;
+static atomic_bool      resize_req = false;
+
+/* Format and rate of the FIFO content, changed with the FIFO reset */
+static recorder_format_t format = RECORDER_MP3;
+static atomic_uint      rate = AUDIO_CAPTURE_RATE;
+
+static SNDFILE          *file = NULL;
+static char             filename[64];
+static rec_index_t      file_index;         /* Envelope of the written samples */
+static rec_cost_t       costs[RECORDER_FORMATS];
+static pthread_mutex_t  file_mux = PTHREAD_MUTEX_INITIALIZER;
+static sem_t            encoder_sem;
+static pthread_t        encoder_thread;
+
+static void update_bytes() {
+    struct stat st;
+
+    if (stat(filename, &st) == 0) {
+        costs[format].bytes = st.st_size;
+    }
+}
+
+/**
+ * Write FIFO samples up to the end position. Called with file_mux locked
+ */
+static void write_samples(uint64_t end) {
+    uint64_t        t = atomic_load(&tail);
+    struct timespec start, stop;
+
+    if (t >= end) {
+        return;
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+    while (t < end) {
+        size_t pos = t % fifo_size;
+        size_t n = LV_MIN(LV_MIN(end - t, REC_WRITE), fifo_size - pos);
+
+        if (file) {
+            sf_write_short(file, &fifo[pos], n);
+            rec_index_put(&file_index, &fifo[pos], n);
+            costs[format].samples += n;
+        }
+
+        t += n;
+        atomic_store(&tail, t);
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stop);
 
-static bool     on = false;
-static SNDFILE  *file = NULL;
+    costs[format].cpu_ns += (stop.tv_sec - start.tv_sec) * 1000000000ULL + stop.tv_nsec - start.tv_nsec;
+
+    if (file) {
+        update_bytes();
+    }
+}
+
+static void close_file() {
+    if (atomic_load(&state) == REC_DRAIN) {
+        write_samples(atomic_load(&stop_head));
+        atomic_store(&state, REC_IDLE);
+    }
+
+    if (file) {
+        sf_close(file);
+        update_bytes();
+        file = NULL;
+
+        // Playback gets the overview and length without decoding
+        rec_index_save(&file_index, filename);
+        rec_index_free(&file_index);
+    }
+}
+
+/**
+ * Reallocate the FIFO for the pre-trigger length, not while a recording is written
+ */
+static void fifo_resize() {
+    size_t size = (atomic_load(&pre_trigger) + REC_HEADROOM) * AUDIO_CAPTURE_RATE;
+
+    pthread_mutex_lock(&fifo_mux);
+
+    format = atomic_load(&format_req);
+    atomic_store(&rate, formats[format].rate);
+
+    if (size != fifo_size) {
+        mem_free(MEM_AUDIO, fifo);
+        fifo = mem_alloc(MEM_AUDIO, size * sizeof(int16_t));
+        fifo_size = fifo ? size : 0;
+
+        if (!fifo) {
+            LV_LOG_ERROR("Can't allocate recorder buffer");
+        }
+    }
+
+    atomic_store(&head, 0);
+    atomic_store(&tail, 0);
+
+    pthread_mutex_unlock(&fifo_mux);
+}
+
+static void * encoder_worker(void *arg) {
+    set_thread_name("rec_encode");
+
+    while (true) {
+        sem_wait(&encoder_sem);
+        pthread_mutex_lock(&file_mux);
+
+        switch (atomic_load(&state)) {
+            case REC_CAPTURE: {
+                uint64_t t = atomic_load(&tail);
+
+                // Whole writes only
+                write_samples(t + (atomic_load(&head) - t) / REC_WRITE * REC_WRITE);
+                break;
+            }
+
+            case REC_DRAIN:
+                close_file();
+                break;
+
+            default:
+                break;
+        }
+
+        if (atomic_load(&state) == REC_IDLE && atomic_load(&resize_req)) {
+            atomic_store(&resize_req, false);
+            fifo_resize();
+        }
+
+        pthread_mutex_unlock(&file_mux);
+    }
+
+    return NULL;
+}
+
+static void on_pre_trigger_change(Subject *subj, void *user_data) {
+    atomic_store(&pre_trigger, subject_get_int(subj));
+    atomic_store(&resize_req, true);
+    sem_post(&encoder_sem);
+}
+
+static void on_format_change(Subject *subj, void *user_data) {
+    int32_t x = subject_get_int(subj);
+
+    if (x < 0 || x >= RECORDER_FORMATS) {
+        x = RECORDER_MP3;
+    }
+
+    // FIFO content is at the rate of the previous format
+    atomic_store(&format_req, x);
+    atomic_store(&resize_req, true);
+    sem_post(&encoder_sem);
+}
+
+void recorder_init() {
+    sem_init(&encoder_sem, 0, 0);
+    fifo_resize();
+    pthread_create(&encoder_thread, NULL, encoder_worker, NULL);
+
+    subject_add_observer_and_call(cfg.rec_pre_trigger.val, on_pre_trigger_change, NULL);
+    subject_add_observer_and_call(cfg.rec_format.val, on_format_change, NULL);
+}
 
 static bool create_file() {
     SF_INFO sfinfo;
 
-    memset(&sfinfo, 0, sizeof(sfinfo));
+    // Encoder still writes the previous recording
+    if (pthread_mutex_trylock(&file_mux) != 0) {
+        LV_LOG_ERROR("Recorder is busy");
+        return false;
+    }
 
-    sfinfo.samplerate = AUDIO_CAPTURE_RATE;
-    sfinfo.channels = 1;
-    sfinfo.format = SF_FORMAT_MPEG | SF_FORMAT_MPEG_LAYER_III;
+    close_file();
 
-    char        filename[64];
-    time_t      now = time(NULL);
-    struct tm   *t = localtime(&now);
+    const rec_format_t  *fmt = &formats[format];
+    time_t              now = time(NULL);
+    struct tm           *t = localtime(&now);
 
     snprintf(filename, sizeof(filename),
-        "%s/REC_%04i%02i%02i_%02i%02i%02i.mp3",
-        recorder_path, t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec
+        "%s/REC_%04i%02i%02i_%02i%02i%02i.%s",
+        recorder_path, t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec, fmt->ext
     );
 
+    memset(&sfinfo, 0, sizeof(sfinfo));
+
+    sfinfo.samplerate = fmt->rate;
+    sfinfo.channels = 1;
+    sfinfo.format = fmt->sf_format;
+
     file = sf_open(filename, SFM_WRITE, &sfinfo);
 
     if (file == NULL) {
+        pthread_mutex_unlock(&file_mux);
+
         const char* err = sf_strerror(NULL);
         LV_LOG_ERROR("Problem with create file: %s", err);
         return false;
     }
 
-    double q = 0.25;
-    sf_command(file, SFC_SET_VBR_ENCODING_QUALITY, &q, sizeof(q));
+    if (format == RECORDER_MP3) {
+        double q = 0.25;
+        sf_command(file, SFC_SET_VBR_ENCODING_QUALITY, &q, sizeof(q));
+    }
+
+    memset(&costs[format], 0, sizeof(rec_cost_t));
+    rec_index_begin(&file_index, fmt->rate);
+
+    /*
+     * Start from the oldest pre-trigger sample, the encoder flushes them in background.
+     * Headroom of the FIFO keeps them from being overwritten meanwhile
+     */
+    uint64_t h = atomic_load(&head);
+    uint64_t pre = (uint64_t) atomic_load(&pre_trigger) * fmt->rate;
+
+    atomic_store(&tail, h > pre ? h - pre : 0);
+    atomic_store(&state, REC_CAPTURE);
+
+    pthread_mutex_unlock(&file_mux);
+
+    sem_post(&encoder_sem);
 
     return true;
 }
 
 void recorder_set_on(bool x) {
     if (x) {
+        overruns_base = atomic_load(&overruns);
+        atomic_store(&stop_req, false);
+
         if (!create_file()) {
             msg_update_text_fmt("Problem with create file");
             return;
@@ -65,7 +324,7 @@ void recorder_set_on(bool x) {
     } else {
         msg_update_text_fmt("Recorder is off");
         on = false;
-        sf_close(file);
+        atomic_store(&stop_req, true);
     }
 
     dialog_recorder_set_on(on);
@@ -75,6 +334,81 @@ bool recorder_is_on() {
     return on;
 }
 
+bool recorder_is_capturing() {
+    return atomic_load(&state) != REC_IDLE || atomic_load(&pre_trigger) > 0;
+}
+
+uint32_t recorder_get_overruns() {
+    return atomic_load(&overruns) - overruns_base;
+}
+
+uint32_t recorder_get_rate() {
+    return atomic_load(&rate);
+}
+
+const char * recorder_format_name(recorder_format_t x) {
+    return formats[x].name;
+}
+
+bool recorder_get_cost(recorder_format_t x, float *cpu_pct, uint32_t *bytes_per_s) {
+    rec_cost_t  cost = costs[x];
+    uint32_t    fmt_rate = formats[x].rate;
+
+    if (cost.samples < fmt_rate) {
+        return false;
+    }
+
+    *cpu_pct = cost.cpu_ns * 1e-7f * fmt_rate / cost.samples;
+    *bytes_per_s = cost.bytes * fmt_rate / cost.samples;
+
+    return true;
+}
+
 void recorder_put_audio_samples(size_t nsamples, int16_t *samples) {
-    sf_write_short(file, samples, nsamples);
+    // FIFO is being reallocated
+    if (pthread_mutex_trylock(&fifo_mux) != 0) {
+        return;
+    }
+
+    if (!fifo) {
+        pthread_mutex_unlock(&fifo_mux);
+        return;
+    }
+
+    int      st = atomic_load(&state);
+    uint64_t h = atomic_load(&head);
+
+    if (st == REC_CAPTURE && atomic_load(&stop_req)) {
+        atomic_store(&stop_head, h);
+        atomic_store(&stop_req, false);
+        atomic_store(&state, REC_DRAIN);
+        sem_post(&encoder_sem);
+        st = REC_DRAIN;
+    }
+
+    // Unwritten samples are kept, while there is a file
+    if (st != REC_IDLE && h + nsamples - atomic_load(&tail) > fifo_size) {
+        if (st == REC_CAPTURE) {
+            atomic_fetch_add(&overruns, 1);
+        }
+        pthread_mutex_unlock(&fifo_mux);
+        return;
+    }
+
+    while (nsamples > 0) {
+        size_t pos = h % fifo_size;
+        size_t n = LV_MIN(nsamples, fifo_size - pos);
+
+        memcpy(&fifo[pos], samples, n * sizeof(int16_t));
+        samples += n;
+        nsamples -= n;
+        h += n;
+    }
+
+    atomic_store(&head, h);
+    pthread_mutex_unlock(&fifo_mux);
+
+    if (st == REC_CAPTURE && h - atomic_load(&tail) >= REC_WRITE) {
+        sem_post(&encoder_sem);
+    }
 }
@@ -9,10 +9,48 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#define RECORDER_PRE_TRIGGERS   4
+
+/* Opus takes no 44.1 kHz, it gets resampled audio */
+#define RECORDER_OPUS_RATE      16000
+
+typedef enum {
+    RECORDER_MP3 = 0,
+    RECORDER_WAV,
+    RECORDER_FLAC,
+    RECORDER_OPUS,
+
+    RECORDER_FORMATS
+} recorder_format_t;
+
 extern char *recorder_path;
 
+/* Pre-trigger lengths, seconds */
+extern const int32_t recorder_pre_triggers[RECORDER_PRE_TRIGGERS];
+
+void recorder_init();
+
 void recorder_set_on(bool on);
 bool recorder_is_on();
+
+/* Capture path is wanted: recording, draining after the stop, or pre-trigger is on */
+bool recorder_is_capturing();
+
+/* Fragments dropped by the current recording, the encoder was behind */
+uint32_t recorder_get_overruns();
+
+/* Sample rate of the capture path for the selected format */
+uint32_t recorder_get_rate();
+
+const char * recorder_format_name(recorder_format_t format);
+
+/**
+ * Measured cost of the format, by its last recording: encoder CPU time per audio time
+ * and file bytes per second. Returns false, if it wasn't recorded yet
+ */
+bool recorder_get_cost(recorder_format_t format, float *cpu_pct, uint32_t *bytes_per_s);
+
 void recorder_put_audio_samples(size_t nsamples, int16_t *samples);
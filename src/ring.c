@@ -0,0 +1,114 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "ring.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+struct ring_s {
+    size_t          block_size;
+    size_t          mask;
+    uint8_t         *data;
+
+    atomic_size_t   head;       /* Written by producer */
+    atomic_size_t   tail;       /* Written by consumer */
+    atomic_uint     overruns;
+};
+
+ring_t ring_create(size_t block_size, size_t count) {
+    size_t size = 1;
+
+    while (size < count) {
+        size <<= 1;
+    }
+
+    ring_t ring = malloc(sizeof(struct ring_s));
+
+    if (!ring) {
+        return NULL;
+    }
+
+    ring->block_size = block_size;
+    ring->mask = size - 1;
+    ring->data = calloc(size, block_size);
+
+    if (!ring->data) {
+        free(ring);
+        return NULL;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overruns, 0);
+
+    return ring;
+}
+
+void ring_destroy(ring_t ring) {
+    if (ring) {
+        free(ring->data);
+        free(ring);
+    }
+}
+
+void *ring_reserve(ring_t ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail > ring->mask) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    return ring->data + (head & ring->mask) * ring->block_size;
+}
+
+void ring_commit(ring_t ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void *ring_peek(ring_t ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    return ring->data + (tail & ring->mask) * ring->block_size;
+}
+
+void ring_release(ring_t ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+void ring_flush(ring_t ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
+
+size_t ring_used(ring_t ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    return head - tail;
+}
+
+size_t ring_size(ring_t ring) {
+    return ring->mask + 1;
+}
+
+uint32_t ring_get_overruns(ring_t ring) {
+    return atomic_load_explicit(&ring->overruns, memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single producer / single consumer lock-free ring of preallocated fixed size blocks.
+ * Producer and consumer never block each other; when ring is full, new block is dropped
+ * and counted as overrun.
+ */
+typedef struct ring_s * ring_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create ring with `count` blocks of `block_size` bytes. `count` is rounded up to power of 2
+ */
+ring_t ring_create(size_t block_size, size_t count);
+void ring_destroy(ring_t ring);
+
+/**
+ * Get free block for writing (producer side). Returns NULL and increments overruns, if ring is full
+ */
+void *ring_reserve(ring_t ring);
+
+/**
+ * Publish block, returned by ring_reserve()
+ */
+void ring_commit(ring_t ring);
+
+/**
+ * Get oldest block for reading (consumer side). Returns NULL if ring is empty
+ */
+void *ring_peek(ring_t ring);
+
+/**
+ * Return block, returned by ring_peek(), to producer
+ */
+void ring_release(ring_t ring);
+
+/**
+ * Drop all pending blocks (consumer side)
+ */
+void ring_flush(ring_t ring);
+
+size_t ring_used(ring_t ring);
+size_t ring_size(ring_t ring);
+uint32_t ring_get_overruns(ring_t ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,80 +7,105 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <linux/input.h>
 
 #include "rotary.h"
 #include "keyboard.h"
-#include "backlight.h"
+#include "input.h"
 
-static int32_t remain_diff = 0;
-static lv_indev_state_t prev_state;
+#define SPEED_RESET_US  200000      /* Pause, after which the speed starts from zero */
+#define SPEED_MIN_DT_US 1000
 
+/**
+ * Smoothed rate of detents from the event timestamps
+ */
+static void speed_update(rotary_t *rotary, const input_rec_t *in) {
+    uint64_t dt = in->time - rotary->last_time;
 
-static void rotary_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
-    struct input_event  in;
-    rotary_t            *rotary = (rotary_t*) drv->user_data;
-    int32_t             diff = 0;
-    bool                send = false;
-
-    if (remain_diff == 0) {
-        while (read(rotary->fd, &in, sizeof(struct input_event)) > 0) {
-            if (in.type == EV_REL) {
-                diff += in.value;
-                send = true;
-            }
-        }
+    if (rotary->last_time == 0 || dt > SPEED_RESET_US) {
+        rotary->speed = 0;
+    } else {
+        uint32_t x = (uint64_t) abs(in->value) * 1000000 / LV_MAX(dt, SPEED_MIN_DT_US);
 
-        if (send) {
-            backlight_tick();
-
-            if (rotary->left[0] == 0 && rotary->right[0] == 0) {
-                int32_t *diff_copy = (int32_t *) malloc(sizeof(int32_t));
-                *diff_copy = diff;
-                lv_event_send(lv_scr_act(), EVENT_ROTARY, (void *) diff_copy);
-            } else {
-                data->continue_reading = 1;
-                remain_diff = diff;
-            }
-        }
-    } else if (prev_state == LV_INDEV_STATE_PRESSED) {
-        data->state = LV_INDEV_STATE_RELEASED;
-        if (remain_diff != 0) {
-            data->continue_reading = 1;
+        rotary->speed = (rotary->speed * 3 + x) / 4;
+    }
+    rotary->last_time = in->time;
+}
+
+static void flush_timer_cb(lv_timer_t *t) {
+    rotary_t        *rotary = (rotary_t*) t->user_data;
+    event_rotary_t  event = {
+        .diff = rotary->event_diff,
+        .speed = rotary->speed
+    };
+
+    lv_timer_pause(t);
+    rotary->event_diff = 0;
+
+    if (event.diff != 0) {
+        lv_event_send(lv_scr_act(), EVENT_ROTARY, (void *) &event);
+    }
+}
+
+/**
+ * Summed delta from the input thread, on the UI thread
+ */
+static void rotary_handle(const input_rec_t *in, void *arg) {
+    rotary_t *rotary = (rotary_t*) arg;
+
+    if (in->type != EV_REL) {
+        return;
+    }
+
+    if (rotary->left[0] == 0 && rotary->right[0] == 0) {
+        // Records of the frame are summed up, the timer runs once after the input lane
+        speed_update(rotary, in);
+        rotary->event_diff += in->value;
+
+        if (!rotary->flush_timer) {
+            rotary->flush_timer = lv_timer_create(flush_timer_cb, 0, rotary);
         }
+        lv_timer_resume(rotary->flush_timer);
+        lv_timer_ready(rotary->flush_timer);
     } else {
-        if (remain_diff > 0) {
-            diff = 1;
-        } else {
-            diff = -1;
-        }
-        remain_diff -= diff;
+        rotary->diff += in->value;
+    }
+}
+
+static void rotary_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+    rotary_t    *rotary = (rotary_t*) drv->user_data;
+    int32_t     diff;
+
+    if (rotary->prev_state == LV_INDEV_STATE_PRESSED) {
+        data->state = LV_INDEV_STATE_RELEASED;
+    } else if (rotary->diff != 0) {
+        diff = rotary->diff > 0 ? 1 : -1;
+        rotary->diff -= diff;
         data->state = LV_INDEV_STATE_PRESSED;
         data->key = diff > 0 ? rotary->left[rotary->mode] : rotary->right[rotary->mode];
-        data->continue_reading = 1;
-
+    } else {
+        data->state = LV_INDEV_STATE_RELEASED;
     }
-    prev_state = data->state;
 
+    // Each step is a press and a release
+    data->continue_reading = (data->state == LV_INDEV_STATE_PRESSED || rotary->diff != 0);
+    rotary->prev_state = data->state;
 }
 
 rotary_t * rotary_init(char *dev_name) {
-    int fd = open(dev_name, O_RDWR | O_NOCTTY | O_NDELAY);
+    int fd = input_open(dev_name);
 
     if (fd == -1) {
-        LV_LOG_ERROR("unable to open rotary interface:");
-
         return NULL;
     }
 
-    fcntl(fd, F_SETFL, O_ASYNC | O_NONBLOCK);
-
     rotary_t *rotary = malloc(sizeof(rotary_t));
 
     memset(rotary, 0, sizeof(rotary_t));
     rotary->fd = fd;
+    rotary->prev_state = LV_INDEV_STATE_RELEASED;
 
     lv_indev_drv_init(&rotary->indev_drv);
 
@@ -91,6 +116,7 @@ rotary_t * rotary_init(char *dev_name) {
     rotary->indev = lv_indev_drv_register(&rotary->indev_drv);
 
     lv_indev_set_group(rotary->indev, keyboard_group);
+    input_add(fd, rotary->indev, rotary_handle, rotary);
 
     return rotary;
 }
@@ -17,6 +17,15 @@ typedef struct {
     uint16_t        left[3];
     uint16_t        right[3];
     uint8_t         mode;
+
+    int32_t         diff;           /* Steps not yet read by the indev */
+    int             prev_state;
+
+    /* EVENT_ROTARY mode, one event per UI frame */
+    lv_timer_t      *flush_timer;
+    int32_t         event_diff;
+    uint32_t        speed;
+    uint64_t        last_time;
     
     lv_indev_drv_t  indev_drv;
     lv_indev_t      *indev;
@@ -0,0 +1,137 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#define _GNU_SOURCE
+
+#include "rt_mem.h"
+
+#include "lvgl/lvgl.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define CHECK_MS    5000
+
+static atomic_bool  enabled = false;
+static size_t       budget = 0;
+static int          lock_errno = 0;
+static size_t       page_size = 4096;
+
+void rt_mem_init() {
+    const char *env = getenv("X6100_RT_MEM");
+
+    if (!env || atoi(env) <= 0) {
+        return;
+    }
+    budget = (size_t) atoi(env) * 1024 * 1024;
+    page_size = sysconf(_SC_PAGESIZE);
+
+    /* Default is 8 MiB (ulimit -s), all of it would be locked for each thread */
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, RT_MEM_STACK_SIZE);
+    pthread_setattr_default_np(&attr);
+    pthread_attr_destroy(&attr);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        lock_errno = errno;
+        return;
+    }
+    enabled = true;
+}
+
+void rt_mem_locked(size_t *locked, size_t *out_budget) {
+    FILE    *f = fopen("/proc/self/status", "r");
+    char    line[128];
+
+    *locked = 0;
+    *out_budget = budget;
+
+    if (!f) {
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long kb;
+
+        if (sscanf(line, "VmLck: %lu kB", &kb) == 1) {
+            *locked = (size_t) kb * 1024;
+            break;
+        }
+    }
+    fclose(f);
+}
+
+static void check_cb(lv_timer_t *t) {
+    size_t locked, limit;
+
+    rt_mem_locked(&locked, &limit);
+
+    if (locked > limit) {
+        munlockall();
+        enabled = false;
+        lv_timer_del(t);
+        LV_LOG_WARN("RT mem: %zu MiB locked, over the budget of %zu MiB, unlocked",
+                    locked / (1024 * 1024), limit / (1024 * 1024));
+    }
+}
+
+void rt_mem_watch() {
+    if (!budget) {
+        return;
+    }
+    if (!enabled) {
+        LV_LOG_WARN("RT mem: can't lock memory: %s", strerror(lock_errno));
+        return;
+    }
+
+    size_t locked, limit;
+
+    rt_mem_locked(&locked, &limit);
+    LV_LOG_USER("RT mem: %zu MiB locked, budget %zu MiB", locked / (1024 * 1024), limit / (1024 * 1024));
+    lv_timer_create(check_cb, CHECK_MS, NULL);
+}
+
+bool rt_mem_enabled() {
+    return enabled;
+}
+
+void rt_mem_thread_start() {
+    if (!enabled) {
+        return;
+    }
+
+    volatile uint8_t stack[RT_MEM_STACK_PREFAULT];
+
+    for (size_t i = 0; i < sizeof(stack); i += page_size) {
+        stack[i] = 0;
+    }
+}
+
+void rt_mem_prefault(void *buf, size_t size) {
+    if (!enabled || !buf) {
+        return;
+    }
+
+    volatile uint8_t *p = buf;
+
+    /* A write, a read of a fresh page would map the shared zero page */
+    for (size_t i = 0; i < size; i += page_size) {
+        p[i] = p[i];
+    }
+    if (size) {
+        p[size - 1] = p[size - 1];
+    }
+}
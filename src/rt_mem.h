@@ -0,0 +1,61 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Real-time memory mode, enabled by X6100_RT_MEM=<MiB of locked memory budget>.
+ * All memory of the process is locked (mlockall MCL_CURRENT | MCL_FUTURE), so
+ * new mappings are faulted in when made and nothing is paged out later. Thread
+ * stacks are made RT_MEM_STACK_SIZE to keep the locked size small, the
+ * SCHED_FIFO threads touch RT_MEM_STACK_PREFAULT of their stack when they start
+ * and the big tagged buffers (mem_stats.h) are touched when allocated. When the
+ * locked size grows over the budget the memory is unlocked and the mode is off.
+ * Keep it free of LVGL headers, used by mem_stats.c.
+ */
+
+#define RT_MEM_STACK_SIZE       (1024 * 1024)
+#define RT_MEM_STACK_PREFAULT   (128 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read X6100_RT_MEM and lock the memory, call first in main(), before any thread is started
+ */
+void rt_mem_init();
+
+/**
+ * Log the result of rt_mem_init() and start the budget check, call after lv_init()
+ */
+void rt_mem_watch();
+
+bool rt_mem_enabled();
+
+/**
+ * Touch the stack of the calling thread, for the real-time ones
+ */
+void rt_mem_thread_start();
+
+/**
+ * Touch every page of the buffer, the content is kept
+ */
+void rt_mem_prefault(void *buf, size_t size);
+
+/**
+ * Locked size of the process and the budget, bytes
+ */
+void rt_mem_locked(size_t *locked, size_t *budget);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,15 +8,19 @@
 #include "rtty.h"
 
 #include "audio.h"
+#include "audio_graph.h"
 #include "pannel.h"
 #include "params/params.h"
 #include "util.h"
+#include "lock_stats.h"
 
 #include "lvgl/lvgl.h"
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <stdio.h>
 
 #define SYMBOL_OVER 8
 #define SYMBOL_FACTOR 2
@@ -25,6 +29,20 @@
 #define RTTY_SYMBOL_CODE (0b11011)
 #define RTTY_LETTER_CODE (0b11111)
 
+#define RATE            RTTY_RATE
+
+#define CHANNELS        5                               // Manual one and found ones
+#define HISTORY_LEN     128                             // Text of a channel, shown on select
+
+#define SCAN_NFFT       1024
+#define SCAN_PERIOD     (RATE * 2)                      // Samples between FSK pairs search
+#define SCAN_LOW        300                             // Hz
+#define SCAN_HIGH       2700                            // Hz
+#define SCAN_SNR        10.0f                           // dB of mark and space over the median
+#define SCAN_NOTCH      3.0f                            // dB of the gap between mark and space
+#define SCAN_SAME       30                              // Hz, a pair of existing channel
+#define CHANNEL_TIMEOUT 15000                           // ms without the pair
+
 typedef enum {
     RX_STATE_IDLE,
     RX_STATE_START,
@@ -32,26 +50,43 @@ typedef enum {
     RX_STATE_STOP
 } rx_state_t;
 
-static pthread_mutex_t rtty_mux;
+typedef struct {
+    bool        active;
+    uint16_t    center;
+    uint64_t    seen;
+
+    nco_crcf    nco;
+    fskdem      demod;
+    cbuffercf   rx_buf;
+    float       rx_over;
+    uint8_t     rx_symbol[SYMBOL_LEN];
+    float       rx_symbol_pwr[SYMBOL_LEN];
+    uint8_t     rx_symbol_cur;
+    rx_state_t  rx_state;
+    uint8_t     rx_counter;
+    uint8_t     rx_bitcntr;
+    uint8_t     rx_data;
+    bool        rx_letter;
+
+    char        history[HISTORY_LEN];
+    uint8_t     history_pos;
+} channel_t;
 
-static fskdem demod = NULL;
+static pthread_mutex_t rtty_mux;
 
-static nco_crcf       nco     = NULL;
+static channel_t      channels[CHANNELS];
+static uint8_t        channel_sel = 0;
 static float complex *nco_buf = NULL;
 
 static uint16_t symbol_samples;
-static uint16_t symbol_over;
+static float    symbol_over;                            // Fractional, keeps timing of the decimated rate
 
-static cbuffercf      rx_buf;
 static complex float *rx_window = NULL;
-static uint8_t        rx_symbol[SYMBOL_LEN];
-static float          rx_symbol_pwr[SYMBOL_LEN];
-static uint8_t        rx_symbol_cur = 0;
-static rx_state_t     rx_state      = RX_STATE_IDLE;
-static uint8_t        rx_counter    = 0;
-static uint8_t        rx_bitcntr    = 0;
-static uint8_t        rx_data       = 0;
-static bool           rx_letter     = true;
+
+static spgramcf scan_sg = NULL;
+static float    scan_psd[SCAN_NFFT];
+static float    scan_sorted[SCAN_NFFT];
+static uint32_t scan_samples = 0;
 
 static bool         ready = false;
 static rtty_state_t state = RTTY_OFF;
@@ -67,79 +102,130 @@ static const char rtty_symbols[32] = {'\0', '3', '\n', '-', ' ', '\0', '8', '7',
                                       '0',  '1', '9',  '?', '&', ' ',  '.', '/', ';',  ' '};
 
 static void on_cur_mode_change(Subject *subj, void *user_data);
+static bool audio_active(void *user);
+static void audio_cb(const void *data, size_t n, void *user);
+
+static void update_nco(channel_t *ch) {
+    float radians = 2.0f * (float)M_PI * (float)ch->center / (float)RATE;
+
+    nco_crcf_set_phase(ch->nco, 0.0f);
+    nco_crcf_set_frequency(ch->nco, radians);
+}
+
+static void reset_channel(channel_t *ch, uint16_t center) {
+    ch->center = center;
+    ch->seen = get_time();
 
-static void update_nco() {
-    float radians = 2.0f * (float)M_PI * (float)params.rtty_center / (float)AUDIO_CAPTURE_RATE;
+    update_nco(ch);
+    cbuffercf_reset(ch->rx_buf);
 
-    nco_crcf_set_phase(nco, 0.0f);
-    nco_crcf_set_frequency(nco, radians);
+    ch->rx_over = 0.0f;
+    ch->rx_symbol_cur = 0;
+    ch->rx_state = RX_STATE_IDLE;
+    ch->rx_letter = true;
+    ch->history_pos = 0;
+
+    memset(ch->rx_symbol, 0, sizeof(ch->rx_symbol));
+    memset(ch->rx_symbol_pwr, 0, sizeof(ch->rx_symbol_pwr));
 }
 
 static void init() {
-    symbol_samples = (float)AUDIO_CAPTURE_RATE / (float)(params.rtty_rate / 100.0f) / (float)SYMBOL_FACTOR + 0.5f;
-    symbol_over    = symbol_samples / SYMBOL_OVER;
+    float symbol_exact = (float)RATE / (float)(params.rtty_rate / 100.0f) / (float)SYMBOL_FACTOR;
+
+    symbol_samples = symbol_exact + 0.5f;
+    symbol_over    = symbol_exact / (float)SYMBOL_OVER;
 
-    nco     = nco_crcf_create(LIQUID_NCO);
     nco_buf = (float complex *)malloc(symbol_samples * sizeof(float complex));
-    update_nco();
 
     /* RX */
 
-    demod  = fskdem_create(1, symbol_samples, (float)params.rtty_shift / (float)AUDIO_CAPTURE_RATE / 2.0f);
-    rx_buf = cbuffercf_create(symbol_samples * 50);
-
     rx_window = malloc(symbol_samples * sizeof(complex float));
 
     for (uint16_t i = 0; i < symbol_samples; i++)
         rx_window[i] = liquid_hann(i, symbol_samples);
 
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+        channel_t *ch = &channels[i];
+
+        ch->nco    = nco_crcf_create(LIQUID_NCO);
+        ch->demod  = fskdem_create(1, symbol_samples, (float)params.rtty_shift / (float)RATE / 2.0f);
+        ch->rx_buf = cbuffercf_create(symbol_samples * 50);
+        ch->active = (i == 0);
+
+        reset_channel(ch, params.rtty_center);
+    }
+    channel_sel = 0;
+
+    scan_sg = spgramcf_create(SCAN_NFFT, LIQUID_WINDOW_HANN, SCAN_NFFT, SCAN_NFFT / 2);
+    scan_samples = 0;
+
     ready = true;
 }
 
 static void done() {
     ready = false;
 
-    nco_crcf_destroy(nco);
     free(nco_buf);
 
-    fskdem_destroy(demod);
-    cbuffercf_destroy(rx_buf);
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+        nco_crcf_destroy(channels[i].nco);
+        fskdem_destroy(channels[i].demod);
+        cbuffercf_destroy(channels[i].rx_buf);
+    }
     free(rx_window);
+
+    spgramcf_destroy(scan_sg);
 }
 
 static void update() {
-    pthread_mutex_lock(&rtty_mux);
+    lock_stats_lock(&rtty_mux, "rtty");
     done();
     init();
-    pthread_mutex_unlock(&rtty_mux);
+    lock_stats_unlock(&rtty_mux, "rtty");
 }
 
 void rtty_init() {
     pthread_mutex_init(&rtty_mux, NULL);
     subject_add_observer_and_call(cfg_cur.mode, on_cur_mode_change, NULL);
     init();
+    audio_graph_add(RATE, AUDIO_FORMAT_CFLOAT, audio_cb, audio_active, NULL);
 }
 
-static char baudot_decoder(uint8_t c) {
+static char baudot_decoder(channel_t *ch, uint8_t c) {
     if (c == RTTY_SYMBOL_CODE) {
-        rx_letter = false;
+        ch->rx_letter = false;
         return 0;
     }
 
     if (c == RTTY_LETTER_CODE) {
-        rx_letter = true;
+        ch->rx_letter = true;
         return 0;
     }
 
-    return rx_letter ? rtty_letters[c] : rtty_symbols[c];
+    return ch->rx_letter ? rtty_letters[c] : rtty_symbols[c];
+}
+
+static void channel_text(channel_t *ch, char c) {
+    if (ch->history_pos == HISTORY_LEN - 1) {
+        memmove(ch->history, ch->history + HISTORY_LEN / 2, HISTORY_LEN / 2 - 1);
+        ch->history_pos = HISTORY_LEN / 2 - 1;
+    }
+    ch->history[ch->history_pos++] = c;
+    ch->history[ch->history_pos] = '\0';
+
+    if (ch == &channels[channel_sel]) {
+        char str[2] = {c, 0};
+
+        pannel_add_text(str);
+    }
 }
 
-static bool is_mark_space(uint8_t *correction) {
+static bool is_mark_space(channel_t *ch, uint8_t *correction) {
     uint16_t res = 0;
 
-    if (rx_symbol[0] && !rx_symbol[SYMBOL_LEN - 1]) {
+    if (ch->rx_symbol[0] && !ch->rx_symbol[SYMBOL_LEN - 1]) {
         for (int i = 0; i < SYMBOL_LEN; i++)
-            res += rx_symbol[i];
+            res += ch->rx_symbol[i];
 
         if (abs(SYMBOL_LEN / 2 - res) < 1) {
             *correction = res;
@@ -149,128 +235,274 @@ static bool is_mark_space(uint8_t *correction) {
     return false;
 }
 
-static bool is_mark() {
-    return rx_symbol[SYMBOL_LEN / 2];
+static bool is_mark(channel_t *ch) {
+    return ch->rx_symbol[SYMBOL_LEN / 2];
 }
 
-static void add_symbol(float pwr) {
+static void add_symbol(channel_t *ch, float pwr, const params_view_t *pv) {
     for (uint8_t i = 1; i < SYMBOL_LEN; i++) {
-        rx_symbol[i - 1]     = rx_symbol[i];
-        rx_symbol_pwr[i - 1] = rx_symbol_pwr[i];
+        ch->rx_symbol[i - 1]     = ch->rx_symbol[i];
+        ch->rx_symbol_pwr[i - 1] = ch->rx_symbol_pwr[i];
     }
 
-    rx_symbol_pwr[SYMBOL_LEN - 1] = pwr;
+    ch->rx_symbol_pwr[SYMBOL_LEN - 1] = pwr;
 
     float   p_avr = 0.0f;
     uint8_t p_num = SYMBOL_LEN / 2;
 
     for (uint8_t i = SYMBOL_LEN - p_num; i < SYMBOL_LEN; i++)
-        p_avr += rx_symbol_pwr[i];
+        p_avr += ch->rx_symbol_pwr[i];
 
     p_avr /= (float)p_num;
 
-    if (rx_symbol_cur == 0) {
-        if (p_avr > params.rtty_snr) {
-            rx_symbol_cur = 1;
+    if (ch->rx_symbol_cur == 0) {
+        if (p_avr > pv->rtty_snr) {
+            ch->rx_symbol_cur = 1;
         }
     } else {
-        if (p_avr < -params.rtty_snr) {
-            rx_symbol_cur = 0;
+        if (p_avr < -pv->rtty_snr) {
+            ch->rx_symbol_cur = 0;
         }
     }
 
-    /* LV_LOG_USER("%5.1f %i", p_avr, rx_symbol_cur); */
-
-    rx_symbol[SYMBOL_LEN - 1] = rx_symbol_cur;
+    ch->rx_symbol[SYMBOL_LEN - 1] = ch->rx_symbol_cur;
 
     uint8_t correction;
 
-    switch (rx_state) {
+    switch (ch->rx_state) {
         case RX_STATE_IDLE:
-            if (is_mark_space(&correction)) {
-                rx_state   = RX_STATE_START;
-                rx_counter = correction;
+            if (is_mark_space(ch, &correction)) {
+                ch->rx_state   = RX_STATE_START;
+                ch->rx_counter = correction;
             }
             break;
 
         case RX_STATE_START:
-            if (--rx_counter == 0) {
-                if (!is_mark()) {
-                    rx_state   = RX_STATE_DATA;
-                    rx_counter = SYMBOL_LEN;
-                    rx_bitcntr = 0;
-                    rx_data    = 0;
+            if (--ch->rx_counter == 0) {
+                if (!is_mark(ch)) {
+                    ch->rx_state   = RX_STATE_DATA;
+                    ch->rx_counter = SYMBOL_LEN;
+                    ch->rx_bitcntr = 0;
+                    ch->rx_data    = 0;
                 } else {
-                    rx_state = RX_STATE_IDLE;
+                    ch->rx_state = RX_STATE_IDLE;
                 }
             }
             break;
 
         case RX_STATE_DATA:
-            if (--rx_counter == 0) {
-                rx_data |= is_mark() << rx_bitcntr++;
-                rx_counter = SYMBOL_LEN;
+            if (--ch->rx_counter == 0) {
+                ch->rx_data |= is_mark(ch) << ch->rx_bitcntr++;
+                ch->rx_counter = SYMBOL_LEN;
             }
 
-            if (rx_bitcntr == params.rtty_bits)
-                rx_state = RX_STATE_STOP;
+            if (ch->rx_bitcntr == pv->rtty_bits)
+                ch->rx_state = RX_STATE_STOP;
             break;
 
         case RX_STATE_STOP:
-            if (--rx_counter == 0) {
-                if (is_mark()) {
-                    char c = baudot_decoder(rx_data);
+            if (--ch->rx_counter == 0) {
+                if (is_mark(ch)) {
+                    char c = baudot_decoder(ch, ch->rx_data);
 
                     if (c) {
-                        char str[2] = {c, 0};
-
-                        pannel_add_text(str);
+                        channel_text(ch, c);
                     }
                 }
-                rx_state = RX_STATE_IDLE;
+                ch->rx_state = RX_STATE_IDLE;
             }
             break;
     }
 }
 
-void rtty_put_audio_samples(unsigned int n, cfloat *samples) {
-    pthread_mutex_lock(&rtty_mux);
-
-    if (!ready) {
-        pthread_mutex_unlock(&rtty_mux);
-        return;
-    }
+static void process_channel(channel_t *ch, cfloat *samples, unsigned int n, const params_view_t *pv) {
+    bool invert = ((cur_mode == x6100_mode_usb || cur_mode == x6100_mode_usb_dig) && !pv->rtty_reverse) ||
+                  ((cur_mode == x6100_mode_lsb || cur_mode == x6100_mode_lsb_dig) && pv->rtty_reverse);
 
-    cbuffercf_write(rx_buf, samples, n);
+    cbuffercf_write(ch->rx_buf, samples, n);
 
-    while (cbuffercf_size(rx_buf) > symbol_samples) {
-        unsigned int   symbol;
+    while (cbuffercf_size(ch->rx_buf) > symbol_samples) {
         unsigned int   n;
         cfloat *buf;
 
-        cbuffercf_read(rx_buf, symbol_samples, &buf, &n);
-        nco_crcf_mix_block_down(nco, buf, nco_buf, n);
+        cbuffercf_read(ch->rx_buf, symbol_samples, &buf, &n);
+        nco_crcf_mix_block_down(ch->nco, buf, nco_buf, n);
 
         for (uint16_t i = 0; i < n; i++)
             nco_buf[i] *= rx_window[i];
 
-        fskdem_demodulate(demod, nco_buf);
+        fskdem_demodulate(ch->demod, nco_buf);
 
-        float pwr0 = 10.0f * log10f(fskdem_get_symbol_energy(demod, 0, 1));
-        float pwr1 = 10.0f * log10f(fskdem_get_symbol_energy(demod, 1, 1));
+        float pwr0 = 10.0f * log10f(fskdem_get_symbol_energy(ch->demod, 0, 1));
+        float pwr1 = 10.0f * log10f(fskdem_get_symbol_energy(ch->demod, 1, 1));
         float pwr  = pwr0 - pwr1;
 
-        if (((cur_mode == x6100_mode_usb || cur_mode == x6100_mode_usb_dig) && !params.rtty_reverse) ||
-            ((cur_mode == x6100_mode_lsb || cur_mode == x6100_mode_lsb_dig) && params.rtty_reverse)) {
-            pwr = -pwr;
+        add_symbol(ch, invert ? -pwr : pwr, pv);
+
+        /* Fractional step, 45.45 baud is 15.16 samples of 11025 */
+
+        ch->rx_over += symbol_over;
+
+        unsigned int step = ch->rx_over;
+
+        ch->rx_over -= step;
+        cbuffercf_release(ch->rx_buf, step);
+    }
+}
+
+static int compare_float(const void *a, const void *b) {
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int16_t bin_freq(int bin) {
+    return (bin - SCAN_NFFT / 2) * RATE / SCAN_NFFT;
+}
+
+static channel_t * find_channel(uint16_t center) {
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+        channel_t *ch = &channels[i];
+
+        if (ch->active && abs((int)ch->center - (int)center) < SCAN_SAME) {
+            return ch;
+        }
+    }
+    return NULL;
+}
+
+static void add_pair(uint16_t center) {
+    uint64_t  now = get_time();
+    channel_t *ch = find_channel(center);
+
+    if (ch) {
+        ch->seen = now;
+
+        /* Auto center, the manual channel keeps params.rtty_center */
+
+        if (ch != &channels[0] && ch->center != center) {
+            ch->center = center;
+            update_nco(ch);
+        }
+        return;
+    }
+
+    for (uint8_t i = 1; i < CHANNELS; i++) {
+        ch = &channels[i];
+
+        if (!ch->active) {
+            reset_channel(ch, center);
+            ch->active = true;
+            LV_LOG_USER("RTTY channel %u at %u Hz", i, center);
+            return;
+        }
+    }
+}
+
+/**
+ * Mark and space are peaks on the configured shift with a gap between them,
+ * a wide signal has no gap. Strongest pairs take channels first
+ */
+static void scan_pairs() {
+    int   low = SCAN_NFFT / 2 + SCAN_LOW * SCAN_NFFT / RATE;
+    int   high = SCAN_NFFT / 2 + SCAN_HIGH * SCAN_NFFT / RATE;
+    int   shift = (params.rtty_shift * SCAN_NFFT + RATE / 2) / RATE;
+    float noise;
+
+    spgramcf_get_psd(scan_sg, scan_psd);
+    spgramcf_reset(scan_sg);
+
+    memcpy(scan_sorted, scan_psd + low, (high - low) * sizeof(float));
+    qsort(scan_sorted, high - low, sizeof(float), compare_float);
+    noise = scan_sorted[(high - low) / 2];
+
+    for (uint8_t n = 1; n < CHANNELS; n++) {
+        int     best = -1;
+        float   best_pwr = noise + SCAN_SNR;
+
+        for (int i = low + 2; i + shift < high - 2; i++) {
+            int   j = i + shift;
+            float pwr = fminf(scan_psd[i], scan_psd[j]);
+
+            if (pwr <= best_pwr) {
+                continue;
+            }
+            if (scan_psd[i] < scan_psd[i - 1] || scan_psd[i] < scan_psd[i + 1] ||
+                scan_psd[j] < scan_psd[j - 1] || scan_psd[j] < scan_psd[j + 1]) {
+                continue;
+            }
+            if (scan_psd[i + shift / 2] > pwr - SCAN_NOTCH) {
+                continue;
+            }
+            best = i;
+            best_pwr = pwr;
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        add_pair((bin_freq(best) + bin_freq(best + shift)) / 2);
+
+        /* Don't find it again */
+
+        for (int i = best - shift / 2; i <= best + shift + shift / 2; i++) {
+            if (i >= low && i < high) {
+                scan_psd[i] = noise;
+            }
         }
+    }
 
-        add_symbol(pwr);
+    uint64_t now = get_time();
 
-        cbuffercf_release(rx_buf, symbol_over);
+    for (uint8_t i = 1; i < CHANNELS; i++) {
+        channel_t *ch = &channels[i];
+
+        if (ch->active && now - ch->seen > CHANNEL_TIMEOUT) {
+            ch->active = false;
+            LV_LOG_USER("RTTY channel %u at %u Hz is gone", i, ch->center);
+
+            if (channel_sel == i) {
+                channel_sel = 0;
+            }
+        }
     }
+}
 
-    pthread_mutex_unlock(&rtty_mux);
+static bool audio_active(void *user) {
+    return state == RTTY_RX;
+}
+
+static void audio_cb(const void *data, size_t n, void *user) {
+    cfloat          *samples = (cfloat *)data;
+    params_view_t   pv;
+
+    params_view_get(&pv);
+    lock_stats_lock(&rtty_mux, "rtty");
+
+    if (!ready) {
+        lock_stats_unlock(&rtty_mux, "rtty");
+        return;
+    }
+
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+        if (channels[i].active) {
+            process_channel(&channels[i], samples, n, &pv);
+        }
+    }
+
+    if (pv.rtty_multi) {
+        spgramcf_write(scan_sg, samples, n);
+        scan_samples += n;
+
+        if (scan_samples >= SCAN_PERIOD) {
+            scan_samples = 0;
+            scan_pairs();
+        }
+    }
+
+    lock_stats_unlock(&rtty_mux, "rtty");
 }
 
 void rtty_set_state(rtty_state_t x) {
@@ -376,9 +608,10 @@ uint16_t rtty_change_center(int16_t df) {
     params.rtty_center = limit(align_int(params.rtty_center + df * 10, 10), 800, 1600);
     params_unlock(&params.dirty.rtty_center);
 
-    pthread_mutex_lock(&rtty_mux);
-    update_nco();
-    pthread_mutex_unlock(&rtty_mux);
+    lock_stats_lock(&rtty_mux, "rtty");
+    channels[0].center = params.rtty_center;
+    update_nco(&channels[0]);
+    lock_stats_unlock(&rtty_mux, "rtty");
 
     return params.rtty_center;
 }
@@ -395,6 +628,62 @@ bool rtty_change_reverse(int16_t df) {
     return params.rtty_reverse;
 }
 
+bool rtty_change_multi(int16_t df) {
+    if (df == 0) {
+        return params.rtty_multi;
+    }
+
+    params_lock();
+    params.rtty_multi = !params.rtty_multi;
+    params_unlock(&params.dirty.rtty_multi);
+
+    if (!params.rtty_multi) {
+        lock_stats_lock(&rtty_mux, "rtty");
+
+        for (uint8_t i = 1; i < CHANNELS; i++) {
+            channels[i].active = false;
+        }
+        channel_sel = 0;
+        lock_stats_unlock(&rtty_mux, "rtty");
+    }
+
+    return params.rtty_multi;
+}
+
+uint8_t rtty_change_channel(int16_t df) {
+    if (df == 0) {
+        return channel_sel;
+    }
+
+    lock_stats_lock(&rtty_mux, "rtty");
+
+    uint8_t i = channel_sel;
+
+    do {
+        i = (i + CHANNELS + (df > 0 ? 1 : -1)) % CHANNELS;
+    } while (!channels[i].active);
+
+    if (i != channel_sel) {
+        char str[16];
+
+        channel_sel = i;
+        snprintf(str, sizeof(str), "\n[%u Hz] ", channels[i].center);
+        pannel_add_text(str);
+
+        if (channels[i].history_pos) {
+            pannel_add_text(channels[i].history);
+        }
+    }
+
+    lock_stats_unlock(&rtty_mux, "rtty");
+
+    return channel_sel;
+}
+
+uint16_t rtty_get_channel_center(uint8_t channel) {
+    return channel < CHANNELS ? channels[channel].center : 0;
+}
+
 static void on_cur_mode_change(Subject *subj, void *user_data) {
     cur_mode = subject_get_int(subj);
 }
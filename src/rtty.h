@@ -20,8 +20,9 @@ typedef enum {
     RTTY_TX
 } rtty_state_t;
 
+#define RTTY_RATE   11025   // Of the audio graph sink
+
 void rtty_init();
-void rtty_put_audio_samples(unsigned int n, cfloat *samples);
 
 void rtty_set_state(rtty_state_t state);
 rtty_state_t rtty_get_state();
@@ -30,3 +31,10 @@ float rtty_change_rate(int16_t df);
 uint16_t rtty_change_shift(int16_t df);
 uint16_t rtty_change_center(int16_t df);
 bool rtty_change_reverse(int16_t df);
+
+/* Multi-channel: FSK pairs of the shift are searched in the spectrum,
+ * channel 0 stays at the manual center */
+
+bool rtty_change_multi(int16_t df);
+uint8_t rtty_change_channel(int16_t df);
+uint16_t rtty_get_channel_center(uint8_t channel);
@@ -7,54 +7,372 @@
  */
 
 #include "scheduler.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include "lock_stats.h"
 
-#include <queue>
-#include <mutex>
+#include <atomic>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 
 extern "C" {
     #include "lvgl/lvgl.h"
 }
 
-#define QUEUE_MAX_SIZE  64
+/*
+ * Bounded MPSC ring (Vyukov style): producers claim a slot with a CAS on
+ * the enqueue position, the UI thread is the only consumer. Small arguments
+ * are copied into the slot itself, bigger ones go to a fixed slab pool and
+ * only oversized ones hit malloc.
+ *
+ * Keyed tasks keep their argument in a per key entry and put a single
+ * trampoline into the ring, later puts only update the entry.
+ *
+ * There is a ring per priority lane. scheduler_work() drains the input lane
+ * and runs the others in order within a time budget, the rest waits for the
+ * next main loop iteration.
+ *
+ * Puts on the input and radio lanes wake the main loop through an eventfd,
+ * display and bulk work waits for the next LVGL timer anyway.
+ */
+
+#define QUEUE_SIZE      256     /* Power of two */
+#define INLINE_SIZE     128
+#define SLAB_BLOCKS     32
+#define SLAB_SIZE       1024
+
+#define DEFAULT_BUDGET  8000    /* us */
 
-struct item_t {
-    scheduler_fn_t fn;
-    void    *arg;
+struct slot_t {
+    std::atomic<uint32_t>   seq;
+    scheduler_fn_t          fn;
+    void                    *arg;
+    uint64_t                put_time;
+    alignas(8) uint8_t      data[INLINE_SIZE];
 };
 
-static std::queue<item_t> queue;
-static std::mutex m_mutex;
+struct lane_t {
+    slot_t                  slots[QUEUE_SIZE];
+    std::atomic<uint32_t>   enqueue_pos;
+    uint32_t                dequeue_pos;
+
+    std::atomic<uint16_t>   depth_max;
+    std::atomic<uint32_t>   runs;
+    std::atomic<uint32_t>   carried;
+    std::atomic<uint64_t>   wait_sum_us;
+    std::atomic<uint32_t>   wait_max_us;
+    std::atomic<uint64_t>   run_sum_us;
+    std::atomic<uint32_t>   run_max_us;
+};
+
+struct keyed_t {
+    StatMutex               mux{"scheduler"};
+    bool                    queued;
+    scheduler_fn_t          fn;
+    size_t                  arg_size;
+    alignas(8) uint8_t      data[INLINE_SIZE];
+};
+
+static lane_t                   lanes[SCHEDULER_PRIO_LAST];
+static keyed_t                  keyed[SCHEDULER_KEY_LAST];
+static uint32_t                 budget = DEFAULT_BUDGET;
+
+alignas(8) static uint8_t       slab[SLAB_BLOCKS][SLAB_SIZE];
+static std::atomic<uint32_t>    slab_used(0);
+
+static std::atomic<uint32_t>    stat_puts(0);
+static std::atomic<uint32_t>    stat_drops(0);
+static std::atomic<uint32_t>    stat_coalesced(0);
+static std::atomic<uint32_t>    stat_slab(0);
+static std::atomic<uint32_t>    stat_malloc(0);
+static std::atomic<uint32_t>    stat_put_max_us(0);
+
+static int                      wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+static std::atomic<bool>        wake_pending(false);
+
+static bool slots_ready = [] {
+    for (uint32_t l = 0; l < SCHEDULER_PRIO_LAST; l++) {
+        for (uint32_t i = 0; i < QUEUE_SIZE; i++) {
+            lanes[l].slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    return true;
+}();
+
+static uint64_t now_us() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void atomic_max(std::atomic<uint32_t> &a, uint32_t v) {
+    uint32_t cur = a.load(std::memory_order_relaxed);
+
+    while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+    }
+}
+
+static void * slab_alloc() {
+    uint32_t used = slab_used.load(std::memory_order_relaxed);
+
+    while (used != UINT32_MAX) {
+        uint32_t bit = __builtin_ctz(~used);
+
+        if (slab_used.compare_exchange_weak(used, used | (1u << bit), std::memory_order_acquire)) {
+            return slab[bit];
+        }
+    }
+    return NULL;
+}
+
+static void arg_free(slot_t *slot) {
+    uint8_t *p = (uint8_t *) slot->arg;
 
-void scheduler_put(scheduler_fn_t fn, void * arg, size_t arg_size) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    if (queue.size() > QUEUE_MAX_SIZE){
-        LV_LOG_ERROR("Scheduler queue overflow");
+    if (p == NULL || p == slot->data) {
         return;
     }
-    void *arg_copy = nullptr;
+    if (p >= slab[0] && p < slab[SLAB_BLOCKS]) {
+        uint32_t bit = (p - slab[0]) / SLAB_SIZE;
+
+        slab_used.fetch_and(~(1u << bit), std::memory_order_release);
+    } else {
+        mem_free(MEM_SCHEDULER, p);
+    }
+}
+
+bool scheduler_put_prio(scheduler_prio_t prio, scheduler_fn_t fn, void * arg, size_t arg_size) {
+    lane_t      *lane = &lanes[prio];
+    uint64_t    start = now_us();
+    uint32_t    pos = lane->enqueue_pos.load(std::memory_order_relaxed);
+    slot_t      *slot;
+
+    while (true) {
+        slot = &lane->slots[pos & (QUEUE_SIZE - 1)];
+
+        int32_t dif = (int32_t) (slot->seq.load(std::memory_order_acquire) - pos);
+
+        if (dif == 0) {
+            if (lane->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            stat_drops.fetch_add(1, std::memory_order_relaxed);
+            LV_LOG_ERROR("Scheduler queue %i overflow", prio);
+            return false;
+        } else {
+            pos = lane->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    void *arg_copy = NULL;
+
     if (arg_size) {
-        arg_copy = malloc(arg_size);
+        if (arg_size <= INLINE_SIZE) {
+            arg_copy = slot->data;
+        } else if (arg_size <= SLAB_SIZE && (arg_copy = slab_alloc())) {
+            stat_slab.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            arg_copy = mem_alloc(MEM_SCHEDULER, arg_size);
+            stat_malloc.fetch_add(1, std::memory_order_relaxed);
+        }
         memcpy(arg_copy, arg, arg_size);
     }
-    item_t item = {fn, arg_copy};
-    queue.push(item);
+
+    uint64_t put_time = now_us();
+
+    slot->fn = fn;
+    slot->arg = arg_copy;
+    slot->put_time = put_time;
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    /* The slot belongs to the consumer from here on */
+
+    uint32_t depth = pos + 1 - __atomic_load_n(&lane->dequeue_pos, __ATOMIC_RELAXED);
+    uint16_t depth_max = lane->depth_max.load(std::memory_order_relaxed);
+
+    while (depth > depth_max && !lane->depth_max.compare_exchange_weak(depth_max, depth, std::memory_order_relaxed)) {
+    }
+
+    stat_puts.fetch_add(1, std::memory_order_relaxed);
+    trace_instant(TRACE_SCHEDULER_PUT, prio);
+    atomic_max(stat_put_max_us, put_time - start);
+
+    if (prio <= SCHEDULER_PRIO_RADIO && !wake_pending.exchange(true, std::memory_order_acq_rel)) {
+        uint64_t one = 1;
+
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            wake_pending.store(false, std::memory_order_relaxed);
+        }
+    }
+    return true;
+}
+
+bool scheduler_put(scheduler_fn_t fn, void * arg, size_t arg_size) {
+    return scheduler_put_prio(SCHEDULER_PRIO_RADIO, fn, arg, arg_size);
 }
 
-void scheduler_put_noargs(scheduler_fn_t fn) {
+bool scheduler_put_noargs(scheduler_fn_t fn) {
     return scheduler_put(fn, NULL, 0);
 }
 
-void scheduler_work() {
-    item_t item;
-    while (!queue.empty()) {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            item = queue.front();
-            queue.pop();
+static void keyed_run(void *arg) {
+    keyed_t                 *entry = &keyed[*(scheduler_key_t *) arg];
+    scheduler_fn_t          fn;
+    alignas(8) uint8_t      data[INLINE_SIZE];
+    bool                    has_arg;
+
+    {
+        std::lock_guard<StatMutex> lock(entry->mux);
+
+        fn = entry->fn;
+        has_arg = entry->arg_size != 0;
+        memcpy(data, entry->data, entry->arg_size);
+        entry->queued = false;
+    }
+    fn(has_arg ? data : NULL);
+}
+
+static bool put_keyed(scheduler_key_t key, scheduler_fn_t fn, scheduler_merge_fn_t merge, void *arg, size_t arg_size) {
+    if (key >= SCHEDULER_KEY_LAST || arg_size > INLINE_SIZE) {
+        LV_LOG_ERROR("Wrong keyed task %i (arg size %zu)", key, arg_size);
+        return false;
+    }
+
+    keyed_t                     *entry = &keyed[key];
+    std::lock_guard<StatMutex> lock(entry->mux);
+
+    if (entry->queued) {
+        if (merge && entry->arg_size == arg_size) {
+            merge(entry->data, arg);
+        } else {
+            memcpy(entry->data, arg, arg_size);
+            entry->arg_size = arg_size;
+        }
+        entry->fn = fn;
+        stat_coalesced.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (arg_size) {
+        memcpy(entry->data, arg, arg_size);
+    }
+    entry->fn = fn;
+    entry->arg_size = arg_size;
+    entry->queued = scheduler_put_prio(SCHEDULER_PRIO_DISPLAY, keyed_run, &key, sizeof(key));
+
+    return entry->queued;
+}
+
+bool scheduler_put_coalesced(scheduler_key_t key, scheduler_fn_t fn, void *arg, size_t arg_size) {
+    return put_keyed(key, fn, NULL, arg, arg_size);
+}
+
+bool scheduler_put_merged(scheduler_key_t key, scheduler_fn_t fn, scheduler_merge_fn_t merge, void *arg, size_t arg_size) {
+    return put_keyed(key, fn, merge, arg, arg_size);
+}
+
+/*
+ * Run tasks of the lane queued before end, at least one and then until the deadline.
+ * Returns true when the lane has been drained up to end
+ */
+static bool lane_work(lane_t *lane, uint32_t end, uint64_t deadline) {
+    bool first = true;
+
+    while (lane->dequeue_pos != end) {
+        slot_t      *slot = &lane->slots[lane->dequeue_pos & (QUEUE_SIZE - 1)];
+        uint32_t    seq = slot->seq.load(std::memory_order_acquire);
+
+        if (seq != lane->dequeue_pos + 1) {
+            break;
+        }
+
+        uint64_t start = now_us();
+
+        if (!first && start > deadline) {
+            return false;
         }
-        item.fn(item.arg);
-        if (item.arg) {
-            free(item.arg);
+        first = false;
+
+        uint32_t wait = start - slot->put_time;
+
+        trace_begin(TRACE_SCHEDULER_WORK, wait);
+        slot->fn(slot->arg);
+        trace_end(TRACE_SCHEDULER_WORK);
+        arg_free(slot);
+
+        slot->seq.store(lane->dequeue_pos + QUEUE_SIZE, std::memory_order_release);
+        __atomic_store_n(&lane->dequeue_pos, lane->dequeue_pos + 1, __ATOMIC_RELAXED);
+
+        uint32_t run = now_us() - start;
+
+        lane->runs.fetch_add(1, std::memory_order_relaxed);
+        lane->wait_sum_us.fetch_add(wait, std::memory_order_relaxed);
+        lane->run_sum_us.fetch_add(run, std::memory_order_relaxed);
+        atomic_max(lane->wait_max_us, wait);
+        atomic_max(lane->run_max_us, run);
+    }
+    return true;
+}
+
+void scheduler_work() {
+    uint64_t    deadline = now_us() + budget;
+    uint32_t    end[SCHEDULER_PRIO_LAST];
+
+    for (uint32_t l = 0; l < SCHEDULER_PRIO_LAST; l++) {
+        end[l] = lanes[l].enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    lane_work(&lanes[SCHEDULER_PRIO_INPUT], end[SCHEDULER_PRIO_INPUT], UINT64_MAX);
+
+    for (uint32_t l = SCHEDULER_PRIO_INPUT + 1; l < SCHEDULER_PRIO_LAST; l++) {
+        if (!lane_work(&lanes[l], end[l], deadline)) {
+            lanes[l].carried.fetch_add(1, std::memory_order_relaxed);
         }
     }
 }
+
+int scheduler_wake_fd() {
+    return wake_fd;
+}
+
+void scheduler_wake_ack() {
+    uint64_t cnt;
+
+    wake_pending.store(false, std::memory_order_release);
+
+    if (read(wake_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN) {
+        LV_LOG_WARN("Wakeup read failed");
+    }
+}
+
+void scheduler_set_budget(uint32_t us) {
+    budget = us;
+}
+
+void scheduler_get_stats(scheduler_stats_t *stats) {
+    stats->puts = stat_puts.load(std::memory_order_relaxed);
+    stats->drops = stat_drops.load(std::memory_order_relaxed);
+    stats->coalesced = stat_coalesced.load(std::memory_order_relaxed);
+    stats->slab_args = stat_slab.load(std::memory_order_relaxed);
+    stats->malloc_args = stat_malloc.load(std::memory_order_relaxed);
+    stats->put_max_us = stat_put_max_us.load(std::memory_order_relaxed);
+
+    for (uint32_t l = 0; l < SCHEDULER_PRIO_LAST; l++) {
+        lane_t                  *lane = &lanes[l];
+        scheduler_lane_stats_t  *out = &stats->lanes[l];
+        uint32_t                runs = lane->runs.load(std::memory_order_relaxed);
+
+        out->runs = runs;
+        out->carried = lane->carried.load(std::memory_order_relaxed);
+        out->depth_max = lane->depth_max.load(std::memory_order_relaxed);
+        out->wait_max_us = lane->wait_max_us.load(std::memory_order_relaxed);
+        out->wait_avg_us = runs ? lane->wait_sum_us.load(std::memory_order_relaxed) / runs : 0;
+        out->run_max_us = lane->run_max_us.load(std::memory_order_relaxed);
+        out->run_avg_us = runs ? lane->run_sum_us.load(std::memory_order_relaxed) / runs : 0;
+    }
+}
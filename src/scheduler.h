@@ -8,30 +8,114 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef void (* scheduler_fn_t)(void *);
+typedef void (* scheduler_merge_fn_t)(void *pending, const void *arg);
+
+/* Lanes in execution order */
+typedef enum {
+    SCHEDULER_PRIO_INPUT = 0,       /* Encoder and key feedback */
+    SCHEDULER_PRIO_RADIO,           /* Radio state */
+    SCHEDULER_PRIO_DISPLAY,         /* Spectrum, waterfall, meters */
+    SCHEDULER_PRIO_BULK,            /* List and text updates */
+
+    SCHEDULER_PRIO_LAST
+} scheduler_prio_t;
+
+/* Keys of idempotent tasks, each one is queued at most once */
+typedef enum {
+    SCHEDULER_KEY_WATERFALL = 0,
+    SCHEDULER_KEY_WATERFALL_FRAME,
+    SCHEDULER_KEY_SPECTRUM,
+    SCHEDULER_KEY_METER,
+    SCHEDULER_KEY_WIFI,
+    SCHEDULER_KEY_DX_SPOTS,
+
+    SCHEDULER_KEY_LAST
+} scheduler_key_t;
+
+typedef struct {
+    uint32_t    runs;
+    uint32_t    carried;        /* Passes which left work for the next loop */
+    uint16_t    depth_max;      /* Queue depth high-water mark */
+    uint32_t    wait_max_us;    /* Longest put to execution delay */
+    uint32_t    wait_avg_us;
+    uint32_t    run_max_us;     /* Longest task */
+    uint32_t    run_avg_us;
+} scheduler_lane_stats_t;
+
+typedef struct {
+    uint32_t                puts;
+    uint32_t                drops;
+    uint32_t                coalesced;      /* Puts absorbed by an already pending key */
+    uint32_t                slab_args;      /* Arguments stored in the slab pool */
+    uint32_t                malloc_args;    /* Arguments too big for the slab pool */
+    uint32_t                put_max_us;     /* Longest scheduler_put() call */
+    scheduler_lane_stats_t  lanes[SCHEDULER_PRIO_LAST];
+} scheduler_stats_t;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * Schedule execution function in main thread
+ * Schedule execution function in main thread. Returns false if the queue is full
  */
-void scheduler_put(scheduler_fn_t fn, void *arg, size_t arg_size);
+bool scheduler_put(scheduler_fn_t fn, void *arg, size_t arg_size);
 
+/**
+ * Schedule execution function in main thread on the given lane
+ */
+bool scheduler_put_prio(scheduler_prio_t prio, scheduler_fn_t fn, void *arg, size_t arg_size);
 
 /**
  * Schedule execution function without arguments in main thread
  */
-void scheduler_put_noargs(scheduler_fn_t fn);
+bool scheduler_put_noargs(scheduler_fn_t fn);
+
+/**
+ * Schedule keyed task on the display lane. If the key is already pending, its
+ * argument is replaced and the task still runs once. Argument size is limited
+ * to 128 bytes
+ */
+bool scheduler_put_coalesced(scheduler_key_t key, scheduler_fn_t fn, void *arg, size_t arg_size);
+
+/**
+ * Same as scheduler_put_coalesced(), but a pending argument is combined with
+ * the new one by merge() instead of being replaced
+ */
+bool scheduler_put_merged(scheduler_key_t key, scheduler_fn_t fn, scheduler_merge_fn_t merge, void *arg, size_t arg_size);
 
 /**
- * Execute scheduled functions
+ * Execute scheduled functions. Tasks put while running are left for the next call.
+ * Input lane is always drained, lower lanes run one task each and then only
+ * while the time budget lasts
  */
 void scheduler_work();
 
+/**
+ * Eventfd which gets readable when a task is put on the input or radio lane
+ */
+int scheduler_wake_fd();
+
+/**
+ * Clear wakeup, called by the main loop after the fd got readable
+ */
+void scheduler_wake_ack();
+
+/**
+ * Set time budget of scheduler_work()
+ */
+void scheduler_set_budget(uint32_t us);
+
+/**
+ * Get queue counters
+ */
+void scheduler_get_stats(scheduler_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <png.h>
 #include <pthread.h>
 
@@ -17,26 +18,39 @@
 #include "util.h"
 #include "msg.h"
 
-static char         file_str[64];
-static char         time_str[64];
-static lv_img_dsc_t snapshot;
-static uint8_t      *rows[480];
-static uint8_t      *buf;
+#define WIDTH       800
+#define HEIGHT      480
+#define POOL_SIZE   2           /* Snapshots waiting for the encoder */
+#define PNG_LEVEL   1           /* Fast zlib level, UI images compress well anyway */
 
-static void * screenshot_thread(void *arg) {
-    get_time_str(time_str, sizeof(time_str));
+typedef struct {
+    uint8_t     *buf;
+    char        time_str[64];
+    bool        pending;
+} shot_t;
+
+static shot_t           pool[POOL_SIZE];
+static uint8_t          next_shot = 0;
+static uint8_t          row[WIDTH * 3];
+
+static pthread_mutex_t  pool_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t   init_once = PTHREAD_ONCE_INIT;
+static bool             ready = false;
 
-    strcpy(file_str, "/mnt/");
-    strcat(file_str, time_str);
-    strcat(file_str, ".png");
+static void encode(shot_t *shot) {
+    char file_str[80];
+
+    snprintf(file_str, sizeof(file_str), "/mnt/%s.png", shot->time_str);
 
     FILE *fp = fopen(file_str, "wb");
 
     if (!fp) {
         msg_update_text_fmt("Error write file");
-        goto done;
+        return;
     }
 
+    png_infop   png_info = NULL;
     png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
     if (!png_ptr) {
@@ -44,7 +58,7 @@ static void * screenshot_thread(void *arg) {
         goto close_file;
     }
 
-    png_infop png_info = png_create_info_struct(png_ptr);
+    png_info = png_create_info_struct(png_ptr);
 
     if (!png_info) {
         LV_LOG_ERROR("Create info struct");
@@ -57,54 +71,119 @@ static void * screenshot_thread(void *arg) {
     }
 
     png_init_io(png_ptr, fp);
+    png_set_compression_level(png_ptr, PNG_LEVEL);
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
 
     png_set_IHDR(
         png_ptr, png_info,
-        800, 480,
+        WIDTH, HEIGHT,
         8, PNG_COLOR_TYPE_RGB,
         PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
         PNG_FILTER_TYPE_DEFAULT);
 
-    for (uint16_t y = 0; y < 480; y++) {
-        rows[y] = (uint8_t *) malloc(800 * 3);
+    png_write_info(png_ptr, png_info);
 
-        for (uint16_t x = 0; x < 800; x++) {
-            uint32_t    to = x * 3;
-            uint32_t    from = (y * 800 + x) * 4 + 2;
+    /* One row buffer, BGRA -> RGB */
+    for (uint16_t y = 0; y < HEIGHT; y++) {
+        const uint8_t *from = &shot->buf[y * WIDTH * 4];
 
-            rows[y][to++] = buf[from--];
-            rows[y][to++] = buf[from--];
-            rows[y][to++] = buf[from--];
+        for (uint16_t x = 0; x < WIDTH; x++) {
+            row[x * 3 + 0] = from[2];
+            row[x * 3 + 1] = from[1];
+            row[x * 3 + 2] = from[0];
+            from += 4;
         }
+
+        png_write_row(png_ptr, row);
     }
 
-    png_set_rows(png_ptr, png_info, rows);
-    png_write_png(png_ptr, png_info, PNG_TRANSFORM_IDENTITY, NULL);
     png_write_end(png_ptr, png_info);
 
-    for (uint16_t y = 0; y < 480; y++) {
-        free(rows[y]);
-    }
-
-    msg_update_text_fmt("Saved %s", time_str);
+    msg_update_text_fmt("Saved %s", shot->time_str);
 
 destroy_write:
-    png_destroy_write_struct(&png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &png_info);
 close_file:
     fclose(fp);
-done:
-    free(buf);
 }
 
-void screenshot_take() {
-    uint32_t        buf_size = lv_snapshot_buf_size_needed(lv_scr_act(), LV_IMG_CF_TRUE_COLOR_ALPHA);
+static void * screenshot_thread(void *arg) {
+    set_thread_name("screenshot");
+
+    uint8_t n = 0;
+
+    while (true) {
+        pthread_mutex_lock(&pool_mux);
+
+        while (!pool[n].pending) {
+            pthread_cond_wait(&pool_cond, &pool_mux);
+        }
+
+        pthread_mutex_unlock(&pool_mux);
+
+        encode(&pool[n]);
+
+        pthread_mutex_lock(&pool_mux);
+        pool[n].pending = false;
+        pthread_mutex_unlock(&pool_mux);
+
+        n = (n + 1) % POOL_SIZE;
+    }
+
+    return NULL;
+}
 
-    buf = (uint8_t *) malloc(buf_size);
+static void init() {
+    uint32_t buf_size = lv_snapshot_buf_size_needed(lv_scr_act(), LV_IMG_CF_TRUE_COLOR_ALPHA);
 
-    lv_snapshot_take_to_buf(lv_scr_act(), LV_IMG_CF_TRUE_COLOR_ALPHA, &snapshot, buf, buf_size);
+    for (uint8_t i = 0; i < POOL_SIZE; i++) {
+        pool[i].buf = (uint8_t *) malloc(buf_size);
+
+        if (!pool[i].buf) {
+            LV_LOG_ERROR("Can't allocate screenshot buffer");
+            return;
+        }
+    }
 
     pthread_t thread;
 
     pthread_create(&thread, NULL, screenshot_thread, NULL);
     pthread_detach(thread);
+
+    ready = true;
+}
+
+void screenshot_take() {
+    lv_img_dsc_t    snapshot;
+    uint32_t        buf_size = lv_snapshot_buf_size_needed(lv_scr_act(), LV_IMG_CF_TRUE_COLOR_ALPHA);
+
+    pthread_once(&init_once, init);
+
+    if (!ready) {
+        return;
+    }
+
+    shot_t *shot = &pool[next_shot];
+
+    /* Encoder is behind, older snapshots are still queued */
+    pthread_mutex_lock(&pool_mux);
+    bool busy = shot->pending;
+    pthread_mutex_unlock(&pool_mux);
+
+    if (busy) {
+        msg_update_text_fmt("Screenshot queue is full");
+        return;
+    }
+
+    lv_snapshot_take_to_buf(lv_scr_act(), LV_IMG_CF_TRUE_COLOR_ALPHA, &snapshot, shot->buf, buf_size);
+    get_time_str(shot->time_str, sizeof(shot->time_str));
+
+    msg_update_text_fmt("Screenshot %s", shot->time_str);
+
+    pthread_mutex_lock(&pool_mux);
+    shot->pending = true;
+    pthread_cond_signal(&pool_cond);
+    pthread_mutex_unlock(&pool_mux);
+
+    next_shot = (next_shot + 1) % POOL_SIZE;
 }
@@ -0,0 +1,98 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "signals.h"
+
+#include "dsp/peak_detect.h"
+
+#include <atomic>
+
+#define SPAN_HZ     100000
+
+static_assert(SIGNALS_MAX == PeakDetector::max_peaks, "Signals list and detector differ");
+
+/* DSP thread */
+static PeakDetector             detector;
+static uint16_t                 psd_size = 0;
+
+static signals_t                list;
+static std::atomic<uint32_t>    seq{0};      /* Odd while the list is written */
+
+static void publish(const float *psd, uint64_t now) {
+    const detected_peak_t   *peaks = detector.values();
+    float                   bin_hz = (float)SPAN_HZ / psd_size;
+    float                   level = detector.floor_median() + SIGNALS_OCCUPIED_DB;
+    uint16_t                occupied = 0;
+    uint32_t                s = seq.load(std::memory_order_relaxed);
+
+    for (uint16_t i = 0; i < psd_size; i++) {
+        occupied += psd[i] > level;
+    }
+
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    list.version++;
+    list.time = now;
+    list.floor = detector.floor_median();
+    list.occupied = (float)occupied / psd_size;
+    list.count = detector.size();
+
+    for (uint16_t i = 0; i < list.count; i++) {
+        signal_peak_t *p = &list.peaks[i];
+
+        p->id = peaks[i].id;
+        p->freq = (peaks[i].bin - psd_size / 2) * bin_hz;
+        p->snr = peaks[i].snr;
+        p->hits = peaks[i].hits;
+        p->narrow = peaks[i].narrow;
+    }
+
+    seq.store(s + 2, std::memory_order_release);
+}
+
+void signals_put_psd(const float *psd, uint16_t size, uint64_t now) {
+    if (size != psd_size) {
+        detector.reset();
+        psd_size = size;
+    }
+    detector.update(psd, size);
+    publish(psd, now);
+}
+
+void signals_retune(int32_t diff) {
+    if (psd_size) {
+        detector.shift((float)diff * psd_size / SPAN_HZ, psd_size);
+    }
+}
+
+void signals_reset() {
+    detector.reset();
+}
+
+float signals_floor_quantile(float q) {
+    return detector.floor_quantile(q);
+}
+
+uint32_t signals_read(signals_t *dst) {
+    uint32_t s;
+
+    do {
+        s = seq.load(std::memory_order_acquire);
+
+        if (s & 1) {
+            continue;
+        }
+
+        *dst = list;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((s & 1) || seq.load(std::memory_order_relaxed) != s);
+
+    return dst->version;
+}
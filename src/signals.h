@@ -0,0 +1,63 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Signals of the RX span, found once per waterfall row by the DSP: peaks over
+ * the median noise floor with hysteresis, tracked between rows by ID. The
+ * list is sorted by freq and copied by the readers without locks (seqlock),
+ * any thread can read it.
+ */
+
+#define SIGNALS_MAX         64
+#define SIGNALS_OCCUPIED_DB 6.0f    /* Over the floor, for the occupied bins */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint16_t    id;             /* Same while the signal is tracked */
+    int32_t     freq;           /* Hz from the center of the span */
+    float       snr;            /* dB over the noise floor */
+    uint16_t    hits;           /* Rows with the signal */
+    bool        narrow;         /* Carrier or CW */
+} signal_peak_t;
+
+typedef struct {
+    uint32_t        version;    /* Incremented with every row */
+    uint64_t        time;
+    float           floor;      /* dB, median of the row */
+    float           occupied;   /* Fraction of the bins over the floor + SIGNALS_OCCUPIED_DB */
+    uint16_t        count;
+    signal_peak_t   peaks[SIGNALS_MAX];
+} signals_t;
+
+/**
+ * Copy the latest list. Returns its version
+ */
+uint32_t signals_read(signals_t *list);
+
+/* DSP thread */
+
+void signals_put_psd(const float *psd, uint16_t size, uint64_t now);
+void signals_retune(int32_t diff);
+void signals_reset();
+
+/**
+ * Quantile of the noise floor, for auto min/max
+ */
+float signals_floor_quantile(float q);
+
+#ifdef __cplusplus
+}
+#endif
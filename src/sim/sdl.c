@@ -0,0 +1,209 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "sdl.h"
+
+#include <SDL2/SDL.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WIDTH       800
+#define HEIGHT      480
+#define POLL_MS     10
+
+typedef enum {
+    DEV_KEYPAD = 0,
+    DEV_VFO,
+    DEV_VOL,
+    DEV_MFK,
+
+    DEV_LAST
+} sim_dev_t;
+
+typedef struct {
+    SDL_Keycode sym;
+    sim_dev_t   dev;
+    int32_t     code;           /* EV_KEY code, or EV_REL value with rel */
+    bool        rel;
+} key_map_t;
+
+static const char * const fifos[DEV_LAST] = { SIM_KEYPAD, SIM_VFO, SIM_VOL, SIM_MFK };
+
+static const key_map_t keys[] = {
+    { SDLK_F1,          DEV_KEYPAD, BTN_TRIGGER_HAPPY13 },
+    { SDLK_F2,          DEV_KEYPAD, BTN_TRIGGER_HAPPY14 },
+    { SDLK_F3,          DEV_KEYPAD, BTN_TRIGGER_HAPPY15 },
+    { SDLK_F4,          DEV_KEYPAD, BTN_TRIGGER_HAPPY19 },
+    { SDLK_F5,          DEV_KEYPAD, BTN_TRIGGER_HAPPY20 },
+    { SDLK_1,           DEV_KEYPAD, BTN_TRIGGER_HAPPY1 },
+    { SDLK_2,           DEV_KEYPAD, BTN_TRIGGER_HAPPY7 },
+    { SDLK_3,           DEV_KEYPAD, BTN_TRIGGER_HAPPY2 },
+    { SDLK_4,           DEV_KEYPAD, BTN_TRIGGER_HAPPY8 },
+    { SDLK_5,           DEV_KEYPAD, BTN_TRIGGER_HAPPY3 },
+    { SDLK_6,           DEV_KEYPAD, BTN_TRIGGER_HAPPY9 },
+    { SDLK_l,           DEV_KEYPAD, BTN_TRIGGER_HAPPY25 },
+    { SDLK_p,           DEV_KEYPAD, KEY_POWER },
+    { SDLK_SPACE,       DEV_KEYPAD, BTN_TRIGGER_HAPPY4 },
+    { SDLK_PAGEDOWN,    DEV_KEYPAD, BTN_TRIGGER_HAPPY5 },
+    { SDLK_PAGEUP,      DEV_KEYPAD, BTN_TRIGGER_HAPPY6 },
+    { SDLK_a,           DEV_KEYPAD, BTN_TRIGGER_HAPPY10 },
+    { SDLK_c,           DEV_KEYPAD, BTN_TRIGGER_HAPPY11 },
+    { SDLK_s,           DEV_KEYPAD, BTN_TRIGGER_HAPPY12 },
+    { SDLK_b,           DEV_KEYPAD, BTN_TRIGGER_HAPPY16 },
+    { SDLK_r,           DEV_KEYPAD, BTN_TRIGGER_HAPPY17 },
+    { SDLK_t,           DEV_KEYPAD, BTN_TRIGGER_HAPPY18 },
+    { SDLK_v,           DEV_KEYPAD, BTN_TRIGGER_HAPPY22 },
+    { SDLK_g,           DEV_KEYPAD, BTN_TRIGGER_HAPPY23 },
+    { SDLK_q,           DEV_KEYPAD, BTN_TRIGGER_HAPPY24 },
+    { SDLK_ESCAPE,      DEV_KEYPAD, BTN_TRIGGER_HAPPY21 },
+    { SDLK_RETURN,      DEV_KEYPAD, BTN_TRIGGER_HAPPY27 },
+
+    { SDLK_LEFT,        DEV_VFO,    -1, true },
+    { SDLK_RIGHT,       DEV_VFO,    1,  true },
+    { SDLK_MINUS,       DEV_VOL,    -1, true },
+    { SDLK_EQUALS,      DEV_VOL,    1,  true },
+    { SDLK_DOWN,        DEV_MFK,    -1, true },
+    { SDLK_UP,          DEV_MFK,    1,  true },
+};
+
+static SDL_Window   *window;
+static SDL_Renderer *renderer;
+static SDL_Texture  *texture;
+static uint32_t     fb[WIDTH * HEIGHT];
+static int          fds[DEV_LAST];
+
+bool sim_sdl_init() {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        LV_LOG_ERROR("SDL init: %s", SDL_GetError());
+        return false;
+    }
+
+    window = SDL_CreateWindow("X6100", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, 0);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
+
+    if (!texture) {
+        LV_LOG_ERROR("SDL window: %s", SDL_GetError());
+        return false;
+    }
+
+    for (uint8_t i = 0; i < DEV_LAST; i++) {
+        unlink(fifos[i]);
+
+        if (mkfifo(fifos[i], 0600) < 0) {
+            LV_LOG_ERROR("mkfifo %s: %s", fifos[i], strerror(errno));
+        }
+    }
+
+    return true;
+}
+
+void sim_sdl_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p) {
+    int32_t w = lv_area_get_width(area);
+
+    for (int32_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&fb[y * WIDTH + area->x1], color_p, w * sizeof(uint32_t));
+        color_p += w;
+    }
+
+    if (lv_disp_flush_is_last(drv)) {
+        SDL_UpdateTexture(texture, NULL, fb, WIDTH * sizeof(uint32_t));
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+    }
+
+    lv_disp_flush_ready(drv);
+}
+
+static void emit(sim_dev_t dev, uint16_t type, uint16_t code, int32_t value) {
+    struct input_event  ev[2];
+    struct timespec     now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    memset(ev, 0, sizeof(ev));
+
+    for (uint8_t i = 0; i < 2; i++) {
+        ev[i].input_event_sec = now.tv_sec;
+        ev[i].input_event_usec = now.tv_nsec / 1000;
+    }
+
+    ev[0].type = type;
+    ev[0].code = code;
+    ev[0].value = value;
+    ev[1].type = EV_SYN;
+    ev[1].code = SYN_REPORT;
+
+    if (fds[dev] >= 0 && write(fds[dev], ev, sizeof(ev)) < 0) {
+        LV_LOG_WARN("Input %s: %s", fifos[dev], strerror(errno));
+    }
+}
+
+static void key(SDL_Keycode sym, bool down, bool repeat) {
+    for (uint8_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        const key_map_t *k = &keys[i];
+
+        if (k->sym != sym) {
+            continue;
+        }
+        if (k->rel) {
+            if (down) {
+                emit(k->dev, EV_REL, REL_WHEEL, k->code);
+            }
+        } else if (!repeat) {
+            emit(k->dev, EV_KEY, k->code, down);
+        }
+        return;
+    }
+}
+
+static void poll_cb(lv_timer_t *t) {
+    SDL_Event e;
+
+    while (SDL_PollEvent(&e)) {
+        switch (e.type) {
+            case SDL_QUIT:
+                exit(0);
+                break;
+
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+                key(e.key.keysym.sym, e.type == SDL_KEYDOWN, e.key.repeat);
+                break;
+
+            case SDL_MOUSEWHEEL: {
+                SDL_Keymod  mod = SDL_GetModState();
+                sim_dev_t   dev = (mod & KMOD_CTRL) ? DEV_MFK : (mod & KMOD_SHIFT) ? DEV_VOL : DEV_VFO;
+
+                emit(dev, EV_REL, REL_WHEEL, e.wheel.y);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+void sim_sdl_input_start() {
+    for (uint8_t i = 0; i < DEV_LAST; i++) {
+        fds[i] = open(fifos[i], O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+        if (fds[i] < 0) {
+            LV_LOG_ERROR("Open %s: %s", fifos[i], strerror(errno));
+        }
+    }
+
+    lv_timer_create(poll_cb, POLL_MS, NULL);
+}
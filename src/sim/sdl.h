@@ -0,0 +1,45 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+#include <stdbool.h>
+
+/*
+ * Simulator display and input. The window shows the 800x480 screen. Keyboard and
+ * mouse wheel are written as evdev records to FIFOs, which are opened by the usual
+ * keypad, rotary and encoder drivers, so the input thread path is the same as on the radio.
+ *
+ *   F1-F5           F1-F5                   Wheel           VFO
+ *   1-6             GEN APP KEY MSG DFN DFL Shift+Wheel     VOL
+ *   L, P            LOCK, POWER             Ctrl+Wheel      MFK
+ *   Space           PTT                     Left, Right     VFO
+ *   PgDn, PgUp      Band down, up           -, =            VOL
+ *   A, C, S         AM, CW, SSB             Down, Up        MFK
+ *   B, R, T         A/B, PRE, ATU           Esc             VOL press
+ *   V, G, Q         V/M, AGC, FST           Enter           MFK press
+ */
+
+#define SIM_KEYPAD  "/tmp/x6100_sim_keypad"
+#define SIM_VFO     "/tmp/x6100_sim_vfo"
+#define SIM_VOL     "/tmp/x6100_sim_vol"
+#define SIM_MFK     "/tmp/x6100_sim_mfk"
+
+/**
+ * Open the window and create the input FIFOs, before the input drivers
+ */
+bool sim_sdl_init();
+
+/**
+ * Open the write side of the FIFOs and start polling SDL events, after the input drivers
+ */
+void sim_sdl_input_start();
+
+void sim_sdl_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
@@ -0,0 +1,170 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+/*
+ * aether_x6100_control for the simulator. Controls are accepted and ignored, the flow
+ * serves packets with IQ blocks of a capture (iq_capture.h format) at the flow rate,
+ * looped. Without the capture the blocks are silent.
+ *
+ * Control setters are called through casts by radio.c, so the header is not included
+ * here and the arguments only have to be ABI compatible
+ */
+
+#include <aether_radio/x6100_control/low/flow.h>
+#include <aether_radio/x6100_control/low/gpio.h>
+
+#include "lvgl/lvgl.h"
+
+#include "../iq_capture.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_IQ_PATH     "iq_replay.x6iq"
+#define SIM_SAMPLES     512             /* RADIO_SAMPLES, radio.h declares the controls */
+#define SIM_FLOW_RATE   100000
+#define SIM_FLOW_LAG_US 100000          /* Resync instead of a burst of late packets */
+
+static FILE             *iq_file = NULL;
+static uint64_t         next_us = 0;
+static atomic_bool      ptt = false;
+
+static uint64_t now_us() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+/* Control */
+
+bool x6100_control_init() {
+    return true;
+}
+
+void x6100_control_cmd(int cmd, uint32_t arg) {
+}
+
+void x6100_control_ptt_set(bool on) {
+    atomic_store(&ptt, on);
+}
+
+#define SIM_SET(name) void x6100_control_##name(uint32_t x) {}
+
+SIM_SET(agc_hang_set)       SIM_SET(agc_knee_set)       SIM_SET(agc_slope_set)
+SIM_SET(agc_time_set)       SIM_SET(atu_set)            SIM_SET(atu_tune)
+SIM_SET(bias_drive_set)     SIM_SET(bias_final_set)     SIM_SET(charger_set)
+SIM_SET(dnf_center_set)     SIM_SET(dnf_set)            SIM_SET(dnf_width_set)
+SIM_SET(hmic_set)           SIM_SET(iambic_mode_set)    SIM_SET(imic_set)
+SIM_SET(key_mode_set)       SIM_SET(key_ratio_set)      SIM_SET(key_speed_set)
+SIM_SET(key_tone_set)       SIM_SET(key_train_set)      SIM_SET(key_vol_set)
+SIM_SET(linein_set)         SIM_SET(lineout_set)        SIM_SET(mic_set)
+SIM_SET(modem_set)          SIM_SET(nb_level_set)       SIM_SET(nb_set)
+SIM_SET(nb_width_set)       SIM_SET(nr_level_set)       SIM_SET(nr_set)
+SIM_SET(qsk_time_set)       SIM_SET(record_set)         SIM_SET(rfg_set)
+SIM_SET(rxvol_set)          SIM_SET(split_set)          SIM_SET(spmode_set)
+SIM_SET(sql_set)            SIM_SET(swrscan_set)        SIM_SET(vfo_set)
+SIM_SET(vox_ag_set)         SIM_SET(vox_delay_set)      SIM_SET(vox_gain_set)
+SIM_SET(vox_set)
+
+void x6100_control_txpwr_set(float pwr) {
+}
+
+void x6100_control_vfo_agc_set(int vfo, uint32_t x) {}
+void x6100_control_vfo_att_set(int vfo, uint32_t x) {}
+void x6100_control_vfo_freq_set(int vfo, uint32_t x) {}
+void x6100_control_vfo_mode_set(int vfo, uint32_t x) {}
+void x6100_control_vfo_pre_set(int vfo, uint32_t x) {}
+
+void x6100_control_idle() {
+}
+
+void x6100_control_poweroff() {
+    exit(0);
+}
+
+/* GPIO */
+
+bool x6100_gpio_init() {
+    return true;
+}
+
+void x6100_gpio_set(x6100_pin_t pin, int value) {
+}
+
+/* Flow */
+
+bool x6100_flow_init() {
+    const char          *path = getenv("X6100_SIM_IQ");
+    iq_file_header_t    header;
+
+    iq_file = fopen(path ? path : SIM_IQ_PATH, "rb");
+
+    if (!iq_file) {
+        LV_LOG_WARN("No IQ capture, silent flow");
+    } else if (fread(&header, sizeof(header), 1, iq_file) != 1 ||
+               memcmp(header.magic, IQ_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        LV_LOG_ERROR("Unknown IQ file format");
+        fclose(iq_file);
+        iq_file = NULL;
+    }
+
+    next_us = now_us();
+
+    return true;
+}
+
+void x6100_flow_restart() {
+    next_us = now_us();
+}
+
+static void read_block(cfloat *samples) {
+    iq_file_record_t rec;
+
+    for (uint8_t retry = 0; retry < 2; retry++) {
+        if (fread(&rec, sizeof(rec), 1, iq_file) == 1 && rec.size <= SIM_SAMPLES &&
+            fread(samples, sizeof(cfloat), rec.size, iq_file) == rec.size)
+        {
+            return;
+        }
+        fseek(iq_file, sizeof(iq_file_header_t), SEEK_SET);
+    }
+}
+
+bool x6100_flow_read(x6100_flow_t *pack) {
+    uint64_t now = now_us();
+
+    if (now < next_us) {
+        return false;
+    }
+    if (now > next_us + SIM_FLOW_LAG_US) {
+        next_us = now;
+    }
+    next_us += (uint64_t) SIM_SAMPLES * 1000000 / SIM_FLOW_RATE;
+
+    cfloat *samples = (cfloat *) ((char *) pack + offsetof(x6100_flow_t, samples));
+
+    memset(pack, 0, sizeof(x6100_flow_t));
+
+    if (iq_file && !atomic_load(&ptt)) {
+        read_block(samples);
+    }
+
+    pack->flag.tx = atomic_load(&ptt);
+    pack->vext = 138;
+    pack->vbat = 82;
+    pack->batcap = 100;
+
+    return true;
+}
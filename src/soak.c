@@ -0,0 +1,438 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "soak.h"
+
+#include "cat_net.h"
+#include "cfg/band.h"
+#include "dialog.h"
+#include "iq_capture.h"
+#include "main_screen.h"
+#include "mem_pool.h"
+#include "mem_stats.h"
+#include "radio.h"
+#include "scheduler.h"
+#include "util.h"
+
+#include "lvgl/lvgl.h"
+
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define TICK_MS             1000
+#define ROW_S               60
+#define FRAME_BUCKET_US     250
+#define FRAME_BUCKETS       400         /* 100 ms */
+#define DECODE_BUCKET_MS    10
+#define DECODE_BUCKETS      500         /* 5 s */
+#define CAT_POLL_MS         250
+#define CAT_RETRY_S         60
+
+typedef enum {
+    STEP_APP = 0,       /* main_screen_start_app(), ACTION_NONE closes */
+    STEP_BAND,          /* cfg_band_load_next(), arg - up */
+} step_kind_t;
+
+typedef struct {
+    uint16_t    at_s;
+    step_kind_t kind;
+    int         arg;
+} step_t;
+
+/* Bands are switched with the dialogs closed, FT8 window tunes its own frequency */
+static const step_t steps[] = {
+    { 0,    STEP_APP,   ACTION_APP_FT8 },
+    { 420,  STEP_APP,   ACTION_NONE },
+    { 430,  STEP_APP,   ACTION_APP_SETTINGS },
+    { 460,  STEP_APP,   ACTION_APP_GPS },
+    { 480,  STEP_APP,   ACTION_APP_RECORDER },
+    { 500,  STEP_APP,   ACTION_NONE },
+    { 510,  STEP_BAND,  true },
+    { 540,  STEP_BAND,  true },
+    { 570,  STEP_BAND,  false },
+    { 590,  STEP_BAND,  false },
+};
+
+typedef struct {
+    float       rss_kb;
+    float       heap_kb;
+    float       heap_free_kb;
+    float       lvgl_kb;
+    float       ft8_kb;
+    float       scheduler_kb;
+    float       pool_kb;
+    float       frame_p99_us;
+    float       decode_p99_ms;
+} drift_row_t;
+
+static bool         enabled = false;
+static uint32_t     duration_s;
+static uint64_t     start_ms;
+static int64_t      last_s = -1;
+static uint32_t     rows = 0;
+static lv_timer_t   *timer = NULL;
+static bool         report_created = false;
+
+/* UI thread */
+static uint32_t     frame_hist[FRAME_BUCKETS];
+static uint32_t     frame_max_us;
+static uint32_t     prev_drops;
+static uint32_t     prev_malloc_args;
+static drift_row_t  first[SOAK_DRIFT_ROWS];
+static drift_row_t  last[SOAK_DRIFT_ROWS];
+
+/* Decode thread */
+static atomic_uint  decode_hist[DECODE_BUCKETS];
+
+/* CAT thread */
+static atomic_bool  cat_run = false;
+static atomic_uint  cat_polls;
+static atomic_uint  cat_errors;
+
+static uint32_t hist_pct(const uint32_t *hist, uint16_t buckets, uint32_t bucket, float pct, uint32_t *count) {
+    uint32_t total = 0;
+    uint32_t acc = 0;
+
+    for (uint16_t i = 0; i < buckets; i++) {
+        total += hist[i];
+    }
+    *count = total;
+
+    if (!total) {
+        return 0;
+    }
+
+    uint32_t target = (uint32_t) (total * pct);
+
+    for (uint16_t i = 0; i < buckets; i++) {
+        acc += hist[i];
+
+        if (acc > target) {
+            return (i + 1) * bucket;
+        }
+    }
+    return buckets * bucket;
+}
+
+/* CAT polling */
+
+static int cat_connect() {
+    struct sockaddr_in  addr;
+    struct timeval      tv = { .tv_sec = 1 };
+    int                 fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(CAT_NET_RIGCTL_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void * cat_thread(void *arg) {
+    static const char   *requests[] = { "f\n", "m\n" };
+    int                 fd = -1;
+    uint32_t            n = 0;
+    char                buf[128];
+
+    set_thread_name("soak_cat");
+
+    while (atomic_load(&cat_run)) {
+        if (fd < 0) {
+            fd = cat_connect();
+
+            if (fd < 0) {
+                LV_LOG_WARN("Soak: no network CAT on port %u, retry in %u s", CAT_NET_RIGCTL_PORT, CAT_RETRY_S);
+                sleep(CAT_RETRY_S);
+                continue;
+            }
+        }
+
+        const char *req = requests[n++ % 2];
+
+        if (send(fd, req, strlen(req), MSG_NOSIGNAL) < 0 || recv(fd, buf, sizeof(buf), 0) <= 0) {
+            atomic_fetch_add(&cat_errors, 1);
+            close(fd);
+            fd = -1;
+        } else {
+            atomic_fetch_add(&cat_polls, 1);
+        }
+        usleep(CAT_POLL_MS * 1000);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+/* Report */
+
+static void report_line(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void report_line(const char *fmt, ...) {
+    FILE    *f = fopen(SOAK_REPORT_PATH, report_created ? "a" : "w");
+    va_list args;
+
+    if (!f) {
+        return;
+    }
+    report_created = true;
+    va_start(args, fmt);
+    vfprintf(f, fmt, args);
+    va_end(args);
+    fclose(f);
+}
+
+static size_t rss_kb() {
+    FILE            *f = fopen("/proc/self/statm", "r");
+    unsigned long   size, resident = 0;
+
+    if (f) {
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void row() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2    mi = mallinfo2();
+#else
+    struct mallinfo     mi = mallinfo();
+#endif
+    mem_stats_t         lvgl, ft8, sched_mem;
+    mem_pool_stats_t    pool;
+    scheduler_stats_t   sched;
+    radio_cmd_stats_t   cmd;
+    uint32_t            decode[DECODE_BUCKETS];
+    uint32_t            frames, slots;
+    uint16_t            depth = 0;
+
+    mem_stats_get(MEM_LVGL, &lvgl);
+    mem_stats_get(MEM_FT8, &ft8);
+    mem_stats_get(MEM_SCHEDULER, &sched_mem);
+    mem_pool_stats(&pool);
+    scheduler_get_stats(&sched);
+    radio_cmd_stats(&cmd, false);
+
+    for (int i = 0; i < SCHEDULER_PRIO_LAST; i++) {
+        if (sched.lanes[i].depth_max > depth) {
+            depth = sched.lanes[i].depth_max;
+        }
+    }
+    for (int i = 0; i < DECODE_BUCKETS; i++) {
+        decode[i] = atomic_exchange(&decode_hist[i], 0);
+    }
+
+    uint32_t    frame_p99 = hist_pct(frame_hist, FRAME_BUCKETS, FRAME_BUCKET_US, 0.99f, &frames);
+    uint32_t    decode_p99 = hist_pct(decode, DECODE_BUCKETS, DECODE_BUCKET_MS, 0.99f, &slots);
+    drift_row_t r = {
+        .rss_kb = rss_kb(),
+        .heap_kb = get_heap_used() / 1024.0f,
+        .heap_free_kb = mi.fordblks / 1024.0f,
+        .lvgl_kb = lvgl.cur / 1024.0f,
+        .ft8_kb = ft8.cur / 1024.0f,
+        .scheduler_kb = sched_mem.cur / 1024.0f,
+        .pool_kb = pool.pages * MEM_POOL_PAGE / 1024.0f,
+        .frame_p99_us = frame_p99,
+        .decode_p99_ms = decode_p99,
+    };
+
+    report_line("%u,%.0f,%.0f,%.0f,%.1f,%.0f,%.0f,%.0f,%.0f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+                     rows + 1, r.rss_kb, r.heap_kb, r.heap_free_kb,
+                     mi.arena ? 100.0f * mi.fordblks / mi.arena : 0.0f,
+                     r.lvgl_kb, r.ft8_kb, r.scheduler_kb, r.pool_kb, pool.overflows,
+                     depth, sched.drops - prev_drops, sched.malloc_args - prev_malloc_args, cmd.depth,
+                     frames, frame_p99, frame_max_us, slots, decode_p99,
+                     atomic_exchange(&cat_polls, 0), atomic_exchange(&cat_errors, 0));
+
+    prev_drops = sched.drops;
+    prev_malloc_args = sched.malloc_args;
+    memset(frame_hist, 0, sizeof(frame_hist));
+    frame_max_us = 0;
+
+    if (rows < SOAK_DRIFT_ROWS) {
+        first[rows] = r;
+    }
+    last[rows % SOAK_DRIFT_ROWS] = r;
+    rows++;
+}
+
+static drift_row_t drift_mean(const drift_row_t *src, uint32_t n) {
+    drift_row_t mean = { 0 };
+
+    for (uint32_t i = 0; i < n; i++) {
+        mean.rss_kb += src[i].rss_kb / n;
+        mean.heap_kb += src[i].heap_kb / n;
+        mean.heap_free_kb += src[i].heap_free_kb / n;
+        mean.lvgl_kb += src[i].lvgl_kb / n;
+        mean.ft8_kb += src[i].ft8_kb / n;
+        mean.scheduler_kb += src[i].scheduler_kb / n;
+        mean.pool_kb += src[i].pool_kb / n;
+        mean.frame_p99_us += src[i].frame_p99_us / n;
+        mean.decode_p99_ms += src[i].decode_p99_ms / n;
+    }
+    return mean;
+}
+
+static void drift() {
+    if (rows < 2 * SOAK_DRIFT_ROWS) {
+        report_line("# drift: too short, %u rows\n", rows);
+        return;
+    }
+
+    drift_row_t a = drift_mean(first, SOAK_DRIFT_ROWS);
+    drift_row_t b = drift_mean(last, SOAK_DRIFT_ROWS);
+    float       hours = (rows - SOAK_DRIFT_ROWS) / 60.0f;
+
+    report_line("# drift over %.1f h, first %u min -> last %u min\n", hours, SOAK_DRIFT_ROWS, SOAK_DRIFT_ROWS);
+    report_line("# rss_kb %.0f -> %.0f (%+.1f/h)\n", a.rss_kb, b.rss_kb, (b.rss_kb - a.rss_kb) / hours);
+    report_line("# heap_kb %.0f -> %.0f (%+.1f/h)\n", a.heap_kb, b.heap_kb, (b.heap_kb - a.heap_kb) / hours);
+    report_line("# heap_free_kb %.0f -> %.0f\n", a.heap_free_kb, b.heap_free_kb);
+    report_line("# lvgl_kb %.0f -> %.0f\n", a.lvgl_kb, b.lvgl_kb);
+    report_line("# ft8_kb %.0f -> %.0f\n", a.ft8_kb, b.ft8_kb);
+    report_line("# scheduler_kb %.0f -> %.0f\n", a.scheduler_kb, b.scheduler_kb);
+    report_line("# pool_kb %.0f -> %.0f\n", a.pool_kb, b.pool_kb);
+    report_line("# frame_p99_us %.0f -> %.0f\n", a.frame_p99_us, b.frame_p99_us);
+    report_line("# decode_p99_ms %.0f -> %.0f\n", a.decode_p99_ms, b.decode_p99_ms);
+
+    LV_LOG_USER("Soak: done, RSS %.0f -> %.0f KiB, UI p99 %.0f -> %.0f us",
+                a.rss_kb, b.rss_kb, a.frame_p99_us, b.frame_p99_us);
+}
+
+/* Load */
+
+static void step(const step_t *s) {
+    switch (s->kind) {
+        case STEP_APP:
+            main_screen_start_app(s->arg);
+            break;
+
+        case STEP_BAND:
+            if (!dialog_is_run()) {
+                cfg_band_load_next(s->arg);
+            }
+            break;
+    }
+}
+
+static void tick_cb(lv_timer_t *t) {
+    int64_t now_s = (get_time() - start_ms) / 1000;
+
+    /* Seconds missed by a late tick are caught up */
+    for (int64_t s = last_s + 1; s <= now_s; s++) {
+        uint32_t at = s % SOAK_CYCLE_S;
+
+        for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+            if (steps[i].at_s == at) {
+                step(&steps[i]);
+            }
+        }
+        if (s && s % ROW_S == 0) {
+            row();
+        }
+    }
+    last_s = now_s;
+
+    if (now_s >= duration_s) {
+        main_screen_start_app(ACTION_NONE);
+        atomic_store(&cat_run, false);
+        drift();
+        lv_timer_del(timer);
+        timer = NULL;
+        enabled = false;
+    }
+}
+
+void soak_init() {
+    const char *env = getenv("X6100_SOAK");
+
+    if (!env || atof(env) <= 0.0) {
+        return;
+    }
+    duration_s = atof(env) * 3600;
+    start_ms = get_time();
+
+    time_t  now = time(NULL);
+    char    date[32];
+
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    report_line("# soak %.1f h from %s, replay %s\n", duration_s / 3600.0f, date,
+#if SIMULATOR
+                     "simulator"
+#else
+                     iq_replay_is_on() ? "on" : "off"
+#endif
+    );
+    report_line("minute,rss_kb,heap_kb,heap_free_kb,heap_free_pct,lvgl_kb,ft8_kb,scheduler_kb,pool_kb,"
+                     "pool_overflows,queue_depth_max,queue_drops,queue_malloc_args,radio_cmd_depth,"
+                     "frames,frame_p99_us,frame_max_us,ft8_slots,decode_p99_ms,cat_polls,cat_errors\n");
+
+    scheduler_stats_t sched;
+
+    scheduler_get_stats(&sched);
+    prev_drops = sched.drops;
+    prev_malloc_args = sched.malloc_args;
+
+    enabled = true;
+    atomic_store(&cat_run, true);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, cat_thread, NULL);
+    pthread_detach(thread);
+
+    timer = lv_timer_create(tick_cb, TICK_MS, NULL);
+    LV_LOG_USER("Soak: %.1f h, report to %s", duration_s / 3600.0f, SOAK_REPORT_PATH);
+}
+
+bool soak_enabled() {
+    return enabled;
+}
+
+void soak_loop(uint32_t lvgl_us) {
+    uint32_t i = lvgl_us / FRAME_BUCKET_US;
+
+    frame_hist[i < FRAME_BUCKETS ? i : FRAME_BUCKETS - 1]++;
+
+    if (lvgl_us > frame_max_us) {
+        frame_max_us = lvgl_us;
+    }
+}
+
+void soak_ft8_decode(uint32_t ms) {
+    if (!enabled) {
+        return;
+    }
+
+    uint32_t i = ms / DECODE_BUCKET_MS;
+
+    atomic_fetch_add_explicit(&decode_hist[i < DECODE_BUCKETS ? i : DECODE_BUCKETS - 1], 1, memory_order_relaxed);
+}
@@ -0,0 +1,67 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Long run soak test, enabled by X6100_SOAK=<hours>. Meant for a replayed flow
+ * (IQ_REPLAY_PATH on the device, X6100_SIM_IQ in the simulator). Every
+ * SOAK_CYCLE_S the FT8 window is kept open for its slots, then other dialogs
+ * are opened and closed and the band is switched up and back. The "soak_cat"
+ * thread polls frequency and mode over the rigctld port of the network CAT
+ * (cfg.cat_net) all the time.
+ *
+ * Once a minute a row goes to SOAK_REPORT_PATH:
+ * - RSS and the malloc heap, used and free
+ * - heap of the LVGL, FT8 and scheduler tags, and the small allocation pool
+ * - the scheduler queue high-water mark, drops and malloc'ed arguments, and the
+ *   pending radio commands
+ * - p99 and max of the LVGL phase of the UI loop
+ * - p99 of the FT8 slot end decode
+ * - CAT polls and errors
+ * The file is appended row by row, so a crash keeps the rows before it. At the
+ * end the drift is written: the mean of the last SOAK_DRIFT_ROWS rows against
+ * the first ones.
+ */
+
+#define SOAK_CYCLE_S        600
+#define SOAK_DRIFT_ROWS     10
+
+#if SIMULATOR
+#define SOAK_REPORT_PATH    "soak_report.csv"
+#else
+#define SOAK_REPORT_PATH    "/mnt/soak_report.csv"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read X6100_SOAK and start, call after the main screen and the radio are up
+ */
+void soak_init();
+
+bool soak_enabled();
+
+/**
+ * Duration of the LVGL phase of a UI loop iteration, called only while enabled
+ */
+void soak_loop(uint32_t lvgl_us);
+
+/**
+ * Duration of the decode at the end of an FT8/FT4 slot, called by the decode thread
+ */
+void soak_ft8_decode(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,10 +18,14 @@
 #include "rtty.h"
 #include "scheduler.h"
 #include "styles.h"
+#include "triple_buf.h"
 #include "util.h"
+#include "widgets/lv_spectrum.h"
+#include "occlusion.h"
 
-#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DEFAULT_MIN S4
 #define DEFAULT_MAX S9_20
@@ -29,11 +33,6 @@
 #define VISOR_HEIGHT_RX 100
 #define SPECTRUM_SIZE 800
 
-typedef struct {
-    float    val;
-    uint64_t time;
-} peak_t;
-
 static float grid_min = DEFAULT_MIN;
 static float grid_max = DEFAULT_MAX;
 
@@ -42,11 +41,23 @@ static lv_obj_t *obj;
 static int32_t width_hz     = 100000;
 static int16_t visor_height = 100;
 
-static float   spectrum_buf[SPECTRUM_SIZE];
-static peak_t  spectrum_peak[SPECTRUM_SIZE];
+typedef struct {
+    bool    tx;
+    bool    peak_valid;
+    float   data[SPECTRUM_SIZE];
+    float   peak[SPECTRUM_SIZE];   /* Peak hold is done by DSP, this is a copy */
+} spectrum_frame_t;
+
+/* Written by the radio thread, drawn in place by the UI */
+static triple_buf_t     frames;
+static spectrum_frame_t empty_frame;
+static atomic_bool      cleared = true;    /* Empty frame is drawn until a new one */
+static const spectrum_frame_t *shown_frame = NULL;  /* Last drawn one, UI thread */
+
 static uint8_t zoom_factor = 1;
 
-static bool spectrum_tx = false;
+/* Fully covered by a dialog: data is kept, nothing is drawn */
+static atomic_bool covered = false;
 
 static int32_t filter_from = 0;
 static int32_t filter_to   = 3000;
@@ -62,8 +73,6 @@ static int16_t freq_mod;
 
 
 
-static pthread_mutex_t data_mux;
-
 static void on_zoom_changed(Subject *subj, void *user_data);
 static void on_real_filter_from_change(Subject *subj, void *user_data);
 static void on_real_filter_to_change(Subject *subj, void *user_data);
@@ -78,32 +87,14 @@ static void spectrum_draw_cb(lv_event_t *e) {
     lv_obj_t          *obj      = lv_event_get_target(e);
     lv_draw_ctx_t     *draw_ctx = lv_event_get_draw_ctx(e);
     lv_draw_line_dsc_t main_line_dsc;
-    lv_draw_line_dsc_t peak_line_dsc;
-
-    if (!spectrum_buf) {
-        return;
-    }
-    float min, max;
-    if (spectrum_tx) {
-        min = DEFAULT_MIN;
-        max = DEFAULT_MAX;
-    } else {
-        min = grid_min;
-        max = grid_max;
-    }
 
-    /* Lines */
+    /* Trace is rasterized by lv_spectrum, only overlays are drawn here */
 
     lv_draw_line_dsc_init(&main_line_dsc);
 
     main_line_dsc.color = lv_color_hex(0xAAAAAA);
     main_line_dsc.width = 1;
 
-    lv_draw_line_dsc_init(&peak_line_dsc);
-
-    peak_line_dsc.color = lv_color_hex(0x555555);
-    peak_line_dsc.width = 1;
-
     lv_coord_t x1 = obj->coords.x1;
     lv_coord_t y1 = obj->coords.y1;
 
@@ -113,49 +104,6 @@ static void spectrum_draw_cb(lv_event_t *e) {
     x1 += lo_offset * zoom_factor * w / width_hz;
 
     lv_point_t main_a, main_b;
-    lv_point_t peak_a, peak_b;
-
-    if (!params.spectrum_filled) {
-        main_b.x = x1;
-        main_b.y = y1 + h;
-    }
-
-    peak_b.x = x1;
-    peak_b.y = y1 + h;
-
-    for (uint16_t i = 0; i < SPECTRUM_SIZE; i++) {
-        float    v = (spectrum_buf[i] - min) / (max - min);
-        uint16_t x = i * w / SPECTRUM_SIZE;
-
-        /* Peak */
-
-        if (params.spectrum_peak && !spectrum_tx) {
-            float v_peak = (spectrum_peak[i].val - min) / (max - min);
-
-            peak_a.x = x1 + x;
-            peak_a.y = y1 + (1.0f - v_peak) * h;
-
-            lv_draw_line(draw_ctx, &peak_line_dsc, &peak_a, &peak_b);
-
-            peak_b = peak_a;
-        }
-
-        /* Main */
-
-        main_a.x = x1 + x;
-        main_a.y = y1 + (1.0f - v) * h;
-
-        if (params.spectrum_filled) {
-            main_b.x = main_a.x;
-            main_b.y = y1 + h;
-        }
-
-        lv_draw_line(draw_ctx, &main_line_dsc, &main_a, &main_b);
-
-        if (!params.spectrum_filled) {
-            main_b = main_a;
-        }
-    }
 
     /* Filter */
 
@@ -255,22 +203,95 @@ static void rx_cb(lv_event_t *e) {
     visor_height = VISOR_HEIGHT_RX;
 }
 
+/* Everything drawn by spectrum_draw_cb on top of the trace */
+typedef struct {
+    int32_t         filter_from;
+    int32_t         filter_to;
+    int32_t         dnf_enabled;
+    int32_t         dnf_center;
+    int32_t         dnf_width;
+    int16_t         visor_height;
+    int32_t         lo_offset;
+    uint8_t         zoom_factor;
+    x6100_mode_t    mode;
+    bool            rtty;
+    uint16_t        rtty_center;
+    uint16_t        rtty_shift;
+    bool            recorder;
+} overlay_state_t;
+
+static bool overlay_changed() {
+    static overlay_state_t prev;
+
+    overlay_state_t cur;
+
+    memset(&cur, 0, sizeof(cur));
+    cur.filter_from = filter_from;
+    cur.filter_to = filter_to;
+    cur.dnf_enabled = dnf_enabled;
+    cur.dnf_center = dnf_center;
+    cur.dnf_width = dnf_width;
+    cur.visor_height = visor_height;
+    cur.lo_offset = lo_offset;
+    cur.zoom_factor = zoom_factor;
+    cur.mode = cur_mode;
+    cur.rtty = rtty_get_state() != RTTY_OFF;
+    cur.rtty_center = params.rtty_center;
+    cur.rtty_shift = params.rtty_shift;
+    cur.recorder = recorder_is_on();
+
+    if (memcmp(&cur, &prev, sizeof(cur)) == 0) {
+        return false;
+    }
+    prev = cur;
+    return true;
+}
+
 static void spectrum_refresh(void *data) {
-    lv_obj_invalidate(obj);
+    float min, max;
+    bool  with_peak;
+    bool  fresh;
+
+    const spectrum_frame_t *frame = triple_buf_read(frames, &fresh);
+
+    if (fresh) {
+        atomic_store(&cleared, false);
+    } else if (atomic_load(&cleared)) {
+        frame = &empty_frame;
+    }
+    shown_frame = (frame == &empty_frame) ? NULL : frame;
+
+    if (frame->tx) {
+        min = DEFAULT_MIN;
+        max = DEFAULT_MAX;
+    } else {
+        min = grid_min;
+        max = grid_max;
+    }
+    with_peak = params.spectrum_peak && !frame->tx && frame->peak_valid;
+
+    lv_coord_t x_offset = lo_offset * zoom_factor * lv_obj_get_width(obj) / width_hz;
+
+    if (overlay_changed()) {
+        lv_spectrum_invalidate_all(obj);
+    }
+    lv_spectrum_set_filled(obj, params.spectrum_filled);
+    lv_spectrum_set_data(obj, frame->data, with_peak ? frame->peak : NULL, SPECTRUM_SIZE, min, max, x_offset);
 }
 
 lv_obj_t *spectrum_init(lv_obj_t *parent) {
-    pthread_mutex_init(&data_mux, NULL);
+    frames = triple_buf_create(sizeof(spectrum_frame_t));
     spectrum_min_max_reset();
 
     for (size_t i = 0; i < SPECTRUM_SIZE; i++) {
-        spectrum_peak[i].val = S_MIN;
-        spectrum_buf[i] = S_MIN;
+        empty_frame.data[i] = S_MIN;
+        empty_frame.peak[i] = S_MIN;
     }
 
-    obj = lv_obj_create(parent);
+    obj = lv_spectrum_create(parent);
 
     lv_obj_add_style(obj, &spectrum_style, 0);
+    lv_spectrum_set_colors(obj, lv_color_hex(0xAAAAAA), lv_color_hex(0x555555));
     lv_obj_add_event_cb(obj, spectrum_draw_cb, LV_EVENT_DRAW_MAIN_END, NULL);
     lv_obj_add_event_cb(obj, tx_cb, EVENT_RADIO_TX, NULL);
     lv_obj_add_event_cb(obj, rx_cb, EVENT_RADIO_RX, NULL);
@@ -291,31 +312,44 @@ lv_obj_t *spectrum_init(lv_obj_t *parent) {
     return obj;
 }
 
-void spectrum_data(float *data_buf, uint16_t size, bool tx) {
-    uint64_t now = get_time();
-
-    pthread_mutex_lock(&data_mux);
-    spectrum_tx = tx;
-    for (uint16_t i = 0; i < size; i++) {
-        spectrum_buf[i] = data_buf[i];
-
-        if (params.spectrum_peak && !tx) {
-            float   v    = spectrum_buf[i];
-            peak_t *peak = &spectrum_peak[i];
-
-            if (v > peak->val) {
-                peak->time = now;
-                peak->val  = v;
-            } else {
-                if (now - peak->time > params.spectrum_peak_hold) {
-                    peak->val -= params.spectrum_peak_speed;
-                }
-            }
-        }
+void spectrum_data(const float *data_buf, const float *peak_buf, uint16_t size, bool tx) {
+    if (!frames) {
+        return;
+    }
+    if (size > SPECTRUM_SIZE) {
+        size = SPECTRUM_SIZE;
+    }
+
+    spectrum_frame_t *frame = triple_buf_back(frames);
+
+    frame->tx = tx;
+    memcpy(frame->data, data_buf, size * sizeof(float));
+    if (peak_buf) {
+        memcpy(frame->peak, peak_buf, size * sizeof(float));
     }
+    for (uint16_t i = size; i < SPECTRUM_SIZE; i++) {
+        frame->data[i] = S_MIN;
+        frame->peak[i] = S_MIN;
+    }
+    frame->peak_valid = peak_buf != NULL;
+    triple_buf_publish(frames);
+
+    if (!atomic_load(&covered)) {
+        scheduler_put_coalesced(SCHEDULER_KEY_SPECTRUM, spectrum_refresh, NULL, 0);
+    }
+}
+
+void spectrum_set_occluder(const lv_area_t *area) {
+    lv_area_t   visible;
+    bool        now_covered = !occlusion_visible_area(&obj->coords, area, &visible);
+    bool        was_covered = atomic_exchange(&covered, now_covered);
 
-    pthread_mutex_unlock(&data_mux);
-    scheduler_put_noargs(spectrum_refresh);
+    lv_spectrum_set_visible_area(obj, area ? &visible : NULL);
+
+    if (was_covered && !now_covered) {
+        lv_spectrum_invalidate_all(obj);
+        spectrum_refresh(NULL);
+    }
 }
 
 void spectrum_min_max_reset() {
@@ -335,8 +369,37 @@ float spectrum_get_min() {
     return grid_min;
 }
 
-void spectrum_update_max(float db) {
+void spectrum_get_range(float *min, float *max) {
+    *min = grid_min;
+    *max = grid_max;
+}
+
+void spectrum_set_auto_range(float min, float max) {
+    if (params.spectrum_auto_min.x) {
+        grid_min = min;
+    }
     if (params.spectrum_auto_max.x) {
+        grid_max = max;
+    }
+}
+
+bool spectrum_last(float *data, uint16_t size) {
+    if (!shown_frame || shown_frame->tx) {
+        return false;
+    }
+    if (size > SPECTRUM_SIZE) {
+        size = SPECTRUM_SIZE;
+    }
+    memcpy(data, shown_frame->data, size * sizeof(float));
+    return true;
+}
+
+void spectrum_update_max(float db) {
+    params_view_t pv;
+
+    params_view_get(&pv);
+
+    if (pv.spectrum_auto_max) {
         lpf(&grid_max, db + 10.0f, 0.55f, DEFAULT_MAX);
     } else {
         // TODO: set min/max at param change
@@ -345,7 +408,11 @@ void spectrum_update_max(float db) {
 }
 
 void spectrum_update_min(float db) {
-    if (params.spectrum_auto_min.x) {
+    params_view_t pv;
+
+    params_view_get(&pv);
+
+    if (pv.spectrum_auto_min) {
         lpf(&grid_min, db + 3.0f, 0.75f, DEFAULT_MIN);
     } else {
         grid_min = subject_get_int(cfg_cur.band->grid.min.val);
@@ -355,13 +422,9 @@ void spectrum_update_min(float db) {
 void spectrum_clear() {
     spectrum_min_max_reset();
     freq_mod = 0;
-    uint64_t now = get_time();
 
-    for (uint16_t i = 0; i < SPECTRUM_SIZE; i++) {
-        spectrum_buf[i]       = S_MIN;
-        spectrum_peak[i].val  = S_MIN;
-        spectrum_peak[i].time = now;
-    }
+    atomic_store(&cleared, true);
+    dsp_spectrum_peak_reset();
 }
 
 static void on_zoom_changed(Subject *subj, void *user_data) {
@@ -404,7 +467,6 @@ void on_cur_freq_change(Subject *subj, void *user_data) {
     if (cur_freq != new_freq) {
         int32_t df = new_freq - cur_freq + freq_mod;
         cur_freq = new_freq;
-        uint64_t time = get_time();
 
         uint16_t div     = width_hz / SPECTRUM_SIZE / zoom_factor;
         int32_t  delta   = (df + div / 2) / div;
@@ -413,17 +475,6 @@ void on_cur_freq_change(Subject *subj, void *user_data) {
         if (delta == 0) {
             return;
         }
-        peak_t  *to;
-        for (int16_t i = 0; i < SPECTRUM_SIZE; i++) {
-            int16_t dst_id = delta > 0 ? i : SPECTRUM_SIZE - i - 1;
-            to = &spectrum_peak[dst_id];
-            int16_t src_id = dst_id + delta;
-            if ((src_id < 0) || (src_id >= SPECTRUM_SIZE)) {
-                to->val = S_MIN;
-                to->time = time;
-            } else {
-                *to = spectrum_peak[src_id];
-            }
-        }
+        dsp_spectrum_peak_shift(delta);
     }
 }
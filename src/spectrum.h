@@ -14,12 +14,32 @@
 #include "lvgl/lvgl.h"
 
 lv_obj_t * spectrum_init(lv_obj_t * parent);
-void spectrum_data(float *data_buf, uint16_t size, bool tx);
+/**
+ * New spectrum and peak (NULL if peaks are off) from DSP
+ */
+void spectrum_data(const float *data_buf, const float *peak_buf, uint16_t size, bool tx);
 void spectrum_min_max_reset();
 
 float spectrum_get_min();
+void spectrum_get_range(float *min, float *max);
+
+/**
+ * Set the sides of the grid range which are auto (params), for a restored state
+ */
+void spectrum_set_auto_range(float min, float max);
+
+/**
+ * Copy of the last drawn RX spectrum, dB. False if nothing is drawn yet or it's TX. UI thread
+ */
+bool spectrum_last(float *data, uint16_t size);
 void spectrum_update_max(float db);
 void spectrum_update_min(float db);
 void spectrum_clear();
+
+/**
+ * Opaque area on top of the spectrum (NULL - none). Only the visible part is
+ * invalidated, while fully covered new data is kept but not drawn
+ */
+void spectrum_set_occluder(const lv_area_t *area);
 // void spectrum_update_filters();
 // void spectrum_update_factor();
@@ -0,0 +1,207 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "spectrum_hires.h"
+
+#include "util.h"
+#include "cfg/subjects.h"
+#include "dsp/spgram.h"
+
+#include <atomic>
+
+extern "C" {
+    #include "lvgl/lvgl.h"
+    #include "cfg/cfg.h"
+    #include "radio.h"
+    #include "ring.h"
+
+    #include <pthread.h>
+    #include <semaphore.h>
+    #include <string.h>
+}
+
+#define RING_BLOCKS     64          // ~330 ms of flow
+
+typedef struct {
+    uint32_t    gen;
+    uint16_t    size;
+    cfloat      samples[RADIO_SAMPLES];
+} hires_block_t;
+
+const int32_t                   spectrum_hires_sizes[SPECTRUM_HIRES_SIZES] = { 0, 4096, 8192 };
+
+static ring_t                   ring = NULL;
+static sem_t                    sem;
+static std::atomic<int32_t>     nfft_req{0};
+static std::atomic<uint32_t>    gen{1};
+
+/* Last frame */
+static pthread_mutex_t          frame_mux = PTHREAD_MUTEX_INITIALIZER;
+static float                    frame_psd[SPECTRUM_HIRES_MAX];
+static uint16_t                 frame_size = 0;
+static uint32_t                 frame_gen = 0;
+static uint32_t                 frame_seq = 0;
+
+/* Worker */
+static ChunkedSpgram            *sg = NULL;
+static size_t                   nfft = 0;
+static cfloat                   window[SPECTRUM_HIRES_MAX];
+static size_t                   fill = 0;
+static uint32_t                 cur_gen = 0;
+static float                    psd[SPECTRUM_HIRES_MAX];
+
+static void setup(size_t size) {
+    delete sg;
+    sg = NULL;
+    nfft = size;
+    fill = 0;
+
+    if (nfft) {
+        // Whole window per transform, overlap is of the window buffer
+        sg = new ChunkedSpgram(nfft, nfft, nfft);
+    }
+}
+
+static void put_samples(const cfloat *samples, size_t size) {
+    while (size) {
+        size_t n = nfft - fill;
+
+        if (n > size) {
+            n = size;
+        }
+        memcpy(window + fill, samples, n * sizeof(cfloat));
+        fill += n;
+        samples += n;
+        size -= n;
+
+        if (fill == nfft) {
+            sg->execute_block(window);
+
+            // 50% overlap
+            memcpy(window, window + nfft / 2, nfft / 2 * sizeof(cfloat));
+            fill = nfft / 2;
+        }
+    }
+}
+
+static void publish() {
+    sg->get_psd(psd);
+
+    pthread_mutex_lock(&frame_mux);
+
+    for (size_t i = 0; i < nfft; i++) {
+        // Same offset as the waterfall
+        frame_psd[i] = psd[i] - 30.0f;
+    }
+    frame_size = nfft;
+    frame_gen = cur_gen;
+
+    if (++frame_seq == 0) {
+        frame_seq = 1;
+    }
+
+    pthread_mutex_unlock(&frame_mux);
+}
+
+static void * worker(void *arg) {
+    uint64_t        frame_time = 0;
+    hires_block_t   *block;
+
+    set_thread_name("spectrum_hires");
+
+    while (true) {
+        sem_wait(&sem);
+
+        size_t req = nfft_req.load();
+
+        if (req != nfft) {
+            setup(req);
+        }
+
+        while ((block = (hires_block_t *)ring_peek(ring))) {
+            if (sg) {
+                if (block->gen != cur_gen) {
+                    cur_gen = block->gen;
+                    fill = 0;
+                    sg->reset();
+                }
+                put_samples(block->samples, block->size);
+            }
+            ring_release(ring);
+        }
+
+        uint64_t now = get_time();
+
+        if (sg && sg->get_num_transforms() && now - frame_time >= SPECTRUM_HIRES_PERIOD_MS) {
+            publish();
+            frame_time = now;
+        }
+    }
+    return NULL;
+}
+
+static void on_size_change(Subject *subj, void *user_data) {
+    int32_t size = subject_get_int(subj);
+
+    if (size != 4096 && size != 8192) {
+        size = 0;
+    }
+    nfft_req = size;
+    sem_post(&sem);
+}
+
+void spectrum_hires_init() {
+    ring = ring_create(sizeof(hires_block_t), RING_BLOCKS);
+    sem_init(&sem, 0, 0);
+
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, worker, NULL);
+    pthread_detach(thread);
+
+    cfg.spectrum_hires.val->subscribe(on_size_change)->notify();
+}
+
+bool spectrum_hires_enabled() {
+    return ring && nfft_req.load(std::memory_order_relaxed);
+}
+
+void spectrum_hires_put(const cfloat *samples, uint16_t size) {
+    hires_block_t *block = (hires_block_t *)ring_reserve(ring);
+
+    if (!block) {
+        return;
+    }
+    block->gen = gen.load(std::memory_order_relaxed);
+    block->size = size;
+    memcpy(block->samples, samples, size * sizeof(cfloat));
+    ring_commit(ring);
+    sem_post(&sem);
+}
+
+void spectrum_hires_retune() {
+    gen++;
+}
+
+uint32_t spectrum_hires_read(uint32_t seq, float *dst, uint16_t *size) {
+    uint32_t res = 0;
+
+    pthread_mutex_lock(&frame_mux);
+
+    if (frame_seq && frame_gen == gen.load() && frame_size == nfft_req.load()) {
+        res = frame_seq;
+
+        if (frame_seq != seq) {
+            memcpy(dst, frame_psd, frame_size * sizeof(float));
+            *size = frame_size;
+        }
+    }
+
+    pthread_mutex_unlock(&frame_mux);
+    return res;
+}
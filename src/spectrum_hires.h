@@ -0,0 +1,57 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "helpers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * High resolution PSD of the RX flow, 4096 or 8192 bins. The DSP passes RX
+ * blocks through a ring, a worker on the UI core runs the FFT with 50%
+ * overlap and publishes an averaged dB frame every SPECTRUM_HIRES_PERIOD_MS.
+ * Frames are of the same scale as the waterfall PSD. Retune drops the
+ * buffered samples, frames older than it are not returned.
+ */
+
+#define SPECTRUM_HIRES_MAX          8192
+#define SPECTRUM_HIRES_PERIOD_MS    200
+#define SPECTRUM_HIRES_SIZES        3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* FFT sizes of the setting, 0 is off */
+extern const int32_t spectrum_hires_sizes[SPECTRUM_HIRES_SIZES];
+
+void spectrum_hires_init();
+
+bool spectrum_hires_enabled();
+
+/**
+ * RX samples, DSP thread. Never blocks, drops the block if the worker is behind
+ */
+void spectrum_hires_put(const cfloat *samples, uint16_t size);
+
+/**
+ * Samples and frames before it are of other freq. DSP thread
+ */
+void spectrum_hires_retune();
+
+/**
+ * Copy the last frame if it is newer than seq. Returns its seq, 0 if there is no frame
+ * of the current freq
+ */
+uint32_t spectrum_hires_read(uint32_t seq, float *psd, uint16_t *size);
+
+#ifdef __cplusplus
+}
+#endif
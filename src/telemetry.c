@@ -0,0 +1,172 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "telemetry.h"
+
+#include "util.h"
+#include "lvgl/lvgl.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define RAW_SIZE    1024        /* About 5 s of packets */
+
+typedef struct {
+    uint32_t            period;     /* ms */
+    uint32_t            size;
+    telemetry_bucket_t  *buckets;
+
+    /* Published, seq is odd while a bucket is written */
+    atomic_uint         seq;
+    uint32_t            head;
+
+    /* Writer only */
+    telemetry_bucket_t  cur;
+    telemetry_sample_t  sum;
+} level_t;
+
+static telemetry_sample_t   raw[RAW_SIZE];
+static atomic_uint          raw_head = 0;
+
+static telemetry_bucket_t   buckets_100ms[600];     /* 1 min */
+static telemetry_bucket_t   buckets_1s[600];        /* 10 min */
+static telemetry_bucket_t   buckets_1min[240];      /* 4 h */
+
+static level_t levels[TELEMETRY_LEVELS] = {
+    [TELEMETRY_100MS]   = { .period = 100,      .size = 600, .buckets = buckets_100ms },
+    [TELEMETRY_1S]      = { .period = 1000,     .size = 600, .buckets = buckets_1s },
+    [TELEMETRY_1MIN]    = { .period = 60000,    .size = 240, .buckets = buckets_1min },
+};
+
+static void level_close(level_t *level) {
+    telemetry_bucket_t  *cur = &level->cur;
+    float               n = cur->count;
+
+    cur->mean.pwr = level->sum.pwr / n;
+    cur->mean.vswr = level->sum.vswr / n;
+    cur->mean.alc = level->sum.alc / n;
+
+    unsigned seq = atomic_load_explicit(&level->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&level->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    level->buckets[level->head % level->size] = *cur;
+    level->head++;
+
+    atomic_store_explicit(&level->seq, seq + 2, memory_order_release);
+
+    cur->count = 0;
+}
+
+static void level_put(level_t *level, const telemetry_sample_t *sample, uint64_t now) {
+    telemetry_bucket_t *cur = &level->cur;
+
+    if (cur->count && now >= cur->time + level->period) {
+        level_close(level);
+    }
+
+    if (cur->count == 0) {
+        cur->time = now - now % level->period;
+        cur->min = *sample;
+        cur->max = *sample;
+        memset(&level->sum, 0, sizeof(level->sum));
+    } else {
+        cur->min.pwr = LV_MIN(cur->min.pwr, sample->pwr);
+        cur->min.vswr = LV_MIN(cur->min.vswr, sample->vswr);
+        cur->min.alc = LV_MIN(cur->min.alc, sample->alc);
+        cur->max.pwr = LV_MAX(cur->max.pwr, sample->pwr);
+        cur->max.vswr = LV_MAX(cur->max.vswr, sample->vswr);
+        cur->max.alc = LV_MAX(cur->max.alc, sample->alc);
+    }
+
+    level->sum.pwr += sample->pwr;
+    level->sum.vswr += sample->vswr;
+    level->sum.alc += sample->alc;
+    cur->count++;
+}
+
+void telemetry_put(float pwr, float vswr, float alc) {
+    telemetry_sample_t  sample = { .pwr = pwr, .vswr = vswr, .alc = alc };
+    unsigned            head = atomic_load_explicit(&raw_head, memory_order_relaxed);
+
+    raw[head % RAW_SIZE] = sample;
+    atomic_store_explicit(&raw_head, head + 1, memory_order_release);
+
+    uint64_t now = get_time();
+
+    for (uint8_t i = 0; i < TELEMETRY_LEVELS; i++) {
+        level_put(&levels[i], &sample, now);
+    }
+}
+
+uint32_t telemetry_position() {
+    return atomic_load_explicit(&raw_head, memory_order_acquire);
+}
+
+size_t telemetry_read(uint32_t *cursor, telemetry_sample_t *samples, size_t max) {
+    uint32_t head = atomic_load_explicit(&raw_head, memory_order_acquire);
+    uint32_t pos = *cursor;
+
+    /* The slot after the head can be in the middle of a write */
+    if (head - pos > RAW_SIZE - 1) {
+        pos = head - (RAW_SIZE - 1);
+    }
+
+    uint32_t count = LV_MIN(head - pos, max);
+
+    for (uint32_t i = 0; i < count; i++) {
+        samples[i] = raw[(pos + i) % RAW_SIZE];
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+
+    /* Drop samples overwritten while copying */
+    uint32_t oldest = atomic_load_explicit(&raw_head, memory_order_relaxed) - (RAW_SIZE - 1);
+    int32_t  lost = oldest - pos;
+
+    if (lost > 0) {
+        if (lost >= count) {
+            *cursor = oldest;
+            return 0;
+        }
+        count -= lost;
+        memmove(samples, samples + lost, count * sizeof(telemetry_sample_t));
+        pos = oldest;
+    }
+
+    *cursor = pos + count;
+
+    return count;
+}
+
+size_t telemetry_history(telemetry_level_t level, telemetry_bucket_t *buckets, size_t max) {
+    level_t     *l = &levels[level];
+    uint32_t    count;
+    unsigned    seq;
+
+    do {
+        seq = atomic_load_explicit(&l->seq, memory_order_acquire);
+
+        if (seq & 1) {
+            continue;
+        }
+
+        uint32_t head = l->head;
+
+        count = LV_MIN(LV_MIN(head, l->size), max);
+
+        for (uint32_t i = 0; i < count; i++) {
+            buckets[i] = l->buckets[(head - count + i) % l->size];
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || atomic_load_explicit(&l->seq, memory_order_relaxed) != seq);
+
+    return count;
+}
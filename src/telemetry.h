@@ -0,0 +1,69 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * TX telemetry (power, SWR, ALC) of every flow packet. The radio thread writes
+ * without locks, readers take what they need at their own rate: latest raw
+ * samples by a cursor, or min/max/mean history per 100 ms, 1 s and 1 min.
+ * Old data is overwritten, a slow reader only loses the oldest samples.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float   pwr;
+    float   vswr;
+    float   alc;
+} telemetry_sample_t;
+
+typedef struct {
+    uint64_t            time;       /* ms, start of the bucket */
+    uint32_t            count;
+    telemetry_sample_t  min;
+    telemetry_sample_t  max;
+    telemetry_sample_t  mean;
+} telemetry_bucket_t;
+
+typedef enum {
+    TELEMETRY_100MS = 0,
+    TELEMETRY_1S,
+    TELEMETRY_1MIN,
+
+    TELEMETRY_LEVELS
+} telemetry_level_t;
+
+/**
+ * Store a sample, called by the radio thread for each TX packet
+ */
+void telemetry_put(float pwr, float vswr, float alc);
+
+/**
+ * Position of the next sample, a reader starts with it to skip the old ones
+ */
+uint32_t telemetry_position();
+
+/**
+ * Copy up to max samples stored since cursor and move it. Returns count of copied
+ */
+size_t telemetry_read(uint32_t *cursor, telemetry_sample_t *samples, size_t max);
+
+/**
+ * Copy up to max latest complete buckets of level, oldest first. Returns count of copied
+ */
+size_t telemetry_history(telemetry_level_t level, telemetry_bucket_t *buckets, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,199 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#define _GNU_SOURCE
+
+#include "threads.h"
+
+#include "util.h"
+#include "rt_mem.h"
+#include "lvgl/lvgl.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define MAX_POLICIES    32
+
+typedef enum {
+    SCHED_KIND_OTHER = 0,
+    SCHED_KIND_FIFO
+} sched_kind_t;
+
+typedef struct {
+    char            name[16];
+    sched_kind_t    sched;
+    int8_t          prio;           /* FIFO priority or nice level */
+    int8_t          cpu;            /* -1 for any */
+} thread_policy_t;
+
+/*
+ * Dual core A7: flow reading, control link and DSP on core 1, UI on core 0.
+ * Keying and IQ delivery are real-time, background work only gets idle time
+ */
+static thread_policy_t policies[MAX_POLICIES] = {
+    { "ui",             SCHED_KIND_OTHER,   0,  0 },
+    { "input",          SCHED_KIND_OTHER,   -5, 0 },
+    { "radio",          SCHED_KIND_FIFO,    50, 1 },
+    { "radio_cmd",      SCHED_KIND_FIFO,    45, 1 },
+    { "cw_encoder",     SCHED_KIND_FIFO,    40, -1 },
+    { "dsp",            SCHED_KIND_FIFO,    20, 1 },
+    { "audio_capture",  SCHED_KIND_FIFO,    25, -1 },
+    { "audio",          SCHED_KIND_FIFO,    20, -1 },
+    { "cat",            SCHED_KIND_OTHER,   -5, -1 },
+    { "cat_net",        SCHED_KIND_OTHER,   0,  -1 },
+    { "pan_stream",     SCHED_KIND_OTHER,   5,  -1 },
+    { "audio_stream",   SCHED_KIND_OTHER,   0,  -1 },
+    { "iq_server",      SCHED_KIND_OTHER,   5,  -1 },
+    { "dx_cluster",     SCHED_KIND_OTHER,   10, -1 },
+    { "psk_reporter",   SCHED_KIND_OTHER,   19, -1 },
+    { "band_activity",  SCHED_KIND_OTHER,   19, -1 },
+    { "qso_log",        SCHED_KIND_OTHER,   10, -1 },
+    { "voice",          SCHED_KIND_OTHER,   0,  -1 },
+    { "msg_voice",      SCHED_KIND_OTHER,   0,  -1 },
+    { "rec_play",       SCHED_KIND_OTHER,   0,  -1 },
+    { "rec_encode",     SCHED_KIND_OTHER,   15, -1 },
+    { "waterfall",      SCHED_KIND_OTHER,   0,  0 },
+    { "spectrum_hires", SCHED_KIND_OTHER,   10, 0 },
+    { "iq_capture",     SCHED_KIND_OTHER,   0,  -1 },
+    { "iq_replay",      SCHED_KIND_OTHER,   0,  -1 },
+    { "ft8",            SCHED_KIND_OTHER,   10, -1 },
+    { "ft8_decode",     SCHED_KIND_OTHER,   10, -1 },
+    { "cw_skimmer",     SCHED_KIND_OTHER,   10, -1 },
+    { "gps",            SCHED_KIND_OTHER,   5,  -1 },
+    { "wifi",           SCHED_KIND_OTHER,   10, -1 },
+    { "params",         SCHED_KIND_OTHER,   5,  -1 },
+    { "cfg_save",       SCHED_KIND_OTHER,   5,  -1 },
+    { "cfg_prefetch",   SCHED_KIND_OTHER,   10, -1 },
+    { "screenshot",     SCHED_KIND_OTHER,   19, -1 },
+    { "adif_import",    SCHED_KIND_OTHER,   19, -1 },
+    { "adif_export",    SCHED_KIND_OTHER,   19, -1 },
+    { "logger",         SCHED_KIND_OTHER,   19, -1 },
+    { "metrics",        SCHED_KIND_OTHER,   19, -1 },
+    { "soak_cat",       SCHED_KIND_OTHER,   19, -1 },
+};
+
+static uint8_t          policies_count = 0;
+static pthread_once_t   init_once = PTHREAD_ONCE_INIT;
+
+static thread_policy_t * policy_find(const char *name) {
+    for (uint8_t i = 0; i < policies_count; i++) {
+        if (strcmp(policies[i].name, name) == 0) {
+            return &policies[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * One X6100_THREADS entry: name=fifo:PRIO[@CPU], name=nice:N[@CPU] or name=other[@CPU]
+ */
+static void parse_entry(char *entry) {
+    char *value = strchr(entry, '=');
+
+    if (!value || value == entry || value - entry >= (long) sizeof(policies[0].name)) {
+        LV_LOG_WARN("Wrong thread policy: %s", entry);
+        return;
+    }
+    *value++ = 0;
+
+    thread_policy_t policy = { .sched = SCHED_KIND_OTHER, .prio = 0, .cpu = -1 };
+    char            *cpu = strchr(value, '@');
+
+    if (cpu) {
+        *cpu++ = 0;
+        policy.cpu = atoi(cpu);
+    }
+
+    if (strncmp(value, "fifo:", 5) == 0) {
+        policy.sched = SCHED_KIND_FIFO;
+        policy.prio = limit(atoi(value + 5), 1, 99);
+    } else if (strncmp(value, "nice:", 5) == 0) {
+        policy.prio = limit(atoi(value + 5), -20, 19);
+    } else if (strcmp(value, "other") != 0) {
+        LV_LOG_WARN("Wrong thread policy: %s=%s", entry, value);
+        return;
+    }
+
+    thread_policy_t *item = policy_find(entry);
+
+    if (!item) {
+        if (policies_count == MAX_POLICIES) {
+            return;
+        }
+        item = &policies[policies_count++];
+    }
+    strcpy(policy.name, entry);
+    *item = policy;
+}
+
+static void policies_init() {
+    while (policies_count < MAX_POLICIES && policies[policies_count].name[0]) {
+        policies_count++;
+    }
+
+    const char *env = getenv("X6100_THREADS");
+
+    if (!env) {
+        return;
+    }
+
+    char *list = strdup(env);
+    char *save = NULL;
+
+    for (char *entry = strtok_r(list, ",", &save); entry; entry = strtok_r(NULL, ",", &save)) {
+        parse_entry(entry);
+    }
+    free(list);
+}
+
+void threads_apply(const char *name) {
+    pthread_once(&init_once, policies_init);
+
+    thread_policy_t *policy = policy_find(name);
+
+    if (!policy) {
+        return;
+    }
+
+    /* Affinity is inherited from the creator (UI is pinned), so "any" is set explicitly */
+    long        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t   set;
+
+    CPU_ZERO(&set);
+
+    if (policy->cpu >= 0 && policy->cpu < cpus) {
+        CPU_SET(policy->cpu, &set);
+    } else {
+        for (long i = 0; i < cpus; i++) {
+            CPU_SET(i, &set);
+        }
+    }
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        LV_LOG_WARN("Can't set cpu %i for thread %s", policy->cpu, name);
+    }
+
+    if (policy->sched == SCHED_KIND_FIFO) {
+        struct sched_param param = { .sched_priority = policy->prio };
+
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+            LV_LOG_WARN("Can't set SCHED_FIFO %i for thread %s", policy->prio, name);
+        }
+        rt_mem_thread_start();
+    } else if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), policy->prio) != 0) {
+        LV_LOG_WARN("Can't set nice %i for thread %s", policy->prio, name);
+    }
+}
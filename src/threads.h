@@ -0,0 +1,32 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scheduling of the app threads. Each thread applies its entry of the table
+ * (by the name given to set_thread_name) when it starts: SCHED_FIFO priority
+ * or nice level, and the CPU it is pinned to.
+ *
+ * Entries can be overridden with X6100_THREADS, a comma separated list of
+ * name=fifo:PRIO[@CPU], name=nice:N[@CPU] or name=other[@CPU],
+ * e.g. X6100_THREADS="ft8=nice:15,dsp=fifo:30@1"
+ */
+
+/**
+ * Apply the policy of the thread name to the calling thread, unknown names are left as is
+ */
+void threads_apply(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,210 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+typedef struct {
+    uint64_t    ns;
+    uint32_t    arg;
+    uint8_t     point;
+    uint8_t     phase;
+} event_t;
+
+typedef struct ring_t {
+    event_t         events[TRACE_RING];
+    atomic_uint     head;               /* Total count of events, published with release */
+    pid_t           tid;
+    char            name[16];
+    struct ring_t   *next;
+} ring_t;
+
+bool                        trace_on = false;
+
+static __thread ring_t      *ring = NULL;
+static ring_t               *rings = NULL;
+static pthread_mutex_t      rings_mux = PTHREAD_MUTEX_INITIALIZER;
+
+static void (*orig_flush_cb)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+static void (*orig_monitor_cb)(lv_disp_drv_t *, uint32_t, uint32_t);
+static void (*orig_render_start_cb)(lv_disp_drv_t *);
+
+static bool                 render_open = false;
+
+static const char * const   point_names[TRACE_LAST] = {
+    "flow_read",
+    "dsp_samples",
+    "waterfall_data",
+    "scheduler_put",
+    "scheduler_work",
+    "render",
+    "flush",
+    "input",
+    "subject_set",
+    "control",
+};
+
+static ring_t * ring_create() {
+    ring_t *r = calloc(1, sizeof(ring_t));
+
+    if (!r) {
+        return NULL;
+    }
+
+    r->tid = syscall(SYS_gettid);
+    pthread_getname_np(pthread_self(), r->name, sizeof(r->name));
+
+    pthread_mutex_lock(&rings_mux);
+    r->next = rings;
+    rings = r;
+    pthread_mutex_unlock(&rings_mux);
+
+    return r;
+}
+
+void trace_put(trace_point_t point, trace_phase_t phase, uint32_t arg) {
+    struct timespec ts;
+
+    if (!ring) {
+        ring = ring_create();
+
+        if (!ring) {
+            return;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    unsigned    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    event_t     *e = &ring->events[head % TRACE_RING];
+
+    e->ns = (uint64_t) ts.tv_sec * 1000000000L + ts.tv_nsec;
+    e->arg = arg;
+    e->point = point;
+    e->phase = phase;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Display */
+
+static void render_start_cb(lv_disp_drv_t *drv) {
+    if (!render_open) {
+        trace_begin(TRACE_RENDER, 0);
+        render_open = true;
+    }
+
+    if (orig_render_start_cb) {
+        orig_render_start_cb(drv);
+    }
+}
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p) {
+    trace_begin(TRACE_FLUSH, lv_area_get_size(area));
+    orig_flush_cb(drv, area, color_p);
+    trace_end(TRACE_FLUSH);
+}
+
+static void monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px) {
+    if (render_open) {
+        trace_end(TRACE_RENDER);
+        render_open = false;
+    }
+
+    if (orig_monitor_cb) {
+        orig_monitor_cb(drv, time, px);
+    }
+}
+
+void trace_init(lv_disp_t *disp) {
+    const char *env = getenv("X6100_TRACE");
+
+    if (!env || !*env || strcmp(env, "0") == 0) {
+        return;
+    }
+
+    if (disp) {
+        lv_disp_drv_t *drv = disp->driver;
+
+        orig_flush_cb = drv->flush_cb;
+        orig_monitor_cb = drv->monitor_cb;
+        orig_render_start_cb = drv->render_start_cb;
+        drv->flush_cb = flush_cb;
+        drv->monitor_cb = monitor_cb;
+        drv->render_start_cb = render_start_cb;
+    }
+
+    __atomic_store_n(&trace_on, true, __ATOMIC_RELAXED);
+    LV_LOG_USER("Tracing, SIGUSR1 writes %s", TRACE_PATH);
+}
+
+/* Export */
+
+static void dump_ring(FILE *f, ring_t *r, bool *first) {
+    unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+    unsigned start = head > TRACE_RING ? head - TRACE_RING : 0;
+
+    fprintf(f, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",", r->tid, r->name);
+    *first = false;
+
+    for (unsigned i = start; i < head; i++) {
+        event_t e = r->events[i % TRACE_RING];
+
+        if (e.point >= TRACE_LAST) {
+            continue;
+        }
+
+        fprintf(f, ",\n{\"ph\":\"%c\",\"name\":\"%s\",\"pid\":1,\"tid\":%i,\"ts\":%llu.%03u",
+                e.phase, point_names[e.point], r->tid,
+                (unsigned long long) (e.ns / 1000), (unsigned) (e.ns % 1000));
+
+        if (e.phase == TRACE_INSTANT) {
+            fprintf(f, ",\"s\":\"t\"");
+        }
+        if (e.phase != TRACE_END) {
+            fprintf(f, ",\"args\":{\"arg\":%u}", e.arg);
+        }
+        fprintf(f, "}");
+    }
+}
+
+bool trace_dump(const char *path) {
+    FILE *f = fopen(path, "w");
+
+    if (!f) {
+        LV_LOG_ERROR("Trace %s: can't open", path);
+        return false;
+    }
+
+    bool first = true;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    pthread_mutex_lock(&rings_mux);
+
+    for (ring_t *r = rings; r; r = r->next) {
+        dump_ring(f, r, &first);
+    }
+
+    pthread_mutex_unlock(&rings_mux);
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    LV_LOG_USER("Trace written to %s", path);
+    return true;
+}
@@ -0,0 +1,92 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include "lvgl/lvgl.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Latency trace points along IQ packet -> DSP -> waterfall -> screen and
+ * key -> subject -> radio command. Every thread writes to its own ring with
+ * monotonic timestamps, without locks. The last TRACE_RING events of each thread
+ * are exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+ *
+ * Enabled by X6100_TRACE=1, SIGUSR1 writes TRACE_PATH. A disabled point costs one load.
+ */
+
+#define TRACE_PATH  "/tmp/trace.json"
+#define TRACE_RING  8192
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TRACE_FLOW_READ = 0,
+    TRACE_DSP_SAMPLES,
+    TRACE_WATERFALL_DATA,
+    TRACE_SCHEDULER_PUT,
+    TRACE_SCHEDULER_WORK,
+    TRACE_RENDER,
+    TRACE_FLUSH,
+    TRACE_INPUT,
+    TRACE_SUBJECT_SET,
+    TRACE_CONTROL,
+
+    TRACE_LAST
+} trace_point_t;
+
+typedef enum {
+    TRACE_BEGIN = 'B',
+    TRACE_END = 'E',
+    TRACE_INSTANT = 'i',
+} trace_phase_t;
+
+extern bool trace_on;
+
+void trace_put(trace_point_t point, trace_phase_t phase, uint32_t arg);
+
+static inline bool trace_enabled() {
+    return __atomic_load_n(&trace_on, __ATOMIC_RELAXED);
+}
+
+static inline void trace_begin(trace_point_t point, uint32_t arg) {
+    if (trace_enabled()) {
+        trace_put(point, TRACE_BEGIN, arg);
+    }
+}
+
+static inline void trace_end(trace_point_t point) {
+    if (trace_enabled()) {
+        trace_put(point, TRACE_END, 0);
+    }
+}
+
+static inline void trace_instant(trace_point_t point, uint32_t arg) {
+    if (trace_enabled()) {
+        trace_put(point, TRACE_INSTANT, arg);
+    }
+}
+
+/**
+ * Read X6100_TRACE. With the display, render and flush are traced too
+ */
+void trace_init(lv_disp_t *disp);
+
+/**
+ * Write the rings as trace-event JSON. Writers are not stopped, so the oldest
+ * events of a busy thread may be overwritten meanwhile
+ */
+bool trace_dump(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
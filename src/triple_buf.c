@@ -0,0 +1,90 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "triple_buf.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_MASK  3
+#define FRESH       4           /* Middle frame isn't read yet */
+#define ALIGN       64
+
+struct triple_buf_s {
+    size_t          stride;
+    uint8_t         *data;
+
+    uint8_t         back;       /* Producer */
+    uint8_t         front;      /* Consumer */
+    atomic_uint     middle;     /* Index and FRESH */
+    atomic_uint     dropped;
+};
+
+triple_buf_t triple_buf_create(size_t frame_size) {
+    triple_buf_t buf = malloc(sizeof(struct triple_buf_s));
+
+    if (!buf) {
+        return NULL;
+    }
+
+    /* Frames on own cache lines */
+    buf->stride = (frame_size + ALIGN - 1) / ALIGN * ALIGN;
+
+    if (posix_memalign((void **) &buf->data, ALIGN, buf->stride * 3) != 0) {
+        free(buf);
+        return NULL;
+    }
+    memset(buf->data, 0, buf->stride * 3);
+
+    buf->back = 0;
+    buf->front = 2;
+    atomic_init(&buf->middle, 1);
+    atomic_init(&buf->dropped, 0);
+
+    return buf;
+}
+
+void triple_buf_destroy(triple_buf_t buf) {
+    if (buf) {
+        free(buf->data);
+        free(buf);
+    }
+}
+
+void *triple_buf_back(triple_buf_t buf) {
+    return buf->data + buf->back * buf->stride;
+}
+
+void triple_buf_publish(triple_buf_t buf) {
+    unsigned prev = atomic_exchange_explicit(&buf->middle, buf->back | FRESH, memory_order_acq_rel);
+
+    if (prev & FRESH) {
+        atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+    }
+    buf->back = prev & INDEX_MASK;
+}
+
+const void *triple_buf_read(triple_buf_t buf, bool *fresh) {
+    bool is_fresh = atomic_load_explicit(&buf->middle, memory_order_relaxed) & FRESH;
+
+    if (is_fresh) {
+        unsigned prev = atomic_exchange_explicit(&buf->middle, buf->front, memory_order_acq_rel);
+
+        buf->front = prev & INDEX_MASK;
+    }
+    if (fresh) {
+        *fresh = is_fresh;
+    }
+
+    return buf->data + buf->front * buf->stride;
+}
+
+uint32_t triple_buf_get_dropped(triple_buf_t buf) {
+    return atomic_load_explicit(&buf->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single producer / single consumer lock-free triple buffer of fixed size frames.
+ * Producer fills its back buffer and publishes it by swapping with the middle one,
+ * consumer takes the middle one when it has a newer frame. Each side owns its
+ * buffer until the next publish/read, so frames are used in place, without locks
+ * or copies. Frames not read before the next publish are dropped and counted.
+ */
+typedef struct triple_buf_s * triple_buf_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create buffer with 3 zeroed frames of `frame_size` bytes
+ */
+triple_buf_t triple_buf_create(size_t frame_size);
+void triple_buf_destroy(triple_buf_t buf);
+
+/**
+ * Frame for writing (producer side), it's the same one until triple_buf_publish()
+ */
+void *triple_buf_back(triple_buf_t buf);
+
+/**
+ * Make the back frame the latest one (producer side)
+ */
+void triple_buf_publish(triple_buf_t buf);
+
+/**
+ * Latest complete frame (consumer side), valid until the next call. `fresh` is set,
+ * if it wasn't returned before. Before the first publish it's a zeroed frame
+ */
+const void *triple_buf_read(triple_buf_t buf, bool *fresh);
+
+uint32_t triple_buf_get_dropped(triple_buf_t buf);
+
+#ifdef __cplusplus
+}
+#endif
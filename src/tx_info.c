@@ -8,19 +8,25 @@
 
 #include "tx_info.h"
 
+#include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 
 #include "dialog.h"
 #include "events.h"
+#include "label_text.h"
 #include "msg_tiny.h"
 #include "params/params.h"
-#include "scheduler.h"
 #include "styles.h"
+#include "telemetry.h"
 #include "util.h"
 
 #define NUM_PWR_ITEMS 6
 #define NUM_VSWR_ITEMS 5
 #define UPDATE_UI_MS 40
+#define PWR_STEP 0.25f
+#define SWR_STEP 0.1f
+#define ALC_STEP 0.1f
 
 static const float min_pwr = 0.0f;
 static const float max_pwr = 10.0f;
@@ -32,9 +38,23 @@ static float pwr  = 0.0f;
 static float vswr = 0.0f;
 static float alc;
 
-static uint8_t msg_id;
+/* Display steps of the last redraw */
+static int32_t drawn_pwr = -1;
+static int32_t drawn_swr = -1;
+static int32_t drawn_alc = -1;
 
-static uint64_t prev_ui_update = 0;
+/* Values for other threads (CAT), a seqlock with the UI timer as the writer */
+static struct {
+    atomic_uint     seq;
+    _Atomic float   pwr;
+    _Atomic float   vswr;
+    _Atomic float   alc;
+} shared;
+
+static atomic_uint msg_id;
+
+static lv_timer_t   *timer;
+static uint32_t     cursor;
 
 static x6100_mode_t cur_mode;
 
@@ -89,7 +109,7 @@ static void tx_info_draw_cb(lv_event_t *e) {
 
     rect_dsc.bg_opa = LV_OPA_80;
 
-    float slice_pwr_step    = 0.25f;
+    float slice_pwr_step    = PWR_STEP;
     slices_total            = (max_pwr - min_pwr) / slice_pwr_step;
     uint8_t slice_pwr_width = w / slices_total;
 
@@ -115,7 +135,7 @@ static void tx_info_draw_cb(lv_event_t *e) {
 
     rect_dsc.bg_opa = LV_OPA_80;
 
-    float slice_swr_step    = 0.1f;
+    float slice_swr_step    = SWR_STEP;
     slices_total            = (max_swr - min_swr) / slice_swr_step;
     uint8_t slice_swr_width = w / slices_total;
 
@@ -188,34 +208,104 @@ static void tx_info_draw_cb(lv_event_t *e) {
     }
 }
 
-static void tx_cb(lv_event_t *e) {
-    pwr  = 0.0f;
-    vswr = 0.0f;
-    alc  = 0.0f;
+static void apply_sample(const telemetry_sample_t *sample) {
+    // Use EMA for smoothing values
+    const float beta = 0.9f;
 
-    lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_move_foreground(obj);
-}
+    float a = 10.f - sample->alc;
+    float s = LV_MIN(max_swr, sample->vswr);
 
-static void rx_cb(lv_event_t *e) {
-    lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    switch (cur_mode) {
+        case x6100_mode_lsb_dig:
+        case x6100_mode_usb_dig:
+            pwr  = sample->pwr;
+            alc  = a;
+            vswr = s;
+            break;
+        default:
+            lpf(&pwr, sample->pwr, beta, 0.0f);
+            lpf(&alc, a, beta, 0.0f);
+            lpf(&vswr, s, beta, 0.0f);
+    }
 }
 
-static void update_tx_info(void *arg) {
+static void update_tx_info(lv_timer_t *t) {
+    telemetry_sample_t  samples[64];
+    size_t              count;
+    bool                updated = false;
+
+    while ((count = telemetry_read(&cursor, samples, 64))) {
+        for (size_t i = 0; i < count; i++) {
+            apply_sample(&samples[i]);
+        }
+        updated = true;
+    }
+
+    if (!updated) {
+        return;
+    }
+
+    unsigned seq = atomic_load_explicit(&shared.seq, memory_order_relaxed);
+
+    atomic_store_explicit(&shared.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&shared.pwr, pwr, memory_order_relaxed);
+    atomic_store_explicit(&shared.vswr, vswr, memory_order_relaxed);
+    atomic_store_explicit(&shared.alc, alc, memory_order_relaxed);
+    atomic_store_explicit(&shared.seq, seq + 2, memory_order_release);
+    atomic_fetch_add(&msg_id, 1);
+
     if (lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) {
         return;
     }
-    lv_obj_invalidate(obj);
+
+    int32_t pwr_step = pwr / PWR_STEP;
+    int32_t swr_step = vswr / SWR_STEP;
+    int32_t alc_step = lroundf(alc / ALC_STEP);
+
+    if (pwr_step != drawn_pwr || swr_step != drawn_swr) {
+        drawn_pwr = pwr_step;
+        drawn_swr = swr_step;
+        lv_obj_invalidate(obj);
+    }
+    if (alc_step == drawn_alc) {
+        return;
+    }
+    drawn_alc = alc_step;
+
     if (params.mag_alc.x) {
         msg_tiny_set_text_fmt("ALC: %.1f", alc);
     }
     if (dialog_is_run() || !params.mag_alc.x) {
-        lv_label_set_text_fmt(alc_label, "ALC: %1.1f", alc);
+        label_text_set_fmt(alc_label, "ALC: %1.1f", alc);
     } else {
-        lv_label_set_text(alc_label, "");
+        label_text_set(alc_label, "");
     }
 }
 
+static void tx_cb(lv_event_t *e) {
+    pwr  = 0.0f;
+    vswr = 0.0f;
+    alc  = 0.0f;
+
+    drawn_pwr = -1;
+    drawn_swr = -1;
+    drawn_alc = -1;
+
+    cursor = telemetry_position();
+    lv_timer_resume(timer);
+
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_foreground(obj);
+}
+
+static void rx_cb(lv_event_t *e) {
+    update_tx_info(timer);
+    lv_timer_pause(timer);
+
+    lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+}
+
 lv_obj_t *tx_info_init(lv_obj_t *parent) {
     obj = lv_obj_create(parent);
 
@@ -249,43 +339,35 @@ lv_obj_t *tx_info_init(lv_obj_t *parent) {
 
     subject_add_observer(cfg_cur.mode, on_cur_mode_change, NULL);
 
-    return obj;
-}
-
-void tx_info_update(float p, float s, float a) {
-    // Use EMA for smoothing values
-    const float beta = 0.9f;
-
-    a = 10.f - a;
-    s = LV_MIN(max_swr, s);
+    timer = lv_timer_create(update_tx_info, UPDATE_UI_MS, NULL);
+    lv_timer_pause(timer);
 
-    switch (cur_mode) {
-        case x6100_mode_lsb_dig:
-        case x6100_mode_usb_dig:
-            pwr  = p;
-            alc  = a;
-            vswr = s;
-            break;
-        default:
-            lpf(&pwr, p, beta, 0.0f);
-            lpf(&alc, a, beta, 0.0f);
-            lpf(&vswr, s, beta, 0.0f);
-    }
-    msg_id++;
-    scheduler_put_noargs(update_tx_info);
+    return obj;
 }
 
 bool tx_info_refresh(uint8_t *prev_msg_id, float *alc_p, float *pwr_p, float *vswr_p) {
-    if (*prev_msg_id == msg_id) {
+    uint8_t id = atomic_load(&msg_id);
+    float   a, p, v;
+    unsigned seq;
+
+    if (*prev_msg_id == id) {
         return false;
     }
+    do {
+        seq = atomic_load_explicit(&shared.seq, memory_order_acquire);
+        a = atomic_load_explicit(&shared.alc, memory_order_relaxed);
+        p = atomic_load_explicit(&shared.pwr, memory_order_relaxed);
+        v = atomic_load_explicit(&shared.vswr, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&shared.seq, memory_order_relaxed));
+
     if (alc_p)
-        *alc_p = alc;
+        *alc_p = a;
     if (pwr_p)
-        *pwr_p = pwr;
+        *pwr_p = p;
     if (vswr_p)
-        *vswr_p = vswr;
-    *prev_msg_id = msg_id;
+        *vswr_p = v;
+    *prev_msg_id = id;
     return true;
 }
 
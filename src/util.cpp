@@ -7,6 +7,8 @@
  */
 #include "util.h"
 #include "util.hpp"
+#include "threads.h"
+#include "profiler.h"
 
 extern "C" {
     #include <complex.h>
@@ -18,6 +20,8 @@ extern "C" {
     #include <string.h>
     #include <string.h>
     #include <errno.h>
+    #include <sys/prctl.h>
+    #include <malloc.h>
 }
 
 /**
@@ -271,41 +275,19 @@ size_t argmax(float * x, size_t n) {
 }
 
 
-char * util_canonize_callsign(const char * callsign, bool strip_slashes) {
-    if (!callsign) {
-        return NULL;
-    }
-
-    char *result = NULL;
-
-    if (strip_slashes) {
-        char *s = strdup(callsign);
-        char *token = strtok(s, "/");
-        while(token) {
-            if ((
-                ((token[0] >= '0') && (token[0] <= '9')) ||
-                ((token[1] >= '0') && (token[1] <= '9')) ||
-                ((token[2] >= '0') && (token[2] <= '9'))
-            ) && strlen(token) >= 4) {
-                result = strdup(token);
-                break;
-            }
-            token = strtok(NULL, "/");
-        }
-        free(s);
-    } else {
-        // strip < and > from remote call
-        size_t callsign_len = strlen(callsign);
-        if ((callsign[0] == '<') && (callsign[callsign_len - 1] == '>')) {
-            result = strdup(callsign + 1);
-            result[callsign_len - 2] = 0;
-        }
+void util_strip_callsign_brackets(const char * callsign, char * out, size_t size) {
+    size_t len = strlen(callsign);
 
+    // strip < and > from remote call
+    if (len >= 2 && callsign[0] == '<' && callsign[len - 1] == '>') {
+        callsign++;
+        len -= 2;
     }
-    if (!result) {
-        result = strdup(callsign);
+    if (len >= size) {
+        len = size - 1;
     }
-    return result;
+    memcpy(out, callsign, len);
+    out[len] = '\0';
 }
 
 
@@ -329,3 +311,19 @@ void sleep_usec(uint32_t msec) {
     }
     errno = olderrno;
 }
+
+void set_thread_name(const char *name) {
+    prctl(PR_SET_NAME, name, 0, 0, 0);
+    threads_apply(name);
+    profiler_thread_start(name);
+}
+
+size_t get_heap_used() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo mi = mallinfo();
+#endif
+
+    return (size_t) mi.uordblks + (size_t) mi.hblkhd;
+}
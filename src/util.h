@@ -51,10 +51,25 @@ float wrms_get_val(wrms_t wr);
 
 size_t argmax(float *x, size_t n);
 
-char *util_canonize_callsign(const char *callsign, bool strip_slashes);
+/**
+ * Callsign without "<>" of a hashed one into `out` of `size`. Canonical callsigns
+ * are made by call_intern_canon()
+ */
+void util_strip_callsign_brackets(const char *callsign, char *out, size_t size);
 
 void sleep_usec(uint32_t msec);
 
+/**
+ * Name of the calling thread, shown in /proc and perf stats (up to 15 chars).
+ * Also applies its scheduling policy, see threads.h
+ */
+void set_thread_name(const char *name);
+
+/**
+ * Allocated heap bytes, LVGL objects included (LV_MEM_CUSTOM)
+ */
+size_t get_heap_used();
+
 #ifdef __cplusplus
 }
 #endif
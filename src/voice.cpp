@@ -9,6 +9,7 @@
 #include "voice.h"
 
 #include "util.h"
+#include "voice_cache.hpp"
 #include "cfg/cfg.h"
 
 extern "C" {
@@ -29,12 +30,19 @@ extern "C" {
 #include <fstream>
 #include <iterator>
 #include <algorithm>
+#include <atomic>
+#include <vector>
+#include <cctype>
 
 #include <RHVoice/core/engine.hpp>
 #include <RHVoice/core/document.hpp>
 #include <RHVoice/core/client.hpp>
 #include <RHVoice/audio.hpp>
 
+#define VOICE_RATE          24000
+#define VOICE_SILENCE       300     /* Level of the clip edges to trim */
+#define VOICE_PHRASE_MAX    48
+
 using namespace RHVoice;
 
 class audio_player: public client {
@@ -44,17 +52,30 @@ public:
     bool play_speech(const short* samples_buf, std::size_t count);
     void finish();
 
+    uint32_t            seq;                // Of the request being said
+    std::vector<short>  *capture = NULL;    // Samples go there instead of the stream
+
 private:
     audio::playback_stream stream;
 };
 
 audio_player::audio_player() {
-    stream.set_sample_rate(24000);
+    stream.set_sample_rate(VOICE_RATE);
     stream.set_buffer_size(512);
     stream.open();
 }
 
 bool audio_player::play_speech(const short* buf, std::size_t count) {
+    // Newer request cancels the synthesis
+    if (seq != req_seq.load()) {
+        return false;
+    }
+
+    if (capture) {
+        capture->insert(capture->end(), buf, buf + count);
+        return true;
+    }
+
     try {
         stream.write(buf, count);
         return true;
@@ -77,13 +98,24 @@ typedef struct {
 
 static std::shared_ptr<engine>      eng(new engine);
 static voice_profile                profile;
+static int                          profile_lang = -1;
 static char                         buf[512];
 static char                         prev[512];
-static pthread_t                    thread;
-static uint32_t                     delay = 0;
-static bool                         run = false;
 static uint16_t                     repeated = 0;
 static bool                         sure = false;
+static VoiceCache                   cache;
+
+/* Request slot of the worker, a new request replaces the pending one and cancels the said one */
+
+static pthread_t                    thread;
+static pthread_once_t               thread_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t              req_mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t               req_cond = PTHREAD_COND_INITIALIZER;
+static char                         req_buf[512];
+static uint32_t                     req_delay = 0;
+static bool                         req_cacheable = false;
+static std::atomic<uint32_t>        req_seq{0};
+static uint32_t                     done_seq = 0;
 
 static voice_item_t                 voice_item[VOICES_NUM] = {
     { .name = "lyubov",         .label = "Lyubov (En)",     .welcome = "Hello. This is voice Lyubov" },
@@ -92,17 +124,152 @@ static voice_item_t                 voice_item[VOICES_NUM] = {
     { .name = "evgeniy-eng",    .label = "Evgeniy (En)",    .welcome = "Hello. This is voice Evgeniy" },
 };
 
-static void * say_thread(void *arg) {
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+static void synthesize(audio_player &player, const char *str) {
+    std::istringstream              text{str};
+    std::istreambuf_iterator<char>  text_start{text};
+    std::istreambuf_iterator<char>  text_end;
+    std::unique_ptr<document>       doc = document::create_from_plain_text(eng, text_start, text_end, content_text, profile);
+
+    doc->speech_settings.relative.rate = params.voice_rate.x / 100.0;
+    doc->speech_settings.relative.pitch = params.voice_pitch.x / 100.0;
+    doc->speech_settings.relative.volume = params.voice_volume.x / 100.0;
+    doc->set_owner(player);
+    doc->synthesize();
+}
+
+/**
+ * Split the text into phrases of the cache: numbers up to 3 digits, decimal point, minus
+ * and words between them. Returns false for text, which is not worth caching
+ */
+static bool split_phrases(const char *text, std::vector<std::string> &phrases) {
+    const char *p = text;
+
+    while (*p) {
+        if (isdigit(*p)) {
+            const char *start = p;
+
+            while (isdigit(*p)) {
+                p++;
+            }
+            if (p - start > 3) {
+                return false;
+            }
+            phrases.emplace_back(start, p);
+        } else if (*p == '.') {
+            if (p > text && isdigit(p[-1]) && isdigit(p[1])) {
+                phrases.emplace_back("point");
+            }
+            p++;
+        } else if (*p == '-' && isdigit(p[1])) {
+            phrases.emplace_back("minus");
+            p++;
+        } else if (*p == '|' || *p == ' ') {
+            p++;
+        } else {
+            const char *start = p;
+
+            while (*p && !isdigit(*p) && *p != '|' && *p != '.') {
+                p++;
+            }
+
+            const char *end = p;
 
-    if (delay) {
-        usleep(delay);
+            while (end > start && end[-1] == ' ') {
+                end--;
+            }
+            if (end - start > VOICE_PHRASE_MAX) {
+                return false;
+            }
+            phrases.emplace_back(start, end);
+        }
+    }
+
+    return !phrases.empty();
+}
+
+/**
+ * Leading and trailing silence of the synthesizer, a gap between concatenated clips
+ */
+static void trim_silence(std::vector<short> &pcm) {
+    const size_t    keep = VOICE_RATE * 30 / 1000;
+    size_t          first = 0;
+    size_t          last = pcm.size();
+
+    while (first < last && abs(pcm[first]) < VOICE_SILENCE) {
+        first++;
+    }
+    while (last > first && abs(pcm[last - 1]) < VOICE_SILENCE) {
+        last--;
+    }
+
+    first = first > keep ? first - keep : 0;
+    last = std::min(last + keep, pcm.size());
+
+    pcm.erase(pcm.begin() + last, pcm.end());
+    pcm.erase(pcm.begin(), pcm.begin() + first);
+}
+
+/**
+ * Say the text by concatenating cached clips. Missing phrases are synthesized and
+ * stored first. Returns false, if the text is for the synthesizer
+ */
+static bool say_cached(audio_player &player, const char *text) {
+    std::vector<std::string>    phrases;
+    std::vector<VoiceClip>      clips;
+    char                        name[64];
+
+    if (!split_phrases(text, phrases)) {
+        return false;
+    }
+
+    snprintf(name, sizeof(name), "%s_%i_%i_%i", voice_item[profile_lang].name,
+             params.voice_rate.x, params.voice_pitch.x, params.voice_volume.x);
+    cache.set_voice(name);
+
+    for (const std::string &phrase : phrases) {
+        VoiceClip clip;
+
+        if (!cache.get(phrase, clip)) {
+            std::vector<short> pcm;
+
+            player.capture = &pcm;
+            synthesize(player, phrase.c_str());
+            player.capture = NULL;
+
+            if (player.seq != req_seq.load()) {
+                return true;
+            }
+
+            trim_silence(pcm);
+
+            if (pcm.empty() || !cache.put(phrase, pcm.data(), pcm.size()) || !cache.get(phrase, clip)) {
+                return false;
+            }
+        }
+        clips.push_back(clip);
+    }
+
+    audio_play_en(true);
+
+    for (const VoiceClip &clip : clips) {
+        if (!player.play_speech(clip.samples, clip.count)) {
+            break;
+        }
     }
 
-    run = true;
+    player.finish();
+    audio_play_en(false);
+
+    return true;
+}
 
-    profile = eng->create_voice_profile(voice_item[params.voice_lang.x].name);
+static void say(audio_player &player, bool cacheable) {
+    int lang = params.voice_lang.x;
+
+    if (lang != profile_lang) {
+        profile = eng->create_voice_profile(voice_item[lang].name);
+        profile_lang = lang;
+    }
 
     char *ptr = strchr(buf, '|');
 
@@ -126,27 +293,97 @@ static void * say_thread(void *arg) {
     }
     strcpy(prev, buf);
 
-    audio_player                    player;
-    std::istringstream              text{ptr};
-    std::istreambuf_iterator<char>  text_start{text};
-    std::istreambuf_iterator<char>  text_end;
-    std::unique_ptr<document>       doc = document::create_from_plain_text(eng, text_start, text_end, content_text, profile);
-
-    doc->speech_settings.relative.rate = params.voice_rate.x / 100.0;
-    doc->speech_settings.relative.pitch = params.voice_pitch.x / 100.0;
-    doc->speech_settings.relative.volume = params.voice_volume.x / 100.0;
-    doc->set_owner(player);
+    if (cacheable && say_cached(player, ptr)) {
+        return;
+    }
 
     audio_play_en(true);
-    doc->synthesize();
+    synthesize(player, ptr);
     player.finish();
     audio_play_en(false);
+}
+
+static void * say_thread(void *arg) {
+    set_thread_name("voice");
+
+    audio_player player;
+
+    pthread_mutex_lock(&req_mux);
+
+    while (true) {
+        while (done_seq == req_seq.load()) {
+            pthread_cond_wait(&req_cond, &req_mux);
+        }
+
+        uint32_t seq = req_seq.load();
+
+        if (req_delay) {
+            struct timespec ts;
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += req_delay / 1000000;
+            ts.tv_nsec += (req_delay % 1000000) * 1000;
+
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+
+            // Newer request restarts the delay
+            while (seq == req_seq.load()) {
+                if (pthread_cond_timedwait(&req_cond, &req_mux, &ts) != 0) {
+                    break;
+                }
+            }
+
+            if (seq != req_seq.load()) {
+                continue;
+            }
+        }
+
+        strcpy(buf, req_buf);
+        bool cacheable = req_cacheable;
+        done_seq = seq;
+        player.seq = seq;
+
+        pthread_mutex_unlock(&req_mux);
+        say(player, cacheable);
+        pthread_mutex_lock(&req_mux);
+
+        sure = false;
+    }
 
-    run = false;
-    sure = false;
     return NULL;
 }
 
+static void thread_init() {
+    pthread_create(&thread, NULL, say_thread, NULL);
+}
+
+/**
+ * Put the request to the worker, replacing the pending one
+ */
+static void say_request(uint32_t delay, bool cacheable, const char * fmt, va_list args) {
+    pthread_once(&thread_once, thread_init);
+    pthread_mutex_lock(&req_mux);
+
+    vsnprintf(req_buf, sizeof(req_buf), fmt, args);
+    req_delay = delay;
+    req_cacheable = cacheable;
+    req_seq++;
+
+    pthread_cond_signal(&req_cond);
+    pthread_mutex_unlock(&req_mux);
+}
+
+static void say_request_fmt(uint32_t delay, bool cacheable, const char * fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    say_request(delay, cacheable, fmt, args);
+    va_end(args);
+}
+
 void voice_sure() {
     sure = true;
 }
@@ -176,7 +413,7 @@ void voice_change_mode() {
 }
 
 bool voice_enable() {
-    if (run || recorder_is_on()) {
+    if (recorder_is_on()) {
         return false;
     }
 
@@ -206,16 +443,8 @@ void voice_delay_say_text_fmt(const char * fmt, ...) {
     va_list args;
 
     va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
+    say_request(1000000, false, fmt, args);
     va_end(args);
-
-    if (thread) {
-        pthread_cancel(thread);
-        pthread_join(thread, NULL);
-    }
-
-    delay = 1000000;
-    pthread_create(&thread, NULL, say_thread, NULL);
 }
 
 void voice_say_text_fmt(const char * fmt, ...) {
@@ -226,11 +455,8 @@ void voice_say_text_fmt(const char * fmt, ...) {
     va_list args;
 
     va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
+    say_request(0, false, fmt, args);
     va_end(args);
-
-    delay = 0;
-    pthread_create(&thread, NULL, say_thread, NULL);
 }
 
 void voice_say_freq(uint64_t freq) {
@@ -243,40 +469,47 @@ void voice_say_freq(uint64_t freq) {
     split_freq(freq, &mhz, &khz, &hz);
 
     if (hz) {
-        snprintf(buf, sizeof(buf), "%i.|%i.%i", mhz, khz, hz);
+        say_request_fmt(1000000, true, "%i.|%i.%i", mhz, khz, hz);
     } else if (khz) {
-        snprintf(buf, sizeof(buf), "%i.|%i", mhz, khz);
+        say_request_fmt(1000000, true, "%i.|%i", mhz, khz);
     } else {
-        snprintf(buf, sizeof(buf), "%i", mhz);
+        say_request_fmt(1000000, true, "%i", mhz);
     }
+}
 
-    if (thread) {
-        pthread_cancel(thread);
-        pthread_join(thread, NULL);
+/**
+ * Prompt with a value, said from the cached phrases
+ */
+static void say_prompt_fmt(const char * fmt, ...) {
+    if (!voice_enable()) {
+        return;
     }
 
-    delay = 1000000;
-    pthread_create(&thread, NULL, say_thread, NULL);
+    va_list args;
+
+    va_start(args, fmt);
+    say_request(1000000, true, fmt, args);
+    va_end(args);
 }
 
 void voice_say_bool(const char *prompt, bool x) {
-    voice_delay_say_text_fmt("%s|%s", prompt, x ? "is on" : "is off");
+    say_prompt_fmt("%s|%s", prompt, x ? "is on" : "is off");
 }
 
 void voice_say_int(const char *prompt, int32_t x) {
-    voice_delay_say_text_fmt("%s|%i", prompt, x);
+    say_prompt_fmt("%s|%i", prompt, x);
 }
 
 void voice_say_float(const char *prompt, float x) {
-    voice_delay_say_text_fmt("%s|%.1f", prompt, x);
+    say_prompt_fmt("%s|%.1f", prompt, x);
 }
 
 void voice_say_float2(const char *prompt, float x) {
-    voice_delay_say_text_fmt("%s|%.2f", prompt, x);
+    say_prompt_fmt("%s|%.2f", prompt, x);
 }
 
 void voice_say_text(const char *prompt, const char *x) {
-    voice_delay_say_text_fmt("%s|%s", prompt, x);
+    say_prompt_fmt("%s|%s", prompt, x);
 }
 
 const char * voice_change(int16_t diff) {
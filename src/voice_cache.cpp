@@ -0,0 +1,106 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#include "voice_cache.hpp"
+
+#include <cctype>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+VoiceCache::~VoiceCache() {
+    unmap();
+}
+
+void VoiceCache::unmap() {
+    for (auto &it : clips) {
+        munmap((void *) it.second.samples, it.second.count * sizeof(int16_t));
+    }
+    clips.clear();
+}
+
+std::string VoiceCache::path(const std::string &key) const {
+    std::string name;
+
+    for (char c : key) {
+        name += isalnum((unsigned char) c) ? tolower((unsigned char) c) : '_';
+    }
+
+    return dir + "/" + name + ".pcm";
+}
+
+void VoiceCache::set_voice(const std::string &name) {
+    std::string new_dir = VOICE_CACHE_PATH "/" + name;
+
+    if (new_dir == dir) {
+        return;
+    }
+
+    unmap();
+    dir = new_dir;
+
+    mkdir(VOICE_CACHE_PATH, 0755);
+    mkdir(dir.c_str(), 0755);
+}
+
+bool VoiceCache::get(const std::string &key, VoiceClip &clip) {
+    auto it = clips.find(key);
+
+    if (it != clips.end()) {
+        clip = it->second;
+        return true;
+    }
+
+    int fd = open(path(key).c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void        *ptr = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(int16_t)) {
+        ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    clip = {(const int16_t *) ptr, st.st_size / sizeof(int16_t)};
+    clips[key] = clip;
+
+    return true;
+}
+
+bool VoiceCache::put(const std::string &key, const int16_t *samples, size_t count) {
+    std::string file = path(key);
+    std::string tmp = file + ".tmp";
+    FILE        *f = fopen(tmp.c_str(), "wb");
+
+    if (!f) {
+        return false;
+    }
+
+    bool ok = fwrite(samples, sizeof(int16_t), count, f) == count;
+
+    ok = (fclose(f) == 0) && ok;
+
+    // Complete clips only, a cut one would be played forever
+    if (!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
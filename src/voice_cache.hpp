@@ -0,0 +1,47 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2022-2023 Belousov Oleg aka R1CBU
+ */
+
+#pragma once
+
+/*
+ * Disk cache of synthesized phrase clips (digits, numbers, prompts), raw 16-bit PCM
+ * at the voice rate. One directory per voice and speech settings, a file per phrase.
+ * Clips are mmapped on the first use and stay mapped until the voice changes
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#define VOICE_CACHE_PATH    "/mnt/voice"
+
+struct VoiceClip {
+    const int16_t   *samples;
+    size_t          count;
+};
+
+/**
+ * Used by the voice thread only
+ */
+class VoiceCache {
+    std::string                                 dir;
+    std::unordered_map<std::string, VoiceClip>  clips;
+
+    std::string path(const std::string &key) const;
+    void unmap();
+
+  public:
+    ~VoiceCache();
+
+    /// @brief Select the directory of the voice, the clips of the previous one are unmapped
+    void set_voice(const std::string &name);
+
+    bool get(const std::string &key, VoiceClip &clip);
+    bool put(const std::string &key, const int16_t *samples, size_t count);
+};
@@ -12,21 +12,36 @@
 #include "events.h"
 #include "params/params.h"
 #include "band_info.h"
+#include "dx_overlay.h"
 #include "meter.h"
 #include "backlight.h"
 #include "dsp.h"
 #include "util.h"
 #include "pubsub_ids.h"
 #include "scheduler.h"
+#include "waterfall_history.h"
+#include "occlusion.h"
+#include "main.h"
+#include "trace.h"
+#include "mem_stats.h"
 
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 #define PX_BYTES    sizeof(lv_color_t)
 #define DEFAULT_MIN S4
 #define DEFAULT_MAX S9_20
 #define WIDTH 800
+#define X0_FRAC_BITS 7
+#define HISTORY_ROWS (25 * 60 * 5)
 
 static lv_obj_t         *obj;
 static lv_obj_t         *img;
@@ -41,12 +56,46 @@ static int32_t          width_hz = 100000;
 static float            grid_min = DEFAULT_MIN;
 static float            grid_max = DEFAULT_MAX;
 
-static lv_img_dsc_t     *frame;
+/*
+ * Rows ring: frame has 2 * height rows, every row is stored twice (at pos and pos + height),
+ * so the visible image is a contiguous window, moved by changing view.data
+ */
+typedef struct {
+    lv_img_dsc_t    *frame;
+
+    /* State of the frame content */
+    bool            valid;
+    uint32_t        seq;            /* History row on top */
+    int32_t         center_freq;
+    uint8_t         zoom;
+    const uint32_t  *palette;
+
+    /* Tuning scroll moved the pixels instead of rendering them */
+    bool            shifted;
+    int32_t         shift_frac;     /* Sub-pixel remainder, Hz * WIDTH * zoom */
+} wf_buf_t;
+
+/*
+ * Threaded mode: render worker fills bufs[1 - shown] and hands it over to the UI thread,
+ * which only switches view to it. Single thread mode renders into bufs[0] in place
+ */
+static wf_buf_t         bufs[2];
+static atomic_int       shown = 0;
+static atomic_bool      pending = false;
+static bool             threaded = false;
+static sem_t            render_sem;
+
+static lv_img_dsc_t     view;
 static uint8_t          delay = 0;
 
-static int32_t          *freq_offsets;
-static uint16_t         last_row_id;
-static uint8_t          *waterfall_cache;
+/* Fully covered: rows only go to history, frame is rebuilt when uncovered */
+static atomic_bool      covered = false;
+/* Invalidation is clipped to the visible part while partially covered */
+static lv_area_t        visible_area;
+static bool             clip = false;
+
+/* History row shown on top while scrolled back, 0 - follow new rows */
+static uint32_t         scroll_seq = 0;
 
 static int32_t          radio_center_freq = 0;
 static int32_t          wf_center_freq = 0;
@@ -57,9 +106,17 @@ static uint8_t          refresh_counter = 0;
 
 static uint8_t          zoom = 1;
 
+/* Column map for map_zoom */
+static uint8_t          map_zoom = 0;
+// Closest left id for screen pixel
+static uint16_t         x0_arr[WIDTH];
+// Actual point offset, Q7
+static uint8_t          x0_dist[WIDTH];
+
 static void refresh_waterfall( void * arg);
 static void draw_middle_line();
-static void redraw_cb(lv_event_t * e);
+static void request_render();
+static void * render_thread(void *arg);
 static void on_zoom_changed(Subject *subj, void *user_data);
 static void on_fg_freq_change(Subject *subj, void *user_data);
 static void on_lo_offset_change(Subject *subj, void *user_data);
@@ -93,17 +150,44 @@ lv_obj_t * waterfall_init(lv_obj_t * parent) {
     return obj;
 }
 
-static void scroll_down() {
-    last_row_id = (last_row_id + 1) % height;
+/**
+ * Linear power thresholds of palette indexes for min..max dB, id >= k where psd >= thr[k].
+ * Rebuilt on the DSP thread when the range changes, thr[0] is unused
+ */
+static float            thr[256];
+static float            thr_min = NAN;
+static float            thr_max = NAN;
+
+static void build_thresholds(float min, float max) {
+    /* dB of k: min + k * (max - min) / 255, geometric progression in linear power */
+    double  t = pow(10.0, (min - WATERFALL_DB_OFFSET) / 10.0);
+    double  r = pow(10.0, (max - min) / 255.0 / 10.0);
+
+    thr[0] = 0.0f;
+    for (uint16_t k = 1; k < 256; k++) {
+        t *= r;
+        thr[k] = t;
+    }
+    thr_min = min;
+    thr_max = max;
+}
+
+static inline uint8_t quantize(float psd) {
+    uint8_t id = 0;
+
+    for (uint8_t step = 128; step; step >>= 1) {
+        id += (psd >= thr[id + step]) ? step : 0;
+    }
+    return id;
 }
 
-void waterfall_data(float *data_buf, uint16_t size, bool tx) {
+void waterfall_data(const float *psd, uint16_t size, bool tx) {
     if (delay)
     {
         delay--;
         return;
     }
-    scroll_down();
+    trace_begin(TRACE_WATERFALL_DATA, size);
 
     float min, max;
     if (tx) {
@@ -113,22 +197,21 @@ void waterfall_data(float *data_buf, uint16_t size, bool tx) {
         min = grid_min;
         max = grid_max;
     }
+    if (min != thr_min || max != thr_max) {
+        build_thresholds(min, max);
+    }
 
-    freq_offsets[last_row_id] = radio_center_freq + lo_offset;
+    uint8_t row[WATERFALL_NFFT];
 
+    if (size > WATERFALL_NFFT) {
+        size = WATERFALL_NFFT;
+    }
     for (uint16_t x = 0; x < size; x++) {
-        float       v = (data_buf[x] - min) / (max - min);
-
-        if (v < 0.0f) {
-            v = 0.0f;
-        } else if (v > 1.0f) {
-            v = 1.0f;
-        }
-
-        uint8_t id = v * 255;
-        waterfall_cache[last_row_id * size + x] = id;
+        row[x] = quantize(psd[x]);
     }
-    scheduler_put_noargs(refresh_waterfall);
+    wf_history_put(row, radio_center_freq + lo_offset);
+    request_render();
+    trace_end(TRACE_WATERFALL_DATA);
 }
 
 static void do_scroll_cb(lv_event_t * event) {
@@ -140,7 +223,23 @@ static void do_scroll_cb(lv_event_t * event) {
     } else {
         wf_center_freq = radio_center_freq;
     }
-    scheduler_put_noargs(refresh_waterfall);
+    request_render();
+}
+
+/**
+ * Like lv_img_buf_alloc(), but counted under MEM_WATERFALL instead of LVGL
+ */
+static lv_img_dsc_t * frame_alloc(lv_coord_t h) {
+    lv_img_dsc_t    *dsc = mem_calloc(MEM_WATERFALL, 1, sizeof(lv_img_dsc_t));
+    uint32_t        size = lv_img_buf_get_img_size(WIDTH, h, LV_IMG_CF_TRUE_COLOR);
+
+    dsc->header.cf = LV_IMG_CF_TRUE_COLOR;
+    dsc->header.w = WIDTH;
+    dsc->header.h = h;
+    dsc->data_size = size;
+    dsc->data = mem_calloc(MEM_WATERFALL, 1, size);
+
+    return dsc;
 }
 
 void waterfall_set_height(lv_coord_t h) {
@@ -152,24 +251,38 @@ void waterfall_set_height(lv_coord_t h) {
 
     height = lv_obj_get_height(obj);
 
-    frame = lv_img_buf_alloc(WIDTH, height, LV_IMG_CF_TRUE_COLOR);
+    threaded = params.waterfall_threaded.x;
+
+    for (uint8_t i = 0; i < (threaded ? 2 : 1); i++) {
+        bufs[i].frame = frame_alloc(height * 2);
+        bufs[i].valid = false;
+    }
+
+    view = *bufs[0].frame;
+    view.header.h = height;
+    view.data_size = WIDTH * height * PX_BYTES;
 
     img = lv_img_create(obj);
     lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
-    lv_img_set_src(img, frame);
+    lv_img_set_src(img, &view);
 
-    freq_offsets = malloc(height * sizeof(*freq_offsets));
-    for (size_t i = 0; i < height; i++) {
-        freq_offsets[i] = radio_center_freq;
+    if (!wf_history_last()) {
+        wf_history_init(WATERFALL_NFFT, HISTORY_ROWS);
     }
-    last_row_id = 0;
-    waterfall_cache = malloc(WATERFALL_NFFT * height);
-    memset(waterfall_cache, 0, WATERFALL_NFFT * height);
 
     lv_obj_add_event_cb(img, do_scroll_cb, LV_EVENT_DRAW_POST_END, NULL);
 
+    if (threaded) {
+        pthread_t thread;
+
+        sem_init(&render_sem, 0, 0);
+        pthread_create(&thread, NULL, render_thread, NULL);
+        pthread_detach(thread);
+    }
+
     waterfall_min_max_reset();
     band_info_init(obj);
+    dx_overlay_init(obj);
     draw_middle_line();
 }
 
@@ -206,8 +319,26 @@ void waterfall_min_max_reset() {
     }
 }
 
-void waterfall_update_max(float db) {
+void waterfall_get_range(float *min, float *max) {
+    *min = grid_min;
+    *max = grid_max;
+}
+
+void waterfall_set_auto_range(float min, float max) {
+    if (params.waterfall_auto_min.x) {
+        grid_min = min;
+    }
     if (params.waterfall_auto_max.x) {
+        grid_max = max;
+    }
+}
+
+void waterfall_update_max(float db) {
+    params_view_t pv;
+
+    params_view_get(&pv);
+
+    if (pv.waterfall_auto_max) {
         lpf(&grid_max, db + 3.0f, 0.85f, DEFAULT_MAX);
     } else {
         // TODO: set min/max at param change
@@ -216,7 +347,11 @@ void waterfall_update_max(float db) {
 }
 
 void waterfall_update_min(float db) {
-    if (params.waterfall_auto_min.x) {
+    params_view_t pv;
+
+    params_view_get(&pv);
+
+    if (pv.waterfall_auto_min) {
         lpf(&grid_min, db + 3.0f, 0.95f, DEFAULT_MIN);
     } else {
         grid_min = subject_get_int(cfg_cur.band->grid.min.val);
@@ -234,48 +369,222 @@ void waterfall_refresh_period_set(uint8_t k) {
     refresh_period = k;
 }
 
-static void redraw_cb(lv_event_t * e) {
-    int32_t src_x_offset;
-    uint16_t src_y, src_x0, dst_y, dst_x;
+/* Frame row for the history row, newer rows are above */
+static inline uint16_t frame_row(int64_t seq) {
+    int32_t slot = seq % height;
 
-    uint8_t current_zoom = 1;
-    if (params.waterfall_zoom.x) {
-        current_zoom = zoom;
+    if (slot < 0) {
+        slot += height;
     }
+    return (height - slot) % height;
+}
 
-    lv_color_t black = lv_color_black();
-    lv_color_t px_color;
+static uint8_t effective_zoom() {
+    return params.waterfall_zoom.x ? zoom : 1;
+}
 
-    // Closest left id for screen pixel
-    uint16_t x0_arr[WIDTH];
-    // Actual point offset, multiplied by 8
-    uint8_t x0_dist[WIDTH];
+static void build_column_map(uint8_t current_zoom) {
     for (uint16_t i = 0; i < WIDTH; i++) {
         // Position on screen, center x is 0
         float rel_screen_position = (((float) i + 0.5) / WIDTH) - 0.5f;
         float src_px = ((rel_screen_position / current_zoom) + 0.5f) * WATERFALL_NFFT + 0.5f;
         x0_arr[i] = src_px;
-        x0_dist[i] = (src_px - x0_arr[i]) * 8;
+        x0_dist[i] = (src_px - x0_arr[i]) * (1 << X0_FRAC_BITS);
+    }
+    map_zoom = current_zoom;
+}
+
+/* First screen column with x0_arr[x] >= v (x0_arr is non-decreasing) */
+static uint16_t column_lower_bound(int32_t v) {
+    uint16_t lo = 0, hi = WIDTH;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+
+        if (x0_arr[mid] < v) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Interpolate and colorize columns [from, to) of a row, all sources are inside of row */
+static void row_kernel(const uint8_t *row, int32_t offset, uint16_t from, uint16_t to, lv_color_t *dst) {
+    uint16_t x = from;
+
+#ifdef __ARM_NEON
+    uint8_t y0[8], y1[8], y[8];
+
+    for (; x + 8 <= to; x += 8) {
+        for (uint8_t k = 0; k < 8; k++) {
+            const uint8_t *p = row + (x0_arr[x + k] - offset);
+
+            y0[k] = p[0];
+            y1[k] = p[1];
+        }
+
+        uint8x8_t a = vld1_u8(y0);
+        int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(y1), a));
+        int16x8_t w = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(x0_dist + x)));
+        int16x8_t v = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(a)), vshrq_n_s16(vmulq_s16(d, w), X0_FRAC_BITS));
+
+        vst1_u8(y, vmovn_u16(vreinterpretq_u16_s16(v)));
+
+        for (uint8_t k = 0; k < 8; k++) {
+            dst[x + k] = (lv_color_t)wf_palette[y[k]];
+        }
+    }
+#endif
+
+    for (; x < to; x++) {
+        const uint8_t *p = row + (x0_arr[x] - offset);
+        uint8_t y = p[0] + ((x0_dist[x] * (p[1] - p[0])) >> X0_FRAC_BITS);
+
+        dst[x] = (lv_color_t)wf_palette[y];
+    }
+}
+
+static void fill_black(lv_color_t *dst, uint16_t from, uint16_t to) {
+    lv_color_t black = lv_color_black();
+
+    for (uint16_t x = from; x < to; x++) {
+        dst[x] = black;
+    }
+}
+
+/* Columns [x_from, x_to) of the history row */
+static void render_cols(lv_color_t *dst, int64_t seq, int32_t center_freq, uint16_t x_from, uint16_t x_to) {
+    int32_t     src_x_offset;
+    uint8_t     row[WATERFALL_NFFT];
+    int32_t     freq;
+
+    if (seq <= 0 || !wf_history_get(seq, row, &freq)) {
+        fill_black(dst, x_from, x_to);
+        return;
+    }
+
+    src_x_offset = (freq - center_freq) * WATERFALL_NFFT / width_hz;
+    if ((src_x_offset > WATERFALL_NFFT) || (src_x_offset < -WATERFALL_NFFT)) {
+        fill_black(dst, x_from, x_to);
+        return;
+    }
+
+    /* Columns with 0 <= x0 - offset < WATERFALL_NFFT - 1, others are black */
+    uint16_t from = column_lower_bound(src_x_offset);
+    uint16_t to = column_lower_bound(src_x_offset + WATERFALL_NFFT - 1);
+
+    from = LV_CLAMP(x_from, from, x_to);
+    to = LV_CLAMP(from, to, x_to);
+
+    fill_black(dst, x_from, from);
+    row_kernel(row, src_x_offset, from, to, dst);
+    fill_black(dst, to, x_to);
+}
+
+static void render_row(wf_buf_t *buf, int64_t seq, int32_t center_freq) {
+    lv_color_t *dst = (lv_color_t *)buf->frame->data + frame_row(seq) * WIDTH;
+
+    render_cols(dst, seq, center_freq, 0, WIDTH);
+    memcpy(dst + height * WIDTH, dst, WIDTH * PX_BYTES);
+}
+
+/* Move the row by `shift` pixels (right if positive) and render only the exposed columns */
+static void shift_row(wf_buf_t *buf, int64_t seq, int32_t center_freq, int32_t shift) {
+    lv_color_t *dst = (lv_color_t *)buf->frame->data + frame_row(seq) * WIDTH;
+
+    if (shift > 0) {
+        memmove(dst + shift, dst, (WIDTH - shift) * PX_BYTES);
+        render_cols(dst, seq, center_freq, 0, shift);
+    } else {
+        memmove(dst, dst - shift, (WIDTH + shift) * PX_BYTES);
+        render_cols(dst, seq, center_freq, WIDTH + shift, WIDTH);
     }
+    memcpy(dst + height * WIDTH, dst, WIDTH * PX_BYTES);
+}
 
-    for (src_y = 0; src_y < height; src_y++) {
-        dst_y = ((height - src_y + last_row_id) % height);
-        src_x_offset = (freq_offsets[src_y] - wf_center_freq) * WATERFALL_NFFT / width_hz;
-        if ((src_x_offset > WATERFALL_NFFT) || (src_x_offset < -WATERFALL_NFFT)) {
-            memset((lv_color_t *)frame->data + dst_y * WIDTH, 0, WIDTH * PX_BYTES);
+/* Bring the buffer up to date, returns false if nothing changed */
+static bool render(wf_buf_t *buf) {
+    uint8_t         current_zoom = effective_zoom();
+    uint32_t        top = scroll_seq ? scroll_seq : wf_history_last();
+    int32_t         center_freq = wf_center_freq;
+    const uint32_t  *palette = wf_palette;
+    int32_t         shift = 0;
+    bool            full = !buf->valid ||
+                           (top < buf->seq) || (top - buf->seq >= height) ||
+                           (current_zoom != buf->zoom) ||
+                           (palette != buf->palette);
+
+    if (!full && center_freq != buf->center_freq) {
+        /* Tuning: whole pixels are moved, the remainder is carried to the next step */
+        int64_t units = (int64_t) (buf->center_freq - center_freq) * WIDTH * current_zoom + buf->shift_frac;
+
+        shift = units / width_hz;
+
+        if (abs(shift) >= WIDTH) {
+            full = true;
         } else {
-            for (dst_x = 0; dst_x < WIDTH; dst_x++) {
-                src_x0 = x0_arr[dst_x] - src_x_offset;
-                if ((src_x0 < 0) || (src_x0 >= WATERFALL_NFFT - 1)) {
-                    px_color = black;
-                } else {
-                    uint8_t * y0_p = waterfall_cache + (src_y * WATERFALL_NFFT + src_x0);
-                    uint8_t y = *y0_p + ((x0_dist[dst_x] * (*(y0_p+1) - *y0_p)) >> 3);
-                    px_color = (lv_color_t)wf_palette[y];
-                }
-                *((lv_color_t*)frame->data + (dst_y * WIDTH + dst_x)) = px_color;
+            buf->shift_frac = units - (int64_t) shift * width_hz;
+            buf->shifted = true;
+        }
+    } else if (!full && buf->shifted && center_freq == radio_center_freq) {
+        /* Moved pixels are within a pixel of the exact ones, redraw once the scroll is done */
+        full = true;
+    }
+
+    if (!full && !shift && top == buf->seq) {
+        buf->center_freq = center_freq;
+        return false;
+    }
+
+    /* waterfall_zoom param could be switched without zoom change */
+    if (current_zoom != map_zoom) {
+        build_column_map(current_zoom);
+    }
+
+    if (full) {
+        for (uint16_t i = 0; i < height; i++) {
+            render_row(buf, (int64_t) top - i, center_freq);
+        }
+        buf->shifted = false;
+        buf->shift_frac = 0;
+    } else {
+        if (shift) {
+            /* Rows which stay in the frame, older ones are replaced by the new rows */
+            for (int64_t seq = (int64_t) top - height + 1; seq <= buf->seq; seq++) {
+                shift_row(buf, seq, center_freq, shift);
             }
         }
+        /* Only rows arrived since the previous render */
+        for (uint32_t seq = buf->seq + 1; seq <= top; seq++) {
+            render_row(buf, seq, center_freq);
+        }
+    }
+
+    buf->valid = true;
+    buf->seq = top;
+    buf->zoom = current_zoom;
+    buf->center_freq = center_freq;
+    buf->palette = palette;
+    return true;
+}
+
+static void show_buf(wf_buf_t *buf) {
+    static bool first = true;
+
+    if (first) {
+        first = false;
+        boot_phase("waterfall");
+    }
+
+    view.data = buf->frame->data + frame_row(buf->seq) * WIDTH * PX_BYTES;
+    lv_img_cache_invalidate_src(&view);
+
+    if (clip) {
+        lv_obj_invalidate_area(img, &visible_area);
+    } else {
+        lv_obj_invalidate(img);
     }
 }
 
@@ -283,19 +592,111 @@ static void refresh_waterfall( void * arg) {
     refresh_counter++;
     if (refresh_counter >= refresh_period) {
         refresh_counter = 0;
-        redraw_cb(NULL);
-        lv_obj_invalidate(img);
+        if (render(&bufs[0])) {
+            show_buf(&bufs[0]);
+        }
+    }
+}
+
+static void publish_frame(void * arg) {
+    int front = 1 - atomic_load(&shown);
+
+    show_buf(&bufs[front]);
+    atomic_store(&shown, front);
+    atomic_store(&pending, false);
+
+    /* Rows could arrive while the frame was pending */
+    sem_post(&render_sem);
+}
+
+static void * render_thread(void *arg) {
+    set_thread_name("waterfall");
+
+    while (true) {
+        sem_wait(&render_sem);
+
+        if (atomic_load(&pending)) {
+            continue;
+        }
+        refresh_counter++;
+        if (refresh_counter < refresh_period) {
+            continue;
+        }
+        refresh_counter = 0;
+
+        if (render(&bufs[1 - atomic_load(&shown)])) {
+            atomic_store(&pending, true);
+            scheduler_put_coalesced(SCHEDULER_KEY_WATERFALL_FRAME, publish_frame, NULL, 0);
+        }
+    }
+    return NULL;
+}
+
+static void request_render() {
+    if (atomic_load(&covered)) {
+        return;
+    }
+    if (threaded) {
+        sem_post(&render_sem);
+    } else {
+        scheduler_put_coalesced(SCHEDULER_KEY_WATERFALL, refresh_waterfall, NULL, 0);
+    }
+}
+
+void waterfall_set_occluder(const lv_area_t *area) {
+    lv_area_t   visible;
+    bool        now_covered = !occlusion_visible_area(&img->coords, area, &visible);
+
+    clip = area != NULL;
+    visible_area = visible;
+
+    if (atomic_exchange(&covered, now_covered) && !now_covered) {
+        request_render();
+    }
+}
+
+void waterfall_redraw() {
+    request_render();
+}
+
+void waterfall_scroll(int32_t rows) {
+    uint32_t last = wf_history_last();
+    int64_t  top = (scroll_seq ? scroll_seq : last) - (int64_t) rows;
+    int64_t  oldest = (int64_t) wf_history_first() + height - 1;
+
+    if (top < oldest) {
+        top = oldest;
+    }
+    scroll_seq = (top >= last) ? 0 : top;
+    request_render();
+}
+
+void waterfall_scroll_reset() {
+    if (scroll_seq) {
+        scroll_seq = 0;
+        request_render();
     }
 }
 
 static void on_zoom_changed(Subject *subj, void *user_data) {
     zoom = subject_get_int(subj);
+    if (threaded) {
+        /* Column map is owned by the render thread */
+        request_render();
+    } else {
+        build_column_map(effective_zoom());
+    }
     lv_style_set_line_width(&middle_line_style, zoom / 2 + 2);
 }
 
 static void on_fg_freq_change(Subject *subj, void *user_data) {
-    delay = 2;
-    radio_center_freq = subject_get_int(subj);
+    int32_t new_freq = subject_get_int(subj);
+
+    /* DSP follows continuous tuning, skip rows only after jumps */
+    if (abs(new_freq - radio_center_freq) >= width_hz / 2) {
+        delay = 2;
+    }
+    radio_center_freq = new_freq;
 }
 
 static void on_lo_offset_change(Subject *subj, void *user_data) {
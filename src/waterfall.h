@@ -13,12 +13,43 @@
 
 #include "lvgl/lvgl.h"
 
+/* dB of the waterfall PSD: 10 * log10(|X|^2) + offset */
+#define WATERFALL_DB_OFFSET (-30.0f)
+
 lv_obj_t * waterfall_init(lv_obj_t * parent);
-void waterfall_data(float *data_buf, uint16_t size, bool tx);
+
+/**
+ * Row of the linear PSD, as of ChunkedSpgram::get_psd_mag(). Palette indexes are found by
+ * the thresholds of the grid range, without dB conversion. Called by the DSP
+ */
+void waterfall_data(const float *psd, uint16_t size, bool tx);
 void waterfall_set_height(lv_coord_t h);
 void waterfall_min_max_reset();
+void waterfall_get_range(float *min, float *max);
+
+/**
+ * Set the sides of the grid range which are auto (params), for a restored state
+ */
+void waterfall_set_auto_range(float min, float max);
 
 void waterfall_update_max(float db);
 void waterfall_update_min(float db);
 void waterfall_refresh_reset();
 void waterfall_refresh_period_set(uint8_t k);
+
+/**
+ * Opaque area on top of the waterfall (NULL - none). Only the visible part is
+ * invalidated, while fully covered rows go to history only
+ */
+void waterfall_set_occluder(const lv_area_t *area);
+
+/**
+ * Render the rows of history, after they were put not by waterfall_data()
+ */
+void waterfall_redraw();
+
+/**
+ * Scroll back through history by `rows` (negative - forward). New rows don't move scrolled view
+ */
+void waterfall_scroll(int32_t rows);
+void waterfall_scroll_reset();
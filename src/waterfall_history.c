@@ -0,0 +1,101 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#include "waterfall_history.h"
+#include "mem_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static pthread_mutex_t  mux = PTHREAD_MUTEX_INITIALIZER;
+
+static uint16_t         width = 0;
+static uint32_t         capacity = 0;
+static uint32_t         last_seq = 0;
+
+static int32_t          *freqs;
+static uint8_t          *packed;    /* capacity rows of width / 2 bytes */
+
+void wf_history_init(uint16_t w, uint32_t rows) {
+    pthread_mutex_lock(&mux);
+    mem_free(MEM_WATERFALL, freqs);
+    mem_free(MEM_WATERFALL, packed);
+
+    width = w & ~1;
+    capacity = rows;
+    last_seq = 0;
+    freqs = mem_alloc(MEM_WATERFALL, capacity * sizeof(*freqs));
+    packed = mem_alloc(MEM_WATERFALL, capacity * width / 2);
+    pthread_mutex_unlock(&mux);
+}
+
+uint32_t wf_history_put(const uint8_t *row, int32_t freq) {
+    pthread_mutex_lock(&mux);
+
+    if (!capacity) {
+        pthread_mutex_unlock(&mux);
+        return 0;
+    }
+
+    uint32_t    seq = ++last_seq;
+    uint32_t    slot = seq % capacity;
+    uint8_t     *dst = packed + slot * width / 2;
+
+    for (uint16_t x = 0; x < width; x += 2) {
+        *dst++ = (row[x] >> 4) | (row[x + 1] & 0xF0);
+    }
+    freqs[slot] = freq;
+
+    pthread_mutex_unlock(&mux);
+    return seq;
+}
+
+uint32_t wf_history_last() {
+    pthread_mutex_lock(&mux);
+    uint32_t res = last_seq;
+    pthread_mutex_unlock(&mux);
+
+    return res;
+}
+
+static uint32_t first_seq() {
+    return last_seq >= capacity ? last_seq - capacity + 1 : 1;
+}
+
+uint32_t wf_history_first() {
+    pthread_mutex_lock(&mux);
+    uint32_t res = first_seq();
+    pthread_mutex_unlock(&mux);
+
+    return res;
+}
+
+bool wf_history_get(uint32_t seq, uint8_t *row, int32_t *freq) {
+    pthread_mutex_lock(&mux);
+
+    if (seq == 0 || seq > last_seq || seq < first_seq()) {
+        pthread_mutex_unlock(&mux);
+        return false;
+    }
+
+    uint32_t        slot = seq % capacity;
+    const uint8_t   *src = packed + slot * width / 2;
+
+    /* 4 bits -> 8 bits with full range: v * 17 */
+    for (uint16_t x = 0; x < width; x += 2) {
+        uint8_t v = *src++;
+
+        row[x] = (v & 0x0F) * 17;
+        row[x + 1] = (v >> 4) * 17;
+    }
+    *freq = freqs[slot];
+
+    pthread_mutex_unlock(&mux);
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Xiegu X6100 LVGL GUI
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Bounded history of waterfall rows. Rows are stored with 4 bits per column together
+ * with the frequency they were taken at. Every row gets increasing sequence number,
+ * starting from 1. Safe to use from DSP and render threads.
+ */
+
+void wf_history_init(uint16_t width, uint32_t rows);
+
+/**
+ * Append row of `width` palette ids (0..255). Returns sequence number of the row
+ */
+uint32_t wf_history_put(const uint8_t *row, int32_t freq);
+
+/**
+ * Sequence number of the newest row, 0 if history is empty
+ */
+uint32_t wf_history_last();
+
+/**
+ * Sequence number of the oldest row still stored
+ */
+uint32_t wf_history_first();
+
+/**
+ * Unpack row to palette ids. Returns false, if row is not stored (too old or not yet arrived)
+ */
+bool wf_history_get(uint32_t seq, uint8_t *row, int32_t *freq);
@@ -0,0 +1,439 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+
+#include "lv_msg_list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_CLASS &lv_msg_list_class
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void lv_msg_list_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
+static void lv_msg_list_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
+static void lv_msg_list_event(const lv_obj_class_t * class_p, lv_event_t * e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+const lv_obj_class_t lv_msg_list_class = {
+    .constructor_cb = lv_msg_list_constructor,
+    .destructor_cb = lv_msg_list_destructor,
+    .event_cb = lv_msg_list_event,
+    .editable = LV_OBJ_CLASS_EDITABLE_TRUE,
+    .group_def = LV_OBJ_CLASS_GROUP_DEF_TRUE,
+    .base_class = &lv_obj_class,
+    .instance_size = sizeof(lv_msg_list_t),
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static lv_coord_t row_height(lv_obj_t * obj) {
+    const lv_font_t *font = lv_obj_get_style_text_font(obj, LV_PART_ITEMS);
+
+    return lv_font_get_line_height(font) + lv_obj_get_style_pad_top(obj, LV_PART_ITEMS) +
+           lv_obj_get_style_pad_bottom(obj, LV_PART_ITEMS);
+}
+
+static uint32_t visible_rows(lv_obj_t * obj) {
+    lv_coord_t rows = lv_obj_get_content_height(obj) / row_height(obj);
+
+    return rows > 0 ? rows : 1;
+}
+
+static void limit_top(lv_msg_list_t * list, uint32_t rows) {
+    uint32_t max_top = list->count > rows ? list->count - rows : 0;
+
+    if (list->top > max_top) {
+        list->top = max_top;
+    }
+}
+
+static void show_selected(lv_obj_t * obj) {
+    lv_msg_list_t   *list = (lv_msg_list_t *)obj;
+    uint32_t        rows = visible_rows(obj);
+
+    if (list->selected != LV_MSG_LIST_NONE) {
+        if (list->selected < list->top) {
+            list->top = list->selected;
+        } else if (list->selected >= list->top + rows) {
+            list->top = list->selected - rows + 1;
+        }
+    }
+    limit_top(list, rows);
+    lv_obj_invalidate(obj);
+}
+
+static void scroll_rows(lv_obj_t * obj, int32_t diff) {
+    lv_msg_list_t   *list = (lv_msg_list_t *)obj;
+
+    if (diff < 0 && list->top < (uint32_t) -diff) {
+        list->top = 0;
+    } else {
+        list->top += diff;
+    }
+    limit_top(list, visible_rows(obj));
+    lv_obj_invalidate(obj);
+}
+
+static void draw_row(lv_obj_t * obj, lv_draw_ctx_t * draw_ctx, uint32_t id, const char * text, const lv_area_t * area) {
+    lv_draw_rect_dsc_t      rect_dsc;
+    lv_draw_label_dsc_t     label_dsc;
+    lv_obj_draw_part_dsc_t  part_dsc;
+    lv_area_t               text_area;
+
+    lv_draw_rect_dsc_init(&rect_dsc);
+    lv_obj_init_draw_rect_dsc(obj, LV_PART_ITEMS, &rect_dsc);
+    lv_draw_label_dsc_init(&label_dsc);
+    lv_obj_init_draw_label_dsc(obj, LV_PART_ITEMS, &label_dsc);
+
+    lv_obj_draw_dsc_init(&part_dsc, draw_ctx);
+    part_dsc.part = LV_PART_ITEMS;
+    part_dsc.class_p = MY_CLASS;
+    part_dsc.id = id;
+    part_dsc.draw_area = area;
+    part_dsc.rect_dsc = &rect_dsc;
+    part_dsc.label_dsc = &label_dsc;
+
+    lv_event_send(obj, LV_EVENT_DRAW_PART_BEGIN, &part_dsc);
+
+    lv_draw_rect(draw_ctx, &rect_dsc, area);
+
+    text_area.x1 = area->x1 + lv_obj_get_style_pad_left(obj, LV_PART_ITEMS);
+    text_area.x2 = area->x2 - lv_obj_get_style_pad_right(obj, LV_PART_ITEMS);
+    text_area.y1 = area->y1 + lv_obj_get_style_pad_top(obj, LV_PART_ITEMS);
+    text_area.y2 = area->y2 - lv_obj_get_style_pad_bottom(obj, LV_PART_ITEMS);
+
+    if (text) {
+        lv_draw_label(draw_ctx, &label_dsc, &text_area, text, NULL);
+    }
+
+    lv_event_send(obj, LV_EVENT_DRAW_PART_END, &part_dsc);
+}
+
+static void draw_rows(lv_obj_t * obj, lv_draw_ctx_t * draw_ctx) {
+    lv_msg_list_t   *list = (lv_msg_list_t *)obj;
+    lv_coord_t      row_h = row_height(obj);
+    lv_area_t       content;
+    lv_area_t       clip;
+    lv_area_t       area;
+
+    lv_obj_get_content_coords(obj, &content);
+
+    if (!_lv_area_intersect(&clip, draw_ctx->clip_area, &content)) {
+        return;
+    }
+
+    const lv_area_t *clip_ori = draw_ctx->clip_area;
+
+    draw_ctx->clip_area = &clip;
+
+    area.x1 = content.x1;
+    area.x2 = content.x2;
+    area.y1 = content.y1;
+
+    if (list->count == 0) {
+        if (list->placeholder) {
+            area.y2 = area.y1 + row_h - 1;
+            draw_row(obj, draw_ctx, LV_MSG_LIST_NONE, list->placeholder, &area);
+        }
+    } else {
+        for (uint32_t i = list->top; i < list->count && area.y1 <= content.y2; i++) {
+            area.y2 = area.y1 + row_h - 1;
+
+            if (area.y2 >= clip.y1) {
+                const void *item = lv_msg_list_get_item(obj, i);
+
+                draw_row(obj, draw_ctx, i, list->text_cb ? list->text_cb(item) : NULL, &area);
+            }
+            area.y1 += row_h;
+        }
+    }
+
+    draw_ctx->clip_area = clip_ori;
+}
+
+static void press(lv_obj_t * obj) {
+    lv_msg_list_t   *list = (lv_msg_list_t *)obj;
+    lv_indev_t      *indev = lv_indev_get_act();
+
+    list->drag_y = 0;
+
+    if (!indev || lv_indev_get_type(indev) != LV_INDEV_TYPE_POINTER) {
+        return;
+    }
+
+    lv_point_t  p;
+    lv_area_t   content;
+
+    lv_indev_get_point(indev, &p);
+    lv_obj_get_content_coords(obj, &content);
+
+    if (p.y < content.y1) {
+        return;
+    }
+
+    uint32_t row = list->top + (p.y - content.y1) / row_height(obj);
+
+    if (row < list->count) {
+        list->selected = row;
+        lv_obj_invalidate(obj);
+    }
+}
+
+static void drag(lv_obj_t * obj) {
+    lv_msg_list_t   *list = (lv_msg_list_t *)obj;
+    lv_indev_t      *indev = lv_indev_get_act();
+    lv_coord_t      row_h = row_height(obj);
+    lv_point_t      vect;
+
+    if (!indev || lv_indev_get_type(indev) != LV_INDEV_TYPE_POINTER) {
+        return;
+    }
+
+    lv_indev_get_vect(indev, &vect);
+    list->drag_y += vect.y;
+
+    // Moving up shows newer rows
+    int32_t rows = -list->drag_y / row_h;
+
+    if (rows != 0) {
+        list->drag_y += rows * row_h;
+        scroll_rows(obj, rows);
+    }
+}
+
+static void key(lv_obj_t * obj, uint32_t c) {
+    lv_msg_list_t   *list = (lv_msg_list_t *)obj;
+
+    if (list->count == 0) {
+        return;
+    }
+
+    switch (c) {
+        case LV_KEY_UP:
+        case LV_KEY_LEFT:
+            if (list->selected > 0) {
+                list->selected--;
+            }
+            break;
+
+        case LV_KEY_DOWN:
+        case LV_KEY_RIGHT:
+            if (list->selected + 1 < list->count) {
+                list->selected++;
+            }
+            break;
+
+        default:
+            return;
+    }
+    show_selected(obj);
+}
+
+static void lv_msg_list_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj) {
+    LV_UNUSED(class_p);
+    LV_TRACE_OBJ_CREATE("begin");
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    list->items = NULL;
+    list->item_size = 0;
+    list->capacity = 0;
+    list->first = 0;
+    list->count = 0;
+    list->top = 0;
+    list->selected = LV_MSG_LIST_NONE;
+    list->drag_y = 0;
+    list->text_cb = NULL;
+    list->placeholder = NULL;
+
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+
+    LV_TRACE_OBJ_CREATE("finished");
+}
+
+static void lv_msg_list_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj) {
+    LV_UNUSED(class_p);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    free(list->items);
+    list->items = NULL;
+}
+
+static void lv_msg_list_event(const lv_obj_class_t * class_p, lv_event_t * e) {
+    LV_UNUSED(class_p);
+
+    lv_res_t res = lv_obj_event_base(MY_CLASS, e);
+
+    if (res != LV_RES_OK) return;
+
+    lv_event_code_t code = lv_event_get_code(e);
+    lv_obj_t * obj = lv_event_get_target(e);
+
+    switch (code) {
+        case LV_EVENT_DRAW_MAIN:
+            draw_rows(obj, lv_event_get_draw_ctx(e));
+            break;
+
+        case LV_EVENT_PRESSED:
+            press(obj);
+            break;
+
+        case LV_EVENT_PRESSING:
+            drag(obj);
+            break;
+
+        case LV_EVENT_KEY:
+            key(obj, lv_event_get_key(e));
+            break;
+
+        case LV_EVENT_SIZE_CHANGED:
+            show_selected(obj);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_obj_t * lv_msg_list_create(lv_obj_t * parent) {
+    LV_LOG_INFO("begin");
+    lv_obj_t * obj = lv_obj_class_create_obj(MY_CLASS, parent);
+    lv_obj_class_init_obj(obj);
+
+    return obj;
+}
+
+/*=====================
+ * Setter functions
+ *====================*/
+
+void lv_msg_list_set_items(lv_obj_t * obj, uint32_t item_size, uint32_t capacity, lv_msg_list_text_cb_t text_cb) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    free(list->items);
+
+    list->items = malloc(item_size * capacity);
+    list->item_size = item_size;
+    list->capacity = list->items ? capacity : 0;
+    list->text_cb = text_cb;
+
+    lv_msg_list_clear(obj);
+}
+
+void lv_msg_list_set_placeholder(lv_obj_t * obj, const char * text) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    list->placeholder = text;
+    lv_obj_invalidate(obj);
+}
+
+void lv_msg_list_set_selected(lv_obj_t * obj, uint32_t idx) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    if (idx < list->count) {
+        list->selected = idx;
+        show_selected(obj);
+    }
+}
+
+void lv_msg_list_append(lv_obj_t * obj, const void * item) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    if (list->capacity == 0) {
+        return;
+    }
+
+    bool follow = (list->count == 0) || (list->selected + 1 == list->count);
+
+    if (list->count == list->capacity) {
+        list->first = (list->first + 1) % list->capacity;
+        list->count--;
+
+        if (list->selected > 0) {
+            list->selected--;
+        }
+        if (list->top > 0) {
+            list->top--;
+        }
+    }
+
+    uint32_t pos = (list->first + list->count) % list->capacity;
+
+    memcpy(list->items + pos * list->item_size, item, list->item_size);
+    list->count++;
+
+    if (follow) {
+        list->selected = list->count - 1;
+    }
+    show_selected(obj);
+}
+
+void lv_msg_list_clear(lv_obj_t * obj) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    list->first = 0;
+    list->count = 0;
+    list->top = 0;
+    list->selected = LV_MSG_LIST_NONE;
+    lv_obj_invalidate(obj);
+}
+
+/*=====================
+ * Getter functions
+ *====================*/
+
+uint32_t lv_msg_list_get_count(lv_obj_t * obj) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    return ((lv_msg_list_t *)obj)->count;
+}
+
+uint32_t lv_msg_list_get_selected(lv_obj_t * obj) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    return ((lv_msg_list_t *)obj)->selected;
+}
+
+void * lv_msg_list_get_item(lv_obj_t * obj, uint32_t idx) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_msg_list_t * list = (lv_msg_list_t *)obj;
+
+    if (idx >= list->count) {
+        return NULL;
+    }
+    return list->items + ((list->first + idx) % list->capacity) * list->item_size;
+}
@@ -0,0 +1,96 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#ifndef LV_MSG_LIST_H
+#define LV_MSG_LIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define LV_MSG_LIST_NONE    UINT32_MAX
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef const char * (*lv_msg_list_text_cb_t)(const void *item);
+
+/**
+ * Single column list of fixed size items in a ring. Only visible rows are drawn,
+ * for each of them LV_EVENT_DRAW_PART_BEGIN/END of LV_PART_ITEMS is sent with the
+ * item index in `id` (LV_MSG_LIST_NONE for the placeholder), like lv_table does
+ */
+typedef struct {
+    lv_obj_t                obj;
+
+    uint8_t                 *items;
+    uint32_t                item_size;
+    uint32_t                capacity;
+    uint32_t                first;      // Ring position of the oldest item
+    uint32_t                count;
+
+    uint32_t                top;        // Index of the first visible row
+    uint32_t                selected;
+    lv_coord_t              drag_y;     // Not scrolled yet pointer move
+
+    lv_msg_list_text_cb_t   text_cb;
+    const char              *placeholder;
+} lv_msg_list_t;
+
+extern const lv_obj_class_t lv_msg_list_class;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+lv_obj_t * lv_msg_list_create(lv_obj_t * parent);
+
+/*=====================
+ * Setter functions
+ *====================*/
+
+/**
+ * Allocate ring of `capacity` items, the list is cleared
+ */
+void lv_msg_list_set_items(lv_obj_t * obj, uint32_t item_size, uint32_t capacity, lv_msg_list_text_cb_t text_cb);
+void lv_msg_list_set_placeholder(lv_obj_t * obj, const char * text);
+void lv_msg_list_set_selected(lv_obj_t * obj, uint32_t idx);
+
+/**
+ * Copy item to the end, the oldest one is dropped on full ring. Selection on the
+ * last item follows the new one
+ */
+void lv_msg_list_append(lv_obj_t * obj, const void * item);
+void lv_msg_list_clear(lv_obj_t * obj);
+
+/*=====================
+ * Getter functions
+ *====================*/
+
+uint32_t lv_msg_list_get_count(lv_obj_t * obj);
+uint32_t lv_msg_list_get_selected(lv_obj_t * obj);
+
+/**
+ * Item by index, 0 - the oldest. NULL, if out of range
+ */
+void * lv_msg_list_get_item(lv_obj_t * obj, uint32_t idx);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif
@@ -0,0 +1,357 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+
+#include "lv_spectrum.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_CLASS &lv_spectrum_class
+
+#if LV_COLOR_DEPTH != 32
+#error "lv_spectrum writes 32 bit pixels directly"
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void lv_spectrum_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
+static void lv_spectrum_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
+static void lv_spectrum_event(const lv_obj_class_t * class_p, lv_event_t * e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+const lv_obj_class_t lv_spectrum_class  = {
+    .constructor_cb = lv_spectrum_constructor,
+    .destructor_cb = lv_spectrum_destructor,
+    .event_cb = lv_spectrum_event,
+    .base_class = &lv_obj_class,
+    .instance_size = sizeof(lv_spectrum_t),
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void free_buf(lv_spectrum_t * spectrum) {
+    if (spectrum->dsc) lv_img_buf_free(spectrum->dsc);
+    if (spectrum->span_top) lv_mem_free(spectrum->span_top);
+    if (spectrum->span_bottom) lv_mem_free(spectrum->span_bottom);
+    if (spectrum->keys) lv_mem_free(spectrum->keys);
+
+    spectrum->dsc = NULL;
+    spectrum->keys = NULL;
+    spectrum->span_top = NULL;
+    spectrum->span_bottom = NULL;
+}
+
+/* (Re)allocate buffer for the current object size, returns false if size is zero */
+static bool check_buf(lv_spectrum_t * spectrum) {
+    lv_obj_t    *obj = (lv_obj_t *)spectrum;
+    lv_coord_t  w = lv_obj_get_width(obj);
+    lv_coord_t  h = lv_obj_get_height(obj);
+
+    if (w <= 0 || h <= 0) {
+        return false;
+    }
+    if (spectrum->dsc && spectrum->dsc->header.w == w && spectrum->dsc->header.h == h) {
+        return true;
+    }
+
+    free_buf(spectrum);
+
+    spectrum->dsc = lv_img_buf_alloc(w, h, LV_IMG_CF_TRUE_COLOR);
+    spectrum->span_top = lv_mem_alloc(w * sizeof(lv_coord_t));
+    spectrum->span_bottom = lv_mem_alloc(w * sizeof(lv_coord_t));
+    spectrum->keys = lv_mem_alloc(w * sizeof(uint64_t));
+    spectrum->full_redraw = true;
+
+    lv_color_t  bg = lv_obj_get_style_bg_color(obj, LV_PART_MAIN);
+    lv_color_t  *px = (lv_color_t *)spectrum->dsc->data;
+
+    for (uint32_t i = 0; i < (uint32_t)w * h; i++) {
+        px[i] = bg;
+    }
+    for (lv_coord_t x = 0; x < w; x++) {
+        spectrum->span_top[x] = 0;
+        spectrum->span_bottom[x] = 0;
+        spectrum->keys[x] = 0;
+    }
+    return true;
+}
+
+static inline lv_coord_t value_y(float v, float min, float max, lv_coord_t h) {
+    float y = (1.0f - (v - min) / (max - min)) * h;
+
+    if (y < 0.0f) {
+        return 0;
+    }
+    if (y > h - 1) {
+        return h - 1;
+    }
+    return (lv_coord_t) y;
+}
+
+static inline void fill_span(lv_color_t * col, lv_coord_t stride, lv_coord_t from, lv_coord_t to, lv_color_t c) {
+    for (lv_coord_t y = from; y < to; y++) {
+        col[y * stride] = c;
+    }
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_obj_t * lv_spectrum_create(lv_obj_t * parent) {
+    LV_LOG_INFO("begin");
+    lv_obj_t * obj = lv_obj_class_create_obj(MY_CLASS, parent);
+    lv_obj_class_init_obj(obj);
+
+    return obj;
+}
+
+/*=====================
+ * Setter functions
+ *====================*/
+
+void lv_spectrum_set_colors(lv_obj_t * obj, lv_color_t main, lv_color_t peak) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_spectrum_t * spectrum = (lv_spectrum_t *)obj;
+
+    spectrum->main_color = main;
+    spectrum->peak_color = peak;
+}
+
+void lv_spectrum_set_filled(lv_obj_t * obj, bool filled) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_spectrum_t * spectrum = (lv_spectrum_t *)obj;
+
+    spectrum->filled = filled;
+}
+
+void lv_spectrum_set_data(lv_obj_t * obj, const float * data, const float * peak, uint16_t cnt,
+                          float min, float max, lv_coord_t x_offset)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_spectrum_t * spectrum = (lv_spectrum_t *)obj;
+
+    if (!cnt) {
+        return;
+    }
+
+    if (!check_buf(spectrum)) {
+        return;
+    }
+
+    bool full = spectrum->full_redraw;
+
+    spectrum->full_redraw = false;
+
+    lv_coord_t  w = spectrum->dsc->header.w;
+    lv_coord_t  h = spectrum->dsc->header.h;
+    lv_color_t  *px = (lv_color_t *)spectrum->dsc->data;
+    lv_color_t  bg = lv_obj_get_style_bg_color(obj, LV_PART_MAIN);
+    lv_coord_t  main_prev = h, peak_prev = h;
+    lv_coord_t  band_w = (w + LV_SPECTRUM_DIRTY_BANDS - 1) / LV_SPECTRUM_DIRTY_BANDS;
+    lv_coord_t  dirty_top[LV_SPECTRUM_DIRTY_BANDS];
+    lv_coord_t  dirty_bottom[LV_SPECTRUM_DIRTY_BANDS];
+
+    for (uint8_t b = 0; b < LV_SPECTRUM_DIRTY_BANDS; b++) {
+        dirty_top[b] = h;
+        dirty_bottom[b] = 0;
+    }
+
+    for (lv_coord_t x = 0; x < w; x++) {
+        lv_coord_t  main_from = 0, main_to = 0;
+        lv_coord_t  peak_from = 0, peak_to = 0;
+        int32_t     src_x = x - x_offset;
+
+        if (src_x >= 0 && src_x < w) {
+            uint16_t i = (uint32_t)src_x * cnt / w;
+
+            /* Peak: connect with previous column */
+
+            if (peak) {
+                lv_coord_t y = value_y(peak[i], min, max, h);
+
+                peak_from = LV_MIN(y, peak_prev);
+                peak_to = LV_MIN(LV_MAX(y, peak_prev) + 1, h);
+                peak_prev = y;
+            }
+
+            /* Main */
+
+            lv_coord_t y = value_y(data[i], min, max, h);
+
+            if (spectrum->filled) {
+                main_from = y;
+                main_to = h;
+            } else {
+                main_from = LV_MIN(y, main_prev);
+                main_to = LV_MIN(LV_MAX(y, main_prev) + 1, h);
+            }
+            main_prev = y;
+        }
+
+        /* Column content is defined by its spans only */
+
+        uint64_t key = ((uint64_t)(uint16_t)main_from << 48) | ((uint64_t)(uint16_t)main_to << 32) |
+                       ((uint64_t)(uint16_t)peak_from << 16) | (uint16_t)peak_to;
+
+        if (key == spectrum->keys[x]) {
+            continue;
+        }
+        spectrum->keys[x] = key;
+
+        lv_color_t  *col = px + x;
+        lv_coord_t  top = h, bottom = 0;
+
+        /* Erase previous trace */
+
+        fill_span(col, w, spectrum->span_top[x], spectrum->span_bottom[x], bg);
+
+        if (peak_to > peak_from) {
+            fill_span(col, w, peak_from, peak_to, spectrum->peak_color);
+            top = peak_from;
+            bottom = peak_to;
+        }
+        if (main_to > main_from) {
+            fill_span(col, w, main_from, main_to, spectrum->main_color);
+            top = LV_MIN(top, main_from);
+            bottom = LV_MAX(bottom, main_to);
+        }
+
+        /* Changed pixels: union of previous and new spans */
+
+        uint8_t b = x / band_w;
+
+        if (spectrum->span_bottom[x] > spectrum->span_top[x]) {
+            dirty_top[b] = LV_MIN(dirty_top[b], spectrum->span_top[x]);
+            dirty_bottom[b] = LV_MAX(dirty_bottom[b], spectrum->span_bottom[x]);
+        }
+        if (bottom > top) {
+            dirty_top[b] = LV_MIN(dirty_top[b], top);
+            dirty_bottom[b] = LV_MAX(dirty_bottom[b], bottom);
+        }
+
+        spectrum->span_top[x] = top;
+        spectrum->span_bottom[x] = LV_MAX(top, bottom);
+    }
+
+    if (full) {
+        if (spectrum->clip) {
+            lv_obj_invalidate_area(obj, &spectrum->visible);
+        } else {
+            lv_obj_invalidate(obj);
+        }
+        return;
+    }
+
+    for (uint8_t b = 0; b < LV_SPECTRUM_DIRTY_BANDS; b++) {
+        if (dirty_bottom[b] <= dirty_top[b]) {
+            continue;
+        }
+
+        lv_area_t area;
+
+        area.x1 = obj->coords.x1 + b * band_w;
+        area.x2 = LV_MIN(area.x1 + band_w, obj->coords.x1 + w) - 1;
+        area.y1 = obj->coords.y1 + dirty_top[b];
+        area.y2 = obj->coords.y1 + dirty_bottom[b] - 1;
+
+        if (spectrum->clip && !_lv_area_intersect(&area, &area, &spectrum->visible)) {
+            continue;
+        }
+        lv_obj_invalidate_area(obj, &area);
+    }
+}
+
+void lv_spectrum_invalidate_all(lv_obj_t * obj) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_spectrum_t * spectrum = (lv_spectrum_t *)obj;
+
+    spectrum->full_redraw = true;
+}
+
+void lv_spectrum_set_visible_area(lv_obj_t * obj, const lv_area_t * area) {
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_spectrum_t * spectrum = (lv_spectrum_t *)obj;
+
+    spectrum->clip = area != NULL;
+    if (area) {
+        spectrum->visible = *area;
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void lv_spectrum_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj) {
+    LV_UNUSED(class_p);
+    LV_TRACE_OBJ_CREATE("begin");
+
+    lv_spectrum_t * spectrum = (lv_spectrum_t *)obj;
+
+    spectrum->dsc = NULL;
+    spectrum->span_top = NULL;
+    spectrum->span_bottom = NULL;
+    spectrum->keys = NULL;
+    spectrum->full_redraw = false;
+    spectrum->clip = false;
+    spectrum->main_color = lv_color_hex(0xAAAAAA);
+    spectrum->peak_color = lv_color_hex(0x555555);
+    spectrum->filled = false;
+
+    LV_TRACE_OBJ_CREATE("finished");
+}
+
+static void lv_spectrum_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj) {
+    LV_UNUSED(class_p);
+
+    free_buf((lv_spectrum_t *)obj);
+}
+
+static void lv_spectrum_event(const lv_obj_class_t * class_p, lv_event_t * e) {
+    LV_UNUSED(class_p);
+
+    if (lv_obj_event_base(MY_CLASS, e) != LV_RES_OK) {
+        return;
+    }
+
+    lv_obj_t        *obj = lv_event_get_target(e);
+    lv_spectrum_t   *spectrum = (lv_spectrum_t *)obj;
+
+    if (lv_event_get_code(e) != LV_EVENT_DRAW_MAIN || !spectrum->dsc) {
+        return;
+    }
+
+    lv_draw_ctx_t       *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_img_dsc_t   img_dsc;
+    lv_area_t           area;
+
+    lv_draw_img_dsc_init(&img_dsc);
+
+    area.x1 = obj->coords.x1;
+    area.y1 = obj->coords.y1;
+    area.x2 = area.x1 + spectrum->dsc->header.w - 1;
+    area.y2 = area.y1 + spectrum->dsc->header.h - 1;
+
+    lv_img_cache_invalidate_src(spectrum->dsc);
+    lv_draw_img(draw_ctx, &img_dsc, &area, spectrum->dsc);
+}
@@ -0,0 +1,93 @@
+/*
+ *  SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  Copyright (c) 2024 Georgy Dyuldin aka R2RFE
+ */
+
+#ifndef LV_SPECTRUM_H
+#define LV_SPECTRUM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Column bands for partial invalidation */
+#define LV_SPECTRUM_DIRTY_BANDS 16
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/*
+ * Spectrum trace, rasterized with vertical spans into own opaque image buffer.
+ * Filled with the background color of LV_PART_MAIN, overlays could be drawn on top
+ * in LV_EVENT_DRAW_MAIN_END.
+ */
+typedef struct {
+    lv_obj_t        obj;
+    lv_img_dsc_t    *dsc;
+
+    /* Pixels [top, bottom) of each column, painted by last rasterize */
+    lv_coord_t      *span_top;
+    lv_coord_t      *span_bottom;
+    /* Packed spans of each column, to skip unchanged ones */
+    uint64_t        *keys;
+    bool            full_redraw;
+
+    /* Invalidation is clipped to this area while part of the object is covered */
+    lv_area_t       visible;
+    bool            clip;
+
+    lv_color_t      main_color;
+    lv_color_t      peak_color;
+    bool            filled;
+} lv_spectrum_t;
+
+extern const lv_obj_class_t lv_spectrum_class;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+lv_obj_t * lv_spectrum_create(lv_obj_t * parent);
+
+/*=====================
+ * Setter functions
+ *====================*/
+
+void lv_spectrum_set_colors(lv_obj_t * obj, lv_color_t main, lv_color_t peak);
+void lv_spectrum_set_filled(lv_obj_t * obj, bool filled);
+
+/**
+ * Rasterize trace of `cnt` bins (and optional peak trace) scaled to min..max and
+ * shifted by x_offset pixels. Only column bands with changed pixels are invalidated
+ */
+void lv_spectrum_set_data(lv_obj_t * obj, const float * data, const float * peak, uint16_t cnt,
+                          float min, float max, lv_coord_t x_offset);
+
+/**
+ * Invalidate whole object on next lv_spectrum_set_data(), e.g. when overlays are changed
+ */
+void lv_spectrum_invalidate_all(lv_obj_t * obj);
+
+/**
+ * Invalidate only the visible part (absolute coords) of the object, NULL - all of it.
+ * The trace is still rasterized in full
+ */
+void lv_spectrum_set_visible_area(lv_obj_t * obj, const lv_area_t * area);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif
@@ -21,6 +21,7 @@
 
 static void lv_waterfall_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
 static void lv_waterfall_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
+static void lv_waterfall_event(const lv_obj_class_t * class_p, lv_event_t * e);
 
 /**********************
  *  STATIC VARIABLES
@@ -29,6 +30,7 @@ static void lv_waterfall_destructor(const lv_obj_class_t * class_p, lv_obj_t * o
 const lv_obj_class_t lv_waterfall_class  = {
     .constructor_cb = lv_waterfall_constructor,
     .destructor_cb = lv_waterfall_destructor,
+    .event_cb = lv_waterfall_event,
     .base_class = &lv_img_class,
     .instance_size = sizeof(lv_waterfall_t),
 };
@@ -73,6 +75,11 @@ void lv_waterfall_set_size(lv_obj_t * obj, lv_coord_t w, lv_coord_t h) {
 
     waterfall->line_len = waterfall->dsc->data_size / waterfall->dsc->header.h;
     waterfall->line_buf = lv_mem_realloc(waterfall->line_buf, waterfall->line_len);
+    waterfall->head = 0;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        waterfall->parts[i] = *waterfall->dsc;
+    }
 
     lv_img_set_src(obj, waterfall->dsc);
     lv_img_cache_invalidate_src(waterfall->dsc);
@@ -85,6 +92,7 @@ void lv_waterfall_clear_data(lv_obj_t * obj) {
 
     memset(waterfall->dsc->data, 0, waterfall->dsc->data_size);
     lv_img_cache_invalidate_src(waterfall->dsc);
+    waterfall->head = 0;
 }
 
 void lv_waterfall_add_data(lv_obj_t * obj, float * data, uint16_t cnt) {
@@ -97,29 +105,35 @@ void lv_waterfall_add_data(lv_obj_t * obj, float * data, uint16_t cnt) {
         return;
     }
 
-    uint32_t        line_len = waterfall->line_len;
+    uint32_t        w = dsc->header.w;
+    uint16_t        head = waterfall->head ? waterfall->head - 1 : dsc->header.h - 1;
 
-    /* Scroll down */
+    /* Paint over the oldest row, it becomes the newest one */
 
-    memmove(dsc->data + line_len, dsc->data, dsc->data_size - line_len);
+    lv_color_t      *row = (lv_color_t *)(dsc->data + head * waterfall->line_len);
+    float           k = (float)(waterfall->palette_cnt - 1) / (waterfall->max - waterfall->min);
+    uint32_t        index = 0, acc = 0;
 
-    /* Paint */
-
-    for (uint32_t x = 0; x < dsc->header.w; x++) {
-        uint32_t    index = x * cnt / dsc->header.w;
-        float       d = data[index];
-        float       v = (d - waterfall->min) / (waterfall->max - waterfall->min);
+    for (uint32_t x = 0; x < w; x++) {
+        float v = (data[index] - waterfall->min) * k;
 
         if (v < 0.0f) {
             v = 0.0f;
-        } else if (v > 1.0f) {
-            v = 1.0f;
+        } else if (v > waterfall->palette_cnt - 1) {
+            v = waterfall->palette_cnt - 1;
         }
 
-        uint8_t id = v * 255;
+        row[x] = waterfall->palette[(uint16_t) v];
 
-        lv_img_buf_set_px_color(dsc, x, 0, waterfall->palette[id]);
+        /* index = x * cnt / w */
+        acc += cnt;
+        while (acc >= w) {
+            acc -= w;
+            index++;
+        }
     }
+
+    waterfall->head = head;
 }
 
 void lv_waterfall_set_min(lv_obj_t * obj, int16_t val) {
@@ -147,6 +161,8 @@ static void lv_waterfall_constructor(const lv_obj_class_t * class_p, lv_obj_t *
     waterfall->palette_cnt = 0;
     waterfall->line_len = 0;
     waterfall->line_buf = NULL;
+    waterfall->dsc = NULL;
+    waterfall->head = 0;
     waterfall->min = -40;
     waterfall->max = 0;
 
@@ -160,3 +176,59 @@ static void lv_waterfall_destructor(const lv_obj_class_t * class_p, lv_obj_t * o
     if (waterfall->palette) lv_mem_free(waterfall->palette);
     if (waterfall->line_buf) lv_mem_free(waterfall->line_buf);
 }
+
+static void lv_waterfall_event(const lv_obj_class_t * class_p, lv_event_t * e) {
+    LV_UNUSED(class_p);
+
+    lv_obj_t        *obj = lv_event_get_target(e);
+    lv_waterfall_t  *waterfall = (lv_waterfall_t *)obj;
+
+    if (lv_event_get_code(e) != LV_EVENT_DRAW_MAIN || !waterfall->dsc) {
+        lv_obj_event_base(MY_CLASS, e);
+        return;
+    }
+
+    /* Background of lv_obj, but not the image itself */
+    if (lv_obj_event_base(&lv_img_class, e) != LV_RES_OK) {
+        return;
+    }
+
+    /* Two blits instead of the image: rows head..h-1 on top, then 0..head-1 */
+
+    lv_draw_ctx_t       *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_img_dsc_t        *dsc = waterfall->dsc;
+    uint16_t            head = waterfall->head;
+    uint16_t            h = dsc->header.h;
+    lv_draw_img_dsc_t   img_dsc;
+    lv_area_t           area;
+
+    lv_draw_img_dsc_init(&img_dsc);
+    lv_obj_init_draw_img_dsc(obj, LV_PART_MAIN, &img_dsc);
+
+    lv_img_dsc_t *top = &waterfall->parts[0];
+    lv_img_dsc_t *bottom = &waterfall->parts[1];
+
+    top->data = dsc->data + head * waterfall->line_len;
+    top->header.h = h - head;
+    top->data_size = top->header.h * waterfall->line_len;
+
+    bottom->data = dsc->data;
+    bottom->header.h = head;
+    bottom->data_size = head * waterfall->line_len;
+
+    area.x1 = obj->coords.x1;
+    area.x2 = obj->coords.x1 + dsc->header.w - 1;
+    area.y1 = obj->coords.y1;
+    area.y2 = area.y1 + top->header.h - 1;
+
+    lv_img_cache_invalidate_src(top);
+    lv_draw_img(draw_ctx, &img_dsc, &area, top);
+
+    if (head) {
+        area.y1 = area.y2 + 1;
+        area.y2 = area.y1 + head - 1;
+
+        lv_img_cache_invalidate_src(bottom);
+        lv_draw_img(draw_ctx, &img_dsc, &area, bottom);
+    }
+}
@@ -25,6 +25,10 @@ typedef struct {
     lv_img_t        obj;
     lv_img_dsc_t    *dsc;
 
+    /* Rows ring, newest row is at head. Drawn as two parts: head..h-1 and 0..head-1 */
+    lv_img_dsc_t    parts[2];
+    volatile uint16_t head;
+
     uint32_t        line_len;
     uint8_t         *line_buf;
 
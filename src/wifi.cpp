@@ -15,11 +15,14 @@ extern "C" {
 #include "msg.h"
 #include "params/params.h"
 #include "pubsub_ids.h"
+#include "scheduler.h"
+#include "util.h"
 
 #include <aether_radio/x6100_control/low/gpio.h>
 #include <glib.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 }
 
@@ -27,32 +30,61 @@ extern "C" {
 #include <map>
 #include <vector>
 #include <array>
+#include <atomic>
 
 #define WLAN_IFACE "wlan0"
 #define EMPTY_SSID_STR "--"
 
-static GMainLoop *loop;
-static NMClient  *client = NULL;
-static NMDevice  *device = NULL;
+#define IP_ADDR_LEN 16
 
-static lv_timer_t *loop_timer;
-static lv_timer_t *scan_timer = NULL;
+/*
+ * GLib main loop and libnm run on the own "wifi" thread. Everything below, except the
+ * snapshot and atomics, is touched by that thread only. Calls from the UI are queued
+ * to it, results come back as a snapshot and a coalesced MSG_WIFI_STATE_CHANGED
+ */
+
+static GMainContext *ctx;
+static GMainLoop    *loop;
+static NMClient     *client = NULL;
+static NMDevice     *device = NULL;
+
+static GSource      *scan_timer = NULL;
 
 // static wifi_ap_change_cb ap_add_cb=NULL;
 // static wifi_ap_change_cb ap_del_cb=NULL;
 
-static wifi_status_t status = WIFI_OFF;
-static bool          scanning = false;
-static uint64_t      last_scan;
+static std::atomic<wifi_status_t>   status(WIFI_OFF);
+static std::atomic<bool>            scanning(false);
+static uint64_t                     last_scan;
+
+/* Snapshot for the UI */
+
+static pthread_mutex_t  snapshot_mux = PTHREAD_MUTEX_INITIALIZER;
+static wifi_ap_arr_t    snapshot_aps = { NULL, 0, false };
+static char             snapshot_ip[IP_ADDR_LEN];
+static char             snapshot_gateway[IP_ADDR_LEN];
+static bool             snapshot_has_ip = false;
+
+typedef void (*wifi_cmd_fn)(const char *a, const char *b);
+
+typedef struct {
+    wifi_cmd_fn fn;
+    char        *a;
+    char        *b;
+} wifi_cmd_t;
 
-static void loop_iterations_cb(lv_timer_t *);
-static void update_scan_status_cb(lv_timer_t *t);
+static gboolean update_scan_status_cb(gpointer user_data);
+static void notify();
 
 static void setup_nm_client();
 static void setup_wifi_device();
 static void fill_access_point_info(GBytes *active_ssid, NMAccessPoint *ap, wifi_ap_info_t *ap_info);
 
 static void set_status(wifi_status_t val);
+static void aps_changed_sig_cb(NMDeviceWifi *device, GObject *ap, gpointer user_data);
+static void ap_added_sig_cb(NMDeviceWifi *device, GObject *ap, gpointer user_data);
+static void ap_strength_changed_sig_cb(GObject *object, GParamSpec *pspec, gpointer user_data);
+static void ip_config_changed_sig_cb(GObject *object, GParamSpec *pspec, gpointer user_data);
 
 static void device_added_sig_cb(NMClient *client, GObject *device, gpointer user_data);
 static void device_state_changed_sig_cb(NMDevice *device, guint new_state, guint old_state, guint reason,
@@ -70,9 +102,39 @@ static void connection_modify_cb(GObject *connection, GAsyncResult *result, gpoi
 static void connection_delete_cb(GObject *connection, GAsyncResult *result, gpointer user_data);
 static void connection_activating_cb(GObject *client, GAsyncResult *result, gpointer user_data);
 
-void wifi_power_setup() {
-    set_status(WIFI_DISCONNECTED);
-    loop = g_main_loop_new(NULL, FALSE);
+/* Commands from the UI, run on the wifi thread */
+
+static gboolean cmd_cb(gpointer data) {
+    wifi_cmd_t *cmd = (wifi_cmd_t *)data;
+
+    cmd->fn(cmd->a, cmd->b);
+    return G_SOURCE_REMOVE;
+}
+
+static void cmd_free(gpointer data) {
+    wifi_cmd_t *cmd = (wifi_cmd_t *)data;
+
+    g_free(cmd->a);
+    g_free(cmd->b);
+    g_free(cmd);
+}
+
+static void run_cmd(wifi_cmd_fn fn, const char *a = NULL, const char *b = NULL) {
+    wifi_cmd_t *cmd = g_new0(wifi_cmd_t, 1);
+
+    cmd->fn = fn;
+    cmd->a = g_strdup(a);
+    cmd->b = g_strdup(b);
+
+    g_main_context_invoke_full(ctx, G_PRIORITY_DEFAULT, cmd_cb, cmd, cmd_free);
+}
+
+static void * loop_thread(void *arg) {
+    set_thread_name("wifi");
+
+    // libnm objects belong to the thread default context
+    g_main_context_push_thread_default(ctx);
+
     setup_nm_client();
     if (client != NULL) {
         device = nm_client_get_device_by_iface(client, WLAN_IFACE);
@@ -80,7 +142,23 @@ void wifi_power_setup() {
             setup_wifi_device();
         }
     }
-    loop_timer = lv_timer_create(loop_iterations_cb, 30, NULL);
+    notify();
+
+    g_main_loop_run(loop);
+
+    g_main_context_pop_thread_default(ctx);
+    return NULL;
+}
+
+void wifi_power_setup() {
+    pthread_t thread;
+
+    set_status(WIFI_DISCONNECTED);
+    ctx = g_main_context_new();
+    loop = g_main_loop_new(ctx, FALSE);
+
+    pthread_create(&thread, NULL, loop_thread, NULL);
+    pthread_detach(thread);
 
     if (params.wifi_enabled.x)
         wifi_power_on();
@@ -88,29 +166,41 @@ void wifi_power_setup() {
         wifi_power_off();
 }
 
-void wifi_power_on() {
-    LV_LOG_USER("Power on wifi/bt");
-    params_bool_set(&params.wifi_enabled, true);
-    x6100_gpio_set(x6100_pin_wifi, 0);
+static void do_power_on(const char *a, const char *b) {
     if (!device) {
         set_status(WIFI_STARTING);
     }
-    lv_msg_send(MSG_WIFI_STATE_CHANGED, NULL);
+    notify();
 }
 
-void wifi_power_off() {
-    LV_LOG_USER("Power off wifi/bt");
+static void do_power_off(const char *a, const char *b) {
     set_status(WIFI_OFF);
     if (device) {
         device = NULL;
     }
-    params_bool_set(&params.wifi_enabled, false);
-    x6100_gpio_set(x6100_pin_wifi, 1);
     if (scan_timer) {
-        lv_timer_del(scan_timer);
+        g_source_destroy(scan_timer);
+        g_source_unref(scan_timer);
         scan_timer = NULL;
     }
     scanning = false;
+    notify();
+}
+
+void wifi_power_on() {
+    LV_LOG_USER("Power on wifi/bt");
+    params_bool_set(&params.wifi_enabled, true);
+    x6100_gpio_set(x6100_pin_wifi, 0);
+    run_cmd(do_power_on);
+}
+
+void wifi_power_off() {
+    LV_LOG_USER("Power off wifi/bt");
+    status = WIFI_OFF;
+    scanning = false;
+    params_bool_set(&params.wifi_enabled, false);
+    x6100_gpio_set(x6100_pin_wifi, 1);
+    run_cmd(do_power_off);
 }
 
 // void wifi_set_change_ap_callbacks(wifi_ap_change_cb add_cb, wifi_ap_change_cb del_cb) {
@@ -127,18 +217,25 @@ wifi_status_t wifi_get_status() {
     return status;
 }
 
-void wifi_start_scan() {
+static void do_start_scan(const char *a, const char *b) {
     if (device != NULL) {
         last_scan = nm_device_wifi_get_last_scan(NM_DEVICE_WIFI(device));
-        nm_device_wifi_request_scan_async(NM_DEVICE_WIFI(device), NULL, scan_request_finishing_cb, loop);
+        nm_device_wifi_request_scan_async(NM_DEVICE_WIFI(device), NULL, scan_request_finishing_cb, NULL);
     }
 }
 
+void wifi_start_scan() {
+    run_cmd(do_start_scan);
+}
+
 bool wifi_scanning() {
     return scanning;
 }
 
-wifi_ap_arr_t wifi_get_available_access_points() {
+/**
+ * Build the AP list from libnm objects, on the wifi thread
+ */
+static wifi_ap_arr_t collect_access_points() {
     const GPtrArray *aps;
     NMAccessPoint   *active_ap = NULL;
     GBytes          *active_ssid = NULL;
@@ -196,13 +293,29 @@ wifi_ap_arr_t wifi_get_available_access_points() {
     return aps_info;
 }
 
+wifi_ap_arr_t wifi_get_available_access_points() {
+    wifi_ap_arr_t aps_info;
+
+    pthread_mutex_lock(&snapshot_mux);
+    aps_info = snapshot_aps;
+    if (aps_info.count) {
+        aps_info.ap_arr = (wifi_ap_info_t *)malloc(sizeof(wifi_ap_info_t) * aps_info.count);
+        memcpy(aps_info.ap_arr, snapshot_aps.ap_arr, sizeof(wifi_ap_info_t) * aps_info.count);
+    } else {
+        aps_info.ap_arr = NULL;
+    }
+    pthread_mutex_unlock(&snapshot_mux);
+
+    return aps_info;
+}
+
 void wifi_aps_info_delete(wifi_ap_arr_t aps_info) {
     if (aps_info.ap_arr != NULL) {
         free(aps_info.ap_arr);
     }
 }
 
-void wifi_add_connection(const char *ssid, const char *password) {
+static void do_add_connection(const char *ssid, const char *password) {
     NMConnection              *connection;
     NMSettingConnection       *s_con;
     NMSettingWireless         *s_wireless;
@@ -278,7 +391,7 @@ void wifi_add_connection(const char *ssid, const char *password) {
     g_object_unref(connection);
 }
 
-void wifi_update_connection(const char *id, const char *password) {
+static void do_update_connection(const char *id, const char *password) {
     NMRemoteConnection        *rem_con = NULL;
     NMConnection              *new_connection;
     NMSettingWirelessSecurity *s_wsec;
@@ -307,14 +420,16 @@ void wifi_update_connection(const char *id, const char *password) {
     }
 }
 
-void wifi_delete_connection(const char *id) {
+static void do_delete_connection(const char *id, const char *b) {
     NMRemoteConnection *rem_con;
 
     rem_con = nm_client_get_connection_by_id(client, id);
-    nm_remote_connection_delete_async(rem_con, NULL, connection_delete_cb, NULL);
+    if (rem_con) {
+        nm_remote_connection_delete_async(rem_con, NULL, connection_delete_cb, NULL);
+    }
 }
 
-void wifi_connect(const char *id) {
+static void do_connect(const char *id, const char *b) {
     NMRemoteConnection  *rem_con = NULL;
     NMSettingConnection *s_con;
     NMConnection        *connection = NULL;
@@ -326,44 +441,97 @@ void wifi_connect(const char *id) {
         rem_con = nm_client_get_connection_by_id(client, id);
         if (rem_con != NULL) {
             nm_client_activate_connection_async(client, NM_CONNECTION(rem_con), device, NULL, NULL,
-                                                connection_activating_cb, loop);
+                                                connection_activating_cb, NULL);
         } else {
             LV_LOG_WARN("Connection with id=%s is not found", id);
         }
     }
 }
 
-void wifi_disconnect() {
+static void do_disconnect(const char *a, const char *b) {
     if (device != NULL) {
         nm_device_disconnect_async(device, NULL, device_disconnection_cb, NULL);
     }
 }
 
+void wifi_add_connection(const char *ssid, const char *password) {
+    run_cmd(do_add_connection, ssid, password);
+}
+
+void wifi_update_connection(const char *id, const char *password) {
+    run_cmd(do_update_connection, id, password);
+}
+
+void wifi_delete_connection(const char *id) {
+    run_cmd(do_delete_connection, id);
+}
+
+void wifi_connect(const char *id) {
+    run_cmd(do_connect, id);
+}
+
+void wifi_disconnect() {
+    run_cmd(do_disconnect);
+}
+
 bool wifi_get_ipaddr(char **ip_addr, char **gateway) {
-    NMIPConfig *ip_cfg;
+    bool res;
+
+    pthread_mutex_lock(&snapshot_mux);
+    res = snapshot_has_ip;
+    if (res) {
+        strcpy(*ip_addr, snapshot_ip);
+        strcpy(*gateway, snapshot_gateway);
+    }
+    pthread_mutex_unlock(&snapshot_mux);
+
+    return res;
+}
+
+/* Snapshot and UI notification */
+
+static void notify_ui_cb(void *arg) {
+    lv_msg_send(MSG_WIFI_STATE_CHANGED, NULL);
+}
+
+/**
+ * Refresh the snapshot and tell the UI. Bursts of D-Bus signals result in one UI update
+ */
+static void notify() {
+    wifi_ap_arr_t   aps = collect_access_points();
+    bool            has_ip = false;
+    char            ip[IP_ADDR_LEN] = "";
+    char            gateway[IP_ADDR_LEN] = "";
+
     if (device) {
-        ip_cfg = nm_device_get_ip4_config(device);
+        NMIPConfig *ip_cfg = nm_device_get_ip4_config(device);
+
         if (ip_cfg) {
             const char * gw = nm_ip_config_get_gateway(ip_cfg);
-            if(gw) {
-                strcpy(*gateway, gw);
+            if (gw) {
+                g_strlcpy(gateway, gw, sizeof(gateway));
                 GPtrArray *addresses = nm_ip_config_get_addresses(ip_cfg);
                 if (addresses->len > 0) {
                     NMIPAddress *address = (NMIPAddress *)g_ptr_array_index(addresses, 0);
-                    strcpy(*ip_addr, nm_ip_address_get_address(address));
+                    g_strlcpy(ip, nm_ip_address_get_address(address), sizeof(ip));
                 }
-                return true;
+                has_ip = true;
             }
         }
     }
-    return false;
-}
 
-static void loop_iterations_cb(lv_timer_t *t) {
-    g_main_context_iteration(g_main_loop_get_context(loop), FALSE);
+    pthread_mutex_lock(&snapshot_mux);
+    wifi_aps_info_delete(snapshot_aps);
+    snapshot_aps = aps;
+    snapshot_has_ip = has_ip;
+    strcpy(snapshot_ip, ip);
+    strcpy(snapshot_gateway, gateway);
+    pthread_mutex_unlock(&snapshot_mux);
+
+    scheduler_put_coalesced(SCHEDULER_KEY_WIFI, notify_ui_cb, NULL, 0);
 }
 
-static void update_scan_status_cb(lv_timer_t *t) {
+static gboolean update_scan_status_cb(gpointer user_data) {
     uint64_t val;
 
     if (device) {
@@ -372,11 +540,30 @@ static void update_scan_status_cb(lv_timer_t *t) {
             LV_LOG_USER("Scan is finished");
             scanning = false;
             last_scan = val;
-            lv_timer_del(scan_timer);
+            g_source_unref(scan_timer);
             scan_timer = NULL;
-            lv_msg_send(MSG_WIFI_STATE_CHANGED, NULL);
+            notify();
+            return G_SOURCE_REMOVE;
         }
     }
+    return G_SOURCE_CONTINUE;
+}
+
+static void aps_changed_sig_cb(NMDeviceWifi *device, GObject *ap, gpointer user_data) {
+    notify();
+}
+
+static void ap_added_sig_cb(NMDeviceWifi *device, GObject *ap, gpointer user_data) {
+    g_signal_connect(ap, "notify::" NM_ACCESS_POINT_STRENGTH, G_CALLBACK(ap_strength_changed_sig_cb), NULL);
+    notify();
+}
+
+static void ap_strength_changed_sig_cb(GObject *object, GParamSpec *pspec, gpointer user_data) {
+    notify();
+}
+
+static void ip_config_changed_sig_cb(GObject *object, GParamSpec *pspec, gpointer user_data) {
+    notify();
 }
 
 static void setup_nm_client() {
@@ -393,9 +580,20 @@ static void setup_nm_client() {
 
 static void setup_wifi_device() {
     NMActiveConnection *active_con;
+    const GPtrArray    *aps;
 
     LV_LOG_USER("Setup wlan0 device");
     g_signal_connect(device, "state-changed", G_CALLBACK(device_state_changed_sig_cb), NULL);
+    g_signal_connect(device, "access-point-added", G_CALLBACK(ap_added_sig_cb), NULL);
+    g_signal_connect(device, "access-point-removed", G_CALLBACK(aps_changed_sig_cb), NULL);
+    g_signal_connect(device, "notify::" NM_DEVICE_IP4_CONFIG, G_CALLBACK(ip_config_changed_sig_cb), NULL);
+
+    /* Signal level of the known APs, the new ones are connected on adding */
+    aps = nm_device_wifi_get_access_points(NM_DEVICE_WIFI(device));
+    for (uint i = 0; i < aps->len; i++) {
+        g_signal_connect(g_ptr_array_index(aps, i), "notify::" NM_ACCESS_POINT_STRENGTH,
+                         G_CALLBACK(ap_strength_changed_sig_cb), NULL);
+    }
     // g_signal_connect(device, "access-point-added", G_CALLBACK(access_point_added_sig_cb), NULL);
     // g_signal_connect(device, "access-point-removed", G_CALLBACK(access_point_removed_sig_cb), NULL);
     active_con = nm_device_get_active_connection(device);
@@ -465,10 +663,10 @@ static void fill_access_point_info(GBytes *active_ssid, NMAccessPoint *ap, wifi_
 }
 
 static void set_status(wifi_status_t val) {
-    wifi_status_t prev_val = status;
-    status = val;
-    if (val != prev_val) {
-        lv_msg_send(MSG_WIFI_STATE_CHANGED, NULL);
+    wifi_status_t prev_val = status.exchange(val);
+
+    if (val != prev_val && ctx) {
+        notify();
     }
 }
 
@@ -484,10 +682,13 @@ static void scan_request_finishing_cb(GObject *device, GAsyncResult *result, gpo
     } else {
         LV_LOG_USER("Scan is started");
         scanning = true;
-        scan_timer = lv_timer_create(update_scan_status_cb, 500, NULL);
+        if (!scan_timer) {
+            scan_timer = g_timeout_source_new(500);
+            g_source_set_callback(scan_timer, update_scan_status_cb, NULL, NULL);
+            g_source_attach(scan_timer, ctx);
+        }
     }
-    lv_msg_send(MSG_WIFI_STATE_CHANGED, NULL);
-    g_main_loop_quit(loop);
+    notify();
 }
 
 static void connection_adding_cb(GObject *client, GAsyncResult *result, gpointer user_data) {
@@ -507,10 +708,7 @@ static void connection_adding_cb(GObject *client, GAsyncResult *result, gpointer
     } else {
         LV_LOG_USER("Added: %s\n", nm_connection_get_path(NM_CONNECTION(remote)));
         g_object_unref(remote);
-    }
-
-    /* Tell the mainloop we're done and we can quit now */
-    g_main_loop_quit(loop);
+    }    notify();
 }
 
 static void connection_adding_and_activating_cb(GObject *client, GAsyncResult *result, gpointer user_data) {
@@ -530,9 +728,6 @@ static void connection_adding_and_activating_cb(GObject *client, GAsyncResult *r
         g_signal_connect(active_con, "state-changed", G_CALLBACK(active_con_state_changed_sig_cb), NULL);
         g_object_unref(active_con);
     }
-
-    /* Tell the mainloop we're done and we can quit now */
-    g_main_loop_quit(loop);
 }
 
 static void connection_modify_cb(GObject *connection, GAsyncResult *result, gpointer user_data) {
@@ -545,7 +740,6 @@ static void connection_modify_cb(GObject *connection, GAsyncResult *result, gpoi
         LV_LOG_USER(("Connection '%s' (%s) successfully modified.\n"), nm_connection_get_id(NM_CONNECTION(connection)),
                     nm_connection_get_uuid(NM_CONNECTION(connection)));
     }
-    g_main_loop_quit(loop);
 }
 
 static void connection_delete_cb(GObject *connection, GAsyncResult *result, gpointer user_data) {
@@ -557,8 +751,7 @@ static void connection_delete_cb(GObject *connection, GAsyncResult *result, gpoi
     } else {
         LV_LOG_USER(("Connection '%s' (%s) successfully deleted.\n"), nm_connection_get_id(NM_CONNECTION(connection)),
                     nm_connection_get_uuid(NM_CONNECTION(connection)));
-    }
-    g_main_loop_quit(loop);
+    }    notify();
 }
 
 static void device_state_changed_sig_cb(NMDevice *device, guint new_state, guint old_state, guint reason,
@@ -620,7 +813,7 @@ static void device_state_changed_sig_cb(NMDevice *device, guint new_state, guint
 static void active_con_state_changed_sig_cb(NMActiveConnection *active_connection, guint state, guint reason,
                                             gpointer user_data) {
     LV_LOG_INFO("Active con state change -  state: %zu, reason: %zu", state, reason);
-    lv_msg_send(MSG_WIFI_STATE_CHANGED, NULL);
+    notify();
 }
 
 static void connection_activating_cb(GObject *client, GAsyncResult *result, gpointer user_data) {
@@ -640,7 +833,6 @@ static void connection_activating_cb(GObject *client, GAsyncResult *result, gpoi
         g_object_unref(active_con);
     }
 
-    g_main_loop_quit(loop);
 }
 
 static void device_disconnection_cb(GObject *device, GAsyncResult *result, gpointer user_data) {
@@ -656,5 +848,4 @@ static void device_disconnection_cb(GObject *device, GAsyncResult *result, gpoin
         LV_LOG_USER("%s disconnected", nm_device_get_iface(NM_DEVICE(device)));
         set_status(WIFI_DISCONNECTED);
     }
-    g_main_loop_quit(loop);
 }
@@ -0,0 +1,49 @@
+#include "alloc_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+size_t allocs;
+
+__attribute__((noinline)) void * operator new(size_t size) {
+    allocs++;
+
+    void *p = malloc(size);
+
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t size) noexcept {
+    free(p);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+    allocs++;
+
+    return malloc(size);
+}
+
+void * operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void *p, size_t size) noexcept {
+    operator delete(p);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+    allocs++;
+
+    return malloc(size);
+}
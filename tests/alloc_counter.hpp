@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstddef>
+
+/* Heap allocations, every operator new variant counts */
+extern size_t allocs;
@@ -0,0 +1,141 @@
+extern "C" {
+    #include "../src/band_activity_store.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+static band_activity_record_t make_record(uint32_t time, uint8_t band) {
+    band_activity_record_t rec = {};
+
+    rec.time = time;
+    rec.span = 15;
+    rec.band = band;
+    return rec;
+}
+
+static std::string temp_path() {
+    char path[] = "/tmp/band_activity_XXXXXX";
+    int  fd = mkstemp(path);
+
+    close(fd);
+    unlink(path);
+    return path;
+}
+
+TEST_CASE( "Band activity SNR bins", "[band_activity]" ) {
+    REQUIRE(band_activity_snr_bin(-24) == 0);
+    REQUIRE(band_activity_snr_bin(-21) == 0);
+    REQUIRE(band_activity_snr_bin(-20) == 1);
+    REQUIRE(band_activity_snr_bin(-16) == 1);
+    REQUIRE(band_activity_snr_bin(-15) == 2);
+    REQUIRE(band_activity_snr_bin(0) == 5);
+    REQUIRE(band_activity_snr_bin(9) == 6);
+    REQUIRE(band_activity_snr_bin(10) == 7);
+    REQUIRE(band_activity_snr_bin(30) == 7);
+}
+
+TEST_CASE( "Band activity rollup", "[band_activity]" ) {
+    band_activity_record_t total = make_record(0, 20);
+    band_activity_record_t a = make_record(0, 20);
+    band_activity_record_t b = make_record(15, 20);
+
+    a.rows = 10;
+    a.floor = -1200;
+    a.occupied = 100;
+    a.decodes = 3;
+    a.snr[2] = 3;
+    b.rows = 30;
+    b.floor = -1000;
+    b.occupied = 300;
+    b.decodes = 1;
+    b.snr[5] = 1;
+
+    band_activity_rollup(&total, &a);
+    band_activity_rollup(&total, &b);
+
+    REQUIRE(total.rows == 40);
+    REQUIRE(total.floor == -1050);
+    REQUIRE(total.occupied == 250);
+    REQUIRE(total.decodes == 4);
+    REQUIRE(total.snr[2] == 3);
+    REQUIRE(total.snr[5] == 1);
+
+    /* Decodes without rows keep the floor */
+    band_activity_record_t c = make_record(30, 20);
+
+    c.decodes = 2;
+    band_activity_rollup(&total, &c);
+
+    REQUIRE(total.floor == -1050);
+    REQUIRE(total.decodes == 6);
+}
+
+TEST_CASE( "Band activity store query", "[band_activity]" ) {
+    std::string             path = temp_path();
+    band_activity_store_t   store;
+
+    REQUIRE(band_activity_store_open(&store, path.c_str(), 1024 * 1024));
+
+    for (uint32_t i = 0; i < 300; i++) {
+        band_activity_record_t rec = make_record(1000 + i * 15, i % 2 ? 20 : 40);
+
+        REQUIRE(band_activity_store_append(&store, &rec));
+    }
+
+    /* 2 blocks in the file, the rest in memory */
+    band_activity_record_t out[400];
+    size_t                 n = band_activity_store_query(&store, 1000 + 100 * 15, 1000 + 200 * 15, 0, out, 400);
+
+    REQUIRE(n == 100);
+    REQUIRE(out[0].time == 1000 + 100 * 15);
+    REQUIRE(out[99].time == 1000 + 199 * 15);
+
+    n = band_activity_store_query(&store, 0, UINT32_MAX, 20, out, 400);
+    REQUIRE(n == 150);
+
+    n = band_activity_store_query(&store, 0, UINT32_MAX, 0, out, 10);
+    REQUIRE(n == 10);
+
+    /* Reopened file has the flushed records */
+    band_activity_store_close(&store);
+    REQUIRE(band_activity_store_open(&store, path.c_str(), 1024 * 1024));
+
+    n = band_activity_store_query(&store, 0, UINT32_MAX, 0, out, 400);
+    REQUIRE(n == 300);
+    REQUIRE(out[299].time == 1000 + 299 * 15);
+
+    band_activity_store_close(&store);
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Band activity store rotation", "[band_activity]" ) {
+    std::string             path = temp_path();
+    std::string             old_path = path + ".1";
+    band_activity_store_t   store;
+
+    /* A block per file */
+    REQUIRE(band_activity_store_open(&store, path.c_str(), 2 * (16 + BAND_ACTIVITY_BLOCK * 32)));
+
+    for (uint32_t i = 0; i < 3 * BAND_ACTIVITY_BLOCK; i++) {
+        band_activity_record_t rec = make_record(i, 20);
+
+        REQUIRE(band_activity_store_append(&store, &rec));
+    }
+
+    static band_activity_record_t out[4 * BAND_ACTIVITY_BLOCK];
+    size_t                        n = band_activity_store_query(&store, 0, UINT32_MAX, 0, out, 4 * BAND_ACTIVITY_BLOCK);
+
+    /* The first block is gone */
+    REQUIRE(n == 2 * BAND_ACTIVITY_BLOCK);
+    REQUIRE(out[0].time == BAND_ACTIVITY_BLOCK);
+    REQUIRE(out[n - 1].time == 3 * BAND_ACTIVITY_BLOCK - 1);
+
+    band_activity_store_close(&store);
+    unlink(path.c_str());
+    unlink(old_path.c_str());
+}
@@ -0,0 +1,51 @@
+#include "../src/ft8/call_intern.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <cstdio>
+#include <string>
+
+using Catch::Matchers::Equals;
+
+TEST_CASE("Same string gets the same ID", "[call_intern]") {
+    call_id_t a = call_intern("R2RFE");
+    call_id_t b = call_intern_n("R2RFE/P", 5);
+
+    REQUIRE(a != CALL_ID_NONE);
+    REQUIRE(a == b);
+    REQUIRE(call_intern("R1CBU") != a);
+    REQUIRE_THAT(call_intern_str(a), Equals("R2RFE"));
+}
+
+TEST_CASE("Canonical callsigns", "[call_intern]") {
+    char call[CALL_INTERN_LEN];
+
+    REQUIRE(call_canonize("ea8/r2rfe/p", call));
+    REQUIRE_THAT(call, Equals("R2RFE"));
+    REQUIRE(call_canonize("R2RFE", call));
+    REQUIRE_THAT(call, Equals("R2RFE"));
+    REQUIRE_FALSE(call_canonize("", call));
+    REQUIRE_FALSE(call_canonize("R2RFE1234567890ABC", call));
+
+    REQUIRE(call_intern_canon("dl/r2rfe") == call_intern("R2RFE"));
+    REQUIRE(call_intern_find_canon("R2RFE/QRP") == call_intern("R2RFE"));
+    REQUIRE(call_intern_find_canon("N0CALL") == CALL_ID_NONE);
+}
+
+TEST_CASE("Strings stay valid while the pool grows", "[call_intern]") {
+    call_id_t   first = call_intern("UA0AAA");
+    const char  *str = call_intern_str(first);
+    char        call[CALL_INTERN_LEN];
+
+    for (int i = 0; i < 5000; i++) {
+        snprintf(call, sizeof(call), "R%iAA", i);
+        REQUIRE(call_intern(call) != CALL_ID_NONE);
+    }
+    for (int i = 0; i < 5000; i++) {
+        snprintf(call, sizeof(call), "R%iAA", i);
+        REQUIRE_THAT(call_intern_str(call_intern(call)), Equals(call));
+    }
+    REQUIRE(call_intern("UA0AAA") == first);
+    REQUIRE(call_intern_str(first) == str);
+}
@@ -0,0 +1,191 @@
+#include "../src/cat_frame.hpp"
+#include "alloc_counter.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint8_t rd_freq[] = {0xFE, 0xFE, 0xA4, 0xE0, 0x03, 0xFD};
+static const uint8_t set_freq[] = {0xFE, 0xFE, 0xA4, 0xE0, 0x05, 0x00, 0x40, 0x07, 0x14, 0x00, 0xFD};
+
+static void feed(CatParser &parser, const uint8_t *data, size_t len) {
+    size_t  space;
+    uint8_t *buf = parser.space(&space);
+
+    REQUIRE(space >= len);
+    memcpy(buf, data, len);
+    parser.commit(len);
+}
+
+/* Answer as the CAT thread does, with a fake C_RD_FREQ / meter payload */
+static size_t answer_all(CatParser &parser, CatTxRing &ring) {
+    CatFrame    req;
+    CatResponse resp;
+    size_t      count = 0;
+
+    while (parser.next(&req)) {
+        ring.put(req.raw, req.raw_len);
+        resp.reply_to(req, 0xA4);
+        resp.set_payload_len(6);
+        memset(resp.data, 0x11, 5);
+        ring.put(resp);
+        count++;
+    }
+    return count;
+}
+
+static void drain(CatTxRing &ring) {
+    const uint8_t *data;
+    size_t        len;
+
+    while ((len = ring.peek(&data))) {
+        ring.consume(len);
+    }
+}
+
+TEST_CASE( "Parse frames", "[cat]" ) {
+    CatParser parser;
+    CatFrame  frame;
+
+    feed(parser, rd_freq, sizeof(rd_freq));
+    feed(parser, set_freq, sizeof(set_freq));
+
+    REQUIRE(parser.next(&frame));
+    REQUIRE(frame.dst_addr == 0xA4);
+    REQUIRE(frame.src_addr == 0xE0);
+    REQUIRE(frame.command == 0x03);
+    REQUIRE(frame.len == 0);
+    REQUIRE(frame.raw_len == sizeof(rd_freq));
+
+    REQUIRE(parser.next(&frame));
+    REQUIRE(frame.command == 0x05);
+    REQUIRE(frame.len == 5);
+    REQUIRE(memcmp(frame.data, set_freq + 5, 5) == 0);
+
+    REQUIRE_FALSE(parser.next(&frame));
+}
+
+TEST_CASE( "Parse split and noisy frames", "[cat]" ) {
+    CatParser       parser;
+    CatFrame        frame;
+    const uint8_t   noise[] = {0x00, 0x13, 0xFD, 0xFE};
+
+    feed(parser, noise, sizeof(noise));
+    REQUIRE_FALSE(parser.next(&frame));
+
+    feed(parser, rd_freq, 3);
+    REQUIRE_FALSE(parser.next(&frame));
+
+    feed(parser, rd_freq + 3, sizeof(rd_freq) - 3);
+    REQUIRE(parser.next(&frame));
+    REQUIRE(frame.command == 0x03);
+    REQUIRE(frame.raw_len == sizeof(rd_freq));
+    REQUIRE(memcmp(frame.raw, rd_freq, sizeof(rd_freq)) == 0);
+}
+
+TEST_CASE( "Drop garbage filling the buffer", "[cat]" ) {
+    CatParser   parser;
+    CatFrame    frame;
+    size_t      space;
+    uint8_t     *buf = parser.space(&space);
+
+    buf[0] = 0xFE;
+    buf[1] = 0xFE;
+    memset(buf + 2, 0x55, space - 2);
+    parser.commit(space);
+
+    REQUIRE_FALSE(parser.next(&frame));
+
+    parser.space(&space);
+    REQUIRE(space == CAT_RX_BUF_SIZE);
+}
+
+TEST_CASE( "Encode responses", "[cat]" ) {
+    CatParser   parser;
+    CatFrame    req;
+    CatResponse resp;
+    uint8_t     buf[CAT_MAX_PAYLOAD + 6];
+
+    feed(parser, set_freq, sizeof(set_freq));
+    REQUIRE(parser.next(&req));
+
+    resp.reply_to(req, 0xA4);
+    resp.set_code(0xFB);
+
+    const uint8_t ok[] = {0xFE, 0xFE, 0xE0, 0xA4, 0xFB, 0xFD};
+
+    REQUIRE(resp.encode(buf) == sizeof(ok));
+    REQUIRE(memcmp(buf, ok, sizeof(ok)) == 0);
+}
+
+TEST_CASE( "TX ring wraps and refuses overflow", "[cat]" ) {
+    CatTxRing       ring;
+    uint8_t         chunk[1000];
+    const uint8_t   *data;
+
+    for (size_t i = 0; i < sizeof(chunk); i++) {
+        chunk[i] = i;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(ring.put(chunk, sizeof(chunk)));
+    }
+    REQUIRE_FALSE(ring.put(chunk, sizeof(chunk)));
+
+    REQUIRE(ring.peek(&data) == 4 * sizeof(chunk));
+    ring.consume(2 * sizeof(chunk));
+    REQUIRE(ring.put(chunk, sizeof(chunk)));
+
+    size_t total = 0;
+    size_t len;
+
+    while ((len = ring.peek(&data))) {
+        for (size_t i = 0; i < len; i++) {
+            REQUIRE(data[i] == (uint8_t) ((total + i) % sizeof(chunk)));
+        }
+        total += len;
+        ring.consume(len);
+    }
+    REQUIRE(total == 3 * sizeof(chunk));
+    REQUIRE(ring.empty());
+}
+
+TEST_CASE( "CAT hot path does not allocate", "[cat]" ) {
+    CatParser   parser;
+    CatTxRing   ring;
+    size_t      frames = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    allocs = 0;
+
+    for (int i = 0; i < 100000; i++) {
+        feed(parser, rd_freq, sizeof(rd_freq));
+        feed(parser, set_freq, sizeof(set_freq));
+        frames += answer_all(parser, ring);
+        drain(ring);
+    }
+
+    size_t count = allocs;
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("CAT: %.0f frames/s\n", frames / sec);
+
+    REQUIRE(frames == 200000);
+    REQUIRE(count == 0);
+
+    BENCHMARK("Parse and answer two frames") {
+        feed(parser, rd_freq, sizeof(rd_freq));
+        feed(parser, set_freq, sizeof(set_freq));
+
+        size_t n = answer_all(parser, ring);
+
+        drain(ring);
+        return n;
+    };
+}
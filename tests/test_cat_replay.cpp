@@ -0,0 +1,433 @@
+#include "../src/cat.private.hpp"
+#include "../src/cat_frame.hpp"
+#include "../src/cat_record.hpp"
+#include "../src/cat_state.h"
+#include "../src/cfg/subjects.h"
+
+extern "C" {
+    #include "../src/cfg/cfg.h"
+    #include "../src/meter.h"
+    #include "../src/params/params.h"
+    #include "../src/radio.h"
+    #include "../src/tx_info.h"
+
+    #include <aether_radio/x6100_control/low/gpio.h>
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Replay of recorded CAT sessions (src/cat_record.hpp) against the CI-V
+ * handlers. Radio, meters and the cfg subjects are mocked, the state starts
+ * from the "# state" line of the recording.
+ *
+ * Set X6100_CAT_RECORD to a recording from the radio, otherwise the sessions
+ * in tests/cat_sessions are replayed. Each run reports per command latency,
+ * throughput and answers, which differ from the recorded ones.
+ */
+
+#define DIFFS_SHOWN 20
+
+/* Mocks */
+
+extern "C" {
+    cfg_t       cfg;
+    cfg_cur_t   cfg_cur;
+    params_t    params;
+
+    static cfg_band_t       band;
+    static radio_state_t    radio_state = RADIO_RX;
+
+    radio_state_t radio_get_state() {
+        return radio_state;
+    }
+
+    void radio_set_ptt(bool tx) {
+        radio_state = tx ? RADIO_TX : RADIO_RX;
+    }
+
+    int16_t meter_get_raw_db() {
+        return S9;
+    }
+
+    bool tx_info_refresh(uint8_t * prev_msg_id, float * alc_p, float * pwr_p, float * vswr_p) {
+        return false;
+    }
+
+    void cfg_band_vfo_copy() {
+        struct vfo_params *src, *dst;
+
+        if (subject_get_int(band.vfo.val) == X6100_VFO_A) {
+            src = &band.vfo_a;
+            dst = &band.vfo_b;
+        } else {
+            src = &band.vfo_b;
+            dst = &band.vfo_a;
+        }
+        subject_set_int(dst->freq.val, subject_get_int(src->freq.val));
+        subject_set_int(dst->mode.val, subject_get_int(src->mode.val));
+    }
+
+    void x6100_gpio_set(x6100_pin_t pin, int value) {
+    }
+}
+
+static struct vfo_params *cur_vfo() {
+    return subject_get_int(band.vfo.val) == X6100_VFO_A ? &band.vfo_a : &band.vfo_b;
+}
+
+/* Current frequency and mode follow the VFO, as cfg does it */
+
+static void on_fg_freq(Subject *subj, void *user_data) {
+    subject_set_int(cur_vfo()->freq.val, subject_get_int(subj));
+}
+
+static void on_mode(Subject *subj, void *user_data) {
+    subject_set_int(cur_vfo()->mode.val, subject_get_int(subj));
+}
+
+static void on_vfo(Subject *subj, void *user_data) {
+    subject_set_int(cfg_cur.fg_freq, subject_get_int(cur_vfo()->freq.val));
+    subject_set_int(cfg_cur.mode, subject_get_int(cur_vfo()->mode.val));
+}
+
+static void mock_init() {
+    static bool ready = false;
+
+    if (ready) {
+        return;
+    }
+    band.vfo_a.freq.val = subject_create_int(0);
+    band.vfo_a.mode.val = subject_create_int(0);
+    band.vfo_b.freq.val = subject_create_int(0);
+    band.vfo_b.mode.val = subject_create_int(0);
+    band.vfo.val = subject_create_int(X6100_VFO_A);
+    band.split.val = subject_create_int(0);
+    band.rfg.val = subject_create_int(0);
+
+    cfg_cur.band = &band;
+    cfg_cur.fg_freq = subject_create_int(0);
+    cfg_cur.mode = subject_create_int(0);
+    cfg_cur.filter.bw = subject_create_int(0);
+    cfg_cur.freq_step = subject_create_int(0);
+    cfg_cur.att = subject_create_int(0);
+    cfg_cur.pre = subject_create_int(0);
+
+    cfg.vol.val = subject_create_int(0);
+    cfg.sql.val = subject_create_int(0);
+    cfg.pwr.val = subject_create_float(0);
+    cfg.nb.val = subject_create_int(0);
+    cfg.nr.val = subject_create_int(0);
+
+    subject_add_observer(cfg_cur.fg_freq, on_fg_freq, NULL);
+    subject_add_observer(cfg_cur.mode, on_mode, NULL);
+    subject_add_observer(band.vfo.val, on_vfo, NULL);
+
+    cat_state_init();
+    ready = true;
+}
+
+static void mock_set_state(const cat_state_t &st) {
+    radio_state = RADIO_RX;
+
+    subject_set_int(band.vfo_a.freq.val, st.vfo_freq[0]);
+    subject_set_int(band.vfo_a.mode.val, st.vfo_mode[0]);
+    subject_set_int(band.vfo_b.freq.val, st.vfo_freq[1]);
+    subject_set_int(band.vfo_b.mode.val, st.vfo_mode[1]);
+    subject_set_int(band.vfo.val, st.vfo);
+    subject_set_int(band.split.val, st.split);
+    subject_set_int(band.rfg.val, st.rfg);
+
+    subject_set_int(cfg_cur.fg_freq, st.fg_freq);
+    subject_set_int(cfg_cur.mode, st.mode);
+    subject_set_int(cfg_cur.filter.bw, st.filter_bw);
+    subject_set_int(cfg_cur.freq_step, st.freq_step);
+    subject_set_int(cfg_cur.att, st.att);
+    subject_set_int(cfg_cur.pre, st.pre);
+
+    subject_set_int(cfg.vol.val, st.vol);
+    subject_set_int(cfg.sql.val, st.sql);
+    subject_set_float(cfg.pwr.val, st.pwr);
+    subject_set_int(cfg.nb.val, st.nb);
+    subject_set_int(cfg.nr.val, st.nr);
+}
+
+/* Replay */
+
+struct Frame {
+    std::vector<uint8_t>    bytes;
+    uint64_t                time;                   /* Of the record line, which completed the frame */
+};
+
+struct CommandStats {
+    uint32_t    count = 0;
+    uint64_t    replay_ns = 0;
+    uint64_t    replay_max_ns = 0;
+    uint64_t    recorded_us = 0;
+    uint32_t    recorded_count = 0;
+};
+
+struct Report {
+    uint32_t                        requests = 0;
+    uint32_t                        diffs = 0;
+    uint32_t                        unanswered = 0;     /* No recorded answer to compare with */
+    uint64_t                        bytes_in = 0;
+    uint64_t                        bytes_out = 0;
+    uint64_t                        replay_ns = 0;
+    uint64_t                        recorded_us = 0;
+    std::map<uint16_t, CommandStats> commands;
+    std::vector<std::string>        diff_lines;
+};
+
+static bool has_subcommand(uint8_t command) {
+    switch (command) {
+        case C_SET_VFO:
+        case C_CTL_LVL:
+        case C_RD_SQSM:
+        case C_CTL_FUNC:
+        case C_CTL_MEM:
+        case C_CTL_PTT:
+        case C_CTL_SCP:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * Answers, which depend on the live signal, are compared by command and length only
+ */
+static bool is_volatile(const CatFrame &req) {
+    return req.command == C_RD_SQSM;
+}
+
+static uint16_t command_key(const CatFrame &req) {
+    uint16_t key = req.command << 8;
+
+    if (has_subcommand(req.command) && req.len > 0) {
+        key |= req.data[0];
+    } else {
+        key |= 0xFF;
+    }
+    return key;
+}
+
+static std::string hex(const uint8_t *data, size_t len) {
+    std::string s;
+    char        buf[4];
+
+    for (size_t i = 0; i < len; i++) {
+        snprintf(buf, sizeof(buf), i ? " %02X" : "%02X", data[i]);
+        s += buf;
+    }
+    return s;
+}
+
+static bool load(const char *path, cat_state_t *state, std::vector<CatRecordEntry> *entries) {
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        return false;
+    }
+
+    static char     line[CAT_RX_BUF_SIZE * 3 + 64];
+    CatRecordEntry  entry;
+
+    memset(state, 0, sizeof(*state));
+
+    while (fgets(line, sizeof(line), f)) {
+        if (cat_record_parse_state(line, state)) {
+            continue;
+        }
+        if (cat_record_parse(line, &entry)) {
+            entries->push_back(entry);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * Answers of the radio in the TX stream, without the echo and unsolicited frames
+ */
+static std::vector<Frame> recorded_answers(const std::vector<CatRecordEntry> &entries) {
+    std::vector<Frame>  answers;
+    CatParser           parser;
+    CatFrame            frame;
+
+    for (const CatRecordEntry &entry : entries) {
+        if (entry.dir != CAT_RECORD_TX) {
+            continue;
+        }
+
+        size_t  len;
+        uint8_t *buf = parser.space(&len);
+
+        len = std::min(len, entry.len);
+        memcpy(buf, entry.data, len);
+        parser.commit(len);
+
+        while (parser.next(&frame)) {
+            if (frame.src_addr == LOCAL_ADDRESS && frame.dst_addr != 0) {
+                answers.push_back({std::vector<uint8_t>(frame.raw, frame.raw + frame.raw_len), entry.time});
+            }
+        }
+    }
+    return answers;
+}
+
+static Report replay(const char *path) {
+    Report                      report;
+    cat_state_t                 state;
+    std::vector<CatRecordEntry> entries;
+
+    mock_init();
+
+    if (!load(path, &state, &entries)) {
+        FAIL("Can't read " << path);
+    }
+    mock_set_state(state);
+
+    std::vector<Frame>  answers = recorded_answers(entries);
+    size_t              next_answer = 0;
+    CatParser           parser;
+    CatFrame            req;
+    CatResponse         resp;
+    uint8_t             encoded[CAT_MAX_PAYLOAD + FRAME_ADD_LEN + 1];
+
+    if (!entries.empty()) {
+        report.recorded_us = entries.back().time - entries.front().time;
+    }
+
+    for (const CatRecordEntry &entry : entries) {
+        if (entry.dir != CAT_RECORD_RX) {
+            continue;
+        }
+
+        size_t  len;
+        uint8_t *buf = parser.space(&len);
+
+        len = std::min(len, entry.len);
+        memcpy(buf, entry.data, len);
+        parser.commit(len);
+        report.bytes_in += len;
+
+        while (parser.next(&req)) {
+            auto start = std::chrono::steady_clock::now();
+
+            cat_process(req, resp);
+
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            size_t   resp_len = resp.encode(encoded);
+
+            CommandStats &stats = report.commands[command_key(req)];
+
+            stats.count++;
+            stats.replay_ns += ns;
+            stats.replay_max_ns = std::max(stats.replay_max_ns, ns);
+            report.replay_ns += ns;
+            report.bytes_out += resp_len;
+            report.requests++;
+
+            if (next_answer >= answers.size()) {
+                report.unanswered++;
+                continue;
+            }
+
+            const Frame &expected = answers[next_answer++];
+            bool        same;
+
+            if (expected.time >= entry.time) {
+                stats.recorded_us += expected.time - entry.time;
+                stats.recorded_count++;
+            }
+
+            if (is_volatile(req)) {
+                same = expected.bytes.size() == resp_len && expected.bytes[4] == encoded[4];
+            } else {
+                same = expected.bytes.size() == resp_len && memcmp(expected.bytes.data(), encoded, resp_len) == 0;
+            }
+
+            if (!same) {
+                report.diffs++;
+
+                if (report.diff_lines.size() < DIFFS_SHOWN) {
+                    report.diff_lines.push_back(
+                        "@" + std::to_string(entry.time) + " " + hex(req.raw, req.raw_len) + "\n" +
+                        "    recorded: " + hex(expected.bytes.data(), expected.bytes.size()) + "\n" +
+                        "    replayed: " + hex(encoded, resp_len)
+                    );
+                }
+            }
+        }
+    }
+    return report;
+}
+
+static void print_report(const char *path, const Report &report) {
+    double sec = report.replay_ns / 1e9;
+
+    printf("CAT replay %s\n", path);
+    printf("  %u requests, %u diffs, %u without recorded answer\n", report.requests, report.diffs, report.unanswered);
+    printf("  recorded %.1f s, replayed %.3f ms: %.0f frames/s, %.0f kB/s in, %.0f kB/s out\n",
+           report.recorded_us / 1e6, sec * 1e3,
+           sec > 0 ? report.requests / sec : 0,
+           sec > 0 ? report.bytes_in / sec / 1e3 : 0,
+           sec > 0 ? report.bytes_out / sec / 1e3 : 0);
+    printf("  cmd    count  replay avg/max, us  recorded avg, ms\n");
+
+    for (const auto &[key, stats] : report.commands) {
+        char sub[4] = "  ";
+
+        if ((key & 0xFF) != 0xFF) {
+            snprintf(sub, sizeof(sub), "%02X", key & 0xFF);
+        }
+        printf("  %02X %s  %6u  %8.2f / %-8.2f", key >> 8, sub, stats.count,
+               stats.replay_ns / 1e3 / stats.count, stats.replay_max_ns / 1e3);
+
+        if (stats.recorded_count) {
+            printf("  %8.2f\n", stats.recorded_us / 1e3 / stats.recorded_count);
+        } else {
+            printf("  -\n");
+        }
+    }
+
+    for (const std::string &line : report.diff_lines) {
+        printf("  %s\n", line.c_str());
+    }
+    if (report.diffs > report.diff_lines.size()) {
+        printf("  ... %u more\n", report.diffs - (uint32_t) report.diff_lines.size());
+    }
+}
+
+TEST_CASE( "Replay recorded CAT sessions", "[cat]" ) {
+    std::vector<std::string>    paths;
+    const char                  *env = getenv("X6100_CAT_RECORD");
+
+    if (env) {
+        paths.push_back(env);
+    } else {
+        paths.push_back(CAT_SESSIONS_DIR "/logger_poll.txt");
+        paths.push_back(CAT_SESSIONS_DIR "/split_ptt.txt");
+    }
+
+    for (const std::string &path : paths) {
+        Report report = replay(path.c_str());
+
+        print_report(path.c_str(), report);
+
+        INFO(path);
+        REQUIRE(report.requests > 0);
+        CHECK(report.diffs == 0);
+        CHECK(report.unanswered == 0);
+    }
+}
@@ -0,0 +1,119 @@
+extern "C" {
+    #include "../src/contest_engine.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <cstdio>
+
+using Catch::Matchers::Equals;
+
+static const contest_rules_t rules = {
+    .dupe_per_mode = true,
+    .mults_per_band = true,
+    .mults = CONTEST_MULT_GRID | CONTEST_MULT_PREFIX,
+    .points = 1,
+};
+
+TEST_CASE("WPX prefixes", "[contest]") {
+    char prefix[CALL_INTERN_LEN];
+
+    REQUIRE(contest_prefix("r2rfe", prefix));
+    REQUIRE_THAT(prefix, Equals("R2"));
+    REQUIRE(contest_prefix("EA8/R2RFE/P", prefix));
+    REQUIRE_THAT(prefix, Equals("R2"));
+    REQUIRE(contest_prefix("3DA0XY", prefix));
+    REQUIRE_THAT(prefix, Equals("3DA0"));
+    REQUIRE(contest_prefix("S52AB", prefix));
+    REQUIRE_THAT(prefix, Equals("S52"));
+    REQUIRE(contest_prefix("RAEM", prefix));
+    REQUIRE_THAT(prefix, Equals("RA0"));
+    REQUIRE_FALSE(contest_prefix("", prefix));
+}
+
+TEST_CASE("Dupes per band and mode", "[contest]") {
+    contest_engine_t engine;
+
+    REQUIRE(contest_engine_init(&engine, &rules));
+
+    REQUIRE(contest_engine_check(&engine, "R2RFE", "RO89", BAND_20M, MODE_FT8) ==
+            (CONTEST_NEW_GRID | CONTEST_NEW_PREFIX));
+    REQUIRE(contest_engine_add(&engine, "R2RFE", "RO89", BAND_20M, MODE_FT8) ==
+            (CONTEST_NEW_GRID | CONTEST_NEW_PREFIX));
+
+    /* Portable is the same station */
+    REQUIRE(contest_engine_check(&engine, "R2RFE/P", "RO89", BAND_20M, MODE_FT8) == CONTEST_DUPE);
+    REQUIRE(contest_engine_check(&engine, "R2RFE", "RO89", BAND_20M, MODE_FT4) == 0);
+    REQUIRE(contest_engine_check(&engine, "R2RFE", "RO89", BAND_40M, MODE_FT8) ==
+            (CONTEST_NEW_GRID | CONTEST_NEW_PREFIX));
+
+    /* Same prefix and another grid */
+    REQUIRE(contest_engine_add(&engine, "R2ABC", "KO85", BAND_20M, MODE_FT8) == CONTEST_NEW_GRID);
+    REQUIRE(contest_engine_add(&engine, "R2RFE", "RO89", BAND_20M, MODE_FT8) == CONTEST_DUPE);
+
+    /* No grid in the message */
+    REQUIRE(contest_engine_add(&engine, "DL1ABC", NULL, BAND_20M, MODE_CW) == CONTEST_NEW_PREFIX);
+    REQUIRE(contest_engine_check(&engine, "DL1ABC", "RR73", BAND_20M, MODE_CW) == CONTEST_DUPE);
+
+    REQUIRE(engine.score.qsos == 4);
+    REQUIRE(engine.score.dupes == 1);
+    REQUIRE(engine.score.points == 3);
+    REQUIRE(engine.score.grids == 2);
+    REQUIRE(engine.score.prefixes == 2);
+    REQUIRE(engine.score.score == 3 * 4);
+
+    contest_engine_clear(&engine);
+
+    REQUIRE(contest_engine_check(&engine, "R2RFE", "RO89", BAND_20M, MODE_FT8) ==
+            (CONTEST_NEW_GRID | CONTEST_NEW_PREFIX));
+    REQUIRE(engine.score.qsos == 0);
+
+    contest_engine_free(&engine);
+}
+
+TEST_CASE("Dupes per band, multipliers once", "[contest]") {
+    contest_rules_t     once = rules;
+    contest_engine_t    engine;
+
+    once.dupe_per_mode = false;
+    once.mults_per_band = false;
+    once.points = 2;
+
+    REQUIRE(contest_engine_init(&engine, &once));
+
+    contest_engine_add(&engine, "UA3AAA", "KO85", BAND_40M, MODE_CW);
+
+    REQUIRE(contest_engine_check(&engine, "UA3AAA", "KO85", BAND_40M, MODE_SSB) == CONTEST_DUPE);
+    REQUIRE(contest_engine_check(&engine, "UA3AAA", "KO85", BAND_20M, MODE_CW) == 0);
+    REQUIRE(contest_engine_add(&engine, "UA3BBB", "KO85", BAND_20M, MODE_CW) == 0);
+    REQUIRE(engine.score.score == 4 * 2);
+
+    contest_engine_free(&engine);
+}
+
+TEST_CASE("Tables grow", "[contest]") {
+    contest_engine_t engine;
+
+    REQUIRE(contest_engine_init(&engine, &rules));
+
+    for (int i = 0; i < 2000; i++) {
+        int  n = i % 1000;
+        char call[16];
+        char grid[8];
+
+        /* 1000 stations, each worked twice */
+        snprintf(call, sizeof(call), "K%dX%c%c", n % 10, 'A' + n / 10 % 26, 'A' + n / 260);
+        snprintf(grid, sizeof(grid), "%c%c%02d", 'A' + i % 18, 'A' + i / 18 % 18, i / 324);
+
+        contest_engine_add(&engine, call, grid, BAND_20M, MODE_FT8);
+    }
+
+    REQUIRE(engine.score.qsos == 2000);
+    REQUIRE(engine.score.dupes == 1000);
+    REQUIRE(engine.score.prefixes == 10);
+    REQUIRE(engine.calls_size >= 1024);
+    REQUIRE(contest_engine_check(&engine, "K5XAA", "AA00", BAND_20M, MODE_FT8) & CONTEST_DUPE);
+
+    contest_engine_free(&engine);
+}
@@ -0,0 +1,122 @@
+extern "C" {
+    #include "../src/display_snapshot_store.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+static std::string temp_path() {
+    char path[] = "/tmp/display_snapshot_XXXXXX";
+    int  fd = mkstemp(path);
+
+    close(fd);
+    unlink(path);
+    return path;
+}
+
+static std::unique_ptr<display_snapshot_t> make_snapshot(uint16_t width, uint16_t rows) {
+    std::unique_ptr<display_snapshot_t> snap(new display_snapshot_t());
+
+    snap->time = 1700000000;
+    snap->band_id = 7;
+    snap->spectrum_min = -121.5f;
+    snap->spectrum_max = -73.0f;
+    snap->waterfall_min = -118.0f;
+    snap->waterfall_max = -80.25f;
+    snap->width = width;
+    snap->rows = rows;
+
+    for (int i = 0; i < DISPLAY_SNAPSHOT_BINS; i++) {
+        snap->spectrum[i] = -127 + i % 100;
+    }
+    for (uint16_t r = 0; r < rows; r++) {
+        snap->freqs[r] = 14074000 + r * 10;
+
+        for (uint16_t x = 0; x < width / 2; x++) {
+            snap->packed[r][x] = (r + x) & 0xFF;
+        }
+    }
+    return snap;
+}
+
+TEST_CASE( "Display snapshot pack", "[display_snapshot]" ) {
+    uint8_t row[8] = { 0, 17, 34, 255, 15, 16, 240, 100 };
+    uint8_t packed[4];
+    uint8_t out[8];
+
+    display_snapshot_pack(row, 8, packed);
+    display_snapshot_unpack(packed, 8, out);
+
+    /* High nibble is kept, expanded to the full range */
+    for (int i = 0; i < 8; i++) {
+        REQUIRE(out[i] == (row[i] >> 4) * 17);
+    }
+}
+
+TEST_CASE( "Display snapshot round trip", "[display_snapshot]" ) {
+    std::string path = temp_path();
+    auto        snap = make_snapshot(1024, 256);
+    auto        read = std::unique_ptr<display_snapshot_t>(new display_snapshot_t());
+
+    REQUIRE(display_snapshot_write(path.c_str(), snap.get()));
+    REQUIRE(display_snapshot_read(path.c_str(), read.get()));
+
+    REQUIRE(read->time == snap->time);
+    REQUIRE(read->band_id == snap->band_id);
+    REQUIRE(read->spectrum_min == snap->spectrum_min);
+    REQUIRE(read->spectrum_max == snap->spectrum_max);
+    REQUIRE(read->waterfall_min == snap->waterfall_min);
+    REQUIRE(read->waterfall_max == snap->waterfall_max);
+    REQUIRE(read->width == 1024);
+    REQUIRE(read->rows == 256);
+    REQUIRE(memcmp(read->spectrum, snap->spectrum, sizeof(snap->spectrum)) == 0);
+    REQUIRE(memcmp(read->freqs, snap->freqs, sizeof(snap->freqs)) == 0);
+    REQUIRE(memcmp(read->packed, snap->packed, sizeof(snap->packed)) == 0);
+
+    /* No rows */
+    snap = make_snapshot(1024, 0);
+    REQUIRE(display_snapshot_write(path.c_str(), snap.get()));
+    REQUIRE(display_snapshot_read(path.c_str(), read.get()));
+    REQUIRE(read->rows == 0);
+
+    /* Odd or too wide rows are not written */
+    snap = make_snapshot(1024, 1);
+    snap->width = 1023;
+    REQUIRE_FALSE(display_snapshot_write(path.c_str(), snap.get()));
+    snap->width = 2048;
+    REQUIRE_FALSE(display_snapshot_write(path.c_str(), snap.get()));
+
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Display snapshot bad files", "[display_snapshot]" ) {
+    std::string path = temp_path();
+    auto        snap = make_snapshot(1024, 16);
+    auto        read = std::unique_ptr<display_snapshot_t>(new display_snapshot_t());
+
+    REQUIRE_FALSE(display_snapshot_read(path.c_str(), read.get()));
+
+    /* Cut short */
+    REQUIRE(display_snapshot_write(path.c_str(), snap.get()));
+    REQUIRE(truncate(path.c_str(), 36 + DISPLAY_SNAPSHOT_BINS + 100) == 0);
+    REQUIRE_FALSE(display_snapshot_read(path.c_str(), read.get()));
+
+    /* Another version */
+    REQUIRE(display_snapshot_write(path.c_str(), snap.get()));
+
+    FILE    *f = fopen(path.c_str(), "r+b");
+    uint8_t version = DISPLAY_SNAPSHOT_VERSION + 1;
+
+    REQUIRE(f);
+    fseek(f, 4, SEEK_SET);
+    fwrite(&version, 1, 1, f);
+    fclose(f);
+    REQUIRE_FALSE(display_snapshot_read(path.c_str(), read.get()));
+
+    unlink(path.c_str());
+}
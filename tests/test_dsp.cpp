@@ -0,0 +1,896 @@
+#include "../src/dsp/adpcm.h"
+#include "../src/dsp/anf.h"
+#include "../src/dsp/channel_power.h"
+#include "../src/dsp/cw_channel.h"
+#include "../src/dsp/decim.h"
+#include "../src/dsp/fft.h"
+#include "../src/dsp/hilbert.h"
+#include "../src/dsp/moving_power.h"
+#include "../src/dsp/peak_detect.h"
+#include "../src/dsp/peak_hold.h"
+#include "../src/dsp/preproc.h"
+#include "../src/dsp/spgram.h"
+#include "../src/dsp/sub_rx.h"
+#include "../src/dsp/tone_band.h"
+#include "../src/iq_capture.h"
+
+extern "C" {
+    #include "../src/util.h"
+}
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <typeinfo>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+#define PACKET_SIZE    512
+#define WATERFALL_NFFT (PACKET_SIZE * 2)
+#define SPECTRUM_NFFT  800
+#define NUM_PACKETS    64
+#define CW_FFT         128
+#define CW_PEAK_WIDTH  22  // 30 WPM at 44100 / 64
+
+/*
+ * Replayed IQ: set X6100_IQ_FILE to .x6iq capture, otherwise synthetic noise with tones is used
+ */
+static std::vector<std::vector<cfloat>> load_packets() {
+    std::vector<std::vector<cfloat>> packets;
+    const char                      *path = getenv("X6100_IQ_FILE");
+
+    if (path) {
+        FILE            *f = fopen(path, "rb");
+        iq_file_header_t header;
+        iq_file_record_t rec;
+
+        if (f && fread(&header, sizeof(header), 1, f) == 1) {
+            while (fread(&rec, sizeof(rec), 1, f) == 1 && rec.size == PACKET_SIZE) {
+                std::vector<cfloat> p(PACKET_SIZE);
+                if (fread(p.data(), sizeof(cfloat), PACKET_SIZE, f) != PACKET_SIZE) {
+                    break;
+                }
+                packets.push_back(p);
+            }
+        }
+        if (f) {
+            fclose(f);
+        }
+        if (!packets.empty()) {
+            return packets;
+        }
+    }
+
+    std::mt19937                    gen(1);
+    std::normal_distribution<float> noise(0.0f, 1e-4f);
+    const float                     tones[] = {0.01f, -0.12f, 0.3f};
+    size_t                          n = 0;
+
+    for (size_t p = 0; p < NUM_PACKETS; p++) {
+        std::vector<cfloat> packet(PACKET_SIZE);
+        for (auto &x : packet) {
+            x = {noise(gen), noise(gen)};
+            for (float tone : tones) {
+                x += std::polar(1e-2f, 2.0f * (float)M_PI * tone * n);
+            }
+            n++;
+        }
+        packets.push_back(packet);
+    }
+    return packets;
+}
+
+TEST_CASE("dB conversion", "[dsp]") {
+    std::vector<float> psd;
+    for (float db = -120.0f; db < 40.0f; db += 0.37f) {
+        psd.push_back(powf(10.0f, db / 10.0f));
+    }
+    std::vector<float> expected(psd.size());
+    for (size_t i = 0; i < psd.size(); i++) {
+        expected[i] = 10.0f * log10f(psd[i]);
+    }
+    psd_to_db(psd.data(), psd.size());
+    for (size_t i = 0; i < psd.size(); i++) {
+        REQUIRE_THAT(psd[i], WithinAbs(expected[i], 1e-3));
+    }
+}
+
+TEST_CASE("Spgram finds tone", "[dsp]") {
+    ChunkedSpgram      sg(PACKET_SIZE, WATERFALL_NFFT);
+    std::vector<float> psd(WATERFALL_NFFT);
+    std::vector<cfloat> packet(PACKET_SIZE);
+
+    sg.set_alpha(0.8f);
+    for (size_t p = 0, n = 0; p < 4; p++) {
+        for (auto &x : packet) {
+            x = std::polar(1.0f, 2.0f * (float)M_PI * 0.25f * n++);
+        }
+        sg.execute_block(packet.data());
+    }
+    sg.get_psd(psd.data());
+    REQUIRE(argmax(psd.data(), psd.size()) == WATERFALL_NFFT / 2 + WATERFALL_NFFT / 4);
+}
+
+TEST_CASE("Spgram follows retune", "[dsp]") {
+    ChunkedSpgram       sg(PACKET_SIZE, WATERFALL_NFFT);
+    std::vector<float>  psd(WATERFALL_NFFT);
+    std::vector<cfloat> packet(PACKET_SIZE);
+    size_t              n = 0;
+
+    sg.set_alpha(0.8f);
+    for (size_t p = 0; p < 4; p++) {
+        for (auto &x : packet) {
+            x = std::polar(1.0f, 2.0f * (float)M_PI * 0.25f * n++);
+        }
+        sg.execute_block(packet.data());
+    }
+
+    // Tuned up by 10 bins: tone moves down without restart of accumulation
+    sg.shift(10.0f / WATERFALL_NFFT);
+    sg.get_psd(psd.data());
+    REQUIRE(argmax(psd.data(), psd.size()) == WATERFALL_NFFT / 2 + WATERFALL_NFFT / 4 - 10);
+
+    // History is rotated too, next transform of the shifted tone stays in the same bin
+    for (auto &x : packet) {
+        x = std::polar(1.0f, 2.0f * (float)M_PI * (0.25f - 10.0f / WATERFALL_NFFT) * n++);
+    }
+    sg.execute_block(packet.data());
+    sg.get_psd(psd.data());
+    REQUIRE(argmax(psd.data(), psd.size()) == WATERFALL_NFFT / 2 + WATERFALL_NFFT / 4 - 10);
+}
+
+TEST_CASE("Spgram hop", "[dsp]") {
+    ChunkedSpgram       *fixed = spgram_create(PACKET_SIZE, WATERFALL_NFFT);
+    ChunkedSpgram       dynamic(PACKET_SIZE, WATERFALL_NFFT);
+    ChunkedSpgram       shared(PACKET_SIZE, WATERFALL_NFFT);
+    std::vector<float>  psd(WATERFALL_NFFT);
+    std::vector<cfloat> packet(PACKET_SIZE);
+    size_t              n = 0;
+
+    fixed->set_hop(2);
+    dynamic.set_hop(2);
+    for (size_t p = 0; p < 8; p++) {
+        for (auto &x : packet) {
+            x = std::polar(1.0f, 2.0f * (float)M_PI * 0.25f * n++);
+        }
+        fixed->execute_block(packet.data());
+        dynamic.execute_block(packet.data());
+        shared.accumulate_from(&dynamic);
+    }
+    REQUIRE(fixed->get_num_transforms() == 4);
+    REQUIRE(dynamic.get_num_transforms() == 4);
+    REQUIRE(shared.get_num_transforms() == 4);
+
+    // History takes the skipped blocks too: the window of two packets is of the last ones
+    fixed->get_psd(psd.data());
+    REQUIRE(argmax(psd.data(), psd.size()) == WATERFALL_NFFT / 2 + WATERFALL_NFFT / 4);
+
+    delete fixed;
+}
+
+TEST_CASE("Spgram window of hop chunks", "[dsp]") {
+    const size_t chunk = PACKET_SIZE / 2;
+
+    // Weak tone in noise: peak over the median, for windows of 1 and 3 chunks
+    auto snr = [chunk](size_t window, bool fixed) {
+        ChunkedSpgram                   *sg = fixed ? spgram_create(chunk, SPECTRUM_NFFT, chunk)
+                                                    : new ChunkedSpgram(chunk, SPECTRUM_NFFT, chunk);
+        std::vector<float>              psd(SPECTRUM_NFFT);
+        std::vector<cfloat>             packet(chunk);
+        std::mt19937                    gen(1);
+        std::normal_distribution<float> noise(0.0f, 1.0f);
+        size_t                          n = 0;
+
+        REQUIRE(sg->get_window_max() == 3);
+        sg->set_window(window);
+        sg->set_hop(window);
+        for (size_t p = 0; p < 48; p++) {
+            for (auto &x : packet) {
+                x = cfloat(noise(gen), noise(gen)) + std::polar(0.2f, 2.0f * (float)M_PI * 0.125f * n++);
+            }
+            sg->execute_block(packet.data());
+        }
+        REQUIRE(sg->get_num_transforms() == 48 / window);
+
+        sg->get_psd(psd.data());
+        float peak = psd[SPECTRUM_NFFT / 2 + SPECTRUM_NFFT / 8];
+
+        std::nth_element(psd.begin(), psd.begin() + psd.size() / 2, psd.end());
+        delete sg;
+
+        return peak - psd[psd.size() / 2];
+    };
+
+    float snr_1 = snr(1, true);
+    float snr_3 = snr(3, true);
+
+    REQUIRE(snr_3 - snr_1 > 3.0f);
+    REQUIRE_THAT(snr(3, false), WithinAbs(snr_3, 1e-3));
+}
+
+TEST_CASE("Fixed spgram matches dynamic", "[dsp]") {
+    /* Waterfall, spectrum x4 and x7 */
+    for (size_t chunk : {PACKET_SIZE, PACKET_SIZE / 4, PACKET_SIZE / 7}) {
+        size_t              nfft   = (chunk == PACKET_SIZE) ? WATERFALL_NFFT : SPECTRUM_NFFT;
+        size_t              buffer = (chunk == PACKET_SIZE) ? 0 : chunk;
+        ChunkedSpgram       dynamic(chunk, nfft, buffer);
+        ChunkedSpgram       *fixed = spgram_create(chunk, nfft, buffer);
+        std::vector<float>  psd_dynamic(nfft), psd_fixed(nfft);
+        std::vector<cfloat> packet(chunk);
+
+        REQUIRE(typeid(*fixed) != typeid(ChunkedSpgram));
+
+        dynamic.set_alpha(0.4f);
+        fixed->set_alpha(0.4f);
+        for (size_t p = 0, n = 0; p < 8; p++) {
+            for (auto &x : packet) {
+                x = std::polar(1.0f, 0.3f * n++);
+            }
+            dynamic.execute_block(packet.data());
+            fixed->execute_block(packet.data());
+        }
+        dynamic.get_psd(psd_dynamic.data());
+        fixed->get_psd(psd_fixed.data());
+
+        for (size_t i = 0; i < nfft; i++) {
+            REQUIRE_THAT(psd_fixed[i], WithinAbs(psd_dynamic[i], 1e-4));
+        }
+        delete fixed;
+    }
+
+    /* Not instantiated */
+    ChunkedSpgram *other = spgram_create(100, SPECTRUM_NFFT, 100);
+
+    REQUIRE(typeid(*other) == typeid(ChunkedSpgram));
+    delete other;
+}
+
+TEST_CASE("Noise floor quantile", "[dsp]") {
+    NoiseFloor         nf(0.5f);
+    std::vector<float> psd(1000);
+
+    for (size_t i = 0; i < psd.size(); i++) {
+        psd[i] = -120.0f + i * 0.05f;
+    }
+    nf.update(psd.data(), psd.size());
+    REQUIRE_THAT(nf.quantile(0.15f), WithinAbs(-112.5f, 0.5f));
+}
+
+TEST_CASE("Peak decimation keeps narrow peaks", "[dsp]") {
+    std::vector<float> psd(8192, -120.0f);
+    std::vector<float> out(SPECTRUM_NFFT);
+
+    psd[4096] = -40.0f;
+    psd[4096 + 1228] = -60.0f;
+    psd[8191] = -80.0f;
+    psd_decimate_peak(psd.data(), psd.size(), out.data(), out.size());
+
+    // Same centering as the resample
+    REQUIRE(out[SPECTRUM_NFFT / 2] == -40.0f);
+    REQUIRE(out[SPECTRUM_NFFT / 2 + lroundf(1228.0f * SPECTRUM_NFFT / 8192)] == -60.0f);
+    REQUIRE(out[SPECTRUM_NFFT - 1] == -80.0f);
+    REQUIRE(std::count(out.begin(), out.end(), -120.0f) == SPECTRUM_NFFT - 3);
+}
+
+TEST_CASE("Block Hilbert gives positive frequency", "[dsp]") {
+    const size_t         size = 4410;
+    const float          freq = 0.2f;  // Inside flat part of 29 taps transformer
+    std::vector<int16_t> in(size);
+    std::vector<cfloat>  out(size);
+
+    for (size_t i = 0; i < size; i++) {
+        in[i] = 16384.0f * cosf(2.0f * (float)M_PI * freq * i);
+    }
+    BlockHilbert hilb(7, 60.0f, size);
+    hilb.execute(in.data(), size, out.data());
+
+    for (size_t i = 100; i < size - 1; i++) {
+        REQUIRE_THAT(std::abs(out[i]), WithinAbs(0.5f, 0.005f));
+        REQUIRE_THAT(std::arg(out[i + 1] / out[i]), WithinAbs(2.0f * M_PI * freq, 1e-3));
+    }
+}
+
+TEST_CASE("Peak hold keeps, decays and shifts", "[dsp]") {
+    const size_t       size = 37; // Not multiple of NEON width
+    PeakHold           ph(size);
+    std::vector<float> x(size, -100.0f);
+    std::vector<float> smoothed(size, -100.0f);
+
+    ph.set_profile({100.0f, 1.0f});
+    ph.reset(-120.0f);
+    x[size - 1] = -50.0f;
+    ph.update(x.data(), 10.0f);
+    REQUIRE(ph.values()[0] == -100.0f);
+    REQUIRE(ph.values()[size - 1] == -50.0f);
+
+    // Held for 100 ms, then decays 1 dB per update
+    std::fill(x.begin(), x.end(), -110.0f);
+    for (int i = 0; i < 10; i++) {
+        ph.update(x.data(), 10.0f);
+    }
+    REQUIRE(ph.values()[size - 1] == -50.0f);
+    ph.update(x.data(), 10.0f);
+    REQUIRE(ph.values()[size - 1] == -51.0f);
+
+    ph.shift(1, -120.0f);
+    REQUIRE(ph.values()[size - 2] == -51.0f);
+    REQUIRE(ph.values()[size - 1] == -120.0f);
+
+    // Smoothing matches lpf_block
+    std::vector<float> ref(smoothed);
+    std::vector<float> cur(x);
+    lpf_block(ref.data(), cur.data(), 0.7f, size);
+    ph.smooth_update(smoothed.data(), x.data(), 0.7f, 10.0f, false);
+    for (size_t i = 0; i < size; i++) {
+        REQUIRE_THAT(smoothed[i], WithinAbs(ref[i], 1e-4));
+    }
+}
+
+TEST_CASE("Peak detector hysteresis and tracking", "[dsp]") {
+    PeakDetector       pd(12.0f, 6.0f);
+    std::vector<float> psd(WATERFALL_NFFT, -120.0f);
+
+    auto put = [&](size_t bin, float db) {
+        psd[bin] = db;
+        psd[bin - 1] = db - 10.0f;
+        psd[bin + 1] = db - 10.0f;
+    };
+
+    put(300, -100.0f);
+    pd.update(psd.data(), psd.size());
+    REQUIRE(pd.size() == 1);
+    REQUIRE(pd.values()[0].narrow);
+    REQUIRE_THAT(pd.values()[0].bin, WithinAbs(300.0f, 0.01f));
+
+    uint16_t id = pd.values()[0].id;
+
+    // Below the start threshold: the tracked one is kept, a new one is not taken
+    std::fill(psd.begin(), psd.end(), -120.0f);
+    put(301, -112.0f);
+    put(600, -112.0f);
+    pd.update(psd.data(), psd.size());
+    REQUIRE(pd.size() == 1);
+    REQUIRE(pd.values()[0].id == id);
+    REQUIRE(pd.values()[0].hits == 2);
+
+    // Follows retune, dropped after a few rows without it
+    pd.shift(100.0f, psd.size());
+    REQUIRE_THAT(pd.values()[0].bin, WithinAbs(201.0f, 0.01f));
+
+    std::fill(psd.begin(), psd.end(), -120.0f);
+    for (int i = 0; i < 3; i++) {
+        pd.update(psd.data(), psd.size());
+    }
+    REQUIRE(pd.size() == 0);
+}
+
+TEST_CASE("ANF notches several carriers", "[dsp]") {
+    Anf                             anf(8, 4, PACKET_SIZE, 128, 500, 100000.0f / 8 / 4 / 128);
+    std::mt19937                    rng(1);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    const float                     freqs[] = {700.0f, 1200.0f, 2100.0f};
+    const float                     amps[] = {0.25f, 1.0f, 0.5f};
+    std::vector<cfloat>             buf(PACKET_SIZE);
+    size_t                          t = 0;
+    uint64_t                        now = get_time();
+    int32_t                         notches[Anf::max_notches];
+
+    anf.set_freq_from(100);
+    anf.set_freq_to(3000);
+
+    auto run = [&](bool carriers) {
+        for (int b = 0; b < 100; b++) {
+            for (size_t i = 0; i < PACKET_SIZE; i++, t++) {
+                cfloat s(noise(rng), noise(rng));
+
+                for (int k = 0; carriers && k < 3; k++) {
+                    s += std::polar(amps[k], (float)(2 * M_PI * freqs[k] * t / 100000.0));
+                }
+                buf[i] = s;
+            }
+            anf.execute_block(buf.data(), PACKET_SIZE);
+        }
+        now += 600;
+        anf.update(now, false);
+    };
+
+    // Confirmed after a few updates, window sidelobes are not notched
+    for (int u = 0; u < 5; u++) {
+        run(true);
+    }
+    REQUIRE(anf.get_notches(notches, Anf::max_notches) == 3);
+    REQUIRE(std::abs(notches[0] - 1200) <= 50);
+    REQUIRE(std::abs(notches[1] - 2100) <= 50);
+    REQUIRE(std::abs(notches[2] - 700) <= 50);
+    REQUIRE(std::abs(anf.notch_freq_subj->get() - 1200) <= 50);
+
+    // Kept over a missed update, then released
+    run(false);
+    REQUIRE(anf.get_notches(notches, Anf::max_notches) == 3);
+    for (int u = 0; u < 3; u++) {
+        run(false);
+    }
+    REQUIRE(anf.get_notches(notches, Anf::max_notches) == 0);
+    REQUIRE(anf.notch_freq_subj->get() == 0);
+}
+
+TEST_CASE("Channel power of the passband", "[dsp]") {
+    ChannelPower cp(100000, 50);
+
+    cp.set_band(100, 2800);
+
+    auto measure = [&](float freq) {
+        std::vector<cfloat> buf(PACKET_SIZE);
+        size_t              t = 0;
+        float               db = NAN;
+
+        cp.reset();
+        for (int b = 0; b < 40; b++) {
+            for (size_t i = 0; i < PACKET_SIZE; i++, t++) {
+                buf[i] = std::polar(0.5f, (float)(2 * M_PI * freq * t / 100000.0));
+            }
+            if (cp.execute(buf.data(), PACKET_SIZE)) {
+                db = cp.get_db();
+            }
+        }
+        return db;
+    };
+
+    REQUIRE_THAT(measure(1450), WithinAbs(-6.0, 0.1));
+    REQUIRE(measure(100) > -8.0f);
+    REQUIRE(measure(2800) > -8.0f);
+    REQUIRE(measure(-2000) < -18.0f);
+    REQUIRE(measure(10000) < -30.0f);
+}
+
+TEST_CASE("Moving power against wrms", "[dsp]") {
+    MovingPower mp(16, 4);
+    wrms_t      wr = wrms_create(16, 4);
+
+    SECTION("Steady tone reads the same") {
+        for (size_t t = 0; t < 1000; t++) {
+            cfloat x = std::polar(0.01f, 0.3f * t);
+
+            wrms_pushcf(wr, x);
+            bool ready = mp.push(x);
+
+            REQUIRE(ready == wrms_ready(wr));
+            if (ready && t >= 16) {
+                REQUIRE_THAT(mp.get_db() * 0.5f, WithinAbs(wrms_get_val(wr), 0.01));
+            }
+        }
+    }
+
+    SECTION("Noise reads higher by the log-mean bias") {
+        std::mt19937                    gen(1);
+        std::normal_distribution<float> norm(0.0f, 0.01f);
+        double                          diff = 0.0;
+        size_t                          outputs = 0;
+
+        for (size_t t = 0; t < 100000; t++) {
+            cfloat x(norm(gen), norm(gen));
+
+            wrms_pushcf(wr, x);
+            if (mp.push(x) && t >= 16) {
+                diff += mp.get_db() * 0.5f - wrms_get_val(wr);
+                outputs++;
+            }
+        }
+        // E[log |x|^2] of complex Gaussian is lower than log E[|x|^2] by Euler's gamma,
+        // the mean of 16 samples reads lower by ln(16) - digamma(16), so 1.18 dB in total
+        REQUIRE_THAT(diff / outputs, WithinAbs(1.18, 0.05));
+    }
+
+    SECTION("No drift after a loud burst") {
+        for (size_t t = 0; t < 100003; t++) {
+            mp.push(std::polar(t < 50000 ? 100.0f : 0.001f, 0.1f * t));
+        }
+        REQUIRE_THAT(mp.get_db(), WithinAbs(-60.0, 0.01));
+    }
+    wrms_destroy(wr);
+}
+
+TEST_CASE("Sub receiver demodulates its sideband", "[dsp]") {
+    bool        lsb = GENERATE(false, true);
+    const float dial = -20000.0f;
+    const float sign = lsb ? -1.0f : 1.0f;
+    SubRx       rx(100000, 44100);
+
+    rx.set_band(300, 2700, lsb);
+    rx.set_offset(dial);
+
+    std::vector<cfloat>  buf(PACKET_SIZE);
+    std::vector<int16_t> out(rx.max_output(PACKET_SIZE));
+    std::vector<int16_t> audio;
+    size_t               t = 0;
+
+    // 1000 Hz in the sideband, 1500 Hz of the opposite one
+    for (int b = 0; b < 200; b++) {
+        for (size_t i = 0; i < PACKET_SIZE; i++, t++) {
+            buf[i] = std::polar(0.01f, (float)(2 * M_PI * (dial + sign * 1000.0f) * t / 100000.0)) +
+                     std::polar(0.01f, (float)(2 * M_PI * (dial - sign * 1500.0f) * t / 100000.0));
+        }
+        size_t n = rx.execute(buf.data(), PACKET_SIZE, out.data());
+
+        REQUIRE(n <= out.size());
+        audio.insert(audio.end(), out.begin(), out.begin() + n);
+    }
+    REQUIRE(audio.size() >= 200 * PACKET_SIZE * 441 / 1000 - 2);
+
+    auto level = [&](float freq) {
+        double re = 0.0, im = 0.0;
+        size_t from = audio.size() / 2;
+
+        for (size_t i = from; i < audio.size(); i++) {
+            re += audio[i] * cos(2 * M_PI * freq * i / 44100.0);
+            im += audio[i] * sin(2 * M_PI * freq * i / 44100.0);
+        }
+        return 2.0 * std::hypot(re, im) / (audio.size() - from) / 32767.0;
+    };
+
+    REQUIRE_THAT(level(1000.0f), WithinAbs(0.3, 0.02));
+    REQUIRE(20.0 * log10(level(1000.0f) / level(1500.0f)) > 60.0);
+}
+
+TEST_CASE("Tone band against noise", "[dsp]") {
+    std::vector<float> psd(CW_FFT, 1.0f);
+
+    psd[5] = 200.0f;
+    tone_band_t band = tone_band(psd.data(), psd.size(), CW_PEAK_WIDTH);
+    REQUIRE(band.peak_pos == 5);
+    REQUIRE_THAT(band.ratio, WithinAbs((200.0f + CW_PEAK_WIDTH - 1) / (CW_FFT - CW_PEAK_WIDTH), 1e-3));
+
+    psd[5] = 1.0f;
+    psd[CW_FFT - 1] = 2.0f;
+    band = tone_band(psd.data(), psd.size(), CW_PEAK_WIDTH);
+    REQUIRE(band.peak_pos == CW_FFT - 1);
+    REQUIRE(band.ratio < 1.0f);
+}
+
+/*
+ * Tone keyed 60 ms on / 60 ms off at 12345 Hz and a stronger carrier 400 Hz above it
+ */
+static std::vector<cfloat> keyed_iq(size_t size, bool keyed) {
+    std::mt19937                    gen(1);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    std::vector<cfloat>             iq(size);
+
+    for (size_t n = 0; n < size; n++) {
+        float t = n / 100000.0f;
+        bool  on = keyed ? ((int)(t * 1000.0f) / 60) % 2 == 0 : true;
+
+        iq[n] = cfloat(noise(gen), noise(gen)) + std::polar(0.2f, 2.0f * (float)M_PI * 12745.0f * t);
+        if (on) {
+            iq[n] += std::polar(0.05f, 2.0f * (float)M_PI * 12345.0f * t);
+        }
+    }
+    return iq;
+}
+
+TEST_CASE("CW channel keys an offset tone", "[dsp]") {
+    CwChannel           ch(100000.0f);
+    std::vector<cfloat> iq = keyed_iq(100000 * 3, true);
+    bool                keys[PACKET_SIZE / (CW_CHANNEL_BOX * CW_CHANNEL_DECIM) + 1];
+    bool                prev = false;
+    size_t              run = 0;
+    std::vector<size_t> runs;
+
+    ch.reset(12345.0f);
+    for (size_t i = 0; i < iq.size(); i += PACKET_SIZE) {
+        size_t n = ch.execute(&iq[i], std::min((size_t)PACKET_SIZE, iq.size() - i), keys);
+
+        for (size_t k = 0; k < n; k++, run++) {
+            if (keys[k] != prev) {
+                runs.push_back(run);
+                prev = keys[k];
+                run = 0;
+            }
+        }
+    }
+    REQUIRE(ch.get_key_ms() == 1.0f);
+    REQUIRE(ch.get_snr() > 20.0f);
+    REQUIRE(runs.size() > 40);
+
+    // Elements after settling keep the keying
+    for (size_t i = runs.size() - 10; i < runs.size(); i++) {
+        REQUIRE(runs[i] >= 57);
+        REQUIRE(runs[i] <= 63);
+    }
+}
+
+static std::vector<std::complex<double>> dft(const std::vector<cfloat> &in, fft_dir_t dir) {
+    size_t                            n = in.size();
+    double                            sign = dir == FFT_DIR_FORWARD ? -1.0 : 1.0;
+    std::vector<std::complex<double>> out(n);
+
+    for (size_t k = 0; k < n; k++) {
+        for (size_t i = 0; i < n; i++) {
+            double phase = sign * 2.0 * M_PI * (double)(k * i % n) / n;
+
+            out[k] += std::complex<double>(in[i]) * std::polar(1.0, phase);
+        }
+    }
+    return out;
+}
+
+TEST_CASE("FFT backends match DFT", "[dsp]") {
+    size_t        n = GENERATE(1, 2, 3, 4, 5, 7, 8, 12, 49, 128, 800, 1024, 1152);
+    fft_dir_t     dir = GENERATE(FFT_DIR_FORWARD, FFT_DIR_BACKWARD);
+    fft_backend_t backend = GENERATE(FFT_BACKEND_NATIVE, FFT_BACKEND_LIQUID);
+
+    std::mt19937                          gen(n);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<cfloat>                   in(n), out(n);
+
+    for (auto &x : in) {
+        x = cfloat(dist(gen), dist(gen));
+    }
+
+    fft_plan_t *plan = fft_plan_get_backend(n, dir, backend);
+
+    REQUIRE(plan);
+    fft_plan_execute(plan, in.data(), out.data());
+    fft_plan_put(plan);
+
+    auto   ref = dft(in, dir);
+    double err = 0.0;
+
+    for (size_t k = 0; k < n; k++) {
+        err = std::max(err, std::abs(std::complex<double>(out[k]) - ref[k]));
+    }
+    INFO(fft_backend_name(backend) << " n=" << n);
+    REQUIRE(err < 1e-5 * n);
+}
+
+TEST_CASE("FFT plans are shared", "[dsp]") {
+    fft_plan_t *a = fft_plan_get(800, FFT_DIR_FORWARD);
+    fft_plan_t *b = fft_plan_get(800, FFT_DIR_FORWARD);
+    fft_plan_t *c = fft_plan_get(800, FFT_DIR_BACKWARD);
+    fft_plan_t *d = fft_plan_get_backend(800, FFT_DIR_FORWARD, FFT_BACKEND_LIQUID);
+
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+    REQUIRE(a != d);
+
+    fft_plan_put(a);
+    fft_plan_put(b);
+    fft_plan_put(c);
+    fft_plan_put(d);
+}
+
+TEST_CASE("ADPCM round trip", "[dsp]") {
+    const size_t            n = 441;
+    std::vector<int16_t>    in(n * 4), out(n * 4);
+    std::vector<uint8_t>    enc((n + 1) / 2);
+    adpcm_state_t           enc_state = {0, 0};
+    double                  sig = 0.0, err = 0.0;
+
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = 12000.0 * sin(2.0 * M_PI * 700.0 * i / 11025.0) + 4000.0 * sin(2.0 * M_PI * 1900.0 * i / 11025.0);
+    }
+
+    /* Frames are decoded from their own start state, one is lost */
+    for (size_t f = 0; f < 4; f++) {
+        adpcm_state_t start = enc_state;
+
+        adpcm_encode(&enc_state, &in[f * n], n, enc.data());
+
+        if (f == 2) {
+            continue;
+        }
+        adpcm_decode(&start, enc.data(), n, &out[f * n]);
+        REQUIRE(start.predictor == enc_state.predictor);
+        REQUIRE(start.index == enc_state.index);
+
+        /* Skip the step adaptation of the first frame */
+        for (size_t i = (f == 0 ? 64 : 0); i < n; i++) {
+            sig += (double)in[f * n + i] * in[f * n + i];
+            err += (double)(in[f * n + i] - out[f * n + i]) * (in[f * n + i] - out[f * n + i]);
+        }
+    }
+    REQUIRE(10.0 * log10(sig / err) > 20.0);
+}
+
+TEST_CASE("FFT backends", "[.][benchmark][dsp]") {
+    /* CW and ANF, spectrum, waterfall, FT4, FT8 */
+    for (size_t n : {128, 800, 1024, 1152, 3840}) {
+        std::vector<cfloat> in(n), out(n);
+
+        for (size_t i = 0; i < n; i++) {
+            in[i] = std::polar(1.0f, 0.1f * i);
+        }
+        for (int backend = 0; backend < FFT_BACKEND_LAST; backend++) {
+            fft_plan_t *plan = fft_plan_get_backend(n, FFT_DIR_FORWARD, (fft_backend_t)backend);
+
+            BENCHMARK(std::to_string(n) + " " + fft_backend_name((fft_backend_t)backend)) {
+                fft_plan_execute(plan, in.data(), out.data());
+                return out[1];
+            };
+            fft_plan_put(plan);
+        }
+    }
+}
+
+TEST_CASE("Fixed and dynamic spgram", "[.][benchmark][dsp]") {
+    for (size_t chunk : {PACKET_SIZE, PACKET_SIZE / 2, PACKET_SIZE / 8}) {
+        size_t              nfft   = (chunk == PACKET_SIZE) ? WATERFALL_NFFT : SPECTRUM_NFFT;
+        size_t              buffer = (chunk == PACKET_SIZE) ? 0 : chunk;
+        ChunkedSpgram       dynamic(chunk, nfft, buffer);
+        ChunkedSpgram       *fixed = spgram_create(chunk, nfft, buffer);
+        std::vector<cfloat> packet(chunk);
+
+        for (size_t i = 0; i < chunk; i++) {
+            packet[i] = std::polar(1.0f, 0.1f * i);
+        }
+        BENCHMARK(std::to_string(chunk) + "/" + std::to_string(nfft) + " dynamic") {
+            dynamic.execute_block(packet.data());
+            return packet[0];
+        };
+        BENCHMARK(std::to_string(chunk) + "/" + std::to_string(nfft) + " fixed") {
+            fixed->execute_block(packet.data());
+            return packet[0];
+        };
+        delete fixed;
+    }
+}
+
+TEST_CASE("CW tone band", "[.][benchmark][dsp]") {
+    std::mt19937                         gen(1);
+    std::exponential_distribution<float> noise(1.0f);
+    std::vector<float>                   psd(CW_FFT);
+
+    for (auto &x : psd) {
+        x = noise(gen);
+    }
+    psd[CW_FFT / 3] = 100.0f;
+    BENCHMARK("tone_band per FFT") {
+        return tone_band(psd.data(), psd.size(), CW_PEAK_WIDTH).ratio;
+    };
+}
+
+TEST_CASE("CW skimmer channel", "[.][benchmark][dsp]") {
+    CwChannel           ch(100000.0f);
+    std::vector<cfloat> iq = keyed_iq(PACKET_SIZE * NUM_PACKETS, true);
+    bool                keys[PACKET_SIZE * NUM_PACKETS / (CW_CHANNEL_BOX * CW_CHANNEL_DECIM) + 1];
+
+    ch.reset(12345.0f);
+    BENCHMARK("CW channel per packet") {
+        return ch.execute(iq.data(), PACKET_SIZE, keys);
+    };
+}
+
+TEST_CASE("process_samples stages", "[.][benchmark][dsp]") {
+    auto   packets = load_packets();
+    size_t n       = 0;
+
+    std::vector<cfloat> buf(PACKET_SIZE);
+    auto next_packet = [&]() -> cfloat * {
+        buf = packets[n++ % packets.size()];
+        return buf.data();
+    };
+
+    DcBlockSwap   dc(0.005f);
+    ChunkedSpgram wf(PACKET_SIZE, WATERFALL_NFFT);
+    ChunkedSpgram sp_shared(PACKET_SIZE, WATERFALL_NFFT);
+    Anf           anf(8, 4, PACKET_SIZE, 128, 500, 100000.0f / 8 / 4 / 128);
+
+    wf.set_alpha(0.8f);
+    sp_shared.set_alpha(0.4f);
+
+    BENCHMARK("DC block + I/Q swap") {
+        dc.execute(next_packet(), PACKET_SIZE);
+        return buf[0];
+    };
+    BENCHMARK("Waterfall spgram") {
+        wf.execute_block(next_packet());
+        return buf[0];
+    };
+    BENCHMARK("Spectrum x1 from waterfall FFT") {
+        sp_shared.accumulate_from(&wf);
+    };
+    for (size_t factor : {2, 4, 8}) {
+        DecimChain          decim(factor);
+        ChunkedSpgram       sp(PACKET_SIZE / factor, SPECTRUM_NFFT, PACKET_SIZE / factor);
+        std::vector<cfloat> dec_buf(PACKET_SIZE / factor);
+
+        sp.set_alpha(0.4f);
+        BENCHMARK("Spectrum x" + std::to_string(factor) + " decim + spgram") {
+            decim.execute(next_packet(), PACKET_SIZE / factor, dec_buf.data());
+            sp.execute_block(dec_buf.data());
+            return dec_buf[0];
+        };
+    }
+    BENCHMARK("ANF") {
+        anf.execute_block(next_packet(), PACKET_SIZE);
+        return buf[0];
+    };
+}
+
+TEST_CASE("update_spectrum/update_waterfall stages", "[.][benchmark][dsp]") {
+    auto packets = load_packets();
+
+    ChunkedSpgram wf(PACKET_SIZE, WATERFALL_NFFT);
+    ChunkedSpgram sp_shared(PACKET_SIZE, WATERFALL_NFFT);
+    NoiseFloor    nf(0.5f);
+
+    std::vector<float> wf_psd(WATERFALL_NFFT);
+    std::vector<float> shared_psd(WATERFALL_NFFT);
+    std::vector<float> sp_psd(SPECTRUM_NFFT);
+    std::vector<float> sp_filtered(SPECTRUM_NFFT, -121.0f);
+
+    wf.set_alpha(0.8f);
+    sp_shared.set_alpha(0.4f);
+    for (auto &p : packets) {
+        wf.execute_block(p.data());
+        sp_shared.accumulate_from(&wf);
+    }
+
+    BENCHMARK("Waterfall get_psd") {
+        wf.get_psd(wf_psd.data());
+        return wf_psd[0];
+    };
+    BENCHMARK("Spectrum x1 resample + dB") {
+        sp_shared.get_psd_mag(shared_psd.data());
+        psd_resample(shared_psd.data(), WATERFALL_NFFT, sp_psd.data(), SPECTRUM_NFFT, 0.64f);
+        psd_to_db(sp_psd.data(), SPECTRUM_NFFT);
+        return sp_psd[0];
+    };
+    BENCHMARK("Spectrum lpf_block") {
+        lpf_block(sp_filtered.data(), sp_psd.data(), 0.7f, SPECTRUM_NFFT);
+        return sp_filtered[0];
+    };
+    PeakHold peak_hold(SPECTRUM_NFFT);
+    BENCHMARK("Spectrum lpf + peak hold") {
+        peak_hold.smooth_update(sp_filtered.data(), sp_psd.data(), 0.7f, 66.0f, true);
+        return peak_hold.values()[0];
+    };
+    BENCHMARK("Noise floor") {
+        nf.update(wf_psd.data(), WATERFALL_NFFT);
+        return nf.quantile(0.15f);
+    };
+}
+
+TEST_CASE("Audio Hilbert", "[.][benchmark][dsp]") {
+    const size_t         size = 4410;
+    std::vector<int16_t> in(size);
+    std::vector<cfloat>  out(size);
+    BlockHilbert         hilb(7, 60.0f, size);
+
+    for (size_t i = 0; i < size; i++) {
+        in[i] = 16384.0f * cosf(0.1f * i);
+    }
+    BENCHMARK("Block Hilbert per fragment") {
+        hilb.execute(in.data(), size, out.data());
+        return out[0];
+    };
+}
+
+TEST_CASE("wrms", "[.][benchmark][dsp]") {
+    auto   packets = load_packets();
+    wrms_t wr      = wrms_create(PACKET_SIZE, 0);
+
+    BENCHMARK("wrms_pushcf per packet") {
+        for (auto &x : packets[0]) {
+            wrms_pushcf(wr, x);
+        }
+        return wrms_get_val(wr);
+    };
+    wrms_destroy(wr);
+
+    MovingPower mp(PACKET_SIZE, PACKET_SIZE);
+
+    BENCHMARK("MovingPower per packet") {
+        for (auto &x : packets[0]) {
+            mp.push(x);
+        }
+        return mp.get_db();
+    };
+}
@@ -0,0 +1,143 @@
+#include "../src/dsp/decim.h"
+#include "../src/dsp/poly_resamp.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <vector>
+
+using Catch::Matchers::WithinRel;
+
+#define PACKET_SIZE 512
+
+static std::vector<cfloat> make_tone(size_t size, float freq) {
+    std::vector<cfloat> x(size);
+    for (size_t i = 0; i < size; i++) {
+        x[i] = std::polar(1.0f, 2.0f * (float)M_PI * freq * i);
+    }
+    return x;
+}
+
+static float single_stage_level(size_t factor, std::vector<cfloat> &in) {
+    size_t              out_size = in.size() / factor;
+    std::vector<cfloat> out(out_size);
+
+    firdecim_crcf decim = firdecim_crcf_create_kaiser(factor, 8, 60.0f);
+    firdecim_crcf_set_scale(decim, sqrtf(1.0f / (float)factor));
+    firdecim_crcf_execute_block(decim, in.data(), out_size, out.data());
+    firdecim_crcf_destroy(decim);
+    return std::abs(out.back());
+}
+
+TEST_CASE("Decimation chain stages", "[dsp]") {
+    REQUIRE(DecimChain(2).get_num_stages() == 1);
+    REQUIRE(DecimChain(3).get_num_stages() == 1);
+    REQUIRE(DecimChain(6).get_num_stages() == 2);
+    REQUIRE(DecimChain(8).get_num_stages() == 3);
+}
+
+TEST_CASE("Decimation chain matches single stage level", "[dsp]") {
+    size_t factor = GENERATE(2, 3, 4, 5, 6, 7, 8);
+
+    // Tone at 1/4 of decimated bandwidth
+    std::vector<cfloat> in = make_tone(PACKET_SIZE * 4, 0.125f / factor);
+    std::vector<cfloat> out(in.size() / factor);
+
+    DecimChain chain(factor);
+    chain.execute(in.data(), out.size(), out.data());
+
+    REQUIRE_THAT(std::abs(out.back()), WithinRel(single_stage_level(factor, in), 0.05f));
+}
+
+TEST_CASE("Decimation chain rejects out of band tone", "[dsp]") {
+    size_t factor = GENERATE(2, 4, 8);
+
+    std::vector<cfloat> dc = make_tone(PACKET_SIZE * 4, 0.0f);
+    float               in_band = single_stage_level(factor, dc);
+
+    // Tone well outside of decimated bandwidth
+    std::vector<cfloat> in = make_tone(PACKET_SIZE * 4, 0.75f / factor);
+    std::vector<cfloat> out(in.size() / factor);
+
+    DecimChain chain(factor);
+    chain.execute(in.data(), out.size(), out.data());
+
+    REQUIRE(20.0f * log10f(std::abs(out.back()) / in_band) < -50.0f);
+}
+
+TEST_CASE("Polyphase resampler keeps tone level and frequency", "[dsp]") {
+    size_t block = GENERATE(576, 1920);     // FT4 and FT8 symbols at 12 kHz
+
+    std::vector<cfloat> in = make_tone(44100, 1000.0f / 44100.0f);
+    std::vector<cfloat> out;
+    std::vector<cfloat> buf(block);
+    PolyResampler       resamp(44100, 12000);
+    size_t              pos = 0;
+
+    while (pos + resamp.input_size(block) <= in.size()) {
+        size_t n = resamp.input_size(block);
+
+        resamp.execute(&in[pos], block, buf.data());
+        out.insert(out.end(), buf.begin(), buf.end());
+        pos += n;
+    }
+
+    // Input is taken by the exact ratio
+    REQUIRE((out.size() * 147 - pos * 40) < 147);
+
+    for (size_t i = 100; i < out.size(); i++) {
+        REQUIRE_THAT(std::abs(out[i]), WithinRel(1.0f, 0.01f));
+        REQUIRE_THAT(std::arg(out[i] * std::conj(out[i - 1])), WithinRel(2.0f * (float)M_PI * 1000.0f / 12000.0f, 0.01f));
+    }
+}
+
+TEST_CASE("Polyphase resampler rejects aliases", "[dsp]") {
+    float freq = GENERATE(9000.0f, 13000.0f, -15000.0f);
+
+    std::vector<cfloat> in = make_tone(44100, freq / 44100.0f);
+    std::vector<cfloat> out(1920);
+    PolyResampler       resamp(44100, 12000);
+
+    // Second block, after the filter delay
+    resamp.execute(in.data(), out.size(), out.data());
+    resamp.execute(&in[7056], out.size(), out.data());
+
+    float peak = 0.0f;
+
+    for (size_t i = 0; i < out.size(); i++) {
+        peak = std::max(peak, std::abs(out[i]));
+    }
+    REQUIRE(20.0f * log10f(peak) < -50.0f);
+}
+
+TEST_CASE("Decimation per packet", "[.][benchmark][dsp]") {
+    std::vector<cfloat> in = make_tone(PACKET_SIZE, 0.01f);
+    std::vector<cfloat> out(PACKET_SIZE);
+
+    for (size_t factor = 2; factor <= 8; factor++) {
+        firdecim_crcf decim = firdecim_crcf_create_kaiser(factor, 8, 60.0f);
+        DecimChain    chain(factor);
+
+        BENCHMARK("Single stage x" + std::to_string(factor)) {
+            firdecim_crcf_execute_block(decim, in.data(), PACKET_SIZE / factor, out.data());
+            return out[0];
+        };
+        BENCHMARK("Chain x" + std::to_string(factor)) {
+            chain.execute(in.data(), PACKET_SIZE / factor, out.data());
+            return out[0];
+        };
+        firdecim_crcf_destroy(decim);
+    }
+
+    PolyResampler       resamp(44100, 12000);
+    std::vector<cfloat> audio = make_tone(7056, 0.01f);
+    std::vector<cfloat> symbol(1920);
+
+    BENCHMARK("Polyphase 44100 -> 12000, FT8 symbol") {
+        resamp.execute(audio.data(), symbol.size(), symbol.data());
+        return symbol[0];
+    };
+}
@@ -0,0 +1,105 @@
+extern "C" {
+    #include "../src/dx_spots.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <string>
+
+static dx_spot_t make_spot(int32_t freq, const char *call) {
+    dx_spot_t spot = {};
+
+    spot.freq = freq;
+    strncpy(spot.call, call, sizeof(spot.call) - 1);
+    return spot;
+}
+
+TEST_CASE( "DX spots sorted range", "[dx_spots]" ) {
+    dx_spots_clear();
+
+    dx_spot_t a = make_spot(14025000, "R2RFE");
+    dx_spot_t b = make_spot(7010000, "R1CBU");
+    dx_spot_t c = make_spot(14074000, "JA1XYZ");
+
+    REQUIRE(dx_spots_add(&a, 1000));
+    REQUIRE(dx_spots_add(&b, 1000));
+    REQUIRE(dx_spots_add(&c, 1000));
+    REQUIRE(dx_spots_count() == 3);
+
+    dx_spot_t res[8];
+    uint16_t  n = dx_spots_range(14000000, 14350000, res, 8, 2000);
+
+    REQUIRE(n == 2);
+    REQUIRE(std::string(res[0].call) == "R2RFE");
+    REQUIRE(std::string(res[1].call) == "JA1XYZ");
+
+    REQUIRE(dx_spots_range(14000000, 14350000, res, 1, 2000) == 1);
+    REQUIRE(dx_spots_range(21000000, 21450000, res, 8, 2000) == 0);
+}
+
+TEST_CASE( "DX spots dedup and expiry", "[dx_spots]" ) {
+    dx_spots_clear();
+
+    dx_spot_t a = make_spot(14025000, "R2RFE");
+    dx_spot_t moved = make_spot(14025500, "R2RFE");
+    dx_spot_t other_band = make_spot(7025000, "R2RFE");
+
+    REQUIRE(dx_spots_add(&a, 1000));
+    REQUIRE_FALSE(dx_spots_add(&moved, 2000));
+    REQUIRE(dx_spots_count() == 1);
+    REQUIRE(dx_spots_add(&other_band, 2000));
+    REQUIRE(dx_spots_count() == 2);
+
+    dx_spot_t res[8];
+
+    REQUIRE(dx_spots_range(14000000, 14350000, res, 8, 3000) == 1);
+    REQUIRE(res[0].freq == 14025500);
+
+    /* Old spots are not returned and are dropped on the next add */
+    uint64_t later = 2000 + DX_SPOT_TTL_MS;
+
+    REQUIRE(dx_spots_range(0, 30000000, res, 8, later) == 0);
+
+    dx_spot_t fresh = make_spot(3550000, "UA3ABC");
+
+    dx_spots_add(&fresh, later);
+    REQUIRE(dx_spots_count() == 1);
+}
+
+TEST_CASE( "DX spots full store drops the oldest", "[dx_spots]" ) {
+    dx_spots_clear();
+
+    for (int i = 0; i < DX_SPOTS_MAX; i++) {
+        dx_spot_t spot = make_spot(7000000 + i * 2000, ("C" + std::to_string(i)).c_str());
+
+        dx_spots_add(&spot, 1000 + i);
+    }
+    REQUIRE(dx_spots_count() == DX_SPOTS_MAX);
+
+    dx_spot_t spot = make_spot(1840000, "NEW");
+    dx_spot_t res[2];
+
+    dx_spots_add(&spot, 1000 + DX_SPOTS_MAX);
+    REQUIRE(dx_spots_count() == DX_SPOTS_MAX);
+    REQUIRE(dx_spots_range(7000000, 7000000, res, 2, 2000) == 0);
+    REQUIRE(dx_spots_range(1840000, 1840000, res, 2, 2000) == 1);
+}
+
+TEST_CASE( "DX cluster spot line", "[dx_spots]" ) {
+    dx_spot_t spot;
+
+    REQUIRE(dx_spot_parse("DX de W3LPL:     14025.0  R2RFE        CW 599 up 1          1234Z", &spot));
+    REQUIRE(spot.freq == 14025000);
+    REQUIRE(std::string(spot.spotter) == "W3LPL");
+    REQUIRE(std::string(spot.call) == "R2RFE");
+    REQUIRE(std::string(spot.info) == "CW 599 up 1");
+
+    REQUIRE(dx_spot_parse("DX de R1CBU-#: 7074.5 JA1XYZ 0845Z", &spot));
+    REQUIRE(spot.freq == 7074500);
+    REQUIRE(std::string(spot.info).empty());
+
+    REQUIRE_FALSE(dx_spot_parse("WWV de W0MU <18>:   SFI=150, A=5, K=1", &spot));
+    REQUIRE_FALSE(dx_spot_parse("DX de W3LPL: R2RFE", &spot));
+    REQUIRE_FALSE(dx_spot_parse("login: ", &spot));
+}
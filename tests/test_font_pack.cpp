@@ -0,0 +1,84 @@
+extern "C" {
+#include "../src/fonts/font_pack.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+TEST_CASE("RLE round trip", "[font_pack]") {
+    std::vector<uint8_t> src(1000), enc(2100), dec(1000);
+
+    srand(1);
+
+    for (int t = 0; t < 1000; t++) {
+        size_t n = rand() % src.size();
+
+        // Mostly empty and full pixels, like antialiased glyphs
+        for (size_t i = 0; i < n; i++) {
+            src[i] = (rand() % 3) ? ((rand() % 2) ? 0x00 : 0xFF) : rand();
+        }
+
+        size_t size = font_pack_rle_encode(src.data(), n, enc.data());
+
+        REQUIRE(size <= n * 2 + 1);
+        REQUIRE(font_pack_rle_decode(enc.data(), size, dec.data(), dec.size()) == n);
+        REQUIRE(memcmp(src.data(), dec.data(), n) == 0);
+    }
+}
+
+TEST_CASE("Decode rejects overflow", "[font_pack]") {
+    uint8_t src[64], enc[129], dec[63];
+
+    memset(src, 0, sizeof(src));
+
+    size_t size = font_pack_rle_encode(src, sizeof(src), enc);
+
+    REQUIRE(font_pack_rle_decode(enc, size, dec, sizeof(dec)) == 0);
+}
+
+TEST_CASE("Pack bitmaps match built-in fonts", "[font_pack]") {
+    char path[] = "/tmp/font_pack_XXXXXX";
+    int  fd = mkstemp(path);
+
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    REQUIRE(font_pack_write(path));
+    REQUIRE(font_pack_init(path));
+
+    size_t glyphs = 0;
+
+    // Twice, the second pass goes through evicted cache slots
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto &entry : font_pack_fonts) {
+            for (uint32_t unicode = 0x20; unicode < 0x7F; unicode++) {
+                lv_font_glyph_dsc_t dsc;
+
+                REQUIRE(lv_font_get_glyph_dsc(entry.font, &dsc, unicode, 0));
+
+                size_t size = ((size_t) dsc.box_w * dsc.box_h * dsc.bpp + 7) / 8;
+
+                if (size == 0) {
+                    continue;
+                }
+
+                const uint8_t *expected = lv_font_get_bitmap_fmt_txt(entry.font, unicode);
+                const uint8_t *packed = font_pack_get_bitmap(entry.font, unicode);
+
+                INFO(entry.name << " U+" << std::hex << unicode);
+                REQUIRE(packed != nullptr);
+                REQUIRE(memcmp(expected, packed, size) == 0);
+                glyphs++;
+            }
+        }
+    }
+
+    REQUIRE(glyphs > 0);
+    REQUIRE(font_pack_get_bitmap(font_pack_fonts[0].font, 0x1F) == nullptr);
+    unlink(path);
+}
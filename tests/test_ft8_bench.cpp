@@ -0,0 +1,303 @@
+#include "../src/dsp/hilbert.h"
+#include "../src/dsp/poly_resamp.h"
+
+extern "C" {
+    #include "../src/ft8/worker.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <sndfile.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Offline FT8/FT4 decoding of WAV slots over the dialog RX path: Hilbert ->
+ * polyphase resampler to 12 kHz -> ftx_worker_put_rx_samples() -> ftx_worker_decode().
+ * X6100_FT8_CORPUS=<dir> benchmarks *.wav of a directory instead of the
+ * reference corpus, which is synthesized from FT8_CORPUS_DIR "/synth.txt"
+ */
+
+#define CAPTURE_RATE    44100
+#define SAMPLE_RATE     12000
+#define FRAGMENT        882
+#define FREQ_LOW        100
+#define FREQ_HIGH       3100
+#define NOISE_LEVEL     1000.0f     // RMS of the synthesized noise
+#define NOISE_SEED      6100
+#define REQUIRED_SNR    -12
+
+typedef struct {
+    float       snr;
+    float       freq;
+    float       dt;
+    std::string text;
+} synth_signal_t;
+
+typedef struct {
+    std::string                 name;
+    ftx_protocol_t              protocol;
+    std::vector<synth_signal_t> signals;
+    std::string                 path;
+} slot_t;
+
+typedef struct {
+    std::vector<std::string>    texts;
+    double                      first_wall_ms;
+    float                       first_audio_s;
+    float                       audio_s;        // Position of the current block
+    std::chrono::steady_clock::time_point start;
+} decode_state_t;
+
+static void decoded_cb(const char *text, int snr, float freq_hz, float time_sec, void *user_data) {
+    decode_state_t *state = (decode_state_t *) user_data;
+
+    if (state->texts.empty()) {
+        state->first_wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - state->start).count();
+        state->first_audio_s = state->audio_s;
+    }
+    state->texts.push_back(text);
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static float slot_time(ftx_protocol_t protocol) {
+    return protocol == FTX_PROTOCOL_FT4 ? FT4_SLOT_TIME : FT8_SLOT_TIME;
+}
+
+static std::vector<slot_t> parse_synth(const char *path) {
+    std::vector<slot_t> slots;
+    FILE                *f = fopen(path, "r");
+    char                line[256];
+
+    REQUIRE(f);
+
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char  proto[8], name[64];
+        float snr, freq, dt;
+        int   text_pos;
+
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "slot %7s %63s", proto, name) == 2) {
+            slots.push_back({name, strcmp(proto, "ft4") == 0 ? FTX_PROTOCOL_FT4 : FTX_PROTOCOL_FT8, {}, ""});
+        } else if (sscanf(line, "%f %f %f %n", &snr, &freq, &dt, &text_pos) == 3 && !slots.empty()) {
+            slots.back().signals.push_back({snr, freq, dt, line + text_pos});
+        }
+    }
+    fclose(f);
+    return slots;
+}
+
+/**
+ * Write the slot as 44.1 kHz mono WAV: signals over white noise
+ */
+static void synth_slot(slot_t &slot, const std::string &dir, std::mt19937 &rng) {
+    size_t                          n = slot_time(slot.protocol) * CAPTURE_RATE;
+    std::vector<float>              mix(n);
+    std::normal_distribution<float> noise(0.0f, NOISE_LEVEL);
+
+    for (float &x : mix) {
+        x = noise(rng);
+    }
+
+    ftx_worker_init(SAMPLE_RATE, slot.protocol, FREQ_LOW, FREQ_HIGH);
+
+    for (const synth_signal_t &sig : slot.signals) {
+        int16_t  *samples;
+        uint32_t n_samples;
+
+        REQUIRE(ftx_worker_generate_tx_samples(sig.text.c_str(), sig.freq, CAPTURE_RATE, &samples, &n_samples));
+
+        // Noise power in 2500 Hz of 0..CAPTURE_RATE/2, synth amplitude is 0.8 of full scale
+        float power = powf(10.0f, sig.snr / 10.0f) * NOISE_LEVEL * NOISE_LEVEL * 2500.0f / (CAPTURE_RATE / 2);
+        float scale = sqrtf(2.0f * power) / (32767.0f * 0.8f);
+        size_t offset = sig.dt * CAPTURE_RATE;
+
+        for (size_t i = 0; i < n_samples && offset + i < n; i++) {
+            mix[offset + i] += samples[i] * scale;
+        }
+        free(samples);
+    }
+    ftx_worker_free();
+
+    std::vector<int16_t> pcm(n);
+
+    for (size_t i = 0; i < n; i++) {
+        pcm[i] = std::lround(std::fmax(-32768.0f, std::fmin(32767.0f, mix[i])));
+    }
+
+    SF_INFO sfinfo;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    sfinfo.samplerate = CAPTURE_RATE;
+    sfinfo.channels = 1;
+    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+
+    slot.path = dir + "/" + slot.name + ".wav";
+
+    SNDFILE *file = sf_open(slot.path.c_str(), SFM_WRITE, &sfinfo);
+
+    REQUIRE(file);
+    sf_write_short(file, pcm.data(), n);
+    sf_close(file);
+}
+
+/**
+ * Decode a WAV slot just like rx_worker() of the FT8 dialog does
+ */
+static decode_state_t decode_slot(const std::string &path, ftx_protocol_t *protocol) {
+    SF_INFO sfinfo;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+
+    SNDFILE *file = sf_open(path.c_str(), SFM_READ, &sfinfo);
+
+    REQUIRE(file);
+    REQUIRE(sfinfo.samplerate >= SAMPLE_RATE);
+
+    std::vector<int16_t> frames(sfinfo.frames * sfinfo.channels);
+    std::vector<int16_t> pcm(sfinfo.frames);
+
+    sf_readf_short(file, frames.data(), sfinfo.frames);
+    sf_close(file);
+
+    for (sf_count_t i = 0; i < sfinfo.frames; i++) {
+        pcm[i] = frames[i * sfinfo.channels];
+    }
+
+    // FT4 slot is 7.5 s
+    *protocol = (float) sfinfo.frames / sfinfo.samplerate > 10.0f ? FTX_PROTOCOL_FT8 : FTX_PROTOCOL_FT4;
+
+    decode_state_t      state = {};
+    BlockHilbert        hilb(7, 60.0f, FRAGMENT);
+    PolyResampler       resamp(sfinfo.samplerate, SAMPLE_RATE);
+    std::vector<cfloat> audio;
+    std::vector<cfloat> block;
+    cfloat              fragment[FRAGMENT];
+
+    state.start = std::chrono::steady_clock::now();
+    ftx_worker_init(SAMPLE_RATE, *protocol, FREQ_LOW, FREQ_HIGH);
+    ftx_worker_set_decode_budget(1000.0f);
+    ftx_worker_set_decode_passes(3);
+    block.resize(ftx_worker_get_block_size());
+
+    for (size_t pos = 0; pos < pcm.size(); pos += FRAGMENT) {
+        size_t n = std::min((size_t) FRAGMENT, pcm.size() - pos);
+
+        hilb.execute(&pcm[pos], n, fragment);
+        audio.insert(audio.end(), fragment, fragment + n);
+    }
+
+    size_t pos = 0;
+    size_t size = resamp.input_size(block.size());
+
+    while (pos + size <= audio.size() && !ftx_worker_is_full()) {
+        resamp.execute(&audio[pos], block.size(), block.data());
+        pos += size;
+        size = resamp.input_size(block.size());
+        state.audio_s = (float) pos / sfinfo.samplerate;
+
+        ftx_worker_put_rx_samples(block.data(), block.size());
+        ftx_worker_decode(decoded_cb, ftx_worker_is_full(), &state);
+    }
+    if (!ftx_worker_is_full()) {
+        ftx_worker_decode(decoded_cb, true, &state);
+    }
+    ftx_worker_free();
+    return state;
+}
+
+static std::vector<std::string> wav_files(const char *dir) {
+    std::vector<std::string> paths;
+    DIR                      *d = opendir(dir);
+
+    if (!d) {
+        return paths;
+    }
+
+    struct dirent *entry;
+
+    while ((entry = readdir(d))) {
+        size_t len = strlen(entry->d_name);
+
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".wav") == 0) {
+            paths.push_back(std::string(dir) + "/" + entry->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+TEST_CASE( "Decode FT8/FT4 WAV corpus", "[ft8_bench]" ) {
+    std::vector<slot_t> slots;
+    const char          *env = getenv("X6100_FT8_CORPUS");
+
+    if (env) {
+        for (const std::string &path : wav_files(env)) {
+            slots.push_back({path, FTX_PROTOCOL_FT8, {}, path});
+        }
+        REQUIRE(!slots.empty());
+    } else {
+        std::mt19937 rng(NOISE_SEED);
+
+        slots = parse_synth(FT8_CORPUS_DIR "/synth.txt");
+
+        for (slot_t &slot : slots) {
+            synth_slot(slot, FT8_CORPUS_OUT, rng);
+        }
+    }
+
+    unsigned total = 0;
+    double   total_ms = 0;
+
+    printf("FT8 bench, %zu slots\n", slots.size());
+    printf("  %-24s %5s %8s %12s %10s  %s\n", "slot", "proto", "decodes", "wall ms", "first", "peak rss");
+
+    for (const slot_t &slot : slots) {
+        ftx_protocol_t protocol;
+        auto           start = std::chrono::steady_clock::now();
+        decode_state_t state = decode_slot(slot.path, &protocol);
+        double         wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        char           first[32] = "-";
+
+        if (!state.texts.empty()) {
+            snprintf(first, sizeof(first), "%.1fs/%.0fms", state.first_audio_s, state.first_wall_ms);
+        }
+        printf("  %-24s %5s %8zu %12.1f %10s  %ld kB\n", slot.name.c_str(), protocol == FTX_PROTOCOL_FT4 ? "FT4" : "FT8",
+               state.texts.size(), wall_ms, first, peak_rss_kb());
+
+        total += state.texts.size();
+        total_ms += wall_ms;
+
+        for (const synth_signal_t &sig : slot.signals) {
+            bool found = std::find(state.texts.begin(), state.texts.end(), sig.text) != state.texts.end();
+
+            printf("    %c %4.0f dB %5.0f Hz  %s\n", found ? '+' : '-', sig.snr, sig.freq, sig.text.c_str());
+
+            if (sig.snr >= REQUIRED_SNR) {
+                CHECK(found);
+            }
+        }
+    }
+    printf("  %u decodes, %.1f ms per slot\n", total, slots.empty() ? 0.0 : total_ms / slots.size());
+}
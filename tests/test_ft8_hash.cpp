@@ -0,0 +1,78 @@
+extern "C" {
+#include "../src/ft8/callsign_hash.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <cstdio>
+#include <string>
+
+using Catch::Matchers::Equals;
+
+static bool lookup(ftx_callsign_hash_type_t type, uint32_t hash, std::string &callsign) {
+    char buf[16] = {0};
+    bool found = callsign_hash_if.lookup_hash(type, hash, buf);
+
+    callsign = buf;
+    return found;
+}
+
+TEST_CASE("Lookup by all hash sizes", "[ft8_hash]") {
+    std::string callsign;
+
+    callsign_hash_clear();
+    callsign_hash_if.save_hash("R2RFE/P", 0x123456);
+
+    REQUIRE(lookup(FTX_CALLSIGN_HASH_22_BITS, 0x123456, callsign));
+    REQUIRE_THAT(callsign, Equals("R2RFE/P"));
+    REQUIRE(lookup(FTX_CALLSIGN_HASH_12_BITS, 0x123456 >> 10, callsign));
+    REQUIRE_THAT(callsign, Equals("R2RFE/P"));
+    REQUIRE(lookup(FTX_CALLSIGN_HASH_10_BITS, 0x123456 >> 12, callsign));
+    REQUIRE_THAT(callsign, Equals("R2RFE/P"));
+    REQUIRE_FALSE(lookup(FTX_CALLSIGN_HASH_22_BITS, 0x123457, callsign));
+}
+
+TEST_CASE("Full table keeps entries reachable", "[ft8_hash]") {
+    std::string callsign;
+    const int   n = CALLSIGN_HASH_SIZE * 2;
+
+    callsign_hash_clear();
+
+    for (int i = 0; i < n; i++) {
+        callsign_hash_if.save_hash(("C" + std::to_string(i)).c_str(), (i * 7919u) & 0x3FFFFF);
+    }
+    REQUIRE(callsign_hash_count() < CALLSIGN_HASH_SIZE);
+
+    uint32_t found = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (lookup(FTX_CALLSIGN_HASH_22_BITS, (i * 7919u) & 0x3FFFFF, callsign)) {
+            REQUIRE_THAT(callsign, Equals("C" + std::to_string(i)));
+            found++;
+        }
+    }
+    REQUIRE(found == callsign_hash_count());
+}
+
+TEST_CASE("Save and load", "[ft8_hash]") {
+    std::string callsign;
+    const char  *path = "test_ft8_hash.txt";
+
+    std::remove(path);
+    callsign_hash_load(path);
+    callsign_hash_clear();
+    callsign_hash_if.save_hash("PJ4/K1ABC", 0x2ABCDE);
+    REQUIRE(callsign_hash_save());
+
+    callsign_hash_clear();
+    REQUIRE_FALSE(lookup(FTX_CALLSIGN_HASH_22_BITS, 0x2ABCDE, callsign));
+
+    FILE *fp = std::fopen(path, "r");
+    char buf[16];
+    REQUIRE(fp);
+    REQUIRE(std::fscanf(fp, "%15s", buf) == 1);
+    std::fclose(fp);
+    REQUIRE_THAT(buf, Equals("PJ4/K1ABC"));
+    std::remove(path);
+}
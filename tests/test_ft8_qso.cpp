@@ -1,9 +1,13 @@
 #include "../src/ft8/qso.h"
+#include "alloc_counter.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
 
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
 #include <tuple>
 #include <vector>
@@ -344,6 +348,46 @@ TEST_CASE("Check answer to many", "[ft8_qso]") {
     qso_vec.clear();
 }
 
+static bool ea0dx_dupe(const char *remote_callsign) {
+    return strcmp(remote_callsign, "EA0DX") == 0;
+}
+
+TEST_CASE("Check skip dupes", "[ft8_qso]") {
+    const int      default_repeats = -100;
+    FTxQsoProcessor   q = FTxQsoProcessor("R2RFE", "LO02", save_qso);
+    ftx_msg_meta_t meta;
+    ftx_tx_msg_t   tx_msg = {.msg = "prev msg", .repeats = default_repeats};
+
+    q.set_dupe_cb(ea0dx_dupe);
+
+    SECTION("Dupe is not answered") {
+        q.add_rx_text("R2RFE EA0DX KK12", -5, &meta, &tx_msg);
+        REQUIRE(meta.to_me);
+        REQUIRE_THAT(tx_msg.msg, Equals("prev msg"));
+        q.add_rx_text("R2RFE EA1DX AB31", 12, &meta, &tx_msg);
+        REQUIRE_THAT(tx_msg.msg, Equals("EA1DX R2RFE +12"));
+    }
+    SECTION("Started QSO goes on") {
+        ftx_msg_meta_t cq_meta = {};
+
+        strcpy(cq_meta.call_de, "EA0DX");
+        strcpy(cq_meta.grid, "KK12");
+        cq_meta.type = FTX_MSG_TYPE_CQ;
+        q.start_qso(&cq_meta, &tx_msg);
+        q.add_rx_text("R2RFE EA0DX -05", 12, &meta, &tx_msg);
+        REQUIRE_THAT(tx_msg.msg, Equals("EA0DX R2RFE R+12"));
+    }
+    SECTION("Manual mode answers dupes") {
+        q.set_auto(false);
+        q.add_rx_text("R2RFE EA0DX KK12", -5, &meta, &tx_msg);
+        ftx_tx_msg_t manual_msg;
+
+        q.start_qso(&meta, &manual_msg);
+        REQUIRE_THAT(manual_msg.msg, Equals("EA0DX R2RFE -05"));
+    }
+    qso_vec.clear();
+}
+
 TEST_CASE("Check save qso", "[ft8_qso]") {
     const int      default_repeats = -100;
     FTxQsoProcessor   q = FTxQsoProcessor("R2RFE", "LO02", save_qso);
@@ -524,3 +568,55 @@ TEST_CASE("Check reset", "[ft8_qso]") {
     REQUIRE_THAT(tx_msg.msg, Equals("EA1DX R2RFE +07"));
     qso_vec.clear();
 }
+
+static size_t saved_qso;
+
+static void count_qso(const char *remote_callsign, const char *remote_grid, const int r_snr, const int s_snr) {
+    saved_qso++;
+}
+
+/* Slot of a busy band: CQs, others QSOs and a full QSO with us */
+static const char *busy_slot[] = {
+    "CQ EA0DX KO12",
+    "CQ DX PU2GK GG66",
+    "CQ POTA W1AW FN31",
+    "PU2GK EA1DX AB31",
+    "PU2GK EA1DX +05",
+    "W1AW EA2DX R-12",
+    "W1AW EA2DX RR73",
+    "EA3DX W1AW 73",
+    "A2AA RR73; PU2GK <RP79AA> +05",
+    "R2RFE EA1DX AB31",
+    "R2RFE EA1DX R+12",
+    "R2RFE EA1DX 73",
+};
+
+TEST_CASE("Process messages without allocation", "[ft8_qso]") {
+    FTxQsoProcessor q = FTxQsoProcessor("R2RFE", "LO02", count_qso);
+    ftx_msg_meta_t  meta;
+    ftx_tx_msg_t    tx_msg = {.msg = "", .repeats = 0};
+
+    saved_qso = 0;
+
+    size_t start = allocs;
+
+    for (int i = 0; i < 1000; i++) {
+        for (auto text : busy_slot) {
+            q.add_rx_text(text, -10, &meta, &tx_msg);
+        }
+        q.start_new_slot();
+    }
+
+    size_t count = allocs - start;
+
+    REQUIRE(count == 0);
+    REQUIRE(saved_qso == 1000);
+
+    BENCHMARK("Busy slot") {
+        for (auto text : busy_slot) {
+            q.add_rx_text(text, -10, &meta, &tx_msg);
+        }
+        q.start_new_slot();
+        return tx_msg.repeats;
+    };
+}
@@ -0,0 +1,104 @@
+#include "../src/jitter_buffer.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <vector>
+
+static const uint16_t frame = 4;
+
+static std::vector<int16_t> make_frame(int16_t v) {
+    return std::vector<int16_t>(frame, v);
+}
+
+/* Frame value of a playout, 0 while buffering */
+static int16_t play(jitter_buffer_t *jb) {
+    int16_t out[frame];
+
+    if (!jitter_buffer_get(jb, out)) {
+        return 0;
+    }
+    return out[0];
+}
+
+TEST_CASE("Playout after the target", "[jitter_buffer]") {
+    static jitter_buffer_t jb = {};
+
+    jitter_buffer_reset(&jb, frame, 3);
+
+    REQUIRE(jitter_buffer_put(&jb, 100, make_frame(1).data()));
+    REQUIRE(play(&jb) == 0);
+    REQUIRE(jitter_buffer_put(&jb, 102, make_frame(3).data()));
+    REQUIRE(jitter_buffer_depth(&jb) == 3);
+
+    /* Reordered frame comes in time */
+    REQUIRE(jitter_buffer_put(&jb, 101, make_frame(2).data()));
+    REQUIRE(play(&jb) == 1);
+    REQUIRE(play(&jb) == 2);
+    REQUIRE(play(&jb) == 3);
+    REQUIRE(jb.stats.lost == 0);
+
+    /* Too late, and duplicates */
+    REQUIRE_FALSE(jitter_buffer_put(&jb, 101, make_frame(2).data()));
+    REQUIRE(jitter_buffer_put(&jb, 103, make_frame(4).data()));
+    REQUIRE_FALSE(jitter_buffer_put(&jb, 103, make_frame(4).data()));
+    REQUIRE(jb.stats.late == 2);
+}
+
+TEST_CASE("Lost frame is concealed", "[jitter_buffer]") {
+    static jitter_buffer_t jb = {};
+
+    jitter_buffer_reset(&jb, frame, 2);
+
+    jitter_buffer_put(&jb, 0, make_frame(1000).data());
+    jitter_buffer_put(&jb, 2, make_frame(3000).data());
+
+    REQUIRE(play(&jb) == 1000);
+    REQUIRE(play(&jb) == 500);
+    REQUIRE(play(&jb) == 3000);
+    REQUIRE(jb.stats.lost == 1);
+}
+
+TEST_CASE("Underrun and catch up", "[jitter_buffer]") {
+    static jitter_buffer_t jb = {};
+
+    jitter_buffer_reset(&jb, frame, 2);
+
+    jitter_buffer_put(&jb, 0, make_frame(1).data());
+    jitter_buffer_put(&jb, 1, make_frame(2).data());
+    REQUIRE(play(&jb) == 1);
+    REQUIRE(play(&jb) == 2);
+
+    /* Empty, buffering again */
+    REQUIRE(play(&jb) == 0);
+    REQUIRE(jb.stats.underruns == 1);
+    jitter_buffer_put(&jb, 2, make_frame(3).data());
+    REQUIRE(play(&jb) == 0);
+
+    /* Burst over twice the target, the oldest are skipped */
+    for (uint16_t seq = 3; seq < 9; seq++) {
+        jitter_buffer_put(&jb, seq, make_frame(seq + 1).data());
+    }
+    REQUIRE(play(&jb) == 6);
+    REQUIRE(jb.stats.skipped == 3);
+    REQUIRE(jitter_buffer_depth(&jb) == 3);
+}
+
+TEST_CASE("Sender restart", "[jitter_buffer]") {
+    static jitter_buffer_t jb = {};
+
+    jitter_buffer_reset(&jb, frame, 1);
+
+    jitter_buffer_put(&jb, 65535, make_frame(1).data());
+    REQUIRE(play(&jb) == 1);
+
+    /* Sequence wraps */
+    jitter_buffer_put(&jb, 0, make_frame(2).data());
+    REQUIRE(play(&jb) == 2);
+
+    /* Far away, both directions */
+    REQUIRE(jitter_buffer_put(&jb, 5000, make_frame(3).data()));
+    REQUIRE(play(&jb) == 3);
+    REQUIRE(jitter_buffer_put(&jb, 10, make_frame(4).data()));
+    REQUIRE(play(&jb) == 4);
+}
@@ -0,0 +1,109 @@
+#include "../src/lock_stats.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const lock_stats_t * find(const lock_stats_t *stats, size_t n, const char *name) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(stats[i].name, name) == 0) {
+            return &stats[i];
+        }
+    }
+    return nullptr;
+}
+
+TEST_CASE( "Lock stats uncontended", "[lock_stats]" ) {
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    for (int i = 0; i < 10; i++) {
+        lock_stats_lock(&mutex, "plain");
+        lock_stats_unlock(&mutex, "plain");
+    }
+
+    lock_stats_t        stats[LOCK_STATS_MAX];
+    size_t              n = lock_stats_get(stats, LOCK_STATS_MAX, true);
+    const lock_stats_t  *s = find(stats, n, "plain");
+
+    REQUIRE(s);
+    REQUIRE(s->acquisitions == 10);
+    REQUIRE(s->contended == 0);
+    REQUIRE(s->wait_hist[0] == 10);
+
+    /* Reset */
+    n = lock_stats_get(stats, LOCK_STATS_MAX, false);
+    s = find(stats, n, "plain");
+
+    REQUIRE(s);
+    REQUIRE(s->acquisitions == 0);
+}
+
+TEST_CASE( "Lock stats contended", "[lock_stats]" ) {
+    pthread_mutex_t     mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::atomic<bool>   locked(false);
+    std::atomic<int>    holder(0);
+
+    std::thread thread([&] {
+        holder = syscall(SYS_gettid);
+        lock_stats_lock(&mutex, "busy");
+        locked = true;
+        usleep(20000);
+        lock_stats_unlock(&mutex, "busy");
+    });
+
+    while (!locked) {
+        usleep(100);
+    }
+    lock_stats_lock(&mutex, "busy");
+    lock_stats_unlock(&mutex, "busy");
+    thread.join();
+
+    lock_stats_t        stats[LOCK_STATS_MAX];
+    size_t              n = lock_stats_get(stats, LOCK_STATS_MAX, true);
+    const lock_stats_t  *s = find(stats, n, "busy");
+
+    REQUIRE(s);
+    REQUIRE(s->acquisitions == 2);
+    REQUIRE(s->contended == 1);
+    REQUIRE(s->wait_max_us >= 5000);
+    REQUIRE(s->wait_max_owner == holder);
+    REQUIRE(s->hold_max_us >= 20000);
+    REQUIRE(s->hold_max_owner == holder);
+
+    uint32_t waits = 0;
+
+    for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+        waits += s->wait_hist[i];
+    }
+    REQUIRE(waits == 2);
+}
+
+TEST_CASE( "Lock stats cond wait ends the hold", "[lock_stats]" ) {
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 30000000;
+
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    lock_stats_lock(&mutex, "cond");
+    lock_stats_cond_timedwait(&cond, &mutex, "cond", &ts);
+    lock_stats_unlock(&mutex, "cond");
+
+    lock_stats_t        stats[LOCK_STATS_MAX];
+    size_t              n = lock_stats_get(stats, LOCK_STATS_MAX, true);
+    const lock_stats_t  *s = find(stats, n, "cond");
+
+    REQUIRE(s);
+    REQUIRE(s->acquisitions == 1);
+    REQUIRE(s->hold_max_us < 20000);
+}
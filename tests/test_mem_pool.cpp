@@ -0,0 +1,119 @@
+#include "../src/mem_pool.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static mem_pool_stats_t stats() {
+    mem_pool_stats_t s;
+
+    mem_pool_stats(&s);
+    return s;
+}
+
+TEST_CASE("Size classes", "[mem_pool]") {
+    void *a = mem_pool_alloc(1);
+    void *b = mem_pool_alloc(17);
+    void *c = mem_pool_alloc(MEM_POOL_MAX_SIZE);
+
+    REQUIRE(mem_pool_owns(a));
+    REQUIRE(mem_pool_block_size(a) == 16);
+    REQUIRE(mem_pool_block_size(b) == 24);
+    REQUIRE(mem_pool_block_size(c) == MEM_POOL_MAX_SIZE);
+    REQUIRE(mem_pool_alloc(0) == NULL);
+    REQUIRE(mem_pool_alloc(MEM_POOL_MAX_SIZE + 1) == NULL);
+
+    int on_heap;
+
+    REQUIRE_FALSE(mem_pool_owns(&on_heap));
+
+    mem_pool_free(a);
+    mem_pool_free(b);
+    mem_pool_free(c);
+    REQUIRE(stats().pages == 0);
+    REQUIRE(stats().used == 0);
+}
+
+TEST_CASE("Blocks don't overlap", "[mem_pool]") {
+    std::vector<uint32_t *> blocks;
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t *p = (uint32_t *) mem_pool_alloc(40);
+
+        REQUIRE(p);
+        REQUIRE((uintptr_t) p % 8 == 0);
+        for (int k = 0; k < 10; k++) {
+            p[k] = i;
+        }
+        blocks.push_back(p);
+    }
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+        REQUIRE(blocks[i][0] == i);
+        REQUIRE(blocks[i][9] == i);
+    }
+    REQUIRE(stats().blocks == 1000);
+
+    for (uint32_t *p : blocks) {
+        mem_pool_free(p);
+    }
+    REQUIRE(stats().pages == 0);
+}
+
+TEST_CASE("Empty pages serve other classes", "[mem_pool]") {
+    std::vector<void *> blocks;
+    uint32_t            overflows = stats().overflows;
+
+    while (void *p = mem_pool_alloc(16)) {
+        blocks.push_back(p);
+    }
+    REQUIRE(blocks.size() == MEM_POOL_ARENA / 16);
+    REQUIRE(stats().overflows == overflows + 1);
+
+    for (void *p : blocks) {
+        mem_pool_free(p);
+    }
+    blocks.clear();
+
+    while (void *p = mem_pool_alloc(MEM_POOL_MAX_SIZE)) {
+        blocks.push_back(p);
+    }
+    REQUIRE(blocks.size() == MEM_POOL_ARENA / MEM_POOL_MAX_SIZE);
+
+    for (void *p : blocks) {
+        mem_pool_free(p);
+    }
+    REQUIRE(stats().pages == 0);
+}
+
+TEST_CASE("Churn doesn't grow the pool", "[mem_pool]") {
+    const size_t        live = 2000;
+    std::vector<void *> blocks(live, nullptr);
+    size_t              peak = 0;
+
+    srand(1);
+
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 20000; i++) {
+            size_t k = rand() % live;
+
+            if (blocks[k]) {
+                mem_pool_free(blocks[k]);
+            }
+            blocks[k] = mem_pool_alloc(1 + rand() % MEM_POOL_MAX_SIZE);
+            REQUIRE(blocks[k]);
+        }
+        if (round == 4) {
+            peak = stats().pages_max;
+        }
+    }
+    /* Settled after the first rounds */
+    REQUIRE(stats().pages_max <= peak + peak / 10);
+
+    for (void *p : blocks) {
+        mem_pool_free(p);
+    }
+    REQUIRE(stats().pages == 0);
+}
@@ -0,0 +1,123 @@
+extern "C" {
+    #include "../src/psk_ipfix.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <vector>
+
+static psk_spot_t make_spot(const char *call, const char *grid, uint32_t freq, int8_t snr) {
+    psk_spot_t spot = {};
+
+    strncpy(spot.call, call, sizeof(spot.call) - 1);
+    strncpy(spot.grid, grid, sizeof(spot.grid) - 1);
+    strcpy(spot.mode, "FT8");
+    spot.freq = freq;
+    spot.snr = snr;
+    spot.time = 1700000000;
+    return spot;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return ((uint32_t) get_u16(p) << 16) | get_u16(p + 2);
+}
+
+TEST_CASE( "PSK Reporter datagram layout", "[psk_ipfix]" ) {
+    psk_receiver_t  rx = { "R2RFE", "KO85", "X6100 GUI", 0x12345678, 7 };
+    psk_spot_t      spots[] = {
+        make_spot("JA1XYZ", "PM95", 14075123, -12),
+        make_spot("W1AW", "", 14074800, 3),
+    };
+    uint8_t         buf[PSK_IPFIX_MAX];
+    size_t          count = 2;
+    size_t          size = psk_ipfix_encode(buf, sizeof(buf), &rx, spots, &count, 1700000100);
+
+    REQUIRE(count == 2);
+    REQUIRE(size % 4 == 0);
+    REQUIRE(get_u16(buf) == 0x000A);
+    REQUIRE(get_u16(buf + 2) == size);
+    REQUIRE(get_u32(buf + 4) == 1700000100);
+    REQUIRE(get_u32(buf + 8) == 7);
+    REQUIRE(get_u32(buf + 12) == 0x12345678);
+
+    /* Sets follow each other up to the end */
+    std::vector<uint16_t> ids;
+
+    for (size_t pos = 16; pos < size; pos += get_u16(buf + pos + 2)) {
+        REQUIRE(get_u16(buf + pos + 2) % 4 == 0);
+        ids.push_back(get_u16(buf + pos));
+    }
+    std::vector<uint16_t> expected = { 3, 2, 0x9992, 0x9993 };
+
+    REQUIRE(ids == expected);
+
+    /* Receiver record */
+    const uint8_t *p = buf + 16 + 36 + 60 + 4;
+
+    REQUIRE(p[0] == 5);
+    REQUIRE(memcmp(p + 1, "R2RFE", 5) == 0);
+    REQUIRE(p[6] == 4);
+    REQUIRE(memcmp(p + 7, "KO85", 4) == 0);
+
+    /* First sender record */
+    p = buf + 16 + 36 + 60;
+    p += get_u16(p + 2) + 4;
+
+    REQUIRE(p[0] == 6);
+    REQUIRE(memcmp(p + 1, "JA1XYZ", 6) == 0);
+    REQUIRE(get_u32(p + 7) == 14075123);
+    REQUIRE((int8_t) p[11] == -12);
+    REQUIRE(p[12] == 3);
+    REQUIRE(memcmp(p + 13, "FT8", 3) == 0);
+    REQUIRE(p[16] == 4);
+    REQUIRE(p[21] == 1);
+    REQUIRE(get_u32(p + 22) == 1700000000);
+}
+
+TEST_CASE( "PSK Reporter datagram split", "[psk_ipfix]" ) {
+    psk_receiver_t          rx = { "R2RFE", "", "X6100 GUI", 1, 0 };
+    std::vector<psk_spot_t> spots(100, make_spot("JA1XYZ", "PM95EN", 7074000, 0));
+    uint8_t                 buf[PSK_IPFIX_MAX];
+    size_t                  done = 0;
+    int                     packets = 0;
+
+    while (done < spots.size()) {
+        size_t count = spots.size() - done;
+        size_t size = psk_ipfix_encode(buf, sizeof(buf), &rx, &spots[done], &count, 0);
+
+        REQUIRE(count > 0);
+        REQUIRE(size <= PSK_IPFIX_MAX);
+        REQUIRE(get_u16(buf + 2) == size);
+        done += count;
+        packets++;
+    }
+    REQUIRE(packets == 3);
+
+    size_t count = 1;
+
+    REQUIRE(psk_ipfix_encode(buf, 100, &rx, spots.data(), &count, 0) == 0);
+    REQUIRE(count == 0);
+}
+
+TEST_CASE( "PSK Reporter callsign and locator", "[psk_ipfix]" ) {
+    REQUIRE(psk_call_valid("R2RFE"));
+    REQUIRE(psk_call_valid("R2RFE/P"));
+    REQUIRE(psk_call_valid("VK2/W1AW"));
+    REQUIRE_FALSE(psk_call_valid("<...>"));
+    REQUIRE_FALSE(psk_call_valid("CQ"));
+    REQUIRE_FALSE(psk_call_valid("TEST"));
+    REQUIRE_FALSE(psk_call_valid("r2rfe"));
+    REQUIRE_FALSE(psk_call_valid("/R2RFE"));
+
+    REQUIRE(psk_grid_valid("KO85"));
+    REQUIRE(psk_grid_valid("KO85ts"));
+    REQUIRE_FALSE(psk_grid_valid("RR73"));
+    REQUIRE_FALSE(psk_grid_valid("ZZ00"));
+    REQUIRE_FALSE(psk_grid_valid("-12"));
+    REQUIRE_FALSE(psk_grid_valid(""));
+}
@@ -5,9 +5,11 @@ extern "C" {
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 using Catch::Matchers::WithinAbs;
 using Catch::Matchers::Equals;
@@ -31,3 +33,110 @@ TEST_CASE( "Distance between points", "[qth]" ) {
     double dist = qth_pos_dist(50.633174563518885,52.99085997976364,63.59940125996173,163.01660120487216);
     REQUIRE_THAT(dist, WithinAbs(5940.4 , 1e-1));
 }
+
+
+/* Grids over the whole map, with repeats like FT8 slots */
+static std::vector<std::string> test_grids(size_t n) {
+    std::vector<std::string> grids;
+
+    for (size_t i = 0; i < n; i++) {
+        char grid[5];
+
+        grid[0] = 'A' + (i * 7) % 18;
+        grid[1] = 'A' + (i * 11) % 18;
+        grid[2] = '0' + (i * 3) % 10;
+        grid[3] = '0' + (i * 13) % 10;
+        grid[4] = 0;
+        grids.push_back(grid);
+    }
+    return grids;
+}
+
+TEST_CASE( "Cached grid position", "[qth]" ) {
+    qth_pos_t   pos;
+    double      lat, lon;
+
+    REQUIRE(qth_grid_pos("LO02QR82", &pos));
+    qth_str_to_pos("LO02QR82", &lat, &lon);
+    REQUIRE_THAT(pos.lat_deg, WithinAbs(lat, 1.0E-9));
+    REQUIRE_THAT(pos.lon_deg, WithinAbs(lon, 1.0E-9));
+
+    // Case of subsquare doesn't matter, second lookup is from the cache
+    REQUIRE(qth_grid_pos("LO02qr82", &pos));
+    REQUIRE_THAT(pos.lat_deg, WithinAbs(lat, 1.0E-9));
+
+    REQUIRE_FALSE(qth_grid_pos("SS00", &pos));
+    REQUIRE_FALSE(qth_grid_pos("", &pos));
+}
+
+TEST_CASE( "Batched distance and bearing", "[qth]" ) {
+    qth_pos_t   from, to[2];
+    double      dist[2], bearing[2];
+
+    qth_pos_init(&from, 50.633174563518885, 52.99085997976364);
+    qth_pos_init(&to[0], 63.59940125996173, 163.01660120487216);
+    qth_pos_init(&to[1], 50.633174563518885, 52.99085997976364);
+
+    qth_pos_dist_batch(&from, to, 2, dist, bearing);
+
+    REQUIRE_THAT(dist[0], WithinAbs(5940.4, 1e-1));
+    REQUIRE_THAT(dist[1], WithinAbs(0.0, 1e-3));
+
+    // Due north and due east
+    qth_pos_init(&from, 0.0, 0.0);
+    qth_pos_init(&to[0], 10.0, 0.0);
+    qth_pos_init(&to[1], 0.0, 10.0);
+
+    qth_pos_dist_batch(&from, to, 2, dist, bearing);
+
+    REQUIRE_THAT(bearing[0], WithinAbs(0.0, 1e-6));
+    REQUIRE_THAT(bearing[1], WithinAbs(90.0, 1e-6));
+}
+
+TEST_CASE( "Batched distance matches haversine", "[qth]" ) {
+    auto        grids = test_grids(1000);
+    qth_pos_t   from;
+
+    qth_grid_pos("KO85", &from);
+
+    for (auto &grid : grids) {
+        qth_pos_t   pos;
+        double      dist;
+
+        REQUIRE(qth_grid_pos(grid.c_str(), &pos));
+        qth_pos_dist_batch(&from, &pos, 1, &dist, NULL);
+
+        REQUIRE_THAT(dist, WithinAbs(qth_pos_dist(from.lat_deg, from.lon_deg, pos.lat_deg, pos.lon_deg), 1e-3));
+    }
+}
+
+TEST_CASE( "Grid distance throughput", "[.][benchmark][qth]" ) {
+    auto                    grids = test_grids(50);
+    std::vector<qth_pos_t>  pos(grids.size());
+    std::vector<double>     dist(grids.size());
+    qth_pos_t               from;
+    double                  cur_lat, cur_lon;
+
+    qth_grid_pos("KO85", &from);
+    qth_str_to_pos("KO85", &cur_lat, &cur_lon);
+
+    BENCHMARK("qth_str_to_pos + qth_pos_dist") {
+        double sum = 0;
+
+        for (auto &grid : grids) {
+            double lat, lon;
+
+            qth_str_to_pos(grid.c_str(), &lat, &lon);
+            sum += qth_pos_dist(lat, lon, cur_lat, cur_lon);
+        }
+        return sum;
+    };
+
+    BENCHMARK("qth_grid_pos + qth_pos_dist_batch") {
+        for (size_t i = 0; i < grids.size(); i++) {
+            qth_grid_pos(grids[i].c_str(), &pos[i]);
+        }
+        qth_pos_dist_batch(&from, pos.data(), pos.size(), dist.data(), NULL);
+        return dist[0];
+    };
+}
@@ -0,0 +1,332 @@
+#include "lvgl/lvgl.h"
+#include "../src/widgets/lv_spectrum.h"
+#include "../src/widgets/lv_waterfall.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Drawing cost of the hot widgets through the full lv_refr path on an off-screen
+ * display, like main.c: 800x480, 1/10 screen draw buffer, with and without the
+ * LVGL rotation (DISP_SW_ROTATE). Per frame: render time, pixels refreshed
+ * (monitor_cb, the joined invalidated areas) and flushed to the panel.
+ */
+
+#define WIDTH               800
+#define HEIGHT              480
+#define DISP_BUF_SIZE       (WIDTH * HEIGHT / 10)
+#define SPECTRUM_BINS       800
+#define SPECTRUM_HEIGHT     (HEIGHT / 3)
+#define WATERFALL_Y         (SPECTRUM_HEIGHT + 36)
+#define WATERFALL_HEIGHT    (HEIGHT - WATERFALL_Y)
+#define GRID_MIN            (-121.0f)
+#define GRID_MAX            (-73.0f)
+#define FRAMES              100
+
+typedef struct {
+    uint64_t    refreshed;
+    uint64_t    flushed;
+} px_stats_t;
+
+static px_stats_t px_stats;
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p) {
+    px_stats.flushed += lv_area_get_size(area);
+    lv_disp_flush_ready(drv);
+}
+
+static void monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px) {
+    px_stats.refreshed += px;
+}
+
+class Display {
+    lv_color_t          buf[DISP_BUF_SIZE];
+    lv_disp_draw_buf_t  draw_buf;
+    lv_disp_drv_t       drv;
+    lv_disp_t           *disp;
+
+  public:
+    Display(bool sw_rotate) {
+        if (!lv_is_initialized()) {
+            lv_init();
+        }
+        lv_disp_draw_buf_init(&draw_buf, buf, NULL, DISP_BUF_SIZE);
+        lv_disp_drv_init(&drv);
+
+        drv.draw_buf = &draw_buf;
+        drv.flush_cb = flush_cb;
+        drv.monitor_cb = monitor_cb;
+
+        if (sw_rotate) {
+            drv.hor_res = HEIGHT;
+            drv.ver_res = WIDTH;
+            drv.sw_rotate = 1;
+            drv.rotated = LV_DISP_ROT_90;
+        } else {
+            drv.hor_res = WIDTH;
+            drv.ver_res = HEIGHT;
+        }
+        disp = lv_disp_drv_register(&drv);
+
+        lv_obj_t *scr = lv_disp_get_scr_act(disp);
+
+        lv_obj_set_style_bg_color(scr, lv_color_black(), 0);
+        lv_obj_clear_flag(scr, LV_OBJ_FLAG_SCROLLABLE);
+    }
+
+    ~Display() {
+        lv_disp_remove(disp);
+    }
+
+    lv_obj_t * screen() {
+        return lv_disp_get_scr_act(disp);
+    }
+
+    void refresh() {
+        lv_refr_now(disp);
+    }
+};
+
+/* Noise floor with a few drifting carriers, dB */
+class SyntheticPsd {
+    std::mt19937                            gen{1};
+    std::normal_distribution<float>         noise{0.0f, 2.5f};
+    size_t                                  frame = 0;
+
+  public:
+    void next(float *psd, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            psd[i] = -112.0f + noise(gen);
+        }
+        for (size_t k = 0; k < 6; k++) {
+            size_t center = (k * n / 6 + frame * (k + 1)) % n;
+
+            for (int d = -2; d <= 2; d++) {
+                size_t i = (center + n + d) % n;
+
+                psd[i] = std::max(psd[i], -80.0f - 6.0f * std::abs(d) - k);
+            }
+        }
+        frame++;
+    }
+};
+
+static std::vector<lv_color_t> make_palette() {
+    std::vector<lv_color_t> palette(256);
+
+    for (size_t i = 0; i < palette.size(); i++) {
+        palette[i] = lv_color_make(i, i / 2, 255 - i);
+    }
+    return palette;
+}
+
+/*
+ * Main waterfall of waterfall.c: a true color frame of twice the height, each
+ * row is written twice and the image source moves up by a row
+ */
+class ImgWaterfall {
+    std::vector<lv_color_t> frame;
+    std::vector<lv_color_t> palette = make_palette();
+    lv_img_dsc_t            view;
+    lv_obj_t                *img;
+    lv_coord_t              head = 0;
+
+  public:
+    ImgWaterfall(lv_obj_t *parent) : frame(WIDTH * WATERFALL_HEIGHT * 2) {
+        memset(&view, 0, sizeof(view));
+        view.header.cf = LV_IMG_CF_TRUE_COLOR;
+        view.header.w = WIDTH;
+        view.header.h = WATERFALL_HEIGHT;
+        view.data_size = WIDTH * WATERFALL_HEIGHT * sizeof(lv_color_t);
+        view.data = (const uint8_t *) frame.data();
+
+        img = lv_img_create(parent);
+        lv_obj_set_pos(img, 0, WATERFALL_Y);
+        lv_img_set_src(img, &view);
+    }
+
+    void add(const float *psd, size_t n) {
+        head = (head + WATERFALL_HEIGHT - 1) % WATERFALL_HEIGHT;
+
+        lv_color_t *row = &frame[head * WIDTH];
+
+        for (size_t x = 0; x < WIDTH; x++) {
+            float v = (psd[x * n / WIDTH] - GRID_MIN) / (GRID_MAX - GRID_MIN) * 255.0f;
+
+            row[x] = palette[(uint8_t) std::min(std::max(v, 0.0f), 255.0f)];
+        }
+        memcpy(row + WIDTH * WATERFALL_HEIGHT, row, WIDTH * sizeof(lv_color_t));
+
+        view.data = (const uint8_t *) &frame[head * WIDTH];
+        lv_img_cache_invalidate_src(&view);
+        lv_obj_invalidate(img);
+    }
+};
+
+/* Widgets as laid out by main_screen.c and dialog_ft8.c */
+class Widgets {
+    std::vector<lv_color_t> palette = make_palette();
+
+  public:
+    lv_obj_t        *spectrum;
+    lv_obj_t        *ft8_waterfall;
+    ImgWaterfall    *waterfall;
+
+    Widgets(lv_obj_t *parent) {
+        spectrum = lv_spectrum_create(parent);
+        lv_obj_set_size(spectrum, WIDTH, SPECTRUM_HEIGHT);
+        lv_obj_set_style_bg_color(spectrum, lv_color_black(), 0);
+        lv_obj_set_style_bg_opa(spectrum, LV_OPA_COVER, 0);
+        lv_spectrum_set_colors(spectrum, lv_color_hex(0xAAAAAA), lv_color_hex(0x555555));
+
+        waterfall = new ImgWaterfall(parent);
+
+        ft8_waterfall = lv_waterfall_create(parent);
+        lv_obj_clear_flag(ft8_waterfall, LV_OBJ_FLAG_SCROLLABLE);
+        lv_waterfall_set_palette(ft8_waterfall, palette.data(), palette.size());
+        lv_waterfall_set_size(ft8_waterfall, 774, 325);
+        lv_waterfall_set_min(ft8_waterfall, GRID_MIN);
+        lv_waterfall_set_max(ft8_waterfall, GRID_MAX);
+        lv_obj_set_pos(ft8_waterfall, 13, 13);
+        lv_obj_add_flag(ft8_waterfall, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    ~Widgets() {
+        delete waterfall;
+    }
+};
+
+typedef enum {
+    SCENE_SPECTRUM = 0,
+    SCENE_WATERFALL,
+    SCENE_MAIN,         /* Spectrum and waterfall, as on the main screen */
+    SCENE_FT8,
+} scene_t;
+
+static const char * scene_names[] = { "spectrum", "waterfall", "main screen", "FT8 waterfall" };
+
+class Bench {
+    Display         display;
+    Widgets         widgets;
+    SyntheticPsd    gen;
+    scene_t         scene;
+    float           psd[SPECTRUM_BINS];
+    float           peak[SPECTRUM_BINS];
+
+  public:
+    Bench(bool sw_rotate, scene_t scene) : display(sw_rotate), widgets(display.screen()), scene(scene) {
+        for (size_t i = 0; i < SPECTRUM_BINS; i++) {
+            peak[i] = GRID_MIN;
+        }
+        if (scene == SCENE_FT8) {
+            lv_obj_clear_flag(widgets.ft8_waterfall, LV_OBJ_FLAG_HIDDEN);
+        }
+        display.refresh();
+    }
+
+    void frame() {
+        gen.next(psd, SPECTRUM_BINS);
+
+        if (scene == SCENE_SPECTRUM || scene == SCENE_MAIN) {
+            for (size_t i = 0; i < SPECTRUM_BINS; i++) {
+                peak[i] = std::max(peak[i] - 0.5f, psd[i]);
+            }
+            lv_spectrum_set_data(widgets.spectrum, psd, peak, SPECTRUM_BINS, GRID_MIN, GRID_MAX, 0);
+        }
+        if (scene == SCENE_WATERFALL || scene == SCENE_MAIN) {
+            widgets.waterfall->add(psd, SPECTRUM_BINS);
+        }
+        if (scene == SCENE_FT8) {
+            lv_waterfall_add_data(widgets.ft8_waterfall, psd, SPECTRUM_BINS);
+        }
+        display.refresh();
+    }
+
+    /* Frames of own timing, for the pixel counts next to the benchmark */
+    void report(const std::string &name) {
+        double  max_ms = 0.0;
+        double  sum_ms = 0.0;
+
+        px_stats = {};
+
+        for (int i = 0; i < FRAMES; i++) {
+            auto start = std::chrono::steady_clock::now();
+
+            frame();
+
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            sum_ms += ms;
+            max_ms = std::max(max_ms, ms);
+        }
+        printf("%-32s %7.3f ms/frame (max %7.3f), %7llu px refreshed, %7llu px flushed\n",
+               name.c_str(), sum_ms / FRAMES, max_ms,
+               (unsigned long long) (px_stats.refreshed / FRAMES),
+               (unsigned long long) (px_stats.flushed / FRAMES));
+    }
+};
+
+TEST_CASE("Spectrum invalidates only changed columns", "[render]") {
+    Display     display(false);
+    Widgets     widgets(display.screen());
+    float       psd[SPECTRUM_BINS];
+
+    for (size_t i = 0; i < SPECTRUM_BINS; i++) {
+        psd[i] = -110.0f;
+    }
+    lv_spectrum_set_data(widgets.spectrum, psd, NULL, SPECTRUM_BINS, GRID_MIN, GRID_MAX, 0);
+    display.refresh();
+
+    /* Same trace */
+    px_stats = {};
+    lv_spectrum_set_data(widgets.spectrum, psd, NULL, SPECTRUM_BINS, GRID_MIN, GRID_MAX, 0);
+    display.refresh();
+    REQUIRE(px_stats.refreshed == 0);
+
+    /* One carrier: a band of columns, not the whole object */
+    psd[SPECTRUM_BINS / 2] = -80.0f;
+    lv_spectrum_set_data(widgets.spectrum, psd, NULL, SPECTRUM_BINS, GRID_MIN, GRID_MAX, 0);
+    display.refresh();
+    REQUIRE(px_stats.refreshed > 0);
+    REQUIRE(px_stats.refreshed <= WIDTH / LV_SPECTRUM_DIRTY_BANDS * 2 * SPECTRUM_HEIGHT);
+    REQUIRE(px_stats.flushed == px_stats.refreshed);
+}
+
+TEST_CASE("Waterfall row refreshes the image only", "[render]") {
+    Display         display(false);
+    Widgets         widgets(display.screen());
+    SyntheticPsd    gen;
+    float           psd[SPECTRUM_BINS];
+
+    display.refresh();
+    gen.next(psd, SPECTRUM_BINS);
+
+    px_stats = {};
+    widgets.waterfall->add(psd, SPECTRUM_BINS);
+    display.refresh();
+    REQUIRE(px_stats.refreshed == WIDTH * WATERFALL_HEIGHT);
+}
+
+TEST_CASE("Widget rendering", "[.][benchmark][render]") {
+    for (bool sw_rotate : {false, true}) {
+        for (scene_t scene : {SCENE_SPECTRUM, SCENE_WATERFALL, SCENE_MAIN, SCENE_FT8}) {
+            std::string name = std::string(scene_names[scene]) + (sw_rotate ? " rot90" : "");
+            Bench       bench(sw_rotate, scene);
+
+            bench.report(name);
+
+            BENCHMARK(name) {
+                bench.frame();
+            };
+        }
+    }
+}
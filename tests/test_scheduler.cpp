@@ -0,0 +1,148 @@
+extern "C" {
+    #include "../src/scheduler.h"
+}
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+struct small_arg_t {
+    uint32_t    producer;
+    uint32_t    n;
+};
+
+static uint32_t last_n[4];
+static uint32_t received;
+static size_t   big_sum;
+
+static void small_cb(void *arg) {
+    small_arg_t *a = (small_arg_t *) arg;
+
+    REQUIRE(a->n == last_n[a->producer] + 1);
+    last_n[a->producer] = a->n;
+    received++;
+}
+
+static void big_cb(void *arg) {
+    uint8_t *p = (uint8_t *) arg;
+
+    for (size_t i = 0; i < 4000; i++) {
+        big_sum += p[i];
+    }
+}
+
+TEST_CASE( "Scheduler keeps per producer order", "[scheduler]" ) {
+    const uint32_t per_producer = 10000;
+    std::vector<std::thread> producers;
+
+    for (uint32_t p = 0; p < 4; p++) {
+        producers.emplace_back([p, per_producer] {
+            for (uint32_t n = 1; n <= per_producer; n++) {
+                small_arg_t a = {p, n};
+
+                while (!scheduler_put(small_cb, &a, sizeof(a))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    while (received < 4 * per_producer) {
+        scheduler_work();
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    scheduler_work();
+
+    REQUIRE(received == 4 * per_producer);
+}
+
+TEST_CASE( "Scheduler copies large arguments", "[scheduler]" ) {
+    std::vector<uint8_t> data(4000, 1);
+    char text[600];
+    scheduler_stats_t before, after;
+
+    memset(text, 'a', sizeof(text));
+    scheduler_get_stats(&before);
+
+    big_sum = 0;
+    scheduler_put(big_cb, data.data(), data.size());
+    scheduler_put([](void *arg) { REQUIRE(((char *) arg)[599] == 'a'); }, text, sizeof(text));
+    memset(data.data(), 0, data.size());
+    scheduler_work();
+
+    scheduler_get_stats(&after);
+    REQUIRE(big_sum == 4000);
+    REQUIRE(after.slab_args == before.slab_args + 1);
+    REQUIRE(after.malloc_args == before.malloc_args + 1);
+}
+
+static int32_t coalesced_value;
+static uint32_t coalesced_runs;
+
+static void coalesced_cb(void *arg) {
+    coalesced_value = *(int32_t *) arg;
+    coalesced_runs++;
+}
+
+static void sum_merge(void *pending, const void *arg) {
+    *(int32_t *) pending += *(const int32_t *) arg;
+}
+
+TEST_CASE( "Scheduler coalesces keyed tasks", "[scheduler]" ) {
+    coalesced_runs = 0;
+
+    for (int32_t i = 1; i <= 10; i++) {
+        REQUIRE(scheduler_put_coalesced(SCHEDULER_KEY_METER, coalesced_cb, &i, sizeof(i)));
+    }
+    scheduler_work();
+    REQUIRE(coalesced_runs == 1);
+    REQUIRE(coalesced_value == 10);
+
+    for (int32_t i = 1; i <= 10; i++) {
+        REQUIRE(scheduler_put_merged(SCHEDULER_KEY_METER, coalesced_cb, sum_merge, &i, sizeof(i)));
+    }
+    scheduler_work();
+    REQUIRE(coalesced_runs == 2);
+    REQUIRE(coalesced_value == 55);
+}
+
+static std::vector<int> run_order;
+
+static void slow_cb(void *arg) {
+    run_order.push_back(*(int *) arg);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+TEST_CASE( "Scheduler runs lanes by priority within budget", "[scheduler]" ) {
+    int bulk = 3, radio = 2, input = 1;
+
+    run_order.clear();
+    scheduler_set_budget(1000);
+
+    for (int i = 0; i < 4; i++) {
+        scheduler_put_prio(SCHEDULER_PRIO_BULK, slow_cb, &bulk, sizeof(bulk));
+    }
+    scheduler_put_prio(SCHEDULER_PRIO_RADIO, slow_cb, &radio, sizeof(radio));
+    scheduler_put_prio(SCHEDULER_PRIO_INPUT, slow_cb, &input, sizeof(input));
+    scheduler_put_prio(SCHEDULER_PRIO_INPUT, slow_cb, &input, sizeof(input));
+
+    scheduler_work();
+    REQUIRE(run_order == std::vector<int>({1, 1, 2, 3}));
+
+    scheduler_stats_t stats;
+
+    scheduler_get_stats(&stats);
+    REQUIRE(stats.lanes[SCHEDULER_PRIO_BULK].carried > 0);
+
+    while (run_order.size() < 7) {
+        scheduler_work();
+    }
+    REQUIRE(run_order == std::vector<int>({1, 1, 2, 3, 3, 3, 3}));
+    scheduler_set_budget(8000);
+}
@@ -0,0 +1,88 @@
+#include "../src/cfg/subjects.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static void count_cb(Subject *subj, void *user_data) {
+    static_cast<std::atomic<uint32_t> *>(user_data)->fetch_add(1);
+}
+
+TEST_CASE("Queued observer outlives unsubscribe", "[subjects]") {
+    static Subject          *subj = subject_create_int(0);
+    std::atomic<uint32_t>   calls{0};
+
+    subject_ctx_bind(SUBJECT_CTX_DSP);
+
+    ObserverDelayed *o = subject_add_ctx_observer(subj, SUBJECT_CTX_DSP, count_cb, &calls);
+
+    // Change from other thread puts the observer into the mailbox of the context
+    std::thread([] { subject_set_int(subj, 1); }).join();
+
+    observer_delayed_del(o);
+    Subject::reclaim();
+
+    // Still in the mailbox, the drain must see a live observer, which isn't called anymore
+    subject_ctx_run(SUBJECT_CTX_DSP);
+    Subject::reclaim();
+
+    REQUIRE(calls == 0);
+}
+
+TEST_CASE("Unsubscribe during notifications from other context", "[subjects]") {
+    static Subject          *subj = subject_create_int(0);
+    std::atomic<uint32_t>   calls{0};
+    std::atomic<bool>       run{true};
+    std::atomic<bool>       notify{true};
+    std::atomic<bool>       bound{false};
+
+    // Owner of the context drains its mailbox
+    std::thread owner([&] {
+        subject_ctx_bind(SUBJECT_CTX_AUDIO);
+        bound = true;
+
+        while (run) {
+            subject_ctx_run(SUBJECT_CTX_AUDIO);
+        }
+        subject_ctx_run(SUBJECT_CTX_AUDIO);
+    });
+
+    while (!bound) {
+        std::this_thread::yield();
+    }
+
+    std::vector<std::thread> notifiers;
+
+    for (int32_t n = 0; n < 3; n++) {
+        notifiers.emplace_back([&, n] {
+            for (int32_t i = 1; notify; i++) {
+                subject_set_int(subj, i * 3 + n);
+            }
+        });
+    }
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+
+    // Freed victims in a mailbox are caught by the sanitizer of the test build
+    while (std::chrono::steady_clock::now() < end) {
+        ObserverDelayed *o = subject_add_ctx_observer(subj, SUBJECT_CTX_AUDIO, count_cb, &calls);
+
+        std::this_thread::yield();
+        observer_delayed_del(o);
+        Subject::reclaim();
+    }
+
+    // The last drain runs after the last change
+    notify = false;
+    for (auto &t : notifiers) {
+        t.join();
+    }
+    run = false;
+    owner.join();
+    Subject::reclaim();
+
+    REQUIRE(subject_get_int(subj) > 0);
+}
@@ -0,0 +1,90 @@
+#include "../src/triple_buf.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <thread>
+
+typedef struct {
+    uint32_t    seq;
+    uint32_t    data[64];
+} frame_t;
+
+static void fill(frame_t *frame, uint32_t seq) {
+    frame->seq = seq;
+
+    for (uint32_t i = 0; i < 64; i++) {
+        frame->data[i] = seq * 64 + i;
+    }
+}
+
+TEST_CASE("Latest frame is read", "[triple_buf]") {
+    triple_buf_t    buf = triple_buf_create(sizeof(frame_t));
+    bool            fresh;
+
+    const frame_t *frame = (const frame_t *) triple_buf_read(buf, &fresh);
+
+    REQUIRE_FALSE(fresh);
+    REQUIRE(frame->seq == 0);
+
+    fill((frame_t *) triple_buf_back(buf), 1);
+    triple_buf_publish(buf);
+
+    frame = (const frame_t *) triple_buf_read(buf, &fresh);
+    REQUIRE(fresh);
+    REQUIRE(frame->seq == 1);
+
+    /* Same frame again */
+    frame = (const frame_t *) triple_buf_read(buf, &fresh);
+    REQUIRE_FALSE(fresh);
+    REQUIRE(frame->seq == 1);
+
+    /* Unread frame is replaced */
+    fill((frame_t *) triple_buf_back(buf), 2);
+    triple_buf_publish(buf);
+    fill((frame_t *) triple_buf_back(buf), 3);
+    triple_buf_publish(buf);
+
+    frame = (const frame_t *) triple_buf_read(buf, &fresh);
+    REQUIRE(fresh);
+    REQUIRE(frame->seq == 3);
+    REQUIRE(triple_buf_get_dropped(buf) == 1);
+
+    triple_buf_destroy(buf);
+}
+
+TEST_CASE("Frames are not torn", "[triple_buf]") {
+    triple_buf_t    buf = triple_buf_create(sizeof(frame_t));
+    const uint32_t  count = 200000;
+    uint32_t        read = 0;
+    uint32_t        last = 0;
+    bool            torn = false;
+
+    std::thread producer([&] {
+        for (uint32_t seq = 1; seq <= count; seq++) {
+            fill((frame_t *) triple_buf_back(buf), seq);
+            triple_buf_publish(buf);
+        }
+    });
+
+    while (last < count) {
+        bool            fresh;
+        const frame_t   *frame = (const frame_t *) triple_buf_read(buf, &fresh);
+
+        if (!fresh) {
+            continue;
+        }
+        for (uint32_t i = 0; i < 64; i++) {
+            torn |= frame->data[i] != frame->seq * 64 + i;
+        }
+        torn |= frame->seq <= last;
+        last = frame->seq;
+        read++;
+    }
+    producer.join();
+
+    REQUIRE_FALSE(torn);
+    REQUIRE(read + triple_buf_get_dropped(buf) == count);
+
+    triple_buf_destroy(buf);
+}